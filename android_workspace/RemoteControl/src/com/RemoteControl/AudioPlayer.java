@@ -0,0 +1,404 @@
+package com.RemoteControl;
+
+import java.util.concurrent.ArrayBlockingQueue;
+import java.util.concurrent.BlockingQueue;
+
+import android.media.AudioFormat;
+import android.media.AudioManager;
+import android.media.AudioTrack;
+import android.os.SystemClock;
+
+/**
+ * Plays a playlist entry on the phone, the audioStream_ stream of the server.
+ * The stream is only served with the framed protocol, which carries the
+ * blocks as data after their audioBlock_ line. ReceiveClass hands the blocks
+ * over, a thread of the stream decodes them from IMA ADPCM and writes them to
+ * an AudioTrack, so a full AudioTrack never stops the receive path. The
+ * server lowers the quality of a stream that falls behind, such blocks are
+ * expanded to the rate and channels of the AudioTrack. The next playlist
+ * entry may have another format, it gets a new AudioTrack.
+ */
+public class AudioPlayer {
+
+	// milliseconds of audio the AudioTrack buffers, the prebuffer the server
+	// sends at once when a stream starts
+	static final int BUFFER_MS = 400;
+
+	// blocks of 100 ms waiting for the stream thread. the oldest is dropped
+	// once it falls this far behind
+	static final int QUEUE_BLOCKS = 20;
+
+	// samples per channel of a block, far above the 100 ms of the server
+	static final int MAX_FRAMES = 48000;
+
+	// IMA ADPCM tables, the same as on the server
+	private static final int[] INDEX = { -1, -1, -1, -1, 2, 4, 6, 8, -1, -1,
+			-1, -1, 2, 4, 6, 8 };
+
+	private static final int[] STEP = { 7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+			19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88,
+			97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337,
+			371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166,
+			1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+			3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493,
+			10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385,
+			24623, 27086, 29794, 32767 };
+
+	/**
+	 * One audioBlock_ of the server, or the end of the stream if data is
+	 * null.
+	 */
+	private static final class Block {
+		int rate;
+		int channels;
+		int frames;
+		byte[] data;
+	}
+
+	/**
+	 * One audioStream_ command and the thread that plays its blocks.
+	 */
+	private static final class Stream implements Runnable {
+		// number of the audioStream_ command, see SendClass.startAudio
+		final int id;
+
+		final BlockingQueue<Block> blocks = new ArrayBlockingQueue<Block>(
+				QUEUE_BLOCKS);
+
+		Thread thread;
+
+		Stream(int id) {
+			this.id = id;
+		}
+
+		void add(Block block) {
+			while (!blocks.offer(block))
+				blocks.poll();
+		}
+
+		public void run() {
+			AudioTrack track = null;
+			int rate = 0;
+			int channels = 0;
+
+			short[] decoded = new short[0];
+			short[] expanded = new short[0];
+
+			// frames written to the current AudioTrack
+			long written = 0;
+
+			try {
+				while (true) {
+					Block block = blocks.take();
+
+					if (block.data == null) {
+						// audioEnd_, the written audio is played out
+						if (track != null)
+							drain(track, written);
+
+						break;
+					}
+
+					if (track == null || rate % block.rate != 0
+							|| block.channels > channels) {
+						if (track != null) {
+							drain(track, written);
+							track.release();
+						}
+
+						rate = block.rate;
+						channels = block.channels;
+						track = open(rate, channels);
+						written = 0;
+
+						if (track == null)
+							break;
+					}
+
+					int samples = block.frames * block.channels;
+
+					if (decoded.length < samples)
+						decoded = new short[samples];
+
+					decode(block.data, block.channels, block.frames, decoded);
+
+					int factor = rate / block.rate;
+					int length = block.frames * factor * channels;
+
+					if (factor == 1 && channels == block.channels) {
+						track.write(decoded, 0, length);
+					} else {
+						if (expanded.length < length)
+							expanded = new short[length];
+
+						expand(decoded, block.channels, block.frames, factor,
+								channels, expanded);
+						track.write(expanded, 0, length);
+					}
+
+					written += block.frames * factor;
+				}
+			} catch (InterruptedException e) {
+				// audioStop or a newer stream, what is buffered is dropped
+			} finally {
+				if (track != null)
+					track.release();
+			}
+		}
+	}
+
+	// stream that is played, null if none
+	private Stream stream = null;
+
+	/**
+	 * starts listening to a playlist entry, a stream that is played is
+	 * replaced. only offered with the framed protocol
+	 * 
+	 * @param position
+	 *            playlist position, -1 for the current track
+	 */
+	synchronized void start(int position) {
+		quit();
+
+		stream = new Stream(SendClass.startAudio(position));
+		stream.thread = new Thread(stream, "AudioPlayer");
+		stream.thread.start();
+	}
+
+	/**
+	 * stops listening
+	 */
+	synchronized void stop() {
+		if (stream != null)
+			SendClass.stopAudio();
+
+		quit();
+	}
+
+	/**
+	 * stops playing without telling the server, its session is gone
+	 */
+	synchronized void disconnected() {
+		quit();
+	}
+
+	/**
+	 * @return true while a stream is played
+	 */
+	synchronized boolean isPlaying() {
+		return stream != null;
+	}
+
+	/**
+	 * hands an audioBlock_ to the thread of its stream. blocks of a replaced
+	 * or stopped stream are dropped
+	 * 
+	 * @param id
+	 *            number of the stream
+	 * @param rate
+	 *            sample rate of the block
+	 * @param channels
+	 *            1 or 2
+	 * @param frames
+	 *            samples per channel
+	 * @param data
+	 *            the block, blockLength(channels, frames) bytes
+	 */
+	synchronized void add(int id, int rate, int channels, int frames,
+			byte[] data) {
+		if (stream == null || stream.id != id || rate <= 0 || channels < 1
+				|| channels > 2)
+			return;
+
+		Block block = new Block();
+		block.rate = rate;
+		block.channels = channels;
+		block.frames = frames;
+		block.data = data;
+
+		stream.add(block);
+	}
+
+	/**
+	 * audioEnd_: the last entry of the playlist has been sent, the stream
+	 * ends once the buffered audio has been played
+	 * 
+	 * @param id
+	 *            number of the stream
+	 */
+	synchronized void end(int id) {
+		if (stream == null || stream.id != id)
+			return;
+
+		stream.add(new Block());
+		stream = null;
+	}
+
+	/**
+	 * audioError_: the server couldn't decode the entry or the connection
+	 * isn't framed
+	 * 
+	 * @param id
+	 *            number of the stream
+	 * @return true if the error belongs to the stream that is played
+	 */
+	synchronized boolean error(int id) {
+		if (stream == null || stream.id != id)
+			return false;
+
+		quit();
+
+		return true;
+	}
+
+	private void quit() {
+		if (stream == null)
+			return;
+
+		stream.thread.interrupt();
+		stream = null;
+	}
+
+	/**
+	 * @param channels
+	 *            channels of a block
+	 * @param frames
+	 *            samples per channel
+	 * @return bytes of an audioBlock_: predictor, step index and a zero byte
+	 *         per channel, then the 4 bit codes of the samples
+	 * @throws NumberFormatException
+	 *             the format isn't one of the server
+	 */
+	static int blockLength(int channels, int frames) {
+		if (channels < 1 || channels > 2 || frames < 0 || frames > MAX_FRAMES)
+			throw new NumberFormatException("audio block format");
+
+		return channels * 4 + (frames * channels + 1) / 2;
+	}
+
+	/**
+	 * decodes an IMA ADPCM block of the server. every channel starts with its
+	 * predictor (16 bit, little endian), step index and a zero byte, the
+	 * codes of the samples follow interleaved, the lower half of a byte first
+	 * 
+	 * @param data
+	 *            the block
+	 * @param channels
+	 *            1 or 2
+	 * @param frames
+	 *            samples per channel
+	 * @param samples
+	 *            receives the interleaved 16 bit samples
+	 */
+	static void decode(byte[] data, int channels, int frames, short[] samples) {
+		int[] predictor = new int[channels];
+		int[] index = new int[channels];
+
+		for (int c = 0; c < channels; c++) {
+			predictor[c] = (short) ((data[c * 4] & 0xFF) | (data[c * 4 + 1] << 8));
+			index[c] = Math.max(0, Math.min(88, data[c * 4 + 2]));
+		}
+
+		int nibble = channels * 8;
+
+		for (int i = 0; i < frames * channels; i++, nibble++) {
+			int c = i % channels;
+			int code = (data[nibble / 2] >> ((nibble & 1) * 4)) & 0x0F;
+
+			int step = STEP[index[c]];
+			int delta = step >> 3;
+
+			if ((code & 4) != 0)
+				delta += step;
+			if ((code & 2) != 0)
+				delta += step >> 1;
+			if ((code & 1) != 0)
+				delta += step >> 2;
+
+			predictor[c] += (code & 8) != 0 ? -delta : delta;
+			predictor[c] = Math.max(-32768, Math.min(32767, predictor[c]));
+			index[c] = Math.max(0, Math.min(88, index[c] + INDEX[code]));
+
+			samples[i] = (short) predictor[c];
+		}
+	}
+
+	/**
+	 * repeats the samples of a block of lower quality to the rate and
+	 * channels of the AudioTrack
+	 * 
+	 * @param samples
+	 *            decoded block
+	 * @param channels
+	 *            channels of the block
+	 * @param frames
+	 *            samples per channel of the block
+	 * @param factor
+	 *            rate of the AudioTrack divided by the rate of the block
+	 * @param outChannels
+	 *            channels of the AudioTrack, at least channels
+	 * @param target
+	 *            receives frames * factor * outChannels samples
+	 */
+	static void expand(short[] samples, int channels, int frames, int factor,
+			int outChannels, short[] target) {
+		int out = 0;
+
+		for (int f = 0; f < frames; f++) {
+			for (int r = 0; r < factor; r++) {
+				for (int c = 0; c < outChannels; c++)
+					target[out++] = samples[f * channels
+							+ Math.min(c, channels - 1)];
+			}
+		}
+	}
+
+	/**
+	 * @return a playing AudioTrack, null if the format isn't supported
+	 */
+	private static AudioTrack open(int rate, int channels) {
+		int config = channels == 1 ? AudioFormat.CHANNEL_CONFIGURATION_MONO
+				: AudioFormat.CHANNEL_CONFIGURATION_STEREO;
+
+		int minimum = AudioTrack.getMinBufferSize(rate, config,
+				AudioFormat.ENCODING_PCM_16BIT);
+
+		if (minimum <= 0)
+			return null;
+
+		int size = Math.max(minimum, rate * channels * 2 * BUFFER_MS / 1000);
+
+		try {
+			AudioTrack track = new AudioTrack(AudioManager.STREAM_MUSIC, rate,
+					config, AudioFormat.ENCODING_PCM_16BIT, size,
+					AudioTrack.MODE_STREAM);
+
+			if (track.getState() != AudioTrack.STATE_INITIALIZED) {
+				track.release();
+				return null;
+			}
+
+			track.play();
+
+			return track;
+		} catch (IllegalArgumentException e) {
+			return null;
+		}
+	}
+
+	/**
+	 * waits until the written frames have been played
+	 * 
+	 * @throws InterruptedException
+	 *             the stream has been stopped
+	 */
+	private static void drain(AudioTrack track, long written)
+			throws InterruptedException {
+		// the head position wraps at 2^32 frames, hours of audio
+		long deadline = SystemClock.uptimeMillis() + BUFFER_MS * 2;
+
+		while ((track.getPlaybackHeadPosition() & 0xFFFFFFFFL) < written
+				&& SystemClock.uptimeMillis() < deadline)
+			Thread.sleep(20);
+	}
+}
@@ -1,82 +1,596 @@
 package com.RemoteControl;
 
+import java.io.File;
+import java.io.FileOutputStream;
 import java.io.IOException;
+import java.io.InputStream;
+import java.nio.ByteBuffer;
+import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.Comparator;
+import java.util.HashMap;
+import java.util.LinkedHashMap;
 import java.util.LinkedList;
+import java.util.Map;
+import java.util.concurrent.CountDownLatch;
+import java.util.concurrent.Executor;
+import java.util.concurrent.Executors;
+import java.util.zip.DataFormatException;
+import java.util.zip.Inflater;
 
 import android.graphics.Bitmap;
 import android.graphics.BitmapFactory;
 
 public class CoverReader {
 
-	private LinkedList<Bitmap> coverList = new LinkedList<Bitmap>();
+	// receives decoded covers
+	interface CoverTarget {
+		/**
+		 * called on the decode thread
+		 * 
+		 * @param cover
+		 *            decoded cover, null if there is none or it couldn't be
+		 *            decoded
+		 */
+		void setCover(Bitmap cover);
+	}
+
+	// number of covers kept by hash on disk. the server assumes the same size
+	// and eviction order to know which covers need not be sent again
+	static final int COVER_HASHES = 256;
+
+	// number of decoded covers kept in memory
+	static final int COVER_BITMAPS = 16;
+
+	// number of read buffers kept for the next covers
+	static final int COVER_BUFFERS = 4;
+
+	// read buffers are made in multiples of this many bytes, so a few fit
+	// covers of all sizes
+	static final int BUFFER_GRANULARITY = 32 * 1024;
+
+	// bitmaps of dropped raw thumbnails kept for the next ones
+	static final int THUMBNAIL_POOL = 8;
+
+	// hashes per coverKnown_ command, the server takes 1024 characters
+	static final int HASHES_PER_COMMAND = 40;
+
+	// characters of a cover hash, a 64 bit hash in hex. the hash names the
+	// file of the cover in the cache directory
+	static final int HASH_LENGTH = 16;
+
+	// decodes the covers in the order they were received, the socket thread
+	// only reads them
+	private Executor decoder = Executors.newSingleThreadExecutor();
+
+	// options of the decode thread, the temporary storage of the decoder is
+	// reused for every cover
+	private BitmapFactory.Options decodeOptions = new BitmapFactory.Options();
+
+	// inflater and pixel buffer of the raw thumbnails, owned by the decode
+	// thread like the options
+	private Inflater pixelInflater = new Inflater();
+	private byte[] pixels = new byte[64 * 64 * 4];
+
+	// nanoseconds the decode thread has spent decoding and the covers it has
+	// decoded, see ReplayBenchmark. only written by the decode thread
+	volatile long decodeTime = 0;
+	volatile int decoded = 0;
+
+	// free read buffers
+	private LinkedList<byte[]> buffers = new LinkedList<byte[]>();
+
+	// latest request by target, see latest
+	private HashMap<CoverTarget, Object> requests = new HashMap<CoverTarget, Object>();
+
+	// pixels of the larger side covers are decoded with, 0 for the full size
+	// until the size has been sent with coverOptions
+	private volatile int coverSize = 0;
+
+	// hashes of the covers on disk, least recently used first
+	private LinkedHashMap<String, Boolean> hashes = new LinkedHashMap<String, Boolean>(
+			COVER_HASHES + 1, 0.75f, true);
+
+	// decoded covers by their server hash, least recently used first
+	private LinkedHashMap<String, Bitmap> bitmaps = new LinkedHashMap<String, Bitmap>(
+			COVER_BITMAPS + 1, 0.75f, true) {
+		private static final long serialVersionUID = 1L;
+
+		@Override
+		protected boolean removeEldestEntry(Map.Entry<String, Bitmap> eldest) {
+			return size() > COVER_BITMAPS;
+		}
+	};
+
+	// covers of the size requested with the last coverOptions, null before
+	private File directory = null;
+
+	// hashes of the playlist thumbnails of covers_, least recently used
+	// first. only the covers_ answers change the order, the server keeps the
+	// same one to know which thumbnails need not be sent again
+	private LinkedHashMap<String, Boolean> thumbnailHashes = new LinkedHashMap<String, Boolean>(
+			COVER_HASHES + 1, 0.75f, true);
+
+	// decoded thumbnails by hash, null if a thumbnail couldn't be decoded
+	private HashMap<String, Bitmap> thumbnails = new HashMap<String, Bitmap>();
+
+	// mutable bitmaps of raw thumbnails that have been dropped. a thumbnail is
+	// dropped COVER_HASHES thumbnails after it was last shown, no row shows it
+	// anymore when it is overwritten
+	private LinkedList<Bitmap> thumbnailPool = new LinkedList<Bitmap>();
+
+	CoverReader() {
+		decodeOptions.inTempStorage = new byte[16 * 1024];
+	}
 
 	/**
-	 * reads a cover file from the input stream. if the hash of a cover is in
-	 * coverHashMap the cover is taken from coverHashMap.
+	 * reads a cover from the input stream and hands it to the decode thread.
+	 * the target gets the cover or null if it couldn't be decoded. a cover
+	 * that is followed by another one for the same target before its decoding
+	 * starts is kept but not decoded, the target gets the newer one
 	 * 
 	 * @param fileSize
 	 *            size of cover to read
-	 * @param makeSmall
-	 *            if true, the file is resized to 50 px width and put into
-	 *            coverHashMap
-	 * @return Bitmap
+	 * @param hash
+	 *            hash from coverHash_, null if none was announced
+	 * @param target
+	 *            receives the decoded cover on the decode thread
 	 * @throws IOException
 	 */
-	Bitmap readCover(int fileSize, boolean makeSmall) throws IOException {
+	void readCover(int fileSize, String hash, CoverTarget target)
+			throws IOException {
+		byte[] imageBytes = null;
 
-		Bitmap cover = null;
+		try {
+			if (fileSize > 0)
+				imageBytes = readBytes(main.getInputStream(), fileSize);
+		} catch (IOException e) {
+			e.printStackTrace();
 
-		if (fileSize > 0) {
-			try {
-				byte[] imageBytes = new byte[fileSize];
+			main.getErrorClassHandler().post(
+					ErrorMessagesClass.conversion_error);
+		}
 
-				int length, count = 0;
+		readCover(imageBytes, fileSize, hash, target);
+	}
 
-				// read data
-				while (count < fileSize) {
-					length = main.getInputStream().read(imageBytes, count,
-							fileSize - count);
-					count += length;
-				}
+	/**
+	 * hands a cover that has been read with readBytes to the decode thread,
+	 * see readCover(int, String, CoverTarget)
+	 * 
+	 * @param imageBytes
+	 *            buffer of readBytes, null if the server sent no cover. it
+	 *            goes back to the pool once it is decoded
+	 * @param length
+	 *            size of the cover
+	 * @param hash
+	 *            hash from coverHash_, null if none was announced
+	 * @param target
+	 *            receives the decoded cover on the decode thread
+	 */
+	void readCover(final byte[] imageBytes, final int length,
+			final String hash, final CoverTarget target) {
+		// outdates the covers of the target that aren't decoded yet
+		final Object request = latest(target);
 
-				// chose: playlist cover (fit to 50 px width and put into
-				// coverList) OR overview cover (original size, not put into
-				// coverList)
-				if (makeSmall) {
-					// get cover from coverList or create new bitmap and put
-					// into coverHashMap
-
-					if (fileSize < 0)
-						cover = coverList.get(-fileSize);
-					else {
-						BitmapFactory.Options bfOptions = new BitmapFactory.Options();
-
-						if (fileSize < 10000)
-							bfOptions.inSampleSize = 1;
-						else if (fileSize < 20000)
-							bfOptions.inSampleSize = 2;
-						else if (fileSize < 40000)
-							bfOptions.inSampleSize = 4;
-						else if (fileSize < 80000)
-							bfOptions.inSampleSize = 8;
-						else
-							bfOptions.inSampleSize = 16;
-
-						cover = BitmapFactory.decodeByteArray(imageBytes, 0,
-								imageBytes.length, bfOptions);
-
-						if (cover != null)
-							coverList.add(cover);
+		if (imageBytes == null) {
+			target.setCover(null);
+			return;
+		}
+
+		decoder.execute(new Runnable() {
+			public void run() {
+				Bitmap cover = null;
+
+				try {
+					// the server counts the cover as sent, it has to be kept
+					// even if it isn't shown. without a disk cache it can
+					// only be kept decoded
+					if (isLatest(target, request) || (hash != null && directory == null)) {
+						long started = System.nanoTime();
+
+						cover = decode(imageBytes, length, coverSize);
+
+						decodeTime += System.nanoTime() - started;
+						decoded++;
 					}
-				} else
-					cover = BitmapFactory.decodeByteArray(imageBytes, 0,
-							imageBytes.length);
 
+					if (hash != null)
+						putCover(hash, cover, imageBytes, length);
+				} finally {
+					releaseBuffer(imageBytes);
+				}
+
+				if (isLatest(target, request))
+					target.setCover(cover);
+			}
+		});
+	}
+
+	/**
+	 * waits until the decode thread has handled every cover handed to it
+	 * before
+	 * 
+	 * @throws InterruptedException
+	 */
+	void drain() throws InterruptedException {
+		final CountDownLatch done = new CountDownLatch(1);
+
+		decoder.execute(new Runnable() {
+			public void run() {
+				done.countDown();
+			}
+		});
+
+		done.await();
+	}
+
+	/**
+	 * reads data of the server into a buffer of the pool. the socket thread
+	 * never waits for a buffer, a new one is made if all are in use
+	 * 
+	 * @param in
+	 *            stream of the server
+	 * @param fileSize
+	 *            number of bytes
+	 * @return buffer with the data at its start, at least fileSize bytes long
+	 * @throws IOException
+	 */
+	byte[] readBytes(InputStream in, int fileSize) throws IOException {
+		byte[] data = acquireBuffer(fileSize);
+
+		int length, count = 0;
+
+		try {
+			while (count < fileSize) {
+				length = in.read(data, count, fileSize - count);
+
+				if (length < 0)
+					throw new IOException("Data truncated");
+
+				count += length;
+			}
+		} catch (IOException e) {
+			releaseBuffer(data);
+
+			throw e;
+		}
+
+		return data;
+	}
+
+	/**
+	 * @param size
+	 *            number of bytes needed
+	 * @return the smallest free buffer of the pool that is large enough, a
+	 *         new one rounded up to BUFFER_GRANULARITY if there is none
+	 */
+	private byte[] acquireBuffer(int size) {
+		synchronized (buffers) {
+			byte[] best = null;
+
+			for (byte[] buffer : buffers) {
+				if (buffer.length >= size
+						&& (best == null || buffer.length < best.length))
+					best = buffer;
+			}
+
+			if (best != null) {
+				buffers.remove(best);
+
+				return best;
+			}
+		}
+
+		return new byte[(size + BUFFER_GRANULARITY - 1) / BUFFER_GRANULARITY
+				* BUFFER_GRANULARITY];
+	}
+
+	/**
+	 * gives a buffer back to the pool. the smallest one is dropped if the
+	 * pool is full
+	 * 
+	 * @param buffer
+	 *            buffer of acquireBuffer
+	 */
+	private void releaseBuffer(byte[] buffer) {
+		synchronized (buffers) {
+			buffers.add(buffer);
+
+			if (buffers.size() > COVER_BUFFERS) {
+				byte[] smallest = buffer;
+
+				for (byte[] b : buffers) {
+					if (b.length < smallest.length)
+						smallest = b;
+				}
+
+				buffers.remove(smallest);
+			}
+		}
+	}
+
+	/**
+	 * starts a new request for a target, the earlier ones are outdated
+	 * 
+	 * @param target
+	 *            receiver of the cover
+	 * @return token of the request, see isLatest
+	 */
+	private Object latest(CoverTarget target) {
+		Object request = new Object();
+
+		synchronized (requests) {
+			requests.put(target, request);
+		}
+
+		return request;
+	}
+
+	/**
+	 * @param target
+	 *            receiver of the cover
+	 * @param request
+	 *            token of latest
+	 * @return true if no newer request for the target has been made
+	 */
+	private boolean isLatest(CoverTarget target, Object request) {
+		synchronized (requests) {
+			return requests.get(target) == request;
+		}
+	}
+
+	/**
+	 * decodes an image that is at least size pixels wide or high if it is
+	 * larger, the largest power of two is skipped. called on the decode
+	 * thread only, which owns the options and their temporary storage
+	 * 
+	 * @param data
+	 *            encoded image
+	 * @param length
+	 *            number of bytes of the image in data
+	 * @param size
+	 *            pixels of the larger side, 0 for the full size
+	 * @return image, null if it couldn't be decoded
+	 */
+	private Bitmap decode(byte[] data, int length, int size) {
+		decodeOptions.inJustDecodeBounds = true;
+		decodeOptions.inSampleSize = 1;
+
+		BitmapFactory.decodeByteArray(data, 0, length, decodeOptions);
+
+		decodeOptions.inJustDecodeBounds = false;
+		decodeOptions.inSampleSize = sampleSize(decodeOptions.outWidth,
+				decodeOptions.outHeight, size);
+
+		try {
+			return BitmapFactory.decodeByteArray(data, 0, length,
+					decodeOptions);
+		} catch (OutOfMemoryError e) {
+			return null;
+		}
+	}
+
+	/**
+	 * copies the pixels of a raw thumbnail into a bitmap of the pool or a new
+	 * one. the thumbnail is a zlib stream of a square of pixels in the format
+	 * of Settings.THUMBNAIL_FORMAT, row by row. called on the decode thread
+	 * only, which owns the inflater and the pixel buffer
+	 * 
+	 * @param data
+	 *            compressed pixels
+	 * @param length
+	 *            number of bytes of the thumbnail in data
+	 * @return thumbnail, null if the pixels are damaged
+	 */
+	private Bitmap copyPixels(byte[] data, int length) {
+		Bitmap.Config config = Settings.THUMBNAIL_FORMAT == Settings.THUMBNAIL_RGB565 ? Bitmap.Config.RGB_565
+				: Bitmap.Config.ARGB_8888;
+		int pixelBytes = config == Bitmap.Config.RGB_565 ? 2 : 4;
+		int count = 0;
+
+		pixelInflater.reset();
+		pixelInflater.setInput(data, 0, length);
+
+		try {
+			while (!pixelInflater.finished()) {
+				if (count == pixels.length) {
+					byte[] larger = new byte[pixels.length * 2];
+					System.arraycopy(pixels, 0, larger, 0, count);
+					pixels = larger;
+				}
+
+				int inflated = pixelInflater.inflate(pixels, count,
+						pixels.length - count);
+
+				if (inflated == 0
+						&& (pixelInflater.needsInput() || pixelInflater
+								.needsDictionary()))
+					return null;
+
+				count += inflated;
+			}
+		} catch (DataFormatException e) {
+			return null;
+		}
+
+		int side = (int) Math.sqrt(count / pixelBytes);
+
+		if (side == 0 || side * side * pixelBytes != count)
+			return null;
+
+		Bitmap bitmap = null;
+
+		synchronized (this) {
+			for (Bitmap pooled : thumbnailPool) {
+				if (pooled.getWidth() == side && pooled.getHeight() == side
+						&& pooled.getConfig() == config) {
+					thumbnailPool.remove(pooled);
+					bitmap = pooled;
+					break;
+				}
+			}
+		}
+
+		try {
+			if (bitmap == null)
+				bitmap = Bitmap.createBitmap(side, side, config);
+		} catch (OutOfMemoryError e) {
+			return null;
+		}
+
+		bitmap.copyPixelsFromBuffer(ByteBuffer.wrap(pixels, 0, count));
+
+		return bitmap;
+	}
+
+	/**
+	 * @param hash
+	 *            hash sent by the server
+	 * @return the hash if it is HASH_LENGTH lower case hex digits like the
+	 *         server sends them, else null. only such a hash may name a file
+	 *         of the cache directory
+	 */
+	static String validHash(String hash) {
+		if (hash.length() != HASH_LENGTH)
+			return null;
+
+		for (int i = 0; i < HASH_LENGTH; i++) {
+			char c = hash.charAt(i);
+
+			if ((c < '0' || c > '9') && (c < 'a' || c > 'f'))
+				return null;
+		}
+
+		return hash;
+	}
+
+	/**
+	 * @param width
+	 *            width of the image
+	 * @param height
+	 *            height of the image
+	 * @param size
+	 *            pixels of the larger side, 0 for the full size
+	 * @return the largest power of two that keeps the larger side at least
+	 *         size pixels
+	 */
+	static int sampleSize(int width, int height, int size) {
+		int larger = Math.max(width, height);
+		int sample = 1;
+
+		while (size > 0 && larger / (sample * 2) >= size)
+			sample *= 2;
+
+		return sample;
+	}
+
+	/**
+	 * stores a received cover under the hash announced by the server. the
+	 * least recently used cover is deleted like by the server
+	 * 
+	 * @param hash
+	 *            hash from coverHash_, not stored unless it is a validHash
+	 * @param cover
+	 *            received cover, may be null
+	 * @param data
+	 *            encoded cover
+	 * @param length
+	 *            number of bytes of the cover in data
+	 */
+	private synchronized void putCover(String hash, Bitmap cover, byte[] data,
+			int length) {
+		if (validHash(hash) == null)
+			return;
+
+		if (cover != null)
+			bitmaps.put(hash, cover);
+
+		hashes.put(hash, Boolean.TRUE);
+
+		if (directory != null) {
+			try {
+				FileOutputStream out = new FileOutputStream(new File(
+						directory, hash));
+
+				try {
+					out.write(data, 0, length);
+				} finally {
+					out.close();
+				}
 			} catch (IOException e) {
-				e.printStackTrace();
+				// memory only
+			}
+		}
+
+		while (hashes.size() > COVER_HASHES) {
+			String eldest = hashes.keySet().iterator().next();
+
+			hashes.remove(eldest);
+			bitmaps.remove(eldest);
+
+			if (directory != null)
+				new File(directory, eldest).delete();
+		}
+	}
+
+	/**
+	 * hands a cover the server didn't send again (coverCached_) to the target,
+	 * decoded from the disk cache if it isn't in memory
+	 * 
+	 * @param hash
+	 *            hash from coverCached_
+	 * @param target
+	 *            receives the cover on the decode thread, null if it is
+	 *            unknown
+	 */
+	void getCover(final String hash, final CoverTarget target) {
+		final Object request = latest(target);
+
+		decoder.execute(new Runnable() {
+			public void run() {
+				if (isLatest(target, request)) {
+					Bitmap cover = getCover(hash);
+
+					if (isLatest(target, request))
+						target.setCover(cover);
+				}
+			}
+		});
+	}
+
+	/**
+	 * @param hash
+	 *            hash from coverCached_
+	 * @return cover or null if it is unknown. called on the decode thread
+	 */
+	private Bitmap getCover(String hash) {
+		File file;
+
+		synchronized (this) {
+			if (hashes.get(hash) == null)
+				return null;
+
+			if (directory == null)
+				return bitmaps.get(hash);
 
-				main.getErrorClassHandler().post(
-						ErrorMessagesClass.conversion_error);
+			file = new File(directory, hash);
+
+			// the order of the disk cache survives a restart
+			file.setLastModified(System.currentTimeMillis());
+
+			Bitmap cover = bitmaps.get(hash);
+
+			if (cover != null)
+				return cover;
+		}
+
+		Bitmap cover = decode(file, coverSize);
+
+		if (cover != null) {
+			synchronized (this) {
+				if (hashes.containsKey(hash))
+					bitmaps.put(hash, cover);
 			}
 		}
 
@@ -84,9 +598,216 @@ public class CoverReader {
 	}
 
 	/**
-	 * resets the coverHashMap
+	 * decodes a file of the disk cache like decode(byte[], int, int)
+	 * 
+	 * @param file
+	 *            encoded image
+	 * @param size
+	 *            pixels of the larger side, 0 for the full size
+	 * @return image, null if it couldn't be decoded
+	 */
+	private Bitmap decode(File file, int size) {
+		decodeOptions.inJustDecodeBounds = true;
+		decodeOptions.inSampleSize = 1;
+
+		BitmapFactory.decodeFile(file.getPath(), decodeOptions);
+
+		decodeOptions.inJustDecodeBounds = false;
+		decodeOptions.inSampleSize = sampleSize(decodeOptions.outWidth,
+				decodeOptions.outHeight, size);
+
+		try {
+			return BitmapFactory.decodeFile(file.getPath(), decodeOptions);
+		} catch (OutOfMemoryError e) {
+			return null;
+		}
+	}
+
+	/**
+	 * builds the coverSize_ and coverKnown_ commands: the cover size the
+	 * server should scale to and the hashes on disk, least recently used
+	 * first. opens the disk cache of the size, the covers of other sizes are
+	 * deleted
+	 * 
+	 * @param size
+	 *            maximum width and height in pixels
+	 * @return commands
+	 */
+	synchronized ArrayList<String> coverOptions(int size) {
+		openDirectory(size);
+
+		coverSize = size;
+
+		// a new session of the server knows no thumbnails
+		thumbnailHashes.clear();
+		thumbnails.clear();
+
+		ArrayList<String> commands = new ArrayList<String>();
+		commands.add("coverSize_" + size);
+
+		StringBuilder command = null;
+		int count = 0;
+
+		for (String hash : hashes.keySet()) {
+			if (command == null)
+				command = new StringBuilder("coverKnown");
+
+			command.append('_').append(hash);
+
+			if (++count % HASHES_PER_COMMAND == 0) {
+				commands.add(command.toString());
+				command = null;
+			}
+		}
+
+		if (command != null)
+			commands.add(command.toString());
+
+		return commands;
+	}
+
+	/**
+	 * reads the hashes of the covers of one size from the cache directory of
+	 * the app, least recently used first
+	 * 
+	 * @param size
+	 *            maximum width and height in pixels
+	 */
+	private void openDirectory(int size) {
+		File covers = new File(main.getActivity().getCacheDir(), "covers");
+		File sized = new File(covers, String.valueOf(size));
+
+		if (sized.equals(directory))
+			return;
+
+		File[] others = covers.listFiles();
+
+		for (int i = 0; others != null && i < others.length; i++) {
+			if (!others[i].equals(sized))
+				deleteDirectory(others[i]);
+		}
+
+		sized.mkdirs();
+
+		directory = sized;
+		hashes.clear();
+		bitmaps.clear();
+
+		File[] files = sized.listFiles();
+
+		if (files == null)
+			return;
+
+		Arrays.sort(files, new Comparator<File>() {
+			public int compare(File a, File b) {
+				long difference = a.lastModified() - b.lastModified();
+
+				return difference < 0 ? -1 : (difference > 0 ? 1 : 0);
+			}
+		});
+
+		for (int i = 0; i < files.length; i++) {
+			if (i < files.length - COVER_HASHES)
+				files[i].delete();
+			else
+				hashes.put(files[i].getName(), Boolean.TRUE);
+		}
+	}
+
+	private static void deleteDirectory(File directory) {
+		File[] files = directory.listFiles();
+
+		for (int i = 0; files != null && i < files.length; i++)
+			files[i].delete();
+
+		directory.delete();
+	}
+
+	/**
+	 * marks the thumbnail of a row of a covers_ answer as recently used, in
+	 * the order of the rows like the server
+	 * 
+	 * @param hash
+	 *            hash of the cover of the row
+	 */
+	synchronized void touchThumbnail(String hash) {
+		thumbnailHashes.get(hash);
+	}
+
+	/**
+	 * keeps a thumbnail announced with thumb_ in memory once it is decoded,
+	 * or once its pixels are copied if it is raw. the least recently used one
+	 * is dropped like by the server
+	 * 
+	 * @param hash
+	 *            hash of the cover
+	 * @param imageBytes
+	 *            buffer of readBytes, it goes back to the pool once it is
+	 *            decoded
+	 * @param length
+	 *            size of the thumbnail
+	 * @param target
+	 *            told on the decode thread when the thumbnail is there
+	 */
+	void readThumbnail(final String hash, final byte[] imageBytes,
+			final int length, final CoverTarget target) {
+		// the order of the hashes is the one of the messages like on the
+		// server, the thumbnail follows
+		synchronized (this) {
+			thumbnailHashes.put(hash, Boolean.TRUE);
+
+			while (thumbnailHashes.size() > COVER_HASHES) {
+				String eldest = thumbnailHashes.keySet().iterator().next();
+
+				thumbnailHashes.remove(eldest);
+				Bitmap dropped = thumbnails.remove(eldest);
+
+				// only the bitmaps of raw thumbnails are mutable
+				if (dropped != null && dropped.isMutable()
+						&& thumbnailPool.size() < THUMBNAIL_POOL)
+					thumbnailPool.add(dropped);
+			}
+		}
+
+		decoder.execute(new Runnable() {
+			public void run() {
+				Bitmap thumbnail;
+
+				try {
+					if (Settings.THUMBNAIL_FORMAT == Settings.THUMBNAIL_JPEG)
+						thumbnail = decode(imageBytes, length, 0);
+					else
+						thumbnail = copyPixels(imageBytes, length);
+				} finally {
+					releaseBuffer(imageBytes);
+				}
+
+				synchronized (CoverReader.this) {
+					if (thumbnailHashes.containsKey(hash))
+						thumbnails.put(hash, thumbnail);
+				}
+
+				target.setCover(thumbnail);
+			}
+		});
+	}
+
+	/**
+	 * @param hash
+	 *            hash of the cover of a playlist row
+	 * @return thumbnail, null if it hasn't been received
+	 */
+	synchronized Bitmap getThumbnail(String hash) {
+		return thumbnails.get(hash);
+	}
+
+	/**
+	 * outdates the covers that are waiting to be decoded, a new connection
+	 * sends its own
 	 */
 	void resetCoverList() {
-		coverList.clear();
+		synchronized (requests) {
+			requests.clear();
+		}
 	}
 }
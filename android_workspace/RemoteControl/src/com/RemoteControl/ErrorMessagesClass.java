@@ -68,6 +68,14 @@ public class ErrorMessagesClass {
 		}
 	};
 
+	final static Runnable tls_error = new Runnable() {
+		public void run() {
+			ToastClass.toast_error
+					.setText("secure connection failed, the server has no certificate or another one");
+			ToastClass.toast_error.show();
+		}
+	};
+
 	final static Runnable output_stream_state = new Runnable() {
 		public void run() {
 			ToastClass.toast_error
@@ -106,6 +114,14 @@ public class ErrorMessagesClass {
 		}
 	};
 
+	final static Runnable audio_error = new Runnable() {
+		public void run() {
+			ToastClass.toast_error
+					.setText("the server can't stream this entry");
+			ToastClass.toast_error.show();
+		}
+	};
+
 	final static Runnable unsupportedEncodingError = new Runnable() {
 		public void run() {
 			ToastClass.toast_error.setText("encoding unicode string failed");
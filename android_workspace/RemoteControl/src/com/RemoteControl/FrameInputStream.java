@@ -0,0 +1,193 @@
+package com.RemoteControl;
+
+import java.io.ByteArrayOutputStream;
+import java.io.DataInputStream;
+import java.io.IOException;
+import java.io.InputStream;
+import java.util.HashMap;
+import java.util.zip.DataFormatException;
+import java.util.zip.Inflater;
+
+/**
+ * Reads the framed protocol of the server and presents it as the text
+ * protocol: every text frame becomes a line, a text frame announcing a stream
+ * (coverLength_) is held back until all data frames of the stream have
+ * arrived and is then followed by the data. Messages sent while a cover is
+ * transferred therefore arrive before the cover. A deflate frame (protocol_3)
+ * inflates to several lines at once. An abort frame ends a stream the server
+ * has dropped because a newer cover supersedes it, the announcing line and
+ * the data received so far are discarded.
+ */
+public class FrameInputStream extends InputStream {
+
+	static final int FRAME_TEXT = 1;
+	static final int FRAME_DATA = 2;
+	static final int FRAME_DATA_END = 3;
+	static final int FRAME_DEFLATE = 4;
+	static final int FRAME_DATA_ABORT = 5;
+
+	// preset dictionary of the deflate frames, the same bytes as on the
+	// server
+	private static final String DEFLATE_DICTIONARY = "Remastered Version" + "Live Version" + "Radio Edit" + "Extended Mix"
+			+ "Original Mix" + "Remix" + "Acoustic" + "Soundtrack" + "Classical"
+			+ "Electronic" + "Hip-Hop" + "Alternative" + "Country" + "Metal"
+			+ "Jazz" + "Blues" + "Pop" + "Rock" + "Dance" + "Other"
+			+ "Unknown Artist" + "Various Artists" + "Unknown" + "Album" + "Disc 1"
+			+ "Part " + "Love" + "You" + "Your" + "Night" + "Life" + "World"
+			+ "Don't" + "Live" + "Intro" + "Time" + "feat. " + "(feat. " + " & "
+			+ " and " + " of " + " in " + " the " + "The " + " - " + ".flac"
+			+ ".ogg" + ".m4a" + ".mp3" + "track_comment_" + "track_genre_"
+			+ "track_length_" + "track_bitrate_" + "track_samplerate_"
+			+ "track_track_" + "track_year_" + "track_album_" + "track_artist_"
+			+ "track_title_" + "queueMove_" + "queueRemove_" + "queueInsert_"
+			+ "queueRefresh_" + "playlist_move_" + "playlist_delete_"
+			+ "playlist_insert_" + "playlist_range_" + "isplaying_"
+			+ "playlistPosition_" + "samplerate_" + "bitrate_" + "length_"
+			+ "title_";
+
+	private static byte[] dictionary = null;
+
+	private static class PendingStream {
+		byte[] text;
+		ByteArrayOutputStream data = new ByteArrayOutputStream();
+	}
+
+	private final DataInputStream in;
+
+	private final HashMap<Integer, PendingStream> streams = new HashMap<Integer, PendingStream>();
+
+	// decoded data not yet read
+	private byte[] current = new byte[0];
+	private int position = 0;
+
+	public FrameInputStream(InputStream in) {
+		this.in = new DataInputStream(in);
+	}
+
+	@Override
+	public int read() throws IOException {
+		while (position >= current.length)
+			nextFrame();
+
+		return current[position++] & 0xFF;
+	}
+
+	@Override
+	public int read(byte[] buffer, int offset, int length) throws IOException {
+		if (length == 0)
+			return 0;
+
+		while (position >= current.length)
+			nextFrame();
+
+		int count = Math.min(length, current.length - position);
+
+		System.arraycopy(current, position, buffer, offset, count);
+		position += count;
+
+		return count;
+	}
+
+	@Override
+	public void close() throws IOException {
+		in.close();
+	}
+
+	/**
+	 * Reads the next frame: type (1 byte), stream id (2 bytes), payload
+	 * length (4 bytes), payload.
+	 * 
+	 * @throws IOException
+	 *             Error reading from stream
+	 */
+	private void nextFrame() throws IOException {
+		int type = in.readUnsignedByte();
+		int stream = in.readUnsignedShort();
+		int length = in.readInt();
+
+		byte[] payload = new byte[length];
+		in.readFully(payload);
+
+		current = new byte[0];
+		position = 0;
+
+		if (type == FRAME_TEXT) {
+			if (stream == 0)
+				current = line(payload, null);
+			else {
+				PendingStream pending = new PendingStream();
+				pending.text = payload;
+
+				streams.put(stream, pending);
+			}
+		} else if (type == FRAME_DEFLATE)
+			current = inflate(payload);
+		else if (type == FRAME_DATA || type == FRAME_DATA_END) {
+			PendingStream pending = streams.get(stream);
+
+			if (pending == null) // not announced
+				return;
+
+			pending.data.write(payload);
+
+			if (type == FRAME_DATA_END) {
+				streams.remove(stream);
+
+				current = line(pending.text, pending.data.toByteArray());
+			}
+		} else if (type == FRAME_DATA_ABORT)
+			streams.remove(stream);
+		// unknown frame types are skipped
+	}
+
+	/**
+	 * Inflates a deflate frame, a zlib stream with the preset dictionary.
+	 * 
+	 * @throws IOException
+	 *             the frame is damaged
+	 */
+	private static byte[] inflate(byte[] payload) throws IOException {
+		if (dictionary == null)
+			dictionary = DEFLATE_DICTIONARY.getBytes("US-ASCII");
+
+		Inflater inflater = new Inflater();
+		inflater.setInput(payload);
+
+		ByteArrayOutputStream text = new ByteArrayOutputStream(
+				payload.length * 4);
+		byte[] buffer = new byte[8192];
+
+		try {
+			while (!inflater.finished()) {
+				int count = inflater.inflate(buffer);
+
+				if (count > 0)
+					text.write(buffer, 0, count);
+				else if (inflater.needsDictionary())
+					inflater.setDictionary(dictionary);
+				else if (inflater.needsInput())
+					throw new IOException("truncated deflate frame");
+			}
+		} catch (DataFormatException e) {
+			throw new IOException("damaged deflate frame");
+		} finally {
+			inflater.end();
+		}
+
+		return text.toByteArray();
+	}
+
+	private static byte[] line(byte[] text, byte[] data) {
+		int dataLength = data == null ? 0 : data.length;
+
+		byte[] result = new byte[text.length + 1 + dataLength];
+
+		System.arraycopy(text, 0, result, 0, text.length);
+		result[text.length] = 0x0A;
+
+		if (data != null)
+			System.arraycopy(data, 0, result, text.length + 1, dataLength);
+
+		return result;
+	}
+}
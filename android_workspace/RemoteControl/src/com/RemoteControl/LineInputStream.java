@@ -0,0 +1,205 @@
+package com.RemoteControl;
+
+import java.io.IOException;
+import java.io.InputStream;
+
+/**
+ * Buffers the stream of the server for UTF8Reader.readLine. Lines are found
+ * and decoded in place in one reusable buffer, the socket is read in large
+ * blocks. Bytes that follow a line (cover data, audio blocks) are read from
+ * the same buffer first, so readers of binary data can use this stream like
+ * the socket stream.
+ */
+public class LineInputStream extends InputStream {
+
+	static final int BUFFER_SIZE = 65536;
+
+	private final InputStream in;
+
+	// buffered bytes are buffer[position] to buffer[limit - 1]
+	private byte[] buffer = new byte[BUFFER_SIZE];
+	private int position = 0;
+	private int limit = 0;
+
+	// start of the last line, for unreadLine
+	private int lineStart = -1;
+
+	// characters of the line that is decoded
+	private char[] chars = new char[1024];
+
+	public LineInputStream(InputStream in) {
+		this.in = in;
+	}
+
+	/**
+	 * Reads UTF-8 character data; lines are terminated with '\n'.
+	 * 
+	 * @return String without the '\n'
+	 * @throws IOException
+	 *             Error reading from stream
+	 */
+	public synchronized String readLine() throws IOException {
+		int scanned = position;
+
+		while (true) {
+			for (int i = scanned; i < limit; i++) {
+				if (buffer[i] == 0x0A) {
+					String line = decode(position, i);
+
+					lineStart = position;
+					position = i + 1;
+
+					return line;
+				}
+			}
+
+			scanned = limit - position;
+
+			if (fill() < 0)
+				throw new IOException("Data truncated");
+
+			scanned += position;
+		}
+	}
+
+	/**
+	 * Makes the last line of readLine the next one again. Only valid before
+	 * the next read.
+	 */
+	public synchronized void unreadLine() {
+		if (lineStart >= 0)
+			position = lineStart;
+
+		lineStart = -1;
+	}
+
+	@Override
+	public synchronized int read() throws IOException {
+		lineStart = -1;
+
+		if (position >= limit && fill() < 0)
+			return -1;
+
+		return buffer[position++] & 0xFF;
+	}
+
+	@Override
+	public synchronized int read(byte[] data, int offset, int length)
+			throws IOException {
+		lineStart = -1;
+
+		if (length == 0)
+			return 0;
+
+		// large blocks bypass the buffer once it is empty
+		if (position >= limit) {
+			if (length >= buffer.length)
+				return in.read(data, offset, length);
+
+			if (fill() < 0)
+				return -1;
+		}
+
+		int count = Math.min(length, limit - position);
+
+		System.arraycopy(buffer, position, data, offset, count);
+		position += count;
+
+		return count;
+	}
+
+	@Override
+	public synchronized int available() throws IOException {
+		return limit - position + in.available();
+	}
+
+	@Override
+	public void close() throws IOException {
+		in.close();
+	}
+
+	/**
+	 * Reads more bytes behind the buffered ones. The buffered bytes are moved
+	 * to the front first, the buffer only grows for a line longer than it.
+	 * 
+	 * @return number of bytes read, -1 at the end of the stream
+	 * @throws IOException
+	 *             Error reading from stream
+	 */
+	private int fill() throws IOException {
+		lineStart = -1;
+
+		if (position > 0) {
+			System.arraycopy(buffer, position, buffer, 0, limit - position);
+			limit -= position;
+			position = 0;
+		}
+
+		if (limit == buffer.length) {
+			byte[] larger = new byte[buffer.length * 2];
+			System.arraycopy(buffer, 0, larger, 0, limit);
+			buffer = larger;
+		}
+
+		int count = in.read(buffer, limit, buffer.length - limit);
+
+		if (count > 0)
+			limit += count;
+
+		return count;
+	}
+
+	/**
+	 * Decodes the UTF-8 bytes buffer[start] to buffer[end - 1]. Malformed
+	 * sequences become U+FFFD.
+	 */
+	private String decode(int start, int end) {
+		if (chars.length < end - start)
+			chars = new char[end - start];
+
+		int count = 0;
+		int i = start;
+
+		while (i < end) {
+			int b = buffer[i++];
+
+			if (b >= 0) {
+				chars[count++] = (char) b;
+				continue;
+			}
+
+			int following;
+			int c;
+
+			if ((b & 0xE0) == 0xC0) {
+				following = 1;
+				c = b & 0x1F;
+			} else if ((b & 0xF0) == 0xE0) {
+				following = 2;
+				c = b & 0x0F;
+			} else if ((b & 0xF8) == 0xF0) {
+				following = 3;
+				c = b & 0x07;
+			} else {
+				chars[count++] = '\uFFFD';
+				continue;
+			}
+
+			int j = 0;
+
+			for (; j < following && i < end && (buffer[i] & 0xC0) == 0x80; j++)
+				c = (c << 6) | (buffer[i++] & 0x3F);
+
+			if (j < following)
+				chars[count++] = '\uFFFD';
+			else if (c >= 0x10000) {
+				c -= 0x10000;
+				chars[count++] = (char) (0xD800 | (c >> 10));
+				chars[count++] = (char) (0xDC00 | (c & 0x3FF));
+			} else
+				chars[count++] = (char) c;
+		}
+
+		return new String(chars, 0, count);
+	}
+}
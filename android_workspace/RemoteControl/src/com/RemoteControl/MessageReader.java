@@ -0,0 +1,193 @@
+package com.RemoteControl;
+
+import java.io.IOException;
+import java.io.InputStream;
+import java.util.concurrent.ArrayBlockingQueue;
+import java.util.concurrent.BlockingQueue;
+
+import android.os.SystemClock;
+
+/**
+ * first stage of the receive path: reads the messages of the server together
+ * with the lines and bytes that follow them as fast as they arrive and queues
+ * them for ReceiveClass, which updates the state and hands the covers to the
+ * decode thread of CoverReader. a slow handler doesn't stop the socket from
+ * being drained until the queue is full
+ */
+public class MessageReader implements Runnable {
+
+	// messages read but not yet handled. the reader waits once ReceiveClass
+	// falls this far behind
+	static final int QUEUE_SIZE = 256;
+
+	// type of the message after the last one, its line is null
+	static final int END = -2;
+
+	// a message of the server with what follows it
+	static final class Message {
+		// type of ReceiveClass, END after the last message
+		int type = END;
+
+		// the message itself
+		String line;
+
+		// lines that follow, null if there are none or their number couldn't
+		// be parsed
+		String[] lines;
+
+		// bytes that follow in a buffer of CoverReader.readBytes, null if
+		// there are none
+		byte[] data;
+		int length;
+
+		// uptime in milliseconds when the message was read
+		long received;
+	}
+
+	final BlockingQueue<Message> queue = new ArrayBlockingQueue<Message>(
+			QUEUE_SIZE);
+
+	private final MessageTrie types;
+
+	// the stream of the connection the reader was started for, a resumed
+	// connection gets its own reader
+	private final InputStream in;
+
+	private final int[] pair = new int[2];
+
+	// first, count, total and pending of a groups_ answer
+	private final int[] header = new int[4];
+
+	// id, sequence, rate, channels and frames of an audioBlock_
+	private final int[] block = new int[5];
+
+	/**
+	 * @param types
+	 *            message types of ReceiveClass
+	 */
+	MessageReader(MessageTrie types) {
+		this.types = types;
+
+		in = main.getInputStream();
+	}
+
+	public void run() {
+		try {
+			try {
+				while (!Thread.currentThread().isInterrupted()) {
+					String line = UTF8Reader.readLine(in);
+
+					if (line == null)
+						break;
+
+					queue.put(read(line));
+				}
+			} catch (IOException e) {
+				// connection closed
+			}
+
+			queue.put(new Message());
+		} catch (InterruptedException e) {
+			// ReceiveClass has stopped
+		}
+	}
+
+	/**
+	 * reads what follows a message. a number that can't be parsed is reported
+	 * by ReceiveClass, which parses the message again
+	 * 
+	 * @param line
+	 *            message
+	 * @return message with its lines or bytes
+	 * @throws IOException
+	 */
+	private Message read(String line) throws IOException {
+		Message message = new Message();
+		message.type = types.match(line);
+		message.line = line;
+		message.received = SystemClock.uptimeMillis();
+
+		try {
+			switch (message.type) {
+			case ReceiveClass.PLAYLIST_RANGE:
+			case ReceiveClass.COVERS:
+			case ReceiveClass.QUEUE_INSERT:
+				// <type><start>_<count>, then count lines
+				MessageTrie.parsePair(line, types.length(message.type), pair);
+				message.lines = readLines(pair[1]);
+				break;
+			case ReceiveClass.GROUPS:
+				// groups_<mode>_<first>_<count>_<total>_<pending>, then the
+				// lines of count groups
+				PlaylistGroups.parseHeader(line, types.length(message.type),
+						header);
+				message.lines = readLines(header[1]
+						* PlaylistGroups.GROUP_LINES);
+				break;
+			case ReceiveClass.QUEUE_REFRESH:
+				// <type><count>, then count lines
+				message.lines = readLines(MessageTrie.parseInt(line,
+						types.length(message.type)));
+				break;
+			case ReceiveClass.THUMB:
+				// thumb_<hash>_<length>, then the thumbnail
+				readData(message, Integer.parseInt(line.substring(line
+						.lastIndexOf('_') + 1)));
+				break;
+			case ReceiveClass.AUDIO_BLOCK:
+				// audioBlock_<id>_<sequence>_<rate>_<channels>_<frames>,
+				// then the block. its length follows from the format
+				MessageTrie.parseNumbers(line, types.length(message.type),
+						block);
+				readBlock(message,
+						AudioPlayer.blockLength(block[3], block[4]));
+				break;
+			case ReceiveClass.COVER_LENGTH:
+			case ReceiveClass.TRACK_COVER_LENGTH:
+				// <type><length>, then the cover
+				readData(message, MessageTrie.parseInt(line,
+						types.length(message.type)));
+				break;
+			}
+		} catch (NumberFormatException e) {
+		}
+
+		return message;
+	}
+
+	private String[] readLines(int count) throws IOException {
+		String[] lines = new String[Math.max(count, 0)];
+
+		for (int i = 0; i < lines.length; i++)
+			lines[i] = UTF8Reader.readLine(in);
+
+		return lines;
+	}
+
+	private void readData(Message message, int length) throws IOException {
+		if (length > 0)
+			message.data = main.getCoverReader().readBytes(in, length);
+
+		message.length = length;
+	}
+
+	/**
+	 * reads an audio block into a buffer of its own, the blocks wait for the
+	 * thread of AudioPlayer and would drain the pool of CoverReader
+	 */
+	private void readBlock(Message message, int length) throws IOException {
+		byte[] data = new byte[Math.max(length, 0)];
+
+		for (int read = 0; read < data.length;) {
+			int count = in.read(data, read, data.length - read);
+
+			if (count < 0)
+				throw new IOException("connection closed");
+
+			read += count;
+		}
+
+		message.data = data;
+		message.length = data.length;
+	}
+}
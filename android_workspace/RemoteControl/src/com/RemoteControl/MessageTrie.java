@@ -0,0 +1,200 @@
+package com.RemoteControl;
+
+/**
+ * Finds the type of a message of the text protocol by its prefix. The
+ * prefixes are stored in a trie, so a message is matched in the time of its
+ * prefix length however many types there are. The arguments of a message
+ * are parsed in place with parseInt.
+ */
+public class MessageTrie {
+
+	static final int UNKNOWN = -1;
+
+	private static class Node {
+		// children by character, first is the lowest character
+		Node[] children = null;
+		char first = 0;
+
+		// type of the prefix ending here
+		int type = UNKNOWN;
+
+		Node child(char c) {
+			int index = c - first;
+
+			if (children == null || index < 0 || index >= children.length)
+				return null;
+
+			return children[index];
+		}
+
+		Node addChild(char c) {
+			if (children == null) {
+				children = new Node[1];
+				first = c;
+			} else if (c < first || c - first >= children.length) {
+				int low = Math.min(first, c);
+				int high = Math.max(first + children.length - 1, c);
+
+				Node[] larger = new Node[high - low + 1];
+				System.arraycopy(children, 0, larger, first - low,
+						children.length);
+
+				children = larger;
+				first = (char) low;
+			}
+
+			if (children[c - first] == null)
+				children[c - first] = new Node();
+
+			return children[c - first];
+		}
+	}
+
+	private final Node root = new Node();
+
+	// prefix length by type
+	private int[] lengths = new int[0];
+
+	/**
+	 * Adds a message type.
+	 * 
+	 * @param prefix
+	 *            start of the messages of the type
+	 * @param type
+	 *            type, 0 or more
+	 */
+	public void add(String prefix, int type) {
+		Node node = root;
+
+		for (int i = 0; i < prefix.length(); i++)
+			node = node.addChild(prefix.charAt(i));
+
+		node.type = type;
+
+		if (type >= lengths.length) {
+			int[] larger = new int[type + 1];
+			System.arraycopy(lengths, 0, larger, 0, lengths.length);
+			lengths = larger;
+		}
+
+		lengths[type] = prefix.length();
+	}
+
+	/**
+	 * @param message
+	 *            message of the server
+	 * @return type of the longest prefix the message starts with, UNKNOWN if
+	 *         none
+	 */
+	public int match(String message) {
+		Node node = root;
+		int type = UNKNOWN;
+
+		for (int i = 0; i < message.length() && node != null; i++) {
+			node = node.child(message.charAt(i));
+
+			if (node != null && node.type != UNKNOWN)
+				type = node.type;
+		}
+
+		return type;
+	}
+
+	/**
+	 * @param type
+	 *            type of match
+	 * @return start of the arguments of the messages of the type
+	 */
+	public int length(int type) {
+		return lengths[type];
+	}
+
+	/**
+	 * Parses a decimal number without creating a substring.
+	 * 
+	 * @param s
+	 *            message
+	 * @param start
+	 *            index of the first character
+	 * @param end
+	 *            index behind the last character
+	 * @return number
+	 * @throws NumberFormatException
+	 *             no number between start and end
+	 */
+	public static int parseInt(String s, int start, int end) {
+		boolean negative = start < end && s.charAt(start) == '-';
+		int i = negative ? start + 1 : start;
+
+		if (i >= end)
+			throw new NumberFormatException(s);
+
+		int value = 0;
+
+		for (; i < end; i++) {
+			int digit = s.charAt(i) - '0';
+
+			if (digit < 0 || digit > 9)
+				throw new NumberFormatException(s);
+
+			value = value * 10 + digit;
+		}
+
+		return negative ? -value : value;
+	}
+
+	/**
+	 * Parses the decimal number from start to the end of the message.
+	 */
+	public static int parseInt(String s, int start) {
+		return parseInt(s, start, s.length());
+	}
+
+	/**
+	 * Parses the two numbers of a message argument like 12_3.
+	 * 
+	 * @param s
+	 *            message
+	 * @param start
+	 *            index of the first number
+	 * @param values
+	 *            receives the numbers
+	 * @throws NumberFormatException
+	 *             the argument isn't two numbers
+	 */
+	public static void parsePair(String s, int start, int[] values) {
+		int separator = s.indexOf('_', start);
+
+		if (separator < 0)
+			throw new NumberFormatException(s);
+
+		values[0] = parseInt(s, start, separator);
+		values[1] = parseInt(s, separator + 1);
+	}
+
+	/**
+	 * Parses the numbers of a message argument like 1_7_22050_2_2205, one
+	 * per element of values.
+	 * 
+	 * @param s
+	 *            message
+	 * @param start
+	 *            index of the first number
+	 * @param values
+	 *            receives the numbers
+	 * @throws NumberFormatException
+	 *             the argument isn't values.length numbers
+	 */
+	public static void parseNumbers(String s, int start, int[] values) {
+		for (int i = 0; i < values.length; i++) {
+			int end = i + 1 < values.length ? s.indexOf('_', start) : s
+					.length();
+
+			if (end < 0)
+				throw new NumberFormatException(s);
+
+			values[i] = parseInt(s, start, end);
+			start = end + 1;
+		}
+	}
+}
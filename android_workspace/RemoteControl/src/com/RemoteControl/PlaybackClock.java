@@ -0,0 +1,121 @@
+package com.RemoteControl;
+
+import android.os.SystemClock;
+
+/**
+ * Playback position advanced on the phone from the last clock_ message of
+ * the server. The server sends its tick count with the position, the
+ * smallest difference between the receive time and that tick count seen on
+ * a connection is the best guess of the offset between both clocks, so the
+ * time the message has been under way doesn't shift the position.
+ * 
+ * The tick counts are compared with int arithmetic, they wrap around like
+ * the tick count of the server.
+ * 
+ * While it plays the server sends a tick_ when the position has drifted from
+ * the clock, the drift is added to the advanced position until the next
+ * clock_.
+ */
+public class PlaybackClock {
+
+	private boolean known = false;
+	private boolean offsetKnown = false;
+
+	// phone time minus server time, milliseconds
+	private int offset;
+
+	// position in milliseconds at the server tick count, rate in thousandths
+	private int position;
+	private int rate;
+	private int tick;
+
+	// milliseconds the position has drifted from the clock, and the elapsed
+	// milliseconds of the tick_ that has sent it
+	private int drift;
+	private int driftElapsed;
+
+	/**
+	 * Forgets the clock and the offset, the next connection may go to
+	 * another server.
+	 */
+	public synchronized void reset() {
+		known = false;
+		offsetKnown = false;
+	}
+
+	/**
+	 * Takes a clock_ message.
+	 * 
+	 * @param position
+	 *            position in milliseconds at tick
+	 * @param rate
+	 *            1000 while playing, 0 otherwise
+	 * @param tick
+	 *            tick count of the server in milliseconds
+	 */
+	public synchronized void set(int position, int rate, int tick) {
+		int sample = (int) SystemClock.elapsedRealtime() - tick;
+
+		if (!offsetKnown || sample - offset < 0) {
+			offset = sample;
+			offsetKnown = true;
+		}
+
+		this.position = position;
+		this.rate = rate;
+		this.tick = tick;
+
+		drift = 0;
+		driftElapsed = Integer.MIN_VALUE;
+
+		known = true;
+	}
+
+	/**
+	 * Takes a tick_ message. The drift is relative to the clock, a later tick
+	 * replaces the one before.
+	 * 
+	 * @param drift
+	 *            milliseconds the position was ahead of the clock
+	 * @param elapsed
+	 *            milliseconds after the tick count of the clock the drift
+	 *            was measured
+	 * @param tickBase
+	 *            tick count of the clock the drift is relative to
+	 * @return false if it belongs to another clock or is older than the tick
+	 *         taken last, a datagram may arrive late
+	 */
+	public synchronized boolean tick(int drift, int elapsed, int tickBase) {
+		if (!known || rate == 0 || tickBase != tick || elapsed < driftElapsed)
+			return false;
+
+		this.drift = drift;
+		driftElapsed = elapsed;
+
+		return true;
+	}
+
+	/**
+	 * @return true after a clock_ message on this connection, older servers
+	 *         don't send any
+	 */
+	public synchronized boolean isKnown() {
+		return known;
+	}
+
+	/**
+	 * @return true if the position advances
+	 */
+	public synchronized boolean isRunning() {
+		return known && rate != 0;
+	}
+
+	/**
+	 * @return position in milliseconds now
+	 */
+	public synchronized long getPosition() {
+		int elapsed = (int) SystemClock.elapsedRealtime() - (tick + offset);
+
+		return position + drift + Math.max(elapsed, 0) * (long) rate / 1000;
+	}
+}
@@ -15,6 +15,8 @@ public class PlaybackSettings {
 	private int current_seconds;
 	private int current_minutes;
 
+	private final PlaybackClock clock = new PlaybackClock();
+
 	public synchronized void setCurrent_seconds(int current_seconds) {
 		this.current_seconds = current_seconds;
 	}
@@ -119,4 +121,8 @@ public class PlaybackSettings {
 		return isPlaying;
 	}
 
+	public PlaybackClock getClock() {
+		return clock;
+	}
+
 }
@@ -0,0 +1,316 @@
+package com.RemoteControl;
+
+import java.util.ArrayList;
+import java.util.BitSet;
+import java.util.HashMap;
+import java.util.Iterator;
+
+/**
+ * The playlist grouped by album, artist or album artist on the server. The
+ * groups are requested in pages of GROUP_PAGE with
+ * groups_<mode>_<start>_<count> when they scroll into view, like the titles
+ * of PlaylistPages. Pages far from the view are dropped, and every change of
+ * the playlist drops them all, because the server groups it again.
+ */
+public class PlaylistGroups {
+
+	// names of the modes in groups_, by the position of the grouping spinner
+	// minus one
+	static final String[] MODES = { "album", "artist", "albumartist" };
+
+	// groups requested with one groups_ request, the server sends at most 200
+	static final int GROUP_PAGE = 50;
+
+	// lines of one group in a groups_ answer: group_<index>, name, album
+	// artist, entries, seconds, cover hash and the runs of the positions
+	static final int GROUP_LINES = 7;
+
+	// pages kept on each side of the shown ones
+	static final int KEEP_PAGES = 4;
+
+	/**
+	 * One group of a groups_ answer.
+	 */
+	static final class Group {
+		String name;
+
+		// album artist, empty except for albums
+		String artist;
+
+		int entries;
+		int seconds;
+
+		// hash of the cover of the first entry, empty if it has none
+		String hash;
+
+		// first and last playlist position of every run, ascending
+		int[] runs;
+
+		/**
+		 * @return first playlist position of the group, -1 if it has none
+		 */
+		int first() {
+			return runs.length > 0 ? runs[0] : -1;
+		}
+
+		/**
+		 * @param position
+		 *            playlist position
+		 * @return true if the entry at position belongs to the group
+		 */
+		boolean contains(int position) {
+			for (int i = 0; i + 1 < runs.length; i += 2) {
+				if (position >= runs[i] && position <= runs[i + 1])
+					return true;
+			}
+
+			return false;
+		}
+
+		/**
+		 * @return playlist positions of the group, ascending
+		 */
+		ArrayList<Integer> positions() {
+			ArrayList<Integer> positions = new ArrayList<Integer>(entries);
+
+			for (int i = 0; i + 1 < runs.length; i += 2) {
+				for (int position = runs[i]; position <= runs[i + 1]; position++)
+					positions.add(position);
+			}
+
+			return positions;
+		}
+	}
+
+	private final String mode;
+
+	// number of groups, -1 until the first answer
+	private int total = -1;
+
+	// entries the server hasn't grouped yet
+	private int pending = 0;
+
+	// groups by index
+	private final HashMap<Integer, Group> groups = new HashMap<Integer, Group>();
+
+	// pages that have been requested and not dropped since
+	private final BitSet requested = new BitSet();
+
+	/**
+	 * @param mode
+	 *            one of MODES
+	 */
+	public PlaylistGroups(String mode) {
+		this.mode = mode;
+	}
+
+	String mode() {
+		return mode;
+	}
+
+	/**
+	 * @return number of groups, 0 until the first answer
+	 */
+	synchronized int count() {
+		return Math.max(total, 0);
+	}
+
+	/**
+	 * @return entries of the playlist that aren't grouped yet
+	 */
+	synchronized int pending() {
+		return pending;
+	}
+
+	/**
+	 * @param index
+	 *            index of the group
+	 * @return group, null if it hasn't been received
+	 */
+	synchronized Group get(int index) {
+		return groups.get(index);
+	}
+
+	/**
+	 * stores a groups_ answer. groups of dropped pages are ignored
+	 * 
+	 * @param first
+	 *            index of the first group
+	 * @param page
+	 *            groups of the answer
+	 * @param total
+	 *            number of groups
+	 * @param pending
+	 *            entries that aren't grouped yet
+	 */
+	synchronized void received(int first, Group[] page, int total,
+			int pending) {
+		this.total = total;
+		this.pending = pending;
+
+		if (!requested.get(first / GROUP_PAGE))
+			return;
+
+		for (int i = 0; i < page.length; i++)
+			groups.put(first + i, page[i]);
+	}
+
+	/**
+	 * requests the page containing index unless it has already been
+	 * requested
+	 * 
+	 * @param index
+	 *            index of the group
+	 */
+	void request(int index) {
+		if (index >= 0)
+			requestPage(index / GROUP_PAGE);
+	}
+
+	/**
+	 * called when the shown rows change: requests their pages and drops the
+	 * pages far from them
+	 * 
+	 * @param first
+	 *            first shown group
+	 * @param count
+	 *            number of shown groups
+	 */
+	void show(int first, int count) {
+		int firstPage = first / GROUP_PAGE;
+		int lastPage = (first + Math.max(count, 1) - 1) / GROUP_PAGE;
+
+		synchronized (this) {
+			Iterator<Integer> it = groups.keySet().iterator();
+
+			while (it.hasNext()) {
+				int page = it.next() / GROUP_PAGE;
+
+				if (page < firstPage - KEEP_PAGES
+						|| page > lastPage + KEEP_PAGES) {
+					it.remove();
+					requested.clear(page);
+				}
+			}
+		}
+
+		for (int page = firstPage; page <= lastPage; page++)
+			requestPage(page);
+	}
+
+	/**
+	 * the playlist or the metadata of its entries has changed, every group
+	 * may have changed. the shown pages are requested again when they are
+	 * bound
+	 */
+	synchronized void invalidate() {
+		groups.clear();
+		requested.clear();
+	}
+
+	private void requestPage(int page) {
+		synchronized (this) {
+			// the first page is requested before the number is known
+			if (page < 0 || (page > 0 && page * GROUP_PAGE >= total)
+					|| requested.get(page))
+				return;
+
+			requested.set(page);
+		}
+
+		SendClass.queueOut.add("groups_" + mode + "_"
+				+ String.valueOf(page * GROUP_PAGE) + "_"
+				+ String.valueOf(GROUP_PAGE));
+	}
+
+	/**
+	 * parses the header of a groups_ answer,
+	 * groups_<mode>_<first>_<count>_<total>_<pending>
+	 * 
+	 * @param message
+	 *            header
+	 * @param start
+	 *            index of the mode
+	 * @param values
+	 *            receives first, count, total and pending
+	 * @return mode
+	 * @throws NumberFormatException
+	 *             the header is malformed
+	 */
+	static String parseHeader(String message, int start, int[] values) {
+		int end = message.indexOf('_', start);
+
+		if (end < 0)
+			throw new NumberFormatException(message);
+
+		String mode = message.substring(start, end);
+
+		for (int i = 0; i < values.length; i++) {
+			int next = i + 1 < values.length ? message.indexOf('_', end + 1)
+					: message.length();
+
+			if (next < 0)
+				throw new NumberFormatException(message);
+
+			values[i] = MessageTrie.parseInt(message, end + 1, next);
+			end = next;
+		}
+
+		return mode;
+	}
+
+	/**
+	 * @param lines
+	 *            lines of a groups_ answer
+	 * @param count
+	 *            number of groups in them
+	 * @return groups
+	 * @throws NumberFormatException
+	 *             a number or a run is malformed
+	 */
+	static Group[] parseGroups(String[] lines, int count) {
+		Group[] page = new Group[count];
+
+		for (int i = 0; i < count; i++) {
+			int line = i * GROUP_LINES;
+
+			Group group = new Group();
+			group.name = lines[line + 1];
+			group.artist = lines[line + 2];
+			group.entries = Integer.parseInt(lines[line + 3]);
+			group.seconds = Integer.parseInt(lines[line + 4]);
+			group.hash = lines[line + 5];
+			group.runs = parseRuns(lines[line + 6]);
+
+			page[i] = group;
+		}
+
+		return page;
+	}
+
+	/**
+	 * @param runs
+	 *            runs like 12-25,40
+	 * @return first and last position of every run
+	 * @throws NumberFormatException
+	 *             a run is malformed
+	 */
+	static int[] parseRuns(String runs) {
+		if (runs.length() == 0)
+			return new int[0];
+
+		String[] parts = runs.split(",");
+		int[] values = new int[parts.length * 2];
+
+		for (int i = 0; i < parts.length; i++) {
+			int dash = parts[i].indexOf('-');
+
+			values[i * 2] = Integer.parseInt(dash < 0 ? parts[i] : parts[i]
+					.substring(0, dash));
+			values[i * 2 + 1] = dash < 0 ? values[i * 2] : Integer
+					.parseInt(parts[i].substring(dash + 1));
+		}
+
+		return values;
+	}
+}
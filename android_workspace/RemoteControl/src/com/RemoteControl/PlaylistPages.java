@@ -0,0 +1,458 @@
+package com.RemoteControl;
+
+import java.io.UnsupportedEncodingException;
+import java.util.ArrayList;
+import java.util.BitSet;
+import java.util.HashMap;
+import java.util.Iterator;
+import java.util.Locale;
+
+import android.util.DisplayMetrics;
+
+/**
+ * Titles of the playlist in pages of Settings.PLAYLIST_RANGE entries. Only
+ * the pages around the shown rows are kept: a page is requested with
+ * playlist_range_ when it scrolls into view, the next pages in the scroll
+ * direction are prefetched and pages far from the view are dropped. The
+ * memory needed doesn't grow with the playlist length.
+ * 
+ * The pages of the last connection are kept with the fingerprint the server
+ * has sent last, playlistHash_. After a reconnect to an unchanged playlist
+ * their titles are shown without requesting them again.
+ */
+public class PlaylistPages {
+
+	/**
+	 * The titles of one page as UTF-8 in one array with the offset and length
+	 * of each row, a few objects per page instead of one String per title.
+	 * Strings are made when the rows are shown.
+	 */
+	static final class TitlePage {
+		// bytes of the titles, a title that is set again is appended
+		private byte[] data = new byte[Settings.PLAYLIST_RANGE * 32];
+		private int used = 0;
+
+		// offset in data by row, -1 until the title has been received
+		private final int[] offsets = new int[Settings.PLAYLIST_RANGE];
+		private final int[] lengths = new int[Settings.PLAYLIST_RANGE];
+
+		TitlePage() {
+			for (int i = 0; i < offsets.length; i++)
+				offsets[i] = -1;
+		}
+
+		/**
+		 * @param rows
+		 *            number of rows of the page in the playlist
+		 * @return true if the titles of all rows have been received
+		 */
+		boolean complete(int rows) {
+			for (int i = 0; i < rows; i++) {
+				if (offsets[i] < 0)
+					return false;
+			}
+
+			return true;
+		}
+
+		/**
+		 * @param row
+		 *            row of the page
+		 * @return title, null if it hasn't been received
+		 */
+		String get(int row) {
+			if (offsets[row] < 0)
+				return null;
+
+			try {
+				return new String(data, offsets[row], lengths[row], "UTF-8");
+			} catch (UnsupportedEncodingException e) {
+				return null;
+			}
+		}
+
+		/**
+		 * @param row
+		 *            row of the page
+		 * @param title
+		 *            title, null to forget it
+		 */
+		void set(int row, String title) {
+			if (title == null) {
+				offsets[row] = -1;
+				return;
+			}
+
+			byte[] bytes;
+
+			try {
+				bytes = title.getBytes("UTF-8");
+			} catch (UnsupportedEncodingException e) {
+				return;
+			}
+
+			if (used + bytes.length > data.length) {
+				byte[] larger = new byte[Math.max(data.length * 2, used
+						+ bytes.length)];
+
+				System.arraycopy(data, 0, larger, 0, used);
+				data = larger;
+			}
+
+			System.arraycopy(bytes, 0, data, used, bytes.length);
+
+			offsets[row] = used;
+			lengths[row] = bytes.length;
+			used += bytes.length;
+		}
+	}
+
+	// pages requested ahead of the scroll direction
+	static final int PREFETCH_PAGES = 1;
+
+	// pages kept on each side of the shown ones
+	static final int KEEP_PAGES = 4;
+
+	private int length;
+
+	// titles by page number
+	private final HashMap<Integer, TitlePage> pages = new HashMap<Integer, TitlePage>();
+
+	// cover hashes of covers_ by page number, null until received and empty
+	// for rows without a cover
+	private final HashMap<Integer, String[]> hashes = new HashMap<Integer, String[]>();
+
+	// pages that have been requested and not dropped since
+	private final BitSet requested = new BitSet();
+
+	// first shown row of the last show call, gives the scroll direction
+	private int lastFirst = 0;
+
+	// playlistHash_ the titles belong to, null after a change the server
+	// hasn't announced one for yet
+	private String fingerprint = null;
+
+	// the pages are from the last connection until the server confirms them
+	private boolean kept = false;
+
+	// pages of the last connection, see store
+	private static PlaylistPages stored = null;
+
+	public PlaylistPages(int length) {
+		this.length = length;
+	}
+
+	/**
+	 * keeps the pages of a connection that has ended for the next one
+	 * 
+	 * @param playlist
+	 *            pages, null if the connection ended before the
+	 *            synchronization, the stored ones stay
+	 */
+	static synchronized void store(PlaylistPages playlist) {
+		if (playlist != null)
+			stored = playlist;
+	}
+
+	/**
+	 * called when a connection has been synchronized. the stored pages are
+	 * used again if the server's playlist may be the same, the fingerprint
+	 * that follows the synchronization decides, see fingerprint
+	 * 
+	 * @param length
+	 *            length of the playlist
+	 * @return pages for the connection
+	 */
+	static synchronized PlaylistPages afterSync(int length) {
+		PlaylistPages playlist = stored;
+		stored = null;
+
+		if (playlist == null || !playlist.keep(length))
+			return new PlaylistPages(length);
+
+		return playlist;
+	}
+
+	/**
+	 * drops the pages whose answers had not arrived when the connection
+	 * ended, they would never be requested again
+	 * 
+	 * @param length
+	 *            length of the server's playlist
+	 * @return false if the pages can't belong to the server's playlist
+	 */
+	private synchronized boolean keep(int length) {
+		if (fingerprint == null || length != this.length)
+			return false;
+
+		Iterator<Integer> it = pages.keySet().iterator();
+
+		while (it.hasNext()) {
+			int page = it.next();
+			String[] pageHashes = hashes.get(page);
+			int rows = Math.min(Settings.PLAYLIST_RANGE, length - page
+					* Settings.PLAYLIST_RANGE);
+			boolean complete = pages.get(page).complete(rows);
+
+			for (int i = 0; complete && i < rows; i++)
+				complete = pageHashes != null && pageHashes[i] != null;
+
+			if (!complete) {
+				it.remove();
+				hashes.remove(page);
+				requested.clear(page);
+			}
+		}
+
+		kept = true;
+
+		return true;
+	}
+
+	/**
+	 * stores the fingerprint of the server's playlist
+	 * 
+	 * @param value
+	 *            playlistHash_ without the type
+	 * @return false if the pages are from the last connection and belong to
+	 *         another playlist, the caller replaces them
+	 */
+	synchronized boolean fingerprint(String value) {
+		if (kept && !value.equals(fingerprint))
+			return false;
+
+		fingerprint = value;
+		kept = false;
+
+		return true;
+	}
+
+	synchronized int length() {
+		return length;
+	}
+
+	/**
+	 * @param position
+	 *            playlist position
+	 * @return title, null if it hasn't been received
+	 */
+	synchronized String getTitle(int position) {
+		TitlePage page = pages.get(position / Settings.PLAYLIST_RANGE);
+
+		return page != null ? page.get(position % Settings.PLAYLIST_RANGE)
+				: null;
+	}
+
+	/**
+	 * stores a title of a playlist_range_ answer. titles of dropped pages
+	 * are ignored
+	 * 
+	 * @param position
+	 *            playlist position
+	 * @param title
+	 *            title
+	 */
+	synchronized void setTitle(int position, String title) {
+		if (position < 0 || position >= length)
+			return;
+
+		TitlePage page = pages.get(position / Settings.PLAYLIST_RANGE);
+
+		if (page != null)
+			page.set(position % Settings.PLAYLIST_RANGE, title);
+	}
+
+	/**
+	 * @param position
+	 *            playlist position
+	 * @return hash of the cover, null if it hasn't been received or the row
+	 *         has no cover
+	 */
+	synchronized String getHash(int position) {
+		String[] page = hashes.get(position / Settings.PLAYLIST_RANGE);
+		String hash = page != null ? page[position % Settings.PLAYLIST_RANGE]
+				: null;
+
+		return hash != null && hash.length() > 0 ? hash : null;
+	}
+
+	/**
+	 * stores a cover hash of a covers_ answer. hashes of dropped pages are
+	 * ignored
+	 * 
+	 * @param position
+	 *            playlist position
+	 * @param hash
+	 *            hash, empty for rows without a cover
+	 */
+	synchronized void setHash(int position, String hash) {
+		if (position < 0 || position >= length)
+			return;
+
+		String[] page = hashes.get(position / Settings.PLAYLIST_RANGE);
+
+		if (page != null)
+			page[position % Settings.PLAYLIST_RANGE] = hash;
+	}
+
+	/**
+	 * requests the page containing position unless it has already been
+	 * requested
+	 * 
+	 * @param position
+	 *            playlist position
+	 */
+	void request(int position) {
+		if (position < 0)
+			return;
+
+		requestPage(position / Settings.PLAYLIST_RANGE);
+	}
+
+	/**
+	 * called when the shown rows change: requests their pages and the next
+	 * ones in the scroll direction and drops the pages far from them
+	 * 
+	 * @param first
+	 *            first shown position
+	 * @param count
+	 *            number of shown positions
+	 */
+	void show(int first, int count) {
+		int firstPage = first / Settings.PLAYLIST_RANGE;
+		int lastPage = (first + Math.max(count, 1) - 1)
+				/ Settings.PLAYLIST_RANGE;
+
+		boolean up;
+
+		synchronized (this) {
+			up = first < lastFirst;
+			lastFirst = first;
+
+			// drop the far pages
+			Iterator<Integer> it = pages.keySet().iterator();
+
+			while (it.hasNext()) {
+				int page = it.next();
+
+				if (page < firstPage - KEEP_PAGES
+						|| page > lastPage + KEEP_PAGES) {
+					it.remove();
+					hashes.remove(page);
+					requested.clear(page);
+				}
+			}
+		}
+
+		for (int page = firstPage; page <= lastPage; page++)
+			requestPage(page);
+
+		for (int i = 1; i <= PREFETCH_PAGES; i++)
+			requestPage(up ? firstPage - i : lastPage + i);
+	}
+
+	private void requestPage(int page) {
+		synchronized (this) {
+			if (page < 0 || page * Settings.PLAYLIST_RANGE >= length
+					|| requested.get(page))
+				return;
+
+			requested.set(page);
+			pages.put(page, new TitlePage());
+			hashes.put(page, new String[Settings.PLAYLIST_RANGE]);
+		}
+
+		SendClass.queueOut.add("playlist_range_"
+				+ String.valueOf(page * Settings.PLAYLIST_RANGE) + "_"
+				+ String.valueOf(Settings.PLAYLIST_RANGE));
+
+		// thumbnails of the rows in pixels, the server sends each cover once
+		DisplayMetrics dm = Settings.dm;
+		int size = dm != null ? (int) (Settings.THUMBNAIL_DP * dm.density)
+				: Settings.THUMBNAIL_DP;
+
+		SendClass.queueOut.add("covers_"
+				+ String.valueOf(page * Settings.PLAYLIST_RANGE) + "_"
+				+ String.valueOf(Settings.PLAYLIST_RANGE) + "_"
+				+ String.valueOf(size) + "_"
+				+ String.valueOf(Settings.THUMBNAIL_FORMAT));
+	}
+
+	/**
+	 * entries have been inserted (count > 0) or deleted (count < 0) at start.
+	 * the titles behind start have moved, their pages are requested again
+	 * when they are shown
+	 * 
+	 * @param start
+	 *            first changed position
+	 * @param count
+	 *            number of inserted entries, negative for deleted ones
+	 */
+	synchronized void resize(int start, int count) {
+		length = Math.max(0, length + count);
+		fingerprint = null;
+
+		drop(start / Settings.PLAYLIST_RANGE, Integer.MAX_VALUE);
+	}
+
+	/**
+	 * an entry has moved, the titles between both positions have changed
+	 * 
+	 * @param from
+	 *            old position
+	 * @param to
+	 *            new position
+	 */
+	synchronized void move(int from, int to) {
+		fingerprint = null;
+
+		drop(Math.min(from, to) / Settings.PLAYLIST_RANGE, Math.max(from, to)
+				/ Settings.PLAYLIST_RANGE);
+	}
+
+	private void drop(int firstPage, int lastPage) {
+		Iterator<Integer> it = pages.keySet().iterator();
+
+		while (it.hasNext()) {
+			int page = it.next();
+
+			if (page >= firstPage && page <= lastPage) {
+				it.remove();
+				hashes.remove(page);
+			}
+		}
+
+		requested.clear(firstPage,
+				Math.max(firstPage, Math.min(lastPage + 1, requested.length())));
+	}
+
+	/**
+	 * @param text
+	 *            filter of the playlist view
+	 * @return positions of the received titles containing text, ascending
+	 */
+	synchronized int[] find(String text) {
+		String lower = text.toLowerCase(Locale.getDefault());
+		ArrayList<Integer> found = new ArrayList<Integer>();
+
+		for (int page = 0; page * Settings.PLAYLIST_RANGE < length; page++) {
+			TitlePage titles = pages.get(page);
+
+			for (int i = 0; titles != null && i < Settings.PLAYLIST_RANGE; i++) {
+				String title = titles.get(i);
+
+				if (title != null
+						&& title.toLowerCase(Locale.getDefault()).contains(
+								lower))
+					found.add(page * Settings.PLAYLIST_RANGE + i);
+			}
+		}
+
+		int[] positions = new int[found.size()];
+
+		for (int i = 0; i < positions.length; i++)
+			positions[i] = found.get(i);
+
+		return positions;
+	}
+}
@@ -18,6 +18,7 @@ public class PreferenceReader {
 		Settings.liststatus[3] = prefs.getBoolean("3", false);
 		Settings.liststatus[4] = prefs.getString("4", "Dim");
 		Settings.liststatus[5] = prefs.getBoolean("5", true);
+		Settings.liststatus[6] = prefs.getBoolean("6", false);
 
 		// register IncomingCallListener
 		if (Settings.liststatus[5].equals(true))
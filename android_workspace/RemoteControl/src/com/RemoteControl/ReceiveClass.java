@@ -1,40 +1,172 @@
 package com.RemoteControl;
 
-import java.io.IOException;
 import java.text.DecimalFormat;
 import java.util.LinkedList;
 import java.util.Timer;
 
-import android.graphics.Bitmap;
+import android.os.SystemClock;
 import com.RemoteControl.RemoteControlOverview.UpdateTimeTask;
 
 public class ReceiveClass implements Runnable {
 
+	// message types of the server
+	static final int ALIVE = 0;
+	static final int ISPLAYING = 1;
+	static final int PLAYLIST_RANGE = 2;
+	static final int PLAYLIST_DELETE = 3;
+	static final int PLAYLIST_INSERT = 4;
+	static final int PLAYLIST_MOVE = 5;
+	static final int PLAYLIST_POSITION = 6;
+	static final int SAMPLERATE = 7;
+	static final int BITRATE = 8;
+	static final int LENGTH = 9;
+	static final int TITLE = 10;
+	static final int STOP = 11;
+	static final int COVER_HASH = 12;
+	static final int COVER_CACHED = 13;
+	static final int COVER_LENGTH = 14;
+	static final int PAUSE = 15;
+	static final int SHUFFLE = 16;
+	static final int REPEAT = 17;
+	static final int VOLUME = 18;
+	static final int PROGRESS = 19;
+	static final int QUEUE_NEXT = 20;
+	static final int QUEUE_REFRESH = 21;
+	static final int QUEUE_INSERT = 22;
+	static final int QUEUE_REMOVE = 23;
+	static final int QUEUE_MOVE = 24;
+	static final int TRACK_TITLE = 25;
+	static final int TRACK_ARTIST = 26;
+	static final int TRACK_ALBUM = 27;
+	static final int TRACK_YEAR = 28;
+	static final int TRACK_TRACK = 29;
+	static final int TRACK_GENRE = 30;
+	static final int TRACK_SAMPLERATE = 31;
+	static final int TRACK_BITRATE = 32;
+	static final int TRACK_LENGTH = 33;
+	static final int TRACK_COMMENT = 34;
+	static final int TRACK_COVER_HASH = 35;
+	static final int TRACK_COVER_CACHED = 36;
+	static final int TRACK_COVER_LENGTH = 37;
+	static final int CLOCK = 38;
+	static final int JOURNAL = 39;
+	static final int SESSION = 40;
+	static final int COVERS = 41;
+	static final int THUMB = 42;
+	static final int LATENCY_PROBE = 43;
+	static final int GROUPS = 44;
+	static final int AUDIO_BLOCK = 45;
+	static final int AUDIO_END = 46;
+	static final int AUDIO_ERROR = 47;
+	static final int PLAYLIST_HASH = 48;
+	static final int TICK = 49;
+
+	static final MessageTrie types = new MessageTrie();
+
+	static {
+		types.add("alive", ALIVE);
+		types.add("isplaying_", ISPLAYING);
+		types.add("playlist_range_", PLAYLIST_RANGE);
+		types.add("playlist_delete_", PLAYLIST_DELETE);
+		types.add("playlist_insert_", PLAYLIST_INSERT);
+		types.add("playlist_move_", PLAYLIST_MOVE);
+		types.add("playlistPosition_", PLAYLIST_POSITION);
+		types.add("samplerate_", SAMPLERATE);
+		types.add("bitrate_", BITRATE);
+		types.add("length_", LENGTH);
+		types.add("title_", TITLE);
+		types.add("stop", STOP);
+		types.add("coverHash_", COVER_HASH);
+		types.add("coverCached_", COVER_CACHED);
+		types.add("coverLength_", COVER_LENGTH);
+		types.add("pause", PAUSE);
+		types.add("shuffle_", SHUFFLE);
+		types.add("repeat_", REPEAT);
+		types.add("volume_", VOLUME);
+		types.add("progress_", PROGRESS);
+		types.add("queue_next", QUEUE_NEXT);
+		types.add("queueRefresh_", QUEUE_REFRESH);
+		types.add("queueInsert_", QUEUE_INSERT);
+		types.add("queueRemove_", QUEUE_REMOVE);
+		types.add("queueMove_", QUEUE_MOVE);
+		types.add("track_title_", TRACK_TITLE);
+		types.add("track_artist_", TRACK_ARTIST);
+		types.add("track_album_", TRACK_ALBUM);
+		types.add("track_year_", TRACK_YEAR);
+		types.add("track_track_", TRACK_TRACK);
+		types.add("track_genre_", TRACK_GENRE);
+		types.add("track_samplerate_", TRACK_SAMPLERATE);
+		types.add("track_bitrate_", TRACK_BITRATE);
+		types.add("track_length_", TRACK_LENGTH);
+		types.add("track_comment_", TRACK_COMMENT);
+		types.add("track_coverHash_", TRACK_COVER_HASH);
+		types.add("track_coverCached_", TRACK_COVER_CACHED);
+		types.add("track_coverLength_", TRACK_COVER_LENGTH);
+		types.add("clock_", CLOCK);
+		types.add("journal_", JOURNAL);
+		types.add("session_", SESSION);
+		types.add("covers_", COVERS);
+		types.add("thumb_", THUMB);
+		types.add("latencyProbe_", LATENCY_PROBE);
+		types.add("groups_", GROUPS);
+		types.add("audioBlock_", AUDIO_BLOCK);
+		types.add("audioEnd_", AUDIO_END);
+		types.add("audioError_", AUDIO_ERROR);
+		types.add("playlistHash_", PLAYLIST_HASH);
+		types.add("tick_", TICK);
+	}
+
+	// arguments of the messages with two numbers
+	private final int[] pair = new int[2];
+
+	// first, count, total and pending of a groups_ answer
+	private final int[] header = new int[4];
+
+	// id, sequence, rate, channels and frames of an audioBlock_
+	private final int[] block = new int[5];
+
+	// hash announced for the next coverLength_ / track_coverLength_
+	private String coverHash = null;
+	private String trackCoverHash = null;
+
 	@Override
 	public void run() {
 		String message = "";
 		CharSequence tmp;
+		MessageReader.Message received;
+
+		main.getPlaybackSettings().getClock().reset();
 
-		while (message != null) {
+		// the socket is read by its own thread, see MessageReader
+		MessageReader reader = new MessageReader(types);
+		Thread readerThread = new Thread(reader);
+		readerThread.start();
+
+		receive: while (message != null) {
 
 			try {
-				message = UTF8Reader.readLine(main.getInputStream());
-			} catch (IOException e2) {
-				// connection closed
+				received = reader.queue.take();
+			} catch (InterruptedException e) {
 				break;
 			}
 
+			// null after the last message
+			message = received.line;
+
 			if (message != null) {
-				if (message.startsWith("alive") == true) {
+				switch (received.type) {
+				case ALIVE: {
 					// send keep alive packages back
 					SendClass.queueOut.add("alive");
-				} else if (message.startsWith("isplaying_") == true) {
+					break;
+				}
+				case ISPLAYING: {
 					try {
-						message = message.substring(10, message.length());
+						int isPlaying = MessageTrie.parseInt(message,
+								types.length(ISPLAYING));
 
-						if (!message.equals("3"))
-							main.getPlaybackSettings().setIsPlaying(
-									Integer.parseInt(message));
+						if (isPlaying != 3)
+							main.getPlaybackSettings().setIsPlaying(isPlaying);
 
 					} catch (Exception e) {
 						main.getErrorClassHandler().post(
@@ -43,52 +175,194 @@ public class ReceiveClass implements Runnable {
 
 					if (main.getPlaybackSettings().getIsPlaying() != 0)
 						main.getConnectionHandler().post(main.pause_runnable);
-				} else if (message.startsWith("playlistPosition_") == true) {
+					break;
+				}
+				case PLAYLIST_RANGE: {
+					// window of titles: playlist_range_<start>_<count>, then
+					// count titles
 					try {
-						message = message.substring(17, message.length());
+						MessageTrie.parsePair(message,
+								types.length(PLAYLIST_RANGE), pair);
+						int start = pair[0];
+						int count = pair[1];
 
-						Settings.playlistPosition = Integer.parseInt(message);
-					} catch (Exception e2) {
+						for (int i = 0; i < count; i++) {
+							message = received.lines[i];
+
+							PlaylistPages playlist = Settings.playlist;
+
+							if (playlist != null)
+								playlist.setTitle(start + i, message);
+						}
+					} catch (Exception e) {
 						main.getErrorClassHandler().post(
 								ErrorMessagesClass.conversion_error);
 					}
 
 					try {
-						RemoteControlPlaylist.refreshItems();
+						RemoteControlPlaylist.viewHandler
+								.post(RemoteControlPlaylist.updateTitles);
 					} catch (NullPointerException e1) {
 					} // playlist not yet loaded
+					break;
+				}
+				case COVERS: {
+					// cover hashes of a playlist window: covers_<start>_<count>,
+					// then count hashes, empty for rows without a cover
+					try {
+						MessageTrie.parsePair(message, types.length(COVERS),
+								pair);
+						int start = pair[0];
+						int count = pair[1];
+
+						for (int i = 0; i < count; i++) {
+							message = received.lines[i];
+
+							PlaylistPages playlist = Settings.playlist;
+
+							if (playlist != null)
+								playlist.setHash(start + i, message);
+
+							// the server touches the hashes in the same order
+							if (message.length() > 0)
+								main.getCoverReader().touchThumbnail(message);
+						}
+					} catch (Exception e) {
+						main.getErrorClassHandler().post(
+								ErrorMessagesClass.conversion_error);
+					}
+					break;
+				}
+				case GROUPS: {
+					// page of the grouped playlist: groups_<mode>_<first>_<count>_<total>_<pending>,
+					// then the lines of count groups. answers for another
+					// grouping than the shown one are dropped
+					try {
+						String mode = PlaylistGroups.parseHeader(message,
+								types.length(GROUPS), header);
+
+						if (received.lines == null)
+							throw new NumberFormatException(message);
+
+						PlaylistGroups groups = Settings.groups;
+
+						if (groups != null && groups.mode().equals(mode))
+							groups.received(header[0], PlaylistGroups
+									.parseGroups(received.lines, header[1]),
+									header[2], header[3]);
+					} catch (Exception e) {
+						main.getErrorClassHandler().post(
+								ErrorMessagesClass.conversion_error);
+					}
+
+					RemoteControlPlaylist.groupsReceived();
+					break;
+				}
+				case THUMB: {
+					// thumb_<hash>_<length>, then the thumbnail
+					int separator = message.lastIndexOf('_');
+
+					try {
+						if (received.data == null)
+							throw new NumberFormatException(message);
+
+						main.getCoverReader().readThumbnail(
+								message.substring(types.length(THUMB),
+										separator), received.data,
+								received.length,
+								RemoteControlPlaylist.thumbnailTarget);
+					} catch (Exception e) {
+						main.getErrorClassHandler().post(
+								ErrorMessagesClass.conversion_error);
+
+						break receive;
+					}
+
+					break;
+				}
+				case PLAYLIST_DELETE: {
+					try {
+						MessageTrie.parsePair(message, types.length(PLAYLIST_DELETE),
+								pair);
+
+						RemoteControlPlaylist.deleteEntries(pair[0], pair[1]);
+					} catch (Exception e) {
+						main.getErrorClassHandler().post(
+								ErrorMessagesClass.conversion_error);
+					}
+					break;
+				}
+				case PLAYLIST_INSERT: {
+					try {
+						MessageTrie.parsePair(message, types.length(PLAYLIST_INSERT),
+								pair);
+
+						RemoteControlPlaylist.insertEntries(pair[0], pair[1]);
+					} catch (Exception e) {
+						main.getErrorClassHandler().post(
+								ErrorMessagesClass.conversion_error);
+					}
+					break;
+				}
+				case PLAYLIST_MOVE: {
+					try {
+						MessageTrie.parsePair(message, types.length(PLAYLIST_MOVE),
+								pair);
 
-				} else if (message.startsWith("samplerate_") == true) {
+						RemoteControlPlaylist.moveEntry(pair[0], pair[1]);
+					} catch (Exception e) {
+						main.getErrorClassHandler().post(
+								ErrorMessagesClass.conversion_error);
+					}
+					break;
+				}
+				case PLAYLIST_POSITION: {
 					try {
-						message = message.substring(11, message.length());
+						Settings.playlistPosition = MessageTrie.parseInt(message,
+								types.length(PLAYLIST_POSITION));
+					} catch (Exception e2) {
+						main.getErrorClassHandler().post(
+								ErrorMessagesClass.conversion_error);
+					}
+
+					RemoteControlPlaylist.refreshPosition();
 
+					break;
+				}
+				case SAMPLERATE: {
+					try {
 						main.getPlaybackSettings().setSamplerate(
-								Integer.parseInt(message));
+								MessageTrie.parseInt(message,
+										types.length(SAMPLERATE)));
 					} catch (Exception e) {
 						main.getErrorClassHandler().post(
 								ErrorMessagesClass.conversion_error);
 					}
-				} else if (message.startsWith("bitrate_") == true) {
+					break;
+				}
+				case BITRATE: {
 					message = message.substring(8, message.length());
 
 					main.getPlaybackSettings()
 							.setBitrate(message.toCharArray());
-				} else if (message.startsWith("length_") == true) {
+					break;
+				}
+				case LENGTH: {
 					try {
-						message = message.substring(7, message.length());
+						int length = MessageTrie.parseInt(message,
+								types.length(LENGTH));
 
-						if (main.getPlaybackSettings().getLength() != Integer
-								.parseInt(message) && !message.equals("-1"))
-							main.getPlaybackSettings().setLength(
-									Integer.parseInt(message));
+						if (main.getPlaybackSettings().getLength() != length
+								&& length != -1)
+							main.getPlaybackSettings().setLength(length);
 
 					} catch (Exception e) {
 						main.getErrorClassHandler().post(
 								ErrorMessagesClass.conversion_error);
 					}
+					break;
 				}
-
-				else if (message.startsWith("title_") == true) {
+				case TITLE: {
 					String title_temp = new String();
 					title_temp = message.substring(6, message.length());
 
@@ -134,7 +408,9 @@ public class ReceiveClass implements Runnable {
 						main.getPlaybackSettings().setIsPlaying(1);
 					}
 
-				} else if (message.startsWith("stop") == true) {
+					break;
+				}
+				case STOP: {
 					try {
 						RemoteControlOverview.timertask.cancel();
 						RemoteControlOverview.timertask.cancel = true;
@@ -148,51 +424,98 @@ public class ReceiveClass implements Runnable {
 							.post(main.play_runnable);
 
 					main.getPlaybackSettings().setIsPlaying(0);
-				} else if (message.startsWith("coverLength_") == true) {
+					break;
+				}
+				case COVER_HASH: {
+					coverHash = message.substring(types.length(COVER_HASH));
+					break;
+				}
+				case COVER_CACHED: {
+					// cover already received once
+					main.getCoverReader().getCover(message.substring(12),
+							RemoteControlOverview.coverTarget);
+					break;
+				}
+				case COVER_LENGTH: {
 					// ///////////////////////////////// COVER
 					// ///////////////////////////////////////////////////
 
 					int coverLength = 0;
-					CharSequence tmp2;
 					// LENGTH
 					try {
-						tmp2 = message.subSequence(12, message.length());
-						coverLength = Integer.parseInt(tmp2.toString());
+						coverLength = MessageTrie.parseInt(message,
+								types.length(COVER_LENGTH));
 					} catch (Exception e) {
 						e.printStackTrace();
 
 						main.getErrorClassHandler().post(
 								ErrorMessagesClass.conversion_error);
 
-						break;
+						break receive;
 					}
 
 					// COVER
 
-					Bitmap cover = null;
+					// decoded on the decode thread, see CoverReader. a hash
+					// that can't name a file drops the cover
 
-					try {
-						cover = main.getCoverReader().readCover(coverLength,
-								false);
-					} catch (IOException e) {
-						e.printStackTrace();
+					if (coverHash == null
+							|| CoverReader.validHash(coverHash) != null)
+						main.getCoverReader().readCover(received.data,
+								coverLength, coverHash,
+								RemoteControlOverview.coverTarget);
 
-						main.getConnect_dialog().dismiss();
-						main.getErrorClassHandler().post(
-								ErrorMessagesClass.reader_error);
-					}
+					coverHash = null;
 
-					if (cover != null) {
-						RemoteControlOverview.cover = cover;
+					break;
+				}
+				case AUDIO_BLOCK: {
+					// audioBlock_<id>_<sequence>_<rate>_<channels>_<frames>,
+					// then the block of the stream that is listened to
+					try {
+						MessageTrie.parseNumbers(message,
+								types.length(AUDIO_BLOCK), block);
 
-						RemoteControlOverview.WinampSettingsHandler
-								.post(RemoteControlOverview.SetCover);
+						if (received.data == null)
+							throw new NumberFormatException(message);
 
-					} else
-						RemoteControlOverview.WinampSettingsHandler
-								.post(RemoteControlOverview.SetEmptyCover);
+						main.getAudioPlayer().add(block[0], block[2],
+								block[3], block[4], received.data);
+					} catch (Exception e) {
+						main.getErrorClassHandler().post(
+								ErrorMessagesClass.conversion_error);
+					}
+					break;
+				}
+				case AUDIO_END: {
+					// audioEnd_<id>, no entry follows the last one
+					try {
+						main.getAudioPlayer().end(
+								MessageTrie.parseInt(message,
+										types.length(AUDIO_END)));
+					} catch (Exception e) {
+						main.getErrorClassHandler().post(
+								ErrorMessagesClass.conversion_error);
+					}
+					break;
+				}
+				case AUDIO_ERROR: {
+					// audioError_<id>_<code>, the entry can't be decoded on
+					// the server
+					try {
+						MessageTrie.parsePair(message,
+								types.length(AUDIO_ERROR), pair);
 
-				} else if (message.startsWith("pause") == true) {
+						if (main.getAudioPlayer().error(pair[0]))
+							main.getErrorClassHandler().post(
+									ErrorMessagesClass.audio_error);
+					} catch (Exception e) {
+						main.getErrorClassHandler().post(
+								ErrorMessagesClass.conversion_error);
+					}
+					break;
+				}
+				case PAUSE: {
 					if (main.getPlaybackSettings().getIsPlaying() == 1) {
 						main.getPlaybackSettings().setCurrent_millis(
 								System.currentTimeMillis()
@@ -225,23 +548,29 @@ public class ReceiveClass implements Runnable {
 						main.getConnectionHandler().post(main.pause_runnable);
 					}
 
-				} else if (message.startsWith("shuffle_") == true) {
-					tmp = message.subSequence(8, 9);
-					main.getPlaybackSettings().setShuffle_status(tmp.charAt(0));
+					break;
+				}
+				case SHUFFLE: {
+					main.getPlaybackSettings().setShuffle_status(
+							message.charAt(types.length(SHUFFLE)));
 
 					RemoteControlOverview.WinampSettingsHandler
 							.post(RemoteControlOverview.UpdateShuffle);
-				} else if (message.startsWith("repeat_") == true) {
-					tmp = message.subSequence(7, 8);
-					main.getPlaybackSettings().setRepeat_status(tmp.charAt(0));
+					break;
+				}
+				case REPEAT: {
+					main.getPlaybackSettings().setRepeat_status(
+							message.charAt(types.length(REPEAT)));
 
 					RemoteControlOverview.WinampSettingsHandler
 							.post(RemoteControlOverview.UpdateRepeat);
-				} else if (message.startsWith("volume_") == true) {
+					break;
+				}
+				case VOLUME: {
 					try {
-						tmp = message.subSequence(7, message.length());
 						main.getPlaybackSettings().setVolume(
-								Integer.parseInt(tmp.toString()));
+								MessageTrie.parseInt(message,
+										types.length(VOLUME)));
 					} catch (Exception e) {
 						main.getErrorClassHandler().post(
 								ErrorMessagesClass.conversion_error);
@@ -249,11 +578,13 @@ public class ReceiveClass implements Runnable {
 
 					RemoteControlOverview.WinampSettingsHandler
 							.post(RemoteControlOverview.UpdateVolume);
-				} else if (message.startsWith("progress_") == true) {
+					break;
+				}
+				case PROGRESS: {
 					try {
-						tmp = message.subSequence(9, message.length());
 						main.getPlaybackSettings().setPlaybackProgress(
-								Integer.parseInt(tmp.toString()));
+								MessageTrie.parseInt(message,
+										types.length(PROGRESS)));
 					} catch (Exception e) {
 						main.getErrorClassHandler().post(
 								ErrorMessagesClass.conversion_error);
@@ -295,34 +626,31 @@ public class ReceiveClass implements Runnable {
 
 					RemoteControlOverview.WinampSettingsHandler
 							.post(RemoteControlOverview.UpdateProgress);
-				} else if (message.startsWith("queue_next") == true) {
+					break;
+				}
+				case QUEUE_NEXT: {
 					try {
 						Settings.Queue.remove(0);
 					} catch (Exception e) {
 					}
 
 					try {
-						RemoteControlPlaylist.refreshItems();
+						RemoteControlPlaylist.refreshQueue();
 					} catch (Exception e) {
 					}
-				} else if (message.startsWith("queueRefresh_") == true) // TODO
-				{
+					break;
+				}
+				case QUEUE_REFRESH: { // TODO
 					try {
-						tmp = message.subSequence(13, message.length());
-						int numberOfElements = Integer.parseInt((String) tmp);
+						int numberOfElements = MessageTrie.parseInt(message,
+								types.length(QUEUE_REFRESH));
 						int i = 0, itemIndex;
 
 						Settings.Queue = new LinkedList<Object>();
 
 						while (message != null & i < numberOfElements) {
 
-							try {
-								message = UTF8Reader.readLine(main
-										.getInputStream());
-							} catch (IOException e2) {
-								// connection closed
-								break;
-							}
+							message = received.lines[i];
 
 							if (message != null) {
 								itemIndex = Integer.parseInt(message) - 1;
@@ -337,62 +665,140 @@ public class ReceiveClass implements Runnable {
 						}
 
 						try {
-							RemoteControlPlaylist.refreshItems();
+							RemoteControlPlaylist.refreshQueue();
 						} catch (Exception e) {
 						}
 					} catch (Exception e) {
 						main.getErrorClassHandler().post(
 								ErrorMessagesClass.conversion_error);
 					}
-				} else if (message.startsWith("track_title_") == true) {
+					break;
+				}
+				case QUEUE_INSERT: {
+					// queueInsert_<start>_<count>, one line per title
+					try {
+						MessageTrie.parsePair(message, types.length(QUEUE_INSERT),
+								pair);
+						int start = pair[0];
+						int count = pair[1];
+
+						for (int i = 0; i < count; i++) {
+							message = received.lines[i];
+
+							if (message == null)
+								break;
+
+							Settings.Queue.add(start + i,
+									Integer.parseInt(message));
+						}
+					} catch (Exception e) {
+						main.getErrorClassHandler().post(
+								ErrorMessagesClass.conversion_error);
+					}
+
+					try {
+						RemoteControlPlaylist.refreshQueue();
+					} catch (Exception e) {
+					}
+					break;
+				}
+				case QUEUE_REMOVE: {
+					// queueRemove_<start>_<count>
+					try {
+						MessageTrie.parsePair(message, types.length(QUEUE_REMOVE),
+								pair);
+						int start = pair[0];
+						int count = pair[1];
+
+						for (int i = 0; i < count
+								&& start < Settings.Queue.size(); i++)
+							Settings.Queue.remove(start);
+
+						RemoteControlPlaylist.refreshQueue();
+					} catch (Exception e) {
+					}
+					break;
+				}
+				case QUEUE_MOVE: {
+					// queueMove_<from>_<to>
+					try {
+						MessageTrie.parsePair(message, types.length(QUEUE_MOVE),
+								pair);
+						int from = pair[0];
+						int to = pair[1];
+
+						Settings.Queue.add(to, Settings.Queue.remove(from));
+
+						RemoteControlPlaylist.refreshQueue();
+					} catch (Exception e) {
+					}
+					break;
+				}
+				case TRACK_TITLE: {
 					try {
 						tmp = message.subSequence(12, message.length());
 						RemoteControlPlaylist.title = (String) tmp;
 					} catch (Exception e) {
 					}
-				} else if (message.startsWith("track_artist_") == true) {
+					break;
+				}
+				case TRACK_ARTIST: {
 					try {
 						tmp = message.subSequence(13, message.length());
 						RemoteControlPlaylist.artist = (String) tmp;
 					} catch (Exception e) {
 					}
-				} else if (message.startsWith("track_album_") == true) {
+					break;
+				}
+				case TRACK_ALBUM: {
 					try {
 						tmp = message.subSequence(12, message.length());
 						RemoteControlPlaylist.album = (String) tmp;
 					} catch (Exception e) {
 					}
-				} else if (message.startsWith("track_year_") == true) {
+					break;
+				}
+				case TRACK_YEAR: {
 					try {
 						tmp = message.subSequence(11, message.length());
 						RemoteControlPlaylist.year = (String) tmp;
 					} catch (Exception e) {
 					}
-				} else if (message.startsWith("track_track_") == true) {
+					break;
+				}
+				case TRACK_TRACK: {
 					try {
 						tmp = message.subSequence(12, message.length());
 						RemoteControlPlaylist.track = (String) tmp;
 					} catch (Exception e) {
 					}
-				} else if (message.startsWith("track_genre_") == true) {
+					break;
+				}
+				case TRACK_GENRE: {
 					try {
 						tmp = message.subSequence(12, message.length());
 						RemoteControlPlaylist.genre = (String) tmp;
 					} catch (Exception e) {
 					}
-				} else if (message.startsWith("track_samplerate_") == true) {
+					break;
+				}
+				case TRACK_SAMPLERATE: {
 					try {
 						tmp = message.subSequence(17, message.length());
 						RemoteControlPlaylist.samplerate = tmp + " Hz";
 					} catch (Exception e) {
 					}
-				} else if (message.startsWith("track_bitrate_") == true) {
+					break;
+				}
+				case TRACK_BITRATE: {
 					try {
 						tmp = message.subSequence(14, message.length());
 						RemoteControlPlaylist.bitrate = tmp + " kbit/s";
 					} catch (Exception e) {
 					}
-				} else if (message.startsWith("track_length_") == true) {
+					break;
+				}
+				case TRACK_LENGTH: {
 					try {
 						tmp = message.subSequence(13, message.length());
 
@@ -408,7 +814,9 @@ public class ReceiveClass implements Runnable {
 								+ secondsString;
 					} catch (Exception e) {
 					}
-				} else if (message.startsWith("track_comment_") == true) {
+					break;
+				}
+				case TRACK_COMMENT: {
 					try {
 						tmp = message.subSequence(14, message.length());
 						RemoteControlPlaylist.comment = (String) tmp;
@@ -419,69 +827,224 @@ public class ReceiveClass implements Runnable {
 					// TEXTVIEWS
 					RemoteControlPlaylist.viewHandler
 							.post(RemoteControlPlaylist.RefreshDialogTextViews);
-				} else if (message.startsWith("track_coverLength_") == true) {
+					break;
+				}
+				case TRACK_COVER_HASH: {
+					trackCoverHash = message.substring(types
+							.length(TRACK_COVER_HASH));
+					break;
+				}
+				case TRACK_COVER_CACHED: {
+					main.getCoverReader().getCover(message.substring(18),
+							RemoteControlPlaylist.coverTarget);
+					break;
+				}
+				case JOURNAL: {
+					// last broadcast received, see resume
+					try {
+						Settings.resumeSequence = MessageTrie.parseInt(
+								message, types.length(JOURNAL));
+					} catch (NumberFormatException e) {
+						Settings.resumeEpoch = null;
+					}
+
+					break;
+				}
+				case SESSION: {
+					// session_<epoch>_<sequence> after the synchronization
+					main.setResumeToken(message.substring(types
+							.length(SESSION)));
+
+					break;
+				}
+				case PLAYLIST_HASH: {
+					// playlistHash_<hash>_<length> after the synchronization
+					// and every change of the playlist
+					PlaylistPages playlist = Settings.playlist;
+
+					if (playlist != null
+							&& !playlist.fingerprint(message.substring(types
+									.length(PLAYLIST_HASH)))) {
+						// the kept titles are from another playlist
+						Settings.playlist = new PlaylistPages(playlist.length());
+
+						try {
+							RemoteControlPlaylist.viewHandler
+									.post(RemoteControlPlaylist.updateTitles);
+						} catch (NullPointerException e1) {
+						} // playlist not yet loaded
+					}
+
+					break;
+				}
+				case LATENCY_PROBE: {
+					// latencyProbe_<id>_<sent> follows the title and cover of a
+					// new song. they are posted to the handler before, so it is
+					// echoed once they are shown
+					final String probe = message.substring(types
+							.length(LATENCY_PROBE));
+					// the time it was read from the socket
+					final long read = received.received;
+
+					RemoteControlOverview.WinampSettingsHandler
+							.post(new Runnable() {
+								public void run() {
+									SendClass.queueOut.add("latencyEcho_"
+											+ probe + "_" + read + "_"
+											+ SystemClock.uptimeMillis());
+								}
+							});
+
+					break;
+				}
+				case CLOCK: {
+					// clock_<position>_<rate>_<tick>, the tick count is unsigned
+					// and wraps into an int
+					PlaybackClock clock = main.getPlaybackSettings().getClock();
+
+					try {
+						int start = types.length(CLOCK);
+						int tickStart = message.lastIndexOf('_') + 1;
+
+						MessageTrie.parsePair(
+								message.substring(0, tickStart - 1), start,
+								pair);
+
+						clock.set(pair[0], pair[1],
+								(int) Long.parseLong(message.substring(tickStart)));
+					} catch (Exception e) {
+						main.getErrorClassHandler().post(
+								ErrorMessagesClass.conversion_error);
+						break;
+					}
+
+					showClock(clock);
+
+					break;
+				}
+				case TICK: {
+					// tick_<drift>_<elapsed>_<tickBase>: the position has
+					// drifted from the clock_ with the tick count tickBase
+					PlaybackClock clock = main.getPlaybackSettings().getClock();
+					boolean taken;
+
+					try {
+						int start = types.length(TICK);
+						int tickStart = message.lastIndexOf('_') + 1;
+
+						MessageTrie.parsePair(
+								message.substring(0, tickStart - 1), start,
+								pair);
+
+						taken = clock.tick(pair[0], pair[1],
+								(int) Long.parseLong(message.substring(tickStart)));
+					} catch (Exception e) {
+						main.getErrorClassHandler().post(
+								ErrorMessagesClass.conversion_error);
+						break;
+					}
+
+					// a tick of an older clock or an older tick of this one
+					if (taken)
+						showClock(clock);
+
+					break;
+				}
+				case TRACK_COVER_LENGTH: {
 					// ///////////////////////////////// COVER
 					// ///////////////////////////////////////////////////
 
 					int coverLength = 0;
-					CharSequence tmp2;
 					// LENGTH
 					try {
-						tmp2 = message.subSequence(18, message.length());
-						coverLength = Integer.parseInt(tmp2.toString());
+						coverLength = MessageTrie.parseInt(message,
+								types.length(TRACK_COVER_LENGTH));
 					} catch (Exception e) {
 						e.printStackTrace();
 
 						main.getErrorClassHandler().post(
 								ErrorMessagesClass.conversion_error);
 
-						break;
+						break receive;
 					}
 
 					// COVER
 
-					if (coverLength > 0) {
-
-						// cover not yet in coverMap
+					if (coverLength > 0 && trackCoverHash != null
+							&& CoverReader.validHash(trackCoverHash) == null) {
 
-						try {
-							Bitmap bmp = main.getCoverReader().readCover(
-									coverLength, false);
+						// a hash that can't name a file drops the cover
 
-							if (bmp != null) {
+						trackCoverHash = null;
 
-								RemoteControlPlaylist.cover = bmp;
+					} else if (coverLength > 0) {
 
-								RemoteControlPlaylist.viewHandler
-										.post(RemoteControlPlaylist.SetCover);
-							} else
-								RemoteControlPlaylist.viewHandler
-										.post(RemoteControlPlaylist.SetEmptyCover);
+						// cover not yet in coverMap
 
-						} catch (IOException e) {
-							e.printStackTrace();
+						main.getCoverReader().readCover(received.data,
+								coverLength, trackCoverHash,
+								RemoteControlPlaylist.coverTarget);
 
-							main.getErrorClassHandler().post(
-									ErrorMessagesClass.conversion_error);
-
-							break;
-						}
+						trackCoverHash = null;
 
 					} else {
 						RemoteControlPlaylist.cover = null;
 					}
-				}
 
+					break;
+				}
+				}
 			}
 		}
 
+		// stops the reader if it waits for room in the queue
+		readerThread.interrupt();
+
 		try {
 
-			// if stream closed
-			if (main.getSocket() != null)
-				main.getActivity().disconnect();
+			// if stream closed. a journaling server replays what has been
+			// missed, the state is kept
+			if (main.getSocket() != null) {
+				if (Settings.resumeEpoch != null)
+					main.resume();
+				else
+					main.getActivity().disconnect();
+			}
 
 		} catch (Exception e) {
 		}
 	}
+
+	/**
+	 * shows the position of the clock and restarts the timer of the overview
+	 * when the clock has changed
+	 * 
+	 * @param clock
+	 *            clock of the playback settings
+	 */
+	private void showClock(PlaybackClock clock) {
+		long position = clock.getPosition();
+
+		// the other messages still count from the start time
+		main.getPlaybackSettings().setStartTime(
+				System.currentTimeMillis() - position);
+
+		try {
+			RemoteControlOverview.timertask.cancel();
+			RemoteControlOverview.timertask.cancel = true;
+			RemoteControlOverview.timer.cancel();
+		} catch (Exception e) {
+		}
+
+		RemoteControlOverview.timertask = new UpdateTimeTask();
+
+		if (clock.isRunning()) {
+			// ticks when the displayed second changes
+			RemoteControlOverview.timer = new Timer();
+			RemoteControlOverview.timer.schedule(
+					RemoteControlOverview.timertask, 1000 - position % 1000,
+					1000);
+		} else
+			RemoteControlOverview.timertask.run();
+	}
 }
@@ -35,9 +35,16 @@ public class RemoteControlOverview extends Activity implements
 			if (cancel == true)
 				cancel();
 			else {
-				main.getPlaybackSettings().setCurrent_millis(
-						System.currentTimeMillis()
-								- main.getPlaybackSettings().getStartTime());
+				PlaybackClock clock = main.getPlaybackSettings().getClock();
+
+				// servers without clock_ messages: counted from the start time
+				if (clock.isKnown())
+					main.getPlaybackSettings().setCurrent_millis(
+							clock.getPosition());
+				else
+					main.getPlaybackSettings().setCurrent_millis(
+							System.currentTimeMillis()
+									- main.getPlaybackSettings().getStartTime());
 				main.getPlaybackSettings()
 						.setCurrent_seconds(
 								(int) (main.getPlaybackSettings()
@@ -60,6 +67,18 @@ public class RemoteControlOverview extends Activity implements
 
 	static Bitmap cover;
 
+	// shows the decoded covers of the current track
+	final static CoverReader.CoverTarget coverTarget = new CoverReader.CoverTarget() {
+		public void setCover(Bitmap bitmap) {
+			if (bitmap != null) {
+				cover = bitmap;
+
+				WinampSettingsHandler.post(SetCover);
+			} else
+				WinampSettingsHandler.post(SetEmptyCover);
+		}
+	};
+
 	static ImageView coverView;
 
 	static TextView title_display, length_seconds_display,
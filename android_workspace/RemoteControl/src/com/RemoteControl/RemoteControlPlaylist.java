@@ -1,6 +1,7 @@
 package com.RemoteControl;
 
 import java.io.UnsupportedEncodingException;
+import java.util.ArrayList;
 
 import com.RemoteControl.R;
 
@@ -21,12 +22,19 @@ import android.view.LayoutInflater;
 import android.view.MenuItem;
 import android.view.View;
 import android.view.ViewGroup;
+import android.widget.AbsListView;
+import android.widget.AbsListView.OnScrollListener;
 import android.widget.AdapterView;
+import android.widget.AdapterView.OnItemSelectedListener;
 import android.widget.ArrayAdapter;
+import android.widget.BaseAdapter;
 import android.widget.EditText;
+import android.widget.Filter;
+import android.widget.Filterable;
 import android.widget.ImageView;
 import android.widget.LinearLayout;
 import android.widget.ListView;
+import android.widget.Spinner;
 import android.widget.TextView;
 import android.widget.TabHost.OnTabChangeListener;
 
@@ -46,28 +54,138 @@ public class RemoteControlPlaylist extends ListActivity {
 
 	static EditText filterText = null;
 
+	// milliseconds until the groups are requested again while the server
+	// hasn't grouped every entry
+	static final int GROUPS_RETRY = 2000;
+
 	ListView listView = null;
 
 	// DIALOG
 	static Dialog trackDialog;
 	static Bitmap cover;
+
+	// shows the decoded covers of the track dialog
+	final static CoverReader.CoverTarget coverTarget = new CoverReader.CoverTarget() {
+		public void setCover(Bitmap bitmap) {
+			cover = bitmap;
+
+			if (bitmap != null)
+				viewHandler.post(SetCover);
+			else
+				viewHandler.post(SetEmptyCover);
+		}
+	};
+
+	// redraws the rows once a thumbnail is decoded
+	final static CoverReader.CoverTarget thumbnailTarget = new CoverReader.CoverTarget() {
+		public void setCover(Bitmap bitmap) {
+			try {
+				viewHandler.post(updateTitles);
+			} catch (NullPointerException e) {
+			} // playlist not yet loaded
+		}
+	};
+
 	static ImageView coverView;
 	static TextView titleView, artistView, albumView, yearView, trackView,
 			genreView, samplerateView, bitrateView, lengthView, commentView;
 	static String title, artist, album, year, track, genre, samplerate,
 			bitrate, length, comment;
 
-	static class EfficientAdapter extends ArrayAdapter<PlaylistElement> {
-
-		public EfficientAdapter(Context context, int textViewResourceId,
-				int playlistTitle, PlaylistElement[] objects) {
-			super(context, textViewResourceId, playlistTitle, objects);
+	/**
+	 * Rows of the playlist backed by Settings.playlist, titles that haven't
+	 * been received are requested when their row is shown. With a filter
+	 * only the received titles containing it are listed. With a grouping the
+	 * rows are the groups of Settings.groups instead, the filter doesn't
+	 * apply to them.
+	 */
+	static class EfficientAdapter extends BaseAdapter implements Filterable {
 
+		public EfficientAdapter(Context context) {
 			mInflater = LayoutInflater.from(context);
 		}
 
 		private LayoutInflater mInflater;
 
+		// playlist positions of the rows while filtered, null otherwise
+		private int[] filtered = null;
+
+		private final Filter filter = new Filter() {
+			@Override
+			protected FilterResults performFiltering(CharSequence constraint) {
+				FilterResults results = new FilterResults();
+				PlaylistPages playlist = Settings.playlist;
+
+				if (constraint != null && constraint.length() > 0
+						&& playlist != null) {
+					int[] positions = playlist.find(constraint.toString());
+
+					results.values = positions;
+					results.count = positions.length;
+				}
+
+				return results;
+			}
+
+			@Override
+			protected void publishResults(CharSequence constraint,
+					FilterResults results) {
+				filtered = (int[]) results.values;
+
+				notifyDataSetChanged();
+			}
+		};
+
+		public Filter getFilter() {
+			return filter;
+		}
+
+		boolean isFiltered() {
+			return filtered != null;
+		}
+
+		public int getCount() {
+			PlaylistGroups groups = Settings.groups;
+
+			if (groups != null)
+				return groups.count();
+
+			if (filtered != null)
+				return filtered.length;
+
+			PlaylistPages playlist = Settings.playlist;
+
+			return playlist != null ? playlist.length() : 0;
+		}
+
+		/**
+		 * @return playlist position of a row, the first entry of a group. -1
+		 *         for a group that hasn't been received
+		 */
+		int getPlaylistPosition(int row) {
+			PlaylistGroups groups = Settings.groups;
+
+			if (groups != null) {
+				PlaylistGroups.Group group = groups.get(row);
+
+				return group != null ? group.first() : -1;
+			}
+
+			return filtered != null ? filtered[row] : row;
+		}
+
+		public Object getItem(int row) {
+			PlaylistPages playlist = Settings.playlist;
+			int position = getPlaylistPosition(row);
+
+			return playlist != null && position >= 0 ? playlist
+					.getTitle(position) : null;
+		}
+
+		public long getItemId(int row) {
+			return getPlaylistPosition(row);
+		}
+
 		@Override
 		public View getView(int position, View convertView, ViewGroup parent) {
 			ViewHolder holder;
@@ -95,29 +213,51 @@ public class RemoteControlPlaylist extends ListActivity {
 				holder = (ViewHolder) convertView.getTag();
 			}
 
+			PlaylistGroups groups = Settings.groups;
+
+			if (groups != null) {
+				bindGroup(holder, groups, position);
+
+				return convertView;
+			}
+
 			try {
-				PlaylistElement item = getItem(position);
-
-				String displayedTitle = new String("");
-				try {
-					displayedTitle = new String(item.title.getBytes(),
-							System.getProperty("file.encoding"));
-				} catch (UnsupportedEncodingException e) {
-					error_class_Handler
-							.post(ErrorMessagesClass.unsupportedEncodingError);
-					e.printStackTrace();
+				int playlistPosition = getPlaylistPosition(position);
+				String title = (String) getItem(position);
+
+				if (title == null) {
+					// title not yet received
+					holder.text.setText(String.valueOf(playlistPosition + 1)
+							+ ". ");
+
+					requestRange(playlistPosition);
+				} else {
+					String displayedTitle = new String("");
+					try {
+						displayedTitle = new String(title.getBytes(),
+								System.getProperty("file.encoding"));
+					} catch (UnsupportedEncodingException e) {
+						error_class_Handler
+								.post(ErrorMessagesClass.unsupportedEncodingError);
+						e.printStackTrace();
+					}
+
+					// fill playlist element with content
+					holder.text.setText(String.valueOf(playlistPosition + 1)
+							+ ". " + Html.fromHtml(displayedTitle).toString());
 				}
+				holder.origPosition = playlistPosition;
 
-				// fill playlist element with content
-				holder.text.setText(String.valueOf(item.position + 1) + ". "
-						+ Html.fromHtml(displayedTitle).toString());
-				holder.origPosition = item.position;
+				PlaylistPages playlist = Settings.playlist;
+				String hash = playlist != null ? playlist
+						.getHash(playlistPosition) : null;
+				Bitmap thumbnail = hash != null ? main.getCoverReader()
+						.getThumbnail(hash) : null;
 
-				// set cover if not null
-				if (item.cover == null)
-					holder.coverImage.setImageResource(R.drawable.cover_square);
+				if (thumbnail != null)
+					holder.coverImage.setImageBitmap(thumbnail);
 				else
-					holder.coverImage.setImageBitmap(item.cover);
+					holder.coverImage.setImageResource(R.drawable.cover_square);
 
 				// set queue number
 				if (Settings.Queue.contains(holder.origPosition))
@@ -143,6 +283,64 @@ public class RemoteControlPlaylist extends ListActivity {
 			return convertView;
 		}
 
+		/**
+		 * fills a row with a group: its name, the album artist, the number
+		 * of entries and their length. the row of the playing entry's group
+		 * is highlighted
+		 */
+		private void bindGroup(ViewHolder holder, PlaylistGroups groups,
+				int index) {
+			PlaylistGroups.Group group = groups.get(index);
+
+			holder.queue.setText("");
+			holder.coverImage.setImageResource(R.drawable.cover_square);
+
+			if (group == null) {
+				// group not yet received
+				holder.text.setText("");
+				holder.origPosition = -1;
+				holder.layout.setBackgroundColor(Color.rgb(224, 224, 224));
+				holder.playImage.setImageResource(0);
+
+				groups.request(index);
+
+				return;
+			}
+
+			String name = group.name.length() > 0 ? group.name : "Unknown";
+			String artist = group.artist.length() > 0 ? group.artist + "\n"
+					: "";
+
+			holder.text.setText(name + "\n" + artist
+					+ String.valueOf(group.entries)
+					+ (group.entries == 1 ? " track, " : " tracks, ")
+					+ formatSeconds(group.seconds));
+			holder.origPosition = group.first();
+
+			Bitmap thumbnail = group.hash.length() > 0 ? main
+					.getCoverReader().getThumbnail(group.hash) : null;
+
+			if (thumbnail != null)
+				holder.coverImage.setImageBitmap(thumbnail);
+
+			if (group.contains(Settings.playlistPosition)) {
+				holder.layout.setBackgroundColor(Color.rgb(200, 200, 200));
+				holder.playImage.setImageResource(R.drawable.playlist_play);
+			} else {
+				holder.layout.setBackgroundColor(Color.rgb(224, 224, 224));
+				holder.playImage.setImageResource(0);
+			}
+		}
+
+		private static String formatSeconds(int seconds) {
+			int hours = seconds / 3600;
+			int minutes = seconds / 60 % 60;
+
+			String time = String.format("%02d:%02d", minutes, seconds % 60);
+
+			return hours > 0 ? String.valueOf(hours) + ":" + time : time;
+		}
+
 		static class ViewHolder {
 			LinearLayout layout;
 			TextView text, queue;
@@ -171,9 +369,7 @@ public class RemoteControlPlaylist extends ListActivity {
 	static Runnable initialize = new Runnable() {
 		public void run() {
 
-			adapter = new EfficientAdapter(RemoteControlPlaylist.activity,
-					android.R.layout.simple_list_item_1,
-					R.string.playlist_title, Settings.playlist);
+			adapter = new EfficientAdapter(RemoteControlPlaylist.activity);
 			RemoteControlPlaylist.activity.setListAdapter(adapter);
 
 			try {
@@ -233,6 +429,31 @@ public class RemoteControlPlaylist extends ListActivity {
 
 		filterText = (EditText) findViewById(R.string.search_box);
 
+		// the plain playlist or one of the groupings of the server
+		Spinner grouping = (Spinner) findViewById(R.string.group_spinner);
+		ArrayAdapter<CharSequence> groupings = ArrayAdapter
+				.createFromResource(this, R.array.groupingArray,
+						android.R.layout.simple_spinner_item);
+		groupings
+				.setDropDownViewResource(android.R.layout.simple_spinner_dropdown_item);
+		grouping.setAdapter(groupings);
+
+		PlaylistGroups current = Settings.groups;
+
+		if (current != null)
+			grouping.setSelection(java.util.Arrays.asList(
+					PlaylistGroups.MODES).indexOf(current.mode()) + 1);
+
+		grouping.setOnItemSelectedListener(new OnItemSelectedListener() {
+			public void onItemSelected(AdapterView<?> parent, View view,
+					int position, long id) {
+				setGrouping(position);
+			}
+
+			public void onNothingSelected(AdapterView<?> parent) {
+			}
+		});
+
 		getListView().setTextFilterEnabled(true);
 
 		error_class_Handler = new Handler();
@@ -242,6 +463,24 @@ public class RemoteControlPlaylist extends ListActivity {
 
 		getListView().setFastScrollEnabled(true);
 
+		// titles of the shown rows and the next ones in the scroll direction
+		getListView().setOnScrollListener(new OnScrollListener() {
+			public void onScroll(AbsListView view, int firstVisibleItem,
+					int visibleItemCount, int totalItemCount) {
+				PlaylistPages playlist = Settings.playlist;
+				PlaylistGroups groups = Settings.groups;
+
+				if (groups != null)
+					groups.show(firstVisibleItem, visibleItemCount);
+				else if (playlist != null && adapter != null
+						&& !adapter.isFiltered())
+					playlist.show(firstVisibleItem, visibleItemCount);
+			}
+
+			public void onScrollStateChanged(AbsListView view, int scrollState) {
+			}
+		});
+
 		// hide keyboard when changing tab
 		main.getActivityTabHost().setOnTabChangedListener(
 				new OnTabChangeListener() {
@@ -259,10 +498,12 @@ public class RemoteControlPlaylist extends ListActivity {
 	static Runnable update = new Runnable() {
 		public void run() {
 			if (main.getSocket() == null) {
-				Settings.playlist = new PlaylistElement[0];
+				Settings.playlist = new PlaylistPages(0);
 				viewHandler.post(initialize);
 			}
 
+			shownPosition = Settings.playlistPosition;
+
 			try { // UPDATE LISTVIEW
 
 				adapter.notifyDataSetChanged();
@@ -290,10 +531,295 @@ public class RemoteControlPlaylist extends ListActivity {
 		}
 	}
 
+	// playlist position that is highlighted as the current one, see
+	// updatePosition
+	private static int shownPosition = -1;
+
+	/**
+	 * Shows a playlistPosition_ of the server: only the rows of the old and
+	 * the new current position are bound again.
+	 */
+	static void refreshPosition() {
+		try {
+			viewHandler.post(updatePosition);
+		} catch (Exception e) {
+		}
+	}
+
+	/**
+	 * Shows a change of the queue: only the shown rows with a queue number,
+	 * before or after the change, are bound again.
+	 */
+	static void refreshQueue() {
+		try {
+			viewHandler.post(updateQueue);
+		} catch (Exception e) {
+		}
+	}
+
+	static Runnable updatePosition = new Runnable() {
+		public void run() {
+			int old = shownPosition;
+			int current = Settings.playlistPosition;
+
+			shownPosition = current;
+
+			updateRows(old, old, false);
+			updateRows(current, current, false);
+
+			try { // SCROLL TO CURRENT PLAYLIST POSITION
+				if (RemoteControlPlaylist.touchmode == false)
+					activity.getListView().setSelection(Math.max(current - 1, 0));
+			} catch (Exception e) {
+			}
+		}
+	};
+
+	static Runnable updateQueue = new Runnable() {
+		public void run() {
+			updateRows(0, Integer.MAX_VALUE, true);
+		}
+	};
+
+	/**
+	 * Binds the shown rows of the playlist positions first to last again
+	 * without notifying the adapter, the other rows and the scroll position
+	 * stay. Called on the UI thread.
+	 * 
+	 * @param first
+	 *            first playlist position
+	 * @param last
+	 *            last playlist position
+	 * @param queued
+	 *            only the rows that show a queue number or are queued
+	 */
+	static void updateRows(int first, int last, boolean queued) {
+		if (Settings.groups != null) {
+			// a group row covers several positions, bind them all again
+			updateTitles.run();
+
+			return;
+		}
+
+		try {
+			ListView list = activity.getListView();
+			int firstRow = list.getFirstVisiblePosition();
+
+			for (int i = 0; i < list.getChildCount()
+					&& firstRow + i < adapter.getCount(); i++) {
+				View row = list.getChildAt(i);
+				int position = adapter.getPlaylistPosition(firstRow + i);
+
+				if (position < first || position > last)
+					continue;
+
+				if (queued) {
+					EfficientAdapter.ViewHolder holder = (EfficientAdapter.ViewHolder) row
+							.getTag();
+
+					if (holder.queue.getText().length() == 0
+							&& !Settings.Queue.contains(position))
+						continue;
+				}
+
+				adapter.getView(firstRow + i, row, list);
+			}
+		} catch (Exception e) {
+		}
+	}
+
+	static Runnable updateTitles = new Runnable() {
+		public void run() {
+			try { // UPDATE LISTVIEW WITHOUT SCROLLING
+				adapter.notifyDataSetChanged();
+			} catch (Exception e) {
+			}
+		}
+	};
+
+	/**
+	 * Removes entries after a playlist_delete_ message of the server.
+	 * 
+	 * @param start
+	 *            position of the first removed entry
+	 * @param count
+	 *            number of removed entries
+	 */
+	static synchronized void deleteEntries(int start, int count) {
+		PlaylistPages playlist = Settings.playlist;
+
+		if (playlist == null || start < 0 || start + count > playlist.length())
+			return;
+
+		playlist.resize(start, -count);
+
+		changed(playlist);
+	}
+
+	/**
+	 * Inserts untitled entries after a playlist_insert_ message of the
+	 * server. Their titles are requested when they are displayed.
+	 * 
+	 * @param start
+	 *            position of the first inserted entry
+	 * @param count
+	 *            number of inserted entries
+	 */
+	static synchronized void insertEntries(int start, int count) {
+		PlaylistPages playlist = Settings.playlist;
+
+		if (playlist == null || start < 0 || start > playlist.length())
+			return;
+
+		playlist.resize(start, count);
+
+		changed(playlist);
+	}
+
+	/**
+	 * Moves an entry after a playlist_move_ message of the server.
+	 * 
+	 * @param from
+	 *            old position
+	 * @param to
+	 *            new position
+	 */
+	static synchronized void moveEntry(int from, int to) {
+		PlaylistPages playlist = Settings.playlist;
+
+		if (playlist == null || from < 0 || to < 0
+				|| from >= playlist.length() || to >= playlist.length())
+			return;
+
+		playlist.move(from, to);
+
+		if (Settings.groups != null) {
+			// the runs of the groups have changed
+			regroup();
+
+			try {
+				viewHandler.post(updateTitles);
+			} catch (NullPointerException e1) {
+			} // playlist not yet loaded
+
+			return;
+		}
+
+		// the number of rows stays, only the moved ones change
+		final int first = Math.min(from, to);
+		final int last = Math.max(from, to);
+
+		try {
+			viewHandler.post(new Runnable() {
+				public void run() {
+					updateRows(first, last, false);
+				}
+			});
+		} catch (NullPointerException e1) {
+		} // playlist not yet loaded
+	}
+
+	/**
+	 * Shows a changed playlist. The pages of the moved titles have been
+	 * dropped and are requested again when they are shown.
+	 */
+	private static void changed(PlaylistPages playlist) {
+		Settings.playlistlength = playlist.length();
+
+		regroup();
+
+		try {
+			viewHandler.post(updateTitles);
+		} catch (NullPointerException e1) {
+		} // playlist not yet loaded
+	}
+
+	/**
+	 * Shows the plain playlist or one of the groupings of the server.
+	 * 
+	 * @param position
+	 *            position of the grouping spinner: 0 for the plain
+	 *            playlist, else 1 + the index in PlaylistGroups.MODES
+	 */
+	static void setGrouping(int position) {
+		PlaylistGroups groups = Settings.groups;
+		String mode = position > 0 ? PlaylistGroups.MODES[position - 1] : null;
+
+		if (groups == null ? mode == null : groups.mode().equals(mode))
+			return;
+
+		Settings.groups = mode != null ? new PlaylistGroups(mode) : null;
+
+		viewHandler.removeCallbacks(retryGroups);
+
+		try {
+			adapter.notifyDataSetChanged();
+			activity.getListView().setSelection(0);
+		} catch (NullPointerException e1) {
+		} // playlist not yet loaded
+	}
+
+	/**
+	 * Drops the received groups after a change of the playlist, the shown
+	 * ones are requested again when they are bound.
+	 */
+	private static void regroup() {
+		PlaylistGroups groups = Settings.groups;
+
+		if (groups != null)
+			groups.invalidate();
+	}
+
+	/**
+	 * Shows a groups_ answer. Entries the server hasn't grouped yet are
+	 * picked up by requesting the groups again after GROUPS_RETRY.
+	 */
+	static void groupsReceived() {
+		PlaylistGroups groups = Settings.groups;
+
+		try {
+			viewHandler.post(updateTitles);
+
+			viewHandler.removeCallbacks(retryGroups);
+
+			if (groups != null && groups.pending() > 0)
+				viewHandler.postDelayed(retryGroups, GROUPS_RETRY);
+		} catch (NullPointerException e1) {
+		} // playlist not yet loaded
+	}
+
+	static Runnable retryGroups = new Runnable() {
+		public void run() {
+			regroup();
+
+			try {
+				adapter.notifyDataSetChanged();
+			} catch (NullPointerException e1) {
+			} // playlist not yet loaded
+		}
+	};
+
+	/**
+	 * Requests the window of titles containing position from the server
+	 * unless it has already been requested.
+	 * 
+	 * @param position
+	 *            playlist position
+	 */
+	static void requestRange(int position) {
+		PlaylistPages playlist = Settings.playlist;
+
+		if (playlist != null)
+			playlist.request(position);
+	}
+
 	@Override
 	protected void onListItemClick(ListView l, View v, int position, long id) {
-		PlaylistElement item = adapter.getItem(position);
-		int pos = item.position;
+		// the first entry of a group
+		int pos = adapter.getPlaylistPosition(position);
+
+		if (pos < 0)
+			return;
 
 		SendClass.queueOut.add("playlistitem_".concat(String.valueOf(pos)));
 		main.getConnectionHandler().post(main.pause_runnable);
@@ -416,8 +942,22 @@ public class RemoteControlPlaylist extends ListActivity {
 
 		menu.add(0, 0, 0, "Play");
 
-		PlaylistElement item = adapter.getItem(info.position);
-		int pos = item.position;
+		// the server streams audio only over the framed protocol
+		if (Settings.framed)
+			menu.add(0, 5, 0, "Listen on phone");
+
+		if (main.getAudioPlayer().isPlaying())
+			menu.add(0, 6, 0, "Stop listening");
+
+		int pos = adapter.getPlaylistPosition(info.position);
+
+		if (Settings.groups != null) {
+			// a group plays from its first entry or is enqueued as a whole
+			if (pos >= 0)
+				menu.add(0, 4, 0, "Enqueue group");
+
+			return;
+		}
 
 		if (Settings.Queue.contains(pos))
 			menu.add(0, 1, 0, "Remove from queue");
@@ -426,6 +966,8 @@ public class RemoteControlPlaylist extends ListActivity {
 
 		menu.add(0, 2, 0, "Track info");
 
+		menu.add(0, 3, 0, "Enqueue all");
+
 	}
 
 	@Override
@@ -433,8 +975,10 @@ public class RemoteControlPlaylist extends ListActivity {
 		AdapterView.AdapterContextMenuInfo info = (AdapterView.AdapterContextMenuInfo) menuItem
 				.getMenuInfo();
 
-		PlaylistElement item = adapter.getItem(info.position);
-		int pos = item.position;
+		int pos = adapter.getPlaylistPosition(info.position);
+
+		if (pos < 0 && menuItem.getItemId() != 6)
+			return true; // group not yet received
 
 		switch (menuItem.getItemId()) {
 		case 0:
@@ -444,14 +988,11 @@ public class RemoteControlPlaylist extends ListActivity {
 		case 1:
 
 			if (Settings.Queue.contains(info.position)) {
+				// the server sends the changed queue
 				SendClass.queueOut.add("remqueue_".concat(String
 						.valueOf(Settings.Queue.indexOf(pos))));
-				Settings.Queue.remove(Settings.Queue.indexOf(pos));
-				refreshItems();
 			} else {
 				SendClass.queueOut.add("enqueue_".concat(String.valueOf(pos)));
-				Settings.Queue.add(pos);
-				refreshItems();
 			}
 			break;
 
@@ -463,6 +1004,48 @@ public class RemoteControlPlaylist extends ListActivity {
 			trackDialog.show();
 
 			break;
+
+		case 3:
+			// every shown title that isn't queued yet, in one round trip
+			ArrayList<Integer> positions = new ArrayList<Integer>();
+
+			for (int i = 0; i < adapter.getCount(); i++) {
+				int position = adapter.getPlaylistPosition(i);
+
+				if (!Settings.Queue.contains(position))
+					positions.add(position);
+			}
+
+			SendClass.sendBatch("enqueueList_", positions);
+
+			break;
+
+		case 4:
+			PlaylistGroups groups = Settings.groups;
+			PlaylistGroups.Group group = groups != null ? groups
+					.get(info.position) : null;
+
+			if (group == null)
+				break;
+
+			ArrayList<Integer> entries = new ArrayList<Integer>();
+
+			for (int position : group.positions()) {
+				if (!Settings.Queue.contains(position))
+					entries.add(position);
+			}
+
+			SendClass.sendBatch("enqueueList_", entries);
+
+			break;
+
+		case 5:
+			main.getAudioPlayer().start(pos);
+			break;
+
+		case 6:
+			main.getAudioPlayer().stop();
+			break;
 		}
 
 		return true;
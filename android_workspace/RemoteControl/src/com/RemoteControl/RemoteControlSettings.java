@@ -20,7 +20,7 @@ public class RemoteControlSettings extends PreferenceActivity {
 
 
 	static EditTextPreference pref0, pref1, pref2;
-	static CheckBoxPreference pref3, pref5;
+	static CheckBoxPreference pref3, pref5, pref6;
 	static ListPreference pref4;
 	
 	String editTextPreference;
@@ -41,6 +41,9 @@ public class RemoteControlSettings extends PreferenceActivity {
 					// SAVE
 			        editor.putString("0", (String) Settings.liststatus[0]);
 		            editor.commit();
+
+		            // another server has another certificate
+		            SecureChannel.forget();
 		            
 		            // REFRESH UI
 					pref0.setSummary((String) Settings.liststatus[0]);
@@ -141,6 +144,17 @@ public class RemoteControlSettings extends PreferenceActivity {
 						main.getTelephonyManager().listen(main.getPhoneListener(), PhoneStateListener.LISTEN_NONE);
 					}
 					break;
+					
+				case 6:
+					Settings.liststatus[6] = newValue;
+					
+					// SAVE
+					editor.putBoolean("6", (Boolean) Settings.liststatus[6]);
+					editor.commit();
+					
+					// REFRESH UI, used with the next connect
+					pref6.setChecked((Boolean) Settings.liststatus[6]);
+					break;
 			}
 			
 			return false;
@@ -169,6 +183,9 @@ public class RemoteControlSettings extends PreferenceActivity {
         
         if(Settings.liststatus[5].equals(true))
         	pref5.setChecked(true);
+        
+        if(Settings.liststatus[6].equals(true))
+        	pref6.setChecked(true);
 	}
 	
 	
@@ -191,6 +208,7 @@ public class RemoteControlSettings extends PreferenceActivity {
 		pref3 = (CheckBoxPreference) findPreference("3");
 		pref4 = (ListPreference) findPreference("4");
 		pref5 = (CheckBoxPreference) findPreference("5");
+		pref6 = (CheckBoxPreference) findPreference("6");
 		
 		// check if prefs exist
 		if (pref1 == null)
@@ -203,6 +221,8 @@ public class RemoteControlSettings extends PreferenceActivity {
 			editor.putString("4", (String) Settings.liststatus[4]);
 		if (pref5 == null)
 			editor.putBoolean("5", (Boolean) Settings.liststatus[5]);
+		if (pref6 == null)
+			editor.putBoolean("6", (Boolean) Settings.liststatus[6]);
 		
 		editor.commit();
 		
@@ -230,6 +250,8 @@ public class RemoteControlSettings extends PreferenceActivity {
 		
 		pref5.setOnPreferenceChangeListener(onPreferenceChangeListener);
 		
+		pref6.setOnPreferenceChangeListener(onPreferenceChangeListener);
+		
 	}
 
 	
@@ -0,0 +1,460 @@
+package com.RemoteControl;
+
+import java.io.ByteArrayInputStream;
+import java.io.ByteArrayOutputStream;
+import java.io.File;
+import java.io.FileInputStream;
+import java.io.FileWriter;
+import java.io.IOException;
+import java.io.InputStream;
+import java.util.ArrayList;
+import java.util.HashMap;
+import java.util.Map;
+import java.util.concurrent.CountDownLatch;
+
+import android.graphics.Bitmap;
+import android.os.Debug;
+import android.util.Log;
+
+/**
+ * Replays a capture of the server (capture_1 and capture_0, see Capture.h of
+ * the plugin) through the receive path of the app and measures every stage:
+ * UTF8Reader.readLine alone, the dispatch of MessageReader and ReceiveClass,
+ * the cover decoding of CoverReader and the rebuild of the playlist rows.
+ * Started while the app isn't connected with
+ * 
+ * adb shell am start -S -n com.RemoteControl/.main -e benchmark <capture>
+ * 
+ * The report is logged with the tag RemoteControl and written next to the
+ * capture as <capture>.txt. The capture only keeps the length of binary
+ * data, every cover and thumbnail is replayed as the same generated JPEG.
+ */
+public class ReplayBenchmark implements Runnable {
+
+	static final String TAG = "RemoteControl";
+
+	// first bytes of a capture file and its record types, see Capture.h
+	static final String MAGIC = "RCCAPTR1";
+	static final int CAPTURE_MESSAGE = 2;
+
+	// session of the broadcasts
+	static final int ALL_SESSIONS = 0;
+
+	// pixels of the generated cover
+	static final int COVER_SIZE = 300;
+
+	// times the rows of the playlist are rebuilt
+	static final int ADAPTER_REBUILDS = 20;
+
+	// milliseconds a tick of the stall monitor may be late before it counts
+	static final int STALL_THRESHOLD = 5;
+
+	private final String capture;
+
+	private final ArrayList<String> report = new ArrayList<String>();
+
+	/**
+	 * a thread that sleeps a millisecond at a time and keeps how late it
+	 * wakes up. dalvik stops every thread for the collections, the stalls are
+	 * an upper bound of the GC pauses
+	 */
+	private static final class StallMonitor implements Runnable {
+		volatile boolean running = true;
+		volatile long longest = 0;
+		volatile long total = 0;
+		volatile int count = 0;
+
+		public void run() {
+			long last = System.nanoTime();
+
+			while (running) {
+				try {
+					Thread.sleep(1);
+				} catch (InterruptedException e) {
+					return;
+				}
+
+				long now = System.nanoTime();
+				long late = (now - last) / 1000000 - 1;
+
+				if (late >= STALL_THRESHOLD) {
+					total += late;
+					count++;
+
+					if (late > longest)
+						longest = late;
+				}
+
+				last = now;
+			}
+		}
+
+		void reset() {
+			longest = 0;
+			total = 0;
+			count = 0;
+		}
+	}
+
+	private final StallMonitor stalls = new StallMonitor();
+
+	// counters of the stage that is measured
+	private long started;
+	private int gcStarted;
+	private int allocStarted;
+
+	/**
+	 * @param capture
+	 *            path of the capture file on the phone
+	 */
+	ReplayBenchmark(String capture) {
+		this.capture = capture;
+	}
+
+	public void run() {
+		if (main.getSocket() != null) {
+			Log.w(TAG, "benchmark needs the app to be disconnected");
+			return;
+		}
+
+		Thread monitor = new Thread(stalls);
+		monitor.setPriority(Thread.MAX_PRIORITY);
+		monitor.start();
+
+		Debug.startAllocCounting();
+
+		try {
+			byte[] stream = replayStream(read(new File(capture)));
+
+			readLines(stream);
+			dispatch(stream);
+			rebuildRows();
+		} catch (Exception e) {
+			report.add("failed " + e);
+		} finally {
+			Debug.stopAllocCounting();
+
+			stalls.running = false;
+			monitor.interrupt();
+
+			// requests of the replayed pages, nobody sends them
+			SendClass.queueOut.clear();
+		}
+
+		write();
+	}
+
+	/**
+	 * @param file
+	 *            capture file
+	 * @return its bytes
+	 * @throws IOException
+	 */
+	private static byte[] read(File file) throws IOException {
+		byte[] data = new byte[(int) file.length()];
+		InputStream in = new FileInputStream(file);
+
+		try {
+			int count = 0, length;
+
+			while (count < data.length
+					&& (length = in.read(data, count, data.length - count)) > 0)
+				count += length;
+		} finally {
+			in.close();
+		}
+
+		return data;
+	}
+
+	/**
+	 * reads a number of 7 bit groups, least significant first
+	 * 
+	 * @param data
+	 *            capture
+	 * @param position
+	 *            offset of the number, receives the offset after it
+	 * @return the number
+	 */
+	private static long readNumber(byte[] data, int[] position) {
+		long number = 0;
+		int shift = 0;
+
+		while (position[0] < data.length) {
+			int b = data[position[0]++];
+
+			number |= (long) (b & 0x7F) << shift;
+			shift += 7;
+
+			if ((b & 0x80) == 0)
+				break;
+		}
+
+		return number;
+	}
+
+	/**
+	 * builds what the server has sent to one client: the broadcasts and the
+	 * lines of the session that has received the most, each terminated by
+	 * '\n'. covers and thumbnails get the generated JPEG, their lengths are
+	 * changed to its length
+	 * 
+	 * @param data
+	 *            capture
+	 * @return stream of the text protocol
+	 * @throws IOException
+	 */
+	private byte[] replayStream(byte[] data) throws IOException {
+		if (data.length < MAGIC.length()
+				|| !new String(data, 0, MAGIC.length(), "US-ASCII")
+						.equals(MAGIC))
+			throw new IOException("not a capture");
+
+		// offsets and lengths of the messages with their session
+		ArrayList<int[]> messages = new ArrayList<int[]>();
+		HashMap<Integer, Integer> counts = new HashMap<Integer, Integer>();
+		int[] position = { MAGIC.length() };
+
+		while (position[0] + 3 <= data.length) {
+			int type = data[position[0]];
+			int session = (data[position[0] + 1] & 0xFF)
+					| (data[position[0] + 2] & 0xFF) << 8;
+
+			position[0] += 3;
+			readNumber(data, position);
+			int length = (int) readNumber(data, position);
+
+			if (position[0] + length > data.length)
+				break;
+
+			if (type == CAPTURE_MESSAGE) {
+				messages.add(new int[] { position[0], length, session });
+
+				Integer count = counts.get(session);
+				counts.put(session, count == null ? 1 : count + 1);
+			}
+
+			position[0] += length;
+		}
+
+		int client = ALL_SESSIONS, most = 0;
+
+		for (Map.Entry<Integer, Integer> entry : counts.entrySet()) {
+			if (entry.getKey() != ALL_SESSIONS && entry.getValue() > most) {
+				client = entry.getKey();
+				most = entry.getValue();
+			}
+		}
+
+		byte[] cover = generateCover();
+		ByteArrayOutputStream stream = new ByteArrayOutputStream(data.length);
+		int replayed = 0, covers = 0;
+
+		for (int[] message : messages) {
+			if (message[2] != ALL_SESSIONS && message[2] != client)
+				continue;
+
+			String line = new String(data, message[0], message[1], "UTF-8");
+			int binary = line.startsWith("coverLength_")
+					|| line.startsWith("track_coverLength_")
+					|| line.startsWith("thumb_") ? line.lastIndexOf('_') + 1
+					: -1;
+
+			if (binary > 0 && !line.endsWith("_0")) {
+				stream.write((line.substring(0, binary) + cover.length + "\n")
+						.getBytes("UTF-8"));
+				stream.write(cover);
+
+				covers++;
+			} else {
+				stream.write(data, message[0], message[1]);
+				stream.write('\n');
+			}
+
+			replayed++;
+		}
+
+		report.add("replay " + capture + " session " + client + " messages "
+				+ replayed + " bytes " + stream.size() + " covers " + covers);
+
+		return stream.toByteArray();
+	}
+
+	/**
+	 * @return a JPEG of COVER_SIZE pixels with a gradient, so it doesn't
+	 *         compress to nothing
+	 */
+	private static byte[] generateCover() {
+		Bitmap bitmap = Bitmap.createBitmap(COVER_SIZE, COVER_SIZE,
+				Bitmap.Config.ARGB_8888);
+
+		for (int y = 0; y < COVER_SIZE; y++)
+			for (int x = 0; x < COVER_SIZE; x++)
+				bitmap.setPixel(x, y, 0xFF000000 | (x * 255 / COVER_SIZE) << 16
+						| (y * 255 / COVER_SIZE) << 8 | ((x ^ y) & 0xFF));
+
+		ByteArrayOutputStream out = new ByteArrayOutputStream();
+		bitmap.compress(Bitmap.CompressFormat.JPEG, 85, out);
+		bitmap.recycle();
+
+		return out.toByteArray();
+	}
+
+	/**
+	 * starts measuring a stage
+	 */
+	private void start() {
+		System.gc();
+
+		stalls.reset();
+		gcStarted = Debug.getGlobalGcInvocationCount();
+		allocStarted = Debug.getGlobalAllocSize();
+		started = System.nanoTime();
+	}
+
+	/**
+	 * adds a line for the stage that has been measured since start
+	 * 
+	 * @param stage
+	 *            name and counts of the stage
+	 * @param items
+	 *            number of items the throughput is computed for
+	 * @param bytes
+	 *            number of bytes the throughput is computed for, 0 if none
+	 */
+	private void finish(String stage, int items, long bytes) {
+		long microseconds = Math.max((System.nanoTime() - started) / 1000, 1);
+
+		StringBuilder line = new StringBuilder(stage);
+		line.append(" ms ").append(microseconds / 1000);
+		line.append(" per_second ").append(items * 1000000L / microseconds);
+
+		if (bytes > 0)
+			line.append(" kb_per_second ").append(
+					bytes * 1000000L / 1024 / microseconds);
+
+		line.append(" gc ").append(
+				Debug.getGlobalGcInvocationCount() - gcStarted);
+		line.append(" alloc_kb ").append(
+				(Debug.getGlobalAllocSize() - allocStarted) / 1024);
+		line.append(" stalls ").append(stalls.count);
+		line.append(" stall_ms ").append(stalls.total);
+		line.append(" longest_stall_ms ").append(stalls.longest);
+
+		report.add(line.toString());
+	}
+
+	/**
+	 * the lines of the stream with UTF8Reader.readLine alone
+	 * 
+	 * @param stream
+	 *            replayed stream
+	 * @throws IOException
+	 */
+	private void readLines(byte[] stream) throws IOException {
+		InputStream in = new LineInputStream(new ByteArrayInputStream(stream));
+		int lines = 0;
+
+		start();
+
+		try {
+			while (UTF8Reader.readLine(in) != null)
+				lines++;
+		} catch (IOException e) {
+			// end of the stream, the covers are read as lines as well
+		}
+
+		finish("readLine lines " + lines, lines, stream.length);
+	}
+
+	/**
+	 * the stream through MessageReader and ReceiveClass as if it came from
+	 * the server, then until CoverReader has decoded every cover
+	 * 
+	 * @param stream
+	 *            replayed stream
+	 * @throws InterruptedException
+	 */
+	private void dispatch(byte[] stream) throws InterruptedException {
+		CoverReader coverReader = main.getCoverReader();
+		long decodeTime = coverReader.decodeTime;
+		int decoded = coverReader.decoded;
+
+		main.setInputStream(new LineInputStream(new ByteArrayInputStream(
+				stream)));
+
+		start();
+
+		new ReceiveClass().run();
+
+		finish("dispatch", 1, stream.length);
+
+		start();
+
+		coverReader.drain();
+
+		finish("decode_wait", 1, 0);
+
+		decoded = coverReader.decoded - decoded;
+		decodeTime = (coverReader.decodeTime - decodeTime) / 1000;
+
+		report.add("decode covers " + decoded + " ms " + decodeTime / 1000
+				+ " per_second "
+				+ (decodeTime > 0 ? decoded * 1000000L / decodeTime : 0));
+	}
+
+	/**
+	 * rebinds the shown rows of the playlist and lets the list rebuild them
+	 * on the UI thread, ADAPTER_REBUILDS times
+	 * 
+	 * @throws InterruptedException
+	 */
+	private void rebuildRows() throws InterruptedException {
+		if (RemoteControlPlaylist.adapter == null) {
+			report.add("adapter - the playlist hasn't been shown");
+			return;
+		}
+
+		final CountDownLatch done = new CountDownLatch(1);
+
+		start();
+
+		RemoteControlPlaylist.activity.runOnUiThread(new Runnable() {
+			public void run() {
+				for (int i = 0; i < ADAPTER_REBUILDS; i++) {
+					RemoteControlPlaylist.updateRows(0, Integer.MAX_VALUE,
+							false);
+					RemoteControlPlaylist.adapter.notifyDataSetChanged();
+				}
+
+				done.countDown();
+			}
+		});
+
+		done.await();
+
+		finish("adapter rebuilds " + ADAPTER_REBUILDS, ADAPTER_REBUILDS, 0);
+	}
+
+	/**
+	 * logs the report and writes it to <capture>.txt
+	 */
+	private void write() {
+		try {
+			FileWriter out = new FileWriter(capture + ".txt");
+
+			try {
+				for (String line : report) {
+					Log.i(TAG, line);
+
+					out.write(line);
+					out.write('\n');
+				}
+			} finally {
+				out.close();
+			}
+		} catch (IOException e) {
+			Log.w(TAG, "benchmark report not written: " + e);
+		}
+	}
+}
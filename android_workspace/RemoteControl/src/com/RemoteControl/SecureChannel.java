@@ -0,0 +1,138 @@
+package com.RemoteControl;
+
+import java.io.IOException;
+import java.net.InetSocketAddress;
+import java.net.Socket;
+import java.security.GeneralSecurityException;
+import java.security.MessageDigest;
+import java.security.NoSuchAlgorithmException;
+import java.security.cert.CertificateException;
+import java.security.cert.X509Certificate;
+
+import javax.net.ssl.SSLContext;
+import javax.net.ssl.SSLSocket;
+import javax.net.ssl.TrustManager;
+import javax.net.ssl.X509TrustManager;
+
+import android.content.SharedPreferences;
+import android.preference.PreferenceManager;
+
+/**
+ * TLS for the connection to the server. The server presents a self signed
+ * certificate, so the certificate of the first connection is trusted and
+ * pinned: its SHA-256 fingerprint is kept in the preferences and a later
+ * connection with another certificate fails. Changing the server address in
+ * the settings forgets the pinned certificate.
+ * 
+ * One SSLContext serves every connection, its session cache lets a
+ * reconnect resume the TLS session with an abbreviated handshake.
+ */
+public class SecureChannel {
+
+	static final String PINNED = "tls_fingerprint";
+
+	private static SSLContext context = null;
+
+	/**
+	 * Starts TLS on a connected socket.
+	 * 
+	 * @param socket
+	 *            connected socket, closed with the returned one
+	 * @param timeout
+	 *            milliseconds the handshake may take
+	 * @return socket that encrypts the connection
+	 * @throws IOException
+	 *             if the handshake failed or the certificate isn't the
+	 *             pinned one
+	 */
+	public static Socket wrap(Socket socket, int timeout) throws IOException {
+		InetSocketAddress address = (InetSocketAddress) socket
+				.getRemoteSocketAddress();
+
+		// the session cache finds sessions by host and port
+		SSLSocket secure = (SSLSocket) context().getSocketFactory()
+				.createSocket(socket, address.getAddress().getHostAddress(),
+						address.getPort(), true);
+
+		secure.setSoTimeout(timeout);
+		secure.startHandshake();
+		secure.setSoTimeout(0);
+
+		return secure;
+	}
+
+	/**
+	 * Forgets the pinned certificate, the next server is trusted again.
+	 */
+	public static void forget() {
+		preferences().edit().remove(PINNED).commit();
+	}
+
+	private static synchronized SSLContext context() throws IOException {
+		if (context == null) {
+			try {
+				SSLContext c = SSLContext.getInstance("TLS");
+				c.init(null, new TrustManager[] { new PinningTrustManager() },
+						null);
+
+				context = c;
+			} catch (GeneralSecurityException e) {
+				throw new IOException(e.toString());
+			}
+		}
+
+		return context;
+	}
+
+	private static SharedPreferences preferences() {
+		return PreferenceManager.getDefaultSharedPreferences(main
+				.getActivity().getBaseContext());
+	}
+
+	private static String fingerprint(X509Certificate certificate)
+			throws CertificateException {
+		try {
+			byte[] digest = MessageDigest.getInstance("SHA-256").digest(
+					certificate.getEncoded());
+
+			StringBuilder hex = new StringBuilder(digest.length * 2);
+
+			for (byte b : digest)
+				hex.append(Integer.toHexString((b & 0xff) | 0x100)
+						.substring(1));
+
+			return hex.toString();
+		} catch (NoSuchAlgorithmException e) {
+			throw new CertificateException(e.toString());
+		}
+	}
+
+	private static class PinningTrustManager implements X509TrustManager {
+
+		public void checkClientTrusted(X509Certificate[] chain, String authType)
+				throws CertificateException {
+			throw new CertificateException("no client certificates");
+		}
+
+		public void checkServerTrusted(X509Certificate[] chain, String authType)
+				throws CertificateException {
+			if (chain == null || chain.length == 0)
+				throw new CertificateException("no server certificate");
+
+			String fingerprint = fingerprint(chain[0]);
+
+			SharedPreferences prefs = preferences();
+			String pinned = prefs.getString(PINNED, null);
+
+			if (pinned == null)
+				prefs.edit().putString(PINNED, fingerprint).commit();
+			else if (!pinned.equals(fingerprint))
+				throw new CertificateException(
+						"the certificate of the server has changed");
+		}
+
+		public X509Certificate[] getAcceptedIssuers() {
+			return new X509Certificate[0];
+		}
+	}
+}
@@ -2,8 +2,15 @@ package com.RemoteControl;
 
 import java.io.DataOutputStream;
 import java.io.IOException;
+import java.io.UnsupportedEncodingException;
+import java.util.ArrayList;
+import java.util.HashMap;
+import java.util.Iterator;
+import java.util.List;
+import java.util.Map;
 import java.util.concurrent.BlockingQueue;
 import java.util.concurrent.LinkedBlockingQueue;
+import java.util.concurrent.TimeUnit;
 
 public class SendClass {
 
@@ -14,18 +21,174 @@ public class SendClass {
 
 	static Thread t;
 
+	// values per batch command, keeps every command below the server's
+	// command length limit
+	static final int BATCH_SIZE = 100;
+
+	// commands that only set a value. while they come faster than one per
+	// CONTINUOUS_INTERVAL milliseconds only the latest value is sent
+	static final String[] CONTINUOUS = { "volume_", "progress_" };
+	static final long CONTINUOUS_INTERVAL = 50;
+
+	// size of the buffer of outToServer, flushed after every batch
+	static final int SEND_BUFFER = 8192;
+
+	// milliseconds stop waits for the send thread
+	static final int SEND_STOP_TIMEOUT = 500;
+
+	/**
+	 * queues one batch command per BATCH_SIZE values, e.g. enqueueList_1_2_3
+	 */
+	static void sendBatch(String command, List<Integer> values) {
+		for (int i = 0; i < values.size(); i += BATCH_SIZE) {
+			StringBuilder batch = new StringBuilder(command);
+
+			for (int j = i; j < Math.min(i + BATCH_SIZE, values.size()); j++) {
+				if (j > i)
+					batch.append('_');
+
+				batch.append(values.get(j));
+			}
+
+			queueOut.add(batch.toString());
+		}
+	}
+
+	/**
+	 * queues the edit of one tag field of a playlist entry, e.g.
+	 * tagEdit_12_rating_4. writeBytes only sends the low byte of every char,
+	 * so the value is passed as its UTF-8 bytes; line breaks would end the
+	 * command
+	 */
+	static void sendTagEdit(int index, String field, String value) {
+		try {
+			String bytes = new String(value.replace('\n', ' ').getBytes("UTF-8"), "ISO-8859-1");
+
+			queueOut.add("tagEdit_" + index + "_" + field + "_" + bytes);
+		} catch (UnsupportedEncodingException e) {
+			e.printStackTrace();
+		}
+	}
+
+	// number of the last search_ or browse_ command, the server numbers the
+	// pages of its answers the same way
+	static int searchId = 0;
+
+	// number of the last audioStream_ command, audioBlock_ and audioEnd_ carry it
+	static int audioId = 0;
+
+	/**
+	 * queues a library search, e.g. search_miles davis, or a browse command,
+	 * e.g. browse_artist_Miles Davis. a newer command replaces the older one
+	 * on the server, searchPage_ and searchEnd_ carry the returned number
+	 */
+	static int sendSearch(String command, String text) {
+		try {
+			String bytes = new String(text.replace('\n', ' ').getBytes("UTF-8"), "ISO-8859-1");
+
+			queueOut.add(command + bytes);
+
+			return ++searchId;
+		} catch (UnsupportedEncodingException e) {
+			e.printStackTrace();
+
+			return searchId;
+		}
+	}
+
+	/**
+	 * stops the pages of the running search
+	 */
+	static void cancelSearch() {
+		queueOut.add("searchCancel");
+	}
+
+	/**
+	 * starts listening to a playlist entry, -1 for the current track. only
+	 * served with the framed protocol, a newer stream replaces the older one
+	 */
+	static int startAudio(int position) {
+		queueOut.add("audioStream_" + position);
+
+		return ++audioId;
+	}
+
+	/**
+	 * stops the audio stream
+	 */
+	static void stopAudio() {
+		queueOut.add("audioStop");
+	}
+
+	/**
+	 * requests level meter frames, 20 to 60 per second. 0 stops them
+	 */
+	static void requestLevels(int rate) {
+		queueOut.add("levels_" + rate);
+	}
+
+	/**
+	 * analyses the album of a playlist entry and writes its ReplayGain tags, -1 for the current track
+	 */
+	static void requestReplayGain(int position) {
+		queueOut.add("replayGain_" + position);
+	}
+
+	/**
+	 * Ends the send thread of a connection that has been dropped, the
+	 * commands still queued are discarded.
+	 */
+	static void stop() {
+		Thread old = t;
+
+		if (old == null)
+			return;
+
+		queueOut.add("destroy");
+
+		try {
+			old.join(SEND_STOP_TIMEOUT);
+		} catch (InterruptedException e) {
+		}
+	}
+
 	static void start() {
 
 		queueOut.clear();
 
+		// a new session counts from the start
+		searchId = 0;
+		audioId = 0;
+
 		t = new Thread() {
 			public void run() {
 
+				// latest held back command and time of the last sent one
+				// by CONTINUOUS prefix
+				HashMap<String, String> held = new HashMap<String, String>();
+				HashMap<String, Long> sent = new HashMap<String, Long>();
+
+				ArrayList<String> batch = new ArrayList<String>();
+				boolean destroy = false;
+
 				// send command
 
-				while (outToServer != null) {
+				while (outToServer != null && !destroy) {
 					try {
-						parameter = queueOut.take();
+						String first;
+
+						if (held.isEmpty())
+							first = queueOut.take();
+						else
+							first = queueOut.poll(nextRelease(held, sent),
+									TimeUnit.MILLISECONDS);
+
+						batch.clear();
+
+						if (first != null) {
+							batch.add(first);
+							queueOut.drainTo(batch);
+						}
 					} catch (InterruptedException e1) {
 						e1.printStackTrace();
 
@@ -37,12 +200,50 @@ public class SendClass {
 						break;
 					}
 
-					if (parameter.equals("destroy"))
-						break;
-
 					try {
-						outToServer.writeBytes(parameter);
+						long now = System.currentTimeMillis();
+
+						for (int i = 0; i < batch.size() && !destroy; i++) {
+							parameter = batch.get(i);
+
+							if (parameter.equals("destroy")) {
+								destroy = true;
+								break;
+							}
 
+							String prefix = continuousPrefix(parameter);
+
+							if (prefix == null)
+								write(parameter);
+							else {
+								Long last = sent.get(prefix);
+
+								if (last != null
+										&& now - last < CONTINUOUS_INTERVAL)
+									held.put(prefix, parameter);
+								else {
+									held.remove(prefix);
+									write(parameter);
+									sent.put(prefix, now);
+								}
+							}
+						}
+
+						// held back values whose interval has passed
+						Iterator<Map.Entry<String, String>> it = held
+								.entrySet().iterator();
+
+						while (it.hasNext() && !destroy) {
+							Map.Entry<String, String> entry = it.next();
+
+							if (now - sent.get(entry.getKey()) >= CONTINUOUS_INTERVAL) {
+								write(entry.getValue());
+								sent.put(entry.getKey(), now);
+								it.remove();
+							}
+						}
+
+						outToServer.flush();
 					} catch (IOException e) {
 						e.printStackTrace();
 
@@ -67,4 +268,38 @@ public class SendClass {
 		t.start();
 	}
 
+	/**
+	 * newline terminated, the server splits commands that arrive together
+	 */
+	private static void write(String command) throws IOException {
+		outToServer.writeBytes(command + "\n");
+	}
+
+	/**
+	 * @return prefix of a command that only sets a value, null for other
+	 *         commands
+	 */
+	private static String continuousPrefix(String command) {
+		for (int i = 0; i < CONTINUOUS.length; i++) {
+			if (command.startsWith(CONTINUOUS[i]))
+				return CONTINUOUS[i];
+		}
+
+		return null;
+	}
+
+	/**
+	 * @return milliseconds until the first held back command may be sent
+	 */
+	private static long nextRelease(HashMap<String, String> held,
+			HashMap<String, Long> sent) {
+		long now = System.currentTimeMillis();
+		long wait = CONTINUOUS_INTERVAL;
+
+		for (String prefix : held.keySet())
+			wait = Math.min(wait, sent.get(prefix) + CONTINUOUS_INTERVAL - now);
+
+		return Math.max(wait, 1);
+	}
+
 }
@@ -0,0 +1,261 @@
+package com.RemoteControl;
+
+import java.io.IOException;
+import java.net.DatagramPacket;
+import java.net.DatagramSocket;
+import java.net.InetAddress;
+import java.net.InetSocketAddress;
+import java.net.Socket;
+import java.net.SocketException;
+import java.net.SocketTimeoutException;
+
+import android.content.SharedPreferences;
+import android.preference.PreferenceManager;
+
+/**
+ * Finds the server when its address has changed, e.g. after the phone or
+ * the PC moved to another access point. The probe is broadcast to the UDP
+ * port with the number of the server port, every server answers with
+ * RemoteControl_<port>_<protocol>_<server id>.
+ * 
+ * connect races a connect to the last server that was reached against the
+ * discovery, so a reconnect to a known server doesn't wait for the timeout
+ * of the settings.
+ */
+public class ServerDiscovery extends Thread {
+
+	static final String PROBE = "RemoteControl_discover";
+	static final String ANSWER = "RemoteControl_";
+
+	// milliseconds a connect to the last server or a discovered one may take
+	static final int DIRECT_TIMEOUT = 150;
+
+	// milliseconds the answers are waited for, counted from the probe
+	static final int DISCOVERY_TIMEOUT = 500;
+
+	// probes sent, datagrams may be lost
+	static final int PROBES = 2;
+
+	private final int port;
+	private final String serverId;
+
+	private DatagramSocket socket = null;
+
+	// first answer, the one of serverId if it came in time
+	private InetSocketAddress found = null;
+	private String foundId = null;
+	private boolean done = false;
+
+	private ServerDiscovery(int port, String serverId) {
+		this.port = port;
+		this.serverId = serverId;
+	}
+
+	/**
+	 * Connects to the server, first to the last one reached and to the
+	 * discovered one while the discovery runs.
+	 * 
+	 * @param configured
+	 *            address of the settings, used if no server was reached
+	 *            before
+	 * @return connected socket, null if neither answered in time. the caller
+	 *         then connects to the configured address with its timeout
+	 */
+	public static Socket connect(InetSocketAddress configured) {
+		SharedPreferences prefs = preferences();
+
+		InetSocketAddress last = configured;
+		String lastAddress = prefs.getString("endpoint_address", null);
+
+		if (lastAddress != null)
+			last = new InetSocketAddress(lastAddress, prefs.getInt(
+					"endpoint_port", configured.getPort()));
+
+		ServerDiscovery discovery = new ServerDiscovery(configured.getPort(),
+				prefs.getString("endpoint_id", null));
+		discovery.start();
+
+		Socket socket = tryConnect(last);
+
+		if (socket == null) {
+			InetSocketAddress address = discovery.await();
+
+			if (address != null && !address.equals(last))
+				socket = tryConnect(address);
+
+			if (socket != null)
+				remember(address, discovery.foundId);
+		}
+
+		discovery.cancel();
+
+		return socket;
+	}
+
+	/**
+	 * Keeps the server for the next connect.
+	 * 
+	 * @param address
+	 *            address and port of the server
+	 * @param id
+	 *            server id of the discovery, null to keep the last one
+	 */
+	public static void remember(InetSocketAddress address, String id) {
+		if (address == null || address.getAddress() == null)
+			return;
+
+		SharedPreferences.Editor editor = preferences().edit();
+
+		editor.putString("endpoint_address", address.getAddress()
+				.getHostAddress());
+		editor.putInt("endpoint_port", address.getPort());
+
+		if (id != null)
+			editor.putString("endpoint_id", id);
+
+		editor.commit();
+	}
+
+	private static SharedPreferences preferences() {
+		return PreferenceManager.getDefaultSharedPreferences(main
+				.getActivity().getBaseContext());
+	}
+
+	private static Socket tryConnect(InetSocketAddress address) {
+		if (address.isUnresolved())
+			return null;
+
+		Socket socket = new Socket();
+
+		try {
+			socket.connect(address, DIRECT_TIMEOUT);
+
+			return socket;
+		} catch (IOException e) {
+			try {
+				socket.close();
+			} catch (IOException e1) {
+			}
+
+			return null;
+		}
+	}
+
+	/**
+	 * Waits for the answers.
+	 * 
+	 * @return address of the server of the last connection or of the first
+	 *         that answered, null if none answered
+	 */
+	private synchronized InetSocketAddress await() {
+		while (!done) {
+			try {
+				wait();
+			} catch (InterruptedException e) {
+				return found;
+			}
+		}
+
+		return found;
+	}
+
+	private void cancel() {
+		DatagramSocket s;
+
+		synchronized (this) {
+			done = true;
+			s = socket;
+
+			notifyAll();
+		}
+
+		// the blocking receive returns
+		if (s != null)
+			s.close();
+	}
+
+	private synchronized void finish() {
+		done = true;
+
+		notifyAll();
+	}
+
+	@Override
+	public void run() {
+		DatagramSocket s;
+
+		try {
+			s = new DatagramSocket();
+			s.setBroadcast(true);
+		} catch (SocketException e) {
+			finish();
+			return;
+		}
+
+		synchronized (this) {
+			if (done) {
+				s.close();
+				return;
+			}
+
+			socket = s;
+		}
+
+		try {
+			byte[] probe = PROBE.getBytes("US-ASCII");
+			InetAddress broadcast = InetAddress.getByName("255.255.255.255");
+
+			for (int i = 0; i < PROBES; i++)
+				s.send(new DatagramPacket(probe, probe.length, broadcast, port));
+
+			long end = System.currentTimeMillis() + DISCOVERY_TIMEOUT;
+			byte[] buffer = new byte[256];
+
+			while (true) {
+				long left = end - System.currentTimeMillis();
+
+				if (left <= 0)
+					break;
+
+				DatagramPacket packet = new DatagramPacket(buffer,
+						buffer.length);
+
+				s.setSoTimeout((int) left);
+				s.receive(packet);
+
+				String answer = new String(buffer, 0, packet.getLength(),
+						"UTF-8");
+
+				if (!answer.startsWith(ANSWER))
+					continue;
+
+				// port_protocol_id, the id may contain underscores
+				String[] fields = answer.substring(ANSWER.length()).split(
+						"_", 3);
+
+				if (fields.length < 3)
+					continue;
+
+				int serverPort = Integer.parseInt(fields[0]);
+
+				synchronized (this) {
+					if (found == null || fields[2].equals(serverId)) {
+						found = new InetSocketAddress(packet.getAddress(),
+								serverPort);
+						foundId = fields[2];
+					}
+
+					if (serverId == null || fields[2].equals(serverId))
+						break;
+				}
+			}
+		} catch (SocketTimeoutException e) {
+		} catch (IOException e) {
+		} catch (NumberFormatException e) {
+		} finally {
+			s.close();
+
+			finish();
+		}
+	}
+}
@@ -11,16 +11,44 @@ public class Settings {
 	// ///////////// PLAYBACK /////////////
 	static String[] listoptions = { "Server IP address", "Server Port",
 			"Timeout [ms]", "Auto Login", "Display behavior",
-			"Pause playback on incoming call" };
-	static Object[] liststatus = { "", "", "", false, "", true };
+			"Pause playback on incoming call", "Encrypt connection (TLS)" };
+	static Object[] liststatus = { "", "", "", false, "", true, false };
 
 	static volatile int playlistlength = 0;
 	static volatile int playlistPosition = 0;
 
 	static volatile List<Object> Queue = new LinkedList<Object>();
 
+	// ///////////// SESSION /////////////
+	// journal position of the server, a dropped connection resumes from it.
+	// null if the server doesn't journal or the user has disconnected
+	static volatile String resumeEpoch = null;
+	static volatile int resumeSequence = 0;
+
 	// ///////////// PLAYLIST ELEMENTS /////////////////
-	static volatile PlaylistElement[] playlist = null;
+	static volatile PlaylistPages playlist = null;
+
+	// grouping shown instead of the titles, null for the plain playlist
+	static volatile PlaylistGroups groups = null;
+
+	// the server confirmed protocol_2 or protocol_3, only then it streams
+	// audio to the phone
+	static volatile boolean framed = false;
+
+	// number of titles fetched with one playlist_range_ request, the page
+	// size of the playlist
+	static final int PLAYLIST_RANGE = 100;
+
+	// width and height of the cover of a playlist row in dp, see listview.xml
+	static final int THUMBNAIL_DP = 50;
+
+	// format the playlist thumbnails are requested in with covers_: 0 jpeg,
+	// 1 raw RGB565 or 2 raw ARGB8888 pixels, which are copied into bitmaps
+	// without a decoder, see CoverReader.readThumbnail
+	static final int THUMBNAIL_JPEG = 0;
+	static final int THUMBNAIL_RGB565 = 1;
+	static final int THUMBNAIL_ARGB8888 = 2;
+	static final int THUMBNAIL_FORMAT = THUMBNAIL_RGB565;
 
 	// ///////////// DISPLAY METRICS /////////////
 	static volatile DisplayMetrics dm;
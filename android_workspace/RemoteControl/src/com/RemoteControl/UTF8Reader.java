@@ -7,7 +7,9 @@ import java.io.InputStream;
 public class UTF8Reader {
 
 	/**
-	 * Reads UTF-8 character data; lines are terminated with '\n'.
+	 * Reads UTF-8 character data; lines are terminated with '\n'. A
+	 * LineInputStream splits the line in its buffer, other streams are read
+	 * byte by byte.
 	 * 
 	 * @param in
 	 *            InputStream to read from
@@ -17,6 +19,9 @@ public class UTF8Reader {
 	 */
 	public static synchronized String readLine(InputStream in)
 			throws IOException {
+		if (in instanceof LineInputStream)
+			return ((LineInputStream) in).readLine();
+
 		ByteArrayOutputStream buffer = new ByteArrayOutputStream();
 		while (true) {
 			int b = in.read();
@@ -3,6 +3,7 @@ package com.RemoteControl;
 import com.RemoteControl.RemoteControlOverview.UpdateTimeTask;
 import com.RemoteControl.R;
 
+import java.io.BufferedOutputStream;
 import java.io.DataOutputStream;
 import java.io.IOException;
 import java.io.InputStream;
@@ -25,7 +26,6 @@ import android.content.pm.ActivityInfo;
 import android.content.pm.PackageInfo;
 import android.content.pm.PackageManager.NameNotFoundException;
 import android.content.res.Resources;
-import android.graphics.Bitmap;
 import android.net.Uri;
 import android.os.Build;
 import android.os.Bundle;
@@ -85,6 +85,8 @@ public class main extends TabActivity implements OnClickListener,
 
 	private static CoverReader coverReader = new CoverReader();
 
+	private static AudioPlayer audioPlayer = new AudioPlayer();
+
 	private static Thread receiveThread;
 
 	private static PlaybackSettings playbackSettings;
@@ -173,6 +175,12 @@ public class main extends TabActivity implements OnClickListener,
 
 		// set listeners
 		setlisteners();
+
+		// replay of a server capture, see ReplayBenchmark
+		String capture = getIntent().getStringExtra("benchmark");
+
+		if (capture != null)
+			new Thread(new ReplayBenchmark(capture)).start();
 	}
 
 	private void setlisteners() {
@@ -308,11 +316,17 @@ public class main extends TabActivity implements OnClickListener,
 
 		// check socket
 
-		setSocket(new Socket());
+		// the last server or a discovered one, the configured address with
+		// the timeout of the settings if none answers at once
+		Socket quick = sockaddr == null ? null : ServerDiscovery
+				.connect((InetSocketAddress) sockaddr);
+
+		setSocket(quick != null ? quick : new Socket());
 
 		try {
-			getSocket().connect(sockaddr,
-					Integer.parseInt((String) Settings.liststatus[2]));
+			if (quick == null)
+				getSocket().connect(sockaddr,
+						Integer.parseInt((String) Settings.liststatus[2]));
 		} catch (SocketTimeoutException e) {
 			e.printStackTrace();
 
@@ -361,9 +375,37 @@ public class main extends TabActivity implements OnClickListener,
 			getErrorClassHandler().post(ErrorMessagesClass.conversion_error);
 		}
 
+		if (quick == null && getSocket().isConnected())
+			ServerDiscovery.remember((InetSocketAddress) getSocket()
+					.getRemoteSocketAddress(), null);
+
+		// encrypted connection, the server detects the TLS handshake
+		if (Settings.liststatus[6].equals(true)) {
+			try {
+				setSocket(SecureChannel.wrap(getSocket(),
+						Integer.parseInt((String) Settings.liststatus[2])));
+			} catch (Exception e) {
+				e.printStackTrace();
+
+				try {
+					getSocket().close();
+				} catch (Exception e1) {
+					e1.printStackTrace();
+				}
+
+				getConnect_dialog().dismiss();
+				getErrorClassHandler().post(ErrorMessagesClass.tls_error);
+
+				setSocket(null);
+
+				return 1;
+			}
+		}
+
 		try {
-			SendClass.outToServer = new DataOutputStream(getSocket()
-					.getOutputStream());
+			SendClass.outToServer = new DataOutputStream(
+					new BufferedOutputStream(getSocket().getOutputStream(),
+							SendClass.SEND_BUFFER));
 			SendClass.start();
 		} catch (IOException e) {
 			e.printStackTrace();
@@ -377,7 +419,7 @@ public class main extends TabActivity implements OnClickListener,
 		}
 
 		try {
-			setInputStream(getSocket().getInputStream());
+			setInputStream(new LineInputStream(getSocket().getInputStream()));
 		} catch (IOException e) {
 			e.printStackTrace();
 
@@ -389,6 +431,43 @@ public class main extends TabActivity implements OnClickListener,
 			return 1;
 		}
 
+		// ///////////////////////////////// PROTOCOL
+		// ///////////////////////////////////////
+		// servers with framing confirm with protocol_3 (compressed text) or
+		// protocol_2, older servers ignore the requests and start with the
+		// playlist length. a dropped connection asks to resume first, see
+		// synchronize
+
+		if (Settings.resumeEpoch != null)
+			SendClass.queueOut.add("resume_" + Settings.resumeEpoch + "_"
+					+ Settings.resumeSequence);
+
+		SendClass.queueOut.add("protocol_3");
+		SendClass.queueOut.add("protocol_2");
+
+		try {
+			String first = UTF8Reader.readLine(getInputStream());
+
+			Settings.framed = first.equals("protocol_3")
+					|| first.equals("protocol_2");
+
+			// the frames are read from the buffer of the socket
+			if (Settings.framed)
+				setInputStream(new LineInputStream(new FrameInputStream(
+						getInputStream())));
+			else
+				((LineInputStream) getInputStream()).unreadLine();
+		} catch (IOException e) {
+			e.printStackTrace();
+
+			getConnect_dialog().dismiss();
+			getErrorClassHandler().post(ErrorMessagesClass.reader_error);
+
+			getActivity().disconnect();
+
+			return 1;
+		}
+
 		return 0;
 	}
 
@@ -471,6 +550,38 @@ public class main extends TabActivity implements OnClickListener,
 		RemoteControlOverview.WinampSettingsHandler
 				.post(RemoteControlOverview.Synchronizing);
 
+		// ///////////////////////////////// RESUMED
+		// ///////////////////////////////////////
+
+		// the server replays the missed broadcasts after
+		// resumed_<epoch>_<sequence>, the state of the last connection stays
+
+		String first;
+
+		try {
+			first = UTF8Reader.readLine(getInputStream());
+		} catch (IOException e) {
+			first = null;
+		}
+
+		if (first != null && first.startsWith("resumed_")) {
+			setResumeToken(first.substring(8));
+
+			receiveThread = new Thread(new ReceiveClass());
+			receiveThread.start();
+
+			// the new session of the server knows no cover options
+			DisplayMetrics metrics = getActivity().getResources()
+					.getDisplayMetrics();
+			SendClass.queueOut.addAll(getCoverReader().coverOptions(
+					Math.max(metrics.widthPixels, metrics.heightPixels)));
+
+			return 0;
+		}
+
+		if (first != null)
+			((LineInputStream) getInputStream()).unreadLine();
+
 		// ///////////////////////////////// create new coverHashMap
 		// ///////////////////////////////////////
 
@@ -495,40 +606,23 @@ public class main extends TabActivity implements OnClickListener,
 			getErrorClassHandler().post(ErrorMessagesClass.conversion_error);
 		}
 
-		Settings.playlist = new PlaylistElement[Settings.playlistlength];
-
 		// ///////////////////////////////// PLAYLIST
 		// ///////////////////////////////////////
 
-		int i, tmpCoverLength;
-		CharSequence tmpMessage = null;
-		Bitmap tmpCover;
+		// titles are requested in pages of Settings.PLAYLIST_RANGE when
+		// they are displayed, see PlaylistPages
 
-		for (i = 0; i < Settings.playlistlength; i++) {
-			try {
-				// read cover
-				tmpMessage = UTF8Reader.readLine(getInputStream());
+		int tmpCoverLength;
 
-				tmpMessage = tmpMessage.subSequence(12, tmpMessage.length());
-				tmpCoverLength = Integer.parseInt(tmpMessage.toString());
+		// the titles of the last connection are shown again if the
+		// fingerprint of the server's playlist matches them
+		Settings.playlist = PlaylistPages.afterSync(Settings.playlistlength);
 
-				tmpCover = getCoverReader().readCover(tmpCoverLength, true);
+		// the chosen grouping stays, its groups are requested again
+		PlaylistGroups groups = Settings.groups;
 
-				// create new playlist element
-				Settings.playlist[i] = new PlaylistElement(
-						UTF8Reader.readLine(getInputStream()), i, tmpCover);
-
-			} catch (IOException e) {
-				e.printStackTrace();
-
-				getConnect_dialog().dismiss();
-				getErrorClassHandler().post(ErrorMessagesClass.reader_error);
-
-				getActivity().disconnect();
-
-				return 1;
-			}
-		}
+		if (groups != null)
+			Settings.groups = new PlaylistGroups(groups.mode());
 
 		// ///////////////////////////////// REPEAT
 		// ///////////////////////////////////////
@@ -867,7 +961,8 @@ public class main extends TabActivity implements OnClickListener,
 		// COVER
 
 		try {
-			tmpCover = getCoverReader().readCover(tmpCoverLength, false);
+			getCoverReader().readCover(tmpCoverLength, null,
+					RemoteControlOverview.coverTarget);
 		} catch (IOException e) {
 			e.printStackTrace();
 
@@ -879,20 +974,20 @@ public class main extends TabActivity implements OnClickListener,
 			return 1;
 		}
 
-		if (tmpCover != null) {
-			RemoteControlOverview.cover = tmpCover;
-
-			RemoteControlOverview.WinampSettingsHandler
-					.post(RemoteControlOverview.SetCover);
-
-		} else
-			RemoteControlOverview.WinampSettingsHandler
-					.post(RemoteControlOverview.SetEmptyCover);
-
 		// start listening for commands
 		receiveThread = new Thread(new ReceiveClass());
 		receiveThread.start();
 
+		// downscaled covers from now on, the server skips the cached ones
+		DisplayMetrics metrics = getActivity().getResources()
+				.getDisplayMetrics();
+		SendClass.queueOut.addAll(getCoverReader().coverOptions(
+				Math.max(metrics.widthPixels, metrics.heightPixels)));
+
+		// titles around the current position first
+		RemoteControlPlaylist.requestRange(Settings.playlistPosition);
+		RemoteControlPlaylist.requestRange(0);
+
 		try {
 			RemoteControlPlaylist.viewHandler
 					.post(RemoteControlPlaylist.initialize);
@@ -908,6 +1003,49 @@ public class main extends TabActivity implements OnClickListener,
 
 	}
 
+	/**
+	 * Keeps the journal position of the server.
+	 * 
+	 * @param token
+	 *            <epoch>_<sequence>
+	 */
+	static void setResumeToken(String token) {
+		int separator = token.lastIndexOf('_');
+
+		try {
+			Settings.resumeSequence = Integer.parseInt(token
+					.substring(separator + 1));
+			Settings.resumeEpoch = token.substring(0, separator);
+		} catch (Exception e) {
+			Settings.resumeEpoch = null;
+		}
+	}
+
+	/**
+	 * Connects again after the connection has been dropped and keeps the
+	 * state. the server replays the broadcasts after the last journal
+	 * position or synchronizes the client like on a new connect
+	 */
+	static void resume() {
+		try {
+			getSocket().close();
+		} catch (Exception e) {
+		}
+
+		setSocket(null);
+		SendClass.outToServer = null;
+		SendClass.stop();
+
+		Thread t = new Thread() {
+			public void run() {
+				// the server is gone, clear everything
+				if (connect() != 0 || synchronize() != 0)
+					getActivity().disconnect();
+			}
+		};
+		t.start();
+	}
+
 	protected void ReceiveThread() {
 
 		Thread ReceiveThread = new Thread() {
@@ -973,6 +1111,9 @@ public class main extends TabActivity implements OnClickListener,
 	};
 
 	int disconnect() {
+		// a disconnect of the user isn't resumed
+		Settings.resumeEpoch = null;
+
 		try {
 			RemoteControlOverview.timertask.cancel();
 			RemoteControlOverview.timertask.cancel = true;
@@ -1023,8 +1164,18 @@ public class main extends TabActivity implements OnClickListener,
 		RemoteControlOverview.seekbarProgress.setProgress(0);
 		RemoteControlOverview.seekbarProgress.setSecondaryProgress(0);
 
+		PlaylistPages.store(Settings.playlist);
 		Settings.playlist = null;
 		Settings.playlistlength = 0;
+
+		audioPlayer.disconnected();
+		Settings.framed = false;
+
+		PlaylistGroups groups = Settings.groups;
+
+		if (groups != null)
+			Settings.groups = new PlaylistGroups(groups.mode());
+
 		Settings.playlistPosition = 0;
 		Settings.Queue.clear();
 
@@ -1375,6 +1526,10 @@ public class main extends TabActivity implements OnClickListener,
 		return coverReader;
 	}
 
+	public static AudioPlayer getAudioPlayer() {
+		return audioPlayer;
+	}
+
 	public static void setActivity(main input) {
 		activity = input;
 	}
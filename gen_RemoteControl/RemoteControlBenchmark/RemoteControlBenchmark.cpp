@@ -0,0 +1,1239 @@
+// RemoteControlBenchmark: load generator for the RemoteControl server. simulates clients of the text protocol
+// that synchronize and then send bursts of playlist_range_ and trackInfo_ commands, and reports the latencies.
+//
+// usage: RemoteControlBenchmark <host> [port] [clients] [bursts] [ranges per burst] [track infos per burst]
+//        RemoteControlBenchmark /dashboard <host> [port] [clients] [seconds] [level frames per second]
+//        RemoteControlBenchmark /playlist <folder> <count> <sample file>
+//
+// the second form simulates always-on dashboards: the clients request level meter frames and only receive them and the
+// progress events, winamp has to play. it reports the gaps between the frames and the socket backend of the server,
+// run it once with each value of the riotransport setting to compare Registered I/O with the completion port.
+// the third form creates a synthetic playlist: count copies of a sample file and an m3u to load in winamp
+//
+// usage: RemoteControlBenchmark /queue [max producers] [bursts per producer]
+//
+// the queue form runs without the server. it compares designs of the tasklist with 1 to max producers that simulate the
+// bursts of MainWndProc: the FIFO the tasklist had, the coalescing queue of priority classes it has now and a lock-free
+// ring. it reports the time a producer spends in push, the wait of the elements that had to wake the consumer, the
+// wait of all elements and the throughput. the coalescing queue delivers fewer elements, replaced state events aren't sent
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#include <process.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <algorithm>
+
+#pragma comment(lib, "ws2_32.lib")
+
+// bytes read with one recv
+#define RECEIVE_BUFFER_SIZE 65536
+
+// titles requested with one playlist_range_ command
+#define RANGE_SIZE 50
+
+// milliseconds without data until a response counts as lost
+#define RESPONSE_TIMEOUT 10000
+
+// elements of the lock-free ring of the queue form, a power of 2
+#define RING_SIZE 8192
+
+// queue form: volume_ events of one volume drag and songs of one next-song storm
+#define DRAG_EVENTS 40
+#define STORM_SONGS 10
+
+
+struct Options {
+	std::string host;
+	int port;
+	int clients;
+	int bursts;
+	int ranges;
+	int trackInfos;
+
+	// dashboard clients instead of bursts
+	bool dashboard;
+	int seconds;
+	int levelsRate;
+};
+
+// one simulated client, only used by its own thread
+struct Client {
+	SOCKET socket;
+
+	char buffer[RECEIVE_BUFFER_SIZE];
+	int start;
+	int end;
+
+	int playlistLength;
+
+	// milliseconds
+	std::vector<double> sync;
+	std::vector<double> range;
+	std::vector<double> trackInfo;
+
+	// dashboard: milliseconds between two level frames, number of frames and progress events
+	std::vector<double> frameGap;
+	int frames;
+	int progress;
+
+	LONGLONG bytes;
+	int lost;
+	bool failed;
+};
+
+// one element of the queue form
+struct QueueItem {
+	std::string element;
+	int session;
+
+	// name of a state event, empty for commands. only the coalescing queue uses it
+	std::string key;
+
+	// microseconds of now when the producer has inserted it
+	double queued;
+};
+
+// a design of the tasklist. pop blocks until there is an element and tells if the consumer had to be woken for it
+class BenchmarkQueue {
+	public:
+		virtual ~BenchmarkQueue() {}
+
+		virtual void push(const std::string & element, const int & session) = 0;
+		virtual void pop(QueueItem & item, bool & woken) = 0;
+};
+
+// one producer thread of the queue form, only used by its own thread
+struct Producer {
+	BenchmarkQueue *queue;
+	int bursts;
+	int session;
+
+	// microseconds spent in push
+	std::vector<double> enqueue;
+	int pushed;
+};
+
+// the consumer thread of the queue form
+struct Consumer {
+	BenchmarkQueue *queue;
+
+	// microseconds from the insert until the consumer has taken it, of all elements and of the ones it was woken for
+	std::vector<double> wait;
+	std::vector<double> wakeup;
+
+	int delivered;
+
+	// milliseconds of now when "quit" was taken
+	double finished;
+};
+
+
+static Options options;
+static HANDLE startEvent;
+static LARGE_INTEGER frequency;
+
+
+/**
+* \brief	now
+*
+* \return	milliseconds of the performance counter
+*/
+static double now() {
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+
+	return (double)counter.QuadPart * 1000.0 / (double)frequency.QuadPart;
+}
+
+/**
+* \brief	fill
+*
+* receives more data into the buffer of a client
+*
+* \param	client	client
+*
+* \return	false if the connection is closed or no data arrived in time
+*/
+static bool fill(Client & client) {
+	if (client.start == client.end)
+		client.start = client.end = 0;
+	else if (client.end == RECEIVE_BUFFER_SIZE) {
+		memmove(client.buffer, client.buffer + client.start, client.end - client.start);
+		client.end -= client.start;
+		client.start = 0;
+	}
+
+	int received = recv(client.socket, client.buffer + client.end, RECEIVE_BUFFER_SIZE - client.end, 0);
+
+	if (received <= 0)
+		return false;
+
+	client.end += received;
+	client.bytes += received;
+
+	return true;
+}
+
+/**
+* \brief	skip
+*
+* drops binary data that follows a coverLength_ line
+*
+* \param	client	client
+* \param	length	number of bytes
+*
+* \return	false if the connection has failed
+*/
+static bool skip(Client & client, long length) {
+	while (length > 0) {
+		if (client.start == client.end && !fill(client))
+			return false;
+
+		long available = client.end - client.start;
+		long used = available < length ? available : length;
+
+		client.start += used;
+		length -= used;
+	}
+
+	return true;
+}
+
+/**
+* \brief	sendLine
+*
+* sends a newline terminated command
+*
+* \param	client	client
+* \param	command	commands, several are separated by \n
+*
+* \return	false if the connection has failed
+*/
+static bool sendLine(Client & client, const std::string & command) {
+	std::string data = command + "\n";
+
+	return send(client.socket, data.c_str(), data.length(), 0) == (int)data.length();
+}
+
+/**
+* \brief	readLine
+*
+* reads the next line from the server. keep alive messages are answered, cover data is skipped
+*
+* \param	client	client
+* \param	line	receives the line without \n
+*
+* \return	false if the connection has failed or no data arrived in time
+*/
+static bool readLine(Client & client, std::string & line) {
+	while (true) {
+		char *newline = (char*)memchr(client.buffer + client.start, '\n', client.end - client.start);
+
+		if (newline == NULL) {
+			if (client.end - client.start == RECEIVE_BUFFER_SIZE)
+				client.start = client.end;	// longer than the buffer, dropped
+
+			if (!fill(client))
+				return false;
+
+			continue;
+		}
+
+		line.assign(client.buffer + client.start, newline);
+		client.start = (newline - client.buffer) + 1;
+
+		if (line.compare("alive") == 0) {
+			if (!sendLine(client, "alive"))
+				return false;
+
+			continue;
+		}
+
+		// binary cover data follows without line end
+		size_t cover = line.find("coverLength_");
+
+		if (cover != std::string::npos && !skip(client, atol(line.c_str() + cover + 12)))
+			return false;
+
+		return true;
+	}
+}
+
+/**
+* \brief	waitFor
+*
+* reads lines until one starts with prefix
+*
+* \param	client	client
+* \param	prefix	start of the line
+* \param	line	receives the line
+*
+* \return	false if the connection has failed or no data arrived in time
+*/
+static bool waitFor(Client & client, const char *prefix, std::string & line) {
+	while (readLine(client, line)) {
+		if (line.compare(0, strlen(prefix), prefix) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+/**
+* \brief	synchronize
+*
+* connects and waits until the synchronization of the text protocol has ended with the cover
+*
+* \param	client	client
+*
+* \return	false if the connection has failed
+*/
+static bool synchronize(Client & client) {
+	addrinfo hints;
+	ZeroMemory(&hints, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_protocol = IPPROTO_TCP;
+
+	char port[16];
+	sprintf_s(port, "%d", options.port);
+
+	addrinfo *address = NULL;
+
+	if (getaddrinfo(options.host.c_str(), port, &hints, &address) != 0)
+		return false;
+
+	double started = now();
+
+	client.socket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+	bool connected = client.socket != INVALID_SOCKET && connect(client.socket, address->ai_addr, address->ai_addrlen) == 0;
+
+	freeaddrinfo(address);
+
+	if (!connected)
+		return false;
+
+	DWORD timeout = RESPONSE_TIMEOUT;
+	setsockopt(client.socket, SOL_SOCKET, SO_RCVTIMEO, (char*)&timeout, sizeof(timeout));
+
+	BOOL noDelay = TRUE;
+	setsockopt(client.socket, IPPROTO_TCP, TCP_NODELAY, (char*)&noDelay, sizeof(noDelay));
+
+	// the first line of the synchronization is the playlist length
+	std::string line;
+
+	if (!readLine(client, line))
+		return false;
+
+	client.playlistLength = atoi(line.c_str());
+
+	// the cover ends the synchronization
+	if (!waitFor(client, "coverLength_", line))
+		return false;
+
+	client.sync.push_back(now() - started);
+
+	return true;
+}
+
+/**
+* \brief	burst
+*
+* sends playlist_range_ and trackInfo_ commands at once and measures each response from the time of sending
+*
+* \param	client	client
+*
+* \return	false if the connection has failed
+*/
+static bool burst(Client & client) {
+	int length = client.playlistLength > 0 ? client.playlistLength : 1;
+
+	std::string commands;
+
+	for (int i = 0; i < options.ranges; i++) {
+		char command[64];
+		sprintf_s(command, "playlist_range_%d_%d\n", rand() % length, RANGE_SIZE);
+		commands += command;
+	}
+
+	for (int i = 0; i < options.trackInfos; i++) {
+		char command[64];
+		sprintf_s(command, "trackInfo_%d\n", rand() % length);
+		commands += command;
+	}
+
+	double sent = now();
+
+	if (send(client.socket, commands.c_str(), commands.length(), 0) != (int)commands.length())
+		return false;
+
+	std::string line;
+
+	// responses arrive in order: first the ranges
+	for (int i = 0; i < options.ranges; i++) {
+		if (!waitFor(client, "playlist_range_", line))
+			return false;
+
+		const char *count = strchr(line.c_str() + 15, '_');
+		int titles = count != NULL ? atoi(count + 1) : 0;
+
+		for (int j = 0; j < titles; j++) {
+			if (!readLine(client, line))
+				return false;
+		}
+
+		client.range.push_back(now() - sent);
+	}
+
+	// track information ends with its cover. files without tags are not answered
+	for (int i = 0; i < options.trackInfos; i++) {
+		if (!waitFor(client, "track_coverLength_", line)) {
+			client.lost += options.trackInfos - i;
+
+			return WSAGetLastError() == WSAETIMEDOUT;
+		}
+
+		client.trackInfo.push_back(now() - sent);
+	}
+
+	return true;
+}
+
+/**
+* \brief	watch
+*
+* dashboard client: requests the level frames and receives them and the progress events for options.seconds
+*
+* \param	client	client
+*
+* \return	false if the connection has failed
+*/
+static bool watch(Client & client) {
+	char command[32];
+	sprintf_s(command, "levels_%d", options.levelsRate);
+
+	if (!sendLine(client, command))
+		return false;
+
+	std::string line;
+
+	double end = now() + options.seconds * 1000.0;
+	double last = 0;
+
+	while (now() < end) {
+		if (!readLine(client, line))
+			return false;
+
+		if (line.compare(0, 7, "levels_") == 0) {
+			double received = now();
+
+			if (last > 0)
+				client.frameGap.push_back(received - last);
+
+			last = received;
+			client.frames++;
+		} else if (line.compare(0, 9, "progress_") == 0)
+			client.progress++;
+	}
+
+	return sendLine(client, "levels_0");
+}
+
+/**
+* \brief	transport
+*
+* asks the server for its counters
+*
+* \param	client	connected client
+*
+* \return	the transport line of the stats, empty if the server doesn't report one
+*/
+static std::string transport(Client & client) {
+	std::string line;
+
+	if (!sendLine(client, "stats") || !waitFor(client, "stats_", line))
+		return "";
+
+	int count = atoi(line.c_str() + 6);
+
+	for (int i = 0; i < count; i++) {
+		if (!readLine(client, line))
+			break;
+
+		if (line.compare(0, 10, "transport ") == 0)
+			return line;
+	}
+
+	return "";
+}
+
+/**
+* \brief	clientFunction
+*
+* thread of one simulated client
+*
+* \param	parameter	Client
+*
+* \return	0
+*/
+static unsigned int __stdcall clientFunction(void *parameter) {
+	Client & client = *(Client*)parameter;
+
+	WaitForSingleObject(startEvent, INFINITE);
+
+	if (!synchronize(client))
+		client.failed = true;
+	else if (options.dashboard) {
+		client.failed = !watch(client);
+
+		sendLine(client, "destroy");
+	} else {
+		for (int i = 0; i < options.bursts && !client.failed; i++)
+			client.failed = !burst(client);
+
+		sendLine(client, "destroy");
+	}
+
+	if (client.socket != INVALID_SOCKET)
+		closesocket(client.socket);
+
+	return 0;
+}
+
+/**
+* \brief	printLatencies
+*
+* prints count, percentiles and maximum of a latency series
+*
+* \param	name	name of the series
+* \param	values	latencies in milliseconds, sorted
+*/
+static void printLatencies(const char *name, std::vector<double> & values) {
+	if (values.empty()) {
+		printf("%-10s %8d\n", name, 0);
+
+		return;
+	}
+
+	std::sort(values.begin(), values.end());
+
+	size_t last = values.size() - 1;
+
+	printf("%-10s %8u %9.2f %9.2f %9.2f %9.2f\n", name, values.size(), values[last * 50 / 100], values[last * 99 / 100],
+		values[last * 999 / 1000], values[last]);
+}
+
+/**
+* \brief	createPlaylist
+*
+* copies a sample file count times into a folder and writes an m3u playlist of the copies
+*
+* \param	folder	target folder, created if necessary
+* \param	count	number of entries
+* \param	sample	audio file with tags and cover
+*
+* \return	0 if success, 1 if error
+*/
+static int createPlaylist(const std::string & folder, const int & count, const std::string & sample) {
+	CreateDirectoryA(folder.c_str(), NULL);
+
+	size_t dot = sample.rfind('.');
+	std::string extension = dot != std::string::npos ? sample.substr(dot) : std::string(".mp3");
+
+	std::string playlistPath = folder + "\\benchmark.m3u";
+
+	FILE *playlist = NULL;
+
+	if (fopen_s(&playlist, playlistPath.c_str(), "w") != 0)
+		return 1;
+
+	fprintf(playlist, "#EXTM3U\n");
+
+	for (int i = 0; i < count; i++) {
+		char name[32];
+		sprintf_s(name, "\\track%06d", i);
+
+		std::string file = folder + name + extension;
+
+		if (CopyFileA(sample.c_str(), file.c_str(), FALSE) == FALSE) {
+			fclose(playlist);
+
+			return 1;
+		}
+
+		fprintf(playlist, "#EXTINF:180,Benchmark Artist %d - Benchmark Title %d\n%s\n", i % 100, i, file.c_str());
+	}
+
+	fclose(playlist);
+
+	printf("created %s with %d entries\n", playlistPath.c_str(), count);
+
+	return 0;
+}
+
+/**
+* \brief	FifoQueue
+*
+* the tasklist before the priority classes: one FIFO under a critical section, every push sets the auto-reset event
+*/
+class FifoQueue : public BenchmarkQueue {
+	private:
+		std::deque<QueueItem> list;
+
+		CRITICAL_SECTION cs_list;
+		HANDLE non_empty_list;
+	public:
+		FifoQueue() {
+			InitializeCriticalSection(&cs_list);
+			non_empty_list = CreateEvent(NULL, FALSE, FALSE, NULL);
+		}
+
+		~FifoQueue() {
+			CloseHandle(non_empty_list);
+			DeleteCriticalSection(&cs_list);
+		}
+
+		void push(const std::string & element, const int & session) {
+			QueueItem item;
+			item.element = element;
+			item.session = session;
+			item.queued = now() * 1000.0;
+
+			// CRITICAL
+			EnterCriticalSection(&cs_list);
+
+			list.push_back(item);
+
+			LeaveCriticalSection(&cs_list);
+			// CRITICAL END
+
+			SetEvent(non_empty_list);
+		}
+
+		void pop(QueueItem & item, bool & woken) {
+			woken = false;
+
+			for (;;) {
+				// CRITICAL
+				EnterCriticalSection(&cs_list);
+
+				bool found = !list.empty();
+
+				if (found) {
+					item = list.front();
+					list.pop_front();
+				}
+
+				LeaveCriticalSection(&cs_list);
+				// CRITICAL END
+
+				if (found)
+					return;
+
+				WaitForSingleObject(non_empty_list, INFINITE);
+				woken = true;
+			}
+		}
+};
+
+/**
+* \brief	CoalescingQueue
+*
+* the shipped TaskList: a FIFO per priority class, a waiting state event of the same name and session is replaced by
+* the new one. producers only wake the consumer when the list was empty, the consumer signals the next element itself
+*/
+class CoalescingQueue : public BenchmarkQueue {
+	private:
+		std::deque<QueueItem> lists[3];
+
+		CRITICAL_SECTION cs_list;
+		HANDLE non_empty_list;
+
+		bool isEmpty() const {
+			return lists[0].empty() && lists[1].empty() && lists[2].empty();
+		}
+
+		// the names of TaskList::stateKey and TaskList::priority the producers use
+		static std::string stateKey(const std::string & element) {
+			static const char *states[] = { "isplaying_", "playlistPosition_", "samplerate_", "bitrate_", "length_", "title_", "volume_" };
+
+			for (unsigned int i = 0; i < sizeof(states) / sizeof(states[0]); i++) {
+				if (element.compare(0, strlen(states[i]), states[i]) == 0)
+					return std::string(states[i]);
+			}
+
+			return std::string();
+		}
+
+		static int priority(const std::string & element) {
+			if (element.compare(0, 12, "trackFields_") == 0)
+				return 1;
+			if (element.compare("cover") == 0)
+				return 2;
+
+			return 0;
+		}
+	public:
+		CoalescingQueue() {
+			InitializeCriticalSection(&cs_list);
+			non_empty_list = CreateEvent(NULL, FALSE, FALSE, NULL);
+		}
+
+		~CoalescingQueue() {
+			CloseHandle(non_empty_list);
+			DeleteCriticalSection(&cs_list);
+		}
+
+		void push(const std::string & element, const int & session) {
+			QueueItem item;
+			item.element = element;
+			item.session = session;
+			item.key = stateKey(element);
+
+			std::deque<QueueItem> & list = lists[priority(element)];
+
+			// CRITICAL
+			EnterCriticalSection(&cs_list);
+
+			bool wake = isEmpty();
+
+			if (!item.key.empty()) {
+				std::deque<QueueItem>::iterator it = list.begin();
+
+				while (it != list.end()) {
+					if (it->session == item.session && it->key == item.key)
+						it = list.erase(it);
+					else
+						it++;
+				}
+			}
+
+			item.queued = now() * 1000.0;
+			list.push_back(item);
+
+			LeaveCriticalSection(&cs_list);
+			// CRITICAL END
+
+			if (wake)
+				SetEvent(non_empty_list);
+		}
+
+		void pop(QueueItem & item, bool & woken) {
+			woken = false;
+
+			for (;;) {
+				// CRITICAL
+				EnterCriticalSection(&cs_list);
+
+				bool found = !isEmpty();
+
+				if (found) {
+					std::deque<QueueItem> *list = lists;
+
+					while (list->empty())
+						list++;
+
+					item = list->front();
+					list->pop_front();
+
+					if (!isEmpty())
+						SetEvent(non_empty_list);
+				}
+
+				LeaveCriticalSection(&cs_list);
+				// CRITICAL END
+
+				if (found)
+					return;
+
+				WaitForSingleObject(non_empty_list, INFINITE);
+				woken = true;
+			}
+		}
+};
+
+/**
+* \brief	RingQueue
+*
+* bounded lock-free ring of several producers and one consumer. a producer claims a slot with a compare exchange of the
+* tail and publishes it with the sequence of the slot. the consumer sleeps on an event after it has announced it, only a
+* producer that sees the announcement sets the event. a full ring makes the producers yield
+*/
+class RingQueue : public BenchmarkQueue {
+	private:
+		struct Slot {
+			volatile LONG sequence;
+			QueueItem item;
+		};
+
+		Slot *slots;
+
+		volatile LONG tail;
+		LONG head;
+
+		volatile LONG sleeping;
+		HANDLE wakeup;
+	public:
+		// pushes that found the ring full
+		volatile LONG full;
+
+		RingQueue() : tail(0), head(0), sleeping(0), full(0) {
+			slots = new Slot[RING_SIZE];
+
+			for (LONG i = 0; i < RING_SIZE; i++)
+				slots[i].sequence = i;
+
+			wakeup = CreateEvent(NULL, FALSE, FALSE, NULL);
+		}
+
+		~RingQueue() {
+			CloseHandle(wakeup);
+			delete[] slots;
+		}
+
+		void push(const std::string & element, const int & session) {
+			LONG position;
+			Slot *slot;
+
+			for (;;) {
+				position = tail;
+				slot = &slots[position & (RING_SIZE - 1)];
+
+				LONG difference = slot->sequence - position;
+
+				if (difference == 0) {
+					if (InterlockedCompareExchange(&tail, position + 1, position) == position)
+						break;
+				} else if (difference < 0) {
+					// the consumer hasn't taken the element a lap before
+					InterlockedIncrement(&full);
+					SwitchToThread();
+				}
+			}
+
+			slot->item.element = element;
+			slot->item.session = session;
+			slot->item.queued = now() * 1000.0;
+
+			// publish, then look for a sleeping consumer. the consumer announces itself before it looks again
+			InterlockedExchange(&slot->sequence, position + 1);
+
+			if (sleeping != 0 && InterlockedExchange(&sleeping, 0) != 0)
+				SetEvent(wakeup);
+		}
+
+		void pop(QueueItem & item, bool & woken) {
+			woken = false;
+
+			Slot & slot = slots[head & (RING_SIZE - 1)];
+
+			while (slot.sequence != head + 1) {
+				InterlockedExchange(&sleeping, 1);
+
+				if (slot.sequence == head + 1) {
+					InterlockedExchange(&sleeping, 0);
+					break;
+				}
+
+				WaitForSingleObject(wakeup, INFINITE);
+				woken = true;
+			}
+
+			item.element.swap(slot.item.element);
+			item.session = slot.item.session;
+			item.queued = slot.item.queued;
+
+			// free the slot for the producers of the next lap
+			InterlockedExchange(&slot.sequence, head + RING_SIZE);
+			head++;
+		}
+};
+
+/**
+* \brief	timedPush
+*
+* pushes an element and records the time the producer has spent in push
+*
+* \param	producer	producer
+* \param	element		element
+*/
+static void timedPush(Producer & producer, const std::string & element) {
+	double start = now();
+
+	producer.queue->push(element, producer.session);
+
+	producer.enqueue.push_back((now() - start) * 1000.0);
+	producer.pushed++;
+}
+
+/**
+* \brief	producerFunction
+*
+* thread of one producer. simulates MainWndProc: volume drags, one volume_ per mouse move, alternate with next-song
+* storms, the state events, file information and cover of every skipped song. the window is idle between two bursts
+*
+* \param	parameter	Producer
+*
+* \return	0
+*/
+static unsigned int __stdcall producerFunction(void *parameter) {
+	Producer & producer = *(Producer*)parameter;
+
+	char element[64];
+
+	WaitForSingleObject(startEvent, INFINITE);
+
+	for (int i = 0; i < producer.bursts; i++) {
+		if (i % 2 == 0) {
+			for (int j = 0; j < DRAG_EVENTS; j++) {
+				sprintf_s(element, "volume_%d", j * 255 / DRAG_EVENTS);
+				timedPush(producer, element);
+			}
+		} else {
+			for (int j = 0; j < STORM_SONGS; j++) {
+				int position = i * STORM_SONGS + j;
+
+				sprintf_s(element, "playlistPosition_%d", position);
+				timedPush(producer, element);
+
+				sprintf_s(element, "title_Benchmark Artist %d - Benchmark Title %d", position % 100, position);
+				timedPush(producer, element);
+
+				timedPush(producer, "length_180");
+				timedPush(producer, "bitrate_320");
+				timedPush(producer, "samplerate_44");
+				timedPush(producer, "isplaying_1");
+
+				sprintf_s(element, "trackFields_%d_7", position);
+				timedPush(producer, element);
+
+				timedPush(producer, "cover");
+			}
+		}
+
+		Sleep(1);
+	}
+
+	return 0;
+}
+
+/**
+* \brief	consumerFunction
+*
+* thread of the consumer, stands in for the send command thread. takes the elements until "quit"
+*
+* \param	parameter	Consumer
+*
+* \return	0
+*/
+static unsigned int __stdcall consumerFunction(void *parameter) {
+	Consumer & consumer = *(Consumer*)parameter;
+
+	QueueItem item;
+	bool woken;
+
+	for (;;) {
+		consumer.queue->pop(item, woken);
+
+		double latency = now() * 1000.0 - item.queued;
+
+		if (item.element == "quit")
+			break;
+
+		consumer.wait.push_back(latency);
+
+		if (woken)
+			consumer.wakeup.push_back(latency);
+
+		consumer.delivered++;
+	}
+
+	consumer.finished = now();
+
+	return 0;
+}
+
+/**
+* \brief	percentile
+*
+* \param	values		sorted series
+* \param	permille	rank in 1/1000
+*
+* \return	value at the rank, 0 for an empty series
+*/
+static double percentile(const std::vector<double> & values, const int & permille) {
+	if (values.empty())
+		return 0.0;
+
+	return values[(values.size() - 1) * permille / 1000];
+}
+
+/**
+* \brief	runQueue
+*
+* runs the producers against one queue and prints a line of results
+*
+* \param	name		name of the design
+* \param	queue		queue
+* \param	producers	number of producer threads
+* \param	bursts		bursts of every producer
+*/
+static void runQueue(const char *name, BenchmarkQueue *queue, const int & producers, const int & bursts) {
+	Consumer consumer;
+	consumer.queue = queue;
+	consumer.delivered = 0;
+	consumer.finished = 0.0;
+	consumer.wait.reserve(producers * bursts * STORM_SONGS * 8);
+
+	std::vector<Producer*> workers;
+	std::vector<HANDLE> threads;
+
+	HANDLE consumerThread = (HANDLE)_beginthreadex(NULL, 0, consumerFunction, &consumer, 0, NULL);
+
+	for (int i = 0; i < producers; i++) {
+		Producer *producer = new Producer();
+		producer->queue = queue;
+		producer->bursts = bursts;
+		producer->session = -1;
+		producer->pushed = 0;
+
+		workers.push_back(producer);
+
+		HANDLE thread = (HANDLE)_beginthreadex(NULL, 0, producerFunction, producer, 0, NULL);
+
+		if (thread != NULL)
+			threads.push_back(thread);
+	}
+
+	double started = now();
+	SetEvent(startEvent);
+
+	for (size_t i = 0; i < threads.size(); i++) {
+		WaitForSingleObject(threads[i], INFINITE);
+		CloseHandle(threads[i]);
+	}
+
+	queue->push("quit", 0);
+
+	WaitForSingleObject(consumerThread, INFINITE);
+	CloseHandle(consumerThread);
+
+	ResetEvent(startEvent);
+
+	std::vector<double> enqueue;
+	int pushed = 0;
+
+	for (size_t i = 0; i < workers.size(); i++) {
+		enqueue.insert(enqueue.end(), workers[i]->enqueue.begin(), workers[i]->enqueue.end());
+		pushed += workers[i]->pushed;
+
+		delete workers[i];
+	}
+
+	std::sort(enqueue.begin(), enqueue.end());
+	std::sort(consumer.wakeup.begin(), consumer.wakeup.end());
+	std::sort(consumer.wait.begin(), consumer.wait.end());
+
+	double seconds = (consumer.finished - started) / 1000.0;
+
+	printf("%-11s %9d %9.2f %9.2f %9.2f %9.2f %9.2f %12.0f %10d\n", name, producers, percentile(enqueue, 500), percentile(enqueue, 990),
+		percentile(consumer.wakeup, 500), percentile(consumer.wakeup, 990), percentile(consumer.wait, 990), seconds > 0 ? pushed / seconds : 0.0,
+		consumer.delivered);
+}
+
+/**
+* \brief	queueBenchmark
+*
+* compares the task queue designs with 1 to maxProducers producers
+*
+* \param	maxProducers	largest number of producers
+* \param	bursts			bursts of every producer
+*
+* \return	0
+*/
+static int queueBenchmark(const int & maxProducers, const int & bursts) {
+	QueryPerformanceFrequency(&frequency);
+
+	startEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+	printf("%d bursts per producer, %d volume events per drag, %d songs per storm\n\n", bursts, DRAG_EVENTS, STORM_SONGS);
+	printf("%-11s %9s %9s %9s %9s %9s %9s %12s %10s (us)\n", "", "producers", "enq_p50", "enq_p99", "wake_p50", "wake_p99", "wait_p99",
+		"pushes/s", "delivered");
+
+	LONG full = 0;
+
+	for (int producers = 1; producers <= maxProducers; producers++) {
+		FifoQueue fifo;
+		runQueue("fifo", &fifo, producers, bursts);
+
+		CoalescingQueue coalescing;
+		runQueue("coalescing", &coalescing, producers, bursts);
+
+		RingQueue ring;
+		runQueue("ring", &ring, producers, bursts);
+		full += ring.full;
+	}
+
+	printf("\n%d pushes found the ring full\n", full);
+
+	CloseHandle(startEvent);
+
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc == 5 && strcmp(argv[1], "/playlist") == 0)
+		return createPlaylist(argv[2], atoi(argv[3]), argv[4]);
+
+	if (argc >= 2 && strcmp(argv[1], "/queue") == 0)
+		return queueBenchmark(argc > 2 ? atoi(argv[2]) : 8, argc > 3 ? atoi(argv[3]) : 200);
+
+	// the dashboard form is the burst form with the arguments moved by one
+	options.dashboard = argc > 2 && strcmp(argv[1], "/dashboard") == 0;
+
+	if (options.dashboard) {
+		argv++;
+		argc--;
+	}
+
+	if (argc < 2) {
+		printf("usage: RemoteControlBenchmark <host> [port] [clients] [bursts] [ranges per burst] [track infos per burst]\n");
+		printf("       RemoteControlBenchmark /dashboard <host> [port] [clients] [seconds] [level frames per second]\n");
+		printf("       RemoteControlBenchmark /playlist <folder> <count> <sample file>\n");
+		printf("       RemoteControlBenchmark /queue [max producers] [bursts per producer]\n");
+
+		return 1;
+	}
+
+	options.host = argv[1];
+	options.port = argc > 2 ? atoi(argv[2]) : 50000;
+	options.clients = argc > 3 ? atoi(argv[3]) : 4;
+	options.bursts = argc > 4 ? atoi(argv[4]) : 20;
+	options.ranges = argc > 5 ? atoi(argv[5]) : 10;
+	options.trackInfos = argc > 6 ? atoi(argv[6]) : 10;
+	options.seconds = argc > 4 ? atoi(argv[4]) : 30;
+	options.levelsRate = argc > 5 ? atoi(argv[5]) : 60;
+
+	if (options.clients < 1)
+		options.clients = 1;
+
+	WSADATA wsaData;
+
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+		return 1;
+
+	QueryPerformanceFrequency(&frequency);
+	srand(GetTickCount());
+
+	startEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+	std::vector<Client*> clients;
+	std::vector<HANDLE> threads;
+
+	for (int i = 0; i < options.clients; i++) {
+		Client *client = new Client();
+		client->socket = INVALID_SOCKET;
+		client->start = 0;
+		client->end = 0;
+		client->playlistLength = 0;
+		client->bytes = 0;
+		client->frames = 0;
+		client->progress = 0;
+		client->lost = 0;
+		client->failed = false;
+
+		clients.push_back(client);
+
+		HANDLE thread = (HANDLE)_beginthreadex(NULL, 0, clientFunction, client, 0, NULL);
+
+		if (thread != NULL)
+			threads.push_back(thread);
+	}
+
+	// all clients connect at the same time
+	double started = now();
+	SetEvent(startEvent);
+
+	// WaitForMultipleObjects handles at most 64
+	for (size_t i = 0; i < threads.size(); i++) {
+		WaitForSingleObject(threads[i], INFINITE);
+		CloseHandle(threads[i]);
+	}
+
+	double seconds = (now() - started) / 1000.0;
+
+	std::vector<double> sync, range, trackInfo, frameGap;
+	LONGLONG bytes = 0;
+	int lost = 0, failed = 0, frames = 0, progress = 0;
+
+	for (size_t i = 0; i < clients.size(); i++) {
+		sync.insert(sync.end(), clients[i]->sync.begin(), clients[i]->sync.end());
+		range.insert(range.end(), clients[i]->range.begin(), clients[i]->range.end());
+		trackInfo.insert(trackInfo.end(), clients[i]->trackInfo.begin(), clients[i]->trackInfo.end());
+		frameGap.insert(frameGap.end(), clients[i]->frameGap.begin(), clients[i]->frameGap.end());
+
+		bytes += clients[i]->bytes;
+		frames += clients[i]->frames;
+		progress += clients[i]->progress;
+		lost += clients[i]->lost;
+		failed += clients[i]->failed ? 1 : 0;
+
+		delete clients[i];
+	}
+
+	if (options.dashboard) {
+		// one more connection asks which backend has served the clients
+		Client *probe = new Client();
+		probe->socket = INVALID_SOCKET;
+		probe->start = 0;
+		probe->end = 0;
+		probe->bytes = 0;
+
+		std::string backend = synchronize(*probe) ? transport(*probe) : "";
+
+		if (probe->socket != INVALID_SOCKET) {
+			sendLine(*probe, "destroy");
+			closesocket(probe->socket);
+		}
+
+		delete probe;
+
+		printf("%d dashboard clients, %d level frames per second for %d s\n", options.clients, options.levelsRate, options.seconds);
+		printf("%s\n\n", backend.empty() ? "transport unknown" : backend.c_str());
+		printf("%-10s %8s %9s %9s %9s %9s (ms)\n", "", "count", "p50", "p99", "p999", "max");
+
+		printLatencies("sync", sync);
+		printLatencies("frame_gap", frameGap);
+
+		printf("\n%.1f s, %.1f KB/s, %.1f frames/s, %.1f progress/s, %d clients failed\n", seconds,
+			seconds > 0 ? bytes / 1024.0 / seconds : 0.0, seconds > 0 ? frames / seconds : 0.0, seconds > 0 ? progress / seconds : 0.0, failed);
+
+		CloseHandle(startEvent);
+		WSACleanup();
+
+		return failed > 0 ? 1 : 0;
+	}
+
+	size_t responses = range.size() + trackInfo.size();
+
+	printf("%d clients, %d bursts of %d ranges and %d track infos\n\n", options.clients, options.bursts, options.ranges, options.trackInfos);
+	printf("%-10s %8s %9s %9s %9s %9s (ms)\n", "", "count", "p50", "p99", "p999", "max");
+
+	printLatencies("sync", sync);
+	printLatencies("range", range);
+	printLatencies("trackInfo", trackInfo);
+
+	printf("\n%.1f s, %.1f KB/s, %.1f responses/s, %d track infos lost, %d clients failed\n", seconds,
+		seconds > 0 ? bytes / 1024.0 / seconds : 0.0, seconds > 0 ? responses / seconds : 0.0, lost, failed);
+
+	CloseHandle(startEvent);
+	WSACleanup();
+
+	return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,1000 @@
+// RemoteControlHost: headless winamp for the RemoteControl server. a hidden window answers the WM_WA_IPC messages the
+// plugin sends, a queue manager stands in for JTFE and a synthetic playlist plays a scripted event stream, so the
+// load generator and the replay of captures run without winamp.
+//
+// usage: RemoteControlHost <plugin dll> <entries | m3u file> [script] [seconds]
+//
+// the playlist is either the given number of synthetic entries or an m3u, for example one of RemoteControlBenchmark
+// /playlist. the script has one event per line, "<milliseconds after the previous event> <event> [argument]":
+//
+//   next, previous, play, pause, stop, shuffle, repeat     buttons of winamp
+//   seek <milliseconds>, volume <0-255>                     changes of the player
+//   queue <position>, insert <count>, delete <position>    changes of the queue and the playlist
+//   loop                                                    starts the script again
+//
+// without a script the song changes every 5 seconds. the host quits the plugin after the seconds or with ctrl+c
+//
+// usage: RemoteControlHost <plugin dll> --proxy <channel> <winamp process id>
+//
+// started by the plugin in winamp if hostprocess is set, see ServerHost. the window stands in for winamp: the messages
+// of the plugin are answered by winamp through the rings of the channel, the events of the winamp window are replayed
+// to the hook of the plugin. the host quits the plugin when winamp tells it or has exited
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include "wa_ipc.h"
+#include "GEN.H"
+#include <api/service/api_service.h>
+#include <api/service/waservicefactory.h>
+#include <Agave/Queue/api_queue.h>
+
+#include "SharedRing.h"
+
+// milliseconds between the song changes without a script
+#define DEFAULT_INTERVAL 5000
+
+// length of the synthetic entries in seconds
+#define SYNTHETIC_LENGTH 180
+
+// milliseconds between two checks whether the playing song has ended
+#define PLAYBACK_POLL 250
+
+// timers of the host window
+#define TIMER_SCRIPT 1
+#define TIMER_PLAYBACK 2
+
+// sent by winamp when an item has finished or next is pressed, see the hook of the plugin
+#define IPC_ITEM_FINISHED 636
+
+// buttons of winamp
+#define BUTTON_PREVIOUS 40044
+#define BUTTON_PLAY 40045
+#define BUTTON_PAUSE 40046
+#define BUTTON_STOP 40047
+#define BUTTON_NEXT 40048
+#define BUTTON_REPEAT 40022
+#define BUTTON_SHUFFLE 40023
+
+
+// one line of the script
+struct Event {
+	DWORD delay;
+	std::string name;
+	int argument;
+};
+
+// one entry of the playlist
+struct Entry {
+	std::string file;
+	std::wstring wideFile;
+	std::wstring title;
+
+	// seconds
+	int length;
+};
+
+// player state, only used by the window thread. the plugin asks it from its own threads through SendMessage
+struct Player {
+	std::vector<Entry> playlist;
+	std::vector<int> queue;
+
+	int position;
+
+	// IPC_ISPLAYING: 1 playing, 3 paused, 0 stopped
+	int playing;
+
+	// tick count when the song would have started without pauses, and the milliseconds played when paused
+	DWORD started;
+	DWORD pausedAt;
+
+	int volume;
+	int shuffle;
+	int repeat;
+};
+
+
+static Player player;
+static std::vector<Event> script;
+static unsigned int nextEvent = 0;
+static HWND window = NULL;
+static winampGeneralPurposePlugin *plugin = NULL;
+static LONG events = 0;
+static LONG songs = 0;
+
+// answered with 1, the plugin doesn't start another host
+static UINT hostedIpc = 0;
+
+
+// rings to winamp in proxy mode
+static HostChannel channel;
+static bool proxied = false;
+static HANDLE winamp = NULL;
+
+// one call at a time, the command ring has one writer
+static CRITICAL_SECTION cs_proxy;
+static LONG sequence = 0;
+
+// string results by thread, valid until the next string result of the thread like the buffers of winamp
+static std::map<DWORD, std::string> results;
+
+// event that is replayed, the window doesn't send it to winamp again. only used by the window thread
+static struct {
+	UINT message;
+	WPARAM wParam;
+	LPARAM lParam;
+	bool pending;
+} replayed = { 0, 0, 0, false };
+
+
+/**
+* \brief	call
+*
+* sends a call to winamp and waits for the result
+*
+* \param	type	HOST_IPC or HOST_QUEUE
+* \param	first	message or API_QUEUE_ code
+* \param	second	parameter
+* \param	third	parameter
+* \param	payload	marshalled structure parameter
+* \param	text	receives the string the result points to, NULL if the result is a number
+*
+* \return	result, 0 if winamp doesn't answer
+*/
+static LRESULT call(const LONG & type, const LONGLONG & first, const LONGLONG & second, const LONGLONG & third, const std::string & payload = std::string(), std::string *text = NULL) {
+	LRESULT result = 0;
+
+	EnterCriticalSection(&cs_proxy);
+
+	LONG number = ++sequence;
+
+	if (channel.rings[HOST_RING_COMMANDS].write(type, number, first, second, third, payload.data(), (unsigned int)payload.length())) {
+		SharedRing & replies = channel.rings[HOST_RING_REPLIES];
+		HANDLE handles[] = { replies.event(), winamp };
+
+		SharedRecord record;
+		std::string reply;
+		bool answered = false;
+		DWORD started = GetTickCount();
+
+		while (!answered) {
+			// replies of calls that have timed out are skipped
+			while (!answered && replies.read(record, reply))
+				answered = record.sequence == number;
+
+			DWORD elapsed = GetTickCount() - started;
+
+			if (!answered && (elapsed >= HOST_REPLY_TIMEOUT || WaitForMultipleObjects(2, handles, FALSE, HOST_REPLY_TIMEOUT - elapsed) != WAIT_OBJECT_0))
+				break;
+		}
+
+		if (answered) {
+			result = (LRESULT)record.values[0];
+
+			if (text != NULL)
+				text->swap(reply);
+		}
+	}
+
+	LeaveCriticalSection(&cs_proxy);
+
+	return result;
+}
+
+/**
+* \brief	proxyQueue
+*
+* forwards a call of the queue manager to the one of winamp in proxy mode, the plugin only uses these
+*
+* \return	1 if the call is known
+*/
+static int proxyQueue(int msg, void *retval, void **params) {
+	switch (msg) {
+		case api_queue::API_QUEUE_ADDITEMTOQUEUE:
+			*(BOOL*)retval = (BOOL)call(HOST_QUEUE, msg, *(int*)params[0], *(int*)params[1]);
+			return 1;
+		case api_queue::API_QUEUE_REMOVEQUEUEDITEM:
+			call(HOST_QUEUE, msg, *(int*)params[0], *(int*)params[1]);
+			return 1;
+		case api_queue::API_QUEUE_CLEARQUEUE:
+			call(HOST_QUEUE, msg, 0, 0);
+			return 1;
+		case api_queue::API_QUEUE_GETNUMBEROFQUEUEDITEMS:
+			*(int*)retval = (int)call(HOST_QUEUE, msg, 0, 0);
+			return 1;
+		case api_queue::API_QUEUE_GETQUEUEDITEMFROMINDEX:
+			*(int*)retval = (int)call(HOST_QUEUE, msg, *(int*)params[0], 0);
+			return 1;
+	}
+
+	return 0;
+}
+
+
+// JTFE queue manager. the plugin only uses the calls below, the others return their default value
+class HostQueue : public api_queue {
+	protected:
+		RECVS_DISPATCH;
+};
+
+int HostQueue::_dispatch(int msg, void *retval, void **params, int nparam) {
+	if (proxied)
+		return proxyQueue(msg, retval, params);
+
+	std::vector<int> & queue = player.queue;
+
+	switch (msg) {
+		case API_QUEUE_ADDITEMTOQUEUE: {
+			int item = *(int*)params[0];
+
+			if (item >= 0 && item < (int)player.playlist.size())
+				queue.push_back(item);
+
+			*(BOOL*)retval = TRUE;
+			return 1;
+		}
+		case API_QUEUE_REMOVEQUEUEDITEM: {
+			int index = *(int*)params[0];
+
+			if (index >= 0 && index < (int)queue.size())
+				queue.erase(queue.begin() + index);
+
+			return 1;
+		}
+		case API_QUEUE_CLEARQUEUE:
+			queue.clear();
+			return 1;
+		case API_QUEUE_GETNUMBEROFQUEUEDITEMS:
+			*(int*)retval = (int)queue.size();
+			return 1;
+		case API_QUEUE_GETQUEUEDITEMFROMINDEX: {
+			int index = *(int*)params[0];
+
+			*(int*)retval = index >= 0 && index < (int)queue.size() ? queue[index] : -1;
+			return 1;
+		}
+		case API_QUEUE_GETQUEUEDITEMFILEPATH: {
+			int item = *(int*)params[0];
+
+			*(wchar_t**)retval = item >= 0 && item < (int)player.playlist.size() ? (wchar_t*)player.playlist[item].wideFile.c_str() : NULL;
+			return 1;
+		}
+		case API_QUEUE_GETQUEUEDITEMPLAYLISTPOSITION:
+			*(int*)retval = *(int*)params[0];
+			return 1;
+		case API_QUEUE_ISITEMQUEUEDMULTIPLETIMES:
+			*(int*)retval = (int)std::count(queue.begin(), queue.end(), *(int*)params[0]);
+			return 1;
+	}
+
+	return 0;
+}
+
+static HostQueue queue;
+
+
+// factory of the queue manager
+class HostQueueFactory : public waServiceFactory {
+	protected:
+		RECVS_DISPATCH;
+};
+
+int HostQueueFactory::_dispatch(int msg, void *retval, void **params, int nparam) {
+	switch (msg) {
+		case WASERVICEFACTORY_GETINTERFACE:
+			*(void**)retval = &queue;
+			return 1;
+		case WASERVICEFACTORY_RELEASEINTERFACE:
+			*(int*)retval = 1;
+			return 1;
+		case WASERVICEFACTORY_GETGUID:
+			*(GUID*)retval = QueueManagerApiGUID;
+			return 1;
+	}
+
+	return 0;
+}
+
+static HostQueueFactory queueFactory;
+
+
+// service manager of IPC_GET_API_SERVICE. it only has the queue manager, the plugin does without the other services
+class HostServices : public api_service {
+	protected:
+		RECVS_DISPATCH;
+};
+
+int HostServices::_dispatch(int msg, void *retval, void **params, int nparam) {
+	switch (msg) {
+		case API_SERVICE_SERVICE_GETSERVICEBYGUID:
+			*(waServiceFactory**)retval = *(GUID*)params[0] == QueueManagerApiGUID ? &queueFactory : NULL;
+			return 1;
+		case API_SERVICE_SERVICE_GETNUMSERVICES:
+			*(size_t*)retval = 0;
+			return 1;
+		case API_SERVICE_SERVICE_ENUMSERVICE:
+			*(waServiceFactory**)retval = NULL;
+			return 1;
+	}
+
+	return 0;
+}
+
+static HostServices services;
+
+
+/**
+* \brief	addEntry
+*
+* appends an entry to the playlist
+*
+* \param	file	path of the file
+* \param	title	title shown in the playlist
+* \param	length	seconds
+*/
+static void addEntry(const std::string & file, const std::string & title, const int & length) {
+	Entry entry;
+	entry.file = file;
+	entry.wideFile = std::wstring(file.begin(), file.end());
+	entry.title = std::wstring(title.begin(), title.end());
+	entry.length = length > 0 ? length : SYNTHETIC_LENGTH;
+
+	player.playlist.push_back(entry);
+}
+
+/**
+* \brief	addSynthetic
+*
+* appends synthetic entries. their files don't exist, the plugin gets their information from the IPC messages
+*
+* \param	count	number of entries
+*/
+static void addSynthetic(const int & count) {
+	for (int i = 0; i < count; i++) {
+		int number = (int)player.playlist.size();
+
+		char file[64], title[128];
+		sprintf_s(file, "C:\\RemoteControlHost\\track%06d.mp3", number);
+		sprintf_s(title, "Host Artist %d - Host Title %d", number % 100, number);
+
+		addEntry(file, title, SYNTHETIC_LENGTH);
+	}
+}
+
+/**
+* \brief	loadPlaylist
+*
+* reads the entries of an m3u, the #EXTINF lines give their titles and lengths
+*
+* \param	path	path of the m3u
+*
+* \return	0 if success, 1 if error
+*/
+static int loadPlaylist(const char *path) {
+	FILE *file = NULL;
+
+	if (fopen_s(&file, path, "r") != 0)
+		return 1;
+
+	char line[2048];
+	std::string title;
+	int length = 0;
+
+	while (fgets(line, sizeof(line), file) != NULL) {
+		std::string text(line);
+		text.erase(text.find_last_not_of("\r\n") + 1);
+
+		if (text.compare(0, 8, "#EXTINF:") == 0) {
+			size_t comma = text.find(',');
+
+			length = atoi(text.c_str() + 8);
+			title = comma != std::string::npos ? text.substr(comma + 1) : std::string();
+		} else if (!text.empty() && text[0] != '#') {
+			addEntry(text, title.empty() ? text : title, length);
+
+			title.clear();
+			length = 0;
+		}
+	}
+
+	fclose(file);
+
+	return player.playlist.empty() ? 1 : 0;
+}
+
+/**
+* \brief	loadScript
+*
+* reads the events of a script
+*
+* \param	path	path of the script
+*
+* \return	0 if success, 1 if error
+*/
+static int loadScript(const char *path) {
+	FILE *file = NULL;
+
+	if (fopen_s(&file, path, "r") != 0)
+		return 1;
+
+	char line[256];
+
+	while (fgets(line, sizeof(line), file) != NULL) {
+		char name[64];
+		Event event;
+		event.argument = 0;
+
+		if (line[0] == '#' || sscanf_s(line, "%lu %63s %d", &event.delay, name, (unsigned)sizeof(name), &event.argument) < 2)
+			continue;
+
+		event.name = name;
+		script.push_back(event);
+	}
+
+	fclose(file);
+
+	return script.empty() ? 1 : 0;
+}
+
+/**
+* \brief	elapsed
+*
+* \return	milliseconds played of the current song, -1 if stopped
+*/
+static int elapsed() {
+	if (player.playing == 0)
+		return -1;
+
+	return player.playing == 3 ? (int)player.pausedAt : (int)(GetTickCount() - player.started);
+}
+
+/**
+* \brief	playEntry
+*
+* starts an entry and tells the plugin like winamp does
+*
+* \param	position	playlist position
+*/
+static void playEntry(const int & position) {
+	if (player.playlist.empty())
+		return;
+
+	player.position = position;
+	player.playing = 1;
+	player.started = GetTickCount();
+
+	songs++;
+
+	SendMessage(window, WM_WA_IPC, (WPARAM)player.playlist[position].file.c_str(), IPC_PLAYING_FILE);
+}
+
+/**
+* \brief	nextPosition
+*
+* \param	forward	false for the previous entry
+*
+* \return	the entry winamp would play next: the first of the queue, a random one with shuffle or the following one
+*/
+static int nextPosition(const bool & forward) {
+	int count = (int)player.playlist.size();
+
+	if (forward && !player.queue.empty()) {
+		int position = player.queue.front();
+		player.queue.erase(player.queue.begin());
+
+		return position;
+	}
+
+	if (player.shuffle == 1)
+		return rand() % count;
+
+	return (player.position + (forward ? 1 : count - 1)) % count;
+}
+
+/**
+* \brief	button
+*
+* performs a button of winamp, sent by the plugin or by the script through the hook of the plugin
+*
+* \param	id	BUTTON_
+*/
+static void button(const WPARAM & id) {
+	switch (id) {
+		case BUTTON_NEXT:
+		case BUTTON_PREVIOUS: {
+			int position = nextPosition(id == BUTTON_NEXT);
+
+			// a stopped player only moves in the playlist
+			if (player.playing == 0)
+				player.position = position;
+			else
+				playEntry(position);
+			break;
+		}
+		case BUTTON_PLAY:
+			if (player.playing == 3) {
+				player.playing = 1;
+				player.started = GetTickCount() - player.pausedAt;
+			} else
+				playEntry(player.position);
+			break;
+		case BUTTON_PAUSE:
+			if (player.playing == 1) {
+				player.pausedAt = GetTickCount() - player.started;
+				player.playing = 3;
+			} else if (player.playing == 3) {
+				player.playing = 1;
+				player.started = GetTickCount() - player.pausedAt;
+			}
+			break;
+		case BUTTON_STOP:
+			player.playing = 0;
+			break;
+		case BUTTON_SHUFFLE:
+			player.shuffle = player.shuffle == 1 ? 0 : 1;
+			break;
+		case BUTTON_REPEAT:
+			player.repeat = player.repeat == 1 ? 0 : 1;
+			break;
+	}
+}
+
+/**
+* \brief	proxyIpc
+*
+* answers a WM_WA_IPC message of the plugin in proxy mode. registered messages have the same number in every
+* process, the queue manager forwards its calls. string results are copied, the structure of IPC_ENQUEUEFILEW is
+* marshalled. the visualization data functions of winamp can't be called from here
+*
+* \return	result of winamp
+*/
+static LRESULT proxyIpc(const WPARAM & wParam, const LPARAM & lParam) {
+	switch (lParam) {
+		case IPC_REGISTER_WINAMP_IPCMESSAGE:
+			return RegisterWindowMessageA((const char*)wParam);
+		case IPC_GET_API_SERVICE:
+			return (LRESULT)&services;
+		case IPC_GETSADATAFUNC:
+		case IPC_GETVUDATAFUNC:
+			return 0;
+		case IPC_ENQUEUEFILEW: {
+			enqueueFileWithMetaStructW *file = (enqueueFileWithMetaStructW*)wParam;
+
+			// length, file and title, each terminated
+			std::wstring strings(file->filename);
+			strings.push_back(L'\0');
+
+			if (file->title != NULL)
+				strings += file->title;
+
+			strings.push_back(L'\0');
+
+			std::string payload((const char*)&file->length, sizeof(int));
+			payload.append((const char*)strings.data(), strings.length() * sizeof(wchar_t));
+
+			return call(HOST_IPC, WM_WA_IPC, 0, lParam, payload);
+		}
+		case IPC_GETPLAYLISTFILE:
+		case IPC_GETPLAYLISTFILEW:
+		case IPC_GETPLAYLISTTITLEW: {
+			std::string text;
+			call(HOST_IPC, WM_WA_IPC, wParam, lParam, std::string(), &text);
+
+			if (text.empty())
+				return 0;
+
+			EnterCriticalSection(&cs_proxy);
+
+			std::string & kept = results[GetCurrentThreadId()];
+			kept.swap(text);
+
+			const char *data = kept.data();
+
+			LeaveCriticalSection(&cs_proxy);
+
+			return (LRESULT)data;
+		}
+	}
+
+	return call(HOST_IPC, WM_WA_IPC, wParam, lParam);
+}
+
+/**
+* \brief	ipc
+*
+* answers the WM_WA_IPC messages the plugin uses
+*
+* \return	result of the message
+*/
+static LRESULT ipc(const WPARAM & wParam, const LPARAM & lParam) {
+	int count = (int)player.playlist.size();
+	bool valid = (int)wParam >= 0 && (int)wParam < count;
+
+	switch (lParam) {
+		case IPC_GETVERSION:	// also the JTFE version, the host has none
+			return 0x5066;
+		case IPC_REGISTER_WINAMP_IPCMESSAGE:
+			return RegisterWindowMessageA((const char*)wParam);
+		case IPC_GET_API_SERVICE:
+			return (LRESULT)&services;
+		case IPC_ISPLAYING:
+			return player.playing;
+		case IPC_GETOUTPUTTIME:
+			if (wParam == 0)
+				return elapsed();
+
+			if (player.playing == 0 || count == 0)
+				return -1;
+
+			return wParam == 1 ? player.playlist[player.position].length : player.playlist[player.position].length * 1000;
+		case IPC_JUMPTOTIME:
+			if (player.playing == 0)
+				return -1;
+
+			if (player.playing == 3)
+				player.pausedAt = (DWORD)wParam;
+			else
+				player.started = GetTickCount() - (DWORD)wParam;
+			return 0;
+		case IPC_SETVOLUME:
+			if ((int)wParam == -666)
+				return player.volume;
+
+			player.volume = max(0, min((int)wParam, 255));
+			return 0;
+		case IPC_GETLISTLENGTH:
+			return count;
+		case IPC_GETLISTPOS:
+			return player.position;
+		case IPC_SETPLAYLISTPOS:
+			if (valid)
+				player.position = (int)wParam;
+			return 0;
+		case IPC_GETINFO:
+			return wParam == 0 ? 44 : (wParam == 1 ? 320 : (wParam == 2 ? 2 : (wParam == 5 ? 44100 : 0)));
+		case IPC_GETPLAYLISTFILE:
+			return valid ? (LRESULT)player.playlist[wParam].file.c_str() : 0;
+		case IPC_GETPLAYLISTFILEW:
+			return valid ? (LRESULT)player.playlist[wParam].wideFile.c_str() : 0;
+		case IPC_GETPLAYLISTTITLEW:
+			return valid ? (LRESULT)player.playlist[wParam].title.c_str() : 0;
+		case IPC_GET_SHUFFLE:
+			return player.shuffle;
+		case IPC_GET_REPEAT:
+			return player.repeat;
+		case IPC_ENQUEUEFILEW: {
+			enqueueFileWithMetaStructW *file = (enqueueFileWithMetaStructW*)wParam;
+			std::wstring name(file->filename), title(file->title != NULL ? file->title : file->filename);
+
+			player.playlist.push_back(Entry());
+			player.playlist.back().file = std::string(name.begin(), name.end());
+			player.playlist.back().wideFile = name;
+			player.playlist.back().title = title;
+			player.playlist.back().length = file->length > 0 ? file->length : SYNTHETIC_LENGTH;
+			return 0;
+		}
+	}
+
+	// IPC_GETWND, IPC_GETSADATAFUNC and IPC_GETVUDATAFUNC: no playlist editor and no visualization data
+	return 0;
+}
+
+/**
+* \brief	runEvent
+*
+* performs an event of the script the way winamp would tell the plugin about it
+*
+* \param	event	event
+*/
+static void runEvent(const Event & event) {
+	static const char *buttons[] = { "next", "previous", "play", "pause", "stop", "shuffle", "repeat" };
+	static const WPARAM ids[] = { BUTTON_NEXT, BUTTON_PREVIOUS, BUTTON_PLAY, BUTTON_PAUSE, BUTTON_STOP, BUTTON_SHUFFLE, BUTTON_REPEAT };
+
+	events++;
+
+	for (int i = 0; i < sizeof(buttons) / sizeof(buttons[0]); i++) {
+		if (event.name == buttons[i]) {
+			SendMessage(window, WM_COMMAND, ids[i], 0);
+
+			return;
+		}
+	}
+
+	if (event.name == "seek")
+		SendMessage(window, WM_WA_IPC, event.argument, IPC_JUMPTOTIME);
+	else if (event.name == "volume")
+		SendMessage(window, WM_WA_IPC, event.argument, IPC_SETVOLUME);
+	else if (event.name == "queue")
+		queue.AddItemToQueue(event.argument, 1, NULL);
+	else if (event.name == "insert") {
+		addSynthetic(max(event.argument, 1));
+
+		SendMessage(window, WM_WA_IPC, 0, IPC_PLAYLIST_MODIFIED);
+	} else if (event.name == "delete") {
+		if (event.argument >= 0 && event.argument < (int)player.playlist.size() && player.playlist.size() > 1) {
+			player.playlist.erase(player.playlist.begin() + event.argument);
+
+			if (player.position >= (int)player.playlist.size())
+				player.position = (int)player.playlist.size() - 1;
+
+			SendMessage(window, WM_WA_IPC, 0, IPC_PLAYLIST_MODIFIED);
+		}
+	}
+}
+
+/**
+* \brief	scheduleEvent
+*
+* starts the timer of the next event of the script
+*/
+static void scheduleEvent() {
+	if (nextEvent < script.size() && script[nextEvent].name == "loop")
+		nextEvent = 0;
+
+	if (nextEvent < script.size())
+		SetTimer(window, TIMER_SCRIPT, max(script[nextEvent].delay, (DWORD)USER_TIMER_MINIMUM), NULL);
+}
+
+/**
+* \brief	replayEvents
+*
+* sends the events of the winamp window to the window in proxy mode, the hook of the plugin handles them like in
+* winamp. runs on the window thread
+*/
+static void replayEvents() {
+	SharedRecord record;
+	std::string payload;
+
+	while (channel.rings[HOST_RING_EVENTS].read(record, payload)) {
+		if (record.type == HOST_QUIT)
+			PostMessage(window, WM_CLOSE, 0, 0);
+		else if (record.type == HOST_CONFIG && plugin != NULL)
+			plugin->config();
+		else if (record.type == HOST_EVENT) {
+			// a copied pointer parameter
+			replayed.message = (UINT)record.values[0];
+			replayed.wParam = payload.empty() ? (WPARAM)record.values[1] : (WPARAM)payload.data();
+			replayed.lParam = (LPARAM)record.values[2];
+			replayed.pending = true;
+
+			events++;
+
+			SendMessage(window, replayed.message, replayed.wParam, replayed.lParam);
+
+			replayed.pending = false;
+		}
+	}
+}
+
+/**
+* \brief	isReplayed
+*
+* \return	true if the message is the replayed event after the hook, winamp has handled it already
+*/
+static bool isReplayed(const UINT & message, const WPARAM & wParam, const LPARAM & lParam) {
+	if (!replayed.pending || message != replayed.message || wParam != replayed.wParam || lParam != replayed.lParam)
+		return false;
+
+	replayed.pending = false;
+
+	return true;
+}
+
+/**
+* \brief	windowProcedure
+*
+* window of the host, the plugin subclasses it like the main window of winamp. in proxy mode the messages of the
+* plugin go to winamp
+*/
+static LRESULT CALLBACK windowProcedure(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam) {
+	if (proxied && isReplayed(message, wParam, lParam))
+		return 0;
+
+	switch (message) {
+		case WM_WA_IPC:
+			if (hostedIpc != 0 && (UINT)lParam == hostedIpc)
+				return 1;
+
+			return proxied ? proxyIpc(wParam, lParam) : ipc(wParam, lParam);
+		case WM_COMMAND:
+			if (proxied)
+				call(HOST_IPC, WM_COMMAND, wParam, lParam);
+			else
+				button(LOWORD(wParam));
+			return 0;
+		case WM_TIMER:
+			if (wParam == TIMER_SCRIPT) {
+				KillTimer(hwnd, TIMER_SCRIPT);
+
+				runEvent(script[nextEvent++]);
+				scheduleEvent();
+			} else if (wParam == TIMER_PLAYBACK && player.playing == 1 && !player.playlist.empty()
+				&& elapsed() >= player.playlist[player.position].length * 1000) {
+				// the song has ended
+				SendMessage(hwnd, WM_WA_IPC, 0, IPC_ITEM_FINISHED);
+
+				playEntry(nextPosition(true));
+			}
+			return 0;
+		case WM_CLOSE:
+			if (plugin != NULL)
+				plugin->quit();
+
+			plugin = NULL;
+
+			DestroyWindow(hwnd);
+			return 0;
+		case WM_DESTROY:
+			PostQuitMessage(0);
+			return 0;
+	}
+
+	return DefWindowProc(hwnd, message, wParam, lParam);
+}
+
+/**
+* \brief	consoleHandler
+*
+* closes the window on ctrl+c, the plugin is quit on the window thread
+*/
+static BOOL WINAPI consoleHandler(DWORD type) {
+	PostMessage(window, WM_CLOSE, 0, 0);
+
+	return TRUE;
+}
+
+int main(int argc, char *argv[]) {
+	if (argc < 3) {
+		printf("usage: RemoteControlHost <plugin dll> <entries | m3u file> [script] [seconds]\n");
+		printf("       RemoteControlHost <plugin dll> --proxy <channel> <winamp process id>\n");
+
+		return 1;
+	}
+
+	proxied = argc > 4 && strcmp(argv[2], "--proxy") == 0;
+
+	DWORD seconds = 0;
+
+	if (proxied) {
+		// the host ends with winamp
+		winamp = OpenProcess(SYNCHRONIZE, FALSE, (DWORD)atoi(argv[4]));
+
+		if (winamp == NULL || !channel.open(argv[3], false)) {
+			printf("could not open the channel %s\n", argv[3]);
+
+			return 1;
+		}
+
+		InitializeCriticalSection(&cs_proxy);
+	} else {
+		int entries = atoi(argv[2]);
+
+		if (entries > 0)
+			addSynthetic(entries);
+		else if (loadPlaylist(argv[2]) != 0) {
+			printf("could not read the playlist %s\n", argv[2]);
+
+			return 1;
+		}
+
+		if (argc > 3 && loadScript(argv[3]) != 0) {
+			printf("could not read the script %s\n", argv[3]);
+
+			return 1;
+		}
+
+		if (script.empty()) {
+			Event next = { DEFAULT_INTERVAL, "next", 0 };
+			Event loop = { 0, "loop", 0 };
+
+			script.push_back(next);
+			script.push_back(loop);
+		}
+
+		seconds = argc > 4 ? (DWORD)atoi(argv[4]) : 0;
+	}
+
+	player.position = 0;
+	player.playing = 0;
+	player.started = 0;
+	player.pausedAt = 0;
+	player.volume = 200;
+	player.shuffle = 0;
+	player.repeat = 1;
+
+	srand(GetTickCount());
+
+	hostedIpc = RegisterWindowMessageA(HOST_HOSTED_IPC);
+
+	HINSTANCE instance = GetModuleHandle(NULL);
+
+	WNDCLASSA windowClass = { 0 };
+	windowClass.lpfnWndProc = windowProcedure;
+	windowClass.hInstance = instance;
+	windowClass.lpszClassName = "Winamp v1.x";
+
+	RegisterClassA(&windowClass);
+
+	// hidden, not a message only window: the plugin treats it like the main window of winamp
+	window = CreateWindowA(windowClass.lpszClassName, "RemoteControlHost", WS_OVERLAPPEDWINDOW, 0, 0, 0, 0, NULL, NULL, instance, NULL);
+
+	HMODULE library = LoadLibraryA(argv[1]);
+	winampGeneralPurposePluginGetter getter = library != NULL ? (winampGeneralPurposePluginGetter)GetProcAddress(library, "winampGetGeneralPurposePlugin") : NULL;
+
+	if (window == NULL || getter == NULL || (plugin = getter()) == NULL) {
+		printf("could not load the plugin %s\n", argv[1]);
+
+		return 1;
+	}
+
+	plugin->hwndParent = window;
+	plugin->hDllInstance = library;
+
+	if (plugin->init() != GEN_INIT_SUCCESS) {
+		printf("could not initialize the plugin\n");
+
+		return 1;
+	}
+
+	SetConsoleCtrlHandler(consoleHandler, TRUE);
+
+	DWORD start = GetTickCount();
+	MSG msg;
+
+	if (proxied) {
+		HANDLE handles[] = { channel.rings[HOST_RING_EVENTS].event(), winamp };
+		DWORD count = 2;
+		bool running = true;
+
+		while (running) {
+			DWORD result = MsgWaitForMultipleObjects(count, handles, FALSE, INFINITE, QS_ALLINPUT);
+
+			if (result == WAIT_OBJECT_0)
+				replayEvents();
+			else if (result == WAIT_OBJECT_0 + 1) {
+				// winamp has exited without quitting the host
+				count = 1;
+
+				PostMessage(window, WM_CLOSE, 0, 0);
+			}
+
+			while (running && PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+				if (msg.message == WM_QUIT)
+					running = false;
+				else {
+					TranslateMessage(&msg);
+					DispatchMessage(&msg);
+				}
+			}
+		}
+
+		if (channel.rings[HOST_RING_EVENTS].dropped() > 0)
+			printf("%ld events of winamp were dropped\n", channel.rings[HOST_RING_EVENTS].dropped());
+	} else {
+		printf("%s loaded with %u entries and %u events\n", plugin->description, player.playlist.size(), script.size());
+
+		playEntry(0);
+
+		SetTimer(window, TIMER_PLAYBACK, PLAYBACK_POLL, NULL);
+		scheduleEvent();
+
+		while (GetMessage(&msg, NULL, 0, 0) > 0) {
+			if (seconds > 0 && GetTickCount() - start >= seconds * 1000 && plugin != NULL)
+				PostMessage(window, WM_CLOSE, 0, 0);
+
+			TranslateMessage(&msg);
+			DispatchMessage(&msg);
+		}
+	}
+
+	FreeLibrary(library);
+
+	printf("%ld events, %ld songs in %.1f s\n", events, songs, (GetTickCount() - start) / 1000.0);
+
+	return 0;
+}
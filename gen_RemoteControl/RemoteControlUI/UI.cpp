@@ -10,6 +10,9 @@ using namespace gen_RemoteControl;
 UI::UI() {
 	this->Text = PLUGIN_NAME;
 
+	windowVisible = false;
+	flushScheduled = 0;
+
 	InitializeComponent();
 }
 
@@ -41,7 +44,7 @@ System::Void UI::linkLabel_LinkClicked(System::Object^  sender, System::Windows:
 /**
 * \brief	UI_Load
 *
-* fills the UI elements with settings from settings file
+* fills the UI elements with settings from settings file and applies the texts the plugin has kept until now
 *
 * \param sender	System::Object^
 * \param e System::EventArgs^
@@ -52,41 +55,23 @@ System::Void UI::UI_Load(System::Object^  sender, System::EventArgs^  e) {
 
 	fillSettingValues();
 
-	checkForNewVersionInvoker();
+	flush();
+
+	host->checkForNewVersion();
 }
 
 
 /**
 * \brief	connectButton_Click
 *
-* executed when connect button is clicked. if client is connected, server is stopped. 
-* if waiting for client, thread is aborted. else server is started.
+* executed when connect button is clicked. if the server is running, all clients are disconnected and the server is stopped.
+* else server is started.
 *
 * \param sender	System::Object^
 * \param e System::EventArgs^
 */
 System::Void UI::connectButton_Click(System::Object^  sender, System::EventArgs^  e) {
-	if (connecting == false) {
-		if(connected == false)
-			startServer();
-		else
-			stopServer(true);
-	}
-	else {
-		// first set connecting = false so accept() can can notice that waiting for client was aborted
-		connecting = false;
-
-		TerminateThread(waitingForClientThread,0);
-
-		shutdownSocket();
-
-		UIManager::setStatusText("Disconnected");
-		UIManager::setButtonText("Start server");
-
-		UIManager::addLogText("Aborted\r\n\r\n");
-
-	}
-			
+	host->connect();
 }
 
 /**
@@ -98,10 +83,19 @@ System::Void UI::connectButton_Click(System::Object^  sender, System::EventArgs^
 * \param e System::EventArgs^
 */
 System::Void UI::saveButton_Click(System::Object^  sender, System::EventArgs^  e) {
-	if (saveSettings() == 1){
-		UIManager::addLogText("Could not save settings!\r\n");
+	UISettings settings;
+
+	if (!Int32::TryParse(portEditBox->Text, settings.port))
+		settings.port = 0;
+
+	settings.autostart = autostartCheckBox->Checked ? 1 : 0;
+	settings.showconfigonstartup = showConfigOnStartupCheckBox->Checked ? 1 : 0;
+	settings.autorestart = autoRestartCheckBox->Checked ? 1 : 0;
+	settings.keepalivemessages = keepAliveCheckBox->Checked ? 1 : 0;
+
+	// the plugin logs the error
+	if (host->save(&settings) == 1)
 		return;
-	}
 
 	saveButton->Enabled = false;
 }
@@ -201,7 +195,7 @@ System::Void UI::UI_FormClosing(System::Object^  sender, System::Windows::Forms:
 			e->Cancel = true;	// prevent from destroying UI
 	}
 	else
-		quit();
+		host->quit();
 }
 
 
@@ -219,21 +213,18 @@ System::Void UI::donatePictureBox_Click(System::Object^  sender, System::EventAr
 
 
 /**
-* \brief	addLogText
+* \brief	setLogText
 *
-* thread save log text change. invokes UI thread to perform log text change if necessary.
+* thread save replacement of the whole log. invokes UI thread to perform log text change if necessary.
 *
 * \param text System::String^
 */
-System::Void UI::addLogText(System::String^ text) {
+System::Void UI::setLogText(System::String^ text) {
 	if (logTextBox->InvokeRequired) {    
-		SetTextDelegate^ d = gcnew SetTextDelegate(this, &UI::addLogText);
+		SetTextDelegate^ d = gcnew SetTextDelegate(this, &UI::setLogText);
 		this->Invoke(d, gcnew array<Object^> { text });
-	} else {
-		string sb;
-		sb.append(time()).append(": ").append(msclr::interop::marshal_as<std::string>(text));
-		logTextBox->Text += gcnew String(sb.c_str());
-	}
+	} else
+		logTextBox->Text = text;
 }
 
 /**
@@ -284,6 +275,39 @@ System::Void UI::setIP(System::String^ text) {
 }
 
 
+/**
+* \brief	setScanText
+*
+* thread save scan progress text change. invokes UI thread to perform scan text change if necessary.
+*
+* \param text System::String^
+*/
+System::Void UI::setScanText(System::String^ text) {
+	if (scanLabel->InvokeRequired) {    
+		SetTextDelegate^ d = gcnew SetTextDelegate(this, &UI::setScanText);
+        this->Invoke(d, gcnew array<Object^> { text });
+	} else
+		scanLabel->Text = text;
+}
+
+
+/**
+* \brief	setMemoryText
+*
+* thread save memory text change. adds the managed heap of the window to the memory of the plugin. invokes UI thread
+* to perform memory text change if necessary.
+*
+* \param text System::String^
+*/
+System::Void UI::setMemoryText(System::String^ text) {
+	if (memoryLabel->InvokeRequired) {    
+		SetTextDelegate^ d = gcnew SetTextDelegate(this, &UI::setMemoryText);
+        this->Invoke(d, gcnew array<Object^> { text });
+	} else
+		memoryLabel->Text = text + ", window " + (System::GC::GetTotalMemory(false) / 1024).ToString() + " KB";
+}
+
+
 /**
 * \brief	newVersionFound
 *
@@ -310,4 +334,81 @@ System::Void UI::backgroundWorker_RunWorkerCompleted(System::Object^  sender, Sy
 		this->Show();
 	else
 		this->Hide();
-}
\ No newline at end of file
+}
+
+/**
+* \brief	fillSettingValues
+*
+* fills the UI fields with the read settings
+*/
+System::Void UI::fillSettingValues() {
+	UISettings settings;
+	host->read(&settings);
+
+	// FILL PORT FIELD
+	portEditBox->Text = settings.port.ToString();
+
+	// FILL CHECKBOXES
+	autostartCheckBox->Checked = settings.autostart == 1;
+	showConfigOnStartupCheckBox->Checked = settings.showconfigonstartup == 1;
+	autoRestartCheckBox->Checked = settings.autorestart == 1;
+	keepAliveCheckBox->Checked = settings.keepalivemessages == 1;
+
+	saveButton->Enabled = false;
+}
+
+/**
+* \brief	apply
+*
+* applies an action of the plugin. runs on the UI thread
+*
+* \param action	UIAction type, see UIModule.h
+* \param text	parameter of the action
+*/
+System::Void UI::apply(int action, System::String^ text) {
+	if (action == LOG)
+		setLogText(text);
+	else if (action == STATUS)
+		setStatusText(text);
+	else if (action == BUTTON)
+		setButtonText(text);
+	else if (action == IP)
+		setIP(text);
+	else if (action == SCAN)
+		setScanText(text);
+	else if (action == MEMORY)
+		setMemoryText(text);
+	else if (action == VERSION)
+		newVersionFound(text);
+	else if (action == SETTINGS)
+		fillSettingValues();
+}
+
+/**
+* \brief	scheduleFlush
+*
+* posts one flush to the UI thread for a burst of actions. called on any thread. before the window handle exists
+* the actions wait for UI_Load
+*/
+System::Void UI::scheduleFlush() {
+	if (!IsHandleCreated || System::Threading::Interlocked::Exchange(flushScheduled, 1) == 1)
+		return;
+
+	try {
+		BeginInvoke(gcnew System::Windows::Forms::MethodInvoker(this, &UI::flush));
+	} catch (System::InvalidOperationException^) {
+		// window destroyed in the meantime
+		flushScheduled = 0;
+	}
+}
+
+/**
+* \brief	flush
+*
+* applies the pending actions of the plugin. runs on the UI thread
+*/
+System::Void UI::flush() {
+	System::Threading::Interlocked::Exchange(flushScheduled, 0);
+
+	host->flush(&receive);
+}
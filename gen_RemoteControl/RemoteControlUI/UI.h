@@ -45,6 +45,8 @@ namespace gen_RemoteControl {
 	private: System::Windows::Forms::PictureBox^  donatePictureBox;
 	private: System::Windows::Forms::Label^  donateLabel;
 	private: System::Windows::Forms::Label^  donateLabel2;
+	public: System::Windows::Forms::Label^  scanLabel;
+	public: System::Windows::Forms::Label^  memoryLabel;
 
 	private:
 		/// <summary>
@@ -82,6 +84,8 @@ namespace gen_RemoteControl {
 			this->donatePictureBox = (gcnew System::Windows::Forms::PictureBox());
 			this->donateLabel = (gcnew System::Windows::Forms::Label());
 			this->donateLabel2 = (gcnew System::Windows::Forms::Label());
+			this->scanLabel = (gcnew System::Windows::Forms::Label());
+			this->memoryLabel = (gcnew System::Windows::Forms::Label());
 			this->logGroupBox->SuspendLayout();
 			this->settingsGroupBox->SuspendLayout();
 			(cli::safe_cast<System::ComponentModel::ISupportInitialize^  >(this->donatePictureBox))->BeginInit();
@@ -198,6 +202,7 @@ namespace gen_RemoteControl {
 			// 
 			// settingsGroupBox
 			// 
+			this->settingsGroupBox->Controls->Add(this->scanLabel);
 			this->settingsGroupBox->Controls->Add(this->keepAliveCheckBox);
 			this->settingsGroupBox->Controls->Add(this->autoRestartCheckBox);
 			this->settingsGroupBox->Controls->Add(this->saveButton);
@@ -223,6 +228,22 @@ namespace gen_RemoteControl {
 			this->keepAliveCheckBox->UseVisualStyleBackColor = true;
 			this->keepAliveCheckBox->CheckedChanged += gcnew System::EventHandler(this, &UI::keepAliveCheckBox_CheckedChanged);
 			// 
+			// scanLabel
+			// 
+			this->scanLabel->AutoSize = true;
+			this->scanLabel->Location = System::Drawing::Point(87, 139);
+			this->scanLabel->Name = L"scanLabel";
+			this->scanLabel->Size = System::Drawing::Size(0, 13);
+			this->scanLabel->TabIndex = 12;
+			// 
+			// memoryLabel
+			// 
+			this->memoryLabel->AutoSize = true;
+			this->memoryLabel->Location = System::Drawing::Point(384, 22);
+			this->memoryLabel->Name = L"memoryLabel";
+			this->memoryLabel->Size = System::Drawing::Size(0, 13);
+			this->memoryLabel->TabIndex = 124;
+			// 
 			// staticPortLabel
 			// 
 			this->staticPortLabel->AutoSize = true;
@@ -341,6 +362,7 @@ namespace gen_RemoteControl {
 			this->Controls->Add(this->staticStatusLabel);
 			this->Controls->Add(this->ipLabel);
 			this->Controls->Add(this->copyrightLabel);
+			this->Controls->Add(this->memoryLabel);
 			this->FormBorderStyle = System::Windows::Forms::FormBorderStyle::FixedSingle;
 			this->Icon = (cli::safe_cast<System::Drawing::Icon^  >(resources->GetObject(L"$this.Icon")));
 			this->Name = L"UI";
@@ -378,13 +400,27 @@ private: System::Void donatePictureBox_Click(System::Object^  sender, System::Ev
 public:	 // delegate needed for thread safe UI operations
 		 delegate void SetTextDelegate(System::String^ text);
 		 
-		 System::Void addLogText(System::String^ text);
+		 System::Void setLogText(System::String^ text);
 		 System::Void setStatusText(System::String^ text);
 		 System::Void setButtonText(System::String^ text);
 		 System::Void setIP(System::String^ text);
+		 System::Void setScanText(System::String^ text);
+		 System::Void setMemoryText(System::String^ text);
 
 private: System::Void backgroundWorker_RunWorkerCompleted(System::Object^  sender, System::ComponentModel::RunWorkerCompletedEventArgs^  e);
 
+public:	 // window visibility, applied by backgroundWorker
+		 bool windowVisible;
+
+		 System::Void fillSettingValues();
+		 System::Void apply(int action, System::String^ text);
+		 System::Void scheduleFlush();
+
+private: // 1 while a flush is posted to the UI thread
+		 int flushScheduled;
+
+		 System::Void flush();
+
 };
 }
 
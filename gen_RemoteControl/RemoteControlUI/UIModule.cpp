@@ -0,0 +1,74 @@
+// UIModule.cpp: entry of the configuration window module, loaded by the plugin the first time the window is shown
+
+#include "stdafx.h"
+
+using namespace gen_RemoteControl;
+
+// plugin functions of this module
+const UIHost *host = NULL;
+
+// the window, created by getUIModule on the winamp thread
+static gcroot<UI^> form;
+
+static UIModule module;
+
+
+/**
+* \brief	receive
+*
+* applies an action the plugin hands over. runs on the UI thread
+*
+* \param	action	UIAction type, see UIModule.h
+* \param	text	parameter of the action
+*/
+void receive(int action, const char *text) {
+	form->apply(action, gcnew System::String(text));
+}
+
+/**
+* \brief	show
+*
+* UIModule function: starts the backgroundWorker that shows or hides the window
+*
+* \param	visible	shows window if true, hides window if false
+*/
+static void show(bool visible) {
+	form->windowVisible = visible;
+
+	form->backgroundWorker->RunWorkerAsync();
+}
+
+/**
+* \brief	changed
+*
+* UIModule function: actions of the plugin are pending
+*/
+static void changed() {
+	form->scheduleFlush();
+}
+
+
+/**
+* \brief	getUIModule
+*
+* exports the window for the plugin and creates it
+*
+* \param	plugin	plugin functions of this module
+*
+* \return	window functions, NULL if the plugin has another version
+*/
+extern "C" __declspec(dllexport) UIModule * getUIModule(const UIHost *plugin) {
+	if (plugin->version != UI_MODULE_VERSION)
+		return NULL;
+
+	host = plugin;
+
+	if ((UI^)form == nullptr)
+		form = gcnew UI();
+
+	module.version = UI_MODULE_VERSION;
+	module.show = &show;
+	module.changed = &changed;
+
+	return &module;
+}
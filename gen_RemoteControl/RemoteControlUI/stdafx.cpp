@@ -0,0 +1,4 @@
+// stdafx.cpp : source file that only includes the standard includes.
+// RemoteControlUI.pch is the precompiled header.
+
+#include "stdafx.h"
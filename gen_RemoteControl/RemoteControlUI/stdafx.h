@@ -0,0 +1,18 @@
+// stdafx.h : include file of the configuration window module. the module is managed, the plugin
+// shares only UIModule.h and version.h with it
+#pragma once
+
+#include <windows.h>
+#include <shellapi.h>
+#include <vcclr.h>
+#include <stdlib.h>
+
+#include "version.h"
+#include "UIModule.h"
+#include "UI.h"
+
+// plugin functions of this module, set by getUIModule
+extern const UIHost *host;
+
+// applies an action the plugin hands over on the UI thread, see UIHost::flush
+extern void receive(int action, const char *text);
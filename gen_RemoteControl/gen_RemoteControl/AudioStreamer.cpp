@@ -0,0 +1,809 @@
+#include "stdafx.h"
+
+// IMA ADPCM tables
+static const int adpcmIndex[16] = { -1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8 };
+
+static const int adpcmStep[89] = {
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97,
+	107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+	876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428,
+	4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350,
+	22385, 24623, 27086, 29794, 32767
+};
+
+
+/**
+* \brief	AudioSession
+*
+* constructor
+*/
+AudioSession::AudioSession() {
+	id = 0;
+	active = false;
+}
+
+/**
+* \brief	AudioStreamer
+*
+* constructor
+*/
+AudioStreamer::AudioStreamer() {
+	thread = NULL;
+
+	requestEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+	InitializeCriticalSection(&cs_audiostreamer);
+}
+
+/**
+* \brief	~AudioStreamer
+*
+* destructor
+*/
+AudioStreamer::~AudioStreamer() {
+	CloseHandle(requestEvent);
+	CloseHandle(stopEvent);
+
+	DeleteCriticalSection(&cs_audiostreamer);
+}
+
+/**
+* \brief	start
+*
+* performs an audioStream_ command: replaces the stream of a session by a playlist entry and starts the stream
+* thread if it isn't running. blocks of the previous stream that haven't been sent are dropped
+*
+* \param	session		id of the session
+* \param	position	position in the playlist, -1 for the current track. the stream goes on with the tracks winamp
+*						would play after it as long as they can be predicted, see TrackPrefetch::nextTrack
+* \param	framed		the session uses the framed protocol, the text protocol can't carry the blocks
+*/
+void AudioStreamer::start(const int & session, const int & position, const bool & framed) {
+	int entry = position < 0 ? winampstate.getListPosition() : position;
+
+	const wchar_t *name = (const wchar_t*)SendMessage(plugin.hwndParent,WM_WA_IPC,entry,IPC_GETPLAYLISTFILEW);
+	std::wstring file(name != NULL ? name : L"");
+
+	bool failed = !framed || file.empty();
+
+	// CRITICAL
+	EnterCriticalSection(&cs_audiostreamer);
+
+	AudioSession & state = sessions[session];
+	state.id++;
+	state.active = true;
+	state.blocks.clear();
+
+	AudioRequest & request = pending[session];
+	request.session = session;
+	request.id = state.id;
+	request.position = entry;
+	request.file = failed ? std::wstring() : file;
+
+	if (failed) {
+		stringstream header;
+		header << "audioError_" << state.id << "_" << API_DECODEFILE_FAILURE;
+
+		AudioBlock block;
+		block.header = header.str();
+
+		state.blocks.push_back(block);
+	}
+
+	if (thread == NULL) {
+		ResetEvent(stopEvent);
+
+		thread = CreateThread(NULL, 0, streamFunction, this, 0, NULL);
+	}
+
+	LeaveCriticalSection(&cs_audiostreamer);
+	// CRITICAL END
+
+	if (failed)
+		tasklist.push("audioBlock", -1, session);
+
+	SetEvent(requestEvent);
+}
+
+/**
+* \brief	cancel
+*
+* performs an audioStop command: stops the stream of a session and drops the blocks that haven't been sent
+*
+* \param	session	id of the session
+*/
+void AudioStreamer::cancel(const int & session) {
+	// CRITICAL
+	EnterCriticalSection(&cs_audiostreamer);
+
+	std::map<int, AudioSession>::iterator it = sessions.find(session);
+
+	if (it != sessions.end()) {
+		it->second.active = false;
+		it->second.blocks.clear();
+
+		AudioRequest & request = pending[session];
+		request.session = session;
+		request.id = it->second.id;
+		request.file.clear();
+	}
+
+	LeaveCriticalSection(&cs_audiostreamer);
+	// CRITICAL END
+
+	SetEvent(requestEvent);
+}
+
+/**
+* \brief	drop
+*
+* forgets the stream state of a closed session, the stream thread closes its decoder
+*
+* \param	session	id of the session
+*/
+void AudioStreamer::drop(const int & session) {
+	// CRITICAL
+	EnterCriticalSection(&cs_audiostreamer);
+
+	if (sessions.erase(session) > 0) {
+		AudioRequest & request = pending[session];
+		request.session = session;
+		request.id = 0;
+		request.file.clear();
+	}
+
+	LeaveCriticalSection(&cs_audiostreamer);
+	// CRITICAL END
+
+	SetEvent(requestEvent);
+}
+
+/**
+* \brief	stop
+*
+* closes the streams and waits for the stream thread. called by quit
+*/
+void AudioStreamer::stop() {
+	SetEvent(stopEvent);
+
+	joinThread(thread, AUDIO_STOP_TIMEOUT);
+}
+
+/**
+* \brief	takeRequests
+*
+* closes and opens the streams of the waiting requests. only called by the stream thread
+*/
+void AudioStreamer::takeRequests() {
+	std::vector<AudioRequest> requests;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_audiostreamer);
+
+	for (std::map<int, AudioRequest>::const_iterator it = pending.begin(); it != pending.end(); it++)
+		requests.push_back(it->second);
+
+	pending.clear();
+
+	LeaveCriticalSection(&cs_audiostreamer);
+	// CRITICAL END
+
+	for (unsigned int i = 0; i < requests.size(); i++) {
+		close(requests[i].session);
+
+		if (!requests[i].file.empty())
+			open(requests[i]);
+	}
+}
+
+/**
+* \brief	openDecoder
+*
+* asks for 16 bit at most in stereo and 44.1 kHz, other sample formats are refused
+*
+* \param	file		file to decode
+* \param	parameters	receives the sample format
+* \param	error		receives the API_DECODEFILE_ code if the file can't be decoded
+*
+* \return	decoder, NULL if error
+*/
+ifc_audiostream* const AudioStreamer::openDecoder(const std::wstring & file, AudioParameters & parameters, int & error) {
+	CHECK_DECODEFILE();
+
+	parameters.bitsPerSample = 16;
+	parameters.channels = 2;
+	parameters.sampleRate = 44100;
+	parameters.flags = AUDIOPARAMETERS_MAXCHANNELS | AUDIOPARAMETERS_MAXSAMPLERATE;
+
+	error = API_DECODEFILE_FAILURE;
+
+	if (AGAVE_API_DECODE == NULL)
+		return NULL;
+
+	ifc_audiostream *decoder = AGAVE_API_DECODE->OpenAudioBackground(file.c_str(), &parameters);
+
+	error = parameters.errorCode;
+
+	if (decoder != NULL && (parameters.bitsPerSample != 16 || parameters.channels < 1 || parameters.channels > 2
+		|| parameters.sampleRate < 8000)) {
+		AGAVE_API_DECODE->CloseAudio(decoder);
+
+		decoder = NULL;
+		error = API_DECODEFILE_BAD_RESAMPLE;
+	}
+
+	return decoder;
+}
+
+/**
+* \brief	trackLength
+*
+* \param	position	playlist position
+*
+* \return	milliseconds of the track, -1 if it isn't known without reading the file
+*/
+LONG const AudioStreamer::trackLength(const int & position) {
+	const char *file = (char*)SendMessage(plugin.hwndParent,WM_WA_IPC,position,IPC_GETPLAYLISTFILE);
+
+	Metadata *metadata = file != NULL ? metadatacache.find(file) : NULL;
+
+	if (metadata == NULL)
+		return -1;
+
+	LONG length = -1;
+
+	if (metadata->samples > 0 && metadata->samplerate > 0)
+		length = (LONG)(metadata->samples * 1000 / metadata->samplerate);
+	else if (metadata->length > 0)
+		length = metadata->length * 1000;
+
+	metadata->release();
+
+	return length;
+}
+
+/**
+* \brief	open
+*
+* opens the decoder of a stream, a file that can't be decoded is refused with audioError_
+*
+* \param	request	stream to open
+*/
+void AudioStreamer::open(const AudioRequest & request) {
+	int error;
+
+	AudioStream *stream = new AudioStream();
+	stream->session = request.session;
+	stream->id = request.id;
+	stream->position = request.position;
+	stream->length = trackLength(request.position);
+	stream->decoder = openDecoder(request.file, stream->parameters, error);
+	stream->next = NULL;
+	stream->nextTried = false;
+
+	if (stream->decoder == NULL) {
+		stringstream header;
+		header << "audioError_" << request.id << "_" << error;
+
+		AudioBlock block;
+		block.header = header.str();
+
+		addBlock(request.session, request.id, block);
+
+		delete stream;
+
+		return;
+	}
+
+	stream->started = GetTickCount();
+	stream->elapsed = 0;
+	stream->frames = 0;
+	stream->sequence = 0;
+	stream->level = 0;
+	stream->inTime = 0;
+
+	for (int i = 0; i < 2; i++) {
+		stream->predictor[i] = 0;
+		stream->index[i] = 0;
+	}
+
+	streams[request.session] = stream;
+}
+
+/**
+* \brief	closeStream
+*
+* closes the decoder of a stream and of its pre-rolled next track
+*
+* \param	stream	open stream, deleted
+*/
+void AudioStreamer::closeStream(AudioStream *stream) {
+	if (stream->next != NULL)
+		closeStream(stream->next);
+
+	AGAVE_API_DECODE->CloseAudio(stream->decoder);
+
+	delete stream;
+}
+
+/**
+* \brief	close
+*
+* closes the decoder of the stream of a session if it has one
+*
+* \param	session	id of the session
+*/
+void AudioStreamer::close(const int & session) {
+	std::map<int, AudioStream*>::iterator it = streams.find(session);
+
+	if (it == streams.end())
+		return;
+
+	closeStream(it->second);
+
+	streams.erase(it);
+}
+
+/**
+* \brief	preroll
+*
+* opens the track that follows the one of a stream and decodes its first AUDIO_PREROLL_MS, so the end of the track
+* doesn't wait for the next file to be opened. tried once per track, the stream ends with the track if the next one
+* can't be predicted or decoded
+*
+* \param	stream	open stream
+*/
+void AudioStreamer::preroll(AudioStream *stream) {
+	stream->nextTried = true;
+
+	int position = TrackPrefetch::nextTrack(stream->position);
+
+	const wchar_t *name = position >= 0 ? (const wchar_t*)SendMessage(plugin.hwndParent,WM_WA_IPC,position,IPC_GETPLAYLISTFILEW) : NULL;
+
+	if (name == NULL || name[0] == 0)
+		return;
+
+	int error;
+	std::wstring file(name);
+
+	AudioStream *next = new AudioStream();
+	next->session = stream->session;
+	next->id = stream->id;
+	next->position = position;
+	next->length = trackLength(position);
+	next->decoder = openDecoder(file, next->parameters, error);
+	next->next = NULL;
+	next->nextTried = false;
+
+	if (next->decoder == NULL) {
+		delete next;
+
+		return;
+	}
+
+	next->buffered.resize(next->parameters.sampleRate * AUDIO_PREROLL_MS / 1000 * next->parameters.channels * 2);
+
+	size_t filled = 0;
+	int kill = 0;
+
+	while (filled < next->buffered.size()) {
+		size_t read = next->decoder->ReadAudio(&next->buffered[filled], next->buffered.size() - filled, &kill, &error);
+
+		if (read == 0)
+			break;
+
+		filled += read;
+	}
+
+	next->buffered.resize(filled);
+
+	stream->next = next;
+}
+
+/**
+* \brief	splice
+*
+* replaces the ended track of a stream by the pre-rolled next one. the stream keeps its number, sequence, quality
+* and ADPCM state, the client hears the next track right after the last sample of the previous one
+*
+* \param	stream	open stream with a pre-rolled next track
+*
+* \return	false if the stream isn't current anymore
+*/
+bool const AudioStreamer::splice(AudioStream *stream) {
+	AudioStream *next = stream->next;
+
+	AGAVE_API_DECODE->CloseAudio(stream->decoder);
+
+	// the pacing goes on from the end of the previous track
+	stream->elapsed += (LONG)(stream->frames * 1000 / stream->parameters.sampleRate);
+	stream->frames = 0;
+
+	stream->position = next->position;
+	stream->length = next->length;
+	stream->decoder = next->decoder;
+	stream->parameters = next->parameters;
+	stream->buffered.swap(next->buffered);
+	stream->next = next->next;
+	stream->nextTried = next->nextTried;
+
+	delete next;
+
+	stringstream header;
+	header << "audioTrack_" << stream->id << "_" << stream->position;
+
+	AudioBlock block;
+	block.header = header.str();
+
+	return addBlock(stream->session, stream->id, block);
+}
+
+/**
+* \brief	isCurrent
+*
+* \param	session	id of the session
+* \param	id		number of the stream
+* \param	behind	receives true if the previous blocks haven't been sent yet
+*
+* \return	false if the stream has been replaced or stopped
+*/
+bool const AudioStreamer::isCurrent(const int & session, const LONG & id, bool & behind) {
+	// CRITICAL
+	EnterCriticalSection(&cs_audiostreamer);
+
+	std::map<int, AudioSession>::iterator it = sessions.find(session);
+
+	bool current = it != sessions.end() && it->second.id == id && it->second.active;
+
+	behind = current && it->second.blocks.size() >= AUDIO_MAX_BLOCKS;
+
+	LeaveCriticalSection(&cs_audiostreamer);
+	// CRITICAL END
+
+	if (current && !behind) {
+		Session *target = sessionlist.get(session);
+
+		if (target != NULL) {
+			behind = target->queueDepth > AUDIO_MAX_QUEUE_DEPTH;
+
+			target->release();
+		}
+	}
+
+	return current;
+}
+
+/**
+* \brief	addBlock
+*
+* hands a block to the send thread unless the stream has been replaced or stopped
+*
+* \param	session	id of the session
+* \param	id		number of the stream
+* \param	block	encoded block or message
+*
+* \return	false if the stream isn't current anymore
+*/
+bool const AudioStreamer::addBlock(const int & session, const LONG & id, const AudioBlock & block) {
+	// CRITICAL
+	EnterCriticalSection(&cs_audiostreamer);
+
+	std::map<int, AudioSession>::iterator it = sessions.find(session);
+
+	bool current = it != sessions.end() && it->second.id == id && it->second.active;
+
+	if (current)
+		it->second.blocks.push_back(block);
+
+	LeaveCriticalSection(&cs_audiostreamer);
+	// CRITICAL END
+
+	if (current)
+		tasklist.push("audioBlock", -1, session);
+
+	return current;
+}
+
+/**
+* \brief	sendBlock
+*
+* sends the next block of the stream of a session. only called by the send command thread, the data follows
+* the header line like the picture after coverLength_, so the framed protocol sends it as data frames of a stream
+*
+* \param	session	id of the session
+*/
+void AudioStreamer::sendBlock(const int & session) {
+	AudioBlock block;
+	bool found = false;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_audiostreamer);
+
+	std::map<int, AudioSession>::iterator it = sessions.find(session);
+
+	if (it != sessions.end() && !it->second.blocks.empty()) {
+		block.header.swap(it->second.blocks.front().header);
+		block.data.swap(it->second.blocks.front().data);
+		it->second.blocks.pop_front();
+
+		found = true;
+	}
+
+	LeaveCriticalSection(&cs_audiostreamer);
+	// CRITICAL END
+
+	if (!found)
+		return;
+
+	rawSend(block.header.c_str());
+
+	if (!block.data.empty()) {
+		SharedData *data = new SharedData(TagLib::ByteVector(block.data.data(), block.data.size()));
+
+		outputBuffer.append(data);
+
+		data->release();
+	}
+}
+
+/**
+* \brief	encode
+*
+* encodes PCM as one block of IMA ADPCM. the level lowers the quality: 1 halves the sample rate, 2 is also mono,
+* 3 quarters the sample rate. the block starts with the predictor (16 bit, little endian), the step index and a
+* zero byte per channel, so the client can start with every block. the 4 bit codes of the samples follow
+* interleaved, the lower half of a byte first
+*
+* \param	stream	stream of the block, its ADPCM state is carried on
+* \param	samples	16 bit PCM of the decoder, interleaved
+* \param	frames	number of samples per channel
+* \param	block	receives header and data
+*/
+void AudioStreamer::encode(AudioStream *stream, const short *samples, const unsigned int & frames, AudioBlock & block) {
+	int channels = stream->parameters.channels;
+	int factor = stream->level == 0 ? 1 : (stream->level == 3 ? 4 : 2);
+	int outChannels = stream->level >= 2 ? 1 : channels;
+	int outFrames = frames / factor;
+
+	stringstream header;
+	header << "audioBlock_" << stream->id << "_" << stream->sequence++ << "_" << stream->parameters.sampleRate / factor << "_" << outChannels << "_" << outFrames;
+	block.header = header.str();
+
+	block.data.assign(outChannels * 4 + (outFrames * outChannels + 1) / 2, 0);
+
+	for (int c = 0; c < outChannels; c++) {
+		block.data[c * 4] = (char)(stream->predictor[c] & 0xFF);
+		block.data[c * 4 + 1] = (char)((stream->predictor[c] >> 8) & 0xFF);
+		block.data[c * 4 + 2] = (char)stream->index[c];
+	}
+
+	unsigned int nibble = outChannels * 8;
+
+	for (int f = 0; f < outFrames; f++) {
+		for (int c = 0; c < outChannels; c++, nibble++) {
+			// average of the decimated samples, and of both channels for mono
+			int sum = 0;
+			int count = 0;
+
+			for (int i = f * factor; i < (f + 1) * factor; i++) {
+				for (int j = 0; j < channels; j++) {
+					if (outChannels == 1 || j == c) {
+						sum += samples[i * channels + j];
+						count++;
+					}
+				}
+			}
+
+			int diff = sum / count - stream->predictor[c];
+			int step = adpcmStep[stream->index[c]];
+			int code = 0;
+
+			if (diff < 0) {
+				code = 8;
+				diff = -diff;
+			}
+
+			int delta = step >> 3;
+
+			if (diff >= step) {
+				code |= 4;
+				diff -= step;
+				delta += step;
+			}
+
+			step >>= 1;
+
+			if (diff >= step) {
+				code |= 2;
+				diff -= step;
+				delta += step;
+			}
+
+			step >>= 1;
+
+			if (diff >= step) {
+				code |= 1;
+				delta += step;
+			}
+
+			stream->predictor[c] += (code & 8) ? -delta : delta;
+			stream->predictor[c] = max(-32768, min(32767, stream->predictor[c]));
+			stream->index[c] = max(0, min(88, stream->index[c] + adpcmIndex[code]));
+
+			block.data[nibble / 2] |= (char)((nibble & 1) ? code << 4 : code);
+		}
+	}
+}
+
+/**
+* \brief	produce
+*
+* decodes and encodes the next block of a stream. a session that is behind gets a lower quality, at the lowest
+* one the block is dropped, the stream goes on in time. AUDIO_RAISE_BLOCKS blocks in time raise the quality again.
+* the next track is pre-rolled AUDIO_PREROLL_LEAD before the end and spliced into the block the current one ends
+* in. a next track with another sample format starts a new block
+*
+* \param	stream	stream of the block
+*
+* \return	false if the stream has ended or isn't current anymore
+*/
+bool const AudioStreamer::produce(AudioStream *stream) {
+	unsigned int frameBytes = stream->parameters.channels * 2;
+
+	// a multiple of the largest decimation
+	unsigned int frames = stream->parameters.sampleRate * AUDIO_BLOCK_MS / 1000 / 4 * 4;
+
+	std::vector<char> pcm(frames * frameBytes);
+	size_t filled = 0;
+	size_t counted = 0;
+	int kill = 0;
+	int error = 0;
+
+	if (!stream->nextTried && stream->length > 0
+		&& (LONG)(stream->frames * 1000 / stream->parameters.sampleRate) >= stream->length - AUDIO_PREROLL_LEAD)
+		preroll(stream);
+
+	while (filled < pcm.size()) {
+		size_t read;
+
+		if (!stream->buffered.empty()) {
+			read = min(stream->buffered.size(), pcm.size() - filled);
+
+			memcpy(&pcm[filled], &stream->buffered[0], read);
+			stream->buffered.erase(stream->buffered.begin(), stream->buffered.begin() + read);
+		} else
+			read = stream->decoder->ReadAudio(&pcm[filled], pcm.size() - filled, &kill, &error);
+
+		if (read > 0) {
+			filled += read;
+
+			continue;
+		}
+
+		// without the length of the track the next one is only opened at its end
+		if (!stream->nextTried)
+			preroll(stream);
+
+		if (stream->next == NULL)
+			break;
+
+		bool same = stream->next->parameters.sampleRate == stream->parameters.sampleRate
+			&& stream->next->parameters.channels == stream->parameters.channels;
+
+		if (!same && filled > 0)
+			break;
+
+		stream->frames += (filled - counted) / frameBytes;
+		counted = filled;
+
+		if (!splice(stream))
+			return false;
+
+		// the block size depends on the sample format
+		if (!same)
+			return true;
+	}
+
+	unsigned int decoded = filled / frameBytes;
+
+	if (decoded == 0) {
+		stringstream header;
+		header << "audioEnd_" << stream->id;
+
+		AudioBlock block;
+		block.header = header.str();
+
+		addBlock(stream->session, stream->id, block);
+
+		return false;
+	}
+
+	stream->frames += (filled - counted) / frameBytes;
+
+	bool behind;
+
+	if (!isCurrent(stream->session, stream->id, behind))
+		return false;
+
+	if (behind) {
+		stream->inTime = 0;
+
+		if (stream->level == AUDIO_MAX_LEVEL)
+			return true;
+
+		stream->level++;
+	} else if (++stream->inTime >= AUDIO_RAISE_BLOCKS && stream->level > 0) {
+		stream->inTime = 0;
+		stream->level--;
+	}
+
+	AudioBlock block;
+	encode(stream, (const short*)&pcm[0], decoded, block);
+
+	return addBlock(stream->session, stream->id, block);
+}
+
+/**
+* \brief	due
+*
+* \param	stream	open stream
+* \param	now		tick count
+*
+* \return	milliseconds until the next block of the stream has to be sent, 0 if it is due
+*/
+DWORD const AudioStreamer::due(AudioStream *stream, const DWORD & now) {
+	LONG ahead = stream->elapsed + (LONG)(stream->frames * 1000 / stream->parameters.sampleRate) - AUDIO_PREBUFFER_MS - (LONG)(now - stream->started);
+
+	return ahead > 0 ? (DWORD)ahead : 0;
+}
+
+/**
+* \brief	streamFunction
+*
+* thread of the streams. handles the requests and produces the blocks that are due as MMCSS audio task, or below
+* the priority of winamp's own threads, see ThreadPolicy. closes the streams after the stop event has been set
+*
+* \param	parameter	audio streamer
+*
+* \return	0
+*/
+DWORD WINAPI AudioStreamer::streamFunction(LPVOID parameter) {
+	AudioStreamer *streamer = (AudioStreamer*)parameter;
+
+	HANDLE events[2] = { streamer->stopEvent, streamer->requestEvent };
+	DWORD wait = INFINITE;
+
+	ThreadPolicy policy(THREAD_CLASS_AUDIO);
+
+	while (WaitForMultipleObjects(2, events, FALSE, wait) != WAIT_OBJECT_0) {
+		streamer->takeRequests();
+
+		DWORD now = GetTickCount();
+
+		wait = INFINITE;
+
+		std::map<int, AudioStream*>::iterator it = streamer->streams.begin();
+
+		while (it != streamer->streams.end()) {
+			AudioStream *stream = (it++)->second;
+			bool open = true;
+
+			// never waits, the blocks only use up the budget of the background work
+			GovernorToken token(GOVERNOR_STREAMING, NULL, 0, false);
+
+			while (open && streamer->due(stream, now) == 0)
+				open = streamer->produce(stream);
+
+			if (open)
+				wait = min(wait, streamer->due(stream, now));
+			else
+				streamer->close(stream->session);
+		}
+	}
+
+	while (!streamer->streams.empty())
+		streamer->close(streamer->streams.begin()->first);
+
+	return 0;
+}
@@ -0,0 +1,165 @@
+#pragma once
+#include "stdafx.h"
+
+// milliseconds of audio per block, the client gets one block per period
+#define AUDIO_BLOCK_MS 100
+
+// milliseconds of audio sent at once when a stream starts, the jitter buffer of the client
+#define AUDIO_PREBUFFER_MS 400
+
+// outgoing elements queued for a session above which the quality is lowered and then blocks are dropped,
+// a block needs about two
+#define AUDIO_MAX_QUEUE_DEPTH 16
+
+// blocks waiting for the send thread above which the session counts as behind
+#define AUDIO_MAX_BLOCKS (AUDIO_PREBUFFER_MS / AUDIO_BLOCK_MS + 1)
+
+// blocks that have to leave in time before the quality is raised again
+#define AUDIO_RAISE_BLOCKS 50
+
+// lowest quality, see AudioStreamer::encode
+#define AUDIO_MAX_LEVEL 3
+
+// milliseconds quit waits for the stream thread
+#define AUDIO_STOP_TIMEOUT 2000
+
+// milliseconds before the end of a track the next one is opened, enough for a slow share
+#define AUDIO_PREROLL_LEAD 3000
+
+// milliseconds of the next track decoded when it is opened, the blocks after the splice are due at once
+// while the prebuffer of the client is refilled
+#define AUDIO_PREROLL_MS AUDIO_PREBUFFER_MS
+
+
+// audioStream_ or audioStop command of a session that the stream thread hasn't handled yet
+struct AudioRequest {
+	int session;
+
+	// number of the audioStream_ command of the session, see AudioSession
+	LONG id;
+
+	// playlist entry of the file
+	int position;
+
+	// file to decode, empty to stop the stream
+	std::wstring file;
+};
+
+
+// one message of a stream: audioBlock_<id>_<sequence>_<rate>_<channels>_<frames> followed by the encoded block,
+// or audioTrack_<id>_<position>, audioEnd_<id> and audioError_<id>_<code> without data. audioTrack_ comes before
+// the block that starts with the next playlist entry
+struct AudioBlock {
+	std::string header;
+	std::string data;
+};
+
+
+// stream state of one session
+struct AudioSession {
+	AudioSession();
+
+	// counts the audioStream_ commands of the session from 1, the client numbers them the same way
+	LONG id;
+
+	// false after audioStop, the blocks of the current stream are dropped
+	bool active;
+
+	// encoded blocks waiting for the send thread
+	std::deque<AudioBlock> blocks;
+};
+
+
+// decoder of one stream, only used by the stream thread
+struct AudioStream {
+	int session;
+	LONG id;
+
+	// playlist entry that is decoded
+	int position;
+
+	// milliseconds of the track, -1 if it isn't in the metadata cache
+	LONG length;
+
+	ifc_audiostream *decoder;
+	AudioParameters parameters;
+
+	// PCM decoded ahead, used before the decoder is read again
+	std::vector<char> buffered;
+
+	// pre-rolled next track, NULL until AUDIO_PREROLL_LEAD before the end
+	AudioStream *next;
+
+	// true once the next track has been opened or can't be
+	bool nextTried;
+
+	// tick count of the start, milliseconds of the tracks before the current one and frames of the current one
+	// decoded since, they give the time the next block is due
+	DWORD started;
+	LONG elapsed;
+	__int64 frames;
+
+	unsigned int sequence;
+
+	// quality, 0 is the sample rate and channels of the decoder
+	int level;
+
+	// blocks that left in time since the last change of level
+	int inTime;
+
+	// IMA ADPCM state per channel, carried from block to block
+	int predictor[2];
+	int index[2];
+};
+
+
+// streams files the clients want to listen to as IMA ADPCM over the framed protocol. the files are decoded
+// with api_decodefile in the background, winamp's own decoder and output aren't touched. blocks are paced by
+// the clock after a prebuffer. if the socket falls behind the quality is lowered, then blocks are dropped, so
+// the latency stays bounded
+class AudioStreamer {
+	private:
+		// waiting requests by session
+		std::map<int, AudioRequest> pending;
+
+		// stream state by session
+		std::map<int, AudioSession> sessions;
+
+		// open streams by session, only used by the stream thread
+		std::map<int, AudioStream*> streams;
+
+		HANDLE thread;
+		HANDLE requestEvent;
+		HANDLE stopEvent;
+
+		// critical audio streamer section
+		CRITICAL_SECTION cs_audiostreamer;
+
+		static DWORD WINAPI streamFunction(LPVOID parameter);
+		static void encode(AudioStream *stream, const short *samples, const unsigned int & frames, AudioBlock & block);
+		static ifc_audiostream* const openDecoder(const std::wstring & file, AudioParameters & parameters, int & error);
+		static LONG const trackLength(const int & position);
+		static void closeStream(AudioStream *stream);
+
+		void takeRequests();
+		void open(const AudioRequest & request);
+		void close(const int & session);
+		bool const produce(AudioStream *stream);
+		void preroll(AudioStream *stream);
+		bool const splice(AudioStream *stream);
+		bool const isCurrent(const int & session, const LONG & id, bool & behind);
+		bool const addBlock(const int & session, const LONG & id, const AudioBlock & block);
+		DWORD const due(AudioStream *stream, const DWORD & now);
+
+	public:
+		AudioStreamer();
+
+		~AudioStreamer();
+
+		void start(const int & session, const int & position, const bool & framed);
+		void cancel(const int & session);
+		void drop(const int & session);
+
+		void sendBlock(const int & session);
+		void stop();
+};
@@ -0,0 +1,175 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	Capture
+*
+* constructor, capturing is disabled
+*/
+Capture::Capture() {
+	enabled = 0;
+	last = 0;
+	dropped = 0;
+
+	InitializeCriticalSection(&cs_capture);
+}
+
+/**
+* \brief	~Capture
+*
+* destructor
+*/
+Capture::~Capture() {
+	DeleteCriticalSection(&cs_capture);
+}
+
+/**
+* \brief	appendNumber
+*
+* appends a number as 7 bit groups, the high bit marks that another group follows. must be called inside cs_capture
+*
+* \param	number	number to append
+*/
+void Capture::appendNumber(const unsigned long long & number) {
+	unsigned long long rest = number;
+
+	while (rest >= 0x80) {
+		data.push_back((char)(rest & 0x7F | 0x80));
+		rest >>= 7;
+	}
+
+	data.push_back((char)rest);
+}
+
+/**
+* \brief	append
+*
+* appends one record with the time since the previous one
+*
+* \param	type	CAPTURE_COMMAND, CAPTURE_MESSAGE or CAPTURE_BINARY
+* \param	session	session id, ALL_SESSIONS for a broadcast
+* \param	bytes	payload
+* \param	length	number of bytes of the payload
+*/
+void Capture::append(const int & type, const int & session, const char *bytes, const unsigned int & length) {
+	LONGLONG time = metrics.now();
+
+	// CRITICAL
+	EnterCriticalSection(&cs_capture);
+
+	if (enabled != 0 && data.length() + length + 24 <= CAPTURE_MAX_BYTES) {
+		data.push_back((char)type);
+		data.push_back((char)(session & 0xFF));
+		data.push_back((char)((session >> 8) & 0xFF));
+
+		appendNumber(time > last ? time - last : 0);
+		appendNumber(length);
+
+		data.append(bytes, length);
+
+		last = time;
+	} else if (enabled != 0)
+		dropped++;
+
+	LeaveCriticalSection(&cs_capture);
+	// CRITICAL END
+}
+
+/**
+* \brief	recordCommand
+*
+* records a command received from a client. called by performCommand
+*
+* \param	session	session id
+* \param	command	null terminated command
+*/
+void Capture::recordCommand(const int & session, const char *command) {
+	if (enabled == 0)
+		return;
+
+	append(CAPTURE_COMMAND, session, command, strlen(command));
+}
+
+/**
+* \brief	recordOutput
+*
+* records the lines of an output buffer before it is flushed. binary data is recorded without its bytes
+*
+* \param	session	session id, ALL_SESSIONS for a broadcast
+* \param	output	buffer that is flushed
+*/
+void Capture::recordOutput(const int & session, const OutputBuffer & output) {
+	if (enabled == 0)
+		return;
+
+	std::vector<std::string> lines;
+	bool text = output.getLines(lines);
+
+	for (unsigned int i = 0; i < lines.size(); i++)
+		append(CAPTURE_MESSAGE, session, lines[i].data(), lines[i].length());
+
+	if (!text)
+		append(CAPTURE_BINARY, session, NULL, 0);
+}
+
+/**
+* \brief	enable
+*
+* clears the capture and starts recording
+*/
+void Capture::enable() {
+	// CRITICAL
+	EnterCriticalSection(&cs_capture);
+
+	data.assign(CAPTURE_MAGIC);
+	last = metrics.now();
+	dropped = 0;
+
+	InterlockedExchange(&enabled, 1);
+
+	LeaveCriticalSection(&cs_capture);
+	// CRITICAL END
+}
+
+/**
+* \brief	dump
+*
+* stops recording and writes the capture
+*
+* \param	path	file to write
+*
+* \return	1 if error, 0 if success
+*/
+int const Capture::dump(const std::string & path) {
+	std::string capture;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_capture);
+
+	InterlockedExchange(&enabled, 0);
+
+	capture.swap(data);
+
+	LeaveCriticalSection(&cs_capture);
+	// CRITICAL END
+
+	if (capture.empty())
+		return 1;
+
+	if (dropped > 0) {
+		stringstream droppedStream;
+		droppedStream << "Capture full, " << dropped << " records dropped\r\n";
+
+		UIManager::addLogText(droppedStream.str());
+	}
+
+	ofstream outFile;
+	outFile.open(path.c_str(), ios::out | ios::binary);
+	outFile.write(capture.data(), capture.length());
+
+	bool failed = outFile.fail();
+
+	outFile.close();
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "stdafx.h"
+
+
+// maximum size of a capture in memory, later records are dropped
+#define CAPTURE_MAX_BYTES 67108864
+
+// record types of a capture
+#define CAPTURE_COMMAND 1	// command received from a client
+#define CAPTURE_MESSAGE 2	// text line sent to a session, session 0 for a broadcast
+#define CAPTURE_BINARY 3	// binary data sent to a session, only its length is kept
+
+// first bytes of a capture file
+#define CAPTURE_MAGIC "RCCAPTR1"
+
+class OutputBuffer;
+
+
+// recording of the protocol traffic for replays. disabled it costs one comparison per command and flush.
+// enabled with the capture_1 command, capture_0 writes it to capturePath.
+// file: CAPTURE_MAGIC, then records of type (1 byte), session (2 bytes), microseconds since the previous record
+// and length (7 bit varints, least significant group first) followed by the bytes
+class Capture {
+	private:
+		std::string data;
+		LONGLONG last;
+
+		// records that didn't fit into CAPTURE_MAX_BYTES
+		LONG dropped;
+
+		// critical capture section
+		CRITICAL_SECTION cs_capture;
+
+		void appendNumber(const unsigned long long & number);
+		void append(const int & type, const int & session, const char *bytes, const unsigned int & length);
+
+	public:
+		Capture();
+
+		~Capture();
+
+		volatile LONG enabled;
+
+		void recordCommand(const int & session, const char *command);
+		void recordOutput(const int & session, const OutputBuffer & output);
+
+		void enable();
+		int const dump(const std::string & path);
+};
@@ -0,0 +1,661 @@
+#include "stdafx.h"
+
+
+volatile LONG CoverCache::scales = 0;
+volatile LONGLONG CoverCache::scaleTime = 0;
+
+/**
+* \brief	CoverCache
+*
+* constructor
+*/
+CoverCache::CoverCache() {
+	bytes = 0;
+
+	InitializeCriticalSection(&cs_covers);
+}
+
+/**
+* \brief	~CoverCache
+*
+* destructor
+*/
+CoverCache::~CoverCache() {
+	clear();
+
+	DeleteCriticalSection(&cs_covers);
+}
+
+/**
+* \brief	hash
+*
+* 64 bit FNV-1a hash of the picture bytes as hex string. the clients identify covers with it
+*
+* \param	picture	embedded picture
+*
+* \return	hash
+*/
+std::string const CoverCache::hash(SharedData *picture) {
+	unsigned long long hash = 14695981039346656037ULL;
+
+	const unsigned char *data = (const unsigned char*)picture->bytes.data();
+	unsigned int length = picture->bytes.size();
+
+	for (unsigned int i = 0; i < length; i++) {
+		hash ^= data[i];
+		hash *= 1099511628211ULL;
+	}
+
+	char hex[17];
+	sprintf_s(hex, sizeof(hex), "%016llx", hash);
+
+	return std::string(hex);
+}
+
+/**
+* \brief	decode
+*
+* decodes a picture with GDI+. it reads the picture from a stream on a copy of the bytes, the stream frees it
+*
+* \param	picture	embedded picture
+* \param	input	receives the stream, the caller has to Release() it after the bitmap has been deleted
+*
+* \return	new bitmap, NULL if the stream can't be created
+*/
+Gdiplus::Bitmap* const CoverCache::decode(SharedData *picture, IStream *& input) {
+	input = NULL;
+
+	HGLOBAL data = GlobalAlloc(GMEM_MOVEABLE, picture->bytes.size());
+
+	if (data == NULL)
+		return NULL;
+
+	memcpy(GlobalLock(data), picture->bytes.data(), picture->bytes.size());
+	GlobalUnlock(data);
+
+	if (CreateStreamOnHGlobal(data, TRUE, &input) != S_OK) {
+		GlobalFree(data);
+
+		input = NULL;
+
+		return NULL;
+	}
+
+	return Gdiplus::Bitmap::FromStream(input);
+}
+
+/**
+* \brief	scale
+*
+* decodes the picture and encodes it as jpeg that fits into size x size pixels. doesn't use the cache, so it may
+* run on any thread
+*
+* \param	picture	embedded picture
+* \param	size	maximum width and height
+*
+* \return	new variant with one reference, NULL if the picture is small enough or can't be decoded
+*/
+SharedData* const CoverCache::scale(SharedData *picture, const int & size) {
+	MemoryTag memoryTag(MEMORY_COVERS, (LONG)picture->bytes.size() * GOVERNOR_DECODE_FACTOR);
+
+	LONGLONG started = metrics.now();
+	SharedData *variant = NULL;
+
+	IStream *input;
+	Gdiplus::Bitmap *image = decode(picture, input);
+
+	if (input == NULL)
+		return NULL;
+
+	if (image != NULL && image->GetLastStatus() == Gdiplus::Ok && (image->GetWidth() > (UINT)size || image->GetHeight() > (UINT)size)) {
+		// keep the aspect ratio
+		int width = size;
+		int height = size;
+
+		if (image->GetWidth() > image->GetHeight())
+			height = max(1, (int)(image->GetHeight() * size / image->GetWidth()));
+		else
+			width = max(1, (int)(image->GetWidth() * size / image->GetHeight()));
+
+		Gdiplus::Bitmap bitmap(width, height, PixelFormat24bppRGB);
+
+		Gdiplus::Graphics graphics(&bitmap);
+		graphics.SetInterpolationMode(Gdiplus::InterpolationModeHighQualityBicubic);
+		graphics.DrawImage(image, 0, 0, width, height);
+
+		// jpeg encoder
+		CLSID codec;
+		ULONG quality = COVER_QUALITY;
+
+		Gdiplus::EncoderParameters parameters;
+		parameters.Count = 1;
+		parameters.Parameter[0].Guid = Gdiplus::EncoderQuality;
+		parameters.Parameter[0].Type = Gdiplus::EncoderParameterValueTypeLong;
+		parameters.Parameter[0].NumberOfValues = 1;
+		parameters.Parameter[0].Value = &quality;
+
+		IStream *output = NULL;
+
+		if (jpegEncoder(codec) == 0 && CreateStreamOnHGlobal(NULL, TRUE, &output) == S_OK) {
+			HGLOBAL encoded = NULL;
+
+			if (bitmap.Save(output, &codec, &parameters) == Gdiplus::Ok && GetHGlobalFromStream(output, &encoded) == S_OK) {
+				STATSTG stat;
+
+				if (output->Stat(&stat, STATFLAG_NONAME) == S_OK) {
+					variant = new SharedData(TagLib::ByteVector((const char*)GlobalLock(encoded), (unsigned int)stat.cbSize.QuadPart));
+					GlobalUnlock(encoded);
+				}
+			}
+
+			output->Release();
+		}
+	}
+
+	delete image;
+
+	input->Release();
+
+	if (variant != NULL) {
+		InterlockedIncrement(&scales);
+		Metrics::add(scaleTime, metrics.now() - started);
+	}
+
+	return variant;
+}
+
+#pragma managed(push, off)
+
+/**
+* \brief	packRGB565
+*
+* converts BGRA pixels to RGB565, 8 pixels per step with SSE2. the low bits of every colour are cut
+*
+* \param	source	pixels of GDI+ in PixelFormat32bppARGB
+* \param	target	receives the pixels
+* \param	count	number of pixels
+*/
+static void packRGB565(const unsigned int *source, unsigned short *target, const int count) {
+	__m128i red = _mm_set1_epi32(0xF800);
+	__m128i green = _mm_set1_epi32(0x07E0);
+	__m128i blue = _mm_set1_epi32(0x001F);
+	int i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i*)(source + i));
+		__m128i b = _mm_loadu_si128((const __m128i*)(source + i + 4));
+
+		a = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_srli_epi32(a, 8), red), _mm_and_si128(_mm_srli_epi32(a, 5), green)), _mm_and_si128(_mm_srli_epi32(a, 3), blue));
+		b = _mm_or_si128(_mm_or_si128(_mm_and_si128(_mm_srli_epi32(b, 8), red), _mm_and_si128(_mm_srli_epi32(b, 5), green)), _mm_and_si128(_mm_srli_epi32(b, 3), blue));
+
+		// sign extended from 16 bits, so the signed pack doesn't saturate
+		a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+		b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+
+		_mm_storeu_si128((__m128i*)(target + i), _mm_packs_epi32(a, b));
+	}
+
+	for (; i < count; i++)
+		target[i] = (unsigned short)(((source[i] >> 8) & 0xF800) | ((source[i] >> 5) & 0x07E0) | ((source[i] >> 3) & 0x001F));
+}
+
+/**
+* \brief	swapRedBlue
+*
+* converts BGRA pixels to RGBA, 4 pixels per step with SSE2
+*
+* \param	source	pixels of GDI+ in PixelFormat32bppARGB
+* \param	target	receives the pixels
+* \param	count	number of pixels
+*/
+static void swapRedBlue(const unsigned int *source, unsigned int *target, const int count) {
+	__m128i alphaGreen = _mm_set1_epi32((int)0xFF00FF00);
+	__m128i redBlue = _mm_set1_epi32(0x00FF00FF);
+	int i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128i p = _mm_loadu_si128((const __m128i*)(source + i));
+		__m128i rb = _mm_and_si128(p, redBlue);
+
+		_mm_storeu_si128((__m128i*)(target + i), _mm_or_si128(_mm_and_si128(p, alphaGreen), _mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16))));
+	}
+
+	for (; i < count; i++)
+		target[i] = (source[i] & 0xFF00FF00) | ((source[i] & 0x00FF0000) >> 16) | ((source[i] & 0x000000FF) << 16);
+}
+
+#pragma managed(pop)
+
+/**
+* \brief	pixels
+*
+* decodes the picture and resamples its centre square to exactly size x size pixels, which are converted to the
+* format of the client and compressed losslessly. doesn't use the cache, so it may run on any thread
+*
+* \param	picture	embedded picture
+* \param	size	width and height
+* \param	format	THUMBNAIL_RGB565 or THUMBNAIL_ARGB8888
+*
+* \return	new variant with one reference, a zlib stream of the pixels row by row. NULL if the picture can't be decoded
+*/
+SharedData* const CoverCache::pixels(SharedData *picture, const int & size, const int & format) {
+	MemoryTag memoryTag(MEMORY_COVERS, (LONG)picture->bytes.size() * GOVERNOR_DECODE_FACTOR);
+
+	LONGLONG started = metrics.now();
+	SharedData *variant = NULL;
+
+	IStream *input;
+	Gdiplus::Bitmap *image = decode(picture, input);
+
+	if (input == NULL)
+		return NULL;
+
+	if (image != NULL && image->GetLastStatus() == Gdiplus::Ok && image->GetWidth() > 0 && image->GetHeight() > 0) {
+		int width = image->GetWidth();
+		int height = image->GetHeight();
+		int side = min(width, height);
+
+		Gdiplus::Bitmap bitmap(size, size, PixelFormat32bppARGB);
+
+		{
+			Gdiplus::Graphics graphics(&bitmap);
+
+			// transparent pictures on black, RGB565 has no alpha
+			graphics.Clear(Gdiplus::Color(255, 0, 0, 0));
+			graphics.SetInterpolationMode(Gdiplus::InterpolationModeHighQualityBicubic);
+			graphics.SetPixelOffsetMode(Gdiplus::PixelOffsetModeHighQuality);
+			graphics.DrawImage(image, Gdiplus::Rect(0, 0, size, size), (width - side) / 2, (height - side) / 2, side, side, Gdiplus::UnitPixel);
+		}
+
+		Gdiplus::Rect rect(0, 0, size, size);
+		Gdiplus::BitmapData locked;
+
+		if (bitmap.LockBits(&rect, Gdiplus::ImageLockModeRead, PixelFormat32bppARGB, &locked) == Gdiplus::Ok) {
+			int pixelBytes = format == THUMBNAIL_RGB565 ? 2 : 4;
+
+			std::string raw;
+			raw.resize(size * size * pixelBytes);
+
+			for (int y = 0; y < size; y++) {
+				const unsigned int *row = (const unsigned int*)((const char*)locked.Scan0 + y * locked.Stride);
+
+				if (format == THUMBNAIL_RGB565)
+					packRGB565(row, (unsigned short*)&raw[y * size * pixelBytes], size);
+				else
+					swapRedBlue(row, (unsigned int*)&raw[y * size * pixelBytes], size);
+			}
+
+			bitmap.UnlockBits(&locked);
+
+			uLongf length = compressBound(raw.length());
+			TagLib::ByteVector compressed((unsigned int)length, 0);
+
+			if (compress2((Bytef*)compressed.data(), &length, (const Bytef*)raw.data(), raw.length(), DEFLATE_LEVEL) == Z_OK) {
+				compressed.resize((unsigned int)length);
+
+				variant = new SharedData(compressed);
+			}
+		}
+	}
+
+	delete image;
+
+	input->Release();
+
+	if (variant != NULL) {
+		InterlockedIncrement(&scales);
+		Metrics::add(scaleTime, metrics.now() - started);
+	}
+
+	return variant;
+}
+
+/**
+* \brief	measure
+*
+* decodes the picture and averages its colour over a COVER_SWATCH_SIZE x COVER_SWATCH_SIZE bitmap. may run on any thread
+*
+* \param	picture	embedded picture
+* \param	preview	receives the size and colour, the hash isn't set
+*
+* \return	1 if the picture can't be decoded, 0 if success
+*/
+int const CoverCache::measure(SharedData *picture, CoverPreview & preview) {
+	int result = 1;
+
+	IStream *input;
+	Gdiplus::Bitmap *image = decode(picture, input);
+
+	if (input == NULL)
+		return 1;
+
+	if (image != NULL && image->GetLastStatus() == Gdiplus::Ok) {
+		Gdiplus::Bitmap bitmap(COVER_SWATCH_SIZE, COVER_SWATCH_SIZE, PixelFormat24bppRGB);
+
+		{
+			Gdiplus::Graphics graphics(&bitmap);
+			graphics.SetInterpolationMode(Gdiplus::InterpolationModeHighQualityBilinear);
+			graphics.DrawImage(image, 0, 0, COVER_SWATCH_SIZE, COVER_SWATCH_SIZE);
+		}
+
+		unsigned int red = 0, green = 0, blue = 0;
+
+		for (int y = 0; y < COVER_SWATCH_SIZE; y++) {
+			for (int x = 0; x < COVER_SWATCH_SIZE; x++) {
+				Gdiplus::Color color;
+				bitmap.GetPixel(x, y, &color);
+
+				red += color.GetR();
+				green += color.GetG();
+				blue += color.GetB();
+			}
+		}
+
+		const unsigned int pixels = COVER_SWATCH_SIZE * COVER_SWATCH_SIZE;
+
+		preview.width = image->GetWidth();
+		preview.height = image->GetHeight();
+		preview.color = (red / pixels) << 16 | (green / pixels) << 8 | (blue / pixels);
+
+		result = 0;
+	}
+
+	delete image;
+
+	input->Release();
+
+	return result;
+}
+
+/**
+* \brief	jpegEncoder
+*
+* finds the jpeg encoder of GDI+
+*
+* \param	codec	receives the class id of the encoder
+*
+* \return	1 if error, 0 if success
+*/
+int const CoverCache::jpegEncoder(CLSID & codec) {
+	UINT count = 0;
+	UINT length = 0;
+
+	if (Gdiplus::GetImageEncodersSize(&count, &length) != Gdiplus::Ok || length == 0)
+		return 1;
+
+	std::vector<char> buffer(length);
+	Gdiplus::ImageCodecInfo *encoders = (Gdiplus::ImageCodecInfo*)&buffer[0];
+
+	if (Gdiplus::GetImageEncoders(count, length, encoders) != Gdiplus::Ok)
+		return 1;
+
+	for (UINT i = 0; i < count; i++) {
+		if (wcscmp(encoders[i].MimeType, L"image/jpeg") == 0) {
+			codec = encoders[i].Clsid;
+
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+/**
+* \brief	find
+*
+* returns a cached variant and marks it as recently used. a jpeg variant that isn't cached is read from the cover store
+*
+* \param	hash	hash of the picture
+* \param	size	maximum width and height, 0 for the picture itself
+* \param	format	THUMBNAIL_, the pixels of pixels aren't stored
+*
+* \return	variant, the caller has to release() it. NULL if it is neither cached nor stored
+*/
+SharedData* const CoverCache::find(const std::string & hash, const int & size, const int & format) {
+	SharedData *variant = NULL;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_covers);
+
+	for (std::list<CoverVariant>::iterator it = variants.begin(); it != variants.end(); it++) {
+		if (it->size == size && it->format == format && it->hash == hash) {
+			// most recently used
+			variants.splice(variants.end(), variants, it);
+
+			variant = variants.back().data;
+			variant->addRef();
+
+			break;
+		}
+	}
+
+	LeaveCriticalSection(&cs_covers);
+	// CRITICAL END
+
+	if (variant == NULL && format == THUMBNAIL_JPEG) {
+		variant = coverstore.load(hash, size);
+
+		if (variant != NULL)
+			put(hash, size, variant);
+	}
+
+	return variant;
+}
+
+/**
+* \brief	put
+*
+* adds a variant made by scale or pixels, the least recently used are dropped above COVER_CACHE_SIZE or the share of the memory budget
+*
+* \param	hash	hash of the picture
+* \param	size	maximum width and height
+* \param	variant	variant, the cache takes its own reference
+* \param	format	THUMBNAIL_
+*/
+void CoverCache::put(const std::string & hash, const int & size, SharedData *variant, const int & format) {
+	variant->addRef();
+
+	CoverVariant entry = { hash, size, format, variant };
+
+	// CRITICAL
+	EnterCriticalSection(&cs_covers);
+
+	variants.push_back(entry);
+	bytes += variant->bytes.size();
+	MemoryTag::add(MEMORY_COVERS, variant->bytes.size());
+
+	memorybudget.update(BUDGET_COVERS, bytes, MemoryBudget::cost(scales > 0 ? scaleTime / scales : 0, variants.size(), bytes));
+
+	evict(min((LONGLONG)COVER_CACHE_SIZE, memorybudget.limit(BUDGET_COVERS)));
+
+	LeaveCriticalSection(&cs_covers);
+	// CRITICAL END
+}
+
+/**
+* \brief	evict
+*
+* drops the least recently used variants until the cache takes at most limit bytes. must be called inside cs_covers
+*
+* \param	limit	bytes
+*/
+void CoverCache::evict(const LONGLONG & limit) {
+	if (bytes <= limit)
+		return;
+
+	while (bytes > limit && variants.size() > 1) {
+		bytes -= variants.front().data->bytes.size();
+		MemoryTag::add(MEMORY_COVERS, -(LONG)variants.front().data->bytes.size());
+		variants.front().data->release();
+		variants.pop_front();
+	}
+
+	memorybudget.update(BUDGET_COVERS, bytes, MemoryBudget::cost(scales > 0 ? scaleTime / scales : 0, variants.size(), bytes));
+}
+
+/**
+* \brief	trim
+*
+* BudgetClient function: gives the bytes above limit back to the memory budget
+*
+* \param	limit	bytes the cache may keep
+*/
+void CoverCache::trim(const LONGLONG & limit) {
+	// CRITICAL
+	EnterCriticalSection(&cs_covers);
+
+	evict(limit);
+
+	LeaveCriticalSection(&cs_covers);
+	// CRITICAL END
+}
+
+/**
+* \brief	get
+*
+* returns the variant of a picture that fits into size x size pixels. scaled variants are cached, the least recently used are dropped.
+* the picture and its variants are written to the cover store once. only called by the send command thread
+*
+* \param	picture	embedded picture, NULL if the file hasn't been read. then it is taken from the cover store
+* \param	hash	hash of the picture
+* \param	size	maximum width and height, 0 for the original
+*
+* \return	variant or the picture itself, the caller has to release() it. NULL if there is no picture
+*/
+SharedData* const CoverCache::get(SharedData *picture, const std::string & hash, const int & size) {
+	if (size > 0) {
+		SharedData *variant = find(hash, size);
+
+		if (variant != NULL)
+			return variant;
+	}
+
+	if (picture != NULL)
+		picture->addRef();
+	else if ((picture = find(hash, 0)) == NULL)
+		return NULL;
+
+	coverstore.save(hash, 0, picture);
+
+	if (size > 0) {
+		SharedData *variant = scale(picture, size);
+
+		if (variant != NULL) {
+			put(hash, size, variant);
+
+			coverstore.save(hash, size, variant);
+
+			picture->release();
+
+			return variant;
+		}
+	}
+
+	// small enough or not decodable: the original is sent
+	return picture;
+}
+
+/**
+* \brief	clear
+*
+* drops all cached variants
+*/
+void CoverCache::clear() {
+	// CRITICAL
+	EnterCriticalSection(&cs_covers);
+
+	for (std::list<CoverVariant>::iterator it = variants.begin(); it != variants.end(); it++)
+		it->data->release();
+
+	variants.clear();
+	MemoryTag::add(MEMORY_COVERS, -(LONG)bytes);
+	bytes = 0;
+
+	memorybudget.update(BUDGET_COVERS, 0, 0);
+
+	LeaveCriticalSection(&cs_covers);
+	// CRITICAL END
+}
+
+/**
+* \brief	preview
+*
+* returns the preview of a picture. measured once, the least recently used previews are forgotten. only called by
+* the send command thread
+*
+* \param	picture	embedded picture
+* \param	hash	hash of the picture
+* \param	preview	receives the preview
+*
+* \return	false if the picture can't be decoded
+*/
+bool const CoverCache::preview(SharedData *picture, const std::string & hash, CoverPreview & preview) {
+	for (std::list<CoverPreview>::iterator it = previews.begin(); it != previews.end(); it++) {
+		if (it->hash == hash) {
+			// most recently used
+			previews.splice(previews.end(), previews, it);
+
+			preview = previews.back();
+
+			return true;
+		}
+	}
+
+	if (measure(picture, preview) != 0)
+		return false;
+
+	preview.hash = hash;
+	previews.push_back(preview);
+
+	if (previews.size() > COVER_PREVIEWS)
+		previews.pop_front();
+
+	return true;
+}
+
+/**
+* \brief	addSource
+*
+* remembers the file of a linked cover, a client may ask for it with GET /cover/<hash>. the least recently linked
+* ones are forgotten. only called by the send command thread
+*
+* \param	hash	hash of the picture
+* \param	file	file with the picture
+*/
+void CoverCache::addSource(const std::string & hash, const char *file) {
+	if (file == NULL)
+		return;
+
+	for (std::list<CoverSource>::iterator it = sources.begin(); it != sources.end(); it++) {
+		if (it->hash == hash) {
+			it->file = file;
+			sources.splice(sources.end(), sources, it);
+
+			return;
+		}
+	}
+
+	CoverSource source = { hash, file };
+	sources.push_back(source);
+
+	if (sources.size() > COVER_SOURCES)
+		sources.pop_front();
+}
+
+/**
+* \brief	findSource
+*
+* only called by the send command thread
+*
+* \param	hash	hash of a linked cover
+*
+* \return	file with the picture, empty if the cover hasn't been linked
+*/
+std::string const CoverCache::findSource(const std::string & hash) {
+	for (std::list<CoverSource>::iterator it = sources.begin(); it != sources.end(); it++) {
+		if (it->hash == hash)
+			return it->file;
+	}
+
+	return std::string();
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include "stdafx.h"
+
+// maximum number of bytes of all cached cover variants, less when the memory budget is exceeded
+#define COVER_CACHE_SIZE 4194304
+
+// number of cover hashes a client keeps on disk. the client cache uses the same size and eviction order
+#define COVER_HASHES 256
+
+// jpeg quality of downscaled cover variants
+#define COVER_QUALITY 85
+
+// number of linked covers whose file is remembered for GET /cover/<hash>
+#define COVER_SOURCES 1024
+
+// maximum number of rows of one covers_ request and the largest thumbnail size it may ask for
+#define MAX_COVER_ROWS 100
+#define MAX_THUMBNAIL_SIZE 300
+
+// maximum number of bytes of a thumbnail, a picture that can't be scaled down is only sent if it is smaller
+#define MAX_THUMBNAIL_BYTES 65536
+
+// formats of the thumbnails of covers_: jpeg, or the pixels of a size x size square as a zlib stream, RGB565 or
+// RGBA in the byte order of an Android ARGB_8888 bitmap. the client copies the pixels into a bitmap without a decoder
+#define THUMBNAIL_JPEG 0
+#define THUMBNAIL_RGB565 1
+#define THUMBNAIL_ARGB8888 2
+
+// smaller variants a slow client gets first, largest first
+#define COVER_MEDIUM_SIZE 300
+#define COVER_THUMBNAIL_SIZE 96
+
+// number of cover previews kept, see CoverCache::preview
+#define COVER_PREVIEWS 1024
+
+// width and height of the bitmap the colour of a preview is averaged from
+#define COVER_SWATCH_SIZE 8
+
+// milliseconds after a track change the cover should have arrived, and the ones the requested variant may
+// take when it follows a smaller one
+#define COVER_DEADLINE 300
+#define COVER_UPGRADE_DEADLINE 2000
+
+
+// one downscaled cover
+struct CoverVariant {
+	std::string hash;
+	int size;
+	int format;	// THUMBNAIL_
+	SharedData *data;
+};
+
+// what a client shows until the cover has arrived: the size of the picture and its average colour
+struct CoverPreview {
+	std::string hash;
+	int width;
+	int height;
+	unsigned int color;
+};
+
+// file with a cover that has been linked with coverLink_
+struct CoverSource {
+	std::string hash;
+	std::string file;
+};
+
+
+class CoverCache : public BudgetClient {
+	private:
+		// least recently used variant first, guarded by cs_covers
+		std::list<CoverVariant> variants;
+		unsigned int bytes;
+
+		// critical cover cache section
+		CRITICAL_SECTION cs_covers;
+
+		// scaled variants and the time it took, the cost of a variant for the memory budget
+		static volatile LONG scales;
+		static volatile LONGLONG scaleTime;
+
+		// least recently linked first
+		std::list<CoverSource> sources;
+
+		// least recently used first
+		std::list<CoverPreview> previews;
+
+		static Gdiplus::Bitmap* const decode(SharedData *picture, IStream *& input);
+		static int const jpegEncoder(CLSID & codec);
+		static int const measure(SharedData *picture, CoverPreview & preview);
+
+		void evict(const LONGLONG & limit);
+
+	public:
+		CoverCache();
+
+		~CoverCache();
+
+		static std::string const hash(SharedData *picture);
+		static SharedData* const scale(SharedData *picture, const int & size);
+		static SharedData* const pixels(SharedData *picture, const int & size, const int & format);
+
+		SharedData* const find(const std::string & hash, const int & size, const int & format = THUMBNAIL_JPEG);
+		void put(const std::string & hash, const int & size, SharedData *variant, const int & format = THUMBNAIL_JPEG);
+		SharedData* const get(SharedData *picture, const std::string & hash, const int & size);
+		void clear();
+		virtual void trim(const LONGLONG & limit);
+
+		bool const preview(SharedData *picture, const std::string & hash, CoverPreview & preview);
+
+		void addSource(const std::string & hash, const char *file);
+		std::string const findSource(const std::string & hash);
+};
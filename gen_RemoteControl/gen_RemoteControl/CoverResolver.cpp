@@ -0,0 +1,177 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	CoverResolver
+*
+* constructor
+*/
+CoverResolver::CoverResolver() {
+	InitializeCriticalSection(&cs_coverresolver);
+}
+
+/**
+* \brief	~CoverResolver
+*
+* destructor
+*/
+CoverResolver::~CoverResolver() {
+	DeleteCriticalSection(&cs_coverresolver);
+}
+
+/**
+* \brief	directoryOf
+*
+* \param	file		path of the file
+* \param	directory	receives the lower case full path of the directory of the file
+* \param	modified	receives the last write time of the directory, it changes when a picture is added
+*
+* \return	false if the file is no local file
+*/
+bool const CoverResolver::directoryOf(const char *file, std::string & directory, FILETIME & modified) {
+	char fullPath[MAX_PATH];
+	char *name = NULL;
+
+	if (GetFullPathNameA(file, MAX_PATH, fullPath, &name) == 0 || name == NULL)
+		return false;
+
+	directory = std::string(fullPath, name);
+	std::transform(directory.begin(), directory.end(), directory.begin(), tolower);
+
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+
+	if (GetFileAttributesExA(directory.c_str(), GetFileExInfoStandard, &attributes) == 0)
+		return false;
+
+	modified = attributes.ftLastWriteTime;
+
+	return true;
+}
+
+/**
+* \brief	resolve
+*
+* asks the album art providers of winamp for the cover of a file. the folder and database providers are skipped
+* for directories they found no cover for before, unless the directory has been modified since
+*
+* \param	file			path of the file
+* \param	embeddedRead	TagLib has already looked for an embedded picture, the embedded providers are skipped
+*
+* \return	picture, empty if there is none
+*/
+TagLib::ByteVector const CoverResolver::resolve(const char *file, const bool & embeddedRead) {
+	TagLib::ByteVector picture;
+
+	if (file == NULL || WASABI_API_SVC == NULL || WASABI_API_MEMMGR == NULL)
+		return picture;
+
+	TraceSpan span("cover_resolve");
+	SlowOperation slow("cover_resolve", file);
+
+	std::string directory;
+	FILETIME modified;
+
+	bool local = directoryOf(file, directory, modified);
+
+	slow.stage("directory");
+	bool skipFolder = false;
+
+	if (local) {
+		// CRITICAL
+		EnterCriticalSection(&cs_coverresolver);
+
+		std::map<std::string, FILETIME>::iterator it = misses.find(directory);
+		skipFolder = it != misses.end() && CompareFileTime(&it->second, &modified) == 0;
+
+		LeaveCriticalSection(&cs_coverresolver);
+		// CRITICAL END
+	}
+
+	if (skipFolder && embeddedRead) {
+		InterlockedIncrement(&metrics.coverMisses);
+
+		return picture;
+	}
+
+	CA2W filename(file);
+	bool askedFolder = false;
+
+	FOURCC type = svc_albumArtProvider::getServiceType();
+	size_t providers = WASABI_API_SVC->service_getNumServices(type);
+
+	for (size_t i = 0; i < providers && picture.isEmpty(); i++) {
+		waServiceFactory *factory = WASABI_API_SVC->service_enumService(type, i);
+
+		if (factory == NULL)
+			continue;
+
+		svc_albumArtProvider *provider = (svc_albumArtProvider*)factory->getInterface();
+
+		if (provider == NULL)
+			continue;
+
+		bool embedded = provider->ProviderType() == ALBUMARTPROVIDER_TYPE_EMBEDDED;
+
+		if (!(embedded ? embeddedRead : skipFolder) && provider->IsMine(filename)) {
+			void *bits = NULL;
+			size_t length = 0;
+			wchar_t *mimeType = NULL;
+
+			if (!embedded)
+				askedFolder = true;
+
+			if (provider->GetAlbumArtData(filename, L"cover", &bits, &length, &mimeType) == ALBUMARTPROVIDER_SUCCESS && bits != NULL && length > 0)
+				picture = TagLib::ByteVector((const char*)bits, (unsigned int)length);
+
+			// allocated by the provider with the memory manager of winamp
+			if (bits != NULL)
+				WASABI_API_MEMMGR->sysFree(bits);
+			if (mimeType != NULL)
+				WASABI_API_MEMMGR->sysFree(mimeType);
+		}
+
+		factory->releaseInterface(provider);
+	}
+
+	slow.stage("providers");
+	slow.addBytes(picture.size());
+
+	if (!picture.isEmpty())
+		InterlockedIncrement(&metrics.coversProvided);
+	else if (skipFolder)
+		InterlockedIncrement(&metrics.coverMisses);
+
+	if (local && askedFolder) {
+		// CRITICAL
+		EnterCriticalSection(&cs_coverresolver);
+
+		if (!picture.isEmpty())
+			misses.erase(directory);
+		else {
+			if (misses.size() >= COVER_MISSES)
+				misses.clear();
+
+			misses[directory] = modified;
+		}
+
+		LeaveCriticalSection(&cs_coverresolver);
+		// CRITICAL END
+	}
+
+	return picture;
+}
+
+/**
+* \brief	clear
+*
+* forgets the album directories without cover
+*/
+void CoverResolver::clear() {
+	// CRITICAL
+	EnterCriticalSection(&cs_coverresolver);
+
+	misses.clear();
+
+	LeaveCriticalSection(&cs_coverresolver);
+	// CRITICAL END
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "stdafx.h"
+
+// maximum number of album directories remembered without cover, all are forgotten when it is exceeded
+#define COVER_MISSES 1024
+
+
+// finds the covers TagLib doesn't read: asks the album art providers of winamp (folder art, cover libraries and the
+// embedded art of the input plugins). album directories without art are remembered until they are modified, so the
+// providers aren't asked again for every track of the album
+class CoverResolver {
+	private:
+		// last write time of the album directories the folder and database providers found no cover for, by lower case path
+		std::map<std::string, FILETIME> misses;
+
+		// critical cover resolver section
+		CRITICAL_SECTION cs_coverresolver;
+
+		static bool const directoryOf(const char *file, std::string & directory, FILETIME & modified);
+
+	public:
+		CoverResolver();
+
+		~CoverResolver();
+
+		TagLib::ByteVector const resolve(const char *file, const bool & embeddedRead);
+		void clear();
+};
@@ -0,0 +1,469 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	CoverStore
+*
+* constructor, the store is disabled until open
+*/
+CoverStore::CoverStore() {
+	bytes = 0;
+	loads = 0;
+	writes = 0;
+	collected = 0;
+
+	InitializeCriticalSection(&cs_coverstore);
+}
+
+/**
+* \brief	~CoverStore
+*
+* destructor
+*/
+CoverStore::~CoverStore() {
+	DeleteCriticalSection(&cs_coverstore);
+}
+
+/**
+* \brief	key
+*
+* \param	hash	hash of the picture, see CoverCache::hash
+* \param	size	size of the variant, 0 for the picture itself
+*
+* \return	<hash>_<size>
+*/
+std::string const CoverStore::key(const std::string & hash, const int & size) {
+	stringstream key;
+	key << hash << "_" << size;
+
+	return key.str();
+}
+
+/**
+* \brief	now
+*
+* \return	current time as FILETIME
+*/
+ULONGLONG const CoverStore::now() {
+	FILETIME time;
+	GetSystemTimeAsFileTime(&time);
+
+	return ((ULONGLONG)time.dwHighDateTime << 32) | time.dwLowDateTime;
+}
+
+/**
+* \brief	open
+*
+* lists the stored covers and enables the store. files of interrupted writes are deleted. called by the startup thread
+*
+* \param	directory	directory of the store with a trailing backslash, created if it doesn't exist
+*/
+void CoverStore::open(const std::string & directory) {
+	CreateDirectoryA(directory.c_str(), NULL);
+
+	std::map<std::string, StoredCover> found;
+	ULONGLONG total = 0;
+
+	WIN32_FIND_DATAA data;
+	HANDLE search = FindFirstFileA((directory + "*").c_str(), &data);
+
+	if (search != INVALID_HANDLE_VALUE) {
+		do {
+			const char *dot = strrchr(data.cFileName, '.');
+
+			if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0 || dot == NULL)
+				continue;
+
+			if (strcmp(dot, ".tmp") == 0) {
+				DeleteFileA((directory + data.cFileName).c_str());
+
+				continue;
+			}
+
+			StoredCover cover = { data.cFileName, data.nFileSizeLow,
+				((ULONGLONG)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime };
+
+			found[std::string(data.cFileName, dot)] = cover;
+			total += cover.bytes;
+		} while (FindNextFileA(search, &data));
+
+		FindClose(search);
+	}
+
+	// CRITICAL
+	EnterCriticalSection(&cs_coverstore);
+
+	this->directory = directory;
+	covers.swap(found);
+	bytes = total;
+
+	LeaveCriticalSection(&cs_coverstore);
+	// CRITICAL END
+
+	collect();
+}
+
+/**
+* \brief	contains
+*
+* \param	hash	hash of the picture
+* \param	size	size of the variant, 0 for the picture itself
+*
+* \return	true if the variant is stored
+*/
+bool const CoverStore::contains(const std::string & hash, const int & size) {
+	// CRITICAL
+	EnterCriticalSection(&cs_coverstore);
+
+	bool found = !directory.empty() && covers.find(key(hash, size)) != covers.end();
+
+	LeaveCriticalSection(&cs_coverstore);
+	// CRITICAL END
+
+	return found;
+}
+
+/**
+* \brief	openCover
+*
+* opens the file of a stored variant and marks it as used. a file that has been deleted by somebody else is forgotten
+*
+* \param	hash	hash of the picture
+* \param	size	size of the variant, 0 for the picture itself
+* \param	name	receives the name of the file
+* \param	length	receives the number of bytes of the file
+*
+* \return	file handle, INVALID_HANDLE_VALUE if the variant isn't stored
+*/
+HANDLE const CoverStore::openCover(const std::string & hash, const int & size, std::string & name, DWORD & length) {
+	std::string cover = key(hash, size);
+	std::string path;
+	bool touch = false;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_coverstore);
+
+	std::map<std::string, StoredCover>::iterator it = covers.find(cover);
+
+	if (it != covers.end() && !directory.empty()) {
+		ULONGLONG time = now();
+
+		name = it->second.name;
+		path = directory + name;
+
+		touch = time - it->second.used > (ULONGLONG)COVER_STORE_TOUCH_INTERVAL * 10000000;
+
+		if (touch)
+			it->second.used = time;
+	}
+
+	LeaveCriticalSection(&cs_coverstore);
+	// CRITICAL END
+
+	if (path.empty())
+		return INVALID_HANDLE_VALUE;
+
+	// the collection may delete it while it is sent
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | FILE_WRITE_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+		OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+	LARGE_INTEGER fileSize;
+
+	if (file != INVALID_HANDLE_VALUE && (GetFileSizeEx(file, &fileSize) == FALSE || fileSize.QuadPart == 0 || fileSize.QuadPart > COVER_STORE_MAX_BYTES)) {
+		CloseHandle(file);
+
+		file = INVALID_HANDLE_VALUE;
+	}
+
+	if (file == INVALID_HANDLE_VALUE) {
+		// CRITICAL
+		EnterCriticalSection(&cs_coverstore);
+
+		it = covers.find(cover);
+
+		if (it != covers.end()) {
+			bytes -= it->second.bytes;
+			covers.erase(it);
+		}
+
+		LeaveCriticalSection(&cs_coverstore);
+		// CRITICAL END
+
+		return INVALID_HANDLE_VALUE;
+	}
+
+	length = fileSize.LowPart;
+
+	if (touch) {
+		FILETIME time;
+		GetSystemTimeAsFileTime(&time);
+
+		SetFileTime(file, NULL, NULL, &time);
+	}
+
+	return file;
+}
+
+/**
+* \brief	load
+*
+* reads a stored variant into memory
+*
+* \param	hash	hash of the picture
+* \param	size	size of the variant, 0 for the picture itself
+*
+* \return	variant, the caller has to release() it. NULL if it isn't stored
+*/
+SharedData* const CoverStore::load(const std::string & hash, const int & size) {
+	std::string name;
+	DWORD length = 0;
+
+	HANDLE file = openCover(hash, size, name, length);
+
+	if (file == INVALID_HANDLE_VALUE)
+		return NULL;
+
+	TagLib::ByteVector bytes(length, 0);
+	DWORD read = 0;
+
+	BOOL done = ReadFile(file, bytes.data(), length, &read, NULL);
+
+	CloseHandle(file);
+
+	if (done == FALSE || read != length)
+		return NULL;
+
+	InterlockedIncrement(&loads);
+
+	return new SharedData(bytes);
+}
+
+/**
+* \brief	openFile
+*
+* opens a stored variant to be sent with TransmitFile, see Session::postSend
+*
+* \param	hash	hash of the picture
+* \param	size	size of the variant, 0 for the picture itself
+* \param	type	receives the content type
+*
+* \return	open file, the caller has to release() it. NULL if the variant isn't stored
+*/
+SharedData* const CoverStore::openFile(const std::string & hash, const int & size, std::string & type) {
+	std::string name;
+	DWORD length = 0;
+
+	HANDLE file = openCover(hash, size, name, length);
+
+	if (file == INVALID_HANDLE_VALUE)
+		return NULL;
+
+	const char *extension = strrchr(name.c_str(), '.');
+
+	if (strcmp(extension, ".jpg") == 0)
+		type = "image/jpeg";
+	else if (strcmp(extension, ".png") == 0)
+		type = "image/png";
+	else
+		type = "application/octet-stream";
+
+	InterlockedIncrement(&loads);
+
+	return new SharedData(file, length);
+}
+
+/**
+* \brief	save
+*
+* stores a variant unless it is stored already. a worker writes it, the caller doesn't wait
+*
+* \param	hash	hash of the picture
+* \param	size	size of the variant, 0 for the picture itself
+* \param	data	variant, referenced until it is written
+*/
+void CoverStore::save(const std::string & hash, const int & size, SharedData *data) {
+	if (data == NULL || data->bytes.isEmpty() || data->bytes.size() > COVER_STORE_MAX_BYTES)
+		return;
+
+	std::string cover = key(hash, size);
+
+	// CRITICAL
+	EnterCriticalSection(&cs_coverstore);
+
+	bool wanted = !directory.empty() && covers.find(cover) == covers.end() && pending.insert(cover).second;
+
+	LeaveCriticalSection(&cs_coverstore);
+	// CRITICAL END
+
+	if (!wanted)
+		return;
+
+	const unsigned char *bytes = (const unsigned char*)data->bytes.data();
+	unsigned int length = data->bytes.size();
+	const char *extension = ".bin";
+
+	if (length >= 2 && bytes[0] == 0xFF && bytes[1] == 0xD8)
+		extension = ".jpg";
+	else if (length >= 4 && memcmp(bytes, "\x89PNG", 4) == 0)
+		extension = ".png";
+
+	StoreRequest *request = new StoreRequest();
+	request->store = this;
+	request->key = cover;
+	request->name = cover + extension;
+	request->data = data;
+
+	data->addRef();
+
+	if (!workpool.submit(writeFunction, request, WORK_PRIORITY_LOW)) {
+		// CRITICAL
+		EnterCriticalSection(&cs_coverstore);
+
+		pending.erase(cover);
+
+		LeaveCriticalSection(&cs_coverstore);
+		// CRITICAL END
+
+		data->release();
+		delete request;
+	}
+}
+
+/**
+* \brief	writeFunction
+*
+* task of the work pool: writes one variant
+*
+* \param	parameter	StoreRequest, deleted here
+*
+* \return	0
+*/
+DWORD WINAPI CoverStore::writeFunction(LPVOID parameter) {
+	StoreRequest *request = (StoreRequest*)parameter;
+
+	request->store->write(request);
+
+	request->data->release();
+	delete request;
+
+	return 0;
+}
+
+/**
+* \brief	write
+*
+* writes a variant to a temporary file and renames it, a file of the store is complete or doesn't exist. collects
+* the least recently used covers if the store has grown over COVER_STORE_SIZE
+*
+* \param	request	variant to write
+*/
+void CoverStore::write(StoreRequest *request) {
+	// CRITICAL
+	EnterCriticalSection(&cs_coverstore);
+
+	std::string path = directory + request->name;
+
+	LeaveCriticalSection(&cs_coverstore);
+	// CRITICAL END
+
+	std::string temporary = path + ".tmp";
+	DWORD length = request->data->bytes.size();
+	bool written = false;
+
+	HANDLE file = CreateFileA(temporary.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+	if (file != INVALID_HANDLE_VALUE) {
+		DWORD count = 0;
+
+		written = WriteFile(file, request->data->bytes.data(), length, &count, NULL) != FALSE && count == length;
+
+		CloseHandle(file);
+
+		written = written && MoveFileExA(temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != FALSE;
+
+		if (!written)
+			DeleteFileA(temporary.c_str());
+	}
+
+	// CRITICAL
+	EnterCriticalSection(&cs_coverstore);
+
+	pending.erase(request->key);
+
+	if (written) {
+		StoredCover cover = { request->name, length, now() };
+
+		covers[request->key] = cover;
+		bytes += length;
+	}
+
+	bool full = bytes > COVER_STORE_SIZE;
+
+	LeaveCriticalSection(&cs_coverstore);
+	// CRITICAL END
+
+	if (written)
+		InterlockedIncrement(&writes);
+
+	if (full)
+		collect();
+}
+
+/**
+* \brief	collect
+*
+* deletes the least recently used covers down to COVER_STORE_TRIMMED if the store is larger than COVER_STORE_SIZE
+*/
+void CoverStore::collect() {
+	std::vector<std::string> deleted;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_coverstore);
+
+	if (bytes > COVER_STORE_SIZE) {
+		std::vector<std::pair<ULONGLONG, std::string> > order;
+		order.reserve(covers.size());
+
+		for (std::map<std::string, StoredCover>::iterator it = covers.begin(); it != covers.end(); it++)
+			order.push_back(std::make_pair(it->second.used, it->first));
+
+		// least recently used first
+		std::sort(order.begin(), order.end());
+
+		for (unsigned int i = 0; i < order.size() && bytes > COVER_STORE_TRIMMED; i++) {
+			std::map<std::string, StoredCover>::iterator it = covers.find(order[i].second);
+
+			bytes -= it->second.bytes;
+			deleted.push_back(directory + it->second.name);
+
+			covers.erase(it);
+		}
+	}
+
+	LeaveCriticalSection(&cs_coverstore);
+	// CRITICAL END
+
+	for (unsigned int i = 0; i < deleted.size(); i++)
+		DeleteFileA(deleted[i].c_str());
+
+	InterlockedExchangeAdd(&collected, (LONG)deleted.size());
+}
+
+/**
+* \brief	report
+*
+* \param	lines	receives one line: number and bytes of the stored covers, reads, writes and deleted covers
+*/
+void CoverStore::report(std::vector<std::string> & lines) {
+	// CRITICAL
+	EnterCriticalSection(&cs_coverstore);
+
+	stringstream line;
+	line << "coverstore covers " << covers.size() << " bytes " << bytes << " loads " << loads << " writes " << writes
+		<< " collected " << collected;
+
+	LeaveCriticalSection(&cs_coverstore);
+	// CRITICAL END
+
+	lines.push_back(line.str());
+}
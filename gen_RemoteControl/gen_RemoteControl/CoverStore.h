@@ -0,0 +1,84 @@
+#pragma once
+#include "stdafx.h"
+
+// bytes of all stored covers, the least recently used ones are deleted above it
+#define COVER_STORE_SIZE (64 * 1024 * 1024)
+
+// bytes the store is trimmed to when it has grown over COVER_STORE_SIZE
+#define COVER_STORE_TRIMMED (48 * 1024 * 1024)
+
+// largest picture that is stored
+#define COVER_STORE_MAX_BYTES (8 * 1024 * 1024)
+
+// seconds after which the use of a stored cover is written to its file again. the time of the last write is the
+// time of the last use, NTFS doesn't keep the last access reliably
+#define COVER_STORE_TOUCH_INTERVAL 86400
+
+
+// one file of the store
+struct StoredCover {
+	std::string name;
+	DWORD bytes;
+
+	// FILETIME of the last use
+	ULONGLONG used;
+};
+
+class CoverStore;
+
+// picture written by a worker of the pool
+struct StoreRequest {
+	CoverStore *store;
+	std::string key;
+	std::string name;
+	SharedData *data;
+};
+
+
+// covers and their scaled variants on disk, named <hash>_<size>.<jpg|png|bin> after the hash of the embedded picture.
+// a picture shared by several albums or files is stored once. a cold start reads a cover from here instead of the
+// audio file, and HTTP clients get it with TransmitFile. written by the workers, the least recently used covers are
+// deleted above COVER_STORE_SIZE
+class CoverStore {
+	private:
+		// with a trailing backslash, empty until open
+		std::string directory;
+
+		// by <hash>_<size>
+		std::map<std::string, StoredCover> covers;
+		ULONGLONG bytes;
+
+		// keys of the pictures a worker is writing
+		std::set<std::string> pending;
+
+		// covers read from the store, written to it and deleted by the collection
+		volatile LONG loads;
+		volatile LONG writes;
+		volatile LONG collected;
+
+		// critical cover store section
+		CRITICAL_SECTION cs_coverstore;
+
+		static std::string const key(const std::string & hash, const int & size);
+		static ULONGLONG const now();
+
+		static DWORD WINAPI writeFunction(LPVOID parameter);
+
+		HANDLE const openCover(const std::string & hash, const int & size, std::string & name, DWORD & length);
+		void write(StoreRequest *request);
+		void collect();
+
+	public:
+		CoverStore();
+
+		~CoverStore();
+
+		void open(const std::string & directory);
+
+		bool const contains(const std::string & hash, const int & size);
+		SharedData* const load(const std::string & hash, const int & size);
+		SharedData* const openFile(const std::string & hash, const int & size, std::string & type);
+		void save(const std::string & hash, const int & size, SharedData *data);
+
+		void report(std::vector<std::string> & lines);
+};
@@ -0,0 +1,312 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	DatagramRoute
+*
+* constructor
+*/
+DatagramRoute::DatagramRoute() {
+	bound = false;
+	sequence = 0;
+
+	memset(&address, 0, sizeof(address));
+}
+
+/**
+* \brief	DatagramChannel
+*
+* constructor
+*/
+DatagramChannel::DatagramChannel() {
+	timer = NULL;
+	busy = 0;
+
+	InitializeCriticalSection(&cs_datagram);
+}
+
+/**
+* \brief	~DatagramChannel
+*
+* destructor
+*/
+DatagramChannel::~DatagramChannel() {
+	DeleteCriticalSection(&cs_datagram);
+}
+
+/**
+* \brief	carries
+*
+* \param	key	name of a state event, see TaskList::stateKey. "levels" for the frames of the level meter
+*
+* \return	true if the state goes over the datagram route of a session that has one
+*/
+bool const DatagramChannel::carries(const std::string & key) {
+	return key.compare("progress_") == 0 || key.compare("tick_") == 0 || key.compare("volume_") == 0 || key.compare("levels") == 0;
+}
+
+/**
+* \brief	newKey
+*
+* \return	DATAGRAM_KEY_BYTES random bytes as hex digits, empty if there is no random source
+*/
+std::string const DatagramChannel::newKey() {
+	HCRYPTPROV provider;
+	BYTE bytes[DATAGRAM_KEY_BYTES];
+
+	if (CryptAcquireContext(&provider, NULL, NULL, PROV_RSA_FULL, CRYPT_VERIFYCONTEXT) == FALSE)
+		return std::string();
+
+	BOOL generated = CryptGenRandom(provider, sizeof(bytes), bytes);
+
+	CryptReleaseContext(provider, 0);
+
+	if (generated == FALSE)
+		return std::string();
+
+	static const char digits[] = "0123456789abcdef";
+	std::string key;
+
+	for (unsigned int i = 0; i < sizeof(bytes); i++) {
+		key += digits[bytes[i] >> 4];
+		key += digits[bytes[i] & 0x0F];
+	}
+
+	return key;
+}
+
+/**
+* \brief	open
+*
+* performs a datagram command: gives the session a new key, a route bound before is replaced. starts the repeat
+* timer if it isn't running
+*
+* \param	session	id of the session
+*
+* \return	datagram_<port>_<key>, datagram_off if the discovery port isn't open
+*/
+std::string const DatagramChannel::open(const int & session) {
+	std::string key = discovery.getSocket() != INVALID_SOCKET ? newKey() : std::string();
+
+	if (key.empty())
+		return "datagram_off";
+
+	// CRITICAL
+	EnterCriticalSection(&cs_datagram);
+
+	DatagramRoute & route = routes[session];
+	route = DatagramRoute();
+	route.key = key;
+
+	LeaveCriticalSection(&cs_datagram);
+	// CRITICAL END
+
+	if (timer == NULL) {
+		HANDLE created = NULL;
+
+		if (CreateTimerQueueTimer(&created, NULL, repeatTimeout, this, DATAGRAM_REPEAT_INTERVAL, DATAGRAM_REPEAT_INTERVAL, WT_EXECUTEDEFAULT) != FALSE
+			&& InterlockedCompareExchangePointer(&timer, created, NULL) != NULL)
+			DeleteTimerQueueTimer(NULL, created, NULL);	// started by another thread in the meantime
+	}
+
+	stringstream answer;
+	answer << "datagram_" << port << "_" << key;
+
+	return answer.str();
+}
+
+/**
+* \brief	receive
+*
+* handles a datagram of the discovery port that isn't a probe. a bind datagram with a known key sets the address
+* of its route and is answered. called by the discovery thread
+*
+* \param	data	datagram, terminated
+* \param	length	bytes of the datagram
+* \param	from	address of the client
+*/
+void DatagramChannel::receive(const char *data, const int & length, const sockaddr_in & from) {
+	size_t prefix = strlen(DATAGRAM_BIND);
+
+	if ((size_t)length < prefix + DATAGRAM_KEY_BYTES * 2 || strncmp(data, DATAGRAM_BIND, prefix) != 0)
+		return;
+
+	// the key has a fixed length, the datagram may end with a line break
+	std::string key(data + prefix, DATAGRAM_KEY_BYTES * 2);
+	bool found = false;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_datagram);
+
+	for (std::map<int, DatagramRoute>::iterator it = routes.begin(); it != routes.end(); it++) {
+		if (it->second.key.compare(key) == 0) {
+			if (!it->second.bound)
+				InterlockedIncrement(&metrics.datagramBinds);
+
+			it->second.bound = true;
+			it->second.address = from;
+
+			found = true;
+			break;
+		}
+	}
+
+	LeaveCriticalSection(&cs_datagram);
+	// CRITICAL END
+
+	if (found)
+		transmit(from, DATAGRAM_BOUND + key);
+}
+
+/**
+* \brief	frame
+*
+* must be called inside cs_datagram
+*
+* \param	route	bound route
+* \param	element	state event
+*
+* \return	datagram of the event with the next number of the route
+*/
+std::string const DatagramChannel::frame(DatagramRoute & route, const std::string & element) {
+	stringstream datagram;
+	datagram << route.key << "_" << ++route.sequence << "_" << element;
+
+	return datagram.str();
+}
+
+/**
+* \brief	transmit
+*
+* sends a datagram from the discovery port, a lost one isn't noticed
+*
+* \param	address		address of the client
+* \param	datagram	data
+*/
+void DatagramChannel::transmit(const sockaddr_in & address, const std::string & datagram) {
+	SOCKET udp = discovery.getSocket();
+
+	if (udp == INVALID_SOCKET)
+		return;
+
+	if (sendto(udp, datagram.c_str(), datagram.length(), 0, (const struct sockaddr*) &address, sizeof(address)) != SOCKET_ERROR)
+		InterlockedIncrement(&metrics.datagramsSent);
+}
+
+/**
+* \brief	send
+*
+* sends a state over the datagram route of a session. called by SessionList::send for the broadcast states and
+* by LevelMeter::sendFrame
+*
+* \param	session	id of the session
+* \param	key		name of the state, see carries
+* \param	element	state event
+*
+* \return	false if the session has no bound route or the state doesn't go over it, the caller sends it over the session
+*/
+bool const DatagramChannel::send(const int & session, const std::string & key, const std::string & element) {
+	if (!carries(key) || element.length() + DATAGRAM_KEY_BYTES * 2 + 12 > DATAGRAM_MAX_SIZE)
+		return false;
+
+	sockaddr_in address;
+	std::string datagram;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_datagram);
+
+	std::map<int, DatagramRoute>::iterator it = routes.find(session);
+	bool bound = it != routes.end() && it->second.bound;
+
+	if (bound) {
+		address = it->second.address;
+		datagram = frame(it->second, element);
+
+		// the meter sends its frames continuously, a lost one is replaced anyway
+		if (key.compare("levels") != 0)
+			it->second.repeats[key] = element;
+	}
+
+	LeaveCriticalSection(&cs_datagram);
+	// CRITICAL END
+
+	if (bound)
+		transmit(address, datagram);
+
+	return bound;
+}
+
+/**
+* \brief	repeatTimeout
+*
+* sends the latest frame of every state that has changed since the last repeat once more, with a new number
+*
+* \param	parameter			datagram channel
+* \param	timerOrWaitFired	unused
+*/
+VOID CALLBACK DatagramChannel::repeatTimeout(PVOID parameter, BOOLEAN timerOrWaitFired) {
+	DatagramChannel *channel = (DatagramChannel*)parameter;
+
+	if (InterlockedExchange(&channel->busy, 1) != 0)
+		return;
+
+	std::vector<std::pair<sockaddr_in, std::string> > datagrams;
+
+	// CRITICAL
+	EnterCriticalSection(&channel->cs_datagram);
+
+	for (std::map<int, DatagramRoute>::iterator it = channel->routes.begin(); it != channel->routes.end(); it++) {
+		DatagramRoute & route = it->second;
+
+		for (std::map<std::string, std::string>::const_iterator state = route.repeats.begin(); state != route.repeats.end(); state++)
+			datagrams.push_back(std::make_pair(route.address, channel->frame(route, state->second)));
+
+		route.repeats.clear();
+	}
+
+	LeaveCriticalSection(&channel->cs_datagram);
+	// CRITICAL END
+
+	for (unsigned int i = 0; i < datagrams.size(); i++)
+		transmit(datagrams[i].first, datagrams[i].second);
+
+	InterlockedExchange(&channel->busy, 0);
+}
+
+/**
+* \brief	drop
+*
+* forgets the route of a closed session
+*
+* \param	session	id of the session
+*/
+void DatagramChannel::drop(const int & session) {
+	// CRITICAL
+	EnterCriticalSection(&cs_datagram);
+
+	routes.erase(session);
+
+	LeaveCriticalSection(&cs_datagram);
+	// CRITICAL END
+}
+
+/**
+* \brief	stop
+*
+* stops the repeats and forgets all routes. called by stopServer before the discovery port is closed
+*/
+void DatagramChannel::stop() {
+	HANDLE running = InterlockedExchangePointer(&timer, NULL);
+
+	// waits for a running repeat, it doesn't send messages to winamp
+	if (running != NULL)
+		DeleteTimerQueueTimer(NULL, running, INVALID_HANDLE_VALUE);
+
+	// CRITICAL
+	EnterCriticalSection(&cs_datagram);
+
+	routes.clear();
+
+	LeaveCriticalSection(&cs_datagram);
+	// CRITICAL END
+}
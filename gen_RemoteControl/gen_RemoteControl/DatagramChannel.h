@@ -0,0 +1,74 @@
+#pragma once
+#include "stdafx.h"
+
+// datagram of a client that binds its address to a session: RemoteControl_bind_<key>, answered with
+// RemoteControl_bound_<key>. the client repeats it until it is answered and when its address may have changed
+#define DATAGRAM_BIND "RemoteControl_bind_"
+#define DATAGRAM_BOUND "RemoteControl_bound_"
+
+// random bytes of a session key, sent as hex digits
+#define DATAGRAM_KEY_BYTES 8
+
+// longest state frame sent as a datagram, a longer one goes over the session
+#define DATAGRAM_MAX_SIZE 1200
+
+// milliseconds after which the latest frame of a state is sent once more, so a lost final value is repaired
+#define DATAGRAM_REPEAT_INTERVAL 250
+
+
+// datagram route of one session
+struct DatagramRoute {
+	DatagramRoute();
+
+	std::string key;
+
+	// false until the bind datagram of the client has arrived
+	bool bound;
+	sockaddr_in address;
+
+	// number of the last frame, the client keeps the frame with the highest number of every state
+	DWORD sequence;
+
+	// latest frame of every state name that hasn't been repeated yet
+	std::map<std::string, std::string> repeats;
+};
+
+
+// optional channel for state that is only useful while it is fresh: progress_, tick_, volume_ and the frames of the
+// level meter. over the session a lost segment holds them back behind the retransmission and everything queued
+// before them. a client asks with the datagram command after the handshake, gets datagram_<port>_<key> and sends
+// the bind datagram to the discovery port. from then on these states are sent to it as <key>_<sequence>_<event>
+// datagrams instead, commands and bulk data stay on the session. nothing is resent except the latest value of a
+// state once, the client drops frames with a lower number than the last one of the same state
+class DatagramChannel {
+	private:
+		// routes by session
+		std::map<int, DatagramRoute> routes;
+
+		HANDLE volatile timer;
+
+		// 1 while a repeat runs, the timer doesn't wait for the last one
+		volatile LONG busy;
+
+		// critical datagram channel section
+		CRITICAL_SECTION cs_datagram;
+
+		static VOID CALLBACK repeatTimeout(PVOID parameter, BOOLEAN timerOrWaitFired);
+		static void transmit(const sockaddr_in & address, const std::string & datagram);
+
+		std::string const frame(DatagramRoute & route, const std::string & element);
+
+	public:
+		DatagramChannel();
+
+		~DatagramChannel();
+
+		static bool const carries(const std::string & key);
+		static std::string const newKey();
+
+		std::string const open(const int & session);
+		void receive(const char *data, const int & length, const sockaddr_in & from);
+		bool const send(const int & session, const std::string & key, const std::string & element);
+		void drop(const int & session);
+		void stop();
+};
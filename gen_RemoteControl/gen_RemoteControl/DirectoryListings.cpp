@@ -0,0 +1,178 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	DirectoryListings
+*
+* constructor
+*/
+DirectoryListings::DirectoryListings() {
+	InitializeCriticalSection(&cs_listings);
+}
+
+/**
+* \brief	~DirectoryListings
+*
+* destructor
+*/
+DirectoryListings::~DirectoryListings() {
+	DeleteCriticalSection(&cs_listings);
+}
+
+/**
+* \brief	attributes
+*
+* returns size and modification time of a file, from the listing of its directory if there is a recent one.
+* a file that is missing from the listing is checked by itself, it may have been created since
+*
+* \param	path		lower case full path of the file
+* \param	attributes	receives the attributes
+*
+* \return	false if the file doesn't exist
+*/
+bool const DirectoryListings::attributes(const std::string & path, WIN32_FILE_ATTRIBUTE_DATA & attributes) {
+	std::string::size_type slash = path.rfind('\\');
+
+	if (slash == std::string::npos)
+		return GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &attributes) != 0;
+
+	std::string directory = path.substr(0, slash);
+	std::string name = path.substr(slash + 1);
+
+	DWORD now = GetTickCount();
+	bool enumerate = false;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_listings);
+
+	std::map<std::string, DirectoryListing>::iterator it = listings.find(directory);
+
+	if (it != listings.end() && now - it->second.listed < LISTING_LIFETIME) {
+		if (it->second.complete) {
+			std::map<std::string, WIN32_FILE_ATTRIBUTE_DATA>::const_iterator file = it->second.files.find(name);
+
+			if (file != it->second.files.end()) {
+				attributes = file->second;
+
+				LeaveCriticalSection(&cs_listings);
+				// CRITICAL END
+
+				return true;
+			}
+		} else
+			enumerate = true;
+	} else {
+		// the first file of the directory, a single check is cheaper than the listing
+		trim(now);
+
+		DirectoryListing & listing = listings[directory];
+		listing.listed = now;
+		listing.complete = false;
+		listing.files.clear();
+	}
+
+	LeaveCriticalSection(&cs_listings);
+	// CRITICAL END
+
+	if (enumerate) {
+		// listed outside of the lock, directories on network shares may take long. a directory that can't be
+		// listed keeps an empty listing, its files are checked by themselves until it expires
+		DirectoryListing listing;
+		list(directory, listing);
+
+		std::map<std::string, WIN32_FILE_ATTRIBUTE_DATA>::const_iterator file = listing.files.find(name);
+		bool found = file != listing.files.end();
+
+		if (found)
+			attributes = file->second;
+
+		// CRITICAL
+		EnterCriticalSection(&cs_listings);
+
+		DirectoryListing & stored = listings[directory];
+		stored.listed = listing.listed;
+		stored.complete = true;
+		stored.files.swap(listing.files);
+
+		LeaveCriticalSection(&cs_listings);
+		// CRITICAL END
+
+		if (found)
+			return true;
+	}
+
+	return GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &attributes) != 0;
+}
+
+/**
+* \brief	list
+*
+* enumerates the files of a directory with large fetches, the basic information level leaves out the short names
+*
+* \param	directory	lower case full path of the directory
+* \param	listing		receives the files, none if the directory can't be listed
+*
+* \return	false if the directory can't be listed
+*/
+bool const DirectoryListings::list(const std::string & directory, DirectoryListing & listing) {
+	std::string pattern = directory + "\\*";
+	WIN32_FIND_DATAA data;
+
+	listing.listed = GetTickCount();
+	listing.complete = true;
+	listing.files.clear();
+
+	HANDLE find = FindFirstFileExA(pattern.c_str(), FindExInfoBasic, &data, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+
+	// windows before 7 knows neither of them
+	if (find == INVALID_HANDLE_VALUE && GetLastError() == ERROR_INVALID_PARAMETER)
+		find = FindFirstFileExA(pattern.c_str(), FindExInfoStandard, &data, FindExSearchNameMatch, NULL, 0);
+
+	if (find == INVALID_HANDLE_VALUE)
+		return false;
+
+	do {
+		if ((data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0)
+			continue;
+
+		std::string name(data.cFileName);
+		std::transform(name.begin(), name.end(), name.begin(), tolower);
+
+		WIN32_FILE_ATTRIBUTE_DATA & attributes = listing.files[name];
+		attributes.dwFileAttributes = data.dwFileAttributes;
+		attributes.ftCreationTime = data.ftCreationTime;
+		attributes.ftLastAccessTime = data.ftLastAccessTime;
+		attributes.ftLastWriteTime = data.ftLastWriteTime;
+		attributes.nFileSizeHigh = data.nFileSizeHigh;
+		attributes.nFileSizeLow = data.nFileSizeLow;
+	} while (FindNextFileA(find, &data) != 0);
+
+	FindClose(find);
+
+	return true;
+}
+
+/**
+* \brief	trim
+*
+* drops the listings that have expired once LISTING_LIMIT directories are known. must be called inside cs_listings
+*
+* \param	now		current tick count
+*/
+void DirectoryListings::trim(const DWORD & now) {
+	if (listings.size() < LISTING_LIMIT)
+		return;
+
+	std::map<std::string, DirectoryListing>::iterator it = listings.begin();
+
+	while (it != listings.end()) {
+		if (now - it->second.listed >= LISTING_LIFETIME)
+			listings.erase(it++);
+		else
+			it++;
+	}
+
+	// all of them are recent, parallel scans of many directories
+	if (listings.size() >= LISTING_LIMIT)
+		listings.clear();
+}
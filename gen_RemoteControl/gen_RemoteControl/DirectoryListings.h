@@ -0,0 +1,45 @@
+#pragma once
+#include "stdafx.h"
+
+// milliseconds a directory listing answers for the sizes and modification times of its files
+#define LISTING_LIFETIME 5000
+
+// number of directory listings that are kept
+#define LISTING_LIMIT 16
+
+
+// files of one directory, enumerated at once
+struct DirectoryListing {
+	// tick count of the enumeration, or of the single file check that came before it
+	DWORD listed;
+
+	// false until the directory has been enumerated
+	bool complete;
+
+	// attributes by lower case file name
+	std::map<std::string, WIN32_FILE_ATTRIBUTE_DATA> files;
+};
+
+
+// checks the files of the metadata cache by directory where change notifications don't help. the first file of a
+// directory is checked by itself, a second one within LISTING_LIFETIME lists the directory with FindFirstFileEx,
+// which returns size and modification time of every file in one call. the next files of an album are answered
+// from the listing without asking the file system
+class DirectoryListings {
+	private:
+		// listings by lower case directory path without the trailing backslash
+		std::map<std::string, DirectoryListing> listings;
+
+		// critical directory listings section
+		CRITICAL_SECTION cs_listings;
+
+		static bool const list(const std::string & directory, DirectoryListing & listing);
+		void trim(const DWORD & now);
+
+	public:
+		DirectoryListings();
+
+		~DirectoryListings();
+
+		bool const attributes(const std::string & path, WIN32_FILE_ATTRIBUTE_DATA & attributes);
+};
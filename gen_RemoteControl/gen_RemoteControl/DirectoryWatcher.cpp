@@ -0,0 +1,265 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	DirectoryWatcher
+*
+* constructor
+*/
+DirectoryWatcher::DirectoryWatcher() {
+	thread = NULL;
+
+	stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+	InitializeCriticalSection(&cs_watcher);
+}
+
+/**
+* \brief	~DirectoryWatcher
+*
+* destructor
+*/
+DirectoryWatcher::~DirectoryWatcher() {
+	CloseHandle(stopEvent);
+
+	DeleteCriticalSection(&cs_watcher);
+}
+
+/**
+* \brief	watch
+*
+* tells whether the changes of a file are notified. the directory of an unknown file is handed to the watcher
+* thread, which is started if it isn't running. its files are only trusted once the request has been issued,
+* a file that has been checked before that may have changed unnoticed
+*
+* \param	path	lower case full path of a file
+*
+* \return	true if the directory of the file is watched
+*/
+bool const DirectoryWatcher::watch(const std::string & path) {
+	std::string::size_type slash = path.rfind('\\');
+
+	if (slash == std::string::npos || slash == 0)
+		return false;
+
+	std::string directory = path.substr(0, slash);
+	bool active = false;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_watcher);
+
+	std::map<std::string, WatchedDirectory*>::iterator it = directories.find(directory);
+
+	if (it != directories.end())
+		active = it->second->active;
+	else if (directories.size() < WATCH_DIRECTORY_LIMIT && WaitForSingleObject(stopEvent, 0) != WAIT_OBJECT_0) {
+		if (thread == NULL)
+			thread = CreateThread(NULL, 0, watchFunction, this, 0, NULL);
+
+		WatchedDirectory *watched = new WatchedDirectory();
+		watched->path = directory;
+		watched->handle = INVALID_HANDLE_VALUE;
+		watched->active = false;
+
+		// the completion routine finds the watcher in the unused event of the request
+		memset(&watched->overlapped, 0, sizeof(OVERLAPPED));
+		watched->overlapped.hEvent = (HANDLE)this;
+
+		directories[directory] = watched;
+
+		if (thread == NULL || QueueUserAPC(addFunction, thread, (ULONG_PTR)watched) == 0)
+			watched->handle = NULL;
+	}
+
+	LeaveCriticalSection(&cs_watcher);
+	// CRITICAL END
+
+	return active;
+}
+
+/**
+* \brief	stop
+*
+* cancels the requests and waits for the watcher thread. called by quit, the directories aren't watched afterwards
+*/
+void DirectoryWatcher::stop() {
+	SetEvent(stopEvent);
+
+	joinThread(thread, WATCH_STOP_TIMEOUT);
+}
+
+/**
+* \brief	setActive
+*
+* changes whether the notifications of a directory arrive. the cached files of a directory that isn't watched
+* anymore are checked again on their next request
+*
+* \param	directory	watched directory
+* \param	active		true if its requests are issued
+*/
+void DirectoryWatcher::setActive(WatchedDirectory *directory, const bool & active) {
+	// CRITICAL
+	EnterCriticalSection(&cs_watcher);
+
+	directory->active = active;
+
+	LeaveCriticalSection(&cs_watcher);
+	// CRITICAL END
+
+	if (!active)
+		metadatacache.invalidateDirectory(directory->path);
+}
+
+/**
+* \brief	request
+*
+* asks for the next change notifications of a directory. file names, sizes and modification times are watched,
+* the subdirectories are not
+*
+* \param	directory	watched directory with an open handle
+*
+* \return	true if the request has been issued
+*/
+bool const DirectoryWatcher::request(WatchedDirectory *directory) {
+	return ReadDirectoryChangesW(directory->handle, directory->buffer, sizeof(directory->buffer), FALSE,
+		FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE, NULL,
+		&directory->overlapped, changeFunction) != FALSE;
+}
+
+/**
+* \brief	addFunction
+*
+* APC of the watcher thread. opens a directory that watch has added and issues its first request. a directory
+* that can't be watched, like shares without change notifications, stays inactive
+*
+* \param	parameter	new directory
+*/
+VOID CALLBACK DirectoryWatcher::addFunction(ULONG_PTR parameter) {
+	WatchedDirectory *directory = (WatchedDirectory*)parameter;
+	DirectoryWatcher *watcher = (DirectoryWatcher*)directory->overlapped.hEvent;
+
+	directory->handle = CreateFileA(directory->path.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+
+	if (directory->handle == INVALID_HANDLE_VALUE) {
+		directory->handle = NULL;
+
+		return;
+	}
+
+	if (request(directory))
+		watcher->setActive(directory, true);
+	else {
+		CloseHandle(directory->handle);
+		directory->handle = NULL;
+	}
+}
+
+/**
+* \brief	changeFunction
+*
+* completion routine of a request, runs in the watcher thread. invalidates the cached entries of the changed
+* files and issues the next request. a notification buffer that overflowed invalidates the whole directory
+*
+* \param	error		result of the request
+* \param	bytes		bytes of the notifications, 0 if some have been lost
+* \param	overlapped	overlapped structure of the watched directory
+*/
+VOID CALLBACK DirectoryWatcher::changeFunction(DWORD error, DWORD bytes, LPOVERLAPPED overlapped) {
+	WatchedDirectory *directory = CONTAINING_RECORD(overlapped, WatchedDirectory, overlapped);
+	DirectoryWatcher *watcher = (DirectoryWatcher*)overlapped->hEvent;
+
+	// the handle has been closed by the stopping thread
+	if (error == ERROR_OPERATION_ABORTED)
+		return;
+
+	if (error != ERROR_SUCCESS && error != ERROR_NOTIFY_ENUM_DIR) {
+		// the share is gone or doesn't notify anymore
+		CloseHandle(directory->handle);
+		directory->handle = NULL;
+
+		watcher->setActive(directory, false);
+
+		return;
+	}
+
+	if (bytes == 0 || error == ERROR_NOTIFY_ENUM_DIR)
+		metadatacache.invalidateDirectory(directory->path);
+	else {
+		const char *position = (const char*)directory->buffer;
+
+		while (1) {
+			const FILE_NOTIFY_INFORMATION *notification = (const FILE_NOTIFY_INFORMATION*)position;
+
+			// the cache keys are the ANSI paths of winamp
+			char name[MAX_PATH];
+			int length = WideCharToMultiByte(CP_ACP, 0, notification->FileName, notification->FileNameLength / sizeof(WCHAR),
+				name, sizeof(name), NULL, NULL);
+
+			if (length > 0) {
+				std::string path = directory->path + "\\" + std::string(name, length);
+				std::transform(path.begin(), path.end(), path.begin(), tolower);
+
+				metadatacache.invalidate(path);
+			}
+
+			if (notification->NextEntryOffset == 0)
+				break;
+
+			position += notification->NextEntryOffset;
+		}
+	}
+
+	// changes between the notification and the next request are lost, the files are checked again
+	if (!request(directory)) {
+		CloseHandle(directory->handle);
+		directory->handle = NULL;
+
+		watcher->setActive(directory, false);
+	}
+}
+
+/**
+* \brief	watchFunction
+*
+* thread of the watcher. waits alertable, so the APCs of watch and the completion routines run in it. when the
+* stop event is set it closes the directories, waits for the cancelled requests and frees them
+*
+* \param	parameter	watcher
+*
+* \return	0
+*/
+DWORD WINAPI DirectoryWatcher::watchFunction(LPVOID parameter) {
+	DirectoryWatcher *watcher = (DirectoryWatcher*)parameter;
+
+	ThreadPolicy policy(THREAD_CLASS_BACKGROUND);
+
+	while (WaitForSingleObjectEx(watcher->stopEvent, INFINITE, TRUE) != WAIT_OBJECT_0);
+
+	// CRITICAL
+	EnterCriticalSection(&watcher->cs_watcher);
+
+	std::map<std::string, WatchedDirectory*> directories;
+	directories.swap(watcher->directories);
+
+	LeaveCriticalSection(&watcher->cs_watcher);
+	// CRITICAL END
+
+	// directories that watch queued after the stop are opened and closed again
+	while (SleepEx(0, TRUE) == WAIT_IO_COMPLETION);
+
+	for (std::map<std::string, WatchedDirectory*>::iterator it = directories.begin(); it != directories.end(); it++) {
+		if (it->second->handle != NULL && it->second->handle != INVALID_HANDLE_VALUE) {
+			CancelIo(it->second->handle);
+			CloseHandle(it->second->handle);
+		}
+	}
+
+	// the completion routines of the cancelled requests still use the buffers
+	while (SleepEx(100, TRUE) == WAIT_IO_COMPLETION);
+
+	for (std::map<std::string, WatchedDirectory*>::iterator it = directories.begin(); it != directories.end(); it++)
+		delete it->second;
+
+	return 0;
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "stdafx.h"
+
+// maximum number of directories that are watched, every one keeps a handle open on its share
+#define WATCH_DIRECTORY_LIMIT 256
+
+// bytes of change notifications one directory receives at once, at most 64 KB over the network
+#define WATCH_BUFFER_SIZE 16384
+
+// milliseconds quit waits for the watcher thread
+#define WATCH_STOP_TIMEOUT 1000
+
+
+// one directory that is watched for changes
+struct WatchedDirectory {
+	// lower case full path without the trailing backslash
+	std::string path;
+
+	HANDLE handle;
+	OVERLAPPED overlapped;
+
+	// true while change notifications arrive. false until the first request has been issued and after it has
+	// failed, the metadata cache checks the files of the directory itself then
+	bool active;
+
+	DWORD buffer[WATCH_BUFFER_SIZE / sizeof(DWORD)];
+};
+
+
+// watches the directories of the cached files with ReadDirectoryChangesW, so the metadata cache doesn't ask the
+// file system for the modification time of every file it returns. a change marks the cached entry of the file as
+// unchecked, a lost notification marks the whole directory. the requests are issued and completed by one thread,
+// which waits alertable for their completion routines
+class DirectoryWatcher {
+	private:
+		// watched directories by lower case path
+		std::map<std::string, WatchedDirectory*> directories;
+
+		HANDLE thread;
+		HANDLE stopEvent;
+
+		// critical directory watcher section
+		CRITICAL_SECTION cs_watcher;
+
+		static DWORD WINAPI watchFunction(LPVOID parameter);
+		static VOID CALLBACK addFunction(ULONG_PTR parameter);
+		static VOID CALLBACK changeFunction(DWORD error, DWORD bytes, LPOVERLAPPED overlapped);
+
+		static bool const request(WatchedDirectory *directory);
+		void setActive(WatchedDirectory *directory, const bool & active);
+
+	public:
+		DirectoryWatcher();
+
+		~DirectoryWatcher();
+
+		bool const watch(const std::string & path);
+		void stop();
+};
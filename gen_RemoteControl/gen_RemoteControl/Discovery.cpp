@@ -0,0 +1,131 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	Discovery
+*
+* constructor
+*/
+Discovery::Discovery() {
+	thread = NULL;
+	socket = INVALID_SOCKET;
+}
+
+/**
+* \brief	start
+*
+* binds the UDP socket and starts the discovery thread. called by startServer after winsock has been started
+*
+* \param	port	port of the server, the probes arrive at the UDP port with the same number
+*
+* \return	1 if error, 0 if success
+*/
+int const Discovery::start(const int & port) {
+	if (thread != NULL)
+		return 0;
+
+	char name[MAX_COMPUTERNAME_LENGTH + 1];
+	DWORD length = sizeof(name);
+
+	if (GetComputerNameA(name, &length) == FALSE)
+		strcpy_s(name, "Winamp");
+
+	stringstream text;
+	text << "RemoteControl_" << port << "_" << PROTOCOL_DEFLATE << "_" << name;
+	answer = text.str();
+
+	SOCKET udp = ::socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+
+	if (udp == INVALID_SOCKET)
+		return 1;
+
+	sockaddr_in local;
+	memset(&local, 0, sizeof(local));
+	local.sin_family = AF_INET;
+	local.sin_addr.s_addr = htonl(INADDR_ANY);
+	local.sin_port = htons(port);
+
+	if (bind(udp, (struct sockaddr*) &local, sizeof(local)) == SOCKET_ERROR) {
+		closesocket(udp);
+
+		return 1;
+	}
+
+	socket = udp;
+	thread = CreateThread(NULL, 0, discoveryFunction, this, 0, NULL);
+
+	if (thread == NULL) {
+		closesocket(udp);
+		socket = INVALID_SOCKET;
+
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+* \brief	stop
+*
+* closes the socket, the blocking recvfrom of the discovery thread returns, and waits for the thread. called by stopServer
+*/
+void Discovery::stop() {
+	SOCKET udp = socket;
+	socket = INVALID_SOCKET;
+
+	if (udp != INVALID_SOCKET)
+		closesocket(udp);
+
+	joinThread(thread, DISCOVERY_STOP_TIMEOUT);
+}
+
+/**
+* \brief	getSocket
+*
+* \return	UDP socket of the port, INVALID_SOCKET while the server doesn't run. DatagramChannel sends from it
+*/
+SOCKET const Discovery::getSocket() const {
+	return socket;
+}
+
+/**
+* \brief	discoveryFunction
+*
+* thread of the discovery. answers every probe to the address it came from, other datagrams are handed to
+* the DatagramChannel. returns when the socket is closed
+*
+* \param	parameter	discovery
+*
+* \return	0
+*/
+DWORD WINAPI Discovery::discoveryFunction(LPVOID parameter) {
+	Discovery *discovery = (Discovery*)parameter;
+
+	ThreadPolicy policy(THREAD_CLASS_INTERACTIVE);
+
+	SOCKET udp = discovery->socket;
+	char buffer[64];
+
+	while (1) {
+		sockaddr_in from;
+		int fromLength = sizeof(from);
+
+		int received = recvfrom(udp, buffer, sizeof(buffer) - 1, 0, (struct sockaddr*) &from, &fromLength);
+
+		if (received == SOCKET_ERROR) {
+			// an ICMP port unreachable of an earlier answer, the socket still works
+			if (WSAGetLastError() == WSAECONNRESET && discovery->socket != INVALID_SOCKET)
+				continue;
+
+			return 0;
+		}
+
+		buffer[received] = '\0';
+
+		// probes may end with a line break
+		if (strncmp(buffer, DISCOVERY_PROBE, strlen(DISCOVERY_PROBE)) == 0)
+			sendto(udp, discovery->answer.c_str(), discovery->answer.length(), 0, (struct sockaddr*) &from, fromLength);
+		else
+			datagramchannel.receive(buffer, received, from);
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "stdafx.h"
+
+// probe of a client looking for servers, broadcast to the UDP port with the number of the server port
+#define DISCOVERY_PROBE "RemoteControl_discover"
+
+// milliseconds stopServer waits for the discovery thread
+#define DISCOVERY_STOP_TIMEOUT 1000
+
+
+// answers the discovery probes of the clients while the server runs, so a client finds the server again after
+// its address has changed. the answer is RemoteControl_<port>_<protocol>_<server id>: the TCP port, the highest
+// protocol of the server (see PROTOCOL_DEFLATE) and the computer name, which tells the servers in a network apart.
+// the other datagrams of the port belong to the DatagramChannel
+class Discovery {
+	private:
+		HANDLE thread;
+		volatile SOCKET socket;
+
+		std::string answer;
+
+		static DWORD WINAPI discoveryFunction(LPVOID parameter);
+
+	public:
+		Discovery();
+
+		int const start(const int & port);
+		void stop();
+
+		SOCKET const getSocket() const;
+};
@@ -14,67 +14,64 @@ int const saveSettings() {
 	
 
 	/////////////// PORT //////////////
-	System::String^ str = UIManager::getUI()->portEditBox->Text;
-
-	pin_ptr<const wchar_t> wch = PtrToStringChars(str);
-	size_t convertedChars = 0;
-	size_t  sizeInBytes = ((str->Length + 1) * 2);
-	errno_t err = 0;
-	char *port_char = (char *)malloc(sizeInBytes);
-
-	err = wcstombs_s(&convertedChars, 
-                    port_char, sizeInBytes,
-                    wch, sizeInBytes);
-	if (err != 0) {
-		file.close();
-		return 1;
-	}
 
-	file << port_char << endl;	// PORT
-	
-	/////////////// AUTOSTART //////////////
+	file << port << endl;
 
-	if (UIManager::getUI()->autostartCheckBox->Checked) {
-		file << 1 << endl;
-		autostart = 1;
-	}
-	else {
-		file << 0 << endl;
-		autostart = 0;
-	}
+	/////////////// AUTOSTART, SHOWCONFIGONSTARTUP, AUTORESTART, KEEP ALIVE MESSAGES //////////////
 
-	/////////////// SHOWCONFIGONSTARTUP //////////////
+	file << autostart << endl;
+	file << showconfigonstartup << endl;
+	file << autorestart << endl;
+	file << keepalivemessages << endl;
 
-	if (UIManager::getUI()->showConfigOnStartupCheckBox->Checked) {
-		file << 1 << endl;
-		showconfigonstartup = 1;
-	}
-	else {
-		file << 0 << endl;
-		showconfigonstartup = 0;
-	}
+	/////////////// SCAN BUDGET //////////////
 
-	/////////////// AUTORESTART //////////////
+	file << scanbudget << endl;
 
-	if (UIManager::getUI()->autoRestartCheckBox->Checked) {
-		file << 1 << endl;
-		autorestart = 1;
-	}
-	else {
-		file << 0 << endl;
-		autorestart = 0;
-	}
+	/////////////// KEEP ALIVE INTERVAL AND MISSES //////////////
 
-	/////////////// KEEP ALIVE MESSAGES //////////////
+	file << keepaliveinterval << endl;
+	file << keepalivemisses << endl;
 
-	if (UIManager::getUI()->keepAliveCheckBox->Checked) {
-		file << 1 << endl;
-		keepalivemessages = 1;
-	}
-	else {
-		file << 0 << endl;
-		keepalivemessages = 0;
-	}
+	/////////////// SOCKET PROFILE //////////////
+
+	file << socketprofile << endl;
+
+	/////////////// TLS TRANSPORT //////////////
+
+	file << tlstransport << endl;
+
+	/////////////// WEB TRANSPORT //////////////
+
+	file << webtransport << endl;
+
+	/////////////// THREAD POLICY //////////////
+
+	file << threadpolicy << endl;
+
+	/////////////// RIO TRANSPORT //////////////
+
+	file << riotransport << endl;
+
+	/////////////// SLOW THRESHOLD //////////////
+
+	file << slowthreshold << endl;
+
+	/////////////// LOG LEVEL //////////////
+
+	file << loglevel << endl;
+
+	/////////////// HOST PROCESS //////////////
+
+	file << hostprocess << endl;
+
+	/////////////// UPLINK //////////////
+
+	file << uplink << endl;
+
+	/////////////// DASHBOARD WEIGHT //////////////
+
+	file << dashboardweight << endl;
 
 
 	// check
@@ -88,37 +85,6 @@ int const saveSettings() {
 	return 0;
 }
 
-/**
-* \brief	fillSettingValues
-*
-* fills the UI fields with the read settings
-*/
-void fillSettingValues() {
-	// FILL PORT FIELD
-	stringstream portStream;
-	portStream << port;
-
-	System::String^ portString = gcnew String(portStream.str().c_str());
-
-	UIManager::getUI()->portEditBox->Text = portString;
-
-	// FILL CHECKBOXES
-				 
-	if (autostart == 1)
-		UIManager::getUI()->autostartCheckBox->Checked = true;
-				 
-	if (showconfigonstartup == 1)
-		UIManager::getUI()->showConfigOnStartupCheckBox->Checked = true;
-
-	if (autorestart == 1)
-		UIManager::getUI()->autoRestartCheckBox->Checked = true;
-
-	if (keepalivemessages == 1)
-		UIManager::getUI()->keepAliveCheckBox->Checked = true;
-
-	UIManager::getUI()->saveButton->Enabled = false;
-}
-
 /** \brief	createNewSettingsFile
 *
 * deletes an old settings file and creates a new one
@@ -142,6 +108,19 @@ int const createNewSettingsFile() {
 	showconfigonstartup = 1;
 	autorestart = 1;
 	keepalivemessages = 1;
+	scanbudget = 20;
+	keepaliveinterval = 5;
+	keepalivemisses = 3;
+	socketprofile = 1;
+	tlstransport = 1;
+	webtransport = 1;
+	threadpolicy = 2;
+	riotransport = 0;
+	slowthreshold = 250;
+	loglevel = 2;
+	hostprocess = 0;
+	uplink = 0;
+	dashboardweight = 1;
 
 
 	// create new file
@@ -153,12 +132,25 @@ int const createNewSettingsFile() {
 	outFile << "1" << endl;		// SHOWCONFIGONSTARTUP
 	outFile << "1" << endl;		// AUTORESTART
 	outFile << "1" << endl;		// KEEP ALIVE MESSAGES
+	outFile << "20" << endl;	// SCAN BUDGET
+	outFile << "5" << endl;		// KEEP ALIVE INTERVAL
+	outFile << "3" << endl;		// KEEP ALIVE MISSES
+	outFile << "1" << endl;		// SOCKET PROFILE
+	outFile << "1" << endl;		// TLS TRANSPORT
+	outFile << "1" << endl;		// WEB TRANSPORT
+	outFile << "2" << endl;		// THREAD POLICY
+	outFile << "0" << endl;		// RIO TRANSPORT
+	outFile << "250" << endl;	// SLOW THRESHOLD
+	outFile << "2" << endl;		// LOG LEVEL
+	outFile << "0" << endl;		// HOST PROCESS
+	outFile << "0" << endl;		// UPLINK
+	outFile << "1" << endl;		// DASHBOARD WEIGHT
 
 	// check
 	if (outFile.fail()) {
 		outFile.close();
 
-		UIManager::getUI()->addLogText("creating new settings file failed. please delete this file: " + gcnew String(settingsPath.c_str()) + "\r\n");
+		UIManager::addLogText("creating new settings file failed. please delete this file: " + settingsPath + "\r\n", LOG_ERROR);
 
 		return 1;
 	}
@@ -166,9 +158,9 @@ int const createNewSettingsFile() {
 	outFile.close();
 
 	// fill UI
-	fillSettingValues();
+	UIManager::settingsChanged();
 
-	UIManager::getUI()->addLogText("settings file restored\r\n");
+	UIManager::addLogText("settings file restored\r\n");
 
 	return 0;
 }
@@ -272,6 +264,123 @@ int const readSettings() {
 		return 0;
 	}
 
+	// READ SCANBUDGET, missing in older settings files
+	buf = new char[6];
+	inFile.getline(buf,6);
+
+	if (!inFile.fail())
+		scanbudget = atoi(buf);
+
+	delete []buf;
+
+	// READ KEEPALIVEINTERVAL
+	buf = new char[6];
+	inFile.getline(buf,6);
+
+	if (!inFile.fail())
+		keepaliveinterval = atoi(buf);
+
+	delete []buf;
+
+	// READ KEEPALIVEMISSES
+	buf = new char[6];
+	inFile.getline(buf,6);
+
+	if (!inFile.fail())
+		keepalivemisses = atoi(buf);
+
+	delete []buf;
+
+	// READ SOCKETPROFILE
+	buf = new char[2];
+	inFile.getline(buf,2);
+
+	if (!inFile.fail())
+		socketprofile = atoi(buf);
+
+	delete []buf;
+
+	// READ TLSTRANSPORT
+	buf = new char[2];
+	inFile.getline(buf,2);
+
+	if (!inFile.fail())
+		tlstransport = atoi(buf);
+
+	delete []buf;
+
+	// READ WEBTRANSPORT
+	buf = new char[2];
+	inFile.getline(buf,2);
+
+	if (!inFile.fail())
+		webtransport = atoi(buf);
+
+	delete []buf;
+
+	// READ THREADPOLICY
+	buf = new char[2];
+	inFile.getline(buf,2);
+
+	if (!inFile.fail())
+		threadpolicy = atoi(buf);
+
+	delete []buf;
+
+	// READ RIOTRANSPORT
+	buf = new char[2];
+	inFile.getline(buf,2);
+
+	if (!inFile.fail())
+		riotransport = atoi(buf);
+
+	delete []buf;
+
+	// READ SLOWTHRESHOLD
+	buf = new char[6];
+	inFile.getline(buf,6);
+
+	if (!inFile.fail())
+		slowthreshold = atoi(buf);
+
+	delete []buf;
+
+	// READ LOGLEVEL
+	buf = new char[2];
+	inFile.getline(buf,2);
+
+	if (!inFile.fail())
+		loglevel = atoi(buf);
+
+	delete []buf;
+
+	// READ HOSTPROCESS
+	buf = new char[2];
+	inFile.getline(buf,2);
+
+	if (!inFile.fail())
+		hostprocess = atoi(buf);
+
+	delete []buf;
+
+	// READ UPLINK
+	buf = new char[8];
+	inFile.getline(buf,8);
+
+	if (!inFile.fail())
+		uplink = atoi(buf);
+
+	delete []buf;
+
+	// READ DASHBOARDWEIGHT
+	buf = new char[3];
+	inFile.getline(buf,3);
+
+	if (!inFile.fail())
+		dashboardweight = atoi(buf);
+
+	delete []buf;
+
 	inFile.close();
 
 	return 0;
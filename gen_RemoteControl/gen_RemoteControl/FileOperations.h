@@ -1,5 +1,4 @@
 #pragma once
 
 extern int const readSettings();
-extern int const saveSettings();
-extern void fillSettingValues();
\ No newline at end of file
+extern int const saveSettings();
\ No newline at end of file
@@ -0,0 +1,184 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	Journal
+*
+* constructor
+*/
+Journal::Journal() {
+	InitializeCriticalSection(&cs_journal);
+
+	resets = 0;
+
+	reset();
+}
+
+/**
+* \brief	~Journal
+*
+* destructor
+*/
+Journal::~Journal() {
+	DeleteCriticalSection(&cs_journal);
+}
+
+/**
+* \brief	reset
+*
+* drops the journal and starts a new epoch. called when the hook is removed, the events after that aren't seen
+*/
+void Journal::reset() {
+	// CRITICAL
+	EnterCriticalSection(&cs_journal);
+
+	entries.clear();
+	sequence = 0;
+	dropped = 0;
+
+	// differs between the runs of the server and within one run
+	stringstream text;
+	text << GetTickCount() << "x" << resets++;
+	epoch = text.str();
+
+	LeaveCriticalSection(&cs_journal);
+	// CRITICAL END
+}
+
+/**
+* \brief	trim
+*
+* drops the oldest broadcasts, always complete ones, until the journal is within JOURNAL_SIZE lines. call inside the lock
+*/
+void Journal::trim() {
+	while (entries.size() > JOURNAL_SIZE) {
+		dropped = entries.front().sequence;
+
+		while (!entries.empty() && entries.front().sequence == dropped)
+			entries.pop_front();
+	}
+}
+
+/**
+* \brief	record
+*
+* adds the lines of a broadcast before it is flushed. a broadcast with binary data starts a new epoch, it
+* couldn't be replayed
+*
+* \param	buffer	output buffer of the broadcast
+*
+* \return	sequence number of the broadcast, 0 if nothing has been recorded
+*/
+LONG const Journal::record(const OutputBuffer & buffer) {
+	std::vector<std::string> lines;
+
+	if (!buffer.getLines(lines)) {
+		reset();
+
+		return 0;
+	}
+
+	if (lines.empty())
+		return 0;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_journal);
+
+	LONG number = ++sequence;
+
+	for (unsigned int i = 0; i < lines.size(); i++) {
+		JournalEntry entry = { number, lines[i], false };
+		entries.push_back(entry);
+	}
+
+	trim();
+
+	LeaveCriticalSection(&cs_journal);
+	// CRITICAL END
+
+	return number;
+}
+
+/**
+* \brief	recordCover
+*
+* notes that the cover of the current track has been broadcast. a resumed session gets the current cover once
+*
+* \return	sequence number of the cover
+*/
+LONG const Journal::recordCover() {
+	// CRITICAL
+	EnterCriticalSection(&cs_journal);
+
+	LONG number = ++sequence;
+
+	JournalEntry entry = { number, std::string(), true };
+	entries.push_back(entry);
+
+	trim();
+
+	LeaveCriticalSection(&cs_journal);
+	// CRITICAL END
+
+	return number;
+}
+
+/**
+* \brief	replay
+*
+* copies the broadcasts a client has missed
+*
+* \param	epoch	epoch the client knows
+* \param	after	last sequence number the client has received
+* \param	lines	receives the missed lines in order
+* \param	cover	set to true if the cover has changed
+*
+* \return	false if the epoch has changed or the missed broadcasts aren't in the journal any more, the client has to
+*			be synchronized
+*/
+bool const Journal::replay(const std::string & epoch, const LONG & after, std::vector<std::string> & lines, bool & cover) {
+	bool result = false;
+
+	cover = false;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_journal);
+
+	// every broadcast after the one the client has received has to be in the journal
+	if (epoch == this->epoch && after >= dropped && after <= sequence) {
+		for (std::deque<JournalEntry>::const_iterator it = entries.begin(); it != entries.end(); it++) {
+			if (it->sequence <= after)
+				continue;
+
+			if (it->cover)
+				cover = true;
+			else if (it->line.compare(0, 13, "latencyProbe_") != 0)	// it would measure the time the client was away
+				lines.push_back(it->line);
+		}
+
+		result = true;
+	}
+
+	LeaveCriticalSection(&cs_journal);
+	// CRITICAL END
+
+	return result;
+}
+
+/**
+* \brief	getToken
+*
+* \return	<epoch>_<sequence> of the last broadcast, what a client that is up to date knows
+*/
+std::string const Journal::getToken() {
+	// CRITICAL
+	EnterCriticalSection(&cs_journal);
+
+	stringstream token;
+	token << epoch << "_" << sequence;
+
+	LeaveCriticalSection(&cs_journal);
+	// CRITICAL END
+
+	return token.str();
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include "stdafx.h"
+
+// broadcast lines kept for resumed sessions
+#define JOURNAL_SIZE 4096
+
+// milliseconds the hook stays installed after the last client has disconnected, the journal misses no event
+// until then and the client can resume
+#define JOURNAL_WINDOW 60000
+
+
+// one broadcast line, or a changed cover of the current track which is sent per session
+struct JournalEntry {
+	LONG sequence;
+	std::string line;
+	bool cover;
+};
+
+
+// change journal of the broadcasts: playlist, queue and state events. every flushed broadcast gets a sequence
+// number that the clients are told with journal_<sequence>. a client that reconnects with resume_<epoch>_<sequence>
+// gets the lines after its sequence number instead of the synchronization. the epoch changes whenever events
+// may have been missed, then the clients are synchronized again
+class Journal {
+	private:
+		std::deque<JournalEntry> entries;
+
+		LONG sequence;
+		std::string epoch;
+
+		// last sequence number that has been dropped from the journal
+		LONG dropped;
+		unsigned int resets;
+
+		// critical journal section
+		CRITICAL_SECTION cs_journal;
+
+		void trim();
+
+	public:
+		Journal();
+
+		~Journal();
+
+		void reset();
+
+		LONG const record(const OutputBuffer & buffer);
+		LONG const recordCover();
+
+		bool const replay(const std::string & epoch, const LONG & after, std::vector<std::string> & lines, bool & cover);
+		std::string const getToken();
+};
@@ -0,0 +1,208 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	LatencyProbes
+*
+* constructor
+*/
+LatencyProbes::LatencyProbes() {
+	lastId = 0;
+
+	InitializeCriticalSection(&cs_latency);
+}
+
+/**
+* \brief	~LatencyProbes
+*
+* destructor
+*/
+LatencyProbes::~LatencyProbes() {
+	DeleteCriticalSection(&cs_latency);
+}
+
+/**
+* \brief	element
+*
+* \param	happened	Metrics::now of the song change
+* \param	position	playlist position of the song
+*
+* \return	task element of the probe of a song change, "latencyProbe_<happened>_<position>"
+*/
+std::string const LatencyProbes::element(const LONGLONG & happened, const int & position) {
+	stringstream element;
+	element << "latencyProbe_" << happened << "_" << position;
+
+	return element.str();
+}
+
+/**
+* \brief	send
+*
+* sends the probe of a song change to the sessions of the track topic. only called by the send command thread
+*
+* \param	element	task element, see element
+*/
+void LatencyProbes::send(const std::string & element) {
+	const char *happened = element.c_str() + 13;
+	const char *position = strchr(happened, '_');
+
+	if (position == NULL)
+		return;
+
+	LatencyProbe probe;
+	probe.id = InterlockedIncrement(&lastId);
+	probe.happened = _atoi64(happened);
+	probe.sent = metrics.now();
+	probe.position = atoi(position + 1);
+
+	// CRITICAL
+	EnterCriticalSection(&cs_latency);
+
+	probes.push_back(probe);
+
+	if (probes.size() > LATENCY_PROBES)
+		probes.pop_front();
+
+	LeaveCriticalSection(&cs_latency);
+	// CRITICAL END
+
+	stringstream message;
+	message << "latencyProbe_" << probe.id << "_" << probe.sent;
+
+	rawSend(message.str().c_str());
+}
+
+/**
+* \brief	echo
+*
+* performs a latencyEcho_ command: records the latency of a song change for the session. called by the network thread
+*
+* \param	session	session of the client
+* \param	argument	<id>_<sent>_<received>_<rendered>, the last two in milliseconds of the client
+*/
+void LatencyProbes::echo(Session *session, const char *argument) {
+	LONGLONG now = metrics.now();
+
+	LONG id = atol(argument);
+	const char *sent = strchr(argument, '_');
+	const char *received = sent != NULL ? strchr(sent + 1, '_') : NULL;
+	const char *rendered = received != NULL ? strchr(received + 1, '_') : NULL;
+
+	if (rendered == NULL)
+		return;
+
+	LatencyProbe probe;
+	bool found = false;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_latency);
+
+	for (unsigned int i = 0; i < probes.size() && !found; i++) {
+		if (probes[i].id == id && probes[i].sent == _atoi64(sent + 1)) {
+			probe = probes[i];
+			found = true;
+		}
+	}
+
+	LeaveCriticalSection(&cs_latency);
+	// CRITICAL END
+
+	if (!found)
+		return;
+
+	LatencySample sample;
+	sample.session = session->id;
+	sample.id = id;
+	sample.position = probe.position;
+	sample.render = max((_atoi64(rendered + 1) - _atoi64(received + 1)) * 1000, 0LL);
+	sample.network = max(now - probe.sent - sample.render, 0LL) / 2;
+	sample.server = probe.sent - probe.happened;
+	sample.total = sample.server + sample.network + sample.render;
+
+	session->endToEnd.record(sample.total);
+	session->oneWay.record(sample.network);
+
+	endToEnd.record(sample.total);
+	oneWay.record(sample.network);
+
+	addSample(sample);
+}
+
+/**
+* \brief	addSample
+*
+* keeps a measurement if it is one of the LATENCY_SLOWEST slowest
+*
+* \param	sample	measurement
+*/
+void LatencyProbes::addSample(const LatencySample & sample) {
+	// CRITICAL
+	EnterCriticalSection(&cs_latency);
+
+	std::vector<LatencySample>::iterator it = slowest.begin();
+
+	while (it != slowest.end() && it->total >= sample.total)
+		it++;
+
+	slowest.insert(it, sample);
+
+	if (slowest.size() > LATENCY_SLOWEST)
+		slowest.pop_back();
+
+	LeaveCriticalSection(&cs_latency);
+	// CRITICAL END
+}
+
+/**
+* \brief	report
+*
+* adds the latencies of all sessions, of every connected one and the slowest measurements to the stats
+*
+* \param	lines	receives the lines
+*/
+void LatencyProbes::report(std::vector<std::string> & lines) {
+	stringstream total;
+	total << "latency_end_to_end count " << endToEnd.getCount() << " average " << endToEnd.getAverage() << " p50 " << endToEnd.percentile(50)
+		<< " p99 " << endToEnd.percentile(99) << " max " << endToEnd.getMaximum();
+	lines.push_back(total.str());
+
+	stringstream network;
+	network << "latency_one_way count " << oneWay.getCount() << " average " << oneWay.getAverage() << " p50 " << oneWay.percentile(50)
+		<< " p99 " << oneWay.percentile(99) << " max " << oneWay.getMaximum();
+	lines.push_back(network.str());
+
+	std::vector<int> ids;
+	sessionlist.getIds(ids);
+
+	for (unsigned int i = 0; i < ids.size(); i++) {
+		Session *session = sessionlist.get(ids[i]);
+
+		if (session == NULL)
+			continue;
+
+		if (session->endToEnd.getCount() > 0) {
+			stringstream line;
+			line << "latency_session " << session->id << " count " << session->endToEnd.getCount() << " end_to_end_p50 "
+				<< session->endToEnd.percentile(50) << " end_to_end_max " << session->endToEnd.getMaximum() << " one_way_p50 "
+				<< session->oneWay.percentile(50) << " one_way_max " << session->oneWay.getMaximum();
+			lines.push_back(line.str());
+		}
+
+		session->release();
+	}
+
+	// CRITICAL
+	EnterCriticalSection(&cs_latency);
+
+	for (unsigned int i = 0; i < slowest.size(); i++) {
+		stringstream line;
+		line << "latency_slow total " << slowest[i].total << " server " << slowest[i].server << " network " << slowest[i].network
+			<< " render " << slowest[i].render << " session " << slowest[i].session << " probe " << slowest[i].id
+			<< " position " << slowest[i].position;
+		lines.push_back(line.str());
+	}
+
+	LeaveCriticalSection(&cs_latency);
+	// CRITICAL END
+}
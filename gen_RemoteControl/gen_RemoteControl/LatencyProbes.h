@@ -0,0 +1,72 @@
+#pragma once
+#include "stdafx.h"
+
+// song changes whose probe can still be echoed, older echoes are ignored
+#define LATENCY_PROBES 16
+
+// slowest measurements kept with their details
+#define LATENCY_SLOWEST 8
+
+
+// probe sent after the title and cover of a new song
+struct LatencyProbe {
+	LONG id;
+
+	// Metrics::now of the song change and of the send of the probe
+	LONGLONG happened;
+	LONGLONG sent;
+
+	// playlist position of the song
+	int position;
+};
+
+
+// one measurement of a song change, microseconds
+struct LatencySample {
+	int session;
+	LONG id;
+	int position;
+
+	// song change until the client has shown it
+	LONGLONG total;
+
+	// song change until the probe is sent, one way to the client and the client until it has rendered
+	LONGLONG server;
+	LONGLONG network;
+	LONGLONG render;
+};
+
+
+// measures how long a song change takes until the clients show its title and cover. a latencyProbe_<id>_<sent> follows
+// the cover of a new song. the client echoes latencyEcho_<id>_<sent>_<received>_<rendered> with its own milliseconds when
+// it has shown what came before the probe. the one way time is half of the round trip without the render time, the
+// clocks of the phone and the server are never compared
+class LatencyProbes {
+	private:
+		std::deque<LatencyProbe> probes;
+		volatile LONG lastId;
+
+		// slowest first
+		std::vector<LatencySample> slowest;
+
+		// critical latency section
+		CRITICAL_SECTION cs_latency;
+
+		void addSample(const LatencySample & sample);
+
+	public:
+		LatencyProbes();
+
+		~LatencyProbes();
+
+		// of every session
+		Histogram endToEnd;
+		Histogram oneWay;
+
+		static std::string const element(const LONGLONG & happened, const int & position);
+
+		void send(const std::string & element);
+		void echo(Session *session, const char *argument);
+
+		void report(std::vector<std::string> & lines);
+};
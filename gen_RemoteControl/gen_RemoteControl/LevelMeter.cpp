@@ -0,0 +1,295 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	LevelMeter
+*
+* constructor
+*/
+LevelMeter::LevelMeter() {
+	getSpectrum = NULL;
+	requestSpectrum = NULL;
+	getVU = NULL;
+	thread = NULL;
+
+	requestEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+	// every band has at least one value, the last one ends with the spectrum
+	edges[0] = 0;
+
+	for (int b = 1; b <= LEVELS_BANDS; b++) {
+		int edge = (int)(pow((double)LEVELS_SPECTRUM, (double)b / LEVELS_BANDS) + 0.5);
+
+		edges[b] = max(edges[b - 1] + 1, min(edge, LEVELS_SPECTRUM - (LEVELS_BANDS - b)));
+	}
+
+	InitializeCriticalSection(&cs_levelmeter);
+}
+
+/**
+* \brief	~LevelMeter
+*
+* destructor
+*/
+LevelMeter::~LevelMeter() {
+	CloseHandle(requestEvent);
+	CloseHandle(stopEvent);
+
+	DeleteCriticalSection(&cs_levelmeter);
+}
+
+/**
+* \brief	setRate
+*
+* performs a levels_ command: starts, changes or stops the feed of a session. starts the meter thread if it isn't running
+*
+* \param	session	id of the session
+* \param	rate	frames per second, clamped to LEVELS_MIN_RATE and LEVELS_MAX_RATE. 0 stops the feed
+*/
+void LevelMeter::setRate(const int & session, const int & rate) {
+	if (rate <= 0) {
+		drop(session);
+
+		return;
+	}
+
+	// CRITICAL
+	EnterCriticalSection(&cs_levelmeter);
+
+	LevelSession & feed = sessions[session];
+	feed.interval = 1000 / max(LEVELS_MIN_RATE, min(LEVELS_MAX_RATE, rate));
+	feed.due = GetTickCount();
+	feed.queued = false;
+
+	if (thread == NULL) {
+		// the functions are looked up once on the winamp thread, they may be called from any thread
+		getSpectrum = (SpectrumFunction)SendMessage(plugin.hwndParent,WM_WA_IPC,0,IPC_GETSADATAFUNC);
+		requestSpectrum = (SpectrumRequestFunction)SendMessage(plugin.hwndParent,WM_WA_IPC,1,IPC_GETSADATAFUNC);
+		getVU = (VUFunction)SendMessage(plugin.hwndParent,WM_WA_IPC,0,IPC_GETVUDATAFUNC);
+
+		ResetEvent(stopEvent);
+
+		thread = CreateThread(NULL, 0, meterFunction, this, 0, NULL);
+	}
+
+	LeaveCriticalSection(&cs_levelmeter);
+	// CRITICAL END
+
+	SetEvent(requestEvent);
+}
+
+/**
+* \brief	drop
+*
+* stops the feed of a session, also called for closed sessions
+*
+* \param	session	id of the session
+*/
+void LevelMeter::drop(const int & session) {
+	// CRITICAL
+	EnterCriticalSection(&cs_levelmeter);
+
+	sessions.erase(session);
+
+	LeaveCriticalSection(&cs_levelmeter);
+	// CRITICAL END
+}
+
+/**
+* \brief	stop
+*
+* waits for the meter thread. called by quit
+*/
+void LevelMeter::stop() {
+	SetEvent(stopEvent);
+
+	joinThread(thread, LEVELS_STOP_TIMEOUT);
+}
+
+/**
+* \brief	sample
+*
+* reads the VU and spectrum data winamp has computed for its visualisations and formats one frame.
+* the RMS is computed from the oscilloscope data, a band is the highest spectrum value it covers
+*
+* \param	frame	receives the frame
+*/
+void LevelMeter::sample(std::string & frame) {
+	unsigned char values[3 + LEVELS_BANDS];
+	memset(values, 0, sizeof(values));
+
+	if (getVU != NULL) {
+		values[0] = (unsigned char)max(0, getVU(0));
+		values[1] = (unsigned char)max(0, getVU(1));
+	}
+
+	const char *data = getSpectrum != NULL ? getSpectrum() : NULL;
+
+	if (data != NULL) {
+		// oscilloscope after the spectrum, signed 8 bit
+		int sum = 0;
+
+		for (int i = 0; i < LEVELS_SPECTRUM; i++) {
+			int x = (signed char)data[LEVELS_SPECTRUM + i];
+
+			sum += x * x;
+		}
+
+		values[2] = (unsigned char)min(255, (int)(sqrt((double)sum / LEVELS_SPECTRUM) * 2));
+
+		for (int b = 0; b < LEVELS_BANDS; b++) {
+			unsigned char band = 0;
+
+			for (int i = edges[b]; i < edges[b + 1]; i++)
+				band = max(band, (unsigned char)data[i]);
+
+			values[3 + b] = band;
+		}
+	}
+
+	static const char hex[] = "0123456789abcdef";
+
+	frame.assign("levels_");
+
+	for (unsigned int i = 0; i < sizeof(values); i++) {
+		frame.push_back(hex[values[i] >> 4]);
+		frame.push_back(hex[values[i] & 0x0F]);
+	}
+}
+
+/**
+* \brief	feed
+*
+* hands a frame to the sessions whose next frame is due. a session that still has a frame waiting gets the new one
+* instead, it isn't queued again
+*
+* \param	frame	newest frame
+* \param	now		tick count
+*
+* \return	milliseconds until the next frame of a session is due, INFINITE if there is no feed
+*/
+DWORD const LevelMeter::feed(const std::string & frame, const DWORD & now) {
+	std::vector<int> queue;
+	DWORD wait = INFINITE;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_levelmeter);
+
+	for (std::map<int, LevelSession>::iterator it = sessions.begin(); it != sessions.end(); it++) {
+		LevelSession & feed = it->second;
+
+		if ((LONG)(feed.due - now) <= 0) {
+			// a late feed doesn't catch up
+			feed.due = ((LONG)(now - feed.due) > (LONG)feed.interval) ? now + feed.interval : feed.due + feed.interval;
+
+			if (frame != feed.sent) {
+				feed.frame = frame;
+
+				if (!feed.queued) {
+					feed.queued = true;
+					queue.push_back(it->first);
+				}
+			}
+		}
+
+		wait = min(wait, (DWORD)max(0, (LONG)(feed.due - now)));
+	}
+
+	LeaveCriticalSection(&cs_levelmeter);
+	// CRITICAL END
+
+	for (unsigned int i = 0; i < queue.size(); i++)
+		tasklist.push("levels", -1, queue[i]);
+
+	return wait;
+}
+
+/**
+* \brief	sendFrame
+*
+* sends the newest frame of a session. only called by the send command thread. the frame is dropped if the
+* socket has too much data queued, the next one is more recent anyway
+*
+* \param	session	id of the session
+*/
+void LevelMeter::sendFrame(const int & session) {
+	std::string frame;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_levelmeter);
+
+	std::map<int, LevelSession>::iterator it = sessions.find(session);
+
+	if (it != sessions.end()) {
+		frame.swap(it->second.frame);
+		it->second.queued = false;
+	}
+
+	LeaveCriticalSection(&cs_levelmeter);
+	// CRITICAL END
+
+	if (frame.empty())
+		return;
+
+	Session *target = sessionlist.get(session);
+
+	if (target == NULL)
+		return;
+
+	bool behind = target->queueDepth > LEVELS_MAX_QUEUE_DEPTH;
+
+	target->release();
+
+	// a datagram isn't held back by the queue of the session
+	bool datagram = datagramchannel.send(session, "levels", frame);
+
+	if (behind && !datagram)
+		return;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_levelmeter);
+
+	it = sessions.find(session);
+
+	if (it != sessions.end())
+		it->second.sent = frame;
+
+	LeaveCriticalSection(&cs_levelmeter);
+	// CRITICAL END
+
+	if (!datagram)
+		rawSend(frame.c_str());
+}
+
+/**
+* \brief	meterFunction
+*
+* thread of the level meter. samples once for all sessions that are due and sleeps until the next one is,
+* returns after the stop event has been set
+*
+* \param	parameter	level meter
+*
+* \return	0
+*/
+DWORD WINAPI LevelMeter::meterFunction(LPVOID parameter) {
+	LevelMeter *meter = (LevelMeter*)parameter;
+
+	HANDLE events[2] = { meter->stopEvent, meter->requestEvent };
+	DWORD wait = 0;
+
+	ThreadPolicy policy(THREAD_CLASS_INTERACTIVE);
+
+	// winamp only computes the spectrum if it is requested
+	if (meter->requestSpectrum != NULL)
+		meter->requestSpectrum(1);
+
+	while (WaitForMultipleObjects(2, events, FALSE, wait) != WAIT_OBJECT_0) {
+		std::string frame;
+		meter->sample(frame);
+
+		wait = meter->feed(frame, GetTickCount());
+	}
+
+	return 0;
+}
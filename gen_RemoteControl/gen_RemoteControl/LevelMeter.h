@@ -0,0 +1,80 @@
+#pragma once
+#include "stdafx.h"
+
+// frames per second a client can request with levels_
+#define LEVELS_MIN_RATE 20
+#define LEVELS_MAX_RATE 60
+
+// frequency bands of a frame
+#define LEVELS_BANDS 32
+
+// values of winamp's spectrum analyser, see IPC_GETSADATAFUNC
+#define LEVELS_SPECTRUM 75
+
+// outgoing elements queued for a session above which a frame is dropped instead of sent
+#define LEVELS_MAX_QUEUE_DEPTH 4
+
+// milliseconds quit waits for the meter thread
+#define LEVELS_STOP_TIMEOUT 1000
+
+
+// functions of winamp's visualisation data
+typedef char * (*SpectrumFunction)();
+typedef void (*SpectrumRequestFunction)(int want);
+typedef int (*VUFunction)(int channel);
+
+
+// level feed of one session
+struct LevelSession {
+	// milliseconds between two frames and tick count of the next one
+	DWORD interval;
+	DWORD due;
+
+	// newest frame that hasn't been sent, older ones are replaced
+	std::string frame;
+	bool queued;
+
+	// last frame sent, a frame that doesn't differ (silence while stopped) isn't sent again
+	std::string sent;
+};
+
+
+// feeds level meters on the phone. samples winamp's VU and spectrum analyser data at the rate each client has
+// requested and sends fixed size frames, levels_ followed by hex digits: peak left, peak right, RMS, then
+// LEVELS_BANDS bands, one byte each. a session keeps only its newest frame, so a stale one is replaced
+// rather than queued behind covers or synchronisation
+class LevelMeter {
+	private:
+		// feeds by session
+		std::map<int, LevelSession> sessions;
+
+		SpectrumFunction getSpectrum;
+		SpectrumRequestFunction requestSpectrum;
+		VUFunction getVU;
+
+		// first spectrum value of every band, roughly logarithmic
+		int edges[LEVELS_BANDS + 1];
+
+		HANDLE thread;
+		HANDLE requestEvent;
+		HANDLE stopEvent;
+
+		// critical level meter section
+		CRITICAL_SECTION cs_levelmeter;
+
+		static DWORD WINAPI meterFunction(LPVOID parameter);
+
+		void sample(std::string & frame);
+		DWORD const feed(const std::string & frame, const DWORD & now);
+
+	public:
+		LevelMeter();
+
+		~LevelMeter();
+
+		void setRate(const int & session, const int & rate);
+		void drop(const int & session);
+
+		void sendFrame(const int & session);
+		void stop();
+};
@@ -0,0 +1,491 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	SessionSearch
+*
+* constructor
+*/
+SessionSearch::SessionSearch() {
+	id = 0;
+	active = false;
+}
+
+/**
+* \brief	LibrarySearch
+*
+* constructor
+*/
+LibrarySearch::LibrarySearch() {
+	running = 0;
+
+	idleEvent = CreateEvent(NULL, TRUE, TRUE, NULL);
+	stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	pageEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+	InitializeCriticalSection(&cs_librarysearch);
+}
+
+/**
+* \brief	~LibrarySearch
+*
+* destructor
+*/
+LibrarySearch::~LibrarySearch() {
+	CloseHandle(idleEvent);
+	CloseHandle(stopEvent);
+	CloseHandle(pageEvent);
+
+	DeleteCriticalSection(&cs_librarysearch);
+}
+
+/**
+* \brief	wideString
+*
+* \param	text	UTF8 text of a command
+*
+* \return	text as wide string
+*/
+std::wstring const LibrarySearch::wideString(const char *text) {
+	int length = MultiByteToWideChar(CP_UTF8, 0, text, -1, NULL, 0);
+
+	if (length <= 1)
+		return std::wstring();
+
+	std::vector<wchar_t> buffer(length);
+	MultiByteToWideChar(CP_UTF8, 0, text, -1, &buffer[0], length);
+
+	return std::wstring(&buffer[0], length - 1);
+}
+
+/**
+* \brief	search
+*
+* performs a search_ command: finds the tracks whose artist, album or title contains every word of the text
+*
+* \param	session	id of the session
+* \param	text	UTF8 words separated by spaces
+*
+* \return	0 if success
+*/
+int const LibrarySearch::search(const int & session, const char *text) {
+	return queue(session, SNAPSHOT_SEARCH, wideString(text));
+}
+
+/**
+* \brief	browse
+*
+* performs a browse_ command: lists the tracks of an artist or an album
+*
+* \param	session		id of the session
+* \param	argument	artist_<name> or album_<name>, the name is UTF8
+*
+* \return	1 if the argument is unknown, 0 if success
+*/
+int const LibrarySearch::browse(const int & session, const char *argument) {
+	if (strncmp(argument, "artist_", 7) == 0)
+		return queue(session, SNAPSHOT_ARTIST, wideString(argument + 7));
+
+	if (strncmp(argument, "album_", 6) == 0)
+		return queue(session, SNAPSHOT_ALBUM, wideString(argument + 6));
+
+	return 1;
+}
+
+/**
+* \brief	find
+*
+* performs a find_ command: finds the playlist positions whose title, artist or album contains every word of the text
+*
+* \param	session	id of the session
+* \param	text	UTF8 words separated by spaces
+*
+* \return	0 if success
+*/
+int const LibrarySearch::find(const int & session, const char *text) {
+	return queue(session, SEARCH_PLAYLIST, wideString(text));
+}
+
+/**
+* \brief	queue
+*
+* replaces the query of a session and submits a search task if none is running. pages of the previous
+* query that haven't been sent are dropped
+*
+* \param	session	id of the session
+* \param	kind	what is compared, see SNAPSHOT_SEARCH
+* \param	text	words of a search or the artist or album to browse
+*
+* \return	0 if success
+*/
+int const LibrarySearch::queue(const int & session, const int & kind, const std::wstring & text) {
+	// CRITICAL
+	EnterCriticalSection(&cs_librarysearch);
+
+	SessionSearch & state = sessions[session];
+	state.id++;
+	state.active = true;
+	state.pages.clear();
+
+	SearchRequest & request = pending[session];
+	request.session = session;
+	request.id = state.id;
+	request.kind = kind;
+	request.text = text;
+
+	bool start = running == 0;
+
+	if (start) {
+		InterlockedExchange(&running, 1);
+
+		ResetEvent(idleEvent);
+		ResetEvent(stopEvent);
+	}
+
+	LeaveCriticalSection(&cs_librarysearch);
+	// CRITICAL END
+
+	if (start && !workpool.submit(searchFunction, this, WORK_PRIORITY_HIGH)) {
+		// the pool is full or stopped
+		HANDLE thread = CreateThread(NULL, 0, searchFunction, this, 0, NULL);
+
+		if (thread != NULL)
+			CloseHandle(thread);
+		else {
+			InterlockedExchange(&running, 0);
+
+			SetEvent(idleEvent);
+		}
+	}
+
+	return 0;
+}
+
+/**
+* \brief	cancel
+*
+* performs a searchCancel command: forgets the waiting query of a session and drops the pages of the running one
+*
+* \param	session	id of the session
+*/
+void LibrarySearch::cancel(const int & session) {
+	// CRITICAL
+	EnterCriticalSection(&cs_librarysearch);
+
+	pending.erase(session);
+
+	std::map<int, SessionSearch>::iterator it = sessions.find(session);
+
+	if (it != sessions.end()) {
+		it->second.active = false;
+		it->second.pages.clear();
+	}
+
+	LeaveCriticalSection(&cs_librarysearch);
+	// CRITICAL END
+}
+
+/**
+* \brief	drop
+*
+* forgets the search state of a closed session
+*
+* \param	session	id of the session
+*/
+void LibrarySearch::drop(const int & session) {
+	// CRITICAL
+	EnterCriticalSection(&cs_librarysearch);
+
+	pending.erase(session);
+	sessions.erase(session);
+
+	LeaveCriticalSection(&cs_librarysearch);
+	// CRITICAL END
+}
+
+/**
+* \brief	stop
+*
+* stops the search task after the running query. called by quit
+*/
+void LibrarySearch::stop() {
+	SetEvent(stopEvent);
+
+	WaitForSingleObject(idleEvent, SEARCH_STOP_TIMEOUT);
+}
+
+/**
+* \brief	take
+*
+* \param	request	receives the next waiting query
+*
+* \return	false if no query is waiting, the search task ends then
+*/
+bool const LibrarySearch::take(SearchRequest & request) {
+	// CRITICAL
+	EnterCriticalSection(&cs_librarysearch);
+
+	bool found = !pending.empty();
+
+	if (found) {
+		request = pending.begin()->second;
+		pending.erase(pending.begin());
+	} else {
+		// a later query submits a new task
+		InterlockedExchange(&running, 0);
+
+		SetEvent(idleEvent);
+	}
+
+	LeaveCriticalSection(&cs_librarysearch);
+	// CRITICAL END
+
+	return found;
+}
+
+/**
+* \brief	isBacklogged
+*
+* \param	session	id of the session
+*
+* \return	true if the socket of the session hasn't sent the queued data yet
+*/
+bool const LibrarySearch::isBacklogged(const int & session) {
+	Session *target = sessionlist.get(session);
+
+	if (target == NULL)
+		return false;
+
+	bool backlogged = target->queueDepth > SEARCH_MAX_QUEUE_DEPTH;
+
+	target->release();
+
+	return backlogged;
+}
+
+/**
+* \brief	addPage
+*
+* hands a page to the send thread unless the query has been replaced or cancelled. waits while SEARCH_PAGES_AHEAD
+* pages haven't been taken or the socket of the session is behind, so a large result is never formatted at once
+*
+* \param	request	query of the page
+* \param	page	formatted page
+*
+* \return	false if the query isn't current anymore or the thread is stopped, the remaining pages don't have to be formatted
+*/
+bool const LibrarySearch::addPage(const SearchRequest & request, const SearchPage & page) {
+	HANDLE events[2] = { stopEvent, pageEvent };
+
+	while (1) {
+		bool current;
+		bool full;
+
+		// CRITICAL
+		EnterCriticalSection(&cs_librarysearch);
+
+		std::map<int, SessionSearch>::iterator it = sessions.find(request.session);
+
+		current = it != sessions.end() && it->second.id == request.id && it->second.active;
+		full = current && it->second.pages.size() >= SEARCH_PAGES_AHEAD;
+
+		if (current && !full)
+			it->second.pages.push_back(page);
+
+		LeaveCriticalSection(&cs_librarysearch);
+		// CRITICAL END
+
+		if (!current)
+			return false;
+
+		if (!full && !isBacklogged(request.session)) {
+			tasklist.push("searchPage", -1, request.session);
+
+			return true;
+		}
+
+		// the queue of the socket isn't signalled, it is checked again after SEARCH_PAGE_WAIT
+		if (WaitForMultipleObjects(2, events, FALSE, SEARCH_PAGE_WAIT) == WAIT_OBJECT_0)
+			return false;
+	}
+}
+
+/**
+* \brief	sendPage
+*
+* sends the next page of the current query of a session. only called by the send command thread,
+* pages of a replaced or cancelled query are gone already
+*
+* \param	session	id of the session
+*/
+void LibrarySearch::sendPage(const int & session) {
+	SearchPage page;
+	bool found = false;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_librarysearch);
+
+	std::map<int, SessionSearch>::iterator it = sessions.find(session);
+
+	if (it != sessions.end() && !it->second.pages.empty()) {
+		page = it->second.pages.front();
+		it->second.pages.pop_front();
+
+		found = true;
+	}
+
+	LeaveCriticalSection(&cs_librarysearch);
+	// CRITICAL END
+
+	if (!found)
+		return;
+
+	SetEvent(pageEvent);
+
+	rawSend(page.header.c_str());
+
+	for (unsigned int i = 0; i < page.lines.size(); i++)
+		rawSend(page.lines[i].c_str());
+}
+
+/**
+* \brief	addRow
+*
+* adds a row yielded by the snapshot to the page of a query and hands the page over once it is full
+*
+* \param	row			row of the snapshot
+* \param	parameter	SearchWriter of the query
+*
+* \return	false if the query isn't current anymore, the snapshot stops the scan
+*/
+bool LibrarySearch::addRow(const unsigned int & row, void *parameter) {
+	SearchWriter *writer = (SearchWriter*)parameter;
+
+	librarysnapshot.appendRow(row, writer->page.lines);
+
+	if (writer->page.lines.size() < SEARCH_PAGE_SIZE * SNAPSHOT_ROW_LINES)
+		return true;
+
+	stringstream header;
+	header << "searchPage_" << writer->request->id << "_" << writer->first << "_" << SEARCH_PAGE_SIZE;
+	writer->page.header = header.str();
+
+	writer->current = librarysearch.addPage(*writer->request, writer->page);
+	writer->page.lines.clear();
+	writer->first += SEARCH_PAGE_SIZE;
+
+	return writer->current;
+}
+
+/**
+* \brief	run
+*
+* runs a query on the library snapshot and hands the result to the send thread page by page while the snapshot
+* yields the rows, the first page leaves before the scan is complete. the rows are capped at SEARCH_MAX_RESULTS,
+* searchEnd_ tells the number of all matches. stops as soon as the query is replaced or cancelled
+*
+* \param	request	query to run
+*/
+void LibrarySearch::run(const SearchRequest & request) {
+	TraceSpan span("library_search", request.session);
+
+	SearchWriter writer;
+	writer.request = &request;
+	writer.first = 0;
+	writer.current = true;
+
+	int total = librarysnapshot.find(request.kind, request.text, SEARCH_MAX_RESULTS, addRow, &writer);
+
+	if (!writer.current)
+		return;
+
+	// last page that isn't full
+	if (!writer.page.lines.empty()) {
+		stringstream header;
+		header << "searchPage_" << request.id << "_" << writer.first << "_" << writer.page.lines.size() / SNAPSHOT_ROW_LINES;
+		writer.page.header = header.str();
+
+		if (!addPage(request, writer.page))
+			return;
+	}
+
+	SearchPage end;
+
+	stringstream header;
+	header << "searchEnd_" << request.id << "_" << total;
+	end.header = header.str();
+
+	addPage(request, end);
+}
+
+/**
+* \brief	runFind
+*
+* runs a find_ query on the playlist index. the positions are ranked at once, they are handed to the send thread
+* as findPage_ messages of SEARCH_PAGE_SIZE positions and findEnd_ with the number of all matches
+*
+* \param	request	query to run
+*/
+void LibrarySearch::runFind(const SearchRequest & request) {
+	TraceSpan span("playlist_find", request.session);
+
+	std::vector<unsigned int> positions;
+	int total = playlistindex.find(request.text, INDEX_MAX_RESULTS, positions);
+
+	for (unsigned int first = 0; first < positions.size(); first += SEARCH_PAGE_SIZE) {
+		unsigned int rows = min(positions.size() - first, (unsigned int)SEARCH_PAGE_SIZE);
+
+		SearchPage page;
+
+		stringstream header;
+		header << "findPage_" << request.id << "_" << first << "_" << rows;
+		page.header = header.str();
+
+		for (unsigned int i = first; i < first + rows; i++) {
+			stringstream line;
+			line << positions[i];
+			page.lines.push_back(line.str());
+		}
+
+		if (!addPage(request, page))
+			return;
+	}
+
+	SearchPage end;
+
+	stringstream header;
+	header << "findEnd_" << request.id << "_" << total;
+	end.header = header.str();
+
+	addPage(request, end);
+}
+
+/**
+* \brief	searchFunction
+*
+* task of the library search. runs the waiting queries one after another until none is left, after the stop
+* event has been set they are only taken
+*
+* \param	parameter	library search
+*
+* \return	0
+*/
+DWORD WINAPI LibrarySearch::searchFunction(LPVOID parameter) {
+	LibrarySearch *search = (LibrarySearch*)parameter;
+
+	ThreadPolicy policy(THREAD_CLASS_INTERACTIVE);
+
+	SearchRequest request;
+
+	while (search->take(request)) {
+		if (WaitForSingleObject(search->stopEvent, 0) == WAIT_OBJECT_0)
+			continue;
+
+		if (request.kind == SEARCH_PLAYLIST)
+			search->runFind(request);
+		else
+			search->run(request);
+	}
+
+	return 0;
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include "stdafx.h"
+
+// rows of a search result sent with one searchPage_ message
+#define SEARCH_PAGE_SIZE 50
+
+// rows a query returns at most, the matches behind them are only counted
+#define SEARCH_MAX_RESULTS 1000
+
+// milliseconds quit waits for a running query
+#define SEARCH_STOP_TIMEOUT 5000
+
+// pages of a query formatted ahead of the send thread, the scan waits for the client after them
+#define SEARCH_PAGES_AHEAD 2
+
+// outgoing elements queued for a session above which the scan waits until the socket has sent them
+#define SEARCH_MAX_QUEUE_DEPTH 8
+
+// milliseconds between two checks of the queue of a session while the scan waits
+#define SEARCH_PAGE_WAIT 20
+
+// kind of a find_ query, it runs on the playlist index instead of the library snapshot
+#define SEARCH_PLAYLIST 3
+
+
+// query of a session that hasn't been run yet
+struct SearchRequest {
+	int session;
+
+	// number of the search or browse command of the session, see SessionSearch
+	LONG id;
+
+	// what is compared, see SNAPSHOT_SEARCH and SEARCH_PLAYLIST
+	int kind;
+
+	// words of a search or the artist or album to browse
+	std::wstring text;
+};
+
+
+// one message of a search result: searchPage_<id>_<first>_<rows> followed by the lines of the rows,
+// or searchEnd_<id>_<total> after the last page. findPage_ and findEnd_ for the playlist positions of a find_ query
+struct SearchPage {
+	std::string header;
+	std::vector<std::string> lines;
+};
+
+
+// page of a running query that is filled while the snapshot yields the rows
+struct SearchWriter {
+	const SearchRequest *request;
+	SearchPage page;
+
+	// number of the first row of the page
+	int first;
+
+	// false once the query has been replaced or cancelled
+	bool current;
+};
+
+
+// search state of one session
+struct SessionSearch {
+	SessionSearch();
+
+	// counts the search and browse commands of the session from 1, the client numbers them the same way
+	LONG id;
+
+	// false after searchCancel, the pages of the current query are dropped
+	bool active;
+
+	// formatted pages waiting for the send thread, at most SEARCH_PAGES_AHEAD
+	std::deque<SearchPage> pages;
+};
+
+
+// runs the search_, browse_ and find_ queries of the clients on the library snapshot in the background. every session has
+// at most one query: a newer one replaces a waiting query and drops the pages of a running one, so typing on the
+// phone doesn't queue up stale queries. the queries run on the work pool with a high priority. the pages are sent one per task as soon as they are formatted, the scan
+// only runs ahead of the socket by a few pages
+class LibrarySearch {
+	private:
+		// waiting queries by session
+		std::map<int, SearchRequest> pending;
+
+		// search state by session
+		std::map<int, SessionSearch> sessions;
+
+		// 1 while a task of the work pool runs the queries
+		volatile LONG running;
+
+		// set while no task runs
+		HANDLE idleEvent;
+		HANDLE stopEvent;
+
+		// set when the send thread has taken a page
+		HANDLE pageEvent;
+
+		// critical library search section
+		CRITICAL_SECTION cs_librarysearch;
+
+		static DWORD WINAPI searchFunction(LPVOID parameter);
+		static std::wstring const wideString(const char *text);
+		static bool addRow(const unsigned int & row, void *parameter);
+
+		int const queue(const int & session, const int & kind, const std::wstring & text);
+		bool const take(SearchRequest & request);
+		bool const addPage(const SearchRequest & request, const SearchPage & page);
+		bool const isBacklogged(const int & session);
+		void run(const SearchRequest & request);
+		void runFind(const SearchRequest & request);
+
+	public:
+		LibrarySearch();
+
+		~LibrarySearch();
+
+		int const search(const int & session, const char *text);
+		int const browse(const int & session, const char *argument);
+		int const find(const int & session, const char *text);
+		void cancel(const int & session);
+		void drop(const int & session);
+
+		void sendPage(const int & session);
+		void stop();
+};
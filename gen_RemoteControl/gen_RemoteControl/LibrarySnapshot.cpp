@@ -0,0 +1,640 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	fold
+*
+* \param	text	value of a field or a query
+*
+* \return	lower case text for the case insensitive comparisons of the media library
+*/
+std::wstring const StringDictionary::fold(const std::wstring & text) {
+	std::wstring folded(text);
+
+	if (!folded.empty())
+		CharLowerBuffW(&folded[0], folded.size());
+
+	return folded;
+}
+
+/**
+* \brief	StringDictionary
+*
+* constructor
+*/
+StringDictionary::StringDictionary() {
+	bytes = 0;
+}
+
+/**
+* \brief	add
+*
+* \param	value	value of a field, NULL if the field is empty
+*
+* \return	id of the value, added if it is new
+*/
+unsigned int const StringDictionary::add(const wchar_t *value) {
+	std::wstring text(value != NULL ? value : L"");
+
+	std::map<std::wstring, unsigned int>::iterator it = ids.find(text);
+
+	if (it != ids.end())
+		return it->second;
+
+	unsigned int id = values.size();
+
+	values.push_back(text);
+	folded.push_back(fold(text));
+	ids[text] = id;
+
+	// the value, its folded copy and the key
+	bytes += text.size() * sizeof(wchar_t) * 3 + SNAPSHOT_VALUE_OVERHEAD;
+
+	return id;
+}
+
+/**
+* \brief	clear
+*
+* removes every value
+*/
+void StringDictionary::clear() {
+	values.clear();
+	folded.clear();
+	ids.clear();
+
+	bytes = 0;
+}
+
+/**
+* \brief	value
+*
+* \param	id	id of a value
+*
+* \return	the value
+*/
+const std::wstring & StringDictionary::value(const unsigned int & id) const {
+	return values[id];
+}
+
+/**
+* \brief	size
+*
+* \return	estimated bytes of the values
+*/
+unsigned int const StringDictionary::size() const {
+	return bytes;
+}
+
+/**
+* \brief	match
+*
+* compares every value once, the rows only look up the result of their id
+*
+* \param	text	lower case text, see fold
+* \param	equal	the value has to be equal to the text, else it has to contain it
+* \param	flags	receives 1 for every id that matches, 0 else
+*/
+void StringDictionary::match(const std::wstring & text, const bool & equal, std::vector<unsigned char> & flags) const {
+	flags.assign(folded.size(), 0);
+
+	for (unsigned int i = 0; i < folded.size(); i++) {
+		if (equal ? folded[i] == text : folded[i].find(text) != std::wstring::npos)
+			flags[i] = 1;
+	}
+}
+
+
+/**
+* \brief	LibrarySnapshot
+*
+* constructor
+*/
+LibrarySnapshot::LibrarySnapshot() {
+	built = false;
+	builtTime = 0;
+	stale = false;
+
+	rowBytes = 0;
+	buildTime = 0;
+	released = 0;
+	accounted = 0;
+
+	InitializeCriticalSection(&cs_snapshot);
+}
+
+/**
+* \brief	~LibrarySnapshot
+*
+* destructor
+*/
+LibrarySnapshot::~LibrarySnapshot() {
+	DeleteCriticalSection(&cs_snapshot);
+}
+
+/**
+* \brief	fileChanged
+*
+* notes a file whose tags may have changed, it is read again before the next query. called by the MainWndProc hook
+*
+* \param	file	path of the file
+*/
+void LibrarySnapshot::fileChanged(const wchar_t *file) {
+	if (file == NULL)
+		return;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_snapshot);
+
+	changed.insert(std::wstring(file));
+
+	LeaveCriticalSection(&cs_snapshot);
+	// CRITICAL END
+}
+
+/**
+* \brief	invalidate
+*
+* builds the snapshot again with the next query. called when the hook is removed, later changes aren't notified
+*/
+void LibrarySnapshot::invalidate() {
+	stale = true;
+}
+
+/**
+* \brief	clear
+*
+* removes every row
+*/
+void LibrarySnapshot::clear() {
+	artists.clear();
+	albums.clear();
+	titles.clear();
+	genres.clear();
+	albumArtists.clear();
+
+	artist.clear();
+	album.clear();
+	title.clear();
+	genre.clear();
+	albumArtist.clear();
+	year.clear();
+	rating.clear();
+	length.clear();
+	track.clear();
+	disc.clear();
+	files.clear();
+	live.clear();
+	rows.clear();
+
+	rowBytes = 0;
+}
+
+/**
+* \brief	setRow
+*
+* stores the fields of a library record in a row
+*
+* \param	row		row number, the next row is added
+* \param	record	record of the library
+*/
+void LibrarySnapshot::setRow(const unsigned int & row, const itemRecordW *record) {
+	if (row == files.size()) {
+		artist.push_back(0);
+		album.push_back(0);
+		title.push_back(0);
+		genre.push_back(0);
+		albumArtist.push_back(0);
+		year.push_back(0);
+		rating.push_back(0);
+		length.push_back(0);
+		track.push_back(0);
+		disc.push_back(0);
+		files.push_back(std::wstring(record->filename));
+		live.push_back(0);
+
+		rows[StringDictionary::fold(record->filename)] = row;
+
+		// the path and its folded key
+		rowBytes += files.back().size() * sizeof(wchar_t) * 2 + SNAPSHOT_ROW_OVERHEAD;
+	}
+
+	artist[row] = artists.add(record->artist);
+	album[row] = albums.add(record->album);
+	title[row] = titles.add(record->title);
+	genre[row] = genres.add(record->genre);
+	albumArtist[row] = albumArtists.add(record->albumartist);
+	year[row] = record->year;
+	rating[row] = record->rating;
+	length[row] = record->length;
+	track[row] = record->track;
+	disc[row] = record->disc;
+	live[row] = 1;
+}
+
+/**
+* \brief	build
+*
+* reads every record of the library with one query
+*/
+void LibrarySnapshot::build() {
+	TraceSpan span("snapshot_build");
+
+	clear();
+
+	// the changes so far are part of the new snapshot
+	// CRITICAL
+	EnterCriticalSection(&cs_snapshot);
+
+	changed.clear();
+
+	LeaveCriticalSection(&cs_snapshot);
+	// CRITICAL END
+
+	stale = false;
+	built = true;
+	builtTime = GetTickCount();
+
+	CHECK_MLDB();
+
+	if (WASABI_API_MLDB == NULL)
+		return;
+
+	SlowOperation slow("library_query", "filename ISNOTEMPTY");
+
+	itemRecordListW *list = WASABI_API_MLDB->Query(L"filename ISNOTEMPTY");
+
+	if (list == NULL)
+		return;
+
+	slow.stage("query");
+
+	for (int i = 0; i < list->Size; i++) {
+		if (list->Items[i].filename != NULL && rows.find(StringDictionary::fold(list->Items[i].filename)) == rows.end())
+			setRow(files.size(), &list->Items[i]);
+	}
+
+	slow.stage("rows");
+	slow.addBytes(list->Size);
+
+	WASABI_API_MLDB->FreeRecordList(list);
+}
+
+/**
+* \brief	update
+*
+* reads the record of one file again. a file that isn't in the library anymore is marked as removed
+*
+* \param	file	path of the file
+*/
+void LibrarySnapshot::update(const std::wstring & file) {
+	if (WASABI_API_MLDB == NULL)
+		return;
+
+	itemRecordW *record;
+
+	{
+		SlowOperation slow("library_get", std::string(CW2A(file.c_str())));
+
+		record = WASABI_API_MLDB->GetFile(file.c_str());
+	}
+
+	std::map<std::wstring, unsigned int>::iterator it = rows.find(StringDictionary::fold(file));
+
+	if (record == NULL) {
+		if (it != rows.end())
+			live[it->second] = 0;
+
+		return;
+	}
+
+	if (record->filename != NULL)
+		setRow(it != rows.end() ? it->second : files.size(), record);
+
+	WASABI_API_MLDB->FreeRecord(record);
+}
+
+/**
+* \brief	refresh
+*
+* builds the snapshot if there is none or it is too old, else reads the notified files again
+*/
+void LibrarySnapshot::refresh() {
+	if (!built || stale || GetTickCount() - builtTime > SNAPSHOT_MAX_AGE) {
+		LONGLONG started = metrics.now();
+
+		build();
+
+		buildTime = metrics.now() - started;
+		account();
+
+		return;
+	}
+
+	std::set<std::wstring> notified;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_snapshot);
+
+	notified.swap(changed);
+
+	LeaveCriticalSection(&cs_snapshot);
+	// CRITICAL END
+
+	for (std::set<std::wstring>::const_iterator it = notified.begin(); it != notified.end(); it++)
+		update(*it);
+
+	if (!notified.empty())
+		account();
+}
+
+/**
+* \brief	size
+*
+* \return	estimated bytes of the rows and the dictionaries
+*/
+unsigned int const LibrarySnapshot::size() const {
+	return rowBytes + artists.size() + albums.size() + titles.size() + genres.size() + albumArtists.size();
+}
+
+/**
+* \brief	account
+*
+* tells the memory budget the bytes of the snapshot and the time it takes to build it again
+*/
+void LibrarySnapshot::account() {
+	unsigned int bytes = size();
+
+	InterlockedExchange(&accounted, (LONG)bytes);
+
+	memorybudget.update(BUDGET_SNAPSHOT, bytes, MemoryBudget::cost(buildTime, 1, bytes));
+}
+
+/**
+* \brief	trim
+*
+* BudgetClient function: the rows can only be dropped by the search thread, they are dropped after the current or the
+* next query if the snapshot takes more than limit bytes. the query after it builds the snapshot again
+*
+* \param	limit	bytes the snapshot may keep
+*/
+void LibrarySnapshot::trim(const LONGLONG & limit) {
+	if (accounted > limit)
+		InterlockedExchange(&released, 1);
+}
+
+#pragma managed(push, off)
+
+/**
+* \brief	scanEqual
+*
+* marks the live rows of a column that hold one id, 16 rows per step with SSE2
+*
+* \param	column	ids of the rows
+* \param	live	1 for the rows in the library
+* \param	count	number of rows
+* \param	id		id to find
+* \param	match	receives 1 for the matching rows, 0 else
+*/
+static void scanEqual(const unsigned int *column, const unsigned char *live, const unsigned int count, const unsigned int id, unsigned char *match) {
+	__m128i needle = _mm_set1_epi32((int)id);
+	unsigned int i = 0;
+
+	for (; i + 16 <= count; i += 16) {
+		__m128i a = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(column + i)), needle);
+		__m128i b = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(column + i + 4)), needle);
+		__m128i c = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(column + i + 8)), needle);
+		__m128i d = _mm_cmpeq_epi32(_mm_loadu_si128((const __m128i*)(column + i + 12)), needle);
+
+		// 0 or -1 per row packed to bytes, the live flags turn -1 into 1
+		__m128i rows = _mm_packs_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+
+		_mm_storeu_si128((__m128i*)(match + i), _mm_and_si128(rows, _mm_loadu_si128((const __m128i*)(live + i))));
+	}
+
+	for (; i < count; i++)
+		match[i] = (column[i] == id) ? live[i] : 0;
+}
+
+#pragma managed(pop)
+
+/**
+* \brief	search
+*
+* yields the live rows whose artist, album or title contains every word while it scans the columns, in the
+* order of the library. the rows after the limit are only counted
+*
+* \param	folded		lower case words separated by spaces
+* \param	limit		maximum number of yielded rows
+* \param	function	called for every yielded row, stops the scan if it returns false
+* \param	parameter	passed to function
+*
+* \return	number of all matching rows
+*/
+unsigned int const LibrarySnapshot::search(const std::wstring & folded, const unsigned int & limit, SnapshotRowFunction function, void *parameter) {
+	// flags of the artists, albums and titles per word
+	std::vector<std::vector<unsigned char> > flags;
+
+	std::wstring::size_type start = 0;
+
+	while (start < folded.size()) {
+		std::wstring::size_type end = folded.find(L' ', start);
+
+		if (end == std::wstring::npos)
+			end = folded.size();
+
+		if (end > start) {
+			std::wstring word = folded.substr(start, end - start);
+
+			flags.resize(flags.size() + 3);
+
+			artists.match(word, false, flags[flags.size() - 3]);
+			albums.match(word, false, flags[flags.size() - 2]);
+			titles.match(word, false, flags[flags.size() - 1]);
+		}
+
+		start = end + 1;
+	}
+
+	// an empty text gets an empty result, not the whole library
+	if (flags.empty())
+		return 0;
+
+	unsigned int count = files.size();
+	unsigned int total = 0;
+
+	for (unsigned int i = 0; i < count; i++) {
+		unsigned char match = live[i];
+
+		for (unsigned int w = 0; match && w < flags.size(); w += 3)
+			match = flags[w][artist[i]] | flags[w + 1][album[i]] | flags[w + 2][title[i]];
+
+		if (!match)
+			continue;
+
+		if (total++ < limit && !function(i, parameter))
+			break;
+	}
+
+	return total;
+}
+
+/**
+* \brief	find
+*
+* runs a search_ or browse_ query on the snapshot and hands the rows to a function one by one, like the
+* callbacks of obj_xml, so the caller can send them before the query is complete. the rows of a browse_ query
+* are sorted first
+*
+* \param	kind		what is compared, see SNAPSHOT_SEARCH
+* \param	text		words of a search or the artist or album to browse
+* \param	limit		maximum number of yielded rows
+* \param	function	called for every yielded row, stops the query if it returns false
+* \param	parameter	passed to function
+*
+* \return	number of all matching rows
+*/
+unsigned int const LibrarySnapshot::find(const int & kind, const std::wstring & text, const unsigned int & limit, SnapshotRowFunction function, void *parameter) {
+	unsigned int total = query(kind, text, limit, function, parameter);
+
+	// asked by the memory budget, the rows are yielded by now
+	if (InterlockedExchange(&released, 0) != 0) {
+		clear();
+
+		built = false;
+		account();
+	}
+
+	return total;
+}
+
+/**
+* \brief	query
+*
+* refreshes the snapshot and yields the matching rows, see find
+*
+* \param	kind		what is compared, see SNAPSHOT_SEARCH
+* \param	text		words of a search or the artist or album to browse
+* \param	limit		maximum number of yielded rows
+* \param	function	called for every yielded row, stops the query if it returns false
+* \param	parameter	passed to function
+*
+* \return	number of all matching rows
+*/
+unsigned int const LibrarySnapshot::query(const int & kind, const std::wstring & text, const unsigned int & limit, SnapshotRowFunction function, void *parameter) {
+	TraceSpan span("snapshot_find", kind);
+
+	refresh();
+
+	std::wstring folded = StringDictionary::fold(text);
+
+	if (kind == SNAPSHOT_SEARCH)
+		return search(folded, limit, function, parameter);
+
+	unsigned int count = files.size();
+	std::vector<unsigned char> match(count, 0);
+	std::vector<unsigned char> flags;
+
+	const StringDictionary & dictionary = (kind == SNAPSHOT_ARTIST) ? artists : albums;
+	const std::vector<unsigned int> & column = (kind == SNAPSHOT_ARTIST) ? artist : album;
+
+	dictionary.match(folded, true, flags);
+
+	// values that only differ in case have different ids
+	unsigned int ids = std::count(flags.begin(), flags.end(), 1);
+
+	if (ids == 1 && count > 0)
+		scanEqual(&column[0], &live[0], count, std::find(flags.begin(), flags.end(), 1) - flags.begin(), &match[0]);
+	else if (ids > 1) {
+		for (unsigned int i = 0; i < count; i++)
+			match[i] = live[i] & flags[column[i]];
+	}
+
+	// the tracks of one artist or album, they have to be complete for the order
+	std::vector<unsigned int> result;
+
+	for (unsigned int i = 0; i < count; i++) {
+		if (match[i])
+			result.push_back(i);
+	}
+
+	unsigned int total = result.size();
+
+	order(kind, result, limit);
+
+	for (unsigned int i = 0; i < result.size(); i++) {
+		if (!function(result[i], parameter))
+			break;
+	}
+
+	return total;
+}
+
+/**
+* \brief	RowOrder
+*
+* order of the rows of a browse_ query
+*/
+struct RowOrder {
+	const StringDictionary *names;
+	const std::vector<unsigned int> *column;
+	const std::vector<int> *disc;
+	const std::vector<int> *track;
+
+	bool operator()(const unsigned int & a, const unsigned int & b) const {
+		if ((*column)[a] != (*column)[b]) {
+			int name = _wcsicmp(names->value((*column)[a]).c_str(), names->value((*column)[b]).c_str());
+
+			if (name != 0)
+				return name < 0;
+		}
+
+		if ((*disc)[a] != (*disc)[b])
+			return (*disc)[a] < (*disc)[b];
+
+		return (*track)[a] < (*track)[b];
+	}
+};
+
+/**
+* \brief	order
+*
+* sorts the rows of a browse_ query and drops the rows behind the limit
+*
+* \param	kind	SNAPSHOT_ARTIST or SNAPSHOT_ALBUM
+* \param	result	matching rows
+* \param	limit	maximum number of rows
+*/
+void LibrarySnapshot::order(const int & kind, std::vector<unsigned int> & result, const unsigned int & limit) {
+	unsigned int count = min(limit, (unsigned int)result.size());
+
+	RowOrder rowOrder;
+	rowOrder.names = (kind == SNAPSHOT_ARTIST) ? &albums : &albumArtists;
+	rowOrder.column = (kind == SNAPSHOT_ARTIST) ? &album : &albumArtist;
+	rowOrder.disc = &disc;
+	rowOrder.track = &track;
+
+	// only the rows that are sent have to be in order
+	std::partial_sort(result.begin(), result.begin() + count, result.end(), rowOrder);
+
+	result.resize(count);
+}
+
+/**
+* \brief	appendRow
+*
+* adds the lines of one row for a searchPage_ message: file, artist, album and title, UTF8
+*
+* \param	row		row number
+* \param	lines	receives the lines
+*/
+void LibrarySnapshot::appendRow(const unsigned int & row, std::vector<std::string> & lines) {
+	const std::wstring *fields[SNAPSHOT_ROW_LINES] = { &files[row], &artists.value(artist[row]), &albums.value(album[row]), &titles.value(title[row]) };
+
+	for (unsigned int i = 0; i < SNAPSHOT_ROW_LINES; i++) {
+		std::string line;
+		utf8_append(line, fields[i]->c_str(), fields[i]->size());
+
+		lines.push_back(line);
+	}
+}
@@ -0,0 +1,121 @@
+#pragma once
+#include "stdafx.h"
+
+// milliseconds after which the snapshot is built again, files added to the library aren't notified
+#define SNAPSHOT_MAX_AGE 600000
+
+// what a query of the snapshot compares
+#define SNAPSHOT_SEARCH 0	// every word is contained in the artist, album or title
+#define SNAPSHOT_ARTIST 1	// artist equals the text, rows ordered by album, disc and track
+#define SNAPSHOT_ALBUM 2	// album equals the text, rows ordered by album artist, disc and track
+
+// lines appendRow adds per row
+#define SNAPSHOT_ROW_LINES 4
+
+// estimated bytes of the containers per dictionary value and per row, on top of the characters
+#define SNAPSHOT_VALUE_OVERHEAD 96
+#define SNAPSHOT_ROW_OVERHEAD 112
+
+// receives the rows of a query one by one, returns false to stop the query
+typedef bool (*SnapshotRowFunction)(const unsigned int & row, void *parameter);
+
+
+// strings of one column, every distinct value is stored once and the rows keep its id
+class StringDictionary {
+	private:
+		std::vector<std::wstring> values;
+
+		// lower case values for the comparisons
+		std::vector<std::wstring> folded;
+
+		std::map<std::wstring, unsigned int> ids;
+
+		// estimated bytes of the values
+		unsigned int bytes;
+
+	public:
+		StringDictionary();
+
+		static std::wstring const fold(const std::wstring & text);
+
+		unsigned int const add(const wchar_t *value);
+		void clear();
+
+		const std::wstring & value(const unsigned int & id) const;
+		unsigned int const size() const;
+		void match(const std::wstring & text, const bool & equal, std::vector<unsigned char> & flags) const;
+};
+
+
+// columns of the fields of the media library the server sends, so search_ and browse_ never touch the database.
+// the snapshot is built with one query and kept up to date with the tag change notifications of winamp.
+// only used by the search thread, the memory budget may ask it to drop its rows after the next query
+class LibrarySnapshot : public BudgetClient {
+	private:
+		StringDictionary artists;
+		StringDictionary albums;
+		StringDictionary titles;
+		StringDictionary genres;
+		StringDictionary albumArtists;
+
+		// one element per row, the row number is the id of the file
+		std::vector<unsigned int> artist;
+		std::vector<unsigned int> album;
+		std::vector<unsigned int> title;
+		std::vector<unsigned int> genre;
+		std::vector<unsigned int> albumArtist;
+		std::vector<int> year;
+		std::vector<int> rating;
+		std::vector<int> length;
+		std::vector<int> track;
+		std::vector<int> disc;
+		std::vector<std::wstring> files;
+
+		// 1 for rows in the library, 0 for removed files
+		std::vector<unsigned char> live;
+
+		// row by lower case path
+		std::map<std::wstring, unsigned int> rows;
+
+		bool built;
+		DWORD builtTime;
+
+		// estimated bytes of the rows without the dictionaries, and the microseconds the last build took
+		unsigned int rowBytes;
+		LONGLONG buildTime;
+
+		// the rows are dropped after the current query, see trim. accounted is the size the budget knows
+		volatile LONG released;
+		volatile LONG accounted;
+
+		// files whose tags may have changed since the last query
+		std::set<std::wstring> changed;
+		volatile bool stale;
+
+		// critical snapshot section, guards changed
+		CRITICAL_SECTION cs_snapshot;
+
+		void clear();
+		void build();
+		void update(const std::wstring & file);
+		void setRow(const unsigned int & row, const itemRecordW *record);
+		void refresh();
+		void order(const int & kind, std::vector<unsigned int> & result, const unsigned int & limit);
+		unsigned int const search(const std::wstring & folded, const unsigned int & limit, SnapshotRowFunction function, void *parameter);
+		unsigned int const query(const int & kind, const std::wstring & text, const unsigned int & limit, SnapshotRowFunction function, void *parameter);
+		unsigned int const size() const;
+		void account();
+
+	public:
+		LibrarySnapshot();
+
+		~LibrarySnapshot();
+
+		void fileChanged(const wchar_t *file);
+		void invalidate();
+
+		unsigned int const find(const int & kind, const std::wstring & text, const unsigned int & limit, SnapshotRowFunction function, void *parameter);
+		void appendRow(const unsigned int & row, std::vector<std::string> & lines);
+
+		virtual void trim(const LONGLONG & limit);
+};
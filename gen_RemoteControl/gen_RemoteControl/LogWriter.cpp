@@ -0,0 +1,255 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	LogWriter
+*
+* constructor
+*/
+LogWriter::LogWriter() {
+	for (LONG i = 0; i < LOG_SLOTS; i++)
+		slots[i].sequence = i;
+
+	enqueuePos = 0;
+	dequeuePos = 0;
+
+	file = INVALID_HANDLE_VALUE;
+	fileSize = 0;
+	thread = NULL;
+
+	wakeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+}
+
+/**
+* \brief	~LogWriter
+*
+* destructor
+*/
+LogWriter::~LogWriter() {
+	if (file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+
+	CloseHandle(wakeEvent);
+	CloseHandle(stopEvent);
+}
+
+/**
+* \brief	append
+*
+* formats an entry into a free slot of the ring: "<hh:mm:ss.mmm> <E|I|D> <text>". called by any thread, it waits for
+* nothing. the entry is dropped if its level is above loglevel or the writer thread has fallen behind
+*
+* \param	level	LOG_ level
+* \param	text	the entry, line breaks at its end are replaced by one
+*/
+void LogWriter::append(const int & level, const std::string & text) {
+	if (!enabled(level) || thread == NULL)
+		return;
+
+	size_t length = text.length();
+
+	while (length > 0 && (text[length - 1] == '\r' || text[length - 1] == '\n'))
+		length--;
+
+	if (length == 0)
+		return;
+
+	// claim a slot
+	LONG pos = enqueuePos;
+	LogSlot *slot;
+
+	for (;;) {
+		slot = &slots[pos & (LOG_SLOTS - 1)];
+
+		LONG diff = slot->sequence - pos;
+
+		if (diff == 0) {
+			LONG claimed = InterlockedCompareExchange(&enqueuePos, pos + 1, pos);
+
+			if (claimed == pos)
+				break;
+
+			pos = claimed;
+		} else if (diff < 0) {	// the writer thread hasn't taken this slot yet
+			InterlockedIncrement(&metrics.logDropped);
+
+			return;
+		} else
+			pos = enqueuePos;
+	}
+
+	SYSTEMTIME time;
+	GetLocalTime(&time);
+
+	static const char levels[] = { '-', 'E', 'I', 'D' };
+
+	int prefix = sprintf_s(slot->text, LOG_SLOT_TEXT, "%02d:%02d:%02d.%03d %c ", time.wHour, time.wMinute, time.wSecond,
+		time.wMilliseconds, levels[max(0, min(LOG_DEBUG, level))]);
+
+	length = min(length, (size_t)(LOG_SLOT_TEXT - 2 - prefix));
+
+	memcpy(slot->text + prefix, text.data(), length);
+	memcpy(slot->text + prefix + length, "\r\n", 2);
+	slot->length = prefix + (int)length + 2;
+
+	// publishes the text to the writer thread
+	InterlockedExchange(&slot->sequence, pos + 1);
+
+	if (level == LOG_ERROR)
+		SetEvent(wakeEvent);
+}
+
+/**
+* \brief	start
+*
+* starts the writer thread. the file is opened with the first entry, so loglevel can be raised while the plugin runs
+*
+* \param	path	log file, rotated files get .1 to .LOG_ROTATE_FILES appended
+*/
+void LogWriter::start(const std::string & path) {
+	if (thread != NULL)
+		return;
+
+	this->path = path;
+
+	ResetEvent(stopEvent);
+
+	thread = CreateThread(NULL, 0, writeFunction, this, 0, NULL);
+}
+
+/**
+* \brief	stop
+*
+* writes the remaining entries and waits for the writer thread. called by quit
+*/
+void LogWriter::stop() {
+	SetEvent(stopEvent);
+
+	joinThread(thread, LOG_STOP_TIMEOUT);
+
+	if (file != INVALID_HANDLE_VALUE) {
+		CloseHandle(file);
+
+		file = INVALID_HANDLE_VALUE;
+	}
+}
+
+/**
+* \brief	writeFunction
+*
+* thread of the writer: empties the ring every LOG_WRITE_INTERVAL milliseconds or when an error is appended
+*
+* \param	parameter	the LogWriter
+*
+* \return	0
+*/
+DWORD WINAPI LogWriter::writeFunction(LPVOID parameter) {
+	LogWriter *writer = (LogWriter*)parameter;
+	HANDLE events[2] = { writer->stopEvent, writer->wakeEvent };
+
+	ThreadPolicy policy(THREAD_CLASS_BACKGROUND);
+
+	for (;;) {
+		DWORD result = WaitForMultipleObjects(2, events, FALSE, LOG_WRITE_INTERVAL);
+
+		writer->drain();
+
+		if (result == WAIT_OBJECT_0)
+			break;
+	}
+
+	return 0;
+}
+
+/**
+* \brief	drain
+*
+* copies the published slots in order into the buffer and writes it whenever it is full. only called by the writer thread
+*/
+void LogWriter::drain() {
+	DWORD length = 0;
+
+	for (;;) {
+		LogSlot *slot = &slots[dequeuePos & (LOG_SLOTS - 1)];
+
+		if (slot->sequence != dequeuePos + 1)
+			break;
+
+		if (length + slot->length > LOG_WRITE_BUFFER) {
+			write(length);
+
+			length = 0;
+		}
+
+		memcpy(buffer + length, slot->text, slot->length);
+		length += slot->length;
+
+		// frees the slot for the producers of the next round
+		InterlockedExchange(&slot->sequence, dequeuePos + LOG_SLOTS);
+
+		dequeuePos++;
+	}
+
+	if (length > 0)
+		write(length);
+}
+
+/**
+* \brief	write
+*
+* appends the buffer to the log file, opens it if it isn't open and rotates it if it has grown over LOG_ROTATE_BYTES
+*
+* \param	length	bytes of the buffer
+*/
+void LogWriter::write(const DWORD & length) {
+	if (file != INVALID_HANDLE_VALUE && fileSize + length > LOG_ROTATE_BYTES)
+		rotate();
+
+	if (file == INVALID_HANDLE_VALUE) {
+		file = CreateFileA(path.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_ALWAYS,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+		if (file == INVALID_HANDLE_VALUE) {
+			InterlockedIncrement(&metrics.logFailures);
+
+			return;
+		}
+
+		LARGE_INTEGER size;
+		fileSize = GetFileSizeEx(file, &size) ? size.QuadPart : 0;
+	}
+
+	DWORD written = 0;
+
+	if (WriteFile(file, buffer, length, &written, NULL)) {
+		fileSize += written;
+
+		InterlockedExchangeAdd(&metrics.logBytes, (LONG)written);
+	} else
+		InterlockedIncrement(&metrics.logFailures);
+}
+
+/**
+* \brief	rotate
+*
+* closes the log file and renames it to .1, .1 to .2 and so on. the oldest file is deleted
+*/
+void LogWriter::rotate() {
+	CloseHandle(file);
+
+	file = INVALID_HANDLE_VALUE;
+	fileSize = 0;
+
+	for (int i = LOG_ROTATE_FILES; i > 0; i--) {
+		stringstream from, to;
+		to << path << "." << i;
+
+		if (i > 1)
+			from << path << "." << i - 1;
+		else
+			from << path;
+
+		MoveFileExA(from.str().c_str(), to.str().c_str(), MOVEFILE_REPLACE_EXISTING);
+	}
+}
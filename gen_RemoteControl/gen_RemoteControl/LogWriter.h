@@ -0,0 +1,84 @@
+#pragma once
+#include "stdafx.h"
+
+
+// levels of loglevel, an entry is written if its level is at most loglevel
+#define LOG_OFF 0
+#define LOG_ERROR 1
+#define LOG_INFO 2
+#define LOG_DEBUG 3
+
+// entries the ring holds until the writer thread takes them, more are dropped. power of two
+#define LOG_SLOTS 1024
+
+// characters of one entry with its time and level, longer texts are cut
+#define LOG_SLOT_TEXT 248
+
+// milliseconds the writer thread collects entries before it writes them, errors are written at once
+#define LOG_WRITE_INTERVAL 1000
+
+// bytes written with one call
+#define LOG_WRITE_BUFFER 65536
+
+// bytes of a log file before it is rotated to .1, the oldest of LOG_ROTATE_FILES is deleted
+#define LOG_ROTATE_BYTES (1024 * 1024)
+#define LOG_ROTATE_FILES 3
+
+// milliseconds quit waits for the last entries to be written
+#define LOG_STOP_TIMEOUT 2000
+
+// one formatted entry, free for the producers if sequence equals their position
+struct LogSlot {
+	volatile LONG sequence;
+	int length;
+	char text[LOG_SLOT_TEXT];
+};
+
+
+// writes the log of the window to logPath. a thread appends to a ring of slots without a lock and formats the
+// entry into its slot, the writer thread empties the ring into one buffer and writes it with one call. entries
+// above loglevel are dropped before they are formatted, so do callers that check enabled first
+class LogWriter {
+	private:
+		LogSlot slots[LOG_SLOTS];
+
+		// next position of the producers and of the writer thread
+		volatile LONG enqueuePos;
+		LONG dequeuePos;
+
+		std::string path;
+		HANDLE file;
+		LONGLONG fileSize;
+
+		char buffer[LOG_WRITE_BUFFER];
+
+		volatile HANDLE thread;
+		HANDLE wakeEvent;
+		HANDLE stopEvent;
+
+		static DWORD WINAPI writeFunction(LPVOID parameter);
+
+		void drain();
+		void write(const DWORD & length);
+		void rotate();
+
+	public:
+		LogWriter();
+
+		~LogWriter();
+
+		/** \brief	enabled
+		*
+		* \param	level	LOG_ level of an entry
+		*
+		* \return	true if an entry of this level is written, checked before an entry is formatted
+		*/
+		static bool const enabled(const int & level) {
+			return level <= loglevel;
+		}
+
+		void append(const int & level, const std::string & text);
+
+		void start(const std::string & path);
+		void stop();
+};
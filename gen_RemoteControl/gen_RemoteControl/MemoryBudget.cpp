@@ -0,0 +1,243 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	MemoryBudget
+*
+* constructor
+*/
+MemoryBudget::MemoryBudget() {
+	for (int i = 0; i < BUDGET_CONSUMERS; i++) {
+		usage[i].client = NULL;
+		usage[i].bytes = 0;
+		usage[i].cost = 0;
+		usage[i].trims = 0;
+	}
+
+	lowMemory = NULL;
+	wait = NULL;
+
+	pressure = 0;
+	checked = 0;
+	pressureEvents = 0;
+}
+
+/**
+* \brief	cost
+*
+* \param	microseconds	time to build one entry again
+* \param	entries			number of entries
+* \param	bytes			bytes of the entries
+*
+* \return	microseconds to build a megabyte of the entries again, 0 if there are none
+*/
+LONGLONG const MemoryBudget::cost(const LONGLONG & microseconds, const LONGLONG & entries, const LONGLONG & bytes) {
+	if (bytes <= 0)
+		return 0;
+
+	return (LONGLONG)((double)microseconds * entries * 1048576 / bytes);
+}
+
+/**
+* \brief	add
+*
+* registers a cache that gives bytes back. the caches own their entries, the budget only asks them to trim
+*
+* \param	consumer	BUDGET_
+* \param	client		the cache
+*/
+void MemoryBudget::add(const int & consumer, BudgetClient *client) {
+	usage[consumer].client = client;
+}
+
+/**
+* \brief	start
+*
+* waits for the low memory notification of the system. called by init
+*/
+void MemoryBudget::start() {
+	lowMemory = CreateMemoryResourceNotification(LowMemoryResourceNotification);
+
+	if (lowMemory != NULL)
+		arm();
+}
+
+/**
+* \brief	stop
+*
+* stops the wait for the low memory notification and waits for a running callback. called by quit
+*/
+void MemoryBudget::stop() {
+	HANDLE registered = InterlockedExchangePointer(&wait, NULL);
+
+	if (registered != NULL)
+		UnregisterWaitEx(registered, INVALID_HANDLE_VALUE);
+
+	if (lowMemory != NULL)
+		CloseHandle(lowMemory);
+
+	lowMemory = NULL;
+}
+
+/**
+* \brief	arm
+*
+* waits once for the low memory notification, the notification stays signalled while the pressure lasts
+*/
+void MemoryBudget::arm() {
+	HANDLE registered = NULL;
+
+	if (RegisterWaitForSingleObject(&registered, lowMemory, pressureCallback, this, INFINITE, WT_EXECUTEONLYONCE) == FALSE)
+		return;
+
+	HANDLE previous = InterlockedExchangePointer(&wait, registered);
+
+	// the wait of the last pressure has already run, it doesn't block
+	if (previous != NULL)
+		UnregisterWait(previous);
+}
+
+/**
+* \brief	pressureCallback
+*
+* wait callback: the system is low on memory. shrinks the budget and trims every cache at once
+*
+* \param	parameter	budget
+*/
+VOID CALLBACK MemoryBudget::pressureCallback(PVOID parameter, BOOLEAN timerOrWaitFired) {
+	MemoryBudget *memoryBudget = (MemoryBudget*)parameter;
+
+	InterlockedExchange(&memoryBudget->pressure, 1);
+	InterlockedIncrement(&memoryBudget->pressureEvents);
+
+	UIManager::addLogText("Low memory, caches reduced\r\n");
+
+	memoryBudget->trimAll();
+}
+
+/**
+* \brief	check
+*
+* ends the pressure once the system isn't low on memory anymore and waits for the next notification. asks the
+* system at most every BUDGET_POLL milliseconds
+*/
+void MemoryBudget::check() {
+	LONG now = (LONG)GetTickCount();
+	LONG last = checked;
+
+	if (pressure == 0 || (DWORD)(now - last) < BUDGET_POLL || InterlockedCompareExchange(&checked, now, last) != last)
+		return;
+
+	BOOL low = TRUE;
+
+	if (QueryMemoryResourceNotification(lowMemory, &low) != FALSE && low == FALSE && InterlockedCompareExchange(&pressure, 0, 1) == 1)
+		arm();
+}
+
+/**
+* \brief	budget
+*
+* \return	bytes all caches may take now
+*/
+LONGLONG const MemoryBudget::budget() {
+	return pressure != 0 ? BUDGET_PRESSURE_SIZE : BUDGET_SIZE;
+}
+
+/**
+* \brief	update
+*
+* sets the bytes of a cache and the cost of building them again. called by the caches when they change
+*
+* \param	consumer	BUDGET_
+* \param	bytes		bytes of the cache
+* \param	cost		microseconds per megabyte, see cost
+*/
+void MemoryBudget::update(const int & consumer, const LONGLONG & bytes, const LONGLONG & cost) {
+	InterlockedExchange64(&usage[consumer].bytes, bytes);
+	InterlockedExchange64(&usage[consumer].cost, cost);
+}
+
+/**
+* \brief	limit
+*
+* \param	consumer	BUDGET_ of a cache that gives bytes back
+*
+* \return	bytes the cache may take: the free budget on top of its bytes while all caches fit, else its share of the
+*			budget after the caches that can't give bytes back
+*/
+LONGLONG const MemoryBudget::limit(const int & consumer) {
+	check();
+
+	LONGLONG available = budget();
+	LONGLONG total = 0;
+
+	for (int i = 0; i < BUDGET_CONSUMERS; i++)
+		total += usage[i].bytes;
+
+	if (total <= available)
+		return usage[consumer].bytes + available - total;
+
+	// the bytes of each cache times the cost to build them again, an empty cache counts with its minimum
+	double weights = 0;
+	double weight = 0;
+	int clients = 0;
+
+	for (int i = 0; i < BUDGET_CONSUMERS; i++) {
+		if (usage[i].client == NULL) {
+			available -= usage[i].bytes;
+
+			continue;
+		}
+
+		double value = (double)max(usage[i].bytes, (LONGLONG)BUDGET_MINIMUM) * (double)max(usage[i].cost, (LONGLONG)1);
+
+		weights += value;
+		clients++;
+
+		if (i == consumer)
+			weight = value;
+	}
+
+	if (clients == 0 || weights <= 0)
+		return BUDGET_MINIMUM;
+
+	available = max(available, (LONGLONG)BUDGET_MINIMUM * clients);
+
+	LONGLONG share = max((LONGLONG)(available * weight / weights), (LONGLONG)BUDGET_MINIMUM);
+
+	if (share < usage[consumer].bytes)
+		InterlockedIncrement(&usage[consumer].trims);
+
+	return share;
+}
+
+/**
+* \brief	trimAll
+*
+* asks every cache to give back the bytes above its share
+*/
+void MemoryBudget::trimAll() {
+	for (int i = 0; i < BUDGET_CONSUMERS; i++) {
+		if (usage[i].client != NULL)
+			usage[i].client->trim(limit(i));
+	}
+}
+
+/**
+* \brief	report
+*
+* adds the budget and the bytes, costs and trims of every cache to the stats
+*
+* \param	lines	vector that receives the lines
+*/
+void MemoryBudget::report(std::vector<std::string> & lines) {
+	static const char *names[BUDGET_CONSUMERS] = { "metadata", "covers", "snapshot", "strings", "playlists" };
+
+	stringstream line;
+	line << "memory_budget bytes " << budget() << " pressure " << pressure << " pressure_events " << pressureEvents;
+
+	for (int i = 0; i < BUDGET_CONSUMERS; i++)
+		line << " " << names[i] << " " << usage[i].bytes << " " << names[i] << "_cost " << usage[i].cost << " " << names[i] << "_trims " << usage[i].trims;
+
+	lines.push_back(line.str());
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "stdafx.h"
+
+// caches that share the memory budget
+#define BUDGET_METADATA 0
+#define BUDGET_COVERS 1
+#define BUDGET_SNAPSHOT 2
+#define BUDGET_STRINGS 3
+#define BUDGET_PLAYLISTS 4
+#define BUDGET_CONSUMERS 5
+
+// bytes all caches may take together, and while the system is low on memory. winamp has a 32 bit address space
+#define BUDGET_SIZE 25165824
+#define BUDGET_PRESSURE_SIZE 6291456
+
+// bytes every cache that gives memory back may keep
+#define BUDGET_MINIMUM 262144
+
+// milliseconds between two checks whether the system is still low on memory
+#define BUDGET_POLL 1000
+
+
+// cache that gives bytes back to the budget
+class BudgetClient {
+	public:
+		virtual ~BudgetClient() {}
+
+		// drops the least recently used entries until the cache takes at most limit bytes. called on any thread
+		virtual void trim(const LONGLONG & limit) = 0;
+};
+
+
+// use of one cache
+struct BudgetUsage {
+	// NULL if the cache can't give bytes back
+	BudgetClient *client;
+
+	volatile LONGLONG bytes;
+
+	// microseconds it takes to build a megabyte of the cache again
+	volatile LONGLONG cost;
+
+	// times the cache was asked to give bytes back
+	volatile LONG trims;
+};
+
+
+// one memory budget of the metadata cache, the cover variants, the library snapshot of the search, the string
+// pool and the replaced playlists. while they fit, every cache may grow into the free budget. above it, the budget is split among the caches that
+// give bytes back in proportion to their bytes times the cost of building them again, so cheap entries are dropped
+// first. a LowMemoryResourceNotification of the system shrinks the budget until the pressure is gone
+class MemoryBudget {
+	private:
+		BudgetUsage usage[BUDGET_CONSUMERS];
+
+		// low memory notification of the system and the wait for it
+		HANDLE lowMemory;
+		HANDLE wait;
+
+		volatile LONG pressure;
+		volatile LONG checked;
+		volatile LONG pressureEvents;
+
+		static VOID CALLBACK pressureCallback(PVOID parameter, BOOLEAN timerOrWaitFired);
+
+		void arm();
+		void check();
+		LONGLONG const budget();
+
+	public:
+		MemoryBudget();
+
+		static LONGLONG const cost(const LONGLONG & microseconds, const LONGLONG & entries, const LONGLONG & bytes);
+
+		void add(const int & consumer, BudgetClient *client);
+		void start();
+		void stop();
+
+		void update(const int & consumer, const LONGLONG & bytes, const LONGLONG & cost);
+		LONGLONG const limit(const int & consumer);
+		void trimAll();
+
+		void report(std::vector<std::string> & lines);
+};
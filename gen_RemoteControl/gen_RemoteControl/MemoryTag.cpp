@@ -0,0 +1,143 @@
+#include "stdafx.h"
+
+
+volatile LONG MemoryTag::live[MEMORY_TAGS] = { 0 };
+volatile LONG MemoryTag::peak[MEMORY_TAGS] = { 0 };
+volatile LONG MemoryTag::allocations[MEMORY_TAGS] = { 0 };
+volatile LONGLONG MemoryTag::allocated[MEMORY_TAGS] = { 0 };
+volatile LONGLONG MemoryTag::since = 0;
+
+/**
+* \brief	MemoryTag
+*
+* constructor, charges the memory a call uses while it runs
+*
+* \param	tag		MEMORY_ subsystem
+* \param	bytes	estimated bytes
+*/
+MemoryTag::MemoryTag(const int & tag, const LONG & bytes) : tag(tag), bytes(bytes) {
+	add(tag, bytes);
+}
+
+/**
+* \brief	~MemoryTag
+*
+* destructor, gives the bytes of the call back
+*/
+MemoryTag::~MemoryTag() {
+	add(tag, -bytes);
+}
+
+/**
+* \brief	add
+*
+* charges bytes a subsystem has allocated to it or gives back the bytes it has freed. called on any thread
+*
+* \param	tag		MEMORY_ subsystem
+* \param	bytes	allocated bytes, negative if freed
+*/
+void MemoryTag::add(const int & tag, const LONG & bytes) {
+	if (tag < 0 || tag >= MEMORY_TAGS || bytes == 0)
+		return;
+
+	LONG value = InterlockedExchangeAdd(&live[tag], bytes) + bytes;
+
+	if (bytes < 0)
+		return;
+
+	LONG maximum = peak[tag];
+
+	while (value > maximum && InterlockedCompareExchange(&peak[tag], value, maximum) != maximum)
+		maximum = peak[tag];
+
+	InterlockedIncrement(&allocations[tag]);
+	Metrics::add(allocated[tag], bytes);
+}
+
+/**
+* \brief	total
+*
+* \return	bytes the subsystems hold
+*/
+LONG const MemoryTag::total() {
+	LONG bytes = 0;
+
+	for (int i = 0; i < MEMORY_TAGS; i++)
+		bytes += live[i];
+
+	return bytes;
+}
+
+/**
+* \brief	summary
+*
+* \return	text of the window: the kilobytes the subsystems hold and the largest of them
+*/
+std::string const MemoryTag::summary() {
+	static const char *names[MEMORY_TAGS] = { "other", "TagLib", "covers", "tasks", "output", "metadata", "log" };
+
+	int largest = 0;
+
+	for (int i = 1; i < MEMORY_TAGS; i++) {
+		if (live[i] > live[largest])
+			largest = i;
+	}
+
+	stringstream text;
+	text << "Memory: " << total() / 1024 << " KB (" << names[largest] << " " << live[largest] / 1024 << " KB)";
+
+	return text.str();
+}
+
+/**
+* \brief	reset
+*
+* starts the peaks at the current use and the allocation rates at 0. called by Metrics::reset
+*/
+void MemoryTag::reset() {
+	for (int i = 0; i < MEMORY_TAGS; i++) {
+		InterlockedExchange(&peak[i], live[i]);
+		InterlockedExchange(&allocations[i], 0);
+		InterlockedExchange64(&allocated[i], 0);
+	}
+
+	InterlockedExchange64(&since, metrics.now());
+}
+
+/**
+* \brief	report
+*
+* adds a "memory_<subsystem>" line with the held bytes, the peak and the allocation rate of every subsystem,
+* the sum of them and the working set and private bytes of the process for the stats command
+*
+* \param	lines	vector that receives the lines
+*/
+void MemoryTag::report(std::vector<std::string> & lines) {
+	static const char *names[MEMORY_TAGS] = { "other", "taglib", "covers", "tasks", "output", "metadata", "log" };
+
+	LONGLONG seconds = (metrics.now() - since) / 1000000;
+
+	if (seconds < 1)
+		seconds = 1;
+
+	for (int i = 0; i < MEMORY_TAGS; i++) {
+		stringstream line;
+		line << "memory_" << names[i] << " live " << live[i] << " peak " << peak[i] << " allocations " << allocations[i]
+			<< " allocations_per_second " << allocations[i] / seconds << " bytes_per_second " << allocated[i] / seconds;
+
+		lines.push_back(line.str());
+	}
+
+	// the rest of the process: winamp, its plugins and the heap of the window module
+	PROCESS_MEMORY_COUNTERS_EX counters;
+	counters.cb = sizeof(counters);
+
+	stringstream process;
+	process << "memory_process plugin " << total();
+
+	if (GetProcessMemoryInfo(GetCurrentProcess(), (PROCESS_MEMORY_COUNTERS*)&counters, sizeof(counters)) != FALSE)
+		process << " working_set " << counters.WorkingSetSize << " private " << counters.PrivateUsage;
+
+	lines.push_back(process.str());
+}
+
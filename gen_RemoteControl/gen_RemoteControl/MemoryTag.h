@@ -0,0 +1,43 @@
+#pragma once
+#include "stdafx.h"
+
+// subsystems the memory of the plugin is counted for
+#define MEMORY_OTHER 0
+#define MEMORY_TAGLIB 1
+#define MEMORY_COVERS 2
+#define MEMORY_TASKS 3
+#define MEMORY_OUTPUT 4
+#define MEMORY_METADATA 5
+#define MEMORY_LOG 6
+#define MEMORY_TAGS 7
+
+
+// counters of the memory the subsystems of the plugin hold. every subsystem charges the bytes of its own buffers
+// when it allocates them and gives them back when it frees them: the caches their entries, the string pool and the
+// path table their blocks, the sessions their queued output, the task list its tasks and the logs their lines.
+// memory that is only used during one call, TagLib parsing and picture decoding, is charged with an estimate by a
+// MemoryTag scope. the window module has its own heap, it shows the size of it next to these counters
+class MemoryTag {
+	private:
+		int tag;
+		LONG bytes;
+
+		static volatile LONG live[MEMORY_TAGS];
+		static volatile LONG peak[MEMORY_TAGS];
+		static volatile LONG allocations[MEMORY_TAGS];
+		static volatile LONGLONG allocated[MEMORY_TAGS];
+		static volatile LONGLONG since;
+
+	public:
+		MemoryTag(const int & tag, const LONG & bytes);
+
+		~MemoryTag();
+
+		static void add(const int & tag, const LONG & bytes);
+
+		static LONG const total();
+		static std::string const summary();
+
+		static void reset();
+		static void report(std::vector<std::string> & lines);
+};
@@ -0,0 +1,931 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	Metadata
+*
+* constructor, empty metadata of a file that couldn't be read
+*/
+Metadata::Metadata() {
+	references = 1;
+
+	valid = false;
+	limited = false;
+	year = 0;
+	track = 0;
+
+	artist = STRING_POOL_EMPTY;
+	album = STRING_POOL_EMPTY;
+	genre = STRING_POOL_EMPTY;
+	albumArtist = STRING_POOL_EMPTY;
+
+	samplerate = -1;
+	bitrate = -1;
+	length = -1;
+
+	samples = -1;
+	seekSpacing = 0;
+
+	cover = NULL;
+	hasCover = false;
+	coverUnknown = false;
+}
+
+/**
+* \brief	~Metadata
+*
+* destructor. only called by release() when the last reference is gone
+*/
+Metadata::~Metadata() {
+	if (cover != NULL)
+		cover->release();
+}
+
+/**
+* \brief	size
+*
+* \return	approximate memory used by the metadata, the pooled values aren't counted
+*/
+unsigned int const Metadata::size() {
+	unsigned int bytes = sizeof(Metadata) + title.length() + comment.length() + coverHash.length()
+		+ seekTable.size() * sizeof(unsigned int);
+
+	if (cover != NULL)
+		bytes += cover->bytes.size();
+
+	return bytes;
+}
+
+/**
+* \brief	edited
+*
+* copies the metadata with one field changed, see TagWriter::isField. the cover is shared with the copy
+*
+* \param	field	field name
+* \param	value	new value, UTF8
+*
+* \return	new metadata with one reference
+*/
+Metadata* const Metadata::edited(const std::string & field, const std::string & value) {
+	Metadata *metadata = new Metadata(*this);
+	metadata->references = 1;
+
+	if (cover != NULL)
+		cover->addRef();
+
+	// stored like the values read by parse
+	TagLib::String text(value, TagLib::String::UTF8);
+
+	if (field == "title")
+		metadata->title = text.toCString();
+	else if (field == "artist")
+		metadata->artist = stringpool.intern(text.toCString());
+	else if (field == "album")
+		metadata->album = stringpool.intern(text.toCString());
+	else if (field == "genre")
+		metadata->genre = stringpool.intern(text.toCString());
+	else if (field == "comment")
+		metadata->comment = text.toCString();
+	else if (field == "year")
+		metadata->year = text.toInt();
+	else if (field == "track")
+		metadata->track = text.toInt();
+
+	return metadata;
+}
+
+/**
+* \brief	addRef
+*
+* adds a reference
+*/
+void Metadata::addRef() {
+	InterlockedIncrement(&references);
+}
+
+/**
+* \brief	release
+*
+* removes a reference and deletes the metadata if it was the last one
+*/
+void Metadata::release() {
+	if (InterlockedDecrement(&references) == 0)
+		delete this;
+}
+
+
+/**
+* \brief	MetadataCache
+*
+* constructor
+*/
+MetadataCache::MetadataCache() {
+	bytes = 0;
+	charged = 0;
+	hits = 0;
+	misses = 0;
+
+	sources.push_back(&library);
+	sources.push_back(&taglib);
+
+	InitializeCriticalSection(&cs_metadata);
+}
+
+/**
+* \brief	~MetadataCache
+*
+* destructor
+*/
+MetadataCache::~MetadataCache() {
+	clear();
+
+	DeleteCriticalSection(&cs_metadata);
+}
+
+/**
+* \brief	get
+*
+* returns the metadata of a file. it is parsed only if the file isn't cached or has been modified since.
+* the least recently used entries are dropped when the cache exceeds METADATA_CACHE_SIZE or its share of the memory budget
+*
+* \param	file		path of the file
+* \param	needCover	parse the file again if only the cover hash is known from the index
+*
+* \return	metadata, the caller has to release() it
+*/
+Metadata* const MetadataCache::get(const char *file, const bool & needCover) {
+	return read(file, needCover, true, true);
+}
+
+/**
+* \brief	find
+*
+* returns the metadata of a file if it is cached or in the index and hasn't been modified. the file is never parsed
+*
+* \param	file	path of the file
+*
+* \return	metadata, the caller has to release() it. NULL if the file would have to be read
+*/
+Metadata* const MetadataCache::find(const char *file) {
+	return read(file, false, true, false);
+}
+
+/**
+* \brief	prefetch
+*
+* reads the metadata of a file into the cache without keeping its cover, so the covers of a whole playlist
+* don't push the tracks in use out of the cache
+*
+* \param	file	path of the file
+*/
+void MetadataCache::prefetch(const char *file) {
+	read(file, false, false, true)->release();
+}
+
+/**
+* \brief	canonical
+*
+* \param	file	path of the file
+* \param	path	receives the canonical lower case path, the key of the cache. the file system isn't asked
+*
+* \return	false if the path is invalid
+*/
+bool const MetadataCache::canonical(const char *file, std::string & path) {
+	char fullPath[MAX_PATH];
+
+	if (GetFullPathNameA(file, MAX_PATH, fullPath, NULL) == 0)
+		return false;
+
+	path = fullPath;
+	std::transform(path.begin(), path.end(), path.begin(), tolower);
+
+	return true;
+}
+
+/**
+* \brief	identify
+*
+* the attributes are taken from a recent listing of the directory if there is one, see DirectoryListings
+*
+* \param	file		path of the file
+* \param	path		receives the canonical lower case path, the key of the cache
+* \param	attributes	receives modification time and size of the file
+*
+* \return	false for streams and missing files, they are not cached
+*/
+bool const MetadataCache::identify(const char *file, std::string & path, WIN32_FILE_ATTRIBUTE_DATA & attributes) {
+	return canonical(file, path) && listings.attributes(path, attributes);
+}
+
+/**
+* \brief	edit
+*
+* changes one field of the cached metadata of a file before the tag writer has written it, so the clients see
+* the edit at once. the file is parsed first if it isn't cached yet
+*
+* \param	file	path of the file
+* \param	field	field name, see TagWriter::isField
+* \param	value	new value, UTF8
+*
+* \return	1 if the file is not cached, 0 if success
+*/
+int const MetadataCache::edit(const char *file, const std::string & field, const std::string & value) {
+	if (file == NULL)
+		return 1;
+
+	std::string path;
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+
+	if (!identify(file, path, attributes))
+		return 1;
+
+	read(file, false, true, true)->release();
+
+	unsigned int id = pathtable.intern(path);
+	int result = 1;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_metadata);
+
+	for (std::list<MetadataEntry>::iterator it = entries.begin(); it != entries.end(); it++) {
+		if (it->path == id) {
+			Metadata *metadata = it->metadata->edited(field, value);
+
+			bytes -= it->metadata->size();
+			it->metadata->release();
+
+			it->metadata = metadata;
+			bytes += metadata->size();
+
+			account();
+
+			result = 0;
+
+			break;
+		}
+	}
+
+	LeaveCriticalSection(&cs_metadata);
+	// CRITICAL END
+
+	return result;
+}
+
+/**
+* \brief	drop
+*
+* removes the metadata of a file from the cache, it is parsed again on the next request
+*
+* \param	file	path of the file
+*/
+void MetadataCache::drop(const char *file) {
+	std::string path;
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+
+	if (file == NULL || !identify(file, path, attributes))
+		return;
+
+	unsigned int id = pathtable.intern(path);
+
+	// CRITICAL
+	EnterCriticalSection(&cs_metadata);
+
+	for (std::list<MetadataEntry>::iterator it = entries.begin(); it != entries.end(); it++) {
+		if (it->path == id) {
+			bytes -= it->metadata->size();
+			it->metadata->release();
+			entries.erase(it);
+
+			account();
+
+			break;
+		}
+	}
+
+	LeaveCriticalSection(&cs_metadata);
+	// CRITICAL END
+}
+
+/**
+* \brief	invalidate
+*
+* called by the directory watcher when a file has changed. its entry is kept, but checked against the file on the
+* next request
+*
+* \param	path	lower case full path of the file
+*/
+void MetadataCache::invalidate(const std::string & path) {
+	unsigned int id = pathtable.intern(path);
+
+	// CRITICAL
+	EnterCriticalSection(&cs_metadata);
+
+	for (std::list<MetadataEntry>::iterator it = entries.begin(); it != entries.end(); it++) {
+		if (it->path == id) {
+			it->watched = false;
+
+			break;
+		}
+	}
+
+	LeaveCriticalSection(&cs_metadata);
+	// CRITICAL END
+}
+
+/**
+* \brief	invalidateDirectory
+*
+* called by the directory watcher when notifications of a directory have been lost or it isn't watched anymore.
+* every file of the directory is checked on its next request. the files of the directory share its id in pathtable
+*
+* \param	path	lower case full path of the directory without the trailing backslash
+*/
+void MetadataCache::invalidateDirectory(const std::string & path) {
+	unsigned int directory = pathtable.intern(path);
+
+	// CRITICAL
+	EnterCriticalSection(&cs_metadata);
+
+	for (std::list<MetadataEntry>::iterator it = entries.begin(); it != entries.end(); it++) {
+		if (pathtable.parent(it->path) == directory)
+			it->watched = false;
+	}
+
+	LeaveCriticalSection(&cs_metadata);
+	// CRITICAL END
+}
+
+/**
+* \brief	read
+*
+* looks up the metadata of a file, see get
+*
+* \param	file		path of the file
+* \param	needCover	parse the file again if only the cover hash is known or the metadata comes from the media library
+* \param	keepCover	keep the picture of a parsed file
+* \param	parse		read the file if it isn't cached
+*
+* \return	metadata, the caller has to release() it. NULL if it isn't cached and parse is false
+*/
+Metadata* const MetadataCache::read(const char *file, const bool & needCover, const bool & keepCover, const bool & parse) {
+	if (file == NULL)
+		return parse ? new Metadata() : NULL;
+
+	// canonical path, modification time and size identify the file. the cache compares the id of the path
+	std::string path;
+	unsigned int id = PATH_TABLE_ROOT;
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+
+	if (canonical(file, path))
+		id = pathtable.intern(path);
+
+	// a file of a watched directory that has been checked recently is returned without asking the file system
+	if (id != PATH_TABLE_ROOT) {
+		DWORD now = GetTickCount();
+
+		// CRITICAL
+		EnterCriticalSection(&cs_metadata);
+
+		for (std::list<MetadataEntry>::iterator it = entries.begin(); it != entries.end(); it++) {
+			if (it->path == id) {
+				bool complete = !needCover || it->metadata->limited || (!it->metadata->coverUnknown && (!it->metadata->hasCover || it->metadata->cover != NULL));
+
+				if (it->watched && now - it->checked < METADATA_RECHECK_INTERVAL && complete) {
+					entries.splice(entries.end(), entries, it);
+
+					Metadata *metadata = entries.back().metadata;
+					metadata->addRef();
+
+					LeaveCriticalSection(&cs_metadata);
+					// CRITICAL END
+
+					InterlockedIncrement(&hits);
+
+					return metadata;
+				}
+
+				break;
+			}
+		}
+
+		LeaveCriticalSection(&cs_metadata);
+		// CRITICAL END
+	}
+
+	// asked before the file, a change after the check is notified
+	bool watched = !path.empty() && directorywatcher.watch(path);
+
+	if (id == PATH_TABLE_ROOT || !identify(file, path, attributes)) {
+		// streams and missing files are not cached
+		if (!parse)
+			return NULL;
+
+		InterlockedIncrement(&misses);
+
+		return fetch(file, NULL, needCover, keepCover);
+	}
+
+	unsigned long long fileSize = ((unsigned long long)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_metadata);
+
+	for (std::list<MetadataEntry>::iterator it = entries.begin(); it != entries.end(); it++) {
+		if (it->path == id) {
+			bool complete = !needCover || it->metadata->limited || (!it->metadata->coverUnknown && (!it->metadata->hasCover || it->metadata->cover != NULL));
+
+			if (CompareFileTime(&it->modified, &attributes.ftLastWriteTime) == 0 && it->fileSize == fileSize && complete) {
+				it->watched = watched;
+				it->checked = GetTickCount();
+
+				// most recently used
+				entries.splice(entries.end(), entries, it);
+
+				Metadata *metadata = entries.back().metadata;
+				metadata->addRef();
+
+				LeaveCriticalSection(&cs_metadata);
+				// CRITICAL END
+
+				InterlockedIncrement(&hits);
+
+				return metadata;
+			}
+
+			// modified or cover missing
+			bytes -= it->metadata->size();
+			it->metadata->release();
+			entries.erase(it);
+
+			account();
+
+			break;
+		}
+	}
+
+	LeaveCriticalSection(&cs_metadata);
+	// CRITICAL END
+
+	if (!parse)
+		return NULL;
+
+	InterlockedIncrement(&misses);
+
+	// read outside of the lock, files on network shares may take long
+	Metadata *metadata = fetch(file, &attributes, needCover, keepCover);
+
+	MetadataEntry entry = { id, attributes.ftLastWriteTime, fileSize, metadata, watched, GetTickCount() };
+
+	metadata->addRef();	// reference of the cache
+
+	// CRITICAL
+	EnterCriticalSection(&cs_metadata);
+
+	insert(entry);
+
+	LeaveCriticalSection(&cs_metadata);
+	// CRITICAL END
+
+	return metadata;
+}
+
+/**
+* \brief	fetch
+*
+* asks the sources for the metadata of a file that isn't cached, the first one that knows the file wins.
+* sources without covers are skipped if the cover is needed
+*
+* \param	file		path of the file
+* \param	attributes	modification time and size of the file, NULL for streams
+* \param	needCover	the cover has to be known
+* \param	keepCover	keep the picture of a parsed file
+*
+* \return	new metadata with one reference, not valid if no source could read the file
+*/
+Metadata* const MetadataCache::fetch(const char *file, const WIN32_FILE_ATTRIBUTE_DATA *attributes, const bool & needCover, const bool & keepCover) {
+	Metadata *metadata = NULL;
+
+	for (unsigned int i = 0; i < sources.size(); i++) {
+		if (needCover && !sources[i]->hasCovers())
+			continue;
+
+		if (metadata != NULL)
+			metadata->release();
+
+		metadata = sources[i]->lookup(file, attributes, keepCover);
+
+		if (metadata != NULL && metadata->valid)
+			break;
+	}
+
+	return metadata != NULL ? metadata : new Metadata();
+}
+
+/**
+* \brief	insert
+*
+* inserts an entry as most recently used, replacing an older one of the same file. the cache takes over the reference
+* of the entry. must be called inside cs_metadata
+*
+* \param	entry	new entry
+*/
+void MetadataCache::insert(const MetadataEntry & entry) {
+	// another thread may have parsed it in the meantime
+	for (std::list<MetadataEntry>::iterator it = entries.begin(); it != entries.end(); it++) {
+		if (it->path == entry.path) {
+			bytes -= it->metadata->size();
+			it->metadata->release();
+			entries.erase(it);
+
+			break;
+		}
+	}
+
+	entries.push_back(entry);
+	bytes += entry.metadata->size();
+
+	account();
+
+	evict(min((LONGLONG)METADATA_CACHE_SIZE, memorybudget.limit(BUDGET_METADATA)));
+}
+
+/**
+* \brief	evict
+*
+* drops the least recently used entries until the cache takes at most limit bytes. must be called inside cs_metadata
+*
+* \param	limit	bytes
+*/
+void MetadataCache::evict(const LONGLONG & limit) {
+	if (bytes <= limit)
+		return;
+
+	while (bytes > limit && entries.size() > 1) {
+		bytes -= entries.front().metadata->size();
+		entries.front().metadata->release();
+		entries.pop_front();
+	}
+
+	account();
+}
+
+/**
+* \brief	account
+*
+* tells the memory budget the bytes of the cache and the parse time of the entries and charges the change of the
+* bytes to MEMORY_METADATA. must be called inside cs_metadata
+*/
+void MetadataCache::account() {
+	MemoryTag::add(MEMORY_METADATA, (LONG)bytes - (LONG)charged);
+	charged = bytes;
+
+	LONGLONG parses = 0;
+	LONGLONG time = 0;
+
+	for (int i = 0; i < FORMATS; i++) {
+		parses += metrics.parseTime[i].getCount();
+		time += (LONGLONG)metrics.parseTime[i].getAverage() * metrics.parseTime[i].getCount();
+	}
+
+	memorybudget.update(BUDGET_METADATA, bytes, MemoryBudget::cost(parses > 0 ? time / parses : 0, entries.size(), bytes));
+}
+
+/**
+* \brief	trim
+*
+* BudgetClient function: gives the bytes above limit back to the memory budget
+*
+* \param	limit	bytes the cache may keep
+*/
+void MetadataCache::trim(const LONGLONG & limit) {
+	// CRITICAL
+	EnterCriticalSection(&cs_metadata);
+
+	evict(limit);
+
+	LeaveCriticalSection(&cs_metadata);
+	// CRITICAL END
+}
+
+/**
+* \brief	getTrack
+*
+* returns the metadata of a playlist entry
+*
+* \param	number		track number, currently playing track if -1
+* \param	needCover	see get
+*
+* \return	metadata, the caller has to release() it
+*/
+Metadata* const MetadataCache::getTrack(const int & number, const bool & needCover) {
+	int position = number;
+
+	if (position == -1)
+		position = winampstate.getListPosition();
+
+	return get((char*)SendMessage(plugin.hwndParent,WM_WA_IPC,position,IPC_GETPLAYLISTFILE), needCover);
+}
+
+/**
+* \brief	IndexReader
+*
+* reads the values of the index file from its mapped view, every read checks the end of the view
+*/
+class IndexReader {
+	private:
+		const char *position;
+		const char *end;
+
+	public:
+		IndexReader(const char *data, const unsigned long long & length) : position(data), end(data + length), failed(false) {}
+
+		bool failed;
+
+		template <typename T> T const read() {
+			T value = T();
+
+			if (end - position < (ptrdiff_t)sizeof(T))
+				failed = true;
+			else {
+				memcpy(&value, position, sizeof(T));
+				position += sizeof(T);
+			}
+
+			return value;
+		}
+
+		std::string const readString() {
+			unsigned int length = read<unsigned int>();
+
+			if (failed || (unsigned int)(end - position) < length) {
+				failed = true;
+
+				return std::string();
+			}
+
+			std::string value(position, length);
+			position += length;
+
+			return value;
+		}
+};
+
+/**
+* \brief	writeString
+*
+* writes a string with its length to the index file
+*
+* \param	file	index file
+* \param	value	string to write
+*/
+static void writeString(ofstream & file, const std::string & value) {
+	unsigned int length = value.length();
+
+	file.write((const char*)&length, sizeof(length));
+	file.write(value.data(), length);
+}
+
+/**
+* \brief	writeValue
+*
+* writes a plain value to the index file
+*
+* \param	file	index file
+* \param	value	value to write
+*/
+template <typename T> static void writeValue(ofstream & file, const T & value) {
+	file.write((const char*)&value, sizeof(T));
+}
+
+/**
+* \brief	load
+*
+* fills the cache from the index file written by save. the file is mapped and read sequentially, so a warm start
+* doesn't open the music files. entries are checked against the files when they are requested
+*
+* \param	path	path of the index file
+*
+* \return	1 if error, 0 if success
+*/
+int const MetadataCache::load(const std::string & path) {
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+
+	if (file == INVALID_HANDLE_VALUE)
+		return 1;
+
+	LARGE_INTEGER length;
+
+	if (GetFileSizeEx(file, &length) == 0 || length.QuadPart == 0) {
+		CloseHandle(file);
+
+		return 1;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	const char *view = mapping != NULL ? (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+
+	int result = 1;
+
+	if (view != NULL) {
+		IndexReader reader(view, length.QuadPart);
+
+		unsigned int magic = reader.read<unsigned int>();
+		unsigned int version = reader.read<unsigned int>();
+		unsigned int count = reader.read<unsigned int>();
+
+		if (!reader.failed && magic == METADATA_INDEX_MAGIC && version == METADATA_INDEX_VERSION) {
+			// CRITICAL
+			EnterCriticalSection(&cs_metadata);
+
+			for (unsigned int i = 0; i < count && !reader.failed; i++) {
+				MetadataEntry entry;
+				entry.path = pathtable.intern(reader.readString());
+				entry.modified = reader.read<FILETIME>();
+				entry.fileSize = reader.read<unsigned long long>();
+
+				// checked against the file on the first request
+				entry.watched = false;
+				entry.checked = 0;
+
+				Metadata *metadata = new Metadata();
+				metadata->valid = reader.read<char>() != 0;
+				metadata->limited = reader.read<char>() != 0;
+				metadata->title = reader.readString();
+				metadata->artist = stringpool.intern(reader.readString());
+				metadata->album = stringpool.intern(reader.readString());
+				metadata->genre = stringpool.intern(reader.readString());
+				metadata->albumArtist = stringpool.intern(reader.readString());
+				metadata->comment = reader.readString();
+				metadata->year = reader.read<unsigned int>();
+				metadata->track = reader.read<unsigned int>();
+				metadata->samplerate = reader.read<int>();
+				metadata->bitrate = reader.read<int>();
+				metadata->length = reader.read<int>();
+				metadata->samples = reader.read<long long>();
+				metadata->seekSpacing = reader.read<unsigned int>();
+
+				unsigned int seekPoints = reader.read<unsigned int>();
+
+				for (unsigned int p = 0; p < seekPoints && !reader.failed; p++)
+					metadata->seekTable.push_back(reader.read<unsigned int>());
+
+				metadata->hasCover = reader.read<char>() != 0;
+				metadata->coverHash = reader.readString();
+				metadata->coverUnknown = reader.read<char>() != 0;
+
+				if (reader.failed) {	// truncated
+					metadata->release();
+					break;
+				}
+
+				entry.metadata = metadata;
+				insert(entry);
+			}
+
+			LeaveCriticalSection(&cs_metadata);
+			// CRITICAL END
+
+			result = 0;
+		}
+
+		UnmapViewOfFile(view);
+	}
+
+	if (mapping != NULL)
+		CloseHandle(mapping);
+
+	CloseHandle(file);
+
+	return result;
+}
+
+/**
+* \brief	save
+*
+* writes the cached metadata without the covers to the index file, least recently used first
+*
+* \param	path	path of the index file
+*
+* \return	1 if error, 0 if success
+*/
+int const MetadataCache::save(const std::string & path) {
+	std::string temporary = path + ".tmp";
+
+	ofstream file(temporary.c_str(), ios::out | ios::binary | ios::trunc);
+
+	if (!file)
+		return 1;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_metadata);
+
+	writeValue(file, (unsigned int)METADATA_INDEX_MAGIC);
+	writeValue(file, (unsigned int)METADATA_INDEX_VERSION);
+	writeValue(file, (unsigned int)entries.size());
+
+	for (std::list<MetadataEntry>::iterator it = entries.begin(); it != entries.end(); it++) {
+		const Metadata *metadata = it->metadata;
+
+		writeString(file, pathtable.path(it->path));
+		writeValue(file, it->modified);
+		writeValue(file, it->fileSize);
+
+		writeValue(file, (char)(metadata->valid ? 1 : 0));
+		writeValue(file, (char)(metadata->limited ? 1 : 0));
+		writeString(file, metadata->title);
+		writeString(file, stringpool.value(metadata->artist));
+		writeString(file, stringpool.value(metadata->album));
+		writeString(file, stringpool.value(metadata->genre));
+		writeString(file, stringpool.value(metadata->albumArtist));
+		writeString(file, metadata->comment);
+		writeValue(file, metadata->year);
+		writeValue(file, metadata->track);
+		writeValue(file, metadata->samplerate);
+		writeValue(file, metadata->bitrate);
+		writeValue(file, metadata->length);
+		writeValue(file, metadata->samples);
+		writeValue(file, metadata->seekSpacing);
+		writeValue(file, (unsigned int)metadata->seekTable.size());
+
+		if (!metadata->seekTable.empty())
+			file.write((const char*)&metadata->seekTable[0], metadata->seekTable.size() * sizeof(unsigned int));
+
+		writeValue(file, (char)(metadata->hasCover ? 1 : 0));
+		writeString(file, metadata->coverHash);
+		writeValue(file, (char)(metadata->coverUnknown ? 1 : 0));
+	}
+
+	LeaveCriticalSection(&cs_metadata);
+	// CRITICAL END
+
+	bool failed = file.fail();
+
+	file.close();
+
+	// replace the old index only if the new one is complete
+	if (failed || MoveFileExA(temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) == 0) {
+		remove(temporary.c_str());
+
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+* \brief	getHits
+*
+* \return	number of requests answered from the cache
+*/
+LONG const MetadataCache::getHits() {
+	return hits;
+}
+
+/**
+* \brief	getMisses
+*
+* \return	number of requests that had to parse the file
+*/
+LONG const MetadataCache::getMisses() {
+	return misses;
+}
+
+/**
+* \brief	reportSources
+*
+* adds the hit rate of every metadata source to the stats
+*
+* \param	lines	receives one line per source
+*/
+void MetadataCache::reportSources(std::vector<std::string> & lines) {
+	for (unsigned int i = 0; i < sources.size(); i++) {
+		LONG sourceHits = sources[i]->getHits();
+		LONG sourceMisses = sources[i]->getMisses();
+
+		stringstream line;
+		line << "metadata_source " << sources[i]->name() << " hits " << sourceHits << " misses " << sourceMisses
+			<< " hit_rate " << (sourceHits + sourceMisses > 0 ? sourceHits * 100 / (sourceHits + sourceMisses) : 0);
+		lines.push_back(line.str());
+	}
+}
+
+/**
+* \brief	clear
+*
+* drops all cached metadata
+*/
+void MetadataCache::clear() {
+	// CRITICAL
+	EnterCriticalSection(&cs_metadata);
+
+	for (std::list<MetadataEntry>::iterator it = entries.begin(); it != entries.end(); it++)
+		it->metadata->release();
+
+	entries.clear();
+	bytes = 0;
+
+	account();
+
+	LeaveCriticalSection(&cs_metadata);
+	// CRITICAL END
+}
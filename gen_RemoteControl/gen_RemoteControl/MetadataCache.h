@@ -0,0 +1,159 @@
+#pragma once
+#include "stdafx.h"
+
+// maximum number of bytes of all cached metadata including the covers
+#define METADATA_CACHE_SIZE 16777216
+
+// milliseconds a file of a watched directory is trusted without asking the file system, shares may lose notifications
+#define METADATA_RECHECK_INTERVAL 300000
+
+// metadata index file: "RCMI", version
+#define METADATA_INDEX_MAGIC 0x494D4352
+#define METADATA_INDEX_VERSION 5
+
+// parts of a file read by TagLibSource. other ID3v2 frames and FLAC blocks are skipped without being parsed
+#define METADATA_READ_MODE (TagLib::File::ReadBasicFields | TagLib::File::ReadPictures | TagLib::File::ReadAudioProperties)
+
+// parse limits of TagLib: bytes read per file, bytes of one read and milliseconds per file. a corrupt size field or a
+// file without frames stops there instead of being read completely
+#define METADATA_PARSE_MAX_BYTES 67108864
+#define METADATA_PARSE_MAX_BLOCK 33554432
+#define METADATA_PARSE_DEADLINE 5000
+
+
+// file information of one track, read once with TagLib. never changed after it is created
+class Metadata {
+	private:
+		volatile LONG references;
+
+		~Metadata();
+
+	public:
+		Metadata();
+
+		// false if TagLib couldn't read the file
+		bool valid;
+
+		// true if the parse has run into the limits, the fields are what was read before. the index keeps it, the file
+		// isn't parsed again until it changes
+		bool limited;
+
+		std::string title;
+		std::string comment;
+
+		// ids of the values in stringpool, they repeat across the tracks
+		unsigned int artist;
+		unsigned int album;
+		unsigned int genre;
+
+		// STRING_POOL_EMPTY if the tags don't name one
+		unsigned int albumArtist;
+
+		unsigned int year;
+		unsigned int track;
+
+		// -1 if unknown
+		int samplerate;
+		int bitrate;
+		int length;
+
+		// samples per channel, -1 if unknown. exact for MP3 files without VBR header as well, their frames are
+		// counted once and the index keeps the result for the lifetime of the file
+		long long samples;
+
+		// MP3 files whose frames have been counted: file offsets of every seekSpacing-th frame
+		std::vector<unsigned int> seekTable;
+		unsigned int seekSpacing;
+
+		// embedded picture. NULL if there is none or if the metadata has been loaded from the index
+		SharedData *cover;
+
+		// true if the file has an embedded picture, its hash identifies it without reading it
+		bool hasCover;
+		std::string coverHash;
+
+		// true if the metadata comes from the media library, which doesn't know the covers. the file is read when the cover is needed
+		bool coverUnknown;
+
+		unsigned int const size();
+
+		Metadata* const edited(const std::string & field, const std::string & value);
+
+		void addRef();
+		void release();
+};
+
+// cached metadata of one file
+struct MetadataEntry {
+	// id of the canonical lower case path in pathtable
+	unsigned int path;
+
+	FILETIME modified;
+	unsigned long long fileSize;
+	Metadata *metadata;
+
+	// true if the directory was watched when modified and fileSize were checked, see DirectoryWatcher
+	bool watched;
+
+	// tick count of the last check
+	DWORD checked;
+};
+
+
+class MetadataCache : public BudgetClient {
+	private:
+		// least recently used entry first
+		std::list<MetadataEntry> entries;
+		unsigned int bytes;
+
+		// bytes charged to MEMORY_METADATA, see account
+		unsigned int charged;
+
+		volatile LONG hits;
+		volatile LONG misses;
+
+		// critical metadata cache section
+		CRITICAL_SECTION cs_metadata;
+
+		// asked in this order
+		LibrarySource library;
+		TagLibSource taglib;
+		std::vector<MetadataSource*> sources;
+
+		// sizes and modification times of the files by directory
+		DirectoryListings listings;
+
+		Metadata* const fetch(const char *file, const WIN32_FILE_ATTRIBUTE_DATA *attributes, const bool & needCover, const bool & keepCover);
+		static bool const canonical(const char *file, std::string & path);
+		bool const identify(const char *file, std::string & path, WIN32_FILE_ATTRIBUTE_DATA & attributes);
+
+		Metadata* const read(const char *file, const bool & needCover, const bool & keepCover, const bool & parse);
+		void insert(const MetadataEntry & entry);
+		void evict(const LONGLONG & limit);
+		void account();
+
+	public:
+		MetadataCache();
+
+		~MetadataCache();
+
+		Metadata* const get(const char *file, const bool & needCover = false);
+		Metadata* const getTrack(const int & number, const bool & needCover = false);
+		Metadata* const find(const char *file);
+		void prefetch(const char *file);
+
+		int const edit(const char *file, const std::string & field, const std::string & value);
+		void drop(const char *file);
+		void invalidate(const std::string & path);
+		void invalidateDirectory(const std::string & path);
+
+		int const load(const std::string & path);
+		int const save(const std::string & path);
+
+		LONG const getHits();
+		LONG const getMisses();
+		void reportSources(std::vector<std::string> & lines);
+
+		void clear();
+		virtual void trim(const LONGLONG & limit);
+};
@@ -0,0 +1,436 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	MetadataSource
+*
+* constructor
+*/
+MetadataSource::MetadataSource() {
+	hits = 0;
+	misses = 0;
+}
+
+/**
+* \brief	lookup
+*
+* reads the metadata of a file and counts whether the source knew it
+*
+* \param	file		path of the file
+* \param	attributes	modification time and size of the file, NULL for streams
+* \param	keepCover	false to keep only the hash of the picture
+*
+* \return	new metadata with one reference, NULL or not valid if the source doesn't know the file
+*/
+Metadata* const MetadataSource::lookup(const char *file, const WIN32_FILE_ATTRIBUTE_DATA *attributes, const bool & keepCover) {
+	Metadata *metadata = read(file, attributes, keepCover);
+
+	if (metadata != NULL && metadata->valid)
+		InterlockedIncrement(&hits);
+	else
+		InterlockedIncrement(&misses);
+
+	return metadata;
+}
+
+/**
+* \brief	getHits
+*
+* \return	number of files the source knew
+*/
+LONG const MetadataSource::getHits() {
+	return hits;
+}
+
+/**
+* \brief	getMisses
+*
+* \return	number of files the source didn't know
+*/
+LONG const MetadataSource::getMisses() {
+	return misses;
+}
+
+/**
+* \brief	name
+*
+* \return	name of the source in the stats
+*/
+const char* const LibrarySource::name() {
+	return "library";
+}
+
+/**
+* \brief	hasCovers
+*
+* \return	false, the media library doesn't know the covers
+*/
+bool const LibrarySource::hasCovers() {
+	return false;
+}
+
+/**
+* \brief	wideString
+*
+* \param	value	string of the media library, may be NULL
+*
+* \return	the string like TagLib::String::toCString returns the values read by TagLib
+*/
+static std::string const wideString(const wchar_t *value) {
+	if (value == NULL)
+		return std::string();
+
+	return TagLib::String(value).toCString();
+}
+
+/**
+* \brief	read
+*
+* looks up a file in the media library of winamp, a database query without file I/O. records that are older than
+* the file are ignored, the library hasn't seen the last change yet
+*
+* \param	file		path of the file
+* \param	attributes	modification time and size of the file, NULL for streams
+* \param	keepCover	not used, the library has no covers
+*
+* \return	new metadata with one reference, the cover is unknown. NULL if the library doesn't know the file
+*/
+Metadata* const LibrarySource::read(const char *file, const WIN32_FILE_ATTRIBUTE_DATA *attributes, const bool & keepCover) {
+	if (file == NULL || attributes == NULL)
+		return NULL;
+
+	CHECK_MLDB();
+
+	if (WASABI_API_MLDB == NULL)
+		return NULL;
+
+	TraceSpan span("library_lookup");
+
+	itemRecordW *record;
+
+	{
+		SlowOperation slow("library_get", file);
+
+		record = WASABI_API_MLDB->GetFile(CA2W(file));
+	}
+
+	if (record == NULL)
+		return NULL;
+
+	// the library keeps the modification time in seconds since 1970 and the size in kilobytes
+	ULARGE_INTEGER written;
+	written.LowPart = attributes->ftLastWriteTime.dwLowDateTime;
+	written.HighPart = attributes->ftLastWriteTime.dwHighDateTime;
+
+	__time64_t modified = (__time64_t)((written.QuadPart - 116444736000000000ULL) / 10000000ULL);
+	unsigned long long fileSize = ((unsigned long long)attributes->nFileSizeHigh << 32) | attributes->nFileSizeLow;
+
+	if (record->filetime != modified || (unsigned long long)record->filesize != fileSize / 1024) {
+		WASABI_API_MLDB->FreeRecord(record);
+
+		return NULL;
+	}
+
+	Metadata *metadata = new Metadata();
+
+	metadata->valid = true;
+	metadata->title = wideString(record->title);
+	metadata->artist = stringpool.intern(wideString(record->artist));
+	metadata->album = stringpool.intern(wideString(record->album));
+	metadata->genre = stringpool.intern(wideString(record->genre));
+	metadata->albumArtist = stringpool.intern(wideString(record->albumartist));
+	metadata->comment = wideString(record->comment);
+	metadata->year = record->year > 0 ? record->year : 0;
+	metadata->track = record->track > 0 ? record->track : 0;
+
+	metadata->bitrate = record->bitrate > 0 ? record->bitrate : -1;
+	metadata->length = record->length > 0 ? record->length : -1;
+
+	metadata->coverUnknown = true;
+
+	WASABI_API_MLDB->FreeRecord(record);
+
+	return metadata;
+}
+
+/**
+* \brief	name
+*
+* \return	name of the source in the stats
+*/
+const char* const TagLibSource::name() {
+	return "taglib";
+}
+
+/**
+* \brief	hasCovers
+*
+* \return	true, TagLib reads the embedded pictures and asks the album art providers for the others
+*/
+bool const TagLibSource::hasCovers() {
+	return true;
+}
+
+/**
+* \brief	readXiphPicture
+*
+* decodes the first METADATA_BLOCK_PICTURE field of a Xiph comment, the picture of Ogg Vorbis and Speex files.
+* the picture data is moved to the front of the decoded block, so it is stored without another copy
+*
+* \param	xiph	comment of the file, may be NULL
+*
+* \return	picture, empty if there is none or the field is damaged
+*/
+static TagLib::ByteVector const readXiphPicture(const TagLib::Ogg::XiphComment *xiph) {
+	if (xiph == NULL || xiph->pictureData().isEmpty())
+		return TagLib::ByteVector();
+
+	const TagLib::ByteVector & text = xiph->pictureData().front();
+
+	TagLib::ByteVector block(text.size() / 4 * 3 + 3, 0);
+	int decoded = base64_decode(text.data(), text.size(), (unsigned char*)block.data());
+
+	// FLAC picture block: type, MIME type, description, width, height, depth, colors and length of the data before it
+	unsigned int offset = 4;
+
+	if (decoded < 32)
+		return TagLib::ByteVector();
+
+	offset += 4 + block.mid(offset, 4).toUInt();	// MIME type
+
+	if ((unsigned int)decoded < offset + 4)
+		return TagLib::ByteVector();
+
+	offset += 4 + block.mid(offset, 4).toUInt() + 16;	// description, width, height, depth and colors
+
+	if ((unsigned int)decoded < offset + 4)
+		return TagLib::ByteVector();
+
+	unsigned int length = block.mid(offset, 4).toUInt();
+	offset += 4;
+
+	if (length == 0 || length > (unsigned int)decoded - offset)
+		return TagLib::ByteVector();
+
+	memmove(block.data(), block.data() + offset, length);
+	block.resize(length);
+
+	return block;
+}
+
+/**
+* \brief	readAlbumArtist
+*
+* TagFields has no album artist, it is looked up in the tags that have one: TPE2 of ID3v2, ALBUMARTIST of Xiph
+* comments and aART of MP4. APE and ASF tags aren't asked
+*
+* \param	f		opened file
+* \param	mpeg	the file if it is an MP3 file, else NULL
+* \param	flac	the file if it is a FLAC file, else NULL
+*
+* \return	album artist, empty if there is none
+*/
+static TagLib::String const readAlbumArtist(TagLib::FileRef & f, TagLib::MPEG::File *mpeg, TagLib::FLAC::File *flac) {
+	TagLib::ID3v2::Tag *id3v2 = mpeg != NULL ? mpeg->ID3v2Tag() : NULL;
+
+	if (id3v2 != NULL) {
+		const TagLib::ID3v2::FrameList & frames = id3v2->frameList("TPE2");
+
+		return frames.isEmpty() ? TagLib::String() : frames.front()->toString();
+	}
+
+	TagLib::Ogg::XiphComment *xiph = flac != NULL ? flac->xiphComment() : dynamic_cast<TagLib::Ogg::XiphComment *>(f.tag());
+
+	// contains() looks the key up in the comment as read, fieldListMap() would
+	// decode every field including the pictures
+	if (xiph != NULL && xiph->contains("ALBUMARTIST")) {
+		const TagLib::Ogg::FieldListMap & fields = xiph->fieldListMap();
+		TagLib::Ogg::FieldListMap::ConstIterator it = fields.find("ALBUMARTIST");
+
+		return it != fields.end() && !it->second.isEmpty() ? it->second.front() : TagLib::String();
+	}
+
+	TagLib::MP4::Tag *mp4 = dynamic_cast<TagLib::MP4::Tag *>(f.tag());
+
+	if (mp4 != NULL && mp4->itemListMap().contains("aART")) {
+		TagLib::StringList values = mp4->itemListMap()["aART"].toStringList();
+
+		return values.isEmpty() ? TagLib::String() : values.front();
+	}
+
+	return TagLib::String();
+}
+
+/**
+* \brief	read
+*
+* reads tags, audio properties and the embedded picture of a file. the file is opened only once.
+* files without embedded picture get the cover of the album art providers
+*
+* \param	file		path of the file
+* \param	attributes	not used, the file is read anyway
+* \param	keepCover	false to keep only the hash of the picture
+*
+* \return	new metadata with one reference, not valid if TagLib couldn't read the file
+*/
+Metadata* const TagLibSource::read(const char *file, const WIN32_FILE_ATTRIBUTE_DATA *attributes, const bool & keepCover) {
+	TraceSpan span("parse");
+	SlowOperation slow("parse", file);
+	MemoryTag memoryTag(MEMORY_TAGLIB, GOVERNOR_TAG_BYTES);
+
+	Metadata *metadata = new Metadata();
+
+	// picture storage of TagLib, shared with the output buffer instead of copied
+	TagLib::ByteVector picture;
+
+	LONGLONG started = metrics.now();
+	int format = FORMAT_OTHER;
+
+	// TagLib has looked for the embedded picture
+	bool embeddedRead = false;
+
+	try {
+		// the format is detected from the content, files with a wrong extension are read as well
+		TagLib::FileRef f(file, METADATA_READ_MODE);
+
+		slow.stage("open");
+
+		TagLib::MPEG::File *mpeg = dynamic_cast<TagLib::MPEG::File *>(f.file());
+		TagLib::FLAC::File *flac = dynamic_cast<TagLib::FLAC::File *>(f.file());
+
+		if (mpeg != NULL) {
+			format = FORMAT_MP3;
+			embeddedRead = true;
+
+			if (mpeg->isValid() && mpeg->ID3v2Tag()) {
+				TagLib::ID3v2::FrameList l = mpeg->ID3v2Tag()->frameList("APIC");	// APIC: attached picture frame
+
+				if (!l.isEmpty())
+					picture = static_cast<TagLib::ID3v2::AttachedPictureFrame *>(l.front())->picture();	// front: first item
+			}
+		} else if (flac != NULL) {
+			format = FORMAT_FLAC;
+			embeddedRead = true;
+
+			if (flac->isValid()) {
+				TagLib::List<TagLib::FLAC::Picture *> pictureList = flac->pictureList();
+
+				if (!pictureList.isEmpty())
+					picture = pictureList.front()->data();
+			}
+		} else if (!f.isNull() && f.file()->isValid()) {
+			TagLib::Ogg::XiphComment *xiph = dynamic_cast<TagLib::Ogg::XiphComment *>(f.tag());
+
+			if (xiph != NULL) {
+				embeddedRead = true;
+				picture = readXiphPicture(xiph);
+			} else {
+				// MP4, ASF and APE tags: one read of the picture instead of the copies TagLib made of every picture
+				std::vector<PictureLocation> pictures;
+				embeddedRead = PictureLocator::locatePictures(*f.file(), pictures);
+
+				int chosen = PictureLocator::choose(pictures);
+
+				if (chosen >= 0)
+					picture = PictureLocator::read(*f.file(), pictures[chosen]);
+			}
+		}
+
+		slow.stage("picture");
+
+		if (!f.isNull() && f.file()->isValid()) {
+			metadata->valid = true;
+
+			TagLib::Tag *tag = f.tag();
+
+			if (tag != NULL) {
+				// all fields with one walk of the frames instead of one lookup per field
+				TagLib::TagFields fields;
+				tag->readFields(fields);
+
+				metadata->title = fields.title.toCString();
+				metadata->artist = stringpool.intern(fields.artist.toCString());
+				metadata->album = stringpool.intern(fields.album.toCString());
+				metadata->genre = stringpool.intern(fields.genre.toCString());
+				metadata->comment = fields.comment.toCString();
+				metadata->year = fields.year;
+				metadata->track = fields.track;
+			}
+
+			metadata->albumArtist = stringpool.intern(readAlbumArtist(f, mpeg, flac).toCString());
+
+			TagLib::AudioProperties *properties = f.audioProperties();
+
+			if (properties != NULL) {
+				metadata->samplerate = properties->sampleRate();
+				metadata->bitrate = properties->bitrate();
+				metadata->length = properties->length();
+			}
+
+			TagLib::MPEG::Properties *mpegProperties = mpeg != NULL ? mpeg->audioProperties() : NULL;
+
+			if (mpegProperties != NULL) {
+				if (mpegProperties->xingHeader() == NULL && mpegProperties->isVariableBitrate()) {
+					// VBR without Xing or VBRI header: the sampled length is only an estimate, the frames are counted.
+					// the index keeps the result, so that happens once for the lifetime of the file
+					TraceSpan scan("frame_scan");
+					slow.stage("properties");
+
+					TagLib::MPEG::Properties accurate(mpeg, TagLib::AudioProperties::Accurate);
+
+					if (accurate.lengthInMicroseconds() > 0) {
+						metadata->bitrate = accurate.bitrate();
+						metadata->length = accurate.length();
+						metadata->samples = accurate.sampleFrames();
+						metadata->seekSpacing = accurate.seekTableSpacing();
+
+						const TagLib::List<long> & table = accurate.seekTable();
+
+						for (TagLib::List<long>::ConstIterator it = table.begin(); it != table.end(); it++)
+							metadata->seekTable.push_back((unsigned int)*it);
+					}
+					slow.stage("frame_scan");
+				} else
+					metadata->samples = mpegProperties->sampleFrames();
+			}
+		}
+
+		slow.stage("fields");
+
+		if (!f.isNull()) {
+			Metrics::add(metrics.parseCalls, f.file()->ioCalls());
+			slow.addBytes(f.file()->bytesRead());
+
+			// partial result, kept like a complete one so the file isn't read again
+			if (f.file()->limitExceeded()) {
+				metadata->limited = true;
+				InterlockedIncrement(&metrics.parsesLimited);
+			}
+		}
+	} catch (...) {
+		picture = TagLib::ByteVector();
+	}
+
+	metrics.parseTime[format].record(metrics.now() - started);
+	slow.setFormat(format);
+
+	// the album art providers know the formats without embedded pictures and folder art
+	if (picture.isEmpty() && metadata->valid)
+		picture = coverresolver.resolve(file, embeddedRead);
+
+	slow.stage("cover");
+
+	// the file has been closed, picture is now the only owner of the storage
+	if (!picture.isEmpty()) {
+		metadata->cover = new SharedData(picture);
+		metadata->hasCover = true;
+		metadata->coverHash = CoverCache::hash(metadata->cover);
+
+		if (!keepCover) {
+			metadata->cover->release();
+			metadata->cover = NULL;
+		}
+	}
+
+	return metadata;
+}
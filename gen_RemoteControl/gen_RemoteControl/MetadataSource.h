@@ -0,0 +1,51 @@
+#pragma once
+#include "stdafx.h"
+
+class Metadata;
+
+// source of the metadata of a file. the metadata cache asks its sources in order until one knows the file
+class MetadataSource {
+	private:
+		volatile LONG hits;
+		volatile LONG misses;
+
+	protected:
+		virtual Metadata* const read(const char *file, const WIN32_FILE_ATTRIBUTE_DATA *attributes, const bool & keepCover) = 0;
+
+	public:
+		MetadataSource();
+
+		virtual ~MetadataSource() {}
+
+		virtual const char* const name() = 0;
+
+		// false if the metadata of the source never has the cover
+		virtual bool const hasCovers() = 0;
+
+		Metadata* const lookup(const char *file, const WIN32_FILE_ATTRIBUTE_DATA *attributes, const bool & keepCover);
+
+		LONG const getHits();
+		LONG const getMisses();
+};
+
+
+// the media library of winamp. it has indexed the tags of its files, they are read without opening the file
+class LibrarySource : public MetadataSource {
+	protected:
+		virtual Metadata* const read(const char *file, const WIN32_FILE_ATTRIBUTE_DATA *attributes, const bool & keepCover);
+
+	public:
+		virtual const char* const name();
+		virtual bool const hasCovers();
+};
+
+
+// reads the file with TagLib, knows every file TagLib can read
+class TagLibSource : public MetadataSource {
+	protected:
+		virtual Metadata* const read(const char *file, const WIN32_FILE_ATTRIBUTE_DATA *attributes, const bool & keepCover);
+
+	public:
+		virtual const char* const name();
+		virtual bool const hasCovers();
+};
@@ -0,0 +1,404 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	Histogram
+*
+* constructor
+*/
+Histogram::Histogram() {
+	reset();
+}
+
+/**
+* \brief	reset
+*
+* removes all values. values recorded at the same time may be lost
+*/
+void Histogram::reset() {
+	for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+		InterlockedExchange(&buckets[i], 0);
+
+	InterlockedExchange(&count, 0);
+	InterlockedExchange64(&total, 0);
+	InterlockedExchange(&maximum, 0);
+}
+
+/**
+* \brief	record
+*
+* adds a value
+*
+* \param	value	duration in microseconds
+*/
+void Histogram::record(const LONGLONG & value) {
+	LONG clipped = value < 0 ? 0 : (value > MAXLONG ? MAXLONG : (LONG)value);
+
+	int bucket = 0;
+
+	while (bucket < HISTOGRAM_BUCKETS - 1 && (clipped >> bucket) != 0)
+		bucket++;
+
+	InterlockedIncrement(&buckets[bucket]);
+	InterlockedIncrement(&count);
+	Metrics::add(total, clipped);
+
+	// raise the maximum unless another thread has set a higher one
+	LONG current = maximum;
+
+	while (clipped > current) {
+		LONG previous = InterlockedCompareExchange(&maximum, clipped, current);
+
+		if (previous == current)
+			break;
+
+		current = previous;
+	}
+}
+
+/**
+* \brief	getCount
+*
+* \return	number of values
+*/
+LONG const Histogram::getCount() {
+	return count;
+}
+
+/**
+* \brief	getAverage
+*
+* \return	average in microseconds, 0 without values
+*/
+LONG const Histogram::getAverage() {
+	LONG number = count;
+
+	return number > 0 ? (LONG)(total / number) : 0;
+}
+
+/**
+* \brief	getMaximum
+*
+* \return	highest value in microseconds
+*/
+LONG const Histogram::getMaximum() {
+	return maximum;
+}
+
+/**
+* \brief	percentile
+*
+* \param	percent	1-100
+*
+* \return	upper bound in microseconds of the bucket that contains the percentile, never above the maximum
+*/
+LONG const Histogram::percentile(const int & percent) {
+	LONG number = count;
+
+	if (number == 0)
+		return 0;
+
+	LONGLONG rank = ((LONGLONG)number * percent + 99) / 100;
+	LONGLONG seen = 0;
+
+	for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+		seen += buckets[i];
+
+		if (seen >= rank) {
+			LONG bound = i == 0 ? 0 : (LONG)((1LL << i) - 1);
+
+			return bound < maximum ? bound : maximum;
+		}
+	}
+
+	return maximum;
+}
+
+
+/**
+* \brief	Metrics
+*
+* constructor
+*/
+Metrics::Metrics() {
+	LARGE_INTEGER value;
+	QueryPerformanceFrequency(&value);
+
+	frequency = value.QuadPart;
+
+	reset();
+}
+
+/**
+* \brief	reset
+*
+* clears all counters. called when the server starts
+*/
+void Metrics::reset() {
+	syncTime.reset();
+	sendLatency.reset();
+	enqueueTime.reset();
+	queueWait.reset();
+
+	for (int i = 0; i < FORMATS; i++)
+		parseTime[i].reset();
+
+	InterlockedExchange64(&bytesSent, 0);
+	InterlockedExchange(&messagesSent, 0);
+
+	InterlockedExchange64(&coverBytes, 0);
+	InterlockedExchange(&coversSent, 0);
+	InterlockedExchange(&coversCached, 0);
+	InterlockedExchange(&coversReduced, 0);
+	InterlockedExchange(&coversUpgraded, 0);
+	InterlockedExchange(&coversAborted, 0);
+	InterlockedExchange64(&coverBytesAborted, 0);
+	InterlockedExchange(&coversProvided, 0);
+	InterlockedExchange(&coverMisses, 0);
+	InterlockedExchange(&tracksPrefetched, 0);
+
+	InterlockedExchange(&commandsSuperseded, 0);
+	InterlockedExchange(&sessionsResumed, 0);
+	InterlockedExchange(&sessionsCongested, 0);
+	InterlockedExchange(&eventsCollapsed, 0);
+	InterlockedExchange(&tasksPaused, 0);
+	InterlockedExchange(&sessionsStalled, 0);
+	InterlockedExchange(&tlsSessions, 0);
+	InterlockedExchange(&tlsResumed, 0);
+	InterlockedExchange(&tlsFailures, 0);
+	InterlockedExchange(&rioSessions, 0);
+	InterlockedExchange(&rioDequeues, 0);
+	InterlockedExchange64(&rioCompletions, 0);
+	InterlockedExchange(&webRequests, 0);
+	InterlockedExchange(&webSockets, 0);
+	InterlockedExchange64(&deflateBytes, 0);
+	InterlockedExchange64(&deflatedBytes, 0);
+	InterlockedExchange(&imageSegments, 0);
+	InterlockedExchange(&imageSegmentsAhead, 0);
+	InterlockedExchange(&imageWaits, 0);
+
+	InterlockedExchange64(&parseCalls, 0);
+	InterlockedExchange(&parsesLimited, 0);
+	InterlockedExchange(&libraryUpdates, 0);
+	InterlockedExchange(&librarySyncs, 0);
+	InterlockedExchange(&slowOperations, 0);
+	InterlockedExchange(&progressSamples, 0);
+	InterlockedExchange(&progressTicks, 0);
+	InterlockedExchange(&datagramsSent, 0);
+	InterlockedExchange(&datagramBinds, 0);
+	InterlockedExchange(&commandsAcknowledged, 0);
+	InterlockedExchange(&echoesSuppressed, 0);
+	InterlockedExchange(&bulkBinds, 0);
+	InterlockedExchange(&bulkFallbacks, 0);
+	InterlockedExchange64(&bulkBytes, 0);
+	InterlockedExchange(&sendWaits, 0);
+	InterlockedExchange64(&bulkBytesGranted, 0);
+	InterlockedExchange(&logDropped, 0);
+	InterlockedExchange(&logBytes, 0);
+	InterlockedExchange(&logFailures, 0);
+	InterlockedExchange(&trackRequestsMerged, 0);
+	InterlockedExchange(&trackPartsCancelled, 0);
+
+	MemoryTag::reset();
+
+	InterlockedExchange64(&started, now());
+}
+
+/**
+* \brief	now
+*
+* \return	performance counter in microseconds
+*/
+LONGLONG const Metrics::now() {
+	LARGE_INTEGER value;
+	QueryPerformanceCounter(&value);
+
+	return value.QuadPart / frequency * 1000000 + value.QuadPart % frequency * 1000000 / frequency;
+}
+
+/**
+* \brief	add
+*
+* adds to a 64 bit counter
+*
+* \param	counter	counter
+* \param	value	value to add
+*/
+void Metrics::add(volatile LONGLONG & counter, const LONGLONG & value) {
+	InterlockedExchangeAdd64(&counter, value);
+}
+
+/**
+* \brief	report
+*
+* describes all counters, one "<name> <values>" line each. durations are in microseconds
+*
+* \param	lines	vector that receives the lines
+*/
+void Metrics::report(std::vector<std::string> & lines) {
+	static const char *formats[FORMATS] = { "mp3", "flac", "other" };
+
+	lines.clear();
+
+	Histogram *histograms[4 + FORMATS] = { &syncTime, &sendLatency, &enqueueTime, &queueWait, &parseTime[FORMAT_MP3], &parseTime[FORMAT_FLAC],
+		&parseTime[FORMAT_OTHER] };
+
+	for (int i = 0; i < 4 + FORMATS; i++) {
+		Histogram *histogram = histograms[i];
+
+		stringstream line;
+
+		if (i == 0)
+			line << "sync";
+		else if (i == 1)
+			line << "send";
+		else if (i == 2)
+			line << "enqueue";
+		else if (i == 3)
+			line << "queue_wait";
+		else
+			line << "parse_" << formats[i - 4];
+
+		line << " count " << histogram->getCount() << " average " << histogram->getAverage() << " p50 " << histogram->percentile(50)
+			<< " p99 " << histogram->percentile(99) << " max " << histogram->getMaximum();
+
+		lines.push_back(line.str());
+	}
+
+	// at least one second so the rates of a fresh start stay readable
+	LONGLONG seconds = (now() - started) / 1000000;
+
+	if (seconds < 1)
+		seconds = 1;
+
+	stringstream throughput;
+	throughput << "throughput bytes " << bytesSent << " messages " << messagesSent
+		<< " bytes_per_second " << bytesSent / seconds << " messages_per_second " << messagesSent / seconds;
+	lines.push_back(throughput.str());
+
+	stringstream tasks;
+	tasks << "tasklist tasks " << queueWait.getCount() << " tasks_per_second " << queueWait.getCount() / seconds;
+	lines.push_back(tasks.str());
+
+	stringstream commands;
+	commands << "commands superseded " << commandsSuperseded;
+	lines.push_back(commands.str());
+
+	stringstream sessions;
+	sessions << "sessions resumed " << sessionsResumed;
+	lines.push_back(sessions.str());
+
+	stringstream backpressure;
+	backpressure << "backpressure congested " << sessionsCongested << " collapsed " << eventsCollapsed << " paused " << tasksPaused
+		<< " stalled " << sessionsStalled;
+	lines.push_back(backpressure.str());
+
+	stringstream tlsStream;
+	tlsStream << "tls sessions " << tlsSessions << " resumed " << tlsResumed << " failed " << tlsFailures;
+	lines.push_back(tlsStream.str());
+
+	stringstream transport;
+	transport << "transport backend " << (RioChannel::isAvailable() ? "rio" : "iocp") << " rio_sessions " << rioSessions << " dequeues "
+		<< rioDequeues << " per_dequeue " << (rioDequeues > 0 ? rioCompletions / rioDequeues : 0);
+	lines.push_back(transport.str());
+
+	stringstream web;
+	web << "http requests " << webRequests << " websockets " << webSockets;
+	lines.push_back(web.str());
+
+	stringstream deflate;
+	deflate << "deflate bytes " << deflateBytes << " compressed " << deflatedBytes;
+	lines.push_back(deflate.str());
+
+	stringstream image;
+	image << "title_image segments " << imageSegments << " ahead " << imageSegmentsAhead << " waits " << imageWaits;
+	lines.push_back(image.str());
+
+	stringstream covers;
+	covers << "covers sent " << coversSent << " cached " << coversCached << " bytes " << coverBytes << " reduced " << coversReduced << " upgraded " << coversUpgraded
+		<< " aborted " << coversAborted << " aborted_bytes " << coverBytesAborted;
+	lines.push_back(covers.str());
+
+	stringstream lookups;
+	lookups << "cover_lookup provided " << coversProvided << " skipped " << coverMisses;
+	lines.push_back(lookups.str());
+
+	LONG parses = 0;
+
+	for (int i = 0; i < FORMATS; i++)
+		parses += parseTime[i].getCount();
+
+	stringstream io;
+	io << "parse_io calls " << parseCalls << " per_file " << (parses > 0 ? parseCalls / parses : 0) << " limited " << parsesLimited;
+	lines.push_back(io.str());
+
+	stringstream library;
+	library << "library_update records " << libraryUpdates << " syncs " << librarySyncs;
+	lines.push_back(library.str());
+
+	stringstream slow;
+	slow << "slow_operations count " << slowOperations << " threshold_ms " << slowthreshold;
+	lines.push_back(slow.str());
+
+	LONG hits = metadatacache.getHits();
+	LONG misses = metadatacache.getMisses();
+
+	stringstream cache;
+	cache << "metadata_cache hits " << hits << " misses " << misses << " hit_rate " << (hits + misses > 0 ? hits * 100 / (hits + misses) : 0);
+	lines.push_back(cache.str());
+
+	stringstream prefetch;
+	prefetch << "prefetched tracks " << tracksPrefetched;
+	lines.push_back(prefetch.str());
+
+	stringstream progress;
+	progress << "progress_ticks samples " << progressSamples << " ticks " << progressTicks;
+	lines.push_back(progress.str());
+
+	stringstream datagrams;
+	datagrams << "datagrams sent " << datagramsSent << " binds " << datagramBinds;
+	lines.push_back(datagrams.str());
+
+	stringstream echo;
+	echo << "commands acknowledged " << commandsAcknowledged << " echoes suppressed " << echoesSuppressed;
+	lines.push_back(echo.str());
+
+	stringstream bulk;
+	bulk << "bulk connections " << bulkBinds << " fallbacks " << bulkFallbacks << " bytes " << bulkBytes;
+	lines.push_back(bulk.str());
+
+	stringstream fairShare;
+	fairShare << "fair_share waits " << sendWaits << " granted " << bulkBytesGranted;
+	lines.push_back(fairShare.str());
+
+	stringstream log;
+	log << "log bytes " << logBytes << " dropped " << logDropped << " failures " << logFailures;
+	lines.push_back(log.str());
+
+	stringstream track;
+	track << "track_info merged " << trackRequestsMerged << " cancelled " << trackPartsCancelled;
+	lines.push_back(track.str());
+
+	ThreadPolicy::report(lines);
+
+	MemoryTag::report(lines);
+
+	memorybudget.report(lines);
+
+	governor.report(lines);
+
+	workpool.report(lines);
+	coverstore.report(lines);
+
+	latencyprobes.report(lines);
+
+	metadatacache.reportSources(lines);
+
+	stringpool.report(lines);
+
+	pathtable.report(lines);
+
+	playlistindex.report(lines);
+	playlistgroups.report(lines);
+	playlistcache.report(lines);
+}
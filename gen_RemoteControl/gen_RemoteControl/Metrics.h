@@ -0,0 +1,163 @@
+#pragma once
+#include "stdafx.h"
+
+
+// bucket i of a histogram counts the values below 2^i microseconds
+#define HISTOGRAM_BUCKETS 32
+
+// formats with their own TagLib parse time
+#define FORMAT_MP3 0
+#define FORMAT_FLAC 1
+#define FORMAT_OTHER 2
+#define FORMATS 3
+
+
+// distribution of durations in microseconds with power of two buckets. record never blocks
+class Histogram {
+	private:
+		volatile LONG buckets[HISTOGRAM_BUCKETS];
+		volatile LONG count;
+		volatile LONGLONG total;
+		volatile LONG maximum;
+
+	public:
+		Histogram();
+
+		void reset();
+		void record(const LONGLONG & value);
+
+		LONG const getCount();
+		LONG const getAverage();
+		LONG const getMaximum();
+		LONG const percentile(const int & percent);
+};
+
+
+// counters of the server, reset on every start. read with the stats command or in the log when the server stops
+class Metrics {
+	private:
+		LONGLONG frequency;
+		volatile LONGLONG started;
+
+	public:
+		Metrics();
+
+		Histogram syncTime;
+		Histogram sendLatency;
+
+		// producer time of TaskList::enqueue and the time a task waits until the send command thread takes it
+		Histogram enqueueTime;
+		Histogram queueWait;
+		Histogram parseTime[FORMATS];
+
+		// completed sends
+		volatile LONGLONG bytesSent;
+		volatile LONG messagesSent;
+
+		// covers transferred and covers the client already had
+		volatile LONGLONG coverBytes;
+		volatile LONG coversSent;
+		volatile LONG coversCached;
+
+		// covers sent smaller than requested to meet COVER_DEADLINE, and the larger ones sent afterwards
+		volatile LONG coversReduced;
+		volatile LONG coversUpgraded;
+
+		// cover transfers of earlier songs aborted between two frames and their bytes that haven't been sent
+		volatile LONG coversAborted;
+		volatile LONGLONG coverBytesAborted;
+
+		// covers found by the album art providers and lookups skipped for album directories without art
+		volatile LONG coversProvided;
+		volatile LONG coverMisses;
+
+		// next tracks read before the song change, see TrackPrefetch
+		volatile LONG tracksPrefetched;
+
+		// volume_ and progress_ commands skipped because a later one arrived with them
+		volatile LONG commandsSuperseded;
+
+		// reconnected clients that got the journal instead of the synchronization
+		volatile LONG sessionsResumed;
+
+		// sessions that went above SEND_HIGH_WATER, state events held for them, bulk tasks paused for them and the
+		// sessions closed after SEND_STALL_TIMEOUT
+		volatile LONG sessionsCongested;
+		volatile LONG eventsCollapsed;
+		volatile LONG tasksPaused;
+		volatile LONG sessionsStalled;
+
+		// established TLS sessions, the ones resumed from the session cache and the failed handshakes or records
+		volatile LONG tlsSessions;
+		volatile LONG tlsResumed;
+		volatile LONG tlsFailures;
+
+		// sessions with Registered I/O, batches taken from its completion queue and the completions in them
+		volatile LONG rioSessions;
+		volatile LONG rioDequeues;
+		volatile LONGLONG rioCompletions;
+
+		// HTTP requests and the ones upgraded to WebSocket
+		volatile LONG webRequests;
+		volatile LONG webSockets;
+
+		// text compressed into deflate frames and the size of the frames
+		volatile LONGLONG deflateBytes;
+		volatile LONGLONG deflatedBytes;
+
+		// segments of the playlist image encoded, the ones the work pool has encoded ahead of the windows and the
+		// windows that have waited for a worker, see PlaylistSnapshot::shareTitles
+		volatile LONG imageSegments;
+		volatile LONG imageSegmentsAhead;
+		volatile LONG imageWaits;
+
+		// read and write calls of TagLib on parsed files
+		volatile LONGLONG parseCalls;
+
+		// parses stopped by the limits of TagLib
+		volatile LONG parsesLimited;
+
+		// records of the media library updated after tag edits and the syncs of the database, one per batch
+		volatile LONG libraryUpdates;
+		volatile LONG librarySyncs;
+
+		// operations that took longer than slowthreshold, see SlowLog
+		volatile LONG slowOperations;
+
+		// samples of the playback position and the tick_ events they have caused, see ProgressTicker
+		volatile LONG progressSamples;
+		volatile LONG progressTicks;
+
+		// datagrams sent to the clients and routes bound, see DatagramChannel
+		volatile LONG datagramsSent;
+		volatile LONG datagramBinds;
+
+		// commands acknowledged with ack_ and state events not sent back to the session that has caused them
+		volatile LONG commandsAcknowledged;
+		volatile LONG echoesSuppressed;
+
+		// bulk connections bound, the ones that were gone while the session still sent over them and the bytes they got
+		volatile LONG bulkBinds;
+		volatile LONG bulkFallbacks;
+		volatile LONGLONG bulkBytes;
+
+		// times a session has waited for tokens of the send scheduler and the bulk bytes it has handed out
+		volatile LONG sendWaits;
+		volatile LONGLONG bulkBytesGranted;
+
+		// entries dropped because the ring was full, bytes written and failed writes of the log file, see LogWriter
+		volatile LONG logDropped;
+		volatile LONG logBytes;
+		volatile LONG logFailures;
+
+		// trackFields_ requests merged into a waiting one of the same track, waiting parts of another track dropped
+		volatile LONG trackRequestsMerged;
+		volatile LONG trackPartsCancelled;
+
+		void reset();
+		LONGLONG const now();
+
+		static void add(volatile LONGLONG & counter, const LONGLONG & value);
+
+		void report(std::vector<std::string> & lines);
+};
@@ -33,12 +33,153 @@ std::string const time()
 */
 std::string const utf8_encode(const std::wstring & wstr)
 {
-    int size_needed = WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), NULL, 0, NULL, NULL);
-    std::string strTo( size_needed, 0 );
-    WideCharToMultiByte(CP_UTF8, 0, &wstr[0], (int)wstr.size(), &strTo[0], size_needed, NULL, NULL);
+    std::string strTo;
+    utf8_append(strTo, wstr.c_str(), wstr.size());
     return strTo;
 }
 
+/**
+* \brief	utf8_append
+*
+* encodes a wide unicode string to UTF8 directly at the end of a string. the string grows by the worst case of
+* three bytes per character first, so the size isn't counted in an extra pass, and is shrunk afterwards
+*
+* \param	target	string the encoded characters are appended to
+* \param	wstr	wide string
+* \param	length	number of characters of wstr
+*/
+void utf8_append(std::string & target, const wchar_t *wstr, const unsigned int & length)
+{
+    if (length == 0)
+        return;
+
+    unsigned int offset = target.length();
+    target.resize(offset + length * 3);
+    target.resize(offset + TagLib::String::encodeUTF8(wstr, length, &target[offset], length * 3));
+}
+
+#pragma managed(push, off)
+
+/**
+* \brief	base64_block
+*
+* decodes 16 base64 characters to 12 bytes with SSE2: the characters are mapped to their 6 bit values by the
+* ranges of the alphabet, pairs of values are joined to 12 bits and pairs of those to 24 bits
+*
+* \param	text	16 characters
+* \param	target	receives 12 bytes
+*
+* \return	false if one of the characters isn't in the alphabet, padding and line breaks included
+*/
+static bool const base64_block(const char *text, unsigned char *target) {
+	__m128i c = _mm_loadu_si128((const __m128i*)text);
+
+	// characters above 127 are negative and in none of the ranges
+	__m128i upper = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('Z' + 1)));
+	__m128i lower = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('z' + 1)));
+	__m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+	__m128i plus = _mm_cmpeq_epi8(c, _mm_set1_epi8('+'));
+	__m128i slash = _mm_cmpeq_epi8(c, _mm_set1_epi8('/'));
+
+	if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, plus)), slash)) != 0xFFFF)
+		return false;
+
+	__m128i offset = _mm_or_si128(_mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-'A')), _mm_and_si128(lower, _mm_set1_epi8(26 - 'a'))),
+		_mm_or_si128(_mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8(52 - '0')), _mm_and_si128(plus, _mm_set1_epi8(62 - '+'))),
+		_mm_and_si128(slash, _mm_set1_epi8(63 - '/'))));
+
+	__m128i values = _mm_add_epi8(c, offset);
+
+	// the first character of a pair is the high part: 12 bits per 16 bit lane, then 24 bits per 32 bit lane
+	__m128i pairs = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(values, _mm_set1_epi16(0x00FF)), 6), _mm_srli_epi16(values, 8));
+	__m128i groups = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));
+
+	unsigned int bits[4];
+	_mm_storeu_si128((__m128i*)bits, groups);
+
+	for (int i = 0; i < 4; i++) {
+		target[3 * i] = (unsigned char)(bits[i] >> 16);
+		target[3 * i + 1] = (unsigned char)(bits[i] >> 8);
+		target[3 * i + 2] = (unsigned char)bits[i];
+	}
+
+	return true;
+}
+
+#pragma managed(pop)
+
+/**
+* \brief	base64_decode
+*
+* decodes base64 text. blocks of 16 characters are decoded with SSE2, the characters around line breaks and the
+* padding one by one. white space is skipped, the text ends at the first =
+*
+* \param	text	base64 text
+* \param	length	number of characters
+* \param	target	receives the bytes, at least length / 4 * 3 + 3
+*
+* \return	number of bytes, -1 if the text isn't base64
+*/
+int const base64_decode(const char *text, const unsigned int & length, unsigned char *target) {
+	int written = 0;
+	unsigned int bits = 0;
+	int count = 0;
+
+	unsigned int i = 0;
+
+	while (i < length) {
+		if (count == 0 && i + 16 <= length && base64_block(text + i, target + written)) {
+			i += 16;
+			written += 12;
+
+			continue;
+		}
+
+		char c = text[i++];
+		unsigned int value;
+
+		if (c >= 'A' && c <= 'Z')
+			value = c - 'A';
+		else if (c >= 'a' && c <= 'z')
+			value = c - 'a' + 26;
+		else if (c >= '0' && c <= '9')
+			value = c - '0' + 52;
+		else if (c == '+')
+			value = 62;
+		else if (c == '/')
+			value = 63;
+		else if (c == '\r' || c == '\n' || c == ' ' || c == '\t')
+			continue;
+		else if (c == '=')
+			break;
+		else
+			return -1;
+
+		bits = bits << 6 | value;
+
+		if (++count == 4) {
+			target[written++] = (unsigned char)(bits >> 16);
+			target[written++] = (unsigned char)(bits >> 8);
+			target[written++] = (unsigned char)bits;
+
+			bits = 0;
+			count = 0;
+		}
+	}
+
+	// the last group without padding
+	if (count == 1)
+		return -1;
+	else if (count == 2)
+		target[written++] = (unsigned char)(bits >> 4);
+	else if (count == 3) {
+		target[written++] = (unsigned char)(bits >> 10);
+		target[written++] = (unsigned char)(bits >> 2);
+	}
+
+	return written;
+}
+
 /**
 * \brief	GetFileExtension
 *
@@ -53,37 +194,57 @@ std::string const GetFileExtension(const std::string & FileName) {
 }
 
 
-// Gets IP addresses of the local computer
-System::String^ GetLocalIP()
+/**
+* \brief	GetLocalIP
+*
+* gets the IPv4 addresses of the network adapters that are up. the adapters are read from the system, no name is
+* resolved, so a misconfigured DNS doesn't block
+*
+* \return	addresses, one per line. empty if there is no network connection
+*/
+std::string const GetLocalIP()
 {
-    System::String ^_IP = gcnew String("");
-
-    // Resolves a host name or IP address to an IPHostEntry instance.
-    // IPHostEntry - Provides a container class for Internet host address information. 
-    System::Net::IPHostEntry ^_IPHostEntry = System::Net::Dns::GetHostEntry(System::Net::Dns::GetHostName());
-
-    // IPAddress class contains the address of a computer on an IP network. 
-    for each (System::Net::IPAddress ^_IPAddress in _IPHostEntry->AddressList)
-    {
-        // InterNetwork indicates that an IP version 4 address is expected 
-        // when a Socket connects to an endpoint
-        if (_IPAddress->AddressFamily.ToString() == "InterNetwork")
-        {
-            _IP += _IPAddress->ToString() + "\r\n";
-        }
-    }
-    return _IP;
+	std::string ip;
+
+	// the adapters may change between the calls
+	ULONG size = 16384;
+	std::vector<char> buffer;
+	ULONG result = ERROR_BUFFER_OVERFLOW;
+
+	for (int attempt = 0; attempt < 3 && result == ERROR_BUFFER_OVERFLOW; attempt++) {
+		buffer.resize(size);
+		result = GetAdaptersAddresses(AF_INET, GAA_FLAG_SKIP_ANYCAST | GAA_FLAG_SKIP_MULTICAST | GAA_FLAG_SKIP_DNS_SERVER,
+			NULL, (IP_ADAPTER_ADDRESSES*)&buffer[0], &size);
+	}
+
+	if (result != NO_ERROR)
+		return ip;
+
+	for (IP_ADAPTER_ADDRESSES *adapter = (IP_ADAPTER_ADDRESSES*)&buffer[0]; adapter != NULL; adapter = adapter->Next) {
+		if (adapter->OperStatus != IfOperStatusUp || adapter->IfType == IF_TYPE_SOFTWARE_LOOPBACK)
+			continue;
+
+		for (IP_ADAPTER_UNICAST_ADDRESS *address = adapter->FirstUnicastAddress; address != NULL; address = address->Next)
+			ip.append(inet_ntoa(((sockaddr_in*)address->Address.lpSockaddr)->sin_addr)).append("\r\n");
+	}
+
+	return ip;
 }
 
 
 /**
 * \brief	checkForNewVersionInvoker
 *
-* starts a new thread that checks for a new version
+* checks for a new version on the work pool, or on a new thread if the pool is full
 */
 void checkForNewVersionInvoker() {
 	// check for new version
-	CreateThread(NULL, 0, checkForNewVersion, 0, 0, NULL);
+	if (!workpool.submit(checkForNewVersion, 0, WORK_PRIORITY_LOW)) {
+		HANDLE thread = CreateThread(NULL, 0, checkForNewVersion, 0, 0, NULL);
+
+		if (thread != NULL)
+			CloseHandle(thread);
+	}
 }
 
 /**
@@ -92,26 +253,43 @@ void checkForNewVersionInvoker() {
 * downloads version information and notifies user about new version if necessary
 */
 DWORD WINAPI checkForNewVersion(LPVOID parameter) {
-	// new WebClient
-	System::Net::WebClient^ wClient = gcnew System::Net::WebClient();
-	String^ strSource = gcnew String("");
+	ThreadPolicy policy(THREAD_CLASS_BACKGROUND);
+
+	HINTERNET internet = InternetOpenA(PLUGIN_NAME, INTERNET_OPEN_TYPE_PRECONFIG, NULL, NULL, 0);
+
+	if (internet == NULL)
+		return 0;
 
 	// download version info
+	HINTERNET url = InternetOpenUrlA(internet, "http://remotecontrol-for-winamp.googlecode.com/svn/trunk/gen_RemoteControl/gen_RemoteControl/version.h",
+		NULL, 0, INTERNET_FLAG_NO_CACHE_WRITE | INTERNET_FLAG_RELOAD, 0);
+
+	std::string source;
+
+	if (url != NULL) {
+		char buffer[1024];
+		DWORD read = 0;
+
+		while (InternetReadFile(url, buffer, sizeof(buffer), &read) && read > 0)
+			source.append(buffer, read);
+
+		InternetCloseHandle(url);
+	}
 
-	try {
+	InternetCloseHandle(internet);
 
-		strSource = wClient->DownloadString("http://remotecontrol-for-winamp.googlecode.com/svn/trunk/gen_RemoteControl/gen_RemoteControl/version.h");
-		
-		// check disabled status
-		if (strSource->EndsWith("DISABLED"))
-			return 0;
+	if (source.empty())
+		return 0;
 
-		// notify user if this version is not up to date
-		if (!strSource->EndsWith("\"" + PLUGIN_VERSION + "\""))
-			UIManager::newVersionFound();
+	std::string current = "\"" PLUGIN_VERSION "\"";
 
-	} catch (Exception^) {}
+	// check disabled status
+	if (source.length() >= 8 && source.compare(source.length() - 8, 8, "DISABLED") == 0)
+		return 0;
 
+	// notify user if this version is not up to date
+	if (source.length() < current.length() || source.compare(source.length() - current.length(), current.length(), current) != 0)
+		UIManager::newVersionFound();
 
 	return 0;
 }
\ No newline at end of file
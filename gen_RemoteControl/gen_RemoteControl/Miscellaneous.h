@@ -6,11 +6,17 @@ extern std::string const time();
 // Convert a wide Unicode string to an UTF8 string
 extern std::string const utf8_encode(const std::wstring &wstr);
 
+// appends a wide Unicode string UTF8 encoded to a string
+extern void utf8_append(std::string & target, const wchar_t *wstr, const unsigned int & length);
+
+// decodes base64 text
+extern int const base64_decode(const char *text, const unsigned int & length, unsigned char *target);
+
 // gets the extension of a file
 extern std::string const GetFileExtension(const std::string& FileName);
 
 // Gets IP addresses of the local computer
-extern System::String^ GetLocalIP();
+extern std::string const GetLocalIP();
 
 
 
@@ -0,0 +1,596 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	OutputChunk
+*
+* copy constructor, adds a reference to the shared data
+*
+* \param	other	chunk to copy
+*/
+OutputChunk::OutputChunk(const OutputChunk & other) : data(other.data), shared(other.shared), sharedOffset(other.sharedOffset), sharedLength(other.sharedLength), bulk(other.bulk), stream(other.stream), cover(other.cover) {
+	if (shared != NULL)
+		shared->addRef();
+}
+
+/**
+* \brief	~OutputChunk
+*
+* destructor, releases the shared data
+*/
+OutputChunk::~OutputChunk() {
+	if (shared != NULL)
+		shared->release();
+}
+
+/**
+* \brief	operator=
+*
+* copies a chunk, the shared data is referenced and not copied
+*
+* \param	other	chunk to copy
+*
+* \return	this chunk
+*/
+OutputChunk & OutputChunk::operator=(const OutputChunk & other) {
+	if (this != &other) {
+		data = other.data;
+		setShared(other.shared, other.sharedOffset, other.sharedLength);
+		bulk = other.bulk;
+		stream = other.stream;
+		cover = other.cover;
+	}
+
+	return *this;
+}
+
+/**
+* \brief	setShared
+*
+* sets the range of shared data sent after the own bytes of the chunk
+*
+* \param	shared	shared data or NULL
+* \param	offset	first byte of the range
+* \param	length	number of bytes
+*/
+void OutputChunk::setShared(SharedData *shared, const unsigned int & offset, const unsigned int & length) {
+	if (shared != NULL)
+		shared->addRef();
+
+	if (this->shared != NULL)
+		this->shared->release();
+
+	this->shared = shared;
+	sharedOffset = offset;
+	sharedLength = length;
+}
+
+/**
+* \brief	swap
+*
+* exchanges the contents of two chunks without copying the data
+*
+* \param	other	chunk to exchange with
+*/
+void OutputChunk::swap(OutputChunk & other) {
+	data.swap(other.data);
+	std::swap(shared, other.shared);
+	std::swap(sharedOffset, other.sharedOffset);
+	std::swap(sharedLength, other.sharedLength);
+	std::swap(bulk, other.bulk);
+	std::swap(stream, other.stream);
+	std::swap(cover, other.cover);
+}
+
+
+/**
+* \brief	OutputBuffer
+*
+* constructor
+*/
+OutputBuffer::OutputBuffer() {
+	nextStream = 1;
+}
+
+/**
+* \brief	reserve
+*
+* returns the chunk the next length bytes are appended to. starts a new chunk if they don't fit into the current one
+*
+* \param	target	chunks to append to
+* \param	length	number of bytes that will be appended
+* \param	bulk	kind of the chunk
+*
+* \return	chunk to append to
+*/
+OutputChunk & OutputBuffer::reserve(std::vector<OutputChunk> & target, const unsigned int & length, const bool & bulk) {
+	if (target.empty() || target.back().bulk != bulk || target.back().shared != NULL || (target.back().data.length() + length > OUTPUT_CHUNK_SIZE && !target.back().data.empty())) {
+		target.push_back(OutputChunk());
+		target.back().bulk = bulk;
+		target.back().data.reserve(length > OUTPUT_CHUNK_SIZE ? length : OUTPUT_CHUNK_SIZE);
+	}
+
+	return target.back();
+}
+
+/**
+* \brief	append
+*
+* appends raw binary data. the data is referenced by the sessions and not copied
+*
+* \param	data	data to append
+*/
+void OutputBuffer::append(SharedData *data) {
+	if (data == NULL || data->bytes.isEmpty())
+		return;
+
+	chunks.push_back(OutputChunk());
+	chunks.back().setShared(data, 0, data->bytes.size());
+
+	OutputMessage message = { chunks.size() - 1, 0, data->bytes.size(), true };
+	messages.push_back(message);
+}
+
+/**
+* \brief	appendLine
+*
+* appends a string and adds \n
+*
+* \param	line	null terminated string
+*/
+void OutputBuffer::appendLine(const char *line) {
+	unsigned int length = strlen(line);
+
+	OutputChunk & chunk = reserve(chunks, length + 1, false);
+
+	OutputMessage message = { chunks.size() - 1, chunk.data.length(), length, false };
+	messages.push_back(message);
+
+	chunk.data.append(line, length);
+	chunk.data.push_back('\n');
+}
+
+/**
+* \brief	appendLine
+*
+* encodes a wide unicode string to UTF8 directly into the buffer and adds \n. the size is counted first so the
+* line fits the chunk exactly, the count of the ASCII runs of a title is cheap
+*
+* \param	line	null terminated wide string
+*/
+void OutputBuffer::appendLine(const wchar_t *line) {
+	int wideLength = wcslen(line);
+	int length = TagLib::String::encodeUTF8(line, wideLength, NULL, 0);
+
+	OutputChunk & chunk = reserve(chunks, length + 1, false);
+
+	unsigned int offset = chunk.data.length();
+
+	OutputMessage message = { chunks.size() - 1, offset, length, false };
+	messages.push_back(message);
+
+	chunk.data.resize(offset + length);
+
+	if (length > 0)
+		TagLib::String::encodeUTF8(line, wideLength, &chunk.data[offset], length);
+
+	chunk.data.push_back('\n');
+}
+
+/**
+* \brief	appendLines
+*
+* appends lines that are already encoded in shared data, each terminated by \n. the text encoding references the
+* data and doesn't copy it, the framed and WebSocket encodings copy the lines into their frames
+*
+* \param	data	encoded lines
+* \param	offsets	offset of the first line and of every line behind it, count + 1 offsets
+* \param	count	number of lines
+*/
+void OutputBuffer::appendLines(SharedData *data, const unsigned int *offsets, const unsigned int & count) {
+	if (data == NULL || count == 0)
+		return;
+
+	chunks.push_back(OutputChunk());
+	chunks.back().setShared(data, offsets[0], offsets[count] - offsets[0]);
+
+	for (unsigned int i = 0; i < count; i++) {
+		OutputMessage message = { chunks.size() - 1, offsets[i] - offsets[0], offsets[i + 1] - offsets[i] - 1, false };
+		messages.push_back(message);
+	}
+}
+
+/**
+* \brief	lineData
+*
+* \param	message	text message
+*
+* \return	first byte of the line, in the own bytes or in the shared data of its chunk
+*/
+const char *OutputBuffer::lineData(const OutputMessage & message) const {
+	const OutputChunk & chunk = chunks[message.chunk];
+
+	return (chunk.shared != NULL ? chunk.sharedData() : chunk.data.data()) + message.offset;
+}
+
+/**
+* \brief	appendFrame
+*
+* appends one frame to a framed encoding
+*
+* \param	target	frames to append to
+* \param	type	FRAME_TEXT, FRAME_DEFLATE, FRAME_DATA or FRAME_DATA_END
+* \param	stream	stream id, 0 for text that doesn't announce data
+* \param	data	payload
+* \param	length	payload length
+* \param	bulk	true for data frames
+*/
+void OutputBuffer::appendFrame(std::vector<OutputChunk> & target, const unsigned char & type, const unsigned short & stream, const char *data, const unsigned int & length, const bool & bulk) {
+	std::string & frame = reserve(target, FRAME_HEADER_SIZE + length, bulk).data;
+
+	char header[FRAME_HEADER_SIZE];
+	header[0] = (char)type;
+	header[1] = (char)((stream >> 8) & 0xFF);
+	header[2] = (char)(stream & 0xFF);
+	header[3] = (char)((length >> 24) & 0xFF);
+	header[4] = (char)((length >> 16) & 0xFF);
+	header[5] = (char)((length >> 8) & 0xFF);
+	header[6] = (char)(length & 0xFF);
+
+	frame.append(header, FRAME_HEADER_SIZE);
+	frame.append(data, length);
+}
+
+/**
+* \brief	appendDataFrame
+*
+* appends one data frame to a framed encoding. only the header is copied, the payload references the shared data
+*
+* \param	target	frames to append to
+* \param	type	FRAME_DATA or FRAME_DATA_END
+* \param	stream	stream id
+* \param	shared	payload storage
+* \param	offset	first payload byte in the shared data
+* \param	length	payload length
+* \param	cover	true for the cover of the current song
+*/
+void OutputBuffer::appendDataFrame(std::vector<OutputChunk> & target, const unsigned char & type, const unsigned short & stream, SharedData *shared, const unsigned int & offset, const unsigned int & length, const bool & cover) {
+	target.push_back(OutputChunk());
+	target.back().bulk = true;
+	target.back().stream = stream;
+	target.back().cover = cover;
+
+	std::string & frame = target.back().data;
+
+	frame.resize(FRAME_HEADER_SIZE);
+	frame[0] = (char)type;
+	frame[1] = (char)((stream >> 8) & 0xFF);
+	frame[2] = (char)(stream & 0xFF);
+	frame[3] = (char)((length >> 24) & 0xFF);
+	frame[4] = (char)((length >> 16) & 0xFF);
+	frame[5] = (char)((length >> 8) & 0xFF);
+	frame[6] = (char)(length & 0xFF);
+
+	target.back().setShared(shared, offset, length);
+}
+
+// preset dictionary of the deflate frames: message prefixes and words that are common in titles and tags, the most
+// frequent last. the client has the same bytes
+static const char deflateDictionary[] =
+	"Remastered Version" "Live Version" "Radio Edit" "Extended Mix" "Original Mix" "Remix" "Acoustic" "Soundtrack"
+	"Classical" "Electronic" "Hip-Hop" "Alternative" "Country" "Metal" "Jazz" "Blues" "Pop" "Rock" "Dance" "Other"
+	"Unknown Artist" "Various Artists" "Unknown" "Album" "Disc 1" "Part " "Love" "You" "Your" "Night" "Life"
+	"World" "Don't" "Live" "Intro" "Time" "feat. " "(feat. " " & " " and " " of " " in " " the " "The " " - "
+	".flac" ".ogg" ".m4a" ".mp3" "track_comment_" "track_genre_" "track_length_" "track_bitrate_"
+	"track_samplerate_" "track_track_" "track_year_" "track_album_" "track_artist_" "track_title_" "queueMove_"
+	"queueRemove_" "queueInsert_" "queueRefresh_" "playlist_move_" "playlist_delete_" "playlist_insert_"
+	"playlist_range_" "isplaying_" "playlistPosition_" "samplerate_" "bitrate_" "length_" "title_";
+
+/**
+* \brief	appendLines
+*
+* appends a run of text lines that announce no stream. runs of at least DEFLATE_MIN_BYTES are compressed into one
+* deflate frame, every session with the deflate protocol gets the same frame
+*
+* \param	target	frames to append to
+* \param	first	index of the first message of the run
+* \param	end		index behind the last message of the run
+*/
+void OutputBuffer::appendLines(std::vector<OutputChunk> & target, const unsigned int & first, const unsigned int & end) {
+	std::string text;
+
+	for (unsigned int i = first; i < end; i++) {
+		if (messages[i].binary)
+			continue;
+
+		text.append(lineData(messages[i]), messages[i].length);
+		text.push_back('\n');
+	}
+
+	if (text.length() >= DEFLATE_MIN_BYTES) {
+		z_stream z;
+		memset(&z, 0, sizeof(z));
+
+		if (deflateInit(&z, DEFLATE_LEVEL) == Z_OK) {
+			std::string compressed;
+			compressed.resize(deflateBound(&z, text.length()));
+
+			z.next_in = (Bytef*)text.data();
+			z.avail_in = text.length();
+			z.next_out = (Bytef*)&compressed[0];
+			z.avail_out = compressed.length();
+
+			bool done = deflateSetDictionary(&z, (const Bytef*)deflateDictionary, sizeof(deflateDictionary) - 1) == Z_OK
+				&& deflate(&z, Z_FINISH) == Z_STREAM_END;
+
+			unsigned int length = z.total_out;
+			deflateEnd(&z);
+
+			if (done && length < text.length()) {
+				appendFrame(target, FRAME_DEFLATE, 0, compressed.data(), length, false);
+
+				Metrics::add(metrics.deflateBytes, text.length());
+				Metrics::add(metrics.deflatedBytes, length);
+
+				return;
+			}
+		}
+	}
+
+	for (unsigned int i = first; i < end; i++) {
+		if (!messages[i].binary)
+			appendFrame(target, FRAME_TEXT, 0, lineData(messages[i]), messages[i].length, false);
+	}
+}
+
+/**
+* \brief	encodeFrames
+*
+* builds a framed encoding. a line directly followed by binary data (coverLength_) announces a stream,
+* the data is split into bulk data frames of this stream so later control frames can overtake it. the frames reference the binary data, it is not copied.
+* the binary data is never compressed, covers are JPEG or PNG already
+*
+* \param	target	receives the frames
+* \param	deflate	compress the runs of other text lines, see appendLines
+*/
+void OutputBuffer::encodeFrames(std::vector<OutputChunk> & target, const bool & deflate) {
+	target.clear();
+
+	// first message of the current run of plain lines
+	unsigned int run = 0;
+
+	for (unsigned int i = 0; i < messages.size(); i++) {
+		const OutputMessage & message = messages[i];
+
+		if (message.binary)	// not announced, can't be assigned by the client
+			continue;
+
+		const char *data = lineData(message);
+
+		unsigned short stream = 0;
+
+		if (i + 1 < messages.size() && messages[i + 1].binary) {
+			stream = nextStream++;
+
+			if (nextStream == 0)
+				nextStream = 1;
+		}
+
+		if (deflate) {
+			// collected until a stream or the end interrupts the run
+			if (stream == 0)
+				continue;
+
+			appendLines(target, run, i);
+		}
+
+		appendFrame(target, FRAME_TEXT, stream, data, message.length, false);
+
+		if (stream != 0) {
+			const OutputMessage & binary = messages[++i];
+			const OutputChunk & bytes = chunks[binary.chunk];
+
+			// a track cover or thumbnail has a prefix, only the cover of the song is superseded by the next one
+			bool cover = message.length > 12 && strncmp(data, "coverLength_", 12) == 0;
+
+			for (unsigned int sent = 0; sent < binary.length; sent += FRAME_DATA_SIZE) {
+				unsigned int size = binary.length - sent > FRAME_DATA_SIZE ? FRAME_DATA_SIZE : binary.length - sent;
+
+				appendDataFrame(target, sent + size == binary.length ? FRAME_DATA_END : FRAME_DATA, stream, bytes.shared, bytes.sharedOffset + sent, size, cover);
+			}
+		}
+
+		run = i + 1;
+	}
+
+	if (deflate)
+		appendLines(target, run, messages.size());
+}
+
+/**
+* \brief	encodeWebSocket
+*
+* builds the WebSocket encoding: a text message for every line, a binary message for the binary data. the binary
+* messages reference the data like the data frames
+*
+* \param	target	receives the messages
+*/
+void OutputBuffer::encodeWebSocket(std::vector<OutputChunk> & target) {
+	target.clear();
+
+	for (unsigned int i = 0; i < messages.size(); i++) {
+		const OutputMessage & message = messages[i];
+		const OutputChunk & chunk = chunks[message.chunk];
+
+		if (message.binary) {
+			target.push_back(OutputChunk());
+			target.back().bulk = true;
+
+			WebChannel::appendFrameHeader(target.back().data, WEB_OPCODE_BINARY, message.length);
+			target.back().setShared(chunk.shared, chunk.sharedOffset, message.length);
+		} else {
+			std::string & frame = reserve(target, message.length + 10, false).data;
+
+			WebChannel::appendFrameHeader(frame, WEB_OPCODE_TEXT, message.length);
+			frame.append(lineData(message), message.length);
+		}
+	}
+}
+
+/**
+* \brief	encoded
+*
+* returns the buffer in the encoding of a protocol. the framed and WebSocket encodings are built on first use and
+* shared by every session of the protocol
+*
+* \param	protocol	PROTOCOL_TEXT, PROTOCOL_FRAMED, PROTOCOL_DEFLATE, PROTOCOL_WEBSOCKET or PROTOCOL_HTTP
+*
+* \return	encoded chunks, none for PROTOCOL_HTTP
+*/
+std::vector<OutputChunk> & OutputBuffer::encoded(const LONG & protocol) {
+	static std::vector<OutputChunk> none;
+
+	if (protocol == PROTOCOL_FRAMED) {
+		if (frames.empty())
+			encodeFrames(frames, false);
+
+		return frames;
+	}
+
+	if (protocol == PROTOCOL_DEFLATE) {
+		if (deflated.empty())
+			encodeFrames(deflated, true);
+
+		return deflated;
+	}
+
+	if (protocol == PROTOCOL_WEBSOCKET) {
+		if (websocket.empty())
+			encodeWebSocket(websocket);
+
+		return websocket;
+	}
+
+	if (protocol == PROTOCOL_HTTP) {
+		none.clear();
+
+		return none;
+	}
+
+	return chunks;
+}
+
+/**
+* \brief	share
+*
+* moves the own bytes of the chunks of an encoding into shared data
+*
+* \param	target	encoded chunks
+*/
+void OutputBuffer::share(std::vector<OutputChunk> & target) {
+	for (std::vector<OutputChunk>::iterator it = target.begin(); it != target.end(); it++) {
+		if (it->shared != NULL || it->data.empty())
+			continue;
+
+		SharedData *data = new SharedData(it->data);
+
+		it->setShared(data, 0, it->data.length());
+		data->release();
+
+		std::string().swap(it->data);
+	}
+}
+
+/**
+* \brief	share
+*
+* moves the own bytes of every encoding into reference counted data, so a broadcast is copied once and every session
+* only queues references. the frames are encoded from the text chunks, so only call after every encoding that is sent
+* has been built. the lines can't be read anymore
+*/
+void OutputBuffer::share() {
+	share(chunks);
+	share(frames);
+	share(deflated);
+	share(websocket);
+}
+
+/**
+* \brief	flush
+*
+* hands all chunks to the session(s) and empties the buffer. never blocks.
+*
+* \param	session	session id, ALL_SESSIONS for a broadcast
+* \param	topic	TOPIC_ flag of a broadcast, 0 for every session
+* \param	state	state event of a broadcast, see SessionList::send
+*
+* \return	1 if error, 0 if success
+*/
+int const OutputBuffer::flush(const int & session, const int & topic, const Task *state) {
+	if (messages.empty())
+		return 0;
+
+	capture.recordOutput(session, *this);
+
+	int result = sessionlist.send(session, *this, topic, state);
+
+	clear();
+
+	return result;
+}
+
+/**
+* \brief	clear
+*
+* drops all data that has not been flushed
+*/
+void OutputBuffer::clear() {
+	chunks.clear();
+	messages.clear();
+	frames.clear();
+	deflated.clear();
+	websocket.clear();
+}
+
+/**
+* \brief	getLines
+*
+* copies the lines that have not been flushed, without \n
+*
+* \param	lines	receives the lines
+*
+* \return	false if binary data has been appended, that isn't copied
+*/
+bool const OutputBuffer::getLines(std::vector<std::string> & lines) const {
+	bool text = true;
+
+	for (unsigned int i = 0; i < messages.size(); i++) {
+		const OutputMessage & message = messages[i];
+
+		if (message.binary)
+			text = false;
+		else
+			lines.push_back(std::string(lineData(message), message.length));
+	}
+
+	return text;
+}
+
+/**
+* \brief	appendAbortFrame
+*
+* appends the frame that ends a stream whose remaining data frames have been dropped
+*
+* \param	target	frames to append to
+* \param	stream	stream id
+*/
+void OutputBuffer::appendAbortFrame(std::vector<OutputChunk> & target, const unsigned short & stream) {
+	target.push_back(OutputChunk());
+
+	std::string & frame = target.back().data;
+
+	frame.resize(FRAME_HEADER_SIZE, '\0');
+	frame[0] = (char)FRAME_DATA_ABORT;
+	frame[1] = (char)((stream >> 8) & 0xFF);
+	frame[2] = (char)(stream & 0xFF);
+}
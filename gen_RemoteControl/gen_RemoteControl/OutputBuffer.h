@@ -0,0 +1,137 @@
+#pragma once
+#include "stdafx.h"
+
+// size of one chunk of the output buffer
+#define OUTPUT_CHUNK_SIZE 65536
+
+// frame types of the framed protocol
+#define FRAME_TEXT 1
+#define FRAME_DATA 2
+#define FRAME_DATA_END 3
+
+// zlib stream with the dictionary of OutputBuffer::encodeFrames, inflates to text lines terminated by \n
+#define FRAME_DEFLATE 4
+
+// empty frame that ends a stream whose data frames have been dropped, the client discards what it has received of it
+#define FRAME_DATA_ABORT 5
+
+// frame header: type (1 byte), stream id (2 bytes), payload length (4 bytes), big endian
+#define FRAME_HEADER_SIZE 7
+
+// maximum payload of one data frame
+#define FRAME_DATA_SIZE 16384
+
+// text of consecutive lines below which the lines are sent as text frames, shorter ones compress badly
+#define DEFLATE_MIN_BYTES 256
+
+// zlib compression level of the deflate frames
+#define DEFLATE_LEVEL 6
+
+
+// reference counted binary data (covers, encoded broadcasts) that is sent without copying it into the chunks.
+// keeps the TagLib storage alive until every session has sent it. TagLib doesn't count its references thread safe,
+// so no other copy of the vector may exist once the data is handed to a session. it may be an open file instead
+class SharedData {
+	private:
+		volatile LONG references;
+
+		~SharedData() { if (file != INVALID_HANDLE_VALUE) CloseHandle(file); }
+
+	public:
+		SharedData(const TagLib::ByteVector & bytes) : references(1), bytes(bytes), file(INVALID_HANDLE_VALUE), fileLength(0) {}
+		SharedData(const std::string & text) : references(1), bytes(text.data(), text.length()), file(INVALID_HANDLE_VALUE), fileLength(0) {}
+		SharedData(HANDLE file, const unsigned int & length) : references(1), file(file), fileLength(length) {}
+
+		const TagLib::ByteVector bytes;
+
+		// file sent with TransmitFile, closed with the last reference. INVALID_HANDLE_VALUE for the bytes in memory.
+		// only handed to sessions without TLS and Registered I/O, see CoverStore::openFile
+		const HANDLE file;
+		const unsigned int fileLength;
+
+		void addRef() { InterlockedIncrement(&references); }
+		void release() { if (InterlockedDecrement(&references) == 0) delete this; }
+};
+
+// encoded data handed to the sessions: own bytes followed by an optional range of shared data
+struct OutputChunk {
+	OutputChunk() : shared(NULL), sharedOffset(0), sharedLength(0), bulk(false), stream(0), cover(false) {}
+	OutputChunk(const OutputChunk & other);
+
+	~OutputChunk();
+
+	OutputChunk & operator=(const OutputChunk & other);
+
+	void setShared(SharedData *shared, const unsigned int & offset, const unsigned int & length);
+	const char *sharedData() const { return shared->bytes.data() + sharedOffset; }
+	unsigned int const length() const { return data.length() + sharedLength; }
+	void swap(OutputChunk & other);
+
+	std::string data;
+
+	SharedData *shared;
+	unsigned int sharedOffset;
+	unsigned int sharedLength;
+
+	// bulk chunks may be overtaken by control chunks queued later
+	bool bulk;
+
+	// stream of a data frame, 0 for other chunks. the frames of the cover of the current song may be dropped until
+	// they are sent, see Session::abortCovers
+	unsigned short stream;
+	bool cover;
+};
+
+// position of one message in the text encoding
+struct OutputMessage {
+	unsigned int chunk;
+	unsigned int offset;
+	unsigned int length;
+	bool binary;
+};
+
+
+struct Task;
+
+class OutputBuffer {
+	private:
+		// text encoding: lines terminated by \n, binary data raw
+		std::vector<OutputChunk> chunks;
+		std::vector<OutputMessage> messages;
+
+		// framed encodings, built from the messages when a framed session needs them. the deflated one compresses
+		// the runs of text lines
+		std::vector<OutputChunk> frames;
+		std::vector<OutputChunk> deflated;
+
+		// WebSocket encoding, one message per line and binary data
+		std::vector<OutputChunk> websocket;
+		unsigned short nextStream;
+
+		OutputChunk & reserve(std::vector<OutputChunk> & target, const unsigned int & length, const bool & bulk);
+		void appendFrame(std::vector<OutputChunk> & target, const unsigned char & type, const unsigned short & stream, const char *data, const unsigned int & length, const bool & bulk);
+		void appendDataFrame(std::vector<OutputChunk> & target, const unsigned char & type, const unsigned short & stream, SharedData *shared, const unsigned int & offset, const unsigned int & length, const bool & cover);
+		void appendLines(std::vector<OutputChunk> & target, const unsigned int & first, const unsigned int & end);
+		void encodeFrames(std::vector<OutputChunk> & target, const bool & deflate);
+		void encodeWebSocket(std::vector<OutputChunk> & target);
+		void share(std::vector<OutputChunk> & target);
+		const char *lineData(const OutputMessage & message) const;
+
+	public:
+		OutputBuffer();
+
+		void append(SharedData *data);
+		void appendLine(const char *line);
+		void appendLine(const wchar_t *line);
+		void appendLines(SharedData *data, const unsigned int *offsets, const unsigned int & count);
+
+		std::vector<OutputChunk> & encoded(const LONG & protocol);
+		void share();
+
+		int const flush(const int & session, const int & topic = 0, const Task *state = NULL);
+		void clear();
+
+		bool const getLines(std::vector<std::string> & lines) const;
+
+		static void appendAbortFrame(std::vector<OutputChunk> & target, const unsigned short & stream);
+};
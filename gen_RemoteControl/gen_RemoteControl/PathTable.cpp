@@ -0,0 +1,253 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	PathTable
+*
+* constructor, the table holds the empty path
+*/
+PathTable::PathTable() {
+	for (int i = 0; i < PATH_TABLE_PAGES; i++)
+		pages[i] = NULL;
+
+	pages[0] = new PathNode[PATH_TABLE_PAGE];
+	pages[0][PATH_TABLE_ROOT].parent = PATH_TABLE_ROOT;
+	pages[0][PATH_TABLE_ROOT].name = STRING_POOL_EMPTY;
+	count = 1;
+
+	table.resize(1024, 0);
+
+	MemoryTag::add(MEMORY_METADATA, PATH_TABLE_PAGE * sizeof(PathNode) + table.size() * sizeof(unsigned int));
+
+	internedBytes = 0;
+
+	InitializeCriticalSection(&cs_paths);
+}
+
+/**
+* \brief	~PathTable
+*
+* destructor
+*/
+PathTable::~PathTable() {
+	for (int i = 0; i < PATH_TABLE_PAGES; i++)
+		delete[] pages[i];
+
+	DeleteCriticalSection(&cs_paths);
+}
+
+/**
+* \brief	hash
+*
+* \param	parent	id of the directory
+* \param	name	id of the name in stringpool
+*
+* \return	hash of the pair
+*/
+unsigned int const PathTable::hash(const unsigned int & parent, const unsigned int & name) {
+	unsigned int h = parent * 2654435761U ^ name;
+
+	h ^= h >> 15;
+	h *= 2246822519U;
+	h ^= h >> 13;
+
+	return h;
+}
+
+/**
+* \brief	node
+*
+* \param	id	id returned by intern
+*
+* \return	directory and name of the id
+*/
+const PathNode & PathTable::node(const unsigned int & id) const {
+	return pages[id / PATH_TABLE_PAGE][id % PATH_TABLE_PAGE];
+}
+
+/**
+* \brief	child
+*
+* returns the id of a name in a directory, the node is added if it is new. must be called inside cs_paths
+*
+* \param	parent	id of the directory
+* \param	name	id of the name in stringpool
+*
+* \return	id, PATH_TABLE_ROOT if the table is full
+*/
+unsigned int const PathTable::child(const unsigned int & parent, const unsigned int & name) {
+	unsigned int mask = table.size() - 1;
+	unsigned int slot = hash(parent, name) & mask;
+
+	while (table[slot] != 0) {
+		const PathNode & candidate = node(table[slot]);
+
+		if (candidate.parent == parent && candidate.name == name)
+			return table[slot];
+
+		slot = (slot + 1) & mask;
+	}
+
+	if ((unsigned int)count >= PATH_TABLE_PAGE * PATH_TABLE_PAGES)
+		return PATH_TABLE_ROOT;
+
+	unsigned int id = count;
+
+	PathNode *&page = pages[id / PATH_TABLE_PAGE];
+
+	if (page == NULL) {
+		page = new PathNode[PATH_TABLE_PAGE];
+		MemoryTag::add(MEMORY_METADATA, PATH_TABLE_PAGE * sizeof(PathNode));
+	}
+
+	page[id % PATH_TABLE_PAGE].parent = parent;
+	page[id % PATH_TABLE_PAGE].name = name;
+	table[slot] = id;
+
+	// the id is handed out after the lock is left, so every reader finds its page
+	InterlockedIncrement(&count);
+
+	// at most half of the slots are used
+	if ((unsigned int)count * 2 > table.size())
+		grow();
+
+	return id;
+}
+
+/**
+* \brief	grow
+*
+* doubles the hash table. must be called inside cs_paths
+*/
+void PathTable::grow() {
+	std::vector<unsigned int> larger(table.size() * 2, 0);
+	unsigned int mask = larger.size() - 1;
+
+	for (unsigned int i = 0; i < table.size(); i++) {
+		unsigned int id = table[i];
+
+		if (id == 0)
+			continue;
+
+		unsigned int slot = hash(node(id).parent, node(id).name) & mask;
+
+		while (larger[slot] != 0)
+			slot = (slot + 1) & mask;
+
+		larger[slot] = id;
+	}
+
+	MemoryTag::add(MEMORY_METADATA, (larger.size() - table.size()) * sizeof(unsigned int));
+
+	table.swap(larger);
+}
+
+/**
+* \brief	intern
+*
+* returns the id of a path, the directories and the file that are new are added. the components are split at the
+* backslashes, empty ones of a share or a trailing backslash are kept
+*
+* \param	path	characters
+* \param	length	number of characters
+*
+* \return	id, PATH_TABLE_ROOT for an empty path or if the table is full
+*/
+unsigned int const PathTable::intern(const char *path, const unsigned int & length) {
+	if (length == 0)
+		return PATH_TABLE_ROOT;
+
+	Metrics::add(internedBytes, length + 1);
+
+	unsigned int id = PATH_TABLE_ROOT;
+	unsigned int start = 0;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_paths);
+
+	while (true) {
+		unsigned int end = start;
+
+		while (end < length && path[end] != '\\')
+			end++;
+
+		id = child(id, stringpool.intern(path + start, end - start));
+
+		if (id == PATH_TABLE_ROOT || end >= length)
+			break;
+
+		start = end + 1;
+	}
+
+	LeaveCriticalSection(&cs_paths);
+	// CRITICAL END
+
+	return id;
+}
+
+/**
+* \brief	intern
+*
+* \param	path	path
+*
+* \return	id of the path, see intern above
+*/
+unsigned int const PathTable::intern(const std::string & path) {
+	return intern(path.data(), path.length());
+}
+
+/**
+* \brief	parent
+*
+* \param	id	id returned by intern
+*
+* \return	id of the directory of the path, PATH_TABLE_ROOT for a drive or a share
+*/
+unsigned int const PathTable::parent(const unsigned int & id) const {
+	return node(id).parent;
+}
+
+/**
+* \brief	path
+*
+* joins the names from the root to a node
+*
+* \param	id	id returned by intern
+*
+* \return	the path as it was interned
+*/
+std::string const PathTable::path(const unsigned int & id) const {
+	std::vector<unsigned int> names;
+	unsigned int length = 0;
+
+	for (unsigned int n = id; n != PATH_TABLE_ROOT; n = node(n).parent) {
+		names.push_back(node(n).name);
+		length += stringpool.length(node(n).name) + 1;
+	}
+
+	std::string path;
+	path.reserve(length);
+
+	for (std::vector<unsigned int>::reverse_iterator it = names.rbegin(); it != names.rend(); it++) {
+		if (it != names.rbegin())
+			path.push_back('\\');
+
+		path.append(stringpool.value(*it), stringpool.length(*it));
+	}
+
+	return path;
+}
+
+/**
+* \brief	report
+*
+* adds the "path_table <nodes>" line of the stats
+*
+* \param	lines	vector that receives the line
+*/
+void PathTable::report(std::vector<std::string> & lines) {
+	stringstream line;
+	line << "path_table nodes " << count - 1 << " node_bytes " << (LONGLONG)(count - 1) * sizeof(PathNode) << " interned_bytes " << internedBytes;
+
+	lines.push_back(line.str());
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "stdafx.h"
+
+
+// nodes per page of the node table and number of pages
+#define PATH_TABLE_PAGE 16384
+#define PATH_TABLE_PAGES 4096
+
+// id of the empty path, the parent of the drives and shares. also returned if the table is full
+#define PATH_TABLE_ROOT 0
+
+
+// one directory or file: the directory it is in and its name in stringpool
+struct PathNode {
+	unsigned int parent;
+	unsigned int name;
+};
+
+
+// paths of the files of the playlist and the library. a directory is stored once as its parent directory and its
+// name, a prefix trie of the components between the backslashes, and a file as its directory and its name. the
+// caches keep the 32 bit id of a path instead of the string: equal ids mean equal paths, and the files of one
+// directory share its id. nodes never change or move, parent and path never block. paths are taken as they are,
+// the caller canonicalizes them if it has to
+class PathTable {
+	private:
+		// node of an id by page. pages are allocated once and kept
+		PathNode *pages[PATH_TABLE_PAGES];
+		volatile LONG count;
+
+		// open addressing table of the ids by parent and name, 0 marks a free slot since the root isn't in it
+		std::vector<unsigned int> table;
+
+		// bytes the interned paths would have taken as strings
+		volatile LONGLONG internedBytes;
+
+		// critical path table section
+		CRITICAL_SECTION cs_paths;
+
+		static unsigned int const hash(const unsigned int & parent, const unsigned int & name);
+
+		const PathNode & node(const unsigned int & id) const;
+		unsigned int const child(const unsigned int & parent, const unsigned int & name);
+		void grow();
+
+	public:
+		PathTable();
+
+		~PathTable();
+
+		unsigned int const intern(const char *path, const unsigned int & length);
+		unsigned int const intern(const std::string & path);
+
+		unsigned int const parent(const unsigned int & id) const;
+		std::string const path(const unsigned int & id) const;
+
+		void report(std::vector<std::string> & lines);
+};
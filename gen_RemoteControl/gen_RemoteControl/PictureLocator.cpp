@@ -0,0 +1,701 @@
+#include "stdafx.h"
+
+
+// GUIDs of the ASF objects that hold pictures, as they are stored in the file
+static const char asfHeaderGuid[] = "\x30\x26\xB2\x75\x8E\x66\xCF\x11\xA6\xD9\x00\xAA\x00\x62\xCE\x6C";
+static const char asfExtendedContentGuid[] = "\x40\xA4\xD0\xD2\x07\xE3\xD2\x11\x97\xF0\x00\xA0\xC9\x5E\xA8\x50";
+static const char asfHeaderExtensionGuid[] = "\xB5\x03\xBF\x5F\x2E\xA9\xCF\x11\x8E\xE3\x00\xC0\x0C\x20\x53\x65";
+static const char asfMetadataLibraryGuid[] = "\x94\x1C\x23\x44\x98\x94\xD1\x49\xA1\x41\x1D\x13\x4E\x45\x70\x54";
+
+// name of the ASF picture attribute in UTF-16
+static const char asfPictureName[] = "W\0M\0/\0P\0i\0c\0t\0u\0r\0e\0";
+
+
+/**
+* \brief	isGuid
+*
+* \param	data	bytes starting with a GUID
+* \param	guid	16 bytes of a GUID
+*
+* \return	true if data starts with guid
+*/
+static bool const isGuid(const TagLib::ByteVector & data, const char *guid) {
+	return data.size() >= 16 && memcmp(data.data(), guid, 16) == 0;
+}
+
+/**
+* \brief	mimeTypeOf
+*
+* \param	name	file name of an APE cover item
+*
+* \return	MIME type by the extension of the name, image/jpeg if it has none that is known
+*/
+static std::string const mimeTypeOf(const std::string & name) {
+	std::string extension = GetFileExtension(name);
+	std::transform(extension.begin(), extension.end(), extension.begin(), tolower);
+
+	if (extension == "png")
+		return "image/png";
+	else if (extension == "gif")
+		return "image/gif";
+	else if (extension == "bmp")
+		return "image/bmp";
+
+	return "image/jpeg";
+}
+
+/**
+* \brief	skipText
+*
+* \param	head		start of an ID3v2 picture frame
+* \param	position	first byte of a null terminated text
+* \param	encoding	text encoding of the frame, UTF-16 texts end with two null bytes
+*
+* \return	first byte behind the terminator, std::string::npos if it isn't in head
+*/
+static size_t const skipText(const std::string & head, const size_t & position, const int & encoding) {
+	if (encoding == 1 || encoding == 2) {
+		for (size_t i = position; i + 1 < head.size(); i += 2) {
+			if (head[i] == 0 && head[i + 1] == 0)
+				return i + 2;
+		}
+
+		return std::string::npos;
+	}
+
+	size_t end = head.find('\0', position);
+
+	return end == std::string::npos ? end : end + 1;
+}
+
+
+/**
+* \brief	readAt
+*
+* \param	file		file
+* \param	position	first byte
+* \param	length		number of bytes
+*
+* \return	bytes, fewer at the end of the file
+*/
+TagLib::ByteVector const PictureLocator::readAt(TagLib::File & file, const long & position, const unsigned int & length) {
+	if (position < 0 || length == 0)
+		return TagLib::ByteVector();
+
+	file.seek(position);
+
+	return file.readBlock(length);
+}
+
+/**
+* \brief	add
+*
+* appends a location, empty pictures are left out
+*/
+void PictureLocator::add(std::vector<PictureLocation> & pictures, const long & offset, const unsigned int & length, const std::string & mimeType,
+	const int & type, const int & encoding) {
+	if (length == 0)
+		return;
+
+	PictureLocation location;
+	location.offset = offset;
+	location.length = length;
+	location.mimeType = mimeType;
+	location.type = type;
+	location.encoding = encoding;
+
+	pictures.push_back(location);
+}
+
+/**
+* \brief	locatePictures
+*
+* finds the embedded pictures of a file. reads the headers of the tags and a few bytes in front of every picture
+*
+* \param	file		opened file
+* \param	pictures	receives the pictures in the order of the file
+*
+* \return	false if the pictures of the format aren't known, the file hasn't been searched
+*/
+bool const PictureLocator::locatePictures(TagLib::File & file, std::vector<PictureLocation> & pictures) {
+	pictures.clear();
+
+	if (!file.isOpen())
+		return false;
+
+	bool known = true;
+	long position = file.tell();
+
+	if (dynamic_cast<TagLib::MPEG::File *>(&file) != NULL) {
+		locateID3v2(file, 0, pictures);
+		locateAPE(file, pictures);
+	} else if (dynamic_cast<TagLib::TrueAudio::File *>(&file) != NULL)
+		locateID3v2(file, 0, pictures);
+	else if (dynamic_cast<TagLib::FLAC::File *>(&file) != NULL)
+		locateFLAC(file, pictures);
+	else if (dynamic_cast<TagLib::MP4::File *>(&file) != NULL)
+		locateMP4(file, 0, file.length(), 0, pictures);
+	else if (dynamic_cast<TagLib::ASF::File *>(&file) != NULL) {
+		TagLib::ByteVector header = readAt(file, 0, 30);
+
+		if (header.size() == 30 && isGuid(header, asfHeaderGuid)) {
+			long long headerLength = header.mid(16, 8).toLongLong(false);
+
+			locateASF(file, 30, (long)min(headerLength, (long long)file.length()), pictures);
+		}
+	} else if (dynamic_cast<TagLib::APE::File *>(&file) != NULL || dynamic_cast<TagLib::MPC::File *>(&file) != NULL
+		|| dynamic_cast<TagLib::WavPack::File *>(&file) != NULL)
+		locateAPE(file, pictures);
+	else
+		known = false;
+
+	// the end of the file may have been read
+	file.clear();
+	file.seek(position);
+
+	return known;
+}
+
+/**
+* \brief	choose
+*
+* \param	pictures	located pictures
+*
+* \return	index of the front cover or else of the first picture, -1 if there is none
+*/
+int const PictureLocator::choose(const std::vector<PictureLocation> & pictures) {
+	for (unsigned int i = 0; i < pictures.size(); i++) {
+		if (pictures[i].type == PICTURE_TYPE_FRONT)
+			return i;
+	}
+
+	return pictures.empty() ? -1 : 0;
+}
+
+/**
+* \brief	read
+*
+* reads a located picture with one read call. unsynchronised pictures are restored
+*
+* \param	file		file the picture has been located in
+* \param	location	picture
+*
+* \return	picture, empty if the file has been shortened
+*/
+TagLib::ByteVector const PictureLocator::read(TagLib::File & file, const PictureLocation & location) {
+	TagLib::ByteVector picture = readAt(file, location.offset, location.length);
+
+	if (picture.size() != location.length)
+		return TagLib::ByteVector();
+
+	if (location.encoding == PICTURE_UNSYNCHRONIZED)
+		return TagLib::ID3v2::SynchData::decode(picture);
+
+	return picture;
+}
+
+/**
+* \brief	locateID3v2
+*
+* finds the APIC frames (PIC in version 2.2) of an ID3v2 tag. compressed and encrypted frames have no byte range of
+* the picture, neither have the frames of a tag before version 2.4 that is unsynchronised as a whole
+*
+* \param	file		file
+* \param	position	first byte of the tag
+* \param	pictures	receives the pictures
+*/
+void PictureLocator::locateID3v2(TagLib::File & file, const long & position, std::vector<PictureLocation> & pictures) {
+	TagLib::ByteVector header = readAt(file, position, 10);
+
+	if (header.size() < 10 || !header.startsWith("ID3"))
+		return;
+
+	int version = (unsigned char)header[3];
+	int flags = (unsigned char)header[5];
+
+	if (version < 2 || version > 4 || (version < 4 && (flags & 0x80) != 0))
+		return;
+
+	long end = position + 10 + TagLib::ID3v2::SynchData::toUInt(header.mid(6, 4));
+	long frame = position + 10;
+
+	if (version > 2 && (flags & 0x40) != 0) {
+		TagLib::ByteVector extended = readAt(file, frame, 4);
+
+		if (extended.size() < 4)
+			return;
+
+		// the size of version 2.4 includes itself
+		frame += version == 4 ? TagLib::ID3v2::SynchData::toUInt(extended) : 4 + extended.toUInt();
+	}
+
+	unsigned int headerLength = version == 2 ? 6 : 10;
+
+	while (frame + (long)headerLength < end) {
+		TagLib::ByteVector frameHeader = readAt(file, frame, headerLength);
+
+		// padding
+		if (frameHeader.size() < headerLength || frameHeader[0] == 0)
+			return;
+
+		unsigned int frameLength;
+
+		if (version == 2)
+			frameLength = frameHeader.toUInt(3, 3, true);
+		else if (version == 3)
+			frameLength = frameHeader.toUInt(4, true);
+		else
+			frameLength = TagLib::ID3v2::SynchData::toUInt(frameHeader.mid(4, 4));
+
+		long data = frame + headerLength;
+		frame = data + frameLength;
+
+		if (frame > end || frame < data)
+			return;
+
+		if (!frameHeader.startsWith(version == 2 ? "PIC" : "APIC"))
+			continue;
+
+		int formatFlags = version == 2 ? 0 : (unsigned char)frameHeader[9];
+		bool unsynchronized = false;
+
+		if (version == 3) {
+			if ((formatFlags & 0xC0) != 0)	// compression, encryption
+				continue;
+
+			if ((formatFlags & 0x20) != 0)	// group identifier
+				data++;
+		} else if (version == 4) {
+			if ((formatFlags & 0x0C) != 0)	// compression, encryption
+				continue;
+
+			if ((formatFlags & 0x40) != 0)	// group identifier
+				data++;
+			if ((formatFlags & 0x01) != 0)	// data length indicator
+				data += 4;
+
+			unsynchronized = (formatFlags & 0x02) != 0 || (flags & 0x80) != 0;
+		}
+
+		if (data >= frame)
+			continue;
+
+		TagLib::ByteVector raw = readAt(file, data, (unsigned int)min((long)PICTURE_HEAD_SIZE, frame - data));
+
+		// the resynchronised head and the position of each of its bytes in the file
+		std::string head;
+		std::vector<long> positions;
+
+		for (unsigned int i = 0; i < raw.size(); i++) {
+			if (unsynchronized && i > 0 && (unsigned char)raw[i - 1] == 0xFF && raw[i] == 0)
+				continue;
+
+			head.push_back(raw[i]);
+			positions.push_back(data + i);
+		}
+
+		if (head.size() < 5)
+			continue;
+
+		int encoding = (unsigned char)head[0];
+		std::string mimeType;
+		size_t p;
+
+		if (version == 2) {
+			// image format instead of a MIME type
+			std::string format = head.substr(1, 3);
+			std::transform(format.begin(), format.end(), format.begin(), tolower);
+
+			mimeType = format == "jpg" ? "image/jpeg" : "image/" + format;
+			p = 4;
+		} else {
+			p = skipText(head, 1, 0);
+
+			if (p == std::string::npos)
+				continue;
+
+			mimeType = head.substr(1, p - 2);
+		}
+
+		if (p >= head.size())
+			continue;
+
+		int type = (unsigned char)head[p];
+
+		// description
+		p = skipText(head, p + 1, encoding);
+
+		if (p == std::string::npos || p >= head.size())
+			continue;
+
+		add(pictures, positions[p], (unsigned int)(frame - positions[p]), mimeType, type, unsynchronized ? PICTURE_UNSYNCHRONIZED : PICTURE_RAW);
+	}
+}
+
+/**
+* \brief	locateFLAC
+*
+* finds the PICTURE blocks of the FLAC metadata
+*
+* \param	file		file
+* \param	pictures	receives the pictures
+*/
+void PictureLocator::locateFLAC(TagLib::File & file, std::vector<PictureLocation> & pictures) {
+	// an ID3v2 tag may come first
+	long position = file.find("fLaC");
+
+	if (position < 0)
+		return;
+
+	position += 4;
+
+	long end = file.length();
+	bool last = false;
+
+	while (!last && position + 4 <= end) {
+		TagLib::ByteVector header = readAt(file, position, 4);
+
+		if (header.size() < 4)
+			return;
+
+		last = (header[0] & 0x80) != 0;
+
+		int blockType = header[0] & 0x7F;
+		unsigned int blockLength = header.toUInt(1, 3, true);
+
+		long data = position + 4;
+		position = data + blockLength;
+
+		if (position > end)
+			return;
+
+		if (blockType != 6)	// PICTURE
+			continue;
+
+		// type, MIME type, description, width, height, depth, colors and length of the data before it
+		TagLib::ByteVector head = readAt(file, data, min((unsigned int)PICTURE_HEAD_SIZE, blockLength));
+
+		if (head.size() < 32)
+			continue;
+
+		int type = head.toUInt(0, true);
+		unsigned int mimeLength = head.toUInt(4, true);
+
+		if (mimeLength > head.size() - 32)
+			continue;
+
+		std::string mimeType(head.data() + 8, mimeLength);
+
+		unsigned int descriptionLength = head.toUInt(8 + mimeLength, true);
+
+		if (descriptionLength > head.size() - 32 - mimeLength)
+			continue;
+
+		unsigned int p = 12 + mimeLength + descriptionLength + 16;
+		unsigned int length = head.toUInt(p, true);
+		p += 4;
+
+		if (length <= blockLength - p)
+			add(pictures, data + p, length, mimeType, type, PICTURE_RAW);
+	}
+}
+
+/**
+* \brief	locateMP4
+*
+* finds the data atoms of the covr atom in moov.udta.meta.ilst
+*
+* \param	file		file
+* \param	begin		first atom
+* \param	end			end of the parent atom
+* \param	depth		number of parents
+* \param	pictures	receives the pictures
+*/
+void PictureLocator::locateMP4(TagLib::File & file, const long & begin, const long & end, const int & depth, std::vector<PictureLocation> & pictures) {
+	static const char *path[] = { "moov", "udta", "meta", "ilst", "covr" };
+
+	long position = begin;
+
+	while (position + 8 <= end) {
+		TagLib::ByteVector header = readAt(file, position, 16);
+
+		if (header.size() < 8)
+			return;
+
+		long long atomLength = header.toUInt(0, true);
+		unsigned int headerLength = 8;
+
+		if (atomLength == 1) {
+			if (header.size() < 16)
+				return;
+
+			atomLength = header.mid(8, 8).toLongLong();
+			headerLength = 16;
+		} else if (atomLength == 0)	// up to the end of the file
+			atomLength = end - position;
+
+		if (atomLength < headerLength || atomLength > end - position)
+			return;
+
+		TagLib::ByteVector name = header.mid(4, 4);
+		long next = position + (long)atomLength;
+
+		if (depth < 5 && name == path[depth]) {
+			// meta has version and flags before its children
+			locateMP4(file, position + headerLength + (depth == 2 ? 4 : 0), next, depth + 1, pictures);
+		} else if (depth == 5 && name == "data" && headerLength == 8 && atomLength >= 16) {
+			// version, flags with the type of the data and locale before it
+			unsigned int flags = header.toUInt(8, true) & 0xFFFFFF;
+
+			std::string mimeType = flags == 14 ? "image/png" : (flags == 12 ? "image/gif" : (flags == 27 ? "image/bmp" : "image/jpeg"));
+
+			add(pictures, position + 16, (unsigned int)(atomLength - 16), mimeType, PICTURE_TYPE_FRONT, PICTURE_RAW);
+		}
+
+		position = next;
+	}
+}
+
+/**
+* \brief	locateASF
+*
+* finds the WM/Picture attributes in the objects of the ASF header. the extended content description holds pictures
+* up to 64 KB, larger ones are in the metadata library of the header extension
+*
+* \param	file		file
+* \param	begin		first object
+* \param	end			end of the parent object
+* \param	pictures	receives the pictures
+*/
+void PictureLocator::locateASF(TagLib::File & file, const long & begin, const long & end, std::vector<PictureLocation> & pictures) {
+	long position = begin;
+
+	while (position + 24 <= end) {
+		TagLib::ByteVector header = readAt(file, position, 24);
+
+		if (header.size() < 24)
+			return;
+
+		long long objectLength = header.mid(16, 8).toLongLong(false);
+
+		if (objectLength < 24 || objectLength > end - position)
+			return;
+
+		long data = position + 24;
+		long next = position + (long)objectLength;
+
+		if (isGuid(header, asfExtendedContentGuid))
+			locateASFContent(file, data, next, pictures);
+		else if (isGuid(header, asfMetadataLibraryGuid))
+			locateASFLibrary(file, data, next, pictures);
+		else if (isGuid(header, asfHeaderExtensionGuid)) {
+			// reserved GUID and number, size of the objects
+			TagLib::ByteVector extension = readAt(file, data, 22);
+
+			if (extension.size() == 22 && next - data >= 22 && extension.toUInt(18, false) <= (unsigned long)(next - data - 22))
+				locateASF(file, data + 22, data + 22 + extension.toUInt(18, false), pictures);
+		}
+
+		position = next;
+	}
+}
+
+/**
+* \brief	locateASFContent
+*
+* finds the pictures of the extended content description object
+*
+* \param	file		file
+* \param	begin		first byte behind the object header
+* \param	end			end of the object
+* \param	pictures	receives the pictures
+*/
+void PictureLocator::locateASFContent(TagLib::File & file, const long & begin, const long & end, std::vector<PictureLocation> & pictures) {
+	TagLib::ByteVector count = readAt(file, begin, 2);
+
+	if (count.size() < 2)
+		return;
+
+	unsigned int descriptors = count.toUInt(0, 2, false);
+	long position = begin + 2;
+
+	for (unsigned int i = 0; i < descriptors && position + 2 <= end; i++) {
+		TagLib::ByteVector length = readAt(file, position, 2);
+
+		if (length.size() < 2)
+			return;
+
+		unsigned int nameLength = length.toUInt(0, 2, false);
+
+		// name, type and length of the value
+		TagLib::ByteVector descriptor = readAt(file, position + 2, nameLength + 4);
+
+		if (descriptor.size() < nameLength + 4)
+			return;
+
+		unsigned int valueType = descriptor.toUInt(nameLength, 2, false);
+		unsigned int valueLength = descriptor.toUInt(nameLength + 2, 2, false);
+
+		long value = position + 2 + nameLength + 4;
+
+		if (value + (long)valueLength > end)
+			return;
+
+		// byte array
+		if (valueType == 1 && nameLength >= 20 && memcmp(descriptor.data(), asfPictureName, 20) == 0 && nameLength <= 22)
+			locateASFPicture(file, value, valueLength, pictures);
+
+		position = value + valueLength;
+	}
+}
+
+/**
+* \brief	locateASFLibrary
+*
+* finds the pictures of the metadata library object
+*
+* \param	file		file
+* \param	begin		first byte behind the object header
+* \param	end			end of the object
+* \param	pictures	receives the pictures
+*/
+void PictureLocator::locateASFLibrary(TagLib::File & file, const long & begin, const long & end, std::vector<PictureLocation> & pictures) {
+	TagLib::ByteVector count = readAt(file, begin, 2);
+
+	if (count.size() < 2)
+		return;
+
+	unsigned int records = count.toUInt(0, 2, false);
+	long position = begin + 2;
+
+	for (unsigned int i = 0; i < records && position + 12 <= end; i++) {
+		// language, stream, length of the name, type and length of the data
+		TagLib::ByteVector record = readAt(file, position, 12);
+
+		if (record.size() < 12)
+			return;
+
+		unsigned int nameLength = record.toUInt(4, 2, false);
+		unsigned int dataType = record.toUInt(6, 2, false);
+		unsigned int dataLength = record.toUInt(8, 4, false);
+
+		long name = position + 12;
+		long value = name + nameLength;
+
+		if (value > end || dataLength > (unsigned long)(end - value))
+			return;
+
+		if (dataType == 1 && nameLength >= 20 && nameLength <= 22) {
+			TagLib::ByteVector recordName = readAt(file, name, nameLength);
+
+			if (recordName.size() == nameLength && memcmp(recordName.data(), asfPictureName, 20) == 0)
+				locateASFPicture(file, value, dataLength, pictures);
+		}
+
+		position = value + dataLength;
+	}
+}
+
+/**
+* \brief	locateASFPicture
+*
+* locates the picture of a WM/Picture value: type, length of the picture, UTF-16 MIME type and description before it
+*
+* \param	file		file
+* \param	value		first byte of the value
+* \param	length		length of the value
+* \param	pictures	receives the picture
+*/
+void PictureLocator::locateASFPicture(TagLib::File & file, const long & value, const unsigned int & length, std::vector<PictureLocation> & pictures) {
+	TagLib::ByteVector head = readAt(file, value, min((unsigned int)PICTURE_HEAD_SIZE, length));
+
+	if (head.size() < 5)
+		return;
+
+	int type = (unsigned char)head[0];
+	unsigned int pictureLength = head.toUInt(1, 4, false);
+
+	// the MIME type is ASCII in UTF-16
+	std::string mimeType;
+	unsigned int p = 5;
+
+	while (p + 1 < head.size() && (head[p] != 0 || head[p + 1] != 0)) {
+		mimeType.push_back(head[p]);
+		p += 2;
+	}
+
+	p += 2;
+
+	while (p + 1 < head.size() && (head[p] != 0 || head[p + 1] != 0))
+		p += 2;
+
+	p += 2;
+
+	if (p <= head.size() && pictureLength <= length - p)
+		add(pictures, value + p, pictureLength, mimeType, type, PICTURE_RAW);
+}
+
+/**
+* \brief	locateAPE
+*
+* finds the binary Cover Art items of an APE tag at the end of the file or before an ID3v1 tag. the value of an item
+* is the file name of the picture, a null byte and the picture
+*
+* \param	file		file
+* \param	pictures	receives the pictures
+*/
+void PictureLocator::locateAPE(TagLib::File & file, std::vector<PictureLocation> & pictures) {
+	long fileLength = file.length();
+
+	for (int i = 0; i < 2; i++) {
+		long footerPosition = fileLength - 32 - (i == 1 ? 128 : 0);
+		TagLib::ByteVector footer = readAt(file, footerPosition, 32);
+
+		if (footer.size() < 32 || !footer.startsWith("APETAGEX"))
+			continue;
+
+		// size of the items and the footer
+		unsigned int tagLength = footer.toUInt(12, false);
+		unsigned int items = footer.toUInt(16, false);
+
+		if (tagLength < 32 || tagLength - 32 > (unsigned long)footerPosition)
+			return;
+
+		long position = footerPosition + 32 - tagLength;
+
+		for (unsigned int item = 0; item < items && position + 8 < footerPosition; item++) {
+			TagLib::ByteVector head = readAt(file, position, (unsigned int)min((long)PICTURE_HEAD_SIZE, footerPosition - position));
+
+			int keyEnd = head.find(TagLib::ByteVector(1, 0), 8);
+
+			if (head.size() < 9 || keyEnd < 0)
+				return;
+
+			unsigned int valueLength = head.toUInt(0, false);
+			unsigned int flags = head.toUInt(4, false);
+
+			long value = position + keyEnd + 1;
+
+			if (valueLength > (unsigned long)(footerPosition - value))
+				return;
+
+			std::string key(head.data() + 8, keyEnd - 8);
+
+			if (((flags >> 1) & 3) == 1 && _strnicmp(key.c_str(), "Cover Art", 9) == 0) {
+				int nameEnd = head.find(TagLib::ByteVector(1, 0), keyEnd + 1);
+
+				if (nameEnd >= 0 && (unsigned int)(nameEnd - keyEnd) <= valueLength) {
+					int type = _stricmp(key.c_str(), "Cover Art (Front)") == 0 ? PICTURE_TYPE_FRONT
+						: (_stricmp(key.c_str(), "Cover Art (Back)") == 0 ? PICTURE_TYPE_BACK : PICTURE_TYPE_OTHER);
+
+					add(pictures, value + nameEnd - keyEnd, valueLength - (nameEnd - keyEnd),
+						mimeTypeOf(std::string(head.data() + keyEnd + 1, nameEnd - keyEnd - 1)), type, PICTURE_RAW);
+				}
+			}
+
+			position = value + valueLength;
+		}
+
+		return;
+	}
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include "stdafx.h"
+
+
+// bytes read at the start of a picture frame, block or item to find where the picture starts
+#define PICTURE_HEAD_SIZE 1024
+
+// how the bytes of a located picture are stored
+#define PICTURE_RAW 0				// the bytes are the picture
+#define PICTURE_UNSYNCHRONIZED 1	// ID3v2 unsynchronisation, a 0x00 behind 0xFF has to be removed
+
+// ID3v2 and FLAC picture types
+#define PICTURE_TYPE_OTHER 0
+#define PICTURE_TYPE_FRONT 3
+#define PICTURE_TYPE_BACK 4
+
+
+// position of an embedded picture in its file
+struct PictureLocation {
+	// first byte and number of bytes of the picture
+	long offset;
+	unsigned int length;
+
+	std::string mimeType;
+
+	// PICTURE_TYPE_, MP4 covers are front covers
+	int type;
+
+	// PICTURE_RAW or PICTURE_UNSYNCHRONIZED
+	int encoding;
+};
+
+
+// finds the embedded pictures of a file in the headers of its tags, the pictures themselves aren't read.
+// knows ID3v2 (MP3, TrueAudio), FLAC, MP4, ASF and APE tags (Monkey's Audio, Musepack, WavPack, MP3). the base64
+// pictures of Ogg files are split by the pages and have no byte range
+class PictureLocator {
+	private:
+		static TagLib::ByteVector const readAt(TagLib::File & file, const long & position, const unsigned int & length);
+		static void add(std::vector<PictureLocation> & pictures, const long & offset, const unsigned int & length, const std::string & mimeType,
+			const int & type, const int & encoding);
+
+		static void locateID3v2(TagLib::File & file, const long & position, std::vector<PictureLocation> & pictures);
+		static void locateFLAC(TagLib::File & file, std::vector<PictureLocation> & pictures);
+		static void locateMP4(TagLib::File & file, const long & begin, const long & end, const int & depth, std::vector<PictureLocation> & pictures);
+		static void locateASF(TagLib::File & file, const long & begin, const long & end, std::vector<PictureLocation> & pictures);
+		static void locateASFContent(TagLib::File & file, const long & begin, const long & end, std::vector<PictureLocation> & pictures);
+		static void locateASFLibrary(TagLib::File & file, const long & begin, const long & end, std::vector<PictureLocation> & pictures);
+		static void locateASFPicture(TagLib::File & file, const long & value, const unsigned int & length, std::vector<PictureLocation> & pictures);
+		static void locateAPE(TagLib::File & file, std::vector<PictureLocation> & pictures);
+
+	public:
+		static bool const locatePictures(TagLib::File & file, std::vector<PictureLocation> & pictures);
+		static int const choose(const std::vector<PictureLocation> & pictures);
+		static TagLib::ByteVector const read(TagLib::File & file, const PictureLocation & location);
+};
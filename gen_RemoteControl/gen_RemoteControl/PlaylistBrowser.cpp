@@ -0,0 +1,417 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	PlaylistPageLoader
+*
+* constructor
+*
+* \param	request	browse or load the entries are read for
+*/
+PlaylistPageLoader::PlaylistPageLoader(const PlaylistRequest & request) : request(request) {
+	index = 0;
+	more = false;
+}
+
+/**
+* \brief	OnFile
+*
+* called by the playlist loader for every entry of the file
+*
+* \param	filename	file of the entry, absolute
+* \param	title		title of the entry, NULL if the file has none
+* \param	lengthInMS	length of the entry, -1 if unknown
+* \param	info		extended information, not used
+*
+* \return	LOAD_ABORT once the window of a browse is full, LOAD_CONTINUE otherwise
+*/
+int PlaylistPageLoader::OnFile(const wchar_t *filename, const wchar_t *title, int lengthInMS, ifc_plentryinfo *info) {
+	if (filename == NULL)
+		return LOAD_CONTINUE;
+
+	int length = lengthInMS >= 0 ? lengthInMS / 1000 : -1;
+
+	if (request.load) {
+		PlaylistEntry entry;
+		entry.file = filename;
+		entry.title = title != NULL ? title : L"";
+		entry.length = length;
+
+		entries.push_back(entry);
+
+		return LOAD_CONTINUE;
+	}
+
+	// the entry behind the window only tells that there are more
+	if (index >= request.start + request.count) {
+		more = true;
+
+		return LOAD_ABORT;
+	}
+
+	if (index++ < request.start)
+		return LOAD_CONTINUE;
+
+	// file name without the directory if the playlist has no title
+	const wchar_t *name = title;
+
+	if (name == NULL || *name == L'\0') {
+		name = wcsrchr(filename, L'\\');
+		name = name != NULL ? name + 1 : filename;
+	}
+
+	stringstream lengthStream;
+	lengthStream << length;
+
+	lines.push_back(utf8_encode(filename));
+	lines.push_back(utf8_encode(name));
+	lines.push_back(lengthStream.str());
+
+	return LOAD_CONTINUE;
+}
+
+#define CBCLASS PlaylistPageLoader
+START_DISPATCH;
+CB(IFC_PLAYLISTLOADERCALLBACK_ONFILE_RET, OnFile)
+END_DISPATCH;
+#undef CBCLASS
+
+
+/**
+* \brief	PlaylistBrowser
+*
+* constructor
+*/
+PlaylistBrowser::PlaylistBrowser() {
+	thread = NULL;
+
+	requestEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+	InitializeCriticalSection(&cs_playlistbrowser);
+}
+
+/**
+* \brief	~PlaylistBrowser
+*
+* destructor
+*/
+PlaylistBrowser::~PlaylistBrowser() {
+	CloseHandle(requestEvent);
+	CloseHandle(stopEvent);
+
+	DeleteCriticalSection(&cs_playlistbrowser);
+}
+
+/**
+* \brief	wideString
+*
+* \param	text	UTF8 text of a command
+* \param	length	bytes of the text
+*
+* \return	text as wide string
+*/
+std::wstring const PlaylistBrowser::wideString(const char *text, const size_t & length) {
+	if (length == 0)
+		return std::wstring();
+
+	int wideLength = MultiByteToWideChar(CP_UTF8, 0, text, (int)length, NULL, 0);
+
+	if (wideLength <= 0)
+		return std::wstring();
+
+	std::vector<wchar_t> buffer(wideLength);
+	MultiByteToWideChar(CP_UTF8, 0, text, (int)length, &buffer[0], wideLength);
+
+	return std::wstring(&buffer[0], wideLength);
+}
+
+/**
+* \brief	browse
+*
+* performs a browse_playlist_ command: sends a window of the entries of a playlist file
+*
+* \param	session		id of the session
+* \param	argument	<path>_<start>_<count>, the path is UTF8 and may contain _
+*
+* \return	1 if the argument is incomplete, 0 if success
+*/
+int const PlaylistBrowser::browse(const int & session, const char *argument) {
+	const char *count = strrchr(argument, '_');
+	const char *start = count;
+
+	// the start follows the last _ in front of the count
+	while (start != NULL && start > argument && start[-1] != '_')
+		start--;
+
+	if (count == NULL || start - 1 <= argument)
+		return 1;
+
+	PlaylistRequest request;
+	request.session = session;
+	request.path = wideString(argument, start - 1 - argument);
+	request.start = max(atoi(start), 0);
+	request.count = min(max(atoi(count + 1), 0), MAX_PLAYLIST_RANGE);
+	request.load = false;
+
+	return queue(request);
+}
+
+/**
+* \brief	load
+*
+* performs a load_playlist_ command: adds the entries of a playlist file to the playlist of winamp
+*
+* \param	session		id of the session
+* \param	argument	UTF8 path of the playlist file
+*
+* \return	1 if the path is empty, 0 if success
+*/
+int const PlaylistBrowser::load(const int & session, const char *argument) {
+	PlaylistRequest request;
+	request.session = session;
+	request.path = wideString(argument, strlen(argument));
+	request.start = 0;
+	request.count = 0;
+	request.load = true;
+
+	if (request.path.empty())
+		return 1;
+
+	return queue(request);
+}
+
+/**
+* \brief	queue
+*
+* replaces the waiting request of a session and starts the thread if it isn't running
+*
+* \param	request	browse or load to run
+*
+* \return	0 if success
+*/
+int const PlaylistBrowser::queue(const PlaylistRequest & request) {
+	// CRITICAL
+	EnterCriticalSection(&cs_playlistbrowser);
+
+	pending[request.session] = request;
+
+	if (thread == NULL) {
+		ResetEvent(stopEvent);
+
+		thread = CreateThread(NULL, 0, browseFunction, this, 0, NULL);
+	}
+
+	LeaveCriticalSection(&cs_playlistbrowser);
+	// CRITICAL END
+
+	SetEvent(requestEvent);
+
+	return 0;
+}
+
+/**
+* \brief	drop
+*
+* forgets the requests and answers of a closed session
+*
+* \param	session	id of the session
+*/
+void PlaylistBrowser::drop(const int & session) {
+	// CRITICAL
+	EnterCriticalSection(&cs_playlistbrowser);
+
+	pending.erase(session);
+	pages.erase(session);
+
+	LeaveCriticalSection(&cs_playlistbrowser);
+	// CRITICAL END
+}
+
+/**
+* \brief	stop
+*
+* stops the thread after the running request. called by quit
+*/
+void PlaylistBrowser::stop() {
+	SetEvent(stopEvent);
+
+	joinThread(thread, PLAYLIST_BROWSE_STOP_TIMEOUT);
+}
+
+/**
+* \brief	take
+*
+* \param	request	receives the next waiting request
+*
+* \return	false if no request is waiting
+*/
+bool const PlaylistBrowser::take(PlaylistRequest & request) {
+	// CRITICAL
+	EnterCriticalSection(&cs_playlistbrowser);
+
+	bool found = !pending.empty();
+
+	if (found) {
+		request = pending.begin()->second;
+		pending.erase(pending.begin());
+	}
+
+	LeaveCriticalSection(&cs_playlistbrowser);
+	// CRITICAL END
+
+	return found;
+}
+
+/**
+* \brief	addPage
+*
+* hands an answer to the send thread
+*
+* \param	session	id of the session
+* \param	page	formatted answer
+*/
+void PlaylistBrowser::addPage(const int & session, const PlaylistPage & page) {
+	// CRITICAL
+	EnterCriticalSection(&cs_playlistbrowser);
+
+	pages[session].push_back(page);
+
+	LeaveCriticalSection(&cs_playlistbrowser);
+	// CRITICAL END
+
+	tasklist.push("playlistPage", -1, session);
+}
+
+/**
+* \brief	sendPage
+*
+* sends the next answer of a session. only called by the send command thread
+*
+* \param	session	id of the session
+*/
+void PlaylistBrowser::sendPage(const int & session) {
+	PlaylistPage page;
+	bool found = false;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_playlistbrowser);
+
+	std::map<int, std::deque<PlaylistPage> >::iterator it = pages.find(session);
+
+	if (it != pages.end() && !it->second.empty()) {
+		page = it->second.front();
+		it->second.pop_front();
+
+		if (it->second.empty())
+			pages.erase(it);
+
+		found = true;
+	}
+
+	LeaveCriticalSection(&cs_playlistbrowser);
+	// CRITICAL END
+
+	if (!found)
+		return;
+
+	rawSend(page.header.c_str());
+
+	for (unsigned int i = 0; i < page.lines.size(); i++)
+		rawSend(page.lines[i].c_str());
+}
+
+/**
+* \brief	insertFunction
+*
+* appends the entries of a playlist file to the playlist of winamp. run on the winamp thread by WinampState::invoke,
+* the entries have their titles and lengths, so winamp doesn't read the files
+*
+* \param	parameter	vector of the PlaylistEntry
+*/
+void PlaylistBrowser::insertFunction(void *parameter) {
+	std::vector<PlaylistEntry> *entries = (std::vector<PlaylistEntry>*)parameter;
+
+	for (unsigned int i = 0; i < entries->size(); i++) {
+		PlaylistEntry & entry = (*entries)[i];
+
+		enqueueFileWithMetaStructW file;
+		file.filename = entry.file.c_str();
+		file.title = entry.title.empty() ? NULL : entry.title.c_str();
+		file.length = entry.length;
+
+		SendMessage(plugin.hwndParent, WM_WA_IPC, (WPARAM)&file, IPC_ENQUEUEFILEW);
+	}
+}
+
+/**
+* \brief	run
+*
+* loads a playlist file with api_playlistmanager. a browse answers browse_playlist_<start>_<count>_<more>
+* followed by the lines of the entries, more is 1 if the file has entries behind them. a load answers
+* load_playlist_<count> after the entries have been added. a file that can't be loaded is answered
+* with browse_playlist_failed or load_playlist_failed
+*
+* \param	request	browse or load to run
+*/
+void PlaylistBrowser::run(const PlaylistRequest & request) {
+	TraceSpan span(request.load ? "playlist_load" : "playlist_browse", request.session);
+
+	CHECK_PLAYLISTMANAGER();
+
+	PlaylistPageLoader loader(request);
+	PlaylistPage page;
+
+	bool loaded = AGAVE_API_PLAYLISTMANAGER != NULL && AGAVE_API_PLAYLISTMANAGER->CanLoad(request.path.c_str())
+		&& AGAVE_API_PLAYLISTMANAGER->Load(request.path.c_str(), &loader) == PLAYLISTMANAGER_SUCCESS;
+
+	const char *command = request.load ? "load_playlist_" : "browse_playlist_";
+
+	stringstream header;
+
+	if (!loaded && loader.index == 0 && loader.entries.empty())
+		header << command << "failed";
+	else if (request.load) {
+		// one call on the winamp thread for the whole file
+		if (!loader.entries.empty())
+			winampstate.invoke(insertFunction, &loader.entries);
+
+		header << command << loader.entries.size();
+	} else {
+		int first = min(request.start, loader.index);
+
+		header << command << first << "_" << loader.lines.size() / PLAYLIST_BROWSE_ROW_LINES << "_" << (loader.more ? 1 : 0);
+
+		page.lines.swap(loader.lines);
+	}
+
+	page.header = header.str();
+
+	addPage(request.session, page);
+}
+
+/**
+* \brief	browseFunction
+*
+* thread of the playlist browser. runs the waiting requests one after another until the stop event is set
+*
+* \param	parameter	playlist browser
+*
+* \return	0
+*/
+DWORD WINAPI PlaylistBrowser::browseFunction(LPVOID parameter) {
+	PlaylistBrowser *browser = (PlaylistBrowser*)parameter;
+
+	HANDLE events[2] = { browser->stopEvent, browser->requestEvent };
+
+	ThreadPolicy policy(THREAD_CLASS_INTERACTIVE);
+
+	while (WaitForMultipleObjects(2, events, FALSE, INFINITE) == WAIT_OBJECT_0 + 1) {
+		PlaylistRequest request;
+
+		while (WaitForSingleObject(browser->stopEvent, 0) != WAIT_OBJECT_0 && browser->take(request))
+			browser->run(request);
+	}
+
+	return 0;
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include "stdafx.h"
+
+// lines of one entry of a browse_playlist_ page: file, title, length in seconds or -1
+#define PLAYLIST_BROWSE_ROW_LINES 3
+
+// milliseconds quit waits for a running load
+#define PLAYLIST_BROWSE_STOP_TIMEOUT 5000
+
+
+// browse_playlist_ or load_playlist_ command of a session that hasn't been run yet
+struct PlaylistRequest {
+	int session;
+
+	// playlist file
+	std::wstring path;
+
+	// window of entries of a browse, not used by a load
+	int start;
+	int count;
+
+	// true if the entries are added to the playlist of winamp instead of being sent
+	bool load;
+};
+
+
+// one answer of a request: the header followed by the lines of the entries
+struct PlaylistPage {
+	std::string header;
+	std::vector<std::string> lines;
+};
+
+
+// one entry of a playlist file that is added to winamp, see PlaylistBrowser::insertFunction
+struct PlaylistEntry {
+	std::wstring file;
+	std::wstring title;
+
+	// seconds, -1 if unknown
+	int length;
+};
+
+
+// receives the entries of a playlist file from api_playlistmanager while the loader reads it. a browse formats
+// the entries of its window into the page and aborts the load after the first entry behind it, a load keeps every entry
+class PlaylistPageLoader : public ifc_playlistloadercallback {
+	public:
+		PlaylistPageLoader(const PlaylistRequest & request);
+
+		const PlaylistRequest & request;
+
+		// number of the entries seen so far
+		int index;
+
+		// true if the file has entries behind the window
+		bool more;
+
+		std::vector<std::string> lines;
+		std::vector<PlaylistEntry> entries;
+
+	protected:
+		RECVS_DISPATCH;
+
+	private:
+		int OnFile(const wchar_t *filename, const wchar_t *title, int lengthInMS, ifc_plentryinfo *info);
+};
+
+
+// lists the entries of saved playlist files for the clients and loads them into winamp. browse_playlist_ sends one
+// window of a file: the loader is aborted once the window is full, so the first page of a long playlist doesn't wait
+// for the rest of it. load_playlist_ adds the whole file to the playlist with one call on the winamp thread.
+// a session has at most one waiting request, a newer one replaces it
+class PlaylistBrowser {
+	private:
+		// waiting requests by session
+		std::map<int, PlaylistRequest> pending;
+
+		// answers waiting for the send thread by session
+		std::map<int, std::deque<PlaylistPage> > pages;
+
+		HANDLE thread;
+		HANDLE requestEvent;
+		HANDLE stopEvent;
+
+		// critical playlist browser section
+		CRITICAL_SECTION cs_playlistbrowser;
+
+		static DWORD WINAPI browseFunction(LPVOID parameter);
+		static void insertFunction(void *parameter);
+		static std::wstring const wideString(const char *text, const size_t & length);
+
+		int const queue(const PlaylistRequest & request);
+		bool const take(PlaylistRequest & request);
+		void addPage(const int & session, const PlaylistPage & page);
+		void run(const PlaylistRequest & request);
+
+	public:
+		PlaylistBrowser();
+
+		~PlaylistBrowser();
+
+		int const browse(const int & session, const char *argument);
+		int const load(const int & session, const char *argument);
+		void drop(const int & session);
+
+		void sendPage(const int & session);
+		void stop();
+};
@@ -0,0 +1,216 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	CachedPlaylist
+*
+* constructor
+*/
+CachedPlaylist::CachedPlaylist() {
+	fingerprint = 0;
+	tagChanges = 0;
+	bytes = 0;
+}
+
+/**
+* \brief	~CachedPlaylist
+*
+* destructor, sessions that still send a window of the image keep their reference
+*/
+CachedPlaylist::~CachedPlaylist() {
+	for (unsigned int i = 0; i < image.size(); i++)
+		delete image[i];
+}
+
+
+/**
+* \brief	PlaylistCache
+*
+* constructor
+*/
+PlaylistCache::PlaylistCache() {
+	bytes = 0;
+	resolveTime = 0;
+	resolved = 0;
+
+	hits = 0;
+	misses = 0;
+
+	InitializeCriticalSection(&cs_playlistcache);
+}
+
+/**
+* \brief	~PlaylistCache
+*
+* destructor
+*/
+PlaylistCache::~PlaylistCache() {
+	for (std::list<CachedPlaylist*>::iterator it = playlists.begin(); it != playlists.end(); it++)
+		delete *it;
+
+	DeleteCriticalSection(&cs_playlistcache);
+}
+
+/**
+* \brief	evict
+*
+* drops the least recently replaced playlists until at most PLAYLIST_CACHE_ENTRIES take at most limit bytes.
+* call inside the critical playlist cache section!
+*
+* \param	limit	maximum number of bytes
+*/
+void PlaylistCache::evict(const LONGLONG & limit) {
+	while (!playlists.empty() && (bytes > limit || playlists.size() > PLAYLIST_CACHE_ENTRIES)) {
+		bytes -= playlists.back()->bytes;
+
+		delete playlists.back();
+		playlists.pop_back();
+	}
+}
+
+/**
+* \brief	updateBudget
+*
+* reports the bytes and the cost of the kept playlists to the memory budget. call inside the critical playlist cache section!
+*/
+void PlaylistCache::updateBudget() {
+	LONGLONG titles = 0;
+
+	for (std::list<CachedPlaylist*>::iterator it = playlists.begin(); it != playlists.end(); it++)
+		titles += (*it)->hashes.size();
+
+	memorybudget.update(BUDGET_PLAYLISTS, bytes, MemoryBudget::cost(resolved > 0 ? resolveTime / resolved : 0, titles, bytes));
+}
+
+/**
+* \brief	put
+*
+* keeps a playlist the snapshot has replaced. a kept playlist with the same entries is dropped. only called by the
+* send command thread
+*
+* \param	playlist	the playlist, owned by the cache from now on
+*/
+void PlaylistCache::put(CachedPlaylist *playlist) {
+	playlist->bytes = sizeof(CachedPlaylist) + playlist->titles.capacity() + playlist->hashes.capacity() * sizeof(unsigned int)
+		+ playlist->titleOffsets.capacity() * sizeof(unsigned int) + playlist->titleStates.capacity()
+		+ playlist->entryHashes.capacity() * sizeof(unsigned long long)
+		+ playlist->image.capacity() * sizeof(ImageSegment*);
+
+	for (unsigned int i = 0; i < playlist->image.size(); i++) {
+		if (playlist->image[i] != NULL)
+			playlist->bytes += sizeof(ImageSegment) + playlist->image[i]->offsets.capacity() * sizeof(unsigned int) + playlist->image[i]->data->bytes.size();
+	}
+
+	LONGLONG limit = min((LONGLONG)PLAYLIST_CACHE_SIZE, memorybudget.limit(BUDGET_PLAYLISTS));
+
+	// CRITICAL
+	EnterCriticalSection(&cs_playlistcache);
+
+	for (std::list<CachedPlaylist*>::iterator it = playlists.begin(); it != playlists.end(); it++) {
+		if ((*it)->hashes == playlist->hashes) {
+			bytes -= (*it)->bytes;
+
+			delete *it;
+			playlists.erase(it);
+
+			break;
+		}
+	}
+
+	playlists.push_front(playlist);
+	bytes += playlist->bytes;
+
+	evict(limit);
+	updateBudget();
+
+	LeaveCriticalSection(&cs_playlistcache);
+	// CRITICAL END
+}
+
+/**
+* \brief	take
+*
+* removes the kept playlist with these entries, the snapshot continues with it. only called by the send command thread
+*
+* \param	hashes	hash of every entry of the current playlist
+*
+* \return	the playlist, the caller has to delete it. NULL if it isn't kept
+*/
+CachedPlaylist* const PlaylistCache::take(const std::vector<unsigned int> & hashes) {
+	CachedPlaylist *playlist = NULL;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_playlistcache);
+
+	for (std::list<CachedPlaylist*>::iterator it = playlists.begin(); it != playlists.end(); it++) {
+		if ((*it)->hashes == hashes) {
+			playlist = *it;
+			bytes -= playlist->bytes;
+
+			playlists.erase(it);
+			updateBudget();
+
+			break;
+		}
+	}
+
+	LeaveCriticalSection(&cs_playlistcache);
+	// CRITICAL END
+
+	InterlockedIncrement(playlist != NULL ? &hits : &misses);
+
+	return playlist;
+}
+
+/**
+* \brief	recordResolve
+*
+* \param	microseconds	time a batch of titles took from its start until its titles were compared
+* \param	titles			number of titles of the batch
+*/
+void PlaylistCache::recordResolve(const LONGLONG & microseconds, const unsigned int & titles) {
+	// CRITICAL
+	EnterCriticalSection(&cs_playlistcache);
+
+	resolveTime += microseconds;
+	resolved += titles;
+
+	LeaveCriticalSection(&cs_playlistcache);
+	// CRITICAL END
+}
+
+/**
+* \brief	trim
+*
+* drops the least recently replaced playlists, called by the memory budget
+*
+* \param	limit	maximum number of bytes
+*/
+void PlaylistCache::trim(const LONGLONG & limit) {
+	// CRITICAL
+	EnterCriticalSection(&cs_playlistcache);
+
+	evict(limit);
+	updateBudget();
+
+	LeaveCriticalSection(&cs_playlistcache);
+	// CRITICAL END
+}
+
+/**
+* \brief	report
+*
+* \param	lines	receives one line: number and bytes of the kept playlists, switches back to one and to others
+*/
+void PlaylistCache::report(std::vector<std::string> & lines) {
+	// CRITICAL
+	EnterCriticalSection(&cs_playlistcache);
+
+	stringstream line;
+	line << "playlist_cache playlists " << playlists.size() << " bytes " << bytes << " hits " << hits << " misses " << misses;
+
+	LeaveCriticalSection(&cs_playlistcache);
+	// CRITICAL END
+
+	lines.push_back(line.str());
+}
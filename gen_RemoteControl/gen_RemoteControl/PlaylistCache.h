@@ -0,0 +1,73 @@
+#pragma once
+#include "stdafx.h"
+
+// number of playlists kept after winamp has switched to another one
+#define PLAYLIST_CACHE_ENTRIES 8
+
+// maximum number of bytes of all kept playlists, less when the memory budget is exceeded
+#define PLAYLIST_CACHE_SIZE 4194304
+
+
+// playlist that has been replaced by another one, with everything the snapshot had built for it
+struct CachedPlaylist {
+	// hash of every entry, see PlaylistSnapshot::hashEntry
+	std::vector<unsigned int> hashes;
+
+	// titles, each terminated by \0, their offsets and their TITLE_ states
+	std::string titles;
+	std::vector<unsigned int> titleOffsets;
+	std::vector<unsigned char> titleStates;
+
+	// segments of the encoded titles that had been built, NULL for the others
+	std::vector<ImageSegment*> image;
+
+	// see PlaylistSnapshot::entryHashes
+	std::vector<unsigned long long> entryHashes;
+	unsigned long long fingerprint;
+
+	// PlaylistSnapshot::tagChanges when the playlist was replaced, the titles are checked again if tags have changed since
+	LONG tagChanges;
+
+	LONGLONG bytes;
+
+	CachedPlaylist();
+
+	~CachedPlaylist();
+};
+
+
+// the last playlists winamp has switched away from. switching back restores the titles, the image and the fingerprint
+// of the snapshot, so the clients get the fingerprint at once instead of every title again from the background.
+// shares the memory budget, a playlist costs the time its titles took to resolve
+class PlaylistCache : public BudgetClient {
+	private:
+		// most recently replaced first
+		std::list<CachedPlaylist*> playlists;
+		LONGLONG bytes;
+
+		// microseconds and titles of the resolved batches, for the cost of the budget
+		LONGLONG resolveTime;
+		LONGLONG resolved;
+
+		volatile LONG hits;
+		volatile LONG misses;
+
+		// critical playlist cache section, trim is called on any thread
+		CRITICAL_SECTION cs_playlistcache;
+
+		void evict(const LONGLONG & limit);
+		void updateBudget();
+
+	public:
+		PlaylistCache();
+
+		~PlaylistCache();
+
+		void put(CachedPlaylist *playlist);
+		CachedPlaylist* const take(const std::vector<unsigned int> & hashes);
+		void recordResolve(const LONGLONG & microseconds, const unsigned int & titles);
+
+		virtual void trim(const LONGLONG & limit);
+
+		void report(std::vector<std::string> & lines);
+};
@@ -0,0 +1,364 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	PlaylistEditor
+*
+* constructor
+*/
+PlaylistEditor::PlaylistEditor() {
+	editing = 0;
+}
+
+/**
+* \brief	isEditing
+*
+* called by the MainWndProc hook, the IPC_PLAYLIST_MODIFIED of a running edit are ignored
+*
+* \return	true while an edit runs on the winamp thread
+*/
+bool const PlaylistEditor::isEditing() const {
+	return editing != 0;
+}
+
+/**
+* \brief	parseNumber
+*
+* reads one number of a command argument
+*
+* \param	argument	number followed by _ or the end of the argument
+* \param	number		receives the number
+*
+* \return	text behind the _, NULL if the argument has no number
+*/
+const char* const PlaylistEditor::parseNumber(const char *argument, int & number) {
+	char *end;
+	number = (int)strtol(argument, &end, 10);
+
+	if (end == argument)
+		return NULL;
+
+	return *end == '_' ? end + 1 : end;
+}
+
+/**
+* \brief	insert
+*
+* performs a playlist_insert_ command: inserts files into the playlist
+*
+* \param	argument	<index>_<path>|<path>..., UTF8 paths; an index behind the playlist appends them
+*
+* \return	1 if the argument has no index or no file, 0 if success
+*/
+int const PlaylistEditor::insert(const char *argument) {
+	PlaylistEdit edit;
+	edit.type = PLAYLIST_EDIT_INSERT;
+
+	const char *files = parseNumber(argument, edit.start);
+
+	if (files == NULL)
+		return 1;
+
+	while (*files != '\0') {
+		const char *end = strchr(files, '|');
+		size_t length = end != NULL ? end - files : strlen(files);
+
+		int wideLength = length > 0 ? MultiByteToWideChar(CP_UTF8, 0, files, (int)length, NULL, 0) : 0;
+
+		if (wideLength > 0 && wideLength < MAX_PATH) {
+			std::vector<wchar_t> buffer(wideLength);
+			MultiByteToWideChar(CP_UTF8, 0, files, (int)length, &buffer[0], wideLength);
+
+			edit.files.push_back(std::wstring(&buffer[0], wideLength));
+		}
+
+		files += length + (end != NULL ? 1 : 0);
+	}
+
+	if (edit.files.empty())
+		return 1;
+
+	return run(edit);
+}
+
+/**
+* \brief	remove
+*
+* performs a playlist_delete_ command: removes a range of entries
+*
+* \param	argument	<start>_<count>
+*
+* \return	1 if the argument is invalid, 0 if success
+*/
+int const PlaylistEditor::remove(const char *argument) {
+	PlaylistEdit edit;
+	edit.type = PLAYLIST_EDIT_DELETE;
+
+	if ((argument = parseNumber(argument, edit.start)) == NULL || parseNumber(argument, edit.count) == NULL)
+		return 1;
+
+	return run(edit);
+}
+
+/**
+* \brief	move
+*
+* performs a playlist_move_ command: moves a range of entries
+*
+* \param	argument	<start>_<count>_<to>, to is the index of the first entry after the move
+*
+* \return	1 if the argument is invalid, 0 if success
+*/
+int const PlaylistEditor::move(const char *argument) {
+	PlaylistEdit edit;
+	edit.type = PLAYLIST_EDIT_MOVE;
+
+	if ((argument = parseNumber(argument, edit.start)) == NULL || (argument = parseNumber(argument, edit.count)) == NULL
+		|| parseNumber(argument, edit.to) == NULL)
+		return 1;
+
+	return run(edit);
+}
+
+/**
+* \brief	sort
+*
+* performs a playlist_sort_ command: sorts a range of entries by title or by file
+*
+* \param	argument	<start>_<count>_<title|file>
+*
+* \return	1 if the argument is invalid, 0 if success
+*/
+int const PlaylistEditor::sort(const char *argument) {
+	PlaylistEdit edit;
+	edit.type = PLAYLIST_EDIT_SORT;
+
+	if ((argument = parseNumber(argument, edit.start)) == NULL || (argument = parseNumber(argument, edit.count)) == NULL)
+		return 1;
+
+	if (strcmp(argument, "file") == 0)
+		edit.byFile = true;
+	else if (strcmp(argument, "title") == 0)
+		edit.byFile = false;
+	else
+		return 1;
+
+	return run(edit);
+}
+
+/**
+* \brief	run
+*
+* runs an edit on the winamp thread and waits for it
+*
+* \param	edit	edit to run
+*
+* \return	0
+*/
+int const PlaylistEditor::run(PlaylistEdit & edit) {
+	TraceSpan span("playlist_edit", edit.type);
+
+	edit.editor = this;
+
+	winampstate.invoke(editFunction, &edit);
+
+	return 0;
+}
+
+/**
+* \brief	editFunction
+*
+* WinampFunction of run. changes the playlist while the hook ignores its IPC_PLAYLIST_MODIFIED, then tells the
+* clients once. the range of the edit is clipped to the playlist
+*
+* \param	parameter	PlaylistEdit
+*/
+void PlaylistEditor::editFunction(void *parameter) {
+	PlaylistEdit *edit = (PlaylistEdit*)parameter;
+
+	int length = SendMessage(plugin.hwndParent,WM_WA_IPC,0,IPC_GETLISTLENGTH);
+
+	InterlockedExchange(&edit->editor->editing, 1);
+
+	if (edit->type == PLAYLIST_EDIT_INSERT)
+		insertEntries(*edit, length);
+	else if (edit->type == PLAYLIST_EDIT_DELETE)
+		removeEntries(*edit, length);
+	else if (edit->type == PLAYLIST_EDIT_MOVE)
+		moveEntries(*edit, length);
+	else if (edit->type == PLAYLIST_EDIT_SORT)
+		sortEntries(*edit, length);
+
+	InterlockedExchange(&edit->editor->editing, 0);
+
+	playlistsnapshot.invalidate();
+	tasklist.push("playlist_modified");	// difference is computed in sendCommandThread
+
+	// the played entry may have another index now
+	if (winampstate.refresh())
+		tasklist.push(winampstate.newClock());
+}
+
+/**
+* \brief	insertEntries
+*
+* inserts the files of an insert with the playlist editor window
+*
+* \param	edit	insert
+* \param	length	number of entries of the playlist
+*/
+void PlaylistEditor::insertEntries(const PlaylistEdit & edit, const int & length) {
+	HWND pe = (HWND)SendMessage(plugin.hwndParent,WM_WA_IPC,IPC_GETWND_PE,IPC_GETWND);
+
+	if (pe == NULL)
+		return;
+
+	int index = edit.start < 0 || edit.start > length ? length : edit.start;
+
+	for (unsigned int i = 0; i < edit.files.size(); i++) {
+		fileinfoW info;
+		wcsncpy(info.file, edit.files[i].c_str(), MAX_PATH - 1);
+		info.file[MAX_PATH - 1] = L'\0';
+		info.index = index + i;
+
+		COPYDATASTRUCT data;
+		data.dwData = IPC_PE_INSERTFILENAMEW;
+		data.cbData = sizeof(info);
+		data.lpData = &info;
+
+		SendMessage(pe, WM_COPYDATA, 0, (LPARAM)&data);
+	}
+}
+
+/**
+* \brief	removeEntries
+*
+* removes the range of a delete, the last entry first so winamp doesn't move the ones behind it for each
+*
+* \param	edit	delete
+* \param	length	number of entries of the playlist
+*/
+void PlaylistEditor::removeEntries(const PlaylistEdit & edit, const int & length) {
+	HWND pe = (HWND)SendMessage(plugin.hwndParent,WM_WA_IPC,IPC_GETWND_PE,IPC_GETWND);
+
+	int start = max(edit.start, 0);
+	int end = min(edit.start + edit.count, length);
+
+	if (pe == NULL)
+		return;
+
+	for (int i = end - 1; i >= start; i--)
+		SendMessage(pe, WM_WA_IPC, IPC_PE_DELETEINDEX, i);
+}
+
+/**
+* \brief	moveEntries
+*
+* moves the range of a move. the entries between the old and the new place are rotated with three reversals,
+* every entry is swapped at most twice
+*
+* \param	edit	move
+* \param	length	number of entries of the playlist
+*/
+void PlaylistEditor::moveEntries(const PlaylistEdit & edit, const int & length) {
+	int start = max(edit.start, 0);
+	int count = min(edit.start + edit.count, length) - start;
+
+	if (count <= 0 || length - 1 > PLAYLIST_EDIT_MAX_INDEX)
+		return;
+
+	int to = min(max(edit.to, 0), length - count);
+
+	if (to < start) {
+		reverse(to, start - 1);
+		reverse(start, start + count - 1);
+		reverse(to, start + count - 1);
+	} else if (to > start) {
+		reverse(start, start + count - 1);
+		reverse(start + count, to + count - 1);
+		reverse(start, to + count - 1);
+	}
+}
+
+/**
+* \brief	sortEntries
+*
+* sorts the range of a sort. the order is computed on the titles or files first, then every entry is swapped
+* to its place once
+*
+* \param	edit	sort
+* \param	length	number of entries of the playlist
+*/
+void PlaylistEditor::sortEntries(const PlaylistEdit & edit, const int & length) {
+	int start = max(edit.start, 0);
+	int count = min(edit.start + edit.count, length) - start;
+
+	if (count <= 1 || length - 1 > PLAYLIST_EDIT_MAX_INDEX)
+		return;
+
+	std::vector<std::pair<std::wstring, int> > keys(count);
+
+	for (int i = 0; i < count; i++) {
+		const wchar_t *key = (const wchar_t*)SendMessage(plugin.hwndParent, WM_WA_IPC, start + i, edit.byFile ? IPC_GETPLAYLISTFILEW : IPC_GETPLAYLISTTITLEW);
+
+		keys[i].first = key != NULL ? key : L"";
+		keys[i].second = i;
+
+		std::transform(keys[i].first.begin(), keys[i].first.end(), keys[i].first.begin(), towlower);
+	}
+
+	// equal keys keep their order
+	std::stable_sort(keys.begin(), keys.end());
+
+	// position of every entry by its old index and old index of the entry at every position
+	std::vector<int> positions(count);
+	std::vector<int> entries(count);
+
+	for (int i = 0; i < count; i++) {
+		positions[i] = i;
+		entries[i] = i;
+	}
+
+	for (int i = 0; i < count; i++) {
+		int entry = keys[i].second;
+		int position = positions[entry];
+
+		if (position == i)
+			continue;
+
+		swap(start + i, start + position);
+
+		entries[position] = entries[i];
+		positions[entries[position]] = position;
+		entries[i] = entry;
+		positions[entry] = i;
+	}
+}
+
+/**
+* \brief	reverse
+*
+* reverses the order of a range of entries
+*
+* \param	first	first entry
+* \param	last	last entry
+*/
+void PlaylistEditor::reverse(const int & first, const int & last) {
+	for (int i = first, j = last; i < j; i++, j--)
+		swap(i, j);
+}
+
+/**
+* \brief	swap
+*
+* swaps two entries with the playlist editor window
+*
+* \param	from	first entry
+* \param	to		second entry
+*/
+void PlaylistEditor::swap(const int & from, const int & to) {
+	HWND pe = (HWND)SendMessage(plugin.hwndParent,WM_WA_IPC,IPC_GETWND_PE,IPC_GETWND);
+
+	if (pe != NULL)
+		SendMessage(pe, WM_WA_IPC, IPC_PE_SWAPINDEX, (from << 16) | to);
+}
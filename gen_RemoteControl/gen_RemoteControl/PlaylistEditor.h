@@ -0,0 +1,69 @@
+#pragma once
+#include "stdafx.h"
+
+// kinds of a PlaylistEdit
+#define PLAYLIST_EDIT_INSERT 0
+#define PLAYLIST_EDIT_DELETE 1
+#define PLAYLIST_EDIT_MOVE 2
+#define PLAYLIST_EDIT_SORT 3
+
+// IPC_PE_SWAPINDEX takes both indices in one LPARAM
+#define PLAYLIST_EDIT_MAX_INDEX 0xFFFF
+
+
+class PlaylistEditor;
+
+
+// one playlist_insert_, playlist_delete_, playlist_move_ or playlist_sort_ command
+struct PlaylistEdit {
+	// editor that runs it
+	PlaylistEditor *editor;
+
+	int type;
+
+	// first entry, for an insert the index the files are inserted at
+	int start;
+
+	// number of entries of a delete, move or sort
+	int count;
+
+	// index of the first moved entry after a move
+	int to;
+
+	// true if a sort compares the files instead of the titles
+	bool byFile;
+
+	// files of an insert
+	std::vector<std::wstring> files;
+};
+
+
+// changes ranges of the playlist for the clients. every command is one call on the winamp thread: the editor
+// sends its messages there as plain function calls and the MainWndProc hook ignores the IPC_PLAYLIST_MODIFIED
+// of each of them, so the clients get one playlist_modified for the whole range
+class PlaylistEditor {
+	private:
+		// 1 while an edit runs on the winamp thread
+		volatile LONG editing;
+
+		static void editFunction(void *parameter);
+		static void insertEntries(const PlaylistEdit & edit, const int & length);
+		static void removeEntries(const PlaylistEdit & edit, const int & length);
+		static void moveEntries(const PlaylistEdit & edit, const int & length);
+		static void sortEntries(const PlaylistEdit & edit, const int & length);
+		static void reverse(const int & first, const int & last);
+		static void swap(const int & from, const int & to);
+		static const char* const parseNumber(const char *argument, int & number);
+
+		int const run(PlaylistEdit & edit);
+
+	public:
+		PlaylistEditor();
+
+		bool const isEditing() const;
+
+		int const insert(const char *argument);
+		int const remove(const char *argument);
+		int const move(const char *argument);
+		int const sort(const char *argument);
+};
@@ -0,0 +1,541 @@
+#include "stdafx.h"
+
+
+// names of the modes in groups_<mode>_<start>_<count>
+static const char *modeNames[GROUP_MODES] = { "album", "artist", "albumartist" };
+
+/**
+* \brief	PlaylistGroups
+*
+* constructor
+*/
+PlaylistGroups::PlaylistGroups() {
+	pending = 0;
+	resolveCursor = 0;
+	running = 0;
+
+	for (int mode = 0; mode < GROUP_MODES; mode++)
+		layouts[mode].valid = false;
+
+	idleEvent = CreateEvent(NULL, TRUE, TRUE, NULL);
+	stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+	InitializeCriticalSection(&cs_playlistgroups);
+	InitializeCriticalSection(&cs_apply);
+}
+
+/**
+* \brief	~PlaylistGroups
+*
+* destructor
+*/
+PlaylistGroups::~PlaylistGroups() {
+	CloseHandle(idleEvent);
+	CloseHandle(stopEvent);
+
+	DeleteCriticalSection(&cs_playlistgroups);
+	DeleteCriticalSection(&cs_apply);
+}
+
+/**
+* \brief	parseMode
+*
+* \param	name	mode of a groups_ request, followed by _ or the end
+*
+* \return	GROUP_ mode, -1 if the name is unknown
+*/
+int const PlaylistGroups::parseMode(const char *name) {
+	const char *end = strchr(name, '_');
+	size_t length = end != NULL ? end - name : strlen(name);
+
+	for (int mode = 0; mode < GROUP_MODES; mode++) {
+		if (strncmp(modeNames[mode], name, length) == 0 && modeNames[mode][length] == '\0')
+			return mode;
+	}
+
+	return -1;
+}
+
+/**
+* \brief	update
+*
+* queues a change of the playlist snapshot and submits the grouping task if none is running. called by
+* PlaylistSnapshot on sendCommandThread next to PlaylistIndex::update
+*
+* \param	first	first changed position
+* \param	deleted	number of entries that have been removed at first
+* \param	range	paths of the entries inserted at first
+*/
+void PlaylistGroups::update(const unsigned int & first, const unsigned int & deleted, const PlaylistTitles & range) {
+	if (deleted == 0 && range.number == 0)
+		return;
+
+	std::vector<std::string> files(range.files);
+	files.resize(range.number);
+
+	// CRITICAL
+	EnterCriticalSection(&cs_playlistgroups);
+
+	deltas.push_back(GroupDelta());
+	deltas.back().first = first;
+	deltas.back().deleted = deleted;
+	deltas.back().files.swap(files);
+
+	bool start = running == 0;
+
+	if (start) {
+		InterlockedExchange(&running, 1);
+
+		ResetEvent(idleEvent);
+	}
+
+	LeaveCriticalSection(&cs_playlistgroups);
+	// CRITICAL END
+
+	if (start && !workpool.submit(applyFunction, this, WORK_PRIORITY_LOW)) {
+		// the pool is full or stopped, the next page applies the changes
+		InterlockedExchange(&running, 0);
+
+		SetEvent(idleEvent);
+	}
+}
+
+/**
+* \brief	apply
+*
+* applies the waiting changes in order. the metadata of the inserted entries is looked up outside of the groups section
+*/
+void PlaylistGroups::apply() {
+	// CRITICAL
+	EnterCriticalSection(&cs_apply);
+
+	while (WaitForSingleObject(stopEvent, 0) != WAIT_OBJECT_0) {
+		GroupDelta delta;
+		bool found;
+
+		// CRITICAL
+		EnterCriticalSection(&cs_playlistgroups);
+
+		found = !deltas.empty();
+
+		if (found) {
+			delta.first = deltas.front().first;
+			delta.deleted = deltas.front().deleted;
+			delta.files.swap(deltas.front().files);
+
+			deltas.pop_front();
+		}
+
+		LeaveCriticalSection(&cs_playlistgroups);
+		// CRITICAL END
+
+		if (!found)
+			break;
+
+		std::vector<Metadata*> metadata(delta.files.size());
+
+		for (unsigned int i = 0; i < metadata.size(); i++)
+			metadata[i] = metadatacache.find(delta.files[i].c_str());
+
+		// CRITICAL
+		EnterCriticalSection(&cs_playlistgroups);
+
+		applyDelta(delta, metadata);
+
+		LeaveCriticalSection(&cs_playlistgroups);
+		// CRITICAL END
+
+		for (unsigned int i = 0; i < metadata.size(); i++) {
+			if (metadata[i] != NULL)
+				metadata[i]->release();
+		}
+	}
+
+	LeaveCriticalSection(&cs_apply);
+	// CRITICAL END
+}
+
+/**
+* \brief	applyDelta
+*
+* removes the counts of the removed rows and groups the inserted ones. a playlist that is replaced as a whole drops
+* its groups. called inside the groups section
+*
+* \param	delta	change of the playlist
+* \param	found	cached metadata of the inserted entries, NULL for the ones that haven't been read
+*/
+void PlaylistGroups::applyDelta(const GroupDelta & delta, const std::vector<Metadata*> & found) {
+	unsigned int first = min(delta.first, rows.size());
+	unsigned int deleted = min(delta.deleted, rows.size() - first);
+
+	if (first == 0 && deleted == rows.size()) {
+		for (int mode = 0; mode < GROUP_MODES; mode++) {
+			groups[mode].clear();
+			keys[mode].clear();
+		}
+
+		pending = 0;
+	} else {
+		for (unsigned int i = first; i < first + deleted; i++)
+			ungroup(rows[i]);
+	}
+
+	rows.erase(rows.begin() + first, rows.begin() + first + deleted);
+	rows.insert(rows.begin() + first, found.size(), GroupRow());
+
+	for (unsigned int i = 0; i < found.size(); i++) {
+		GroupRow & row = rows[first + i];
+
+		if (found[i] != NULL)
+			group(row, found[i]);
+		else {
+			for (int mode = 0; mode < GROUP_MODES; mode++)
+				row.groups[mode] = GROUP_NONE;
+
+			row.length = 0;
+			row.path = pathtable.intern(delta.files[i]);
+
+			pending++;
+		}
+	}
+
+	invalidate();
+}
+
+/**
+* \brief	resolve
+*
+* groups up to GROUP_RESOLVE_BATCH rows whose metadata has been cached since they were inserted, e.g. by the
+* playlist scanner. the positions don't change meanwhile, no change is applied
+*/
+void PlaylistGroups::resolve() {
+	// CRITICAL
+	EnterCriticalSection(&cs_apply);
+
+	std::vector<unsigned int> positions;
+	std::vector<unsigned int> paths;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_playlistgroups);
+
+	unsigned int size = rows.size();
+	unsigned int start = resolveCursor < size ? resolveCursor : 0;
+
+	for (unsigned int n = 0; n < size && pending > 0 && positions.size() < min(pending, (unsigned int)GROUP_RESOLVE_BATCH); n++) {
+		unsigned int position = (start + n) % size;
+
+		if (rows[position].groups[0] != GROUP_NONE)
+			continue;
+
+		positions.push_back(position);
+		paths.push_back(rows[position].path);
+
+		resolveCursor = position + 1;
+	}
+
+	LeaveCriticalSection(&cs_playlistgroups);
+	// CRITICAL END
+
+	std::vector<Metadata*> found(positions.size());
+
+	for (unsigned int i = 0; i < found.size(); i++)
+		found[i] = metadatacache.find(pathtable.path(paths[i]).c_str());
+
+	// CRITICAL
+	EnterCriticalSection(&cs_playlistgroups);
+
+	for (unsigned int i = 0; i < found.size(); i++) {
+		if (found[i] == NULL)
+			continue;
+
+		group(rows[positions[i]], found[i]);
+
+		pending--;
+
+		invalidate();
+	}
+
+	LeaveCriticalSection(&cs_playlistgroups);
+	// CRITICAL END
+
+	for (unsigned int i = 0; i < found.size(); i++) {
+		if (found[i] != NULL)
+			found[i]->release();
+	}
+
+	LeaveCriticalSection(&cs_apply);
+	// CRITICAL END
+}
+
+/**
+* \brief	group
+*
+* adds a row to the group of every mode, new keys get a group. called inside the groups section
+*
+* \param	row			row of the playlist, gets its groups
+* \param	metadata	cached metadata of its file
+*/
+void PlaylistGroups::group(GroupRow & row, Metadata *metadata) {
+	bool valid = metadata->valid;
+
+	unsigned int artist = valid ? metadata->artist : STRING_POOL_EMPTY;
+	unsigned int albumArtist = valid && metadata->albumArtist != STRING_POOL_EMPTY ? metadata->albumArtist : artist;
+	unsigned int album = valid ? metadata->album : STRING_POOL_EMPTY;
+
+	unsigned long long values[GROUP_MODES] = { ((unsigned long long)albumArtist << 32) | album, artist, albumArtist };
+	unsigned int names[GROUP_MODES] = { album, artist, albumArtist };
+
+	row.length = valid && metadata->length > 0 ? metadata->length : 0;
+	row.path = PATH_TABLE_ROOT;
+
+	for (int mode = 0; mode < GROUP_MODES; mode++) {
+		std::map<unsigned long long, unsigned int>::iterator it = keys[mode].find(values[mode]);
+
+		if (it == keys[mode].end()) {
+			PlaylistGroup created = { names[mode], mode == GROUP_ALBUM ? albumArtist : STRING_POOL_EMPTY, 0, 0, std::string() };
+
+			it = keys[mode].insert(std::make_pair(values[mode], groups[mode].size())).first;
+			groups[mode].push_back(created);
+		}
+
+		PlaylistGroup & target = groups[mode][it->second];
+		target.count++;
+		target.seconds += row.length;
+
+		if (target.coverHash.empty() && metadata->hasCover)
+			target.coverHash = metadata->coverHash;
+
+		row.groups[mode] = it->second;
+	}
+}
+
+/**
+* \brief	ungroup
+*
+* removes a row from its groups. called inside the groups section
+*
+* \param	row	row that is removed from the playlist
+*/
+void PlaylistGroups::ungroup(const GroupRow & row) {
+	if (row.groups[0] == GROUP_NONE) {
+		pending--;
+
+		return;
+	}
+
+	for (int mode = 0; mode < GROUP_MODES; mode++) {
+		PlaylistGroup & target = groups[mode][row.groups[mode]];
+		target.count--;
+		target.seconds -= row.length;
+	}
+}
+
+/**
+* \brief	invalidate
+*
+* drops the layouts after a change, the next page builds them again. called inside the groups section
+*/
+void PlaylistGroups::invalidate() {
+	for (int mode = 0; mode < GROUP_MODES; mode++) {
+		layouts[mode].valid = false;
+		layouts[mode].order.clear();
+		layouts[mode].runs.clear();
+	}
+}
+
+/**
+* \brief	appendRun
+*
+* \param	runs	runs of a group, gets ",<first>-<last>" or ",<first>". the first run has no comma
+* \param	first	first position of the run
+* \param	last	last position of the run
+*/
+void PlaylistGroups::appendRun(std::string & runs, const unsigned int & first, const unsigned int & last) {
+	char run[24];
+
+	if (first == last)
+		sprintf_s(run, sizeof(run), runs.empty() ? "%u" : ",%u", first);
+	else
+		sprintf_s(run, sizeof(run), runs.empty() ? "%u-%u" : ",%u-%u", first, last);
+
+	runs.append(run);
+}
+
+/**
+* \brief	layout
+*
+* orders the groups of a mode by their first position and collects the runs of their positions with one walk over
+* the rows, unless that has been done since the last change. called inside the groups section
+*
+* \param	mode	GROUP_ mode
+*/
+void PlaylistGroups::layout(const int & mode) {
+	GroupLayout & target = layouts[mode];
+
+	if (target.valid)
+		return;
+
+	// slot of every group in the order, and the run of the slot that is still open
+	std::vector<unsigned int> slots(groups[mode].size(), GROUP_NONE);
+	std::vector<unsigned int> runFirst;
+	std::vector<unsigned int> runLast;
+
+	for (unsigned int position = 0; position < rows.size(); position++) {
+		unsigned int id = rows[position].groups[mode];
+
+		if (id == GROUP_NONE)
+			continue;
+
+		unsigned int & slot = slots[id];
+
+		if (slot == GROUP_NONE) {
+			slot = target.order.size();
+
+			target.order.push_back(id);
+			target.runs.push_back(std::string());
+			runFirst.push_back(position);
+			runLast.push_back(position);
+		} else if (runLast[slot] + 1 == position)
+			runLast[slot] = position;
+		else {
+			appendRun(target.runs[slot], runFirst[slot], runLast[slot]);
+
+			runFirst[slot] = position;
+			runLast[slot] = position;
+		}
+	}
+
+	for (unsigned int slot = 0; slot < target.order.size(); slot++)
+		appendRun(target.runs[slot], runFirst[slot], runLast[slot]);
+
+	target.valid = true;
+}
+
+/**
+* \brief	send
+*
+* performs a groups_<mode>_<start>_<count> request: "groups_<mode>_<start>_<count>_<total>_<pending>", then for every
+* group of the page group_<index> and the lines name, album artist (empty except for albums), number of entries,
+* seconds, cover hash (empty if none) and the runs of its playlist positions. the groups are ordered by their first
+* position, pending is the number of entries that aren't grouped yet. the waiting changes are applied first
+*
+* \param	mode	GROUP_ mode, the request is dropped for -1
+* \param	start	index of the first group
+* \param	count	number of requested groups, at most MAX_GROUP_PAGE
+*/
+void PlaylistGroups::send(const int & mode, const int & start, const int & count) {
+	if (mode < 0 || mode >= GROUP_MODES)
+		return;
+
+	apply();
+	resolve();
+
+	std::vector<std::string> lines;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_playlistgroups);
+
+	layout(mode);
+
+	const GroupLayout & current = layouts[mode];
+
+	int total = current.order.size();
+	int first = start < 0 ? 0 : min(start, total);
+	int number = count < 0 ? 0 : min(min(count, MAX_GROUP_PAGE), total - first);
+
+	stringstream header;
+	header << "groups_" << modeNames[mode] << "_" << first << "_" << number << "_" << total << "_" << pending;
+
+	lines.push_back(header.str());
+
+	for (int i = first; i < first + number; i++) {
+		const PlaylistGroup & item = groups[mode][current.order[i]];
+
+		stringstream index, entries, seconds;
+		index << "group_" << i;
+		entries << item.count;
+		seconds << item.seconds;
+
+		lines.push_back(index.str());
+		lines.push_back(stringpool.value(item.name));
+		lines.push_back(stringpool.value(item.artist));
+		lines.push_back(entries.str());
+		lines.push_back(seconds.str());
+		lines.push_back(item.coverHash);
+		lines.push_back(current.runs[i]);
+	}
+
+	LeaveCriticalSection(&cs_playlistgroups);
+	// CRITICAL END
+
+	for (unsigned int i = 0; i < lines.size(); i++)
+		rawSend(lines[i].c_str());
+}
+
+/**
+* \brief	stop
+*
+* stops the grouping task after the change it applies. called by quit
+*/
+void PlaylistGroups::stop() {
+	SetEvent(stopEvent);
+
+	WaitForSingleObject(idleEvent, GROUPS_STOP_TIMEOUT);
+}
+
+/**
+* \brief	report
+*
+* \param	lines	receives the number of rows and groups, see stats command
+*/
+void PlaylistGroups::report(std::vector<std::string> & lines) {
+	// CRITICAL
+	EnterCriticalSection(&cs_playlistgroups);
+
+	stringstream line;
+	line << "playlist_groups rows " << rows.size() << " pending " << pending << " albums " << groups[GROUP_ALBUM].size()
+		<< " artists " << groups[GROUP_ARTIST].size() << " album_artists " << groups[GROUP_ALBUM_ARTIST].size()
+		<< " waiting_changes " << deltas.size();
+
+	LeaveCriticalSection(&cs_playlistgroups);
+	// CRITICAL END
+
+	lines.push_back(line.str());
+}
+
+/**
+* \brief	applyFunction
+*
+* task of the playlist groups. applies the waiting changes with background priority until none is left
+*
+* \param	parameter	playlist groups
+*
+* \return	0
+*/
+DWORD WINAPI PlaylistGroups::applyFunction(LPVOID parameter) {
+	PlaylistGroups *grouping = (PlaylistGroups*)parameter;
+
+	ThreadPolicy policy(THREAD_CLASS_BACKGROUND);
+
+	while (1) {
+		grouping->apply();
+
+		// CRITICAL
+		EnterCriticalSection(&grouping->cs_playlistgroups);
+
+		bool done = grouping->deltas.empty() || WaitForSingleObject(grouping->stopEvent, 0) == WAIT_OBJECT_0;
+
+		if (done) {
+			// a later change submits a new task
+			InterlockedExchange(&grouping->running, 0);
+
+			SetEvent(grouping->idleEvent);
+		}
+
+		LeaveCriticalSection(&grouping->cs_playlistgroups);
+		// CRITICAL END
+
+		if (done)
+			return 0;
+	}
+}
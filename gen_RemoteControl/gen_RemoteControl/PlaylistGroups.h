@@ -0,0 +1,137 @@
+#pragma once
+#include "stdafx.h"
+
+// groupings of groups_<mode>_<start>_<count>: albums, artists and album artists. an album is told apart by its
+// album artist, the artist stands in for a missing one
+#define GROUP_ALBUM 0
+#define GROUP_ARTIST 1
+#define GROUP_ALBUM_ARTIST 2
+
+#define GROUP_MODES 3
+
+// group of a row whose metadata isn't cached yet
+#define GROUP_NONE 0xFFFFFFFF
+
+// maximum number of groups of one groups_ page
+#define MAX_GROUP_PAGE 200
+
+// pending rows looked up in the metadata cache per groups_ page, the lookups may ask the file system
+#define GROUP_RESOLVE_BATCH 1000
+
+// milliseconds quit waits for the grouping task
+#define GROUPS_STOP_TIMEOUT 5000
+
+
+// change of the playlist as sendChanges has seen it: entries replaced from a position on
+struct GroupDelta {
+	unsigned int first;
+
+	// number of entries that have been removed at first
+	unsigned int deleted;
+
+	// paths of the entries inserted at first
+	std::vector<std::string> files;
+};
+
+
+// playlist entry as the grouping knows it
+struct GroupRow {
+	// group of every mode, GROUP_NONE while the metadata of the file isn't cached
+	unsigned int groups[GROUP_MODES];
+
+	// seconds, 0 if unknown
+	int length;
+
+	// id in pathtable of the file while the row waits for its metadata, PATH_TABLE_ROOT once it is grouped
+	unsigned int path;
+};
+
+
+// entries of the playlist that share an album, an artist or an album artist
+struct PlaylistGroup {
+	// values in stringpool: name of the group and the album artist of an album
+	unsigned int name;
+	unsigned int artist;
+
+	// entries and their seconds, a group without entries isn't sent
+	unsigned int count;
+	long long seconds;
+
+	// cover of the first entry that has one, empty if none has
+	std::string coverHash;
+};
+
+
+// order of the groups of one mode and the playlist positions of every group, built when a page is asked for
+// after a change
+struct GroupLayout {
+	bool valid;
+
+	// groups with entries by their first position in the playlist
+	std::vector<unsigned int> order;
+
+	// positions of every group as runs "<first>-<last>" or "<position>" separated by commas
+	std::vector<std::string> runs;
+};
+
+
+// the current playlist grouped by album, artist and album artist with the number of entries, their length and a
+// cover per group, so a client shows the grouped playlist from a few groups_ pages instead of a rows_ request for
+// every entry. the changes of sendChanges are applied in the background by a low priority task like the ones of
+// PlaylistIndex, each one adds and removes the counts of its rows only. the metadata is taken from the metadata
+// cache, entries that haven't been read are grouped by a later page that finds them there, GROUP_RESOLVE_BATCH per
+// page. a tag edit shows when winamp reports the entry as changed
+class PlaylistGroups {
+	private:
+		std::vector<GroupRow> rows;
+
+		// rows waiting for their metadata, and the position the next page looks for them from
+		unsigned int pending;
+		unsigned int resolveCursor;
+
+		// groups of every mode by id, and their ids by key. a group keeps its id when its entries are removed
+		std::vector<PlaylistGroup> groups[GROUP_MODES];
+		std::map<unsigned long long, unsigned int> keys[GROUP_MODES];
+
+		GroupLayout layouts[GROUP_MODES];
+
+		// changes that haven't been applied yet, oldest first
+		std::deque<GroupDelta> deltas;
+
+		// 1 while a task of the work pool applies the changes
+		volatile LONG running;
+
+		// set while no task runs
+		HANDLE idleEvent;
+		HANDLE stopEvent;
+
+		// critical playlist groups section, guards the rows and groups
+		CRITICAL_SECTION cs_playlistgroups;
+
+		// only one thread applies the changes at a time, so they keep their order
+		CRITICAL_SECTION cs_apply;
+
+		static DWORD WINAPI applyFunction(LPVOID parameter);
+		static void appendRun(std::string & runs, const unsigned int & first, const unsigned int & last);
+
+		void apply();
+		void resolve();
+		void applyDelta(const GroupDelta & delta, const std::vector<Metadata*> & found);
+		void group(GroupRow & row, Metadata *metadata);
+		void ungroup(const GroupRow & row);
+		void invalidate();
+		void layout(const int & mode);
+
+	public:
+		PlaylistGroups();
+
+		~PlaylistGroups();
+
+		static int const parseMode(const char *name);
+
+		void update(const unsigned int & first, const unsigned int & deleted, const PlaylistTitles & range);
+		void send(const int & mode, const int & start, const int & count);
+
+		void stop();
+		void report(std::vector<std::string> & lines);
+};
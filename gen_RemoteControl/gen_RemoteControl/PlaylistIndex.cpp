@@ -0,0 +1,517 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	PlaylistIndex
+*
+* constructor
+*/
+PlaylistIndex::PlaylistIndex() {
+	removed = 0;
+	running = 0;
+
+	idleEvent = CreateEvent(NULL, TRUE, TRUE, NULL);
+	stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+	InitializeCriticalSection(&cs_playlistindex);
+	InitializeCriticalSection(&cs_apply);
+}
+
+/**
+* \brief	~PlaylistIndex
+*
+* destructor
+*/
+PlaylistIndex::~PlaylistIndex() {
+	CloseHandle(idleEvent);
+	CloseHandle(stopEvent);
+
+	DeleteCriticalSection(&cs_playlistindex);
+	DeleteCriticalSection(&cs_apply);
+}
+
+/**
+* \brief	fold
+*
+* \param	text	UTF8 text
+* \param	length	number of bytes of the text
+*
+* \return	lower case UTF8 text, folded like the comparisons of the media library
+*/
+std::string const PlaylistIndex::fold(const char *text, const int & length) {
+	std::string folded;
+
+	if (length <= 0)
+		return folded;
+
+	int wideLength = MultiByteToWideChar(CP_UTF8, 0, text, length, NULL, 0);
+
+	if (wideLength <= 0)
+		return folded;
+
+	std::vector<wchar_t> buffer(wideLength);
+	MultiByteToWideChar(CP_UTF8, 0, text, length, &buffer[0], wideLength);
+
+	CharLowerBuffW(&buffer[0], wideLength);
+
+	utf8_append(folded, &buffer[0], wideLength);
+
+	return folded;
+}
+
+/**
+* \brief	splitWords
+*
+* \param	text	lower case UTF8 query
+* \param	words	receives the words separated by spaces, newlines can't be part of a word
+*/
+void PlaylistIndex::splitWords(const std::string & text, std::vector<std::string> & words) {
+	unsigned int start = 0;
+
+	for (unsigned int i = 0; i <= text.length(); i++) {
+		if (i < text.length() && text[i] != ' ' && text[i] != '\n')
+			continue;
+
+		if (i > start)
+			words.push_back(text.substr(start, i - start));
+
+		start = i + 1;
+	}
+}
+
+/**
+* \brief	update
+*
+* queues a change of the playlist snapshot and submits the index task if none is running. called by
+* PlaylistSnapshot::updateTitles on sendCommandThread, the titles have been encoded there already
+*
+* \param	first	first changed position
+* \param	deleted	number of entries that have been removed at first
+* \param	range	titles and paths of the entries inserted at first
+*/
+void PlaylistIndex::update(const unsigned int & first, const unsigned int & deleted, const PlaylistTitles & range) {
+	if (deleted == 0 && range.number == 0)
+		return;
+
+	IndexDelta delta;
+	delta.first = first;
+	delta.deleted = deleted;
+	delta.titles.reserve(range.number);
+
+	for (unsigned int i = 0; i < range.number; i++)
+		delta.titles.push_back(range.data.c_str() + range.offsets[i]);
+
+	delta.files = range.files;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_playlistindex);
+
+	deltas.push_back(IndexDelta());
+	deltas.back().first = delta.first;
+	deltas.back().deleted = delta.deleted;
+	deltas.back().titles.swap(delta.titles);
+	deltas.back().files.swap(delta.files);
+
+	bool start = running == 0;
+
+	if (start) {
+		InterlockedExchange(&running, 1);
+
+		ResetEvent(idleEvent);
+	}
+
+	LeaveCriticalSection(&cs_playlistindex);
+	// CRITICAL END
+
+	if (start && !workpool.submit(applyFunction, this, WORK_PRIORITY_LOW)) {
+		// the pool is full or stopped, the next query applies the changes
+		InterlockedExchange(&running, 0);
+
+		SetEvent(idleEvent);
+	}
+}
+
+/**
+* \brief	apply
+*
+* applies the waiting changes in order. the texts of the inserted entries are built outside of the index section,
+* the artists and albums are only taken from the metadata cache, files that haven't been read are indexed by their title
+*/
+void PlaylistIndex::apply() {
+	// CRITICAL
+	EnterCriticalSection(&cs_apply);
+
+	while (WaitForSingleObject(stopEvent, 0) != WAIT_OBJECT_0) {
+		IndexDelta delta;
+		bool found;
+
+		// CRITICAL
+		EnterCriticalSection(&cs_playlistindex);
+
+		found = !deltas.empty();
+
+		if (found) {
+			delta.first = deltas.front().first;
+			delta.deleted = deltas.front().deleted;
+			delta.titles.swap(deltas.front().titles);
+			delta.files.swap(deltas.front().files);
+
+			deltas.pop_front();
+		}
+
+		LeaveCriticalSection(&cs_playlistindex);
+		// CRITICAL END
+
+		if (!found)
+			break;
+
+		std::vector<IndexEntry> inserted(delta.titles.size());
+
+		for (unsigned int i = 0; i < inserted.size(); i++) {
+			IndexEntry & entry = inserted[i];
+			entry.text = fold(delta.titles[i].c_str(), delta.titles[i].length());
+			entry.titleLength = entry.text.length();
+			entry.live = true;
+
+			Metadata *metadata = i < delta.files.size() ? metadatacache.find(delta.files[i].c_str()) : NULL;
+
+			if (metadata == NULL)
+				continue;
+
+			if (metadata->valid) {
+				unsigned int fields[2] = { metadata->artist, metadata->album };
+
+				for (int j = 0; j < 2; j++) {
+					entry.text.push_back('\n');
+					entry.text.append(fold(stringpool.value(fields[j]), stringpool.length(fields[j])));
+				}
+			}
+
+			metadata->release();
+		}
+
+		// CRITICAL
+		EnterCriticalSection(&cs_playlistindex);
+
+		applyDelta(delta, inserted);
+
+		LeaveCriticalSection(&cs_playlistindex);
+		// CRITICAL END
+	}
+
+	LeaveCriticalSection(&cs_apply);
+	// CRITICAL END
+}
+
+/**
+* \brief	applyDelta
+*
+* marks the removed entries and adds the inserted ones with new ids. called inside the index section
+*
+* \param	delta		change of the playlist
+* \param	inserted	texts of the inserted entries, they are moved into the index
+*/
+void PlaylistIndex::applyDelta(const IndexDelta & delta, std::vector<IndexEntry> & inserted) {
+	unsigned int first = min(delta.first, ids.size());
+	unsigned int deleted = min(delta.deleted, ids.size() - first);
+
+	for (unsigned int i = first; i < first + deleted; i++) {
+		entries[ids[i]].live = false;
+		entries[ids[i]].text.clear();
+	}
+
+	removed += deleted;
+
+	std::vector<unsigned int> added;
+	added.reserve(inserted.size());
+
+	for (unsigned int i = 0; i < inserted.size(); i++) {
+		added.push_back(entries.size());
+
+		entries.push_back(IndexEntry());
+		entries.back().text.swap(inserted[i].text);
+		entries.back().titleLength = inserted[i].titleLength;
+		entries.back().live = true;
+
+		addPostings(added.back());
+	}
+
+	ids.erase(ids.begin() + first, ids.begin() + first + deleted);
+	ids.insert(ids.begin() + first, added.begin(), added.end());
+
+	if (removed > INDEX_COMPACT_MINIMUM && removed > ids.size())
+		compact();
+}
+
+/**
+* \brief	addPostings
+*
+* adds an entry to the postings of its trigrams. its id is larger than every id in the postings, every trigram
+* is added once. called inside the index section
+*
+* \param	id	id of the entry
+*/
+void PlaylistIndex::addPostings(const unsigned int & id) {
+	const std::string & text = entries[id].text;
+
+	for (unsigned int i = 0; i + 3 <= text.length(); i++) {
+		if (text[i] == '\n' || text[i + 1] == '\n' || text[i + 2] == '\n')
+			continue;
+
+		unsigned int trigram = ((unsigned char)text[i] << 16) | ((unsigned char)text[i + 1] << 8) | (unsigned char)text[i + 2];
+
+		std::vector<unsigned int> & list = postings[trigram];
+
+		if (list.empty() || list.back() != id)
+			list.push_back(id);
+	}
+}
+
+/**
+* \brief	compact
+*
+* numbers the entries of the playlist again in their order and builds the postings without the removed ones.
+* called inside the index section
+*/
+void PlaylistIndex::compact() {
+	std::vector<IndexEntry> live(ids.size());
+
+	for (unsigned int i = 0; i < ids.size(); i++) {
+		live[i].text.swap(entries[ids[i]].text);
+		live[i].titleLength = entries[ids[i]].titleLength;
+		live[i].live = true;
+
+		ids[i] = i;
+	}
+
+	entries.swap(live);
+	removed = 0;
+
+	postings.clear();
+
+	for (unsigned int i = 0; i < entries.size(); i++)
+		addPostings(i);
+}
+
+/**
+* \brief	rarest
+*
+* \param	word	lower case UTF8 word of at least three bytes
+*
+* \return	shortest postings of the trigrams of the word, every entry containing the word is in them. NULL if a trigram is unknown
+*/
+const std::vector<unsigned int>* const PlaylistIndex::rarest(const std::string & word) {
+	const std::vector<unsigned int> *shortest = NULL;
+
+	for (unsigned int i = 0; i + 3 <= word.length(); i++) {
+		unsigned int trigram = ((unsigned char)word[i] << 16) | ((unsigned char)word[i + 1] << 8) | (unsigned char)word[i + 2];
+
+		std::map<unsigned int, std::vector<unsigned int> >::const_iterator it = postings.find(trigram);
+
+		if (it == postings.end())
+			return NULL;
+
+		if (shortest == NULL || it->second.size() < shortest->size())
+			shortest = &it->second;
+	}
+
+	return shortest;
+}
+
+/**
+* \brief	score
+*
+* \param	entry	entry of the index
+* \param	word	lower case UTF8 word
+*
+* \return	INDEX_SCORE_ of the best place the word is found at, 0 if the entry doesn't contain it
+*/
+unsigned int const PlaylistIndex::score(const IndexEntry & entry, const std::string & word) {
+	unsigned int best = 0;
+	std::string::size_type offset = entry.text.find(word);
+
+	while (offset != std::string::npos && best < INDEX_SCORE_TITLE_START) {
+		// bytes of multi byte characters are letters
+		unsigned char before = offset > 0 ? entry.text[offset - 1] : ' ';
+		bool boundary = before < 0x80 && !isalnum(before);
+		bool title = offset < entry.titleLength;
+
+		unsigned int value;
+
+		if (title)
+			value = offset == 0 ? INDEX_SCORE_TITLE_START : (boundary ? INDEX_SCORE_TITLE_WORD : INDEX_SCORE_TITLE);
+		else
+			value = boundary ? INDEX_SCORE_FIELD_WORD : INDEX_SCORE_FIELD;
+
+		best = max(best, value);
+		offset = entry.text.find(word, offset + 1);
+	}
+
+	return best;
+}
+
+/**
+* \brief	find
+*
+* performs a find_ command: the playlist positions whose title, artist or album contains every word of the text.
+* the waiting changes are applied first. only the entries in the shortest postings of the rarest trigram of the
+* words are compared, words shorter than three bytes are compared with every entry
+*
+* \param	text		words separated by spaces
+* \param	maximum		number of positions returned at most
+* \param	positions	receives the positions of the best matches, ordered by score and position
+*
+* \return	number of all matches
+*/
+int const PlaylistIndex::find(const std::wstring & text, const unsigned int & maximum, std::vector<unsigned int> & positions) {
+	std::string query = utf8_encode(text);
+	std::vector<std::string> words;
+
+	splitWords(fold(query.c_str(), query.length()), words);
+
+	if (words.empty())
+		return 0;
+
+	apply();
+
+	std::vector<IndexMatch> matches;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_playlistindex);
+
+	const std::vector<unsigned int> *candidates = NULL;
+	bool unknown = false;
+
+	for (unsigned int i = 0; i < words.size() && !unknown; i++) {
+		if (words[i].length() < 3)
+			continue;
+
+		const std::vector<unsigned int> *postings = rarest(words[i]);
+
+		if (postings == NULL)
+			unknown = true;
+		else if (candidates == NULL || postings->size() < candidates->size())
+			candidates = postings;
+	}
+
+	std::vector<bool> marked;
+
+	if (candidates != NULL) {
+		marked.resize(entries.size(), false);
+
+		for (unsigned int i = 0; i < candidates->size(); i++)
+			marked[(*candidates)[i]] = true;
+	}
+
+	for (unsigned int position = 0; position < ids.size() && !unknown; position++) {
+		if (candidates != NULL && !marked[ids[position]])
+			continue;
+
+		const IndexEntry & entry = entries[ids[position]];
+		IndexMatch match = { position, 0 };
+
+		for (unsigned int i = 0; i < words.size(); i++) {
+			unsigned int value = score(entry, words[i]);
+
+			if (value == 0) {
+				match.score = 0;
+				break;
+			}
+
+			match.score += value;
+		}
+
+		if (match.score > 0)
+			matches.push_back(match);
+	}
+
+	LeaveCriticalSection(&cs_playlistindex);
+	// CRITICAL END
+
+	unsigned int count = min(maximum, matches.size());
+
+	std::partial_sort(matches.begin(), matches.begin() + count, matches.end());
+
+	positions.reserve(count);
+
+	for (unsigned int i = 0; i < count; i++)
+		positions.push_back(matches[i].position);
+
+	return matches.size();
+}
+
+/**
+* \brief	stop
+*
+* stops the index task after the change it applies. called by quit
+*/
+void PlaylistIndex::stop() {
+	SetEvent(stopEvent);
+
+	WaitForSingleObject(idleEvent, INDEX_STOP_TIMEOUT);
+}
+
+/**
+* \brief	report
+*
+* \param	lines	receives the size of the index, see stats command
+*/
+void PlaylistIndex::report(std::vector<std::string> & lines) {
+	// CRITICAL
+	EnterCriticalSection(&cs_playlistindex);
+
+	unsigned long long textBytes = 0;
+	unsigned long long postingBytes = 0;
+
+	for (unsigned int i = 0; i < entries.size(); i++)
+		textBytes += entries[i].text.length();
+
+	for (std::map<unsigned int, std::vector<unsigned int> >::const_iterator it = postings.begin(); it != postings.end(); it++)
+		postingBytes += it->second.size() * sizeof(unsigned int);
+
+	stringstream line;
+	line << "playlist_index entries " << ids.size() << " removed " << removed << " trigrams " << postings.size()
+		<< " text_bytes " << textBytes << " posting_bytes " << postingBytes << " waiting_changes " << deltas.size();
+
+	LeaveCriticalSection(&cs_playlistindex);
+	// CRITICAL END
+
+	lines.push_back(line.str());
+}
+
+/**
+* \brief	applyFunction
+*
+* task of the playlist index. applies the waiting changes with background priority until none is left
+*
+* \param	parameter	playlist index
+*
+* \return	0
+*/
+DWORD WINAPI PlaylistIndex::applyFunction(LPVOID parameter) {
+	PlaylistIndex *index = (PlaylistIndex*)parameter;
+
+	ThreadPolicy policy(THREAD_CLASS_BACKGROUND);
+
+	while (1) {
+		index->apply();
+
+		// CRITICAL
+		EnterCriticalSection(&index->cs_playlistindex);
+
+		bool done = index->deltas.empty() || WaitForSingleObject(index->stopEvent, 0) == WAIT_OBJECT_0;
+
+		if (done) {
+			// a later change submits a new task
+			InterlockedExchange(&index->running, 0);
+
+			SetEvent(index->idleEvent);
+		}
+
+		LeaveCriticalSection(&index->cs_playlistindex);
+		// CRITICAL END
+
+		if (done)
+			return 0;
+	}
+}
@@ -0,0 +1,110 @@
+#pragma once
+#include "stdafx.h"
+
+// positions a find_ query returns at most, the matches behind them are only counted
+#define INDEX_MAX_RESULTS 200
+
+// removed entries above which the postings are built again, as long as they are more than the entries that are left
+#define INDEX_COMPACT_MINIMUM 4096
+
+// milliseconds quit waits for the index task
+#define INDEX_STOP_TIMEOUT 5000
+
+// scores of a word of a find_ query, the best place it is found counts. title before artist and album
+#define INDEX_SCORE_TITLE_START 8	// the title begins with the word
+#define INDEX_SCORE_TITLE_WORD 4	// a word of the title begins with it
+#define INDEX_SCORE_TITLE 2			// somewhere inside the title
+#define INDEX_SCORE_FIELD_WORD 2	// a word of the artist or album begins with it
+#define INDEX_SCORE_FIELD 1			// somewhere inside the artist or album
+
+
+// change of the playlist as sendChanges has seen it: entries replaced from a position on
+struct IndexDelta {
+	unsigned int first;
+
+	// number of entries that have been removed at first
+	unsigned int deleted;
+
+	// UTF8 titles and paths of the entries inserted at first
+	std::vector<std::string> titles;
+	std::vector<std::string> files;
+};
+
+
+// searchable text of one playlist entry: lower case UTF8 title, artist and album separated by \n
+struct IndexEntry {
+	std::string text;
+
+	// bytes of the title at the beginning of text
+	unsigned int titleLength;
+
+	// false once the entry has been removed from the playlist, its id stays in the postings until they are compacted
+	bool live;
+};
+
+
+// match of a find_ query
+struct IndexMatch {
+	unsigned int position;
+	unsigned int score;
+
+	bool operator<(const IndexMatch & other) const {
+		return score != other.score ? score > other.score : position < other.position;
+	}
+};
+
+
+// trigram index over the titles of the playlist snapshot and the artists and albums of the metadata cache. the
+// changes of sendChanges are applied in the background by a low priority task, a query applies the waiting ones
+// first. every entry has an id that doesn't change when entries before it are inserted or removed, the postings
+// of a trigram are the ids in ascending order. removed ids are only marked and dropped when the postings are compacted
+class PlaylistIndex {
+	private:
+		// id of the entry of every playlist position
+		std::vector<unsigned int> ids;
+
+		// entries by id
+		std::vector<IndexEntry> entries;
+		unsigned int removed;
+
+		// ids of the entries that contain a trigram, by its three bytes
+		std::map<unsigned int, std::vector<unsigned int> > postings;
+
+		// changes that haven't been applied yet, oldest first
+		std::deque<IndexDelta> deltas;
+
+		// 1 while a task of the work pool applies the changes
+		volatile LONG running;
+
+		// set while no task runs
+		HANDLE idleEvent;
+		HANDLE stopEvent;
+
+		// critical playlist index section, guards the entries and postings
+		CRITICAL_SECTION cs_playlistindex;
+
+		// only one thread applies the changes at a time, so they keep their order
+		CRITICAL_SECTION cs_apply;
+
+		static DWORD WINAPI applyFunction(LPVOID parameter);
+		static std::string const fold(const char *text, const int & length);
+		static void splitWords(const std::string & text, std::vector<std::string> & words);
+		static unsigned int const score(const IndexEntry & entry, const std::string & word);
+
+		void apply();
+		void applyDelta(const IndexDelta & delta, std::vector<IndexEntry> & inserted);
+		void addPostings(const unsigned int & id);
+		void compact();
+		const std::vector<unsigned int>* const rarest(const std::string & word);
+
+	public:
+		PlaylistIndex();
+
+		~PlaylistIndex();
+
+		void update(const unsigned int & first, const unsigned int & deleted, const PlaylistTitles & range);
+		int const find(const std::wstring & text, const unsigned int & maximum, std::vector<unsigned int> & positions);
+
+		void stop();
+		void report(std::vector<std::string> & lines);
+};
@@ -0,0 +1,185 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	PlaylistScanner
+*
+* constructor
+*/
+PlaylistScanner::PlaylistScanner() {
+	next = 0;
+	scanned = 0;
+
+	for (int i = 0; i < SCAN_THREADS; i++)
+		threads[i] = NULL;
+
+	stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+}
+
+/**
+* \brief	~PlaylistScanner
+*
+* destructor
+*/
+PlaylistScanner::~PlaylistScanner() {
+	CloseHandle(stopEvent);
+}
+
+/**
+* \brief	readFiles
+*
+* copies the file names of the playlist. run on the winamp thread by WinampState::invoke
+*
+* \param	parameter	std::vector<std::string> that receives the file names
+*/
+void PlaylistScanner::readFiles(void *parameter) {
+	std::vector<std::string> *files = (std::vector<std::string>*)parameter;
+
+	files->clear();
+
+	int length = SendMessage(plugin.hwndParent,WM_WA_IPC,0,IPC_GETLISTLENGTH);
+
+	for (int i = 0; i < length; i++) {
+		const char *file = (char*)SendMessage(plugin.hwndParent,WM_WA_IPC,i,IPC_GETPLAYLISTFILE);
+
+		if (file != NULL)
+			files->push_back(std::string(file));
+	}
+}
+
+/**
+* \brief	start
+*
+* starts reading the metadata of every playlist entry into the metadata cache in the background.
+* files already in the cache are only checked. does nothing if a scan is running or scanbudget is 0
+*/
+void PlaylistScanner::start() {
+	if (scanbudget <= 0)
+		return;
+
+	for (int i = 0; i < SCAN_THREADS; i++) {
+		if (threads[i] != NULL && WaitForSingleObject(threads[i], 0) == WAIT_TIMEOUT)
+			return;
+	}
+
+	// handles of the last scan
+	stop();
+
+	// one call on the winamp thread instead of one message per entry
+	winampstate.invoke(readFiles, &files);
+
+	if (files.empty())
+		return;
+
+	next = 0;
+	scanned = 0;
+
+	ResetEvent(stopEvent);
+
+	for (int i = 0; i < SCAN_THREADS; i++)
+		threads[i] = CreateThread(NULL, 0, scanFunction, this, 0, NULL);
+
+	showProgress();
+}
+
+/**
+* \brief	stop
+*
+* stops the scan and waits for the threads. a thread still parsing a file on a slow share keeps its handle,
+* so no new scan is started before it has returned
+*/
+void PlaylistScanner::stop() {
+	SetEvent(stopEvent);
+
+	for (int i = 0; i < SCAN_THREADS; i++)
+		joinThread(threads[i], 2000);
+}
+
+/**
+* \brief	throttle
+*
+* waits before the next file so the scan stays within scanbudget files per second.
+* while winamp plays a file from the same disk, only one file is read every SCAN_PAUSE milliseconds
+*
+* \param	file	next file to read
+*
+* \return	false if the scan has been stopped
+*/
+bool const PlaylistScanner::throttle(const std::string & file) {
+	if (WaitForSingleObject(stopEvent, SCAN_THREADS * 1000 / scanbudget) != WAIT_TIMEOUT)
+		return false;
+
+	if (winampstate.getIsPlaying() == 1) {
+		const char *playing = (char*)SendMessage(plugin.hwndParent,WM_WA_IPC,winampstate.getListPosition(),IPC_GETPLAYLISTFILE);
+
+		char playingVolume[MAX_PATH];
+		char fileVolume[MAX_PATH];
+
+		if (playing != NULL && GetVolumePathNameA(playing, playingVolume, MAX_PATH) != 0 && GetVolumePathNameA(file.c_str(), fileVolume, MAX_PATH) != 0
+			&& _stricmp(playingVolume, fileVolume) == 0)
+			return WaitForSingleObject(stopEvent, SCAN_PAUSE) == WAIT_TIMEOUT;
+	}
+
+	return true;
+}
+
+/**
+* \brief	showProgress
+*
+* shows the number of scanned files in the UI
+*/
+void PlaylistScanner::showProgress() {
+	int count = scanned;
+	int total = files.size();
+
+	stringstream scanStream;
+
+	if (count >= total)
+		scanStream << "Metadata: " << total << " files";
+	else
+		scanStream << "Metadata: " << count << " / " << total;
+
+	UIManager::setScanText(scanStream.str());
+}
+
+/**
+* \brief	scanFunction
+*
+* thread of the scan. takes the next file of the list and reads it into the metadata cache with background priority
+* and within the budget of the resource governor, so disk and network access of the playback come first
+*
+* \param	parameter	scanner
+*
+* \return	0
+*/
+DWORD WINAPI PlaylistScanner::scanFunction(LPVOID parameter) {
+	PlaylistScanner *scanner = (PlaylistScanner*)parameter;
+
+	// low cpu and i/o priority
+	ThreadPolicy policy(THREAD_CLASS_BACKGROUND);
+
+	LONG index;
+
+	while ((index = InterlockedIncrement(&scanner->next) - 1) < (LONG)scanner->files.size()) {
+		const std::string & file = scanner->files[index];
+
+		if (!scanner->throttle(file))
+			break;
+
+		GovernorToken token(GOVERNOR_SCAN, scanner->stopEvent);
+
+		if (!token.granted)
+			break;
+
+		metadatacache.prefetch(file.c_str());
+
+		token.addIo(GOVERNOR_TAG_BYTES);
+
+		LONG count = InterlockedIncrement(&scanner->scanned);
+
+		if (count % SCAN_PROGRESS_STEP == 0 || count == (LONG)scanner->files.size())
+			scanner->showProgress();
+	}
+
+	return 0;
+}
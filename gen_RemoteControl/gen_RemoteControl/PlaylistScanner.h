@@ -0,0 +1,37 @@
+#pragma once
+#include "stdafx.h"
+
+// number of threads parsing files
+#define SCAN_THREADS 2
+
+// milliseconds between two files while winamp plays from the same disk
+#define SCAN_PAUSE 10000
+
+// number of files between two progress updates of the UI
+#define SCAN_PROGRESS_STEP 25
+
+
+class PlaylistScanner {
+	private:
+		// files of the playlist when the scan was started
+		std::vector<std::string> files;
+		volatile LONG next;
+		volatile LONG scanned;
+
+		HANDLE threads[SCAN_THREADS];
+		HANDLE stopEvent;
+
+		static void readFiles(void *parameter);
+		static DWORD WINAPI scanFunction(LPVOID parameter);
+
+		bool const throttle(const std::string & file);
+		void showProgress();
+
+	public:
+		PlaylistScanner();
+
+		~PlaylistScanner();
+
+		void start();
+		void stop();
+};
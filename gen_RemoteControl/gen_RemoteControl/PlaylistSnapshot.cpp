@@ -0,0 +1,1191 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	PlaylistSnapshot
+*
+* constructor
+*/
+PlaylistSnapshot::PlaylistSnapshot() {
+	stale = 1;
+	fingerprint = hashPair(FINGERPRINT_EDGE, FINGERPRINT_EDGE);
+	announced = fingerprint;
+
+	unusedBytes = 0;
+	unresolved = 0;
+	resolveCursor = 0;
+	generation = 0;
+
+	resolving = 0;
+	readyBatch = NULL;
+	recheck = 0;
+	tagChanges = 0;
+
+	segmentsEncoding = 0;
+	segmentEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+	InitializeCriticalSection(&cs_playlist);
+}
+
+/**
+* \brief	~PlaylistSnapshot
+*
+* destructor
+*/
+PlaylistSnapshot::~PlaylistSnapshot() {
+	delete readyBatch;
+
+	dropImage();
+
+	CloseHandle(segmentEvent);
+
+	DeleteCriticalSection(&cs_playlist);
+}
+
+/**
+* \brief	hashEntry
+*
+* FNV-1a hash of the file name of a playlist entry. the title isn't asked, winamp would read every file
+* it hasn't shown yet
+*
+* \param	position	playlist position
+*
+* \return	hash
+*/
+unsigned int const PlaylistSnapshot::hashEntry(const int & position) {
+	unsigned int hash = 2166136261U;
+
+	const wchar_t *file = (wchar_t*)SendMessage(plugin.hwndParent,WM_WA_IPC,position,IPC_GETPLAYLISTFILEW);
+
+	if (file != NULL) {
+		for (const wchar_t *c = file; *c != L'\0'; c++) {
+			hash ^= (unsigned int)*c;
+			hash *= 16777619U;
+		}
+	}
+
+	return hash;
+}
+
+/**
+* \brief	hashTitle
+*
+* 64 bit FNV-1a hash of an entry and its title, the part of one entry in the fingerprint
+*
+* \param	entry	hash of the entry, see hashEntry
+* \param	title	UTF8 title
+*
+* \return	hash
+*/
+unsigned long long const PlaylistSnapshot::hashTitle(const unsigned int & entry, const char *title) {
+	unsigned long long hash = 14695981039346656037ULL;
+
+	for (int shift = 0; shift < 32; shift += 8) {
+		hash ^= (entry >> shift) & 0xFF;
+		hash *= 1099511628211ULL;
+	}
+
+	for (const char *c = title; *c != '\0'; c++) {
+		hash ^= (unsigned char)*c;
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+/**
+* \brief	hashPair
+*
+* mixes the hashes of two neighbouring entries, the order counts. a move changes the pairs around the entry
+*
+* \param	previous	hash of the first entry, FINGERPRINT_EDGE before the first one of the playlist
+* \param	next		hash of the second entry, FINGERPRINT_EDGE behind the last one
+*
+* \return	hash of the pair
+*/
+unsigned long long const PlaylistSnapshot::hashPair(const unsigned long long & previous, const unsigned long long & next) {
+	unsigned long long hash = previous * 0x9E3779B97F4A7C15ULL + next;
+
+	hash ^= hash >> 30;
+	hash *= 0xBF58476D1CE4E5B9ULL;
+	hash ^= hash >> 27;
+	hash *= 0x94D049BB133111EBULL;
+	hash ^= hash >> 31;
+
+	return hash;
+}
+
+/**
+* \brief	sumPairs
+*
+* adds the hashes of the pairs first to last. pair i is the one of entry i - 1 and entry i, pair entries.size() the
+* last entry and the edge
+*
+* \param	entries	hash of every entry, see hashTitle
+* \param	first	first pair
+* \param	last	last pair
+*
+* \return	sum of the pairs
+*/
+unsigned long long const PlaylistSnapshot::sumPairs(const std::vector<unsigned long long> & entries, const unsigned int & first, const unsigned int & last) {
+	unsigned long long sum = 0;
+
+	for (unsigned int i = first; i <= last; i++)
+		sum += hashPair(i > 0 ? entries[i - 1] : FINGERPRINT_EDGE, i < entries.size() ? entries[i] : FINGERPRINT_EDGE);
+
+	return sum;
+}
+
+/**
+* \brief	replaceEntries
+*
+* replaces the hashes of count entries from first by new ones and updates the fingerprint with the pairs that have
+* changed. the rest of the playlist isn't read, however long it is
+*
+* \param	first	first replaced entry
+* \param	count	number of replaced entries
+* \param	entries	hashes of the new entries, see hashTitle
+*/
+void PlaylistSnapshot::replaceEntries(const unsigned int & first, const unsigned int & count, const std::vector<unsigned long long> & entries) {
+	fingerprint -= sumPairs(entryHashes, first, first + count);
+
+	if (count == entries.size())
+		std::copy(entries.begin(), entries.end(), entryHashes.begin() + first);
+	else {
+		entryHashes.erase(entryHashes.begin() + first, entryHashes.begin() + first + count);
+		entryHashes.insert(entryHashes.begin() + first, entries.begin(), entries.end());
+	}
+
+	fingerprint += sumPairs(entryHashes, first, first + entries.size());
+}
+
+/**
+* \brief	appendPlaceholder
+*
+* appends the title an entry has until winamp is asked: the file name without directory and extension
+*
+* \param	target	string the UTF8 title is appended to
+* \param	file	path or URL of the entry, NULL if unknown
+*/
+void PlaylistSnapshot::appendPlaceholder(std::string & target, const wchar_t *file) {
+	if (file == NULL)
+		return;
+
+	const wchar_t *name = file;
+
+	for (const wchar_t *c = file; *c != L'\0'; c++) {
+		if (*c == L'\\' || *c == L'/')
+			name = c + 1;
+	}
+
+	// URL of a directory of a server
+	if (*name == L'\0')
+		name = file;
+
+	const wchar_t *extension = wcsrchr(name, L'.');
+
+	if (extension == NULL || extension == name)
+		extension = name + wcslen(name);
+
+	utf8_append(target, name, extension - name);
+}
+
+/**
+* \brief	readFunction
+*
+* hashes the current winamp playlist. run on the winamp thread by WinampState::invoke
+*
+* \param	parameter	std::vector<unsigned int> that receives one hash per entry
+*/
+void PlaylistSnapshot::readFunction(void *parameter) {
+	std::vector<unsigned int> & current = *(std::vector<unsigned int>*)parameter;
+
+	int length = SendMessage(plugin.hwndParent,WM_WA_IPC,0,IPC_GETLISTLENGTH);
+
+	current.clear();
+	current.reserve(length);
+
+	for (int i = 0; i < length; i++)
+		current.push_back(hashEntry(i));
+}
+
+/**
+* \brief	readTitlesFunction
+*
+* encodes the titles of a range of playlist entries and takes their paths. run on the winamp thread by WinampState::invoke
+*
+* \param	parameter	PlaylistTitles that receives the titles or placeholders and the paths, missing ones are empty
+*/
+void PlaylistSnapshot::readTitlesFunction(void *parameter) {
+	PlaylistTitles & range = *(PlaylistTitles*)parameter;
+
+	range.offsets.reserve(range.number);
+	range.files.reserve(range.number);
+
+	for (unsigned int i = 0; i < range.number; i++) {
+		range.offsets.push_back(range.data.length());
+
+		if (range.placeholders)
+			appendPlaceholder(range.data, (wchar_t*)SendMessage(plugin.hwndParent,WM_WA_IPC,range.first + i,IPC_GETPLAYLISTFILEW));
+		else {
+			wchar_t *title = (wchar_t*)SendMessage(plugin.hwndParent,WM_WA_IPC,range.first + i,IPC_GETPLAYLISTTITLEW);
+
+			if (title != NULL)
+				utf8_append(range.data, title, wcslen(title));
+		}
+
+		range.data.push_back('\0');
+
+		const char *file = (char*)SendMessage(plugin.hwndParent,WM_WA_IPC,range.first + i,IPC_GETPLAYLISTFILE);
+		range.files.push_back(file != NULL ? file : "");
+	}
+}
+
+/**
+* \brief	readBatchFilesFunction
+*
+* takes the paths of the entries of a batch. run on the winamp thread by WinampState::invoke
+*
+* \param	parameter	TitleBatch that receives the paths, missing ones are empty
+*/
+void PlaylistSnapshot::readBatchFilesFunction(void *parameter) {
+	TitleBatch & batch = *(TitleBatch*)parameter;
+
+	batch.files.reserve(batch.positions.size());
+
+	for (unsigned int i = 0; i < batch.positions.size(); i++) {
+		const char *file = (char*)SendMessage(plugin.hwndParent,WM_WA_IPC,batch.positions[i],IPC_GETPLAYLISTFILE);
+		batch.files.push_back(file != NULL ? file : "");
+	}
+}
+
+/**
+* \brief	readBatchTitlesFunction
+*
+* encodes the titles of the entries of a batch, winamp reads the files it hasn't shown yet. run on the winamp thread
+* by WinampState::invoke
+*
+* \param	parameter	TitleBatch that receives the titles, missing ones are empty
+*/
+void PlaylistSnapshot::readBatchTitlesFunction(void *parameter) {
+	TitleBatch & batch = *(TitleBatch*)parameter;
+
+	batch.titles.resize(batch.positions.size());
+
+	for (unsigned int i = 0; i < batch.positions.size(); i++) {
+		wchar_t *title = (wchar_t*)SendMessage(plugin.hwndParent,WM_WA_IPC,batch.positions[i],IPC_GETPLAYLISTTITLEW);
+
+		if (title != NULL)
+			utf8_append(batch.titles[i], title, wcslen(title));
+	}
+}
+
+/**
+* \brief	prefetchFunction
+*
+* task of the work pool: reads the files of a batch into the metadata cache with background priority, so winamp
+* finds them in the file system cache when upgradeTitles asks for the titles
+*
+* \param	parameter	TitleBatch, handed on to upgradeTitles
+*
+* \return	0
+*/
+DWORD WINAPI PlaylistSnapshot::prefetchFunction(LPVOID parameter) {
+	TitleBatch *batch = (TitleBatch*)parameter;
+
+	{
+		ThreadPolicy policy(THREAD_CLASS_BACKGROUND);
+
+		for (unsigned int i = 0; i < batch->files.size(); i++) {
+			if (!batch->files[i].empty())
+				metadatacache.prefetch(batch->files[i].c_str());
+		}
+	}
+
+	playlistsnapshot.finishBatch(batch);
+
+	return 0;
+}
+
+/**
+* \brief	finishBatch
+*
+* hands a batch that has been read to upgradeTitles on sendCommandThread
+*
+* \param	batch	batch of the entries
+*/
+void PlaylistSnapshot::finishBatch(TitleBatch *batch) {
+	// CRITICAL
+	EnterCriticalSection(&cs_playlist);
+
+	readyBatch = batch;
+
+	LeaveCriticalSection(&cs_playlist);
+	// CRITICAL END
+
+	tasklist.push("titleUpgrade");
+}
+
+/**
+* \brief	read
+*
+* hashes the current winamp playlist with one call on the winamp thread instead of two messages per entry
+*
+* \param	current	vector that receives one hash per entry
+*/
+void PlaylistSnapshot::read(std::vector<unsigned int> & current) {
+	winampstate.invoke(readFunction, &current);
+}
+
+/**
+* \brief	isMove
+*
+* checks if the changed range is a single entry that has been moved from one end of the range to the other
+*
+* \param	current	hashes of the current playlist
+* \param	start	first changed position
+* \param	count	number of changed positions, same in old and current playlist
+* \param	down	true: moved from start to the end of the range, false: moved from the end to start
+*
+* \return	true if the range only contains this move
+*/
+bool const PlaylistSnapshot::isMove(const std::vector<unsigned int> & current, const unsigned int & start, const unsigned int & count, const bool & down) {
+	unsigned int last = start + count - 1;
+
+	if (down) {
+		if (hashes[start] != current[last])
+			return false;
+
+		for (unsigned int i = start; i < last; i++)
+			if (hashes[i + 1] != current[i])
+				return false;
+	} else {
+		if (hashes[last] != current[start])
+			return false;
+
+		for (unsigned int i = start; i < last; i++)
+			if (hashes[i] != current[i + 1])
+				return false;
+	}
+
+	return true;
+}
+
+/**
+* \brief	updateTitles
+*
+* patches the titles with the entries that have changed. the unchanged beginning and end are copied, not encoded again.
+* more than TITLE_INLINE_LIMIT changed entries get placeholders, winamp would read the files of a freshly loaded
+* playlist on its own thread. the change is queued for the playlist index as well
+*
+* \param	prefix	number of unchanged entries at the beginning
+* \param	suffix	number of unchanged entries at the end
+* \param	current	hash of every entry of the current playlist
+*/
+void PlaylistSnapshot::updateTitles(const unsigned int & prefix, const unsigned int & suffix, const std::vector<unsigned int> & current) {
+	unsigned int oldLength = titleOffsets.size();
+	unsigned int newLength = current.size();
+
+	// the workers read the titles that are replaced
+	finishSegments();
+
+	// the offsets have to be in order
+	if (unusedBytes > 0)
+		compactTitles();
+
+	PlaylistTitles range;
+	range.first = prefix;
+	range.number = newLength - prefix - suffix;
+	range.placeholders = range.number > TITLE_INLINE_LIMIT;
+
+	if (range.number > 0)
+		winampstate.invoke(readTitlesFunction, &range);
+
+	// bytes of the unchanged beginning and start of the unchanged end
+	unsigned int head = prefix < oldLength ? titleOffsets[prefix] : titles.length();
+	unsigned int tail = suffix > 0 ? titleOffsets[oldLength - suffix] : titles.length();
+
+	std::string data;
+	data.reserve(head + range.data.length() + titles.length() - tail);
+	data.append(titles, 0, head);
+	data.append(range.data);
+
+	std::vector<unsigned int> offsets;
+	offsets.reserve(newLength);
+	offsets.insert(offsets.end(), titleOffsets.begin(), titleOffsets.begin() + prefix);
+
+	for (unsigned int i = 0; i < range.number; i++)
+		offsets.push_back(head + range.offsets[i]);
+
+	for (unsigned int i = oldLength - suffix; i < oldLength; i++)
+		offsets.push_back(titleOffsets[i] - tail + data.length());
+
+	data.append(titles, tail, std::string::npos);
+
+	std::vector<unsigned char> states;
+	states.reserve(newLength);
+	states.insert(states.end(), titleStates.begin(), titleStates.begin() + prefix);
+	states.insert(states.end(), range.number, range.placeholders ? TITLE_PLACEHOLDER : TITLE_RESOLVED);
+	states.insert(states.end(), titleStates.end() - suffix, titleStates.end());
+
+	titleStates.swap(states);
+	unresolved = titleStates.size() - std::count(titleStates.begin(), titleStates.end(), (unsigned char)TITLE_RESOLVED);
+
+	// a batch that is read has the old positions
+	if (oldLength != prefix + suffix || range.number > 0) {
+		std::vector<unsigned long long> entries;
+		entries.reserve(range.number);
+
+		for (unsigned int i = 0; i < range.number; i++)
+			entries.push_back(hashTitle(current[prefix + i], range.data.c_str() + range.offsets[i]));
+
+		replaceEntries(prefix, oldLength - prefix - suffix, entries);
+
+		generation++;
+
+		dropImage();
+	}
+
+	if (range.placeholders)
+		resolveCursor = prefix;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_playlist);
+
+	titles.swap(data);
+	titleOffsets.swap(offsets);
+
+	LeaveCriticalSection(&cs_playlist);
+	// CRITICAL END
+
+	playlistindex.update(prefix, oldLength - prefix - suffix, range);
+	playlistgroups.update(prefix, oldLength - prefix - suffix, range);
+}
+
+/**
+* \brief	keep
+*
+* copies the playlist of the snapshot before it is replaced, for playlistcache. only call from sendCommandThread!
+*
+* \return	the playlist, the caller has to delete it
+*/
+CachedPlaylist* const PlaylistSnapshot::keep() {
+	finishSegments();
+
+	if (unusedBytes > 0)
+		compactTitles();
+
+	CachedPlaylist *playlist = new CachedPlaylist();
+	playlist->hashes = hashes;
+	playlist->titles = titles;
+	playlist->titleOffsets = titleOffsets;
+	playlist->titleStates = titleStates;
+	playlist->entryHashes = entryHashes;
+	playlist->fingerprint = fingerprint;
+	playlist->tagChanges = tagChanges;
+
+	for (unsigned int i = 0; i < image.size(); i++) {
+		ImageSegment *segment = NULL;
+
+		if (image[i] != NULL && image[i]->state == SEGMENT_READY) {
+			segment = new ImageSegment(image[i]->first, image[i]->number);
+			segment->state = SEGMENT_READY;
+			segment->data = image[i]->data;
+			segment->data->addRef();
+			segment->offsets = image[i]->offsets;
+		}
+
+		playlist->image.push_back(segment);
+	}
+
+	return playlist;
+}
+
+/**
+* \brief	restore
+*
+* continues with a playlist winamp had switched away from instead of resolving its titles again, see updateTitles.
+* if tags have changed since, the background checks every title. only call from sendCommandThread!
+*
+* \param	playlist	playlist of playlistcache with the entries of the current playlist, deleted here
+*/
+void PlaylistSnapshot::restore(CachedPlaylist *playlist) {
+	unsigned int oldLength = titleOffsets.size();
+
+	// the paths for the playlist index, the placeholders are replaced by the kept titles
+	PlaylistTitles range;
+	range.first = 0;
+	range.number = playlist->hashes.size();
+	range.placeholders = true;
+
+	winampstate.invoke(readTitlesFunction, &range);
+
+	range.data = playlist->titles;
+	range.offsets = playlist->titleOffsets;
+	range.placeholders = false;
+
+	titleStates.swap(playlist->titleStates);
+
+	if (playlist->tagChanges != tagChanges) {
+		for (unsigned int i = 0; i < titleStates.size(); i++) {
+			if (titleStates[i] == TITLE_RESOLVED)
+				titleStates[i] = TITLE_CHECK;
+		}
+	}
+
+	unresolved = titleStates.size() - std::count(titleStates.begin(), titleStates.end(), (unsigned char)TITLE_RESOLVED);
+	resolveCursor = 0;
+	generation++;
+
+	dropImage();
+
+	if (unresolved == 0)
+		image.swap(playlist->image);
+
+	entryHashes.swap(playlist->entryHashes);
+	fingerprint = playlist->fingerprint;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_playlist);
+
+	titles.swap(playlist->titles);
+	titleOffsets.swap(playlist->titleOffsets);
+
+	LeaveCriticalSection(&cs_playlist);
+	// CRITICAL END
+
+	unusedBytes = 0;
+
+	delete playlist;
+
+	playlistindex.update(0, oldLength, range);
+	playlistgroups.update(0, oldLength, range);
+}
+
+/**
+* \brief	compactTitles
+*
+* copies the titles in the order of the entries into a new string without the bytes of the replaced titles
+*/
+void PlaylistSnapshot::compactTitles() {
+	finishSegments();
+
+	std::string data;
+	data.reserve(titles.length() - unusedBytes);
+
+	std::vector<unsigned int> offsets;
+	offsets.reserve(titleOffsets.size());
+
+	for (unsigned int i = 0; i < titleOffsets.size(); i++) {
+		offsets.push_back(data.length());
+
+		data.append(titles.c_str() + titleOffsets[i]);
+		data.push_back('\0');
+	}
+
+	// CRITICAL
+	EnterCriticalSection(&cs_playlist);
+
+	titles.swap(data);
+	titleOffsets.swap(offsets);
+
+	LeaveCriticalSection(&cs_playlist);
+	// CRITICAL END
+
+	unusedBytes = 0;
+}
+
+/**
+* \brief	dropImage
+*
+* releases the encoded titles after a change, once the work pool has finished the segments it encodes. sessions
+* that still send a window of them keep their reference. only call from sendCommandThread!
+*/
+void PlaylistSnapshot::dropImage() {
+	finishSegments();
+
+	for (unsigned int i = 0; i < image.size(); i++)
+		delete image[i];
+
+	std::vector<ImageSegment*>().swap(image);
+}
+
+/**
+* \brief	encodeSegment
+*
+* encodes the titles of a segment as lines. the buffer is sized by the titles first and filled in place, the line
+* ends are there already. runs on a worker or on sendCommandThread, which doesn't change the titles meanwhile
+*
+* \param	segment	segment claimed for encoding, ready afterwards
+*/
+void PlaylistSnapshot::encodeSegment(ImageSegment & segment) {
+	segment.offsets.resize(segment.number + 1);
+
+	unsigned int length = 0;
+
+	for (unsigned int i = 0; i < segment.number; i++) {
+		segment.offsets[i] = length;
+		length += strlen(titles.c_str() + titleOffsets[segment.first + i]) + 1;
+	}
+
+	segment.offsets[segment.number] = length;
+
+	// the shared data has to hold the only reference to the bytes, see SharedData
+	{
+		TagLib::ByteVector lines(length, '\n');
+		char *target = lines.data();
+
+		for (unsigned int i = 0; i < segment.number; i++)
+			memcpy(target + segment.offsets[i], titles.c_str() + titleOffsets[segment.first + i], segment.offsets[i + 1] - segment.offsets[i] - 1);
+
+		segment.data = new SharedData(lines);
+	}
+
+	MemoryTag::add(MEMORY_OUTPUT, length);
+
+	InterlockedIncrement(&metrics.imageSegments);
+
+	InterlockedExchange(&segment.state, SEGMENT_READY);
+}
+
+/**
+* \brief	encodeFunction
+*
+* encodes the oldest segment of the queue unless a window has taken it already. run on a worker of the work pool
+*
+* \param	parameter	the snapshot
+*
+* \return	0
+*/
+DWORD WINAPI PlaylistSnapshot::encodeFunction(LPVOID parameter) {
+	PlaylistSnapshot *snapshot = (PlaylistSnapshot*)parameter;
+	ImageSegment *segment = NULL;
+
+	// CRITICAL
+	EnterCriticalSection(&snapshot->cs_playlist);
+
+	if (!snapshot->segmentQueue.empty()) {
+		ImageSegment *next = snapshot->image[snapshot->segmentQueue.front()];
+		snapshot->segmentQueue.pop_front();
+
+		if (InterlockedCompareExchange(&next->state, SEGMENT_ENCODING, SEGMENT_QUEUED) == SEGMENT_QUEUED) {
+			segment = next;
+
+			InterlockedIncrement(&snapshot->segmentsEncoding);
+		}
+	}
+
+	LeaveCriticalSection(&snapshot->cs_playlist);
+	// CRITICAL END
+
+	// encoded by a window or dropped with the titles
+	if (segment == NULL)
+		return 0;
+
+	snapshot->encodeSegment(*segment);
+
+	InterlockedIncrement(&metrics.imageSegmentsAhead);
+
+	InterlockedDecrement(&snapshot->segmentsEncoding);
+	SetEvent(snapshot->segmentEvent);
+
+	return 0;
+}
+
+/**
+* \brief	queueSegments
+*
+* hands the segments of a range that nobody has asked for yet to the work pool. segments the pool can't take are
+* encoded by the windows that need them. only call from sendCommandThread!
+*
+* \param	begin	index of the first segment
+* \param	end		index behind the last segment
+*/
+void PlaylistSnapshot::queueSegments(const unsigned int & begin, const unsigned int & end) {
+	unsigned int queued = 0;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_playlist);
+
+	for (unsigned int i = begin; i < end && i < image.size(); i++) {
+		if (image[i] != NULL)
+			continue;
+
+		image[i] = new ImageSegment(i * IMAGE_SEGMENT_TITLES, min((unsigned int)titleOffsets.size() - i * IMAGE_SEGMENT_TITLES, (unsigned int)IMAGE_SEGMENT_TITLES));
+		segmentQueue.push_back(i);
+		queued++;
+	}
+
+	LeaveCriticalSection(&cs_playlist);
+	// CRITICAL END
+
+	for (unsigned int i = 0; i < queued; i++) {
+		if (!workpool.submit(encodeFunction, this, WORK_PRIORITY_NORMAL))
+			break;
+	}
+}
+
+/**
+* \brief	takeSegment
+*
+* returns a segment a window needs. it is encoded here unless a worker has started it, then this waits for the
+* worker. only call from sendCommandThread!
+*
+* \param	index	index of the segment
+*
+* \return	the ready segment
+*/
+ImageSegment* const PlaylistSnapshot::takeSegment(const unsigned int & index) {
+	queueSegments(index, index + 1);
+
+	ImageSegment *segment = image[index];
+
+	if (InterlockedCompareExchange(&segment->state, SEGMENT_ENCODING, SEGMENT_QUEUED) == SEGMENT_QUEUED)
+		encodeSegment(*segment);
+	else if (segment->state != SEGMENT_READY) {
+		InterlockedIncrement(&metrics.imageWaits);
+
+		while (segment->state != SEGMENT_READY)
+			WaitForSingleObject(segmentEvent, INFINITE);
+	}
+
+	return segment;
+}
+
+/**
+* \brief	finishSegments
+*
+* empties the segment queue and waits for the segments the workers encode, before the titles they read change.
+* the dropped segments stay queued for the windows. only call from sendCommandThread!
+*/
+void PlaylistSnapshot::finishSegments() {
+	// CRITICAL
+	EnterCriticalSection(&cs_playlist);
+
+	segmentQueue.clear();
+
+	LeaveCriticalSection(&cs_playlist);
+	// CRITICAL END
+
+	while (segmentsEncoding > 0)
+		WaitForSingleObject(segmentEvent, INFINITE);
+}
+
+/**
+* \brief	scheduleResolve
+*
+* takes the next TITLE_RESOLVE_BATCH entries whose titles aren't resolved, from resolveCursor on, and hands them
+* to the work pool. at most one batch is read at a time. only call from sendCommandThread!
+*/
+void PlaylistSnapshot::scheduleResolve() {
+	if (unresolved == 0 || resolving != 0)
+		return;
+
+	TitleBatch *batch = new TitleBatch();
+	batch->generation = generation;
+	batch->read = false;
+	batch->started = metrics.now();
+
+	unsigned int length = titleStates.size();
+
+	if (resolveCursor >= length)
+		resolveCursor = 0;
+
+	for (unsigned int i = 0; i < length && batch->positions.size() < TITLE_RESOLVE_BATCH; i++) {
+		unsigned int position = (resolveCursor + i) % length;
+
+		if (titleStates[position] == TITLE_RESOLVED)
+			continue;
+
+		batch->positions.push_back(position);
+
+		if (titleStates[position] == TITLE_PLACEHOLDER)
+			batch->read = true;
+	}
+
+	resolveCursor = batch->positions.back() + 1;
+
+	winampstate.invoke(readBatchFilesFunction, batch);
+
+	InterlockedExchange(&resolving, 1);
+
+	// titles that are only checked are known to winamp, the pool doesn't have to read their files
+	if (!batch->read || !workpool.submit(prefetchFunction, batch, WORK_PRIORITY_LOW))
+		finishBatch(batch);
+}
+
+/**
+* \brief	sendUpgrade
+*
+* replaces the titles of consecutive entries and sends them to the clients as "playlist_range_<start>_<count>",
+* which they already know how to apply. the new titles are appended, the playlist index gets them as well
+*
+* \param	run	resolved titles that differ from the snapshot
+*/
+void PlaylistSnapshot::sendUpgrade(const PlaylistTitles & run) {
+	dropImage();
+
+	// CRITICAL
+	EnterCriticalSection(&cs_playlist);
+
+	for (unsigned int i = 0; i < run.number; i++) {
+		unsigned int & offset = titleOffsets[run.first + i];
+
+		unusedBytes += strlen(titles.c_str() + offset) + 1;
+
+		offset = titles.length();
+		titles.append(run.data.c_str() + run.offsets[i]);
+		titles.push_back('\0');
+	}
+
+	LeaveCriticalSection(&cs_playlist);
+	// CRITICAL END
+
+	std::vector<unsigned long long> entries;
+	entries.reserve(run.number);
+
+	for (unsigned int i = 0; i < run.number; i++)
+		entries.push_back(hashTitle(hashes[run.first + i], run.data.c_str() + run.offsets[i]));
+
+	replaceEntries(run.first, run.number, entries);
+
+	stringstream rangeStream;
+	rangeStream << "playlist_range_" << run.first << "_" << run.number;
+
+	rawSend(rangeStream.str().c_str());
+
+	appendTitles(run.first, run.number, outputBuffer);
+
+	playlistindex.update(run.first, run.number, run);
+	playlistgroups.update(run.first, run.number, run);
+
+	if (unusedBytes > titles.length() / 2)
+		compactTitles();
+}
+
+/**
+* \brief	upgradeTitles
+*
+* performs a titleUpgrade task: asks winamp for the titles of the batch that has been read and sends the ones that
+* differ from the snapshot, then takes the next batch. the fingerprint follows once every title is resolved.
+* only call from sendCommandThread!
+*/
+void PlaylistSnapshot::upgradeTitles() {
+	if (InterlockedExchange(&recheck, 0) == 1) {
+		for (unsigned int i = 0; i < titleStates.size(); i++) {
+			if (titleStates[i] == TITLE_RESOLVED) {
+				titleStates[i] = TITLE_CHECK;
+				unresolved++;
+			}
+		}
+	}
+
+	// CRITICAL
+	EnterCriticalSection(&cs_playlist);
+
+	TitleBatch *batch = readyBatch;
+	readyBatch = NULL;
+
+	LeaveCriticalSection(&cs_playlist);
+	// CRITICAL END
+
+	// a batch of older positions is dropped, its entries are taken again
+	if (batch != NULL && batch->generation == generation) {
+		winampstate.invoke(readBatchTitlesFunction, batch);
+
+		PlaylistTitles run;
+		run.first = 0;
+		run.number = 0;
+		run.placeholders = false;
+
+		for (unsigned int i = 0; i < batch->positions.size(); i++) {
+			unsigned int position = batch->positions[i];
+
+			if (titleStates[position] != TITLE_RESOLVED) {
+				titleStates[position] = TITLE_RESOLVED;
+				unresolved--;
+			}
+
+			if (batch->titles[i].compare(titles.c_str() + titleOffsets[position]) == 0)
+				continue;
+
+			if (run.number > 0 && run.first + run.number != position) {
+				sendUpgrade(run);
+
+				run.number = 0;
+				run.data.clear();
+				run.offsets.clear();
+				run.files.clear();
+			}
+
+			if (run.number == 0)
+				run.first = position;
+
+			run.offsets.push_back(run.data.length());
+			run.data.append(batch->titles[i]);
+			run.data.push_back('\0');
+			run.files.push_back(batch->files[i]);
+			run.number++;
+		}
+
+		if (run.number > 0)
+			sendUpgrade(run);
+
+		playlistcache.recordResolve(metrics.now() - batch->started, batch->positions.size());
+
+		if (unresolved == 0 && fingerprint != announced)
+			announceFingerprint();
+	}
+
+	if (batch != NULL) {
+		delete batch;
+
+		InterlockedExchange(&resolving, 0);
+	}
+
+	scheduleResolve();
+}
+
+/**
+* \brief	titlesChanged
+*
+* called by the MainWndProc hook when the tags of a file may have changed. the background compares every title again
+*/
+void PlaylistSnapshot::titlesChanged() {
+	InterlockedIncrement(&tagChanges);
+
+	if (InterlockedExchange(&recheck, 1) == 0)
+		tasklist.push("titleUpgrade");
+}
+
+/**
+* \brief	prioritize
+*
+* a client has asked for the titles of a window, the next batch starts there if the entry isn't resolved.
+* only call from sendCommandThread!
+*
+* \param	position	first entry of the window
+*/
+void PlaylistSnapshot::prioritize(const int & position) {
+	if (position >= 0 && (unsigned int)position < titleStates.size() && titleStates[position] != TITLE_RESOLVED)
+		resolveCursor = position;
+}
+
+/**
+* \brief	sendChanges
+*
+* compares the current playlist with the snapshot and sends the difference to the clients as
+* "playlist_move_<from>_<to>" or "playlist_delete_<start>_<count>" and "playlist_insert_<start>_<count>".
+* inserted entries don't carry titles, the clients fetch them with playlist_range_. every change is followed by the
+* new fingerprint. titles that aren't resolved yet are resolved afterwards, see upgradeTitles. a playlist that replaces
+* most of the entries is kept in playlistcache, switching back to it restores its titles with the fingerprint.
+* only call from sendCommandThread!
+*/
+void PlaylistSnapshot::sendChanges() {
+	// changes from now on are seen by the next call
+	InterlockedExchange(&stale, 0);
+
+	std::vector<unsigned int> current;
+	read(current);
+
+	unsigned int oldLength = hashes.size();
+	unsigned int newLength = current.size();
+
+	// unchanged beginning and end
+	unsigned int prefix = 0;
+
+	while (prefix < oldLength && prefix < newLength && hashes[prefix] == current[prefix])
+		prefix++;
+
+	unsigned int suffix = 0;
+
+	while (suffix < oldLength - prefix && suffix < newLength - prefix && hashes[oldLength - 1 - suffix] == current[newLength - 1 - suffix])
+		suffix++;
+
+	unsigned int deleted = oldLength - prefix - suffix;
+	unsigned int inserted = newLength - prefix - suffix;
+
+	stringstream changeStream;
+
+	if (deleted == inserted && deleted > 1 && isMove(current, prefix, deleted, true)) {
+		changeStream << "playlist_move_" << prefix << "_" << (prefix + deleted - 1);
+
+		rawSend(changeStream.str().c_str());
+	} else if (deleted == inserted && deleted > 1 && isMove(current, prefix, deleted, false)) {
+		changeStream << "playlist_move_" << (prefix + deleted - 1) << "_" << prefix;
+
+		rawSend(changeStream.str().c_str());
+	} else {
+		if (deleted > 0) {
+			changeStream << "playlist_delete_" << prefix << "_" << deleted;
+
+			rawSend(changeStream.str().c_str());
+
+			changeStream.str("");
+		}
+
+		if (inserted > 0) {
+			changeStream << "playlist_insert_" << prefix << "_" << inserted;
+
+			rawSend(changeStream.str().c_str());
+		}
+	}
+
+	// winamp has switched playlists, more entries than are read inline
+	CachedPlaylist *kept = inserted > TITLE_INLINE_LIMIT ? playlistcache.take(current) : NULL;
+
+	if (deleted > TITLE_INLINE_LIMIT)
+		playlistcache.put(keep());
+
+	if (kept != NULL)
+		restore(kept);
+	else
+		updateTitles(prefix, suffix, current);
+
+	hashes.swap(current);
+
+	// clients that keep the titles know their playlist is the current one
+	if (deleted > 0 || inserted > 0)
+		announceFingerprint();
+
+	scheduleResolve();
+}
+
+/**
+* \brief	length
+*
+* \return	number of entries of the snapshot
+*/
+int const PlaylistSnapshot::length() {
+	return hashes.size();
+}
+
+/**
+* \brief	getFingerprint
+*
+* a client that has kept the titles of a playlist with this fingerprint doesn't need to request them with
+* playlist_range_ again after a reconnect, see PlaylistPages of the client
+*
+* \return	playlistHash_<hash>_<length>
+*/
+std::string const PlaylistSnapshot::getFingerprint() {
+	stringstream fingerprintStream;
+	fingerprintStream << "playlistHash_" << fingerprint << "_" << hashes.size();
+
+	return fingerprintStream.str();
+}
+
+/**
+* \brief	announceFingerprint
+*
+* sends the fingerprint to the clients after a change. only call from sendCommandThread!
+*/
+void PlaylistSnapshot::announceFingerprint() {
+	rawSend(getFingerprint().c_str());
+
+	announced = fingerprint;
+}
+
+/**
+* \brief	invalidate
+*
+* called by the MainWndProc hook when the playlist or the tags of a file have changed. the titles are read from winamp
+* until the next sendChanges
+*/
+void PlaylistSnapshot::invalidate() {
+	InterlockedExchange(&stale, 1);
+}
+
+/**
+* \brief	appendTitle
+*
+* appends the UTF8 title of a playlist entry without encoding it
+*
+* \param	position	playlist position
+* \param	target		string the title is appended to
+*
+* \return	false if the snapshot doesn't know the current title, nothing is appended
+*/
+bool const PlaylistSnapshot::appendTitle(const int & position, std::string & target) {
+	bool found = false;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_playlist);
+
+	if (stale == 0 && position >= 0 && (unsigned int)position < titleOffsets.size()) {
+		target.append(titles.c_str() + titleOffsets[position]);
+		found = true;
+	}
+
+	LeaveCriticalSection(&cs_playlist);
+	// CRITICAL END
+
+	return found;
+}
+
+/**
+* \brief	appendTitles
+*
+* appends the titles of a range of entries as lines, the way the clients know the playlist. only call from sendCommandThread!
+*
+* \param	first	position of the first title, inside the snapshot
+* \param	number	number of titles, inside the snapshot
+* \param	output	buffer the lines are appended to
+*/
+void PlaylistSnapshot::appendTitles(const int & first, const int & number, OutputBuffer & output) {
+	// CRITICAL
+	EnterCriticalSection(&cs_playlist);
+
+	for (int i = first; i < first + number && (unsigned int)i < titleOffsets.size(); i++)
+		output.appendLine(titles.c_str() + titleOffsets[i]);
+
+	LeaveCriticalSection(&cs_playlist);
+	// CRITICAL END
+}
+
+/**
+* \brief	shareTitles
+*
+* appends the titles of a range of entries like appendTitles, but as ranges of the segments of the encoded image, so
+* a window costs no copy however many sessions request it. the segments of the window are encoded in parallel, the
+* ones behind it by the work pool while the window is sent. while titles are still resolved every upgrade would
+* build the image again, the lines are copied then. only call from sendCommandThread!
+*
+* \param	first	position of the first title, inside the snapshot
+* \param	number	number of titles, inside the snapshot
+* \param	output	buffer the lines are appended to
+*/
+void PlaylistSnapshot::shareTitles(const int & first, const int & number, OutputBuffer & output) {
+	if (number <= 0)
+		return;
+
+	if (unresolved > 0) {
+		appendTitles(first, number, output);
+
+		return;
+	}
+
+	unsigned int begin = first;
+	unsigned int end = first + number;
+
+	if (end > titleOffsets.size())
+		return;
+
+	if (image.empty())
+		image.resize((titleOffsets.size() + IMAGE_SEGMENT_TITLES - 1) / IMAGE_SEGMENT_TITLES, NULL);
+
+	unsigned int firstSegment = begin / IMAGE_SEGMENT_TITLES;
+	unsigned int endSegment = (end - 1) / IMAGE_SEGMENT_TITLES + 1;
+
+	// the first segment is encoded here, the others meanwhile by the pool
+	queueSegments(firstSegment + 1, endSegment + IMAGE_AHEAD_SEGMENTS);
+
+	for (unsigned int i = firstSegment; i < endSegment; i++) {
+		ImageSegment *segment = takeSegment(i);
+
+		unsigned int from = max(begin, segment->first) - segment->first;
+		unsigned int to = min(end, segment->first + segment->number) - segment->first;
+
+		output.appendLines(segment->data, &segment->offsets[from], to - from);
+	}
+}
@@ -0,0 +1,191 @@
+#pragma once
+#include "stdafx.h"
+
+// changed entries of one sendChanges above which winamp isn't asked for their titles, they get the file name until
+// the background resolves them
+#define TITLE_INLINE_LIMIT 64
+
+// hash of the missing neighbour of the first and the last entry in the fingerprint
+#define FINGERPRINT_EDGE 14695981039346656037ULL
+
+// entries whose titles are resolved with one call on the winamp thread
+#define TITLE_RESOLVE_BATCH 64
+
+// state of the title of an entry
+#define TITLE_PLACEHOLDER 0	// derived from the file name, the file hasn't been read
+#define TITLE_CHECK 1		// asked from winamp before, the tags may have changed since
+#define TITLE_RESOLVED 2	// as winamp shows it
+
+// entries of one segment of the image, encoded by one task of the work pool
+#define IMAGE_SEGMENT_TITLES 256
+
+// segments behind a window that the work pool encodes while the window is sent, the next windows the client asks for
+#define IMAGE_AHEAD_SEGMENTS 4
+
+// state of a segment of the image
+#define SEGMENT_QUEUED 0	// waits for a worker, the window that needs it first encodes it itself
+#define SEGMENT_ENCODING 1
+#define SEGMENT_READY 2
+
+
+// UTF8 titles of a range of playlist entries, each terminated by \0
+struct PlaylistTitles {
+	unsigned int first;
+	unsigned int number;
+
+	std::string data;
+	std::vector<unsigned int> offsets;
+
+	// paths of the entries, for the metadata of the playlist index and groups
+	std::vector<std::string> files;
+
+	// true: the titles are derived from the file names, winamp isn't asked
+	bool placeholders;
+};
+
+
+// entries whose titles are resolved together: the files are read by the work pool, then the titles are asked from winamp
+struct TitleBatch {
+	// generation of the playlist the positions belong to, see PlaylistSnapshot::generation
+	unsigned int generation;
+
+	std::vector<unsigned int> positions;
+	std::vector<std::string> files;
+	std::vector<std::string> titles;
+
+	// true if an entry has a placeholder, only then the files are read before winamp is asked
+	bool read;
+
+	// metrics.now() when the batch was taken
+	LONGLONG started;
+};
+
+
+// titles of consecutive entries encoded as the lines playlist_range_ sends. immutable once it is ready
+struct ImageSegment {
+	unsigned int first;
+	unsigned int number;
+
+	volatile LONG state;
+
+	// encoded lines, NULL until the segment is ready
+	SharedData *data;
+
+	// offset of every line and the end of the last one
+	std::vector<unsigned int> offsets;
+
+	ImageSegment(const unsigned int & first, const unsigned int & number) : first(first), number(number), state(SEGMENT_QUEUED), data(NULL) {}
+
+	~ImageSegment() { if (data != NULL) { MemoryTag::add(MEMORY_OUTPUT, -(LONG)data->bytes.size()); data->release(); } }
+};
+
+
+struct CachedPlaylist;
+
+class PlaylistSnapshot {
+	private:
+		// hash of the file name of every playlist entry as the clients know it. the titles are compared by the background,
+		// see upgradeTitles
+		std::vector<unsigned int> hashes;
+
+		// hash of every entry together with its title, see hashTitle. the fingerprint of the playlist is the sum of the
+		// hashes of every pair of neighbouring entries, so a change only takes the pairs around it out and puts the new
+		// ones in. see getFingerprint
+		std::vector<unsigned long long> entryHashes;
+		unsigned long long fingerprint;
+
+		// fingerprint the clients have been sent last
+		unsigned long long announced;
+
+		// UTF8 titles of the entries in one string, each terminated by \0, and the offset of every title.
+		// only the changed entries are encoded again
+		std::string titles;
+		std::vector<unsigned int> titleOffsets;
+
+		// every title encoded as the line playlist_range_ sends, referenced by the sessions instead of copied. only
+		// while every title is resolved, dropped when a title changes. a segment is encoded when the first window
+		// needs it, the segments behind the window by the work pool while the window is sent. NULL for the segments
+		// nobody has asked for yet
+		std::vector<ImageSegment*> image;
+
+		// segments waiting for the work pool and the number it is encoding, guarded by cs_playlist. the titles aren't
+		// changed until the encoding ones are ready, see finishSegments
+		std::deque<unsigned int> segmentQueue;
+		volatile LONG segmentsEncoding;
+
+		// set when a worker has encoded a segment
+		HANDLE segmentEvent;
+
+		// resolved titles are appended, the bytes of the titles they replace are unused until the titles are compacted
+		unsigned int unusedBytes;
+
+		// TITLE_ state of every title, the number of titles that aren't resolved and where the next batch starts
+		std::vector<unsigned char> titleStates;
+		unsigned int unresolved;
+		unsigned int resolveCursor;
+
+		// counts the changes of the positions, a batch of an older generation is dropped
+		unsigned int generation;
+
+		// 1 while a batch is read, a batch that has been read waits for upgradeTitles
+		volatile LONG resolving;
+		TitleBatch *readyBatch;
+
+		// 1 after the tags of a file have changed, every title is checked again
+		volatile LONG recheck;
+
+		// counts the changes of tags, a playlist restored from playlistcache is checked if they have changed since
+		volatile LONG tagChanges;
+
+		// 1 if winamp may show other titles than the snapshot, until the next sendChanges
+		volatile LONG stale;
+
+		// critical playlist section, guards the titles and the segment queue. they are read by other threads than sendCommandThread
+		CRITICAL_SECTION cs_playlist;
+
+		static void readFunction(void *parameter);
+		static void readTitlesFunction(void *parameter);
+		static void readBatchFilesFunction(void *parameter);
+		static void readBatchTitlesFunction(void *parameter);
+		static DWORD WINAPI prefetchFunction(LPVOID parameter);
+		static DWORD WINAPI encodeFunction(LPVOID parameter);
+		static void read(std::vector<unsigned int> & current);
+		static unsigned int const hashEntry(const int & position);
+		static unsigned long long const hashTitle(const unsigned int & entry, const char *title);
+		static unsigned long long const hashPair(const unsigned long long & previous, const unsigned long long & next);
+		static unsigned long long const sumPairs(const std::vector<unsigned long long> & entries, const unsigned int & first, const unsigned int & last);
+		static void appendPlaceholder(std::string & target, const wchar_t *file);
+
+		bool const isMove(const std::vector<unsigned int> & current, const unsigned int & start, const unsigned int & count, const bool & down);
+		void updateTitles(const unsigned int & prefix, const unsigned int & suffix, const std::vector<unsigned int> & current);
+		void replaceEntries(const unsigned int & first, const unsigned int & count, const std::vector<unsigned long long> & entries);
+		void announceFingerprint();
+		void compactTitles();
+		void dropImage();
+		void encodeSegment(ImageSegment & segment);
+		void queueSegments(const unsigned int & begin, const unsigned int & end);
+		ImageSegment* const takeSegment(const unsigned int & index);
+		void finishSegments();
+		void scheduleResolve();
+		void sendUpgrade(const PlaylistTitles & run);
+		void finishBatch(TitleBatch *batch);
+		CachedPlaylist* const keep();
+		void restore(CachedPlaylist *playlist);
+
+	public:
+		PlaylistSnapshot();
+
+		~PlaylistSnapshot();
+
+		void sendChanges();
+		int const length();
+		std::string const getFingerprint();
+
+		void invalidate();
+		void titlesChanged();
+		void upgradeTitles();
+		void prioritize(const int & position);
+		bool const appendTitle(const int & position, std::string & target);
+		void appendTitles(const int & first, const int & number, OutputBuffer & output);
+		void shareTitles(const int & first, const int & number, OutputBuffer & output);
+};
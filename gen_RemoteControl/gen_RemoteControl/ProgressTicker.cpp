@@ -0,0 +1,102 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	ProgressTicker
+*
+* constructor
+*/
+ProgressTicker::ProgressTicker() {
+	timer = NULL;
+	busy = 0;
+	sampled = 0;
+}
+
+/**
+* \brief	start
+*
+* starts the periodic check if it isn't running. called by updateTimers while clients are connected
+*
+* \return	1 if error, 0 if success
+*/
+int const ProgressTicker::start() {
+	if (timer != NULL)
+		return 0;
+
+	HANDLE created = NULL;
+
+	// the sample waits for the winamp thread
+	if (CreateTimerQueueTimer(&created, NULL, progressTimeout, this, PROGRESS_POLL, PROGRESS_POLL, WT_EXECUTELONGFUNCTION) == FALSE)
+		return 1;
+
+	// started by another thread in the meantime
+	if (InterlockedCompareExchangePointer(&timer, created, NULL) != NULL)
+		DeleteTimerQueueTimer(NULL, created, NULL);
+
+	return 0;
+}
+
+/**
+* \brief	stop
+*
+* stops the check. doesn't wait for a running one, it sends messages to winamp and stopServer may run on its thread.
+* called by stopServer and by updateTimers when the last client has gone
+*/
+void ProgressTicker::stop() {
+	HANDLE running = InterlockedExchangePointer(&timer, NULL);
+
+	if (running != NULL)
+		DeleteTimerQueueTimer(NULL, running, NULL);
+}
+
+/**
+* \brief	sampleFunction
+*
+* WinampFunction of progressTimeout. reads the state and queues a new clock if playback has jumped or its state has
+* changed, otherwise a tick if the position has drifted from the clock of the clients
+*
+* \param	parameter	unused
+*/
+void ProgressTicker::sampleFunction(void *parameter) {
+	InterlockedIncrement(&metrics.progressSamples);
+
+	if (winampstate.refresh()) {
+		tasklist.push(winampstate.newClock());
+
+		return;
+	}
+
+	std::string tick = winampstate.getTick();
+
+	if (!tick.empty()) {
+		tasklist.push(tick);
+
+		InterlockedIncrement(&metrics.progressTicks);
+	}
+}
+
+/**
+* \brief	progressTimeout
+*
+* samples the position once the interval SessionList::progressInterval asks for has passed
+*
+* \param	parameter			ticker
+* \param	timerOrWaitFired	unused
+*/
+VOID CALLBACK ProgressTicker::progressTimeout(PVOID parameter, BOOLEAN timerOrWaitFired) {
+	ProgressTicker *ticker = (ProgressTicker*)parameter;
+
+	if (InterlockedExchange(&ticker->busy, 1) != 0)
+		return;
+
+	int interval = connected == true && winampstate.getIsPlaying() == 1 ? sessionlist.progressInterval() : 0;
+	DWORD now = GetTickCount();
+
+	if (interval > 0 && now - ticker->sampled >= (DWORD)interval - PROGRESS_POLL / 2) {
+		ticker->sampled = now;
+
+		winampstate.invoke(sampleFunction, NULL);
+	}
+
+	InterlockedExchange(&ticker->busy, 0);
+}
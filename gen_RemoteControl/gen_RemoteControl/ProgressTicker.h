@@ -0,0 +1,37 @@
+#pragma once
+#include "stdafx.h"
+
+// milliseconds between two checks whether a sample is due
+#define PROGRESS_POLL 500
+
+// milliseconds between two samples of the position for a client in the foreground and for one on a slow link
+#define PROGRESS_INTERVAL 1000
+#define PROGRESS_INTERVAL_SLOW 4000
+
+// round trip time in milliseconds above which a link is slow
+#define PROGRESS_SLOW_RTT 300
+
+
+// samples the playback position of winamp while it plays and sends the clients a tick_ when it has drifted from the
+// position they advance from their clock, e.g. after buffering or a stalled stream. a jump or a change of the playback
+// state gets a new clock. no sampling while every client is in the background or has unsubscribed from progress,
+// slower sampling while every client is congested or on a slow link
+class ProgressTicker {
+	private:
+		HANDLE volatile timer;
+
+		// 1 while a check runs, the timer doesn't wait for the last one
+		volatile LONG busy;
+
+		// tick count of the last sample, only used by the running check
+		DWORD sampled;
+
+		static VOID CALLBACK progressTimeout(PVOID parameter, BOOLEAN timerOrWaitFired);
+		static void sampleFunction(void *parameter);
+
+	public:
+		ProgressTicker();
+
+		int const start();
+		void stop();
+};
@@ -0,0 +1,113 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	read
+*
+* reads the current JTFE queue
+*
+* \param	current	vector that receives the playlist position of every queued title
+*/
+void QueueSnapshot::read(std::vector<int> & current) {
+	int length = WASABI_API_QUEUEMGR->GetNumberOfQueuedItems();
+
+	current.clear();
+	current.reserve(length);
+
+	for (int i = 0; i < length; i++)
+		current.push_back(WASABI_API_QUEUEMGR->GetQueuedItemFromIndex(i));
+}
+
+/**
+* \brief	sendChanges
+*
+* compares the current queue with the snapshot and sends the difference to the clients as "queueMove_<from>_<to>",
+* "queueRemove_<start>_<count>" or "queueInsert_<start>_<count>" followed by one line per inserted title.
+* other changes like a randomised queue are sent as the whole queue with queueRefresh_. only call from sendCommandThread!
+*/
+void QueueSnapshot::sendChanges() {
+	std::vector<int> current;
+	read(current);
+
+	unsigned int oldLength = items.size();
+	unsigned int newLength = current.size();
+
+	// unchanged beginning and end
+	unsigned int prefix = 0;
+
+	while (prefix < oldLength && prefix < newLength && items[prefix] == current[prefix])
+		prefix++;
+
+	unsigned int suffix = 0;
+
+	while (suffix < oldLength - prefix && suffix < newLength - prefix && items[oldLength - 1 - suffix] == current[newLength - 1 - suffix])
+		suffix++;
+
+	unsigned int removed = oldLength - prefix - suffix;
+	unsigned int inserted = newLength - prefix - suffix;
+	unsigned int last = prefix + removed - 1;
+
+	stringstream changeStream;
+
+	if (removed == 0 && inserted == 0) {
+		// unchanged
+	} else if (removed == inserted && removed > 1 && items[prefix] == current[last]
+		&& std::equal(items.begin() + prefix + 1, items.begin() + last + 1, current.begin() + prefix)) {
+		changeStream << "queueMove_" << prefix << "_" << last;
+
+		rawSend(changeStream.str().c_str());
+	} else if (removed == inserted && removed > 1 && items[last] == current[prefix]
+		&& std::equal(items.begin() + prefix, items.begin() + last, current.begin() + prefix + 1)) {
+		changeStream << "queueMove_" << last << "_" << prefix;
+
+		rawSend(changeStream.str().c_str());
+	} else if (inserted == 0) {
+		changeStream << "queueRemove_" << prefix << "_" << removed;
+
+		rawSend(changeStream.str().c_str());
+	} else if (removed == 0) {
+		changeStream << "queueInsert_" << prefix << "_" << inserted;
+
+		rawSend(changeStream.str().c_str());
+
+		for (unsigned int i = prefix; i < prefix + inserted; i++) {
+			changeStream.str("");
+			changeStream << current[i];
+
+			rawSend(changeStream.str().c_str());
+		}
+	} else
+		refreshQueueListFunction();
+
+	items.swap(current);
+}
+
+/**
+* \brief	sendAll
+*
+* sends the snapshot as queueRefresh_<count> followed by one line per title, the base of the next changes.
+* only call from sendCommandThread!
+*/
+void QueueSnapshot::sendAll() {
+	stringstream itemStream;
+	itemStream << "queueRefresh_" << items.size();
+
+	rawSend(itemStream.str().c_str());
+
+	for (unsigned int i = 0; i < items.size(); i++) {
+		itemStream.str("");
+		itemStream << items[i];
+
+		rawSend(itemStream.str().c_str());
+	}
+}
+
+/**
+* \brief	next
+*
+* removes the first title like the clients do when they receive queue_next. only call from sendCommandThread!
+*/
+void QueueSnapshot::next() {
+	if (!items.empty())
+		items.erase(items.begin());
+}
@@ -0,0 +1,16 @@
+#pragma once
+#include "stdafx.h"
+
+
+class QueueSnapshot {
+	private:
+		// playlist position of every queued title as the clients know it
+		std::vector<int> items;
+
+		static void read(std::vector<int> & current);
+
+	public:
+		void sendChanges();
+		void sendAll();
+		void next();
+};
@@ -0,0 +1,391 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	ReplayGainJob
+*
+* constructor
+*/
+ReplayGainJob::ReplayGainJob() {
+	next = 0;
+	session = 0;
+	id = 0;
+	kill = 0;
+	job = NULL;
+
+	stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+	for (int i = 0; i < REPLAYGAIN_MAX_THREADS; i++)
+		threads[i] = NULL;
+
+}
+
+/**
+* \brief	~ReplayGainJob
+*
+* destructor
+*/
+ReplayGainJob::~ReplayGainJob() {
+	CloseHandle(stopEvent);
+}
+
+/**
+* \brief	start
+*
+* performs a replayGain_ command: starts a job for the album of a playlist entry. the client gets replayGainBusy
+* if a job is running
+*
+* \param	session		id of the session
+* \param	position	position in the playlist, -1 for the current track
+*/
+void ReplayGainJob::start(const int & session, const int & position) {
+	if (job != NULL && WaitForSingleObject(job, 0) == WAIT_TIMEOUT) {
+		tasklist.push("replayGainBusy", -1, session);
+
+		return;
+	}
+
+	const wchar_t *name = (const wchar_t*)SendMessage(plugin.hwndParent,WM_WA_IPC,position < 0 ? winampstate.getListPosition() : position,IPC_GETPLAYLISTFILEW);
+
+	if (name == NULL)
+		return;
+
+	// handles of the last job
+	stop();
+
+	file = name;
+
+	this->session = session;
+	id++;
+	kill = 0;
+
+	ResetEvent(stopEvent);
+
+	job = CreateThread(NULL, 0, jobFunction, this, 0, NULL);
+}
+
+/**
+* \brief	stop
+*
+* stops the decoders and waits for the job. the tags of a stopped job aren't written. called by quit
+*/
+void ReplayGainJob::stop() {
+	kill = 1;
+
+	SetEvent(stopEvent);
+
+	joinThread(job, REPLAYGAIN_STOP_TIMEOUT);
+}
+
+/**
+* \brief	format
+*
+* \param	pattern	printf pattern for one float
+* \param	value	value to format
+*
+* \return	formatted value
+*/
+std::string const ReplayGainJob::format(const char *pattern, const float & value) {
+	char text[32];
+	sprintf_s(text, sizeof(text), pattern, value);
+
+	return std::string(text);
+}
+
+/**
+* \brief	findAlbum
+*
+* fills the tracks with the files of the media library that have the album and album artist of the playlist entry.
+* a file that isn't in the library is an album of its own
+*/
+void ReplayGainJob::findAlbum() {
+	tracks.clear();
+
+	CHECK_MLDB();
+
+	SlowOperation slow("library_query", std::string(CW2A(file.c_str())));
+
+	itemRecordW *record = WASABI_API_MLDB != NULL ? WASABI_API_MLDB->GetFile(file.c_str()) : NULL;
+
+	slow.stage("file");
+
+	if (record != NULL && record->album != NULL && record->album[0] != L'\0') {
+		std::wstring query(L"album = \"");
+
+		// quotes can't be escaped in the query language
+		for (const wchar_t *c = record->album; *c != L'\0'; c++) {
+			if (*c != L'"')
+				query += *c;
+		}
+
+		query += L"\"";
+
+		itemRecordListW *list = WASABI_API_MLDB->Query(query.c_str());
+
+		slow.stage("album");
+
+		for (int i = 0; list != NULL && i < list->Size && tracks.size() < REPLAYGAIN_MAX_TRACKS; i++) {
+			const itemRecordW & item = list->Items[i];
+
+			// albums of the same name by other artists
+			if (item.filename == NULL || _wcsicmp(item.albumartist != NULL ? item.albumartist : L"", record->albumartist != NULL ? record->albumartist : L"") != 0)
+				continue;
+
+			ReplayGainTrack track;
+			track.file = item.filename;
+			track.context = NULL;
+			track.gain = 0;
+			track.peak = 0;
+			track.analysed = false;
+
+			tracks.push_back(track);
+		}
+
+		if (list != NULL)
+			WASABI_API_MLDB->FreeRecordList(list);
+	}
+
+	if (record != NULL)
+		WASABI_API_MLDB->FreeRecord(record);
+
+	if (tracks.empty()) {
+		ReplayGainTrack track;
+		track.file = file;
+		track.context = NULL;
+		track.gain = 0;
+		track.peak = 0;
+		track.analysed = false;
+
+		tracks.push_back(track);
+	}
+}
+
+/**
+* \brief	analyse
+*
+* decodes one track and runs the analyzer on it. the decoder is asked for 16 bit and at most stereo, if the
+* analyzer doesn't know the sample rate the track is decoded again at 44.1 kHz. sends replayGainTrack_
+*
+* \param	index	index of the track
+*/
+void ReplayGainJob::analyse(const unsigned int & index) {
+	ReplayGainTrack & track = tracks[index];
+
+	ifc_audiostream *decoder = NULL;
+	AudioParameters parameters;
+
+	for (int attempt = 0; attempt < 2 && track.context == NULL; attempt++) {
+		parameters = AudioParameters();
+		parameters.bitsPerSample = 16;
+		parameters.channels = 2;
+		parameters.sampleRate = attempt == 0 ? 0 : 44100;
+		parameters.flags = AUDIOPARAMETERS_MAXCHANNELS;
+
+		decoder = AGAVE_API_DECODE != NULL ? AGAVE_API_DECODE->OpenAudioBackground(track.file.c_str(), &parameters) : NULL;
+
+		if (decoder == NULL)
+			break;
+
+		void *context = WACreateRGContext();
+
+		if (parameters.bitsPerSample == 16 && parameters.channels >= 1 && parameters.channels <= 2
+			&& WAInitGainAnalysis(context, (long)parameters.sampleRate) == INIT_GAIN_ANALYSIS_OK)
+			track.context = context;
+		else {
+			WAFreeRGContext(context);
+
+			AGAVE_API_DECODE->CloseAudio(decoder);
+			decoder = NULL;
+		}
+	}
+
+	stringstream result;
+	result << "replayGainTrack_" << id << "_" << index << "_";
+
+	if (decoder == NULL) {
+		result << "error";
+
+		tasklist.push(result.str(), -1, session);
+
+		return;
+	}
+
+	int channels = parameters.channels;
+
+	std::vector<short> pcm(REPLAYGAIN_BLOCK * channels);
+	std::vector<Float_t> left(REPLAYGAIN_BLOCK);
+	std::vector<Float_t> right(REPLAYGAIN_BLOCK);
+
+	int error = 0;
+	int peak = 0;
+	size_t read;
+
+	while (kill == 0) {
+		// one block at a time within the budget of the resource governor
+		GovernorToken token(GOVERNOR_REPLAYGAIN, stopEvent);
+
+		if (!token.granted || (read = decoder->ReadAudio(&pcm[0], pcm.size() * sizeof(short), (int*)&kill, &error)) == 0)
+			break;
+
+		size_t frames = read / (channels * sizeof(short));
+
+		for (size_t i = 0; i < frames; i++) {
+			left[i] = pcm[i * channels];
+			right[i] = pcm[i * channels + channels - 1];
+
+			peak = max(peak, max(abs((int)pcm[i * channels]), abs((int)pcm[i * channels + channels - 1])));
+		}
+
+		WAAnalyzeSamples(track.context, &left[0], &right[0], frames, channels);
+	}
+
+	AGAVE_API_DECODE->CloseAudio(decoder);
+
+	// the decoder has read the whole file
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+
+	if (GetFileAttributesExW(track.file.c_str(), GetFileExInfoStandard, &attributes))
+		governor.charge(GOVERNOR_REPLAYGAIN, 0, ((LONGLONG)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow);
+
+	if (kill != 0)
+		return;
+
+	track.gain = WAGetTitleGain(track.context);
+	track.peak = peak / 32768.0f;
+	track.analysed = track.gain != GAIN_NOT_ENOUGH_SAMPLES;
+
+	if (track.analysed)
+		result << format("%.2f", track.gain) << "_" << format("%.6f", track.peak);
+	else
+		result << "error";
+
+	tasklist.push(result.str(), -1, session);
+}
+
+/**
+* \brief	writeTags
+*
+* computes the album gain from the analysed tracks and queues the ReplayGain fields of every analysed track for the tag writer.
+* sends replayGainEnd_
+*/
+void ReplayGainJob::writeTags() {
+	void *album = WACreateRGContext();
+	WAInitGainAnalysis(album, 44100);
+
+	float albumPeak = 0;
+	bool analysed = false;
+
+	for (unsigned int i = 0; i < tracks.size(); i++) {
+		if (tracks[i].analysed) {
+			WAMergeAlbumGain(album, tracks[i].context);
+
+			albumPeak = max(albumPeak, tracks[i].peak);
+			analysed = true;
+		}
+	}
+
+	float albumGain = WAGetAlbumGain(album);
+
+	WAFreeRGContext(album);
+
+	stringstream end;
+	end << "replayGainEnd_" << id << "_";
+
+	if (!analysed || albumGain == GAIN_NOT_ENOUGH_SAMPLES) {
+		end << "error";
+
+		tasklist.push(end.str(), -1, session);
+
+		return;
+	}
+
+	for (unsigned int i = 0; i < tracks.size(); i++) {
+		if (!tracks[i].analysed)
+			continue;
+
+		// the tag writer takes the ANSI paths winamp gives for IPC_GETPLAYLISTFILE
+		char path[MAX_PATH];
+
+		if (WideCharToMultiByte(CP_ACP, 0, tracks[i].file.c_str(), -1, path, MAX_PATH, NULL, NULL) == 0)
+			continue;
+
+		tagwriter.add(path, "replaygain_track_gain", format("%.2f dB", tracks[i].gain));
+		tagwriter.add(path, "replaygain_track_peak", format("%.6f", tracks[i].peak));
+		tagwriter.add(path, "replaygain_album_gain", format("%.2f dB", albumGain));
+		tagwriter.add(path, "replaygain_album_peak", format("%.6f", albumPeak));
+	}
+
+	end << format("%.2f", albumGain) << "_" << format("%.6f", albumPeak);
+
+	tasklist.push(end.str(), -1, session);
+}
+
+/**
+* \brief	analyseFunction
+*
+* thread of the analysis. takes the next track of the album until every track has been taken, with background priority
+*
+* \param	parameter	job
+*
+* \return	0
+*/
+DWORD WINAPI ReplayGainJob::analyseFunction(LPVOID parameter) {
+	ReplayGainJob *job = (ReplayGainJob*)parameter;
+
+	// low cpu and i/o priority, playback comes first
+	ThreadPolicy policy(THREAD_CLASS_BACKGROUND);
+
+	LONG index;
+
+	while (job->kill == 0 && (index = InterlockedIncrement(&job->next) - 1) < (LONG)job->tracks.size())
+		job->analyse(index);
+
+	return 0;
+}
+
+/**
+* \brief	jobFunction
+*
+* thread of the job. finds the album, runs one analysis thread per core and writes the tags once every track is done
+*
+* \param	parameter	job
+*
+* \return	0
+*/
+DWORD WINAPI ReplayGainJob::jobFunction(LPVOID parameter) {
+	ReplayGainJob *job = (ReplayGainJob*)parameter;
+
+	job->findAlbum();
+
+	CHECK_DECODEFILE();
+
+	stringstream start;
+	start << "replayGainStart_" << job->id << "_" << job->tracks.size();
+
+	tasklist.push(start.str(), -1, job->session);
+
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+
+	int count = min((int)info.dwNumberOfProcessors, min((int)job->tracks.size(), REPLAYGAIN_MAX_THREADS));
+
+	job->next = 0;
+
+	for (int i = 0; i < count; i++)
+		job->threads[i] = CreateThread(NULL, 0, analyseFunction, job, 0, NULL);
+
+	for (int i = 0; i < count; i++)
+		joinThread(job->threads[i], INFINITE);
+
+	if (job->kill == 0)
+		job->writeTags();
+
+	for (unsigned int i = 0; i < job->tracks.size(); i++) {
+		if (job->tracks[i].context != NULL)
+			WAFreeRGContext(job->tracks[i].context);
+	}
+
+	job->tracks.clear();
+
+	return 0;
+}
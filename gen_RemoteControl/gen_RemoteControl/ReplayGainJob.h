@@ -0,0 +1,71 @@
+#pragma once
+#include "stdafx.h"
+
+// threads analysing the tracks of an album at most, one track per thread
+#define REPLAYGAIN_MAX_THREADS 8
+
+// tracks of an album at most
+#define REPLAYGAIN_MAX_TRACKS 100
+
+// samples per channel decoded and analysed at once
+#define REPLAYGAIN_BLOCK 4096
+
+// milliseconds quit waits for a running job
+#define REPLAYGAIN_STOP_TIMEOUT 5000
+
+
+// one track of the album of a job
+struct ReplayGainTrack {
+	std::wstring file;
+
+	// analyzer of the track, kept for the album gain
+	void *context;
+
+	// gain in dB and peak (1 is full scale), valid if analysed
+	float gain;
+	float peak;
+	bool analysed;
+};
+
+
+// computes the ReplayGain of the album of a playlist entry for a replayGain_ command. the tracks are decoded with
+// api_decodefile and analysed in parallel with background priority, one track per thread, then the gains are
+// queued for the tag writer. the client gets replayGainStart_, replayGainTrack_ for every track and replayGainEnd_.
+// one job runs at a time
+class ReplayGainJob {
+	private:
+		std::vector<ReplayGainTrack> tracks;
+		volatile LONG next;
+
+		// session that gets the progress and number of the job
+		int session;
+		LONG id;
+
+		HANDLE job;
+		HANDLE threads[REPLAYGAIN_MAX_THREADS];
+
+		// killswitch of the decoders, set by stop
+		volatile int kill;
+
+		// set by stop as well, ends waits for the resource governor
+		HANDLE stopEvent;
+
+		// playlist entry of the job, read by jobFunction
+		std::wstring file;
+
+		static DWORD WINAPI jobFunction(LPVOID parameter);
+		static DWORD WINAPI analyseFunction(LPVOID parameter);
+		static std::string const format(const char *pattern, const float & value);
+
+		void findAlbum();
+		void analyse(const unsigned int & index);
+		void writeTags();
+
+	public:
+		ReplayGainJob();
+
+		~ReplayGainJob();
+
+		void start(const int & session, const int & position);
+		void stop();
+};
@@ -0,0 +1,330 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	ResourceGovernor
+*
+* constructor, the budgets start full
+*/
+ResourceGovernor::ResourceGovernor() {
+	cpu = cpuRate(false) * GOVERNOR_BURST / 1000;
+	io = ioRate(false) * GOVERNOR_BURST / 1000;
+	refilled = GetTickCount();
+	memory = 0;
+
+	ZeroMemory(usage, sizeof(usage));
+
+	InitializeCriticalSection(&cs_governor);
+}
+
+/**
+* \brief	~ResourceGovernor
+*
+* destructor
+*/
+ResourceGovernor::~ResourceGovernor() {
+	DeleteCriticalSection(&cs_governor);
+}
+
+/**
+* \brief	playing
+*
+* \return	true while winamp decodes, the mirrored IPC_ISPLAYING state. paused playback needs no decoder
+*/
+bool const ResourceGovernor::playing() {
+	return winampstate.getIsPlaying() == 1;
+}
+
+/**
+* \brief	cpuRate
+*
+* \param	playing	true while winamp decodes
+*
+* \return	100 ns units of cpu time the background work may use per second
+*/
+LONGLONG const ResourceGovernor::cpuRate(const bool & playing) {
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+
+	// 10000000 units per second and core
+	return (LONGLONG)info.dwNumberOfProcessors * 100000 * (playing ? GOVERNOR_CPU_PLAYING : GOVERNOR_CPU_IDLE);
+}
+
+/**
+* \brief	ioRate
+*
+* \param	playing	true while winamp decodes
+*
+* \return	bytes the background work may read or write per second
+*/
+LONGLONG const ResourceGovernor::ioRate(const bool & playing) {
+	return playing ? GOVERNOR_IO_PLAYING : GOVERNOR_IO_IDLE;
+}
+
+/**
+* \brief	memoryBudget
+*
+* \param	playing	true while winamp decodes
+*
+* \return	bytes the background work may have reserved at once
+*/
+LONGLONG const ResourceGovernor::memoryBudget(const bool & playing) {
+	return playing ? GOVERNOR_MEMORY_PLAYING : GOVERNOR_MEMORY_IDLE;
+}
+
+/**
+* \brief	refill
+*
+* adds the budget of the time since the last refill at the rates of the current playback state, at most
+* GOVERNOR_BURST milliseconds of it. must be called inside cs_governor
+*/
+void ResourceGovernor::refill() {
+	DWORD now = GetTickCount();
+	DWORD elapsed = min(now - refilled, (DWORD)GOVERNOR_BURST);
+
+	refilled = now;
+
+	bool decoding = playing();
+
+	LONGLONG cpuLimit = cpuRate(decoding) * GOVERNOR_BURST / 1000;
+	LONGLONG ioLimit = ioRate(decoding) * GOVERNOR_BURST / 1000;
+
+	cpu = min(cpu + cpuRate(decoding) * elapsed / 1000, cpuLimit);
+	io = min(io + ioRate(decoding) * elapsed / 1000, ioLimit);
+}
+
+/**
+* \brief	pause
+*
+* waits GOVERNOR_POLL milliseconds
+*
+* \param	stop	stop event of the consumer, NULL if it can't be stopped
+*
+* \return	false if the stop event has been set
+*/
+bool const ResourceGovernor::pause(HANDLE stop) {
+	if (stop == NULL) {
+		Sleep(GOVERNOR_POLL);
+
+		return true;
+	}
+
+	return WaitForSingleObject(stop, GOVERNOR_POLL) == WAIT_TIMEOUT;
+}
+
+/**
+* \brief	wait
+*
+* waits until neither the cpu nor the i/o budget is in debt
+*
+* \param	consumer	GOVERNOR_ consumer
+* \param	stop		stop event of the consumer, NULL if it can't be stopped
+*
+* \return	false if the stop event has been set
+*/
+bool const ResourceGovernor::wait(const int & consumer, HANDLE stop) {
+	bool waited = false;
+
+	while (1) {
+		// CRITICAL
+		EnterCriticalSection(&cs_governor);
+
+		refill();
+
+		bool available = cpu >= 0 && io >= 0;
+
+		LeaveCriticalSection(&cs_governor);
+		// CRITICAL END
+
+		if (available)
+			break;
+
+		if (!waited) {
+			InterlockedIncrement(&usage[consumer].waits);
+
+			waited = true;
+		}
+
+		if (!pause(stop))
+			return false;
+	}
+
+	InterlockedIncrement(&usage[consumer].grants);
+
+	return true;
+}
+
+/**
+* \brief	reserve
+*
+* reserves memory for a piece of work, waits while the budget of the playback state would be exceeded. a reservation
+* is always granted if nothing else is reserved, so a piece larger than the budget runs alone
+*
+* \param	consumer	GOVERNOR_ consumer
+* \param	bytes		bytes the work needs
+* \param	stop		stop event of the consumer, NULL if it can't be stopped
+*
+* \return	false if the stop event has been set, nothing is reserved then
+*/
+bool const ResourceGovernor::reserve(const int & consumer, const LONGLONG & bytes, HANDLE stop) {
+	bool waited = false;
+
+	while (1) {
+		// CRITICAL
+		EnterCriticalSection(&cs_governor);
+
+		bool available = memory == 0 || memory + bytes <= memoryBudget(playing());
+
+		if (available)
+			memory += bytes;
+
+		LeaveCriticalSection(&cs_governor);
+		// CRITICAL END
+
+		if (available)
+			return true;
+
+		if (!waited) {
+			InterlockedIncrement(&usage[consumer].waits);
+
+			waited = true;
+		}
+
+		if (!pause(stop))
+			return false;
+	}
+}
+
+/**
+* \brief	freeMemory
+*
+* \param	bytes	bytes reserved by reserve
+*/
+void ResourceGovernor::freeMemory(const LONGLONG & bytes) {
+	// CRITICAL
+	EnterCriticalSection(&cs_governor);
+
+	memory -= bytes;
+
+	LeaveCriticalSection(&cs_governor);
+	// CRITICAL END
+}
+
+/**
+* \brief	charge
+*
+* takes the resources a piece of work has used from the budgets, the next waiting consumers wait for the debt
+*
+* \param	consumer	GOVERNOR_ consumer
+* \param	cpuTime		100 ns units of cpu time
+* \param	ioBytes		bytes read or written
+*/
+void ResourceGovernor::charge(const int & consumer, const LONGLONG & cpuTime, const LONGLONG & ioBytes) {
+	// CRITICAL
+	EnterCriticalSection(&cs_governor);
+
+	refill();
+
+	cpu -= cpuTime;
+	io -= ioBytes;
+
+	LeaveCriticalSection(&cs_governor);
+	// CRITICAL END
+
+	Metrics::add(usage[consumer].cpu, cpuTime);
+	Metrics::add(usage[consumer].io, ioBytes);
+}
+
+/**
+* \brief	threadTime
+*
+* \return	kernel and user time of the calling thread in 100 ns units
+*/
+LONGLONG const ResourceGovernor::threadTime() {
+	FILETIME creation, exit, kernel, user;
+
+	if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+		return 0;
+
+	return ((LONGLONG)kernel.dwHighDateTime << 32 | kernel.dwLowDateTime) + ((LONGLONG)user.dwHighDateTime << 32 | user.dwLowDateTime);
+}
+
+/**
+* \brief	report
+*
+* adds the current budgets and the use of every consumer to the stats
+*
+* \param	lines	receives the lines
+*/
+void ResourceGovernor::report(std::vector<std::string> & lines) {
+	static const char *names[GOVERNOR_CONSUMERS] = { "scan", "replaygain", "covers", "tags", "streaming" };
+
+	// CRITICAL
+	EnterCriticalSection(&cs_governor);
+
+	refill();
+
+	bool decoding = playing();
+
+	stringstream budget;
+	budget << "governor " << (decoding ? "playing" : "idle") << " cpu_ms " << cpu / 10000 << " / " << cpuRate(decoding) / 10000
+		<< " io_kb " << io / 1024 << " / " << ioRate(decoding) / 1024 << " memory_kb " << memory / 1024 << " / " << memoryBudget(decoding) / 1024;
+
+	LeaveCriticalSection(&cs_governor);
+	// CRITICAL END
+
+	lines.push_back(budget.str());
+
+	for (int i = 0; i < GOVERNOR_CONSUMERS; i++) {
+		stringstream consumer;
+		consumer << "governor_" << names[i] << " grants " << usage[i].grants << " waits " << usage[i].waits << " cpu_ms "
+			<< usage[i].cpu / 10000 << " io_kb " << usage[i].io / 1024;
+
+		lines.push_back(consumer.str());
+	}
+}
+
+
+/**
+* \brief	GovernorToken
+*
+* constructor, waits for the budget of a piece of work and reserves its memory
+*
+* \param	consumer	GOVERNOR_ consumer
+* \param	stop		stop event of the consumer, NULL if it can't be stopped
+* \param	memory		bytes the work needs
+* \param	throttled	false for work that must not wait, like the audio streams. it is only charged
+*/
+GovernorToken::GovernorToken(const int & consumer, HANDLE stop, const LONGLONG & memory, const bool & throttled) : consumer(consumer), io(0), memory(0) {
+	granted = !throttled || governor.wait(consumer, stop);
+
+	if (granted && memory > 0 && throttled) {
+		granted = governor.reserve(consumer, memory, stop);
+
+		if (granted)
+			this->memory = memory;
+	}
+
+	started = ResourceGovernor::threadTime();
+}
+
+/**
+* \brief	~GovernorToken
+*
+* destructor, charges the cpu time since the constructor and the i/o and frees the memory
+*/
+GovernorToken::~GovernorToken() {
+	governor.charge(consumer, ResourceGovernor::threadTime() - started, io);
+
+	if (memory > 0)
+		governor.freeMemory(memory);
+}
+
+/**
+* \brief	addIo
+*
+* \param	bytes	bytes the work has read or written
+*/
+void GovernorToken::addIo(const LONGLONG & bytes) {
+	io += bytes;
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include "stdafx.h"
+
+// background consumers of the governor
+#define GOVERNOR_SCAN 0
+#define GOVERNOR_REPLAYGAIN 1
+#define GOVERNOR_COVERS 2
+#define GOVERNOR_TAGS 3
+#define GOVERNOR_STREAMING 4
+#define GOVERNOR_CONSUMERS 5
+
+// percent of all cores the background work may use while winamp is stopped or paused, and while it decodes
+#define GOVERNOR_CPU_IDLE 50
+#define GOVERNOR_CPU_PLAYING 15
+
+// bytes per second the background work may read or write
+#define GOVERNOR_IO_IDLE 33554432
+#define GOVERNOR_IO_PLAYING 4194304
+
+// bytes the background work may have in use at once
+#define GOVERNOR_MEMORY_IDLE 67108864
+#define GOVERNOR_MEMORY_PLAYING 16777216
+
+// milliseconds of unused budget that can be saved up
+#define GOVERNOR_BURST 1000
+
+// milliseconds between two checks of a waiting consumer
+#define GOVERNOR_POLL 50
+
+// a decoded picture takes about this many times the bytes of its file
+#define GOVERNOR_DECODE_FACTOR 10
+
+// bytes charged for a file whose tags are read, the size of a typical tag with a cover
+#define GOVERNOR_TAG_BYTES 262144
+
+
+// use of one consumer since the start
+struct GovernorUsage {
+	volatile LONG grants;
+	volatile LONG waits;
+	volatile LONGLONG cpu;
+	volatile LONGLONG io;
+};
+
+
+// one budget of cpu time, i/o bytes and memory that every background subsystem draws from, so scans, ReplayGain
+// analyses, cover transcodes, tag writes and the audio streams together never take what winamp's decoder needs.
+// cpu time and i/o are token buckets that are refilled with the rate of the playback state and charged after the
+// work, a consumer waits while a bucket is in debt. memory is reserved before the work and freed after it
+class ResourceGovernor {
+	private:
+		// available budget, negative while in debt: 100 ns units of cpu time and bytes
+		LONGLONG cpu;
+		LONGLONG io;
+		DWORD refilled;
+
+		// reserved bytes
+		LONGLONG memory;
+
+		GovernorUsage usage[GOVERNOR_CONSUMERS];
+
+		// critical governor section
+		CRITICAL_SECTION cs_governor;
+
+		static bool const playing();
+		static LONGLONG const cpuRate(const bool & playing);
+		static LONGLONG const ioRate(const bool & playing);
+		static LONGLONG const memoryBudget(const bool & playing);
+
+		void refill();
+		bool const pause(HANDLE stop);
+
+	public:
+		ResourceGovernor();
+
+		~ResourceGovernor();
+
+		bool const wait(const int & consumer, HANDLE stop);
+		bool const reserve(const int & consumer, const LONGLONG & bytes, HANDLE stop);
+		void freeMemory(const LONGLONG & bytes);
+		void charge(const int & consumer, const LONGLONG & cpuTime, const LONGLONG & ioBytes);
+
+		static LONGLONG const threadTime();
+
+		void report(std::vector<std::string> & lines);
+};
+
+
+// draws from the governor for one piece of background work: the constructor waits for the budget and reserves
+// the memory, the destructor charges the cpu time of the calling thread and the i/o and frees the memory
+class GovernorToken {
+	private:
+		int consumer;
+		LONGLONG started;
+		LONGLONG io;
+		LONGLONG memory;
+
+	public:
+		GovernorToken(const int & consumer, HANDLE stop, const LONGLONG & memory = 0, const bool & throttled = true);
+
+		~GovernorToken();
+
+		// false if the stop event has been set while waiting
+		bool granted;
+
+		void addIo(const LONGLONG & bytes);
+};
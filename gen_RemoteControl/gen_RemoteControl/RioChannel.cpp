@@ -0,0 +1,222 @@
+#include "stdafx.h"
+
+RIO_EXTENSION_FUNCTION_TABLE RioChannel::functions;
+bool RioChannel::available = false;
+RIO_CQ RioChannel::completions = RIO_INVALID_CQ;
+IOContext RioChannel::notifyContext;
+char *RioChannel::region = NULL;
+RIO_BUFFERID RioChannel::regionId = RIO_INVALID_BUFFERID;
+volatile LONG RioChannel::slots[RIO_MAX_SESSIONS];
+
+
+/**
+* \brief	~RioChannel
+*
+* destructor, gives the slot back. the socket has been closed with its request queue and no request is pending
+*/
+RioChannel::~RioChannel() {
+	InterlockedExchange(&slots[slot], 0);
+}
+
+/**
+* \brief	start
+*
+* asks the system for the Registered I/O functions, registers the region of the slots and creates the completion
+* queue that notifies the completion port. called when the server starts
+*
+* \param	socket	listening socket, the functions are asked through it
+* \param	port	completion port of the network thread
+*
+* \return	1 if the system has no Registered I/O (before Windows 8), 0 if success
+*/
+int const RioChannel::start(const SOCKET & socket, const HANDLE & port) {
+	if (available)
+		return 0;
+
+	GUID guid = WSAID_MULTIPLE_RIO;
+	DWORD bytes = 0;
+
+	ZeroMemory(&functions, sizeof(functions));
+	functions.cbSize = sizeof(functions);
+
+	if (WSAIoctl(socket, SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER, &guid, sizeof(guid), &functions, sizeof(functions), &bytes, NULL, NULL) != 0)
+		return 1;
+
+	// page aligned and never paged out while registered
+	region = (char*)VirtualAlloc(NULL, RIO_MAX_SESSIONS * RIO_SLOT_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+
+	if (region == NULL)
+		return 1;
+
+	regionId = functions.RIORegisterBuffer(region, RIO_MAX_SESSIONS * RIO_SLOT_SIZE);
+
+	if (regionId == RIO_INVALID_BUFFERID) {
+		VirtualFree(region, 0, MEM_RELEASE);
+		region = NULL;
+
+		return 1;
+	}
+
+	ZeroMemory(&notifyContext, sizeof(IOContext));
+	notifyContext.operation = OPERATION_RIO;
+
+	RIO_NOTIFICATION_COMPLETION notification;
+	notification.Type = RIO_IOCP_COMPLETION;
+	notification.Iocp.IocpHandle = port;
+	notification.Iocp.CompletionKey = NULL;
+	notification.Iocp.Overlapped = &notifyContext.overlapped;
+
+	// one receive and one send per session
+	completions = functions.RIOCreateCompletionQueue(2 * RIO_MAX_SESSIONS, &notification);
+
+	if (completions == RIO_INVALID_CQ) {
+		functions.RIODeregisterBuffer(regionId);
+		VirtualFree(region, 0, MEM_RELEASE);
+
+		regionId = RIO_INVALID_BUFFERID;
+		region = NULL;
+
+		return 1;
+	}
+
+	available = true;
+
+	notify();
+
+	return 0;
+}
+
+/**
+* \brief	stop
+*
+* closes the completion queue and releases the region. called by shutdownSocket when the network thread has returned
+*/
+void RioChannel::stop() {
+	if (!available)
+		return;
+
+	available = false;
+
+	functions.RIOCloseCompletionQueue(completions);
+	functions.RIODeregisterBuffer(regionId);
+	VirtualFree(region, 0, MEM_RELEASE);
+
+	completions = RIO_INVALID_CQ;
+	regionId = RIO_INVALID_BUFFERID;
+	region = NULL;
+}
+
+/**
+* \brief	open
+*
+* takes a free slot for a new session and creates the request queue of its socket. the socket has to be created
+* with WSA_FLAG_REGISTERED_IO
+*
+* \param	socket	accepted socket
+* \param	session	session of the socket, the socket context of its completions
+*
+* \return	channel of the session, NULL if every slot is taken or the queue can't be created
+*/
+RioChannel *RioChannel::open(const SOCKET & socket, Session *session) {
+	if (!available)
+		return NULL;
+
+	for (unsigned int slot = 0; slot < RIO_MAX_SESSIONS; slot++) {
+		if (InterlockedCompareExchange(&slots[slot], 1, 0) != 0)
+			continue;
+
+		RIO_RQ requests = functions.RIOCreateRequestQueue(socket, 1, 1, 1, 1, completions, completions, session);
+
+		if (requests == RIO_INVALID_RQ) {
+			InterlockedExchange(&slots[slot], 0);
+
+			return NULL;
+		}
+
+		InterlockedIncrement(&metrics.rioSessions);
+
+		return new RioChannel(requests, slot);
+	}
+
+	return NULL;
+}
+
+/**
+* \brief	dequeue
+*
+* takes up to RIO_DEQUEUE_SIZE completions of every session at once. only called by the network thread
+*
+* \param	results	array of RIO_DEQUEUE_SIZE results
+*
+* \return	number of results, 0 if the queue is empty
+*/
+unsigned int const RioChannel::dequeue(RIORESULT *results) {
+	ULONG count = functions.RIODequeueCompletion(completions, results, RIO_DEQUEUE_SIZE);
+
+	if (count == RIO_CORRUPT_CQ)
+		return 0;
+
+	if (count > 0) {
+		InterlockedIncrement(&metrics.rioDequeues);
+		Metrics::add(metrics.rioCompletions, count);
+	}
+
+	return count;
+}
+
+/**
+* \brief	notify
+*
+* lets the completion queue post the next completion packet to the completion port, at once if it isn't empty.
+* only called by the network thread when the queue has been emptied
+*/
+void RioChannel::notify() {
+	functions.RIONotify(completions);
+}
+
+/**
+* \brief	receive
+*
+* starts a receive into the receive buffer of the slot. the request queue doesn't lock itself, the caller holds
+* the session section
+*
+* \return	1 if error, 0 if success
+*/
+int const RioChannel::receive() {
+	RIO_BUF buffer;
+	buffer.BufferId = regionId;
+	buffer.Offset = slot * RIO_SLOT_SIZE;
+	buffer.Length = RECEIVE_BUFFER_SIZE;
+
+	return functions.RIOReceive(requests, &buffer, 1, 0, (PVOID)OPERATION_RECEIVE) == TRUE ? 0 : 1;
+}
+
+/**
+* \brief	send
+*
+* copies the gathered buffers of a send into the send buffer of the slot and sends it. what doesn't fit stays
+* queued, the send completes with fewer bytes. the caller holds the session section
+*
+* \param	buffers	buffers gathered by Session::postSend
+* \param	count	number of buffers
+*
+* \return	1 if error, 0 if success
+*/
+int const RioChannel::send(const WSABUF *buffers, const DWORD & count) {
+	char *target = region + slot * RIO_SLOT_SIZE + RECEIVE_BUFFER_SIZE;
+	ULONG length = 0;
+
+	for (DWORD i = 0; i < count && length < RIO_SEND_SIZE; i++) {
+		ULONG part = min(buffers[i].len, (ULONG)RIO_SEND_SIZE - length);
+
+		memcpy(target + length, buffers[i].buf, part);
+		length += part;
+	}
+
+	RIO_BUF buffer;
+	buffer.BufferId = regionId;
+	buffer.Offset = slot * RIO_SLOT_SIZE + RECEIVE_BUFFER_SIZE;
+	buffer.Length = length;
+
+	return functions.RIOSend(requests, &buffer, 1, 0, (PVOID)OPERATION_SEND) == TRUE ? 0 : 1;
+}
@@ -0,0 +1,144 @@
+#pragma once
+#include "stdafx.h"
+
+// sessions with a registered slot, later ones are served through the completion port
+#define RIO_MAX_SESSIONS 64
+
+// bytes of the registered send buffer of a session. a send that gathers more is completed in parts
+#define RIO_SEND_SIZE 16384
+
+// registered bytes of one session: its receive buffer followed by its send buffer
+#define RIO_SLOT_SIZE (RECEIVE_BUFFER_SIZE + RIO_SEND_SIZE)
+
+// results taken from the completion queue with one RIODequeueCompletion
+#define RIO_DEQUEUE_SIZE 64
+
+
+// Registered I/O of Windows 8, the SDKs before it don't declare it. the functions are asked from the system at run
+// time, so the plugin keeps loading on older systems
+#ifndef RIO_CORRUPT_CQ
+typedef struct RIO_BUFFERID_t *RIO_BUFFERID;
+typedef struct RIO_CQ_t *RIO_CQ;
+typedef struct RIO_RQ_t *RIO_RQ;
+
+typedef struct _RIORESULT {
+	LONG Status;
+	ULONG BytesTransferred;
+	ULONGLONG SocketContext;
+	ULONGLONG RequestContext;
+} RIORESULT, *PRIORESULT;
+
+typedef struct _RIO_BUF {
+	RIO_BUFFERID BufferId;
+	ULONG Offset;
+	ULONG Length;
+} RIO_BUF, *PRIO_BUF;
+
+typedef enum _RIO_NOTIFICATION_COMPLETION_TYPE {
+	RIO_EVENT_COMPLETION = 1,
+	RIO_IOCP_COMPLETION = 2
+} RIO_NOTIFICATION_COMPLETION_TYPE;
+
+typedef struct _RIO_NOTIFICATION_COMPLETION {
+	RIO_NOTIFICATION_COMPLETION_TYPE Type;
+	union {
+		struct {
+			HANDLE EventHandle;
+			BOOL NotifyReset;
+		} Event;
+		struct {
+			HANDLE IocpHandle;
+			PVOID CompletionKey;
+			PVOID Overlapped;
+		} Iocp;
+	};
+} RIO_NOTIFICATION_COMPLETION, *PRIO_NOTIFICATION_COMPLETION;
+
+typedef BOOL (PASCAL *LPFN_RIORECEIVE)(RIO_RQ, PRIO_BUF, ULONG, DWORD, PVOID);
+typedef int (PASCAL *LPFN_RIORECEIVEEX)(RIO_RQ, PRIO_BUF, ULONG, PRIO_BUF, PRIO_BUF, PRIO_BUF, PRIO_BUF, DWORD, PVOID);
+typedef BOOL (PASCAL *LPFN_RIOSEND)(RIO_RQ, PRIO_BUF, ULONG, DWORD, PVOID);
+typedef BOOL (PASCAL *LPFN_RIOSENDEX)(RIO_RQ, PRIO_BUF, ULONG, PRIO_BUF, PRIO_BUF, PRIO_BUF, PRIO_BUF, DWORD, PVOID);
+typedef VOID (PASCAL *LPFN_RIOCLOSECOMPLETIONQUEUE)(RIO_CQ);
+typedef RIO_CQ (PASCAL *LPFN_RIOCREATECOMPLETIONQUEUE)(DWORD, PRIO_NOTIFICATION_COMPLETION);
+typedef RIO_RQ (PASCAL *LPFN_RIOCREATEREQUESTQUEUE)(SOCKET, ULONG, ULONG, ULONG, ULONG, RIO_CQ, RIO_CQ, PVOID);
+typedef ULONG (PASCAL *LPFN_RIODEQUEUECOMPLETION)(RIO_CQ, PRIORESULT, ULONG);
+typedef VOID (PASCAL *LPFN_RIODEREGISTERBUFFER)(RIO_BUFFERID);
+typedef INT (PASCAL *LPFN_RIONOTIFY)(RIO_CQ);
+typedef RIO_BUFFERID (PASCAL *LPFN_RIOREGISTERBUFFER)(PCHAR, DWORD);
+typedef BOOL (PASCAL *LPFN_RIORESIZECOMPLETIONQUEUE)(RIO_CQ, DWORD);
+typedef BOOL (PASCAL *LPFN_RIORESIZEREQUESTQUEUE)(RIO_RQ, DWORD, DWORD);
+
+typedef struct _RIO_EXTENSION_FUNCTION_TABLE {
+	DWORD cbSize;
+	LPFN_RIORECEIVE RIOReceive;
+	LPFN_RIORECEIVEEX RIOReceiveEx;
+	LPFN_RIOSEND RIOSend;
+	LPFN_RIOSENDEX RIOSendEx;
+	LPFN_RIOCLOSECOMPLETIONQUEUE RIOCloseCompletionQueue;
+	LPFN_RIOCREATECOMPLETIONQUEUE RIOCreateCompletionQueue;
+	LPFN_RIOCREATEREQUESTQUEUE RIOCreateRequestQueue;
+	LPFN_RIODEQUEUECOMPLETION RIODequeueCompletion;
+	LPFN_RIODEREGISTERBUFFER RIODeregisterBuffer;
+	LPFN_RIONOTIFY RIONotify;
+	LPFN_RIOREGISTERBUFFER RIORegisterBuffer;
+	LPFN_RIORESIZECOMPLETIONQUEUE RIOResizeCompletionQueue;
+	LPFN_RIORESIZEREQUESTQUEUE RIOResizeRequestQueue;
+} RIO_EXTENSION_FUNCTION_TABLE;
+
+#define RIO_INVALID_BUFFERID ((RIO_BUFFERID)0xFFFFFFFF)
+#define RIO_INVALID_CQ ((RIO_CQ)0)
+#define RIO_INVALID_RQ ((RIO_RQ)0)
+#define RIO_CORRUPT_CQ 0xFFFFFFFF
+
+#define WSAID_MULTIPLE_RIO { 0x8509e081, 0x96dd, 0x4005, { 0xb1, 0x65, 0x9e, 0x2e, 0xe8, 0xc7, 0x9e, 0x3f } }
+#endif
+
+#ifndef SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER
+#define SIO_GET_MULTIPLE_EXTENSION_FUNCTION_POINTER _WSAIORW(IOC_WS2, 36)
+#endif
+
+#ifndef WSA_FLAG_REGISTERED_IO
+#define WSA_FLAG_REGISTERED_IO 0x100
+#endif
+
+
+// Registered I/O of one session, an experimental backend next to the completion port for many clients that get
+// frequent small frames. every session has a slot of one registered region, so no send or receive locks its pages.
+// the completions of all sessions are taken in batches from one completion queue that reports to the completion
+// port of the server, the network thread handles them like the other completions, see networkFunction
+class RioChannel {
+	private:
+		static RIO_EXTENSION_FUNCTION_TABLE functions;
+		static bool available;
+
+		static RIO_CQ completions;
+
+		// completion packet the completion queue posts to the completion port, operation OPERATION_RIO
+		static IOContext notifyContext;
+
+		// registered memory of every slot, and 1 for each slot a session holds
+		static char *region;
+		static RIO_BUFFERID regionId;
+		static volatile LONG slots[RIO_MAX_SESSIONS];
+
+		RIO_RQ requests;
+		unsigned int slot;
+
+		RioChannel(const RIO_RQ & requests, const unsigned int & slot) : requests(requests), slot(slot) {}
+
+	public:
+		~RioChannel();
+
+		static int const start(const SOCKET & socket, const HANDLE & port);
+		static void stop();
+		static bool const isAvailable() { return available; }
+
+		static RioChannel *open(const SOCKET & socket, Session *session);
+		static unsigned int const dequeue(RIORESULT *results);
+		static void notify();
+
+		const char *received() const { return region + slot * RIO_SLOT_SIZE; }
+
+		int const receive();
+		int const send(const WSABUF *buffers, const DWORD & count);
+};
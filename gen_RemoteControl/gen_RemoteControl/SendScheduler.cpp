@@ -0,0 +1,240 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	SendScheduler
+*
+* constructor
+*/
+SendScheduler::SendScheduler() {
+	timer = NULL;
+	busy = 0;
+	controlBytes = 0;
+	turn = 0;
+
+	InitializeCriticalSection(&cs_scheduler);
+}
+
+/**
+* \brief	~SendScheduler
+*
+* destructor
+*/
+SendScheduler::~SendScheduler() {
+	DeleteCriticalSection(&cs_scheduler);
+}
+
+/**
+* \brief	isPacing
+*
+* \return	true while the rounds run, the bulk data of the sessions needs tokens then
+*/
+bool const SendScheduler::isPacing() const {
+	return timer != NULL;
+}
+
+/**
+* \brief	wait
+*
+* lets a session wait for the next round, called by the session when its bucket is empty and bulk data is left.
+* the session marks itself with scheduled, so it is only waiting once
+*
+* \param	session	session that has run out of tokens, gets a reference
+*/
+void SendScheduler::wait(Session *session) {
+	session->addRef();
+
+	// CRITICAL
+	EnterCriticalSection(&cs_scheduler);
+
+	waiting.push_back(session);
+
+	LeaveCriticalSection(&cs_scheduler);
+	// CRITICAL END
+
+	InterlockedIncrement(&metrics.sendWaits);
+}
+
+/**
+* \brief	charge
+*
+* counts bytes of a control queue against the interactive share of the current round
+*
+* \param	bytes	bytes handed to a socket
+*/
+void SendScheduler::charge(const LONG & bytes) {
+	if (timer != NULL)
+		InterlockedExchangeAdd(&controlBytes, bytes);
+}
+
+/**
+* \brief	start
+*
+* starts the rounds if they aren't running. called by updateTimers while clients are connected and uplink is set
+*
+* \return	1 if error, 0 if success
+*/
+int const SendScheduler::start() {
+	if (timer != NULL)
+		return 0;
+
+	HANDLE created = NULL;
+
+	if (CreateTimerQueueTimer(&created, NULL, roundTimeout, this, SEND_ROUND_INTERVAL, SEND_ROUND_INTERVAL, WT_EXECUTEDEFAULT) == FALSE)
+		return 1;
+
+	// started by another thread in the meantime
+	if (InterlockedCompareExchangePointer(&timer, created, NULL) != NULL)
+		DeleteTimerQueueTimer(NULL, created, NULL);
+
+	return 0;
+}
+
+/**
+* \brief	stop
+*
+* stops the rounds, the waiting sessions send their bulk data unpaced again. doesn't wait for a running round, it
+* hands its sessions back itself. called by stopServer and by updateTimers
+*/
+void SendScheduler::stop() {
+	std::deque<Session*> released;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_scheduler);
+
+	HANDLE running = InterlockedExchangePointer(&timer, NULL);
+
+	released.swap(waiting);
+
+	LeaveCriticalSection(&cs_scheduler);
+	// CRITICAL END
+
+	if (running != NULL)
+		DeleteTimerQueueTimer(NULL, running, NULL);
+
+	for (std::deque<Session*>::iterator it = released.begin(); it != released.end(); it++) {
+		InterlockedExchange(&(*it)->scheduled, 0);
+
+		(*it)->resumeBulk();
+		(*it)->release();
+	}
+}
+
+/**
+* \brief	weightOf
+*
+* \param	session	waiting session, a bulk connection has the weight of the session it carries the frames of
+*
+* \return	weight_<n> of the client, dashboardweight for a browser, SEND_WEIGHT_DEFAULT for others
+*/
+LONG const SendScheduler::weightOf(Session *session) {
+	Session *owner = session->bulkOwner != 0 ? sessionlist.get(session->bulkOwner) : NULL;
+	Session *client = owner != NULL ? owner : session;
+
+	LONG weight = client->weight > 0 ? client->weight : (client->web != NULL ? dashboardweight : SEND_WEIGHT_DEFAULT);
+
+	if (owner != NULL)
+		owner->release();
+
+	return max(weight, 1);
+}
+
+/**
+* \brief	roundTimeout
+*
+* timer callback, runs a round unless the last one is still running
+*
+* \param	parameter			scheduler
+* \param	timerOrWaitFired	unused
+*/
+VOID CALLBACK SendScheduler::roundTimeout(PVOID parameter, BOOLEAN timerOrWaitFired) {
+	SendScheduler *scheduler = (SendScheduler*)parameter;
+
+	if (InterlockedExchange(&scheduler->busy, 1) != 0)
+		return;
+
+	scheduler->round();
+
+	InterlockedExchange(&scheduler->busy, 0);
+}
+
+/**
+* \brief	round
+*
+* refills the buckets of the waiting sessions with the bulk part of the uplink bytes of one interval and lets the
+* ones with tokens send. the interactive share is kept even if the control queues have used less, so the bulk data
+* never fills the link up. the budget of a round without waiting sessions is gone, the buckets hold the burst
+*/
+void SendScheduler::round() {
+	std::vector<Session*> sessions;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_scheduler);
+
+	sessions.assign(waiting.begin(), waiting.end());
+	waiting.clear();
+
+	LeaveCriticalSection(&cs_scheduler);
+	// CRITICAL END
+
+	LONGLONG budget = (LONGLONG)max(uplink, 0) * 1024 * SEND_ROUND_INTERVAL / 1000;
+	LONGLONG control = InterlockedExchange(&controlBytes, 0);
+	LONGLONG available = budget - max(control, budget * SEND_INTERACTIVE_SHARE / 100);
+
+	std::vector<LONG> quanta(sessions.size());
+
+	for (unsigned int i = 0; i < sessions.size(); i++)
+		quanta[i] = SEND_QUANTUM * min(weightOf(sessions[i]), (LONG)SEND_WEIGHT_MAX);
+
+	// deficit round robin, a session whose bucket is full leaves its quanta to the others
+	bool granted = true;
+
+	while (available > 0 && granted) {
+		granted = false;
+
+		for (unsigned int n = 0; n < sessions.size() && available > 0; n++) {
+			unsigned int i = (turn + n) % sessions.size();
+			LONG depth = quanta[i] * SEND_BUCKET_QUANTA;
+			LONG tokens = sessions[i]->bulkTokens;
+
+			if (sessions[i]->closed != 0 || tokens >= depth)
+				continue;
+
+			LONG grant = (LONG)min((LONGLONG)min(quanta[i], depth - tokens), available);
+
+			InterlockedExchangeAdd(&sessions[i]->bulkTokens, grant);
+			Metrics::add(metrics.bulkBytesGranted, grant);
+
+			available -= grant;
+			granted = true;
+		}
+	}
+
+	turn++;
+
+	// sessions still in debt from a large frame wait on, before the ones that have run out in the meantime
+	std::vector<Session*> ready;
+	std::deque<Session*> kept;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_scheduler);
+
+	for (unsigned int i = 0; i < sessions.size(); i++) {
+		if (timer != NULL && sessions[i]->closed == 0 && sessions[i]->bulkTokens <= 0)
+			kept.push_back(sessions[i]);
+		else
+			ready.push_back(sessions[i]);
+	}
+
+	waiting.insert(waiting.begin(), kept.begin(), kept.end());
+
+	LeaveCriticalSection(&cs_scheduler);
+	// CRITICAL END
+
+	for (unsigned int i = 0; i < ready.size(); i++) {
+		InterlockedExchange(&ready[i]->scheduled, 0);
+
+		ready[i]->resumeBulk();
+		ready[i]->release();
+	}
+}
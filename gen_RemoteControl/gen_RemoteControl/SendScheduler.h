@@ -0,0 +1,64 @@
+#pragma once
+#include "stdafx.h"
+
+// milliseconds between two rounds of the scheduler, each one hands out the uplink bytes of its interval
+#define SEND_ROUND_INTERVAL 25
+
+// percent of every round kept for the interactive and metadata frames, the bulk data gets the rest at most
+#define SEND_INTERACTIVE_SHARE 20
+
+// bulk bytes a session gets per weight and pass of a round
+#define SEND_QUANTUM 1500
+
+// quanta a token bucket holds at most, the burst of a session that starts sending again
+#define SEND_BUCKET_QUANTA 8
+
+// weight of a native client that hasn't sent weight_<n>, and the highest weight it may ask for
+#define SEND_WEIGHT_DEFAULT 4
+#define SEND_WEIGHT_MAX 16
+
+
+// fair share of the uplink between the sessions while the uplink setting is set. the interactive and metadata frames
+// of the control queues are never held, the bulk frames (covers, playlist windows, audio, the frames of a bulk
+// connection) of a session are only handed to the socket while its token bucket has bytes. the buckets are refilled
+// every SEND_ROUND_INTERVAL milliseconds by deficit round robin over the waiting sessions: every pass gives each one
+// SEND_QUANTUM bytes per weight until the bulk part of the round is spent. a tablet paging a large playlist with
+// thumbnails so gets its share and no more, the play/pause of another phone doesn't wait behind its data in the
+// socket buffers. a kiosk dashboard lowers its weight with weight_<n>, the browser sessions get dashboardweight
+class SendScheduler {
+	private:
+		HANDLE volatile timer;
+
+		// 1 while a round runs, the timer doesn't wait for the last one
+		volatile LONG busy;
+
+		// sessions whose bulk data waits for tokens in the order they have run out, each one holds a reference
+		std::deque<Session*> waiting;
+
+		// bytes of the control queues handed to the sockets since the last round
+		volatile LONG controlBytes;
+
+		// session the next round starts its passes at, only used by the running round
+		unsigned int turn;
+
+		// critical scheduler section
+		CRITICAL_SECTION cs_scheduler;
+
+		static VOID CALLBACK roundTimeout(PVOID parameter, BOOLEAN timerOrWaitFired);
+		static LONG const weightOf(Session *session);
+
+		void round();
+
+	public:
+		SendScheduler();
+
+		~SendScheduler();
+
+		bool const isPacing() const;
+
+		void wait(Session *session);
+		void charge(const LONG & bytes);
+
+		int const start();
+		void stop();
+};
@@ -0,0 +1,329 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	ServerHost
+*
+* constructor
+*/
+ServerHost::ServerHost() {
+	process = NULL;
+	executor = NULL;
+	forwarding = 0;
+	calling = 0;
+
+	callMessage = 0;
+	callWParam = 0;
+	callLParam = 0;
+}
+
+/**
+* \brief	~ServerHost
+*
+* destructor
+*/
+ServerHost::~ServerHost() {
+	if (process != NULL)
+		CloseHandle(process);
+}
+
+/**
+* \brief	isHosted
+*
+* \return	true if the plugin runs in RemoteControlHost, its window answers HOST_HOSTED_IPC
+*/
+bool const ServerHost::isHosted() {
+	UINT_PTR ipc = SendMessage(plugin.hwndParent, WM_WA_IPC, (WPARAM)HOST_HOSTED_IPC, IPC_REGISTER_WINAMP_IPCMESSAGE);
+
+	return ipc != 0 && SendMessage(plugin.hwndParent, WM_WA_IPC, 0, ipc) == 1;
+}
+
+/**
+* \brief	start
+*
+* creates the rings and starts RemoteControlHost with the plugin, it starts the server there
+*
+* \return	1 if error, 0 if success
+*/
+int const ServerHost::start() {
+	char module[MAX_PATH];
+
+	if (GetModuleFileNameA(plugin.hDllInstance, module, MAX_PATH) == 0)
+		return 1;
+
+	std::string executable(module);
+	executable = executable.substr(0, executable.find_last_of('\\') + 1) + SERVER_HOST_EXECUTABLE;
+
+	stringstream name;
+	name << "Local\\RemoteControl_host_" << GetCurrentProcessId();
+
+	if (!channel.open(name.str(), true))
+		return 1;
+
+	stringstream command;
+	command << "\"" << executable << "\" \"" << module << "\" --proxy " << name.str() << " " << GetCurrentProcessId();
+
+	std::string line = command.str();
+
+	STARTUPINFOA startup;
+	ZeroMemory(&startup, sizeof(startup));
+	startup.cb = sizeof(startup);
+
+	PROCESS_INFORMATION info;
+
+	if (CreateProcessA(executable.c_str(), &line[0], NULL, NULL, FALSE, CREATE_NO_WINDOW, NULL, NULL, &startup, &info) == FALSE) {
+		channel.close();
+
+		return 1;
+	}
+
+	CloseHandle(info.hThread);
+	process = info.hProcess;
+
+	InterlockedExchange(&forwarding, 1);
+
+	executor = CreateThread(NULL, 0, executorFunction, this, 0, NULL);
+
+	if (executor == NULL) {
+		stop();
+
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+* \brief	stop
+*
+* has the host quit the server and waits for it. the calls of the server while it quits are answered, so the sent
+* messages of the executor are handled while waiting. a host that doesn't exit in time is terminated
+*/
+void ServerHost::stop() {
+	if (process == NULL)
+		return;
+
+	InterlockedExchange(&forwarding, 0);
+
+	channel.rings[HOST_RING_EVENTS].write(HOST_QUIT, 0, 0, 0, 0);
+
+	DWORD started = GetTickCount();
+	DWORD elapsed = 0;
+
+	while (elapsed < SERVER_HOST_STOP_TIMEOUT && MsgWaitForMultipleObjects(1, &process, FALSE, SERVER_HOST_STOP_TIMEOUT - elapsed, QS_SENDMESSAGE) == WAIT_OBJECT_0 + 1) {
+		MSG message;
+		PeekMessage(&message, NULL, 0, 0, PM_NOREMOVE | PM_QS_SENDMESSAGE);
+
+		elapsed = GetTickCount() - started;
+	}
+
+	if (WaitForSingleObject(process, 0) != WAIT_OBJECT_0) {
+		UIManager::addLogText("RemoteControlHost didn't quit in time!\r\n", LOG_ERROR);
+
+		TerminateProcess(process, 1);
+	}
+
+	joinThread(executor, SERVER_HOST_STOP_TIMEOUT);
+
+	CloseHandle(process);
+	process = NULL;
+
+	channel.close();
+}
+
+/**
+* \brief	showConfig
+*
+* has the host show the window of the plugin
+*/
+void ServerHost::showConfig() {
+	channel.rings[HOST_RING_EVENTS].write(HOST_CONFIG, 0, 0, 0, 0);
+}
+
+/**
+* \brief	forward
+*
+* writes an event of the winamp window into the event ring, the ones the hook of the plugin handles. a pointer
+* parameter is copied. called by the MainWndProc hook for every message, the others pass with a few comparisons
+*
+* \param	message	message of the window
+* \param	wParam	parameter
+* \param	lParam	parameter
+*/
+void ServerHost::forward(const UINT & message, const WPARAM & wParam, const LPARAM & lParam) {
+	if (forwarding == 0)
+		return;
+
+	const void *payload = NULL;
+	unsigned int length = 0;
+
+	switch (message) {
+		case WM_WA_IPC:
+			switch (lParam) {
+				case 636:	// item has just finished playback or next button is pressed
+				case IPC_JUMPTOTIME:
+				case IPC_PLAYLIST_MODIFIED:
+				case IPC_SETPLAYLISTPOS:
+					break;
+				case IPC_SETVOLUME:
+					if (wParam == -666)	// a query
+						return;
+					break;
+				case IPC_PLAYING_FILE:
+				case IPC_FILE_TAG_MAY_HAVE_UPDATED:
+					if (wParam != 0) {
+						payload = (const char*)wParam;
+						length = strlen((const char*)wParam) + 1;
+					}
+					break;
+				case IPC_FILE_TAG_MAY_HAVE_UPDATEDW:
+					if (wParam != 0) {
+						payload = (const wchar_t*)wParam;
+						length = (wcslen((const wchar_t*)wParam) + 1) * sizeof(wchar_t);
+					}
+					break;
+				default:
+					if (genjtfe_queue == NULL || (UINT_PTR)lParam != genjtfe_queue)
+						return;
+			}
+			break;
+		case WM_COMMAND:
+		case WM_SYSCOMMAND:
+			// repeat, shuffle, previous, play, pause, stop and next button
+			if (wParam != 40022 && wParam != 40023 && (wParam < 40044 || wParam > 40048))
+				return;
+			break;
+		case WM_MOUSEWHEEL:
+			break;
+		default:
+			return;
+	}
+
+	// a call of the host, its hook has seen it already
+	if (calling != 0 && message == callMessage && wParam == callWParam && lParam == callLParam)
+		return;
+
+	channel.rings[HOST_RING_EVENTS].write(HOST_EVENT, 0, message, wParam, lParam, payload, length);
+}
+
+/**
+* \brief	send
+*
+* sends a call of the host to winamp
+*
+* \return	result of winamp
+*/
+LRESULT const ServerHost::send(const UINT & message, const WPARAM & wParam, const LPARAM & lParam) {
+	callMessage = message;
+	callWParam = wParam;
+	callLParam = lParam;
+
+	InterlockedExchange(&calling, 1);
+
+	LRESULT result = SendMessage(plugin.hwndParent, message, wParam, lParam);
+
+	InterlockedExchange(&calling, 0);
+
+	return result;
+}
+
+/**
+* \brief	execute
+*
+* runs a call of the host and writes its result into the reply ring. a string the result points to is copied,
+* the structure of IPC_ENQUEUEFILEW is built from its marshalled strings
+*
+* \param	record	HOST_IPC or HOST_QUEUE
+* \param	payload	marshalled parameter
+*/
+void ServerHost::execute(const SharedRecord & record, const std::string & payload) {
+	LRESULT result = 0;
+	std::string text;
+
+	if (record.type == HOST_IPC) {
+		UINT message = (UINT)record.values[0];
+		WPARAM wParam = (WPARAM)record.values[1];
+		LPARAM lParam = (LPARAM)record.values[2];
+
+		if (message == WM_WA_IPC && lParam == IPC_ENQUEUEFILEW && payload.length() > sizeof(int)) {
+			// length, file and title, each terminated
+			const wchar_t *file = (const wchar_t*)(payload.data() + sizeof(int));
+			const wchar_t *title = file + wcslen(file) + 1;
+
+			enqueueFileWithMetaStructW entry;
+			entry.filename = file;
+			entry.title = title[0] != L'\0' ? title : NULL;
+			entry.length = *(const int*)payload.data();
+
+			result = send(message, (WPARAM)&entry, lParam);
+		} else {
+			result = send(message, wParam, lParam);
+
+			if (message == WM_WA_IPC && result != 0) {
+				if (lParam == IPC_GETPLAYLISTFILE)
+					text.assign((const char*)result, strlen((const char*)result) + 1);
+				else if (lParam == IPC_GETPLAYLISTFILEW || lParam == IPC_GETPLAYLISTTITLEW)
+					text.assign((const char*)result, (wcslen((const wchar_t*)result) + 1) * sizeof(wchar_t));
+			}
+		}
+	} else if (record.type == HOST_QUEUE) {
+		int first = (int)record.values[1];
+		int second = (int)record.values[2];
+
+		CHECK_QUEUEMGR();
+
+		if (WASABI_API_QUEUEMGR != NULL) {
+			switch ((int)record.values[0]) {
+				case api_queue::API_QUEUE_ADDITEMTOQUEUE:
+					result = WASABI_API_QUEUEMGR->AddItemToQueue(first, second, NULL);
+					break;
+				case api_queue::API_QUEUE_REMOVEQUEUEDITEM:
+					WASABI_API_QUEUEMGR->RemoveQueuedItem(first, second);
+					break;
+				case api_queue::API_QUEUE_CLEARQUEUE:
+					WASABI_API_QUEUEMGR->ClearQueue();
+					break;
+				case api_queue::API_QUEUE_GETNUMBEROFQUEUEDITEMS:
+					result = WASABI_API_QUEUEMGR->GetNumberOfQueuedItems();
+					break;
+				case api_queue::API_QUEUE_GETQUEUEDITEMFROMINDEX:
+					result = WASABI_API_QUEUEMGR->GetQueuedItemFromIndex(first);
+					break;
+			}
+		}
+	} else
+		return;
+
+	channel.rings[HOST_RING_REPLIES].write(HOST_REPLY, record.sequence, result, 0, 0, text.data(), text.length());
+}
+
+/**
+* \brief	executorFunction
+*
+* runs the calls of the host until it has exited
+*
+* \param	parameter	ServerHost
+*
+* \return	0
+*/
+DWORD WINAPI ServerHost::executorFunction(LPVOID parameter) {
+	ServerHost *host = (ServerHost*)parameter;
+	SharedRing & commands = host->channel.rings[HOST_RING_COMMANDS];
+
+	ThreadPolicy policy(THREAD_CLASS_INTERACTIVE);
+
+	HANDLE handles[] = { host->process, commands.event() };
+
+	SharedRecord record;
+	std::string payload;
+
+	while (WaitForMultipleObjects(2, handles, FALSE, INFINITE) == WAIT_OBJECT_0 + 1) {
+		while (commands.read(record, payload))
+			host->execute(record, payload);
+	}
+
+	if (InterlockedExchange(&host->forwarding, 0) != 0)
+		UIManager::addLogText("RemoteControlHost has exited, the server is stopped!\r\n", LOG_ERROR);
+
+	return 0;
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include "stdafx.h"
+
+// executable of the host, next to the plugin
+#define SERVER_HOST_EXECUTABLE "RemoteControlHost.exe"
+
+// milliseconds quit waits for the host to quit the server
+#define SERVER_HOST_STOP_TIMEOUT 5000
+
+
+// runs the server in RemoteControlHost instead of winamp if hostprocess is set. the plugin in winamp is only a shim:
+// the MainWndProc hook writes the events of the window into the event ring and a thread runs the calls of the host
+// from the command ring on winamp. the plugin in the host treats the host window as winamp: its hook gets the
+// replayed events and its messages to winamp are answered through the rings. the networking, the caches, the
+// parsing and the UI use the address space of the host, and a crash of the server doesn't take winamp with it
+class ServerHost {
+	private:
+		HostChannel channel;
+
+		HANDLE process;
+		volatile HANDLE executor;
+
+		// 1 while the hook forwards the events, until the host has exited
+		volatile LONG forwarding;
+
+		// call the executor is sending to winamp, the hook doesn't return it to the host as an event
+		volatile LONG calling;
+		UINT callMessage;
+		WPARAM callWParam;
+		LPARAM callLParam;
+
+		static DWORD WINAPI executorFunction(LPVOID parameter);
+		void execute(const SharedRecord & record, const std::string & payload);
+		LRESULT const send(const UINT & message, const WPARAM & wParam, const LPARAM & lParam);
+
+	public:
+		ServerHost();
+
+		~ServerHost();
+
+		static bool const isHosted();
+
+		int const start();
+		void stop();
+		void showConfig();
+		void forward(const UINT & message, const WPARAM & wParam, const LPARAM & lParam);
+
+		bool const isActive() const { return process != NULL; }
+};
@@ -1,9 +1,38 @@
 #include "stdafx.h"
 
+// session of the task currently performed by sendCommandThread. only written by sendCommandThread
+volatile int sendTarget = ALL_SESSIONS;
+
+// TOPIC_ flag of the broadcast the current task sends, 0 if every synchronized session gets it
+volatile int sendTopic = 0;
+
+// broadcast state event the current task sends, congested sessions hold its latest value instead. NULL for other tasks
+const Task *sendState = NULL;
+
+// pending AcceptEx of the listening socket
+IOContext acceptContext;
+SOCKET acceptSocket = INVALID_SOCKET;
+char acceptBuffer[2 * (sizeof(sockaddr_in) + 16)];
+
+// 1 if the MainWndProc callback hook is enabled
+volatile LONG hookInstalled = 0;
+
+LatencyStats latencyStats[SOCKET_PROFILE_THROUGHPUT + 1];
+HANDLE qosHandle = NULL;
+
+// removes the hook JOURNAL_WINDOW milliseconds after the last client has disconnected
+HANDLE volatile hookTimer = NULL;
+
+// notifications of changed network interfaces and addresses while the server runs
+HANDLE interfaceNotification = NULL;
+HANDLE addressNotification = NULL;
+
 /**
 * \brief	startServer
 *	
-* starts the RemoteControl server: initializes playlist queue, reads settings from settings file, starts socket+waitingForClient thread
+* starts the RemoteControl server: initializes playlist queue, starts socket, network and sendCommand threads.
+* the timers only run while clients are connected, see updateTimers. uses the current settings, init has read them
+* and the UI applies its changes
 */
 void startServer() {
 	connecting = true;
@@ -18,19 +47,15 @@ void startServer() {
 
 	
 	////////////////////////////////////////// UI ///////////////////////////////////////////////////////
-	UIManager::setButtonText("Abort");
-	UIManager::addLogText("Starting server on port " + port + "\r\n");
+	UIManager::setButtonText("Stop server");
+	stringstream portStream;
+	portStream << "Starting server on port " << port << "\r\n";
+
+	UIManager::addLogText(portStream.str());
 	
 	UIManager::setStatusText("Starting socket...");
 	/////////////////////////////////////////////////////////////////////////////////////////////////////
 
-	// get current settings
-	if (readSettings() == 1) {
-		UIManager::addLogText("Could not read settings!\r\n");
-		return;
-	}
-
-
 	// start socket
 	if (startSocket() == 1) {
 		// ERROR
@@ -46,8 +71,41 @@ void startServer() {
 		UIManager::setStatusText("Waiting for client...");
 		/////////////////////////////////////////////////////////////////////////////////////////////////////
 		
-		// wait for client
-		waitingForClientThread = CreateThread(NULL, 0, waitingForClientFunction, 0, 0, NULL);
+		// marks the traffic of the latency profile
+		if (socketprofile != SOCKET_PROFILE_THROUGHPUT) {
+			QOS_VERSION version;
+			version.MajorVersion = 1;
+			version.MinorVersion = 0;
+
+			if (QOSCreateHandle(&version, &qosHandle) == FALSE)
+				qosHandle = NULL;
+		}
+
+		metrics.reset();
+
+		// new event for every start, a thread of the last run that didn't stop in time keeps its own
+		serverStopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+		networkThread = CreateThread(NULL, 0, networkFunction, 0, 0, NULL);
+		sendCommandThread = CreateThread(NULL, 0, sendCommandFunction, serverStopEvent, 0, NULL);
+
+		// the credentials are kept until quit, SChannel resumes the TLS sessions of returning clients with them
+		if (tlstransport == 1 && TlsChannel::start() != 0)
+			UIManager::addLogText("No certificate for TLS found, clients connect without TLS\r\n");
+
+		// clients whose address of the server is outdated find it again
+		if (discovery.start(port) != 0)
+			UIManager::addLogText("Could not start server discovery\r\n", LOG_ERROR);
+
+		// wait for clients
+		if (postAccept() != 0) {
+			UIManager::addLogText("Could not accept client\r\n", LOG_ERROR);
+
+			stopServer(true);
+		} else {
+			// fill the metadata cache before the clients ask
+			playlistscanner.start();
+		}
 	}
 
 }
@@ -55,37 +113,106 @@ void startServer() {
 /**
 * \brief	stopServer
 *
-* stops the server, kills threads, disables MainWndProc callback hook
+* stops the server, disconnects all clients, stops the threads, disables MainWndProc callback hook
 *
 * \return showLogMessage shows log message "disconnected" if true
 */
 void stopServer(bool showLogMessage) {
+	connecting = false;
 	connected = false;
-	
-	// kill threads if running. DON'T KILL keepAliveMessagesThread OR CLIENT CONNECTION LOSE WON'T BE RECOGNIZED
-	TerminateThread(waitingForClientThread,0);
-	TerminateThread(sendCommandThread,0);
-	
-	// shutdown socket
+
+	// sendCommandThread returns
+	if (serverStopEvent != NULL)
+		SetEvent(serverStopEvent);
+
+	// waits for a running callback
+	HANDLE keepAlive = InterlockedExchangePointer(&keepAliveTimer, NULL);
+
+	if (keepAlive != NULL)
+		DeleteTimerQueueTimer(NULL, keepAlive, INVALID_HANDLE_VALUE);
+
+	// disable MainWndProc callback hook
+	HANDLE timer = InterlockedExchangePointer(&hookTimer, NULL);
+
+	if (timer != NULL)
+		DeleteTimerQueueTimer(NULL, timer, INVALID_HANDLE_VALUE);
+
+	removeHook();
+
+	datagramchannel.stop();
+	discovery.stop();
+	trackprefetch.stop();
+	progressticker.stop();
+	sendscheduler.stop();
+
+	// disconnect all clients
+	sessionlist.removeAll();
+
+	if (qosHandle != NULL) {
+		QOSCloseHandle(qosHandle);
+		qosHandle = NULL;
+	}
+
+	// a running task finishes first
+	int running = joinThread(sendCommandThread, THREAD_STOP_TIMEOUT);
+
+	// shutdown socket, stops network thread
 	shutdownSocket();
+
+	if (running != 0 || networkThread != NULL) {
+		// the thread returns later, only its handle is dropped. the stop event stays set for it
+		UIManager::addLogText("Server thread did not stop in time\r\n");
+
+		if (sendCommandThread != NULL)
+			CloseHandle(sendCommandThread);
+
+		if (networkThread != NULL)
+			CloseHandle(networkThread);
+
+		sendCommandThread = NULL;
+		networkThread = NULL;
+	} else if (serverStopEvent != NULL)
+		CloseHandle(serverStopEvent);
+
+	serverStopEvent = NULL;
 		
 	////////////////////////////////////////// UI ///////////////////////////////////////////////////////
 	UIManager::setStatusText("Disconnected");
 	UIManager::setButtonText("Start server");
+	UIManager::setMemoryText(MemoryTag::summary());
+
+	if (showLogMessage == true) {
+		stringstream cacheStream;
+		cacheStream << "Metadata cache: " << metadatacache.getHits() << " hits, " << metadatacache.getMisses() << " misses\r\n";
+
+		UIManager::addLogText(cacheStream.str());
+
+		std::vector<std::string> lines;
+		metrics.report(lines);
+
+		for (unsigned int i = 0; i < lines.size(); i++)
+			UIManager::addLogText(lines[i] + "\r\n");
+
+		for (int profile = SOCKET_PROFILE_LATENCY; profile <= SOCKET_PROFILE_THROUGHPUT; profile++) {
+			LONG samples = latencyStats[profile].samples;
 
-	if (showLogMessage == true)
+			if (samples > 0) {
+				stringstream profileStream;
+				profileStream << (profile == SOCKET_PROFILE_LATENCY ? "Latency" : "Throughput") << " profile: " << samples << " round trips, "
+					<< latencyStats[profile].total / samples << " ms average, " << latencyStats[profile].maximum << " ms maximum\r\n";
+
+				UIManager::addLogText(profileStream.str());
+			}
+		}
 		UIManager::addLogText("Disconnected\r\n\r\n");
+	}
 	/////////////////////////////////////////////////////////////////////////////////////////////////////
-
-	// disable MainWndProc callback hook
-	if( lpWndProcOld )
-		SetWindowLongPtr(plugin.hwndParent, GWL_WNDPROC, (LONG)lpWndProcOld); 
 }
 
 /**
 * \brief	startSocket
 *
-* start winsock (WSA), create+bind+listen socket and displays local IP address
+* start winsock (WSA), create+bind+listen socket, create the completion port and displays local IP address
 *
 *
 * \return	1 if error, 0 if success
@@ -95,7 +222,21 @@ int const startSocket() {
 	int err = startWinsock();
 
 	if(err != 0) {
-		UIManager::addLogText("Could not start Winsock. Error code " + err + "\r\n");
+		stringstream errorStream;
+		errorStream << "Could not start Winsock. Error code " << err << "\r\n";
+
+		UIManager::addLogText(errorStream.str(), LOG_ERROR);
+
+		return 1;
+	}
+
+	// create completion port
+
+	iocp = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
+	if (iocp == NULL) {
+		UIManager::addLogText("Could not create completion port\r\n", LOG_ERROR);
+
+		stopServer(true);
 
 		return 1;
 	}
@@ -104,7 +245,7 @@ int const startSocket() {
 
 	s = socket(PF_INET, SOCK_STREAM, 0);
 	if (s == INVALID_SOCKET) {
-		UIManager::addLogText("Could not create socket\r\n");
+		UIManager::addLogText("Could not create socket\r\n", LOG_ERROR);
 
 		stopServer(true);
 
@@ -139,74 +280,135 @@ int const startSocket() {
 	}
 
 
-	// check and display local IP address
-	System::String^ address = GetLocalIP();
+	// accepted clients are reported to the completion port
+
+	if (CreateIoCompletionPort((HANDLE)s, iocp, 0, 0) == NULL) {
+		UIManager::addLogText("Could not create completion port\r\n", LOG_ERROR);
+
+		stopServer(true);
+
+		return 1;
+	}
+
+
+	// experimental, the accepted sockets are created for Registered I/O while it is available
+	if (riotransport == 1 && RioChannel::start(s, iocp) != 0)
+		UIManager::addLogText("Registered I/O not available, clients are served through the completion port\r\n");
+
+
+	// check and display local IP address, again when the interfaces change
+	showLocalIP();
+
+	if (NotifyIpInterfaceChange(AF_INET, interfaceChanged, NULL, FALSE, &interfaceNotification) != NO_ERROR)
+		interfaceNotification = NULL;
+
+	if (NotifyUnicastIpAddressChange(AF_INET, addressChanged, NULL, FALSE, &addressNotification) != NO_ERROR)
+		addressNotification = NULL;
+
+	return 0;
+}
+
+/**
+* \brief	showLocalIP
+*
+* displays the local IP addresses
+*/
+void showLocalIP() {
+	std::string address = GetLocalIP();
 	
-	if(address->Equals("127.0.0.1\r\n") || address->Equals(""))
+	if (address.empty())
 		UIManager::setIP("No network connection");
 	else
 		UIManager::setIP(address);
+}
 
-	return 0;
+/**
+* \brief	interfaceChanged
+*
+* callback of NotifyIpInterfaceChange, an interface has been added, removed or changed
+*/
+VOID WINAPI interfaceChanged(PVOID context, PMIB_IPINTERFACE_ROW row, MIB_NOTIFICATION_TYPE type) {
+	showLocalIP();
+}
+
+/**
+* \brief	addressChanged
+*
+* callback of NotifyUnicastIpAddressChange, an address has been added, removed or changed
+*/
+VOID WINAPI addressChanged(PVOID context, PMIB_UNICASTIPADDRESS_ROW row, MIB_NOTIFICATION_TYPE type) {
+	showLocalIP();
 }
 
 
 /**
 * \brief	shutdownSocket
 *
-* shuts down the socket and cleans up WSA
+* shuts down the listening socket, stops the network thread, closes the completion port and cleans up WSA
 *
 */
 void shutdownSocket() {
 
-	// close connection
-	shutdown(c, 2);
-	shutdown(s, 2);
+	// waits for running callbacks
+	if (interfaceNotification != NULL) {
+		CancelMibChangeNotify2(interfaceNotification);
+		interfaceNotification = NULL;
+	}
+
+	if (addressNotification != NULL) {
+		CancelMibChangeNotify2(addressNotification);
+		addressNotification = NULL;
+	}
 
-	closesocket(c);
+	// close listening socket, pending AcceptEx returns with an error
+	shutdown(s, 2);
 	closesocket(s);
 
-	// clean up WSA
-	WSACleanup();
-}
+	if (iocp != NULL) {
+		// stop network thread
+		PostQueuedCompletionStatus(iocp, 0, 0, NULL);
 
+		joinThread(networkThread, THREAD_STOP_TIMEOUT);
 
-/**
-* \brief	startWinsock
-*
-* initializes WSA
-*
-* \return	0 if success, else error code
-*/
-int const startWinsock() {
-  WSADATA wsa;
+		RioChannel::stop();
 
-  return WSAStartup(MAKEWORD(2,0),&wsa);
-}
+		CloseHandle(iocp);
+		iocp = NULL;
+	}
+
+	if (acceptSocket != INVALID_SOCKET) {
+		closesocket(acceptSocket);
+		acceptSocket = INVALID_SOCKET;
+	}
 
+	// clean up WSA
+	WSACleanup();
+}
 
 
 /**
-* \brief	rawSend
-*
-* sends a raw std::string and adds \n
+* \brief	postAccept
 *
-* \param	const char *parameter		
+* starts an overlapped accept on the listening socket. the new client is delivered to the network thread through the completion port
 *
 * \return	1 if error, 0 if success
 */
-int const rawSend(const char *parameter) {
-	int result;
+int const postAccept() {
+	DWORD flags = WSA_FLAG_OVERLAPPED | (RioChannel::isAvailable() ? WSA_FLAG_REGISTERED_IO : 0);
+
+	acceptSocket = WSASocket(AF_INET, SOCK_STREAM, IPPROTO_TCP, NULL, 0, flags);
+	if (acceptSocket == INVALID_SOCKET)
+		return 1;
 
-	string parameterFull(parameter);
-	parameterFull.append("\n");
+	ZeroMemory(&acceptContext, sizeof(IOContext));
+	acceptContext.operation = OPERATION_ACCEPT;
 
-	// send
-	result = send(c,parameterFull.c_str(),parameterFull.length(),0);
+	DWORD bytes = 0;
 
-	// check if successfully sent
-	if (result == -1) {
-		UIManager::addLogText("Could not send data\r\n");
+	if (AcceptEx(s, acceptSocket, acceptBuffer, 0, sizeof(sockaddr_in) + 16, sizeof(sockaddr_in) + 16, &bytes, &acceptContext.overlapped) == FALSE
+		&& WSAGetLastError() != ERROR_IO_PENDING) {
+		closesocket(acceptSocket);
+		acceptSocket = INVALID_SOCKET;
 
 		return 1;
 	}
@@ -215,337 +417,1197 @@ int const rawSend(const char *parameter) {
 }
 
 /**
-* \brief	sendCover
-*
-* sends the cover length (bits) and the cover data. to keep socket thread safe only access via TaskList!
+* \brief	acceptCompleted
 *
-* \param prefix prefix for every coverlength string
-* \param number track number of file to read. currently playing track if -1
+* called by the network thread when a client has been accepted: creates its session, schedules the
+* synchronization, starts receiving commands and waits for the next client
 *
-* \return	0 if success, 1 if error
+* \param	success	false if AcceptEx failed
 */
-int const sendCover(const char* prefix, const int & number) {
-	string prefixStr(prefix);
+void acceptCompleted(const bool & success) {
+	SOCKET client = acceptSocket;
+	acceptSocket = INVALID_SOCKET;
 
-	unsigned int coverLength = 0;
-	char* data = NULL;
+	// server stopped
+	if (connecting == false) {
+		closesocket(client);
 
-	string fullPath;
-
-	// if -1 then currently playing track. else select track number from playlist
-	if (number == -1)
-		fullPath = (char*)SendMessage(plugin.hwndParent,WM_WA_IPC,SendMessage(plugin.hwndParent,WM_WA_IPC,0,IPC_GETLISTPOS),IPC_GETPLAYLISTFILE);
-	else
-		fullPath = (char*)SendMessage(plugin.hwndParent,WM_WA_IPC,number,IPC_GETPLAYLISTFILE);
+		return;
+	}
 
-	// get file extension
-	string extension(GetFileExtension(fullPath));
+	if (success == false) {
+		UIManager::addLogText("Could not accept client\r\n", LOG_ERROR);
 
-	// low character file extension
-	std::transform(extension.begin(), extension.end(), extension.begin(), tolower); 
-	
-	if (extension.compare("mp3") == 0) {
-		TagLib::MPEG::File file(fullPath.c_str());
+		closesocket(client);
+	} else {
+		SOCKET listening = s;
+		setsockopt(client, SOL_SOCKET, SO_UPDATE_ACCEPT_CONTEXT, (char*)&listening, sizeof(listening));
+
+		// the network thread reads what the zero byte receives announce, it must never wait in recv
+		u_long nonBlocking = 1;
+		ioctlsocket(client, FIONBIO, &nonBlocking);
+
+		// the TCP stack detects dead peers too, also of clients that don't answer keep alive messages
+		if (keepalivemessages == 1) {
+			tcp_keepalive keepAlive;
+			keepAlive.onoff = 1;
+			keepAlive.keepalivetime = (keepaliveinterval > 0 ? keepaliveinterval : 1) * 1000;
+			keepAlive.keepaliveinterval = 1000;
+
+			DWORD bytes = 0;
+			WSAIoctl(client, SIO_KEEPALIVE_VALS, &keepAlive, sizeof(keepAlive), NULL, 0, &bytes, NULL, NULL);
+		}
 
-		TagLib::ID3v2::Tag *id3v2tag;
+		Session *session = sessionlist.add(client);
 
-		if(file.isValid()) {
-			try {
-				id3v2tag = file.ID3v2Tag();
-			} catch (...) {
-				prefixStr += "coverLength_0";
+		if (applySocketProfile(session) != 0)
+			UIManager::addLogText("Could not set socket options\r\n", LOG_ERROR);
 
-				if (rawSend(prefixStr.c_str()) != 0)
-					UIManager::addLogText("Sending cover info failed!\r\n");
+		// sessions above RIO_MAX_SESSIONS use the completion port
+		session->rio = RioChannel::open(client, session);
 
-				return 1;
-			}
+		if (session->rio == NULL && CreateIoCompletionPort((HANDLE)client, iocp, 0, 0) == NULL) {
+			UIManager::addLogText("Could not accept client\r\n", LOG_ERROR);
 
-			if(id3v2tag) {
-				if(!file.ID3v2Tag()) {	// file open+readable, has id3v2 tag
-					prefixStr += "coverLength_0";
+			closeSession(session, false);
+		} else {
+			UIManager::addLogText("Connected\r\n");
 
-					if (rawSend(prefixStr.c_str()) != 0)
-						UIManager::addLogText("Sending cover info failed!\r\n");
+			// the new client gets the complete state first, broadcasts follow after that. give it the chance
+			// to request the framed protocol before
+			session->addRef();
 
-					return 1;
-				}
+			if (CreateTimerQueueTimer(&session->handshakeTimer, NULL, handshakeTimeout, session, HANDSHAKE_TIMEOUT, 0, WT_EXECUTEONLYONCE) == FALSE) {
+				session->handshakeTimer = NULL;
+				session->release();
 
-				TagLib::ID3v2::FrameList l = file.ID3v2Tag()->frameList("APIC");	// APIC: attached picture frame
+				scheduleSync(session);
+			}
 
-				if(l.isEmpty()) {
-					prefixStr += "coverLength_0";
+			// a resuming client finds the journal complete
+			HANDLE timer = InterlockedExchangePointer(&hookTimer, NULL);
 
-					if (rawSend(prefixStr.c_str()) != 0)
-						UIManager::addLogText("Sending cover info failed!\r\n");
+			if (timer != NULL)
+				DeleteTimerQueueTimer(NULL, timer, NULL);
 
-					return 1;
-				}
+			installHook();
 
-				TagLib::ID3v2::AttachedPictureFrame *f3 = static_cast<TagLib::ID3v2::AttachedPictureFrame *>(l.front());	// front: first item
+			connected = true;
 
-				try {
-					coverLength = f3->picture().size(); // size in bytes
-				} catch (...) {
-					prefixStr += "coverLength_0";
+			updateTimers();
 
-					if (rawSend(prefixStr.c_str()) != 0)
-						UIManager::addLogText("Sending cover info failed!\r\n");
+			// wait for commands
+			if (session->postReceive() != 0)
+				closeSession(session, true);
+		}
+	}
 
-					return 1;
-				}
+	// wait for next client
+	if (postAccept() != 0)
+		UIManager::addLogText("Could not accept client\r\n", LOG_ERROR);
+}
 
-				if (coverLength > 0) {	// PICTURE DATA FOUND: copy picture data
-					data = new char[coverLength];
-					memcpy(data, f3->picture().data(), coverLength);
-				} else {
-					prefixStr += "coverLength_0";
+/**
+* \brief	handshakeTimeout
+*
+* timer callback: synchronizes a client with the text protocol if it didn't request the framed protocol
+*
+* \param	parameter	session, holds a reference for the timer
+*/
+VOID CALLBACK handshakeTimeout(PVOID parameter, BOOLEAN timerOrWaitFired) {
+	Session *session = (Session*)parameter;
 
-					if (rawSend(prefixStr.c_str()) != 0)
-						UIManager::addLogText("Sending cover info failed!\r\n");
+	scheduleSync(session);
 
-					return 1;
-				}
-			} else {
-				prefixStr += "coverLength_0";
+	session->release();
+}
 
-				if (rawSend(prefixStr.c_str()) != 0)
-					UIManager::addLogText("Sending cover info failed!\r\n");
+/**
+* \brief	scheduleSync
+*
+* enqueues the synchronization of a session once
+*
+* \param	session	session to synchronize
+*
+* \return	true if scheduled by this call, false if it has already been scheduled before
+*/
+bool const scheduleSync(Session *session) {
+	if (InterlockedCompareExchange(&session->syncScheduled, 1, 0) != 0)
+		return false;
 
-				return 1;
-			}
-		} else {
-			prefixStr += "coverLength_0";
+	tasklist.push("sync", -1, session->id);
 
-			if (rawSend(prefixStr.c_str()) != 0)
-				UIManager::addLogText("Sending cover info failed!\r\n");
+	return true;
+}
 
-			return 1;
-		}
-	} else if (extension.compare("flac") == 0) {
-		TagLib::FLAC::File file(fullPath.c_str());
+/**
+* \brief	closeSession
+*
+* disconnects a client. disables MainWndProc callback hook if it was the last one
+*
+* \param	session				session to close
+* \param	showLogMessage		shows log message "disconnected" if true
+*/
+void closeSession(Session *session, bool showLogMessage) {
+	if (sessionlist.remove(session) == false)	// already closed
+		return;
 
-		if(file.isValid()) {
-			
-			TagLib::List<TagLib::FLAC::Picture *> pictureList = file.pictureList();
+	librarysearch.drop(session->id);
+	playlistbrowser.drop(session->id);
+	audiostreamer.drop(session->id);
+	levelmeter.drop(session->id);
+	datagramchannel.drop(session->id);
 
-			if (!pictureList.isEmpty()) {
-				TagLib::FLAC::Picture *f3 = static_cast<TagLib::FLAC::Picture *>(pictureList.front());
-				
-				try {
-					coverLength = f3->data().size(); // size in bytes
-				} catch (...) {
-					prefixStr += "coverLength_0";
+	// a client without its control connection doesn't need the bulk one, a session without its bulk connection
+	// multiplexes again
+	Session *route = session->unbindBulk();
 
-					if (rawSend(prefixStr.c_str()) != 0)
-						UIManager::addLogText("Sending cover info failed!\r\n");
+	if (route != NULL) {
+		closeSession(route, false);
 
-					return 1;
-				}
+		route->release();
+	}
 
-				if (coverLength > 0) {	// PICTURE DATA FOUND: copy picture data
-					data = new char[coverLength];
-					memcpy(data, f3->data().data(), coverLength);
-				} else {
-					prefixStr += "coverLength_0";
+	Session *owner = session->bulkOwner != 0 ? sessionlist.get(session->bulkOwner) : NULL;
 
-					if (rawSend(prefixStr.c_str()) != 0)
-						UIManager::addLogText("Sending cover info failed!\r\n");
+	if (owner != NULL) {
+		route = owner->unbindBulk(session);
 
-					return 1;
-				}
-			} else {
-				prefixStr += "coverLength_0";
+		if (route != NULL) {
+			InterlockedIncrement(&metrics.bulkFallbacks);
 
-				if (rawSend(prefixStr.c_str()) != 0)
-					UIManager::addLogText("Sending cover info failed!\r\n");
+			route->release();
+		}
 
-				return 1;
-			}
-		} else {
-			prefixStr += "coverLength_0";
+		owner->release();
+	}
 
-			if (rawSend(prefixStr.c_str()) != 0)
-				UIManager::addLogText("Sending cover info failed!\r\n");
+	if (showLogMessage == true) {
+		stringstream peakStream;
+		peakStream << "Disconnected (queue depth peak " << (int)session->peakQueueDepth << ")\r\n";
 
-			return 1;
-		}
+		UIManager::addLogText(peakStream.str());
 	}
-	else
-	{
-		prefixStr += "coverLength_0";
 
-		if (rawSend(prefixStr.c_str()) != 0)
-			UIManager::addLogText("Sending cover info failed!\r\n");
+	if (sessionlist.count() == 0) {
+		// the journal keeps recording for a client that comes back
+		HANDLE timer = NULL;
 
-		return 1;
+		if (connecting == false || CreateTimerQueueTimer(&timer, NULL, hookTimeout, NULL, JOURNAL_WINDOW, 0, WT_EXECUTEONLYONCE) == FALSE)
+			removeHook();
+		else {
+			timer = InterlockedExchangePointer(&hookTimer, timer);
+
+			if (timer != NULL)
+				DeleteTimerQueueTimer(NULL, timer, NULL);
+		}
+
+		connected = false;
 	}
 
-	
-	// LENGTH
-	stringstream coverlengthStream;
-	coverlengthStream << prefixStr;
-	coverlengthStream << "coverLength_";
-	coverlengthStream << coverLength;
+	updateTimers();
 
-	// send
-	if (rawSend(coverlengthStream.str().c_str()) != 0)
-	{
-		UIManager::addLogText("Sending cover info failed!\r\n");
-		
-		if (data != NULL)
-			delete [] data;
+	if (connecting == true)
+		updateStatusText();
+}
 
-		return 1;
-	}
+/**
+* \brief	updateTimers
+*
+* runs the keep alive timer while a session is in the foreground and the check of the track prefetch, the progress
+* ticks and the rounds of the send scheduler while a session is connected, so an idle server has no timer. called when a session is added, closed or changes to the background.
+* never waits for a running callback, it may be the caller
+*/
+void updateTimers() {
+	int sessions = connecting == true ? sessionlist.count() : 0;
+	int foreground = sessions > 0 ? sessionlist.foregroundCount() : 0;
+
+	if (keepalivemessages == 1 && foreground > 0) {
+		DWORD interval = (keepaliveinterval > 0 ? keepaliveinterval : 1) * 1000;
+		HANDLE timer = NULL;
+
+		if (keepAliveTimer == NULL) {
+			if (CreateTimerQueueTimer(&timer, NULL, keepAliveTimeout, NULL, interval, interval, WT_EXECUTEDEFAULT) == FALSE)
+				UIManager::addLogText("Could not start keep alive messages\r\n", LOG_ERROR);
+			else if (InterlockedCompareExchangePointer(&keepAliveTimer, timer, NULL) != NULL)
+				DeleteTimerQueueTimer(NULL, timer, NULL);	// started by another thread in the meantime
+		}
+	} else {
+		HANDLE timer = InterlockedExchangePointer(&keepAliveTimer, NULL);
 
+		if (timer != NULL)
+			DeleteTimerQueueTimer(NULL, timer, NULL);
+	}
 
+	if (sessions > 0) {
+		// the next track is read before the song change
+		if (trackprefetch.start() != 0)
+			UIManager::addLogText("Could not start prefetching the next track\r\n", LOG_ERROR);
 
-	if (coverLength > 0)
-	{
-		// COVER
+		// the position of the clients is checked while winamp plays
+		if (progressticker.start() != 0)
+			UIManager::addLogText("Could not start the progress ticks\r\n", LOG_ERROR);
 
-		bool carry = false;
-		int result, count, maxCount = coverLength / 1024;	// 1024 byte segments
-		if((coverLength % 1024) != 0) {	// count needed steps
-			maxCount++;
-			carry = true;
-		}
+		// the bulk data of the clients shares the uplink
+		if (uplink <= 0)
+			sendscheduler.stop();
+		else if (sendscheduler.start() != 0)
+			UIManager::addLogText("Could not start the send scheduler\r\n", LOG_ERROR);
+	} else {
+		trackprefetch.stop();
+		progressticker.stop();
+		sendscheduler.stop();
+	}
+}
 
+/**
+* \brief	hookTimeout
+*
+* timer callback: removes the hook if no client has come back within JOURNAL_WINDOW milliseconds
+*
+* \param	parameter	not used
+*/
+VOID CALLBACK hookTimeout(PVOID parameter, BOOLEAN timerOrWaitFired) {
+	if (sessionlist.count() == 0)
+		removeHook();
+}
 
+/**
+* \brief	updateStatusText
+*
+* displays the number of connected clients, the highest round trip time and the deepest send queue
+*
+*/
+void updateStatusText() {
+	int count = sessionlist.count();
 
-		for(count = 0; count < maxCount; count++) {
-			if(count == maxCount-1 && carry == true) {
-				// send with offset
-				result = send(c, data+count*1024, (coverLength % 1024), 0);
-			
-				if (result == -1) {
-					UIManager::addLogText("Sending cover info failed!\r\n");
+	////////////////////////////////////////// UI ///////////////////////////////////////////////////////
+	if (count == 0)
+		UIManager::setStatusText("Waiting for client...");
+	else {
+		int rtt = sessionlist.maxRtt();
+		int depth = sessionlist.maxQueueDepth();
 
-					if (data != NULL)
-						delete [] data;
+		stringstream statusStream;
+		statusStream << "Connected (" << count << (count == 1 ? " client" : " clients");
 
-					return 1;
-				}
-			} else {
-				result = send(c, data+count*1024, 1024, 0);
-			
-				if (result == -1) {
-					UIManager::addLogText("Sending cover info failed!\r\n");
+		if (rtt >= 0)
+			statusStream << ", " << rtt << " ms";
 
-					if (data != NULL)
-						delete [] data;
+		if (depth > 0)
+			statusStream << ", " << depth << " queued";
 
-					return 1;
-				}
-			}
-		}
+		statusStream << ")";
 
-		delete []data;
+		UIManager::setStatusText(statusStream.str());
 	}
 
-	return 0;
+	UIManager::setMemoryText(MemoryTag::summary());
+	/////////////////////////////////////////////////////////////////////////////////////////////////////
 }
 
-
-
 /**
-* \brief	synchronize
+* \brief	applySocketProfile
+*
+* sets the socket options of the socketprofile setting on a new client socket
 *
-* synchronizes RemoteControl server and app
+* \param	session	new session
 *
 * \return	1 if error, 0 if success
 */
-int const synchronize() {
-	////////////////////////////////////////// UI ///////////////////////////////////////////////////////
-	UIManager::setStatusText("Synchronizing...");
-	/////////////////////////////////////////////////////////////////////////////////////////////////////
-	
-	int bytes=1;
+int const applySocketProfile(Session *session) {
+	session->profile = socketprofile == SOCKET_PROFILE_THROUGHPUT ? SOCKET_PROFILE_THROUGHPUT : SOCKET_PROFILE_LATENCY;
 
-	int result=0, j=0;
-	TagLib::FileRef f;
+	BOOL noDelay = session->profile == SOCKET_PROFILE_LATENCY ? TRUE : FALSE;
+	int sendBuffer = session->profile == SOCKET_PROFILE_LATENCY ? LATENCY_SEND_BUFFER : THROUGHPUT_SEND_BUFFER;
+	int receiveBuffer = SOCKET_RECEIVE_BUFFER;
 
-	/////////////////////////////////// INITIALIZE CURRENT FILE  ///////////////////////////////////////
+	if (setsockopt(session->socket, IPPROTO_TCP, TCP_NODELAY, (char*)&noDelay, sizeof(noDelay)) == SOCKET_ERROR
+		|| setsockopt(session->socket, SOL_SOCKET, SO_SNDBUF, (char*)&sendBuffer, sizeof(sendBuffer)) == SOCKET_ERROR
+		|| setsockopt(session->socket, SOL_SOCKET, SO_RCVBUF, (char*)&receiveBuffer, sizeof(receiveBuffer)) == SOCKET_ERROR)
+		return 1;
 
-	char *file = (char*)SendMessage(plugin.hwndParent,WM_WA_IPC,SendMessage(plugin.hwndParent,WM_WA_IPC,0,IPC_GETLISTPOS),IPC_GETPLAYLISTFILE);
-	
-	try {
-		if (file != NULL) {	// catch empty playlist
-			TagLib::FileRef tmp(file);
-			f = tmp;
-		}
-	} catch (...) {
-		UIManager::addLogText("Synchronizing failed!\r\n");
+	// DSCP marking of interactive traffic. not possible without the qWAVE service, the options above still apply
+	if (session->profile == SOCKET_PROFILE_LATENCY && qosHandle != NULL) {
+		QOS_FLOWID flowId = 0;
 
-		return 1;
+		if (QOSAddSocketToFlow(qosHandle, session->socket, NULL, QOSTrafficTypeExcellentEffort, QOS_NON_ADAPTIVE_FLOW, &flowId) == TRUE)
+			session->flowId = flowId;
 	}
 
+	return 0;
+}
 
-	/////////////////////////////////// CRITICAL  BEGIN ////////////////////////////////////////
-	EnterCriticalSection(&cs_winamp);
-
-	/////////////////////////////////// PLAYLISTLENGTH  ///////////////////////////////////////
+/**
+* \brief	recordLatency
+*
+* adds a measured round trip time to the statistics of a socket profile
+*
+* \param	profile	socket profile of the session
+* \param	rtt		round trip time in milliseconds
+*/
+void recordLatency(const int & profile, const LONG & rtt) {
+	LatencyStats & stats = latencyStats[profile];
 
-	playlistlength = SendMessage(plugin.hwndParent,WM_WA_IPC,0,IPC_GETLISTLENGTH);
+	InterlockedIncrement(&stats.samples);
+	InterlockedExchangeAdd(&stats.total, rtt);
 
-	stringstream playlistlengthStream;
-	playlistlengthStream << playlistlength;
-	
-	// send
-	if (rawSend(playlistlengthStream.str().c_str()) != 0) {
-		UIManager::addLogText("Synchronizing failed!\r\n");
+	LONG maximum = stats.maximum;
 
-		LeaveCriticalSection(&cs_winamp);
+	while (rtt > maximum && InterlockedCompareExchange(&stats.maximum, rtt, maximum) != maximum)
+		maximum = stats.maximum;
+}
 
-		return 1;
-	}
+/**
+* \brief	installHook
+*
+* enables MainWndProc callback hook. the subclass itself is installed by init, on the thread of the window
+*
+*/
+void installHook() {
+	if (InterlockedExchange(&hookInstalled, 1) != 0)
+		return;
+
+	// the hook keeps the player state up to date from now on
+	winampstate.enable();
+}
+
+/**
+* \brief	removeHook
+*
+* disables MainWndProc callback hook
+*
+*/
+void removeHook() {
+	if (InterlockedExchange(&hookInstalled, 0) == 0)
+		return;
+
+	winampstate.disable();
+
+	// tag changes aren't notified without the hook
+	librarysnapshot.invalidate();
+
+	// nor are the events, the clients will have to be synchronized
+	journal.reset();
+}
+
+
+/**
+* \brief	startWinsock
+*
+* initializes WSA
+*
+* \return	0 if success, else error code
+*/
+int const startWinsock() {
+  WSADATA wsa;
+
+  return WSAStartup(MAKEWORD(2,0),&wsa);
+}
+
+
+
+/**
+* \brief	rawSend
+*
+* appends a raw std::string and \n to the output buffer. sent to sendTarget by flushOutput, never blocks
+*
+* \param	const char *parameter		
+*
+* \return	1 if error, 0 if success
+*/
+int const rawSend(const char *parameter) {
+	outputBuffer.appendLine(parameter);
+
+	return 0;
+}
+
+/**
+* \brief	sendJournalSequence
+*
+* appends journal_<sequence> to the output buffer, the last broadcast the receiving clients have got
+*
+* \param	sequence	journal sequence number
+*/
+void sendJournalSequence(const LONG & sequence) {
+	stringstream journalStream;
+	journalStream << "journal_" << sequence;
+
+	outputBuffer.appendLine(journalStream.str().c_str());
+}
+
+/**
+* \brief	flushOutput
+*
+* hands everything encoded by rawSend and sendCover to the session of the current task
+*
+* \return	1 if error, 0 if success
+*/
+int const flushOutput() {
+	// broadcasts are journaled for resumed sessions, the clients learn the sequence number
+	if (sendTarget == ALL_SESSIONS) {
+		LONG sequence = journal.record(outputBuffer);
+
+		if (sequence != 0)
+			sendJournalSequence(sequence);
+	}
+
+	if (outputBuffer.flush(sendTarget, sendTarget == ALL_SESSIONS ? sendTopic : 0, sendTarget == ALL_SESSIONS ? sendState : NULL) != 0) {
+		UIManager::addLogText("Could not send data\r\n", LOG_ERROR);
+
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+* \brief	coverData
+*
+* returns the embedded picture of a track. metadata from the index only knows the hash and metadata from
+* the media library doesn't know the cover, then the file is read
+*
+* \param metadata	metadata of the track, replaced by the complete metadata if the file has to be read
+* \param number	track number of the file. currently playing track if -1
+*
+* \return	picture, valid as long as metadata. NULL if there is no cover
+*/
+SharedData* const coverData(Metadata *& metadata, const int & number) {
+	if (metadata->coverUnknown || (metadata->hasCover && metadata->cover == NULL)) {
+		Metadata *complete = metadatacache.getTrack(number, true);
+
+		metadata->release();
+		metadata = complete;
+	}
+
+	return metadata->cover;
+}
+
+/**
+* \brief	coverBudget
+*
+* \param session	receiving session
+* \param deadline	milliseconds the cover may take
+*
+* \return	number of bytes the session can receive within the deadline, 0 if its throughput is unknown
+*/
+static unsigned int const coverBudget(Session *session, const int & deadline) {
+	LONG throughput = session->throughput;
+	LONG rtt = session->rtt;
+
+	if (throughput <= 0)
+		return 0;
+
+	// the cover can't arrive before the round trip, at least a quarter of the deadline is left for the data
+	LONG remaining = max((LONG)deadline - max(rtt, 0L), (LONG)deadline / 4);
+
+	return (unsigned int)max((LONGLONG)throughput * remaining / 1000, 1LL);
+}
+
+/**
+* \brief	adaptedVariant
+*
+* returns the largest variant of a picture, up to the requested size, that the session can receive within the
+* deadline. the variants are tried from the requested one down to COVER_THUMBNAIL_SIZE, the thumbnail is used
+* if nothing fits
+*
+* \param session	receiving session
+* \param picture	embedded picture, NULL to take it from the cover store
+* \param hash	hash of the picture
+* \param reduced	true if the variant is smaller than requested
+*
+* \return	variant, the caller has to release() it. NULL if the store doesn't have the picture
+*/
+static SharedData* const adaptedVariant(Session *session, SharedData *picture, const std::string & hash, bool & reduced) {
+	static const int sizes[] = { COVER_MEDIUM_SIZE, COVER_THUMBNAIL_SIZE };
+
+	SharedData *data = coverCache.get(picture, hash, session->coverSize);
+	unsigned int budget = coverBudget(session, COVER_DEADLINE);
+
+	reduced = false;
+
+	for (unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]) && data != NULL && budget > 0 && data->bytes.size() > budget; i++) {
+		// 0 is the original
+		if (session->coverSize > 0 && sizes[i] >= session->coverSize)
+			continue;
+
+		data->release();
+		data = coverCache.get(picture, hash, sizes[i]);
+
+		reduced = true;
+	}
+
+	return data;
+}
+
+/**
+* \brief	sendPicture
+*
+* encodes a cover for one session. clients that requested a cover size get a downscaled variant and its hash,
+* or only the hash if they have the cover cached. a slow client gets a smaller variant first, see adaptedVariant and
+* sendCoverUpgrade. clients that load covers over HTTP only get coverLink_<hash>, see sendHttpCover. the picture is
+* only read if it has to be sent
+*
+* \param session	receiving session
+* \param prefix	prefix for every cover string
+* \param metadata	metadata of the track
+* \param number	track number of the file. currently playing track if -1
+*
+* \return	0 if success, 1 if error or no cover
+*/
+int const sendPicture(Session *session, const char* prefix, Metadata *& metadata, const int & number) {
+	stringstream coverStream;
+	coverStream << prefix;
+
+	SharedData *data = NULL;
+
+	// the hash of a media library track is only known after the file has been read
+	if (session->coverLinks && metadata->coverUnknown)
+		coverData(metadata, number);
+
+	if (metadata->hasCover && session->coverLinks) {
+		int position = number == -1 ? winampstate.getListPosition() : number;
+
+		coverCache.addSource(metadata->coverHash, (char*)SendMessage(plugin.hwndParent,WM_WA_IPC,position,IPC_GETPLAYLISTFILE));
+
+		coverStream << "coverLink_" << metadata->coverHash;
+
+		return rawSend(coverStream.str().c_str());
+	}
+
+	if (metadata->hasCover && session->coverSize >= 0) {
+		std::string hash = metadata->coverHash;
+
+		if (session->hasCover(hash)) {
+			// nothing to transfer
+			coverStream << "coverCached_" << hash;
+
+			InterlockedIncrement(&metrics.coversCached);
+
+			return rawSend(coverStream.str().c_str());
+		}
+
+		// the index only knows the hash, the file isn't read if the cover store has the picture
+		bool stored = metadata->cover == NULL && !metadata->coverUnknown && coverstore.contains(hash, 0);
+		SharedData *picture = stored ? NULL : coverData(metadata, number);
+
+		if (picture != NULL || stored) {
+			coverStream << "coverHash_" << hash;
+			rawSend(coverStream.str().c_str());
+
+			coverStream.str("");
+			coverStream << prefix;
+
+			bool reduced;
+			data = adaptedVariant(session, picture, hash, reduced);
+
+			if (prefix[0] == '\0')
+				session->sentCover = data != NULL && !reduced ? hash : "";
+
+			// the client keeps the smaller variant under the hash, it gets the cover again until it has the requested one
+			if (data == NULL) {
+				// deleted from the store since
+			} else if (!reduced)
+				session->rememberCover(hash);
+			else {
+				InterlockedIncrement(&metrics.coversReduced);
+
+				if (prefix[0] == '\0')
+					tasklist.push("coverUpgrade_" + hash, -1, session->id);
+			}
+		}
+	} else {
+		data = coverData(metadata, number);
+
+		if (data != NULL)
+			data->addRef();
+	}
+
+	// LENGTH
+	coverStream << "coverLength_";
+	coverStream << (data != NULL ? data->bytes.size() : 0);
+
+	// send
+	if (rawSend(coverStream.str().c_str()) != 0)
+	{
+		UIManager::addLogText("Sending cover info failed!\r\n", LOG_ERROR);
+
+		if (data != NULL)
+			data->release();
+
+		return 1;
+	}
+
+	if (data == NULL)
+		return 1;
+
+	// COVER
+
+	// referenced by the output buffer, sent from the TagLib storage
+	outputBuffer.append(data);
+
+	InterlockedIncrement(&metrics.coversSent);
+	Metrics::add(metrics.coverBytes, data->bytes.size());
+
+	data->release();
+
+	return 0;
+}
+
+/**
+* \brief	abortSupersededCover
+*
+* aborts the transfer of the cover of an earlier song to a framed session between two frames, the client would only
+* show it until the new one has arrived. the transfer of the same picture goes on. an aborted cover is forgotten
+*
+* \param session	receiving session
+* \param metadata	metadata of the new song
+*/
+static void abortSupersededCover(Session *session, Metadata *metadata) {
+	if (metadata->hasCover && !metadata->coverUnknown && metadata->coverHash == session->sentCover)
+		return;
+
+	if (session->abortCovers() > 0 && !session->sentCover.empty()) {
+		session->forgetCover(session->sentCover);
+		session->sentCover.clear();
+	}
+}
+
+/**
+* \brief	sendCover
+*
+* sends the cover length (bits) and the cover data. the cover is read at most once, a broadcast encodes it for every synchronized session.
+* to keep socket thread safe only access via TaskList!
+*
+* \param prefix prefix for every coverlength string
+* \param number track number of file to read. currently playing track if -1
+*
+* \return	0 if success, 1 if error
+*/
+int const sendCover(const char* prefix, const int & number) {
+	Metadata *metadata = metadatacache.getTrack(number);
+
+	int result = 1;
+
+	if (sendTarget == ALL_SESSIONS) {
+		// output of the task so far goes to everyone
+		flushOutput();
+
+		// the covers are encoded per session, resumed sessions get the current one
+		LONG sequence = journal.recordCover();
+
+		std::vector<int> ids;
+		sessionlist.getIds(ids);
+
+		for (unsigned int i = 0; i < ids.size(); i++) {
+			Session *session = sessionlist.get(ids[i]);
+
+			if (session == NULL)
+				continue;
+
+			if (session->isSubscribed(sendTopic)) {
+				abortSupersededCover(session, metadata);
+
+				// a congested session gets the cover of the current song when it has caught up
+				if (!session->holdState("cover", "cover")) {
+					result = sendPicture(session, prefix, metadata, number);
+
+					sendJournalSequence(sequence);
+
+					outputBuffer.flush(session->id);
+				}
+			}
+
+			session->release();
+		}
+	} else {
+		Session *session = sessionlist.get(sendTarget);
+
+		if (session != NULL) {
+			if (prefix[0] == '\0')
+				abortSupersededCover(session, metadata);
+
+			result = sendPicture(session, prefix, metadata, number);
+
+			session->release();
+		}
+	}
+
+	metadata->release();
+
+	return result;
+}
+
+/**
+* \brief	previewLine
+*
+* \param metadata	metadata of the current track
+* \param number	track number of the file. currently playing track if -1
+*
+* \return	coverPreview_<hash>_<width>_<height>_<rrggbb>, the size and colour are 0 if the picture can't be decoded.
+* coverPreview_none if the track has no cover
+*/
+static std::string const previewLine(Metadata *& metadata, const int & number) {
+	SharedData *picture = coverData(metadata, number);
+
+	if (picture == NULL)
+		return "coverPreview_none";
+
+	CoverPreview preview = { metadata->coverHash, 0, 0, 0 };
+	coverCache.preview(picture, metadata->coverHash, preview);
+
+	char line[96];
+	sprintf_s(line, sizeof(line), "coverPreview_%s_%d_%d_%06x", metadata->coverHash.c_str(), preview.width, preview.height, preview.color);
+
+	return std::string(line);
+}
+
+/**
+* \brief	sendCoverPreview
+*
+* sends the preview of the new cover at metadata priority, so the client can show the size and colour of the
+* cover one round trip after a track change while the picture follows at bulk priority. only clients that
+* requested a cover size or links get it, the others don't know the element. to keep socket thread safe only
+* access via TaskList!
+*
+* \return	0 if success, 1 if error
+*/
+int const sendCoverPreview() {
+	Metadata *metadata = metadatacache.getTrack(-1);
+
+	// encoded once for every session
+	std::string line;
+	int result = 0;
+
+	if (sendTarget == ALL_SESSIONS) {
+		flushOutput();
+
+		std::vector<int> ids;
+		sessionlist.getIds(ids);
+
+		for (unsigned int i = 0; i < ids.size(); i++) {
+			Session *session = sessionlist.get(ids[i]);
+
+			if (session == NULL)
+				continue;
+
+			// a congested session only gets the cover when it has caught up, a preview would be outdated by then
+			if ((session->coverSize >= 0 || session->coverLinks) && session->isSubscribed(sendTopic) && !session->holdState("cover", "cover")) {
+				if (line.empty())
+					line = previewLine(metadata, -1);
+
+				result |= rawSend(line.c_str());
+
+				outputBuffer.flush(session->id);
+			}
+
+			session->release();
+		}
+	} else {
+		Session *session = sessionlist.get(sendTarget);
+
+		if (session != NULL) {
+			if (session->coverSize >= 0 || session->coverLinks)
+				result = rawSend(previewLine(metadata, -1).c_str());
+
+			session->release();
+		}
+	}
+
+	metadata->release();
+
+	return result;
+}
+
+/**
+* \brief	prefetchCover
+*
+* prepares the cover preview and the cover variants of a prefetched track for the synchronized sessions, the ones
+* adaptedVariant would choose now. nothing is sent. only call from sendCommandThread!
+*
+* \param number	playlist position of the prefetched track
+*/
+void prefetchCover(const int & number) {
+	Metadata *metadata = metadatacache.getTrack(number, true);
+
+	if (metadata->cover != NULL) {
+		CoverPreview preview;
+		coverCache.preview(metadata->cover, metadata->coverHash, preview);
+
+		std::vector<int> ids;
+		sessionlist.getIds(ids);
+
+		for (unsigned int i = 0; i < ids.size(); i++) {
+			Session *session = sessionlist.get(ids[i]);
+
+			if (session == NULL)
+				continue;
+
+			if (session->synchronized && session->coverSize >= 0 && !session->coverLinks) {
+				bool reduced;
+				adaptedVariant(session, metadata->cover, metadata->coverHash, reduced)->release();
+			}
+
+			session->release();
+		}
+	}
+
+	metadata->release();
+}
+
+/**
+* \brief	sendCoverUpgrade
+*
+* sends the requested variant of the current cover after a smaller one, if the session can receive it within
+* COVER_UPGRADE_DEADLINE. dropped if the track has changed or the throughput is too low. only call from sendCommandThread!
+*
+* \param hash	hash of the cover that has been sent reduced
+*
+* \return	0 if the cover has been sent, 1 otherwise
+*/
+int const sendCoverUpgrade(const char *hash) {
+	Session *session = sessionlist.get(sendTarget);
+
+	if (session == NULL)
+		return 1;
+
+	Metadata *metadata = metadatacache.getTrack(-1);
+
+	int result = 1;
+
+	if (metadata->hasCover && metadata->coverHash == hash && !session->hasCover(hash)) {
+		SharedData *picture = coverData(metadata, -1);
+		unsigned int budget = coverBudget(session, COVER_UPGRADE_DEADLINE);
+
+		if (picture != NULL && budget > 0) {
+			SharedData *data = coverCache.get(picture, hash, session->coverSize);
+
+			if (data->bytes.size() <= budget) {
+				stringstream coverStream;
+				coverStream << "coverLength_" << data->bytes.size();
+
+				rawSend((std::string("coverHash_") + hash).c_str());
+
+				if (rawSend(coverStream.str().c_str()) == 0) {
+					outputBuffer.append(data);
+
+					session->rememberCover(hash);
+					session->sentCover = hash;
+
+					InterlockedIncrement(&metrics.coversUpgraded);
+					InterlockedIncrement(&metrics.coversSent);
+					Metrics::add(metrics.coverBytes, data->bytes.size());
+
+					result = 0;
+				}
+			}
+
+			data->release();
+		}
+	}
+
+	metadata->release();
+	session->release();
+
+	return result;
+}
+
+/**
+* \brief	setCoverOptions
+*
+* handles coverSize_<pixels>[_<hash>...] of a client: the size of the cover variants it wants
+* and the covers it still has cached, least recently used first
+*
+* \param session	requesting session
+* \param options	parameters after coverSize_
+*/
+void setCoverOptions(Session *session, const char *options) {
+	session->coverSize = atoi(options);
+	session->coverHashes.clear();
+
+	addKnownCovers(session, strchr(options, '_'));
+}
+
+/**
+* \brief	addKnownCovers
+*
+* handles coverKnown_<hash>[_<hash>...] of a client: further covers it has cached, least recently used first.
+* the hashes of a large cache don't fit into one command
+*
+* \param session	requesting session
+* \param hashes	hashes, each after a _
+*/
+void addKnownCovers(Session *session, const char *hashes) {
+	for (const char *hash = hashes; hash != NULL; hash = strchr(hash + 1, '_')) {
+		const char *end = strchr(hash + 1, '_');
+		std::string value = end != NULL ? std::string(hash + 1, end) : std::string(hash + 1);
+
+		if (!value.empty())
+			session->rememberCover(value);
+	}
+}
+
+/**
+* \brief	sendHttp
+*
+* sends an HTTP response to the session of the current task. HTTP sessions get nothing of the output buffer,
+* so the response is handed to the session directly
+*
+* \param	response	status line and header lines, terminated by an empty line
+* \param	body		shared data with the body, NULL if there is none
+* \param	offset		first byte of the body in the shared data
+* \param	length		number of bytes of the body
+*
+* \return	1 if error, 0 if success
+*/
+int const sendHttp(const std::string & response, SharedData *body, const unsigned int & offset, const unsigned int & length) {
+	Session *session = sessionlist.get(sendTarget);
+
+	if (session == NULL)
+		return 1;
+
+	std::vector<OutputChunk> chunks(1);
+	chunks[0].data = response;
+
+	if (body != NULL && length > 0)
+		chunks[0].setShared(body, offset, length);
+
+	int result = session->send(chunks, false);
+
+	session->release();
+
+	return result;
+}
+
+/**
+* \brief	sendHttpCover
+*
+* answers GET /cover/<hash>?size=<pixels> with the variant of the cover cache, sent from the shared cover storage
+* without copying it. a plain connection gets a variant of the cover store with TransmitFile. a variant of a picture
+* doesn't change, so the hash and the size are a strong ETag and the response is immutable. If-None-Match gets 304,
+* a single byte range 206
+*
+* \param	request	<hash>_<size>_<Range>_<If-None-Match>, see WebChannel::answer
+*
+* \return	1 if error, 0 if success
+*/
+int const sendHttpCover(const char *request) {
+	static const char *notFound = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+
+	const char *sizeField = strchr(request, '_');
+	const char *rangeField = sizeField != NULL ? strchr(sizeField + 1, '_') : NULL;
+	const char *matchField = rangeField != NULL ? strchr(rangeField + 1, '_') : NULL;
+
+	if (matchField == NULL)
+		return sendHttp(notFound, NULL, 0, 0);
+
+	std::string hash(request, sizeField);
+	int size = atoi(sizeField + 1);
+	std::string range(rangeField + 1, matchField);
+	std::string match(matchField + 1);
+
+	stringstream tag;
+	tag << "\"" << hash << "-" << size << "\"";
+
+	stringstream headers;
+	headers << "ETag: " << tag.str() << "\r\nCache-Control: public, max-age=31536000, immutable\r\nAccess-Control-Allow-Origin: *\r\n";
+
+	// If-None-Match may list several tags
+	if (!match.empty() && (match == "*" || match.find(tag.str()) != std::string::npos))
+		return sendHttp("HTTP/1.1 304 Not Modified\r\n" + headers.str() + "\r\n", NULL, 0, 0);
+
+	// TransmitFile needs the socket itself
+	Session *session = sessionlist.get(sendTarget);
+	bool transmit = session != NULL && session->tls == NULL && session->rio == NULL;
+
+	if (session != NULL)
+		session->release();
+
+	std::string type;
+	SharedData *data = transmit ? coverstore.openFile(hash, size, type) : NULL;
+
+	// cached or stored, then scaled from the picture of the linked file
+	if (data == NULL)
+		data = coverCache.find(hash, size);
+
+	std::string file = data == NULL ? coverCache.findSource(hash) : std::string();
+
+	if (!file.empty()) {
+		Metadata *metadata = metadatacache.get(file.c_str(), true);
+
+		// the file may have another picture by now
+		if (metadata->cover != NULL && metadata->coverHash == hash)
+			data = coverCache.get(metadata->cover, hash, size);
+
+		metadata->release();
+	}
+
+	if (data == NULL || (data->bytes.isEmpty() && data->file == INVALID_HANDLE_VALUE)) {
+		if (data != NULL)
+			data->release();
+
+		return sendHttp(notFound, NULL, 0, 0);
+	}
+
+	unsigned int length = data->file != INVALID_HANDLE_VALUE ? data->fileLength : data->bytes.size();
+	unsigned int first = 0;
+	unsigned int last = length - 1;
+	bool partial = false;
+
+	// bytes=<first>-[<last>] or bytes=-<suffix length>, several ranges get the whole cover
+	if (range.compare(0, 6, "bytes=") == 0 && range.find(',') == std::string::npos) {
+		const char *spec = range.c_str() + 6;
+		const char *dash = strchr(spec, '-');
+
+		if (dash == spec) {
+			unsigned int suffix = strtoul(dash + 1, NULL, 10);
+
+			if (suffix > 0) {
+				first = suffix >= length ? 0 : length - suffix;
+				partial = true;
+			}
+		} else if (dash != NULL) {
+			first = strtoul(spec, NULL, 10);
+
+			if (dash[1] != '\0')
+				last = min(last, (unsigned int)strtoul(dash + 1, NULL, 10));
+
+			partial = true;
+		}
+	}
+
+	int result;
+
+	if (partial && (first >= length || first > last)) {
+		headers << "Content-Range: bytes */" << length << "\r\nContent-Length: 0\r\n";
+
+		result = sendHttp("HTTP/1.1 416 Range Not Satisfiable\r\n" + headers.str() + "\r\n", NULL, 0, 0);
+	} else {
+		const unsigned char *bytes = (const unsigned char*)data->bytes.data();
+
+		if (!type.empty()) {
+			// named by the store
+		} else if (length >= 2 && bytes[0] == 0xFF && bytes[1] == 0xD8)
+			type = "image/jpeg";
+		else if (length >= 4 && memcmp(bytes, "\x89PNG", 4) == 0)
+			type = "image/png";
+		else
+			type = "application/octet-stream";
+
+		headers << "Content-Type: " << type << "\r\nAccept-Ranges: bytes\r\nContent-Length: " << (last - first + 1) << "\r\n";
+
+		if (partial)
+			headers << "Content-Range: bytes " << first << "-" << last << "/" << length << "\r\n";
+
+		result = sendHttp((partial ? "HTTP/1.1 206 Partial Content\r\n" : "HTTP/1.1 200 OK\r\n") + headers.str() + "\r\n", data, first, last - first + 1);
+
+		InterlockedIncrement(&metrics.coversSent);
+		Metrics::add(metrics.coverBytes, last - first + 1);
+	}
+
+	data->release();
+
+	return result;
+}
+
+
+
+/**
+* \brief	resumeSession
+*
+* sends the broadcasts a resuming client has missed instead of the synchronization: resumed_<epoch>_<sequence>
+* first, so the client knows it keeps its state, then the journaled lines and the current cover if it has changed.
+* only called by sendCommandThread with sendTarget set to the session
+*
+* \param	session	session that has sent resume_
+*
+* \return	0 if resumed, 1 if the client has to be synchronized
+*/
+int const resumeSession(Session *session) {
+	std::vector<std::string> lines;
+	bool cover;
+
+	if (!session->resume || !journal.replay(session->resumeEpoch, session->resumeSequence, lines, cover))
+		return 1;
+
+	rawSend(("resumed_" + journal.getToken()).c_str());
+
+	for (unsigned int i = 0; i < lines.size(); i++)
+		rawSend(lines[i].c_str());
+
+	if (cover)
+		sendCover("", -1);
+
+	InterlockedIncrement(&metrics.sessionsResumed);
+
+	return 0;
+}
+
+/**
+* \brief	synchronize
+*
+* synchronizes RemoteControl server and app. sends the playlist length but no titles
+*
+* \return	1 if error, 0 if success
+*/
+int const synchronize() {
+	////////////////////////////////////////// UI ///////////////////////////////////////////////////////
+	UIManager::setStatusText("Synchronizing...");
+	/////////////////////////////////////////////////////////////////////////////////////////////////////
+	
+	int bytes=1;
+
+	int result=0, j=0;
 
+	/////////////////////////////////// INITIALIZE CURRENT FILE  ///////////////////////////////////////
 
-	/////////////////////////////////// PLAYLIST  ///////////////////////////////////////
-	
-	for (int i = 0; i < playlistlength; i++) {
-		wchar_t *title_wchar_t;
-		title_wchar_t = (wchar_t*)SendMessageA(plugin.hwndParent,WM_USER, i, IPC_GETPLAYLISTTITLEW);
+	char *file = (char*)SendMessage(plugin.hwndParent,WM_WA_IPC,winampstate.getListPosition(),IPC_GETPLAYLISTFILE);
 
-		std::string title_str = utf8_encode(title_wchar_t);
+	// catch empty playlist. only the audio properties are needed
+	Metadata *metadata = metadatacache.get(file);
 
+	int samplerate = metadata->samplerate >= 0 ? metadata->samplerate : SendMessage(plugin.hwndParent,WM_WA_IPC,5,IPC_GETINFO);
+	int bitrate = metadata->bitrate >= 0 ? metadata->bitrate : SendMessage(plugin.hwndParent,WM_WA_IPC,1,IPC_GETINFO);
+	int length = metadata->length >= 0 ? metadata->length : SendMessage(plugin.hwndParent,WM_WA_IPC,1,IPC_GETOUTPUTTIME);
 
-		if (title_wchar_t != NULL)
-		{
-			if (rawSend(title_str.c_str()) != 0) {
-				UIManager::addLogText("Synchronizing failed!\r\n");
+	metadata->release();
 
-				LeaveCriticalSection(&cs_winamp);
 
-				return 1;
-			}
-		} else {
-			if (rawSend("") != 0) {
-				UIManager::addLogText("Synchronizing failed!\r\n");
+	// one snapshot, all values belong to the same moment and no lock is held while sending
+	PlayerState *state = winampstate.acquire();
 
-				LeaveCriticalSection(&cs_winamp);
+	/////////////////////////////////// PLAYLISTLENGTH  ///////////////////////////////////////
 
-				return 1;
-			}
-		}
+	// length of the snapshot the playlist changes are based on
+	int playlistlength = playlistsnapshot.length();
+
+	stringstream playlistlengthStream;
+	playlistlengthStream << playlistlength;
+	
+	// send
+	if (rawSend(playlistlengthStream.str().c_str()) != 0) {
+		UIManager::addLogText("Synchronizing failed!\r\n", LOG_ERROR);
+
+		state->release();
+
+		return 1;
 	}
 
 
-	
+	// titles are requested by the client with playlist_range_<start>_<count>, see sendPlaylistRange
+
+
 	/////////////////////////////////// REPEAT  ///////////////////////////////////////
 	// 1 if on
 	
-	repeat_status = SendMessageA(plugin.hwndParent, WM_USER, 0, 251);
-
 	stringstream repeatStream;
-	repeatStream << repeat_status;
+	repeatStream << state->repeat;
 
 	// send
 	if (rawSend(repeatStream.str().c_str()) != 0) {
-		UIManager::addLogText("Synchronizing failed!\r\n");
+		UIManager::addLogText("Synchronizing failed!\r\n", LOG_ERROR);
 
-		LeaveCriticalSection(&cs_winamp);
+		state->release();
 
 		return 1;
 	}
@@ -554,30 +1616,26 @@ int const synchronize() {
 	/////////////////////////////////// SHUFFLE ///////////////////////////////////////
 	// 1 if on
 
-	shuffle_status = SendMessageA(plugin.hwndParent, WM_USER, 0, 250); 
-
 	stringstream shuffleStream;
-	shuffleStream << shuffle_status;
+	shuffleStream << state->shuffle;
 
 	if (rawSend(shuffleStream.str().c_str()) != 0) {
-		UIManager::addLogText("Synchronizing failed!\r\n");
+		UIManager::addLogText("Synchronizing failed!\r\n", LOG_ERROR);
 
-		LeaveCriticalSection(&cs_winamp);
+		state->release();
 
 		return 1;
 	}
 	
 	/////////////////////////////////// VOLUME ///////////////////////////////////////
 
-	volume = SendMessageA(plugin.hwndParent, WM_WA_IPC, -666, IPC_SETVOLUME);
-	
 	stringstream volumeStream;
-	volumeStream << volume;
+	volumeStream << state->volume;
 
 	if (rawSend(volumeStream.str().c_str()) != 0) {
-		UIManager::addLogText("Synchronizing failed!\r\n");
+		UIManager::addLogText("Synchronizing failed!\r\n", LOG_ERROR);
 
-		LeaveCriticalSection(&cs_winamp);
+		state->release();
 
 		return 1;
 	}
@@ -590,9 +1648,9 @@ int const synchronize() {
 	queueCountStream << queueCount;
 
 	if (rawSend(queueCountStream.str().c_str()) != 0) {
-		UIManager::addLogText("Synchronizing failed!\r\n");
+		UIManager::addLogText("Synchronizing failed!\r\n", LOG_ERROR);
 
-		LeaveCriticalSection(&cs_winamp);
+		state->release();
 
 		return 1;
 	}
@@ -602,464 +1660,1090 @@ int const synchronize() {
 	int k, tmp;
 	stringstream queueElementStream;
 
-	for (k=0; k < queueCount; k++) {
-	
-		tmp = WASABI_API_QUEUEMGR->GetQueuedItemFromIndex(k);
+	for (k=0; k < queueCount; k++) {
+	
+		tmp = WASABI_API_QUEUEMGR->GetQueuedItemFromIndex(k);
+
+		queueElementStream << tmp;
+
+		if (rawSend(queueElementStream.str().c_str()) != 0) {
+			UIManager::addLogText("Synchronizing failed!\r\n", LOG_ERROR);
+
+			state->release();
+
+			return 1;
+		}
+	
+		// clear stringstream
+		queueElementStream.str("");
+	}
+
+	/////////////////////////////// SAMPLERATE ////////////////////////////////////
+
+	if (file != NULL) {
+
+		stringstream samplerateStream;
+		samplerateStream << samplerate;
+
+		if (rawSend(samplerateStream.str().c_str()) != 0) {
+			UIManager::addLogText("Synchronizing failed!\r\n", LOG_ERROR);
+
+			state->release();
+
+			return 1;
+		}
+
+	}
+	else
+	{
+		if (rawSend("0") != 0) {
+			UIManager::addLogText("Synchronizing failed!\r\n", LOG_ERROR);
+
+			state->release();
+
+			return 1;
+		}
+	}
+
+	/////////////////////////////// BITRATE ////////////////////////////////////
+
+	if (file != NULL) {
+
+		stringstream bitrateStream;
+		bitrateStream << bitrate;
+
+		if (rawSend(bitrateStream.str().c_str()) != 0) {
+			UIManager::addLogText("Synchronizing failed!\r\n", LOG_ERROR);
+
+			state->release();
+
+			return 1;
+		}
+
+	}
+	else
+	{
+		if (rawSend("0") != 0) {
+			UIManager::addLogText("Synchronizing failed!\r\n", LOG_ERROR);
+
+			state->release();
+
+			return 1;
+		}
+	}
+
+
+	/////////////////////////////////// LENGTH ///////////////////////////////////////
+
+	if (file != NULL) {
+
+		stringstream lengthStream;
+		lengthStream << length;
+
+		if (rawSend(lengthStream.str().c_str()) != 0) {
+			UIManager::addLogText("Synchronizing failed!\r\n", LOG_ERROR);
+
+			state->release();
+
+			return 1;
+		}
+	}
+	else
+	{
+		if (rawSend("0") != 0) {
+			UIManager::addLogText("Synchronizing failed!\r\n", LOG_ERROR);
+
+			state->release();
+
+			return 1;
+		}
+	}
+
+
+	/////////////////////////////////// PLAYLIST POSITION ///////////////////////////////////////
+
+	int playlistPosition = state->listPosition;
+
+	stringstream playlistPositionStream;
+
+	playlistPositionStream << playlistPosition;
+
+	if (rawSend(playlistPositionStream.str().c_str()) != 0) {
+		UIManager::addLogText("Synchronizing failed!\r\n", LOG_ERROR);
+
+		state->release();
+
+		return 1;
+	}
+
+
+	/////////////////////////////////// TITLE ///////////////////////////////////////
+
+	// encoded by the playlist snapshot, which the sync has just updated
+	std::string title_str;
+
+	if (!playlistsnapshot.appendTitle(playlistPosition, title_str)) {
+		wchar_t *title_wchar_t;
+		title_wchar_t = (wchar_t*)SendMessageA(plugin.hwndParent,WM_USER, playlistPosition, IPC_GETPLAYLISTTITLEW);
+
+		if (title_wchar_t != NULL)
+			utf8_append(title_str, title_wchar_t, wcslen(title_wchar_t));
+	}
+
+	// empty if there is no title
+	if (rawSend(title_str.c_str()) != 0) {
+		UIManager::addLogText("Synchronizing failed!\r\n", LOG_ERROR);
+
+		state->release();
+
+		return 1;
+	}
+
+	/////////////////////////////////// PLAYBACK POSITION ///////////////////////////////////////
+	
+	int position = state->getPosition();
+
+	stringstream positionStream;
+	positionStream << position;
+
+	if (rawSend(positionStream.str().c_str()) != 0) {
+		UIManager::addLogText("Synchronizing failed!\r\n", LOG_ERROR);
+
+		state->release();
+
+		return 1;
+	}
+	
+
+	/////////////////////////////////// PLAYBACK STATUS ///////////////////////////////////////
+	
+	stringstream isPlayingStream;
+	isPlayingStream << state->isPlaying;
+
+	if (rawSend(isPlayingStream.str().c_str()) != 0) {
+		UIManager::addLogText("Synchronizing failed!\r\n", LOG_ERROR);
+
+		state->release();
+
+		return 1;
+	}
+
+	
+	/////////////////////////////////// COVER ///////////////////////////////////////
+	
+	if (file != NULL) {
+		result = sendCover("", -1);
+
+		if (result == -1) {
+			UIManager::addLogText("Synchronizing failed!\r\n", LOG_ERROR);
+			
+			state->release();
+
+			return 1;
+		}
+
+	} else {
+		if (rawSend("coverLength_0") != 0) {
+			UIManager::addLogText("Synchronizing failed!\r\n", LOG_ERROR);
+
+			state->release();
+
+			return 1;
+		}
+	}
+
+
+	state->release();
+
+	return 0;
+}
+
+
+
+/**
+* \brief	sendPlaylistRange
+*
+* sends a window of playlist titles: "playlist_range_<start>_<count>" followed by count titles.
+* the window is clipped to the playlist as the clients know it and to MAX_PLAYLIST_RANGE titles. the titles are
+* referenced in the encoded image of the playlist snapshot, see PlaylistSnapshot::shareTitles. the work pool encodes the next windows while this one is sent.
+* placeholders are replaced later, see PlaylistSnapshot::upgradeTitles
+*
+* \param start	position of the first title
+* \param count	number of requested titles
+*/
+void sendPlaylistRange(const int & start, const int & count) {
+	int length = playlistsnapshot.length();
+
+	int first = start < 0 ? 0 : start;
+	int number = count > MAX_PLAYLIST_RANGE ? MAX_PLAYLIST_RANGE : count;
+
+	if (first > length)
+		first = length;
+
+	if (number < 0)
+		number = 0;
+	else if (first + number > length)
+		number = length - first;
+
+	stringstream rangeStream;
+	rangeStream << "playlist_range_" << first << "_" << number;
+
+	rawSend(rangeStream.str().c_str());
+
+	playlistsnapshot.shareTitles(first, number, outputBuffer);
+
+	// the titles the client shows are resolved first
+	playlistsnapshot.prioritize(first);
+}
+
+// files of a playlist window read by readPlaylistFiles
+struct PlaylistFiles {
+	int first;
+	int number;
+	std::vector<std::string> files;
+};
+
+/**
+* \brief	readPlaylistFiles
+*
+* copies the file names of a playlist window. run on the winamp thread by WinampState::invoke
+*
+* \param	parameter	PlaylistFiles, files that don't exist are empty
+*/
+static void readPlaylistFiles(void *parameter) {
+	PlaylistFiles *range = (PlaylistFiles*)parameter;
+
+	range->files.resize(range->number);
+
+	for (int i = 0; i < range->number; i++) {
+		const char *file = (char*)SendMessage(plugin.hwndParent,WM_WA_IPC,range->first + i,IPC_GETPLAYLISTFILE);
+
+		if (file != NULL)
+			range->files[i] = file;
+	}
+}
+
+// work items of a covers_ request handled by the thread pool, see runCoverJobs
+struct CoverJobs {
+	volatile LONG remaining;
+	HANDLE done;
+};
+
+// one row or one thumbnail of a covers_ request
+struct CoverJob {
+	CoverJobs *jobs;
+	std::string file;
+	Metadata *metadata;
+	SharedData *picture;
+	std::string hash;
+	int size;
+	int format;
+	SharedData *variant;
+};
+
+/**
+* \brief	readCoverJob
+*
+* reads the metadata of a row with its cover. run on a worker of the thread pool
+*
+* \param	parameter	CoverJob
+*
+* \return	0
+*/
+static DWORD WINAPI readCoverJob(LPVOID parameter) {
+	CoverJob *job = (CoverJob*)parameter;
+
+	job->metadata = metadatacache.get(job->file.c_str(), true);
+
+	if (InterlockedDecrement(&job->jobs->remaining) == 0)
+		SetEvent(job->jobs->done);
+
+	return 0;
+}
+
+/**
+* \brief	scaleCoverJob
+*
+* scales the cover of a thumbnail that isn't in the cover cache, or resamples it to the pixels of a raw thumbnail.
+* run on a worker of the thread pool
+*
+* \param	parameter	CoverJob
+*
+* \return	0
+*/
+static DWORD WINAPI scaleCoverJob(LPVOID parameter) {
+	CoverJob *job = (CoverJob*)parameter;
+
+	// the decoded picture within the memory budget
+	{
+		GovernorToken token(GOVERNOR_COVERS, NULL, (LONGLONG)job->picture->bytes.size() * GOVERNOR_DECODE_FACTOR);
+
+		job->variant = job->format == THUMBNAIL_JPEG ? CoverCache::scale(job->picture, job->size) : CoverCache::pixels(job->picture, job->size, job->format);
+	}
+
+	if (InterlockedDecrement(&job->jobs->remaining) == 0)
+		SetEvent(job->jobs->done);
+
+	return 0;
+}
+
+/**
+* \brief	runCoverJobs
+*
+* runs a function for every job on the work pool and waits for all of them. a job that can't be queued runs
+* on the calling thread
+*
+* \param	jobs		jobs
+* \param	function	readCoverJob or scaleCoverJob
+*/
+static void runCoverJobs(std::vector<CoverJob*> & jobs, LPTHREAD_START_ROUTINE function) {
+	if (jobs.empty())
+		return;
+
+	CoverJobs state;
+	state.remaining = (LONG)jobs.size();
+	state.done = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+	for (unsigned int i = 0; i < jobs.size(); i++) {
+		jobs[i]->jobs = &state;
+
+		if (!workpool.submit(function, jobs[i]))
+			function(jobs[i]);	// no worker available
+	}
+
+	WaitForSingleObject(state.done, INFINITE);
+	CloseHandle(state.done);
+}
+
+/**
+* \brief	sendCoverRows
+*
+* sends the cover thumbnails of a playlist window: "covers_<start>_<count>" followed by count lines with the hash
+* of the cover of each row, empty for rows without one. then "thumb_<hash>_<length>" and the thumbnail for every
+* hash of the window the client doesn't have yet, each hash once. the rows are read and the missing thumbnails
+* scaled on the thread pool, the cached ones come from the metadata and cover caches. a client that asks for raw
+* pixels gets a zlib stream of size x size pixels instead of a jpeg, see CoverCache::pixels. it has to ask for the
+* same format on every request, the hashes it has are remembered regardless of the format
+*
+* \param start	position of the first row
+* \param count	number of requested rows, at most MAX_COVER_ROWS
+* \param size	maximum width and height of the thumbnails, the size of raw ones
+* \param format	THUMBNAIL_ format of the thumbnails, unknown formats are sent as jpeg
+*/
+void sendCoverRows(const int & start, const int & count, const int & size, const int & format) {
+	Session *session = sessionlist.get(sendTarget);
+
+	if (session == NULL)
+		return;
+
+	int length = SendMessage(plugin.hwndParent,WM_WA_IPC,0,IPC_GETLISTLENGTH);
+	int thumbnailSize = size < 16 ? 16 : (size > MAX_THUMBNAIL_SIZE ? MAX_THUMBNAIL_SIZE : size);
+	int thumbnailFormat = format == THUMBNAIL_RGB565 || format == THUMBNAIL_ARGB8888 ? format : THUMBNAIL_JPEG;
 
-		queueElementStream << tmp;
+	PlaylistFiles range;
+	range.first = start < 0 ? 0 : (start > length ? length : start);
+	range.number = count < 0 ? 0 : min(min(count, MAX_COVER_ROWS), length - range.first);
 
-		if (rawSend(queueElementStream.str().c_str()) != 0) {
-			UIManager::addLogText("Synchronizing failed!\r\n");
+	winampstate.invoke(readPlaylistFiles, &range);
 
-			LeaveCriticalSection(&cs_winamp);
+	std::vector<CoverJob> rows(range.number);
+	std::vector<CoverJob*> reads;
 
-			return 1;
-		}
-	
-		// clear stringstream
-		queueElementStream.str("");
-	}
+	for (int i = 0; i < range.number; i++) {
+		rows[i].file = range.files[i];
+		rows[i].metadata = NULL;
+		rows[i].picture = NULL;
+		rows[i].size = thumbnailSize;
+		rows[i].format = thumbnailFormat;
+		rows[i].variant = NULL;
 
-	/////////////////////////////// SAMPLERATE ////////////////////////////////////
-	int samplerate;
+		if (!rows[i].file.empty())
+			reads.push_back(&rows[i]);
+	}
 
-	if (file != NULL) {
+	runCoverJobs(reads, readCoverJob);
 
-		try {
-			samplerate = f.audioProperties()->sampleRate();
-		} catch (...) {
-			samplerate = SendMessage(plugin.hwndParent,WM_WA_IPC,5,IPC_GETINFO);
-		}
+	stringstream header;
+	header << "covers_" << range.first << "_" << range.number;
 
-		stringstream samplerateStream;
-		samplerateStream << samplerate;
+	rawSend(header.str().c_str());
 
-		if (rawSend(samplerateStream.str().c_str()) != 0) {
-			UIManager::addLogText("Synchronizing failed!\r\n");
+	// the first row of every hash the client doesn't have
+	std::vector<CoverJob*> thumbnails;
+	std::set<std::string> seen;
 
-			LeaveCriticalSection(&cs_winamp);
+	for (int i = 0; i < range.number; i++) {
+		Metadata *metadata = rows[i].metadata;
 
-			return 1;
+		if (metadata != NULL && metadata->cover != NULL) {
+			rows[i].picture = metadata->cover;
+			rows[i].hash = metadata->coverHash;
 		}
 
+		rawSend(rows[i].hash.c_str());
+
+		// the client touches the hashes of the rows in the same order
+		if (!rows[i].hash.empty() && !session->hasThumbnail(rows[i].hash) && seen.insert(rows[i].hash).second)
+			thumbnails.push_back(&rows[i]);
 	}
-	else
-	{
-		if (rawSend("0") != 0) {
-			UIManager::addLogText("Synchronizing failed!\r\n");
 
-			LeaveCriticalSection(&cs_winamp);
+	flushOutput();
 
-			return 1;
-		}
+	std::vector<CoverJob*> scales;
+
+	for (unsigned int i = 0; i < thumbnails.size(); i++) {
+		thumbnails[i]->variant = coverCache.find(thumbnails[i]->hash, thumbnailSize, thumbnailFormat);
+
+		if (thumbnails[i]->variant == NULL)
+			scales.push_back(thumbnails[i]);
 	}
 
-	/////////////////////////////// BITRATE ////////////////////////////////////
-	int bitrate;
+	runCoverJobs(scales, scaleCoverJob);
 
-	if (file != NULL) {
+	for (unsigned int i = 0; i < thumbnails.size(); i++) {
+		CoverJob *thumbnail = thumbnails[i];
+		SharedData *data = thumbnail->variant;
+
+		if (data != NULL && std::find(scales.begin(), scales.end(), thumbnail) != scales.end())
+			coverCache.put(thumbnail->hash, thumbnailSize, data, thumbnailFormat);
 
-		try {
-			bitrate = f.audioProperties()->bitrate();
-		} catch (...) {
-			bitrate = SendMessage(plugin.hwndParent,WM_WA_IPC,1,IPC_GETINFO);
+		// small enough already, or not decodable. raw thumbnails can't fall back to the picture
+		if (data == NULL && thumbnailFormat == THUMBNAIL_JPEG && thumbnail->picture->bytes.size() <= MAX_THUMBNAIL_BYTES) {
+			data = thumbnail->picture;
+			data->addRef();
 		}
 
-		stringstream bitrateStream;
-		bitrateStream << bitrate;
+		if (data == NULL)
+			continue;
 
-		if (rawSend(bitrateStream.str().c_str()) != 0) {
-			UIManager::addLogText("Synchronizing failed!\r\n");
+		stringstream thumbStream;
+		thumbStream << "thumb_" << thumbnail->hash << "_" << data->bytes.size();
 
-			LeaveCriticalSection(&cs_winamp);
+		if (rawSend(thumbStream.str().c_str()) == 0) {
+			outputBuffer.append(data);
 
-			return 1;
-		}
+			session->rememberThumbnail(thumbnail->hash);
 
-	}
-	else
-	{
-		if (rawSend("0") != 0) {
-			UIManager::addLogText("Synchronizing failed!\r\n");
+			InterlockedIncrement(&metrics.coversSent);
+			Metrics::add(metrics.coverBytes, data->bytes.size());
+		}
 
-			LeaveCriticalSection(&cs_winamp);
+		data->release();
 
-			return 1;
-		}
+		// one thumbnail after the other, the rows of the next request don't wait for the whole window
+		if (flushOutput() != 0)
+			break;
 	}
 
+	for (int i = 0; i < range.number; i++) {
+		if (rows[i].metadata != NULL)
+			rows[i].metadata->release();
+	}
 
-	/////////////////////////////////// LENGTH ///////////////////////////////////////
-	int length;
-
-	if (file != NULL) {
+	session->release();
+}
 
-		try {
-			length = f.audioProperties()->length();
-		} catch (...) {
-			length = SendMessage(plugin.hwndParent,WM_WA_IPC,1,IPC_GETOUTPUTTIME);
-		}
 
-		stringstream lengthStream;
-		lengthStream << length;
 
-		if (rawSend(lengthStream.str().c_str()) != 0) {
-			UIManager::addLogText("Synchronizing failed!\r\n");
+struct RowJob;
 
-			LeaveCriticalSection(&cs_winamp);
+// misses of a rows_ request read by the thread pool, each one is sent as soon as it is read
+struct RowJobs {
+	CRITICAL_SECTION cs_rows;
+	std::vector<RowJob*> completed;
+	HANDLE ready;
+};
 
-			return 1;
-		}
-	}
-	else
-	{
-		if (rawSend("0") != 0) {
-			UIManager::addLogText("Synchronizing failed!\r\n");
+// one row of a rows_ request that isn't cached
+struct RowJob {
+	RowJobs *jobs;
+	int index;
+	std::string file;
+	Metadata *metadata;
+};
 
-			LeaveCriticalSection(&cs_winamp);
+/**
+* \brief	readRowJob
+*
+* reads the metadata of a row and hands it to the send command thread. run on a worker of the thread pool
+*
+* \param	parameter	RowJob
+*
+* \return	0
+*/
+static DWORD WINAPI readRowJob(LPVOID parameter) {
+	RowJob *job = (RowJob*)parameter;
 
-			return 1;
-		}
-	}
+	job->metadata = metadatacache.get(job->file.c_str());
 
+	// CRITICAL
+	EnterCriticalSection(&job->jobs->cs_rows);
 
-	/////////////////////////////////// PLAYLIST POSITION ///////////////////////////////////////
+	job->jobs->completed.push_back(job);
 
-	int playlistPosition = SendMessage(plugin.hwndParent,WM_WA_IPC,0,IPC_GETLISTPOS);
+	LeaveCriticalSection(&job->jobs->cs_rows);
+	// CRITICAL END
 
-	stringstream playlistPositionStream;
+	SetEvent(job->jobs->ready);
 
-	playlistPositionStream << playlistPosition;
+	return 0;
+}
 
-	if (rawSend(playlistPositionStream.str().c_str()) != 0) {
-		UIManager::addLogText("Synchronizing failed!\r\n");
+/**
+* \brief	appendRow
+*
+* adds the lines of one row of a rows_ request: row_<position>, then the fields of the mask in the order of
+* trackInfo_. a file that couldn't be read has empty fields and unknown audio properties
+*
+* \param position	playlist position of the row
+* \param metadata	metadata of the row
+* \param fields	TRACK_FIELD_BASIC and TRACK_FIELD_AUDIO flags
+* \param lines	receives the lines
+*/
+static void appendRow(const int & position, Metadata *metadata, const int & fields, std::vector<std::string> & lines) {
+	stringstream rowStream;
+	rowStream << "row_" << position;
+
+	lines.push_back(rowStream.str());
+
+	bool valid = metadata->valid;
+
+	if (fields & TRACK_FIELD_BASIC) {
+		stringstream year, track;
+		year << (valid ? metadata->year : 0);
+		track << (valid ? metadata->track : 0);
+
+		lines.push_back(valid ? metadata->title : std::string());
+		lines.push_back(valid ? stringpool.value(metadata->artist) : "");
+		lines.push_back(valid ? stringpool.value(metadata->album) : "");
+		lines.push_back(year.str());
+		lines.push_back(track.str());
+		lines.push_back(valid ? stringpool.value(metadata->genre) : "");
+		lines.push_back(valid ? metadata->comment : std::string());
+	}
 
-		LeaveCriticalSection(&cs_winamp);
+	if (fields & TRACK_FIELD_AUDIO) {
+		stringstream samplerate, bitrate, length;
+		samplerate << (valid ? metadata->samplerate : -1);
+		bitrate << (valid ? metadata->bitrate : -1);
+		length << (valid ? metadata->length : -1);
 
-		return 1;
+		lines.push_back(samplerate.str());
+		lines.push_back(bitrate.str());
+		lines.push_back(length.str());
 	}
+}
+
+/**
+* \brief	sendRows
+*
+* sends the tag fields of a playlist window: "rows_<start>_<count>_<fields>" and then a row_ line with its fields
+* for every row, see appendRow. the rows in the metadata cache or its index come first, the others are read on the
+* thread pool and sent in the order they are done, so the client fills in a window while it is scrolled. only the
+* basic fields and the audio properties can be asked for, the other TRACK_FIELD_ flags are ignored
+*
+* \param start	position of the first row
+* \param count	number of requested rows, at most MAX_METADATA_ROWS
+* \param fields	TRACK_FIELD_ flags
+*/
+void sendRows(const int & start, const int & count, const int & fields) {
+	int length = SendMessage(plugin.hwndParent,WM_WA_IPC,0,IPC_GETLISTLENGTH);
+	int mask = fields & (TRACK_FIELD_BASIC | TRACK_FIELD_AUDIO);
 
+	PlaylistFiles range;
+	range.first = start < 0 ? 0 : (start > length ? length : start);
+	range.number = count < 0 ? 0 : min(min(count, MAX_METADATA_ROWS), length - range.first);
 
-	/////////////////////////////////// TITLE ///////////////////////////////////////
+	winampstate.invoke(readPlaylistFiles, &range);
 
-	wchar_t *title_wchar_t;
-	title_wchar_t = (wchar_t*)SendMessageA(plugin.hwndParent,WM_USER, playlistPosition, IPC_GETPLAYLISTTITLEW);
+	stringstream header;
+	header << "rows_" << range.first << "_" << range.number << "_" << mask;
 
-	if (title_wchar_t != NULL) {
+	rawSend(header.str().c_str());
 
-		std::string title_str = utf8_encode(title_wchar_t);
+	std::vector<RowJob> misses;
+	std::vector<std::string> lines;
 
-		if (rawSend(title_str.c_str()) != 0) {
-			UIManager::addLogText("Synchronizing failed!\r\n");
+	for (int i = 0; i < range.number; i++) {
+		Metadata *metadata = metadatacache.find(range.files[i].c_str());
 
-			LeaveCriticalSection(&cs_winamp);
+		if (metadata == NULL) {
+			RowJob job = { NULL, range.first + i, range.files[i], NULL };
+			misses.push_back(job);
 
-			return 1;
+			continue;
 		}
-	} else {
-		if (rawSend("") != 0) {
-			UIManager::addLogText("Synchronizing failed!\r\n");
 
-			LeaveCriticalSection(&cs_winamp);
+		appendRow(range.first + i, metadata, mask, lines);
 
-			return 1;
-		}
+		metadata->release();
 	}
 
-	/////////////////////////////////// PLAYBACK POSITION ///////////////////////////////////////
-	
-	int position = SendMessageA(plugin.hwndParent, WM_WA_IPC, 0, IPC_GETOUTPUTTIME);
+	for (unsigned int i = 0; i < lines.size(); i++)
+		rawSend(lines[i].c_str());
 
-	stringstream positionStream;
-	positionStream << position;
+	bool connected = flushOutput() == 0;
 
-	if (rawSend(positionStream.str().c_str()) != 0) {
-		UIManager::addLogText("Synchronizing failed!\r\n");
+	if (misses.empty())
+		return;
 
-		LeaveCriticalSection(&cs_winamp);
+	RowJobs jobs;
+	InitializeCriticalSection(&jobs.cs_rows);
+	jobs.ready = CreateEvent(NULL, FALSE, FALSE, NULL);
 
-		return 1;
+	// the jobs that haven't started are dropped once the client has gone
+	WorkCancel cancel(jobs.ready);
+
+	for (unsigned int i = 0; i < misses.size(); i++) {
+		misses[i].jobs = &jobs;
+
+		if (!workpool.submit(readRowJob, &misses[i], WORK_PRIORITY_NORMAL, &cancel))
+			readRowJob(&misses[i]);	// no worker available
 	}
-	
 
-	/////////////////////////////////// PLAYBACK STATUS ///////////////////////////////////////
-	
-	isPlaying = SendMessageA(plugin.hwndParent, WM_WA_IPC, 0, IPC_ISPLAYING);
+	// every job has to be done or dropped before they go out of scope
+	unsigned int sent = 0;
 
-	stringstream isPlayingStream;
-	isPlayingStream << isPlaying;
+	while (sent + cancel.getDropped() < misses.size()) {
+		WaitForSingleObject(jobs.ready, INFINITE);
 
-	if (rawSend(isPlayingStream.str().c_str()) != 0) {
-		UIManager::addLogText("Synchronizing failed!\r\n");
+		std::vector<RowJob*> completed;
 
-		LeaveCriticalSection(&cs_winamp);
+		// CRITICAL
+		EnterCriticalSection(&jobs.cs_rows);
 
-		return 1;
-	}
+		completed.swap(jobs.completed);
 
-	
-	/////////////////////////////////// COVER ///////////////////////////////////////
-	
-	if (file != NULL) {
-		result = sendCover("", -1);
+		LeaveCriticalSection(&jobs.cs_rows);
+		// CRITICAL END
 
-		if (result == -1) {
-			UIManager::addLogText("Synchronizing failed!\r\n");
-			
-			LeaveCriticalSection(&cs_winamp);
+		lines.clear();
 
-			return 1;
+		for (unsigned int i = 0; i < completed.size(); i++) {
+			appendRow(completed[i]->index, completed[i]->metadata, mask, lines);
+
+			completed[i]->metadata->release();
 		}
 
-	} else {
-		if (rawSend("coverLength_0") != 0) {
-			UIManager::addLogText("Synchronizing failed!\r\n");
+		sent += completed.size();
 
-			LeaveCriticalSection(&cs_winamp);
+		for (unsigned int i = 0; i < lines.size() && connected; i++)
+			rawSend(lines[i].c_str());
 
-			return 1;
-		}
+		if (connected)
+			connected = flushOutput() == 0;
+
+		if (!connected)
+			cancel.cancel();
 	}
 
+	CloseHandle(jobs.ready);
+	DeleteCriticalSection(&jobs.cs_rows);
+}
+
+/**
+* \brief	sendStats
+*
+* sends the counters of the server: "stats_<count>" followed by count lines, see Metrics::report
+*/
+void sendStats() {
+	std::vector<std::string> lines;
+	metrics.report(lines);
 
-	////////////////////////////////////// CRITICAL END ///////////////////////////////////////////
-	LeaveCriticalSection(&cs_winamp);
+	stringstream countStream;
+	countStream << "stats_" << lines.size();
 
-	return 0;
+	rawSend(countStream.str().c_str());
+
+	for (unsigned int i = 0; i < lines.size(); i++)
+		rawSend(lines[i].c_str());
+}
+
+/**
+* \brief	sendSlowLog
+*
+* sends the slow operations, newest first: "slowlog_<count>" followed by count lines, see SlowEntry::describe
+*/
+void sendSlowLog() {
+	std::vector<std::string> lines;
+	slowlog.report(lines);
+
+	stringstream countStream;
+	countStream << "slowlog_" << lines.size();
+
+	rawSend(countStream.str().c_str());
+
+	for (unsigned int i = 0; i < lines.size(); i++)
+		rawSend(lines[i].c_str());
 }
 
 
 
 /**
-* \brief	sendTrackInfo
+* \brief	stars
 *
-* reads the tag info from a file and sends the results to the client
+* \param	popularimeter	rating of a POPM frame, 0 to 255
 *
-* \param number track number
+* \return	0 (no rating) to 5 stars, the inverse of the values TagWriter::setRating writes
 */
-void sendTrackInfo(const int & number) {
-	int bytes=1;
+static int const stars(const int & popularimeter) {
+	static const int lowest[] = { 1, 64, 128, 196, 255 };
 
-	int result=0, j=0;
-	TagLib::FileRef f;
+	int rating = 0;
 
-	/////////////////////////////////// INITIALIZE CURRENT FILE  ///////////////////////////////////////
+	while (rating < 5 && popularimeter >= lowest[rating])
+		rating++;
+
+	return rating;
+}
+
+/**
+* \brief	readExtendedFields
+*
+* reads the lyrics, the rating and the ReplayGain values of a file, the fields TagWriter writes. only the tags are
+* parsed, without the pictures and the audio properties. ID3v2 and APE tags of MP3 files and Xiph comments are read,
+* other formats have no common fields
+*
+* \param	file	path of the file
+* \param	fields	TRACK_FIELD_ flags of the request
+* \param	lines	receives the lines to send
+*/
+static void readExtendedFields(const char *file, const int & fields, std::vector<std::string> & lines) {
+	static const char *replayGain[] = { "replaygain_track_gain", "replaygain_track_peak", "replaygain_album_gain", "replaygain_album_peak" };
+
+	MemoryTag memoryTag(MEMORY_TAGLIB, GOVERNOR_TAG_BYTES);
+
+	TagLib::String lyrics;
+	TagLib::String gains[4];
+	int rating = 0;
 
-	char *file = (char*)SendMessage(plugin.hwndParent,WM_WA_IPC,number,IPC_GETPLAYLISTFILE);
-	
 	try {
-		if (file != NULL) {	// catch empty playlist
-			TagLib::FileRef tmp(file);
-			f = tmp;
-		}
-	} catch (...) {
-		UIManager::addLogText("Could not read TAG data!\r\n");
+		TagLib::FileRef f(file, TagLib::File::ReadExtendedFields);
 
-		return;
-	}
+		if (!f.isNull() && f.file()->isValid()) {
+			TagLib::MPEG::File *mpeg = dynamic_cast<TagLib::MPEG::File *>(f.file());
+			TagLib::FLAC::File *flac = dynamic_cast<TagLib::FLAC::File *>(f.file());
+			TagLib::Ogg::XiphComment *xiph = flac != NULL ? flac->xiphComment() : dynamic_cast<TagLib::Ogg::XiphComment *>(f.tag());
 
-	// check
-	if (file == NULL)
-		return;
+			if (mpeg != NULL && mpeg->ID3v2Tag() != NULL) {
+				TagLib::ID3v2::Tag *id3v2 = mpeg->ID3v2Tag();
+				TagLib::ID3v2::FrameList l = id3v2->frameList("USLT");	// USLT: unsynchronised lyrics frame
 
-	/////////////////////////////////// CRITICAL  BEGIN ////////////////////////////////////////
-	EnterCriticalSection(&cs_winamp);
+				if (!l.isEmpty())
+					lyrics = static_cast<TagLib::ID3v2::UnsynchronizedLyricsFrame *>(l.front())->text();
 
-	/////////////////////////////////// TITLE ////////////////////////////////////////////
+				l = id3v2->frameList("POPM");	// POPM: popularimeter frame
 
-	TagLib::String title = f.tag()->title();
+				if (!l.isEmpty())
+					rating = stars(static_cast<TagLib::ID3v2::PopularimeterFrame *>(l.front())->rating());
 
-	string titleString("track_title_");
-	titleString.append(title.toCString());
+				// foobar2000 writes the descriptions in lower case, mp3gain and TagWriter in upper case
+				l = id3v2->frameList("TXXX");
 
-	if (rawSend(titleString.c_str()) != 0) {
-		UIManager::addLogText("Could not read TAG info!\r\n");
+				for (TagLib::ID3v2::FrameList::ConstIterator it = l.begin(); it != l.end(); it++) {
+					TagLib::ID3v2::UserTextIdentificationFrame *frame = static_cast<TagLib::ID3v2::UserTextIdentificationFrame *>(*it);
+					TagLib::String description = frame->description().upper();
 
-		LeaveCriticalSection(&cs_winamp);
+					for (int i = 0; i < 4; i++) {
+						if (description == TagLib::String(replayGain[i]).upper() && frame->fieldList().size() > 1)
+							gains[i] = frame->fieldList()[1];
+					}
+				}
+			}
 
-		return;
-	}
+			if (mpeg != NULL && mpeg->APETag() != NULL) {
+				const TagLib::APE::ItemListMap & items = mpeg->APETag()->itemListMap();
 
-	/////////////////////////////////// INTERPRET ////////////////////////////////////////////
+				for (int i = 0; i < 4; i++) {
+					TagLib::String name = TagLib::String(replayGain[i]).upper();
 
-	TagLib::String artist = f.tag()->artist();
+					if (gains[i].isEmpty() && items.contains(name))
+						gains[i] = items[name].toString();
+				}
+			}
 
-	string artistString("track_artist_");
-	artistString.append(artist.toCString());
+			if (xiph != NULL) {
+				const TagLib::Ogg::FieldListMap & map = xiph->fieldListMap();
 
-	if (rawSend(artistString.c_str()) != 0) {
-		UIManager::addLogText("Could not read TAG info!\r\n");
+				if (map.contains("LYRICS") && !map["LYRICS"].isEmpty())
+					lyrics = map["LYRICS"].front();
 
-		LeaveCriticalSection(&cs_winamp);
+				if (map.contains("RATING") && !map["RATING"].isEmpty())
+					rating = min(max((map["RATING"].front().toInt() + 10) / 20, 0), 5);
 
-		return;
+				for (int i = 0; i < 4; i++) {
+					TagLib::String name = TagLib::String(replayGain[i]).upper();
+
+					if (map.contains(name) && !map[name].isEmpty())
+						gains[i] = map[name].front();
+				}
+			}
+		}
+	} catch (...) {
+		UIManager::addLogText("Could not read TAG data!\r\n", LOG_ERROR);
 	}
 
-	/////////////////////////////////// ALBUM ////////////////////////////////////////////
+	// the lyrics as count and lines like the stats
+	if (fields & TRACK_FIELD_LYRICS) {
+		std::vector<std::string> text;
+		std::string utf8 = lyrics.to8Bit(true);
 
-	TagLib::String album = f.tag()->album();
+		std::string::size_type start = 0;
 
-	string albumString("track_album_");
-	albumString.append(album.toCString());
+		while (!utf8.empty() && start <= utf8.size()) {
+			std::string::size_type end = utf8.find('\n', start);
 
-	if (rawSend(albumString.c_str()) != 0) {
-		UIManager::addLogText("Could not read TAG info!\r\n");
+			if (end == std::string::npos)
+				end = utf8.size();
 
-		LeaveCriticalSection(&cs_winamp);
+			std::string line = utf8.substr(start, end - start);
 
-		return;
-	}
+			if (!line.empty() && line[line.size() - 1] == '\r')
+				line.erase(line.size() - 1);
 
-	/////////////////////////////////// YEAR ////////////////////////////////////////////
+			text.push_back(line);
+			start = end + 1;
+		}
 
-	unsigned int year = f.tag()->year();
+		stringstream countStream;
+		countStream << "track_lyrics_" << text.size();
 
-	stringstream yearStream;
-	yearStream << "track_year_";
-	yearStream << year;
+		lines.push_back(countStream.str());
+		lines.insert(lines.end(), text.begin(), text.end());
+	}
 
-	if (rawSend(yearStream.str().c_str()) != 0) {
-		UIManager::addLogText("Could not read TAG info!\r\n");
+	if (fields & TRACK_FIELD_RATING) {
+		stringstream ratingStream;
+		ratingStream << "track_rating_" << rating;
 
-		LeaveCriticalSection(&cs_winamp);
+		lines.push_back(ratingStream.str());
+	}
 
-		return;
+	if (fields & TRACK_FIELD_REPLAYGAIN) {
+		for (int i = 0; i < 4; i++)
+			lines.push_back("track_" + std::string(replayGain[i]) + "_" + gains[i].to8Bit(true));
 	}
+}
+
+/**
+* \brief	sendTrackCover
+*
+* sends a downscaled cover of a track for trackInfo_ as track_coverHash_<hash> and track_coverLength_<length>
+* followed by the picture, or only track_coverLength_0 if the track has none
+*
+* \param metadata	metadata of the track
+* \param number	track number
+* \param size	maximum width and height
+*
+* \return	0 if success, 1 if error or no cover
+*/
+static int const sendTrackCover(Metadata *& metadata, const int & number, const int & size) {
+	SharedData *picture = coverData(metadata, number);
 
-	/////////////////////////////////// TRACK ////////////////////////////////////////////
+	if (picture == NULL) {
+		rawSend("track_coverLength_0");
 
-	unsigned int track = f.tag()->track();
+		return 1;
+	}
 
-	stringstream trackStream;
-	trackStream << "track_track_";
-	trackStream << track;
+	SharedData *data = coverCache.get(picture, metadata->coverHash, size);
 
-	if (rawSend(trackStream.str().c_str()) != 0) {
-		UIManager::addLogText("Could not read TAG info!\r\n");
+	stringstream coverStream;
+	coverStream << "track_coverHash_" << metadata->coverHash;
+	rawSend(coverStream.str().c_str());
 
-		LeaveCriticalSection(&cs_winamp);
+	coverStream.str("");
+	coverStream << "track_coverLength_" << data->bytes.size();
 
-		return;
+	if (rawSend(coverStream.str().c_str()) != 0) {
+		data->release();
+
+		return 1;
 	}
 
-	/////////////////////////////////// GENRE ////////////////////////////////////////////
+	// referenced by the output buffer
+	outputBuffer.append(data);
 
-	TagLib::String genre = f.tag()->genre();
+	InterlockedIncrement(&metrics.coversSent);
+	Metrics::add(metrics.coverBytes, data->bytes.size());
 
-	string genreString("track_genre_");
-	genreString.append(genre.toCString());
+	data->release();
+
+	return 0;
+}
 
-	if (rawSend(genreString.c_str()) != 0) {
-		UIManager::addLogText("Could not read TAG info!\r\n");
+/**
+* \brief	sendTrackInfo
+*
+* sends the requested fields of a track to the client. the basic fields and the audio properties come from the
+* metadata cache, the extended fields are read from the tags alone. a requested cover is queued as trackCover_ task
+* behind them, see sendTrackInfoCover
+*
+* \param number track number
+* \param fields TRACK_FIELD_ flags, TRACK_FIELDS_ALL for trackInfo_ without a mask
+*/
+void sendTrackInfo(const int & number, const int & fields) {
+	/////////////////////////////////// INITIALIZE CURRENT FILE  ///////////////////////////////////////
 
-		LeaveCriticalSection(&cs_winamp);
+	char *file = (char*)SendMessage(plugin.hwndParent,WM_WA_IPC,number,IPC_GETPLAYLISTFILE);
 
+	// check
+	if (file == NULL)
 		return;
-	}
 
+	std::string path(file);
+	std::vector<std::string> lines;
+	Metadata *metadata = NULL;
 
-	/////////////////////////////// SAMPLERATE ////////////////////////////////////
-	int samplerate;
+	if (fields & (TRACK_FIELD_BASIC | TRACK_FIELD_AUDIO)) {
+		// parsed only if the file is not cached yet
+		metadata = metadatacache.get(file);
 
-	stringstream samplerateStream;
-	samplerateStream << "track_samplerate_";
-	
+		if (!metadata->valid) {
+			UIManager::addLogText("Could not read TAG data!\r\n", LOG_ERROR);
 
-	try {
-		samplerate = f.audioProperties()->sampleRate();
-	} catch (...) {
-		samplerate = SendMessage(plugin.hwndParent,WM_WA_IPC,5,IPC_GETINFO);
+			metadata->release();
+
+			return;
+		}
 	}
 
-	samplerateStream << samplerate;
+	/////////////////////////////////// TITLE, INTERPRET, ALBUM, YEAR, TRACK, GENRE ////////////////////////////////////
 
-	if (rawSend(samplerateStream.str().c_str()) != 0) {
-		UIManager::addLogText("Synchronizing failed!\r\n");
+	if (fields & TRACK_FIELD_BASIC) {
+		stringstream yearStream;
+		yearStream << "track_year_" << metadata->year;
 
-		LeaveCriticalSection(&cs_winamp);
+		stringstream trackStream;
+		trackStream << "track_track_" << metadata->track;
 
-		return;
+		lines.push_back("track_title_" + metadata->title);
+		lines.push_back("track_artist_" + std::string(stringpool.value(metadata->artist)));
+		lines.push_back("track_album_" + std::string(stringpool.value(metadata->album)));
+		lines.push_back(yearStream.str());
+		lines.push_back(trackStream.str());
+		lines.push_back("track_genre_" + std::string(stringpool.value(metadata->genre)));
 	}
 
+	/////////////////////////////////// SAMPLERATE, BITRATE, LENGTH ////////////////////////////////////
 
-	/////////////////////////////// BITRATE ////////////////////////////////////
-	int bitrate;
+	if (fields & TRACK_FIELD_AUDIO) {
+		int samplerate = metadata->samplerate >= 0 ? metadata->samplerate : SendMessage(plugin.hwndParent,WM_WA_IPC,5,IPC_GETINFO);
+		int bitrate = metadata->bitrate >= 0 ? metadata->bitrate : SendMessage(plugin.hwndParent,WM_WA_IPC,1,IPC_GETINFO);
+		int length = metadata->length >= 0 ? metadata->length : SendMessage(plugin.hwndParent,WM_WA_IPC,1,IPC_GETOUTPUTTIME);
 
-	stringstream bitrateStream;
-	bitrateStream << "track_bitrate_";
+		stringstream samplerateStream;
+		samplerateStream << "track_samplerate_" << samplerate;
 
-	try {
-		bitrate = f.audioProperties()->bitrate();
-	} catch (...) {
-		bitrate = SendMessage(plugin.hwndParent,WM_WA_IPC,1,IPC_GETINFO);
+		stringstream bitrateStream;
+		bitrateStream << "track_bitrate_" << bitrate;
+
+		stringstream lengthStream;
+		lengthStream << "track_length_" << length;
+
+		lines.push_back(samplerateStream.str());
+		lines.push_back(bitrateStream.str());
+		lines.push_back(lengthStream.str());
 	}
 
-	bitrateStream << bitrate;
+	/////////////////////////////////// COMMENT ////////////////////////////////////////////
+
+	if (fields & TRACK_FIELD_BASIC)
+		lines.push_back("track_comment_" + metadata->comment);
 
-	if (rawSend(bitrateStream.str().c_str()) != 0) {
-		UIManager::addLogText("Synchronizing failed!\r\n");
+	/////////////////////////////////// LYRICS, RATING, REPLAYGAIN ////////////////////////////////////////////
 
-		LeaveCriticalSection(&cs_winamp);
+	if (fields & (TRACK_FIELD_LYRICS | TRACK_FIELD_RATING | TRACK_FIELD_REPLAYGAIN))
+		readExtendedFields(path.c_str(), fields, lines);
 
-		return;
+	for (unsigned int i = 0; i < lines.size(); i++) {
+		if (rawSend(lines[i].c_str()) != 0) {
+			UIManager::addLogText("Could not read TAG info!\r\n", LOG_ERROR);
+
+			if (metadata != NULL)
+				metadata->release();
+
+			return;
+		}
 	}
 
+	if (metadata != NULL)
+		metadata->release();
 
+	/////////////////////////////////// COVER ///////////////////////////////////////
 
-	/////////////////////////////////// LENGTH ///////////////////////////////////////
-	int length;
+	// a request of the client for another track drops it while it waits
+	int cover = fields & (TRACK_FIELD_COVER | TRACK_FIELD_COVER_MEDIUM | TRACK_FIELD_THUMBNAIL);
 
-	
-	try {
-		length = f.audioProperties()->length();
-	} catch (...) {
-		length = SendMessage(plugin.hwndParent,WM_WA_IPC,1,IPC_GETOUTPUTTIME);
+	if (cover != 0) {
+		stringstream coverStream;
+		coverStream << "trackCover_" << number << "_" << cover;
+
+		tasklist.push(coverStream.str(), -1, sendTarget);
 	}
+}
 
-	stringstream lengthStream;
-	lengthStream << "track_length_";
-	lengthStream << length;
+/**
+* \brief	sendTrackInfoCover
+*
+* sends the cover of a trackInfo_ request, queued by sendTrackInfo behind the other fields
+*
+* \param number track number
+* \param fields TRACK_FIELD_COVER, TRACK_FIELD_COVER_MEDIUM and TRACK_FIELD_THUMBNAIL flags, the largest one is sent
+*/
+void sendTrackInfoCover(const int & number, const int & fields) {
+	// the largest requested size class
+	if (fields & TRACK_FIELD_COVER) {
+		if (sendCover("track_", number) == -1)
+			UIManager::addLogText("Synchronizing failed!\r\n", LOG_ERROR);
 
-	if (rawSend(lengthStream.str().c_str()) != 0) {
-		UIManager::addLogText("Synchronizing failed!\r\n");
+		return;
+	}
 
-		LeaveCriticalSection(&cs_winamp);
+	char *file = (char*)SendMessage(plugin.hwndParent,WM_WA_IPC,number,IPC_GETPLAYLISTFILE);
 
+	if (file == NULL)
 		return;
-	}
-	
 
-	
-	/////////////////////////////////// COMMENT ////////////////////////////////////////////
+	Metadata *metadata = metadatacache.get(file);
 
-	TagLib::String comment = f.tag()->comment();
+	if (metadata->valid)
+		sendTrackCover(metadata, number, (fields & TRACK_FIELD_COVER_MEDIUM) ? COVER_MEDIUM_SIZE : COVER_THUMBNAIL_SIZE);
+	else
+		rawSend("track_coverLength_0");
 
-	string commentString("track_comment_");
-	commentString.append(comment.toCString());
+	metadata->release();
+}
 
-	if (rawSend(commentString.c_str()) != 0) {
-		UIManager::addLogText("Could not read TAG info!\r\n");
+/**
+* \brief	editTag
+*
+* performs a tagEdit_ command: updates the cached metadata of a playlist entry at once and queues the edit
+* for the tag writer, which writes the file in the background. the client gets the new track information
+*
+* \param	argument	<index>_<field>_<value>, the value is UTF8 and may contain _
+*/
+void editTag(const char *argument) {
+	char *end;
+	int number = strtol(argument, &end, 10);
 
-		LeaveCriticalSection(&cs_winamp);
+	const char *field = end + 1;
+	const char *value = (*end == '_') ? strchr(field, '_') : NULL;
 
+	if (end == argument || value == NULL)
 		return;
-	}
 
-	/////////////////////////////////// COVER ///////////////////////////////////////
-	
-	
-	result = sendCover("track_", number);
+	std::string name(field, value - field);
 
-	if (result == -1) {
-		UIManager::addLogText("Synchronizing failed!\r\n");
-			
-		LeaveCriticalSection(&cs_winamp);
+	char *file = (char*)SendMessage(plugin.hwndParent,WM_WA_IPC,number,IPC_GETPLAYLISTFILE);
+
+	if (tagwriter.add(file, name, value + 1) != 0) {
+		UIManager::addLogText("Could not edit TAG data!\r\n", LOG_ERROR);
 
 		return;
 	}
 
-	
+	metadatacache.edit(file, name, value + 1);
 
-	////////////////////////////////////// CRITICAL END ///////////////////////////////////////////
-	LeaveCriticalSection(&cs_winamp);
-}
\ No newline at end of file
+	sendTrackInfo(number);
+}
@@ -1,15 +1,102 @@
 #pragma once
 
+// maximum number of titles sent for one playlist_range_ request
+#define MAX_PLAYLIST_RANGE 500
+
+// maximum number of rows of one rows_ request
+#define MAX_METADATA_ROWS 200
+
+// socket profiles: small messages are sent at once with a small send buffer and marked as interactive traffic,
+// or coalesced by Nagle with a large send buffer for fast synchronizations
+#define SOCKET_PROFILE_LATENCY 1
+#define SOCKET_PROFILE_THROUGHPUT 2
+
+// socket buffer sizes of the profiles. a small send buffer keeps little bulk data ahead of control messages
+#define LATENCY_SEND_BUFFER 16384
+#define THROUGHPUT_SEND_BUFFER 262144
+#define SOCKET_RECEIVE_BUFFER 8192
+
+// fields of a trackInfo_<index>_<mask> request
+#define TRACK_FIELD_BASIC 0x01			// title, artist, album, year, track, genre and comment
+#define TRACK_FIELD_AUDIO 0x02			// samplerate, bitrate and length
+#define TRACK_FIELD_COVER 0x04			// the cover as the client gets it on a song change
+#define TRACK_FIELD_COVER_MEDIUM 0x08	// the cover downscaled to COVER_MEDIUM_SIZE
+#define TRACK_FIELD_THUMBNAIL 0x10		// the cover downscaled to COVER_THUMBNAIL_SIZE
+#define TRACK_FIELD_LYRICS 0x20			// unsynchronised lyrics
+#define TRACK_FIELD_RATING 0x40			// 0 to 5 stars
+#define TRACK_FIELD_REPLAYGAIN 0x80		// track and album gain and peak
+
+// fields of trackInfo_<index> without a mask
+#define TRACK_FIELDS_ALL (TRACK_FIELD_BASIC | TRACK_FIELD_AUDIO | TRACK_FIELD_COVER)
+
+// round trip times of the keep alive messages measured with one socket profile
+struct LatencyStats {
+	volatile LONG samples;
+	volatile LONG total;
+	volatile LONG maximum;
+};
+
+extern LatencyStats latencyStats[SOCKET_PROFILE_THROUGHPUT + 1];
+
+// qWAVE handle of the latency profile, NULL if not available
+extern HANDLE qosHandle;
+
 extern int const startWinsock();
 extern int const startSocket();
 extern void startServer();
 
 extern void shutdownSocket();
+extern void showLocalIP();
+extern VOID WINAPI interfaceChanged(PVOID context, PMIB_IPINTERFACE_ROW row, MIB_NOTIFICATION_TYPE type);
+extern VOID WINAPI addressChanged(PVOID context, PMIB_UNICASTIPADDRESS_ROW row, MIB_NOTIFICATION_TYPE type);
 extern void stopServer(bool showLogMessage);
 
+extern int const postAccept();
+extern void acceptCompleted(const bool & success);
+extern VOID CALLBACK handshakeTimeout(PVOID parameter, BOOLEAN timerOrWaitFired);
+extern bool const scheduleSync(Session *session);
+extern void closeSession(Session *session, bool showLogMessage);
+extern void updateTimers();
+extern VOID CALLBACK hookTimeout(PVOID parameter, BOOLEAN timerOrWaitFired);
+extern void updateStatusText();
+
+extern int const applySocketProfile(Session *session);
+extern void recordLatency(const int & profile, const LONG & rtt);
+
+// 1 if the MainWndProc callback hook is enabled
+extern volatile LONG hookInstalled;
+
+extern void installHook();
+extern void removeHook();
+
+extern volatile int sendTarget;
+extern volatile int sendTopic;
+extern const Task *sendState;
+
 extern int const rawSend(const char *parameter);
+extern void sendJournalSequence(const LONG & sequence);
+extern int const flushOutput();
 
+extern int const resumeSession(Session *session);
 extern int const synchronize();
+extern SharedData* const coverData(Metadata *& metadata, const int & number);
+extern int const sendPicture(Session *session, const char* prefix, Metadata *& metadata, const int & number);
 extern int const sendCover(const char* prefix, const int & number);
+extern int const sendCoverPreview();
+extern void setCoverOptions(Session *session, const char *options);
+extern void addKnownCovers(Session *session, const char *hashes);
+extern int const sendCoverUpgrade(const char *hash);
+extern void prefetchCover(const int & number);
+extern void sendCoverRows(const int & start, const int & count, const int & size, const int & format);
+extern void sendRows(const int & start, const int & count, const int & fields);
+extern int const sendHttp(const std::string & response, SharedData *body, const unsigned int & offset, const unsigned int & length);
+extern int const sendHttpCover(const char *request);
+
+extern void sendPlaylistRange(const int & start, const int & count);
+
+extern void sendStats();
+extern void sendSlowLog();
 
-extern void sendTrackInfo(const int & number);
\ No newline at end of file
+extern void sendTrackInfo(const int & number, const int & fields = TRACK_FIELDS_ALL);
+extern void sendTrackInfoCover(const int & number, const int & fields);
+extern void editTag(const char *argument);
\ No newline at end of file
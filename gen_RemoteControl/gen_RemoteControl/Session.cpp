@@ -0,0 +1,1315 @@
+#include "stdafx.h"
+
+char Session::receiveBuffer[RECEIVE_BUFFER_SIZE + 1];
+
+
+/**
+* \brief	gather
+*
+* adds the unsent part of a queued element to the buffers of a send
+*
+* \param	chunk	queued element
+* \param	offset	number of bytes of the element that have already been sent
+* \param	buffers	buffers of the send
+* \param	count	number of used buffers, increased
+*/
+static void gather(const OutputChunk & chunk, const unsigned int & offset, WSABUF *buffers, DWORD & count) {
+	if (offset < chunk.data.length()) {
+		buffers[count].buf = (char*)chunk.data.data() + offset;
+		buffers[count].len = chunk.data.length() - offset;
+		count++;
+	}
+
+	if (chunk.sharedLength > 0) {
+		unsigned int skip = offset > chunk.data.length() ? offset - chunk.data.length() : 0;
+
+		buffers[count].buf = (char*)chunk.sharedData() + skip;
+		buffers[count].len = chunk.sharedLength - skip;
+		count++;
+	}
+}
+
+/**
+* \brief	Session
+*
+* constructor, initializes the overlapped contexts of a newly accepted client connection
+*
+* \param	socket	connected client socket
+* \param	id		unique session id
+*/
+Session::Session(const SOCKET & socket, const int & id) {
+	this->socket = socket;
+	this->id = id;
+
+	references = 1;	// reference of the session list
+	sentBytes = 0;
+	bulkSentBytes = 0;
+	sealedSentBytes = 0;
+	sending = false;
+	sendStarted = 0;
+
+	protocol = PROTOCOL_TEXT;
+	handshakeTimer = NULL;
+	syncScheduled = 0;
+
+	synchronized = false;
+	topics = TOPIC_ALL;
+	resume = false;
+	resumeSequence = 0;
+	closed = 0;
+	background = 0;
+	alive_delay = 0;
+	aliveSent = 0;
+	rtt = -1;
+	throughput = -1;
+
+	queueDepth = 0;
+	peakQueueDepth = 0;
+	queuedBytes = 0;
+	congested = 0;
+	lastSent = GetTickCount();
+
+	weight = 0;
+	bulkTokens = 0;
+	scheduled = 0;
+
+	profile = SOCKET_PROFILE_LATENCY;
+	flowId = 0;
+
+	coverSize = -1;
+	coverLinks = false;
+
+	bulkRoute = NULL;
+	bulkOwner = 0;
+
+	commandOverflow = false;
+	delimited = false;
+	received = false;
+	plainReceived = false;
+
+	tls = NULL;
+	web = NULL;
+	rio = NULL;
+
+	ZeroMemory(&receiveContext, sizeof(IOContext));
+	receiveContext.operation = OPERATION_RECEIVE;
+	receiveContext.session = this;
+
+	ZeroMemory(&sendContext, sizeof(IOContext));
+	sendContext.operation = OPERATION_SEND;
+	sendContext.session = this;
+
+	InitializeCriticalSection(&cs_session);
+}
+
+/**
+* \brief	~Session
+*
+* destructor. only called by release() when the last reference is gone
+*/
+Session::~Session() {
+	// the timer callback holds a reference, so it has already run
+	if (handshakeTimer != NULL)
+		DeleteTimerQueueTimer(NULL, handshakeTimer, NULL);
+
+	delete tls;
+	delete web;
+	delete rio;
+
+	if (bulkRoute != NULL)
+		bulkRoute->release();
+
+	MemoryTag::add(MEMORY_OUTPUT, -queuedBytes);
+
+	DeleteCriticalSection(&cs_session);
+}
+
+/**
+* \brief	addRef
+*
+* adds a reference. every pending overlapped operation and every thread using the session holds one
+*/
+void Session::addRef() {
+	InterlockedIncrement(&references);
+}
+
+/**
+* \brief	release
+*
+* removes a reference and deletes the session if it was the last one
+*/
+void Session::release() {
+	if (InterlockedDecrement(&references) == 0)
+		delete this;
+}
+
+/**
+* \brief	postReceive
+*
+* starts an overlapped receive of zero bytes. it completes on the network thread through the completion port when
+* the client has sent something, see receiveReady. an idle session has no buffer locked for its receive.
+* a session with Registered I/O receives into its slot instead, see receiveRegistered
+*
+* \return	1 if error, 0 if success
+*/
+int const Session::postReceive() {
+	if (closed != 0)
+		return 1;
+
+	if (rio != NULL) {
+		addRef();
+
+		// CRITICAL
+		EnterCriticalSection(&cs_session);
+
+		int result = rio->receive();
+
+		LeaveCriticalSection(&cs_session);
+		// CRITICAL END
+
+		if (result != 0)
+			release();
+
+		return result;
+	}
+
+	WSABUF buffer;
+	buffer.buf = NULL;
+	buffer.len = 0;
+
+	DWORD flags = 0;
+
+	ZeroMemory(&receiveContext.overlapped, sizeof(OVERLAPPED));
+
+	addRef();
+
+	if (WSARecv(socket, &buffer, 1, NULL, &flags, &receiveContext.overlapped, NULL) == SOCKET_ERROR && WSAGetLastError() != WSA_IO_PENDING) {
+		release();
+
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+* \brief	receiveReady
+*
+* called by the network thread when the zero byte receive has finished: reads what the socket has received
+* without blocking, at most MAX_RECEIVE_READS times
+*
+* \return	1 if the stream has been closed or failed, 0 if success
+*/
+int const Session::receiveReady() {
+	for (int i = 0; i < MAX_RECEIVE_READS && closed == 0; i++) {
+		int bytes = recv(socket, receiveBuffer, RECEIVE_BUFFER_SIZE, 0);
+
+		// stream closed
+		if (bytes == 0)
+			return 1;
+
+		if (bytes == SOCKET_ERROR)
+			return WSAGetLastError() == WSAEWOULDBLOCK ? 0 : 1;
+
+		receiveCompleted(bytes);
+	}
+
+	return 0;
+}
+
+/**
+* \brief	receiveRegistered
+*
+* called by the network thread when the Registered I/O receive of the session has finished
+*
+* \param	bytes	number of bytes in the receive buffer of the slot, not 0
+*/
+void Session::receiveRegistered(const DWORD & bytes) {
+	memcpy(receiveBuffer, rio->received(), bytes);
+
+	receiveCompleted(bytes);
+}
+
+/**
+* \brief	receiveCompleted
+*
+* called by receiveReady for every read of the socket. a client that starts with a TLS handshake
+* record gets a TLS session if the server has a certificate, its records are decrypted before the commands are
+* received
+*
+* \param	bytes	number of received bytes
+*/
+void Session::receiveCompleted(const DWORD & bytes) {
+	receiveBuffer[bytes] = '\0'; // securely terminate char*
+
+	if (!received) {
+		received = true;
+
+		if ((unsigned char)receiveBuffer[0] == TLS_HANDSHAKE_RECORD && tlstransport == 1 && TlsChannel::isAvailable()) {
+			// CRITICAL
+			EnterCriticalSection(&cs_session);
+
+			tls = new TlsChannel();
+
+			LeaveCriticalSection(&cs_session);
+			// CRITICAL END
+		}
+	}
+
+	if (tls == NULL) {
+		receivePlain(receiveBuffer, bytes);
+
+		return;
+	}
+
+	std::string plain;
+	std::string token;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_session);
+
+	// records are decrypted and encrypted with the same context
+	bool establishing = !tls->isEstablished();
+	int result = tls->receive(receiveBuffer, bytes, plain, token);
+
+	if (!token.empty()) {
+		sealedQueue.push_back(OutputChunk());
+		sealedQueue.back().data.swap(token);
+	}
+
+	// the handshake messages, after the handshake also what has been queued meanwhile
+	if (!sending)
+		postSend();
+
+	LeaveCriticalSection(&cs_session);
+	// CRITICAL END
+
+	if (result != 0) {
+		InterlockedIncrement(&metrics.tlsFailures);
+
+		close();
+
+		return;
+	}
+
+	if (establishing && tls->isEstablished()) {
+		InterlockedIncrement(&metrics.tlsSessions);
+
+		if (tls->isResumed())
+			InterlockedIncrement(&metrics.tlsResumed);
+	}
+
+	if (!plain.empty())
+		receivePlain(&plain[0], plain.length());
+}
+
+/**
+* \brief	receivePlain
+*
+* performs the commands of received or decrypted bytes. a client that starts with an HTTP request gets a WebChannel,
+* which takes the commands from the requests. the responses are tasks, so they keep the order of the requests
+*
+* \param	data	received bytes, null terminated
+* \param	count	number of received bytes
+*/
+void Session::receivePlain(char *data, const unsigned int & count) {
+	if (!plainReceived) {
+		plainReceived = true;
+
+		if (webtransport == 1 && WebChannel::isRequest(data, count)) {
+			web = new WebChannel();
+
+			// not synchronized until the upgrade to WebSocket, the output of the server is dropped
+			InterlockedExchange(&protocol, PROTOCOL_HTTP);
+			InterlockedExchange(&syncScheduled, 1);
+		}
+	}
+
+	if (web == NULL) {
+		processCommands(data, count);
+
+		return;
+	}
+
+	std::string commands;
+	std::string response;
+	std::vector<std::string> tasks;
+
+	bool upgrading = !web->isUpgraded();
+	int result = web->receive(data, count, commands, response, tasks);
+
+	for (unsigned int i = 0; i < tasks.size(); i++)
+		tasklist.push(tasks[i], -1, id);
+
+	if (!response.empty()) {
+		std::vector<OutputChunk> chunks(1);
+		chunks[0].data.swap(response);
+
+		send(chunks, false);
+	}
+
+	if (result != 0) {
+		close();
+
+		return;
+	}
+
+	// the answer of the upgrade comes first, the synchronization follows in WebSocket messages
+	if (upgrading && web->isUpgraded()) {
+		InterlockedExchange(&protocol, PROTOCOL_WEBSOCKET);
+
+		// browsers load the covers with their HTTP cache
+		coverLinks = true;
+
+		tasklist.push("sync", -1, id);
+	}
+
+	if (!commands.empty())
+		processCommands(&commands[0], commands.length());
+}
+
+/**
+* \brief	processCommands
+*
+* splits received bytes into newline terminated commands and performs them. complete commands are performed in
+* place, only the start of an incomplete one is kept until the rest arrives
+*
+* \param	start	received bytes, null terminated
+* \param	count	number of received bytes
+*/
+void Session::processCommands(char *start, const unsigned int & count) {
+	char *end = start + count;
+
+	if (!delimited) {
+		if (memchr(start, '\n', count) == NULL) {
+			performCommand(this, start);
+
+			return;
+		}
+
+		delimited = true;
+	}
+
+	while (start < end && closed == 0) {
+		char *newline = (char*)memchr(start, '\n', end - start);
+		unsigned int length = (newline != NULL ? newline : end) - start;
+
+		if (newline == NULL || !partialCommand.empty() || commandOverflow) {
+			// part of a command
+			if (partialCommand.size() + length > MAX_COMMAND_LENGTH)
+				commandOverflow = true;
+			else
+				partialCommand.append(start, length);
+
+			if (newline != NULL) {
+				// the buffer is freed with the command
+				std::string command;
+				command.swap(partialCommand);
+				command.push_back('\0');
+
+				if (!commandOverflow)
+					dispatch(&command[0], newline + 1, end);
+
+				commandOverflow = false;
+			}
+		} else {
+			*newline = '\0';
+
+			dispatch(start, newline + 1, end);
+		}
+
+		start += length + 1;
+	}
+}
+
+// commands that only set a value, an earlier one is superseded by a later one of the same kind
+static const char *continuousCommands[] = { "volume_", "progress_" };
+
+/**
+* \brief	isSuperseded
+*
+* checks if a command only sets a value that a later complete command of the same receive sets again,
+* e.g. the volume_ commands of a slider drag
+*
+* \param	command	null terminated command
+* \param	rest	received bytes after the command
+* \param	end		end of the received bytes
+*
+* \return	true if the command can be skipped
+*/
+bool const Session::isSuperseded(const char *command, const char *rest, const char *end) {
+	for (unsigned int i = 0; i < sizeof(continuousCommands) / sizeof(continuousCommands[0]); i++) {
+		size_t length = strlen(continuousCommands[i]);
+
+		if (strncmp(command, continuousCommands[i], length) != 0)
+			continue;
+
+		// lines that are complete, an incomplete one may still overflow
+		for (const char *line = rest; line < end;) {
+			const char *newline = (const char*)memchr(line, '\n', end - line);
+
+			if (newline == NULL)
+				return false;
+
+			if ((size_t)(newline - line) >= length && memcmp(line, continuousCommands[i], length) == 0)
+				return true;
+
+			line = newline + 1;
+		}
+
+		return false;
+	}
+
+	return false;
+}
+
+/**
+* \brief	dispatch
+*
+* performs one received command without its line end, unless a later command of the same receive supersedes it
+*
+* \param	command	null terminated command, may be changed
+* \param	rest	received bytes after the command
+* \param	end		end of the received bytes
+*/
+void Session::dispatch(char *command, const char *rest, const char *end) {
+	size_t length = strlen(command);
+
+	if (length > 0 && command[length - 1] == '\r')
+		command[--length] = '\0';
+
+	if (length == 0)
+		return;
+
+	if (isSuperseded(command, rest, end)) {
+		InterlockedIncrement(&metrics.commandsSuperseded);
+
+		return;
+	}
+
+	performCommand(this, command);
+}
+
+/**
+* \brief	send
+*
+* appends chunks to the outgoing queues of the session and starts sending if no send is pending. never blocks.
+* bulk chunks only go to the bulk queue after the synchronization, before that everything is sent in order. a framed
+* session with a bound bulk connection sends them there, if that connection is gone they are multiplexed again
+*
+* \param	chunks	data to send
+* \param	copy	if false the chunks are taken over and left empty
+*
+* \return	1 if error, 0 if success
+*/
+int const Session::send(std::vector<OutputChunk> & chunks, const bool & copy) {
+	if (closed != 0)
+		return 1;
+
+	int result = 0;
+
+	// bulk chunks for the bulk connection
+	std::vector<OutputChunk> routed;
+	Session *route = NULL;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_session);
+
+	bool framed = protocol == PROTOCOL_FRAMED || protocol == PROTOCOL_DEFLATE;
+
+	for (std::vector<OutputChunk>::iterator it = chunks.begin(); it != chunks.end(); it++) {
+		if (it->length() == 0)
+			continue;
+
+		if (it->bulk && synchronized && framed && bulkRoute != NULL) {
+			routed.push_back(OutputChunk());
+
+			if (copy)
+				routed.back() = *it;
+			else
+				routed.back().swap(*it);
+
+			continue;
+		}
+
+		std::deque<OutputChunk> & queue = (it->bulk && synchronized) ? bulkQueue : outQueue;
+
+		addQueued(it->length());
+
+		if (copy)
+			queue.push_back(*it);	// shared data is referenced, not copied
+		else {
+			queue.push_back(OutputChunk());
+			queue.back().swap(*it);
+		}
+	}
+
+	queueDepth = outQueue.size() + bulkQueue.size();
+
+	if (queueDepth > peakQueueDepth)
+		peakQueueDepth = queueDepth;
+
+	// the client doesn't read fast enough
+	if (congested == 0 && queuedBytes > SEND_HIGH_WATER) {
+		congested = 1;
+		InterlockedIncrement(&metrics.sessionsCongested);
+	}
+
+	if (!sending)
+		result = postSend();
+
+	if (!routed.empty()) {
+		route = bulkRoute;
+		route->addRef();
+	}
+
+	LeaveCriticalSection(&cs_session);
+	// CRITICAL END
+
+	if (route != NULL) {
+		unsigned int bytes = 0;
+
+		for (unsigned int i = 0; i < routed.size(); i++)
+			bytes += routed[i].length();
+
+		// a closed connection leaves the chunks untouched
+		if (route->send(routed, false) == 0)
+			Metrics::add(metrics.bulkBytes, bytes);
+		else {
+			Session *removed = unbindBulk(route);
+
+			if (removed != NULL) {
+				InterlockedIncrement(&metrics.bulkFallbacks);
+
+				removed->release();
+			}
+
+			result = send(routed, false);
+		}
+
+		route->release();
+	}
+
+	return result;
+}
+
+/**
+* \brief	postSend
+*
+* starts an overlapped send of the front elements of the outgoing queues. must be called inside cs_session.
+* a partially sent bulk element is finished first so frames are never split by other data. while the scheduler paces,
+* the bulk elements wait for tokens and the control elements are charged to the interactive share. a TLS session
+* only sends its records, the next elements are encrypted when they are gone. Registered I/O copies the gathered
+* buffers into the send buffer of the slot. an element with a file is sent alone with TransmitFile
+*
+* \return	1 if error, 0 if success
+*/
+int const Session::postSend() {
+	inFlight.clear();
+
+	if (tls != NULL && sealedQueue.empty() && tls->isEstablished() && seal() != 0) {
+		close();
+
+		sending = false;
+
+		return 1;
+	}
+
+	if ((tls != NULL ? sealedQueue.empty() : (outQueue.empty() && bulkQueue.empty())) || closed != 0) {
+		sending = false;
+
+		return 0;
+	}
+
+	// gather the front elements into one send
+	WSABUF buffers[MAX_SEND_BUFFERS];
+	DWORD count = 0;
+	unsigned int bulk = 0;
+
+	OutputChunk *transmitted = NULL;
+	TRANSMIT_FILE_BUFFERS head;
+	ZeroMemory(&head, sizeof(head));
+
+	if (tls != NULL) {
+		for (std::deque<OutputChunk>::iterator record = sealedQueue.begin(); record != sealedQueue.end() && count + 1 <= MAX_SEND_BUFFERS; record++) {
+			gather(*record, record == sealedQueue.begin() ? sealedSentBytes : 0, buffers, count);
+
+			inFlight.push_back(&sealedQueue);
+		}
+	} else {
+		std::deque<OutputChunk>::iterator control = outQueue.begin();
+		std::deque<OutputChunk>::iterator data = bulkQueue.begin();
+
+		// a chunk with a file goes alone, its own bytes are the head of the TransmitFile
+		if (bulkSentBytes == 0 && control != outQueue.end() && control->shared != NULL && control->shared->file != INVALID_HANDLE_VALUE) {
+			transmitted = &*control;
+
+			inFlight.push_back(&outQueue);
+		} else if (bulkSentBytes > 0) {
+			gather(*data, bulkSentBytes, buffers, count);
+
+			inFlight.push_back(&bulkQueue);
+			data++;
+			bulk++;
+		}
+
+		DWORD first = count;
+
+		for (; transmitted == NULL && control != outQueue.end() && count + 2 <= MAX_SEND_BUFFERS; control++) {
+			if (control->shared != NULL && control->shared->file != INVALID_HANDLE_VALUE)
+				break;
+
+			// the frames of a bulk connection are paced like a bulk queue, a partially sent one is paid for
+			if (bulkOwner != 0 && !(control == outQueue.begin() && sentBytes > 0) && !takeTokens(*control))
+				break;
+
+			// front element may be partially sent
+			gather(*control, control == outQueue.begin() ? sentBytes : 0, buffers, count);
+
+			inFlight.push_back(&outQueue);
+		}
+
+		if (bulkOwner == 0) {
+			LONG interactive = transmitted != NULL ? transmitted->length() : 0;
+
+			for (DWORD i = first; i < count; i++)
+				interactive += buffers[i].len;
+
+			sendscheduler.charge(interactive);
+		}
+
+		for (; transmitted == NULL && data != bulkQueue.end() && count + 2 <= MAX_SEND_BUFFERS && bulk < MAX_BULK_BUFFERS; data++, bulk++) {
+			if (!takeTokens(*data))
+				break;
+
+			gather(*data, 0, buffers, count);
+
+			inFlight.push_back(&bulkQueue);
+		}
+
+		// everything left waits for the scheduler
+		if (transmitted == NULL && count == 0) {
+			sending = false;
+
+			return 0;
+		}
+	}
+
+	ZeroMemory(&sendContext.overlapped, sizeof(OVERLAPPED));
+
+	DWORD skip = 0;
+
+	if (transmitted != NULL) {
+		unsigned int own = transmitted->data.length();
+
+		if (sentBytes < own) {
+			head.Head = (char*)transmitted->data.data() + sentBytes;
+			head.HeadLength = own - sentBytes;
+		} else
+			skip = sentBytes - own;
+
+		sendContext.overlapped.Offset = transmitted->sharedOffset + skip;
+	}
+
+	sending = true;
+	sendStarted = metrics.now();
+
+	addRef();
+
+	if (transmitted != NULL ? TransmitFile(socket, transmitted->shared->file, transmitted->sharedLength - skip, 0, &sendContext.overlapped,
+			head.HeadLength > 0 ? &head : NULL, 0) == FALSE && WSAGetLastError() != WSA_IO_PENDING
+		: rio != NULL ? rio->send(buffers, count) != 0
+		: WSASend(socket, buffers, count, NULL, 0, &sendContext.overlapped, NULL) == SOCKET_ERROR && WSAGetLastError() != WSA_IO_PENDING) {
+		sending = false;
+
+		release();
+
+		return 1;
+	}
+
+	tracer.record("send", TRACE_INSTANT, id);
+
+	return 0;
+}
+
+/**
+* \brief	addQueued
+*
+* changes the bytes of the queued elements and charges the change to MEMORY_OUTPUT. must be called inside cs_session
+*
+* \param	bytes	bytes of the queued elements, negative for sent or dropped ones
+*/
+void Session::addQueued(const LONG & bytes) {
+	queuedBytes += bytes;
+
+	MemoryTag::add(MEMORY_OUTPUT, bytes);
+}
+
+/**
+* \brief	seal
+*
+* encrypts the front elements of the outgoing queues into TLS records, in the order postSend would send them and
+* with the same pacing. must be called inside cs_session
+*
+* \return	1 if error, 0 if success
+*/
+int const Session::seal() {
+	unsigned int elements = 0;
+
+	while (!outQueue.empty() && elements < MAX_SEND_BUFFERS) {
+		if (bulkOwner != 0 && !takeTokens(outQueue.front()))
+			break;
+
+		if (tls->encrypt(outQueue.front(), sealedQueue) != 0)
+			return 1;
+
+		if (bulkOwner == 0)
+			sendscheduler.charge(outQueue.front().length());
+
+		addQueued(-(LONG)outQueue.front().length());
+		outQueue.pop_front();
+		elements++;
+	}
+
+	for (unsigned int bulk = 0; !bulkQueue.empty() && bulk < MAX_BULK_BUFFERS && takeTokens(bulkQueue.front()); bulk++) {
+		if (tls->encrypt(bulkQueue.front(), sealedQueue) != 0)
+			return 1;
+
+		addQueued(-(LONG)bulkQueue.front().length());
+		bulkQueue.pop_front();
+		elements++;
+	}
+
+	InterlockedExchangeAdd(&metrics.messagesSent, elements);
+
+	return 0;
+}
+
+/**
+* \brief	sendCompleted
+*
+* called by the network thread when an overlapped send has finished. continues with the rest of the queues
+*
+* \param	bytes	number of bytes that have been sent
+*/
+void Session::sendCompleted(const DWORD & bytes) {
+	// CRITICAL
+	EnterCriticalSection(&cs_session);
+
+	DWORD remaining = bytes;
+	LONGLONG elapsed = metrics.now() - sendStarted;
+
+	metrics.sendLatency.record(elapsed);
+	tracer.record("sent", TRACE_INSTANT, bytes);
+
+	if (SlowLog::isSlow(elapsed)) {
+		SlowEntry entry;
+		entry.operation = "send";
+		entry.bytes = bytes;
+		entry.duration = elapsed;
+
+		stringstream caller;
+		caller << "session:" << id;
+		entry.caller = caller.str();
+
+		slowlog.add(entry);
+	}
+	Metrics::add(metrics.bytesSent, bytes);
+
+	if (bytes >= THROUGHPUT_MIN_BYTES && elapsed > 0) {
+		LONGLONG sample = min((LONGLONG)bytes * 1000000 / elapsed, (LONGLONG)LONG_MAX);
+
+		InterlockedExchange(&throughput, (LONG)(throughput < 0 ? sample : (3 * (LONGLONG)throughput + sample) / 4));
+	}
+
+	// drop completely sent elements in send order
+	for (unsigned int i = 0; i < inFlight.size() && remaining > 0; i++) {
+		std::deque<OutputChunk> & queue = *inFlight[i];
+		unsigned int & offset = (&queue == &outQueue) ? sentBytes : ((&queue == &bulkQueue) ? bulkSentBytes : sealedSentBytes);
+
+		unsigned int length = queue.front().length() - offset;
+
+		if (remaining >= length) {
+			remaining -= length;
+			offset = 0;
+
+			// the elements of the records have been counted by seal
+			if (&queue != &sealedQueue) {
+				addQueued(-(LONG)queue.front().length());
+				InterlockedIncrement(&metrics.messagesSent);
+			}
+
+			queue.pop_front();
+		} else {
+			offset += remaining;
+			remaining = 0;
+		}
+	}
+
+	queueDepth = outQueue.size() + bulkQueue.size();
+	lastSent = GetTickCount();
+
+	// the held events and paused tasks follow once the client has caught up
+	bool relieved = congested != 0 && queuedBytes < SEND_LOW_WATER;
+
+	if (relieved)
+		congested = 0;
+
+	// the session of a bulk connection continues its paused tasks
+	relieved = relieved && (!heldStates.empty() || !pausedTasks.empty() || bulkOwner != 0);
+
+	postSend();
+
+	LeaveCriticalSection(&cs_session);
+	// CRITICAL END
+
+	if (relieved)
+		tasklist.push("relieved", -1, bulkOwner != 0 ? bulkOwner : id);
+
+	// reference of the finished send
+	release();
+}
+
+/**
+* \brief	resumeBulk
+*
+* called by the scheduler when the session has got tokens, starts sending if no send is pending
+*/
+void Session::resumeBulk() {
+	// CRITICAL
+	EnterCriticalSection(&cs_session);
+
+	if (!sending && closed == 0)
+		postSend();
+
+	LeaveCriticalSection(&cs_session);
+	// CRITICAL END
+}
+
+/**
+* \brief	takeTokens
+*
+* pays for a bulk element out of the bucket of the session while the scheduler paces. an empty bucket lets the
+* session wait for the next round. must be called inside cs_session
+*
+* \param	chunk	bulk element that is about to be sent
+*
+* \return	true if the element may be sent
+*/
+bool const Session::takeTokens(const OutputChunk & chunk) {
+	if (!sendscheduler.isPacing())
+		return true;
+
+	if (bulkTokens > 0) {
+		InterlockedExchangeAdd(&bulkTokens, -(LONG)chunk.length());
+
+		return true;
+	}
+
+	if (InterlockedCompareExchange(&scheduled, 1, 0) == 0)
+		sendscheduler.wait(this);
+
+	return false;
+}
+
+/**
+* \brief	abortCovers
+*
+* drops the data frames of the covers of earlier songs that haven't been handed to the socket yet, a new song makes
+* them stale. the frames of a pending send are finished, so a stream always ends between two frames. the client gets
+* FRAME_DATA_ABORT for every stream it won't receive completely. only the framed protocols split the covers
+*
+* \return	number of aborted covers
+*/
+unsigned int const Session::abortCovers() {
+	if (protocol != PROTOCOL_FRAMED && protocol != PROTOCOL_DEFLATE)
+		return 0;
+
+	LONGLONG bytes = 0;
+	unsigned int aborted = dropCovers(bytes);
+
+	Session *route = NULL;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_session);
+
+	if (bulkRoute != NULL) {
+		route = bulkRoute;
+		route->addRef();
+	}
+
+	LeaveCriticalSection(&cs_session);
+	// CRITICAL END
+
+	// the bulk connection carries the data frames
+	if (route != NULL) {
+		aborted += route->dropCovers(bytes);
+		route->release();
+	}
+
+	if (aborted > 0) {
+		InterlockedExchangeAdd(&metrics.coversAborted, aborted);
+		Metrics::add(metrics.coverBytesAborted, bytes);
+	}
+
+	return aborted;
+}
+
+/**
+* \brief	dropCovers
+*
+* drops the cover frames of the connection that aren't sending and queues an abort frame for each of their streams
+*
+* \param	bytes	increased by the dropped bytes
+*
+* \return	number of aborted streams
+*/
+unsigned int const Session::dropCovers(LONGLONG & bytes) {
+	std::vector<unsigned short> streams;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_session);
+
+	// the elements of the pending send are the front ones, a partially sent one is finished in any case
+	unsigned int control = sentBytes > 0 ? 1 : 0;
+	unsigned int bulk = bulkSentBytes > 0 ? 1 : 0;
+
+	if (sending) {
+		control = max(control, (unsigned int)std::count(inFlight.begin(), inFlight.end(), &outQueue));
+		bulk = max(bulk, (unsigned int)std::count(inFlight.begin(), inFlight.end(), &bulkQueue));
+	}
+
+	LONGLONG dropped = dropCovers(outQueue, control, streams) + dropCovers(bulkQueue, bulk, streams);
+
+	if (!streams.empty()) {
+		std::vector<OutputChunk> frames;
+
+		for (unsigned int i = 0; i < streams.size(); i++)
+			OutputBuffer::appendAbortFrame(frames, streams[i]);
+
+		addQueued(-(LONG)dropped);
+
+		for (unsigned int i = 0; i < frames.size(); i++) {
+			addQueued(frames[i].length());
+
+			outQueue.push_back(OutputChunk());
+			outQueue.back().swap(frames[i]);
+		}
+
+		queueDepth = outQueue.size() + bulkQueue.size();
+
+		if (!sending && closed == 0)
+			postSend();
+	}
+
+	LeaveCriticalSection(&cs_session);
+	// CRITICAL END
+
+	bytes += dropped;
+
+	return streams.size();
+}
+
+/**
+* \brief	dropCovers
+*
+* removes the cover frames from a queue
+*
+* \param	queue	outgoing queue
+* \param	keep	number of front elements that are sending
+* \param	streams	receives the streams of the removed frames
+*
+* \return	bytes of the removed frames
+*/
+LONGLONG const Session::dropCovers(std::deque<OutputChunk> & queue, const unsigned int & keep, std::vector<unsigned short> & streams) {
+	LONGLONG bytes = 0;
+
+	std::deque<OutputChunk>::iterator it = queue.begin() + min(keep, (unsigned int)queue.size());
+
+	while (it != queue.end()) {
+		if (!it->cover) {
+			it++;
+
+			continue;
+		}
+
+		if (std::find(streams.begin(), streams.end(), it->stream) == streams.end())
+			streams.push_back(it->stream);
+
+		bytes += it->length();
+		it = queue.erase(it);
+	}
+
+	return bytes;
+}
+
+/**
+* \brief	close
+*
+* closes the client socket. all pending operations return with an error and release their references
+*/
+void Session::close() {
+	if (InterlockedExchange(&closed, 1) != 0)
+		return;
+
+	if (flowId != 0 && qosHandle != NULL)
+		QOSRemoveSocketFromFlow(qosHandle, socket, flowId, 0);
+
+	shutdown(socket, 2);
+	closesocket(socket);
+}
+
+/**
+* \brief	isSubscribed
+*
+* \param	topic	TOPIC_ flag of a broadcast, 0 for the ones every client gets
+*
+* \return	true if the session gets the broadcast
+*/
+bool const Session::isSubscribed(const int & topic) const {
+	return synchronized && (topic == 0 || (topics & topic) != 0);
+}
+
+/**
+* \brief	bindBulk
+*
+* makes a connection the bulk connection of the session, from now on it sends the bulk frames
+*
+* \param	route	session of the connection, gets a reference
+*
+* \return	true if bound, false if the session is closed or has a bulk connection already
+*/
+bool const Session::bindBulk(Session *route) {
+	// CRITICAL
+	EnterCriticalSection(&cs_session);
+
+	bool bound = closed == 0 && bulkRoute == NULL;
+
+	if (bound) {
+		bulkRoute = route;
+		bulkRoute->addRef();
+	}
+
+	LeaveCriticalSection(&cs_session);
+	// CRITICAL END
+
+	return bound;
+}
+
+/**
+* \brief	unbindBulk
+*
+* removes the bulk connection, the bulk frames are multiplexed again
+*
+* \param	route	connection to remove, NULL for any
+*
+* \return	removed connection with the reference of the session, the caller has to release() it. NULL if there was none
+*/
+Session* const Session::unbindBulk(const Session *route) {
+	Session *removed = NULL;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_session);
+
+	if (bulkRoute != NULL && (route == NULL || route == bulkRoute)) {
+		removed = bulkRoute;
+		bulkRoute = NULL;
+	}
+
+	LeaveCriticalSection(&cs_session);
+	// CRITICAL END
+
+	return removed;
+}
+
+/**
+* \brief	holdState
+*
+* keeps a broadcast state event for a congested session instead of queueing it, a later one of the same name
+* replaces it. the held value of a session that isn't congested is outdated by the event
+*
+* \param	key		name of the state, see TaskList::stateKey
+* \param	element	state event
+*
+* \return	true if the event is held, false if it is sent
+*/
+bool const Session::holdState(const std::string & key, const std::string & element) {
+	// CRITICAL
+	EnterCriticalSection(&cs_session);
+
+	bool held = congested != 0;
+
+	if (held)
+		heldStates[key] = element;
+	else
+		heldStates.erase(key);
+
+	// a tick is relative to the clock before it
+	if (key == "clock_")
+		heldStates.erase("tick_");
+
+	LeaveCriticalSection(&cs_session);
+	// CRITICAL END
+
+	if (held)
+		InterlockedIncrement(&metrics.eventsCollapsed);
+
+	return held;
+}
+
+/**
+* \brief	pauseTask
+*
+* defers a bulk task of a congested session or one whose bulk connection is congested. once a task is paused the
+* later ones wait too, so they keep their order
+*
+* \param	element	task element
+*
+* \return	true if the task is paused
+*/
+bool const Session::pauseTask(const std::string & element) {
+	// CRITICAL
+	EnterCriticalSection(&cs_session);
+
+	bool paused = congested != 0 || (bulkRoute != NULL && bulkRoute->congested != 0) || !pausedTasks.empty();
+
+	if (paused)
+		pausedTasks.push_back(element);
+
+	LeaveCriticalSection(&cs_session);
+	// CRITICAL END
+
+	if (paused)
+		InterlockedIncrement(&metrics.tasksPaused);
+
+	return paused;
+}
+
+/**
+* \brief	takeHeld
+*
+* removes the held state events and the paused tasks. called by the send command thread for the relieved task
+*
+* \param	states	receives the held state events
+* \param	tasks	receives the paused tasks in order
+*/
+void Session::takeHeld(std::vector<std::string> & states, std::vector<std::string> & tasks) {
+	// CRITICAL
+	EnterCriticalSection(&cs_session);
+
+	for (std::map<std::string, std::string>::iterator it = heldStates.begin(); it != heldStates.end(); it++)
+		states.push_back(it->second);
+
+	heldStates.clear();
+	tasks.swap(pausedTasks);
+
+	LeaveCriticalSection(&cs_session);
+	// CRITICAL END
+}
+
+/**
+* \brief	isStalled
+*
+* \return	true if the session is congested and no send has completed for SEND_STALL_TIMEOUT milliseconds. a session
+*			waiting for the scheduler isn't stalled
+*/
+bool const Session::isStalled() const {
+	return congested != 0 && scheduled == 0 && GetTickCount() - (DWORD)lastSent > SEND_STALL_TIMEOUT;
+}
+
+/**
+* \brief	hasCover
+*
+* checks if the client has a cover cached and marks it as recently used, the same way the client does
+*
+* \param	hash	hash of the cover
+*
+* \return	true if the client has the cover
+*/
+bool const Session::hasCover(const std::string & hash) {
+	return findHash(coverHashes, hash);
+}
+
+/**
+* \brief	rememberCover
+*
+* adds a cover the client has received. the least recently used one is dropped like by the client
+*
+* \param	hash	hash of the cover
+*/
+void Session::rememberCover(const std::string & hash) {
+	addHash(coverHashes, hash);
+}
+
+/**
+* \brief	forgetCover
+*
+* removes a cover the client hasn't received completely after all, see abortCovers
+*
+* \param	hash	hash of the cover
+*/
+void Session::forgetCover(const std::string & hash) {
+	coverHashes.remove(hash);
+}
+
+/**
+* \brief	hasThumbnail
+*
+* checks if the client has the thumbnail of a cover and marks it as recently used, the same way the client does
+*
+* \param	hash	hash of the cover
+*
+* \return	true if the client has the thumbnail
+*/
+bool const Session::hasThumbnail(const std::string & hash) {
+	return findHash(thumbnailHashes, hash);
+}
+
+/**
+* \brief	rememberThumbnail
+*
+* adds a thumbnail the client has received. the least recently used one is dropped like by the client
+*
+* \param	hash	hash of the cover
+*/
+void Session::rememberThumbnail(const std::string & hash) {
+	addHash(thumbnailHashes, hash);
+}
+
+/**
+* \brief	findHash
+*
+* \param	hashes	hashes, least recently used first
+* \param	hash	hash to find, it becomes the most recently used
+*
+* \return	true if the hash has been found
+*/
+bool const Session::findHash(std::list<std::string> & hashes, const std::string & hash) {
+	for (std::list<std::string>::iterator it = hashes.begin(); it != hashes.end(); it++) {
+		if (*it == hash) {
+			hashes.splice(hashes.end(), hashes, it);
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+* \brief	addHash
+*
+* adds a hash as the most recently used one, the least recently used is dropped after COVER_HASHES
+*
+* \param	hashes	hashes, least recently used first
+* \param	hash	hash to add
+*/
+void Session::addHash(std::list<std::string> & hashes, const std::string & hash) {
+	if (findHash(hashes, hash))
+		return;
+
+	hashes.push_back(hash);
+
+	if (hashes.size() > COVER_HASHES)
+		hashes.pop_front();
+}
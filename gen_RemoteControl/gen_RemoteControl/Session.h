@@ -0,0 +1,275 @@
+#pragma once
+#include "stdafx.h"
+
+// overlapped socket operations handled by the completion port
+#define OPERATION_ACCEPT 1
+#define OPERATION_RECEIVE 2
+#define OPERATION_SEND 3
+
+// completion packet of the Registered I/O completion queue, see RioChannel
+#define OPERATION_RIO 4
+
+// size of the receive buffer the network thread reads the sockets into
+#define RECEIVE_BUFFER_SIZE 256
+
+// reads of one socket per completed receive, the other sessions get their turn after them
+#define MAX_RECEIVE_READS 16
+
+// maximum length of a command that is received in several parts, longer ones are dropped
+#define MAX_COMMAND_LENGTH 1024
+
+// maximum number of buffers handed to one WSASend. a queued element needs up to two (own and shared bytes)
+#define MAX_SEND_BUFFERS 16
+
+// maximum number of bulk elements handed to one WSASend, limits how long control data waits behind a cover
+#define MAX_BULK_BUFFERS 2
+
+// minimum number of bytes of a send whose completion is a throughput sample. small sends only measure the latency
+#define THROUGHPUT_MIN_BYTES 8192
+
+// protocols: newline terminated text or frames, see OutputBuffer
+#define PROTOCOL_TEXT 1
+#define PROTOCOL_FRAMED 2
+
+// framed with the runs of text lines compressed, see FRAME_DEFLATE
+#define PROTOCOL_DEFLATE 3
+
+// WebSocket messages, a session upgraded by WebChannel
+#define PROTOCOL_WEBSOCKET 4
+
+// HTTP requests, the session gets no output of the server
+#define PROTOCOL_HTTP 5
+
+// queued bytes above which a session is congested: the broadcast state events wait for it collapsed to their latest
+// value and its bulk tasks pause. it is relieved below the low water mark
+#define SEND_HIGH_WATER 1048576
+#define SEND_LOW_WATER 262144
+
+// milliseconds a congested session may go without a completed send before it is closed
+#define SEND_STALL_TIMEOUT 30000
+
+// topics of the broadcast events, a client stops getting one with unsubscribe_<name>. see TaskList::topic
+#define TOPIC_PROGRESS 0x01		// progress: progress_, clock_ and tick_
+#define TOPIC_POSITION 0x02		// position: playlistPosition_
+#define TOPIC_QUEUE 0x04		// queue: changes of the JTFE queue
+#define TOPIC_TRACK 0x08		// track: file information and cover of a new song
+#define TOPIC_ALL 0x0F
+
+// milliseconds a new client has to request the framed protocol before it is synchronized with the text protocol
+#define HANDSHAKE_TIMEOUT 500
+
+class Session;
+class RioChannel;
+
+// context of one pending overlapped operation. the completion port returns the OVERLAPPED member
+// so it always has to be the first one
+struct IOContext {
+	OVERLAPPED overlapped;
+	int operation;
+	Session *session;
+};
+
+
+class Session {
+	private:
+		volatile LONG references;
+
+		// outgoing data. the front elements are the ones currently sent
+		std::deque<OutputChunk> outQueue;
+		unsigned int sentBytes;
+
+		// outgoing bulk data (framed protocol only), sent when outQueue is empty
+		std::deque<OutputChunk> bulkQueue;
+		unsigned int bulkSentBytes;
+
+		// TLS records and handshake messages in send order. the elements of the other queues are encrypted
+		// when these have been sent, the records of a TLS session can't overtake each other
+		std::deque<OutputChunk> sealedQueue;
+		unsigned int sealedSentBytes;
+
+		// queue of every element of the pending send, in send order
+		std::vector<std::deque<OutputChunk>*> inFlight;
+		bool sending;
+
+		// latest broadcast state events while congested by state name, "cover" for the cover of a new song
+		std::map<std::string, std::string> heldStates;
+
+		// bulk tasks of the session deferred while congested, in order
+		std::vector<std::string> pausedTasks;
+
+		// second connection of the client that carries the bulk frames, NULL while they are multiplexed. holds a reference
+		Session *bulkRoute;
+
+		// Metrics::now when the pending send has been started
+		LONGLONG sendStarted;
+
+		// critical session section
+		CRITICAL_SECTION cs_session;
+
+		// start of a newline terminated command that has not been received completely, empty most of the time.
+		// only used by the network thread
+		std::string partialCommand;
+		bool commandOverflow;
+
+		// true after the first newline. older clients don't terminate their commands, every receive is one command
+		bool delimited;
+
+		// false until the first bytes have been received, they tell whether the client uses TLS. the first
+		// decrypted ones tell whether it uses HTTP
+		bool received;
+		bool plainReceived;
+
+		// bytes read from a socket, the network thread reads one at a time
+		static char receiveBuffer[RECEIVE_BUFFER_SIZE + 1];
+
+		int const postSend();
+		int const seal();
+		bool const takeTokens(const OutputChunk & chunk);
+		void addQueued(const LONG & bytes);
+		unsigned int const dropCovers(LONGLONG & bytes);
+		void receiveCompleted(const DWORD & bytes);
+		void receivePlain(char *data, const unsigned int & count);
+		void processCommands(char *start, const unsigned int & count);
+		void dispatch(char *command, const char *rest, const char *end);
+
+		static bool const isSuperseded(const char *command, const char *rest, const char *end);
+		static LONGLONG const dropCovers(std::deque<OutputChunk> & queue, const unsigned int & keep, std::vector<unsigned short> & streams);
+		static bool const findHash(std::list<std::string> & hashes, const std::string & hash);
+		static void addHash(std::list<std::string> & hashes, const std::string & hash);
+
+	public:
+		Session(const SOCKET & socket, const int & id);
+
+		~Session();
+
+		SOCKET socket;
+		int id;
+
+		// TLS of the session, NULL for plain connections. created with the first receive
+		TlsChannel *tls;
+
+		// HTTP and WebSocket of the session, NULL for the native protocol. only used by the network thread
+		WebChannel *web;
+
+		// Registered I/O of the session, NULL for sessions served through the completion port
+		RioChannel *rio;
+
+		// PROTOCOL_TEXT until the client requests a framed protocol
+		volatile LONG protocol;
+
+		// timer that synchronizes the client if it doesn't request the framed protocol
+		HANDLE handshakeTimer;
+		volatile LONG syncScheduled;
+
+		// true after the initial synchronization has been sent. broadcast events are only sent to synchronized sessions
+		volatile bool synchronized;
+
+		// TOPIC_ flags of the broadcast events the client gets, TOPIC_ALL until it unsubscribes
+		volatile LONG topics;
+
+		// journal position of resume_<epoch>_<sequence>, the sync replays the missed broadcasts instead if it can.
+		// written by the network thread before the sync is scheduled
+		volatile bool resume;
+		std::string resumeEpoch;
+		LONG resumeSequence;
+		volatile LONG closed;
+
+		// 1 while the client reports being in the background with background_1, it gets no keep alive messages
+		volatile LONG background;
+
+		// not answered keep alive messages
+		volatile LONG alive_delay;
+
+		// tick count when the first not answered keep alive message was queued
+		volatile LONG aliveSent;
+
+		// milliseconds measured with the last answered keep alive message, -1 if unknown
+		volatile LONG rtt;
+
+		// song change until the client has shown it and the one way time of its probe, see LatencyProbes
+		Histogram endToEnd;
+		Histogram oneWay;
+
+		// bytes per second of the large sends, smoothed. a send completes when the socket has taken the data,
+		// so it is near the link rate once the send buffer is full. -1 if unknown
+		volatile LONG throughput;
+
+		// number of queued outgoing elements and the highest number since the client has connected
+		volatile LONG queueDepth;
+		volatile LONG peakQueueDepth;
+
+		// bytes of the queued elements, 1 while congested and tick count of the last completed send. see SEND_HIGH_WATER
+		volatile LONG queuedBytes;
+		volatile LONG congested;
+		volatile LONG lastSent;
+
+		// key of bulk_<key> the client binds its second connection with, empty if it hasn't asked for one.
+		// only used by the network thread
+		std::string bulkKey;
+
+		// id of the session whose bulk frames this connection carries, 0 for the control connection of a client.
+		// a bulk connection is never synchronized and gets no keep alive messages
+		volatile LONG bulkOwner;
+
+		// share of the uplink set with weight_<n>, 0 for the default of the client. see SendScheduler
+		volatile LONG weight;
+
+		// bytes of bulk frames the session may still hand to the socket while the scheduler paces, below 0 after a
+		// frame larger than the rest. 1 while it waits for a round of the scheduler
+		volatile LONG bulkTokens;
+		volatile LONG scheduled;
+
+		// socket profile, see applySocketProfile
+		int profile;
+
+		// qWAVE flow of the socket, 0 if the traffic isn't marked
+		QOS_FLOWID flowId;
+
+		// maximum cover width and height requested with coverSize_, -1 for clients that only know coverLength_
+		int coverSize;
+
+		// true if the client loads the covers over HTTP, it only gets coverLink_<hash>. see sendPicture
+		volatile bool coverLinks;
+
+		// hashes of the covers the client has cached, least recently used first. only used by the send command thread
+		std::list<std::string> coverHashes;
+
+		// hash of the last cover of the song queued to be kept by the client, empty if it gets a reduced variant. it is
+		// forgotten again if the transfer is aborted. only used by the send command thread
+		std::string sentCover;
+
+		// hashes of the thumbnails of covers_ the client keeps in memory, least recently used first. only used by the
+		// send command thread
+		std::list<std::string> thumbnailHashes;
+
+		IOContext receiveContext;
+		IOContext sendContext;
+
+		void addRef();
+		void release();
+
+		int const postReceive();
+		int const receiveReady();
+		void receiveRegistered(const DWORD & bytes);
+		int const send(std::vector<OutputChunk> & chunks, const bool & copy);
+		void sendCompleted(const DWORD & bytes);
+		void resumeBulk();
+		unsigned int const abortCovers();
+		void close();
+
+		bool const isSubscribed(const int & topic) const;
+
+		bool const bindBulk(Session *route);
+		Session* const unbindBulk(const Session *route = NULL);
+
+		bool const holdState(const std::string & key, const std::string & element);
+		bool const pauseTask(const std::string & element);
+		void takeHeld(std::vector<std::string> & states, std::vector<std::string> & tasks);
+		bool const isStalled() const;
+
+		bool const hasCover(const std::string & hash);
+		void rememberCover(const std::string & hash);
+		void forgetCover(const std::string & hash);
+		bool const hasThumbnail(const std::string & hash);
+		void rememberThumbnail(const std::string & hash);
+};
@@ -0,0 +1,393 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	SessionList
+*
+* constructor
+*/
+SessionList::SessionList() {
+	nextId = ALL_SESSIONS + 1;
+
+	InitializeCriticalSection(&cs_sessions);
+}
+
+/**
+* \brief	~SessionList
+*
+* destructor
+*/
+SessionList::~SessionList() {
+	DeleteCriticalSection(&cs_sessions);
+}
+
+/**
+* \brief	add
+*
+* creates a new session for an accepted client socket and inserts it into the list
+*
+* \param	socket	connected client socket
+*
+* \return	new session
+*/
+Session* const SessionList::add(const SOCKET & socket) {
+	// CRITICAL
+	EnterCriticalSection(&cs_sessions);
+
+	Session *session = new Session(socket, nextId++);
+
+	sessions.push_back(session);
+
+	LeaveCriticalSection(&cs_sessions);
+	// CRITICAL END
+
+	return session;
+}
+
+/**
+* \brief	remove
+*
+* removes a session from the list, closes its socket and drops the reference of the list
+*
+* \param	session	session to remove
+*
+* \return	true if the session was in the list
+*/
+bool const SessionList::remove(Session *session) {
+	bool found = false;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_sessions);
+
+	for (std::list<Session*>::iterator it = sessions.begin(); it != sessions.end(); it++) {
+		if (*it == session) {
+			sessions.erase(it);
+			found = true;
+			break;
+		}
+	}
+
+	LeaveCriticalSection(&cs_sessions);
+	// CRITICAL END
+
+	if (found) {
+		session->close();
+		session->release();
+	}
+
+	return found;
+}
+
+/**
+* \brief	removeAll
+*
+* closes and removes all sessions
+*/
+void SessionList::removeAll() {
+	std::list<Session*> closing;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_sessions);
+
+	closing.swap(sessions);
+
+	LeaveCriticalSection(&cs_sessions);
+	// CRITICAL END
+
+	for (std::list<Session*>::iterator it = closing.begin(); it != closing.end(); it++) {
+		(*it)->close();
+		(*it)->release();
+	}
+}
+
+/**
+* \brief	get
+*
+* returns the session with the given id. the caller has to release() the returned session
+*
+* \param	id	session id
+*
+* \return	session or NULL if there is no session with this id
+*/
+Session* const SessionList::get(const int & id) {
+	Session *session = NULL;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_sessions);
+
+	for (std::list<Session*>::iterator it = sessions.begin(); it != sessions.end(); it++) {
+		if ((*it)->id == id) {
+			session = *it;
+			session->addRef();
+			break;
+		}
+	}
+
+	LeaveCriticalSection(&cs_sessions);
+	// CRITICAL END
+
+	return session;
+}
+
+/**
+* \brief	getIds
+*
+* copies the ids of all current sessions
+*
+* \param	ids	vector that receives the ids
+*/
+void SessionList::getIds(std::vector<int> & ids) {
+	ids.clear();
+
+	// CRITICAL
+	EnterCriticalSection(&cs_sessions);
+
+	for (std::list<Session*>::iterator it = sessions.begin(); it != sessions.end(); it++)
+		ids.push_back((*it)->id);
+
+	LeaveCriticalSection(&cs_sessions);
+	// CRITICAL END
+}
+
+/**
+* \brief	count
+*
+* \return	number of connected clients, their bulk connections aren't counted
+*/
+int const SessionList::count() {
+	int number = 0;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_sessions);
+
+	for (std::list<Session*>::iterator it = sessions.begin(); it != sessions.end(); it++) {
+		if ((*it)->bulkOwner == 0)
+			number++;
+	}
+
+	LeaveCriticalSection(&cs_sessions);
+	// CRITICAL END
+
+	return number;
+}
+
+/**
+* \brief	foregroundCount
+*
+* \return	number of connected clients that aren't in the background, see Session::background
+*/
+int const SessionList::foregroundCount() {
+	int number = 0;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_sessions);
+
+	for (std::list<Session*>::iterator it = sessions.begin(); it != sessions.end(); it++) {
+		if ((*it)->background == 0 && (*it)->bulkOwner == 0)
+			number++;
+	}
+
+	LeaveCriticalSection(&cs_sessions);
+	// CRITICAL END
+
+	return number;
+}
+
+/**
+* \brief	maxRtt
+*
+* \return	highest measured round trip time of all sessions in milliseconds, -1 if none is known
+*/
+int const SessionList::maxRtt() {
+	int rtt = -1;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_sessions);
+
+	for (std::list<Session*>::iterator it = sessions.begin(); it != sessions.end(); it++) {
+		if ((*it)->rtt > rtt)
+			rtt = (*it)->rtt;
+	}
+
+	LeaveCriticalSection(&cs_sessions);
+	// CRITICAL END
+
+	return rtt;
+}
+
+/**
+* \brief	progressInterval
+*
+* \return	milliseconds between two samples of the playback position: PROGRESS_INTERVAL if a synchronized session in
+*			the foreground gets the progress events over a good link, PROGRESS_INTERVAL_SLOW if they are all congested
+*			or slow, 0 if there is none
+*/
+int const SessionList::progressInterval() {
+	int interval = 0;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_sessions);
+
+	for (std::list<Session*>::iterator it = sessions.begin(); it != sessions.end() && interval != PROGRESS_INTERVAL; it++) {
+		Session *session = *it;
+
+		if (!session->synchronized || session->background != 0 || !session->isSubscribed(TOPIC_PROGRESS))
+			continue;
+
+		interval = session->congested == 0 && session->rtt <= PROGRESS_SLOW_RTT ? PROGRESS_INTERVAL : PROGRESS_INTERVAL_SLOW;
+	}
+
+	LeaveCriticalSection(&cs_sessions);
+	// CRITICAL END
+
+	return interval;
+}
+
+/**
+* \brief	maxQueueDepth
+*
+* \return	highest number of queued outgoing elements of all sessions
+*/
+int const SessionList::maxQueueDepth() {
+	int depth = 0;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_sessions);
+
+	for (std::list<Session*>::iterator it = sessions.begin(); it != sessions.end(); it++) {
+		if ((*it)->queueDepth > depth)
+			depth = (*it)->queueDepth;
+	}
+
+	LeaveCriticalSection(&cs_sessions);
+	// CRITICAL END
+
+	return depth;
+}
+
+/**
+* \brief	isSubscribed
+*
+* \param	topic	TOPIC_ flag of a broadcast
+*
+* \return	true if at least one synchronized session gets the broadcast
+*/
+bool const SessionList::isSubscribed(const int & topic) {
+	bool subscribed = false;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_sessions);
+
+	for (std::list<Session*>::iterator it = sessions.begin(); it != sessions.end() && !subscribed; it++)
+		subscribed = (*it)->isSubscribed(topic);
+
+	LeaveCriticalSection(&cs_sessions);
+	// CRITICAL END
+
+	return subscribed;
+}
+
+/**
+* \brief	bindBulk
+*
+* binds a new connection to the session that has been given the key with bulk_<key>. a key binds once
+*
+* \param	key		key sent by the client on the new connection
+* \param	route	session of the new connection
+*
+* \return	true if bound
+*/
+bool const SessionList::bindBulk(const std::string & key, Session *route) {
+	bool bound = false;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_sessions);
+
+	for (std::list<Session*>::iterator it = sessions.begin(); it != sessions.end() && !key.empty(); it++) {
+		Session *session = *it;
+
+		if (session != route && session->bulkKey == key) {
+			session->bulkKey.clear();
+
+			if (session->bindBulk(route)) {
+				route->bulkOwner = session->id;
+				bound = true;
+			}
+
+			break;
+		}
+	}
+
+	LeaveCriticalSection(&cs_sessions);
+	// CRITICAL END
+
+	if (bound)
+		InterlockedIncrement(&metrics.bulkBinds);
+
+	return bound;
+}
+
+/**
+* \brief	send
+*
+* queues the output buffer for one session or for all synchronized sessions, each in the encoding of its protocol. a broadcast
+* is encoded once per protocol and shared by the sessions. never blocks.
+*
+* \param	id		session id, ALL_SESSIONS for a broadcast
+* \param	output	data to send. taken over if sent to a single session
+* \param	topic	TOPIC_ flag of a broadcast, it skips the sessions that have unsubscribed. 0 for every session
+* \param	state	state event of a broadcast, congested sessions hold it instead and the session that has caused it
+*					doesn't get it. NULL for other data
+*
+* \return	1 if error, 0 if success
+*/
+int const SessionList::send(const int & id, OutputBuffer & output, const int & topic, const Task *state) {
+	int result = 0;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_sessions);
+
+	if (id == ALL_SESSIONS) {
+		std::vector<Session*> receivers;
+
+		// each encoding once, built before the bytes are shared
+		for (std::list<Session*>::iterator it = sessions.begin(); it != sessions.end(); it++) {
+			// the client has already shown its own change
+			if (state != NULL && state->origin == (*it)->id) {
+				InterlockedIncrement(&metrics.echoesSuppressed);
+
+				continue;
+			}
+
+			// fresh state goes over the datagram route of the session if it has one
+			if (state != NULL && (*it)->isSubscribed(topic) && datagramchannel.send((*it)->id, state->key, state->element))
+				continue;
+
+			if ((*it)->isSubscribed(topic) && (state == NULL || !(*it)->holdState(state->key, state->element))) {
+				output.encoded((*it)->protocol);
+				receivers.push_back(*it);
+			}
+		}
+
+		// one copy of the bytes, the sessions queue references that are released when their sends have finished
+		if (receivers.size() > 1)
+			output.share();
+
+		for (unsigned int i = 0; i < receivers.size(); i++)
+			receivers[i]->send(output.encoded(receivers[i]->protocol), true);
+	} else {
+		result = 1;
+
+		for (std::list<Session*>::iterator it = sessions.begin(); it != sessions.end(); it++) {
+			if ((*it)->id == id) {
+				result = (*it)->send(output.encoded((*it)->protocol), false);
+				break;
+			}
+		}
+	}
+
+	LeaveCriticalSection(&cs_sessions);
+	// CRITICAL END
+
+	return result;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include "stdafx.h"
+
+// session id for tasks that are sent to all synchronized sessions
+#define ALL_SESSIONS 0
+
+struct Task;
+
+
+class SessionList {
+	private:
+		std::list<Session*> sessions;
+		int nextId;
+
+		// critical session list section
+		CRITICAL_SECTION cs_sessions;
+
+	public:
+		SessionList();
+
+		~SessionList();
+
+		Session* const add(const SOCKET & socket);
+		bool const remove(Session *session);
+		void removeAll();
+
+		Session* const get(const int & id);
+		void getIds(std::vector<int> & ids);
+		int const count();
+		int const foregroundCount();
+		int const maxRtt();
+		int const maxQueueDepth();
+		int const progressInterval();
+		bool const isSubscribed(const int & topic);
+		bool const bindBulk(const std::string & key, Session *route);
+
+		int const send(const int & id, OutputBuffer & output, const int & topic = 0, const Task *state = NULL);
+};
@@ -0,0 +1,282 @@
+#pragma once
+// shared with RemoteControlHost, only needs the system headers
+#include <windows.h>
+#include <stdio.h>
+#include <string>
+
+
+// bytes of one ring, a power of two
+#define HOST_RING_SIZE (1 << 20)
+
+// rings of the host channel: events of the winamp window to the host, calls of the host to winamp and their results
+#define HOST_RING_EVENTS 0
+#define HOST_RING_COMMANDS 1
+#define HOST_RING_REPLIES 2
+#define HOST_RINGS 3
+
+// record types
+#define HOST_PAD 0
+
+// message the winamp window got: message, wParam, lParam. the string of a pointer parameter is the payload
+#define HOST_EVENT 1
+
+// message the plugin sends to winamp: message, wParam, lParam. a marshalled structure parameter is the payload
+#define HOST_IPC 2
+
+// call of the queue manager: API_QUEUE_ dispatch code, parameter
+#define HOST_QUEUE 3
+
+// result of a HOST_IPC or HOST_QUEUE: result. the string a pointer result points to is the payload
+#define HOST_REPLY 4
+
+// the host quits the plugin and exits
+#define HOST_QUIT 5
+
+// the host shows the window of the plugin
+#define HOST_CONFIG 6
+
+// ipc message the host answers with 1, winamp with 0
+#define HOST_HOSTED_IPC "RemoteControl_hosted"
+
+// milliseconds the host waits for a reply before it treats winamp as gone
+#define HOST_REPLY_TIMEOUT 10000
+
+
+// header of one ring in the shared memory, followed by its data. the counters only grow, the offset in the data
+// is the counter modulo the size
+struct SharedRingHeader {
+	// bytes written, only changed by the writer
+	volatile LONG head;
+
+	// bytes read, only changed by the reader
+	volatile LONG tail;
+
+	// records the writer had no room for
+	volatile LONG dropped;
+
+	LONG size;
+};
+
+// record header, followed by the payload padded to 8 bytes. the values are 64 bit, so a 32 bit winamp and a 64 bit
+// host agree on the layout
+struct SharedRecord {
+	LONG type;
+	LONG length;
+
+	// number of the call a reply answers, a late reply to a call that has timed out is skipped
+	LONG sequence;
+	LONG reserved;
+
+	LONGLONG values[3];
+};
+
+
+// single producer single consumer ring of records in memory shared by two processes. without locks: the writer
+// publishes a record by advancing head after writing it, the reader frees it by advancing tail after reading it.
+// a record never wraps, the rest of the data is skipped instead. a named event wakes the reader
+class SharedRing {
+	private:
+		SharedRingHeader *header;
+		char *data;
+		HANDLE signal;
+
+		static ULONG const padded(const ULONG & length) { return (length + 7) & ~7UL; }
+
+	public:
+		SharedRing() : header(NULL), data(NULL), signal(NULL) {}
+
+		/**
+		* \brief	attach
+		*
+		* \param	memory	header and data of the ring in the mapping, the creator initializes the header
+		* \param	event	auto reset event of the ring
+		* \param	create	true for the process that has created the mapping
+		*/
+		void attach(void *memory, HANDLE event, const bool & create) {
+			header = (SharedRingHeader*)memory;
+			data = (char*)memory + sizeof(SharedRingHeader);
+			signal = event;
+
+			if (create) {
+				header->head = 0;
+				header->tail = 0;
+				header->dropped = 0;
+				header->size = HOST_RING_SIZE;
+			}
+		}
+
+		/**
+		* \brief	write
+		*
+		* appends a record and wakes the reader. never blocks, a full ring drops the record
+		*
+		* \return	false if the record has been dropped
+		*/
+		bool const write(const LONG & type, const LONG & sequence, const LONGLONG & first, const LONGLONG & second, const LONGLONG & third, const void *payload = NULL, const unsigned int & length = 0) {
+			ULONG size = (ULONG)header->size;
+			ULONG need = sizeof(SharedRecord) + padded(length);
+			ULONG head = (ULONG)header->head;
+			ULONG tail = (ULONG)header->tail;
+
+			ULONG offset = head & (size - 1);
+			ULONG skip = size - offset < need ? size - offset : 0;
+
+			if (need > size / 2 || head + skip + need - tail > size) {
+				InterlockedIncrement(&header->dropped);
+
+				return false;
+			}
+
+			// the reader skips the rest of the data after a pad record or if not even a record header fits
+			if (skip >= sizeof(SharedRecord))
+				((SharedRecord*)(data + offset))->type = HOST_PAD;
+
+			SharedRecord *record = (SharedRecord*)(data + ((head + skip) & (size - 1)));
+			record->type = type;
+			record->length = (LONG)length;
+			record->sequence = sequence;
+			record->reserved = 0;
+			record->values[0] = first;
+			record->values[1] = second;
+			record->values[2] = third;
+
+			if (length > 0)
+				memcpy(record + 1, payload, length);
+
+			InterlockedExchange(&header->head, (LONG)(head + skip + need));
+
+			SetEvent(signal);
+
+			return true;
+		}
+
+		/**
+		* \brief	read
+		*
+		* takes the oldest record
+		*
+		* \param	record	receives type and values
+		* \param	payload	receives the payload
+		*
+		* \return	false if the ring is empty
+		*/
+		bool const read(SharedRecord & record, std::string & payload) {
+			ULONG size = (ULONG)header->size;
+			ULONG tail = (ULONG)header->tail;
+			bool found = false;
+
+			while (!found && tail != (ULONG)header->head) {
+				ULONG offset = tail & (size - 1);
+				SharedRecord *next = (SharedRecord*)(data + offset);
+
+				if (size - offset < sizeof(SharedRecord) || next->type == HOST_PAD) {
+					tail += size - offset;
+
+					continue;
+				}
+
+				record = *next;
+				payload.assign((const char*)(next + 1), record.length);
+
+				tail += sizeof(SharedRecord) + padded(record.length);
+				found = true;
+			}
+
+			InterlockedExchange(&header->tail, (LONG)tail);
+
+			return found;
+		}
+
+		/**
+		* \brief	wait
+		*
+		* \param	timeout	milliseconds
+		*
+		* \return	true if a record may have been written since the last wait
+		*/
+		bool const wait(const DWORD & timeout) {
+			return WaitForSingleObject(signal, timeout) == WAIT_OBJECT_0;
+		}
+
+		HANDLE const event() const { return signal; }
+		LONG const dropped() const { return header->dropped; }
+};
+
+
+// shared memory of the rings between the plugin in winamp and RemoteControlHost. the plugin creates it with the
+// name it passes to the host
+class HostChannel {
+	private:
+		HANDLE mapping;
+		void *view;
+		HANDLE signals[HOST_RINGS];
+
+	public:
+		SharedRing rings[HOST_RINGS];
+
+		HostChannel() : mapping(NULL), view(NULL) {
+			for (int i = 0; i < HOST_RINGS; i++)
+				signals[i] = NULL;
+		}
+
+		~HostChannel() { close(); }
+
+		/**
+		* \brief	open
+		*
+		* \param	name	name of the mapping, the events are named <name>_<ring>
+		* \param	create	true to create the mapping, false to open an existing one
+		*
+		* \return	false if error
+		*/
+		bool const open(const std::string & name, const bool & create) {
+			DWORD bytes = HOST_RINGS * (sizeof(SharedRingHeader) + HOST_RING_SIZE);
+
+			mapping = create ? CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, bytes, name.c_str())
+				: OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, name.c_str());
+
+			if (mapping != NULL)
+				view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+
+			if (view == NULL) {
+				close();
+
+				return false;
+			}
+
+			for (int i = 0; i < HOST_RINGS; i++) {
+				char eventName[128];
+				sprintf_s(eventName, sizeof(eventName), "%s_%d", name.c_str(), i);
+
+				signals[i] = create ? CreateEventA(NULL, FALSE, FALSE, eventName) : OpenEventA(EVENT_ALL_ACCESS, FALSE, eventName);
+
+				if (signals[i] == NULL) {
+					close();
+
+					return false;
+				}
+
+				rings[i].attach((char*)view + i * (sizeof(SharedRingHeader) + HOST_RING_SIZE), signals[i], create);
+			}
+
+			return true;
+		}
+
+		void close() {
+			for (int i = 0; i < HOST_RINGS; i++) {
+				if (signals[i] != NULL)
+					CloseHandle(signals[i]);
+
+				signals[i] = NULL;
+			}
+
+			if (view != NULL)
+				UnmapViewOfFile(view);
+
+			if (mapping != NULL)
+				CloseHandle(mapping);
+
+			view = NULL;
+			mapping = NULL;
+		}
+};
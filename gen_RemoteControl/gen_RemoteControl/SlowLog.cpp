@@ -0,0 +1,248 @@
+#include "stdafx.h"
+
+
+DWORD SlowOperation::tlsCurrent = TLS_OUT_OF_INDEXES;
+
+/**
+* \brief	SlowEntry
+*
+* constructor, an entry without stages
+*/
+SlowEntry::SlowEntry() {
+	ZeroMemory(&time, sizeof(time));
+
+	operation = "";
+	format = -1;
+	bytes = 0;
+	duration = 0;
+	stageCount = 0;
+}
+
+/**
+* \brief	describe
+*
+* \return	one line: "slow <operation> ms <ms> time <hh:mm:ss> caller <caller> format <format> bytes <bytes>
+*			stages <name>:<ms>,... path <path>". the path is last, it may contain spaces
+*/
+std::string const SlowEntry::describe() const {
+	static const char *formats[] = { "mp3", "flac", "other" };
+
+	char clock[16];
+	sprintf_s(clock, sizeof(clock), "%02d:%02d:%02d", time.wHour, time.wMinute, time.wSecond);
+
+	stringstream line;
+	line << "slow " << operation << " ms " << duration / 1000 << " time " << clock << " caller " << (caller.empty() ? "-" : caller)
+		<< " format " << (format >= 0 && format < FORMATS ? formats[format] : "-")
+		<< " bytes " << bytes << " stages ";
+
+	for (unsigned int i = 0; i < stageCount; i++)
+		line << (i > 0 ? "," : "") << stages[i].name << ":" << stages[i].duration / 1000;
+
+	if (stageCount == 0)
+		line << "-";
+
+	line << " path " << path;
+
+	return line.str();
+}
+
+/**
+* \brief	size
+*
+* \return	bytes the entry takes in the log
+*/
+unsigned int const SlowEntry::size() const {
+	return sizeof(SlowEntry) + caller.length() + path.length();
+}
+
+
+/**
+* \brief	SlowLog
+*
+* constructor
+*/
+SlowLog::SlowLog() {
+	InitializeCriticalSection(&cs_slowlog);
+}
+
+/**
+* \brief	~SlowLog
+*
+* destructor
+*/
+SlowLog::~SlowLog() {
+	DeleteCriticalSection(&cs_slowlog);
+}
+
+/**
+* \brief	isSlow
+*
+* \param	duration	microseconds an operation took
+*
+* \return	true if it belongs into the slow log
+*/
+bool const SlowLog::isSlow(const LONGLONG & duration) {
+	int threshold = slowthreshold;
+
+	return threshold > 0 && duration >= (LONGLONG)threshold * 1000;
+}
+
+/**
+* \brief	add
+*
+* keeps a slow operation, dropping the oldest one if the log is full, and lists it in the log of the window
+*
+* \param	entry	operation, the time is set here
+*/
+void SlowLog::add(SlowEntry & entry) {
+	GetLocalTime(&entry.time);
+
+	// CRITICAL
+	EnterCriticalSection(&cs_slowlog);
+
+	if (entries.size() >= SLOW_LOG_ENTRIES) {
+		MemoryTag::add(MEMORY_LOG, -(LONG)entries.front().size());
+		entries.pop_front();
+	}
+
+	entries.push_back(entry);
+	MemoryTag::add(MEMORY_LOG, entry.size());
+
+	LeaveCriticalSection(&cs_slowlog);
+	// CRITICAL END
+
+	InterlockedIncrement(&metrics.slowOperations);
+
+	UIManager::addLogText(entry.describe() + "\r\n");
+}
+
+/**
+* \brief	report
+*
+* describes the kept operations, newest first
+*
+* \param	lines	receives one line per operation, see SlowEntry::describe
+*/
+void SlowLog::report(std::vector<std::string> & lines) {
+	// CRITICAL
+	EnterCriticalSection(&cs_slowlog);
+
+	for (std::deque<SlowEntry>::reverse_iterator it = entries.rbegin(); it != entries.rend(); it++)
+		lines.push_back(it->describe());
+
+	LeaveCriticalSection(&cs_slowlog);
+	// CRITICAL END
+}
+
+
+/**
+* \brief	SlowOperation
+*
+* constructor, starts the clock and the first stage
+*
+* \param	operation	name of the operation, must be a string literal
+* \param	path		file, command or peer the operation works on
+*/
+SlowOperation::SlowOperation(const char *operation, const std::string & path) {
+	active = slowthreshold > 0;
+	parent = NULL;
+
+	if (!active)
+		return;
+
+	// the first operation allocates the index
+	if (tlsCurrent == TLS_OUT_OF_INDEXES) {
+		DWORD index = TlsAlloc();
+
+		if (InterlockedCompareExchange((volatile LONG*)&tlsCurrent, (LONG)index, (LONG)TLS_OUT_OF_INDEXES) != (LONG)TLS_OUT_OF_INDEXES)
+			TlsFree(index);
+	}
+
+	if (tlsCurrent != TLS_OUT_OF_INDEXES) {
+		parent = (SlowOperation*)TlsGetValue(tlsCurrent);
+		TlsSetValue(tlsCurrent, this);
+	}
+
+	entry.operation = operation;
+	entry.path = path;
+
+	started = metrics.now();
+	stageStarted = started;
+}
+
+/**
+* \brief	~SlowOperation
+*
+* destructor, adds the operation to slowlog if it took longer than slowthreshold. the caller is only described then
+*/
+SlowOperation::~SlowOperation() {
+	if (!active)
+		return;
+
+	if (tlsCurrent != TLS_OUT_OF_INDEXES)
+		TlsSetValue(tlsCurrent, parent);
+
+	entry.duration = metrics.now() - started;
+
+	if (!SlowLog::isSlow(entry.duration))
+		return;
+
+	stringstream caller;
+
+	if (parent != NULL)
+		caller << parent->entry.operation << (parent->entry.path.empty() ? "" : ":") << parent->entry.path;
+	else
+		caller << "thread:" << GetCurrentThreadId();
+
+	entry.caller = caller.str();
+
+	slowlog.add(entry);
+}
+
+/**
+* \brief	stage
+*
+* ends the current stage. the time since the previous stage or the start is charged to it
+*
+* \param	name	name of the stage that has ended, must be a string literal
+*/
+void SlowOperation::stage(const char *name) {
+	if (!active || entry.stageCount >= SLOW_LOG_STAGES)
+		return;
+
+	LONGLONG now = metrics.now();
+
+	entry.stages[entry.stageCount].name = name;
+	entry.stages[entry.stageCount].duration = now - stageStarted;
+	entry.stageCount++;
+
+	stageStarted = now;
+}
+
+/**
+* \brief	setPath
+*
+* \param	path	file, command or peer the operation works on, if it is known after the start
+*/
+void SlowOperation::setPath(const std::string & path) {
+	if (active)
+		entry.path = path;
+}
+
+/**
+* \brief	setFormat
+*
+* \param	format	FORMAT_ of the parsed file
+*/
+void SlowOperation::setFormat(const int & format) {
+	entry.format = format;
+}
+
+/**
+* \brief	addBytes
+*
+* \param	bytes	bytes read or sent by the operation
+*/
+void SlowOperation::addBytes(const LONGLONG & bytes) {
+	entry.bytes += bytes;
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include "stdafx.h"
+
+
+// number of slow operations kept, the oldest ones are dropped
+#define SLOW_LOG_ENTRIES 128
+
+// stages of one operation that are timed separately
+#define SLOW_LOG_STAGES 6
+
+// timed part of a slow operation
+struct SlowStage {
+	const char *name;	// string literal
+	LONGLONG duration;	// microseconds
+};
+
+// one operation that took longer than slowthreshold
+struct SlowEntry {
+	// local time the operation has finished
+	SYSTEMTIME time;
+
+	// string literal, e.g. parse
+	const char *operation;
+
+	// enclosing operation, session or thread
+	std::string caller;
+
+	// file, command or peer the operation worked on
+	std::string path;
+
+	// FORMAT_ of a parsed file, -1 for other operations
+	int format;
+
+	// bytes read or sent
+	LONGLONG bytes;
+
+	// microseconds
+	LONGLONG duration;
+
+	SlowStage stages[SLOW_LOG_STAGES];
+	unsigned int stageCount;
+
+	SlowEntry();
+
+	std::string const describe() const;
+	unsigned int const size() const;
+};
+
+
+// the last operations that took longer than slowthreshold milliseconds with their path and stages. the histograms
+// of Metrics tell that the sync is slow, this tells which file of which share made it slow. listed in the log of the
+// window as they happen and sent by the slowlog command
+class SlowLog {
+	private:
+		// oldest first
+		std::deque<SlowEntry> entries;
+
+		// critical slow log section
+		CRITICAL_SECTION cs_slowlog;
+
+	public:
+		SlowLog();
+
+		~SlowLog();
+
+		static bool const isSlow(const LONGLONG & duration);
+
+		void add(SlowEntry & entry);
+		void report(std::vector<std::string> & lines);
+};
+
+
+// times an operation from the constructor to the destructor and adds it to slowlog if it was slow. an operation
+// inside another one on the same thread names it as caller. disabled it costs one comparison
+class SlowOperation {
+	private:
+		SlowEntry entry;
+		bool active;
+
+		LONGLONG started;
+		LONGLONG stageStarted;
+
+		// enclosing operation of the thread, NULL if there is none
+		SlowOperation *parent;
+
+		// thread local innermost operation
+		static DWORD tlsCurrent;
+
+	public:
+		SlowOperation(const char *operation, const std::string & path = std::string());
+
+		~SlowOperation();
+
+		void stage(const char *name);
+		void setPath(const std::string & path);
+		void setFormat(const int & format);
+		void addBytes(const LONGLONG & bytes);
+};
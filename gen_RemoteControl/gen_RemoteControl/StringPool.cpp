@@ -0,0 +1,254 @@
+#include "stdafx.h"
+
+
+// length and characters of the empty string, id STRING_POOL_EMPTY
+static const char emptyValue[5] = { 0, 0, 0, 0, 0 };
+
+
+/**
+* \brief	StringPool
+*
+* constructor, the pool holds the empty string
+*/
+StringPool::StringPool() {
+	current = NULL;
+	used = STRING_POOL_BLOCK;
+
+	for (int i = 0; i < STRING_POOL_PAGES; i++)
+		pages[i] = NULL;
+
+	pages[0] = new const char*[STRING_POOL_PAGE];
+	pages[0][STRING_POOL_EMPTY] = emptyValue + 4;
+	count = 1;
+
+	table.resize(1024, 0);
+
+	MemoryTag::add(MEMORY_METADATA, STRING_POOL_PAGE * sizeof(const char*) + table.size() * sizeof(unsigned int));
+
+	arenaBytes = 0;
+	internedBytes = 0;
+
+	InitializeCriticalSection(&cs_pool);
+}
+
+/**
+* \brief	~StringPool
+*
+* destructor
+*/
+StringPool::~StringPool() {
+	for (unsigned int i = 0; i < blocks.size(); i++)
+		delete[] blocks[i];
+
+	for (int i = 0; i < STRING_POOL_PAGES; i++)
+		delete[] pages[i];
+
+	DeleteCriticalSection(&cs_pool);
+}
+
+/**
+* \brief	hash
+*
+* \param	value	characters
+* \param	length	number of characters
+*
+* \return	FNV-1a hash of the characters
+*/
+unsigned int const StringPool::hash(const char *value, const unsigned int & length) {
+	unsigned int h = 2166136261U;
+
+	for (unsigned int i = 0; i < length; i++) {
+		h ^= (unsigned char)value[i];
+		h *= 16777619U;
+	}
+
+	return h;
+}
+
+/**
+* \brief	store
+*
+* copies a value into the arena. must be called inside cs_pool
+*
+* \param	value	characters
+* \param	length	number of characters
+*
+* \return	first character of the copy
+*/
+const char* const StringPool::store(const char *value, const unsigned int & length) {
+	unsigned int needed = length + 5;
+	char *target;
+
+	if (needed > STRING_POOL_BLOCK) {
+		// a block of its own, the current block stays in use
+		target = new char[needed];
+		blocks.push_back(target);
+
+		Metrics::add(arenaBytes, needed);
+		MemoryTag::add(MEMORY_METADATA, needed);
+
+		// the values are never dropped, the tracks keep their ids
+		memorybudget.update(BUDGET_STRINGS, arenaBytes, 0);
+	} else {
+		if (needed > STRING_POOL_BLOCK - used) {
+			current = new char[STRING_POOL_BLOCK];
+			blocks.push_back(current);
+			used = 0;
+
+			Metrics::add(arenaBytes, STRING_POOL_BLOCK);
+			MemoryTag::add(MEMORY_METADATA, STRING_POOL_BLOCK);
+
+			memorybudget.update(BUDGET_STRINGS, arenaBytes, 0);
+		}
+
+		target = current + used;
+		used += needed;
+	}
+
+	memcpy(target, &length, 4);
+	memcpy(target + 4, value, length);
+	target[4 + length] = 0;
+
+	return target + 4;
+}
+
+/**
+* \brief	grow
+*
+* doubles the hash table. must be called inside cs_pool
+*/
+void StringPool::grow() {
+	std::vector<unsigned int> larger(table.size() * 2, 0);
+	unsigned int mask = larger.size() - 1;
+
+	for (unsigned int i = 0; i < table.size(); i++) {
+		unsigned int id = table[i];
+
+		if (id == 0)
+			continue;
+
+		unsigned int slot = hash(value(id), length(id)) & mask;
+
+		while (larger[slot] != 0)
+			slot = (slot + 1) & mask;
+
+		larger[slot] = id;
+	}
+
+	MemoryTag::add(MEMORY_METADATA, (larger.size() - table.size()) * sizeof(unsigned int));
+
+	table.swap(larger);
+}
+
+/**
+* \brief	intern
+*
+* returns the id of a value, the value is stored if it is new
+*
+* \param	value	characters
+* \param	length	number of characters
+*
+* \return	id, STRING_POOL_EMPTY for an empty value or if the pool is full
+*/
+unsigned int const StringPool::intern(const char *value, const unsigned int & length) {
+	if (length == 0)
+		return STRING_POOL_EMPTY;
+
+	Metrics::add(internedBytes, length + 1);
+
+	unsigned int h = hash(value, length);
+	unsigned int id = STRING_POOL_EMPTY;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_pool);
+
+	unsigned int mask = table.size() - 1;
+	unsigned int slot = h & mask;
+
+	while (table[slot] != 0) {
+		unsigned int candidate = table[slot];
+
+		if (this->length(candidate) == length && memcmp(this->value(candidate), value, length) == 0) {
+			id = candidate;
+			break;
+		}
+
+		slot = (slot + 1) & mask;
+	}
+
+	if (id == STRING_POOL_EMPTY && (unsigned int)count < STRING_POOL_PAGE * STRING_POOL_PAGES) {
+		id = count;
+
+		const char **&page = pages[id / STRING_POOL_PAGE];
+
+		if (page == NULL) {
+			page = new const char*[STRING_POOL_PAGE];
+			MemoryTag::add(MEMORY_METADATA, STRING_POOL_PAGE * sizeof(const char*));
+		}
+
+		page[id % STRING_POOL_PAGE] = store(value, length);
+		table[slot] = id;
+
+		// the id is handed out after the lock is left, so every reader finds its page
+		InterlockedIncrement(&count);
+
+		// at most half of the slots are used
+		if ((unsigned int)count * 2 > table.size())
+			grow();
+	}
+
+	LeaveCriticalSection(&cs_pool);
+	// CRITICAL END
+
+	return id;
+}
+
+/**
+* \brief	intern
+*
+* \param	value	value
+*
+* \return	id of the value, see intern above
+*/
+unsigned int const StringPool::intern(const std::string & value) {
+	return intern(value.data(), value.length());
+}
+
+/**
+* \brief	value
+*
+* \param	id	id returned by intern
+*
+* \return	null terminated value
+*/
+const char* const StringPool::value(const unsigned int & id) const {
+	return pages[id / STRING_POOL_PAGE][id % STRING_POOL_PAGE];
+}
+
+/**
+* \brief	length
+*
+* \param	id	id returned by intern
+*
+* \return	number of characters of the value
+*/
+unsigned int const StringPool::length(const unsigned int & id) const {
+	unsigned int length;
+	memcpy(&length, value(id) - 4, 4);
+
+	return length;
+}
+
+/**
+* \brief	report
+*
+* adds the "string_pool <values>" line of the stats
+*
+* \param	lines	vector that receives the line
+*/
+void StringPool::report(std::vector<std::string> & lines) {
+	stringstream line;
+	line << "string_pool values " << count - 1 << " arena_bytes " << arenaBytes << " interned_bytes " << internedBytes;
+
+	lines.push_back(line.str());
+}
@@ -0,0 +1,59 @@
+#pragma once
+#include "stdafx.h"
+
+
+// bytes of one block of the arena, longer values get a block of their own
+#define STRING_POOL_BLOCK 65536
+
+// ids per page of the id table and number of pages
+#define STRING_POOL_PAGE 16384
+#define STRING_POOL_PAGES 4096
+
+// id of the empty string
+#define STRING_POOL_EMPTY 0
+
+
+// distinct values of the fields that repeat across a library: artist, album and genre. every value is stored once
+// in an arena and never changes or moves, the tracks keep its 32 bit id. equal ids mean equal values.
+// value never blocks, the ids are only interned under the lock
+class StringPool {
+	private:
+		// blocks of the arena, a value is stored as its length (4 bytes), the characters and a null byte
+		std::vector<char*> blocks;
+
+		// block new values are stored in and its used bytes
+		char *current;
+		unsigned int used;
+
+		// first character of the value of an id by page. pages are allocated once and kept
+		const char **pages[STRING_POOL_PAGES];
+		volatile LONG count;
+
+		// open addressing table of the ids by hash, 0 marks a free slot since the empty string isn't in it
+		std::vector<unsigned int> table;
+
+		// bytes of the arena and the bytes the values would have taken every time they were interned
+		volatile LONGLONG arenaBytes;
+		volatile LONGLONG internedBytes;
+
+		// critical string pool section
+		CRITICAL_SECTION cs_pool;
+
+		static unsigned int const hash(const char *value, const unsigned int & length);
+
+		const char* const store(const char *value, const unsigned int & length);
+		void grow();
+
+	public:
+		StringPool();
+
+		~StringPool();
+
+		unsigned int const intern(const char *value, const unsigned int & length);
+		unsigned int const intern(const std::string & value);
+
+		const char* const value(const unsigned int & id) const;
+		unsigned int const length(const unsigned int & id) const;
+
+		void report(std::vector<std::string> & lines);
+};
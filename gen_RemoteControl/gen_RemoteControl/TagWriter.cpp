@@ -0,0 +1,485 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	TagWriter
+*
+* constructor
+*/
+TagWriter::TagWriter() {
+	thread = NULL;
+
+	editEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+	stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+	InitializeCriticalSection(&cs_tagwriter);
+}
+
+/**
+* \brief	~TagWriter
+*
+* destructor
+*/
+TagWriter::~TagWriter() {
+	CloseHandle(editEvent);
+	CloseHandle(stopEvent);
+
+	DeleteCriticalSection(&cs_tagwriter);
+}
+
+/**
+* \brief	isField
+*
+* \param	field	field name of a tagEdit_ command
+*
+* \return	true if the field can be written
+*/
+bool const TagWriter::isField(const std::string & field) {
+	return field == "title" || field == "artist" || field == "album" || field == "genre" || field == "comment"
+		|| field == "year" || field == "track" || field == "rating" || field == "replaygain_track_gain"
+		|| field == "replaygain_track_peak" || field == "replaygain_album_gain" || field == "replaygain_album_peak";
+}
+
+/**
+* \brief	add
+*
+* queues the edit of one field of a file and starts the writer thread if it isn't running.
+* an earlier edit of the same field that hasn't been written yet is replaced
+*
+* \param	file	path of the file
+* \param	field	field name, see isField
+* \param	value	new value, UTF8
+*
+* \return	1 if the field is unknown or the file is no local file, 0 if success
+*/
+int const TagWriter::add(const char *file, const std::string & field, const std::string & value) {
+	if (file == NULL || !isField(field))
+		return 1;
+
+	// streams can't be written
+	char fullPath[MAX_PATH];
+
+	if (GetFullPathNameA(file, MAX_PATH, fullPath, NULL) == 0 || GetFileAttributesA(fullPath) == INVALID_FILE_ATTRIBUTES)
+		return 1;
+
+	std::string key(fullPath);
+	std::transform(key.begin(), key.end(), key.begin(), tolower);
+
+	// CRITICAL
+	EnterCriticalSection(&cs_tagwriter);
+
+	TagEdit & edit = pending[key];
+	edit.file = fullPath;
+	edit.fields[field] = value;
+	edit.edited = GetTickCount();
+
+	if (thread == NULL) {
+		ResetEvent(stopEvent);
+
+		thread = CreateThread(NULL, 0, writeFunction, this, 0, NULL);
+	}
+
+	LeaveCriticalSection(&cs_tagwriter);
+	// CRITICAL END
+
+	SetEvent(editEvent);
+
+	return 0;
+}
+
+/**
+* \brief	stop
+*
+* writes the pending edits, also of the file that is played, and waits for the writer thread. called by quit
+*/
+void TagWriter::stop() {
+	SetEvent(stopEvent);
+
+	joinThread(thread, TAG_WRITE_TIMEOUT);
+}
+
+/**
+* \brief	playingFile
+*
+* \return	lower case full path of the file winamp plays or has paused, empty if it is stopped
+*/
+static std::string const playingFile() {
+	if (winampstate.getIsPlaying() == 0)
+		return std::string();
+
+	const char *file = (char*)SendMessage(plugin.hwndParent,WM_WA_IPC,winampstate.getListPosition(),IPC_GETPLAYLISTFILE);
+	char fullPath[MAX_PATH];
+
+	if (file == NULL || GetFullPathNameA(file, MAX_PATH, fullPath, NULL) == 0)
+		return std::string();
+
+	std::string path(fullPath);
+	std::transform(path.begin(), path.end(), path.begin(), tolower);
+
+	return path;
+}
+
+/**
+* \brief	takeReady
+*
+* removes the edits that can be written now from the pending ones: files that haven't been edited for
+* TAG_WRITE_DELAY milliseconds and aren't played
+*
+* \param	edits	receives the edits to write
+* \param	all		take every pending edit
+* \param	wait	receives the milliseconds until the next edit may be ready, INFINITE if none is left
+*/
+void TagWriter::takeReady(std::vector<TagEdit> & edits, const bool & all, DWORD & wait) {
+	// asked outside of the lock, the winamp thread may be busy
+	std::string playing = all ? std::string() : playingFile();
+
+	DWORD now = GetTickCount();
+
+	wait = INFINITE;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_tagwriter);
+
+	std::map<std::string, TagEdit>::iterator it = pending.begin();
+
+	while (it != pending.end()) {
+		DWORD elapsed = now - it->second.edited;
+
+		if (!all && elapsed < TAG_WRITE_DELAY) {
+			wait = min(wait, TAG_WRITE_DELAY - elapsed);
+			it++;
+		} else if (!all && it->first == playing) {
+			wait = min(wait, (DWORD)TAG_WRITE_POLL);
+			it++;
+		} else {
+			edits.push_back(it->second);
+			pending.erase(it++);
+		}
+	}
+
+	LeaveCriticalSection(&cs_tagwriter);
+	// CRITICAL END
+}
+
+/**
+* \brief	setRating
+*
+* sets the rating of a file: a POPM frame with the values of Windows Media Player for MP3, the RATING field
+* in percent for Xiph comments. other formats have no common rating field
+*
+* \param	f		file to change
+* \param	rating	0 (no rating) to 5 stars
+*/
+void TagWriter::setRating(TagLib::FileRef & f, const int & rating) {
+	static const int popularimeter[] = { 0, 1, 64, 128, 196, 255 };
+
+	int stars = rating < 0 ? 0 : (rating > 5 ? 5 : rating);
+
+	TagLib::MPEG::File *mpeg = dynamic_cast<TagLib::MPEG::File *>(f.file());
+	TagLib::FLAC::File *flac = dynamic_cast<TagLib::FLAC::File *>(f.file());
+	TagLib::Ogg::XiphComment *xiph = flac != NULL ? flac->xiphComment(true) : dynamic_cast<TagLib::Ogg::XiphComment *>(f.tag());
+
+	if (mpeg != NULL) {
+		TagLib::ID3v2::Tag *id3v2 = mpeg->ID3v2Tag(true);
+		TagLib::ID3v2::FrameList l = id3v2->frameList("POPM");	// POPM: popularimeter frame
+		TagLib::ID3v2::PopularimeterFrame *frame;
+
+		if (l.isEmpty()) {
+			frame = new TagLib::ID3v2::PopularimeterFrame();
+			frame->setEmail("Windows Media Player 9 Series");
+
+			id3v2->addFrame(frame);
+		} else
+			frame = static_cast<TagLib::ID3v2::PopularimeterFrame *>(l.front());
+
+		frame->setRating(popularimeter[stars]);
+	} else if (xiph != NULL)
+		xiph->addField("RATING", TagLib::String::number(stars * 20), true);
+}
+
+/**
+* \brief	setReplayGain
+*
+* sets a ReplayGain field of a file: a TXXX frame for MP3 like foobar2000 and mp3gain write it, a Xiph comment field
+* for Ogg and FLAC. other formats aren't changed
+*
+* \param	f		file to change
+* \param	field	replaygain_ field name, see isField
+* \param	value	gain in dB or peak
+*/
+void TagWriter::setReplayGain(TagLib::FileRef & f, const std::string & field, const TagLib::String & value) {
+	TagLib::String name = TagLib::String(field).upper();
+
+	TagLib::MPEG::File *mpeg = dynamic_cast<TagLib::MPEG::File *>(f.file());
+	TagLib::FLAC::File *flac = dynamic_cast<TagLib::FLAC::File *>(f.file());
+	TagLib::Ogg::XiphComment *xiph = flac != NULL ? flac->xiphComment(true) : dynamic_cast<TagLib::Ogg::XiphComment *>(f.tag());
+
+	if (mpeg != NULL) {
+		TagLib::ID3v2::Tag *id3v2 = mpeg->ID3v2Tag(true);
+		TagLib::ID3v2::UserTextIdentificationFrame *frame = TagLib::ID3v2::UserTextIdentificationFrame::find(id3v2, name);
+
+		if (frame == NULL) {
+			frame = new TagLib::ID3v2::UserTextIdentificationFrame(TagLib::String::UTF8);
+			frame->setDescription(name);
+
+			id3v2->addFrame(frame);
+		}
+
+		frame->setText(value);
+	} else if (xiph != NULL)
+		xiph->addField(name, value, true);
+}
+
+/**
+* \brief	write
+*
+* writes the edits of one file with TagLib. MP3 files get an ID3v2 tag, the other tags they have are kept
+*
+* \param	edit	edits of the file
+*
+* \return	1 if error, 0 if success
+*/
+int const TagWriter::write(const TagEdit & edit) {
+	TraceSpan span("tag_write");
+	MemoryTag memoryTag(MEMORY_TAGLIB, GOVERNOR_TAG_BYTES);
+
+	try {
+		TagLib::FileRef f(edit.file.c_str(), false);
+
+		if (f.isNull() || f.tag() == NULL || !f.file()->isValid())
+			return 1;
+
+		TagLib::Tag *tag = f.tag();
+
+		for (std::map<std::string, std::string>::const_iterator it = edit.fields.begin(); it != edit.fields.end(); it++) {
+			TagLib::String value(it->second, TagLib::String::UTF8);
+
+			if (it->first == "title")
+				tag->setTitle(value);
+			else if (it->first == "artist")
+				tag->setArtist(value);
+			else if (it->first == "album")
+				tag->setAlbum(value);
+			else if (it->first == "genre")
+				tag->setGenre(value);
+			else if (it->first == "comment")
+				tag->setComment(value);
+			else if (it->first == "year")
+				tag->setYear(value.toInt());
+			else if (it->first == "track")
+				tag->setTrack(value.toInt());
+			else if (it->first == "rating")
+				setRating(f, value.toInt());
+			else if (it->first.compare(0, 11, "replaygain_") == 0)
+				setReplayGain(f, it->first, value);
+		}
+
+		TagLib::MPEG::File *mpeg = dynamic_cast<TagLib::MPEG::File *>(f.file());
+
+		if (mpeg != NULL) {
+			int tags = TagLib::MPEG::File::ID3v2;
+
+			if (mpeg->ID3v1Tag() != NULL)
+				tags |= TagLib::MPEG::File::ID3v1;
+			if (mpeg->APETag() != NULL)
+				tags |= TagLib::MPEG::File::APE;
+
+			return mpeg->save(tags, false) ? 0 : 1;
+		}
+
+		return f.save() ? 0 : 1;
+	} catch (...) {
+		return 1;
+	}
+}
+
+/**
+* \brief	libraryWindow
+*
+* \return	window of the media library that takes the WM_ML_IPC messages, NULL if it isn't loaded
+*/
+static HWND const libraryWindow() {
+	static LRESULT getWindowIpc = 0;
+
+	if (getWindowIpc == 0)
+		getWindowIpc = SendMessage(plugin.hwndParent, WM_WA_IPC, (WPARAM)"LibraryGetWnd", IPC_REGISTER_WINAMP_IPCMESSAGE);
+
+	return (HWND)SendMessage(plugin.hwndParent, WM_WA_IPC, -1, getWindowIpc);
+}
+
+/**
+* \brief	wideValue
+*
+* \param	value	UTF8 value of an edit
+*
+* \return	value as wide string
+*/
+static std::wstring const wideValue(const std::string & value) {
+	int length = MultiByteToWideChar(CP_UTF8, 0, value.c_str(), -1, NULL, 0);
+
+	if (length <= 1)
+		return std::wstring();
+
+	std::vector<wchar_t> buffer(length);
+	MultiByteToWideChar(CP_UTF8, 0, value.c_str(), -1, &buffer[0], length);
+
+	return std::wstring(&buffer[0], length - 1);
+}
+
+/**
+* \brief	updateLibrary
+*
+* writes the edits of a batch of written files to the media library. SetField of api_mldb edits the record and the
+* indexes once per field, so every file gets one ML_IPC_DB_UPDATEITEMW with all of its fields instead, and the
+* database is synced once at the end of the batch. the modification time and size of the record are updated as well,
+* LibrarySource trusts the record again. files the library doesn't know are skipped
+*
+* \param	edits	edits of the files that have been written
+*/
+void TagWriter::updateLibrary(const std::vector<TagEdit> & edits) {
+	if (edits.empty())
+		return;
+
+	CHECK_MLDB();
+
+	HWND library = libraryWindow();
+
+	if (WASABI_API_MLDB == NULL || library == NULL)
+		return;
+
+	TraceSpan span("library_update");
+	SlowOperation slow("library_update");
+
+	int updated = 0;
+
+	for (unsigned int i = 0; i < edits.size(); i++) {
+		const TagEdit & edit = edits[i];
+
+		itemRecordW *record = WASABI_API_MLDB->GetFile(CA2W(edit.file.c_str()));
+
+		if (record == NULL)
+			continue;
+
+		// the unchanged fields point to the strings of the record, the changed ones to values
+		itemRecordW update = *record;
+
+		std::vector<std::wstring> values;
+		values.reserve(edit.fields.size());
+
+		for (std::map<std::string, std::string>::const_iterator it = edit.fields.begin(); it != edit.fields.end(); it++) {
+			values.push_back(wideValue(it->second));
+			wchar_t *value = const_cast<wchar_t*>(values.back().c_str());
+
+			if (it->first == "title")
+				update.title = value;
+			else if (it->first == "artist")
+				update.artist = value;
+			else if (it->first == "album")
+				update.album = value;
+			else if (it->first == "genre")
+				update.genre = value;
+			else if (it->first == "comment")
+				update.comment = value;
+			else if (it->first == "year")
+				update.year = _wtoi(value);
+			else if (it->first == "track")
+				update.track = _wtoi(value);
+			else if (it->first == "rating")
+				update.rating = max(0, min(5, _wtoi(value)));
+			else if (it->first == "replaygain_track_gain")
+				update.replaygain_track_gain = value;
+			else if (it->first == "replaygain_album_gain")
+				update.replaygain_album_gain = value;
+			// the library has no fields for the peaks
+		}
+
+		// the same units as LibrarySource compares: seconds since 1970 and kilobytes
+		WIN32_FILE_ATTRIBUTE_DATA attributes;
+
+		if (GetFileAttributesExA(edit.file.c_str(), GetFileExInfoStandard, &attributes) != 0) {
+			ULARGE_INTEGER written;
+			written.LowPart = attributes.ftLastWriteTime.dwLowDateTime;
+			written.HighPart = attributes.ftLastWriteTime.dwHighDateTime;
+
+			update.filetime = (__time64_t)((written.QuadPart - 116444736000000000ULL) / 10000000ULL);
+			update.filesize = (int)((((unsigned long long)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow) / 1024);
+		}
+
+		if (SendMessage(library, WM_ML_IPC, (WPARAM)&update, ML_IPC_DB_UPDATEITEMW) != -2)
+			updated++;
+
+		WASABI_API_MLDB->FreeRecord(record);
+	}
+
+	slow.stage("records");
+
+	// the indexes and the file of the database are written once for the batch
+	if (updated > 0) {
+		SendMessage(library, WM_ML_IPC, 0, ML_IPC_DB_SYNCDB);
+
+		slow.stage("sync");
+
+		InterlockedExchangeAdd(&metrics.libraryUpdates, updated);
+		InterlockedIncrement(&metrics.librarySyncs);
+	}
+}
+
+/**
+* \brief	writeFunction
+*
+* thread of the writer. waits for edits and writes the ready ones with background priority, every file once per batch.
+* a file that couldn't be written is dropped from the metadata cache, so the clients see its tags again, the written
+* ones are updated in the media library as one batch. returns after the stop event has been set and the remaining
+* edits are written
+*
+* \param	parameter	writer
+*
+* \return	0
+*/
+DWORD WINAPI TagWriter::writeFunction(LPVOID parameter) {
+	TagWriter *writer = (TagWriter*)parameter;
+
+	HANDLE events[2] = { writer->stopEvent, writer->editEvent };
+	DWORD wait = INFINITE;
+
+	while (1) {
+		bool stopping = WaitForMultipleObjects(2, events, FALSE, wait) == WAIT_OBJECT_0;
+
+		std::vector<TagEdit> edits;
+		writer->takeReady(edits, stopping, wait);
+
+		if (!edits.empty()) {
+			// low cpu and i/o priority while writing
+			ThreadPolicy *policy = new ThreadPolicy(THREAD_CLASS_BACKGROUND);
+
+			std::vector<TagEdit> written;
+
+			for (unsigned int i = 0; i < edits.size(); i++) {
+				// the remaining edits are written at once when stopping
+				GovernorToken token(GOVERNOR_TAGS, writer->stopEvent, 0, !stopping);
+				token.addIo(GOVERNOR_TAG_BYTES);
+
+				if (write(edits[i]) != 0) {
+					UIManager::addLogText("Could not write tags of " + edits[i].file + "\r\n", LOG_ERROR);
+
+					metadatacache.drop(edits[i].file.c_str());
+				} else
+					written.push_back(edits[i]);
+			}
+
+			delete policy;
+
+			// the library and winamp are asked on their thread, which waits for this one when stopping. the
+			// library reads the files again when it finds them modified
+			if (!stopping) {
+				updateLibrary(written);
+
+				// winamp reads the titles of its playlist again
+				SendMessage(plugin.hwndParent,WM_WA_IPC,0,IPC_REFRESHPLCACHE);
+			}
+		}
+
+		if (stopping)
+			return 0;
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "stdafx.h"
+
+// milliseconds an edited file waits for further edits before it is written
+#define TAG_WRITE_DELAY 1000
+
+// milliseconds between two checks whether a file that is played has been left
+#define TAG_WRITE_POLL 2000
+
+// milliseconds quit waits for the last writes
+#define TAG_WRITE_TIMEOUT 5000
+
+
+// edits of one file that haven't been written yet. later edits of a field replace earlier ones
+struct TagEdit {
+	// full path of the file
+	std::string file;
+
+	// field name and UTF8 value, see TagWriter::isField
+	std::map<std::string, std::string> fields;
+
+	// tick count of the last edit
+	DWORD edited;
+};
+
+
+// writes the tag edits of the clients in the background. a file is written once it hasn't been edited for
+// TAG_WRITE_DELAY milliseconds and winamp doesn't play it, so playback never waits for the disk
+class TagWriter {
+	private:
+		// pending edits by lower case path
+		std::map<std::string, TagEdit> pending;
+
+		HANDLE thread;
+		HANDLE editEvent;
+		HANDLE stopEvent;
+
+		// critical tag writer section
+		CRITICAL_SECTION cs_tagwriter;
+
+		static DWORD WINAPI writeFunction(LPVOID parameter);
+		static int const write(const TagEdit & edit);
+		static void setRating(TagLib::FileRef & f, const int & rating);
+		static void setReplayGain(TagLib::FileRef & f, const std::string & field, const TagLib::String & value);
+		static void updateLibrary(const std::vector<TagEdit> & edits);
+
+		void takeReady(std::vector<TagEdit> & edits, const bool & all, DWORD & wait);
+
+	public:
+		TagWriter();
+
+		~TagWriter();
+
+		static bool const isField(const std::string & field);
+
+		int const add(const char *file, const std::string & field, const std::string & value);
+		void stop();
+};
@@ -1,6 +1,26 @@
 #include "stdafx.h"
 
 
+/**
+* \brief	Task
+*
+* constructor, classifies the element as state event or command and gives it its priority class and topic
+*
+* \param	element	command
+* \param	session	id of the receiving session, ALL_SESSIONS for a broadcast
+*/
+Task::Task(const std::string & element, const int & session, const int & origin) : element(element), session(session), key(TaskList::stateKey(element)), priority(TaskList::priority(element)), topic(TaskList::topic(element)), origin(origin), queued(0) {
+}
+
+/**
+* \brief	size
+*
+* \return	bytes the task takes in the list, charged to MEMORY_TASKS while it waits
+*/
+unsigned int const Task::size() const {
+	return sizeof(Task) + element.length() + key.length();
+}
+
 /**
 * \brief	TaskList
 *
@@ -8,9 +28,10 @@
 */
 TaskList::TaskList() {
 	non_empty_list = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+	metadataGeneration = 0;
 	
 	InitializeCriticalSection(&cs_tasklist);
-	InitializeCriticalSection(&cs_parameter);
 }
 
 /**
@@ -20,270 +41,648 @@ TaskList::TaskList() {
 */
 TaskList::~TaskList() {
 	DeleteCriticalSection(&cs_tasklist);
-	DeleteCriticalSection(&cs_parameter);
 }
 
-const int TaskList::getParameter() {
-	// CRITICAL
-	EnterCriticalSection(&cs_parameter);
-	
-	int param = parameter;
+/**
+* \brief	pop
+*
+* takes the first inserted element of the highest priority class that isn't empty out of queue (BLOCKING!).
+* a cover or playlist window waiting in the bulk class never delays a pause or volume event
+*
+* \param	task	receives the taken element
+* \param	stop	event that cancels the wait
+*
+* \return	false if stop has been set
+*/
+bool const TaskList::pop(Task & task, HANDLE stop) {
+	// stop first, a set stop event wins over waiting elements
+	HANDLE events[2] = { stop, non_empty_list };
 
-	LeaveCriticalSection(&cs_parameter);
-	// CRITICAL END
+	while (WaitForMultipleObjects(2, events, FALSE, INFINITE) == WAIT_OBJECT_0 + 1) {
+		// CRITICAL
+		EnterCriticalSection(&cs_tasklist);
+
+		bool found = !isEmpty();
+
+		if (found) {
+			std::deque<Task> *list = lists;
+
+			while (list->empty())
+				list++;
+
+			task = list->front();
+			list->pop_front();
+
+			MemoryTag::add(MEMORY_TASKS, -(LONG)task.size());
+
+			tracer.record("dequeue", TRACE_INSTANT, size());
+
+			// time from the insert until the send command thread takes it, the waiting tasks before it included
+			metrics.queueWait.record(metrics.now() - task.queued);
+
+			// producers only wake the thread when the list was empty, so the next element is signalled here
+			if (!isEmpty())
+				SetEvent(non_empty_list);
+		}
+
+		LeaveCriticalSection(&cs_tasklist);
+		// CRITICAL END
+
+		if (found)
+			return true;
+	}
+
+	return false;
+}
 
-	return param;
+
+/**
+* \brief	stateKey
+*
+* returns the name of a state event (value after the last _). state events supersede older ones with the same name,
+* everything else is a command and sent in order. queueList resends the whole queue, so one waiting refresh is enough
+*
+* \param	element	task element
+*
+* \return	name of the state including _, empty for commands
+*/
+std::string const TaskList::stateKey(const std::string & element) {
+	static const char *states[] = { "isplaying_", "playlistPosition_", "samplerate_", "bitrate_", "length_", "title_",
+		"volume_", "progress_", "shuffle_", "repeat_", "clock_", "tick_", "queueList", "coverPreview" };
+
+	for (unsigned int i = 0; i < sizeof(states) / sizeof(states[0]); i++) {
+		if (element.compare(0, strlen(states[i]), states[i]) == 0)
+			return std::string(states[i]);
+	}
+
+	return std::string();
 }
 
+/**
+* \brief	priority
+*
+* returns the priority class of an element. tasks whose order matters for one session share a class: sync,
+* protocol_ and the HTTP responses are all bulk, coverSize_ and coverKnown_ come before the covers they affect
+*
+* \param	element	task element
+*
+* \return	PRIORITY_INTERACTIVE, PRIORITY_METADATA or PRIORITY_BULK
+*/
+int const TaskList::priority(const std::string & element) {
+	static const char *bulk[] = { "cover", "playlist_range_", "audioBlock", "sync", "protocol_", "http_", "httpCover_", "latencyProbe_",
+		"trackCover_" };
+	static const char *metadata[] = { "trackFields_", "rows_", "groups_", "playlist_modified", "titleUpgrade", "queueList", "queueState", "searchPage", "stats", "slowlog", "levels",
+		"coverSize_", "coverKnown_", "tagEdit_", "coverPreview" };
+
+	// before the bulk names, "cover" is a prefix of coverSize_
+	for (unsigned int i = 0; i < sizeof(metadata) / sizeof(metadata[0]); i++) {
+		if (element.compare(0, strlen(metadata[i]), metadata[i]) == 0)
+			return PRIORITY_METADATA;
+	}
+
+	for (unsigned int i = 0; i < sizeof(bulk) / sizeof(bulk[0]); i++) {
+		if (element.compare(0, strlen(bulk[i]), bulk[i]) == 0)
+			return PRIORITY_BULK;
+	}
+
+	return PRIORITY_INTERACTIVE;
+}
+
+/**
+* \brief	topic
+*
+* returns the topic of a broadcast element. sessions that have unsubscribed from it don't get it, see Session::topics
+*
+* \param	element	task element
+*
+* \return	TOPIC_ flag, 0 for the elements every client gets
+*/
+int const TaskList::topic(const std::string & element) {
+	static const char *names[] = { "progress_", "clock_", "tick_", "playlistPosition_", "queueList", "queue_next", "samplerate_",
+		"bitrate_", "length_", "title_", "latencyProbe_" };
+	static const int topics[] = { TOPIC_PROGRESS, TOPIC_PROGRESS, TOPIC_PROGRESS, TOPIC_POSITION, TOPIC_QUEUE, TOPIC_QUEUE, TOPIC_TRACK,
+		TOPIC_TRACK, TOPIC_TRACK, TOPIC_TRACK, TOPIC_TRACK };
+
+	// the cover of a new song and its preview, not coverSize_ and the others
+	if (element.compare("cover") == 0 || element.compare("coverPreview") == 0)
+		return TOPIC_TRACK;
+
+	for (unsigned int i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+		if (element.compare(0, strlen(names[i]), names[i]) == 0)
+			return topics[i];
+	}
+
+	return 0;
+}
+
+/**
+* \brief	isWanted
+*
+* the same test as the send command thread makes before it encodes a broadcast. the queue snapshot has to follow every change
+*
+* \param	task	task to insert
+*
+* \return	false for a broadcast of a topic no session is subscribed to
+*/
+bool const TaskList::isWanted(const Task & task) {
+	return task.session != ALL_SESSIONS || task.topic == 0 || task.topic == TOPIC_QUEUE || sessionlist.isSubscribed(task.topic);
+}
+
+/**
+* \brief	parseTrack
+*
+* \param	element	task element
+* \param	number	receives the playlist position of a trackFields_<number>_<mask> or trackCover_<number>_<mask> task
+* \param	fields	receives the TRACK_FIELD_ mask
+*
+* \return	false for other elements
+*/
+bool const TaskList::parseTrack(const std::string & element, int & number, int & fields) {
+	const char *argument;
+
+	if (element.compare(0, 12, "trackFields_") == 0)
+		argument = element.c_str() + 12;
+	else if (element.compare(0, 11, "trackCover_") == 0)
+		argument = element.c_str() + 11;
+	else
+		return false;
+
+	const char *mask = strchr(argument, '_');
+
+	if (mask == NULL)
+		return false;
+
+	number = atoi(argument);
+	fields = strtol(mask + 1, NULL, 0);
+
+	return true;
+}
+
+/**
+* \brief	isEmpty
+*
+* must be called inside cs_tasklist
+*
+* \return	true if no class has a waiting task
+*/
+bool const TaskList::isEmpty() const {
+	for (int i = 0; i < TASK_PRIORITIES; i++) {
+		if (!lists[i].empty())
+			return false;
+	}
+
+	return true;
+}
+
+/**
+* \brief	size
+*
+* must be called inside cs_tasklist
+*
+* \return	number of waiting tasks of all classes
+*/
+unsigned int const TaskList::size() const {
+	unsigned int count = 0;
+
+	for (int i = 0; i < TASK_PRIORITIES; i++)
+		count += lists[i].size();
+
+	return count;
+}
+
+/**
+* \brief	insert
+*
+* appends a task to the queue of its class. a waiting state event of the same name and session is dropped, so only
+* the latest value is sent. a new clock_ drops the waiting tick_ as well, it is relative to the old clock. must be
+* called inside cs_tasklist
+*
+* \param	task	task to insert
+*/
+void TaskList::insert(const Task & task) {
+	std::deque<Task> & list = lists[task.priority];
+
+	if (!task.key.empty()) {
+		bool clock = task.key == "clock_";
+
+		// there is at most one of each
+		std::deque<Task>::iterator it = list.begin();
+
+		while (it != list.end()) {
+			if (it->session == task.session && (it->key == task.key || (clock && it->key == "tick_"))) {
+				MemoryTag::add(MEMORY_TASKS, -(LONG)it->size());
+				it = list.erase(it);
+			} else
+				it++;
+		}
+	}
+
+	list.push_back(task);
+	list.back().queued = metrics.now();
+
+	MemoryTag::add(MEMORY_TASKS, task.size());
+}
+
+/**
+* \brief	enqueue
+*
+* inserts a task. a broadcast of a topic no session is subscribed to is dropped here, it doesn't wake
+* the send command thread
+*
+* \param	task	task to insert
+*/
+void TaskList::enqueue(const Task & task) {
+	if (!isWanted(task))
+		return;
+
+	LONGLONG start = metrics.now();
 
-void TaskList::setParameter(const int & param) {
 	// CRITICAL
-	EnterCriticalSection(&cs_parameter);
-	
-	parameter = param;
+	EnterCriticalSection(&cs_tasklist);
 
-	LeaveCriticalSection(&cs_parameter);
+	bool wake = isEmpty();
+
+	insert(task);
+
+	tracer.record("enqueue", TRACE_INSTANT, size());
+
+	LeaveCriticalSection(&cs_tasklist);
 	// CRITICAL END
+
+	// a non empty list is already signalled, see pop
+	if (wake)
+		SetEvent(non_empty_list);
+
+	// the producer's share: waiting for the lock, inserting and signalling
+	metrics.enqueueTime.record(metrics.now() - start);
 }
 
 /**
-* \brief	pop
+* \brief	enqueue
 *
-* takes the first inserted element out of queue (BLOCKING!)
+* inserts several tasks with one lock and at most one wakeup of the send command thread
 *
-* \return	taken element
+* \param	tasks	tasks to insert in order
 */
-std::string const TaskList::pop() {
-	WaitForSingleObject(non_empty_list, INFINITE);
+void TaskList::enqueue(const std::vector<Task> & tasks) {
+	LONGLONG start = metrics.now();
+
+	// outside of the lock, isWanted takes the one of the session list
+	std::vector<const Task*> wanted;
+
+	for (unsigned int i = 0; i < tasks.size(); i++) {
+		if (isWanted(tasks[i]))
+			wanted.push_back(&tasks[i]);
+	}
 
 	// CRITICAL
 	EnterCriticalSection(&cs_tasklist);
 
-	std::string element = list.front();
-	list.pop();
+	bool wake = isEmpty();
 
-	if (!list.empty())
-		SetEvent(non_empty_list);
+	for (unsigned int i = 0; i < wanted.size(); i++)
+		insert(*wanted[i]);
+
+	tracer.record("enqueue", TRACE_INSTANT, size());
 
 	LeaveCriticalSection(&cs_tasklist);
 	// CRITICAL END
 
-	return element;
-}
+	if (wake && !wanted.empty())
+		SetEvent(non_empty_list);
 
+	metrics.enqueueTime.record(metrics.now() - start);
+}
 
 /**
-* \brief	push
+* \brief	enqueueTrack
 *
-* inserts new element into queue relating to input parameter
+* inserts a trackFields_ request or the trackCover_ part that follows it. the requests of a session are single
+* flight per track: a request for a track that is already waiting adds its fields to the waiting one, a request for
+* another track drops the waiting parts of the older one, the client has moved on. a cover part is dropped if a
+* request for another track is waiting
 *
-* \param	value for element to be added
+* \param	task	task to insert
 */
-void TaskList::push(const std::string & element, const int & number) {
+void TaskList::enqueueTrack(const Task & task) {
+	int number, fields;
 
-	if (element.compare("new_song_") == 0) {
+	if (!parseTrack(task.element, number, fields))
+		return;
 
-		/////////////////////////////// read file information ////////////////////////////////////
-		const char* file = (char*)SendMessage(plugin.hwndParent,WM_WA_IPC,SendMessage(plugin.hwndParent,WM_WA_IPC,0,IPC_GETLISTPOS),IPC_GETPLAYLISTFILE);
+	bool request = task.element.compare(0, 12, "trackFields_") == 0;
+	std::string kind = request ? "trackFields_" : "trackCover_";
 
-		TagLib::FileRef f(file);
+	LONGLONG start = metrics.now();
+	bool merged = false, dropped = false;
+	LONG cancelled = 0;
 
-		/////////////////////////////// isPlaying ////////////////////////////////////
+	// CRITICAL
+	EnterCriticalSection(&cs_tasklist);
 
-		int isplaying = SendMessage(plugin.hwndParent, WM_WA_IPC, 0, IPC_ISPLAYING);
+	bool wake = isEmpty();
 
-		stringstream isplayingStream;
-		isplayingStream << "isplaying_";
-		isplayingStream << isplaying;
-		
-		// CRITICAL
-		EnterCriticalSection(&cs_tasklist);
-		
-		list.push(isplayingStream.str().c_str());
-		
-		LeaveCriticalSection(&cs_tasklist);
-		// CRITICAL END
+	for (int i = 0; i < TASK_PRIORITIES && !dropped; i++) {
+		std::deque<Task>::iterator it = lists[i].begin();
 
+		while (it != lists[i].end()) {
+			int waitingNumber, waitingFields;
 
-		SetEvent(non_empty_list);
+			if (it->session != task.session || !parseTrack(it->element, waitingNumber, waitingFields)) {
+				it++;
+			} else if (waitingNumber != number && request) {
+				MemoryTag::add(MEMORY_TASKS, -(LONG)it->size());
+				it = lists[i].erase(it);
+				cancelled++;
+			} else if (waitingNumber != number) {
+				// a newer request is waiting, the cover of this track isn't wanted anymore
+				if (it->element.compare(0, 12, "trackFields_") == 0) {
+					dropped = true;
 
+					break;
+				}
 
-		/////////////////////////////////// PLAYLIST POSITION ///////////////////////////////////////
+				it++;
+			} else {
+				if (it->element.compare(0, kind.length(), kind) == 0 && !merged) {
+					stringstream element;
+					element << kind << number << "_" << (waitingFields | fields);
 
-		int playlistPosition = SendMessage(plugin.hwndParent,WM_WA_IPC,0,IPC_GETLISTPOS);
+					MemoryTag::add(MEMORY_TASKS, (LONG)element.str().length() - (LONG)it->element.length());
 
-		stringstream playlistPositionStream;
-		playlistPositionStream << "playlistPosition_";
-		playlistPositionStream << playlistPosition;
-		
-		// CRITICAL
-		EnterCriticalSection(&cs_tasklist);
+					it->element = element.str();
+					merged = true;
+				}
+
+				it++;
+			}
+		}
+	}
 
-		list.push(playlistPositionStream.str().c_str());
+	if (!merged && !dropped)
+		insert(task);
 
-		// CRITICAL END
-		LeaveCriticalSection(&cs_tasklist);
+	tracer.record("enqueue", TRACE_INSTANT, size());
+
+	LeaveCriticalSection(&cs_tasklist);
+	// CRITICAL END
 
+	if (wake && !merged && !dropped)
 		SetEvent(non_empty_list);
 
-		/////////////////////////////// SAMPLERATE ////////////////////////////////////
-		int samplerate;
+	if (merged)
+		InterlockedIncrement(&metrics.trackRequestsMerged);
 
-		try {
-			samplerate = f.audioProperties()->sampleRate();
-		} catch (...) {
-			samplerate = SendMessage(plugin.hwndParent,WM_WA_IPC,5,IPC_GETINFO);
-		}
+	InterlockedExchangeAdd(&metrics.trackPartsCancelled, cancelled + (dropped ? 1 : 0));
 
-		stringstream samplerateStream;
-		samplerateStream << "samplerate_";
-		samplerateStream << samplerate;
+	metrics.enqueueTime.record(metrics.now() - start);
+}
 
-		// CRITICAL
-		EnterCriticalSection(&cs_tasklist);
+/**
+* \brief	requeue
+*
+* inserts tasks of one session before the waiting ones of their class, in order. used for the bulk tasks that have
+* been paused, they are older than the waiting ones
+*
+* \param	elements	task elements
+* \param	session		id of the receiving session
+*/
+void TaskList::requeue(const std::vector<std::string> & elements, const int & session) {
+	if (elements.empty())
+		return;
 
-		list.push(samplerateStream.str().c_str());
+	// CRITICAL
+	EnterCriticalSection(&cs_tasklist);
 
-		// CRITICAL END
-		LeaveCriticalSection(&cs_tasklist);
+	bool wake = isEmpty();
 
-		SetEvent(non_empty_list);
+	for (unsigned int i = elements.size(); i > 0; i--) {
+		Task task(elements[i - 1], session);
+		task.queued = metrics.now();
 
+		lists[task.priority].push_front(task);
 
-		/////////////////////////////// BITRATE ////////////////////////////////////
-		int bitrate;
+		MemoryTag::add(MEMORY_TASKS, task.size());
+	}
 
-		try {
-			bitrate = f.audioProperties()->bitrate();
-		} catch (...) {
-			bitrate = SendMessage(plugin.hwndParent,WM_WA_IPC,1,IPC_GETINFO);
-		}
+	tracer.record("enqueue", TRACE_INSTANT, size());
 
-		stringstream bitrateStream;
-		bitrateStream << "bitrate_";
-		bitrateStream << bitrate;
+	LeaveCriticalSection(&cs_tasklist);
+	// CRITICAL END
 
-		// CRITICAL
-		EnterCriticalSection(&cs_tasklist);
+	if (wake)
+		SetEvent(non_empty_list);
+}
 
-		list.push(bitrateStream.str().c_str());
-		
-		// CRITICAL END
-		LeaveCriticalSection(&cs_tasklist);
+/**
+* \brief	enqueueMetadata
+*
+* inserts the file information of a song unless another song has started since it was requested
+*
+* \param	tasks		tasks to insert
+* \param	generation	song generation of the request
+*/
+void TaskList::enqueueMetadata(const std::vector<Task> & tasks, const LONG & generation) {
+	// CRITICAL
+	EnterCriticalSection(&cs_tasklist);
+
+	bool current = generation == metadataGeneration;
+	bool wake = current && isEmpty();
 
+	if (current) {
+		for (unsigned int i = 0; i < tasks.size(); i++)
+			insert(tasks[i]);
+
+		tracer.record("enqueue", TRACE_INSTANT, size());
+	}
+
+	LeaveCriticalSection(&cs_tasklist);
+	// CRITICAL END
+
+	if (wake)
 		SetEvent(non_empty_list);
+}
+
+/**
+* \brief	requestMetadata
+*
+* has the file information of a playlist entry read by a worker of the work pool
+*
+* \param	position	playlist position
+* \param	session		receiving session, ALL_SESSIONS for a broadcast
+* \param	generation	song generation of the request, see enqueueMetadata
+* \param	happened	Metrics::now of the song change, 0 if the request isn't for one
+*/
+void TaskList::requestMetadata(const int & position, const int & session, const LONG & generation, const LONGLONG & happened) {
+	MetadataRequest *request = new MetadataRequest;
+	request->tasklist = this;
+	request->position = position;
+	request->session = session;
+	request->generation = generation;
+	request->happened = happened;
+
+	if (!workpool.submit(readMetadata, request))
+		readMetadata(request);	// no worker available
+}
 
-		/////////////////////////////// LENGTH ////////////////////////////////////
-		int length;
+/**
+* \brief	readMetadata
+*
+* reads the file information of a new song with TagLib and inserts it into the queue. runs on a worker of the thread pool,
+* the result is dropped if another song has started in the meantime
+*
+* \param	parameter	MetadataRequest, deleted when done
+*
+* \return	0
+*/
+DWORD WINAPI TaskList::readMetadata(LPVOID parameter) {
+	MetadataRequest *request = (MetadataRequest*)parameter;
 
-		try {
-			length = f.audioProperties()->length();
-		} catch (...) {
-			length = SendMessage(plugin.hwndParent,WM_WA_IPC,1,IPC_GETOUTPUTTIME);
-		}
+	const int & session = request->session;
 
-		stringstream lengthStream;
-		lengthStream << "length_";
-		lengthStream << length;
+	std::vector<Task> tasks;
 
-		// CRITICAL
-		EnterCriticalSection(&cs_tasklist);
+	/////////////////////////////// read file information ////////////////////////////////////
 
-		list.push(lengthStream.str().c_str());
+	// parsed once, the cover task finds the picture in the cache
+	Metadata *metadata = metadatacache.getTrack(request->position);
 
-		// CRITICAL END
-		LeaveCriticalSection(&cs_tasklist);
+	/////////////////////////////// SAMPLERATE ////////////////////////////////////
+	int samplerate = metadata->samplerate >= 0 ? metadata->samplerate : SendMessage(plugin.hwndParent,WM_WA_IPC,5,IPC_GETINFO);
 
-		SetEvent(non_empty_list);
+	stringstream samplerateStream;
+	samplerateStream << "samplerate_";
+	samplerateStream << samplerate;
+
+	tasks.push_back(Task(samplerateStream.str().c_str(), session));
+
+
+	/////////////////////////////// BITRATE ////////////////////////////////////
+	int bitrate = metadata->bitrate >= 0 ? metadata->bitrate : SendMessage(plugin.hwndParent,WM_WA_IPC,1,IPC_GETINFO);
+
+	stringstream bitrateStream;
+	bitrateStream << "bitrate_";
+	bitrateStream << bitrate;
+
+	tasks.push_back(Task(bitrateStream.str().c_str(), session));
+
+	/////////////////////////////// LENGTH ////////////////////////////////////
+	int length = metadata->length >= 0 ? metadata->length : SendMessage(plugin.hwndParent,WM_WA_IPC,1,IPC_GETOUTPUTTIME);
 
-		/////////////////////////////// TITLE ////////////////////////////////////
+	metadata->release();
 
+	stringstream lengthStream;
+	lengthStream << "length_";
+	lengthStream << length;
+
+	tasks.push_back(Task(lengthStream.str().c_str(), session));
+
+	/////////////////////////////// TITLE ////////////////////////////////////
+
+	std::string title_str = "title_";
+
+	// encoded once by the playlist snapshot unless the playlist has changed since
+	if (!playlistsnapshot.appendTitle(request->position, title_str)) {
 		wchar_t *title_wchar_t;
-		title_wchar_t = (wchar_t*)SendMessageA(plugin.hwndParent,WM_USER, playlistPosition, IPC_GETPLAYLISTTITLEW);
+		title_wchar_t = (wchar_t*)SendMessageA(plugin.hwndParent,WM_USER, request->position, IPC_GETPLAYLISTTITLEW);
 
-		std::string title_str = "title_";
-		title_str += utf8_encode(title_wchar_t);
+		if (title_wchar_t != NULL)
+			utf8_append(title_str, title_wchar_t, wcslen(title_wchar_t));
+	}
 
-		// CRITICAL
-		EnterCriticalSection(&cs_tasklist);
+	tasks.push_back(Task(title_str.c_str(), session));
 
-		list.push(title_str.c_str());
+	/////////////////////////////// COVER ////////////////////////////////////
 
-		// CRITICAL END
-		LeaveCriticalSection(&cs_tasklist);
+	// the preview goes ahead of the queued bulk tasks, the picture follows them
+	tasks.push_back(Task("coverPreview", session));
+	tasks.push_back(Task("cover", session));
 
-		SetEvent(non_empty_list);
+	// behind the cover, the clients echo it once they have shown the song
+	if (request->happened != 0)
+		tasks.push_back(Task(LatencyProbes::element(request->happened, request->position), session));
 
-		/////////////////////////////// COVER ////////////////////////////////////
+	//////////////////////////////////////////////////////////////////////////
 
-		// CRITICAL
-		EnterCriticalSection(&cs_tasklist);
+	request->tasklist->enqueueMetadata(tasks, request->generation);
 
-		list.push("cover");
+	delete request;
 
-		// CRITICAL END
-		LeaveCriticalSection(&cs_tasklist);
+	return 0;
+}
 
-		SetEvent(non_empty_list);
+/**
+* \brief	push
+*
+* inserts new element into queue relating to input parameter
+*
+* \param	value for element to be added
+* \param	number parameter of the element
+* \param	session id of the session the element is sent to, ALL_SESSIONS for a broadcast
+* \param	origin	session whose command has caused a state event, see commandOrigin
+*/
+void TaskList::push(const std::string & element, const int & number, const int & session, const int & origin) {
+
+	if (element.compare("new_song_") == 0) {
+		// only cheap IPC calls here, this runs in the window procedure of winamp
+		std::vector<Task> tasks;
 
-		//////////////////////////////////////////////////////////////////////////
+		LONGLONG happened = metrics.now();
 
+		/////////////////////////////// isPlaying ////////////////////////////////////
+
+		int isplaying = winampstate.getIsPlaying();
+
+		stringstream isplayingStream;
+		isplayingStream << "isplaying_";
+		isplayingStream << isplaying;
+		
+		tasks.push_back(Task(isplayingStream.str().c_str(), session));
+
+
+		/////////////////////////////////// PLAYLIST POSITION ///////////////////////////////////////
+
+		int playlistPosition = winampstate.getListPosition();
+
+		stringstream playlistPositionStream;
+		playlistPositionStream << "playlistPosition_";
+		playlistPositionStream << playlistPosition;
+		
+		tasks.push_back(Task(playlistPositionStream.str().c_str(), session));
+
+		enqueue(tasks);
+
+		/////////////////////////////// FILE INFORMATION ////////////////////////////////////
+
+		// read by a worker of the thread pool
+		requestMetadata(playlistPosition, session, InterlockedIncrement(&metadataGeneration), happened);
+	}
+	else if (element.compare("trackState") == 0) {
+		// file information of the current song for a session that subscribes to it again. a song change still drops it
+		requestMetadata(winampstate.getListPosition(), session, metadataGeneration);
 	}
 	else if (element.compare("volume_") == 0) {
 		
-		// volume is read in MainWndProc hook!
+		// volume is mirrored by the MainWndProc hook!
 
 		// VOLUME
 		stringstream information;
 		information << "volume_";
-		information << volume;
+		information << winampstate.getVolume();
 		
-		// CRITICAL
-		EnterCriticalSection(&cs_tasklist);
-
-		list.push(information.str().c_str());
-
-		// CRITICAL END
-		LeaveCriticalSection(&cs_tasklist);
-
-		SetEvent(non_empty_list);
+		enqueue(Task(information.str().c_str(), session, origin));
 	}
 	else if (element.compare("progress_") == 0) {
 		
 		// GET PROGRESS
 		stringstream information;
 		information << "progress_";
-		information << progress;
-
-		// CRITICAL
-		EnterCriticalSection(&cs_tasklist);
-
-		list.push(information.str().c_str());
-
-		// CRITICAL END
-		LeaveCriticalSection(&cs_tasklist);
-
-		SetEvent(non_empty_list);
-	} else if (element.compare("track_info") == 0) {
-		// CRITICAL
-		EnterCriticalSection(&cs_tasklist);
-
-		setParameter(number);
-		list.push("track_info");
-
-		// CRITICAL END
-		LeaveCriticalSection(&cs_tasklist);
+		information << winampstate.getPosition();
 
-		SetEvent(non_empty_list);
+		enqueue(Task(information.str().c_str(), session, origin));
+	} else if (element.compare(0, 12, "trackFields_") == 0 || element.compare(0, 11, "trackCover_") == 0) {
+		enqueueTrack(Task(element, session));
 	} else {
-		// CRITICAL
-		EnterCriticalSection(&cs_tasklist);
-
-		list.push(element);
-
-		// CRITICAL END
-		LeaveCriticalSection(&cs_tasklist);
-
-		SetEvent(non_empty_list);
+		enqueue(Task(element, session, origin));
 	}
 }
\ No newline at end of file
@@ -1,27 +1,90 @@
 #pragma once
 #include "stdafx.h"
 
+// priority classes of the tasks, a class is only sent when the ones before it are empty
+#define PRIORITY_INTERACTIVE 0	// state events and short commands
+#define PRIORITY_METADATA 1		// file information, playlist changes, search pages
+#define PRIORITY_BULK 2			// covers, playlist windows, audio, synchronization and HTTP responses
+
+#define TASK_PRIORITIES 3
+
+
+// one element of the tasklist: command and the session it is sent to
+struct Task {
+	Task(const std::string & element, const int & session, const int & origin = 0);
+
+	unsigned int const size() const;
+
+	std::string element;
+	int session;
+
+	// name of a state event, empty for commands
+	std::string key;
+
+	// class of the element, see TaskList::priority
+	int priority;
+
+	// TOPIC_ flag of a broadcast, see TaskList::topic
+	int topic;
+
+	// session whose id_ command has caused a broadcast state event, it doesn't get its own change back. 0 for others
+	int origin;
+
+	// microseconds of Metrics::now when the task was inserted, 0 before
+	LONGLONG queued;
+};
+
+
+class TaskList;
+
+// playlist entry whose file information is read by a worker
+struct MetadataRequest {
+	TaskList *tasklist;
+	int position;
+	int session;
+	LONG generation;
+
+	// Metrics::now of the song change, 0 if the request isn't for one
+	LONGLONG happened;
+};
 
 
 class TaskList {
 	private: 
-		std::queue<std::string> list;
-		volatile int parameter;
+		// one FIFO queue per priority class
+		std::deque<Task> lists[TASK_PRIORITIES];
 
 		HANDLE non_empty_list;
 
 		// critical tasklist section
 		CRITICAL_SECTION cs_tasklist;
-		CRITICAL_SECTION cs_parameter;
+
+		// incremented on every song change, results of older requests are dropped
+		volatile LONG metadataGeneration;
+
+		void insert(const Task & task);
+		bool const isEmpty() const;
+		static bool const isWanted(const Task & task);
+		static bool const parseTrack(const std::string & element, int & number, int & fields);
+		unsigned int const size() const;
+		void enqueue(const Task & task);
+		void enqueue(const std::vector<Task> & tasks);
+		void enqueueTrack(const Task & task);
+		void enqueueMetadata(const std::vector<Task> & tasks, const LONG & generation);
+		void requestMetadata(const int & position, const int & session, const LONG & generation, const LONGLONG & happened = 0);
+
+		static DWORD WINAPI readMetadata(LPVOID parameter);
 	public:	
 		TaskList();
 
 		~TaskList();
 
 
-		std::string const pop();
-		void push(const std::string & element, const int & number = -1);
+		static std::string const stateKey(const std::string & element);
+		static int const priority(const std::string & element);
+		static int const topic(const std::string & element);
 
-		const int getParameter();
-		void setParameter(const int & param);
+		bool const pop(Task & task, HANDLE stop);
+		void push(const std::string & element, const int & number = -1, const int & session = ALL_SESSIONS, const int & origin = 0);
+		void requeue(const std::vector<std::string> & elements, const int & session);
 };
\ No newline at end of file
@@ -2,290 +2,999 @@
 
 
 // thread handles
-volatile HANDLE waitingForClientThread;
-volatile HANDLE keepAliveMessagesThread;
-volatile HANDLE waitingForCommandThread;
+volatile HANDLE networkThread;
 volatile HANDLE sendCommandThread;
 
+HANDLE volatile keepAliveTimer = NULL;
+
+volatile HANDLE serverStopEvent = NULL;
+
 
 /**
-* \brief	waitingForClient
+* \brief	joinThread
+*
+* waits until a thread has returned and closes its handle. messages sent to the calling thread are handled
+* while waiting, so a thread that calls SendMessage to winamp can finish when the main window waits for it
 *
-* waits for a client to connect. is successful, starts synchronization and waitingForCommand, keepAliveMessages threads and enables MainWndProc hook
+* \param	thread	thread handle, set to NULL if the thread has returned
+* \param	timeout	maximum milliseconds to wait
 *
+* \return	1 if the thread is still running, 0 if success
 */
-DWORD WINAPI waitingForClientFunction(LPVOID parameter) {
-	if ((c = accept(s, NULL, NULL)) == -1 && connecting == true) {	// if "connecting" is false then waiting for client has been aborted
-		
-		////////////////////////////////////////// UI ///////////////////////////////////////////////////////
-		UIManager::addLogText("Could not accept client\r\n");
-		UIManager::setStatusText("Disconnected");
-		UIManager::setButtonText("Start server");
-		/////////////////////////////////////////////////////////////////////////////////////////////////////
-
-		connecting = false;
-		
-		return -1;
-	}
-	
-	// synchronize, then start waiting for commands
+int const joinThread(volatile HANDLE & thread, const DWORD & timeout) {
+	HANDLE handle = thread;
 
-	UIManager::addLogText("Connected\r\n");
+	if (handle == NULL)
+		return 0;
 
+	DWORD start = GetTickCount();
+	DWORD elapsed = 0;
 
-	if (synchronize() == 0) {
-		////////////////////////////////////////// UI ///////////////////////////////////////////////////////
-		UIManager::setStatusText("Connected");
-		UIManager::setButtonText("Disconnect");
-		/////////////////////////////////////////////////////////////////////////////////////////////////////
-		
-		if (keepalivemessages == 1)
-			keepAliveMessagesThread = CreateThread(NULL, 0, keepAliveMessagesFunction, 0, 0, NULL);
+	while (elapsed < timeout) {
+		DWORD result = MsgWaitForMultipleObjects(1, &handle, FALSE, timeout - elapsed, QS_SENDMESSAGE);
 
-        waitingForCommandThread = CreateThread(NULL, 0, waitingForCommandFunction, 0, 0, NULL);
-        sendCommandThread = CreateThread(NULL, 0, sendCommandFunction, 0, 0, NULL);
+		if (result == WAIT_OBJECT_0) {
+			CloseHandle(handle);
+			thread = NULL;
 
-		// enable MainWndProc callback hook
-		if (IsWindowUnicode(plugin.hwndParent)) {
-			lpWndProcOld = (WNDPROC)SetWindowLongPtrW(plugin.hwndParent,GWLP_WNDPROC,(LONG)MainWndProc);
-		} else {
-			lpWndProcOld = (WNDPROC)SetWindowLongPtrA(plugin.hwndParent,GWLP_WNDPROC,(LONG)MainWndProc);
+			return 0;
 		}
 
-		connected = true;
+		if (result != WAIT_OBJECT_0 + 1)
+			break;
 
-	} else {
-		UIManager::setStatusText("Disconnected");
-		UIManager::setButtonText("Start server");
+		// handles the sent messages
+		MSG msg;
+		PeekMessage(&msg, NULL, 0, 0, PM_NOREMOVE);
+
+		elapsed = GetTickCount() - start;
 	}
 
-	connecting = false;
+	return 1;
+}
+
 
-	return 0;
+/**
+* \brief	registeredCompleted
+*
+* handles one completion of a session with Registered I/O like the completion port ones: a receive is performed and
+* the next one started, a send continues with the rest of the queues
+*
+* \param	result	completion taken from the completion queue
+*/
+static void registeredCompleted(const RIORESULT & result) {
+	Session *session = (Session*)result.SocketContext;
+
+	if (result.RequestContext == OPERATION_RECEIVE) {
+		// no bytes: stream closed
+		if (result.Status != 0 || result.BytesTransferred == 0) {
+			closeSession(session, true);
+		} else {
+			session->receiveRegistered(result.BytesTransferred);
+
+			if (session->postReceive() != 0)
+				closeSession(session, true);
+		}
+
+		// reference of the finished receive
+		session->release();
+	} else if (result.Status != 0) {
+		UIManager::addLogText("Could not send data\r\n", LOG_ERROR);
+
+		closeSession(session, true);
+
+		// reference of the finished send
+		session->release();
+	} else
+		session->sendCompleted(result.BytesTransferred);
+}
+
+/**
+* \brief	network
+*
+* waits for completed socket operations of all sessions on the completion port: accepts new clients,
+* performs received commands and continues pending sends. one thread serves every connected client, the sessions
+* with Registered I/O through the packets of their completion queue.
+* returns when stopServer posts the stop packet or closes the completion port.
+*
+*/
+DWORD WINAPI networkFunction(LPVOID parameter) {
+	DWORD bytes;
+	ULONG_PTR key;
+	OVERLAPPED *overlapped;
+
+	ThreadPolicy policy(THREAD_CLASS_INTERACTIVE);
+
+	while (1) {
+		BOOL success = GetQueuedCompletionStatus(iocp, &bytes, &key, &overlapped, INFINITE);
+
+		// stop packet or completion port closed
+		if (overlapped == NULL)
+			return 0;
+
+		IOContext *context = CONTAINING_RECORD(overlapped, IOContext, overlapped);
+
+		if (context->operation == OPERATION_ACCEPT) {
+			acceptCompleted(success == TRUE);
+		} else if (context->operation == OPERATION_RECEIVE) {
+			Session *session = context->session;
+
+			// the zero byte receive tells that the socket has data or has been closed
+			if (success == FALSE || session->receiveReady() != 0) {
+				closeSession(session, true);
+			} else {
+				// get new command
+				if (session->postReceive() != 0)
+					closeSession(session, true);
+			}
+
+			// reference of the finished receive
+			session->release();
+		} else if (context->operation == OPERATION_RIO) {
+			RIORESULT results[RIO_DEQUEUE_SIZE];
+			unsigned int count;
+
+			// the completions of every Registered I/O session in batches, then the next packet is requested
+			while ((count = RioChannel::dequeue(results)) > 0) {
+				for (unsigned int i = 0; i < count; i++)
+					registeredCompleted(results[i]);
+			}
+
+			RioChannel::notify();
+		} else if (context->operation == OPERATION_SEND) {
+			Session *session = context->session;
+
+			if (success == FALSE) {
+				UIManager::addLogText("Could not send data\r\n", LOG_ERROR);
+
+				closeSession(session, true);
+
+				// reference of the finished send
+				session->release();
+			} else
+				session->sendCompleted(bytes);
+		}
+	}
 }
 
 /**
 * \brief	sendCommand
 *
-* waits for elements to be inserted into tasklist queue, extracts them and sends these commands to the app. every call to rawSend must come from this thread!
+* waits for elements to be inserted into tasklist queue, extracts them and sends these commands to the sessions they belong to.
+* every call to rawSend must come from this thread! the output of one task is flushed at once.
+* returns when the stop event passed as parameter is set
 *
 */
 DWORD WINAPI sendCommandFunction(LPVOID parameter)
 {
-	std::string element;
-	element = tasklist.pop();
+	HANDLE stop = (HANDLE)parameter;
 
-	while (1) {
-		if (element.compare("") != 0) {
-			if (element.compare("cover") == 0)
+	ThreadPolicy policy(THREAD_CLASS_INTERACTIVE);
+
+	Task task("", ALL_SESSIONS);
+
+	while (tasklist.pop(task, stop)) {
+		TraceSpan span("task", task.session);
+		SlowOperation slow("task", task.element);
+
+		// every rawSend of this task goes to the session of the task
+		sendTarget = task.session;
+		sendTopic = task.session == ALL_SESSIONS ? task.topic : 0;
+		sendState = NULL;
+
+		// an event nobody is subscribed to isn't encoded. the queue snapshot has to follow every change
+		if (sendTopic != 0 && sendTopic != TOPIC_QUEUE && !sessionlist.isSubscribed(sendTopic))
+			continue;
+
+		// a congested client gets no bulk data until it has caught up, see SEND_HIGH_WATER
+		if (task.session != ALL_SESSIONS && task.priority == PRIORITY_BULK) {
+			Session *session = sessionlist.get(task.session);
+			bool paused = session != NULL && session->pauseTask(task.element);
+
+			if (session != NULL)
+				session->release();
+
+			if (paused)
+				continue;
+		}
+
+		if (task.element.compare("") != 0) {
+			if (task.element.compare("sync") == 0) {
+				// bring the other clients up to date first, the new one starts with the current playlist
+				sendTarget = ALL_SESSIONS;
+
+				playlistsnapshot.sendChanges();
+				queuesnapshot.sendChanges();
+				flushOutput();
+
+				sendTarget = task.session;
+
+				Session *session = sessionlist.get(task.session);
+
+				if (session != NULL) {
+					LONGLONG started = metrics.now();
+
+					// a client that comes back within the journal only gets what it has missed
+					int result = resumeSession(session) == 0 ? 0 : synchronize();
+
+					// journal position and playlist fingerprint of the client, older clients ignore them
+					if (result == 0) {
+						rawSend(("session_" + journal.getToken()).c_str());
+						rawSend(playlistsnapshot.getFingerprint().c_str());
+					}
+
+					if (result == 0 && flushOutput() == 0) {
+						session->synchronized = true;
+
+						metrics.syncTime.record(metrics.now() - started);
+
+						// older clients ignore it
+						tasklist.push(winampstate.getClock(), -1, task.session);
+					} else {
+						outputBuffer.clear();
+
+						closeSession(session, true);
+					}
+
+					session->release();
+				}
+
+				updateStatusText();
+			}
+			else if (task.element.compare("protocol_2") == 0 || task.element.compare("protocol_3") == 0) {
+				// confirmation is the last text line, everything after it is framed
+				Session *session = sessionlist.get(task.session);
+
+				if (session != NULL) {
+					rawSend(task.element.c_str());
+					flushOutput();
+
+					session->protocol = task.element[9] == '3' ? PROTOCOL_DEFLATE : PROTOCOL_FRAMED;
+					session->release();
+				}
+			}
+			else if (task.element.compare("relieved") == 0) {
+				// the latest state events a congested client has missed, then its paused bulk tasks
+				Session *session = sessionlist.get(task.session);
+
+				if (session != NULL) {
+					std::vector<std::string> states, paused;
+					session->takeHeld(states, paused);
+
+					for (unsigned int i = 0; i < states.size(); i++) {
+						if (states[i].compare("cover") == 0)
+							sendCover("", -1);
+						else
+							rawSend(states[i].c_str());
+					}
+
+					tasklist.requeue(paused, task.session);
+
+					session->release();
+				}
+			}
+			else if (task.element.compare("cover") == 0)
 				sendCover("", -1);
-			else if (element.compare("track_info") == 0)
-				sendTrackInfo(tasklist.getParameter());
-			else if (element.compare("queueList") == 0)
-				refreshQueueListFunction();
-			else {
-				int result;
+			else if (task.element.compare("coverPreview") == 0)
+				sendCoverPreview();
+			else if (task.element.compare(0, 13, "latencyProbe_") == 0)
+				latencyprobes.send(task.element);
+			else if (task.element.compare(0, 12, "trackFields_") == 0) {
+				const char *number = task.element.c_str() + 12;
+				const char *mask = strchr(number, '_');
+
+				if (mask != NULL)
+					sendTrackInfo(atoi(number), strtol(mask + 1, NULL, 0));
+			}
+			else if (task.element.compare(0, 11, "trackCover_") == 0) {
+				const char *number = task.element.c_str() + 11;
+				const char *mask = strchr(number, '_');
+
+				if (mask != NULL)
+					sendTrackInfoCover(atoi(number), strtol(mask + 1, NULL, 0));
+			}
+			else if (task.element.compare("queueList") == 0)
+				queuesnapshot.sendChanges();
+			else if (task.element.compare("queueState") == 0)
+				queuesnapshot.sendAll();
+			else if (task.element.compare("queue_next") == 0) {
+				queuesnapshot.next();
+
+				rawSend("queue_next");
+			}
+			else if (task.element.compare("playlist_modified") == 0)
+				playlistsnapshot.sendChanges();
+			else if (task.element.compare("titleUpgrade") == 0)
+				playlistsnapshot.upgradeTitles();
+			else if (task.element.compare("stats") == 0)
+				sendStats();
+			else if (task.element.compare("slowlog") == 0)
+				sendSlowLog();
+			else if (task.element.compare(0, 14, "coverPrefetch_") == 0)
+				prefetchCover(atoi(task.element.c_str() + 14));
+			else if (task.element.compare(0, 13, "coverUpgrade_") == 0)
+				sendCoverUpgrade(task.element.c_str() + 13);
+			else if (task.element.compare(0, 10, "coverSize_") == 0) {
+				Session *session = sessionlist.get(task.session);
+
+				if (session != NULL) {
+					setCoverOptions(session, task.element.c_str() + 10);
+					session->release();
+				}
+			}
+			else if (task.element.compare(0, 11, "coverKnown_") == 0) {
+				Session *session = sessionlist.get(task.session);
+
+				if (session != NULL) {
+					addKnownCovers(session, task.element.c_str() + 10);
+					session->release();
+				}
+			}
+			else if (task.element.compare(0, 5, "http_") == 0)
+				sendHttp(task.element.substr(5), NULL, 0, 0);
+			else if (task.element.compare(0, 10, "httpCover_") == 0)
+				sendHttpCover(task.element.c_str() + 10);
+			else if (task.element.compare(0, 8, "tagEdit_") == 0)
+				editTag(task.element.c_str() + 8);
+			else if (task.element.compare("searchPage") == 0)
+				librarysearch.sendPage(task.session);
+			else if (task.element.compare("playlistPage") == 0)
+				playlistbrowser.sendPage(task.session);
+			else if (task.element.compare("audioBlock") == 0)
+				audiostreamer.sendBlock(task.session);
+			else if (task.element.compare("levels") == 0)
+				levelmeter.sendFrame(task.session);
+			else if (task.element.compare(0, 7, "covers_") == 0) {
+				const char *range = task.element.c_str() + 7;
+				const char *count = strchr(range, '_');
+				const char *size = count != NULL ? strchr(count + 1, '_') : NULL;
+				const char *format = size != NULL ? strchr(size + 1, '_') : NULL;
+
+				if (size != NULL)
+					sendCoverRows(atoi(range), atoi(count + 1), atoi(size + 1), format != NULL ? atoi(format + 1) : THUMBNAIL_JPEG);
+			}
+			else if (task.element.compare(0, 5, "rows_") == 0) {
+				const char *range = task.element.c_str() + 5;
+				const char *count = strchr(range, '_');
+				const char *fields = count != NULL ? strchr(count + 1, '_') : NULL;
 
-				element += "\n";
+				if (fields != NULL)
+					sendRows(atoi(range), atoi(count + 1), strtol(fields + 1, NULL, 0));
+			}
+			else if (task.element.compare(0, 7, "groups_") == 0) {
+				const char *mode = task.element.c_str() + 7;
+				const char *range = strchr(mode, '_');
+				const char *count = range != NULL ? strchr(range + 1, '_') : NULL;
 
-				// send
-				result = send(c,element.c_str(),element.length(),0);
+				if (count != NULL)
+					playlistgroups.send(PlaylistGroups::parseMode(mode), atoi(range + 1), atoi(count + 1));
+			}
+			else if (task.element.compare(0, 15, "playlist_range_") == 0) {
+				const char *range = task.element.c_str() + 15;
+				const char *count = strchr(range, '_');
 
-				if (result == -1)
-					UIManager::addLogText("Could not send data\r\n");
+				if (count != NULL)
+					sendPlaylistRange(atoi(range), atoi(count + 1));
 			}
+			else {
+				// state events collapse for congested clients
+				if (task.session == ALL_SESSIONS && !task.key.empty())
+					sendState = &task;
 
+				rawSend(task.element.c_str());
+			}
+
+			// send everything the task has encoded at once
+			flushOutput();
 		}
+	}
+
+	return 0;
+}
+
+
+static void dispatchCommand(Session *session, char *buf);
+
+/**
+* \brief	commands
+*
+* one handler for every command received from a client. the argument is the part after the command name,
+* an empty string for commands without argument
+*/
+static void aliveCommand(Session *session, const char *command, const char *argument) {	// heartbeat received
+	LONG sent = session->aliveSent;
+
+	if (session->alive_delay > 0 && sent != 0) {
+		LONG rtt = (LONG)(GetTickCount() - sent);
+
+		InterlockedExchange(&session->rtt, rtt);
+
+		recordLatency(session->profile, rtt);
+	}
+
+	InterlockedExchange(&session->alive_delay, 0);
+}
+
+static void protocolCommand(Session *session, const char *command, const char *argument) {
+	// framed protocol requested, protocol_2 or protocol_3 for compressed text. only possible before the
+	// synchronization, the first request wins. clients send protocol_3 before protocol_2 for older servers.
+	// WebSocket and HTTP sessions keep their protocol
+	if (session->protocol == PROTOCOL_TEXT && InterlockedCompareExchange(&session->syncScheduled, 1, 0) == 0) {
+		tasklist.push(command, -1, session->id);
+		tasklist.push("sync", -1, session->id);
+	}
+}
+
+static void resumeCommand(Session *session, const char *command, const char *argument) {
+	// resume_<epoch>_<sequence>, sent before the synchronization is scheduled
+	const char *sequence = strrchr(argument, '_');
+
+	if (sequence == NULL || session->syncScheduled != 0)
+		return;
+
+	session->resumeEpoch.assign(argument, sequence - argument);
+	session->resumeSequence = atol(sequence + 1);
+	session->resume = true;
+}
+
+static void destroyCommand(Session *session, const char *command, const char *argument) {
+	// client disconnects
+	closeSession(session, true);
+}
+
+static void previousCommand(Session *session, const char *command, const char *argument) {
+	SendMessageA(plugin.hwndParent, WM_COMMAND, 40044, 0);
+}
+
+static void playCommand(Session *session, const char *command, const char *argument) {
+	SendMessageA(plugin.hwndParent, WM_COMMAND, 40045, 0); 
+}
+
+static void pauseCommand(Session *session, const char *command, const char *argument) {
+	SendMessageA(plugin.hwndParent, WM_COMMAND, 40046, 0);
+}
+
+static void stopCommand(Session *session, const char *command, const char *argument) {
+	SendMessageA(plugin.hwndParent, WM_COMMAND, 40047, 0);
+}
+
+static void nextCommand(Session *session, const char *command, const char *argument) {
+	SendMessageA(plugin.hwndParent, WM_COMMAND, 40048, 0);
+}
+
+static void shuffleCommand(Session *session, const char *command, const char *argument) {
+	SendMessageA(plugin.hwndParent, WM_COMMAND, 40023, 0);
+}
+
+static void repeatCommand(Session *session, const char *command, const char *argument) {
+	SendMessageA(plugin.hwndParent, WM_COMMAND, 40022, 0);
+}
+
+static void muteCommand(Session *session, const char *command, const char *argument) {
+	if (winampstate.getVolume() == 0)	// was already muted
+		SendMessageA(plugin.hwndParent, WM_WA_IPC, volume_last, IPC_SETVOLUME);	// reset volume
+	else {
+		volume_last = winampstate.getVolume();
+
+		SendMessageA(plugin.hwndParent, WM_WA_IPC, 0, IPC_SETVOLUME);	// mute winamp
+	}
+}
+
+static void volumeCommand(Session *session, const char *command, const char *argument) {
+	SendMessageA(plugin.hwndParent, WM_WA_IPC, atoi(argument), IPC_SETVOLUME);
+}
+
+static void progressCommand(Session *session, const char *command, const char *argument) {	// change position within track
+	SendMessage(plugin.hwndParent, WM_WA_IPC, atoi(argument), IPC_JUMPTOTIME);
+}
+
+static void playlistItemCommand(Session *session, const char *command, const char *argument) {	// change played title
+	if (winampstate.getIsPlaying() == 3)	// if paused make sure to continue with selected track
+		SendMessageA(plugin.hwndParent, WM_COMMAND, 40047, 0);
+
+	// set position in playlist
+	SendMessage(plugin.hwndParent, WM_WA_IPC, atoi(argument), IPC_SETPLAYLISTPOS);
+	// play selected title
+	SendMessage(plugin.hwndParent,WM_COMMAND,MAKEWPARAM(40045,0),0);
+}
+
+static void enqueueCommand(Session *session, const char *command, const char *argument) {	// add title to queue
+	WASABI_API_QUEUEMGR->AddItemToQueue(atoi(argument),1,0);
+}
+
+static void remqueueCommand(Session *session, const char *command, const char *argument) {	// remove title from queue
+	WASABI_API_QUEUEMGR->RemoveQueuedItem(atoi(argument));
+}
+
+/**
+* \brief	parseIndices
+*
+* reads the numbers of a batch command argument
+*
+* \param	argument	numbers separated by _
+* \param	indices		receives the numbers
+*/
+static void parseIndices(const char *argument, std::vector<int> & indices) {
+	indices.clear();
+
+	while (*argument != '\0') {
+		char *end;
+		long index = strtol(argument, &end, 10);
 
-		// next element
-		element = tasklist.pop();
+		if (end == argument)
+			break;
+
+		indices.push_back((int)index);
+
+		argument = (*end == '_') ? end + 1 : end;
 	}
 }
 
+static void enqueueListCommand(Session *session, const char *command, const char *argument) {	// add titles to queue in one pass
+	std::vector<int> indices;
+	parseIndices(argument, indices);
+
+	// JTFE updates its queue window only for the last title
+	for (unsigned int i = 0; i < indices.size(); i++)
+		WASABI_API_QUEUEMGR->AddItemToQueue(indices[i], i + 1 == indices.size() ? 1 : 0, 0);
+}
+
+static void remqueueListCommand(Session *session, const char *command, const char *argument) {	// remove titles from queue in one pass
+	std::vector<int> indices;
+	parseIndices(argument, indices);
+
+	// highest queue index first, so the other indices stay valid
+	std::sort(indices.begin(), indices.end());
+	indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+
+	for (int i = indices.size() - 1; i >= 0; i--)
+		WASABI_API_QUEUEMGR->RemoveQueuedItem(indices[i], i == 0 ? 0 : 1);
+}
+
+static void traceCommand(Session *session, const char *command, const char *argument) {	// trace_1 starts, trace_0 writes the trace
+	if (atoi(argument) == 1) {
+		tracer.enable();
+
+		UIManager::addLogText("Tracing started\r\n");
+	} else if (tracer.dump(tracePath) == 0)
+		UIManager::addLogText("Trace written to " + tracePath + "\r\n");
+	else
+		UIManager::addLogText("Could not write trace!\r\n", LOG_ERROR);
+}
+
+static void captureCommand(Session *session, const char *command, const char *argument) {	// capture_1 starts, capture_0 writes the capture
+	if (atoi(argument) == 1) {
+		capture.enable();
+
+		UIManager::addLogText("Capture started\r\n");
+	} else if (capture.dump(capturePath) == 0)
+		UIManager::addLogText("Capture written to " + capturePath + "\r\n");
+	else
+		UIManager::addLogText("Could not write capture!\r\n", LOG_ERROR);
+}
+
+static void sessionTaskCommand(Session *session, const char *command, const char *argument) {
+	// playlist_range_: window of playlist titles, covers_: cover thumbnails of a playlist window, rows_: tag fields of a playlist window, groups_: page of the grouped playlist, coverSize_ and coverKnown_: cover size and cached covers of the client,
+	// stats: counters of the server, slowlog: the slow operations, tagEdit_: changed tag field of a playlist entry
+	tasklist.push(command, -1, session->id);
+}
+
+static void latencyEchoCommand(Session *session, const char *command, const char *argument) {	// song change shown by the client
+	latencyprobes.echo(session, argument);
+}
+
+static void coverLinksCommand(Session *session, const char *command, const char *argument) {	// load covers over HTTP
+	session->coverLinks = true;
+}
+
+static void trackInfoCommand(Session *session, const char *command, const char *argument) {	// show track information
+	// trackInfo_<index>_<mask> sends only the fields of the mask. the request is carried by its own task
+	stringstream element;
+	element << "trackFields_" << argument;
+
+	if (strchr(argument, '_') == NULL)
+		element << "_" << TRACK_FIELDS_ALL;
+
+	tasklist.push(element.str(), -1, session->id);
+}
+
+static void searchCommand(Session *session, const char *command, const char *argument) {	// search the media library
+	librarysearch.search(session->id, argument);
+}
+
+static void findCommand(Session *session, const char *command, const char *argument) {	// search the current playlist
+	librarysearch.find(session->id, argument);
+}
+
+static void browseCommand(Session *session, const char *command, const char *argument) {	// tracks of an artist or album, entries of a playlist file
+	if (strncmp(argument, "playlist_", 9) == 0)
+		playlistbrowser.browse(session->id, argument + 9);
+	else
+		librarysearch.browse(session->id, argument);
+}
+
+static void playlistInsertCommand(Session *session, const char *command, const char *argument) {	// insert files into the playlist
+	playlisteditor.insert(argument);
+}
+
+static void playlistDeleteCommand(Session *session, const char *command, const char *argument) {	// remove a range of the playlist
+	playlisteditor.remove(argument);
+}
+
+static void playlistMoveCommand(Session *session, const char *command, const char *argument) {	// move a range of the playlist
+	playlisteditor.move(argument);
+}
+
+static void playlistSortCommand(Session *session, const char *command, const char *argument) {	// sort a range of the playlist
+	playlisteditor.sort(argument);
+}
+
+static void loadPlaylistCommand(Session *session, const char *command, const char *argument) {	// add a playlist file to winamp
+	playlistbrowser.load(session->id, argument);
+}
+
+static void backgroundCommand(Session *session, const char *command, const char *argument) {	// background_1 when the app is hidden, background_0 when it is shown again
+	LONG background = atoi(argument) == 1 ? 1 : 0;
+
+	// the messages of the time before don't count
+	if (InterlockedExchange(&session->background, background) != background && background == 0)
+		InterlockedExchange(&session->alive_delay, 0);
+
+	updateTimers();
+}
+
+static void weightCommand(Session *session, const char *command, const char *argument) {	// weight_<1-16>, share of the uplink, e.g. lower for a kiosk dashboard
+	LONG weight = atoi(argument);
+
+	InterlockedExchange(&session->weight, max(1, min(weight, SEND_WEIGHT_MAX)));
+}
+
+static void searchCancelCommand(Session *session, const char *command, const char *argument) {
+	librarysearch.cancel(session->id);
+}
+
+static void audioStreamCommand(Session *session, const char *command, const char *argument) {	// listen to a playlist entry on the phone
+	audiostreamer.start(session->id, atoi(argument), session->protocol == PROTOCOL_FRAMED || session->protocol == PROTOCOL_DEFLATE);
+}
+
+static void audioStopCommand(Session *session, const char *command, const char *argument) {
+	audiostreamer.cancel(session->id);
+}
+
+static void levelsCommand(Session *session, const char *command, const char *argument) {	// level meter frames per second, 0 stops them
+	levelmeter.setRate(session->id, atoi(argument));
+}
+
+static void datagramCommand(Session *session, const char *command, const char *argument) {	// fresh state as datagrams, see DatagramChannel
+	tasklist.push(datagramchannel.open(session->id), -1, session->id);
+}
+
+static void idCommand(Session *session, const char *command, const char *argument) {	// id_<id>_<command>, acknowledged before it is performed
+	// the state events the command causes go to the other sessions only, the client has applied them already
+	const char *separator = strchr(argument, '_');
+
+	if (separator == NULL || separator == argument)
+		return;
+
+	tasklist.push("ack_" + std::string(argument, separator - argument), -1, session->id);
+
+	InterlockedIncrement(&metrics.commandsAcknowledged);
+
+	InterlockedExchange(&commandOrigin, session->id);
+
+	// the argument is part of the received buffer
+	dispatchCommand(session, (char*)separator + 1);
+
+	InterlockedExchange(&commandOrigin, 0);
+}
+
+static void bulkCommand(Session *session, const char *command, const char *argument) {	// second connection for covers and audio, sent at the handshake
+	// answered with bulk_<key>, the client connects again and sends bulkBind_<key>. the frames of a WebSocket can't
+	// be split over two connections
+	std::string key = session->web == NULL && session->bulkOwner == 0 ? DatagramChannel::newKey() : std::string();
+
+	session->bulkKey = key;
+
+	tasklist.push(key.empty() ? "bulk_off" : "bulk_" + key, -1, session->id);
+}
+
+static void bulkBindCommand(Session *session, const char *command, const char *argument) {	// first command of a bulk connection
+	// the connection is never synchronized, one with an unknown key is closed. a synchronized session ignores it
+	if (InterlockedCompareExchange(&session->syncScheduled, 1, 0) != 0)
+		return;
+
+	if (sessionlist.bindBulk(argument, session)) {
+		UIManager::addLogText("Bulk connection bound\r\n");
+
+		updateStatusText();
+	} else
+		closeSession(session, false);
+}
 
 /**
-* \brief	waitingForCommand
+* \brief	parseTopics
 *
-* waits commands from the client and performs corresponding winamp-actions. if client has disconnected, 
-* stops the server and restars server if setting is set
+* \param	argument	topic names separated by _: progress, position, queue, track
 *
+* \return	TOPIC_ flags of the names
 */
-DWORD WINAPI waitingForCommandFunction(LPVOID parameter) {
-	char *buf = new char[256];
-    int bytes=1;
+static LONG const parseTopics(const char *argument) {
+	static const char *names[] = { "progress", "position", "queue", "track" };
+	static const LONG topics[] = { TOPIC_PROGRESS, TOPIC_POSITION, TOPIC_QUEUE, TOPIC_TRACK };
+
+	LONG flags = 0;
 
-	// wait for first command
-	bytes = recv(c, buf, 256, 0);
+	while (*argument != '\0') {
+		const char *end = strchr(argument, '_');
+		size_t length = end != NULL ? end - argument : strlen(argument);
 
-	while (bytes > 0) {
-		if (bytes == SOCKET_ERROR) {
-			UIManager::addLogText("Receipt error\r\n");
+		for (unsigned int i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+			if (strncmp(names[i], argument, length) == 0 && names[i][length] == '\0')
+				flags |= topics[i];
+		}
 
-			delete [] buf;
+		argument += end != NULL ? length + 1 : length;
+	}
 
-			////////////////////////////////////////// UI ///////////////////////////////////////////////////////
-			UIManager::setStatusText("Disconnected");
-			UIManager::setButtonText("Start server");
-			/////////////////////////////////////////////////////////////////////////////////////////////////////
+	return flags;
+}
 
-			if (connected == true)
-				stopServer(true);
+static void subscribeCommand(Session *session, const char *command, const char *argument) {	// get the events of topics again
+	LONG requested = parseTopics(argument);
+	LONG topics = requested & ~InterlockedOr(&session->topics, requested);
 
-			if (autorestart == 1)
-				startServer();
+	// the client has missed the changes in the meantime, it gets the current state. queued after the
+	// events of the time it wasn't subscribed, which it doesn't get anymore
+	if (topics & TOPIC_PROGRESS) {
+		tasklist.push(winampstate.getClock(), -1, session->id);
+		tasklist.push("progress_", -1, session->id);
+	}
 
-			return 0;
-		} else {
-			buf[bytes] = '\0'; // securely terminate char*
-
-			if (strcmp(buf, "alive") == 0) {	// heartbeat received
-				// CRITICAL
-				EnterCriticalSection(&cs_alive);
-
-				alive_delay = 0;
-
-				// CRITICAL END
-				LeaveCriticalSection(&cs_alive);
-			} else if (strcmp(buf, "destroy") == 0) {
-				delete[] buf;
-
-				// disable title sending function
-				if( lpWndProcOld )
-					SetWindowLongPtr(plugin.hwndParent, GWL_WNDPROC, (LONG)lpWndProcOld); 
-
-				break;
-			} else if (strcmp(buf, "previous") == 0)
-				SendMessageA(plugin.hwndParent, WM_COMMAND, 40044, 0);
-			else if (strcmp(buf, "play") == 0)
-				SendMessageA(plugin.hwndParent, WM_COMMAND, 40045, 0); 
-			else if (strcmp(buf, "pause") == 0)
-				SendMessageA(plugin.hwndParent, WM_COMMAND, 40046, 0);
-			else if (strcmp(buf, "stop") == 0)
-				SendMessageA(plugin.hwndParent, WM_COMMAND, 40047, 0);
-			else if (strcmp(buf, "next") == 0)
-				SendMessageA(plugin.hwndParent, WM_COMMAND, 40048, 0);
-			else if (strcmp(buf, "shuffle") == 0)
-				SendMessageA(plugin.hwndParent, WM_COMMAND, 40023, 0);
-			else if (strcmp(buf, "repeat") == 0)
-				SendMessageA(plugin.hwndParent, WM_COMMAND, 40022, 0);
-			else if (strcmp(buf, "mute") == 0) {
-				if (SendMessageA(plugin.hwndParent, WM_WA_IPC, -666, IPC_SETVOLUME) == 0)	// was already muted
-					SendMessageA(plugin.hwndParent, WM_WA_IPC, volume_last, IPC_SETVOLUME);	// reset volume
-				else {
-					// CRITICAL
-					EnterCriticalSection(&cs_winamp);
-
-					volume_last = SendMessageA(plugin.hwndParent, WM_WA_IPC, -666, IPC_SETVOLUME);
-
-					// CRITICAL END
-					LeaveCriticalSection(&cs_winamp);
-
-					SendMessageA(plugin.hwndParent, WM_WA_IPC, 0, IPC_SETVOLUME);	// mute winamp
-				}
-			} else if (strstr (buf,"volume_") != NULL) {
-				char *anfang = strstr (buf,"_") + sizeof(char);
+	if (topics & TOPIC_POSITION) {
+		stringstream positionStream;
+		positionStream << "playlistPosition_" << winampstate.getListPosition();
 
-				SendMessageA(plugin.hwndParent, WM_WA_IPC, atoi(anfang), IPC_SETVOLUME);
-			} else if (strstr (buf,"progress_") != NULL) {	// change position within track
-				char *position = strstr (buf,"_") + sizeof(char);
+		tasklist.push(positionStream.str(), -1, session->id);
+	}
 
-				SendMessage(plugin.hwndParent, WM_WA_IPC, atoi(position), IPC_JUMPTOTIME);
-			} else if (strstr (buf,"playlistitem_") != NULL) {	// change played title
-				char *position = strstr (buf,"_") + sizeof(char);
+	if (topics & TOPIC_QUEUE)
+		tasklist.push("queueState", -1, session->id);
 
-				if (SendMessage(plugin.hwndParent,WM_WA_IPC,0,IPC_ISPLAYING) == 3)	// if paused make sure to continue with selected track
-					SendMessageA(plugin.hwndParent, WM_COMMAND, 40047, 0);
+	if (topics & TOPIC_TRACK)
+		tasklist.push("trackState", -1, session->id);
+}
 
-				// set position in playlist
-				SendMessage(plugin.hwndParent, WM_WA_IPC, atoi(position), IPC_SETPLAYLISTPOS);
-				// play selected title
-				SendMessage(plugin.hwndParent,WM_COMMAND,MAKEWPARAM(40045,0),0);
-			} else if (strstr (buf,"enqueue_") != NULL) {	// add title to queue
-				char *position = strstr (buf,"_") + sizeof(char);
+static void unsubscribeCommand(Session *session, const char *command, const char *argument) {	// e.g. no queue events on the overview screen
+	InterlockedAnd(&session->topics, ~parseTopics(argument));
+}
 
-				WASABI_API_QUEUEMGR->AddItemToQueue(atoi(position),1,0);
-			} else if (strstr (buf,"remqueue_") != NULL) {	// remove title from queue
-				char *position = strstr (buf,"_") + sizeof(char);
+static void replayGainCommand(Session *session, const char *command, const char *argument) {	// album gain of a playlist entry
+	replaygainjob.start(session->id, atoi(argument));
+}
 
-				WASABI_API_QUEUEMGR->RemoveQueuedItem(atoi(position));
-			} else if (strstr (buf,"trackInfo_") != NULL) {	// show track information
-				char *position = strstr (buf,"_") + sizeof(char);
+// commands with an argument end with _
+static const Command commands[] = {
+	{ "alive", aliveCommand },
+	{ "protocol_2", protocolCommand },
+	{ "protocol_3", protocolCommand },
+	{ "resume_", resumeCommand },
+	{ "destroy", destroyCommand },
+	{ "previous", previousCommand },
+	{ "play", playCommand },
+	{ "pause", pauseCommand },
+	{ "stop", stopCommand },
+	{ "next", nextCommand },
+	{ "shuffle", shuffleCommand },
+	{ "repeat", repeatCommand },
+	{ "mute", muteCommand },
+	{ "volume_", volumeCommand },
+	{ "progress_", progressCommand },
+	{ "playlistitem_", playlistItemCommand },
+	{ "enqueue_", enqueueCommand },
+	{ "remqueue_", remqueueCommand },
+	{ "enqueueList_", enqueueListCommand },
+	{ "remqueueList_", remqueueListCommand },
+	{ "playlist_range_", sessionTaskCommand },
+	{ "playlist_insert_", playlistInsertCommand },
+	{ "playlist_delete_", playlistDeleteCommand },
+	{ "playlist_move_", playlistMoveCommand },
+	{ "playlist_sort_", playlistSortCommand },
+	{ "covers_", sessionTaskCommand },
+	{ "rows_", sessionTaskCommand },
+	{ "groups_", sessionTaskCommand },
+	{ "coverSize_", sessionTaskCommand },
+	{ "coverKnown_", sessionTaskCommand },
+	{ "coverLinks", coverLinksCommand },
+	{ "stats", sessionTaskCommand },
+	{ "slowlog", sessionTaskCommand },
+	{ "trace_", traceCommand },
+	{ "capture_", captureCommand },
+	{ "trackInfo_", trackInfoCommand },
+	{ "tagEdit_", sessionTaskCommand },
+	{ "search_", searchCommand },
+	{ "find_", findCommand },
+	{ "browse_", browseCommand },
+	{ "searchCancel", searchCancelCommand },
+	{ "load_playlist_", loadPlaylistCommand },
+	{ "audioStream_", audioStreamCommand },
+	{ "audioStop", audioStopCommand },
+	{ "levels_", levelsCommand },
+	{ "datagram", datagramCommand },
+	{ "bulk", bulkCommand },
+	{ "bulkBind_", bulkBindCommand },
+	{ "id_", idCommand },
+	{ "replayGain_", replayGainCommand },
+	{ "subscribe_", subscribeCommand },
+	{ "unsubscribe_", unsubscribeCommand },
+	{ "background_", backgroundCommand },
+	{ "weight_", weightCommand },
+	{ "latencyEcho_", latencyEchoCommand }
+};
+
+// open addressing hash table of the commands, filled on the first command
+static const Command *commandTable[COMMAND_TABLE_SIZE];
+static bool commandTableFilled = false;
 
-				int track = atoi(position);
+/**
+* \brief	commandHash
+*
+* \param	name	command name, not terminated
+* \param	length	length of the name
+*
+* \return	FNV-1a hash of the name
+*/
+static unsigned int const commandHash(const char *name, const size_t & length) {
+	unsigned int hash = 2166136261U;
 
-				tasklist.push("track_info", track);
-			}
+	for (size_t i = 0; i < length; i++) {
+		hash ^= (unsigned char)name[i];
+		hash *= 16777619U;
+	}
 
+	return hash;
+}
+
+/**
+* \brief	findCommand
+*
+* looks up a command name in the hash table
+*
+* \param	name	command name, not terminated
+* \param	length	length of the name
+*
+* \return	command or NULL if unknown
+*/
+static const Command* const findCommand(const char *name, const size_t & length) {
+	if (!commandTableFilled) {
+		for (unsigned int i = 0; i < sizeof(commands) / sizeof(commands[0]); i++) {
+			unsigned int slot = commandHash(commands[i].name, strlen(commands[i].name)) % COMMAND_TABLE_SIZE;
+
+			while (commandTable[slot] != NULL)
+				slot = (slot + 1) % COMMAND_TABLE_SIZE;
+
+			commandTable[slot] = &commands[i];
 		}
 
-		if (buf != NULL)
-			delete [] buf;
-		buf = new char[256];
+		commandTableFilled = true;
+	}
+
+	unsigned int slot = commandHash(name, length) % COMMAND_TABLE_SIZE;
+
+	while (commandTable[slot] != NULL) {
+		if (strncmp(commandTable[slot]->name, name, length) == 0 && commandTable[slot]->name[length] == '\0')
+			return commandTable[slot];
 
-		// get new command
-		bytes = recv(c, buf, 256, 0);
+		slot = (slot + 1) % COMMAND_TABLE_SIZE;
 	}
 
-	// stream closed if bytes == 0
-	
-	delete[] buf;
-	
-	if(connected == true) {
-		stopServer(true);
+	return NULL;
+}
 
-	if (autorestart == 1)
-		startServer();
+/**
+* \brief	performCommand
+*
+* performs the winamp-action that corresponds to a command received from a client, see dispatchCommand. the command is
+* recorded and logged once, also if it is wrapped into id_. only called by the network thread
+*
+* \param	session	session the command was received from
+* \param	buf		null terminated command
+*/
+void performCommand(Session *session, char *buf) {
+	capture.recordCommand(session->id, buf);
+
+	if (LogWriter::enabled(LOG_DEBUG)) {
+		stringstream entry;
+		entry << "session " << session->id << " command " << buf;
+
+		UIManager::addLogText(entry.str(), LOG_DEBUG);
 	}
 
-	return 0;
+	dispatchCommand(session, buf);
 }
 
 /**
-* \brief	keepAliveMessages
+* \brief	dispatchCommand
 *
-* sends keep alive messages to the client to see if it has still connection
+* calls the handler of a command. the command is looked up as a whole first, then by its name up to an _ for commands
+* with an argument
 *
+* \param	session	session the command was received from
+* \param	buf		null terminated command
 */
-DWORD WINAPI keepAliveMessagesFunction(LPVOID parameter) {
-	alive_delay = 0;
+static void dispatchCommand(Session *session, char *buf) {
+	size_t length = strlen(buf);
 
-	while (connected == true) {
-		Sleep(5000);	// wait 5 seconds
+	const Command *command = findCommand(buf, length);
+	const char *argument = buf + length;
 
-		// CRITICAL
-		EnterCriticalSection(&cs_alive);
+	for (const char *separator = strchr(buf, '_'); command == NULL && separator != NULL; separator = strchr(separator + 1, '_')) {
+		argument = separator + 1;
+		command = findCommand(buf, argument - buf);
+	}
 
-		if (alive_delay == 3) {	// if 3 not arrived messages stop server
-			// CRITICAL END
-			LeaveCriticalSection(&cs_alive);
+	if (command != NULL)
+		command->handler(session, buf, argument);
+}
 
-			UIManager::addLogText("Connection lost\r\n\r\n");
+/**
+* \brief	keepAliveTimeout
+*
+* timer callback: sends keep alive messages to all clients to see if they have still connection. one timer serves every
+* session, it fires every keepaliveinterval seconds. sessions that didn't answer keepalivemisses messages are closed,
+* so are the congested ones that haven't completed a send for SEND_STALL_TIMEOUT milliseconds. sessions in the background
+* are skipped, the timer only runs while a session is in the foreground, see updateTimers
+*
+* \param	parameter	not used
+*/
+VOID CALLBACK keepAliveTimeout(PVOID parameter, BOOLEAN timerOrWaitFired) {
+	std::vector<int> ids;
+	LONG misses = keepalivemisses > 0 ? keepalivemisses : 1;
 
-			stopServer(false);
+	sessionlist.getIds(ids);
 
-			if (autorestart == 1)
-				startServer();
+	for (unsigned int i = 0; i < ids.size(); i++) {
+		Session *session = sessionlist.get(ids[i]);
 
-			return 0;
-		}
+		if (session == NULL)	// already disconnected
+			continue;
+
+		if (session->bulkOwner != 0 && !session->isStalled()) {
+			// bulk connection, the keep alive messages go over the connection of its session
+		} else if (session->background != 0) {
+			// may be suspended by its system, the TCP keep alive finds dead peers
+		} else if (session->alive_delay >= misses) {	// not arrived messages
+			UIManager::addLogText("Connection lost\r\n");
+
+			closeSession(session, false);
+		} else if (session->isStalled()) {	// doesn't read its data anymore
+			UIManager::addLogText("Client stopped reading, connection closed\r\n");
 
+			InterlockedIncrement(&metrics.sessionsStalled);
 
-		tasklist.push("alive");
+			closeSession(session, false);
+		} else {
+			// round trip time is measured from the first unanswered message
+			if (session->alive_delay == 0)
+				InterlockedExchange(&session->aliveSent, (LONG)GetTickCount());
+
+			InterlockedIncrement(&session->alive_delay);
 
-		alive_delay++;
+			tasklist.push("alive", -1, session->id);
+		}
 
-		// CRITICAL END
-		LeaveCriticalSection(&cs_alive);
+		session->release();
 	}
 
-	return 0;
+	// shows the round trip times
+	if (connecting == true && !ids.empty())
+		updateStatusText();
 }
 
 
 /**
 * \brief	refreshQueueListsFunction
 *
-* refreshs the whole queue list on the client
+* refreshs the whole queue list on the clients. see QueueSnapshot::sendChanges for single changes
 */
 void refreshQueueListFunction() {
 	/////////////////////////////// QUEUE LIST COUNT ////////////////////////////////////
@@ -297,7 +1006,7 @@ void refreshQueueListFunction() {
 	queueCountStream << queueCount;
 
 	if (rawSend(queueCountStream.str().c_str()) != 0) {
-		UIManager::addLogText("synchronizing queue list failed!\r\n");
+		UIManager::addLogText("synchronizing queue list failed!\r\n", LOG_ERROR);
 
 		return;
 	}
@@ -314,7 +1023,7 @@ void refreshQueueListFunction() {
 		queueElementStream << tmp;
 
 		if (rawSend(queueElementStream.str().c_str()) != 0) {
-			UIManager::addLogText("Synchronizing queue list failed!\r\n");
+			UIManager::addLogText("Synchronizing queue list failed!\r\n", LOG_ERROR);
 
 			return;
 		}
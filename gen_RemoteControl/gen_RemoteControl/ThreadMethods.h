@@ -1,16 +1,35 @@
 #pragma once
 #include "stdafx.h"
 
-extern DWORD WINAPI waitingForClientFunction(LPVOID parameter);
+extern DWORD WINAPI networkFunction(LPVOID parameter);
 extern DWORD WINAPI sendCommandFunction(LPVOID parameter);
-extern DWORD WINAPI waitingForCommandFunction(LPVOID parameter);
-extern DWORD WINAPI keepAliveMessagesFunction(LPVOID parameter);
+extern VOID CALLBACK keepAliveTimeout(PVOID parameter, BOOLEAN timerOrWaitFired);
 
-extern volatile HANDLE waitingForClientThread;
-extern volatile HANDLE keepAliveMessagesThread;
-extern volatile HANDLE waitingForCommandThread;
+// handler of a client command, see performCommand
+struct Command {
+	const char *name;
+	void (*handler)(Session *session, const char *command, const char *argument);
+};
+
+// slots of the command hash table, at least twice the number of commands
+#define COMMAND_TABLE_SIZE 128
+
+extern void performCommand(Session *session, char *buf);
+
+extern volatile HANDLE networkThread;
 extern volatile HANDLE sendCommandThread;
 
+// periodic timer of the keep alive messages, shared by all sessions
+extern HANDLE volatile keepAliveTimer;
+
+// milliseconds stopServer waits for each thread
+#define THREAD_STOP_TIMEOUT 1000
+
+// set by stopServer, the threads of the server return
+extern volatile HANDLE serverStopEvent;
+
+extern int const joinThread(volatile HANDLE & thread, const DWORD & timeout);
+
 extern void refreshQueueListFunction();
 
 extern volatile HANDLE checkForNewVersionThread;
\ No newline at end of file
@@ -0,0 +1,113 @@
+#include "stdafx.h"
+
+
+volatile LONG ThreadPolicy::threads[THREAD_CLASSES] = { 0, 0, 0 };
+volatile LONG ThreadPolicy::mmcssThreads = 0;
+volatile LONG ThreadPolicy::mmcssFailures = 0;
+
+/**
+* \brief	ThreadPolicy
+*
+* constructor, applies a class to the calling thread
+*
+* \param	threadClass	THREAD_CLASS_ of the thread
+*/
+ThreadPolicy::ThreadPolicy(const int & threadClass) : threadClass(threadClass) {
+	applied = THREAD_POLICY_DEFAULT;
+	avrt = NULL;
+	task = NULL;
+
+	InterlockedIncrement(&threads[threadClass]);
+
+	int policy = threadpolicy;
+
+	if (policy == THREAD_POLICY_DEFAULT)
+		return;
+
+	if (threadClass == THREAD_CLASS_INTERACTIVE) {
+		SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_NORMAL);
+	} else if (threadClass == THREAD_CLASS_BACKGROUND) {
+		// low cpu, i/o and memory priority. fails if the thread already is in background mode
+		if (SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN))
+			applied = THREAD_POLICY_BACKGROUND;
+	} else if (threadClass == THREAD_CLASS_AUDIO) {
+		if (policy == THREAD_POLICY_MMCSS && registerTask()) {
+			applied = THREAD_POLICY_MMCSS;
+		} else {
+			// below winamp's own threads
+			SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+
+			applied = THREAD_POLICY_BACKGROUND;
+		}
+	}
+}
+
+/**
+* \brief	~ThreadPolicy
+*
+* destructor, restores the calling thread
+*/
+ThreadPolicy::~ThreadPolicy() {
+	if (applied == THREAD_POLICY_MMCSS) {
+		AvRevertFunction revert = (AvRevertFunction)GetProcAddress(avrt, "AvRevertMmThreadCharacteristics");
+
+		if (revert != NULL)
+			revert(task);
+
+		FreeLibrary(avrt);
+
+		InterlockedDecrement(&mmcssThreads);
+	} else if (applied == THREAD_POLICY_BACKGROUND) {
+		SetThreadPriority(GetCurrentThread(), threadClass == THREAD_CLASS_AUDIO ? THREAD_PRIORITY_NORMAL : THREAD_MODE_BACKGROUND_END);
+	}
+
+	InterlockedDecrement(&threads[threadClass]);
+}
+
+/**
+* \brief	registerTask
+*
+* registers the calling thread as THREAD_MMCSS_TASK task. Windows XP has no MMCSS
+*
+* \return	true if success
+*/
+bool const ThreadPolicy::registerTask() {
+	avrt = LoadLibraryW(L"avrt.dll");
+
+	AvSetFunction set = avrt != NULL ? (AvSetFunction)GetProcAddress(avrt, "AvSetMmThreadCharacteristicsW") : NULL;
+	DWORD taskIndex = 0;
+
+	if (set != NULL)
+		task = set(THREAD_MMCSS_TASK, &taskIndex);
+
+	if (task == NULL) {
+		if (avrt != NULL)
+			FreeLibrary(avrt);
+
+		avrt = NULL;
+
+		InterlockedIncrement(&mmcssFailures);
+
+		return false;
+	}
+
+	InterlockedIncrement(&mmcssThreads);
+
+	return true;
+}
+
+/**
+* \brief	report
+*
+* describes the policy and the running threads of every class for the stats command
+*
+* \param	lines	vector that receives the line
+*/
+void ThreadPolicy::report(std::vector<std::string> & lines) {
+	stringstream line;
+	line << "threads policy " << threadpolicy << " interactive " << threads[THREAD_CLASS_INTERACTIVE] << " background "
+		<< threads[THREAD_CLASS_BACKGROUND] << " audio " << threads[THREAD_CLASS_AUDIO] << " mmcss " << mmcssThreads
+		<< " mmcss_failed " << mmcssFailures;
+
+	lines.push_back(line.str());
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "stdafx.h"
+
+// scheduling classes of the plugin threads
+#define THREAD_CLASS_INTERACTIVE 0
+#define THREAD_CLASS_BACKGROUND 1
+#define THREAD_CLASS_AUDIO 2
+#define THREAD_CLASSES 3
+
+// values of the threadpolicy setting: every thread at normal priority, background threads in background mode
+// and audio threads below normal, or in addition the audio threads registered with MMCSS
+#define THREAD_POLICY_DEFAULT 0
+#define THREAD_POLICY_BACKGROUND 1
+#define THREAD_POLICY_MMCSS 2
+
+// MMCSS task of the audio threads
+#define THREAD_MMCSS_TASK L"Audio"
+
+
+// AvSetMmThreadCharacteristicsW and AvRevertMmThreadCharacteristics of avrt.dll, loaded at run time for Windows XP
+typedef HANDLE (WINAPI *AvSetFunction)(LPCWSTR task, LPDWORD taskIndex);
+typedef BOOL (WINAPI *AvRevertFunction)(HANDLE avrt);
+
+
+// scheduling of the calling thread after the threadpolicy setting: interactive threads run at normal priority,
+// background threads with low cpu, i/o and memory priority so scans and transcodes don't compete with winamp's
+// decoder and output, audio threads as MMCSS "Audio" task. the constructor applies the class, the destructor
+// restores the thread
+class ThreadPolicy {
+	private:
+		int threadClass;
+
+		// applied THREAD_POLICY_, THREAD_POLICY_DEFAULT if the thread hasn't been changed
+		int applied;
+
+		// avrt.dll and the MMCSS task of an audio thread
+		HMODULE avrt;
+		HANDLE task;
+
+		// running threads of every class and the audio threads MMCSS didn't accept
+		static volatile LONG threads[THREAD_CLASSES];
+		static volatile LONG mmcssThreads;
+		static volatile LONG mmcssFailures;
+
+		bool const registerTask();
+
+	public:
+		ThreadPolicy(const int & threadClass);
+
+		~ThreadPolicy();
+
+		static void report(std::vector<std::string> & lines);
+};
@@ -0,0 +1,316 @@
+#include "stdafx.h"
+
+
+CredHandle TlsChannel::credentials;
+bool TlsChannel::available = false;
+
+/**
+* \brief	TlsChannel
+*
+* constructor
+*/
+TlsChannel::TlsChannel() {
+	SecInvalidateHandle(&context);
+
+	established = false;
+	resumed = false;
+
+	ZeroMemory(&sizes, sizeof(sizes));
+}
+
+/**
+* \brief	~TlsChannel
+*
+* destructor
+*/
+TlsChannel::~TlsChannel() {
+	if (SecIsValidHandle(&context))
+		DeleteSecurityContext(&context);
+}
+
+/**
+* \brief	start
+*
+* acquires the server credentials with the certificate TLS_CERTIFICATE_SUBJECT of the personal store once.
+* the protocol versions and ciphers are the ones the system enables, without the weak ones
+*
+* \return	1 if there is no usable certificate, 0 if success
+*/
+int const TlsChannel::start() {
+	if (available)
+		return 0;
+
+	HCERTSTORE store = CertOpenStore(CERT_STORE_PROV_SYSTEM_W, 0, NULL, CERT_SYSTEM_STORE_CURRENT_USER | CERT_STORE_READONLY_FLAG, L"MY");
+
+	if (store == NULL)
+		return 1;
+
+	PCCERT_CONTEXT certificate = CertFindCertificateInStore(store, X509_ASN_ENCODING | PKCS_7_ASN_ENCODING, 0,
+		CERT_FIND_SUBJECT_STR_W, TLS_CERTIFICATE_SUBJECT, NULL);
+
+	if (certificate == NULL) {
+		CertCloseStore(store, 0);
+
+		return 1;
+	}
+
+	SCHANNEL_CRED cred;
+	ZeroMemory(&cred, sizeof(cred));
+
+	cred.dwVersion = SCHANNEL_CRED_VERSION;
+	cred.cCreds = 1;
+	cred.paCred = &certificate;
+	cred.grbitEnabledProtocols = 0;	// system default
+#ifdef SCH_USE_STRONG_CRYPTO
+	cred.dwFlags = SCH_USE_STRONG_CRYPTO;
+#endif
+
+	TimeStamp expiry;
+	SECURITY_STATUS status = AcquireCredentialsHandle(NULL, UNISP_NAME, SECPKG_CRED_INBOUND, NULL, &cred, NULL, NULL, &credentials, &expiry);
+
+	CertFreeCertificateContext(certificate);
+	CertCloseStore(store, 0);
+
+	available = status == SEC_E_OK;
+
+	return available ? 0 : 1;
+}
+
+/**
+* \brief	stop
+*
+* releases the server credentials. called by quit, after every session is gone
+*/
+void TlsChannel::stop() {
+	if (!available)
+		return;
+
+	FreeCredentialsHandle(&credentials);
+
+	available = false;
+}
+
+/**
+* \brief	receive
+*
+* continues the handshake or decrypts the records with the received bytes. an incomplete record is kept
+*
+* \param	data	received bytes
+* \param	length	number of received bytes
+* \param	plain	receives the decrypted data
+* \param	token	receives the handshake messages to send to the client
+*
+* \return	1 if the connection has to be closed, 0 if success
+*/
+int const TlsChannel::receive(const char *data, const unsigned int & length, std::string & plain, std::string & token) {
+	if (input.length() + length > TLS_INPUT_LIMIT)
+		return 1;
+
+	input.append(data, length);
+
+	bool incomplete = false;
+
+	while (!input.empty() && !incomplete) {
+		int result = established ? decrypt(plain, incomplete) : handshake(token, incomplete);
+
+		if (result != 0)
+			return 1;
+	}
+
+	return 0;
+}
+
+/**
+* \brief	handshake
+*
+* hands the received handshake messages to SChannel. the context is established when it returns SEC_E_OK
+*
+* \param	token		receives the handshake messages or the alert to send to the client
+* \param	incomplete	set if more bytes are needed
+*
+* \return	1 if the handshake failed, 0 if success
+*/
+int const TlsChannel::handshake(std::string & token, bool & incomplete) {
+	SecBuffer inBuffers[2];
+	inBuffers[0].BufferType = SECBUFFER_TOKEN;
+	inBuffers[0].pvBuffer = &input[0];
+	inBuffers[0].cbBuffer = input.length();
+	inBuffers[1].BufferType = SECBUFFER_EMPTY;
+	inBuffers[1].pvBuffer = NULL;
+	inBuffers[1].cbBuffer = 0;
+
+	SecBuffer outBuffers[2];
+	outBuffers[0].BufferType = SECBUFFER_TOKEN;
+	outBuffers[0].pvBuffer = NULL;
+	outBuffers[0].cbBuffer = 0;
+	outBuffers[1].BufferType = SECBUFFER_ALERT;
+	outBuffers[1].pvBuffer = NULL;
+	outBuffers[1].cbBuffer = 0;
+
+	SecBufferDesc inDesc = { SECBUFFER_VERSION, 2, inBuffers };
+	SecBufferDesc outDesc = { SECBUFFER_VERSION, 2, outBuffers };
+
+	ULONG attributes = 0;
+	TimeStamp expiry;
+
+	SECURITY_STATUS status = AcceptSecurityContext(&credentials, SecIsValidHandle(&context) ? &context : NULL, &inDesc,
+		TLS_CONTEXT_FLAGS, 0, &context, &outDesc, &attributes, &expiry);
+
+	for (int i = 0; i < 2; i++) {
+		if (outBuffers[i].pvBuffer != NULL) {
+			if (outBuffers[i].BufferType == SECBUFFER_TOKEN)
+				token.append((char*)outBuffers[i].pvBuffer, outBuffers[i].cbBuffer);
+
+			FreeContextBuffer(outBuffers[i].pvBuffer);
+		}
+	}
+
+	if (status == SEC_E_INCOMPLETE_MESSAGE) {
+		incomplete = true;
+
+		return 0;
+	}
+
+	if (status != SEC_E_OK && status != SEC_I_CONTINUE_NEEDED)
+		return 1;
+
+	// bytes after the handshake messages belong to the next ones or to the first record
+	if (inBuffers[1].BufferType == SECBUFFER_EXTRA)
+		input.erase(0, input.length() - inBuffers[1].cbBuffer);
+	else
+		input.clear();
+
+	if (status == SEC_E_OK) {
+		if (QueryContextAttributes(&context, SECPKG_ATTR_STREAM_SIZES, &sizes) != SEC_E_OK)
+			return 1;
+
+		SecPkgContext_SessionInfo info;
+
+		if (QueryContextAttributes(&context, SECPKG_ATTR_SESSION_INFO, &info) == SEC_E_OK)
+			resumed = (info.dwFlags & SSL_SESSION_RECONNECT) != 0;
+
+		established = true;
+	}
+
+	return 0;
+}
+
+/**
+* \brief	decrypt
+*
+* decrypts the first received record. a renegotiation or a TLS 1.3 key update continues with the handshake
+*
+* \param	plain		receives the decrypted data
+* \param	incomplete	set if more bytes are needed
+*
+* \return	1 if the record is invalid or the client has closed the connection, 0 if success
+*/
+int const TlsChannel::decrypt(std::string & plain, bool & incomplete) {
+	SecBuffer buffers[4];
+	buffers[0].BufferType = SECBUFFER_DATA;
+	buffers[0].pvBuffer = &input[0];
+	buffers[0].cbBuffer = input.length();
+
+	for (int i = 1; i < 4; i++) {
+		buffers[i].BufferType = SECBUFFER_EMPTY;
+		buffers[i].pvBuffer = NULL;
+		buffers[i].cbBuffer = 0;
+	}
+
+	SecBufferDesc desc = { SECBUFFER_VERSION, 4, buffers };
+
+	SECURITY_STATUS status = DecryptMessage(&context, &desc, 0, NULL);
+
+	if (status == SEC_E_INCOMPLETE_MESSAGE) {
+		incomplete = true;
+
+		return 0;
+	}
+
+	if (status != SEC_E_OK && status != SEC_I_RENEGOTIATE)
+		return 1;
+
+	// decrypted in place, the data has to be taken before the record is removed
+	unsigned int extra = 0;
+
+	for (int i = 1; i < 4; i++) {
+		if (buffers[i].BufferType == SECBUFFER_DATA)
+			plain.append((char*)buffers[i].pvBuffer, buffers[i].cbBuffer);
+		else if (buffers[i].BufferType == SECBUFFER_EXTRA)
+			extra = buffers[i].cbBuffer;
+	}
+
+	input.erase(0, input.length() - extra);
+
+	if (status == SEC_I_RENEGOTIATE)
+		established = false;
+
+	return 0;
+}
+
+/**
+* \brief	encrypt
+*
+* encrypts a queued element into records of at most the maximum message size. the own and the shared bytes are copied
+* into the records once and encrypted there, so a cover is read from the cover cache without another copy
+*
+* \param	chunk	plain element
+* \param	records	the records are appended, with the bulk flag of the element
+*
+* \return	1 if error, 0 if success
+*/
+int const TlsChannel::encrypt(const OutputChunk & chunk, std::deque<OutputChunk> & records) {
+	unsigned int length = chunk.length();
+
+	for (unsigned int offset = 0; offset < length;) {
+		unsigned int part = min(length - offset, (unsigned int)sizes.cbMaximumMessage);
+
+		records.push_back(OutputChunk());
+
+		OutputChunk & record = records.back();
+		record.bulk = chunk.bulk;
+		record.data.resize(sizes.cbHeader + part + sizes.cbTrailer);
+
+		char *header = &record.data[0];
+		char *body = header + sizes.cbHeader;
+
+		// own bytes first, then the shared ones
+		unsigned int own = chunk.data.length();
+		unsigned int copied = 0;
+
+		if (offset < own) {
+			copied = min(part, own - offset);
+
+			memcpy(body, chunk.data.data() + offset, copied);
+		}
+
+		if (copied < part)
+			memcpy(body + copied, chunk.sharedData() + (offset + copied - own), part - copied);
+
+		SecBuffer buffers[4];
+		buffers[0].BufferType = SECBUFFER_STREAM_HEADER;
+		buffers[0].pvBuffer = header;
+		buffers[0].cbBuffer = sizes.cbHeader;
+		buffers[1].BufferType = SECBUFFER_DATA;
+		buffers[1].pvBuffer = body;
+		buffers[1].cbBuffer = part;
+		buffers[2].BufferType = SECBUFFER_STREAM_TRAILER;
+		buffers[2].pvBuffer = body + part;
+		buffers[2].cbBuffer = sizes.cbTrailer;
+		buffers[3].BufferType = SECBUFFER_EMPTY;
+		buffers[3].pvBuffer = NULL;
+		buffers[3].cbBuffer = 0;
+
+		SecBufferDesc desc = { SECBUFFER_VERSION, 4, buffers };
+
+		if (EncryptMessage(&context, 0, &desc, 0) != SEC_E_OK)
+			return 1;
+
+		// the trailer may be shorter than the maximum
+		record.data.resize(buffers[0].cbBuffer + buffers[1].cbBuffer + buffers[2].cbBuffer);
+
+		offset += part;
+	}
+
+	return 0;
+}
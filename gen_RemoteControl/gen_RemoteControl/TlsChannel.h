@@ -0,0 +1,51 @@
+#pragma once
+#include "stdafx.h"
+
+// subject of the certificate in the personal store of the user that the server presents to TLS clients
+#define TLS_CERTIFICATE_SUBJECT L"RemoteControl"
+
+// content type of a TLS record with handshake messages. a TLS client starts with it, no command does
+#define TLS_HANDSHAKE_RECORD 0x16
+
+// maximum number of received bytes that can't be decrypted yet. a record has at most 16 KB and its overhead
+#define TLS_INPUT_LIMIT 32768
+
+// requirements of the server contexts
+#define TLS_CONTEXT_FLAGS (ASC_REQ_STREAM | ASC_REQ_CONFIDENTIALITY | ASC_REQ_SEQUENCE_DETECT | ASC_REQ_REPLAY_DETECT \
+	| ASC_REQ_EXTENDED_ERROR | ASC_REQ_ALLOCATE_MEMORY)
+
+
+// TLS of one session with SChannel. the ciphers are the ones the system prefers, AES-GCM with AES-NI on current
+// systems. every session uses the same credentials, so SChannel's session cache lets a returning client resume its
+// TLS session with an abbreviated handshake
+class TlsChannel {
+	private:
+		static CredHandle credentials;
+		static bool available;
+
+		CtxtHandle context;
+		bool established;
+		bool resumed;
+		SecPkgContext_StreamSizes sizes;
+
+		// received bytes of a record that is incomplete
+		std::string input;
+
+		int const handshake(std::string & token, bool & incomplete);
+		int const decrypt(std::string & plain, bool & incomplete);
+
+	public:
+		TlsChannel();
+
+		~TlsChannel();
+
+		static int const start();
+		static void stop();
+		static bool const isAvailable() { return available; }
+
+		bool const isEstablished() const { return established; }
+		bool const isResumed() const { return resumed; }
+
+		int const receive(const char *data, const unsigned int & length, std::string & plain, std::string & token);
+		int const encrypt(const OutputChunk & chunk, std::deque<OutputChunk> & records);
+};
@@ -0,0 +1,148 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	Trace
+*
+* constructor, tracing is disabled
+*/
+Trace::Trace() {
+	next = 0;
+	enabled = 0;
+
+	ZeroMemory(events, sizeof(events));
+}
+
+/**
+* \brief	record
+*
+* adds an event to the ring if tracing is enabled. never blocks
+*
+* \param	name	name of the stage, must be a string literal
+* \param	phase	TRACE_BEGIN, TRACE_END or TRACE_INSTANT
+* \param	value	additional value, e.g. a message or a number of elements
+*/
+void Trace::record(const char *name, const int & phase, const int & value) {
+	if (enabled == 0)
+		return;
+
+	TraceEvent & event = events[(InterlockedIncrement(&next) - 1) & (TRACE_EVENTS - 1)];
+
+	event.time = metrics.now();
+	event.name = name;
+	event.thread = GetCurrentThreadId();
+	event.phase = phase;
+	event.value = value;
+}
+
+/**
+* \brief	enter
+*
+* enters a critical section. the wait is recorded as span if the section is owned by another thread
+*
+* \param	section	critical section
+* \param	name	name of the span
+*/
+void Trace::enter(CRITICAL_SECTION *section, const char *name) {
+	if (enabled == 0) {
+		EnterCriticalSection(section);
+
+		return;
+	}
+
+	if (TryEnterCriticalSection(section) != FALSE)
+		return;
+
+	record(name, TRACE_BEGIN);
+
+	EnterCriticalSection(section);
+
+	record(name, TRACE_END);
+}
+
+/**
+* \brief	enable
+*
+* clears the ring and starts recording
+*/
+void Trace::enable() {
+	InterlockedExchange(&enabled, 0);
+
+	ZeroMemory(events, sizeof(events));
+	InterlockedExchange(&next, 0);
+
+	InterlockedExchange(&enabled, 1);
+}
+
+/**
+* \brief	dump
+*
+* stops recording and writes the ring in the chrome trace format (chrome://tracing), oldest event first.
+* events written while tracing is stopped may be incomplete
+*
+* \param	path	file to write
+*
+* \return	1 if error, 0 if success
+*/
+int const Trace::dump(const std::string & path) {
+	InterlockedExchange(&enabled, 0);
+
+	LONG count = next;
+	LONG first = count > TRACE_EVENTS ? count - TRACE_EVENTS : 0;
+
+	ofstream outFile;
+	outFile.open(path.c_str());
+
+	outFile << "{\"traceEvents\":[" << endl;
+
+	bool separator = false;
+
+	for (LONG i = first; i < count; i++) {
+		const TraceEvent & event = events[i & (TRACE_EVENTS - 1)];
+
+		if (event.name == NULL)
+			continue;
+
+		outFile << (separator ? "," : "") << "{\"name\":\"" << event.name << "\",\"ph\":\"" << (char)event.phase
+			<< "\",\"ts\":" << event.time << ",\"pid\":1,\"tid\":" << event.thread
+			<< (event.phase == TRACE_INSTANT ? ",\"s\":\"t\"" : "") << ",\"args\":{\"value\":" << event.value << "}}" << endl;
+
+		separator = true;
+	}
+
+	outFile << "]}" << endl;
+
+	bool failed = outFile.fail();
+
+	outFile.close();
+
+	return failed ? 1 : 0;
+}
+
+
+/**
+* \brief	TraceSpan
+*
+* constructor, records the begin event
+*
+* \param	name	name of the span, must be a string literal
+* \param	value	additional value of the begin event
+* \param	active	false to record nothing
+*/
+TraceSpan::TraceSpan(const char *name, const int & value, const bool & active) {
+	this->name = name;
+	this->active = active && tracer.enabled != 0;
+
+	if (this->active)
+		tracer.record(name, TRACE_BEGIN, value);
+}
+
+/**
+* \brief	~TraceSpan
+*
+* destructor, records the end event
+*/
+TraceSpan::~TraceSpan() {
+	if (active)
+		tracer.record(name, TRACE_END);
+}
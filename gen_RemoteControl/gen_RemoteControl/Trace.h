@@ -0,0 +1,52 @@
+#pragma once
+#include "stdafx.h"
+
+
+// number of events kept in the ring, the oldest ones are overwritten. power of two
+#define TRACE_EVENTS 8192
+
+// phases of a trace event, as in the chrome trace format
+#define TRACE_BEGIN 'B'
+#define TRACE_END 'E'
+#define TRACE_INSTANT 'i'
+
+struct TraceEvent {
+	LONGLONG time;
+	const char *name;	// string literal
+	DWORD thread;
+	int phase;
+	int value;
+};
+
+
+// in memory ring of timed events of the server pipeline. disabled it costs one comparison per event.
+// enabled with the trace_1 command, trace_0 writes the ring to tracePath
+class Trace {
+	private:
+		TraceEvent events[TRACE_EVENTS];
+		volatile LONG next;
+
+	public:
+		Trace();
+
+		volatile LONG enabled;
+
+		void record(const char *name, const int & phase, const int & value = 0);
+		void enter(CRITICAL_SECTION *section, const char *name);
+
+		void enable();
+		int const dump(const std::string & path);
+};
+
+
+// begin event in the constructor, end event in the destructor
+class TraceSpan {
+	private:
+		const char *name;
+		bool active;
+
+	public:
+		TraceSpan(const char *name, const int & value = 0, const bool & active = true);
+
+		~TraceSpan();
+};
@@ -0,0 +1,128 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	TrackPrefetch
+*
+* constructor
+*/
+TrackPrefetch::TrackPrefetch() {
+	timer = NULL;
+	busy = 0;
+}
+
+/**
+* \brief	start
+*
+* starts the periodic check of the playback position if it isn't running. called by updateTimers while clients are connected
+*
+* \return	1 if error, 0 if success
+*/
+int const TrackPrefetch::start() {
+	if (timer != NULL)
+		return 0;
+
+	HANDLE created = NULL;
+
+	// the check reads files, it may take longer than a timer thread should be blocked
+	if (CreateTimerQueueTimer(&created, NULL, prefetchTimeout, this, PREFETCH_INTERVAL, PREFETCH_INTERVAL, WT_EXECUTELONGFUNCTION) == FALSE)
+		return 1;
+
+	// started by another thread in the meantime
+	if (InterlockedCompareExchangePointer(&timer, created, NULL) != NULL)
+		DeleteTimerQueueTimer(NULL, created, NULL);
+
+	return 0;
+}
+
+/**
+* \brief	stop
+*
+* stops the check. doesn't wait for a running one, it sends messages to winamp and stopServer may run on its thread.
+* called by stopServer and by updateTimers when the last client has gone
+*/
+void TrackPrefetch::stop() {
+	HANDLE running = InterlockedExchangePointer(&timer, NULL);
+
+	if (running != NULL)
+		DeleteTimerQueueTimer(NULL, running, NULL);
+
+	// a check that is still running keeps its file
+	if (InterlockedExchange(&busy, 1) == 0) {
+		prefetched.clear();
+
+		InterlockedExchange(&busy, 0);
+	}
+}
+
+/**
+* \brief	nextTrack
+*
+* the prediction of the metadata prefetch, also used by the audio streams to pre-roll the next track
+*
+* \param	after	playlist position of a track, the queue only applies to the current one
+*
+* \return	playlist position winamp plays after the track, -1 if it can't be known (shuffle, end of the playlist)
+*/
+int const TrackPrefetch::nextTrack(const int & after) {
+	if (after == winampstate.getListPosition() && WASABI_API_QUEUEMGR != NULL && WASABI_API_QUEUEMGR->GetNumberOfQueuedItems() > 0)
+		return WASABI_API_QUEUEMGR->GetQueuedItemFromIndex(0);
+
+	if (winampstate.getShuffle() != 0)
+		return -1;
+
+	int next = after + 1;
+
+	if (next < SendMessage(plugin.hwndParent,WM_WA_IPC,0,IPC_GETLISTLENGTH))
+		return next;
+
+	return winampstate.getRepeat() != 0 ? 0 : -1;
+}
+
+/**
+* \brief	prefetchTimeout
+*
+* reads the next track into the metadata cache once the current one has less than PREFETCH_LEAD milliseconds left,
+* every track once. the cover variants of the clients are prepared by a coverPrefetch_ task, the cover cache belongs
+* to the send command thread
+*
+* \param	parameter			prefetcher
+* \param	timerOrWaitFired	unused
+*/
+VOID CALLBACK TrackPrefetch::prefetchTimeout(PVOID parameter, BOOLEAN timerOrWaitFired) {
+	TrackPrefetch *prefetch = (TrackPrefetch*)parameter;
+
+	if (InterlockedExchange(&prefetch->busy, 1) != 0)
+		return;
+
+	if (connected == true && winampstate.getIsPlaying() == 1) {
+		int length = SendMessage(plugin.hwndParent,WM_WA_IPC,1,IPC_GETOUTPUTTIME) * 1000;
+		int next = length > 0 && length - winampstate.getPosition() <= PREFETCH_LEAD ? nextTrack(winampstate.getListPosition()) : -1;
+
+		const char *file = next >= 0 ? (char*)SendMessage(plugin.hwndParent,WM_WA_IPC,next,IPC_GETPLAYLISTFILE) : NULL;
+
+		// streams aren't cached
+		if (file != NULL && GetFileAttributesA(file) != INVALID_FILE_ATTRIBUTES) {
+			std::string path(file);
+			std::transform(path.begin(), path.end(), path.begin(), tolower);
+
+			if (path != prefetch->prefetched) {
+				prefetch->prefetched = path;
+
+				TraceSpan span("prefetch", next);
+
+				// with the cover, get keeps it in the cache
+				metadatacache.get(file, true)->release();
+
+				stringstream task;
+				task << "coverPrefetch_" << next;
+
+				tasklist.push(task.str());
+
+				InterlockedIncrement(&metrics.tracksPrefetched);
+			}
+		}
+	}
+
+	InterlockedExchange(&prefetch->busy, 0);
+}
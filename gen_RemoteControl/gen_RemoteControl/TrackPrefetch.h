@@ -0,0 +1,33 @@
+#pragma once
+#include "stdafx.h"
+
+// milliseconds between two checks of the playback position
+#define PREFETCH_INTERVAL 1000
+
+// milliseconds before the end of a track the next one is read
+#define PREFETCH_LEAD 10000
+
+
+// reads the metadata and the cover of the track winamp is going to play next during the last PREFETCH_LEAD
+// milliseconds of the current one, so the song change is a hit of the metadata and cover caches. the next track
+// is the head of the queue, or the following playlist entry if shuffle is off
+class TrackPrefetch {
+	private:
+		HANDLE volatile timer;
+
+		// 1 while a check runs, the timer doesn't wait for the last one
+		volatile LONG busy;
+
+		// lower case path of the last prefetched file, only used by the running check
+		std::string prefetched;
+
+		static VOID CALLBACK prefetchTimeout(PVOID parameter, BOOLEAN timerOrWaitFired);
+
+	public:
+		TrackPrefetch();
+
+		static int const nextTrack(const int & after);
+
+		int const start();
+		void stop();
+};
@@ -1,126 +1,377 @@
 #include "stdafx.h"
 
-using namespace gen_RemoteControl;
-using namespace System::Threading;
+std::string UIManager::texts[UI_ACTIONS];
+bool UIManager::pending[UI_ACTIONS];
+std::deque<std::string> UIManager::logLines;
+CRITICAL_SECTION UIManager::cs_uimanager;
+HMODULE UIManager::module = NULL;
+UIModule *UIManager::ui = NULL;
+UIHost UIManager::host;
+
+
+/**
+* \brief	initialize
+*
+* creates the critical section and the UIHost. called by init before anything is logged. the critical section is
+* never deleted, threads that are stopped by quit may still log
+*/
+void UIManager::initialize() {
+	InitializeCriticalSection(&cs_uimanager);
+
+	for (int i = 0; i < UI_ACTIONS; i++)
+		pending[i] = false;
+
+	host.version = UI_MODULE_VERSION;
+	host.name = PLUGIN_NAME;
+	host.connect = &UIManager::connect;
+	host.save = &UIManager::save;
+	host.read = &UIManager::read;
+	host.flush = &UIManager::flush;
+	host.checkForNewVersion = &UIManager::checkForNewVersion;
+	host.quit = &UIManager::quit;
+}
 
 /**
-* \brief	getUI
+* \brief	load
+*
+* loads the window module from the folder of the plugin dll. the CLR starts with it
 *
-* returns the used UI object or creates a new one if it's not yet created.
+* \param	error	receives the reason if the module couldn't be loaded
 *
-* \return UI^
+* \return	1 if error, 0 if success
 */
-UI^ UIManager::getUI() {
-	if (UIform == nullptr)
-		UIform = gcnew gen_RemoteControl::UI();
+int const UIManager::load(std::string & error) {
+	if (ui != NULL)
+		return 0;
+
+	wchar_t path[MAX_PATH];
+	DWORD length = GetModuleFileNameW(plugin.hDllInstance, path, MAX_PATH);
+
+	if (length == 0 || length == MAX_PATH) {
+		error = "The folder of the plugin is unknown.";
+
+		return 1;
+	}
+
+	wchar_t *name = wcsrchr(path, L'\\');
+	name = name == NULL ? path : name + 1;
+
+	if (wcscpy_s(name, MAX_PATH - (name - path), UI_MODULE_NAME) != 0) {
+		error = "The path of the plugin is too long.";
 
-	return UIform;
+		return 1;
+	}
+
+	module = LoadLibraryW(path);
+
+	if (module == NULL) {
+		DWORD code = GetLastError();
+		char text[256];
+
+		// a missing file, or a missing dependency of it: the runtime of Visual C++ or the .NET Framework 4
+		if (code == ERROR_MOD_NOT_FOUND && GetFileAttributesW(path) == INVALID_FILE_ATTRIBUTES)
+			sprintf_s(text, "RemoteControlUI.dll is missing in the plugins folder of Winamp. Please install the plugin again.");
+		else
+			sprintf_s(text, "RemoteControlUI.dll couldn't be loaded (error %lu). It needs the .NET Framework 4 and the Visual C++ 2010 runtime.", code);
+
+		error = text;
+
+		return 1;
+	}
+
+	UIModuleEntry entry = (UIModuleEntry)GetProcAddress(module, UI_MODULE_ENTRY);
+	UIModule *loaded = entry != NULL ? entry(&host) : NULL;
+
+	if (loaded == NULL || loaded->version != UI_MODULE_VERSION) {
+		FreeLibrary(module);
+		module = NULL;
+
+		error = "RemoteControlUI.dll doesn't belong to this version of the plugin. Please install the plugin again.";
+
+		return 1;
+	}
+
+	ui = loaded;
+
+	return 0;
 }
 
+
 /**
-* \brief	setUI
+* \brief	queue
 *
-* sets a new UI object
+* stores an action until the window flushes it. only the latest action of each type is kept, so a burst of
+* updates costs one flush. without the window the actions wait until it is loaded
 *
-* \param	UIform_orig	the new UI object to use
+* \param	action	UIAction type, see UIModule.h
+* \param	text	parameter of the action
 */
-void UIManager::setUI(UI^ UIform_orig) {
-	UIform = UIform_orig;
+void UIManager::queue(const int & action, const std::string & text) {
+	// CRITICAL
+	EnterCriticalSection(&cs_uimanager);
+
+	if (action != LOG)
+		texts[action] = text;
+
+	pending[action] = true;
+
+	LeaveCriticalSection(&cs_uimanager);
+	// CRITICAL END
+
+	UIModule *loaded = ui;
+
+	if (loaded != NULL)
+		loaded->changed();
+}
+
+/**
+* \brief	flush
+*
+* UIHost function: hands all pending actions to the window. runs on the UI thread, the log is handed once for every
+* batch of new entries. receive is called outside of the lock
+*
+* \param	receive	function of the window that applies an action
+*/
+void UIManager::flush(UIReceive receive) {
+	std::vector<std::pair<int, std::string> > actions;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_uimanager);
+
+	for (int i = 0; i < UI_ACTIONS; i++) {
+		if (!pending[i])
+			continue;
+
+		pending[i] = false;
+
+		if (i == LOG) {
+			std::string log;
+
+			for (std::deque<std::string>::const_iterator it = logLines.begin(); it != logLines.end(); it++)
+				log.append(*it);
+
+			actions.push_back(std::make_pair(i, log));
+		} else
+			actions.push_back(std::make_pair(i, texts[i]));
+	}
+
+	LeaveCriticalSection(&cs_uimanager);
+	// CRITICAL END
+
+	for (unsigned int i = 0; i < actions.size(); i++)
+		receive(actions[i].first, actions[i].second.c_str());
+}
+
+
+/**
+* \brief	connect
+*
+* UIHost function: starts the server or stops it if it is running
+*/
+void UIManager::connect() {
+	// the background phase of init starts the server
+	if (startupRunning == 1)
+		return;
+
+	if (connecting == false && connected == false)
+		startServer();
+	else
+		stopServer(true);
+}
+
+/**
+* \brief	save
+*
+* UIHost function: applies the settings of the window and saves them
+*
+* \param	settings	settings of the window
+*
+* \return	1 if error, 0 if success
+*/
+int UIManager::save(const UISettings *settings) {
+	port = settings->port;
+	autostart = settings->autostart;
+	showconfigonstartup = settings->showconfigonstartup;
+	autorestart = settings->autorestart;
+	keepalivemessages = settings->keepalivemessages;
+
+	if (saveSettings() == 1) {
+		addLogText("Could not save settings!\r\n", LOG_ERROR);
+
+		return 1;
+	}
+
+	return 0;
+}
+
+/**
+* \brief	read
+*
+* UIHost function: reads the current settings for the window
+*
+* \param	settings	receives the settings
+*/
+void UIManager::read(UISettings *settings) {
+	settings->port = port;
+	settings->autostart = autostart;
+	settings->showconfigonstartup = showconfigonstartup;
+	settings->autorestart = autorestart;
+	settings->keepalivemessages = keepalivemessages;
+}
+
+/**
+* \brief	checkForNewVersion
+*
+* UIHost function: starts a new thread that checks for a new version
+*/
+void UIManager::checkForNewVersion() {
+	checkForNewVersionInvoker();
+}
+
+/**
+* \brief	quit
+*
+* UIHost function: quits the plugin, the window is destroyed by the system
+*/
+void UIManager::quit() {
+	::quit();
 }
 
 
 /**
 * \brief	addLogText
 *
-* starts a thread to create a new log entry
+* adds a new log entry. the entry is shown with the next batch, only the last LOG_LINES entries are kept. it is also
+* written to the log file if loglevel allows it, LOG_DEBUG entries are only written there
 *
 * \param	text	the new entry to add
+* \param	level	LOG_ level of the entry
 */
-void UIManager::addLogText(System::String^ text) {
-	UIAction^ la = gcnew UIAction();
+void UIManager::addLogText(const std::string & text, const int & level) {
+	logwriter.append(level, text);
+
+	if (level >= LOG_DEBUG)
+		return;
+
+	std::string entry = time();
+	entry.append(": ").append(text);
+
+	// CRITICAL
+	EnterCriticalSection(&cs_uimanager);
+
+	logLines.push_back(entry);
+	MemoryTag::add(MEMORY_LOG, entry.length());
 
-	la->setParameter(text);
-	la->setAction(LOG);
+	while (logLines.size() > LOG_LINES) {
+		MemoryTag::add(MEMORY_LOG, -(LONG)logLines.front().length());
+		logLines.pop_front();
+	}
 
-	Thread^ t = gcnew Thread(gcnew ThreadStart(la, &UIAction::Start));
-	t->Start();
+	LeaveCriticalSection(&cs_uimanager);
+	// CRITICAL END
+
+	// flush builds the LOG action from logLines
+	queue(LOG, std::string());
 }
 
 /**
 * \brief	setStatusText
 *
-* starts a thread to set a new status text
+* sets a new status text with the next batch
 *
 * \param	text	the new text
 */
-void UIManager::setStatusText(System::String^ text) {
-	UIAction^ la = gcnew UIAction();
-
-	la->setParameter(text);
-	la->setAction(STATUS);
-
-	Thread^ t = gcnew Thread(gcnew ThreadStart(la, &UIAction::Start));
-	t->Start(); 
+void UIManager::setStatusText(const std::string & text) {
+	queue(STATUS, text);
 }
 
 /**
 * \brief	setButtonText
 *
-* starts a thread to set a new button text
+* sets a new button text with the next batch
 *
 * \param	text	the new text
 */
-void UIManager::setButtonText(System::String^ text) {
-	UIAction^ la = gcnew UIAction();
-
-	la->setParameter(text);
-	la->setAction(BUTTON);
-
-	Thread^ t = gcnew Thread(gcnew ThreadStart(la, &UIAction::Start));
-	t->Start(); 
+void UIManager::setButtonText(const std::string & text) {
+	queue(BUTTON, text);
 }
 
 /**
 * \brief	setIP
 *
-* starts a thread to set a new IP text
+* sets a new IP text with the next batch
 *
 * \param	text	the new text
 */
-void UIManager::setIP(System::String^ text) {
-	UIAction^ la = gcnew UIAction();
+void UIManager::setIP(const std::string & text) {
+	queue(IP, text);
+}
 
-	la->setParameter(text);
-	la->setAction(IP);
+/**
+* \brief	setScanText
+*
+* sets a new playlist scan progress text with the next batch
+*
+* \param	text	the new text
+*/
+void UIManager::setScanText(const std::string & text) {
+	queue(SCAN, text);
+}
 
-	Thread^ t = gcnew Thread(gcnew ThreadStart(la, &UIAction::Start));
-	t->Start(); 
+/**
+* \brief	setMemoryText
+*
+* sets a new text of the memory the plugin has allocated with the next batch, see MemoryTag::summary
+*
+* \param	text	the new text
+*/
+void UIManager::setMemoryText(const std::string & text) {
+	queue(MEMORY, text);
 }
 
 /**
 * \brief	newVersionFound
 *
-* starts a thread to notice about a new available version
+* notices about a new available version with the next batch
 */
 void UIManager::newVersionFound() {
-	UIAction^ la = gcnew UIAction();
-
-	la->setParameter(gcnew String(""));
-	la->setAction(VERSION);
+	queue(VERSION, std::string());
+}
 
-	Thread^ t = gcnew Thread(gcnew ThreadStart(la, &UIAction::Start));
-	t->Start(); 
+/**
+* \brief	settingsChanged
+*
+* fills the settings fields of the window again with the next batch
+*/
+void UIManager::settingsChanged() {
+	queue(SETTINGS, std::string());
 }
 
 /**
 * \brief	showUI
 *
-* starts the backgroundWorker that shows or hides the UI window
+* shows or hides the window. the window module is loaded the first time the window is shown, hiding a window
+* that has never been loaded does nothing. a window module that can't be loaded is reported with a message box, the
+* log is part of the window. called on the winamp thread
 *
 * \param	value	shows window if true, hides window if false
 */
 void UIManager::showUI(const bool value) {
-	windowVisible = value;
+	if (ui == NULL) {
+		if (!value)
+			return;
+
+		std::string error;
+
+		if (load(error) == 1) {
+			addLogText("Could not load the configuration window! " + error + "\r\n", LOG_ERROR);
 
-	getUI()->backgroundWorker->RunWorkerAsync();
-}
\ No newline at end of file
+			MessageBoxA(plugin.hwndParent, ("Could not load the configuration window!\r\n\r\n" + error).c_str(), PLUGIN_NAME,
+				MB_OK | MB_ICONERROR);
+
+			return;
+		}
+	}
+
+	ui->show(value);
+}
@@ -2,17 +2,44 @@
 #include "stdafx.h"
 
 
-ref class UIManager
+// native side of the configuration window. keeps the texts of the window until the window module is loaded
+// by showUI and hands them to it in batches, see UIModule.h
+class UIManager
 {
-	private: static gen_RemoteControl::UI^ UIform = nullptr;
+	private: // pending actions, handed to the window by flush. guarded by cs_uimanager
+			 static std::string texts[UI_ACTIONS];
+			 static bool pending[UI_ACTIONS];
 
-	public: static gen_RemoteControl::UI^ getUI();
-            static void setUI(gen_RemoteControl::UI^ UIform_orig);
+			 // the last LOG_LINES log entries
+			 static std::deque<std::string> logLines;
 
-			static void addLogText(System::String^ text);
-			static void setStatusText(System::String^ text);
-			static void setButtonText(System::String^ text);
-			static void setIP(System::String^ text);
+			 static CRITICAL_SECTION cs_uimanager;
+
+			 // window module, NULL until it is loaded
+			 static HMODULE module;
+			 static UIModule *ui;
+			 static UIHost host;
+
+			 static void queue(const int & action, const std::string & text);
+			 static int const load(std::string & error);
+
+			 // UIHost functions
+			 static void connect();
+			 static int save(const UISettings *settings);
+			 static void read(UISettings *settings);
+			 static void flush(UIReceive receive);
+			 static void checkForNewVersion();
+			 static void quit();
+
+	public: static void initialize();
+
+			static void addLogText(const std::string & text, const int & level = LOG_INFO);
+			static void setStatusText(const std::string & text);
+			static void setButtonText(const std::string & text);
+			static void setIP(const std::string & text);
+			static void setScanText(const std::string & text);
+			static void setMemoryText(const std::string & text);
 			static void	newVersionFound();
+			static void settingsChanged();
 			static void showUI(const bool value);
-};
\ No newline at end of file
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+// interface between the native plugin and the managed configuration window. the window lives in its own
+// module that is loaded the first time it is shown, so winamp starts without the CLR. only plain C types
+// cross the module boundary
+
+// file name of the window module, next to the plugin dll. without the gen_ prefix winamp doesn't load it as plugin
+#define UI_MODULE_NAME L"RemoteControlUI.dll"
+
+// exported function of the window module, see UIModule
+#define UI_MODULE_ENTRY "getUIModule"
+
+// changes when UIHost or UIModule change, a module with another version isn't used
+#define UI_MODULE_VERSION 1
+
+// definitions to identify UIAction: add log text or change status text in UI?
+#define LOG 1
+#define STATUS 2
+#define BUTTON 3
+#define IP 4
+#define VERSION 5
+#define SCAN 6
+#define SETTINGS 7
+#define MEMORY 8
+
+// number of UIAction types + 1, actions are pending per type
+#define UI_ACTIONS 9
+
+
+// settings the window shows and changes
+struct UISettings {
+	int port;
+	int autostart;
+	int showconfigonstartup;
+	int autorestart;
+	int keepalivemessages;
+};
+
+// receives the text of a pending action, see UIHost::flush
+typedef void (*UIReceive)(int action, const char *text);
+
+// functions of the plugin for the window, called on the UI thread
+struct UIHost {
+	int version;
+
+	// PLUGIN_NAME
+	const char *name;
+
+	// starts the server or stops it if it is running
+	void (*connect)();
+
+	// applies and saves the settings, 1 if error, 0 if success
+	int (*save)(const UISettings *settings);
+
+	// reads the current settings
+	void (*read)(UISettings *settings);
+
+	// calls receive for every action that changed since the last flush
+	void (*flush)(UIReceive receive);
+
+	// starts a thread that checks for a new version
+	void (*checkForNewVersion)();
+
+	// quits the plugin when the window is destroyed by the system
+	void (*quit)();
+};
+
+// functions of the window for the plugin
+struct UIModule {
+	int version;
+
+	// shows or hides the window, called on the winamp thread
+	void (*show)(bool visible);
+
+	// actions are pending, the window flushes them soon on its own thread. called on any thread
+	void (*changed)();
+};
+
+// signature of UI_MODULE_ENTRY
+typedef UIModule* (*UIModuleEntry)(const UIHost *host);
@@ -0,0 +1,425 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	WebChannel
+*
+* constructor
+*/
+WebChannel::WebChannel() {
+	upgraded = false;
+}
+
+/**
+* \brief	isRequest
+*
+* checks if the first bytes of a connection are an HTTP request. no command starts like one
+*
+* \param	data	first received bytes
+* \param	length	number of received bytes
+*
+* \return	true for GET and POST requests
+*/
+bool const WebChannel::isRequest(const char *data, const unsigned int & length) {
+	return length >= 4 && (memcmp(data, "GET ", 4) == 0 || memcmp(data, "POST", 4) == 0);
+}
+
+/**
+* \brief	appendFrameHeader
+*
+* appends the header of an unmasked WebSocket frame that holds a complete message
+*
+* \param	target	string to append to
+* \param	opcode	WEB_OPCODE_TEXT, WEB_OPCODE_BINARY or a control opcode
+* \param	length	payload length
+*/
+void WebChannel::appendFrameHeader(std::string & target, const unsigned char & opcode, const unsigned int & length) {
+	target.push_back((char)(0x80 | opcode));	// FIN
+
+	if (length < 126)
+		target.push_back((char)length);
+	else if (length <= 0xFFFF) {
+		target.push_back((char)126);
+		target.push_back((char)((length >> 8) & 0xFF));
+		target.push_back((char)(length & 0xFF));
+	} else {
+		target.push_back((char)127);
+		target.append(4, '\0');
+		target.push_back((char)((length >> 24) & 0xFF));
+		target.push_back((char)((length >> 16) & 0xFF));
+		target.push_back((char)((length >> 8) & 0xFF));
+		target.push_back((char)(length & 0xFF));
+	}
+}
+
+/**
+* \brief	receive
+*
+* handles the received bytes of the requests or, after the upgrade, of the WebSocket frames. an incomplete request
+* or frame is kept
+*
+* \param	data		received bytes
+* \param	length		number of received bytes
+* \param	commands	receives the commands of the requests or messages, terminated by \n
+* \param	response	receives the WebSocket frames to send to the client at once
+* \param	tasks		receives the tasks that send the responses to the requests, http_<response> or
+*						httpCover_<hash>_<size>_<range>_<If-None-Match>
+*
+* \return	1 if the connection has to be closed, 0 if success
+*/
+int const WebChannel::receive(const char *data, const unsigned int & length, std::string & commands, std::string & response, std::vector<std::string> & tasks) {
+	if (input.length() + length > WEB_REQUEST_LIMIT + WEB_MESSAGE_LIMIT)
+		return 1;
+
+	input.append(data, length);
+
+	bool incomplete = false;
+
+	while (!input.empty() && !incomplete) {
+		int result = upgraded ? receiveFrame(commands, response, incomplete) : receiveRequest(commands, tasks, incomplete);
+
+		if (result != 0)
+			return 1;
+	}
+
+	return 0;
+}
+
+/**
+* \brief	receiveRequest
+*
+* takes the first request with its body from the received bytes and answers it
+*
+* \param	commands	receives the commands of the request
+* \param	tasks		receives the task of the response
+* \param	incomplete	set if more bytes are needed
+*
+* \return	1 if the request is invalid, 0 if success
+*/
+int const WebChannel::receiveRequest(std::string & commands, std::vector<std::string> & tasks, bool & incomplete) {
+	size_t end = input.find("\r\n\r\n");
+
+	if (end == std::string::npos) {
+		incomplete = true;
+
+		return input.length() > WEB_REQUEST_LIMIT ? 1 : 0;
+	}
+
+	if (end > WEB_REQUEST_LIMIT)
+		return 1;
+
+	std::string head = input.substr(0, end + 2);
+	unsigned int bodyLength = atoi(header("Content-Length", head).c_str());
+
+	if (bodyLength > WEB_MESSAGE_LIMIT)
+		return 1;
+
+	if (input.length() < end + 4 + bodyLength) {
+		incomplete = true;
+
+		return 0;
+	}
+
+	std::string body = input.substr(end + 4, bodyLength);
+	input.erase(0, end + 4 + bodyLength);
+
+	return answer(head, body, commands, tasks);
+}
+
+/**
+* \brief	answer
+*
+* performs a request: upgrades to WebSocket, takes the commands of the request or asks for a cover
+*
+* \param	head		request line and header lines
+* \param	body		request body
+* \param	commands	receives the commands of the request
+* \param	tasks		receives the task of the response
+*
+* \return	1 if the request is no HTTP request, 0 if success
+*/
+int const WebChannel::answer(const std::string & head, const std::string & body, std::string & commands, std::vector<std::string> & tasks) {
+	std::istringstream requestLine(head.substr(0, head.find("\r\n")));
+	std::string method, target, version;
+
+	requestLine >> method >> target >> version;
+
+	if (version.compare(0, 5, "HTTP/") != 0)
+		return 1;
+
+	InterlockedIncrement(&metrics.webRequests);
+
+	if (method == "GET" && _stricmp(header("Upgrade", head).c_str(), "websocket") == 0) {
+		std::string key = header("Sec-WebSocket-Key", head);
+
+		if (!isSameOrigin(head)) {
+			tasks.push_back("http_HTTP/1.1 403 Forbidden\r\nContent-Length: 0\r\n\r\n");
+
+			return 0;
+		}
+
+		if (key.empty()) {
+			tasks.push_back("http_HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n");
+
+			return 0;
+		}
+
+		tasks.push_back("http_HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: " + accept(key) + "\r\n\r\n");
+		upgraded = true;
+
+		InterlockedIncrement(&metrics.webSockets);
+
+		return 0;
+	}
+
+	size_t query = target.find('?');
+	std::string path = target.substr(0, query);
+
+	if (method == "GET" && path.compare(0, 7, "/cover/") == 0) {
+		std::string hash = path.substr(7);
+
+		// size=<pixels>, the original without it
+		int size = 0;
+		size_t parameter = query == std::string::npos ? std::string::npos : target.find("size=", query);
+
+		if (parameter != std::string::npos && (target[parameter - 1] == '?' || target[parameter - 1] == '&'))
+			size = max(0, atoi(target.c_str() + parameter + 5));
+
+		if (hash.empty() || hash.length() > 16 || hash.find('_') != std::string::npos) {
+			tasks.push_back("http_HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+
+			return 0;
+		}
+
+		stringstream cover;
+		cover << "httpCover_" << hash << "_" << size << "_" << header("Range", head) << "_" << header("If-None-Match", head);
+
+		tasks.push_back(cover.str());
+
+		return 0;
+	}
+
+	if (path != "/command" && path.compare(0, 9, "/command/") != 0) {
+		tasks.push_back("http_HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+
+		return 0;
+	}
+
+	// commands change the state of winamp, a link or an image of another page must not send them
+	if (method != "POST" || path != "/command") {
+		tasks.push_back("http_HTTP/1.1 405 Method Not Allowed\r\nAllow: POST\r\nContent-Length: 0\r\n\r\n");
+
+		return 0;
+	}
+
+	if (!isSameOrigin(head)) {
+		tasks.push_back("http_HTTP/1.1 403 Forbidden\r\nContent-Length: 0\r\n\r\n");
+
+		return 0;
+	}
+
+	commands += body + "\n";
+
+	tasks.push_back("http_HTTP/1.1 204 No Content\r\n\r\n");
+
+	return 0;
+}
+
+/**
+* \brief	isSameOrigin
+*
+* checks that a request of a browser comes from a page of the plugin itself. browsers send Origin with every
+* WebSocket upgrade and POST, requests without it come from other programs
+*
+* \param	head	request line and header lines
+*
+* \return	false if Origin names another host than the one the request was sent to
+*/
+bool const WebChannel::isSameOrigin(const std::string & head) {
+	std::string origin = header("Origin", head);
+
+	if (origin.empty())
+		return true;
+
+	std::string host = header("Host", head);
+	size_t scheme = origin.find("://");
+
+	return scheme != std::string::npos && !host.empty() && _stricmp(origin.c_str() + scheme + 3, host.c_str()) == 0;
+}
+
+/**
+* \brief	receiveFrame
+*
+* takes the first WebSocket frame from the received bytes. the frames of a client are masked
+*
+* \param	commands	receives the commands of a completed text message
+* \param	response	receives the answer to a ping or a close
+* \param	incomplete	set if more bytes are needed
+*
+* \return	1 if the connection has to be closed, 0 if success
+*/
+int const WebChannel::receiveFrame(std::string & commands, std::string & response, bool & incomplete) {
+	const unsigned char *bytes = (const unsigned char*)input.data();
+	unsigned int available = input.length();
+
+	if (available < 2) {
+		incomplete = true;
+
+		return 0;
+	}
+
+	bool fin = (bytes[0] & 0x80) != 0;
+	unsigned char opcode = bytes[0] & 0x0F;
+
+	unsigned long long length = bytes[1] & 0x7F;
+	unsigned int offset = 2;
+
+	if (length == 126) {
+		offset = 4;
+
+		if (available >= offset)
+			length = (bytes[2] << 8) | bytes[3];
+	} else if (length == 127) {
+		offset = 10;
+
+		if (available >= offset) {
+			length = 0;
+
+			for (int i = 2; i < 10; i++)
+				length = (length << 8) | bytes[i];
+		}
+	}
+
+	if ((bytes[1] & 0x80) == 0 || length > WEB_MESSAGE_LIMIT)
+		return 1;
+
+	if (available < offset + 4 + length) {
+		incomplete = true;
+
+		return 0;
+	}
+
+	const unsigned char *mask = bytes + offset;
+	std::string payload(input, offset + 4, (unsigned int)length);
+
+	for (unsigned int i = 0; i < payload.length(); i++)
+		payload[i] ^= mask[i % 4];
+
+	input.erase(0, offset + 4 + (unsigned int)length);
+
+	switch (opcode) {
+		case WEB_OPCODE_TEXT:
+			message.swap(payload);
+			break;
+
+		case WEB_OPCODE_CONTINUATION:
+			if (message.length() + payload.length() > WEB_MESSAGE_LIMIT)
+				return 1;
+
+			message += payload;
+			break;
+
+		case WEB_OPCODE_PING:
+			appendFrameHeader(response, WEB_OPCODE_PONG, payload.length());
+			response += payload;
+
+			return 0;
+
+		case WEB_OPCODE_PONG:
+			return 0;
+
+		case WEB_OPCODE_CLOSE:
+			appendFrameHeader(response, WEB_OPCODE_CLOSE, 0);
+
+			return 1;
+
+		default:	// binary messages aren't commands
+			return 1;
+	}
+
+	if (fin) {
+		commands += message + "\n";
+		message.clear();
+	}
+
+	return 0;
+}
+
+/**
+* \brief	header
+*
+* finds a header field of a request, the name is compared without case
+*
+* \param	name	field name
+* \param	head	request line and header lines, each terminated by \r\n
+*
+* \return	value without surrounding spaces, empty if the field is missing
+*/
+std::string const WebChannel::header(const std::string & name, const std::string & head) {
+	size_t line = head.find("\r\n");
+
+	while (line != std::string::npos && line + 2 < head.length()) {
+		size_t start = line + 2;
+		size_t end = head.find("\r\n", start);
+
+		if (end == std::string::npos)
+			break;
+
+		if (end - start > name.length() && head[start + name.length()] == ':'
+			&& _strnicmp(head.c_str() + start, name.c_str(), name.length()) == 0) {
+			size_t first = head.find_first_not_of(" \t", start + name.length() + 1);
+			size_t last = head.find_last_not_of(" \t", end - 1);
+
+			return first == std::string::npos || first > last ? std::string() : head.substr(first, last - first + 1);
+		}
+
+		line = end;
+	}
+
+	return std::string();
+}
+
+/**
+* \brief	accept
+*
+* computes Sec-WebSocket-Accept: base64 of the SHA-1 of the key and WEB_SOCKET_GUID
+*
+* \param	key	Sec-WebSocket-Key of the client
+*
+* \return	value for the response, empty if the hash failed
+*/
+std::string const WebChannel::accept(const std::string & key) {
+	std::string text = key + WEB_SOCKET_GUID;
+	std::string result;
+
+	HCRYPTPROV provider;
+	HCRYPTHASH hash;
+
+	if (CryptAcquireContext(&provider, NULL, NULL, PROV_RSA_FULL, CRYPT_VERIFYCONTEXT) == FALSE)
+		return result;
+
+	if (CryptCreateHash(provider, CALG_SHA1, 0, 0, &hash) != FALSE) {
+		BYTE digest[20];
+		DWORD digestLength = sizeof(digest);
+
+		if (CryptHashData(hash, (const BYTE*)text.data(), text.length(), 0) != FALSE
+			&& CryptGetHashParam(hash, HP_HASHVAL, digest, &digestLength, 0) != FALSE) {
+			char encoded[64];
+			DWORD encodedLength = sizeof(encoded);
+
+			if (CryptBinaryToStringA(digest, digestLength, CRYPT_STRING_BASE64, encoded, &encodedLength) != FALSE) {
+				// without the line end
+				for (DWORD i = 0; i < encodedLength; i++) {
+					if (encoded[i] != '\r' && encoded[i] != '\n')
+						result.push_back(encoded[i]);
+				}
+			}
+		}
+
+		CryptDestroyHash(hash);
+	}
+
+	CryptReleaseContext(provider, 0);
+
+	return result;
+}
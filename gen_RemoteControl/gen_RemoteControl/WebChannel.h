@@ -0,0 +1,58 @@
+#pragma once
+#include "stdafx.h"
+
+// maximum size of the header of one HTTP request
+#define WEB_REQUEST_LIMIT 4096
+
+// maximum payload of one WebSocket message from a client, the commands are short
+#define WEB_MESSAGE_LIMIT 65536
+
+// appended to Sec-WebSocket-Key for Sec-WebSocket-Accept, RFC 6455
+#define WEB_SOCKET_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+// WebSocket opcodes
+#define WEB_OPCODE_CONTINUATION 0x0
+#define WEB_OPCODE_TEXT 0x1
+#define WEB_OPCODE_BINARY 0x2
+#define WEB_OPCODE_CLOSE 0x8
+#define WEB_OPCODE_PING 0x9
+#define WEB_OPCODE_PONG 0xA
+
+
+// HTTP/1.1 and WebSocket clients on the port of the native protocol, e.g. browser dashboards and home automation.
+// POST /command with one command per line performs commands like the phone sends them and is answered with 204,
+// GET /cover/<hash>?size=<pixels> returns a cover the server has linked with coverLink_. the connection is kept
+// alive, the responses are sent by the send command thread in request order. HTTP sessions get no output of the
+// server, idle ones are closed like a phone that doesn't answer the keep alive messages. GET with a WebSocket upgrade
+// turns the session into a PROTOCOL_WEBSOCKET one: every text message holds commands, every line the server sends is
+// a text message and a cover a binary message. it is synchronized, gets the broadcasts and has to answer alive like
+// a phone. upgrades and commands of browser pages are only taken from pages of the plugin's own host, see isSameOrigin
+class WebChannel {
+	private:
+		// received bytes of an incomplete request or WebSocket frame
+		std::string input;
+
+		// payload of a fragmented WebSocket message
+		std::string message;
+
+		bool upgraded;
+
+		int const receiveRequest(std::string & commands, std::vector<std::string> & tasks, bool & incomplete);
+		int const receiveFrame(std::string & commands, std::string & response, bool & incomplete);
+		int const answer(const std::string & head, const std::string & body, std::string & commands, std::vector<std::string> & tasks);
+
+		static std::string const accept(const std::string & key);
+		static bool const isSameOrigin(const std::string & head);
+
+	public:
+		WebChannel();
+
+		static std::string const header(const std::string & name, const std::string & request);
+
+		static bool const isRequest(const char *data, const unsigned int & length);
+		static void appendFrameHeader(std::string & target, const unsigned char & opcode, const unsigned int & length);
+
+		bool const isUpgraded() const { return upgraded; }
+
+		int const receive(const char *data, const unsigned int & length, std::string & commands, std::string & response, std::vector<std::string> & tasks);
+};
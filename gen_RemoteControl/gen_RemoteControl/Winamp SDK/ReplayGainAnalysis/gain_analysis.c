@@ -93,6 +93,7 @@
  *   Modification to allow for multiple instances to be run simtulaneously (via context pointer)
  *  03 July 2007 - Marc Lerch (marc.lerch[]gmail.com) and Ben Allison (benski[]nullsoft.com)
  *   Coefficients for 64000, 88200 and 96000 sampling rates
+ *  SSE version of the Yule filter, WAMergeAlbumGain so parallel contexts can give one album gain
  */
 
 #include <stdio.h>
@@ -100,6 +101,11 @@
 #include <string.h>
 #include <math.h>
 
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE__)
+#define GAIN_ANALYSIS_SSE
+#include <xmmintrin.h>
+#endif
+
 #include "gain_analysis.h"
 
 typedef unsigned short Uint16_t;
@@ -109,7 +115,11 @@ typedef signed int Int32_t;
 
 #define YULE_ORDER         10
 #define BUTTER_ORDER        2
+#ifdef GAIN_ANALYSIS_SSE
+#define YULE_FILTER     filterYuleSSE
+#else
 #define YULE_FILTER     filterYule
+#endif
 #define BUTTER_FILTER   filterButter
 #define RMS_PERCENTILE      0.95        // percentile which is louder than the proposed level
 #define MAX_SAMP_FREQ   96000.          // maximum allowed sample frequency [Hz]
@@ -234,6 +244,58 @@ filterYule (const Float_t* input, Float_t* output, size_t nSamples, const Float_
 	}
 }
 
+#ifdef GAIN_ANALYSIS_SSE
+
+// Same filter as filterYule. The oldest 8 inputs and outputs of a sample are known before it is computed,
+// their products are summed 4 at a time with the coefficients in memory order. The 3 newest inputs and
+// the 2 newest outputs are added one by one.
+
+static void
+filterYuleSSE (const Float_t* input, Float_t* output, size_t nSamples, const Float_t* kernel)
+{
+	Float_t b [8];
+	Float_t a [8];
+	__m128 b0, b1, a0, a1, sum;
+	Float_t total;
+	int i;
+
+	// coefficients of input[-10] ... input[-3] and output[-10] ... output[-3]
+	for ( i = 0; i < 8; i++ )
+	{
+		b[i] = kernel[2 * (10 - i)];
+		a[i] = kernel[2 * (10 - i) - 1];
+	}
+
+	b0 = _mm_loadu_ps ( b );
+	b1 = _mm_loadu_ps ( b + 4 );
+	a0 = _mm_loadu_ps ( a );
+	a1 = _mm_loadu_ps ( a + 4 );
+
+	while (nSamples--)
+	{
+		sum = _mm_add_ps ( _mm_mul_ps ( _mm_loadu_ps ( input - 10 ), b0 ), _mm_mul_ps ( _mm_loadu_ps ( input - 6 ), b1 ) );
+		sum = _mm_sub_ps ( sum, _mm_mul_ps ( _mm_loadu_ps ( output - 10 ), a0 ) );
+		sum = _mm_sub_ps ( sum, _mm_mul_ps ( _mm_loadu_ps ( output - 6 ), a1 ) );
+
+		// horizontal sum
+		sum = _mm_add_ps ( sum, _mm_movehl_ps ( sum, sum ) );
+		sum = _mm_add_ss ( sum, _mm_shuffle_ps ( sum, sum, 1 ) );
+		_mm_store_ss ( &total, sum );
+
+		*output = (Float_t)(1e-10  /* 1e-10 is a hack to avoid slowdown because of denormals */
+				+  input [0]  * kernel[0]
+		    - output[ -1] * kernel[1]
+		    + input [ -1] * kernel[2]
+		    - output[ -2] * kernel[3]
+		    + input [ -2] * kernel[4]
+		    + total);
+		++output;
+		++input;
+	}
+}
+
+#endif
+
 static void
 filterButter (const Float_t* input, Float_t* output, size_t nSamples, const Float_t* kernel)
 {
@@ -516,6 +578,19 @@ Float_t WAGetAlbumGain(void *context)
 	return analyzeResult(rg->B, sizeof(rg->B) / sizeof(*(rg->B)) );
 }
 
+// adds the loudness of the titles analyzed with track (after WAGetTitleGain) to the album of context
+
+DLLEXPORT
+void WAMergeAlbumGain(void *context, const void *track)
+{
+	ReplayGainContext *rg=context;
+	const ReplayGainContext *source=track;
+	int i;
+
+	for ( i = 0; i < (int)(sizeof(rg->B) / sizeof(*(rg->B))); i++ )
+		rg->B[i] += source->B[i];
+}
+
 DLLEXPORT
 void *WACreateRGContext()
 {
@@ -53,6 +53,7 @@ extern "C"
 	int	DLLEXPORT WAResetSampleFrequency ( void *context, long samplefreq );
 	Float_t DLLEXPORT WAGetTitleGain(void *context);
 	Float_t DLLEXPORT WAGetAlbumGain(void *context);
+	DLLEXPORT void WAMergeAlbumGain(void *context, const void *track);
 
 #ifdef __cplusplus
 }
@@ -1,7 +1,56 @@
 #include "../nde/NDE.h"
+#include "../nu/AutoWide.h"
 #include <iostream>
+#include <string>
 #include <time.h>
 using namespace std;
+
+#define COMPACTION_BLOAT 25 // percent of the table that has to be reclaimable before it is compacted
+#define COMPACTION_SLICE 10 // milliseconds the compaction thread holds the table at a time
+
+// the table is used by the query prompt and by the compaction thread, one at a time
+static CRITICAL_SECTION tableLock;
+static volatile LONG stopCompaction = 0;
+
+// compacts the table while the prompt waits for the next query. the thread runs at idle priority, it only gets
+// the processor when nothing else wants it, and gives the table back after every slice
+static DWORD WINAPI compactionThread(LPVOID param)
+{
+	Table *table = (Table *)param;
+	int done = 0;
+	while (!done && !stopCompaction)
+	{
+		EnterCriticalSection(&tableLock);
+		done = table->CompactionStep(COMPACTION_SLICE);
+		LeaveCriticalSection(&tableLock);
+		Sleep(0);
+	}
+	return 0;
+}
+
+// prints the counters of the table, the "stats" command of the query prompt
+static void printStats(Table *table)
+{
+	int hits, misses;
+	table->GetQueryCacheStats(&hits, &misses);
+	unsigned long size;
+	unsigned long reclaimable = table->ReclaimableBytes(&size);
+
+	cout << "number of records: " << table->GetRecordsCount() << endl;
+	cout << "query cache: " << hits << " hits, " << misses << " misses";
+	// queries with the shape of an earlier one skip the parser, see QueryCache
+	if (hits + misses > 0)
+		cout << ", hit rate " << (100 * hits / (hits + misses)) << "%";
+	cout << endl;
+	// deleted records and moved fields that a compaction would free
+	cout << "table: " << size << " bytes, " << reclaimable << " reclaimable";
+	if (size > 0)
+		cout << ", bloat " << (int)((double)reclaimable * 100 / size) << "%";
+	if (table->IsCompacting())
+		cout << ", compacting";
+	cout << endl;
+}
+
 int main()
 {
 
@@ -10,8 +59,9 @@ int main()
 	// open the media library's database by passing the filenames of the data file and index file
 	// we have to tell the database not to create the table and index
 	// paths are hardcoded for this example.
+	// the table is cached in memory, it can only be compacted in the background then
 	Table *table = db.OpenTable("C:/Documents and Settings/benski/Application Data/Winamp/Plugins/ml/main.dat", 
-		"C:/Documents and Settings/benski/Application Data/Winamp/Plugins/ml/main.idx", false, false);
+		"C:/Documents and Settings/benski/Application Data/Winamp/Plugins/ml/main.idx", false, true);
 
 	cout << "number of records: " << table->GetRecordsCount() << endl;
 
@@ -108,6 +158,71 @@ int main()
 		cout << "----------" << endl;
 	}
 
+	/*
+	then queries are read from the console, one per line, like the ones the search box of the media library makes
+	while you type: artist HAS "x"
+	"stats" prints the counters of the table, an empty line quits
+	a bloated table is compacted in the meantime. a query runs on a snapshot of the table, on a thread per processor,
+	the compaction goes on while it runs
+	*/
+	InitializeCriticalSection(&tableLock);
+	HANDLE compaction = NULL;
+	unsigned long size;
+	unsigned long reclaimable = table->ReclaimableBytes(&size);
+	if (size > 0 && (double)reclaimable * 100 / size >= COMPACTION_BLOAT && table->BeginCompaction())
+	{
+		compaction = CreateThread(NULL, 0, compactionThread, table, 0, NULL);
+		if (compaction)
+			SetThreadPriority(compaction, THREAD_PRIORITY_IDLE);
+		else
+			table->CancelCompaction();
+	}
+
+	string line;
+	cout << "query: ";
+	while (getline(cin, line) && !line.empty())
+	{
+		if (line == "stats")
+		{
+			EnterCriticalSection(&tableLock);
+			printStats(table);
+			LeaveCriticalSection(&tableLock);
+		}
+		else
+		{
+			EnterCriticalSection(&tableLock);
+			Snapshot *snapshot = table->NewSnapshot();
+			LeaveCriticalSection(&tableLock);
+
+			int found;
+			int *ids = snapshot ? snapshot->Query(AutoWide(line.c_str()), &found) : NULL;
+			if (ids)
+			{
+				cout << found << " matching records" << endl;
+				free(ids);
+			}
+			else
+				cout << "invalid query" << endl;
+
+			// the shape of the query has been cached on this thread, the table is only locked for the snapshot
+			EnterCriticalSection(&tableLock);
+			if (snapshot)
+				table->DeleteSnapshot(snapshot);
+			LeaveCriticalSection(&tableLock);
+		}
+		cout << "query: ";
+	}
+
+	// a compaction that hasn't finished is given up, the table stays as it was
+	if (compaction)
+	{
+		InterlockedExchange(&stopCompaction, 1);
+		WaitForSingleObject(compaction, INFINITE);
+		CloseHandle(compaction);
+		table->CancelCompaction();
+	}
+	DeleteCriticalSection(&tableLock);
+
 	// cleanup
 	table->DeleteScanner(scanner);
 	db.CloseTable(table);
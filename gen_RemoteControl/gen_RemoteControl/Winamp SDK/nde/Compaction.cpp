@@ -0,0 +1,234 @@
+/* ---------------------------------------------------------------------------
+                           Nullsoft Database Engine
+                             --------------------
+                        codename: Near Death Experience
+--------------------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------------------
+
+ Compaction Class
+
+--------------------------------------------------------------------------- */
+
+#include "NDE.h"
+
+//---------------------------------------------------------------------------
+Compaction::Compaction(VFILE *_Source)
+{
+	Source = _Source;
+	Cursor = 0;
+	Failed = FALSE;
+	Touched = NULL;
+	NTouched = 0;
+	MaxTouched = 0;
+	MapSize = COMPACTION_MAP_SIZE;
+	MapCount = 0;
+	Keys = (int *)calloc(MapSize, sizeof(int));
+	Values = (int *)calloc(MapSize, sizeof(int));
+
+	// the live records fit in the size of the table, the region rarely grows
+	Size = (unsigned long)strlen(__TABLE_SIGNATURE__);
+	MaxSize = (Source->filesize + VFILE_INC-1)&~(VFILE_INC-1);
+	if (MaxSize < Size) MaxSize = VFILE_INC;
+	Data = (unsigned char *)malloc(MaxSize);
+	if (Data)
+		memcpy(Data, __TABLE_SIGNATURE__, Size);
+}
+
+//---------------------------------------------------------------------------
+Compaction::~Compaction()
+{
+	free(Data);
+	free(Touched);
+	free(Keys);
+	free(Values);
+}
+
+//---------------------------------------------------------------------------
+BOOL Compaction::IsValid(void)
+{
+	return Data && Keys && Values;
+}
+
+//---------------------------------------------------------------------------
+// Follows the redirectors from Pos to the field, returns its position and
+// reads its size on disk and the position of the next field. Returns 0 if
+// the field is outside the table.
+int Compaction::Resolve(VFILE *Source, int Pos, size_t *Size, int *Next)
+{
+	for (int n=0;n<COMPACTION_FIELD_LIMIT;n++)
+	{
+		if (Pos <= 0 || (unsigned long)Pos + 2 + sizeof(int) > Source->filesize)
+			return 0;
+		unsigned char *p = Source->data + Pos;
+		if (p[1] == FIELD_REDIRECTOR)
+		{
+			memcpy(&Pos, p + 2, sizeof(int));
+			continue;
+		}
+		if ((unsigned long)Pos + COMPACTION_FIELD_HEADER > Source->filesize)
+			return 0;
+		memcpy(Size, p + 2, sizeof(size_t));
+		memcpy(Next, p + COMPACTION_NEXT_OFFSET, sizeof(int));
+		if (*Size > Source->filesize - Pos - COMPACTION_FIELD_HEADER)
+			return 0;
+		return Pos;
+	}
+	return 0;
+}
+
+//---------------------------------------------------------------------------
+// Bytes of the fields of the record at Pos, without redirectors
+unsigned long Compaction::RecordSize(VFILE *Source, int Pos)
+{
+	unsigned long Total = 0;
+	for (int n=0;Pos && n<COMPACTION_FIELD_LIMIT;n++)
+	{
+		size_t Size;
+		int Next;
+		if (!Resolve(Source, Pos, &Size, &Next))
+			break;
+		Total += (unsigned long)(COMPACTION_FIELD_HEADER + Size);
+		Pos = Next;
+	}
+	return Total;
+}
+
+//---------------------------------------------------------------------------
+unsigned char *Compaction::Alloc(unsigned long Length)
+{
+	if (Size + Length > MaxSize)
+	{
+		unsigned long NewSize = (Size + Length + VFILE_INC-1)&~(VFILE_INC-1);
+		unsigned char *NewData = (unsigned char *)realloc(Data, NewSize);
+		if (!NewData)
+			return NULL;
+		Data = NewData;
+		MaxSize = NewSize;
+	}
+	unsigned char *p = Data + Size;
+	Size += Length;
+	return p;
+}
+
+//---------------------------------------------------------------------------
+// Copies the fields of the record at Pos behind the region, one after the
+// other. Returns the position of the copy or 0 if the record is broken or
+// there isn't enough memory.
+int Compaction::CopyRecord(int Pos)
+{
+	int Head = 0;
+	int Last = 0;
+	for (int n=0;Pos && n<COMPACTION_FIELD_LIMIT;n++)
+	{
+		size_t FieldSize;
+		int Next;
+		int FieldPos = Resolve(Source, Pos, &FieldSize, &Next);
+		if (!FieldPos)
+			return 0;
+
+		unsigned long Length = (unsigned long)(COMPACTION_FIELD_HEADER + FieldSize);
+		int NewPos = (int)Size;
+		unsigned char *Copy = Alloc(Length);
+		if (!Copy)
+			return 0;
+		memcpy(Copy, Source->data + FieldPos, Length);
+
+		int Zero = 0;
+		memcpy(Copy + COMPACTION_NEXT_OFFSET, &Zero, sizeof(int));
+		memcpy(Copy + COMPACTION_PREVIOUS_OFFSET, &Last, sizeof(int));
+		if (Last)
+			memcpy(Data + Last + COMPACTION_NEXT_OFFSET, &NewPos, sizeof(int));
+		else
+			Head = NewPos;
+
+		Put(Pos, NewPos);
+		if (FieldPos != Pos)
+			Put(FieldPos, NewPos);
+		Last = NewPos;
+		Pos = Next;
+	}
+	return Failed ? 0 : Head;
+}
+
+//---------------------------------------------------------------------------
+// Position of the copy of the field at Pos, 0 if it hasn't been copied
+int Compaction::Translate(int Pos)
+{
+	if (Pos <= 0)
+		return 0;
+	unsigned int Slot = ((unsigned int)Pos * 2654435761U) & (MapSize-1);
+	while (Keys[Slot])
+	{
+		if (Keys[Slot] == Pos)
+			return Values[Slot];
+		Slot = (Slot+1) & (MapSize-1);
+	}
+	return 0;
+}
+
+//---------------------------------------------------------------------------
+void Compaction::Put(int Key, int Value)
+{
+	if ((MapCount+1)*2 > MapSize)
+		GrowMap();
+	if (MapCount+1 >= MapSize)
+	{
+		Failed = TRUE;
+		return;
+	}
+	unsigned int Slot = ((unsigned int)Key * 2654435761U) & (MapSize-1);
+	while (Keys[Slot] && Keys[Slot] != Key)
+		Slot = (Slot+1) & (MapSize-1);
+	if (!Keys[Slot])
+		MapCount++;
+	Keys[Slot] = Key;
+	Values[Slot] = Value;
+}
+
+//---------------------------------------------------------------------------
+void Compaction::GrowMap(void)
+{
+	int *OldKeys = Keys;
+	int *OldValues = Values;
+	int OldSize = MapSize;
+	int *NewKeys = (int *)calloc(OldSize*2, sizeof(int));
+	int *NewValues = (int *)calloc(OldSize*2, sizeof(int));
+	if (!NewKeys || !NewValues)
+	{
+		free(NewKeys);
+		free(NewValues);
+		return;
+	}
+	Keys = NewKeys;
+	Values = NewValues;
+	MapSize = OldSize*2;
+	MapCount = 0;
+	for (int i=0;i<OldSize;i++)
+		if (OldKeys[i])
+			Put(OldKeys[i], OldValues[i]);
+	free(OldKeys);
+	free(OldValues);
+}
+
+//---------------------------------------------------------------------------
+// Remembers that the record at Pos has been written, it is copied again
+// before the region replaces the table
+void Compaction::Touch(int Pos)
+{
+	if (Pos <= 0)
+		return;
+	if (NTouched == MaxTouched)
+	{
+		int NewMax = MaxTouched ? MaxTouched*2 : 64;
+		int *NewTouched = (int *)realloc(Touched, NewMax*sizeof(int));
+		if (!NewTouched)
+		{
+			Failed = TRUE;
+			return;
+		}
+		Touched = NewTouched;
+		MaxTouched = NewMax;
+	}
+	Touched[NTouched++] = Pos;
+}
@@ -0,0 +1,61 @@
+/* ---------------------------------------------------------------------------
+                           Nullsoft Database Engine
+                             --------------------
+                        codename: Near Death Experience
+--------------------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------------------
+
+ Compaction Class Prototypes
+
+--------------------------------------------------------------------------- */
+
+#ifndef __COMPACTION_H
+#define __COMPACTION_H
+
+// a field on disk: id, type, size on disk, position of the next and of the previous field, data
+#define COMPACTION_NEXT_OFFSET (2+sizeof(size_t))
+#define COMPACTION_PREVIOUS_OFFSET (COMPACTION_NEXT_OFFSET+sizeof(int))
+#define COMPACTION_FIELD_HEADER (COMPACTION_PREVIOUS_OFFSET+sizeof(int))
+
+#define COMPACTION_FIELD_LIMIT 256 // fields of a record and redirections of a field, stops at broken chains
+#define COMPACTION_MAP_SIZE 1024 // initial slots of the position map, a power of two
+
+// state of an incremental compaction, see Table::BeginCompaction. the records are copied field by
+// field into a new region without the space of deleted records, moved fields and redirectors. the
+// map remembers where every copied field went, so the indexes and the loaded records can be pointed
+// to the copies when the region replaces the table. records written after they were copied are
+// touched and copied again before that
+class Compaction
+{
+	public:
+		Compaction(VFILE *Source);
+		~Compaction();
+		BOOL IsValid(void);
+		int CopyRecord(int Pos);
+		int Translate(int Pos);
+		void Touch(int Pos);
+		static int Resolve(VFILE *Source, int Pos, size_t *Size, int *Next);
+		static unsigned long RecordSize(VFILE *Source, int Pos);
+
+		unsigned char *Data;
+		unsigned long Size;
+		unsigned long MaxSize;
+		int Cursor; // next entry of the primary index to copy
+		int *Touched;
+		int NTouched;
+		BOOL Failed; // out of memory, the map or the touched records are incomplete
+
+	private:
+		VFILE *Source;
+		int MaxTouched;
+		int *Keys;
+		int *Values;
+		int MapSize;
+		int MapCount;
+		unsigned char *Alloc(unsigned long Length);
+		void Put(int Key, int Value);
+		void GrowMap(void);
+};
+
+#endif
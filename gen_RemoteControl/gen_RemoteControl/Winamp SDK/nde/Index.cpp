@@ -20,8 +20,6 @@ char *iSign="NDEINDEX";
 Index::Index(VFILE *H, unsigned char id, int pos, int type, BOOL newindex, int nentries, Table *parentTable)
 {
 	Handle = H;
-	IndexTable = NULL;
-	MaxSize=0;
 	Modified = FALSE;
 	locateUpToDate = FALSE;
 	Id = id;
@@ -48,8 +46,6 @@ Index::Index(VFILE *H, unsigned char id, int pos, int type, BOOL newindex, int n
 //---------------------------------------------------------------------------
 Index::~Index()
 {
-	if (IndexTable)
-		free(IndexTable);
 }
 
 //---------------------------------------------------------------------------
@@ -70,26 +66,15 @@ int Index::Insert(Index *parindex, int N, BOOL localonly)
 	SetGlobalLocateUpToDate(FALSE);
 	InInsert=TRUE;
 	if (N > NEntries) N = NEntries;
-	if ((int)(NEntries+1) > MaxSize)
-	{
-		int *newBlock;
-		MaxSize *=2;//+= BLOCK_SIZE;
-		newBlock = (int *)calloc(MaxSize, sizeof(int)*2);
-		memcpy(newBlock, IndexTable, NEntries*sizeof(int)*2);
-		free(IndexTable);
-		IndexTable = newBlock;
-	}
 
+	// the new entry starts as a copy of the one it pushes back, like the shifted array did
+	IndexEntry NewEntry = { 0, 0 };
 	if (N < NEntries && Id == PRIMARY_INDEX)
-	{
-		memmove(IndexTable+(N+1)*2, IndexTable+(N*2), (NEntries-N)*sizeof(int)*2);
-		NEntries++;
-	}
+		NewEntry = *Tree.Get(N);
 	else
-	{
 		N=NEntries;
-		NEntries++;
-	}
+	Tree.Insert(N, &NewEntry);
+	NEntries++;
 
 	Update(N, 0, NULL, localonly);
 
@@ -102,7 +87,7 @@ int Index::Insert(Index *parindex, int N, BOOL localonly)
 		InChain=TRUE;
 		pp = SecIndex->index->Insert(this, N, FALSE);
 		InChain=FALSE;
-		IndexTable[N*2+1] = pp == -1 ? N : pp;
+		Tree.Get(N)->Cooperative = pp == -1 ? N : pp;
 		if (N < NEntries-1 && Id == PRIMARY_INDEX)
 		{
 			if (!parindex)
@@ -135,17 +120,23 @@ int Index::Insert(Index *parindex, int N, BOOL localonly)
 //---------------------------------------------------------------------------
 void Index::LoadIndex(BOOL newindex)
 {
-	if (IndexTable)
-		free(IndexTable);
-	MaxSize = ((NEntries) / BLOCK_SIZE + 1) * BLOCK_SIZE;
-	IndexTable = (int *)calloc(MaxSize, sizeof(int)*2);
 	if (!newindex)
 	{
 		Vfseek(Handle, (int)strlen(__INDEX_SIGNATURE__)+4+((NEntries*4*2)+4)*(Position+1), SEEK_SET);
 		int v;
 		Vfread(&v, sizeof(v), 1, Handle);
 		Id = (unsigned char)v;
-		Vfread(IndexTable, NEntries*2, sizeof(int), Handle);
+
+		// the entries are read in one block and the tree is built from them bottom up
+		IndexEntry *Entries = (IndexEntry *)calloc(max(NEntries, 1), sizeof(IndexEntry));
+		Vfread(Entries, NEntries*2, sizeof(int), Handle);
+		Tree.Load(Entries, NEntries);
+		free(Entries);
+	}
+	else
+	{
+		Tree.Clear();
+		Tree.Resize(NEntries);
 	}
 }
 
@@ -162,17 +153,17 @@ int Index::Update(Index *parindex, int paridx, int Idx, int Pos, Record *record,
 	int oldSecPtr;
 	int state;
 	if (InChain) return InChainIdx;
-	oldSecPtr = IndexTable[Idx*2+1];
+	oldSecPtr = (Idx >= 0 && Idx < NEntries) ? Tree.Get(Idx)->Cooperative : 0;
 	if (!forceLast && Id == PRIMARY_INDEX || record == NULL || Idx < 2)
 	{
 		if (Idx < NEntries && Idx >= 0)
 		{
-			IndexTable[Idx*2] = Pos;
+			Tree.Get(Idx)->Pos = Pos;
 			if (!localonly && SecIndex && SecIndex->index != this && !InInsert)
 			{
 				InChain=TRUE;
 				InChainIdx = Idx;
-				SecIndex->index->Update(this, Idx, IndexTable[Idx*2+1], Pos, record, forceLast, FALSE);
+				SecIndex->index->Update(this, Idx, Tree.Get(Idx)->Cooperative, Pos, record, forceLast, FALSE);
 				InChainIdx = -1;
 				InChain=FALSE;
 			}
@@ -225,7 +216,7 @@ int Index::Update(Index *parindex, int paridx, int Idx, int Pos, Record *record,
 					}
 				}
 			}
-			IndexTable[NewIdx*2] = Pos;
+			Tree.Get(NewIdx)->Pos = Pos;
 			if (!localonly && SecIndex && SecIndex->index != this && !InInsert) // Actually, we should never be InInsert and here, but lets cover our ass
 			{
 				InChain=TRUE;
@@ -254,8 +245,8 @@ int Index::Update(Index *parindex, int paridx, int Idx, int Pos, Record *record,
 //---------------------------------------------------------------------------
 int Index::Get(int Idx)
 {
-	if (Idx < NEntries)
-		return IndexTable[Idx*2];
+	if (Idx < NEntries && Idx >= 0)
+		return Tree.Get(Idx)->Pos;
 	else
 	{
 #ifdef WIN32
@@ -270,8 +261,8 @@ int Index::Get(int Idx)
 //---------------------------------------------------------------------------
 void Index::Set(int Idx, int P)
 {
-	if (Idx < NEntries)
-		IndexTable[Idx*2]=P;
+	if (Idx < NEntries && Idx >= 0)
+		Tree.Get(Idx)->Pos=P;
 	else
 	{
 #ifdef WIN32
@@ -293,7 +284,14 @@ void Index::WriteIndex(void)
 	Vfseek(Handle, (int)strlen(__INDEX_SIGNATURE__)+4+((NEntries*4*2)+4)*(Position+1), SEEK_SET);
 	int v=(int)Id;
 	Vfwrite(&v, sizeof(v), 1, Handle);
-	Vfwrite(IndexTable, NEntries*2, sizeof(int), Handle);
+
+	// the entries of a leaf are contiguous and laid out like the file
+	int run;
+	for (int i=0;i<NEntries;i+=run)
+	{
+		IndexEntry *Entries = Tree.GetRun(i, &run);
+		Vfwrite(Entries, run*2, sizeof(int), Handle);
+	}
 	Modified=FALSE;
 }
 
@@ -302,16 +300,11 @@ int Index::MoveIndex(int idx, int newidx)
 {
 	if (idx == newidx)
 		return newidx;
-	int oldPos=IndexTable[idx*2], oldPtr=IndexTable[idx*2+1];
-
-	if (NEntries > idx+1)
-		memmove(IndexTable+idx*2, IndexTable+(idx+1)*2, (NEntries-idx)*sizeof(int)*2);
+	IndexEntry Moved;
+	Tree.Remove(idx, &Moved);
 	if (newidx > idx)
 		newidx--;
-	if (NEntries > newidx)
-		memmove(IndexTable+(newidx+1)*2, IndexTable+newidx*2, (NEntries-newidx-1)*sizeof(int)*2);
-	IndexTable[newidx*2] = oldPos;
-	IndexTable[newidx*2+1] = oldPtr;
+	Tree.Insert(newidx, &Moved);
 	return newidx;
 }
 
@@ -334,7 +327,7 @@ void Index::Propagate(void)
 	Record *rec;
 
 	if (!SecIndex || SecIndex->ID == PRIMARY_INDEX) return;
-	SecIndex->index->NEntries=2;
+	SecIndex->index->Resize(2);
 	for (i=0;i<2;i++)
 	{
 		SecIndex->index->Set(i, Get(i));
@@ -386,7 +379,7 @@ void Index::Propagate(void)
 		rec = s->GetRecord(coopSave[i]);
 		if (rec)
 		{
-			SecIndex->index->NEntries++;
+			SecIndex->index->Resize(SecIndex->index->NEntries+1);
 			//    SecIndex->index->Insert(NULL, i, TRUE);
 			SecIndex->index->SetCooperative(i, coopSave[i]);
 			SecIndex->index->Set(i, Get(i));
@@ -422,7 +415,7 @@ void Index::Propagate(void)
 void Index::SetCooperative(int Idx, int secpos)
 {
 if (Idx < NEntries && Idx >= 0)
-  IndexTable[Idx*2+1] = secpos;
+  Tree.Get(Idx)->Cooperative = secpos;
 else
   {
   #ifdef WIN32
@@ -437,7 +430,7 @@ else
 int Index::GetCooperative(int Idx)
 {
 if (Idx < NEntries && Idx >= 0)
-  return IndexTable[Idx*2+1];
+  return Tree.Get(Idx)->Cooperative;
 else
   {
   #ifdef WIN32
@@ -452,7 +445,7 @@ return -1;
 //---------------------------------------------------------------------------
 int Index::NeedFix() {
   for (int i=2;i<NEntries;i++) {
-    if (IndexTable[i*2+1] <= 0) return 1;
+    if (Tree.Get(i)->Cooperative <= 0) return 1;
   }
   return 0;
 }
@@ -838,9 +831,18 @@ void Index::Shrink(void)
 		SecIndex->index->Shrink();
 		InChain=FALSE;
 	}
+	Tree.Remove(NEntries-1, NULL);
 	NEntries--;
 }
 
+//---------------------------------------------------------------------------
+// sets the number of entries, new ones are zero
+void Index::Resize(int N)
+{
+	Tree.Resize(N);
+	NEntries = N;
+}
+
 //---------------------------------------------------------------------------
 void Index::SetGlobalLocateUpToDate(BOOL isUptodate) {
   if (!pTable) return;
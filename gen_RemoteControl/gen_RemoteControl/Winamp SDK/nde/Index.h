@@ -20,14 +20,13 @@
 #include <unistd.h>
 #endif
 
-#define BLOCK_SIZE 2048 // 8192 entries blocks
-
 class Index : public LinkedListEntry
 	{
 	friend class Record;
 	friend class Table;
 	friend class IndexField;
 	friend class Scanner;
+	friend class Snapshot;
 
 	protected:
 
@@ -46,8 +45,7 @@ class Index : public LinkedListEntry
 		int Update(int Idx, int Pos, Record *record, BOOL localonly);
 		int Update(Index *parindex, int paridx, int Idx, int Pos, Record *record, BOOL forceLast, BOOL localonly);
     unsigned char GetId();
-		int *IndexTable;
-		int MaxSize;
+		IndexTree Tree;
 		unsigned char Id;
 		BOOL Modified;
 		BOOL InChain;
@@ -69,6 +67,7 @@ class Index : public LinkedListEntry
 		int TranslateIndex(int Pos, Index *index);
 		void Delete(int Idx, int Pos, Record *record);
 		void Shrink(void);
+		void Resize(int N);
 		BOOL locateUpToDate;
 		void Propagate(void);
     void SetGlobalLocateUpToDate(BOOL isUptodate);
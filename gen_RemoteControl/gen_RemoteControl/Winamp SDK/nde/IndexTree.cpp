@@ -0,0 +1,406 @@
+/* ---------------------------------------------------------------------------
+                           Nullsoft Database Engine
+                             --------------------
+                        codename: Near Death Experience
+--------------------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------------------
+
+ Index Tree Class
+
+--------------------------------------------------------------------------- */
+
+#include "NDE.h"
+
+// a leaf holds entries, an inner node its children. Total counts the entries below the node
+struct IndexTreeNode
+{
+	bool Leaf;
+	int Count;
+	int Total;
+	union
+	{
+		IndexEntry Entries[INDEXTREE_LEAF_SIZE];
+		IndexTreeNode *Children[INDEXTREE_NODE_SIZE];
+	};
+};
+
+//---------------------------------------------------------------------------
+IndexTree::IndexTree()
+{
+	Root = NULL;
+	CachedLeaf = NULL;
+	CachedStart = 0;
+}
+
+//---------------------------------------------------------------------------
+IndexTree::~IndexTree()
+{
+	Clear();
+}
+
+//---------------------------------------------------------------------------
+IndexTreeNode *IndexTree::NewNode(bool Leaf)
+{
+	IndexTreeNode *Node = (IndexTreeNode *)calloc(1, sizeof(IndexTreeNode));
+	Node->Leaf = Leaf;
+	return Node;
+}
+
+//---------------------------------------------------------------------------
+void IndexTree::FreeNode(IndexTreeNode *Node)
+{
+	if (!Node->Leaf)
+		for (int i=0;i<Node->Count;i++)
+			FreeNode(Node->Children[i]);
+	free(Node);
+}
+
+//---------------------------------------------------------------------------
+void IndexTree::Clear(void)
+{
+	if (Root)
+		FreeNode(Root);
+	Root = NULL;
+	CachedLeaf = NULL;
+}
+
+//---------------------------------------------------------------------------
+int IndexTree::GetCount(void)
+{
+	return Root ? Root->Total : 0;
+}
+
+//---------------------------------------------------------------------------
+IndexEntry *IndexTree::Get(int Idx)
+{
+	if (Idx < 0 || Idx >= GetCount())
+		return NULL;
+
+	// sequential reads stay in one leaf
+	if (CachedLeaf && Idx >= CachedStart && Idx < CachedStart + CachedLeaf->Count)
+		return &CachedLeaf->Entries[Idx - CachedStart];
+
+	IndexTreeNode *Node = Root;
+	int i = Idx;
+	while (!Node->Leaf)
+	{
+		int c = 0;
+		while (i >= Node->Children[c]->Total)
+		{
+			i -= Node->Children[c]->Total;
+			c++;
+		}
+		Node = Node->Children[c];
+	}
+
+	CachedLeaf = Node;
+	CachedStart = Idx - i;
+	return &Node->Entries[i];
+}
+
+//---------------------------------------------------------------------------
+// the entry Idx and the number of entries from it to the end of its leaf, they are contiguous
+IndexEntry *IndexTree::GetRun(int Idx, int *Run)
+{
+	IndexEntry *Entry = Get(Idx);
+	*Run = Entry ? CachedLeaf->Count - (Idx - CachedStart) : 0;
+	return Entry;
+}
+
+//---------------------------------------------------------------------------
+// moves the upper half of a full node to a new sibling, the totals of both are counted again
+IndexTreeNode *IndexTree::Split(IndexTreeNode *Node)
+{
+	IndexTreeNode *Sibling = NewNode(Node->Leaf);
+	int Half = Node->Count / 2;
+
+	Sibling->Count = Node->Count - Half;
+	Node->Count = Half;
+
+	if (Node->Leaf)
+	{
+		memcpy(Sibling->Entries, Node->Entries + Half, Sibling->Count * sizeof(IndexEntry));
+		Node->Total = Node->Count;
+		Sibling->Total = Sibling->Count;
+	}
+	else
+	{
+		memcpy(Sibling->Children, Node->Children + Half, Sibling->Count * sizeof(IndexTreeNode *));
+		Node->Total = 0;
+		Sibling->Total = 0;
+		for (int i=0;i<Node->Count;i++)
+			Node->Total += Node->Children[i]->Total;
+		for (int i=0;i<Sibling->Count;i++)
+			Sibling->Total += Sibling->Children[i]->Total;
+	}
+	return Sibling;
+}
+
+//---------------------------------------------------------------------------
+// inserts a child into an inner node that has room for it, the total is left to the caller
+void IndexTree::AddChild(IndexTreeNode *Node, int Pos, IndexTreeNode *Child)
+{
+	memmove(Node->Children + Pos + 1, Node->Children + Pos, (Node->Count - Pos) * sizeof(IndexTreeNode *));
+	Node->Children[Pos] = Child;
+	Node->Count++;
+}
+
+//---------------------------------------------------------------------------
+void IndexTree::Insert(int Idx, IndexEntry *Entry)
+{
+	if (Idx < 0 || Idx > GetCount())
+		return;
+
+	CachedLeaf = NULL;
+
+	if (!Root)
+		Root = NewNode(true);
+
+	IndexTreeNode *Sibling = InsertInto(Root, Idx, Entry);
+	if (Sibling)
+	{
+		IndexTreeNode *NewRoot = NewNode(false);
+		NewRoot->Children[0] = Root;
+		NewRoot->Children[1] = Sibling;
+		NewRoot->Count = 2;
+		NewRoot->Total = Root->Total + Sibling->Total;
+		Root = NewRoot;
+	}
+}
+
+//---------------------------------------------------------------------------
+// returns the new sibling of the node if it had to be split
+IndexTreeNode *IndexTree::InsertInto(IndexTreeNode *Node, int Idx, IndexEntry *Entry)
+{
+	if (Node->Leaf)
+	{
+		if (Node->Count == INDEXTREE_LEAF_SIZE)
+		{
+			IndexTreeNode *Sibling = Split(Node);
+			if (Idx <= Node->Count)
+				InsertInto(Node, Idx, Entry);
+			else
+				InsertInto(Sibling, Idx - Node->Count, Entry);
+			return Sibling;
+		}
+		memmove(Node->Entries + Idx + 1, Node->Entries + Idx, (Node->Count - Idx) * sizeof(IndexEntry));
+		Node->Entries[Idx] = *Entry;
+		Node->Count++;
+		Node->Total++;
+		return NULL;
+	}
+
+	// an entry behind the last one of a child is appended to it
+	int c = 0;
+	while (c < Node->Count-1 && Idx > Node->Children[c]->Total)
+	{
+		Idx -= Node->Children[c]->Total;
+		c++;
+	}
+
+	Node->Total++;
+	IndexTreeNode *NewChild = InsertInto(Node->Children[c], Idx, Entry);
+	if (!NewChild)
+		return NULL;
+
+	if (Node->Count < INDEXTREE_NODE_SIZE)
+	{
+		AddChild(Node, c+1, NewChild);
+		return NULL;
+	}
+
+	IndexTreeNode *Sibling = Split(Node);
+	if (c+1 <= Node->Count)
+	{
+		AddChild(Node, c+1, NewChild);
+		Node->Total += NewChild->Total;
+	}
+	else
+	{
+		AddChild(Sibling, c+1 - Node->Count, NewChild);
+		Sibling->Total += NewChild->Total;
+	}
+	return Sibling;
+}
+
+//---------------------------------------------------------------------------
+void IndexTree::Remove(int Idx, IndexEntry *Removed)
+{
+	if (Idx < 0 || Idx >= GetCount())
+		return;
+
+	CachedLeaf = NULL;
+
+	RemoveFrom(Root, Idx, Removed);
+
+	while (!Root->Leaf && Root->Count == 1)
+	{
+		IndexTreeNode *Child = Root->Children[0];
+		free(Root);
+		Root = Child;
+	}
+}
+
+//---------------------------------------------------------------------------
+void IndexTree::RemoveFrom(IndexTreeNode *Node, int Idx, IndexEntry *Removed)
+{
+	Node->Total--;
+
+	if (Node->Leaf)
+	{
+		if (Removed)
+			*Removed = Node->Entries[Idx];
+		memmove(Node->Entries + Idx, Node->Entries + Idx + 1, (Node->Count - Idx - 1) * sizeof(IndexEntry));
+		Node->Count--;
+		return;
+	}
+
+	int c = 0;
+	while (Idx >= Node->Children[c]->Total)
+	{
+		Idx -= Node->Children[c]->Total;
+		c++;
+	}
+
+	RemoveFrom(Node->Children[c], Idx, Removed);
+
+	int Size = Node->Children[c]->Leaf ? INDEXTREE_LEAF_SIZE : INDEXTREE_NODE_SIZE;
+	if (Node->Children[c]->Count < Size / 4)
+		Rebalance(Node, c);
+}
+
+//---------------------------------------------------------------------------
+// merges a child that has become small with a neighbour, or evens them out if they don't fit
+// into one node
+void IndexTree::Rebalance(IndexTreeNode *Node, int Child)
+{
+	if (Node->Count < 2)
+		return;
+
+	int c = Child > 0 ? Child-1 : Child;
+	IndexTreeNode *Left = Node->Children[c];
+	IndexTreeNode *Right = Node->Children[c+1];
+	bool Leaf = Left->Leaf;
+	int Size = Leaf ? INDEXTREE_LEAF_SIZE : INDEXTREE_NODE_SIZE;
+
+	if (Left->Count + Right->Count <= Size)
+	{
+		if (Leaf)
+			memcpy(Left->Entries + Left->Count, Right->Entries, Right->Count * sizeof(IndexEntry));
+		else
+			memcpy(Left->Children + Left->Count, Right->Children, Right->Count * sizeof(IndexTreeNode *));
+		Left->Count += Right->Count;
+		Left->Total += Right->Total;
+		free(Right);
+
+		memmove(Node->Children + c+1, Node->Children + c+2, (Node->Count - c-2) * sizeof(IndexTreeNode *));
+		Node->Count--;
+		return;
+	}
+
+	int Target = (Left->Count + Right->Count) / 2;
+	int Moved = 0;
+
+	if (Left->Count < Target)
+	{
+		// the first items of the right node go to the end of the left one
+		int n = Target - Left->Count;
+		if (Leaf)
+		{
+			memcpy(Left->Entries + Left->Count, Right->Entries, n * sizeof(IndexEntry));
+			memmove(Right->Entries, Right->Entries + n, (Right->Count - n) * sizeof(IndexEntry));
+			Moved = n;
+		}
+		else
+		{
+			for (int i=0;i<n;i++)
+				Moved += Right->Children[i]->Total;
+			memcpy(Left->Children + Left->Count, Right->Children, n * sizeof(IndexTreeNode *));
+			memmove(Right->Children, Right->Children + n, (Right->Count - n) * sizeof(IndexTreeNode *));
+		}
+		Left->Count += n;
+		Right->Count -= n;
+		Left->Total += Moved;
+		Right->Total -= Moved;
+	}
+	else
+	{
+		// the last items of the left node go to the front of the right one
+		int n = Left->Count - Target;
+		if (Leaf)
+		{
+			memmove(Right->Entries + n, Right->Entries, Right->Count * sizeof(IndexEntry));
+			memcpy(Right->Entries, Left->Entries + Target, n * sizeof(IndexEntry));
+			Moved = n;
+		}
+		else
+		{
+			for (int i=Target;i<Left->Count;i++)
+				Moved += Left->Children[i]->Total;
+			memmove(Right->Children + n, Right->Children, Right->Count * sizeof(IndexTreeNode *));
+			memcpy(Right->Children, Left->Children + Target, n * sizeof(IndexTreeNode *));
+		}
+		Left->Count -= n;
+		Right->Count += n;
+		Left->Total -= Moved;
+		Right->Total += Moved;
+	}
+}
+
+//---------------------------------------------------------------------------
+// zero entries are appended, entries at the end removed
+void IndexTree::Resize(int N)
+{
+	IndexEntry Zero = { 0, 0 };
+
+	while (GetCount() > N)
+		Remove(GetCount()-1, NULL);
+	while (GetCount() < N)
+		Insert(GetCount(), &Zero);
+}
+
+//---------------------------------------------------------------------------
+// builds the tree bottom up from the entries of an index file. the nodes are filled to three
+// quarters, so the first inserts don't split them
+void IndexTree::Load(IndexEntry *Entries, int N)
+{
+	Clear();
+	if (N <= 0)
+		return;
+
+	const int LeafFill = INDEXTREE_LEAF_SIZE * 3 / 4;
+	const int NodeFill = INDEXTREE_NODE_SIZE * 3 / 4;
+
+	int Count = (N + LeafFill - 1) / LeafFill;
+	IndexTreeNode **Level = (IndexTreeNode **)malloc(Count * sizeof(IndexTreeNode *));
+
+	for (int i=0;i<Count;i++)
+	{
+		IndexTreeNode *Leaf = NewNode(true);
+		Leaf->Count = min(LeafFill, N - i*LeafFill);
+		Leaf->Total = Leaf->Count;
+		memcpy(Leaf->Entries, Entries + i*LeafFill, Leaf->Count * sizeof(IndexEntry));
+		Level[i] = Leaf;
+	}
+
+	while (Count > 1)
+	{
+		int Parents = (Count + NodeFill - 1) / NodeFill;
+		for (int i=0;i<Parents;i++)
+		{
+			IndexTreeNode *Node = NewNode(false);
+			Node->Count = min(NodeFill, Count - i*NodeFill);
+			for (int j=0;j<Node->Count;j++)
+			{
+				Node->Children[j] = Level[i*NodeFill + j];
+				Node->Total += Node->Children[j]->Total;
+			}
+			Level[i] = Node;
+		}
+		Count = Parents;
+	}
+
+	Root = Level[0];
+	free(Level);
+}
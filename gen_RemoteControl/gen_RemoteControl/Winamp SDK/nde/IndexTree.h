@@ -0,0 +1,60 @@
+/* ---------------------------------------------------------------------------
+                           Nullsoft Database Engine
+                             --------------------
+                        codename: Near Death Experience
+--------------------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------------------
+
+ Index Tree Class Prototypes
+
+--------------------------------------------------------------------------- */
+
+#ifndef __INDEXTREE_H
+#define __INDEXTREE_H
+
+#define INDEXTREE_LEAF_SIZE 256 // entries of a leaf
+#define INDEXTREE_NODE_SIZE 64 // children of an inner node
+
+// one entry of an index, laid out like the pairs of the index file: the position of the record
+// in the table and its slot in the cooperative index
+struct IndexEntry
+{
+	int Pos;
+	int Cooperative;
+};
+
+struct IndexTreeNode;
+
+// B+tree of the index entries, addressed by their rank like the flat array it replaces. the inner
+// nodes count the entries below them, so Get, Insert and Remove descend in O(log n) instead of
+// shifting the entries behind the change. the leaf of the last Get is kept, runs of entries are
+// read from it without descending again
+class IndexTree
+{
+	public:
+		IndexTree();
+		~IndexTree();
+		int GetCount(void);
+		IndexEntry *Get(int Idx);
+		IndexEntry *GetRun(int Idx, int *Run);
+		void Insert(int Idx, IndexEntry *Entry);
+		void Remove(int Idx, IndexEntry *Removed);
+		void Resize(int N);
+		void Load(IndexEntry *Entries, int N);
+		void Clear(void);
+
+	private:
+		IndexTreeNode *Root;
+		IndexTreeNode *CachedLeaf;
+		int CachedStart;
+		static IndexTreeNode *NewNode(bool Leaf);
+		static void FreeNode(IndexTreeNode *Node);
+		static IndexTreeNode *Split(IndexTreeNode *Node);
+		static void AddChild(IndexTreeNode *Node, int Pos, IndexTreeNode *Child);
+		static IndexTreeNode *InsertInto(IndexTreeNode *Node, int Idx, IndexEntry *Entry);
+		static void RemoveFrom(IndexTreeNode *Node, int Idx, IndexEntry *Removed);
+		static void Rebalance(IndexTreeNode *Node, int Child);
+};
+
+#endif
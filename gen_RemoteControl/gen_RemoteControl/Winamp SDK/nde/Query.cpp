@@ -11,11 +11,43 @@ BOOL Scanner::Query(const char *query)
 BOOL Scanner::Query(const wchar_t *query)
 {
 	if (!query) return FALSE;
+
+	// a query with the shape of an earlier one gets its filters without being parsed
+	wchar_t **literals = NULL;
+	int nliterals = 0;
+	// the threads of a snapshot only read the cache, Snapshot::Query looks the shape up for them
+	wchar_t *shape = snapshot ? NULL : Query_Shape(query, &literals, &nliterals);
+	QueryShape *cached = shape ? pTable->QueryShapes.Find(shape) : NULL;
+	BOOL r = Query_Run(query, cached, literals, nliterals);
+
+	if (shape && !cached && r && FiltersOK)
+		Query_Remember(shape, nliterals);
+	else
+		free(shape);
+	Query_FreeLiterals(literals, nliterals);
+
+	return r;
+}
+
+//---------------------------------------------------------------------------
+// Sets the filters of a query, from the cached shape with the literals of
+// the query if there is one
+BOOL Scanner::Query_Run(const wchar_t *query, QueryShape *cached, wchar_t **literals, int nliterals)
+{
 	if (last_query) free(last_query);
 	last_query = wcsdup(query);
 	RemoveFilters();
 	in_query_parser = 1;
-	BOOL r = Query_Parse(query);
+
+	BOOL r = FALSE;
+	if (cached)
+	{
+		r = Query_Replay(cached, literals, nliterals);
+		if (r == FALSE)
+			RemoveFilters();
+	}
+	if (r == FALSE)
+		r = Query_Parse(query);
 	
 	if (r == FALSE)
 	{
@@ -24,7 +56,234 @@ BOOL Scanner::Query(const wchar_t *query)
 	}
 	in_query_parser = 0;
 	Query_CleanUp();
-	return r & CheckFilters();
+	BOOL checked = CheckFilters();
+	return r & checked;
+}
+
+//---------------------------------------------------------------------------
+void Scanner::Query_FreeLiterals(wchar_t **literals, int nliterals)
+{
+	for (int i=0;i<nliterals;i++)
+		free(literals[i]);
+	free(literals);
+}
+
+//---------------------------------------------------------------------------
+// The shape of a query: the kind of each token and the column names, with
+// the values compared with left out and returned in literals, in the order
+// Query_Parse gives them to the filters. Spaces and the spelling of the
+// operators don't matter. NULL if the query has a date format, its values
+// depend on the time it is run.
+wchar_t *Scanner::Query_Shape(const wchar_t *query, wchar_t ***literals, int *nliterals)
+{
+	size_t l = wcslen(query);
+	wchar_t *shape = (wchar_t *)malloc((l*3+2)*sizeof(wchar_t));
+	wchar_t **values = (wchar_t **)malloc((l+1)*sizeof(wchar_t *));
+	wchar_t *t = NULL;
+	const wchar_t *p = query;
+	int size, n = 0;
+	size_t k = 0;
+	BOOL value = FALSE;
+	BOOL valid = shape && values;
+
+	if (valid)
+		shape[k++] = disable_date_resolution ? L'1' : L'0';
+	while (valid)
+	{
+		p = Query_EatSpace(p);
+		int tid = Query_GetNextToken(p, &size, &t);
+		if (tid == TOKEN_EOQ)
+			break;
+		if (tid == TOKEN_UNKNOWN || tid == TOKEN_SQBRACKETOPEN)
+		{
+			valid = FALSE;
+			break;
+		}
+		if (value)
+		{
+			// whatever follows an operator is its value, like in state 2 of Query_Parse
+			shape[k++] = L'?';
+			values[n++] = wcsdup(t ? t : L"");
+			value = FALSE;
+		}
+		else
+		{
+			shape[k++] = (wchar_t)(tid + 2);
+			if (tid == TOKEN_IDENTIFIER)
+			{
+				size_t len = wcslen(t);
+				if (len >= 0xFFFF)
+				{
+					valid = FALSE;
+					break;
+				}
+				shape[k++] = (wchar_t)(len + 1);
+				memcpy(shape + k, t, len*sizeof(wchar_t));
+				k += len;
+			}
+			value = (tid >= TOKEN_EQUAL && tid <= TOKEN_AOREQUAL) || tid == TOKEN_CONTAINS || tid == TOKEN_NOTCONTAINS
+				|| tid == TOKEN_BEGINS || tid == TOKEN_ENDS || tid == TOKEN_LIKE || tid == TOKEN_BEGINSLIKE;
+		}
+		p += size;
+	}
+	if (t) free(t);
+
+	if (!valid)
+	{
+		while (n > 0)
+			free(values[--n]);
+		free(values);
+		free(shape);
+		*literals = NULL;
+		*nliterals = 0;
+		return NULL;
+	}
+	shape[k] = 0;
+	*literals = values;
+	*nliterals = n;
+	return shape;
+}
+
+//---------------------------------------------------------------------------
+// Adds the filters of a cached shape with the literals of the query
+BOOL Scanner::Query_Replay(QueryShape *shape, wchar_t **literals, int nliterals)
+{
+	int n = 0;
+	for (int i=0;i<shape->NSteps;i++)
+	{
+		QueryStep *s = shape->Steps + i;
+		if (s->Op < FILTER_NONE)
+		{
+			AddFilterOp(s->Op);
+			continue;
+		}
+		Field *data = NULL;
+		if (s->HasData)
+		{
+			if (n == nliterals)
+				return FALSE;
+			data = Query_NewData(s->DataType, literals[n++]);
+			if (!data)
+				return FALSE;
+		}
+		if (AddFilterById(s->Id, data, s->Op) == ADDFILTER_FAILED)
+		{
+			delete data;
+			return FALSE;
+		}
+	}
+	return n == nliterals;
+}
+
+//---------------------------------------------------------------------------
+// Caches the filters Query_Parse made under the shape of the query, takes
+// the shape
+void Scanner::Query_Remember(wchar_t *shape, int nliterals)
+{
+	int nsteps = FilterList.GetNElements();
+	QueryStep *steps = (QueryStep *)malloc(max(nsteps, 1)*sizeof(QueryStep));
+	if (!steps)
+	{
+		free(shape);
+		return;
+	}
+
+	int n = 0;
+	Filter *filter = (Filter *)FilterList.GetHead();
+	for (int i=0;i<nsteps && filter;i++)
+	{
+		QueryStep *s = steps + i;
+		s->Op = filter->GetOp();
+		s->Id = s->Op < FILTER_NONE ? 0 : (unsigned char)filter->GetId();
+		s->HasData = filter->Data() != NULL;
+		s->DataType = -1;
+		if (s->HasData)
+		{
+			ColumnField *c = GetColumnById(s->Id);
+			s->DataType = c ? c->GetDataType() : -1;
+			n++;
+		}
+		filter = (Filter *)filter->GetNext();
+	}
+
+	// every value has to come from a literal, or the shape missed one
+	if (n != nliterals)
+	{
+		free(steps);
+		free(shape);
+		return;
+	}
+	pTable->QueryShapes.Add(shape, steps, nsteps);
+}
+
+//---------------------------------------------------------------------------
+// The value of a filter on a column of the type, from a query token. NULL
+// if the columns of the type can't be compared with a query value.
+Field *Scanner::Query_NewData(int type, const wchar_t *value)
+{
+	switch (type)
+	{
+	case FIELD_DATETIME:
+		if (disable_date_resolution)
+			goto field_string_override;
+	case FIELD_LENGTH:
+	{
+		int i;
+		IntegerField *i_f = new IntegerField();
+		i = _wtoi(value); // todo: Replace with own conversion and error checking
+		const wchar_t *p;
+		if ((p=wcsstr(value,L":")))
+		{
+			i*=60;
+			i+=_wtoi(++p);
+			if ((p=wcsstr(p,L":")))
+			{
+				i*=60;
+				i+=_wtoi(++p);
+			}
+		}
+		i_f->SetValue(i);
+		return i_f;
+	}
+
+	case FIELD_BOOLEAN:
+	case FIELD_INTEGER:
+	{
+		int i;
+		IntegerField *i_f = new IntegerField();
+		i = _wtoi(value); // todo: Replace with own conversion and error checking
+		i_f->SetValue(i);
+		return i_f;
+	}
+	case FIELD_INT64:
+	{
+		int64_t i;
+		Int64Field *i_f = new Int64Field();
+		#ifdef _WIN32
+		i = _wtoi64(value); // todo: Replace with own conversion and error checking
+		#elif defined(__APPLE__)
+		i = wcstoll(value, 0, 10);
+		#else
+		#error port me
+		#endif
+		i_f->SetValue(i);
+		return i_f;
+	}
+	case FIELD_FILENAME:
+	{
+		FilenameField *s_f = new FilenameField();
+		s_f->SetStringW(value);
+		return s_f;
+	}
+	case FIELD_STRING:
+field_string_override:
+	{
+		StringField *s_f = new StringField();
+		s_f->SetStringW(value);
+		return s_f;
+	}
+	}
+	return NULL;
 }
 
 const wchar_t *Scanner::GetLastQuery()
@@ -361,78 +620,13 @@ BOOL Scanner::Query_Parse(const wchar_t *query)
 				Filter *f = GetLastFilter();
 				int id = f->GetId();
 				ColumnField *c = GetColumnById(id);
-				switch (c ? c->GetDataType() : -1)
-				{
-				case FIELD_DATETIME:
-					if (disable_date_resolution)
-						goto field_string_override;
-				case FIELD_LENGTH:
-				{
-					int i;
-					IntegerField *i_f = new IntegerField();
-					i = _wtoi(token); // todo: Replace with own conversion and error checking
-					wchar_t *p;
-					if ((p=wcsstr(token,L":")))
-					{
-						i*=60;
-						i+=_wtoi(++p);
-						if ((p=wcsstr(p,L":")))
-						{
-							i*=60;
-							i+=_wtoi(++p);
-						}
-					}
-					i_f->SetValue(i);
-					f->SetData(i_f);
-				}
-				break;
-
-				case FIELD_BOOLEAN:
-				case FIELD_INTEGER:
+				Field *data = Query_NewData(c ? c->GetDataType() : -1, token);
+				if (!data)
 				{
-					int i;
-					IntegerField *i_f = new IntegerField();
-					i = _wtoi(token); // todo: Replace with own conversion and error checking
-					i_f->SetValue(i);
-					f->SetData(i_f);
-				}
-				break;
-				case FIELD_INT64:
-				{
-					int64_t i;
-					Int64Field *i_f = new Int64Field();
-					#ifdef _WIN32
-					i = _wtoi64(token); // todo: Replace with own conversion and error checking
-					#elif defined(__APPLE__)
-					i = wcstoll(token, 0, 10);
-					#else
-					#error port me
-					#endif
-					i_f->SetValue(i);
-					f->SetData(i_f);
-				}
-				break;
-				case FIELD_FILENAME:
-					{
-						FilenameField *s_f = new FilenameField();
-						s_f->SetStringW(token);
-						f->SetData(s_f);
-					}
-					break;
-				case FIELD_STRING:
-field_string_override:
-					{
-						StringField *s_f = new StringField();
-						s_f->SetStringW(token);
-						f->SetData(s_f);
-					}
-					break;
-				default:
 					Query_SyntaxError((int)(p-query));
 					return FALSE;
-					break;
-
 				}
+				f->SetData(data);
 				// pop all operators in this level beginning by the last inserted
 				entry = (VListEntry<OpLevel> *)pstack.GetFoot();
 				while (entry)
@@ -29,6 +29,12 @@
     #define TOKEN_BEGINSLIKE     23 // string is nearly starts with (excluding "the " and whitespace etc)
 
     BOOL Query_Parse(const wchar_t *query);
+    wchar_t *Query_Shape(const wchar_t *query, wchar_t ***literals, int *nliterals);
+    BOOL Query_Replay(QueryShape *shape, wchar_t **literals, int nliterals);
+    BOOL Query_Run(const wchar_t *query, QueryShape *cached, wchar_t **literals, int nliterals);
+    static void Query_FreeLiterals(wchar_t **literals, int nliterals);
+    void Query_Remember(wchar_t *shape, int nliterals);
+    Field *Query_NewData(int type, const wchar_t *value);
     static int Query_LookupToken(wchar_t *token);
     void Query_CleanUp(void);
     void Query_SyntaxError(int c);
@@ -0,0 +1,92 @@
+/* ---------------------------------------------------------------------------
+                           Nullsoft Database Engine
+                             --------------------
+                        codename: Near Death Experience
+--------------------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------------------
+
+ Query Cache Class
+
+--------------------------------------------------------------------------- */
+
+#include "NDE.h"
+
+//---------------------------------------------------------------------------
+QueryCache::QueryCache()
+{
+	memset(Shapes, 0, sizeof(Shapes));
+	Clock = 0;
+	Hits = 0;
+	Misses = 0;
+}
+
+//---------------------------------------------------------------------------
+QueryCache::~QueryCache()
+{
+	Clear();
+}
+
+//---------------------------------------------------------------------------
+// Counts a hit or a miss, the shape found is the most recently used then
+QueryShape *QueryCache::Find(const wchar_t *Key)
+{
+	for (int i=0;i<QUERYCACHE_SIZE;i++)
+	{
+		if (Shapes[i].Key && !wcscmp(Shapes[i].Key, Key))
+		{
+			Hits++;
+			Shapes[i].Used = ++Clock;
+			return Shapes + i;
+		}
+	}
+	Misses++;
+	return NULL;
+}
+
+//---------------------------------------------------------------------------
+// Takes Key and Steps, they are freed with the shape
+void QueryCache::Add(wchar_t *Key, QueryStep *Steps, int NSteps)
+{
+	int Slot = 0;
+	for (int i=0;i<QUERYCACHE_SIZE;i++)
+	{
+		if (!Shapes[i].Key)
+		{
+			Slot = i;
+			break;
+		}
+		if (Shapes[i].Used < Shapes[Slot].Used)
+			Slot = i;
+	}
+	free(Shapes[Slot].Key);
+	free(Shapes[Slot].Steps);
+	Shapes[Slot].Key = Key;
+	Shapes[Slot].Steps = Steps;
+	Shapes[Slot].NSteps = NSteps;
+	Shapes[Slot].Used = ++Clock;
+}
+
+//---------------------------------------------------------------------------
+// Forgets the shapes, the columns they were parsed for have changed
+void QueryCache::Clear(void)
+{
+	for (int i=0;i<QUERYCACHE_SIZE;i++)
+	{
+		free(Shapes[i].Key);
+		free(Shapes[i].Steps);
+	}
+	memset(Shapes, 0, sizeof(Shapes));
+}
+
+//---------------------------------------------------------------------------
+int QueryCache::GetHits(void)
+{
+	return Hits;
+}
+
+//---------------------------------------------------------------------------
+int QueryCache::GetMisses(void)
+{
+	return Misses;
+}
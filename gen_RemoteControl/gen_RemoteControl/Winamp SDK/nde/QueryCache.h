@@ -0,0 +1,56 @@
+/* ---------------------------------------------------------------------------
+                           Nullsoft Database Engine
+                             --------------------
+                        codename: Near Death Experience
+--------------------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------------------
+
+ Query Cache Class Prototypes
+
+--------------------------------------------------------------------------- */
+
+#ifndef __QUERYCACHE_H
+#define __QUERYCACHE_H
+
+#define QUERYCACHE_SIZE 32 // query shapes a table keeps, the least recently used one is replaced
+
+// one filter of a parsed query as it was added to the filter list. a filter with data takes the next
+// literal of the query, converted for the type of its column, an operator filter only has its op
+struct QueryStep
+{
+	unsigned char Id;
+	unsigned char Op;
+	BOOL HasData;
+	int DataType;
+};
+
+struct QueryShape
+{
+	wchar_t *Key;
+	QueryStep *Steps;
+	int NSteps;
+	unsigned int Used;
+};
+
+// parsed queries of a table by their shape, the tokens of the query without the values compared
+// with, see Scanner::Query_Shape. a query with a known shape gets its filters without being parsed
+class QueryCache
+{
+	public:
+		QueryCache();
+		~QueryCache();
+		QueryShape *Find(const wchar_t *Key);
+		void Add(wchar_t *Key, QueryStep *Steps, int NSteps);
+		void Clear(void);
+		int GetHits(void);
+		int GetMisses(void);
+
+	private:
+		QueryShape Shapes[QUERYCACHE_SIZE];
+		unsigned int Clock;
+		int Hits;
+		int Misses;
+};
+
+#endif
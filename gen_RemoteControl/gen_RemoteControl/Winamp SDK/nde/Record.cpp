@@ -35,6 +35,7 @@ if (RecordPos != NULL)
 			break;
 		Vfseek(HTable, ThisPos, SEEK_SET);
 		Field Entry (ThisPos, ParentTable);
+		Entry.HTable = HTable;
 		Field *TypedEntry = Entry.ReadField(ThisPos);
 		Entry.SetDeletable();
 
@@ -102,6 +103,9 @@ if (RecordIndex == NEW_RECORD)
 	RecordIndex = ParentTable->dScanner->index->Insert(InsertionPoint);
 if (Fields.GetNElements())
 	P=((Field *)Fields.GetHead())->GetFieldPos();
+// a compaction that copied the record already has to copy it again
+if (ParentTable->compaction)
+	ParentTable->compaction->Touch(P);
 RecordIndex = ParentTable->dScanner->index->Update(RecordIndex, P, this, FALSE);
 }
 
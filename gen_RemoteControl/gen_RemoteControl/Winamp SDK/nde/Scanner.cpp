@@ -34,6 +34,15 @@ Scanner::Scanner(Table *parentTable, BOOL CanEdit, BOOL _orderIntegrity)
 	CurrentRecordIdx=0;
 	iModified = FALSE;
 	FiltersOK = FALSE;
+	Program = NULL;
+	ProgramSize = 0;
+	Candidates = NULL;
+	NCandidates = 0;
+	HasPlan = FALSE;
+	PlanPending = FALSE;
+	snapshot = NULL;
+	View = NULL;
+	SnapshotEnd = 0;
 	subtablecolumn = NULL;
 
 	/*inMatchJoins = 0;
@@ -60,18 +69,38 @@ Scanner::~Scanner()
 
 	Query_CleanUp();
 
+	ClearPlan();
+	if (Program) free(Program);
+
 	if (token) free(token);
 	if (last_query) free(last_query);
+	if (View) free(View);
 }
 
 //---------------------------------------------------------------------------
 Record *Scanner::GetRecord(int Idx)
 {
 	int Ptr;
-	Ptr = index->Get(Idx);
+	Ptr = EntryPos(Idx);
+	if (snapshot)
+		return new Record(Ptr, Idx, Idx, View, NULL, pTable, this);
 	return new Record(Ptr, Idx, Idx, pTable->Handle, pTable->IdxHandle, pTable, this);
 }
 
+//---------------------------------------------------------------------------
+int Scanner::EntryCount(void)
+{
+	return snapshot ? SnapshotEnd : index->NEntries;
+}
+
+//---------------------------------------------------------------------------
+int Scanner::EntryPos(int Idx)
+{
+	if (!snapshot)
+		return index->Get(Idx);
+	return Idx >= 0 && Idx < snapshot->NEntries ? snapshot->Positions[Idx] : -1;
+}
+
 //---------------------------------------------------------------------------
 void Scanner::GetCurrentRecord(void)
 {
@@ -89,7 +118,7 @@ void Scanner::GetCurrentRecord(void)
 //---------------------------------------------------------------------------
 void Scanner::GetRecordById(int Id, BOOL checkFilters)
 {
-	CurrentRecordIdx=max(min(index->NEntries, Id+2), 0);
+	CurrentRecordIdx=max(min(EntryCount(), Id+2), 0);
 	GetCurrentRecord();
 	if (!checkFilters || MatchFilters())
 		return;
@@ -113,6 +142,8 @@ int Scanner::Next(int force_block, int *killswitch)
 	while (!Eof() && !Bof())
 	{
 		CurrentRecordIdx++;
+		if (!IsCandidate(CurrentRecordIdx))
+			continue;
 		GetCurrentRecord();
 		if (MatchFilters())
 			break;
@@ -133,6 +164,8 @@ int Scanner::Previous(int force_block, int *killswitch)
 	while (CurrentRecordIdx >= 2)
 	{
 		CurrentRecordIdx--;
+		if (!IsCandidate(CurrentRecordIdx))
+			continue;
 		GetCurrentRecord();
 		if (MatchFilters())
 			break;
@@ -149,12 +182,12 @@ int Scanner::Previous(int force_block, int *killswitch)
 void Scanner::Last(int *killswitch)
 {
 	if (last_query_failed) return;
-	GetRecordById(index->NEntries-3); // -3 here because 1)GetRecordById is public, so -2, and 2)last entry is nentries-1, so -1
+	GetRecordById(EntryCount()-3); // -3 here because 1)GetRecordById is public, so -2, and 2)last entry is nentries-1, so -1
 	if (!MatchFilters() && !Bof())
 		Previous(1,killswitch);
 	if (CurrentRecordIdx < 2)
 	{
-		CurrentRecordIdx = index->NEntries;
+		CurrentRecordIdx = EntryCount();
 		GetCurrentRecord(); // will only delete current record if it exists
 	}
 }
@@ -163,7 +196,7 @@ void Scanner::Last(int *killswitch)
 BOOL Scanner::Eof(void)
 {
 	if (last_query_failed) return TRUE;
-	return CurrentRecordIdx >= index->NEntries;
+	return CurrentRecordIdx >= EntryCount();
 }
 
 //---------------------------------------------------------------------------
@@ -400,7 +433,8 @@ BOOL Scanner::LocateByIdEx(int Id, int From, Field *field, int *nskip, int comp_
 	int n;
 	Field *cfV;
 
-	if (index->NEntries == 2)
+	// the indexes of the table aren't copied into a snapshot
+	if (snapshot || index->NEntries == 2)
 		return FALSE;
 
 	int success;
@@ -799,7 +833,7 @@ float Scanner::FragmentationLevel(void)
 		CurrentRecordIdx = 0;
 	}
 
-	for (i=0;i<index->NEntries;i++)
+	for (i=0;i<EntryCount();i++)
 	{
 		Record *r = GetRecord(i);
 		if (r)
@@ -814,13 +848,16 @@ float Scanner::FragmentationLevel(void)
 		}
 	}
 	GetRecordById(oldP);
-	Vfseek(pTable->Handle, 0, SEEK_END);
-	return (((float)(Vftell(pTable->Handle)-strlen(__TABLE_SIGNATURE__)) / (float)totalSize) - 1) * 100;
+	VFILE *h = snapshot ? View : pTable->Handle;
+	Vfseek(h, 0, SEEK_END);
+	return (((float)(Vftell(h)-strlen(__TABLE_SIGNATURE__)) / (float)totalSize) - 1) * 100;
 }
 
 //---------------------------------------------------------------------------
 int Scanner::GetRecordsCount(void)
 {
+	if (snapshot)
+		return snapshot->GetRecordsCount();
 	if (index)
 		return index->NEntries-2;
 	else
@@ -830,6 +867,8 @@ int Scanner::GetRecordsCount(void)
 //---------------------------------------------------------------------------
 BOOL Scanner::SetWorkingIndexById(unsigned char Id)
 {
+	if (snapshot)
+		return FALSE;
 	IndexField *indx = pTable->GetIndexById(Id);
 	int v = CurrentRecordIdx;
 	if (indx)
@@ -866,6 +905,12 @@ BOOL Scanner::SetWorkingIndexByName(char *desc)
 void Scanner::IndexModified(void)
 {
 	iModified = TRUE;
+	// record positions may have moved, the plan is made again with the next record
+	if (HasPlan)
+	{
+		ClearPlan();
+		PlanPending = TRUE;
+	}
 }
 
 //---------------------------------------------------------------------------
@@ -955,6 +1000,8 @@ void Scanner::RemoveFilters(void)
 	while (FilterList.GetNElements() > 0)
 		FilterList.RemoveEntry(FilterList.GetHead());
 	FiltersOK = FALSE;
+	ProgramSize = 0;
+	ClearPlan();
 }
 
 //---------------------------------------------------------------------------
@@ -982,12 +1029,188 @@ BOOL Scanner::CheckFilters(void)
 
 	if (f == 1)
 	{
+		CompileFilters();
 		FiltersOK = TRUE;
 		return FILTERS_COMPLETE;
 	}
 	return FILTERS_INCOMPLETE;
 }
 
+//---------------------------------------------------------------------------
+// Copies the filters into a flat program, so MatchFilters doesn't walk the
+// linked list and classify every filter again for each record. The index
+// plan is made again with the first record that is scanned.
+void Scanner::CompileFilters(void)
+{
+	if (Program) free(Program);
+	Program = (FilterInstruction *)malloc(FilterList.GetNElements() * sizeof(FilterInstruction));
+	ProgramSize = 0;
+
+	Filter *filter = (Filter *)FilterList.GetHead();
+	while (filter)
+	{
+		FilterInstruction *instruction = &Program[ProgramSize++];
+		instruction->filter = filter;
+		instruction->op = filter->GetOp();
+		instruction->test = filter->Data() || instruction->op == FILTER_ISEMPTY || instruction->op == FILTER_ISNOTEMPTY;
+		filter = (Filter *)filter->GetNext();
+	}
+
+	ClearPlan();
+	PlanPending = TRUE;
+}
+
+//---------------------------------------------------------------------------
+// Returns an equality test every matching record has to pass (reached from
+// the root of the program through ANDs only) on a string or integer column
+// with an index, NULL if there is none.
+Filter *Scanner::RequiredEquality(void)
+{
+	int required[256];
+	int n = 0;
+
+	for (int i=0;i<ProgramSize;i++)
+	{
+		FilterInstruction *instruction = &Program[i];
+		if (instruction->test)
+		{
+			Filter *filter = instruction->filter;
+			Field *data = filter->Data();
+			ColumnField *column = GetColumnById(filter->Id);
+			bool usable = instruction->op == FILTER_EQUALS && data && column && pTable->GetIndexById(filter->Id)
+			              && column->GetDataType() == data->GetType();
+
+			// an empty string also matches the records without the field, they aren't in one range
+			if (usable && data->GetType() == FIELD_STRING)
+			{
+				const wchar_t *value = ((StringField *)data)->GetStringW();
+				usable = value && *value;
+			}
+			else if (usable)
+				usable = data->GetType() == FIELD_INTEGER;
+
+			required[n++] = usable ? i : -1;
+		}
+		else
+			switch (instruction->op)
+			{
+			case FILTER_AND:
+				if (n > 1)
+				{
+					if (required[n-2] == -1)
+						required[n-2] = required[n-1];
+					n--;
+				}
+				break;
+			case FILTER_OR:
+				if (n > 1)
+				{
+					required[n-2] = -1;
+					n--;
+				}
+				break;
+			case FILTER_NOT:
+				if (n > 0)
+					required[n-1] = -1;
+				break;
+			}
+	}
+
+	if (n != 1 || required[0] == -1)
+		return NULL;
+	return Program[required[0]].filter;
+}
+
+//---------------------------------------------------------------------------
+// Binary search in the index of the filter column: the first entry that
+// isn't below the filter value, or with upper the first entry above it.
+// Entries without the field are sorted last, like Index::FindSortedPlace.
+int Scanner::IndexBound(Index *i, Filter *filter, bool upper)
+{
+	int top = 2;
+	int bottom = i->NEntries;
+
+	while (top < bottom)
+	{
+		int compEntry = (bottom-top)/2+top;
+		int pos = i->Get(compEntry);
+		Field *compField = pos ? i->QuickFindField(filter->Id, pos) : NULL;
+		int c = filter->Data()->Compare(compField);
+		if (compField)
+		{
+			compField->SetDeletable();
+			delete compField;
+		}
+		if (c > 0 || (upper && c == 0))
+			top = compEntry+1;
+		else
+			bottom = compEntry;
+	}
+	return top;
+}
+
+static int CompareInts(const void *a, const void *b)
+{
+	int x = *(const int *)a, y = *(const int *)b;
+	return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+//---------------------------------------------------------------------------
+// Looks up the range of a required equality test in the index of its column
+// and keeps the positions of these records. The range can hold records the
+// test rejects, the index compares like Field::Compare, so Next() still
+// checks every candidate with MatchFilters.
+void Scanner::PlanFilters(void)
+{
+	ClearPlan();
+
+	// the index of the column may be changed by the writer of the table
+	if (snapshot)
+		return;
+
+	Filter *filter = RequiredEquality();
+	if (!filter)
+		return;
+
+	Index *i = pTable->GetIndexById(filter->Id)->index;
+	int from = IndexBound(i, filter, false);
+	int to = IndexBound(i, filter, true);
+
+	Candidates = (int *)malloc(max(to-from, 1) * sizeof(int));
+	for (int j=from;j<to;j++)
+	{
+		int pos = i->Get(j);
+		if (pos)
+			Candidates[NCandidates++] = pos;
+	}
+	qsort(Candidates, NCandidates, sizeof(int), CompareInts);
+	HasPlan = TRUE;
+}
+
+//---------------------------------------------------------------------------
+void Scanner::ClearPlan(void)
+{
+	if (Candidates) free(Candidates);
+	Candidates = NULL;
+	NCandidates = 0;
+	HasPlan = FALSE;
+	PlanPending = FALSE;
+}
+
+//---------------------------------------------------------------------------
+// false if the record at Idx of the working index is outside of the index
+// range of the filters and can't match. the first call after a change of
+// the filters or the indexes makes the plan
+bool Scanner::IsCandidate(int Idx)
+{
+	if (PlanPending && FiltersOK)
+		PlanFilters();
+	if (!HasPlan || Idx < 2 || Idx >= EntryCount())
+		return true;
+	int pos = EntryPos(Idx);
+	return bsearch(&pos, Candidates, NCandidates, sizeof(int), CompareInts) != NULL;
+}
+
 //---------------------------------------------------------------------------
 LinkedList *Scanner::GetFilters(void)
 {
@@ -1061,7 +1284,7 @@ private:
 //---------------------------------------------------------------------------
 bool Scanner::MatchFilters(void)
 {
-	if (!FiltersOK || FilterList.GetNElements() == 0)
+	if (!FiltersOK || ProgramSize == 0)
 	{
 //  return MatchJoins();
 		return TRUE;
@@ -1071,19 +1294,14 @@ bool Scanner::MatchFilters(void)
 
 	Results resultTable[256];
 
-	Filter *filter = (Filter *)FilterList.GetHead();
-	while (filter)
+	// CheckFilters has made sure the program never needs more than 256 results
+	for (int i=0;i<ProgramSize;i++)
 	{
-		if (ResultPtr == 256)
-		{
-			FiltersOK = FALSE; // Should never happen, case already discarded by CheckFilters
-			return TRUE;
-		}
-		int op = filter->GetOp();
-		if (filter->Data() || op == FILTER_ISEMPTY || op == FILTER_ISNOTEMPTY)
-			resultTable[ResultPtr++].SetFilter(filter);
+		FilterInstruction *instruction = &Program[i];
+		if (instruction->test)
+			resultTable[ResultPtr++].SetFilter(instruction->filter);
 		else
-			switch (op)
+			switch (instruction->op)
 			{
 			case FILTER_AND:
 				if (ResultPtr > 1)
@@ -1100,7 +1318,6 @@ bool Scanner::MatchFilters(void)
 					resultTable[ResultPtr-1] = !resultTable[ResultPtr-1].Calc(this);
 				break;
 			}
-		filter = (Filter *)filter->GetNext();
 	}
 
 	if (ResultPtr != 1) // Should never happen, case already discarded by CheckFilters
@@ -14,6 +14,16 @@
 #define __SCANNER_H
 
 class Scanner;
+
+// one step of the compiled filters: a test on a field or an operator that combines the results
+// of the previous steps, in the postfix order of FilterList
+struct FilterInstruction
+{
+	Filter *filter;
+	unsigned char op;
+	bool test;
+};
+
 /*
 class ScannerJoin {
   public:
@@ -37,6 +47,7 @@ class Scanner : LinkedListEntry {
 	friend class Record;
 	friend class LinkedList;
 	friend class Index;
+	friend class Snapshot;
 	
 	public: // should be protected 
 
@@ -56,6 +67,12 @@ class Scanner : LinkedListEntry {
 		int CheckFilters(void);
 		bool MatchFilter(Filter *filter);
 		void CacheLastLocate(int Id, int From, Field *field, Index *i, int j);
+		void CompileFilters(void);
+		Filter *RequiredEquality(void);
+		int IndexBound(Index *i, Filter *filter, bool upper);
+		void PlanFilters(void);
+		void ClearPlan(void);
+		bool IsCandidate(int Idx);
 
     #include "Query.h"
 
@@ -76,6 +93,25 @@ class Scanner : LinkedListEntry {
 
 		int ResultPtr;
 		BOOL FiltersOK;
+
+		// FilterList as flat program, valid while FiltersOK
+		FilterInstruction *Program;
+		int ProgramSize;
+
+		// sorted positions of the records an index range allows, see PlanFilters. records
+		// that aren't in the list can't match the filters and are skipped without reading them
+		int *Candidates;
+		int NCandidates;
+		BOOL HasPlan;
+		BOOL PlanPending;
+
+		// only set for the scanners of a snapshot: they read its copy through their own View and
+		// leave out the entries from SnapshotEnd on, see Snapshot::Query
+		Snapshot *snapshot;
+		VFILE *View;
+		int SnapshotEnd;
+		int EntryCount(void);
+		int EntryPos(int Idx);
     ColumnField *subtablecolumn;
     //PtrList<ScannerJoin> joined;
     //int inMatchJoins;
@@ -0,0 +1,227 @@
+/* ---------------------------------------------------------------------------
+                           Nullsoft Database Engine
+                             --------------------
+                        codename: Near Death Experience
+--------------------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------------------
+
+ Snapshot Class
+
+--------------------------------------------------------------------------- */
+
+#include "NDE.h"
+
+//---------------------------------------------------------------------------
+// Copies the records and the index, only cached tables can be copied. One
+// memcpy is cheaper than locking every read of the scanners.
+Snapshot::Snapshot(Table *parentTable, Index *index)
+{
+	pTable = parentTable;
+	Data = NULL;
+	Size = 0;
+	Positions = NULL;
+	NEntries = 0;
+
+	VFILE *h = pTable->Handle;
+	if (!h || !h->cached || !index)
+		return;
+
+	Data = (unsigned char *)malloc(max(h->filesize, 1));
+	Positions = (int *)malloc(max(index->NEntries, 1) * sizeof(int));
+	if (!Data || !Positions)
+	{
+		if (Data) free(Data);
+		if (Positions) free(Positions);
+		Data = NULL;
+		Positions = NULL;
+		return;
+	}
+
+	memcpy(Data, h->data, h->filesize);
+	Size = h->filesize;
+	NEntries = index->NEntries;
+	for (int i=0;i<NEntries;i++)
+		Positions[i] = index->Get(i);
+}
+
+//---------------------------------------------------------------------------
+Snapshot::~Snapshot()
+{
+	if (Data) free(Data);
+	if (Positions) free(Positions);
+}
+
+//---------------------------------------------------------------------------
+BOOL Snapshot::IsValid(void)
+{
+	return Data != NULL;
+}
+
+//---------------------------------------------------------------------------
+int Snapshot::GetRecordsCount(void)
+{
+	return max(NEntries-2, 0);
+}
+
+//---------------------------------------------------------------------------
+// A read only scanner of the copy. Every scanner reads through its own view
+// of the data, the position of the reads is the only state they would share.
+Scanner *Snapshot::NewScanner(void)
+{
+	VFILE *view = (VFILE *)calloc(1, sizeof(VFILE));
+	if (!view)
+		return NULL;
+	view->data = Data;
+	view->filesize = Size;
+	view->maxsize = Size;
+	view->mode = VFS_READ;
+	view->cached = TRUE;
+
+	Scanner *s = new Scanner(pTable, FALSE, FALSE);
+	s->snapshot = this;
+	s->View = view;
+	s->SnapshotEnd = NEntries;
+	return s;
+}
+
+//---------------------------------------------------------------------------
+void Snapshot::DeleteScanner(Scanner *scan)
+{
+	delete scan;
+}
+
+//---------------------------------------------------------------------------
+void Snapshot::QueryPart(SnapshotPart *part)
+{
+	Scanner *s = part->scanner;
+	s->SnapshotEnd = part->To;
+	part->Results = (int *)malloc(max(part->To-part->From, 1) * sizeof(int));
+	if (!part->Results || !s->Query_Run(part->query, part->shape, part->literals, part->nliterals))
+	{
+		part->Failed = TRUE;
+		return;
+	}
+
+	for (s->GetRecordById(part->From-2); !s->Eof(); s->Next())
+		part->Results[part->NResults++] = s->GetRecordId();
+}
+
+#ifdef WIN32
+//---------------------------------------------------------------------------
+DWORD WINAPI Snapshot::QueryThread(LPVOID part)
+{
+	QueryPart((SnapshotPart *)part);
+	return 0;
+}
+#endif
+
+//---------------------------------------------------------------------------
+// Runs a query on parts of the records at the same time, one thread and one
+// scanner per part, parts=0 for a thread per processor. The parts follow each
+// other in the index, their results are joined in the order of the parts.
+// The shape of the query is looked up in the cache of the table on this
+// thread, the threads only read it.
+// Returns the ids of the matching records in the order of the index, for
+// GetRecordById of a scanner of the snapshot, or NULL if the query failed.
+// The caller frees the list.
+int *Snapshot::Query(const wchar_t *query, int *nresults, int parts)
+{
+	*nresults = 0;
+	if (!query || !Data)
+		return NULL;
+
+	int n = GetRecordsCount();
+#ifdef WIN32
+	if (parts <= 0)
+	{
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		parts = info.dwNumberOfProcessors;
+	}
+#else
+	if (parts <= 0)
+		parts = 1;
+#endif
+	parts = max(min(min(parts, n/SNAPSHOT_PART_MIN), SNAPSHOT_MAX_PARTS), 1);
+
+	SnapshotPart *part = (SnapshotPart *)calloc(parts, sizeof(SnapshotPart));
+	if (!part)
+		return NULL;
+	int i;
+	for (i=0;i<parts;i++)
+	{
+		part[i].scanner = NewScanner();
+		part[i].query = query;
+		part[i].From = 2 + n*i/parts;
+		part[i].To = 2 + n*(i+1)/parts;
+		part[i].Failed = part[i].scanner == NULL;
+	}
+
+	wchar_t **literals = NULL;
+	int nliterals = 0;
+	Scanner *first = part[0].scanner;
+	wchar_t *shape = first ? first->Query_Shape(query, &literals, &nliterals) : NULL;
+	QueryShape *cached = shape ? pTable->QueryShapes.Find(shape) : NULL;
+	for (i=0;i<parts;i++)
+	{
+		part[i].shape = cached;
+		part[i].literals = literals;
+		part[i].nliterals = nliterals;
+	}
+
+#ifdef WIN32
+	// the first part runs on this thread
+	HANDLE threads[SNAPSHOT_MAX_PARTS];
+	int nthreads = 0;
+	for (i=1;i<parts;i++)
+	{
+		if (part[i].Failed)
+			continue;
+		threads[nthreads] = CreateThread(NULL, 0, QueryThread, &part[i], 0, NULL);
+		if (threads[nthreads])
+			nthreads++;
+		else
+			QueryPart(&part[i]);
+	}
+	if (!part[0].Failed)
+		QueryPart(&part[0]);
+	if (nthreads)
+		WaitForMultipleObjects(nthreads, threads, TRUE, INFINITE);
+	for (i=0;i<nthreads;i++)
+		CloseHandle(threads[i]);
+#else
+	for (i=0;i<parts;i++)
+		if (!part[i].Failed)
+			QueryPart(&part[i]);
+#endif
+
+	// a parsed query is cached like the ones of the scanners of the table
+	if (shape && !cached && !part[0].Failed && first->FiltersOK)
+		first->Query_Remember(shape, nliterals);
+	else
+		free(shape);
+	Scanner::Query_FreeLiterals(literals, nliterals);
+
+	BOOL failed = FALSE;
+	int total = 0;
+	for (i=0;i<parts;i++)
+	{
+		failed |= part[i].Failed;
+		total += part[i].NResults;
+	}
+
+	int *results = failed ? NULL : (int *)malloc(max(total, 1) * sizeof(int));
+	for (i=0;i<parts;i++)
+	{
+		if (results)
+		{
+			memcpy(results + *nresults, part[i].Results, part[i].NResults * sizeof(int));
+			*nresults += part[i].NResults;
+		}
+		if (part[i].Results) free(part[i].Results);
+		DeleteScanner(part[i].scanner);
+	}
+	free(part);
+	return results;
+}
@@ -0,0 +1,65 @@
+/* ---------------------------------------------------------------------------
+                           Nullsoft Database Engine
+                             --------------------
+                        codename: Near Death Experience
+--------------------------------------------------------------------------- */
+
+/* ---------------------------------------------------------------------------
+
+ Snapshot Class Prototypes
+
+--------------------------------------------------------------------------- */
+
+#ifndef __SNAPSHOT_H
+#define __SNAPSHOT_H
+
+#define SNAPSHOT_PART_MIN 1024 // fewest records Query gives to one thread
+#define SNAPSHOT_MAX_PARTS 64 // most threads of one Query, WaitForMultipleObjects can't wait for more
+
+// records of one thread of Snapshot::Query: the entries from From to To of the index, the ids of
+// the records that match go to Results. shape is the cached shape of the query, NULL if it's parsed
+struct SnapshotPart
+{
+	Scanner *scanner;
+	const wchar_t *query;
+	QueryShape *shape;
+	wchar_t **literals;
+	int nliterals;
+	int From;
+	int To;
+	int *Results;
+	int NResults;
+	BOOL Failed;
+};
+
+// a copy of the records of a table and of the order of one of its indexes, see Table::NewSnapshot.
+// the scanners of a snapshot only read the copy, so they give the same records while the table is
+// written and can be used by other threads, one thread per scanner. the columns of the table must
+// not change while a snapshot exists
+class Snapshot
+{
+	friend class Table;
+	friend class Scanner;
+
+	protected:
+		Snapshot(Table *parentTable, Index *index);
+		~Snapshot();
+		Table *pTable;
+		unsigned char *Data;
+		unsigned long Size;
+		int *Positions; // record position of every entry of the index, like Index::Get
+		int NEntries;
+		static void QueryPart(SnapshotPart *part);
+#ifdef WIN32
+		static DWORD WINAPI QueryThread(LPVOID part);
+#endif
+
+	public:
+		BOOL IsValid(void);
+		int GetRecordsCount(void);
+		Scanner *NewScanner(void);
+		void DeleteScanner(Scanner *scan);
+		int *Query(const wchar_t *query, int *nresults, int parts = 0);
+};
+
+#endif
@@ -74,6 +74,8 @@ void StringField::InitField(void)
 	#ifdef _WIN32
 	StringW = NULL;
 	optimized_the = 0;
+	SortKey = NULL;
+	SortKeyLength = 0;
 	#endif
 	Kind = DELETABLE;
 	Physical = FALSE;
@@ -94,6 +96,7 @@ StringField::~StringField()
 	free(String);
 	ndestring_release(StringW);
 	StringW=0;
+	free(SortKey);
 	#elif defined(__APPLE__)
 	if (String)
 		CFRelease(String);
@@ -113,6 +116,56 @@ void StringField::MakeANSIString()
 	if (StringW && !String)
 		String = AutoCharDup(StringW);
 }
+
+//---------------------------------------------------------------------------
+const unsigned char *StringField::GetSortKey(int *length)
+{
+	if (!SortKey)
+	{
+		const wchar_t *s = GetStringW();
+		if (!s)
+			s = L"";
+		int n = LCMapStringW(LOCALE_USER_DEFAULT, LCMAP_SORTKEY|NORM_IGNORECASE|NORM_IGNORENONSPACE, s, -1, NULL, 0);
+		if (n > 0)
+		{
+			SortKey = (unsigned char *)malloc(n);
+			if (SortKey && LCMapStringW(LOCALE_USER_DEFAULT, LCMAP_SORTKEY|NORM_IGNORECASE|NORM_IGNORENONSPACE, s, -1, (LPWSTR)SortKey, n) == n)
+				SortKeyLength = n;
+			else
+			{
+				free(SortKey);
+				SortKey = NULL;
+			}
+		}
+	}
+	*length = SortKeyLength;
+	return SortKey;
+}
+
+//---------------------------------------------------------------------------
+void StringField::ClearSortKey(void)
+{
+	free(SortKey);
+	SortKey = NULL;
+	SortKeyLength = 0;
+}
+
+//---------------------------------------------------------------------------
+// nde_wcsicmp of the strings, missing strings are empty. the keys end with a
+// 0, the shorter one is below when the other one continues
+int StringField::CompareSortKey(StringField *Entry)
+{
+	int la, lb;
+	const unsigned char *a = GetSortKey(&la);
+	const unsigned char *b = Entry->GetSortKey(&lb);
+	if (!a || !b)
+	{
+		const wchar_t *d = GetStringW(), *p = Entry->GetStringW();
+		return nde_wcsicmp(d ? d : L"", p ? p : L"");
+	}
+	int r = memcmp(a, b, min(la, lb));
+	return r ? r : la - lb;
+}
 #endif
 
 //---------------------------------------------------------------------------
@@ -160,6 +213,7 @@ void StringField::ReadTypedData(unsigned char *data, size_t len)
 		String = CFStringCreateWithBytes(kCFAllocatorDefault, data, c, kCFStringEncodingUTF16, true); 
 		#elif defined(_WIN32)
 			ndestring_release(StringW);
+			ClearSortKey();
 			StringW = ndestring_malloc(c+sizeof(wchar_t));
 
 			GET_BINARY((unsigned char *)StringW, data, c, pos);
@@ -180,6 +234,7 @@ void StringField::ReadTypedData(unsigned char *data, size_t len)
 			CFRelease(String);
 		String = CFStringCreateWithBytes(kCFAllocatorDefault, data, c, kCFStringEncodingWindowsLatin1, false); 
 		#elif defined(_WIN32)
+			ClearSortKey();
 			String = (char *)malloc(c+1);
 			GET_BINARY((unsigned char *)String, data, c, pos);
 			String[c]=0;
@@ -293,6 +348,7 @@ void StringField::SetString(const char *Str)
 	StringW = NULL;
 	String = strdup(Str);
 	optimized_the=0;
+	ClearSortKey();
 }
 
 //---------------------------------------------------------------------------
@@ -309,6 +365,7 @@ void StringField::SetStringW(const wchar_t *Str)
 	StringW = NULL;
 	StringW = ndestring_wcsdup(Str);
 	optimized_the=0;
+	ClearSortKey();
 }
 
 //---------------------------------------------------------------------------
@@ -327,6 +384,7 @@ void StringField::SetNDEString(wchar_t *Str)
 	ndestring_retain(StringW);
 	ndestring_release(oldStr);
 	optimized_the=0;
+	ClearSortKey();
 }
 #endif
 //---------------------------------------------------------------------------
@@ -363,7 +421,12 @@ int StringField::Compare(Field *Entry)
 	if (!Entry) return -1;
 	if (Entry->GetType() != GetType()) return 0;
 	#ifdef _WIN32
-	return mywcsicmp(GetStringW(), ((StringField*)Entry)->GetStringW());
+	StringField *compField = (StringField*)Entry;
+	if (!GetStringW() && !compField->GetStringW()) return 0;
+	if (!GetStringW()) return 1;
+	if (!compField->GetStringW()) return -1;
+	int r = CompareSortKey(compField);
+	return min(max(r, -1), 1);
 	#elif defined(__APPLE__)
 	CFStringRef compareString = ((StringField*)Entry)->GetString();
 	if (!String && !compareString) return 0;
@@ -563,13 +626,14 @@ bool StringField::ApplyFilter(Field *Data, int op)
 	if (!d)
 		d = L"";
 	
+	// equality and order compare the sort keys, the keys of the filter are built once
 	switch (op)
 	{
 		case FILTER_EQUALS:
-			r = !nde_wcsicmp(d, p);
+			r = !CompareSortKey(compField);
 			break;
 		case FILTER_NOTEQUALS:
-			r = !!nde_wcsicmp(d, p);
+			r = !!CompareSortKey(compField);
 			break;
 		case FILTER_CONTAINS:
 			r = (NULL != wcsistr(d, p));
@@ -578,16 +642,16 @@ bool StringField::ApplyFilter(Field *Data, int op)
 			r = (NULL == wcsistr(d, p));
 			break;
 		case FILTER_ABOVE:
-			r = (bool)(nde_wcsicmp(d, p) > 0);
+			r = (bool)(CompareSortKey(compField) > 0);
 			break;
 		case FILTER_ABOVEOREQUAL:
-			r = (bool)(nde_wcsicmp(d, p) >= 0);
+			r = (bool)(CompareSortKey(compField) >= 0);
 			break;
 		case FILTER_BELOW:
-			r = (bool)(nde_wcsicmp(d, p) < 0);
+			r = (bool)(CompareSortKey(compField) < 0);
 			break;
 		case FILTER_BELOWOREQUAL:
-			r = (bool)(nde_wcsicmp(d, p) <= 0);
+			r = (bool)(CompareSortKey(compField) <= 0);
 			break;
 		case FILTER_BEGINS:
 			r = (bool)(nde_wcsnicmp(d, p, wcslen(p)) == 0);
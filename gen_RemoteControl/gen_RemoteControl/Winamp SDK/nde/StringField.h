@@ -42,6 +42,14 @@ protected:
 	char *String;
 	wchar_t *StringW;
 	const wchar_t *optimized_the;
+
+	// sort key of the string for the comparisons of nde_wcsicmp, built with LCMapString on the first
+	// comparison after the string has been read or set. memcmp of two keys orders like CompareString
+	unsigned char *SortKey;
+	int SortKeyLength;
+	const unsigned char *GetSortKey(int *length);
+	void ClearSortKey(void);
+	int CompareSortKey(StringField *Entry);
 	#elif defined(__APPLE__)
 	CFStringRef String;
 #endif
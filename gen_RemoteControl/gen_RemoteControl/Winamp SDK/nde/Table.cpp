@@ -50,6 +50,7 @@ void Table::Init()
 	IndexList=NULL;
 	doCRC = FALSE;
 	GLocateUpToDate = FALSE;
+	compaction = NULL;
 }
 
 //---------------------------------------------------------------------------
@@ -65,6 +66,7 @@ Table::~Table()
 //---------------------------------------------------------------------------
 void Table::Reset() 
 {
+	CancelCompaction();
 	delete IndexList;
 	IndexList=0;
 	delete FieldsRecord;
@@ -270,6 +272,8 @@ void Table::Close(void)
 {
 	int v=0;
 
+	CancelCompaction();
+
 	if (IndexList)
 	{
 		IndexField *f = (IndexField *)IndexList->Fields.GetHead();
@@ -404,6 +408,7 @@ void Table::Sync(void)
 //---------------------------------------------------------------------------
 ColumnField *Table::NewColumn(unsigned char FieldID, char *FieldName, unsigned char FieldType, BOOL indexUnique)
 {
+	QueryShapes.Clear();
 	ColumnField *f = GetColumnById(FieldID);
 	if (f) {
 		int t = f->GetDataType();
@@ -455,6 +460,7 @@ void Table::SetUniqueById(int ID, BOOL tf) {
 //---------------------------------------------------------------------------
 void Table::PostColumns(void)
 {
+	QueryShapes.Clear();
 	FieldsRecord->WriteFields();
 	HasNewHdr=FALSE;
 }
@@ -703,6 +709,15 @@ void Table::RemoveFilters(void)
 	dScanner->RemoveFilters();
 }
 
+//---------------------------------------------------------------------------
+// Queries of all scanners and snapshots of the table that got their filters
+// from the query cache and the ones that were parsed
+void Table::GetQueryCacheStats(int *hits, int *misses)
+{
+	if (hits != NULL) *hits = QueryShapes.GetHits();
+	if (misses != NULL) *misses = QueryShapes.GetMisses();
+}
+
 //---------------------------------------------------------------------------
 void Table::Edit(void)
 {
@@ -822,6 +837,31 @@ void Table::DeleteScanner(Scanner *scan)
 		Scanners->RemoveEntry(scan);
 }
 
+//---------------------------------------------------------------------------
+// Copies the records in the order of an index for the read only scanners of
+// other threads, NULL if the index doesn't exist or the table isn't cached.
+// Delete the snapshot before the table is closed.
+Snapshot *Table::NewSnapshot(unsigned char indexId)
+{
+	IndexField *f = GetIndexById(indexId);
+	if (!f)
+		return NULL;
+	Snapshot *s = new Snapshot(this, f->index);
+	if (!s->IsValid())
+	{
+		delete s;
+		return NULL;
+	}
+	return s;
+}
+
+//---------------------------------------------------------------------------
+// the scanners of the snapshot have to be deleted first
+void Table::DeleteSnapshot(Snapshot *snapshot)
+{
+	delete snapshot;
+}
+
 //---------------------------------------------------------------------------
 void Table::IndexModified(void)
 {
@@ -1020,6 +1060,166 @@ void Table::SetGlobalLocateUpToDate(BOOL is) {
 	GLocateUpToDate = is;
 }
 
+//---------------------------------------------------------------------------
+// Starts an incremental compaction: instead of rebuilding the table at once
+// like Compact, CompactionStep copies the live records into a new region a
+// few at a time, the table stays usable in between. Call it from an idle
+// timer or a low priority thread until it returns 1, the region replaces the
+// table then. Only cached tables can be compacted this way.
+BOOL Table::BeginCompaction(void)
+{
+	if (compaction)
+		return TRUE;
+	if (!Handle || !Handle->cached || !dScanner || !dScanner->index)
+		return FALSE;
+	compaction = new Compaction(Handle);
+	if (!compaction->IsValid())
+	{
+		CancelCompaction();
+		return FALSE;
+	}
+	return TRUE;
+}
+
+//---------------------------------------------------------------------------
+// Copies records for about timeSlice milliseconds, at least one. Returns 0
+// while the compaction goes on, 1 when it is finished or has been given up.
+int Table::CompactionStep(int timeSlice, int *progress)
+{
+	if (!compaction)
+		return 1;
+
+	Index *idx = dScanner->index;
+	DWORD start = GetTickCount();
+	while (compaction->Cursor < idx->NEntries)
+	{
+		int pos = idx->Get(compaction->Cursor++);
+		if (pos > 0 && !compaction->CopyRecord(pos))
+		{
+			CancelCompaction();
+			return 1;
+		}
+		if (progress != NULL) *progress = (int)((float)compaction->Cursor/(float)idx->NEntries*100.0f);
+		if ((int)(GetTickCount() - start) >= timeSlice)
+			return 0;
+	}
+
+	if (!FinishCompaction())
+		return compaction ? 0 : 1;
+	if (progress != NULL) *progress = 100;
+	return 1;
+}
+
+//---------------------------------------------------------------------------
+// Replaces the table by the region. Returns FALSE if a scanner is editing,
+// the record would be written to its old place, or if the compaction has
+// been given up.
+BOOL Table::FinishCompaction(void)
+{
+	Scanner *s = (Scanner *)Scanners->GetHead();
+	while (s)
+	{
+		if (s->Edition)
+			return FALSE;
+		s = (Scanner *)s->GetNext();
+	}
+
+	// records written since they were copied, the ones deleted since then are copied for nothing
+	for (int i=0;i<compaction->NTouched;i++)
+		compaction->CopyRecord(compaction->Touched[i]);
+
+	// records the cursor didn't meet: inserted before it or moved behind it by the index
+	Index *idx = dScanner->index;
+	for (int i=0;i<idx->NEntries;i++)
+	{
+		int pos = idx->Get(i);
+		if (pos > 0 && !compaction->Translate(pos) && !compaction->CopyRecord(pos))
+			compaction->Failed = TRUE;
+	}
+	if (compaction->Failed)
+	{
+		CancelCompaction();
+		return FALSE;
+	}
+
+	// point the indexes and the loaded records to the copies
+	IndexField *f = (IndexField *)IndexList->Fields.GetHead();
+	while (f)
+	{
+		int run;
+		for (int i=0;i<f->index->NEntries;i+=run)
+		{
+			IndexEntry *Entries = f->index->Tree.GetRun(i, &run);
+			for (int j=0;j<run;j++)
+				Entries[j].Pos = compaction->Translate(Entries[j].Pos);
+		}
+		f = (IndexField *)f->GetNext();
+	}
+	TranslateRecord(FieldsRecord);
+	TranslateRecord(IndexList);
+	s = (Scanner *)Scanners->GetHead();
+	while (s)
+	{
+		TranslateRecord(s->CurrentRecord);
+		s = (Scanner *)s->GetNext();
+	}
+
+	Vreplace(Handle, compaction->Data, compaction->Size, compaction->MaxSize);
+	compaction->Data = NULL;
+	CancelCompaction();
+	Sync();
+	return TRUE;
+}
+
+//---------------------------------------------------------------------------
+void Table::TranslateRecord(Record *record)
+{
+	if (!record)
+		return;
+	Field *f = (Field *)record->Fields.GetHead();
+	while (f)
+	{
+		// fields that haven't been written yet keep their position 0
+		if (f->Pos > 0)
+			f->Pos = compaction->Translate(f->Pos);
+		f->NextFieldPos = compaction->Translate(f->NextFieldPos);
+		f->PreviousFieldPos = compaction->Translate(f->PreviousFieldPos);
+		f = (Field *)f->GetNext();
+	}
+}
+
+//---------------------------------------------------------------------------
+void Table::CancelCompaction(void)
+{
+	delete compaction;
+	compaction = NULL;
+}
+
+//---------------------------------------------------------------------------
+BOOL Table::IsCompacting(void)
+{
+	return compaction != NULL;
+}
+
+//---------------------------------------------------------------------------
+// Bytes a compaction would free: the size of the table without the fields of
+// the records in the primary index. Reads the field headers only, unlike
+// FragmentationLevel, so it can be asked often. 0 for tables that aren't cached.
+unsigned long Table::ReclaimableBytes(unsigned long *tableSize)
+{
+	if (tableSize != NULL) *tableSize = 0;
+	if (!Handle || !Handle->cached || !dScanner || !dScanner->index)
+		return 0;
+
+	Index *idx = dScanner->index;
+	unsigned long live = (unsigned long)strlen(__TABLE_SIGNATURE__);
+	for (int i=0;i<idx->NEntries;i++)
+		live += Compaction::RecordSize(Handle, idx->Get(i));
+
+	if (tableSize != NULL) *tableSize = Handle->filesize;
+	return Handle->filesize > live ? Handle->filesize - live : 0;
+}
+
 #ifdef _WIN32
 bool Table::Compact_ColumnWalk(LinkedListEntry *Entry, int id, void *data1, void *data2)
 {
@@ -1060,6 +1260,8 @@ void Table::Compact(int *progress) {
 	// nifty indexes that cross reference themselves and blablabla, we're just gonna duplicate the
 	// whole table from scratch, overwrite ourselves, and reopen the table. duh.
 
+	CancelCompaction();
+
 	// crate a temporary table in windows temp dir
 	char temp_table[MAX_PATH+12];
 	char temp_index[MAX_PATH+12];
@@ -19,6 +19,7 @@
 #else
 #include <unistd.h>
 #endif
+#include "QueryCache.h"
 
 #define CONSISTENCY_OK                      0 // Table is valid
 #define CONSISTENCY_DONTKNOW                1 // No info whatsoever
@@ -27,6 +28,8 @@
 #define CONSISTENCY_BACKUPCORRUPTED         4 // Table and backup are corrupted, can't rebuild
 #define CONSISTENCY_REBUILT                 5 // Unique values table corrupted, restore failed, table rebuilt successfully
 
+class Compaction;
+
 class Table
 {
 	friend class Record;
@@ -35,6 +38,7 @@ class Table
 	friend class Field;
 	friend class ColumnField;
 	friend class Database;
+	friend class Snapshot;
 
 private:
 	void Init();
@@ -65,6 +69,10 @@ protected:
 	BOOL doCRC;
 	BOOL GLocateUpToDate;
 	int numErrors;
+	Compaction *compaction;
+	QueryCache QueryShapes;
+	BOOL FinishCompaction(void);
+	void TranslateRecord(Record *record);
 
 	// Tables
 	Table(char *TableName, char *IdxName, BOOL Create, Database *db, BOOL Cached);
@@ -141,11 +149,14 @@ public:
 	int AddFilterById(unsigned char Id, Field *Data, unsigned char Op);
 	int AddFilterOp(unsigned char Op);
 	void RemoveFilters(void);
+	void GetQueryCacheStats(int *hits, int *misses);
 
 	// Scanners
 	Scanner *NewScanner(BOOL notifyUpdates);
 	Scanner *GetDefaultScanner(void);
 	void DeleteScanner(Scanner *scan);
+	Snapshot *NewSnapshot(unsigned char indexId = PRIMARY_INDEX);
+	void DeleteSnapshot(Snapshot *snapshot);
 
 	// Misc
 	float FragmentationLevel(void);
@@ -154,6 +165,11 @@ public:
 	int RestoreBackup();
 	void SetCRCChecks(BOOL tf);
 	void Compact(int *progress = NULL);
+	BOOL BeginCompaction(void);
+	int CompactionStep(int timeSlice, int *progress = NULL);
+	void CancelCompaction(void);
+	BOOL IsCompacting(void);
+	unsigned long ReclaimableBytes(unsigned long *tableSize = NULL);
 	void doRecovery();
 	void SetDlgInfo(int nrecords, int currecord, int nlost);
 
@@ -87,6 +87,10 @@ VFILE *Vfopen(char *fl, char *mode, BOOL Cached)
 	f->ptr = 0;
 	f->dirty=0;
 	f->flushtable=0;
+	f->mapped = FALSE;
+#ifndef NDE_NOWIN32FILEIO
+	f->mapping = NULL;
+#endif
 #ifdef NDE_ALLOW_NONCACHED
 	f->cached = Cached;
 #else
@@ -196,7 +200,8 @@ VFILE *Vfopen(char *fl, char *mode, BOOL Cached)
 again:
 		if (attempts<100) // we'll try for 10 seconds
 		{
-			hFile=CreateFile(fl,GENERIC_READ,FILE_SHARE_READ/*|FILE_SHARE_WRITE*/,0,OPEN_EXISTING,FILE_FLAG_SEQUENTIAL_SCAN,0);
+			// FILE_SHARE_DELETE lets Vsync of another handle move the file while it is mapped
+			hFile=CreateFile(fl,GENERIC_READ,FILE_SHARE_READ|FILE_SHARE_DELETE/*|FILE_SHARE_WRITE*/,0,OPEN_EXISTING,FILE_FLAG_SEQUENTIAL_SCAN,0);
 			if (hFile == INVALID_HANDLE_VALUE && GetLastError() == ERROR_SHARING_VIOLATION)
 			{
 				Sleep(100); // let's try again
@@ -206,7 +211,7 @@ again:
 		else if (hFile == INVALID_HANDLE_VALUE && GetLastError() == ERROR_SHARING_VIOLATION)
 		{
 			// screwed up STILL? eeergh I bet it's another program locking it, let's try with more sharing flags
-			hFile=CreateFile(fl,GENERIC_READ,FILE_SHARE_READ|FILE_SHARE_WRITE,0,OPEN_EXISTING,FILE_FLAG_SEQUENTIAL_SCAN,0);
+			hFile=CreateFile(fl,GENERIC_READ,FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE,0,OPEN_EXISTING,FILE_FLAG_SEQUENTIAL_SCAN,0);
 		}
 
 		if (hFile==INVALID_HANDLE_VALUE)
@@ -226,24 +231,43 @@ again:
 			if (fsize_ret_value==INVALID_FILE_SIZE)
 				return NULL;
 			f->filesize = static_cast<size_t>(fsize_ret_value);
-			f->data = (unsigned char *)calloc(f->filesize, 1);
-			if (f->data == NULL)
+			f->maxsize = f->filesize;
+			// the file is mapped instead of read, fields are parsed straight from the view. the pages
+			// are only loaded when they are scanned, a write replaces the view by a copy (Vunmap)
+			if (f->filesize)
 			{
-				CloseHandle(hFile);
-				free(f);
-				return NULL;
+				f->mapping = CreateFileMapping(hFile, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+				if (f->mapping)
+				{
+					f->data = (unsigned char *)MapViewOfFile(f->mapping, FILE_MAP_COPY, 0, 0, 0);
+					if (f->data)
+						f->mapped = TRUE;
+					else
+					{
+						CloseHandle(f->mapping);
+						f->mapping = NULL;
+					}
+				}
 			}
-			f->maxsize = f->filesize;
-			DWORD r;
-			// TODO: benski> I think we should switch this to overlapped I/O (to allow I/O to happen as we're parsing)
-			//               or switch to a memory mapped file... but we'll need to check with the profiler
-			if (!ReadFile(hFile,f->data,f->filesize,&r,NULL) || r != f->filesize)
+			if (!f->mapped)
 			{
-				CloseHandle(hFile);
-				free(f->data);
-				free(f);
-				return NULL;
+				f->data = (unsigned char *)calloc(f->filesize, 1);
+				if (f->data == NULL)
+				{
+					CloseHandle(hFile);
+					free(f);
+					return NULL;
+				}
+				DWORD r;
+				if (!ReadFile(hFile,f->data,f->filesize,&r,NULL) || r != f->filesize)
+				{
+					CloseHandle(hFile);
+					free(f->data);
+					free(f);
+					return NULL;
+				}
 			}
+			// the mapping keeps its own reference to the file
 			CloseHandle(hFile);
 		}
 #endif
@@ -256,6 +280,59 @@ again:
 	return f;
 }
 
+//----------------------------------------------------------------------------
+// Replaces the view of a mapped file by a copy on the heap before the first
+// write: the data can grow then and Vsync can replace the file on disk.
+// Returns 0 if there isn't enough memory for the copy.
+static int Vunmap(VFILE *f)
+{
+	if (!f->mapped) return 1;
+#ifndef NDE_NOWIN32FILEIO
+	unsigned char *copy = (unsigned char *)malloc(f->maxsize ? f->maxsize : 1);
+	if (copy == NULL)
+		return 0;
+	memcpy(copy, f->data, f->maxsize);
+	UnmapViewOfFile(f->data);
+	CloseHandle(f->mapping);
+	f->mapping = NULL;
+	f->data = copy;
+#endif
+	f->mapped = FALSE;
+	return 1;
+}
+
+//----------------------------------------------------------------------------
+// Frees the data of a file, unmaps it if it is still mapped
+static void Vfree(VFILE *f)
+{
+#ifndef NDE_NOWIN32FILEIO
+	if (f->mapped)
+	{
+		UnmapViewOfFile(f->data);
+		CloseHandle(f->mapping);
+		f->mapping = NULL;
+		f->mapped = FALSE;
+		f->data = NULL;
+		return;
+	}
+#endif
+	free(f->data);
+}
+
+//----------------------------------------------------------------------------
+// Replaces the content of a cached file by data allocated with malloc, the
+// file frees it. Vsync writes it to disk like any other change
+void Vreplace(VFILE *f, unsigned char *data, unsigned long size, unsigned long maxsize)
+{
+	if (!f) return;
+	Vfree(f);
+	f->data = data;
+	f->filesize = size;
+	f->maxsize = maxsize;
+	f->ptr = 0;
+	f->dirty = 1;
+}
+
 //----------------------------------------------------------------------------
 void Vfclose(VFILE *f)
 {
@@ -282,7 +359,7 @@ void Vfclose(VFILE *f)
 	if (!(f->mode & VFS_WRITE))
 	{
 		free(f->filename);
-		free(f->data);
+		Vfree(f);
 		free(f);
 		return;
 	}
@@ -290,7 +367,7 @@ void Vfclose(VFILE *f)
 	Vsync(f);
 
 	free(f->filename);
-	free(f->data);
+	Vfree(f);
 	free(f);
 }
 
@@ -350,6 +427,7 @@ void Vfwrite(void *ptr, size_t size, size_t n, VFILE *f)
 		return;
 	}
 #endif
+	if (!Vunmap(f)) return;
 	f->dirty=1;
 	size_t s = (size*n);
 	if (s + f->ptr > f->maxsize)
@@ -375,6 +453,7 @@ void Vgrow(VFILE *f)
 #ifdef NDE_ALLOW_NONCACHED
 	if (!f->cached) return;
 #endif
+	if (!Vunmap(f)) return;
 	unsigned char *newBlock = (unsigned char *)calloc(f->maxsize + VFILE_INC, 1);
 	if (f->data)
 		memcpy(newBlock, f->data, f->maxsize);
@@ -40,6 +40,11 @@ typedef struct {
     BOOL cached;
     int dirty;
     int flushtable;
+    BOOL mapped; // data is a view of the file until the first write, see Vunmap
+
+#ifndef NDE_NOWIN32FILEIO
+    HANDLE mapping;
+#endif
 
 #ifdef NDE_ALLOW_NONCACHED
   #ifdef NDE_NOWIN32FILEIO
@@ -71,6 +76,7 @@ int Vfeof(VFILE *fl);
 // benski> unused: char *Vfgets(char *dest, int n, VFILE *fl);
 // benski> unused: char Vfgetc(VFILE *fl);
 int Vsync(VFILE *fl); // 1 on error updating
+void Vreplace(VFILE *fl, unsigned char *data, unsigned long size, unsigned long maxsize);
 
 #ifdef __cplusplus
 }
@@ -139,6 +139,7 @@ class NDE_API PrivateField;
 class NDE_API FilenameField;
 class NDE_API Record;
 class NDE_API Scanner;
+class NDE_API Snapshot;
 class NDE_API Table;
 class NDE_API Index;
 class NDE_API Filter;
@@ -172,6 +173,7 @@ void CopyFile(const char *filename, const char *destfilename, BOOL b);
 void DeleteFile(const char *filename);
 BOOL MoveFile(const char *filename, const char *destfilename);
 void Sleep(int ms);
+DWORD GetTickCount(void);
 
 #define stricmp strcasecmp
 #define strcmpi strcasecmp
@@ -208,10 +210,14 @@ void Sleep(int ms);
 #include "Binary32Field.h"
 #include "FilenameField.h"
 #include "Record.h"
+#include "QueryCache.h"
 #include "Scanner.h"
 #include "Table.h"
 #include "Database.h"
+#include "IndexTree.h"
 #include "Index.h"
+#include "Compaction.h"
+#include "Snapshot.h"
 #include "Filter.h"
 #include "DBUtils.h"
 
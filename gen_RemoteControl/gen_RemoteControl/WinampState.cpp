@@ -0,0 +1,515 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	PlayerState
+*
+* copy constructor, the copy has one reference and isn't published yet
+*/
+PlayerState::PlayerState(const PlayerState & other) : references(1) {
+	volume = other.volume;
+	isPlaying = other.isPlaying;
+	listPosition = other.listPosition;
+	shuffle = other.shuffle;
+	repeat = other.repeat;
+	position = other.position;
+	positionTick = other.positionTick;
+	version = other.version;
+}
+
+/**
+* \brief	getPosition
+*
+* \return	playback position in milliseconds, advanced by the time since it has been read while playing
+*/
+int const PlayerState::getPosition() const {
+	LONG current = position;
+
+	if (isPlaying == 1)
+		current += (LONG)(GetTickCount() - positionTick);
+
+	return current;
+}
+
+
+/**
+* \brief	WinampState
+*
+* constructor. the state is read from winamp until the hook is installed
+*/
+WinampState::WinampState() {
+	current = new PlayerState();
+
+	InitializeCriticalSectionAndSpinCount(&cs_state, 4000);
+
+	valid = 0;
+	invokeIpc = 0;
+
+	hasBase = false;
+	basePosition = 0;
+	basePlaying = 0;
+	baseTick = 0;
+	lastDrift = 0;
+}
+
+/**
+* \brief	~WinampState
+*
+* destructor
+*/
+WinampState::~WinampState() {
+	current->release();
+
+	DeleteCriticalSection(&cs_state);
+}
+
+/**
+* \brief	initialize
+*
+* registers the winamp ipc message of invoke. called by init on the winamp thread
+*/
+void WinampState::initialize() {
+	invokeIpc = SendMessage(plugin.hwndParent, WM_WA_IPC, (WPARAM)"RemoteControl_invoke", IPC_REGISTER_WINAMP_IPCMESSAGE);
+}
+
+/**
+* \brief	read
+*
+* reads the whole state from winamp
+*
+* \return	new state with one reference, not published
+*/
+PlayerState* const WinampState::read() {
+	PlayerState *state = new PlayerState();
+
+	state->volume = SendMessage(plugin.hwndParent, WM_WA_IPC, -666, IPC_SETVOLUME);
+	state->isPlaying = SendMessage(plugin.hwndParent, WM_WA_IPC, 0, IPC_ISPLAYING);
+	state->listPosition = SendMessage(plugin.hwndParent, WM_WA_IPC, 0, IPC_GETLISTPOS);
+	state->shuffle = SendMessage(plugin.hwndParent, WM_USER, 0, 250);
+	state->repeat = SendMessage(plugin.hwndParent, WM_USER, 0, 251);
+
+	state->positionTick = GetTickCount();
+	state->position = SendMessage(plugin.hwndParent, WM_WA_IPC, 0, IPC_GETOUTPUTTIME);
+
+	return state;
+}
+
+/**
+* \brief	publish
+*
+* makes a state the current one. only called on the winamp thread, so the current state isn't replaced by another
+* thread in the meantime. readers that still hold the old state keep it until they release it
+*
+* \param	state	new state, its reference is taken over
+*/
+void WinampState::publish(PlayerState *state) {
+	PlayerState *old = current;
+
+	state->version = old->version + 1;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_state);
+
+	current = state;
+
+	LeaveCriticalSection(&cs_state);
+	// CRITICAL END
+
+	old->release();
+}
+
+/**
+* \brief	acquire
+*
+* returns the current state. all values of it belong to the same moment
+*
+* \return	state with a reference for the caller, who releases it. read from winamp without the hook
+*/
+PlayerState* const WinampState::acquire() {
+	if (valid == 0)
+		return read();
+
+	// CRITICAL
+	EnterCriticalSection(&cs_state);
+
+	PlayerState *state = current;
+	state->addRef();
+
+	LeaveCriticalSection(&cs_state);
+	// CRITICAL END
+
+	return state;
+}
+
+/**
+* \brief	refresh
+*
+* reads the whole state and publishes it. only call from the winamp thread, there the messages are plain function calls
+*
+* \return	true if playback has started, stopped or jumped, the clients need a new clock
+*/
+bool const WinampState::refresh() {
+	PlayerState *state = read();
+
+	LONG wasPlaying = current->isPlaying;
+	LONG expected = valid != 0 ? current->getPosition() : -1;
+
+	bool changed = state->isPlaying != wasPlaying || abs(state->position - expected) > CLOCK_TOLERANCE;
+
+	publish(state);
+
+	return changed;
+}
+
+/**
+* \brief	refreshFunction
+*
+* WinampFunction of enable
+*
+* \param	parameter	state
+*/
+void WinampState::refreshFunction(void *parameter) {
+	((WinampState*)parameter)->refresh();
+}
+
+/**
+* \brief	enable
+*
+* reads the state once on the winamp thread after the hook has been installed. from now on the hook keeps it current
+*/
+void WinampState::enable() {
+	invoke(refreshFunction, this);
+
+	// CRITICAL
+	EnterCriticalSection(&cs_state);
+
+	hasBase = false;
+
+	LeaveCriticalSection(&cs_state);
+	// CRITICAL END
+
+	InterlockedExchange(&valid, 1);
+}
+
+/**
+* \brief	disable
+*
+* called before the hook is removed, the state is read from winamp again
+*/
+void WinampState::disable() {
+	InterlockedExchange(&valid, 0);
+}
+
+/**
+* \brief	handle
+*
+* runs a WinampCall sent by invoke. called by the MainWndProc hook for every WM_WA_IPC message
+*
+* \param	wParam	WinampCall
+* \param	lParam	ipc message
+*
+* \return	true if it was the invoke message
+*/
+bool const WinampState::handle(const WPARAM & wParam, const LPARAM & lParam) {
+	if (invokeIpc == 0 || (UINT_PTR)lParam != invokeIpc)
+		return false;
+
+	WinampCall *call = (WinampCall*)wParam;
+	call->function(call->parameter);
+
+	return true;
+}
+
+/**
+* \brief	invoke
+*
+* runs a function on the winamp thread with one message. every message the function sends to winamp is a plain
+* function call there, so bulk reads of the playlist don't need one thread switch per entry.
+* before init has installed the subclass the function runs on the calling thread
+*
+* \param	function	function to run
+* \param	parameter	parameter of the function
+*/
+void WinampState::invoke(WinampFunction function, void *parameter) {
+	WinampCall call = { function, parameter };
+
+	// the round trip includes the wait for the winamp thread
+	SlowOperation slow("winamp_invoke");
+
+	if (invokeIpc == 0 || SendMessage(plugin.hwndParent, WM_WA_IPC, (WPARAM)&call, invokeIpc) != WINAMP_INVOKED)
+		function(parameter);
+}
+
+/**
+* \brief	setVolume
+*
+* publishes a new volume. called by the MainWndProc hook
+*
+* \param	volume	volume 0-255
+*/
+void WinampState::setVolume(const int & volume) {
+	PlayerState *state = new PlayerState(*current);
+	state->volume = volume;
+
+	publish(state);
+}
+
+/**
+* \brief	setPosition
+*
+* publishes a new playback position, e.g. after a jump. called by the MainWndProc hook
+*
+* \param	position	playback position in milliseconds
+*/
+void WinampState::setPosition(const int & position) {
+	PlayerState *state = new PlayerState(*current);
+	state->position = position;
+	state->positionTick = GetTickCount();
+
+	publish(state);
+}
+
+/**
+* \brief	setShuffle
+*
+* publishes a new shuffle state. called by the MainWndProc hook
+*
+* \param	shuffle	1 if on
+*/
+void WinampState::setShuffle(const int & shuffle) {
+	PlayerState *state = new PlayerState(*current);
+	state->shuffle = shuffle;
+
+	publish(state);
+}
+
+/**
+* \brief	setRepeat
+*
+* publishes a new repeat state. called by the MainWndProc hook
+*
+* \param	repeat	1 if on
+*/
+void WinampState::setRepeat(const int & repeat) {
+	PlayerState *state = new PlayerState(*current);
+	state->repeat = repeat;
+
+	publish(state);
+}
+
+/**
+* \brief	getVolume
+*
+* \return	volume 0-255
+*/
+int const WinampState::getVolume() {
+	if (valid == 0)
+		return SendMessage(plugin.hwndParent, WM_WA_IPC, -666, IPC_SETVOLUME);
+
+	PlayerState *state = acquire();
+	int volume = state->volume;
+	state->release();
+
+	return volume;
+}
+
+/**
+* \brief	getIsPlaying
+*
+* \return	1 playing, 3 paused, 0 stopped
+*/
+int const WinampState::getIsPlaying() {
+	if (valid == 0)
+		return SendMessage(plugin.hwndParent, WM_WA_IPC, 0, IPC_ISPLAYING);
+
+	PlayerState *state = acquire();
+	int isPlaying = state->isPlaying;
+	state->release();
+
+	return isPlaying;
+}
+
+/**
+* \brief	getListPosition
+*
+* \return	playlist position of the current track
+*/
+int const WinampState::getListPosition() {
+	if (valid == 0)
+		return SendMessage(plugin.hwndParent, WM_WA_IPC, 0, IPC_GETLISTPOS);
+
+	PlayerState *state = acquire();
+	int listPosition = state->listPosition;
+	state->release();
+
+	return listPosition;
+}
+
+/**
+* \brief	getShuffle
+*
+* \return	1 if on
+*/
+int const WinampState::getShuffle() {
+	if (valid == 0)
+		return SendMessage(plugin.hwndParent, WM_USER, 0, 250);
+
+	PlayerState *state = acquire();
+	int shuffle = state->shuffle;
+	state->release();
+
+	return shuffle;
+}
+
+/**
+* \brief	getRepeat
+*
+* \return	1 if on
+*/
+int const WinampState::getRepeat() {
+	if (valid == 0)
+		return SendMessage(plugin.hwndParent, WM_USER, 0, 251);
+
+	PlayerState *state = acquire();
+	int repeat = state->repeat;
+	state->release();
+
+	return repeat;
+}
+
+/**
+* \brief	getPosition
+*
+* \return	playback position in milliseconds, advanced by the time since it has been read while playing
+*/
+int const WinampState::getPosition() {
+	if (valid == 0)
+		return SendMessage(plugin.hwndParent, WM_WA_IPC, 0, IPC_GETOUTPUTTIME);
+
+	PlayerState *state = acquire();
+	int position = state->getPosition();
+	state->release();
+
+	return position;
+}
+
+/**
+* \brief	takeBase
+*
+* makes the current state the clock of the clients. must be called inside cs_state
+*/
+void WinampState::takeBase() {
+	basePosition = max(current->position, 0L);
+	basePlaying = current->isPlaying;
+	baseTick = current->positionTick;
+	lastDrift = 0;
+
+	hasBase = true;
+}
+
+/**
+* \brief	getClock
+*
+* the clients advance the playback position themselves from the last clock. the tick count lets them tell how long
+* the message has been under way, so the position doesn't depend on when it is sent. a client that is synchronized
+* later gets the clock the others have, so the ticks apply to all of them
+*
+* \return	clock_<position>_<rate>_<tick>: position in milliseconds at the tick count of the server in milliseconds,
+*			playback rate in thousandths (1000 while playing, 0 otherwise)
+*/
+std::string const WinampState::getClock() {
+	LONG position;
+	DWORD tick;
+	int playing;
+
+	if (valid == 0) {
+		tick = GetTickCount();
+		position = SendMessage(plugin.hwndParent, WM_WA_IPC, 0, IPC_GETOUTPUTTIME);
+		playing = SendMessage(plugin.hwndParent, WM_WA_IPC, 0, IPC_ISPLAYING);
+	} else {
+		// CRITICAL
+		EnterCriticalSection(&cs_state);
+
+		if (!hasBase)
+			takeBase();
+
+		position = basePosition;
+		playing = basePlaying;
+		tick = baseTick;
+
+		LeaveCriticalSection(&cs_state);
+		// CRITICAL END
+	}
+
+	stringstream clock;
+	clock << "clock_" << max(position, 0L) << "_" << (playing == 1 ? 1000 : 0) << "_" << tick;
+
+	return clock.str();
+}
+
+/**
+* \brief	newClock
+*
+* takes the current state as the clock of the clients, for a broadcast after refresh has reported a change
+*
+* \return	clock_ event, see getClock
+*/
+std::string const WinampState::newClock() {
+	// CRITICAL
+	EnterCriticalSection(&cs_state);
+
+	hasBase = false;
+
+	LeaveCriticalSection(&cs_state);
+	// CRITICAL END
+
+	return getClock();
+}
+
+/**
+* \brief	getTick
+*
+* compares the position of the current state with the one the clients have advanced to from their clock. the drift is
+* sent when it has changed by more than CLOCK_DRIFT since the last tick, relative to the clock and not to the last
+* tick, so a later tick replaces an earlier one that hasn't been sent yet
+*
+* \return	tick_<drift>_<elapsed>_<tickBase>: tickBase is the tick count of the clock_ the tick is relative to. at
+*			tickBase plus elapsed milliseconds the position was the one of the clock advanced by elapsed plus drift
+*			milliseconds. tickBase tells a tick that arrives as a datagram before its clock apart. empty if the
+*			clients are close enough or need a new clock
+*/
+std::string const WinampState::getTick() {
+	if (valid == 0)
+		return std::string();
+
+	// CRITICAL
+	EnterCriticalSection(&cs_state);
+
+	// a change of the playback state gets a new clock
+	if (!hasBase || current->isPlaying != basePlaying || basePlaying != 1) {
+		LeaveCriticalSection(&cs_state);
+		// CRITICAL END
+
+		return std::string();
+	}
+
+	DWORD tickBase = baseTick;
+	LONG elapsed = (LONG)(current->positionTick - baseTick);
+	LONG drift = current->position - (basePosition + elapsed);
+
+	bool drifted = abs(drift - lastDrift) > CLOCK_DRIFT;
+
+	if (drifted)
+		lastDrift = drift;
+
+	LeaveCriticalSection(&cs_state);
+	// CRITICAL END
+
+	if (!drifted)
+		return std::string();
+
+	stringstream tick;
+	tick << "tick_" << drift << "_" << elapsed << "_" << tickBase;
+
+	return tick.str();
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include "stdafx.h"
+
+
+// function that is run on the winamp thread by WinampState::invoke
+typedef void (*WinampFunction)(void *parameter);
+
+// wParam of the invoke message
+struct WinampCall {
+	WinampFunction function;
+	void *parameter;
+};
+
+// return value of a handled invoke message
+#define WINAMP_INVOKED 0x52434956
+
+// milliseconds a read position may differ from the advanced one before the clients get a new clock
+#define CLOCK_TOLERANCE 250
+
+// milliseconds the sampled position may drift from the clock of the clients before they get a tick_
+#define CLOCK_DRIFT 100
+
+
+// player state of winamp at one moment. a published state is never changed, the readers keep a reference while
+// they serialize it, so no lock is held while they send
+class PlayerState {
+	private:
+		volatile LONG references;
+
+		~PlayerState() {}
+
+	public:
+		PlayerState() : references(1), volume(0), isPlaying(0), listPosition(0), shuffle(0), repeat(0), position(0), positionTick(0), version(0) {}
+		PlayerState(const PlayerState & other);
+
+		LONG volume;
+		LONG isPlaying;
+		LONG listPosition;
+		LONG shuffle;
+		LONG repeat;
+
+		// playback position in milliseconds at positionTick
+		LONG position;
+		DWORD positionTick;
+
+		// increases with every published state
+		LONG version;
+
+		int const getPosition() const;
+
+		void addRef() { InterlockedIncrement(&references); }
+		void release() { if (InterlockedDecrement(&references) == 0) delete this; }
+};
+
+
+// player state of winamp, mirrored on the winamp thread by the MainWndProc hook. reading it doesn't send
+// messages to winamp while the hook is installed, only changes have to go to winamp. every change publishes
+// a new PlayerState, the lock only guards swapping and referencing the current one
+class WinampState {
+	private:
+		// published state, one reference is held by WinampState
+		PlayerState *current;
+
+		// critical state section, held for a pointer swap or a reference
+		CRITICAL_SECTION cs_state;
+
+		// 1 while the hook keeps the state current
+		volatile LONG valid;
+
+		// registered winamp ipc message that runs a WinampCall
+		UINT_PTR invokeIpc;
+
+		// clock the clients advance the position from, guarded by cs_state. a new one is taken when playback has
+		// started, stopped or jumped, the drift of the last tick_ is relative to it
+		bool hasBase;
+		LONG basePosition;
+		LONG basePlaying;
+		DWORD baseTick;
+		LONG lastDrift;
+
+		static void refreshFunction(void *parameter);
+		static PlayerState* const read();
+
+		void publish(PlayerState *state);
+		void takeBase();
+
+	public:
+		WinampState();
+
+		~WinampState();
+
+		void initialize();
+
+		bool const refresh();
+		void enable();
+		void disable();
+
+		bool const handle(const WPARAM & wParam, const LPARAM & lParam);
+		void invoke(WinampFunction function, void *parameter);
+
+		PlayerState* const acquire();
+
+		void setVolume(const int & volume);
+		void setPosition(const int & position);
+		void setShuffle(const int & shuffle);
+		void setRepeat(const int & repeat);
+
+		int const getVolume();
+		int const getIsPlaying();
+		int const getListPosition();
+		int const getShuffle();
+		int const getRepeat();
+		int const getPosition();
+		std::string const getClock();
+		std::string const newClock();
+		std::string const getTick();
+};
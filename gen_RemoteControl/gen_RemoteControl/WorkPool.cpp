@@ -0,0 +1,332 @@
+#include "stdafx.h"
+
+
+/**
+* \brief	WorkCancel
+*
+* constructor
+*
+* \param	event	set when a task of the token is dropped, NULL if nobody waits for them
+*/
+WorkCancel::WorkCancel(HANDLE event) : event(event) {
+	cancelled = 0;
+	dropped = 0;
+}
+
+/**
+* \brief	cancel
+*
+* the tasks of the token that haven't started yet are dropped
+*/
+void WorkCancel::cancel() {
+	InterlockedExchange(&cancelled, 1);
+}
+
+/**
+* \brief	isCancelled
+*
+* a running task may ask it to stop early
+*
+* \return	true if cancel has been called
+*/
+bool const WorkCancel::isCancelled() const {
+	return cancelled != 0;
+}
+
+/**
+* \brief	drop
+*
+* counts a task that has been dropped. called by the work pool
+*/
+void WorkCancel::drop() {
+	InterlockedIncrement(&dropped);
+
+	if (event != NULL)
+		SetEvent(event);
+}
+
+/**
+* \brief	getDropped
+*
+* \return	number of dropped tasks
+*/
+LONG const WorkCancel::getDropped() const {
+	return dropped;
+}
+
+
+/**
+* \brief	WorkPool
+*
+* constructor. the workers are started by start, not while the DLL is loaded
+*/
+WorkPool::WorkPool() {
+	queued = 0;
+	count = 0;
+	stopping = 0;
+	executed = 0;
+	stolen = 0;
+	rejected = 0;
+	dropped = 0;
+
+	semaphore = CreateSemaphore(NULL, 0, WORKPOOL_QUEUE_SIZE + WORKPOOL_MAX_THREADS, NULL);
+	tlsWorker = TlsAlloc();
+
+	for (int i = 0; i < WORKPOOL_MAX_THREADS; i++) {
+		threads[i] = NULL;
+
+		InitializeCriticalSection(&deques[i].cs_deque);
+	}
+
+	InitializeCriticalSection(&cs_workpool);
+}
+
+/**
+* \brief	~WorkPool
+*
+* destructor
+*/
+WorkPool::~WorkPool() {
+	CloseHandle(semaphore);
+
+	if (tlsWorker != TLS_OUT_OF_INDEXES)
+		TlsFree(tlsWorker);
+
+	for (int i = 0; i < WORKPOOL_MAX_THREADS; i++)
+		DeleteCriticalSection(&deques[i].cs_deque);
+
+	DeleteCriticalSection(&cs_workpool);
+}
+
+/**
+* \brief	start
+*
+* starts one worker per core. called by init
+*/
+void WorkPool::start() {
+	if (count > 0)
+		return;
+
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+
+	// at least two, a task may wait for another one
+	int workers = max(2, min((int)info.dwNumberOfProcessors, WORKPOOL_MAX_THREADS));
+
+	stopping = 0;
+
+	for (int i = 0; i < workers; i++) {
+		threads[count] = CreateThread(NULL, 0, workerFunction, (LPVOID)(INT_PTR)(count + 1), 0, NULL);
+
+		if (threads[count] != NULL)
+			count++;
+	}
+}
+
+/**
+* \brief	stop
+*
+* runs the tasks that are still queued and waits for the workers. later submits fail. called by quit
+*/
+void WorkPool::stop() {
+	if (count == 0)
+		return;
+
+	InterlockedExchange(&stopping, 1);
+
+	// every worker wakes up once more after the queues are empty
+	ReleaseSemaphore(semaphore, count, NULL);
+
+	DWORD start = GetTickCount();
+
+	for (int i = 0; i < count; i++)
+		joinThread(threads[i], WORKPOOL_STOP_TIMEOUT - min(GetTickCount() - start, (DWORD)WORKPOOL_STOP_TIMEOUT));
+
+	count = 0;
+}
+
+/**
+* \brief	submit
+*
+* queues a task. a worker queues it in its own deque unless it has a high or low priority
+*
+* \param	function	task
+* \param	parameter	parameter of the task
+* \param	priority	WORK_PRIORITY_
+* \param	cancel		cancellation token, NULL if the task can't be cancelled
+*
+* \return	false if the pool isn't running or the queue is full, the caller runs the task itself then
+*/
+bool const WorkPool::submit(LPTHREAD_START_ROUTINE function, void *parameter, const int & priority, WorkCancel *cancel) {
+	if (count == 0 || stopping != 0)
+		return false;
+
+	if (InterlockedIncrement(&queued) > WORKPOOL_QUEUE_SIZE) {
+		InterlockedDecrement(&queued);
+		InterlockedIncrement(&rejected);
+
+		return false;
+	}
+
+	WorkItem item = { function, parameter, cancel };
+	int worker = (int)(INT_PTR)TlsGetValue(tlsWorker);
+
+	if (worker > 0 && priority == WORK_PRIORITY_NORMAL) {
+		WorkDeque & deque = deques[worker - 1];
+
+		// CRITICAL
+		EnterCriticalSection(&deque.cs_deque);
+
+		deque.items.push_back(item);
+
+		LeaveCriticalSection(&deque.cs_deque);
+		// CRITICAL END
+	} else {
+		// CRITICAL
+		EnterCriticalSection(&cs_workpool);
+
+		queues[priority].push_back(item);
+
+		LeaveCriticalSection(&cs_workpool);
+		// CRITICAL END
+	}
+
+	ReleaseSemaphore(semaphore, 1, NULL);
+
+	return true;
+}
+
+/**
+* \brief	take
+*
+* takes the next task of a worker: the newest of its own deque, then the oldest of the queues by priority, then
+* the oldest of another deque
+*
+* \param	worker	number of the worker from 1
+* \param	item	receives the task
+*
+* \return	false if no task is waiting
+*/
+bool const WorkPool::take(const int & worker, WorkItem & item) {
+	WorkDeque & own = deques[worker - 1];
+	bool found = false;
+
+	// CRITICAL
+	EnterCriticalSection(&own.cs_deque);
+
+	if (!own.items.empty()) {
+		item = own.items.back();
+		own.items.pop_back();
+
+		found = true;
+	}
+
+	LeaveCriticalSection(&own.cs_deque);
+	// CRITICAL END
+
+	if (found)
+		return true;
+
+	// CRITICAL
+	EnterCriticalSection(&cs_workpool);
+
+	for (int i = 0; i < WORK_PRIORITIES && !found; i++) {
+		if (!queues[i].empty()) {
+			item = queues[i].front();
+			queues[i].pop_front();
+
+			found = true;
+		}
+	}
+
+	LeaveCriticalSection(&cs_workpool);
+	// CRITICAL END
+
+	for (int i = 1; i < count && !found; i++) {
+		WorkDeque & other = deques[(worker - 1 + i) % count];
+
+		// CRITICAL
+		EnterCriticalSection(&other.cs_deque);
+
+		if (!other.items.empty()) {
+			item = other.items.front();
+			other.items.pop_front();
+
+			found = true;
+		}
+
+		LeaveCriticalSection(&other.cs_deque);
+		// CRITICAL END
+
+		if (found)
+			InterlockedIncrement(&stolen);
+	}
+
+	return found;
+}
+
+/**
+* \brief	run
+*
+* runs a task unless its token has been cancelled
+*
+* \param	item	task
+*/
+void WorkPool::run(const WorkItem & item) {
+	InterlockedDecrement(&queued);
+
+	if (item.cancel != NULL && item.cancel->isCancelled()) {
+		InterlockedIncrement(&dropped);
+
+		item.cancel->drop();
+
+		return;
+	}
+
+	item.function(item.parameter);
+
+	InterlockedIncrement(&executed);
+}
+
+/**
+* \brief	workerFunction
+*
+* thread of a worker. runs tasks while the semaphore counts waiting ones, returns once the pool is stopped and
+* nothing is left
+*
+* \param	parameter	number of the worker from 1
+*
+* \return	0
+*/
+DWORD WINAPI WorkPool::workerFunction(LPVOID parameter) {
+	int worker = (int)(INT_PTR)parameter;
+
+	TlsSetValue(workpool.tlsWorker, parameter);
+
+	while (WaitForSingleObject(workpool.semaphore, INFINITE) == WAIT_OBJECT_0) {
+		WorkItem item;
+
+		// the count of a task has been taken, the wake ups of stop find nothing
+		if (workpool.take(worker, item))
+			workpool.run(item);
+		else if (workpool.stopping != 0)
+			break;
+	}
+
+	return 0;
+}
+
+/**
+* \brief	report
+*
+* adds the state of the pool to the stats
+*
+* \param	lines	receives the lines
+*/
+void WorkPool::report(std::vector<std::string> & lines) {
+	stringstream line;
+	line << "workpool workers " << count << " queued " << queued << " executed " << executed << " stolen " << stolen
+		<< " rejected " << rejected << " dropped " << dropped;
+
+	lines.push_back(line.str());
+}
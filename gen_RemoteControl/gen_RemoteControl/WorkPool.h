@@ -0,0 +1,100 @@
+#pragma once
+#include "stdafx.h"
+
+// priorities of the tasks: requests a client waits for, metadata and cover work, maintenance like the update check
+#define WORK_PRIORITY_HIGH 0
+#define WORK_PRIORITY_NORMAL 1
+#define WORK_PRIORITY_LOW 2
+#define WORK_PRIORITIES 3
+
+// workers at most, one per core
+#define WORKPOOL_MAX_THREADS 16
+
+// tasks waiting at most, submit fails above
+#define WORKPOOL_QUEUE_SIZE 1024
+
+// milliseconds quit waits for the queued tasks
+#define WORKPOOL_STOP_TIMEOUT 5000
+
+
+// cancellation token of a group of tasks. a task whose token has been cancelled is dropped before it starts,
+// so its parameter has to be owned by the submitter. the submitter may count the dropped tasks and be signalled
+class WorkCancel {
+	private:
+		volatile LONG cancelled;
+		volatile LONG dropped;
+
+		// set when a task is dropped, NULL if nobody waits
+		HANDLE event;
+
+	public:
+		WorkCancel(HANDLE event = NULL);
+
+		void cancel();
+		bool const isCancelled() const;
+
+		void drop();
+		LONG const getDropped() const;
+};
+
+
+// one submitted task
+struct WorkItem {
+	LPTHREAD_START_ROUTINE function;
+	void *parameter;
+	WorkCancel *cancel;
+};
+
+
+// tasks a worker has submitted itself. the worker takes the newest, idle workers steal the oldest
+struct WorkDeque {
+	std::deque<WorkItem> items;
+
+	// critical deque section
+	CRITICAL_SECTION cs_deque;
+};
+
+
+// the one thread pool of the plugin, one worker per core. tasks from other threads wait in a bounded queue per
+// priority, tasks a worker submits go to its own deque and run there unless another worker steals them. the
+// workers wait on a semaphore that counts the waiting tasks
+class WorkPool {
+	private:
+		std::deque<WorkItem> queues[WORK_PRIORITIES];
+		volatile LONG queued;
+
+		WorkDeque deques[WORKPOOL_MAX_THREADS];
+		HANDLE threads[WORKPOOL_MAX_THREADS];
+		int count;
+
+		HANDLE semaphore;
+		volatile LONG stopping;
+
+		// thread local index of the worker, 0 on other threads
+		DWORD tlsWorker;
+
+		volatile LONG executed;
+		volatile LONG stolen;
+		volatile LONG rejected;
+		volatile LONG dropped;
+
+		// critical work pool section
+		CRITICAL_SECTION cs_workpool;
+
+		static DWORD WINAPI workerFunction(LPVOID parameter);
+
+		bool const take(const int & worker, WorkItem & item);
+		void run(const WorkItem & item);
+
+	public:
+		WorkPool();
+
+		~WorkPool();
+
+		void start();
+		void stop();
+
+		bool const submit(LPTHREAD_START_ROUTINE function, void *parameter, const int & priority = WORK_PRIORITY_NORMAL, WorkCancel *cancel = NULL);
+
+		void report(std::vector<std::string> & lines);
+};
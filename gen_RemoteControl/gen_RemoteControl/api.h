@@ -7,8 +7,21 @@ extern api_service *serviceManager;
 
 #include <api/service/waServiceFactory.h>
 
+#include <api/memmgr/api_memmgr.h>
+extern api_memmgr *memmgrApi;
+#define WASABI_API_MEMMGR memmgrApi
+
 #include "../Agave/Language/api_language.h"
 
 #include "../Agave/Queue/api_queue.h"
 
+#include "../Agave/AlbumArt/svc_albumArtProvider.h"
+
+#include "../ml_local/api_mldb.h"
+
+#include "../Agave/DecodeFile/api_decodefile.h"
+
+#include "../playlist/api_playlistmanager.h"
+#include "../playlist/ifc_playlistloadercallback.h"
+
 #endif
\ No newline at end of file
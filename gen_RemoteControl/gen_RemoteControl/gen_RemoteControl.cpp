@@ -2,21 +2,81 @@
 
 #include "stdafx.h"
 
+// loads the metadata index and starts the server after init has returned
+volatile HANDLE startupThread = NULL;
+volatile LONG startupRunning = 0;
+
+// DEFER_ flags of the events since the last deferredFunction and the winamp ipc message that runs it
+static volatile LONG deferred = 0;
+static UINT_PTR deferIpc = 0;
+
+/**
+* \brief	startupFunction
+*
+* background phase of init: loads the metadata index and starts the server if autostart is set. runs while winamp
+* finishes its own startup, the name lookups and file reads don't delay it
+*
+* \param	parameter	performance counter in microseconds when init was called
+*
+* \return	0
+*/
+DWORD WINAPI startupFunction(LPVOID parameter) {
+	LONGLONG started = *(LONGLONG*)parameter;
+	delete (LONGLONG*)parameter;
+
+	ThreadPolicy policy(THREAD_CLASS_BACKGROUND);
+
+	// covers extracted in the last sessions
+	coverstore.open(coverStorePath);
+
+	// metadata known from the last session
+	metadatacache.load(indexPath);
+
+	// start server?
+	if (autostart == 1)
+		startServer();
+
+	stringstream startupStream;
+	startupStream << "Background startup finished after " << (metrics.now() - started) / 1000 << " ms\r\n";
+
+	UIManager::addLogText(startupStream.str());
+
+	InterlockedExchange(&startupRunning, 0);
+
+	return 0;
+}
+
 /**
 * \brief	init
 *
-* initializes the plugin: checks winamp version, creates new UI, loads services, gets settings folder, reads settings and creates critical sections.
-* if settings are set: shows UI and starts server. must return 0 or plugin is not loaded.
+* initializes the plugin: checks winamp version, loads services, gets settings folder, reads settings and creates critical sections.
+* shows UI if set and starts the background phase, see startupFunction. the UI module is only loaded when the UI is shown.
+* must return 0 or plugin is not loaded.
 *
 * \return	0 if success, 1 if error
 */
 int init() {
+	LONGLONG started = metrics.now();
+
+	// texts of the UI, kept until the UI is shown
+	UIManager::initialize();
 	
 	// winamp version 5.5+
 	if(SendMessage(plugin.hwndParent, WM_WA_IPC, 0, IPC_GETVERSION) >= 0x5050) {
 
-		// initialize GUI
-		UIManager::setUI(gcnew gen_RemoteControl::UI());
+		winampstate.initialize();
+
+		deferIpc = SendMessage(plugin.hwndParent, WM_WA_IPC, (WPARAM)"RemoteControl_defer", IPC_REGISTER_WINAMP_IPCMESSAGE);
+
+		// for the whole session, installHook only enables it. other subclasses of the window stay intact
+		if (SetWindowSubclass(plugin.hwndParent, MainWndProc, HOOK_SUBCLASS_ID, 0) == FALSE)
+			UIManager::addLogText("Could not install the window hook!\r\n", LOG_ERROR);
+
+		// cover scaling
+		Gdiplus::GdiplusStartupInput gdiplusInput;
+
+		if (Gdiplus::GdiplusStartup(&gdiplusToken, &gdiplusInput, NULL) != Gdiplus::Ok)
+			gdiplusToken = 0;
 
 		// load wasabi services
 		WASABI_API_SVC = (api_service*)SendMessage(plugin.hwndParent, WM_WA_IPC, 0, IPC_GET_API_SERVICE);
@@ -25,11 +85,14 @@ int init() {
 
 		if(WASABI_API_SVC != NULL) {
 			ServiceBuild(WASABI_API_LNG,languageApiGUID);
+			ServiceBuild(WASABI_API_MEMMGR,memMgrApiServiceGuid);
 
-			WASABI_API_START_LANG(plugin.hDllInstance,GenQueueExampleLangGUID);
+			// hosts without the language service, like RemoteControlHost
+			if (WASABI_API_LNG != NULL)
+				WASABI_API_START_LANG(plugin.hDllInstance,GenQueueExampleLangGUID);
 		}
 		else
-			UIManager::addLogText("Could not load wasabi services!\r\n");
+			UIManager::addLogText("Could not load wasabi services!\r\n", LOG_ERROR);
 		
 
 		// check JTFE version (1.2.4 necessary for QUEUE_X commands)
@@ -49,21 +112,76 @@ int init() {
 		settingsPath += string("\\Winamp\\");
 		settingsPath += settingsFileName;
 
+		indexPath = string(T2A(szPath));
+		indexPath += string("\\Winamp\\");
+		indexPath += indexFileName;
+
+		tracePath = string(T2A(szPath));
+		tracePath += string("\\Winamp\\");
+		tracePath += traceFileName;
+
+		capturePath = string(T2A(szPath));
+		capturePath += string("\\Winamp\\");
+		capturePath += captureFileName;
+
+		logPath = string(T2A(szPath));
+		logPath += string("\\Winamp\\");
+		logPath += logFileName;
+
+		logwriter.start(logPath);
+
+		coverStorePath = string(T2A(szPath));
+		coverStorePath += string("\\Winamp\\");
+		coverStorePath += coverStoreName;
+
+		// long TagLib scans of local files read from memory maps
+		TagLib::FileStream::setMemoryMapping(true);
+
+		// corrupt and pathological files fail fast with what has been read
+		TagLib::File::setParseLimits(METADATA_PARSE_MAX_BYTES, METADATA_PARSE_MAX_BLOCK, METADATA_PARSE_DEADLINE);
+
 		// read current settings
 		if (readSettings() == 1)
-			UIManager::addLogText("Could not read settings!\r\n");
+			UIManager::addLogText("Could not read settings!\r\n", LOG_ERROR);
 
-		// initialize critical sections
-		InitializeCriticalSection(&cs_alive);
-		InitializeCriticalSection(&cs_winamp);
+		// winamp only keeps the hook and runs the calls of the host, the host starts the server
+		if (hostprocess == 1 && !ServerHost::isHosted()) {
+			if (serverhost.start() == 0) {
+				UIManager::addLogText("Server runs in " SERVER_HOST_EXECUTABLE "\r\n");
+
+				return 0;
+			}
+
+			UIManager::addLogText("Could not start " SERVER_HOST_EXECUTABLE ", the server runs in winamp!\r\n", LOG_ERROR);
+		}
 
 		// show UI?
 		if (showconfigonstartup == 1)
 			UIManager::showUI(true);
 
-		// start server?
-		if (autostart == 1)
-			startServer();
+		// metadata index and server
+		InterlockedExchange(&startupRunning, 1);
+
+		LONGLONG *startupStarted = new LONGLONG(started);
+
+		// the caches give memory back when all of them are above the budget or the system is low on memory
+		memorybudget.add(BUDGET_METADATA, &metadatacache);
+		memorybudget.add(BUDGET_COVERS, &coverCache);
+		memorybudget.add(BUDGET_SNAPSHOT, &librarysnapshot);
+		memorybudget.add(BUDGET_PLAYLISTS, &playlistcache);
+		memorybudget.start();
+
+		workpool.start();
+
+		startupThread = CreateThread(NULL, 0, startupFunction, startupStarted, 0, NULL);
+
+		if (startupThread == NULL)
+			startupFunction(startupStarted);
+
+		stringstream initStream;
+		initStream << "Plugin initialized in " << (metrics.now() - started) / 1000 << " ms\r\n";
+
+		UIManager::addLogText(initStream.str());
 	}
 	
   return 0;
@@ -77,28 +195,88 @@ int init() {
 *
 */
 void quit() {
+	// the host quits the server, winamp has no other state
+	if (serverhost.isActive()) {
+		serverhost.stop();
+
+		RemoveWindowSubclass(plugin.hwndParent, MainWndProc, HOOK_SUBCLASS_ID);
+
+		logwriter.stop();
+
+		if (gdiplusToken != 0)
+			Gdiplus::GdiplusShutdown(gdiplusToken);
+
+		gdiplusToken = 0;
+
+		return;
+	}
+
 	// fast close
 	UIManager::showUI(false);
 
+	// a server that is still starting is stopped below
+	joinThread(startupThread, STARTUP_STOP_TIMEOUT);
+
 
 	// stop server
 	stopServer(false);
 
+	RemoveWindowSubclass(plugin.hwndParent, MainWndProc, HOOK_SUBCLASS_ID);
+
+	TlsChannel::stop();
+
+	playlistscanner.stop();
+
+	librarysearch.stop();
+
+	playlistindex.stop();
+	playlistgroups.stop();
+
+	playlistbrowser.stop();
+
+	audiostreamer.stop();
+
+	levelmeter.stop();
 
-	// delete critical sections
-	DeleteCriticalSection(&cs_alive);
-	DeleteCriticalSection(&cs_winamp);
+	// a job that is stopped doesn't queue its tags
+	replaygainjob.stop();
+
+	// edits that are still waiting, the cached metadata already has them
+	tagwriter.stop();
+
+	directorywatcher.stop();
+
+	// the metadata tasks that are still queued add to the index
+	workpool.stop();
+
+	memorybudget.stop();
+
+	// keep the metadata for the next start
+	if (metadatacache.save(indexPath) != 0)
+		UIManager::addLogText("Could not save metadata index!\r\n", LOG_ERROR);
+
+	// the entries of the shutdown are the last ones
+	logwriter.stop();
+
+	if (gdiplusToken != 0)
+		Gdiplus::GdiplusShutdown(gdiplusToken);
+
+	gdiplusToken = 0;
 }
 
 
 /**
 * \brief	config
 *
-* executed when plugin information is opened. shows UI.
+* executed when plugin information is opened. shows UI, the UI module is loaded the first time. the UI of a server
+* in RemoteControlHost is shown by the host
 *
 */
 void config() {
-	UIManager::showUI(true);
+	if (serverhost.isActive())
+		serverhost.showConfig();
+	else
+		UIManager::showUI(true);
 }
 
 
@@ -121,6 +299,7 @@ extern "C" __declspec(dllexport) RemoteControlPlugin * winampGetGeneralPurposePl
 extern "C" __declspec( dllexport ) int winampUninstallPlugin(HINSTANCE hDllInst, HWND hwndDlg, int param) {
 	// delete config file
 	remove(settingsPath.c_str());
+	remove(indexPath.c_str());
 	
 	UIManager::showUI(false);
 
@@ -130,142 +309,239 @@ extern "C" __declspec( dllexport ) int winampUninstallPlugin(HINSTANCE hDllInst,
 
 
 /**
-* \brief	MainWndProc
+* \brief	deferredFunction
+*
+* reads what the events of the hook have changed and queues the tasks that need the new state. runs on the winamp
+* thread in its own message, the messages it sends are plain function calls there
+*/
+static void deferredFunction() {
+	LONG work = InterlockedExchange(&deferred, 0);
+
+	if (hookInstalled == 0)
+		return;
+
+	if (work & DEFER_VOLUME) {	// volume changed with mouse wheel
+		winampstate.setVolume(SendMessage(plugin.hwndParent, WM_WA_IPC, -666, IPC_SETVOLUME));
+
+		tasklist.push("volume_");
+	}
+
+	// the clients advance the position from the last clock
+	if ((work & (DEFER_STATE | DEFER_NEW_SONG)) && winampstate.refresh())
+		tasklist.push(winampstate.newClock());
+
+	if (work & DEFER_NEW_SONG)
+		tasklist.push("new_song_");
+
+	if ((work & DEFER_QUEUE_NEXT) && WASABI_API_QUEUEMGR->GetNumberOfQueuedItems() != 0)	// this is next element in queue
+		tasklist.push("queue_next");	// tell app to update queue
+}
+
+/**
+* \brief	defer
 *
-* callback hook that is called when client is connected and winamp actions are performed. 
-* enqueues the command in the tasklist and returns to original winamp function.
+* has deferredFunction run after the current message. several events before it runs share one run
+*
+* \param	work	DEFER_ flags
 */
-LRESULT CALLBACK MainWndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam) {
-    if (message == WM_WA_IPC) {
-        if (lParam == delay_load_ipc) {
-            CHECK_QUEUEMGR();
-        }  else if (lParam == 636) { // item has just finished playback or next button is pressed
-            int QueueLength = WASABI_API_QUEUEMGR->GetNumberOfQueuedItems();
-
-            if (QueueLength != 0)   // this is next element in queue
+static void defer(const LONG & work) {
+	if (InterlockedOr(&deferred, work) != 0)
+		return;	// already posted
+
+	if (deferIpc == 0 || PostMessage(plugin.hwndParent, WM_WA_IPC, 0, deferIpc) == FALSE)
+		deferredFunction();
+}
+
+/**
+* \brief	ipcMessage
+*
+* handles the WM_WA_IPC messages of the hook
+*
+* \return	result of winamp
+*/
+static LRESULT ipcMessage(HWND hwnd, WPARAM wParam, LPARAM lParam) {
+	TraceSpan span("hook", (int)lParam);
+
+	LONG work = 0;
+
+	switch (lParam) {
+		case 636:	// item has just finished playback or next button is pressed
+			if (WASABI_API_QUEUEMGR->GetNumberOfQueuedItems() != 0)	// this is next element in queue
 				tasklist.push("queue_next");	// tell app to update queue
-        } else if (lParam == IPC_PLAYING_FILE) {	// begin playing
-            CallWindowProc(lpWndProcOld,hwnd,message,wParam,lParam);
-
-			tasklist.push("new_song_");
-            
-            return 0;
-        } else if (lParam == IPC_SETVOLUME && wParam != -666) {	// volume changed
-            // CRITICAL
-			EnterCriticalSection(&cs_winamp);
-
-			volume = wParam;
-
-			LeaveCriticalSection(&cs_winamp);
-			// CRITICAL END
-
-            tasklist.push("volume_");
-        } else if (lParam == IPC_JUMPTOTIME) {	// position in track changed
-            // CRITICAL
-			EnterCriticalSection(&cs_winamp);
-
-			progress = wParam;
-
-			LeaveCriticalSection(&cs_winamp);
-			// CRITICAL END
-			
-            tasklist.push("progress_");
-        } else if (lParam == IPC_PLAYLIST_MODIFIED) {	// playlist modified
-			UIManager::addLogText("Playlist out of sync!\r\n");
-        } else if (lParam == genjtfe_queue) {
-			if (wParam == QUEUE_ADD || wParam == QUEUE_CLEAR || wParam == QUEUE_REMOVE || wParam == QUEUE_RANDOMISE || wParam == QUEUE_MOVE || wParam == QUEUE_MISC) {
-				// sync queue lists
-				tasklist.push("queueList");
-			}
-		}
 
-    } else if (message == WM_COMMAND || message == WM_SYSCOMMAND) {
-        if (wParam == 40048 || wParam == 40044) {	// next or previous button pressed
-            // CRITICAL
-			EnterCriticalSection(&cs_winamp);
+			work = DEFER_STATE;
+			break;
+		case IPC_PLAYING_FILE:	// begin playing
+			work = DEFER_NEW_SONG;
+			break;
+		case IPC_SETVOLUME:	// volume changed
+			if (wParam != -666) {
+				winampstate.setVolume(wParam);
 
-			isPlaying = SendMessage(plugin.hwndParent, WM_WA_IPC, 0, IPC_ISPLAYING);
+				tasklist.push("volume_", -1, ALL_SESSIONS, commandOrigin);
 
-			LeaveCriticalSection(&cs_winamp);
-			// CRITICAL END
-			
-            CallWindowProc(lpWndProcOld,hwnd,message,wParam,lParam);
+				work = DEFER_STATE;
+			}
+			break;
+		case IPC_JUMPTOTIME:	// position in track changed
+			winampstate.setPosition(wParam);
 
-            // if not playing
-            if (isPlaying != 1) {
-                tasklist.push("new_song_");
+			tasklist.push("progress_", -1, ALL_SESSIONS, commandOrigin);
 
-                if (wParam == 40048)	// if next pressed
-                    if (WASABI_API_QUEUEMGR->GetNumberOfQueuedItems() != 0) // this is next element in queue
-                        tasklist.push("queue_next");	// tell app to update queue
-            }
+			work = DEFER_STATE;
+			break;
+		case IPC_PLAYLIST_MODIFIED:	// playlist modified, an edit of the clients tells them once
+			if (!playlisteditor.isEditing()) {
+				playlistsnapshot.invalidate();
+				tasklist.push("playlist_modified");	// difference is computed in sendCommandThread
 
-            return 0;
-        } else if (wParam == 40045) {	// play button pressed
-			isPlaying = SendMessage(plugin.hwndParent, WM_WA_IPC, 0, IPC_ISPLAYING);
+				work = DEFER_STATE;
+			}
+			break;
+		case IPC_SETPLAYLISTPOS:	// current track changed
+			work = DEFER_STATE;
+			break;
+		case IPC_FILE_TAG_MAY_HAVE_UPDATEDW:	// tags of a file edited
+			librarysnapshot.fileChanged((const wchar_t*)wParam);
+			playlistsnapshot.invalidate();
+			playlistsnapshot.titlesChanged();
+			break;
+		case IPC_FILE_TAG_MAY_HAVE_UPDATED:
+			if (wParam != 0) {
+				librarysnapshot.fileChanged(CA2W((const char*)wParam));
+				playlistsnapshot.invalidate();
+				playlistsnapshot.titlesChanged();
+			}
+			break;
+		default:
+			if ((UINT_PTR)lParam == delay_load_ipc) {
+				CHECK_QUEUEMGR();
+			} else if (genjtfe_queue != NULL && (UINT_PTR)lParam == genjtfe_queue) {
+				if (wParam == QUEUE_ADD || wParam == QUEUE_CLEAR || wParam == QUEUE_REMOVE || wParam == QUEUE_RANDOMISE || wParam == QUEUE_MOVE || wParam == QUEUE_MISC) {
+					// sync queue lists
+					tasklist.push("queueList");
+				}
+			}
+	}
 
-			if (isPlaying == 3)
-                tasklist.push("new_song_");     // NEEDED FOR PAUSE -> PLAY
-        } else if (wParam == 40046) {	// pause button pressed
-                tasklist.push("pause");
-        } else if (wParam == 40047) {	// stop button pressed
-                tasklist.push("stop");
-        } else if (wParam == 40023) {	// shuffle button pressed
-            if (shuffle_status == 1) {
-                    // CRITICAL
-					EnterCriticalSection(&cs_winamp);
+	LRESULT result = DefSubclassProc(hwnd, WM_WA_IPC, wParam, lParam);
 
-					shuffle_status = 0;
+	if (work != 0)
+		defer(work);
 
-					LeaveCriticalSection(&cs_winamp);
-					// CRITICAL END
-					
-					tasklist.push("shuffle_0");
-            } else if (shuffle_status == 0) {
-                    // CRITICAL
-					EnterCriticalSection(&cs_winamp);
+	return result;
+}
 
-					shuffle_status = 1;
+/**
+* \brief	commandMessage
+*
+* handles the WM_COMMAND and WM_SYSCOMMAND messages of the hook, the buttons of winamp
+*
+* \return	result of winamp
+*/
+static LRESULT commandMessage(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam) {
+	LONG work = 0;
+
+	switch (wParam) {
+		case 40048:	// next button pressed
+		case 40044:	// previous button pressed
+			// if not playing there is no IPC_PLAYING_FILE
+			if (winampstate.getIsPlaying() != 1)
+				work = DEFER_NEW_SONG | (wParam == 40048 ? DEFER_QUEUE_NEXT : 0);
+
+			work |= DEFER_STATE;
+			break;
+		case 40045:	// play button pressed
+			if (winampstate.getIsPlaying() == 3)
+				tasklist.push("new_song_");	// NEEDED FOR PAUSE -> PLAY
+
+			work = DEFER_STATE;
+			break;
+		case 40046:	// pause button pressed
+			tasklist.push("pause");
+
+			work = DEFER_STATE;
+			break;
+		case 40047:	// stop button pressed
+			tasklist.push("stop");
+
+			work = DEFER_STATE;
+			break;
+		case 40023: {	// shuffle button pressed
+			int shuffle = winampstate.getShuffle() == 1 ? 0 : 1;
+
+			winampstate.setShuffle(shuffle);
+
+			tasklist.push(shuffle == 1 ? "shuffle_1" : "shuffle_0", -1, ALL_SESSIONS, commandOrigin);
+
+			work = DEFER_STATE;
+			break;
+		}
+		case 40022: {	// repeat button pressed
+			int repeat = winampstate.getRepeat() == 1 ? 0 : 1;
 
-					LeaveCriticalSection(&cs_winamp);
-					// CRITICAL END
+			winampstate.setRepeat(repeat);
 
-					tasklist.push("shuffle_1");
-            }
-        } else if (wParam == 40022) {	// repeat button pressed
-            if (repeat_status == 1) {
-					// CRITICAL
-					EnterCriticalSection(&cs_winamp);
+			tasklist.push(repeat == 1 ? "repeat_1" : "repeat_0", -1, ALL_SESSIONS, commandOrigin);
 
-					repeat_status = 0;
+			work = DEFER_STATE;
+			break;
+		}
+		default:
+			return DefSubclassProc(hwnd, message, wParam, lParam);
+	}
 
-					LeaveCriticalSection(&cs_winamp);
-					// CRITICAL END
+	TraceSpan span("hook", (int)wParam);
 
-					tasklist.push("repeat_0");
-            } else if (repeat_status == 0) {
-                    // CRITICAL
-					EnterCriticalSection(&cs_winamp);
+	LRESULT result = DefSubclassProc(hwnd, message, wParam, lParam);
 
-					repeat_status = 1;
+	defer(work);
 
-					LeaveCriticalSection(&cs_winamp);
-					// CRITICAL END
+	return result;
+}
 
-					tasklist.push("repeat_1");
-            } 
-        }
-    } else if (message == WM_MOUSEWHEEL) {	// volume changed with mouse wheel
-        // CRITICAL
-		EnterCriticalSection(&cs_winamp);
+/**
+* \brief	MainWndProc
+*
+* subclass procedure of the winamp window, installed by init for the whole session and active while a client is
+* connected, see installHook. a switch on the message lets every other message pass with a few comparisons.
+* the hook itself only notes the parameters of the events and enqueues the commands in the tasklist, the player
+* state they change is read afterwards in one deferredFunction, see WinampState. with a server in RemoteControlHost
+* it only forwards the events, see ServerHost
+*/
+LRESULT CALLBACK MainWndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam, UINT_PTR id, DWORD_PTR data) {
+	if (serverhost.isActive())
+		serverhost.forward(message, wParam, lParam);
+
+	switch (message) {
+		case WM_WA_IPC:
+			if (winampstate.handle(wParam, lParam))	// function sent by WinampState::invoke
+				return WINAMP_INVOKED;
 
-		volume = SendMessageA(plugin.hwndParent, WM_WA_IPC, -666, IPC_SETVOLUME);
+			if (deferIpc != 0 && (UINT_PTR)lParam == deferIpc) {
+				deferredFunction();
 
-		LeaveCriticalSection(&cs_winamp);
-		// CRITICAL END
+				return 0;
+			}
 
-        tasklist.push("volume_");
-    }
+			if (hookInstalled != 0)
+				return ipcMessage(hwnd, wParam, lParam);
+			break;
+		case WM_COMMAND:
+		case WM_SYSCOMMAND:
+			if (hookInstalled != 0)
+				return commandMessage(hwnd, message, wParam, lParam);
+			break;
+		case WM_MOUSEWHEEL:	// volume changed with mouse wheel
+			if (hookInstalled != 0) {
+				LRESULT result = DefSubclassProc(hwnd, message, wParam, lParam);
+
+				defer(DEFER_VOLUME | DEFER_STATE);
+
+				return result;
+			}
+			break;
+	}
 
-    return CallWindowProc(lpWndProcOld,hwnd,message,wParam,lParam);
+	return DefSubclassProc(hwnd, message, wParam, lParam);
 }
@@ -1,7 +1,23 @@
 #pragma once
 
+// milliseconds quit waits for the background phase of init
+#define STARTUP_STOP_TIMEOUT 5000
+
+// id of the MainWndProc subclass of the winamp window
+#define HOOK_SUBCLASS_ID 0x5243
+
+// work the MainWndProc hook leaves to deferredFunction: read the player state, the volume after a mouse wheel,
+// queue new_song_ and check the queue for queue_next
+#define DEFER_STATE 1
+#define DEFER_VOLUME 2
+#define DEFER_NEW_SONG 4
+#define DEFER_QUEUE_NEXT 8
+
+// 1 while the background phase of init runs, see startupFunction
+extern volatile LONG startupRunning;
+
 extern int  init();
 extern void config();
 extern void quit();
 
-extern LRESULT CALLBACK MainWndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam);
\ No newline at end of file
+extern LRESULT CALLBACK MainWndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam, UINT_PTR id, DWORD_PTR data);
\ No newline at end of file
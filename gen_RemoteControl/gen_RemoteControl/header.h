@@ -19,39 +19,79 @@
 
 // needed for winsock
 #pragma comment(lib, "Ws2_32.lib")
+#pragma comment(lib, "Mswsock.lib")
+#pragma comment(lib, "qwave.lib")
+#pragma comment(lib, "Iphlpapi.lib")
+
+// TLS and WebSocket
+#pragma comment(lib, "Secur32.lib")
+#pragma comment(lib, "Crypt32.lib")
+#pragma comment(lib, "Advapi32.lib")
+
+// version check and cover scaling
+#pragma comment(lib, "Wininet.lib")
+#pragma comment(lib, "Gdiplus.lib")
+
+// subclass of the winamp window
+#pragma comment(lib, "Comctl32.lib")
+
+// memory of the process in the stats, the psapi.dll functions also exist on Windows XP
+#pragma comment(lib, "Psapi.lib")
 
 #include <winsock2.h>
 #include <Ws2tcpip.h>
+#include <mswsock.h>
+#include <mstcpip.h>
+#include <qos2.h>
+#include <iphlpapi.h>
 
 
 #include <windows.h>
+#include <commctrl.h>
+
+#define PSAPI_VERSION 1
+#include <psapi.h>
+
+#define SECURITY_WIN32
+#include <wincrypt.h>
+#include <security.h>
+#include <schannel.h>
+
+#include <wininet.h>
+#include <gdiplus.h>
+
 #include <iostream>
 #include <stdio.h>
 #include <string>
 #include <fstream>
 #include <time.h>
 #include <sstream>
-#include <vcclr.h>
 #include <queue>
+#include <deque>
 #include <tchar.h>
 #include <list>
+#include <map>
+#include <set>
+#include <vector>
+#include <algorithm>
+#include <emmintrin.h>
 #include <wchar.h>
 #include <wctype.h>
+#include <math.h>
+#include <zlib.h>
 
 // ATL INCLUDES
 #include <shlobj.h>
 #include <atlbase.h>
 #include <atlconv.h>
 
-// marshal_as library
-#include <msclr/marshal.h>
-#include <msclr\marshal_cppstd.h> 
-
 // WINAMP SDK INCLUDES
 #include "wa_ipc.h"
+#include "ipc_pe.h"
 #include "gen.h"
 #include "api.h"
 #include "Winamp SDK\Agave\Queue\wa_jtfe.h"
+#include "Winamp SDK\ReplayGainAnalysis\gain_analysis.h"
 
 // TAGLIB INCLUDES
 #include <config.h>
@@ -64,6 +104,7 @@
 #include <apefooter.h>
 #include <apeitem.h>
 #include <apetag.h>
+#include <apefile.h>
 #include <asfattribute.h>
 #include <asffile.h>
 #include <asfproperties.h>
@@ -119,8 +160,11 @@
 #include <taglib.h>
 #include <tbytevector.h>
 #include <tbytevectorlist.h>
+#include <tbytevectorstream.h>
 #include <tdebug.h>
 #include <tfile.h>
+#include <tfilestream.h>
+#include <tiostream.h>
 #include <tlist.h>
 #include <tmap.h>
 #include <tstring.h>
@@ -132,37 +176,86 @@
 #include <wavpackproperties.h>
 
 
-// server variables
+// server variables. connecting: server accepts clients, connected: at least one client is connected
 extern volatile bool connecting, connected;
 
-// winamp variables
-extern volatile int shuffle_status, repeat_status, volume, volume_last, isPlaying, progress, playlistlength;
+// session whose id_ command the network thread performs, 0 otherwise. the hook runs inside the SendMessage of the
+// command and marks the state events it causes with it, see Task::origin
+extern volatile LONG commandOrigin;
+
+// winamp variables. volume_last: volume before muting, the player state is kept by WinampState
+extern volatile int volume_last;
 
 // settings variables
 extern std::string settingsFileName;
 extern std::string settingsPath;
 
+extern std::string indexFileName;
+extern std::string indexPath;
+
+extern std::string traceFileName;
+extern std::string tracePath;
+
+extern std::string captureFileName;
+extern std::string capturePath;
+
+extern std::string logFileName;
+extern std::string logPath;
+
+extern std::string coverStoreName;
+extern std::string coverStorePath;
+
 extern volatile int port, autostart, showconfigonstartup, autorestart, keepalivemessages; 
 
-// sockets
-extern volatile int c, s;
+// seconds between two keep alive messages and number of not answered ones until a client is disconnected
+extern volatile int keepaliveinterval, keepalivemisses;
 
+// socket options of the clients, SOCKET_PROFILE_LATENCY or SOCKET_PROFILE_THROUGHPUT
+extern volatile int socketprofile;
 
+// files per second read by the playlist scanner, 0 to disable it
+extern volatile int scanbudget;
 
-// socket adress
-extern struct sockaddr_in addr;
+// 1 if clients may connect with TLS, needs the certificate TLS_CERTIFICATE_SUBJECT
+extern volatile int tlstransport;
 
-// critical winamp variables section
-extern CRITICAL_SECTION cs_winamp;
+// 1 if HTTP and WebSocket clients may connect, see WebChannel
+extern volatile int webtransport;
 
-// critical keep alive section
-extern CRITICAL_SECTION cs_alive;
+// scheduling of the plugin threads, THREAD_POLICY_DEFAULT, THREAD_POLICY_BACKGROUND or THREAD_POLICY_MMCSS
+extern volatile int threadpolicy;
 
-// keep alive message delay
-extern volatile int alive_delay;
+// 1 if the sessions use Registered I/O where the system has it (experimental), see RioChannel
+extern volatile int riotransport;
 
-// old callback hook
-extern WNDPROC lpWndProcOld;
+// milliseconds an operation may take before it is kept in the slow log, 0 to keep none. see SlowLog
+extern volatile int slowthreshold;
+
+// highest LOG_ level written to logPath, LOG_OFF to write nothing. see LogWriter
+extern volatile int loglevel;
+
+// 1 if the server runs in RemoteControlHost and winamp only keeps a shim, see ServerHost
+extern volatile int hostprocess;
+
+// kilobytes per second the clients share fairly, 0 to send without pacing. see SendScheduler
+extern volatile int uplink;
+
+// share of the uplink of a browser session, the native clients have SEND_WEIGHT_DEFAULT
+extern volatile int dashboardweight;
+
+// listening socket
+extern volatile int s;
+
+// completion port of the server
+extern HANDLE iocp;
+
+
+
+// socket adress
+extern struct sockaddr_in addr;
+
+// GDI+ of the cover scaling, started by init
+extern ULONG_PTR gdiplusToken;
 
 
 // plugin version (don't touch this)
@@ -177,6 +270,9 @@ extern const GUID GenQueueExampleLangGUID;
 // Wasabi based services for localisation support
 extern api_service *WASABI_API_SVC;
 extern api_language *WASABI_API_LNG;
+
+// memory manager, the album art providers allocate the pictures with it
+extern api_memmgr *WASABI_API_MEMMGR;
 // these two must be declared as they're used by the language api's
 // when the system is comparing/loading the different resources
 extern HINSTANCE WASABI_API_LNG_HINST,
@@ -186,6 +282,21 @@ extern api_queue *WASABI_API_QUEUEMGR;
 #define CHECK_QUEUEMGR() \
 		if(WASABI_API_QUEUEMGR == NULL){ServiceBuild(WASABI_API_QUEUEMGR,QueueManagerApiGUID);}
 
+// database of the media library, loaded after the general purpose plugins
+extern api_mldb *WASABI_API_MLDB;
+#define CHECK_MLDB() \
+		if(WASABI_API_MLDB == NULL){ServiceBuild(WASABI_API_MLDB,mldbApiGuid);}
+
+// decoders of winamp for files that aren't played, see AudioStreamer
+extern api_decodefile *AGAVE_API_DECODE;
+#define CHECK_DECODEFILE() \
+		if(AGAVE_API_DECODE == NULL){ServiceBuild(AGAVE_API_DECODE,decodeFileGUID);}
+
+// loaders of winamp for saved playlist files, see PlaylistBrowser
+extern api_playlistmanager *AGAVE_API_PLAYLISTMANAGER;
+#define CHECK_PLAYLISTMANAGER() \
+		if(AGAVE_API_PLAYLISTMANAGER == NULL){ServiceBuild(AGAVE_API_PLAYLISTMANAGER,api_playlistmanagerGUID);}
+
 
 extern UINT_PTR delay_load_ipc;
 
@@ -247,16 +358,8 @@ typedef struct {
 
 extern RemoteControlPlugin plugin;
 
-// definitions to identify UIAction: add log text or change status text in UI?
-#define LOG 1
-#define STATUS 2
-#define BUTTON 3
-#define IP 4
-#define VERSION 5
-
-// window visibility
-extern volatile bool windowVisible;
+// number of log entries kept in the log window, older ones are dropped
+#define LOG_LINES 200
 
 // namespaces
-using namespace System::Threading;
-using namespace gen_RemoteControl;
\ No newline at end of file
+using namespace std;
\ No newline at end of file
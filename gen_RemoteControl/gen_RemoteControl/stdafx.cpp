@@ -7,29 +7,59 @@
 
 // server variables
 volatile bool connecting = false, connected = false;
+volatile LONG commandOrigin = 0;
 
 // winamp variables
-volatile int shuffle_status, repeat_status, volume, volume_last, isPlaying, progress, playlistlength;
+volatile int volume_last;
 
 // settings variables
 std::string settingsFileName = "RemoteControl.dat";
 std::string settingsPath;
 
-volatile int port = 50000, autostart = 1, showconfigonstartup = 1, autorestart = 1, keepalivemessages = 1; 
+// metadata index, next to the settings file
+std::string indexFileName = "RemoteControl.idx";
+std::string indexPath;
 
-// sockets
-volatile int c, s;
+// trace of the server pipeline, next to the settings file
+std::string traceFileName = "RemoteControl_trace.json";
+std::string tracePath;
 
-// socket adress
-struct sockaddr_in addr;
+std::string captureFileName = "RemoteControl_capture.bin";
+std::string capturePath;
 
-// keep alive message delay
-volatile int alive_delay = 0;
+// log of the window on disk, next to the settings file
+std::string logFileName = "RemoteControl.log";
+std::string logPath;
 
+// extracted covers and their variants, see CoverStore
+std::string coverStoreName = "RemoteControl_covers\\";
+std::string coverStorePath;
 
-// critical sections
-CRITICAL_SECTION cs_alive;
-CRITICAL_SECTION cs_winamp;
+volatile int port = 50000, autostart = 1, showconfigonstartup = 1, autorestart = 1, keepalivemessages = 1; 
+volatile int keepaliveinterval = 5, keepalivemisses = 3;
+volatile int socketprofile = 1;
+volatile int scanbudget = 20;
+volatile int tlstransport = 1;
+volatile int webtransport = 1;
+volatile int threadpolicy = 2;
+volatile int riotransport = 0;
+volatile int slowthreshold = 250;
+volatile int loglevel = 2;
+volatile int hostprocess = 0;
+volatile int uplink = 0;
+volatile int dashboardweight = 1;
+
+// listening socket
+volatile int s;
+
+// completion port of the server
+HANDLE iocp = NULL;
+
+// socket adress
+struct sockaddr_in addr;
+
+// GDI+ of the cover scaling
+ULONG_PTR gdiplusToken = 0;
 
 
 volatile HANDLE refreshQueueListThread;
@@ -44,13 +74,15 @@ const GUID GenQueueExampleLangGUID =
 
 // Wasabi based services for localisation support
 api_queue *WASABI_API_QUEUEMGR = 0;
+api_mldb *WASABI_API_MLDB = 0;
+api_decodefile *AGAVE_API_DECODE = 0;
+api_playlistmanager *AGAVE_API_PLAYLISTMANAGER = 0;
 
 UINT_PTR delay_load_ipc = -1;
 
 api_service *WASABI_API_SVC = 0;
 api_language *WASABI_API_LNG = 0;
-
-WNDPROC lpWndProcOld = NULL;
+api_memmgr *WASABI_API_MEMMGR = 0;
 
 HINSTANCE WASABI_API_LNG_HINST = 0,
           WASABI_API_ORIG_HINST = 0;
@@ -72,5 +104,44 @@ RemoteControlPlugin plugin = {
 // Tasklist object
 TaskList tasklist;
 
-// window visibility
-bool volatile windowVisible;
\ No newline at end of file
+// connected sessions
+SessionList sessionlist;
+OutputBuffer outputBuffer;
+PlaylistSnapshot playlistsnapshot;
+PlaylistCache playlistcache;
+PlaylistIndex playlistindex;
+PlaylistGroups playlistgroups;
+QueueSnapshot queuesnapshot;
+WinampState winampstate;
+Metrics metrics;
+Trace tracer;
+SlowLog slowlog;
+LogWriter logwriter;
+Capture capture;
+ResourceGovernor governor;
+WorkPool workpool;
+MemoryBudget memorybudget;
+LatencyProbes latencyprobes;
+CoverCache coverCache;
+CoverStore coverstore;
+CoverResolver coverresolver;
+StringPool stringpool;
+PathTable pathtable;
+MetadataCache metadatacache;
+DirectoryWatcher directorywatcher;
+PlaylistScanner playlistscanner;
+TagWriter tagwriter;
+LibrarySnapshot librarysnapshot;
+LibrarySearch librarysearch;
+PlaylistBrowser playlistbrowser;
+PlaylistEditor playlisteditor;
+AudioStreamer audiostreamer;
+LevelMeter levelmeter;
+ReplayGainJob replaygainjob;
+Discovery discovery;
+DatagramChannel datagramchannel;
+TrackPrefetch trackprefetch;
+ProgressTicker progressticker;
+SendScheduler sendscheduler;
+Journal journal;
+ServerHost serverhost;
\ No newline at end of file
@@ -6,11 +6,60 @@
 // TODO: Hier auf zustzliche Header, die das Programm erfordert, verweisen.
 
 #include "version.h"
-#include "UI.h"
 #include "header.h"
+#include "LogWriter.h"
+#include "UIModule.h"
 #include "UIManager.h"
+#include "Metrics.h"
+#include "Trace.h"
+#include "SlowLog.h"
+#include "Capture.h"
+#include "ThreadPolicy.h"
+#include "MemoryTag.h"
+#include "MemoryBudget.h"
+#include "ResourceGovernor.h"
+#include "WorkPool.h"
+#include "OutputBuffer.h"
+#include "TlsChannel.h"
+#include "WebChannel.h"
+#include "Session.h"
+#include "RioChannel.h"
+#include "SessionList.h"
+#include "SendScheduler.h"
+#include "LatencyProbes.h"
+#include "PlaylistSnapshot.h"
+#include "PlaylistCache.h"
+#include "PlaylistIndex.h"
+#include "PlaylistGroups.h"
+#include "QueueSnapshot.h"
+#include "WinampState.h"
+#include "SharedRing.h"
+#include "ServerHost.h"
+#include "CoverCache.h"
+#include "CoverStore.h"
+#include "CoverResolver.h"
+#include "PictureLocator.h"
+#include "StringPool.h"
+#include "PathTable.h"
+#include "MetadataSource.h"
+#include "DirectoryWatcher.h"
+#include "DirectoryListings.h"
+#include "MetadataCache.h"
+#include "PlaylistScanner.h"
+#include "TagWriter.h"
+#include "LibrarySnapshot.h"
+#include "LibrarySearch.h"
+#include "PlaylistBrowser.h"
+#include "PlaylistEditor.h"
+#include "AudioStreamer.h"
+#include "LevelMeter.h"
+#include "ReplayGainJob.h"
+#include "Discovery.h"
+#include "DatagramChannel.h"
+#include "TrackPrefetch.h"
+#include "ProgressTicker.h"
+#include "Journal.h"
 #include "TaskList.h"
-#include "UIAction.h"
 #include "ThreadMethods.h"
 #include "Miscellaneous.h"
 #include "FileOperations.h"
@@ -20,4 +69,114 @@
 
 
 // Tasklist object
-extern TaskList tasklist;
\ No newline at end of file
+extern TaskList tasklist;
+
+// connected sessions
+extern SessionList sessionlist;
+
+// encoded output of sendCommandThread
+extern OutputBuffer outputBuffer;
+
+// playlist as the clients know it
+extern PlaylistSnapshot playlistsnapshot;
+extern PlaylistCache playlistcache;
+
+// trigram index of the playlist, see find_ command
+extern PlaylistIndex playlistindex;
+
+// the playlist grouped by album and artist, see groups_ command
+extern PlaylistGroups playlistgroups;
+
+// queue as the clients know it
+extern QueueSnapshot queuesnapshot;
+extern WinampState winampstate;
+extern CoverCache coverCache;
+extern CoverStore coverstore;
+
+// covers of the album art providers of winamp
+extern CoverResolver coverresolver;
+
+extern MetadataCache metadatacache;
+
+// change notifications of the directories of the cached files
+extern DirectoryWatcher directorywatcher;
+
+extern PlaylistScanner playlistscanner;
+
+// tag edits of the clients, written in the background
+extern TagWriter tagwriter;
+
+// columns of the media library for search_ and browse_
+extern LibrarySnapshot librarysnapshot;
+
+// search_ and browse_ queries of the clients
+extern LibrarySearch librarysearch;
+
+// browse_playlist_ and load_playlist_ requests of the clients
+extern PlaylistBrowser playlistbrowser;
+
+// playlist_insert_, playlist_delete_, playlist_move_ and playlist_sort_ commands of the clients
+extern PlaylistEditor playlisteditor;
+
+// audio streams to the clients
+extern AudioStreamer audiostreamer;
+
+// level meter feeds of the clients
+extern LevelMeter levelmeter;
+
+// album ReplayGain of the replayGain_ command
+extern ReplayGainJob replaygainjob;
+
+// answers the discovery probes of the clients
+extern Discovery discovery;
+
+// sends the fresh state to the clients that have bound a datagram route
+extern DatagramChannel datagramchannel;
+
+// reads the next track before the song change
+extern TrackPrefetch trackprefetch;
+
+// samples the playback position and sends the drift of the clients
+extern ProgressTicker progressticker;
+
+// fair share of the uplink between the sessions
+extern SendScheduler sendscheduler;
+
+// broadcasts replayed to resumed sessions
+extern Journal journal;
+
+// counters of the server, see stats command
+extern Metrics metrics;
+
+// artist, album and genre values of the metadata cache
+extern StringPool stringpool;
+
+// paths of the metadata cache and the playlist groups as directories and names
+extern PathTable pathtable;
+
+// timed events of the server pipeline, see trace_ command
+extern Trace tracer;
+
+// operations above slowthreshold with their file and stages, see slowlog command
+extern SlowLog slowlog;
+
+// log of the window on disk, written by a background thread
+extern LogWriter logwriter;
+
+// recorded protocol traffic, see capture_ command
+extern Capture capture;
+
+// cpu, i/o and memory budget of the background work
+extern ResourceGovernor governor;
+
+// thread pool of the metadata, cover, search and update tasks
+extern WorkPool workpool;
+
+// memory budget of the caches
+extern MemoryBudget memorybudget;
+
+// latency of the song changes until the clients show them
+extern LatencyProbes latencyprobes;
+
+// shim of the server in RemoteControlHost, see hostprocess
+extern ServerHost serverhost;
\ No newline at end of file
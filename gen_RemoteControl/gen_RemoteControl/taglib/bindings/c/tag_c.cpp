@@ -26,6 +26,17 @@
 #include "tag_c.h"
 
 #include <stdlib.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <pthread.h>
+# include <unistd.h>
+#endif
+
 #include <fileref.h>
 #include <tfile.h>
 #include <asffile.h>
@@ -269,6 +280,281 @@ int taglib_audioproperties_channels(const TagLib_AudioProperties *audioPropertie
   return p->channels();
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// Batch reads
+////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+  // The strings of a batch, copied into large blocks.  Every worker has its own
+  // arena, so equal strings are only stored once per worker and no lock is
+  // needed.
+
+  class StringArena
+  {
+  public:
+    StringArena() : current(0), used(BlockSize) {}
+
+    ~StringArena()
+    {
+      for(std::vector<char *>::iterator it = blocks.begin(); it != blocks.end(); ++it)
+        free(*it);
+    }
+
+    const char *intern(const String &s)
+    {
+      if(s.isEmpty())
+        return "";
+
+      const std::string value = s.to8Bit(unicodeStrings);
+
+      std::map<std::string, const char *>::const_iterator it = interned.find(value);
+      if(it != interned.end())
+        return it->second;
+
+      const char *copy = allocate(value.c_str(), value.size() + 1);
+      if(copy)
+        interned.insert(std::make_pair(value, copy));
+      return copy ? copy : "";
+    }
+
+    // The lookup table is only needed while the strings are added.
+
+    void seal()
+    {
+      interned.clear();
+    }
+
+  private:
+    enum { BlockSize = 65536 };
+
+    char *allocate(const char *data, size_t size)
+    {
+      char *block;
+
+      if(size > BlockSize / 4) {
+        // Long strings get a block of their own, the current one is kept.
+        block = static_cast<char *>(malloc(size));
+        if(!block)
+          return 0;
+        blocks.push_back(block);
+      }
+      else {
+        if(used + size > BlockSize) {
+          current = static_cast<char *>(malloc(BlockSize));
+          if(!current) {
+            used = BlockSize;
+            return 0;
+          }
+          blocks.push_back(current);
+          used = 0;
+        }
+        block = current + used;
+        used += size;
+      }
+
+      ::memcpy(block, data, size);
+      return block;
+    }
+
+    std::vector<char *> blocks;
+    char *current;
+    size_t used;
+    std::map<std::string, const char *> interned;
+  };
+
+  typedef std::vector<StringArena *> ArenaList;
+
+  enum {
+    TagFields = TagLib_Field_Title | TagLib_Field_Artist | TagLib_Field_Album |
+                TagLib_Field_Comment | TagLib_Field_Genre | TagLib_Field_Year |
+                TagLib_Field_Track,
+    PropertyFields = TagLib_Field_Length | TagLib_Field_Bitrate |
+                     TagLib_Field_SampleRate | TagLib_Field_Channels
+  };
+
+  struct BatchJob
+  {
+    const char *const *filenames;
+    unsigned int count;
+    unsigned int fields;
+    TagLib_Batch *batch;
+    volatile long next;
+    volatile long valid;
+  };
+
+  struct BatchWorker
+  {
+    BatchJob *job;
+    StringArena *arena;
+  };
+
+  long increment(volatile long *value)
+  {
+#ifdef _WIN32
+    return InterlockedIncrement(value);
+#else
+    return __sync_add_and_fetch(value, 1);
+#endif
+  }
+
+  unsigned int processorCount()
+  {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+#else
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? uint(count) : 1;
+#endif
+  }
+
+  void readBatchFile(BatchJob &job, unsigned int i, StringArena &arena)
+  {
+    const unsigned int fields = job.fields;
+    TagLib_Batch *b = job.batch;
+
+    int readMode = 0;
+    if(fields & TagFields)
+      readMode |= File::ReadBasicFields;
+    if(fields & PropertyFields)
+      readMode |= File::ReadAudioProperties;
+
+    FileRef f(job.filenames[i], readMode);
+
+    const bool valid = !f.isNull() && f.file()->isValid();
+    const Tag *t = valid ? f.tag() : 0;
+    const AudioProperties *p = valid ? f.audioProperties() : 0;
+
+    if(b->valid)
+      b->valid[i] = valid;
+
+    if(b->title && (fields & TagLib_Field_Title))
+      b->title[i] = t ? arena.intern(t->title()) : "";
+    if(b->artist && (fields & TagLib_Field_Artist))
+      b->artist[i] = t ? arena.intern(t->artist()) : "";
+    if(b->album && (fields & TagLib_Field_Album))
+      b->album[i] = t ? arena.intern(t->album()) : "";
+    if(b->comment && (fields & TagLib_Field_Comment))
+      b->comment[i] = t ? arena.intern(t->comment()) : "";
+    if(b->genre && (fields & TagLib_Field_Genre))
+      b->genre[i] = t ? arena.intern(t->genre()) : "";
+    if(b->year && (fields & TagLib_Field_Year))
+      b->year[i] = t ? t->year() : 0;
+    if(b->track && (fields & TagLib_Field_Track))
+      b->track[i] = t ? t->track() : 0;
+
+    if(b->length && (fields & TagLib_Field_Length))
+      b->length[i] = p ? p->length() : 0;
+    if(b->bitrate && (fields & TagLib_Field_Bitrate))
+      b->bitrate[i] = p ? p->bitrate() : 0;
+    if(b->samplerate && (fields & TagLib_Field_SampleRate))
+      b->samplerate[i] = p ? p->sampleRate() : 0;
+    if(b->channels && (fields & TagLib_Field_Channels))
+      b->channels[i] = p ? p->channels() : 0;
+
+    if(valid)
+      increment(&job.valid);
+  }
+
+  // Takes the next file until all are done.
+
+#ifdef _WIN32
+  DWORD WINAPI runBatchWorker(LPVOID parameter)
+#else
+  void *runBatchWorker(void *parameter)
+#endif
+  {
+    BatchWorker *worker = static_cast<BatchWorker *>(parameter);
+    BatchJob &job = *worker->job;
+
+    for(long i = increment(&job.next) - 1; i < long(job.count); i = increment(&job.next) - 1)
+      readBatchFile(job, uint(i), *worker->arena);
+
+    worker->arena->seal();
+    return 0;
+  }
+}
+
+unsigned int taglib_batch_read(const char *const *filenames, unsigned int count,
+                               unsigned int fields, unsigned int threads,
+                               TagLib_Batch *batch)
+{
+  if(!filenames || !batch || count == 0)
+    return 0;
+
+  if(threads == 0)
+    threads = processorCount();
+  if(threads > count)
+    threads = count;
+
+  BatchJob job;
+  job.filenames = filenames;
+  job.count = count;
+  job.fields = fields;
+  job.batch = batch;
+  job.next = 0;
+  job.valid = 0;
+
+  if(!batch->strings)
+    batch->strings = new ArenaList;
+  ArenaList *arenas = static_cast<ArenaList *>(batch->strings);
+
+  std::vector<BatchWorker> workers(threads);
+  for(unsigned int i = 0; i < threads; i++) {
+    workers[i].job = &job;
+    workers[i].arena = new StringArena;
+    arenas->push_back(workers[i].arena);
+  }
+
+  // The calling thread is the first worker.  If a thread can't be started the
+  // others take over its share.
+
+#ifdef _WIN32
+  std::vector<HANDLE> handles;
+  for(unsigned int i = 1; i < threads; i++) {
+    HANDLE handle = CreateThread(NULL, 0, runBatchWorker, &workers[i], 0, NULL);
+    if(handle)
+      handles.push_back(handle);
+  }
+
+  runBatchWorker(&workers[0]);
+
+  for(std::vector<HANDLE>::iterator it = handles.begin(); it != handles.end(); ++it) {
+    WaitForSingleObject(*it, INFINITE);
+    CloseHandle(*it);
+  }
+#else
+  std::vector<pthread_t> handles;
+  for(unsigned int i = 1; i < threads; i++) {
+    pthread_t handle;
+    if(pthread_create(&handle, NULL, runBatchWorker, &workers[i]) == 0)
+      handles.push_back(handle);
+  }
+
+  runBatchWorker(&workers[0]);
+
+  for(std::vector<pthread_t>::iterator it = handles.begin(); it != handles.end(); ++it)
+    pthread_join(*it, NULL);
+#endif
+
+  return uint(job.valid);
+}
+
+void taglib_batch_free_strings(TagLib_Batch *batch)
+{
+  if(!batch || !batch->strings)
+    return;
+
+  ArenaList *arenas = static_cast<ArenaList *>(batch->strings);
+  for(ArenaList::iterator it = arenas->begin(); it != arenas->end(); ++it)
+    delete *it;
+  delete arenas;
+
+  batch->strings = 0;
+}
+
 void taglib_id3v2_set_default_text_encoding(TagLib_ID3v2_Encoding encoding)
 {
   String::Type type = String::Latin1;
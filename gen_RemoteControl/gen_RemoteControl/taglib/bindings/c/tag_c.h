@@ -268,6 +268,67 @@ TAGLIB_C_EXPORT int taglib_audioproperties_samplerate(const TagLib_AudioProperti
  */
 TAGLIB_C_EXPORT int taglib_audioproperties_channels(const TagLib_AudioProperties *audioProperties);
 
+/******************************************************************************
+ * Batch API
+ ******************************************************************************/
+
+typedef enum {
+  TagLib_Field_Title      = 0x0001,
+  TagLib_Field_Artist     = 0x0002,
+  TagLib_Field_Album      = 0x0004,
+  TagLib_Field_Comment    = 0x0008,
+  TagLib_Field_Genre      = 0x0010,
+  TagLib_Field_Year       = 0x0020,
+  TagLib_Field_Track      = 0x0040,
+  TagLib_Field_Length     = 0x0100,
+  TagLib_Field_Bitrate    = 0x0200,
+  TagLib_Field_SampleRate = 0x0400,
+  TagLib_Field_Channels   = 0x0800
+} TagLib_Field;
+
+/*
+ * The results of taglib_batch_read(), one array per field with an entry per
+ * file.  The caller allocates the arrays of the requested fields, the others
+ * may be NULL.  The strings are owned by the batch and live until
+ * taglib_batch_free_strings() is called, equal strings are only stored once.
+ * Fields that a file doesn't have are "" or 0.
+ */
+
+typedef struct {
+  BOOL *valid;
+  const char **title;
+  const char **artist;
+  const char **album;
+  const char **comment;
+  const char **genre;
+  unsigned int *year;
+  unsigned int *track;
+  int *length;
+  int *bitrate;
+  int *samplerate;
+  int *channels;
+
+  /* Used internally, must be NULL before the first read. */
+  void *strings;
+} TagLib_Batch;
+
+/*!
+ * Reads the \a fields, a combination of TagLib_Field values, of \a count
+ * files in \a threads threads into \a batch.  0 threads use one per
+ * processor.  The files are only read as far as the fields need, the strings
+ * follow taglib_set_strings_unicode().
+ *
+ * \returns the number of valid files.
+ */
+TAGLIB_C_EXPORT unsigned int taglib_batch_read(const char *const *filenames, unsigned int count,
+                                               unsigned int fields, unsigned int threads,
+                                               TagLib_Batch *batch);
+
+/*!
+ * Frees all of the strings of the batch reads into \a batch.
+ */
+TAGLIB_C_EXPORT void taglib_batch_free_strings(TagLib_Batch *batch);
+
 /*******************************************************************************
  * Special convenience ID3v2 functions
  *******************************************************************************/
@@ -9,3 +9,6 @@
 #cmakedefine   NO_ITUNES_HACKS 1
 #cmakedefine   WITH_ASF 1
 #cmakedefine   WITH_MP4 1
+
+/* Allocate small private objects from free lists, see tallocator.h */
+#cmakedefine   WITH_POOLED_ALLOCATION 1
@@ -9,3 +9,6 @@
 /* #undef NO_ITUNES_HACKS */
 #define   WITH_ASF 1
 #define   WITH_MP4 1
+
+/* Allocate small private objects from free lists, see tallocator.h */
+#define   WITH_POOLED_ALLOCATION 1
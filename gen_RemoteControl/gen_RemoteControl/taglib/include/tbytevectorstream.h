@@ -0,0 +1 @@
+#include "../taglib/toolkit/tbytevectorstream.h"
@@ -0,0 +1 @@
+#include "../taglib/toolkit/tfilestream.h"
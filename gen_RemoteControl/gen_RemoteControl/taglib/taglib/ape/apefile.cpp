@@ -41,6 +41,7 @@
 
 #include "apetag.h"
 #include "apefooter.h"
+#include "apetrailer.h"
 
 using namespace TagLib;
 
@@ -92,6 +93,13 @@ APE::File::File(FileName file, bool readProperties,
   read(readProperties, propertiesStyle);
 }
 
+APE::File::File(IOStream *stream, bool readProperties,
+                Properties::ReadStyle propertiesStyle) : TagLib::File(stream)
+{
+  d = new FilePrivate;
+  read(readProperties, propertiesStyle);
+}
+
 APE::File::~File()
 {
   delete d;
@@ -207,23 +215,22 @@ void APE::File::strip(int tags)
 
 void APE::File::read(bool readProperties, Properties::ReadStyle /* propertiesStyle */)
 {
-  // Look for an ID3v1 tag
+  // Look for an ID3v1 and an APE tag, the end of the file is read once
 
-  d->ID3v1Location = findID3v1();
+  const APE::Trailer trailer(this);
+
+  d->ID3v1Location = trailer.ID3v1Location();
 
   if(d->ID3v1Location >= 0) {
-    d->tag.set(ID3v1Index, new ID3v1::Tag(this, d->ID3v1Location));
+    d->tag.set(ID3v1Index, new ID3v1::Tag(this, d->ID3v1Location, trailer.ID3v1Data()));
     d->hasID3v1 = true;
   }
 
-  // Look for an APE tag
-
-  d->APELocation = findAPE();
+  d->APELocation = trailer.APELocation();
 
   if(d->APELocation >= 0) {
-    d->tag.set(APEIndex, new APE::Tag(this, d->APELocation));
-    d->APESize = APETag()->footer()->completeTagSize();
-    d->APELocation = d->APELocation + APETag()->footer()->size() - d->APESize;
+    d->tag.set(APEIndex, new APE::Tag(this, trailer.APEFooterLocation(), trailer.APEFooterData()));
+    d->APESize = trailer.APESize();
     d->hasAPE = true;
   }
 
@@ -237,34 +244,3 @@ void APE::File::read(bool readProperties, Properties::ReadStyle /* propertiesSty
   }
 }
 
-long APE::File::findAPE()
-{
-  if(!isValid())
-    return -1;
-
-  if(d->hasID3v1)
-    seek(-160, End);
-  else
-    seek(-32, End);
-
-  long p = tell();
-
-  if(readBlock(8) == APE::Tag::fileIdentifier())
-    return p;
-
-  return -1;
-}
-
-long APE::File::findID3v1()
-{
-  if(!isValid())
-    return -1;
-
-  seek(-128, End);
-  long p = tell();
-
-  if(readBlock(3) == ID3v1::Tag::fileIdentifier())
-    return p;
-
-  return -1;
-}
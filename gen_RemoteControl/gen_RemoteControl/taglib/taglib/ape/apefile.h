@@ -91,6 +91,17 @@ namespace TagLib {
       File(FileName file, bool readProperties = true,
            Properties::ReadStyle propertiesStyle = Properties::Average);
 
+      /*!
+       * Contructs an WavPack file from \a stream.  If \a readProperties is true the
+       * file's audio properties will also be read using \a propertiesStyle.  If
+       * false, \a propertiesStyle is ignored.
+       *
+       * The stream is not owned by the file, it has to stay valid until the
+       * file is destroyed.
+       */
+      File(IOStream *stream, bool readProperties = true,
+           Properties::ReadStyle propertiesStyle = Properties::Average);
+
       /*!
        * Destroys this instance of the File.
        */
@@ -159,8 +170,6 @@ namespace TagLib {
 
       void read(bool readProperties, Properties::ReadStyle propertiesStyle);
       void scan();
-      long findID3v1();
-      long findAPE();
 
       class FilePrivate;
       FilePrivate *d;
@@ -42,11 +42,30 @@
 using namespace TagLib;
 using namespace APE;
 
+namespace
+{
+  // An item that hasn't been decoded yet, its place in the item data.
+
+  struct PendingItem
+  {
+    uint offset;
+    uint size;
+  };
+}
+
 class APE::Tag::TagPrivate
 {
 public:
   TagPrivate() : file(0), footerLocation(-1), tagLength(0) {}
 
+  // Decodes the pending item of the upper case key, if there is one.
+
+  void decode(const String &key);
+
+  // Decodes all pending items.
+
+  void decodeAll();
+
   File *file;
   long footerLocation;
   long tagLength;
@@ -54,8 +73,38 @@ public:
   Footer footer;
 
   ItemListMap itemListMap;
+
+  // The items are only decoded when they are asked for, binary items like
+  // cover art mostly never are.
+
+  ByteVector itemData;
+  Map<const String, PendingItem> pendingItems;
 };
 
+void APE::Tag::TagPrivate::decode(const String &key)
+{
+  if(pendingItems.isEmpty())
+    return;
+
+  Map<const String, PendingItem>::Iterator it = pendingItems.find(key);
+  if(it == pendingItems.end())
+    return;
+
+  Item item;
+  item.parse(itemData.mid(it->second.offset, it->second.size));
+  itemListMap.insert(key, item);
+
+  pendingItems.erase(it);
+  if(pendingItems.isEmpty())
+    itemData.clear();
+}
+
+void APE::Tag::TagPrivate::decodeAll()
+{
+  while(!pendingItems.isEmpty())
+    decode(pendingItems.begin()->first);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // public methods
 ////////////////////////////////////////////////////////////////////////////////
@@ -74,6 +123,16 @@ APE::Tag::Tag(File *file, long footerLocation) : TagLib::Tag()
   read();
 }
 
+APE::Tag::Tag(File *file, long footerLocation, const ByteVector &footerData) : TagLib::Tag()
+{
+  d = new TagPrivate;
+  d->file = file;
+  d->footerLocation = footerLocation;
+  d->footer.setData(footerData);
+
+  read();
+}
+
 APE::Tag::~Tag()
 {
   delete d;
@@ -86,6 +145,7 @@ ByteVector APE::Tag::fileIdentifier()
 
 String APE::Tag::title() const
 {
+  d->decode("TITLE");
   if(d->itemListMap["TITLE"].isEmpty())
     return String::null;
   return d->itemListMap["TITLE"].toString();
@@ -93,6 +153,7 @@ String APE::Tag::title() const
 
 String APE::Tag::artist() const
 {
+  d->decode("ARTIST");
   if(d->itemListMap["ARTIST"].isEmpty())
     return String::null;
   return d->itemListMap["ARTIST"].toString();
@@ -100,6 +161,7 @@ String APE::Tag::artist() const
 
 String APE::Tag::album() const
 {
+  d->decode("ALBUM");
   if(d->itemListMap["ALBUM"].isEmpty())
     return String::null;
   return d->itemListMap["ALBUM"].toString();
@@ -107,6 +169,7 @@ String APE::Tag::album() const
 
 String APE::Tag::comment() const
 {
+  d->decode("COMMENT");
   if(d->itemListMap["COMMENT"].isEmpty())
     return String::null;
   return d->itemListMap["COMMENT"].toString();
@@ -114,6 +177,7 @@ String APE::Tag::comment() const
 
 String APE::Tag::genre() const
 {
+  d->decode("GENRE");
   if(d->itemListMap["GENRE"].isEmpty())
     return String::null;
   return d->itemListMap["GENRE"].toString();
@@ -121,6 +185,7 @@ String APE::Tag::genre() const
 
 TagLib::uint APE::Tag::year() const
 {
+  d->decode("YEAR");
   if(d->itemListMap["YEAR"].isEmpty())
     return 0;
   return d->itemListMap["YEAR"].toString().toInt();
@@ -128,6 +193,7 @@ TagLib::uint APE::Tag::year() const
 
 TagLib::uint APE::Tag::track() const
 {
+  d->decode("TRACK");
   if(d->itemListMap["TRACK"].isEmpty())
     return 0;
   return d->itemListMap["TRACK"].toString().toInt();
@@ -181,11 +247,13 @@ APE::Footer *APE::Tag::footer() const
 
 const APE::ItemListMap& APE::Tag::itemListMap() const
 {
+  d->decodeAll();
   return d->itemListMap;
 }
 
 void APE::Tag::removeItem(const String &key)
 {
+  d->decode(key.upper());
   Map<const String, Item>::Iterator it = d->itemListMap.find(key.upper());
   if(it != d->itemListMap.end())
     d->itemListMap.erase(it);
@@ -193,6 +261,7 @@ void APE::Tag::removeItem(const String &key)
 
 void APE::Tag::addValue(const String &key, const String &value, bool replace)
 {
+  d->decode(key.upper());
   if(replace)
     removeItem(key);
   if(!value.isEmpty()) {
@@ -205,12 +274,13 @@ void APE::Tag::addValue(const String &key, const String &value, bool replace)
 
 void APE::Tag::setItem(const String &key, const Item &item)
 {
+  d->pendingItems.erase(key.upper());
   d->itemListMap.insert(key.upper(), item);
 }
 
 bool APE::Tag::isEmpty() const
 {
-  return d->itemListMap.isEmpty();
+  return d->itemListMap.isEmpty() && d->pendingItems.isEmpty();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -221,8 +291,12 @@ void APE::Tag::read()
 {
   if(d->file && d->file->isValid()) {
 
-    d->file->seek(d->footerLocation);
-    d->footer.setData(d->file->readBlock(Footer::size()));
+    // The footer has already been read if the tag was created with its data.
+
+    if(d->footer.tagSize() == 0) {
+      d->file->seek(d->footerLocation);
+      d->footer.setData(d->file->readBlock(Footer::size()));
+    }
 
     if(d->footer.tagSize() <= Footer::size() ||
        d->footer.tagSize() > uint(d->file->length()))
@@ -238,6 +312,8 @@ ByteVector APE::Tag::render() const
   ByteVector data;
   uint itemCount = 0;
 
+  d->decodeAll();
+
   {
     for(Map<const String, Item>::ConstIterator it = d->itemListMap.begin();
         it != d->itemListMap.end(); ++it)
@@ -258,14 +334,33 @@ void APE::Tag::parse(const ByteVector &data)
 {
   uint pos = 0;
 
+  // Only the keys and sizes are read here, see TagPrivate::decode().  The
+  // size is counted like APE::Item::size() does.
+
+  d->itemData = data;
+
   // 11 bytes is the minimum size for an APE item
 
-  for(uint i = 0; i < d->footer.itemCount() && pos <= data.size() - 11; i++) {
-    APE::Item item;
-    item.parse(data.mid(pos));
+  for(uint i = 0; i < d->footer.itemCount() && pos + 11 <= data.size(); i++) {
+    const uint valueLength = data.mid(pos, 4).toUInt(false);
 
-    d->itemListMap.insert(item.key().upper(), item);
+    int keyEnd = data.find('\0', pos + 8);
+    if(keyEnd < 0)
+      keyEnd = data.size();
 
-    pos += item.size();
+    const String key(data.mid(pos + 8, keyEnd - pos - 8), String::UTF8);
+    const uint valueOffset = pos + 8 + key.size() + 1;
+    const uint available = valueOffset < data.size() ? data.size() - valueOffset : 0;
+
+    PendingItem item;
+    item.offset = pos;
+    item.size = 8 + key.size() + 1 + (valueLength < available ? valueLength : available);
+
+    d->pendingItems.insert(key.upper(), item);
+
+    pos += item.size;
   }
+
+  if(d->pendingItems.isEmpty())
+    d->itemData.clear();
 }
@@ -68,6 +68,12 @@ namespace TagLib {
        */
       Tag(TagLib::File *file, long footerLocation);
 
+      /*!
+       * Create an APE tag from the data in \a file with the APE footer at
+       * \a footerLocation, which has already been read into \a footerData.
+       */
+      Tag(TagLib::File *file, long footerLocation, const ByteVector &footerData);
+
       /*!
        * Destroys this Tag instance.
        */
@@ -0,0 +1,157 @@
+/***************************************************************************
+ *   This library is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Lesser General Public License version   *
+ *   2.1 as published by the Free Software Foundation.                     *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful, but   *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU     *
+ *   Lesser General Public License for more details.                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU Lesser General Public      *
+ *   License along with this library; if not, write to the Free Software   *
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA         *
+ *   02110-1301  USA                                                       *
+ *                                                                         *
+ *   Alternatively, this file is available under the Mozilla Public        *
+ *   License Version 1.1.  You may obtain a copy of the License at         *
+ *   http://www.mozilla.org/MPL/                                           *
+ ***************************************************************************/
+
+#include <tfile.h>
+#include <id3v1tag.h>
+
+#include "apetrailer.h"
+#include "apetag.h"
+#include "apefooter.h"
+
+using namespace TagLib;
+
+namespace
+{
+  // The last bytes of a file hold an ID3v1 tag and an APE footer.
+
+  const long probeSize = 128 + 32;
+
+  // A Lyrics3 v2 block starts with "LYRICSBEGIN" and ends with its size in
+  // six digits and "LYRICS200", right in front of the ID3v1 tag.
+
+  const long lyrics3FooterSize = 6 + 9;
+
+  long lyrics3Size(const ByteVector &digits)
+  {
+    long size = 0;
+    for(ByteVector::ConstIterator it = digits.begin(); it != digits.end(); ++it) {
+      if(*it < '0' || *it > '9')
+        return -1;
+      size = size * 10 + (*it - '0');
+    }
+    return size;
+  }
+}
+
+APE::Trailer::Trailer(TagLib::File *file) :
+  id3v1Location(-1),
+  lyricsLocation(-1),
+  apeFooterLocation(-1),
+  apeSize(0)
+{
+  if(!file->isValid())
+    return;
+
+  const long fileLength = file->length();
+  const long blockSize = fileLength < probeSize ? fileLength : probeSize;
+  const long blockOffset = fileLength - blockSize;
+
+  file->seek(blockOffset);
+  const ByteVector block = file->readBlock(blockSize);
+
+  if(long(block.size()) != blockSize)
+    return;
+
+  // The end of the APE tag within the block.
+
+  long end = blockSize;
+
+  if(blockSize >= 128 && block.containsAt(ID3v1::Tag::fileIdentifier(), blockSize - 128)) {
+    id3v1Location = blockOffset + blockSize - 128;
+    id3v1Data = block.mid(blockSize - 128);
+    end = blockSize - 128;
+
+    if(end >= lyrics3FooterSize && block.containsAt("LYRICS200", end - 9)) {
+      const long size = lyrics3Size(block.mid(end - lyrics3FooterSize, 6));
+      const long location = id3v1Location - lyrics3FooterSize - size;
+
+      if(size >= 11 && location >= 0) {
+
+        // The start of the block and an APE footer in front of it are read
+        // together.
+
+        const long dataOffset = location >= 32 ? location - 32 : location;
+        file->seek(dataOffset);
+        const ByteVector data = file->readBlock(location - dataOffset + 11);
+
+        if(data.containsAt("LYRICSBEGIN", location - dataOffset)) {
+          lyricsLocation = location;
+          findAPE(data, dataOffset, location - dataOffset);
+          return;
+        }
+      }
+    }
+  }
+
+  findAPE(block, blockOffset, end);
+}
+
+long APE::Trailer::ID3v1Location() const
+{
+  return id3v1Location;
+}
+
+ByteVector APE::Trailer::ID3v1Data() const
+{
+  return id3v1Data;
+}
+
+long APE::Trailer::lyrics3Location() const
+{
+  return lyricsLocation;
+}
+
+long APE::Trailer::APELocation() const
+{
+  if(apeFooterLocation < 0)
+    return -1;
+  return apeFooterLocation + Footer::size() - apeSize;
+}
+
+long APE::Trailer::APEFooterLocation() const
+{
+  return apeFooterLocation;
+}
+
+TagLib::uint APE::Trailer::APESize() const
+{
+  return apeSize;
+}
+
+ByteVector APE::Trailer::APEFooterData() const
+{
+  return apeFooterData;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// private members
+////////////////////////////////////////////////////////////////////////////////
+
+void APE::Trailer::findAPE(const ByteVector &data, long dataOffset, long end)
+{
+  const long footerSize = Footer::size();
+
+  if(end < footerSize || !data.containsAt(APE::Tag::fileIdentifier(), end - footerSize))
+    return;
+
+  apeFooterData = data.mid(end - footerSize, footerSize);
+  apeFooterLocation = dataOffset + end - footerSize;
+  apeSize = Footer(apeFooterData).completeTagSize();
+}
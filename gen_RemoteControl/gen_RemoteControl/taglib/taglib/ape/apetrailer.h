@@ -0,0 +1,106 @@
+/***************************************************************************
+ *   This library is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Lesser General Public License version   *
+ *   2.1 as published by the Free Software Foundation.                     *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful, but   *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU     *
+ *   Lesser General Public License for more details.                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU Lesser General Public      *
+ *   License along with this library; if not, write to the Free Software   *
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA         *
+ *   02110-1301  USA                                                       *
+ *                                                                         *
+ *   Alternatively, this file is available under the Mozilla Public        *
+ *   License Version 1.1.  You may obtain a copy of the License at         *
+ *   http://www.mozilla.org/MPL/                                           *
+ ***************************************************************************/
+
+#ifndef TAGLIB_APETRAILER_H
+#define TAGLIB_APETRAILER_H
+
+#include "tbytevector.h"
+
+namespace TagLib {
+
+  class File;
+
+  namespace APE {
+
+#ifndef DO_NOT_DOCUMENT
+
+    /*!
+     * The tags at the end of an MPEG, MPC, WavPack or APE file: an optional
+     * APE tag, an optional Lyrics3 v2 block and an optional ID3v1 tag, in this
+     * order.  A single read of the last 160 bytes finds the ID3v1 tag, the
+     * Lyrics3 block and the APE footer behind either of them.  Only an APE tag
+     * in front of a Lyrics3 block costs a second read.
+     *
+     * The ID3v1 tag and the APE footer are kept, the tags are created from
+     * them without reading them again.
+     *
+     * \internal
+     */
+    class Trailer
+    {
+    public:
+      /*!
+       * Reads the end of \a file.  The read pointer is moved.
+       */
+      explicit Trailer(TagLib::File *file);
+
+      /*!
+       * \return The offset of the ID3v1 tag, -1 if there is none.
+       */
+      long ID3v1Location() const;
+
+      /*!
+       * \return The 128 bytes of the ID3v1 tag, empty if there is none.
+       */
+      ByteVector ID3v1Data() const;
+
+      /*!
+       * \return The offset of the Lyrics3 v2 block, -1 if there is none.
+       */
+      long lyrics3Location() const;
+
+      /*!
+       * \return The offset of the APE tag, its header if it has one, -1 if
+       * there is none.
+       */
+      long APELocation() const;
+
+      /*!
+       * \return The offset of the APE footer, -1 if there is no APE tag.
+       */
+      long APEFooterLocation() const;
+
+      /*!
+       * \return The size of the APE tag with header and footer.
+       */
+      uint APESize() const;
+
+      /*!
+       * \return The data of the APE footer, empty if there is no APE tag.
+       */
+      ByteVector APEFooterData() const;
+
+    private:
+      void findAPE(const ByteVector &data, long dataOffset, long end);
+
+      long id3v1Location;
+      ByteVector id3v1Data;
+      long lyricsLocation;
+      long apeFooterLocation;
+      uint apeSize;
+      ByteVector apeFooterData;
+    };
+
+#endif
+
+  }
+}
+
+#endif
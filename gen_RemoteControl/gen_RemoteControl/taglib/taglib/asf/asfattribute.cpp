@@ -42,7 +42,9 @@ public:
   AttributePrivate()
     : pictureValue(ASF::Picture::fromInvalid()),
       stream(0),
-      language(0) {}
+      language(0),
+      pending(false),
+      picture(false) {}
   AttributeTypes type;
   String stringValue;
   ByteVector byteVectorValue;
@@ -55,8 +57,39 @@ public:
   };
   int stream;
   int language;
+  // The string and byte values of parsed attributes are kept as a slice of
+  // the header until they are asked for, see decode().
+  ByteVector rawValue;
+  bool pending;
+  bool picture;
 };
 
+namespace
+{
+  // Take little endian values from the attribute data.  Truncated data moves
+  // the offset beyond the end.
+
+  ByteVector readBytes(const ByteVector &data, uint &offset, uint length)
+  {
+    if(offset > data.size() || length > data.size() - offset) {
+      offset = data.size() + 1;
+      return ByteVector::null;
+    }
+    offset += length;
+    return data.mid(offset - length, length);
+  }
+
+  uint readInt(const ByteVector &data, uint &offset, uint length)
+  {
+    if(offset > data.size() || length > data.size() - offset) {
+      offset = data.size() + 1;
+      return 0;
+    }
+    offset += length;
+    return data.toUInt(offset - length, length, false);
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // public members
 ////////////////////////////////////////////////////////////////////////////////
@@ -144,11 +177,13 @@ ASF::Attribute::AttributeTypes ASF::Attribute::type() const
 
 String ASF::Attribute::toString() const
 {
+  decode();
   return d->stringValue;
 }
 
 ByteVector ASF::Attribute::toByteVector() const
 {
+  decode();
   if(d->pictureValue.isValid())
     return d->pictureValue.render();
   return d->byteVectorValue;
@@ -176,83 +211,97 @@ unsigned long long ASF::Attribute::toULongLong() const
 
 ASF::Picture ASF::Attribute::toPicture() const
 {
+  decode();
   return d->pictureValue;
 }
 
-String ASF::Attribute::parse(ASF::File &f, int kind)
+String ASF::Attribute::parse(const ByteVector &data, uint &offset, int kind)
 {
   uint size, nameLength;
   String name;
   d->pictureValue = Picture::fromInvalid();
   // extended content descriptor
   if(kind == 0) {
-    nameLength = f.readWORD();
-    name = f.readString(nameLength);
-    d->type = ASF::Attribute::AttributeTypes(f.readWORD());
-    size = f.readWORD();
+    nameLength = readInt(data, offset, 2);
+    name = File::parseString(readBytes(data, offset, nameLength));
+    d->type = ASF::Attribute::AttributeTypes(readInt(data, offset, 2));
+    size = readInt(data, offset, 2);
   }
   // metadata & metadata library
   else {
-    int temp = f.readWORD();
+    int temp = readInt(data, offset, 2);
     // metadata library
     if(kind == 2) {
       d->language = temp;
     }
-    d->stream = f.readWORD();
-    nameLength = f.readWORD();
-    d->type = ASF::Attribute::AttributeTypes(f.readWORD());
-    size = f.readDWORD();
-    name = f.readString(nameLength);
+    d->stream = readInt(data, offset, 2);
+    nameLength = readInt(data, offset, 2);
+    d->type = ASF::Attribute::AttributeTypes(readInt(data, offset, 2));
+    size = readInt(data, offset, 4);
+    name = File::parseString(readBytes(data, offset, nameLength));
   }
 
   if(kind != 2 && size > 65535) {
     debug("ASF::Attribute::parse() -- Value larger than 64kB");
   }
 
+  const ByteVector value = readBytes(data, offset, size);
+
   switch(d->type) {
   case WordType:
-    d->shortValue = f.readWORD();
+    d->shortValue = value.toUShort(false);
     break;
 
   case BoolType:
-    if(kind == 0) {
-      d->boolValue = f.readDWORD() == 1;
-    }
-    else {
-      d->boolValue = f.readWORD() == 1;
-    }
+    d->boolValue = value.toUInt(false) == 1;
     break;
 
   case DWordType:
-    d->intValue = f.readDWORD();
+    d->intValue = value.toUInt(false);
     break;
 
   case QWordType:
-    d->longLongValue = f.readQWORD();
+    d->longLongValue = value.toLongLong(false);
     break;
 
   case UnicodeType:
-    d->stringValue = f.readString(size);
-    break;
-
   case BytesType:
   case GuidType:
-    d->byteVectorValue = f.readBlock(size);
+    d->rawValue = value;
+    d->pending = true;
+    d->picture = d->type == BytesType && name == "WM/Picture";
     break;
   }
 
-  if(d->type == BytesType && name == "WM/Picture") {
-    d->pictureValue.parse(d->byteVectorValue);
-    if(d->pictureValue.isValid()) {
-      d->byteVectorValue.clear();
+  return name;
+}
+
+void ASF::Attribute::decode() const
+{
+  if(!d->pending)
+    return;
+
+  d->pending = false;
+
+  if(d->type == UnicodeType) {
+    d->stringValue = File::parseString(d->rawValue);
+  }
+  else {
+    d->byteVectorValue = d->rawValue;
+    if(d->picture) {
+      d->pictureValue.parse(d->byteVectorValue);
+      if(d->pictureValue.isValid()) {
+        d->byteVectorValue.clear();
+      }
     }
   }
 
-  return name;
+  d->rawValue.clear();
 }
 
 int ASF::Attribute::dataSize() const
 {
+  decode();
   switch (d->type) {
   case WordType:
     return 2;
@@ -275,6 +324,8 @@ int ASF::Attribute::dataSize() const
 
 ByteVector ASF::Attribute::render(const String &name, int kind) const
 {
+  decode();
+
   ByteVector data;
 
   switch (d->type) {
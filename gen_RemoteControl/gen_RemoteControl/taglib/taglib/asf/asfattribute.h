@@ -182,7 +182,7 @@ namespace TagLib
 
 #ifndef DO_NOT_DOCUMENT
       /* THIS IS PRIVATE, DON'T TOUCH IT! */
-      String parse(ASF::File &file, int kind = 0);
+      String parse(const ByteVector &data, uint &offset, int kind = 0);
 #endif
 
       //! Returns the size of the stored data
@@ -192,6 +192,7 @@ namespace TagLib
       friend class File;
 
       ByteVector render(const String &name, int kind = 0) const;
+      void decode() const;
 
       class AttributePrivate;
       AttributePrivate *d;
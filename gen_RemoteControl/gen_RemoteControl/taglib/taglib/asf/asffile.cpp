@@ -70,13 +70,56 @@ static ByteVector headerExtensionGuid("\xb5\x03\xbf_.\xa9\xcf\x11\x8e\xe3\x00\xc
 static ByteVector metadataGuid("\xEA\xCB\xF8\xC5\xAF[wH\204g\xAA\214D\xFAL\xCA", 16);
 static ByteVector metadataLibraryGuid("\224\034#D\230\224\321I\241A\x1d\x13NEpT", 16);
 
+namespace
+{
+  // Takes the next object, its GUID and its data without the 24 bytes of the
+  // GUID and the size, from the objects in data.  The data is a slice of the
+  // header that has been read in one block.
+
+  bool nextObject(const ByteVector &data, uint &pos, ByteVector &guid, ByteVector &objectData)
+  {
+    if(pos > data.size() || data.size() - pos < 24)
+      return false;
+    const unsigned long long size = data.mid(pos + 16, 8).toLongLong(false);
+    if(size < 24 || size > data.size() - pos) {
+      debug("ASF: Invalid object size.");
+      return false;
+    }
+    guid = data.mid(pos, 16);
+    objectData = data.mid(pos + 24, uint(size) - 24);
+    pos += uint(size);
+    return true;
+  }
+
+  // The attributes of the extended content description (kind 0), the metadata
+  // (1) and the metadata library (2) objects.  Only the names are decoded here,
+  // the values are slices that are decoded when a tag field asks for them.
+
+  void parseAttributes(ASF::Tag *tag, const ByteVector &data, int kind)
+  {
+    if(data.size() < 2)
+      return;
+    uint count = data.toUInt(0u, 2u, false);
+    uint pos = 2;
+    while(count--) {
+      ASF::Attribute attribute;
+      String name = attribute.parse(data, pos, kind);
+      if(pos > data.size()) {
+        debug("ASF: Truncated attribute.");
+        break;
+      }
+      tag->addAttribute(name, attribute);
+    }
+  }
+}
+
 class ASF::File::BaseObject
 {
 public:
   ByteVector data;
   virtual ~BaseObject() {}
   virtual ByteVector guid() = 0;
-  virtual void parse(ASF::File *file, unsigned int size);
+  virtual void parse(ASF::File *file, const ByteVector &bytes);
   virtual ByteVector render(ASF::File *file);
 };
 
@@ -92,21 +135,21 @@ class ASF::File::FilePropertiesObject : public ASF::File::BaseObject
 {
 public:
   ByteVector guid();
-  void parse(ASF::File *file, uint size);
+  void parse(ASF::File *file, const ByteVector &bytes);
 };
 
 class ASF::File::StreamPropertiesObject : public ASF::File::BaseObject
 {
 public:
   ByteVector guid();
-  void parse(ASF::File *file, uint size);
+  void parse(ASF::File *file, const ByteVector &bytes);
 };
 
 class ASF::File::ContentDescriptionObject : public ASF::File::BaseObject
 {
 public:
   ByteVector guid();
-  void parse(ASF::File *file, uint size);
+  void parse(ASF::File *file, const ByteVector &bytes);
   ByteVector render(ASF::File *file);
 };
 
@@ -115,7 +158,7 @@ class ASF::File::ExtendedContentDescriptionObject : public ASF::File::BaseObject
 public:
   ByteVectorList attributeData;
   ByteVector guid();
-  void parse(ASF::File *file, uint size);
+  void parse(ASF::File *file, const ByteVector &bytes);
   ByteVector render(ASF::File *file);
 };
 
@@ -124,7 +167,7 @@ class ASF::File::MetadataObject : public ASF::File::BaseObject
 public:
   ByteVectorList attributeData;
   ByteVector guid();
-  void parse(ASF::File *file, uint size);
+  void parse(ASF::File *file, const ByteVector &bytes);
   ByteVector render(ASF::File *file);
 };
 
@@ -133,7 +176,7 @@ class ASF::File::MetadataLibraryObject : public ASF::File::BaseObject
 public:
   ByteVectorList attributeData;
   ByteVector guid();
-  void parse(ASF::File *file, uint size);
+  void parse(ASF::File *file, const ByteVector &bytes);
   ByteVector render(ASF::File *file);
 };
 
@@ -141,18 +184,15 @@ class ASF::File::HeaderExtensionObject : public ASF::File::BaseObject
 {
 public:
   List<ASF::File::BaseObject *> objects;
+  ~HeaderExtensionObject();
   ByteVector guid();
-  void parse(ASF::File *file, uint size);
+  void parse(ASF::File *file, const ByteVector &bytes);
   ByteVector render(ASF::File *file);
 };
 
-void ASF::File::BaseObject::parse(ASF::File *file, unsigned int size)
+void ASF::File::BaseObject::parse(ASF::File * /*file*/, const ByteVector &bytes)
 {
-  data.clear();
-  if (size > 24 && size <= (unsigned int)(file->length()))
-    data = file->readBlock(size - 24);
-  else
-    data = ByteVector::null;
+  data = bytes;
 }
 
 ByteVector ASF::File::BaseObject::render(ASF::File * /*file*/)
@@ -174,9 +214,9 @@ ByteVector ASF::File::FilePropertiesObject::guid()
   return filePropertiesGuid;
 }
 
-void ASF::File::FilePropertiesObject::parse(ASF::File *file, uint size)
+void ASF::File::FilePropertiesObject::parse(ASF::File *file, const ByteVector &bytes)
 {
-  BaseObject::parse(file, size);
+  BaseObject::parse(file, bytes);
   file->d->properties->setLength((int)(data.mid(40, 8).toLongLong(false) / 10000000L - data.mid(56, 8).toLongLong(false) / 1000L));
 }
 
@@ -185,9 +225,9 @@ ByteVector ASF::File::StreamPropertiesObject::guid()
   return streamPropertiesGuid;
 }
 
-void ASF::File::StreamPropertiesObject::parse(ASF::File *file, uint size)
+void ASF::File::StreamPropertiesObject::parse(ASF::File *file, const ByteVector &bytes)
 {
-  BaseObject::parse(file, size);
+  BaseObject::parse(file, bytes);
   file->d->properties->setChannels(data.mid(56, 2).toShort(false));
   file->d->properties->setSampleRate(data.mid(58, 4).toUInt(false));
   file->d->properties->setBitrate(data.mid(62, 4).toUInt(false) * 8 / 1000);
@@ -198,19 +238,26 @@ ByteVector ASF::File::ContentDescriptionObject::guid()
   return contentDescriptionGuid;
 }
 
-void ASF::File::ContentDescriptionObject::parse(ASF::File *file, uint /*size*/)
+void ASF::File::ContentDescriptionObject::parse(ASF::File *file, const ByteVector &bytes)
 {
   file->d->contentDescriptionObject = this;
-  int titleLength = file->readWORD();
-  int artistLength = file->readWORD();
-  int copyrightLength = file->readWORD();
-  int commentLength = file->readWORD();
-  int ratingLength = file->readWORD();
-  file->d->tag->setTitle(file->readString(titleLength));
-  file->d->tag->setArtist(file->readString(artistLength));
-  file->d->tag->setCopyright(file->readString(copyrightLength));
-  file->d->tag->setComment(file->readString(commentLength));
-  file->d->tag->setRating(file->readString(ratingLength));
+  if(bytes.size() < 10)
+    return;
+  uint titleLength = bytes.toUInt(0u, 2u, false);
+  uint artistLength = bytes.toUInt(2u, 2u, false);
+  uint copyrightLength = bytes.toUInt(4u, 2u, false);
+  uint commentLength = bytes.toUInt(6u, 2u, false);
+  uint ratingLength = bytes.toUInt(8u, 2u, false);
+  uint pos = 10;
+  file->d->tag->setTitle(parseString(bytes.mid(pos, titleLength)));
+  pos += titleLength;
+  file->d->tag->setArtist(parseString(bytes.mid(pos, artistLength)));
+  pos += artistLength;
+  file->d->tag->setCopyright(parseString(bytes.mid(pos, copyrightLength)));
+  pos += copyrightLength;
+  file->d->tag->setComment(parseString(bytes.mid(pos, commentLength)));
+  pos += commentLength;
+  file->d->tag->setRating(parseString(bytes.mid(pos, ratingLength)));
 }
 
 ByteVector ASF::File::ContentDescriptionObject::render(ASF::File *file)
@@ -239,15 +286,10 @@ ByteVector ASF::File::ExtendedContentDescriptionObject::guid()
   return extendedContentDescriptionGuid;
 }
 
-void ASF::File::ExtendedContentDescriptionObject::parse(ASF::File *file, uint /*size*/)
+void ASF::File::ExtendedContentDescriptionObject::parse(ASF::File *file, const ByteVector &bytes)
 {
   file->d->extendedContentDescriptionObject = this;
-  int count = file->readWORD();
-  while(count--) {
-    ASF::Attribute attribute;
-    String name = attribute.parse(*file);
-    file->d->tag->addAttribute(name, attribute);
-  }
+  parseAttributes(file->d->tag, bytes, 0);
 }
 
 ByteVector ASF::File::ExtendedContentDescriptionObject::render(ASF::File *file)
@@ -263,15 +305,10 @@ ByteVector ASF::File::MetadataObject::guid()
   return metadataGuid;
 }
 
-void ASF::File::MetadataObject::parse(ASF::File *file, uint /*size*/)
+void ASF::File::MetadataObject::parse(ASF::File *file, const ByteVector &bytes)
 {
   file->d->metadataObject = this;
-  int count = file->readWORD();
-  while(count--) {
-    ASF::Attribute attribute;
-    String name = attribute.parse(*file, 1);
-    file->d->tag->addAttribute(name, attribute);
-  }
+  parseAttributes(file->d->tag, bytes, 1);
 }
 
 ByteVector ASF::File::MetadataObject::render(ASF::File *file)
@@ -287,15 +324,10 @@ ByteVector ASF::File::MetadataLibraryObject::guid()
   return metadataLibraryGuid;
 }
 
-void ASF::File::MetadataLibraryObject::parse(ASF::File *file, uint /*size*/)
+void ASF::File::MetadataLibraryObject::parse(ASF::File *file, const ByteVector &bytes)
 {
   file->d->metadataLibraryObject = this;
-  int count = file->readWORD();
-  while(count--) {
-    ASF::Attribute attribute;
-    String name = attribute.parse(*file, 2);
-    file->d->tag->addAttribute(name, attribute);
-  }
+  parseAttributes(file->d->tag, bytes, 2);
 }
 
 ByteVector ASF::File::MetadataLibraryObject::render(ASF::File *file)
@@ -306,20 +338,29 @@ ByteVector ASF::File::MetadataLibraryObject::render(ASF::File *file)
   return BaseObject::render(file);
 }
 
+ASF::File::HeaderExtensionObject::~HeaderExtensionObject()
+{
+  // The objects keep slices of the header, it would never be freed.
+  for(unsigned int i = 0; i < objects.size(); i++) {
+    delete objects[i];
+  }
+}
+
 ByteVector ASF::File::HeaderExtensionObject::guid()
 {
   return headerExtensionGuid;
 }
 
-void ASF::File::HeaderExtensionObject::parse(ASF::File *file, uint /*size*/)
+void ASF::File::HeaderExtensionObject::parse(ASF::File *file, const ByteVector &bytes)
 {
   file->d->headerExtensionObject = this;
-  file->seek(18, File::Current);
-  long long dataSize = file->readDWORD();
-  long long dataPos = 0;
-  while(dataPos < dataSize) {
-    ByteVector guid = file->readBlock(16);
-    long long size = file->readQWORD();
+  if(bytes.size() < 22)
+    return;
+  const ByteVector extensionData = bytes.mid(22, bytes.toUInt(18u, false));
+  uint pos = 0;
+  ByteVector guid;
+  ByteVector objectData;
+  while(nextObject(extensionData, pos, guid, objectData)) {
     BaseObject *obj;
     if(guid == metadataGuid) {
       obj = new MetadataObject();
@@ -330,9 +371,8 @@ void ASF::File::HeaderExtensionObject::parse(ASF::File *file, uint /*size*/)
     else {
       obj = new UnknownObject(guid);
     }
-    obj->parse(file, size);
+    obj->parse(file, objectData);
     objects.append(obj);
-    dataPos += size;
   }
 }
 
@@ -357,6 +397,13 @@ ASF::File::File(FileName file, bool readProperties, Properties::ReadStyle proper
   read(readProperties, propertiesStyle);
 }
 
+ASF::File::File(IOStream *stream, bool readProperties, Properties::ReadStyle propertiesStyle) 
+  : TagLib::File(stream)
+{
+  d = new FilePrivate;
+  read(readProperties, propertiesStyle);
+}
+
 ASF::File::~File()
 {
   for(unsigned int i = 0; i < d->objects.size(); i++) {
@@ -386,8 +433,8 @@ void ASF::File::read(bool /*readProperties*/, Properties::ReadStyle /*properties
   if(!isValid())
     return;
 
-  ByteVector guid = readBlock(16);
-  if(guid != headerGuid) {
+  ByteVector header = readBlock(30);
+  if(header.size() < 30 || !header.startsWith(headerGuid)) {
     debug("ASF: Not an ASF file.");
     return;
   }
@@ -395,13 +442,29 @@ void ASF::File::read(bool /*readProperties*/, Properties::ReadStyle /*properties
   d->tag = new ASF::Tag();
   d->properties = new ASF::Properties();
 
-  d->size = readQWORD();
-  int numObjects = readDWORD();
-  seek(2, Current);
+  d->size = header.mid(16, 8).toLongLong(false);
+  uint numObjects = header.toUInt(24u, false);
+
+  if(d->size < 30 || d->size > (unsigned long long)length()) {
+    debug("ASF: Invalid header size.");
+    setValid(false);
+    return;
+  }
 
-  for(int i = 0; i < numObjects; i++) {
-    ByteVector guid = readBlock(16);
-    long size = (long)readQWORD();
+  // The header object holds all of the metadata, so it is read with one block
+  // and the objects take slices of it.  The data object and the indexes behind
+  // it are never touched.
+
+  const ByteVector data = readBlock(uint(d->size - 30));
+  uint pos = 0;
+  ByteVector guid;
+  ByteVector objectData;
+
+  for(uint i = 0; i < numObjects; i++) {
+    if(!nextObject(data, pos, guid, objectData)) {
+      setValid(false);
+      return;
+    }
     BaseObject *obj;
     if(guid == filePropertiesGuid) {
       obj = new FilePropertiesObject();
@@ -421,7 +484,7 @@ void ASF::File::read(bool /*readProperties*/, Properties::ReadStyle /*properties
     else {
       obj = new UnknownObject(guid);
     }
-    obj->parse(this, size);
+    obj->parse(this, objectData);
     d->objects.append(obj);
   }
 }
@@ -491,33 +554,9 @@ bool ASF::File::save()
 // protected members
 ////////////////////////////////////////////////////////////////////////////////
 
-int ASF::File::readBYTE()
-{
-  ByteVector v = readBlock(1);
-  return v[0];
-}
-
-int ASF::File::readWORD()
-{
-  ByteVector v = readBlock(2);
-  return v.toUShort(false);
-}
-
-unsigned int ASF::File::readDWORD()
-{
-  ByteVector v = readBlock(4);
-  return v.toUInt(false);
-}
-
-long long ASF::File::readQWORD()
-{
-  ByteVector v = readBlock(8);
-  return v.toLongLong(false);
-}
-
-String ASF::File::readString(int length)
+String ASF::File::parseString(const ByteVector &bytes)
 {
-  ByteVector data = readBlock(length);
+  ByteVector data = bytes;
   unsigned int size = data.size();
   while (size >= 2) {
     if(data[size - 1] != '\0' || data[size - 2] != '\0') {
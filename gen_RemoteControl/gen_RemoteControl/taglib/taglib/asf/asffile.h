@@ -57,6 +57,19 @@ namespace TagLib {
        */
       File(FileName file, bool readProperties = true, Properties::ReadStyle propertiesStyle = Properties::Average);
 
+      /*!
+       * Contructs an ASF file from \a stream.  If \a readProperties is true the
+       * file's audio properties will also be read using \a propertiesStyle.  If
+       * false, \a propertiesStyle is ignored.
+       *
+       * The stream is not owned by the file, it has to stay valid until the
+       * file is destroyed.
+       *
+       * \note In the current implementation, both \a readProperties and
+       * \a propertiesStyle are ignored.
+       */
+      File(IOStream *stream, bool readProperties = true, Properties::ReadStyle propertiesStyle = Properties::Average);
+
       /*!
        * Destroys this instance of the File.
        */
@@ -88,12 +101,8 @@ namespace TagLib {
 
     private:
 
-      int readBYTE();
-      int readWORD();
-      unsigned int readDWORD();
-      long long readQWORD();
       static ByteVector renderString(const String &str, bool includeLength = false);
-      String readString(int len);
+      static String parseString(const ByteVector &data);
       void read(bool readProperties, Properties::ReadStyle propertiesStyle);
 
       friend class Attribute;
@@ -32,6 +32,7 @@
 #endif
 
 #include <tfile.h>
+#include <tfilestream.h>
 #include <tstring.h>
 #include <tdebug.h>
 
@@ -52,6 +53,156 @@
 
 using namespace TagLib;
 
+namespace
+{
+  // The end of a file that is fetched along with its start: the ID3v1 and APE
+  // tags and a Lyrics3 block in front of them.
+
+  const TagLib::ulong prefetchTailSize = 16 * 1024;
+
+  // Creates the file the magic number at the start of the stream stands for,
+  // 0 if it is unknown.  head holds the first bytes of the stream.
+
+  File *createFromContent(IOStream *stream, const ByteVector &head, int readMode,
+                          AudioProperties::ReadStyle audioPropertiesStyle)
+  {
+    const bool readAudioProperties = (readMode & File::ReadAudioProperties) != 0;
+
+    if(head.startsWith("ID3") && head.size() >= 10) {
+
+      // FLAC, TrueAudio, APE and Musepack files may start with an ID3v2 tag as well, look
+      // behind it.
+
+      const uint tagSize = ((uchar(head[6]) & 0x7f) << 21) | ((uchar(head[7]) & 0x7f) << 14) |
+        ((uchar(head[8]) & 0x7f) << 7) | (uchar(head[9]) & 0x7f);
+      const uint afterTag = 10 + tagSize + ((head[5] & 0x10) ? 10 : 0);
+
+      ByteVector magic;
+
+      if(afterTag + 4 <= head.size())
+        magic = head.mid(afterTag, 4);
+      else {
+        stream->seek(afterTag);
+        magic = stream->readBlock(4);
+      }
+
+      if(magic == "fLaC")
+        return new FLAC::File(stream, readMode, audioPropertiesStyle);
+      if(magic == "TTA1")
+        return new TrueAudio::File(stream, readMode, audioPropertiesStyle);
+      if(magic == "MAC ")
+        return new APE::File(stream, readAudioProperties, audioPropertiesStyle);
+      if(magic == "MPCK" || magic.startsWith("MP+"))
+        return new MPC::File(stream, readMode, audioPropertiesStyle);
+      return new MPEG::File(stream, readMode, audioPropertiesStyle);
+    }
+
+    if(head.startsWith("fLaC"))
+      return new FLAC::File(stream, readMode, audioPropertiesStyle);
+
+    if(head.startsWith("OggS") && head.size() > 27) {
+
+      // The first packet of the stream names the codec, it starts behind the
+      // segment table of the first page.
+
+      const uint packet = 27 + uchar(head[26]);
+
+      if(head.containsAt("\x01vorbis", packet))
+        return new Ogg::Vorbis::File(stream, readAudioProperties, audioPropertiesStyle);
+      if(head.containsAt("\x7f" "FLAC", packet) || head.containsAt("fLaC", packet))
+        return new Ogg::FLAC::File(stream, readAudioProperties, audioPropertiesStyle);
+      if(head.containsAt("Speex   ", packet))
+        return new Ogg::Speex::File(stream, readAudioProperties, audioPropertiesStyle);
+      return 0;
+    }
+
+#ifdef TAGLIB_WITH_MP4
+    // Some older files start with the movie atom instead of the file type atom.
+
+    if(head.containsAt("ftyp", 4) || head.containsAt("moov", 4))
+      return new MP4::File(stream, readAudioProperties, audioPropertiesStyle);
+#endif
+
+#ifdef TAGLIB_WITH_ASF
+    static const char asfHeaderGuid[] = "\x30\x26\xb2\x75\x8e\x66\xcf\x11\xa6\xd9\x00\xaa\x00\x62\xce\x6c";
+
+    if(head.startsWith(ByteVector(asfHeaderGuid, 16)))
+      return new ASF::File(stream, readAudioProperties, audioPropertiesStyle);
+#endif
+
+    if(head.startsWith("RIFF") && head.containsAt("WAVE", 8))
+      return new RIFF::WAV::File(stream, readAudioProperties, audioPropertiesStyle);
+    if(head.startsWith("FORM") && (head.containsAt("AIFF", 8) || head.containsAt("AIFC", 8)))
+      return new RIFF::AIFF::File(stream, readAudioProperties, audioPropertiesStyle);
+    if(head.startsWith("MAC "))
+      return new APE::File(stream, readAudioProperties, audioPropertiesStyle);
+    if(head.startsWith("wvpk"))
+      return new WavPack::File(stream, readMode, audioPropertiesStyle);
+    if(head.startsWith("TTA1"))
+      return new TrueAudio::File(stream, readMode, audioPropertiesStyle);
+    if(head.startsWith("MP+") || head.startsWith("MPCK"))
+      return new MPC::File(stream, readMode, audioPropertiesStyle);
+
+    // An MPEG frame without tags in front of it.
+
+    if(head.size() >= 2 && uchar(head[0]) == 0xff && (uchar(head[1]) & 0xe0) == 0xe0)
+      return new MPEG::File(stream, readMode, audioPropertiesStyle);
+
+    return 0;
+  }
+
+  // Creates the file the extension stands for, 0 if it is unknown.
+
+  File *createFromExtension(IOStream *stream, const String &ext, int readMode,
+                            AudioProperties::ReadStyle audioPropertiesStyle)
+  {
+    const bool readAudioProperties = (readMode & File::ReadAudioProperties) != 0;
+
+    // If this list is updated, the method defaultFileExtensions() should also be
+    // updated.  However at some point that list should be created at the same time
+    // that a default file type resolver is created.
+
+    if(ext == "MP3")
+      return new MPEG::File(stream, readMode, audioPropertiesStyle);
+    if(ext == "OGG")
+      return new Ogg::Vorbis::File(stream, readAudioProperties, audioPropertiesStyle);
+    if(ext == "OGA") {
+      /* .oga can be any audio in the Ogg container. First try FLAC, then Vorbis. */
+      File *file = new Ogg::FLAC::File(stream, readAudioProperties, audioPropertiesStyle);
+      if (file->isValid())
+        return file;
+      delete file;
+      return new Ogg::Vorbis::File(stream, readAudioProperties, audioPropertiesStyle);
+    }
+    if(ext == "FLAC")
+      return new FLAC::File(stream, readMode, audioPropertiesStyle);
+    if(ext == "MPC")
+      return new MPC::File(stream, readMode, audioPropertiesStyle);
+    if(ext == "WV")
+      return new WavPack::File(stream, readMode, audioPropertiesStyle);
+    if(ext == "SPX")
+      return new Ogg::Speex::File(stream, readAudioProperties, audioPropertiesStyle);
+    if(ext == "TTA")
+      return new TrueAudio::File(stream, readMode, audioPropertiesStyle);
+#ifdef TAGLIB_WITH_MP4
+    if(ext == "M4A" || ext == "M4B" || ext == "M4P" || ext == "MP4" || ext == "3G2")
+      return new MP4::File(stream, readAudioProperties, audioPropertiesStyle);
+#endif
+#ifdef TAGLIB_WITH_ASF
+    if(ext == "WMA" || ext == "ASF")
+      return new ASF::File(stream, readAudioProperties, audioPropertiesStyle);
+#endif
+    if(ext == "AIF" || ext == "AIFF")
+      return new RIFF::AIFF::File(stream, readAudioProperties, audioPropertiesStyle);
+    if(ext == "WAV")
+      return new RIFF::WAV::File(stream, readAudioProperties, audioPropertiesStyle);
+    if(ext == "APE")
+      return new APE::File(stream, readAudioProperties, audioPropertiesStyle);
+
+    return 0;
+  }
+}
+
 class FileRef::FileRefPrivate : public RefCounter
 {
 public:
@@ -81,6 +232,12 @@ FileRef::FileRef(FileName fileName, bool readAudioProperties,
   d = new FileRefPrivate(create(fileName, readAudioProperties, audioPropertiesStyle));
 }
 
+FileRef::FileRef(FileName fileName, int readMode,
+                 AudioProperties::ReadStyle audioPropertiesStyle)
+{
+  d = new FileRefPrivate(create(fileName, readMode, audioPropertiesStyle));
+}
+
 FileRef::FileRef(File *file)
 {
   d = new FileRefPrivate(file);
@@ -198,69 +355,64 @@ bool FileRef::operator!=(const FileRef &ref) const
 File *FileRef::create(FileName fileName, bool readAudioProperties,
                       AudioProperties::ReadStyle audioPropertiesStyle) // static
 {
+  return create(fileName,
+                readAudioProperties ? File::ReadAll : File::ReadAll & ~File::ReadAudioProperties,
+                audioPropertiesStyle);
+}
 
-  List<const FileTypeResolver *>::ConstIterator it = FileRefPrivate::fileTypeResolvers.begin();
+File *FileRef::create(FileName fileName, int readMode,
+                      AudioProperties::ReadStyle audioPropertiesStyle) // static
+{
+  const bool readAudioProperties = (readMode & File::ReadAudioProperties) != 0;
+
+  // Iterated as const, so the shared list isn't detached by parallel calls.
+
+  const List<const FileTypeResolver *> &resolvers = FileRefPrivate::fileTypeResolvers;
+  List<const FileTypeResolver *>::ConstIterator it = resolvers.begin();
 
-  for(; it != FileRefPrivate::fileTypeResolvers.end(); ++it) {
+  for(; it != resolvers.end(); ++it) {
     File *file = (*it)->createFile(fileName, readAudioProperties, audioPropertiesStyle);
     if(file)
       return file;
   }
 
-  // Ok, this is really dumb for now, but it works for testing.
+  // The type is detected from the first bytes of the file, the extension is
+  // only used for the files without a known magic number.  The stream is opened
+  // once and handed over to the created file together with its first bytes.
 
-  String s;
+  FileStream *stream = new FileStream(fileName);
+
+  if(!stream->isOpen()) {
+    delete stream;
+    return 0;
+  }
+
+  // On a network drive the start of the file up to the first audio frames and
+  // the tags at its end are fetched together.
+
+  stream->prefetch(FileStream::scanBufferSize(), prefetchTailSize);
+
+  File *file = createFromContent(stream, stream->head(), readMode, audioPropertiesStyle);
+
+  if(!file) {
+    String s;
 
 #ifdef _WIN32
-  s = (wcslen((const wchar_t *) fileName) > 0) ? String((const wchar_t *) fileName) : String((const char *) fileName);
+    s = (wcslen((const wchar_t *) fileName) > 0) ? String((const wchar_t *) fileName) : String((const char *) fileName);
 #else
-  s = fileName;
+    s = fileName;
 #endif
 
-  // If this list is updated, the method defaultFileExtensions() should also be
-  // updated.  However at some point that list should be created at the same time
-  // that a default file type resolver is created.
+    int pos = s.rfind(".");
+    if(pos != -1)
+      file = createFromExtension(stream, s.substr(pos + 1).upper(), readMode, audioPropertiesStyle);
+  }
 
-  int pos = s.rfind(".");
-  if(pos != -1) {
-    String ext = s.substr(pos + 1).upper();
-    if(ext == "MP3")
-      return new MPEG::File(fileName, readAudioProperties, audioPropertiesStyle);
-    if(ext == "OGG")
-      return new Ogg::Vorbis::File(fileName, readAudioProperties, audioPropertiesStyle);
-    if(ext == "OGA") {
-      /* .oga can be any audio in the Ogg container. First try FLAC, then Vorbis. */
-      File *file = new Ogg::FLAC::File(fileName, readAudioProperties, audioPropertiesStyle);
-      if (file->isValid())
-        return file;
-      delete file;
-      return new Ogg::Vorbis::File(fileName, readAudioProperties, audioPropertiesStyle);
-    }
-    if(ext == "FLAC")
-      return new FLAC::File(fileName, readAudioProperties, audioPropertiesStyle);
-    if(ext == "MPC")
-      return new MPC::File(fileName, readAudioProperties, audioPropertiesStyle);
-    if(ext == "WV")
-      return new WavPack::File(fileName, readAudioProperties, audioPropertiesStyle);
-    if(ext == "SPX")
-      return new Ogg::Speex::File(fileName, readAudioProperties, audioPropertiesStyle);
-    if(ext == "TTA")
-      return new TrueAudio::File(fileName, readAudioProperties, audioPropertiesStyle);
-#ifdef TAGLIB_WITH_MP4
-    if(ext == "M4A" || ext == "M4B" || ext == "M4P" || ext == "MP4" || ext == "3G2")
-      return new MP4::File(fileName, readAudioProperties, audioPropertiesStyle);
-#endif
-#ifdef TAGLIB_WITH_ASF
-    if(ext == "WMA" || ext == "ASF")
-      return new ASF::File(fileName, readAudioProperties, audioPropertiesStyle);
-#endif
-    if(ext == "AIF" || ext == "AIFF")
-      return new RIFF::AIFF::File(fileName, readAudioProperties, audioPropertiesStyle);
-    if(ext == "WAV")
-      return new RIFF::WAV::File(fileName, readAudioProperties, audioPropertiesStyle);
-    if(ext == "APE")
-      return new APE::File(fileName, readAudioProperties, audioPropertiesStyle);
+  if(!file) {
+    delete stream;
+    return 0;
   }
 
-  return 0;
+  file->takeStreamOwnership();
+  return file;
 }
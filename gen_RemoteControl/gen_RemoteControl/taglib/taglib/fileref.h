@@ -127,6 +127,21 @@ namespace TagLib {
                      AudioProperties::ReadStyle
                      audioPropertiesStyle = AudioProperties::Average);
 
+    /*!
+     * Create a FileRef from \a fileName that only reads the parts given by
+     * \a readMode, a combination of File::ReadMode values.  The audio properties
+     * are read using \a audioPropertiesStyle if requested.  Formats without
+     * partial reads only leave out the audio properties.
+     *
+     * \note A file that has been read without File::ReadAllFrames may not be
+     * saved.
+     *
+     * \see File::ReadMode
+     */
+    FileRef(FileName fileName, int readMode,
+            AudioProperties::ReadStyle
+            audioPropertiesStyle = AudioProperties::Average);
+
     /*!
      * Contruct a FileRef using \a file.  The FileRef now takes ownership of the
      * pointer and will delete the File when it passes out of scope.
@@ -199,9 +214,9 @@ namespace TagLib {
     static const FileTypeResolver *addFileTypeResolver(const FileTypeResolver *resolver);
 
     /*!
-     * As is mentioned elsewhere in this class's documentation, the default file
-     * type resolution code provided by TagLib only works by comparing file
-     * extensions.
+     * The default file type resolution code provided by TagLib looks at the first
+     * bytes of the file and only compares file extensions if they don't give
+     * the type away.
      *
      * This method returns the list of file extensions that are used by default.
      *
@@ -238,7 +253,9 @@ namespace TagLib {
     bool operator!=(const FileRef &ref) const;
 
     /*!
-     * A simple implementation of file type guessing.  If \a readAudioProperties
+     * A simple implementation of file type guessing from the magic number at the
+     * start of the file and from its extension.  The file is opened once, the
+     * created file reads its first bytes from memory.  If \a readAudioProperties
      * is true then the audio properties will be read using
      * \a audioPropertiesStyle.  If \a readAudioProperties is false then
      * \a audioPropertiesStyle will be ignored.
@@ -252,6 +269,14 @@ namespace TagLib {
                         bool readAudioProperties = true,
                         AudioProperties::ReadStyle audioPropertiesStyle = AudioProperties::Average);
 
+    /*!
+     * The same as above, but only reads the parts given by \a readMode, see
+     * File::ReadMode.  The file type resolvers are only told if the audio
+     * properties are requested.
+     */
+    static File *create(FileName fileName, int readMode,
+                        AudioProperties::ReadStyle audioPropertiesStyle);
+
 
   private:
     class FileRefPrivate;
@@ -44,8 +44,31 @@ using namespace TagLib;
 namespace
 {
   enum { XiphIndex = 0, ID3v2Index = 1, ID3v1Index = 2 };
-  enum { MinPaddingLength = 4096 };
   enum { LastBlockFlag = 0x80 };
+
+  // Bytes of the metadata read at once by scan(), and bytes of a picture
+  // block read to get the fields in front of the image data
+  enum { MetadataBufferLength = 4096 };
+  enum { PictureHeaderLength = 1024 };
+
+  // Returns length bytes at offset of the metadata.  Block headers and small
+  // blocks are taken from the buffer, which is refilled from offset if they
+  // are not in it; larger blocks are read directly.
+  ByteVector readMetadata(TagLib::File *file, ByteVector &buffer, long &bufferOffset,
+                          long offset, TagLib::uint length)
+  {
+    if(offset >= bufferOffset && offset + long(length) <= bufferOffset + long(buffer.size()))
+      return buffer.mid(offset - bufferOffset, length);
+
+    file->seek(offset);
+
+    if(length > MetadataBufferLength)
+      return file->readBlock(length);
+
+    buffer = file->readBlock(MetadataBufferLength);
+    bufferOffset = offset;
+    return buffer.mid(0, length);
+  }
 }
 
 class FLAC::File::FilePrivate
@@ -63,7 +86,8 @@ public:
     scanned(false),
     hasXiphComment(false),
     hasID3v2(false),
-    hasID3v1(false)
+    hasID3v1(false),
+    readMode(TagLib::File::ReadAll)
   {
   }
 
@@ -96,6 +120,8 @@ public:
   bool hasXiphComment;
   bool hasID3v2;
   bool hasID3v1;
+
+  int readMode;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -110,6 +136,14 @@ FLAC::File::File(FileName file, bool readProperties,
   read(readProperties, propertiesStyle);
 }
 
+FLAC::File::File(IOStream *stream, bool readProperties,
+                 Properties::ReadStyle propertiesStyle) :
+  TagLib::File(stream)
+{
+  d = new FilePrivate;
+  read(readProperties, propertiesStyle);
+}
+
 FLAC::File::File(FileName file, ID3v2::FrameFactory *frameFactory,
                  bool readProperties, Properties::ReadStyle propertiesStyle) :
   TagLib::File(file)
@@ -119,6 +153,33 @@ FLAC::File::File(FileName file, ID3v2::FrameFactory *frameFactory,
   read(readProperties, propertiesStyle);
 }
 
+FLAC::File::File(IOStream *stream, ID3v2::FrameFactory *frameFactory,
+                 bool readProperties, Properties::ReadStyle propertiesStyle) :
+  TagLib::File(stream)
+{
+  d = new FilePrivate;
+  d->ID3v2FrameFactory = frameFactory;
+  read(readProperties, propertiesStyle);
+}
+
+FLAC::File::File(FileName file, int readMode,
+                 Properties::ReadStyle propertiesStyle) :
+  TagLib::File(file)
+{
+  d = new FilePrivate;
+  d->readMode = readMode;
+  read((readMode & ReadAudioProperties) != 0, propertiesStyle);
+}
+
+FLAC::File::File(IOStream *stream, int readMode,
+                 Properties::ReadStyle propertiesStyle) :
+  TagLib::File(stream)
+{
+  d = new FilePrivate;
+  d->readMode = readMode;
+  read((readMode & ReadAudioProperties) != 0, propertiesStyle);
+}
+
 FLAC::File::~File()
 {
   delete d;
@@ -137,6 +198,11 @@ FLAC::Properties *FLAC::File::audioProperties() const
 
 bool FLAC::File::save()
 {
+  if(!(d->readMode & ReadAllFrames)) {
+    debug("FLAC::File::save() -- The file has not been read completely.");
+    return false;
+  }
+
   if(readOnly()) {
     debug("FLAC::File::save() - Cannot save to a read only file.");
     return false;
@@ -187,12 +253,13 @@ bool FLAC::File::save()
     data.append(blockData);
   }
 
-  // Adjust the padding block(s)
+  // Adjust the padding block(s).  The metadata keeps its old space while it
+  // fits, otherwise the new padding leaves room for the next saves.
 
   long originalLength = d->streamStart - d->flacStart;
-  int paddingLength = originalLength - data.size() - 4; 
+  int paddingLength = originalLength - data.size() - 4;
   if (paddingLength < 0) {
-    paddingLength = MinPaddingLength;
+    paddingLength = File::paddingSize();
   }
   ByteVector padding = ByteVector::fromUInt(paddingLength);
   padding.resize(paddingLength + 4);
@@ -263,7 +330,7 @@ void FLAC::File::read(bool readProperties, Properties::ReadStyle propertiesStyle
 
   if(d->ID3v2Location >= 0) {
 
-    d->tag.set(ID3v2Index, new ID3v2::Tag(this, d->ID3v2Location, d->ID3v2FrameFactory));
+    d->tag.set(ID3v2Index, new ID3v2::Tag(this, d->ID3v2Location, d->ID3v2FrameFactory, d->readMode));
 
     d->ID3v2OriginalSize = ID3v2Tag()->header()->completeTagSize();
 
@@ -278,7 +345,8 @@ void FLAC::File::read(bool readProperties, Properties::ReadStyle propertiesStyle
   d->ID3v1Location = findID3v1();
 
   if(d->ID3v1Location >= 0) {
-    d->tag.set(ID3v1Index, new ID3v1::Tag(this, d->ID3v1Location));
+    if(d->readMode & (ReadBasicFields | ReadAllFrames))
+      d->tag.set(ID3v1Index, new ID3v1::Tag(this, d->ID3v1Location));
     d->hasID3v1 = true;
   }
 
@@ -339,9 +407,16 @@ void FLAC::File::scan()
   nextBlockOffset += 4;
   d->flacStart = nextBlockOffset;
 
-  seek(nextBlockOffset);
+  ByteVector buffer;
+  long bufferOffset = 0;
 
-  ByteVector header = readBlock(4);
+  ByteVector header = readMetadata(this, buffer, bufferOffset, nextBlockOffset, 4);
+
+  if(header.size() != 4) {
+    debug("FLAC::File::scan() -- invalid FLAC stream");
+    setValid(false);
+    return;
+  }
 
   // Header format (from spec):
   // <1> Last-metadata-block flag
@@ -355,7 +430,7 @@ void FLAC::File::scan()
 
   char blockType = header[0] & 0x7f;
   bool isLastBlock = (header[0] & 0x80) != 0;
-  uint length = header.mid(1, 3).toUInt();
+  uint length = header.toUInt(1U, 3U, true);
 
   // First block should be the stream_info metadata
 
@@ -365,27 +440,85 @@ void FLAC::File::scan()
     return;
   }
 
-  d->streamInfoData = readBlock(length);
+  d->streamInfoData = readMetadata(this, buffer, bufferOffset, nextBlockOffset + 4, length);
   d->blocks.append(new UnknownMetadataBlock(blockType, d->streamInfoData));
   nextBlockOffset += length + 4;
 
+  // Blocks that aren't asked for are only stepped over.  Without the audio
+  // properties the stream start isn't needed, so the scan can also stop as
+  // soon as everything that has been asked for is there.
+
+  const bool filtered = !(d->readMode & ReadAllFrames);
+  const bool readComment = (d->readMode & (ReadBasicFields | ReadExtendedFields)) != 0;
+  const bool readPictures = (d->readMode & ReadPictures) != 0;
+  const bool findStream = (d->readMode & ReadAudioProperties) != 0;
+
   // Search through the remaining metadata
   while(!isLastBlock) {
 
-    header = readBlock(4);
+    if(filtered && !findStream && !readPictures && (!readComment || d->hasXiphComment))
+      break;
+
+    header = readMetadata(this, buffer, bufferOffset, nextBlockOffset, 4);
+    if(header.size() != 4) {
+      debug("FLAC::File::scan() -- FLAC stream corrupted");
+      setValid(false);
+      return;
+    }
+
     blockType = header[0] & 0x7f;
     isLastBlock = (header[0] & 0x80) != 0;
-    length = header.mid(1, 3).toUInt();
+    length = header.toUInt(1U, 3U, true);
+
+    if(filtered &&
+       !(readComment && blockType == MetadataBlock::VorbisComment) &&
+       !(readPictures && blockType == MetadataBlock::Picture))
+    {
+      nextBlockOffset += length + 4;
+
+      if(nextBlockOffset >= File::length()) {
+        debug("FLAC::File::scan() -- FLAC stream corrupted");
+        setValid(false);
+        return;
+      }
+      continue;
+    }
+
+    MetadataBlock *block = 0;
+
+    // A picture that is only read is parsed without its image data, the data
+    // is read when it's asked for, see Picture::data().
+
+    if(filtered && blockType == MetadataBlock::Picture) {
+      FLAC::Picture *picture = new FLAC::Picture();
+      const ByteVector pictureHeader = readMetadata(this, buffer, bufferOffset, nextBlockOffset + 4,
+                                                    length < PictureHeaderLength ? length : uint(PictureHeaderLength));
+      if(picture->parseHeader(pictureHeader, length, this, nextBlockOffset + 4))
+        d->blocks.append(picture);
+      else {
+        delete picture;
+        picture = 0;
+      }
+
+      if(picture) {
+        nextBlockOffset += length + 4;
+
+        if(nextBlockOffset >= File::length()) {
+          debug("FLAC::File::scan() -- FLAC stream corrupted");
+          setValid(false);
+          return;
+        }
+        continue;
+      }
+    }
 
-    ByteVector data = readBlock(length);
+    ByteVector data = readMetadata(this, buffer, bufferOffset, nextBlockOffset + 4, length);
     if(data.size() != length) {
       debug("FLAC::File::scan() -- FLAC stream corrupted");
       setValid(false);
       return;
     }
 
-    MetadataBlock *block = 0;
-
     // Found the vorbis-comment
     if(blockType == MetadataBlock::VorbisComment) {
       if(!d->hasXiphComment) {
@@ -424,7 +557,6 @@ void FLAC::File::scan()
       setValid(false);
       return;
     }
-    seek(nextBlockOffset);
   }
 
   // End of metadata, now comes the datastream
@@ -77,6 +77,17 @@ namespace TagLib {
       File(FileName file, bool readProperties = true,
            Properties::ReadStyle propertiesStyle = Properties::Average);
 
+      /*!
+       * Contructs a FLAC file from \a stream.  If \a readProperties is true the
+       * file's audio properties will also be read using \a propertiesStyle.  If
+       * false, \a propertiesStyle is ignored.
+       *
+       * The stream is not owned by the file, it has to stay valid until the
+       * file is destroyed.
+       */
+      File(IOStream *stream, bool readProperties = true,
+           Properties::ReadStyle propertiesStyle = Properties::Average);
+
       /*!
        * Contructs a FLAC file from \a file.  If \a readProperties is true the
        * file's audio properties will also be read using \a propertiesStyle.  If
@@ -90,6 +101,43 @@ namespace TagLib {
            bool readProperties = true,
            Properties::ReadStyle propertiesStyle = Properties::Average);
 
+      /*!
+       * Contructs a FLAC file from \a stream.  If \a readProperties is true the
+       * file's audio properties will also be read using \a propertiesStyle.  If
+       * false, \a propertiesStyle is ignored.
+       *
+       * If this file contains and ID3v2 tag the frames will be created using
+       * \a frameFactory.
+       *
+       * The stream is not owned by the file, it has to stay valid until the
+       * file is destroyed.
+       */
+      // BIC: merge with the above constructor
+      File(IOStream *stream, ID3v2::FrameFactory *frameFactory,
+           bool readProperties = true,
+           Properties::ReadStyle propertiesStyle = Properties::Average);
+
+      /*!
+       * Contructs a FLAC file from \a file that only reads the parts given by
+       * \a readMode, a combination of TagLib::File::ReadMode values.  The audio
+       * properties are read using \a propertiesStyle if requested.  Metadata
+       * blocks that are not asked for are skipped without being read.
+       *
+       * \note A file that has been read without ReadAllFrames can't be saved.
+       */
+      File(FileName file, int readMode,
+           Properties::ReadStyle propertiesStyle = Properties::Average);
+
+      /*!
+       * Contructs a FLAC file from \a stream that only reads the parts given by
+       * \a readMode, see the constructor above.
+       *
+       * The stream is not owned by the file, it has to stay valid until the
+       * file is destroyed.
+       */
+      File(IOStream *stream, int readMode,
+           Properties::ReadStyle propertiesStyle = Properties::Average);
+
       /*!
        * Destroys this instance of the File.
        */
@@ -29,6 +29,7 @@
 
 #include <taglib.h>
 #include <tdebug.h>
+#include <tfile.h>
 #include "flacpicture.h"
 
 using namespace TagLib;
@@ -41,7 +42,10 @@ public:
     width(0),
     height(0),
     colorDepth(0),
-    numColors(0)
+    numColors(0),
+    dataLength(0),
+    dataOffset(-1),
+    file(0)
     {}
 
   Type type;
@@ -52,6 +56,11 @@ public:
   int colorDepth;
   int numColors;
   ByteVector data;
+  uint dataLength;
+  long dataOffset;
+
+  // The file to read the data from, zero once it has been read
+  TagLib::File *file;
 };
 
 FLAC::Picture::Picture()
@@ -82,40 +91,13 @@ bool FLAC::Picture::parse(const ByteVector &data)
     return false;
   }
 
-  int pos = 0;
-  d->type = FLAC::Picture::Type(data.mid(pos, 4).toUInt());
-  pos += 4;
-  uint mimeTypeLength = data.mid(pos, 4).toUInt();
-  pos += 4;
-  if(pos + mimeTypeLength + 24 > data.size()) {
+  int pos = parseFields(data, data.size());
+  if(pos < 0) {
     debug("Invalid picture block.");
     return false;
   }
-  d->mimeType = String(data.mid(pos, mimeTypeLength), String::UTF8);
-  pos += mimeTypeLength;
-  uint descriptionLength = data.mid(pos, 4).toUInt();
-  pos += 4;
-  if(pos + descriptionLength + 20 > data.size()) {
-    debug("Invalid picture block.");
-    return false;
-  }
-  d->description = String(data.mid(pos, descriptionLength), String::UTF8);
-  pos += descriptionLength;
-  d->width = data.mid(pos, 4).toUInt();
-  pos += 4;
-  d->height = data.mid(pos, 4).toUInt();
-  pos += 4;
-  d->colorDepth = data.mid(pos, 4).toUInt();
-  pos += 4;
-  d->numColors = data.mid(pos, 4).toUInt();
-  pos += 4;
-  uint dataLength = data.mid(pos, 4).toUInt();
-  pos += 4;
-  if(pos + dataLength > data.size()) {
-    debug("Invalid picture block.");
-    return false;
-  }
-  d->data = data.mid(pos, dataLength);
+  d->data = data.mid(pos, d->dataLength);
+  d->file = 0;
 
   return true;  
 }
@@ -134,8 +116,9 @@ ByteVector FLAC::Picture::render() const
   result.append(ByteVector::fromUInt(d->height));
   result.append(ByteVector::fromUInt(d->colorDepth));
   result.append(ByteVector::fromUInt(d->numColors));
-  result.append(ByteVector::fromUInt(d->data.size()));
-  result.append(d->data);
+  const ByteVector pictureData = data();
+  result.append(ByteVector::fromUInt(pictureData.size()));
+  result.append(pictureData);
   return result;
 }
 
@@ -211,11 +194,82 @@ void FLAC::Picture::setNumColors(int numColors)
 
 ByteVector FLAC::Picture::data() const
 {
+  if(d->file) {
+    d->file->seek(d->dataOffset);
+    d->data = d->file->readBlock(d->dataLength);
+    d->file = 0;
+  }
   return d->data;
 }
 
 void FLAC::Picture::setData(const ByteVector &data)
 {
   d->data = data;
+  d->dataLength = data.size();
+  d->dataOffset = -1;
+  d->file = 0;
+}
+
+TagLib::uint FLAC::Picture::dataLength() const
+{
+  return d->dataLength;
+}
+
+long FLAC::Picture::dataOffset() const
+{
+  return d->dataOffset;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// private members
+////////////////////////////////////////////////////////////////////////////////
+
+int FLAC::Picture::parseFields(const ByteVector &data, uint length)
+{
+  if(length < 32 || data.size() < 32)
+    return -1;
+
+  uint pos = 0;
+  d->type = FLAC::Picture::Type(data.toUInt(pos));
+  pos += 4;
+  uint mimeTypeLength = data.toUInt(pos);
+  pos += 4;
+  if(pos + mimeTypeLength + 24 > data.size())
+    return -1;
+  d->mimeType = String(data.mid(pos, mimeTypeLength), String::UTF8);
+  pos += mimeTypeLength;
+  uint descriptionLength = data.toUInt(pos);
+  pos += 4;
+  if(pos + descriptionLength + 20 > data.size())
+    return -1;
+  d->description = String(data.mid(pos, descriptionLength), String::UTF8);
+  pos += descriptionLength;
+  d->width = data.toUInt(pos);
+  pos += 4;
+  d->height = data.toUInt(pos);
+  pos += 4;
+  d->colorDepth = data.toUInt(pos);
+  pos += 4;
+  d->numColors = data.toUInt(pos);
+  pos += 4;
+  d->dataLength = data.toUInt(pos);
+  pos += 4;
+  if(pos + d->dataLength > length)
+    return -1;
+
+  return pos;
+}
+
+bool FLAC::Picture::parseHeader(const ByteVector &data, uint length, TagLib::File *file, long offset)
+{
+  int pos = parseFields(data, length);
+  if(pos < 0)
+    return false;
+
+  d->data = ByteVector::null;
+  d->dataOffset = offset + pos;
+  d->file = file;
+
+  return true;
 }
 
@@ -34,8 +34,12 @@
 
 namespace TagLib {
 
+  class File;
+
   namespace FLAC {
 
+    class File;
+
     class TAGLIB_EXPORT Picture : public MetadataBlock
     {
     public:
@@ -168,9 +172,24 @@ namespace TagLib {
 
       /*!
        * Returns the image data.
+       *
+       * \note The data of a picture of a FLAC::File that has been read without
+       * File::ReadAllFrames is only read from the file by the first call.
        */
       ByteVector data() const;
 
+      /*!
+       * Returns the size of the image data, without reading it.
+       */
+      uint dataLength() const;
+
+      /*!
+       * Returns the offset of the image data in the file the picture has been
+       * read from, or -1 if the picture hasn't been read from a file or its
+       * data has been replaced.
+       */
+      long dataOffset() const;
+
       /*!
        * Sets the image data.
        */
@@ -192,9 +211,26 @@ namespace TagLib {
       bool parse(const ByteVector &rawData);
 
     private:
+      friend class File;
+
       Picture(const Picture &item);
       Picture &operator=(const Picture &item);
 
+      /*!
+       * Parses the fields in front of the image data, \a data has to contain
+       * at least everything up to the data, \a length is the size of the
+       * whole block.  Returns the position of the image data or -1 if the
+       * block is invalid or \a data is too short.
+       */
+      int parseFields(const ByteVector &data, uint length);
+
+      /*!
+       * Parses a picture block of \a length bytes at \a offset in \a file
+       * from the start of the block in \a data, without the image data.  It
+       * is read by data() when it's needed.
+       */
+      bool parseHeader(const ByteVector &data, uint length, TagLib::File *file, long offset);
+
       class PicturePrivate;
       PicturePrivate *d;
     };
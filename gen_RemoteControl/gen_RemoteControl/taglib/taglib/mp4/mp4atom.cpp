@@ -40,7 +40,7 @@ const char *MP4::Atom::containers[10] = {
     "stbl", "minf", "moof", "traf", "trak",
 };
 
-MP4::Atom::Atom(File *file)
+MP4::Atom::Atom(File *file) : file(file), childOffset(-1)
 {
   offset = file->tell();
   ByteVector header = file->readBlock(8);
@@ -79,16 +79,11 @@ MP4::Atom::Atom(File *file)
 
   for(int i = 0; i < numContainers; i++) {
     if(name == containers[i]) {
+      childOffset = file->tell();
       if(name == "meta") {
-        file->seek(4, File::Current);
+        childOffset += 4;
       }
-      while(file->tell() < offset + length) {
-        MP4::Atom *child = new MP4::Atom(file);
-        children.append(child);
-        if (child->length == 0)
-          return;
-      }
-      return;
+      break;
     }
   }
 
@@ -103,9 +98,35 @@ MP4::Atom::~Atom()
   children.clear();
 }
 
+void
+MP4::Atom::readChildren()
+{
+  if(childOffset < 0) {
+    return;
+  }
+  file->seek(childOffset);
+  childOffset = -1;
+  while(file->tell() < offset + length) {
+    MP4::Atom *child = new MP4::Atom(file);
+    children.append(child);
+    if (child->length == 0)
+      return;
+  }
+}
+
+void
+MP4::Atom::readAll()
+{
+  readChildren();
+  for(unsigned int i = 0; i < children.size(); i++) {
+    children[i]->readAll();
+  }
+}
+
 MP4::Atom *
 MP4::Atom::find(const char *name1, const char *name2, const char *name3, const char *name4)
 {
+  readChildren();
   if(name1 == 0) {
     return this;
   }
@@ -120,6 +141,7 @@ MP4::Atom::find(const char *name1, const char *name2, const char *name3, const c
 MP4::AtomList
 MP4::Atom::findall(const char *name, bool recursive)
 {
+  readChildren();
   MP4::AtomList result;
   for(unsigned int i = 0; i < children.size(); i++) {
     if(children[i]->name == name) {
@@ -135,6 +157,7 @@ MP4::Atom::findall(const char *name, bool recursive)
 bool
 MP4::Atom::path(MP4::AtomList &path, const char *name1, const char *name2, const char *name3)
 {
+  readChildren();
   path.append(this);
   if(name1 == 0) {
     return true;
@@ -147,17 +170,11 @@ MP4::Atom::path(MP4::AtomList &path, const char *name1, const char *name2, const
   return false;
 }
 
-MP4::Atoms::Atoms(File *file)
+MP4::Atoms::Atoms(File *file) : file(file), nextOffset(0)
 {
-  file->seek(0, File::End);
-  long end = file->tell();
-  file->seek(0);
-  while(file->tell() + 8 <= end) {
-    MP4::Atom *atom = new MP4::Atom(file);
-    atoms.append(atom);
-    if (atom->length == 0)
-      break;
-  }
+  // Nothing is read yet, in a fast start file the moov atom is found without
+  // stepping over the media data.
+  end = file->length();
 }
 
 MP4::Atoms::~Atoms()
@@ -168,27 +185,63 @@ MP4::Atoms::~Atoms()
   atoms.clear();
 }
 
+bool
+MP4::Atoms::readNext()
+{
+  if(nextOffset < 0 || nextOffset + 8 > end) {
+    return false;
+  }
+  file->seek(nextOffset);
+  MP4::Atom *atom = new MP4::Atom(file);
+  atoms.append(atom);
+  nextOffset = atom->length == 0 ? -1 : file->tell();
+  return true;
+}
+
+void
+MP4::Atoms::readAll()
+{
+  while(readNext()) {
+  }
+  for(unsigned int i = 0; i < atoms.size(); i++) {
+    atoms[i]->readAll();
+  }
+}
+
 MP4::Atom *
-MP4::Atoms::find(const char *name1, const char *name2, const char *name3, const char *name4)
+MP4::Atoms::findRoot(const char *name)
 {
   for(unsigned int i = 0; i < atoms.size(); i++) {
-    if(atoms[i]->name == name1) {
-      return atoms[i]->find(name2, name3, name4);
+    if(atoms[i]->name == name) {
+      return atoms[i];
+    }
+  }
+  while(readNext()) {
+    if(atoms.back()->name == name) {
+      return atoms.back();
     }
   }
   return 0;
 }
 
+MP4::Atom *
+MP4::Atoms::find(const char *name1, const char *name2, const char *name3, const char *name4)
+{
+  MP4::Atom *atom = findRoot(name1);
+  if(atom) {
+    return atom->find(name2, name3, name4);
+  }
+  return 0;
+}
+
 MP4::AtomList
 MP4::Atoms::path(const char *name1, const char *name2, const char *name3, const char *name4)
 {
   MP4::AtomList path;
-  for(unsigned int i = 0; i < atoms.size(); i++) {
-    if(atoms[i]->name == name1) {
-      if(!atoms[i]->path(path, name2, name3, name4)) {
-        path.clear();
-      }
-      return path;
+  MP4::Atom *atom = findRoot(name1);
+  if(atom) {
+    if(!atom->path(path, name2, name3, name4)) {
+      path.clear();
     }
   }
   return path;
@@ -40,6 +40,13 @@ namespace TagLib {
     class Atom;
     typedef TagLib::List<Atom *> AtomList;
 
+    //! An atom, only its header is read until its children are asked for
+
+    /*!
+     * The children of a container are read by the first find(), path() or
+     * findall() that descends into it, the atoms these return have their
+     * children read as well.
+     */
     class Atom
     {
     public:
@@ -48,16 +55,21 @@ namespace TagLib {
         Atom *find(const char *name1, const char *name2 = 0, const char *name3 = 0, const char *name4 = 0);
         bool path(AtomList &path, const char *name1, const char *name2 = 0, const char *name3 = 0);
         AtomList findall(const char *name, bool recursive = false);
+        void readAll();
         long offset;
         long length;
         TagLib::ByteVector name;
         AtomList children;
     private:
+        void readChildren();
+        File *file;
+        // offset of the first child of a container, -1 if the children have been read
+        long childOffset;
         static const int numContainers = 10;
         static const char *containers[10];
     };
 
-    //! Root-level atoms
+    //! Root-level atoms, read up to the one that is asked for
     class Atoms
     {
     public:
@@ -65,7 +77,20 @@ namespace TagLib {
         ~Atoms();
         Atom *find(const char *name1, const char *name2 = 0, const char *name3 = 0, const char *name4 = 0);
         AtomList path(const char *name1, const char *name2 = 0, const char *name3 = 0, const char *name4 = 0);
+
+        /*!
+         * Reads the whole tree, the remaining root-level atoms and all
+         * children.  Has to be done before the file is changed.
+         */
+        void readAll();
+
         AtomList atoms;
+    private:
+        Atom *findRoot(const char *name);
+        bool readNext();
+        File *file;
+        long end;
+        long nextOffset;
     };
 
   }
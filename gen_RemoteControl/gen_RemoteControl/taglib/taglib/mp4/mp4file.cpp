@@ -72,6 +72,13 @@ MP4::File::File(FileName file, bool readProperties, AudioProperties::ReadStyle a
   read(readProperties, audioPropertiesStyle);
 }
 
+MP4::File::File(IOStream *stream, bool readProperties, AudioProperties::ReadStyle audioPropertiesStyle)
+    : TagLib::File(stream)
+{
+  d = new FilePrivate;
+  read(readProperties, audioPropertiesStyle);
+}
+
 MP4::File::~File()
 {
   delete d;
@@ -108,14 +115,10 @@ MP4::File::read(bool readProperties, Properties::ReadStyle audioPropertiesStyle)
     return;
 
   d->atoms = new Atoms(this);
-  if (!checkValid(d->atoms->atoms)) {
-    setValid(false);
-    return;
-  }
 
   // must have a moov atom, otherwise consider it invalid
   MP4::Atom *moov = d->atoms->find("moov");
-  if(!moov) {
+  if(!moov || !checkValid(d->atoms->atoms)) {
     setValid(false);
     return;
   }
@@ -124,6 +127,11 @@ MP4::File::read(bool readProperties, Properties::ReadStyle audioPropertiesStyle)
   if(readProperties) {
     d->properties = new Properties(this, d->atoms, audioPropertiesStyle);
   }
+
+  // only the atoms needed for the tag and the properties have been read
+  if (!checkValid(d->atoms->atoms)) {
+    setValid(false);
+  }
 }
 
 bool
@@ -29,6 +29,7 @@
 
 #ifdef WITH_MP4
 
+#include <string.h>
 #include <tdebug.h>
 #include <tstring.h>
 #include "mp4atom.h"
@@ -45,6 +46,8 @@ public:
   TagLib::File *file;
   Atoms *atoms;
   ItemListMap items;
+  // covr atoms that haven't been parsed yet, see itemListMap()
+  AtomList covr;
 };
 
 MP4::Tag::Tag(TagLib::File *file, MP4::Atoms *atoms)
@@ -78,7 +81,8 @@ MP4::Tag::Tag(TagLib::File *file, MP4::Atoms *atoms)
       parseGnre(atom, file);
     }
     else if(atom->name == "covr") {
-      parseCovr(atom, file);
+      // the pictures are only read when the items are asked for
+      d->covr.append(atom);
     }
     else {
       parseText(atom, file);
@@ -201,6 +205,7 @@ void
 MP4::Tag::parseCovr(MP4::Atom *atom, TagLib::File *file)
 {
   MP4::CoverArtList value;
+  file->seek(atom->offset + 8);
   ByteVector data = file->readBlock(atom->length - 8);
   unsigned int pos = 0;
   while(pos < data.size()) {
@@ -221,11 +226,20 @@ MP4::Tag::parseCovr(MP4::Atom *atom, TagLib::File *file)
     d->items.insert(atom->name, value);
 }
 
+void
+MP4::Tag::parseCovr()
+{
+  for(unsigned int i = 0; i < d->covr.size(); i++) {
+    parseCovr(d->covr[i], d->file);
+  }
+  d->covr.clear();
+}
+
 ByteVector
 MP4::Tag::padIlst(const ByteVector &data, int length)
 {
   if (length == -1) {
-    length = ((data.size() + 1023) & ~1023) - data.size();
+    length = ((data.size() + File::paddingSize() + 1023) & ~1023) - data.size();
   }
   return renderAtom("free", ByteVector(length, '\1'));
 }
@@ -327,6 +341,11 @@ MP4::Tag::renderFreeForm(const String &name, MP4::Item &item)
 bool
 MP4::Tag::save()
 {
+  // the offsets of the atoms that are not read yet would be stale
+  // after the first change
+  parseCovr();
+  d->atoms->readAll();
+
   ByteVector data;
   for(MP4::ItemListMap::Iterator i = d->items.begin(); i != d->items.end(); i++) {
     const String name = i->first;
@@ -391,49 +410,57 @@ MP4::Tag::updateParents(AtomList &path, long delta, int ignore)
 }
 
 void
-MP4::Tag::updateOffsets(long delta, long offset)
+MP4::Tag::updateOffsets(long delta, long offset, long end)
 {
+  // only the atoms and chunks in (offset, end) have moved, a table is
+  // written back once and only if one of its entries has changed
   MP4::Atom *moov = d->atoms->find("moov");
   if(moov) {
     MP4::AtomList stco = moov->findall("stco", true);
     for(unsigned int i = 0; i < stco.size(); i++) {
       MP4::Atom *atom = stco[i];
-      if(atom->offset > offset) {
+      if(atom->offset > offset && (end < 0 || atom->offset < end)) {
         atom->offset += delta;
       }
       d->file->seek(atom->offset + 12);
       ByteVector data = d->file->readBlock(atom->length - 12);
       unsigned int count = data.mid(0, 4).toUInt();
-      d->file->seek(atom->offset + 16);
-      int pos = 4;
-      while(count--) {
+      bool changed = false;
+      for(unsigned int pos = 4; count-- && pos + 4 <= data.size(); pos += 4) {
         long o = data.mid(pos, 4).toUInt();
-        if(o > offset) {
-          o += delta;
+        if(o > offset && (end < 0 || o < end)) {
+          ByteVector moved = ByteVector::fromUInt(o + delta);
+          ::memcpy(data.data() + pos, moved.data(), 4);
+          changed = true;
         }
-        d->file->writeBlock(ByteVector::fromUInt(o));
-        pos += 4;
+      }
+      if(changed) {
+        d->file->seek(atom->offset + 16);
+        d->file->writeBlock(data.mid(4));
       }
     }
 
     MP4::AtomList co64 = moov->findall("co64", true);
     for(unsigned int i = 0; i < co64.size(); i++) {
       MP4::Atom *atom = co64[i];
-      if(atom->offset > offset) {
+      if(atom->offset > offset && (end < 0 || atom->offset < end)) {
         atom->offset += delta;
       }
       d->file->seek(atom->offset + 12);
       ByteVector data = d->file->readBlock(atom->length - 12);
       unsigned int count = data.mid(0, 4).toUInt();
-      d->file->seek(atom->offset + 16);
-      int pos = 4;
-      while(count--) {
+      bool changed = false;
+      for(unsigned int pos = 4; count-- && pos + 8 <= data.size(); pos += 8) {
         long long o = data.mid(pos, 8).toLongLong();
-        if(o > offset) {
-          o += delta;
+        if(o > offset && (end < 0 || o < end)) {
+          ByteVector moved = ByteVector::fromLongLong(o + delta);
+          ::memcpy(data.data() + pos, moved.data(), 8);
+          changed = true;
         }
-        d->file->writeBlock(ByteVector::fromLongLong(o));
-        pos += 8;
+      }
+      if(changed) {
+        d->file->seek(atom->offset + 16);
+        d->file->writeBlock(data.mid(4));
       }
     }
   }
@@ -443,24 +470,81 @@ MP4::Tag::updateOffsets(long delta, long offset)
     MP4::AtomList tfhd = moof->findall("tfhd", true);
     for(unsigned int i = 0; i < tfhd.size(); i++) {
       MP4::Atom *atom = tfhd[i];
-      if(atom->offset > offset) {
+      if(atom->offset > offset && (end < 0 || atom->offset < end)) {
         atom->offset += delta;
       }
       d->file->seek(atom->offset + 9);
-      ByteVector data = d->file->readBlock(atom->offset - 9);
+      ByteVector data = d->file->readBlock(atom->length - 9);
       unsigned int flags = (ByteVector(1, '\0') + data.mid(0, 3)).toUInt();
       if(flags & 1) {
         long long o = data.mid(7, 8).toLongLong();
-        if(o > offset) {
+        if(o > offset && (end < 0 || o < end)) {
           o += delta;
+          d->file->seek(atom->offset + 16);
+          d->file->writeBlock(ByteVector::fromLongLong(o));
         }
-        d->file->seek(atom->offset + 16);
-        d->file->writeBlock(ByteVector::fromLongLong(o));
       }
     }
   }
 }
 
+bool
+MP4::Tag::saveInPadding(const ByteVector &data, AtomList &path, long offset, long length)
+{
+  // the region grows into a 'free' or 'skip' atom that follows one of its
+  // containers.  the bytes between the region and that atom move, the
+  // containers in between grow and the one that holds the padding keeps
+  // its size, so the chunk offsets stay valid unless a chunk lies in between
+  static const long maxMove = 16 * 1024 * 1024;
+
+  long delta = data.size() - length;
+
+  for(int j = path.size() - 1; j >= 0; j--) {
+    AtomList &siblings = j > 0 ? path[j - 1]->children : d->atoms->atoms;
+    AtomList::Iterator it = siblings.find(path[j]);
+    if(it == siblings.end() || ++it == siblings.end()) {
+      continue;
+    }
+    MP4::Atom *padding = *it;
+    if(padding->name != "free" && padding->name != "skip") {
+      continue;
+    }
+    if(padding->length != delta && padding->length < delta + 8) {
+      continue;
+    }
+    // a truncated file ends inside the padding
+    if(padding->offset + padding->length > d->file->length()) {
+      continue;
+    }
+    long between = padding->offset - (offset + length);
+    if(between < 0 || between > maxMove) {
+      continue;
+    }
+
+    ByteVector region = data;
+    if(between > 0) {
+      d->file->seek(offset + length);
+      region.append(d->file->readBlock(between));
+    }
+    if(padding->length != delta) {
+      region.append(padIlst(data, padding->length - delta - 8));
+    }
+    d->file->insert(region, offset, padding->offset + padding->length - offset);
+
+    AtomList grown;
+    for(unsigned int i = j; i < path.size(); i++) {
+      grown.append(path[i]);
+    }
+    updateParents(grown, delta);
+    if(between > 0) {
+      updateOffsets(delta, offset, padding->offset);
+    }
+    return true;
+  }
+
+  return false;
+}
+
 void
 MP4::Tag::saveNew(ByteVector &data)
 {
@@ -475,6 +559,10 @@ MP4::Tag::saveNew(ByteVector &data)
   }
 
   long offset = path[path.size() - 1]->offset + 8;
+  if(saveInPadding(data, path, offset, 0)) {
+    return;
+  }
+
   d->file->insert(data, offset, 0);
 
   updateParents(path, data.size());
@@ -512,7 +600,18 @@ MP4::Tag::saveExisting(ByteVector &data, AtomList &path)
   }
 
   long delta = data.size() - length;
-  if(delta > 0 || (delta < 0 && delta > -8)) {
+  if(delta > 0) {
+    // a padding atom further out takes the growth, the offset tables and
+    // 'mdat' are only touched if there is none
+    AtomList parents = path;
+    parents.erase(parents.find(ilst));
+    if(saveInPadding(data, parents, offset, length)) {
+      return;
+    }
+    data.append(padIlst(data));
+    delta = data.size() - length;
+  }
+  else if(delta < 0 && delta > -8) {
     data.append(padIlst(data));
     delta = data.size() - length;
   }
@@ -630,6 +729,7 @@ MP4::Tag::setTrack(uint value)
 MP4::ItemListMap &
 MP4::Tag::itemListMap()
 {
+  parseCovr();
   return d->items;
 }
 
@@ -75,6 +75,7 @@ namespace TagLib {
         void parseIntPair(Atom *atom, TagLib::File *file);
         void parseBool(Atom *atom, TagLib::File *file);
         void parseCovr(Atom *atom, TagLib::File *file);
+        void parseCovr();
 
         TagLib::ByteVector padIlst(const ByteVector &data, int length = -1);
         TagLib::ByteVector renderAtom(const ByteVector &name, const TagLib::ByteVector &data);
@@ -88,7 +89,8 @@ namespace TagLib {
         TagLib::ByteVector renderCovr(const ByteVector &name, Item &item);
 
         void updateParents(AtomList &path, long delta, int ignore = 0);
-        void updateOffsets(long delta, long offset);
+        void updateOffsets(long delta, long offset, long end = -1);
+        bool saveInPadding(const TagLib::ByteVector &data, AtomList &path, long offset, long length);
 
         void saveNew(TagLib::ByteVector &data);
         void saveExisting(TagLib::ByteVector &data, AtomList &path);
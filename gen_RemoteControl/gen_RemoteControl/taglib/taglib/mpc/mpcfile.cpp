@@ -33,6 +33,7 @@
 #include "id3v2header.h"
 #include "apetag.h"
 #include "apefooter.h"
+#include "apetrailer.h"
 
 using namespace TagLib;
 
@@ -55,7 +56,8 @@ public:
     scanned(false),
     hasAPE(false),
     hasID3v1(false),
-    hasID3v2(false) {}
+    hasID3v2(false),
+    readMode(TagLib::File::ReadAll) {}
 
   ~FilePrivate()
   {
@@ -83,6 +85,8 @@ public:
   bool hasAPE;
   bool hasID3v1;
   bool hasID3v2;
+
+  int readMode;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -96,6 +100,29 @@ MPC::File::File(FileName file, bool readProperties,
   read(readProperties, propertiesStyle);
 }
 
+MPC::File::File(IOStream *stream, bool readProperties,
+                Properties::ReadStyle propertiesStyle) : TagLib::File(stream)
+{
+  d = new FilePrivate;
+  read(readProperties, propertiesStyle);
+}
+
+MPC::File::File(FileName file, int readMode,
+                Properties::ReadStyle propertiesStyle) : TagLib::File(file)
+{
+  d = new FilePrivate;
+  d->readMode = readMode;
+  read((readMode & ReadAudioProperties) != 0, propertiesStyle);
+}
+
+MPC::File::File(IOStream *stream, int readMode,
+                Properties::ReadStyle propertiesStyle) : TagLib::File(stream)
+{
+  d = new FilePrivate;
+  d->readMode = readMode;
+  read((readMode & ReadAudioProperties) != 0, propertiesStyle);
+}
+
 MPC::File::~File()
 {
   delete d;
@@ -113,6 +140,11 @@ MPC::Properties *MPC::File::audioProperties() const
 
 bool MPC::File::save()
 {
+  if(!(d->readMode & ReadAllFrames)) {
+    debug("MPC::File::save() -- The file has not been read completely.");
+    return false;
+  }
+
   if(readOnly()) {
     debug("MPC::File::save() -- File is read only.");
     return false;
@@ -227,99 +259,66 @@ void MPC::File::remove(int tags)
 // private members
 ////////////////////////////////////////////////////////////////////////////////
 
-void MPC::File::read(bool readProperties, Properties::ReadStyle /* propertiesStyle */)
+void MPC::File::read(bool readProperties, Properties::ReadStyle propertiesStyle)
 {
-  // Look for an ID3v1 tag
+  if(!isValid())
+    return;
+
+  // Look for an ID3v1 and an APE tag, the end of the file is read once.  The
+  // probe also tells where the stream ends when the tags aren't parsed.
+
+  const APE::Trailer trailer(this);
+  const bool readTags = (d->readMode & (ReadBasicFields | ReadExtendedFields | ReadAllFrames)) != 0;
 
-  d->ID3v1Location = findID3v1();
+  d->ID3v1Location = trailer.ID3v1Location();
 
   if(d->ID3v1Location >= 0) {
-    d->tag.set(ID3v1Index, new ID3v1::Tag(this, d->ID3v1Location));
+    if(readTags)
+      d->tag.set(ID3v1Index, new ID3v1::Tag(this, d->ID3v1Location, trailer.ID3v1Data()));
     d->hasID3v1 = true;
   }
 
-  // Look for an APE tag
-
-  findAPE();
-
-  d->APELocation = findAPE();
+  d->APELocation = trailer.APELocation();
 
   if(d->APELocation >= 0) {
-    d->tag.set(APEIndex, new APE::Tag(this, d->APELocation));
+    if(readTags)
+      d->tag.set(APEIndex, new APE::Tag(this, trailer.APEFooterLocation(), trailer.APEFooterData()));
 
-    d->APESize = APETag()->footer()->completeTagSize();
-    d->APELocation = d->APELocation + APETag()->footer()->size() - d->APESize;
+    d->APESize = trailer.APESize();
     d->hasAPE = true;
   }
 
   if(!d->hasID3v1)
     APETag(true);
 
-  // Look for and skip an ID3v2 tag
+  // The start of the file holds the stream header or the header of an ID3v2
+  // tag that is skipped, it is read once.
 
-  d->ID3v2Location = findID3v2();
+  seek(0);
+  ByteVector header = readBlock(MPC::HeaderSize);
 
-  if(d->ID3v2Location >= 0) {
-    seek(d->ID3v2Location);
-    d->ID3v2Header = new ID3v2::Header(readBlock(ID3v2::Header::size()));
+  if(header.startsWith(ID3v2::Header::fileIdentifier()) && header.size() >= ID3v2::Header::size()) {
+    d->ID3v2Location = 0;
+    d->ID3v2Header = new ID3v2::Header(header.mid(0, ID3v2::Header::size()));
     d->ID3v2Size = d->ID3v2Header->completeTagSize();
     d->hasID3v2 = true;
-  }
-
-  if(d->hasID3v2)
-    seek(d->ID3v2Location + d->ID3v2Size);
-  else
-    seek(0);
 
-  // Look for MPC metadata
-
-  if(readProperties) {
-    d->properties = new Properties(readBlock(MPC::HeaderSize),
-                                   length() - d->ID3v2Size - d->APESize);
+    if(readProperties) {
+      seek(d->ID3v2Size);
+      header = readBlock(MPC::HeaderSize);
+    }
   }
-}
-
-long MPC::File::findAPE()
-{
-  if(!isValid())
-    return -1;
-
-  if(d->hasID3v1)
-    seek(-160, End);
-  else
-    seek(-32, End);
-
-  long p = tell();
-
-  if(readBlock(8) == APE::Tag::fileIdentifier())
-    return p;
-
-  return -1;
-}
 
-long MPC::File::findID3v1()
-{
-  if(!isValid())
-    return -1;
-
-  seek(-128, End);
-  long p = tell();
-
-  if(readBlock(3) == ID3v1::Tag::fileIdentifier())
-    return p;
+  // Look for MPC metadata, the stream lies between the tags
 
-  return -1;
-}
-
-long MPC::File::findID3v2()
-{
-  if(!isValid())
-    return -1;
-
-  seek(0);
+  if(readProperties) {
+    long streamEnd = length();
 
-  if(readBlock(3) == ID3v2::Header::fileIdentifier())
-    return 0;
+    if(d->hasAPE)
+      streamEnd = d->APELocation;
+    if(d->hasID3v1 && d->ID3v1Location < streamEnd)
+      streamEnd = d->ID3v1Location;
 
-  return -1;
+    d->properties = new Properties(header, streamEnd - long(d->ID3v2Size), propertiesStyle);
+  }
 }
@@ -32,6 +32,24 @@
 
 using namespace TagLib;
 
+namespace
+{
+  // The packet sizes and sample counts of SV8 take 7 bits per byte, the high
+  // bit tells that another byte follows.
+
+  bool readSV8Number(const ByteVector &data, uint &pos, unsigned long long &value)
+  {
+    value = 0;
+    for(int i = 0; i < 9 && pos < data.size(); i++) {
+      const uchar byte = data[pos++];
+      value = (value << 7) | (byte & 0x7f);
+      if(!(byte & 0x80))
+        return true;
+    }
+    return false;
+  }
+}
+
 class MPC::Properties::PropertiesPrivate
 {
 public:
@@ -103,6 +121,11 @@ static const unsigned short sftable [4] = { 44100, 48000, 37800, 32000 };
 
 void MPC::Properties::read()
 {
+  if(d->data.startsWith("MPCK")) {
+    readSV8();
+    return;
+  }
+
   if(!d->data.startsWith("MP+"))
     return;
 
@@ -138,3 +161,51 @@ void MPC::Properties::read()
   if(!d->bitrate)
     d->bitrate = d->length > 0 ? ((d->streamLength * 8L) / d->length) / 1000 : 0;
 }
+
+void MPC::Properties::readSV8()
+{
+  // The stream header packet follows the magic number: its key "SH", its size,
+  // a CRC, the stream version, the sample count, the samples of silence at the
+  // beginning, then the sample rate and the channels in the high bits of the
+  // next two bytes.
+
+  uint pos = 4;
+
+  if(!d->data.containsAt("SH", pos))
+    return;
+  pos += 2;
+
+  unsigned long long size;
+  if(!readSV8Number(d->data, pos, size))
+    return;
+
+  pos += 4;
+
+  if(pos >= d->data.size())
+    return;
+  d->version = uchar(d->data[pos]);
+  pos += 1;
+
+  unsigned long long samples;
+  unsigned long long silence;
+  if(!readSV8Number(d->data, pos, samples) || !readSV8Number(d->data, pos, silence))
+    return;
+
+  if(pos + 2 > d->data.size())
+    return;
+
+  const uint rateIndex = uchar(d->data[pos]) >> 5;
+  if(rateIndex >= 4)
+    return;
+
+  d->sampleRate = sftable[rateIndex];
+  d->channels = (uchar(d->data[pos + 1]) >> 4) + 1;
+
+  if(samples > silence)
+    samples -= silence;
+  else
+    samples = 0;
+
+  d->length = int((samples + d->sampleRate / 2) / d->sampleRate);
+  d->bitrate = d->length > 0 ? ((d->streamLength * 8L) / d->length) / 1000 : 0;
+}
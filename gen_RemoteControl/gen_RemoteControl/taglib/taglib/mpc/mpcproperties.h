@@ -66,7 +66,7 @@ namespace TagLib {
       virtual int channels() const;
 
       /*!
-       * Returns the version of the bitstream (SV4-SV7)
+       * Returns the version of the bitstream (SV4-SV8)
        */
       int mpcVersion() const;
 
@@ -75,6 +75,7 @@ namespace TagLib {
       Properties &operator=(const Properties &);
 
       void read();
+      void readSV8();
 
       class PropertiesPrivate;
       PropertiesPrivate *d;
@@ -23,185 +23,262 @@
  *   http://www.mozilla.org/MPL/                                           *
  ***************************************************************************/
 
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <pthread.h>
+#endif
+
 #include "id3v1genres.h"
 
 using namespace TagLib;
 
-namespace TagLib {
-  namespace ID3v1 {
-
-    static const int genresSize = 148;
-    static const String genres[] = {
-      "Blues",
-      "Classic Rock",
-      "Country",
-      "Dance",
-      "Disco",
-      "Funk",
-      "Grunge",
-      "Hip-Hop",
-      "Jazz",
-      "Metal",
-      "New Age",
-      "Oldies",
-      "Other",
-      "Pop",
-      "R&B",
-      "Rap",
-      "Reggae",
-      "Rock",
-      "Techno",
-      "Industrial",
-      "Alternative",
-      "Ska",
-      "Death Metal",
-      "Pranks",
-      "Soundtrack",
-      "Euro-Techno",
-      "Ambient",
-      "Trip-Hop",
-      "Vocal",
-      "Jazz+Funk",
-      "Fusion",
-      "Trance",
-      "Classical",
-      "Instrumental",
-      "Acid",
-      "House",
-      "Game",
-      "Sound Clip",
-      "Gospel",
-      "Noise",
-      "Alternative Rock",
-      "Bass",
-      "Soul",
-      "Punk",
-      "Space",
-      "Meditative",
-      "Instrumental Pop",
-      "Instrumental Rock",
-      "Ethnic",
-      "Gothic",
-      "Darkwave",
-      "Techno-Industrial",
-      "Electronic",
-      "Pop-Folk",
-      "Eurodance",
-      "Dream",
-      "Southern Rock",
-      "Comedy",
-      "Cult",
-      "Gangsta",
-      "Top 40",
-      "Christian Rap",
-      "Pop/Funk",
-      "Jungle",
-      "Native American",
-      "Cabaret",
-      "New Wave",
-      "Psychedelic",
-      "Rave",
-      "Showtunes",
-      "Trailer",
-      "Lo-Fi",
-      "Tribal",
-      "Acid Punk",
-      "Acid Jazz",
-      "Polka",
-      "Retro",
-      "Musical",
-      "Rock & Roll",
-      "Hard Rock",
-      "Folk",
-      "Folk/Rock",
-      "National Folk",
-      "Swing",
-      "Fusion",
-      "Bebob",
-      "Latin",
-      "Revival",
-      "Celtic",
-      "Bluegrass",
-      "Avantgarde",
-      "Gothic Rock",
-      "Progressive Rock",
-      "Psychedelic Rock",
-      "Symphonic Rock",
-      "Slow Rock",
-      "Big Band",
-      "Chorus",
-      "Easy Listening",
-      "Acoustic",
-      "Humour",
-      "Speech",
-      "Chanson",
-      "Opera",
-      "Chamber Music",
-      "Sonata",
-      "Symphony",
-      "Booty Bass",
-      "Primus",
-      "Porn Groove",
-      "Satire",
-      "Slow Jam",
-      "Club",
-      "Tango",
-      "Samba",
-      "Folklore",
-      "Ballad",
-      "Power Ballad",
-      "Rhythmic Soul",
-      "Freestyle",
-      "Duet",
-      "Punk Rock",
-      "Drum Solo",
-      "A Cappella",
-      "Euro-House",
-      "Dance Hall",
-      "Goa",
-      "Drum & Bass",
-      "Club-House",
-      "Hardcore",
-      "Terror",
-      "Indie",
-      "BritPop",
-      "Negerpunk",
-      "Polsk Punk",
-      "Beat",
-      "Christian Gangsta Rap",
-      "Heavy Metal",
-      "Black Metal",
-      "Crossover",
-      "Contemporary Christian",
-      "Christian Rock",
-      "Merengue",
-      "Salsa",
-      "Thrash Metal",
-      "Anime",
-      "Jpop",
-      "Synthpop"
-    };
+namespace
+{
+  // The names are plain character arrays, they need no initialization.
+
+  const int genresSize = 148;
+  const char *const genres[] = {
+    "Blues",
+    "Classic Rock",
+    "Country",
+    "Dance",
+    "Disco",
+    "Funk",
+    "Grunge",
+    "Hip-Hop",
+    "Jazz",
+    "Metal",
+    "New Age",
+    "Oldies",
+    "Other",
+    "Pop",
+    "R&B",
+    "Rap",
+    "Reggae",
+    "Rock",
+    "Techno",
+    "Industrial",
+    "Alternative",
+    "Ska",
+    "Death Metal",
+    "Pranks",
+    "Soundtrack",
+    "Euro-Techno",
+    "Ambient",
+    "Trip-Hop",
+    "Vocal",
+    "Jazz+Funk",
+    "Fusion",
+    "Trance",
+    "Classical",
+    "Instrumental",
+    "Acid",
+    "House",
+    "Game",
+    "Sound Clip",
+    "Gospel",
+    "Noise",
+    "Alternative Rock",
+    "Bass",
+    "Soul",
+    "Punk",
+    "Space",
+    "Meditative",
+    "Instrumental Pop",
+    "Instrumental Rock",
+    "Ethnic",
+    "Gothic",
+    "Darkwave",
+    "Techno-Industrial",
+    "Electronic",
+    "Pop-Folk",
+    "Eurodance",
+    "Dream",
+    "Southern Rock",
+    "Comedy",
+    "Cult",
+    "Gangsta",
+    "Top 40",
+    "Christian Rap",
+    "Pop/Funk",
+    "Jungle",
+    "Native American",
+    "Cabaret",
+    "New Wave",
+    "Psychedelic",
+    "Rave",
+    "Showtunes",
+    "Trailer",
+    "Lo-Fi",
+    "Tribal",
+    "Acid Punk",
+    "Acid Jazz",
+    "Polka",
+    "Retro",
+    "Musical",
+    "Rock & Roll",
+    "Hard Rock",
+    "Folk",
+    "Folk/Rock",
+    "National Folk",
+    "Swing",
+    "Fusion",
+    "Bebob",
+    "Latin",
+    "Revival",
+    "Celtic",
+    "Bluegrass",
+    "Avantgarde",
+    "Gothic Rock",
+    "Progressive Rock",
+    "Psychedelic Rock",
+    "Symphonic Rock",
+    "Slow Rock",
+    "Big Band",
+    "Chorus",
+    "Easy Listening",
+    "Acoustic",
+    "Humour",
+    "Speech",
+    "Chanson",
+    "Opera",
+    "Chamber Music",
+    "Sonata",
+    "Symphony",
+    "Booty Bass",
+    "Primus",
+    "Porn Groove",
+    "Satire",
+    "Slow Jam",
+    "Club",
+    "Tango",
+    "Samba",
+    "Folklore",
+    "Ballad",
+    "Power Ballad",
+    "Rhythmic Soul",
+    "Freestyle",
+    "Duet",
+    "Punk Rock",
+    "Drum Solo",
+    "A Cappella",
+    "Euro-House",
+    "Dance Hall",
+    "Goa",
+    "Drum & Bass",
+    "Club-House",
+    "Hardcore",
+    "Terror",
+    "Indie",
+    "BritPop",
+    "Negerpunk",
+    "Polsk Punk",
+    "Beat",
+    "Christian Gangsta Rap",
+    "Heavy Metal",
+    "Black Metal",
+    "Crossover",
+    "Contemporary Christian",
+    "Christian Rock",
+    "Merengue",
+    "Salsa",
+    "Thrash Metal",
+    "Anime",
+    "Jpop",
+    "Synthpop"
+  };
+
+  // A perfect hash of the names for genreIndex(): the FNV-1a hash of a name
+  // picks one of the displacements, hashing once more with it gives the slot
+  // of the genre number.  255 marks the empty slots.  "Fusion" is in the list
+  // twice, its slot has the later number like genreMap().
+
+  const uchar genreDisplacements[32] = {
+      5,   0,   6,   0,   9,   2,   0,   1,  13,   3,   7,  37,   8,  28,  10,   0,
+      0,   3,  21,   5,   5,  11,   1,  35,   0,   7,   2,  10,   0,  11,   8,   0
+  };
+
+  const uchar genreSlots[256] = {
+     46, 255, 255, 117, 255, 255,   9, 113, 255, 118, 135, 255, 255,  50,  70,  17,
+    255, 255,  90, 255, 109,   1, 255, 255, 105, 112,  37,  47,  65,  40, 255, 255,
+     81,  12, 255, 255, 255, 255, 255, 133, 255, 255, 146,  87, 255, 255,  44,  35,
+    255, 255, 255,  79,  53, 255, 255, 255,  28,  61,  80,  63, 255, 116, 255,   2,
+    142,  67, 255,  94, 255,  36, 255, 255, 255,  59,  13, 255, 255, 255, 255, 255,
+    137, 106,   3, 255, 255,  14,   6,  16,   7,  20, 127,  66,  89,  86, 103,  10,
+     24, 255, 144,  34,  77, 255,  54, 120, 255, 132, 255, 255,  93,  52, 255,  74,
+    255, 255,   8, 114,  26, 255, 255, 107, 115,  78, 126,  92, 255, 255,   4, 255,
+    255, 129,  31, 255,  82, 128, 255, 255,  39,  19, 255, 255,  45,   5,  41, 255,
+     51,  29, 255,  42, 255, 255, 255, 255,  38,  73,  83, 255, 108, 255,  18, 255,
+     55, 123, 255,  85, 143, 255, 255, 255, 255, 255, 255, 130, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255,  98, 255, 255,  21, 255, 255, 255, 139, 255, 102,
+     56, 147,  48, 255,  23, 255, 255, 101,  25, 141, 255,  72,  11,  88, 255, 140,
+    125, 255,  84,  68,  57,  49, 121,  33, 136, 255, 255,  76,  62,  91,  43,  95,
+    145, 255, 134,  69, 124, 255, 138, 255,  97, 131,  15,  64, 100,  60, 119, 255,
+    110,  22,  32, 122,  99, 255, 255,  71, 111,  75,  58, 255,  96,   0, 104,  27
+  };
+
+  uint genreHash(const String &name)
+  {
+    uint hash = 2166136261U;
+    for(String::ConstIterator it = name.begin(); it != name.end(); ++it) {
+      hash ^= uint(*it);
+      hash *= 16777619U;
+    }
+    return hash;
   }
+
+  // The list and the map are created on the first call of genreList() or
+  // genreMap(), once even if several threads ask at the same time.  The
+  // pointers and the once flags need no construction.
+
+  StringList *genreListData = 0;
+  ID3v1::GenreMap *genreMapData = 0;
+
+  void createGenreTables()
+  {
+    genreListData = new StringList;
+    genreMapData = new ID3v1::GenreMap;
+    for(int i = 0; i < genresSize; i++) {
+      const String name = genres[i];
+      genreListData->append(name);
+      genreMapData->insert(name, i);
+    }
+  }
+
+#ifdef _WIN32
+  INIT_ONCE genreTablesOnce = INIT_ONCE_STATIC_INIT;
+
+  BOOL CALLBACK initGenreTables(PINIT_ONCE, PVOID, PVOID *)
+  {
+    createGenreTables();
+    return TRUE;
+  }
+
+  void loadGenreTables()
+  {
+    InitOnceExecuteOnce(&genreTablesOnce, initGenreTables, 0, 0);
+  }
+#else
+  pthread_once_t genreTablesOnce = PTHREAD_ONCE_INIT;
+
+  void loadGenreTables()
+  {
+    pthread_once(&genreTablesOnce, createGenreTables);
+  }
+#endif
 }
 
 StringList ID3v1::genreList()
 {
-  static StringList l;
-  if(l.isEmpty()) {
-    for(int i = 0; i < genresSize; i++)
-      l.append(genres[i]);
-  }
-  return l;
+  loadGenreTables();
+  return *genreListData;
 }
 
 ID3v1::GenreMap ID3v1::genreMap()
 {
-  static GenreMap m;
-  if(m.isEmpty()) {
-    for(int i = 0; i < genresSize; i++)
-      m.insert(genres[i], i);
-  }
-  return m;
+  loadGenreTables();
+  return *genreMapData;
 }
 
 String ID3v1::genre(int i)
@@ -213,7 +290,20 @@ String ID3v1::genre(int i)
 
 int ID3v1::genreIndex(const String &name)
 {
-  if(genreMap().contains(name))
-    return genreMap()[name];
-  return 255;
+  const uint hash = genreHash(name);
+  const uint slot = ((hash ^ genreDisplacements[hash % 32]) * 16777619U) >> 24;
+  const int index = genreSlots[slot];
+
+  if(index == 255)
+    return 255;
+
+  // The slot of an unknown name can hold any genre, compare the characters.
+
+  const char *s = genres[index];
+  for(String::ConstIterator it = name.begin(); it != name.end(); ++it, ++s) {
+    if(*s == 0 || uint(*it) != uint(uchar(*s)))
+      return 255;
+  }
+
+  return *s == 0 ? index : 255;
 }
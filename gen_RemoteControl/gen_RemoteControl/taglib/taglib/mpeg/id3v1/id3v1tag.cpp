@@ -90,6 +90,18 @@ ID3v1::Tag::Tag(File *file, long tagOffset) : TagLib::Tag()
   read();
 }
 
+ID3v1::Tag::Tag(File *file, long tagOffset, const ByteVector &data) : TagLib::Tag()
+{
+  d = new TagPrivate;
+  d->file = file;
+  d->tagOffset = tagOffset;
+
+  if(data.size() == 128 && data.startsWith("TAG"))
+    parse(data);
+  else
+    debug("ID3v1 tag is not valid or could not be read at the specified offset.");
+}
+
 ID3v1::Tag::~Tag()
 {
   delete d;
@@ -115,6 +115,12 @@ namespace TagLib {
        */
       Tag(File *file, long tagOffset);
 
+      /*!
+       * Create an ID3v1 tag from the 128 bytes \a data that have already been
+       * read from \a file at \a tagOffset.
+       */
+      Tag(File *file, long tagOffset, const ByteVector &data);
+
       /*!
        * Destroys this Tag instance.
        */
@@ -35,6 +35,7 @@
 
 #include <tdebug.h>
 #include <tstringlist.h>
+#include <tallocator.h>
 
 #include "id3v2frame.h"
 #include "id3v2synchdata.h"
@@ -42,7 +43,7 @@
 using namespace TagLib;
 using namespace ID3v2;
 
-class Frame::FramePrivate
+class Frame::FramePrivate : public SmallObject
 {
 public:
   FramePrivate() :
@@ -247,7 +248,7 @@ String::Type Frame::checkEncoding(const StringList &fields, String::Type encodin
 // Frame::Header class
 ////////////////////////////////////////////////////////////////////////////////
 
-class Frame::Header::HeaderPrivate
+class Frame::Header::HeaderPrivate : public SmallObject
 {
 public:
   HeaderPrivate() :
@@ -344,9 +345,10 @@ void Frame::Header::setData(const ByteVector &data, uint version)
       return;
     }
 
-    // Set the frame ID -- the first three bytes
+    // Set the frame ID -- the first three bytes.  Copied, a part of the tag
+    // data would keep all of it alive.
 
-    d->frameID = data.mid(0, 3);
+    d->frameID = ByteVector(data.data(), 3);
 
     // If the full header information was not passed in, do not continue to the
     // steps to parse the frame size and flags.
@@ -356,7 +358,7 @@ void Frame::Header::setData(const ByteVector &data, uint version)
       return;
     }
 
-    d->frameSize = data.mid(3, 3).toUInt();
+    d->frameSize = data.toUInt(3U, 3U, true);
 
     break;
   }
@@ -369,9 +371,9 @@ void Frame::Header::setData(const ByteVector &data, uint version)
       return;
     }
 
-    // Set the frame ID -- the first four bytes
+    // Set the frame ID -- the first four bytes, copied like above
 
-    d->frameID = data.mid(0, 4);
+    d->frameID = ByteVector(data.data(), 4);
 
     // If the full header information was not passed in, do not continue to the
     // steps to parse the frame size and flags.
@@ -384,7 +386,7 @@ void Frame::Header::setData(const ByteVector &data, uint version)
     // Set the size -- the frame size is the four bytes starting at byte four in
     // the frame header (structure 4)
 
-    d->frameSize = data.mid(4, 4).toUInt();
+    d->frameSize = data.toUInt(4U, true);
 
     { // read the first byte of flags
       std::bitset<8> flags(data[8]);
@@ -411,9 +413,9 @@ void Frame::Header::setData(const ByteVector &data, uint version)
       return;
     }
 
-    // Set the frame ID -- the first four bytes
+    // Set the frame ID -- the first four bytes, copied like above
 
-    d->frameID = data.mid(0, 4);
+    d->frameID = ByteVector(data.data(), 4);
 
     // If the full header information was not passed in, do not continue to the
     // steps to parse the frame size and flags.
@@ -431,7 +433,7 @@ void Frame::Header::setData(const ByteVector &data, uint version)
     // iTunes writes v2.4 tags with v2.3-like frame sizes
     if(d->frameSize > 127) {
       if(!isValidFrameID(data.mid(d->frameSize + 10, 4))) {
-        unsigned int uintSize = data.mid(4, 4).toUInt();
+        unsigned int uintSize = data.toUInt(4U, true);
         if(isValidFrameID(data.mid(uintSize + 10, 4))) {
           d->frameSize = uintSize;
         }
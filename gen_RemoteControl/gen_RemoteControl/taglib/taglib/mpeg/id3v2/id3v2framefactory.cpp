@@ -27,6 +27,12 @@
 #include <config.h>
 #endif
 
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <pthread.h>
+#endif
+
 #include <tdebug.h>
 
 #include "id3v2framefactory.h"
@@ -67,14 +73,163 @@ public:
 
 FrameFactory *FrameFactory::factory = 0;
 
+namespace
+{
+  // instance() creates the default factory once, even if several threads
+  // parse tags at the same time.  The flag needs no construction.
+
+#ifdef _WIN32
+  INIT_ONCE factoryOnce = INIT_ONCE_STATIC_INIT;
+#else
+  pthread_once_t factoryOnce = PTHREAD_ONCE_INIT;
+#endif
+
+  // frame IDs are uppercase Latin1 characters and digits
+  bool isValidFrameID(const ByteVector &frameID)
+  {
+    for(ByteVector::ConstIterator it = frameID.begin(); it != frameID.end(); it++) {
+      if( (*it < 'A' || *it > 'Z') && (*it < '1' || *it > '9') )
+        return false;
+    }
+    return true;
+  }
+
+  // The frame IDs are dispatched as one integer: the characters from the most
+  // significant byte on, the three character IDs of ID3v2.2 end with a zero
+  // byte.  FRAME_ID() gives the same value as a constant for the case labels.
+
+#define FRAME_ID(a, b, c, d) \
+  ((TagLib::uint(uchar(a)) << 24) | (TagLib::uint(uchar(b)) << 16) | (TagLib::uint(uchar(c)) << 8) | TagLib::uint(uchar(d)))
+
+  uint packFrameID(const ByteVector &frameID)
+  {
+    const uint size = frameID.size();
+    return FRAME_ID(size > 0 ? frameID[0] : 0, size > 1 ? frameID[1] : 0,
+                    size > 2 ? frameID[2] : 0, size > 3 ? frameID[3] : 0);
+  }
+
+  // The ID3v2.4 equivalents of the ID3v2.2 frames, sorted by the packed ID.
+  // Frames without an equivalent are discarded.
+
+  struct FrameConversion
+  {
+    uint from;
+    const char *to;
+  };
+
+  const FrameConversion v22Conversions[] = {
+    { FRAME_ID('B', 'U', 'F', 0), "RBUF" },
+    { FRAME_ID('C', 'N', 'T', 0), "PCNT" },
+    { FRAME_ID('C', 'O', 'M', 0), "COMM" },
+    { FRAME_ID('C', 'R', 'A', 0), "AENC" },
+    { FRAME_ID('C', 'R', 'M', 0), 0 },
+    { FRAME_ID('E', 'Q', 'U', 0), 0 },
+    { FRAME_ID('E', 'T', 'C', 0), "ETCO" },
+    { FRAME_ID('G', 'E', 'O', 0), "GEOB" },
+    { FRAME_ID('I', 'P', 'L', 0), "TIPL" },
+    { FRAME_ID('L', 'N', 'K', 0), 0 },
+    { FRAME_ID('M', 'C', 'I', 0), "MCDI" },
+    { FRAME_ID('M', 'L', 'L', 0), "MLLT" },
+    { FRAME_ID('P', 'O', 'P', 0), "POPM" },
+    { FRAME_ID('R', 'E', 'V', 0), "RVRB" },
+    { FRAME_ID('R', 'V', 'A', 0), 0 },
+    { FRAME_ID('S', 'L', 'T', 0), "SYLT" },
+    { FRAME_ID('S', 'T', 'C', 0), "SYTC" },
+    { FRAME_ID('T', 'A', 'L', 0), "TALB" },
+    { FRAME_ID('T', 'B', 'P', 0), "TBPM" },
+    { FRAME_ID('T', 'C', 'M', 0), "TCOM" },
+    { FRAME_ID('T', 'C', 'O', 0), "TCON" },
+    { FRAME_ID('T', 'C', 'R', 0), "TCOP" },
+    { FRAME_ID('T', 'D', 'A', 0), 0 },
+    { FRAME_ID('T', 'D', 'Y', 0), "TDLY" },
+    { FRAME_ID('T', 'E', 'N', 0), "TENC" },
+    { FRAME_ID('T', 'F', 'T', 0), "TFLT" },
+    { FRAME_ID('T', 'I', 'M', 0), 0 },
+    { FRAME_ID('T', 'K', 'E', 0), "TKEY" },
+    { FRAME_ID('T', 'L', 'A', 0), "TLAN" },
+    { FRAME_ID('T', 'L', 'E', 0), "TLEN" },
+    { FRAME_ID('T', 'M', 'T', 0), "TMED" },
+    { FRAME_ID('T', 'O', 'A', 0), "TOAL" },
+    { FRAME_ID('T', 'O', 'F', 0), "TOFN" },
+    { FRAME_ID('T', 'O', 'L', 0), "TOLY" },
+    { FRAME_ID('T', 'O', 'R', 0), "TDOR" },
+    { FRAME_ID('T', 'O', 'T', 0), "TOAL" },
+    { FRAME_ID('T', 'P', '1', 0), "TPE1" },
+    { FRAME_ID('T', 'P', '2', 0), "TPE2" },
+    { FRAME_ID('T', 'P', '3', 0), "TPE3" },
+    { FRAME_ID('T', 'P', '4', 0), "TPE4" },
+    { FRAME_ID('T', 'P', 'A', 0), "TPOS" },
+    { FRAME_ID('T', 'P', 'B', 0), "TPUB" },
+    { FRAME_ID('T', 'R', 'C', 0), "TSRC" },
+    { FRAME_ID('T', 'R', 'D', 0), "TDRC" },
+    { FRAME_ID('T', 'R', 'K', 0), "TRCK" },
+    { FRAME_ID('T', 'S', 'I', 0), 0 },
+    { FRAME_ID('T', 'S', 'S', 0), "TSSE" },
+    { FRAME_ID('T', 'T', '1', 0), "TIT1" },
+    { FRAME_ID('T', 'T', '2', 0), "TIT2" },
+    { FRAME_ID('T', 'T', '3', 0), "TIT3" },
+    { FRAME_ID('T', 'X', 'T', 0), "TOLY" },
+    { FRAME_ID('T', 'X', 'X', 0), "TXXX" },
+    { FRAME_ID('T', 'Y', 'E', 0), "TDRC" },
+    { FRAME_ID('U', 'F', 'I', 0), "UFID" },
+    { FRAME_ID('U', 'L', 'T', 0), "USLT" },
+    { FRAME_ID('W', 'A', 'F', 0), "WOAF" },
+    { FRAME_ID('W', 'A', 'R', 0), "WOAR" },
+    { FRAME_ID('W', 'A', 'S', 0), "WOAS" },
+    { FRAME_ID('W', 'C', 'M', 0), "WCOM" },
+    { FRAME_ID('W', 'C', 'P', 0), "WCOP" },
+    { FRAME_ID('W', 'P', 'B', 0), "WPUB" },
+    { FRAME_ID('W', 'X', 'X', 0), "WXXX" }
+  };
+
+  const FrameConversion *findV22Conversion(uint frameID)
+  {
+    uint first = 0;
+    uint last = sizeof(v22Conversions) / sizeof(v22Conversions[0]);
+
+    while(first < last) {
+      const uint middle = (first + last) / 2;
+      if(v22Conversions[middle].from < frameID)
+        first = middle + 1;
+      else
+        last = middle;
+    }
+
+    if(first < sizeof(v22Conversions) / sizeof(v22Conversions[0]) && v22Conversions[first].from == frameID)
+      return &v22Conversions[first];
+    return 0;
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // public members
 ////////////////////////////////////////////////////////////////////////////////
 
 FrameFactory *FrameFactory::instance()
 {
-  if(!factory)
-    factory = new FrameFactory;
+  // A local class may use the protected constructor.
+
+  struct Create
+  {
+#ifdef _WIN32
+    static BOOL CALLBACK run(PINIT_ONCE, PVOID, PVOID *)
+    {
+      factory = new FrameFactory;
+      return TRUE;
+    }
+#else
+    static void run()
+    {
+      factory = new FrameFactory;
+    }
+#endif
+  };
+
+#ifdef _WIN32
+  InitOnceExecuteOnce(&factoryOnce, Create::run, 0, 0);
+#else
+  pthread_once(&factoryOnce, Create::run);
+#endif
   return factory;
 }
 
@@ -108,11 +263,9 @@ Frame *FrameFactory::createFrame(const ByteVector &origData, Header *tagHeader)
     return 0;
   }
 
-  for(ByteVector::ConstIterator it = frameID.begin(); it != frameID.end(); it++) {
-    if( (*it < 'A' || *it > 'Z') && (*it < '1' || *it > '9') ) {
-      delete header;
-      return 0;
-    }
+  if(!isValidFrameID(frameID)) {
+    delete header;
+    return 0;
   }
 
   if(version > 3 && (tagHeader->unsynchronisation() || header->unsynchronisation())) {
@@ -147,29 +300,26 @@ Frame *FrameFactory::createFrame(const ByteVector &origData, Header *tagHeader)
   frameID = header->frameID();
 
   // This is where things get necissarily nasty.  Here we determine which
-  // Frame subclass (or if none is found simply an Frame) based
-  // on the frame ID.  Since there are a lot of possibilities, that means
-  // a lot of if blocks.
+  // Frame subclass (or if none is found simply an Frame) based on the frame
+  // ID.  The packed ID picks the subclass with a single switch.
 
-  // Text Identification (frames 4.2)
+  const uint id = packFrameID(frameID);
 
-  if(frameID.startsWith("T")) {
+  switch(id) {
 
-    TextIdentificationFrame *f = frameID != "TXXX"
-      ? new TextIdentificationFrame(data, header)
-      : new UserTextIdentificationFrame(data, header);
+  // Text Identification (frames 4.2)
 
+  case FRAME_ID('T', 'X', 'X', 'X'):
+  {
+    UserTextIdentificationFrame *f = new UserTextIdentificationFrame(data, header);
     d->setTextEncoding(f);
-
-    if(frameID == "TCON")
-      updateGenre(f);
-
     return f;
   }
 
   // Comments (frames 4.10)
 
-  if(frameID == "COMM") {
+  case FRAME_ID('C', 'O', 'M', 'M'):
+  {
     CommentsFrame *f = new CommentsFrame(data, header);
     d->setTextEncoding(f);
     return f;
@@ -177,7 +327,8 @@ Frame *FrameFactory::createFrame(const ByteVector &origData, Header *tagHeader)
 
   // Attached Picture (frames 4.14)
 
-  if(frameID == "APIC") {
+  case FRAME_ID('A', 'P', 'I', 'C'):
+  {
     AttachedPictureFrame *f = new AttachedPictureFrame(data, header);
     d->setTextEncoding(f);
     return f;
@@ -185,46 +336,45 @@ Frame *FrameFactory::createFrame(const ByteVector &origData, Header *tagHeader)
 
   // ID3v2.2 Attached Picture
 
-	if(frameID == "PIC") {
+  case FRAME_ID('P', 'I', 'C', 0):
+  {
     AttachedPictureFrame *f = new AttachedPictureFrameV22(data, header);
     d->setTextEncoding(f);
     return f;
   }
 
-	// Relative Volume Adjustment (frames 4.11)
+  // Relative Volume Adjustment (frames 4.11)
 
-  if(frameID == "RVA2")
+  case FRAME_ID('R', 'V', 'A', '2'):
     return new RelativeVolumeFrame(data, header);
 
   // Unique File Identifier (frames 4.1)
 
-  if(frameID == "UFID")
+  case FRAME_ID('U', 'F', 'I', 'D'):
     return new UniqueFileIdentifierFrame(data, header);
 
   // General Encapsulated Object (frames 4.15)
 
-  if(frameID == "GEOB") {
+  case FRAME_ID('G', 'E', 'O', 'B'):
+  {
     GeneralEncapsulatedObjectFrame *f = new GeneralEncapsulatedObjectFrame(data, header);
     d->setTextEncoding(f);
     return f;
   }
 
-  // URL link (frames 4.3)
+  // User defined URL link (frames 4.3.2)
 
-  if(frameID.startsWith("W")) {
-    if(frameID != "WXXX") {
-      return new UrlLinkFrame(data, header);
-    }
-    else {
-      UserUrlLinkFrame *f = new UserUrlLinkFrame(data, header);
-      d->setTextEncoding(f);
-      return f;
-    }
+  case FRAME_ID('W', 'X', 'X', 'X'):
+  {
+    UserUrlLinkFrame *f = new UserUrlLinkFrame(data, header);
+    d->setTextEncoding(f);
+    return f;
   }
 
   // Unsynchronized lyric/text transcription (frames 4.8)
 
-  if(frameID == "USLT") {
+  case FRAME_ID('U', 'S', 'L', 'T'):
+  {
     UnsynchronizedLyricsFrame *f = new UnsynchronizedLyricsFrame(data, header);
     if(d->useDefaultEncoding)
       f->setTextEncoding(d->defaultEncoding);
@@ -233,17 +383,63 @@ Frame *FrameFactory::createFrame(const ByteVector &origData, Header *tagHeader)
 
   // Popularimeter (frames 4.17)
 
-  if(frameID == "POPM")
+  case FRAME_ID('P', 'O', 'P', 'M'):
     return new PopularimeterFrame(data, header);
 
   // Private (frames 4.27)
 
-  if(frameID == "PRIV")
+  case FRAME_ID('P', 'R', 'I', 'V'):
     return new PrivateFrame(data, header);
+  }
+
+  // The other text identification (frames 4.2) and URL link (frames 4.3)
+  // frames share one class each.
+
+  if((id >> 24) == 'T') {
+    TextIdentificationFrame *f = new TextIdentificationFrame(data, header);
+
+    d->setTextEncoding(f);
+
+    if(id == FRAME_ID('T', 'C', 'O', 'N'))
+      updateGenre(f);
+
+    return f;
+  }
+
+  if((id >> 24) == 'W')
+    return new UrlLinkFrame(data, header);
 
   return new UnknownFrame(data, header);
 }
 
+ByteVector FrameFactory::frameID(const ByteVector &data, Header *tagHeader) const
+{
+  Frame::Header header(data, tagHeader->majorVersion());
+
+  // The same checks as in createFrame(), except for the frame size.
+
+  if(header.frameSize() <= uint(header.dataLengthIndicator() ? 4 : 0) ||
+     !isValidFrameID(header.frameID()))
+  {
+    return ByteVector::null;
+  }
+
+  // Encrypted and discarded frames become unknown frames with the ID they
+  // have.
+
+#if HAVE_ZLIB == 0
+  if(header.compression())
+    return header.frameID();
+#endif
+  if(header.encryption())
+    return header.frameID();
+
+  if(updateFrame(&header) && header.frameID() == "PIC")
+    return "APIC";
+
+  return header.frameID();
+}
+
 String::Type FrameFactory::defaultTextEncoding() const
 {
   return d->defaultEncoding;
@@ -271,104 +467,49 @@ FrameFactory::~FrameFactory()
 
 bool FrameFactory::updateFrame(Frame::Header *header) const
 {
-  TagLib::ByteVector frameID = header->frameID();
+  const uint frameID = packFrameID(header->frameID());
 
   switch(header->version()) {
 
   case 2: // ID3v2.2
   {
-    if(frameID == "CRM" ||
-       frameID == "EQU" ||
-       frameID == "LNK" ||
-       frameID == "RVA" ||
-       frameID == "TIM" ||
-       frameID == "TSI" ||
-       frameID == "TDA")
-    {
-      debug("ID3v2.4 no longer supports the frame type " + String(frameID) +
+    // ID3v2.2 only used 3 bytes for the frame ID, so we need to convert all of
+    // the frames to their 4 byte ID3v2.4 equivalent.
+
+    const FrameConversion *conversion = findV22Conversion(frameID);
+
+    if(conversion && !conversion->to) {
+      debug("ID3v2.4 no longer supports the frame type " + String(header->frameID()) +
             ".  It will be discarded from the tag.");
       return false;
     }
 
-    // ID3v2.2 only used 3 bytes for the frame ID, so we need to convert all of
-    // the frames to their 4 byte ID3v2.4 equivalent.
-
-    convertFrame("BUF", "RBUF", header);
-    convertFrame("CNT", "PCNT", header);
-    convertFrame("COM", "COMM", header);
-    convertFrame("CRA", "AENC", header);
-    convertFrame("ETC", "ETCO", header);
-    convertFrame("GEO", "GEOB", header);
-    convertFrame("IPL", "TIPL", header);
-    convertFrame("MCI", "MCDI", header);
-    convertFrame("MLL", "MLLT", header);
-    convertFrame("POP", "POPM", header);
-    convertFrame("REV", "RVRB", header);
-    convertFrame("SLT", "SYLT", header);
-    convertFrame("STC", "SYTC", header);
-    convertFrame("TAL", "TALB", header);
-    convertFrame("TBP", "TBPM", header);
-    convertFrame("TCM", "TCOM", header);
-    convertFrame("TCO", "TCON", header);
-    convertFrame("TCR", "TCOP", header);
-    convertFrame("TDY", "TDLY", header);
-    convertFrame("TEN", "TENC", header);
-    convertFrame("TFT", "TFLT", header);
-    convertFrame("TKE", "TKEY", header);
-    convertFrame("TLA", "TLAN", header);
-    convertFrame("TLE", "TLEN", header);
-    convertFrame("TMT", "TMED", header);
-    convertFrame("TOA", "TOAL", header);
-    convertFrame("TOF", "TOFN", header);
-    convertFrame("TOL", "TOLY", header);
-    convertFrame("TOR", "TDOR", header);
-    convertFrame("TOT", "TOAL", header);
-    convertFrame("TP1", "TPE1", header);
-    convertFrame("TP2", "TPE2", header);
-    convertFrame("TP3", "TPE3", header);
-    convertFrame("TP4", "TPE4", header);
-    convertFrame("TPA", "TPOS", header);
-    convertFrame("TPB", "TPUB", header);
-    convertFrame("TRC", "TSRC", header);
-    convertFrame("TRD", "TDRC", header);
-    convertFrame("TRK", "TRCK", header);
-    convertFrame("TSS", "TSSE", header);
-    convertFrame("TT1", "TIT1", header);
-    convertFrame("TT2", "TIT2", header);
-    convertFrame("TT3", "TIT3", header);
-    convertFrame("TXT", "TOLY", header);
-    convertFrame("TXX", "TXXX", header);
-    convertFrame("TYE", "TDRC", header);
-    convertFrame("UFI", "UFID", header);
-    convertFrame("ULT", "USLT", header);
-    convertFrame("WAF", "WOAF", header);
-    convertFrame("WAR", "WOAR", header);
-    convertFrame("WAS", "WOAS", header);
-    convertFrame("WCM", "WCOM", header);
-    convertFrame("WCP", "WCOP", header);
-    convertFrame("WPB", "WPUB", header);
-    convertFrame("WXX", "WXXX", header);
+    if(conversion)
+      header->setFrameID(conversion->to);
 
     break;
   }
 
   case 3: // ID3v2.3
   {
-    if(frameID == "EQUA" ||
-       frameID == "RVAD" ||
-       frameID == "TIME" ||
-       frameID == "TRDA" ||
-       frameID == "TSIZ" ||
-       frameID == "TDAT")
-    {
-      debug("ID3v2.4 no longer supports the frame type " + String(frameID) +
+    switch(frameID) {
+    case FRAME_ID('E', 'Q', 'U', 'A'):
+    case FRAME_ID('R', 'V', 'A', 'D'):
+    case FRAME_ID('T', 'I', 'M', 'E'):
+    case FRAME_ID('T', 'R', 'D', 'A'):
+    case FRAME_ID('T', 'S', 'I', 'Z'):
+    case FRAME_ID('T', 'D', 'A', 'T'):
+      debug("ID3v2.4 no longer supports the frame type " + String(header->frameID()) +
             ".  It will be discarded from the tag.");
       return false;
+    case FRAME_ID('T', 'O', 'R', 'Y'):
+      header->setFrameID("TDOR");
+      break;
+    case FRAME_ID('T', 'Y', 'E', 'R'):
+      header->setFrameID("TDRC");
+      break;
     }
 
-    convertFrame("TORY", "TDOR", header);
-    convertFrame("TYER", "TDRC", header);
-
     break;
   }
 
@@ -377,7 +518,8 @@ bool FrameFactory::updateFrame(Frame::Header *header) const
     // This should catch a typo that existed in TagLib up to and including
     // version 1.1 where TRDC was used for the year rather than TDRC.
 
-    convertFrame("TRDC", "TDRC", header);
+    if(frameID == FRAME_ID('T', 'R', 'D', 'C'))
+      header->setFrameID("TDRC");
     break;
   }
 
@@ -388,18 +530,6 @@ bool FrameFactory::updateFrame(Frame::Header *header) const
 // private members
 ////////////////////////////////////////////////////////////////////////////////
 
-void FrameFactory::convertFrame(const char *from, const char *to,
-                                Frame::Header *header) const
-{
-  if(header->frameID() != from)
-    return;
-
-  // debug("ID3v2.4 no longer supports the frame type " + String(from) + "  It has" +
-  //       "been converted to the type " + String(to) + ".");
-
-  header->setFrameID(to);
-}
-
 void FrameFactory::updateGenre(TextIdentificationFrame *frame) const
 {
   StringList fields = frame->fieldList();
@@ -431,3 +561,5 @@ void FrameFactory::updateGenre(TextIdentificationFrame *frame) const
   frame->setText(newfields);
 
 }
+
+#undef FRAME_ID
@@ -93,6 +93,15 @@ namespace TagLib {
       // BIC: make virtual
       Frame *createFrame(const ByteVector &data, Header *tagHeader) const;
 
+      /*!
+       * Returns the ID of the frame that createFrame() creates from \a data, after
+       * the conversion of older frame types, without creating it.  Only the frame
+       * header at the start of \a data is used, so the frame size isn't checked
+       * against the size of \a data.  Returns an empty ByteVector if createFrame()
+       * would fail.
+       */
+      ByteVector frameID(const ByteVector &data, Header *tagHeader) const;
+
       /*!
        * Returns the default text encoding for text frames.  If setTextEncoding()
        * has not been explicitly called this will only be used for new text
@@ -145,14 +154,6 @@ namespace TagLib {
       FrameFactory(const FrameFactory &);
       FrameFactory &operator=(const FrameFactory &);
 
-      /*!
-       * This method is used internally to convert a frame from ID \a from to ID
-       * \a to.  If the frame matches the \a from pattern and converts the frame
-       * ID in the \a header or simply does nothing if the frame ID does not match.
-       */
-      void convertFrame(const char *from, const char *to,
-                        Frame::Header *header) const;
-
       void updateGenre(TextIdentificationFrame *frame) const;
 
       static FrameFactory *factory;
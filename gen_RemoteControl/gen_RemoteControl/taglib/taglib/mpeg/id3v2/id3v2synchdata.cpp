@@ -24,6 +24,7 @@
  ***************************************************************************/
 
 #include <ostream>
+#include <string.h>
 
 #include "id3v2synchdata.h"
 
@@ -67,11 +68,47 @@ ByteVector SynchData::fromUInt(uint value)
 
 ByteVector SynchData::decode(const ByteVector &data)
 {
-  ByteVector result = data;
+  // Unsynchronisation puts a zero byte after every 0xFF that could be taken
+  // for a sync, so these are removed.  memchr() finds the 0xFF bytes and the
+  // data in between is copied in one piece.
 
-  ByteVector pattern(2, char(0));
-  pattern[0] = '\xFF';
-  pattern[1] = '\x00';
+  const char *begin = data.data();
+  const char *end = begin + data.size();
+  const char *in = begin;
 
-  return result.replace(pattern, '\xFF');
+  // Nothing to remove, the data is shared instead of copied.
+
+  for(;;) {
+    in = static_cast<const char *>(memchr(in, '\xFF', end - in));
+    if(!in || in + 1 >= end)
+      return data;
+    if(in[1] == '\x00')
+      break;
+    in++;
+  }
+
+  ByteVector result(data.size(), 0);
+  char *out = result.data();
+
+  // Everything up to the first 0xFF that is followed by a zero.
+
+  in++;
+  ::memcpy(out, begin, in - begin);
+  out += in - begin;
+  in++;
+
+  while(in < end) {
+    const char *next = static_cast<const char *>(memchr(in, '\xFF', end - in));
+    const char *stop = next ? next + 1 : end;
+
+    ::memcpy(out, in, stop - in);
+    out += stop - in;
+    in = stop;
+
+    if(in < end && *in == '\x00')
+      in++;
+  }
+
+  result.resize(out - result.data());
+  return result;
 }
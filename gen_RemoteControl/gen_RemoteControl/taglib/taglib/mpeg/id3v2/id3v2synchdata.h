@@ -59,7 +59,8 @@ namespace TagLib {
       TAGLIB_EXPORT ByteVector fromUInt(uint value);
 
       /*!
-       * Convert the data from unsynchronized data to its original format.
+       * Convert the data from unsynchronized data to its original format.  If
+       * there is nothing to convert \a input is returned without a copy.
        */
       TAGLIB_EXPORT ByteVector decode(const ByteVector &input);
     }
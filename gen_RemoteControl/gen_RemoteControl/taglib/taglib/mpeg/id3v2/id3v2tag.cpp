@@ -25,6 +25,9 @@
 
 #include <tfile.h>
 #include <tdebug.h>
+#include <tbytevectorlist.h>
+
+#include <string.h>
 
 #include "id3v2tag.h"
 #include "id3v2header.h"
@@ -40,10 +43,95 @@
 using namespace TagLib;
 using namespace ID3v2;
 
+namespace
+{
+  // fields of the Tag interface
+  enum BasicField {
+    TitleField   = TagLib::Tag::Title,
+    ArtistField  = TagLib::Tag::Artist,
+    AlbumField   = TagLib::Tag::Album,
+    CommentField = TagLib::Tag::Comment,
+    GenreField   = TagLib::Tag::Genre,
+    YearField    = TagLib::Tag::Year,
+    TrackField   = TagLib::Tag::Track,
+    AllBasicFields = TagLib::Tag::AllFields
+  };
+
+  // frames that hold the basic fields, by their ID3v2.4 ids
+  struct BasicFrame
+  {
+    const char *id;
+    int field;
+  };
+
+  const BasicFrame basicFrames[] = {
+    { "TIT2", TitleField },
+    { "TPE1", ArtistField },
+    { "TALB", AlbumField },
+    { "COMM", CommentField },
+    { "TCON", GenreField },
+    { "TDRC", YearField },
+    { "TRCK", TrackField }
+  };
+
+  // returns the basic field held by the frame, 0 for other frames
+  int basicField(const ByteVector &frameID)
+  {
+    for(uint i = 0; i < sizeof(basicFrames) / sizeof(basicFrames[0]); i++) {
+      if(frameID == basicFrames[i].id)
+        return basicFrames[i].field;
+    }
+    return 0;
+  }
+
+  // returns the genre of a TCON frame, the ID3v1 genre numbers replaced by
+  // their names
+
+  String genreOf(Frame *frame)
+  {
+    // TODO: In the next major version (TagLib 2.0) a list of multiple genres
+    // should be separated by " / " instead of " ".  For the moment to keep
+    // the behavior the same as released versions it is being left with " ".
+
+    TextIdentificationFrame *f = dynamic_cast<TextIdentificationFrame *>(frame);
+
+    if(!f)
+      return String::null;
+
+    // ID3v2.4 lists genres as the fields in its frames field list.  If the field
+    // is simply a number it can be assumed that it is an ID3v1 genre number.
+    // Here was assume that if an ID3v1 string is present that it should be
+    // appended to the genre string.  Multiple fields will be appended as the
+    // string is built.
+
+    StringList fields = f->fieldList();
+
+    StringList genres;
+
+    for(StringList::Iterator it = fields.begin(); it != fields.end(); ++it) {
+
+      if((*it).isEmpty())
+        continue;
+
+      bool ok;
+      int number = (*it).toInt(&ok);
+      if(ok && number >= 0 && number <= 255) {
+        *it = ID3v1::genre(number);
+      }
+
+      if(std::find(genres.begin(), genres.end(), *it) == genres.end())
+        genres.append(*it);
+    }
+
+    return genres.toString();
+  }
+}
+
 class ID3v2::Tag::TagPrivate
 {
 public:
-  TagPrivate() : file(0), tagOffset(-1), extendedHeader(0), footer(0), paddingSize(0)
+  TagPrivate() : file(0), tagOffset(-1), readMode(File::ReadAll), extendedHeader(0), footer(0), paddingSize(0),
+    pendingFrames(0)
   {
     frameList.setAutoDelete(true);
   }
@@ -55,6 +143,7 @@ public:
 
   File *file;
   long tagOffset;
+  int readMode;
   const FrameFactory *factory;
 
   Header header;
@@ -65,8 +154,131 @@ public:
 
   FrameListMap frameListMap;
   FrameList frameList;
+
+  // Frames are only created from the tag data when they are accessed.  The
+  // index holds every frame of the tag in the order of the tag.
+
+  struct IndexEntry
+  {
+    ByteVector frameID;
+    uint offset;
+    uint size;
+    Frame *frame;
+    bool created;
+  };
+
+  typedef List<IndexEntry> Index;
+
+  ByteVector frameData;
+  Index index;
+  uint pendingFrames;
+
+  Frame *createFrame(Index::Iterator entry);
+  void insertFrame(Index::Iterator entry);
+  void createFrames(const ByteVector &frameID);
+  void createBasicFrames(int fields);
+  void createAllFrames();
+  void forgetFrame(Frame *frame);
 };
 
+Frame *ID3v2::Tag::TagPrivate::createFrame(Index::Iterator entry)
+{
+  entry->created = true;
+  entry->frame = factory->createFrame(frameData.mid(entry->offset, entry->size), &header);
+  pendingFrames--;
+
+  if(entry->frame)
+    frameListMap[entry->frame->frameID()].append(entry->frame);
+
+  return entry->frame;
+}
+
+void ID3v2::Tag::TagPrivate::createFrames(const ByteVector &frameID)
+{
+  if(pendingFrames == 0)
+    return;
+
+  for(Index::Iterator it = index.begin(); it != index.end(); ++it) {
+    if(!it->created && it->frameID == frameID)
+      insertFrame(it);
+  }
+
+  if(pendingFrames == 0)
+    frameData = ByteVector::null;
+}
+
+void ID3v2::Tag::TagPrivate::insertFrame(Index::Iterator entry)
+{
+  Frame *frame = createFrame(entry);
+
+  if(!frame)
+    return;
+
+  // The frames of the tag stay in front of the added ones, in their order.
+
+  FrameList::Iterator position = frameList.begin();
+
+  for(Index::Iterator previous = entry; previous != index.begin();) {
+    --previous;
+    if(previous->frame) {
+      position = frameList.find(previous->frame);
+      ++position;
+      break;
+    }
+  }
+
+  frameList.insert(position, frame);
+}
+
+void ID3v2::Tag::TagPrivate::createBasicFrames(int fields)
+{
+  if(pendingFrames == 0)
+    return;
+
+  for(Index::Iterator it = index.begin(); it != index.end(); ++it) {
+    if(!it->created && (basicField(it->frameID) & fields) != 0)
+      insertFrame(it);
+  }
+
+  if(pendingFrames == 0)
+    frameData = ByteVector::null;
+}
+
+void ID3v2::Tag::TagPrivate::createAllFrames()
+{
+  if(pendingFrames == 0)
+    return;
+
+  FrameList::Iterator position = frameList.begin();
+
+  for(Index::Iterator it = index.begin(); it != index.end(); ++it) {
+    if(!it->created) {
+      Frame *frame = createFrame(it);
+      if(frame) {
+        position = frameList.insert(position, frame);
+        ++position;
+      }
+    }
+    else if(it->frame) {
+      while(*position != it->frame)
+        ++position;
+      ++position;
+    }
+  }
+
+  frameData = ByteVector::null;
+}
+
+void ID3v2::Tag::TagPrivate::forgetFrame(Frame *frame)
+{
+  for(Index::Iterator it = index.begin(); it != index.end(); ++it) {
+    if(it->frame == frame) {
+      it->frame = 0;
+      return;
+    }
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // public members
 ////////////////////////////////////////////////////////////////////////////////
@@ -89,6 +301,19 @@ ID3v2::Tag::Tag(File *file, long tagOffset, const FrameFactory *factory) :
   read();
 }
 
+ID3v2::Tag::Tag(File *file, long tagOffset, const FrameFactory *factory, int readMode) :
+  TagLib::Tag()
+{
+  d = new TagPrivate;
+
+  d->file = file;
+  d->tagOffset = tagOffset;
+  d->readMode = readMode;
+  d->factory = factory;
+
+  read();
+}
+
 ID3v2::Tag::~Tag()
 {
   delete d;
@@ -97,28 +322,31 @@ ID3v2::Tag::~Tag()
 
 String ID3v2::Tag::title() const
 {
-  if(!d->frameListMap["TIT2"].isEmpty())
-    return d->frameListMap["TIT2"].front()->toString();
+  const FrameList &frames = frameList("TIT2");
+  if(!frames.isEmpty())
+    return frames.front()->toString();
   return String::null;
 }
 
 String ID3v2::Tag::artist() const
 {
-  if(!d->frameListMap["TPE1"].isEmpty())
-    return d->frameListMap["TPE1"].front()->toString();
+  const FrameList &frames = frameList("TPE1");
+  if(!frames.isEmpty())
+    return frames.front()->toString();
   return String::null;
 }
 
 String ID3v2::Tag::album() const
 {
-  if(!d->frameListMap["TALB"].isEmpty())
-    return d->frameListMap["TALB"].front()->toString();
+  const FrameList &frames = frameList("TALB");
+  if(!frames.isEmpty())
+    return frames.front()->toString();
   return String::null;
 }
 
 String ID3v2::Tag::comment() const
 {
-  const FrameList &comments = d->frameListMap["COMM"];
+  const FrameList &comments = frameList("COMM");
 
   if(comments.isEmpty())
     return String::null;
@@ -136,58 +364,95 @@ String ID3v2::Tag::comment() const
 
 String ID3v2::Tag::genre() const
 {
-  // TODO: In the next major version (TagLib 2.0) a list of multiple genres
-  // should be separated by " / " instead of " ".  For the moment to keep
-  // the behavior the same as released versions it is being left with " ".
+  const FrameList &frames = frameList("TCON");
 
-  if(d->frameListMap["TCON"].isEmpty() ||
-     !dynamic_cast<TextIdentificationFrame *>(d->frameListMap["TCON"].front()))
-  {
+  if(frames.isEmpty())
     return String::null;
-  }
 
-  // ID3v2.4 lists genres as the fields in its frames field list.  If the field
-  // is simply a number it can be assumed that it is an ID3v1 genre number.
-  // Here was assume that if an ID3v1 string is present that it should be
-  // appended to the genre string.  Multiple fields will be appended as the
-  // string is built.
-
-  TextIdentificationFrame *f = static_cast<TextIdentificationFrame *>(
-    d->frameListMap["TCON"].front());
-
-  StringList fields = f->fieldList();
-
-  StringList genres;
-
-  for(StringList::Iterator it = fields.begin(); it != fields.end(); ++it) {
+  return genreOf(frames.front());
+}
 
-    if((*it).isEmpty())
+void ID3v2::Tag::readFields(TagFields &result, int fields) const
+{
+  d->createBasicFrames(fields);
+
+  // The first frame of a field wins like in the accessors, a comment without
+  // description wins over the other comments.
+
+  int missing = fields;
+  Frame *firstComment = 0;
+
+  for(FrameList::ConstIterator it = d->frameList.begin(); it != d->frameList.end() && missing != 0; ++it) {
+    const int field = basicField((*it)->frameID()) & missing;
+
+    switch(field) {
+    case TitleField:
+      result.title = (*it)->toString();
+      break;
+    case ArtistField:
+      result.artist = (*it)->toString();
+      break;
+    case AlbumField:
+      result.album = (*it)->toString();
+      break;
+    case CommentField:
+      {
+        CommentsFrame *frame = dynamic_cast<CommentsFrame *>(*it);
+
+        if(!frame || !frame->description().isEmpty()) {
+          if(!firstComment)
+            firstComment = *it;
+          continue;
+        }
+
+        result.comment = (*it)->toString();
+      }
+      break;
+    case GenreField:
+      result.genre = genreOf(*it);
+      break;
+    case YearField:
+      result.year = (*it)->toString().substr(0, 4).toInt();
+      break;
+    case TrackField:
+      result.track = (*it)->toString().toInt();
+      break;
+    default:
       continue;
-
-    bool ok;
-    int number = (*it).toInt(&ok);
-    if(ok && number >= 0 && number <= 255) {
-      *it = ID3v1::genre(number);
     }
 
-    if(std::find(genres.begin(), genres.end(), *it) == genres.end())
-      genres.append(*it);
+    missing &= ~field;
   }
 
-  return genres.toString();
+  if(missing & TitleField)
+    result.title = String::null;
+  if(missing & ArtistField)
+    result.artist = String::null;
+  if(missing & AlbumField)
+    result.album = String::null;
+  if(missing & CommentField)
+    result.comment = firstComment ? firstComment->toString() : String::null;
+  if(missing & GenreField)
+    result.genre = String::null;
+  if(missing & YearField)
+    result.year = 0;
+  if(missing & TrackField)
+    result.track = 0;
 }
 
 TagLib::uint ID3v2::Tag::year() const
 {
-  if(!d->frameListMap["TDRC"].isEmpty())
-    return d->frameListMap["TDRC"].front()->toString().substr(0, 4).toInt();
+  const FrameList &frames = frameList("TDRC");
+  if(!frames.isEmpty())
+    return frames.front()->toString().substr(0, 4).toInt();
   return 0;
 }
 
 TagLib::uint ID3v2::Tag::track() const
 {
-  if(!d->frameListMap["TRCK"].isEmpty())
-    return d->frameListMap["TRCK"].front()->toString().toInt();
+  const FrameList &frames = frameList("TRCK");
+  if(!frames.isEmpty())
+    return frames.front()->toString().toInt();
   return 0;
 }
 
@@ -213,8 +478,10 @@ void ID3v2::Tag::setComment(const String &s)
     return;
   }
 
-  if(!d->frameListMap["COMM"].isEmpty())
-    d->frameListMap["COMM"].front()->setText(s);
+  const FrameList &comments = frameList("COMM");
+
+  if(!comments.isEmpty())
+    comments.front()->setText(s);
   else {
     CommentsFrame *f = new CommentsFrame(d->factory->defaultTextEncoding());
     addFrame(f);
@@ -268,7 +535,7 @@ void ID3v2::Tag::setTrack(uint i)
 
 bool ID3v2::Tag::isEmpty() const
 {
-  return d->frameList.isEmpty();
+  return d->frameList.isEmpty() && d->pendingFrames == 0;
 }
 
 Header *ID3v2::Tag::header() const
@@ -288,21 +555,28 @@ Footer *ID3v2::Tag::footer() const
 
 const FrameListMap &ID3v2::Tag::frameListMap() const
 {
+  d->createAllFrames();
   return d->frameListMap;
 }
 
 const FrameList &ID3v2::Tag::frameList() const
 {
+  d->createAllFrames();
   return d->frameList;
 }
 
 const FrameList &ID3v2::Tag::frameList(const ByteVector &frameID) const
 {
+  d->createFrames(frameID);
   return d->frameListMap[frameID];
 }
 
 void ID3v2::Tag::addFrame(Frame *frame)
 {
+  // the frames of the tag with the same ID come first
+
+  d->createFrames(frame->frameID());
+
   d->frameList.append(frame);
   d->frameListMap[frame->frameID()].append(frame);
 }
@@ -317,6 +591,8 @@ void ID3v2::Tag::removeFrame(Frame *frame, bool del)
   it = d->frameListMap[frame->frameID()].find(frame);
   d->frameListMap[frame->frameID()].erase(it);
 
+  d->forgetFrame(frame);
+
   // ...and delete as desired
   if(del)
     delete frame;
@@ -324,7 +600,7 @@ void ID3v2::Tag::removeFrame(Frame *frame, bool del)
 
 void ID3v2::Tag::removeFrames(const ByteVector &id)
 {
-    FrameList l = d->frameListMap[id];
+    FrameList l = frameList(id);
     for(FrameList::Iterator it = l.begin(); it != l.end(); ++it)
       removeFrame(*it, true);
 }
@@ -335,12 +611,18 @@ ByteVector ID3v2::Tag::render() const
   // render in the tag's header.  The "tag data" -- everything that is included
   // in ID3v2::Header::tagSize() -- includes the extended header, frames and
   // padding, but does not include the tag's header or footer.
-
-  ByteVector tagData;
+  //
+  // The fields of every frame are rendered and measured in a first pass, the
+  // second one copies them behind their frame headers into a buffer of the
+  // final size.  Neither the frames nor the tag are put together from pieces.
 
   // TODO: Render the extended header.
 
-  // Loop through the frames rendering them and adding them to the tagData.
+  d->createAllFrames();
+
+  FrameList frames;
+  ByteVectorList fields;
+  uint framesSize = 0;
 
   for(FrameList::Iterator it = d->frameList.begin(); it != d->frameList.end(); it++) {
     if((*it)->header()->frameID().size() != 4) {
@@ -348,27 +630,57 @@ ByteVector ID3v2::Tag::render() const
           + String((*it)->header()->frameID()) + "\' has been discarded");
       continue;
     }
-    if(!(*it)->header()->tagAlterPreservation())
-      tagData.append((*it)->render());
+    if(!(*it)->header()->tagAlterPreservation()) {
+      ByteVector data = (*it)->renderFields();
+      (*it)->header()->setFrameSize(data.size());
+      frames.append(*it);
+      fields.append(data);
+      framesSize += Frame::headerSize() + data.size();
+    }
   }
 
-  // Compute the amount of padding, and append that to tagData.
+  // Compute the amount of padding.  The space of the old tag is kept as long as
+  // the frames fit into it, the file doesn't have to be rewritten then; a tag
+  // that has outgrown it reserves some more.
 
   uint paddingSize = 0;
   uint originalSize = d->header.tagSize();
 
-  if(tagData.size() < originalSize)
-    paddingSize = originalSize - tagData.size();
+  if(framesSize <= originalSize)
+    paddingSize = originalSize - framesSize;
   else
-    paddingSize = 1024;
-
-  tagData.append(ByteVector(paddingSize, char(0)));
+    paddingSize = TagLib::File::paddingSize();
 
   // Set the tag size.
-  d->header.setTagSize(tagData.size());
+  d->header.setTagSize(framesSize + paddingSize);
+
+  // The buffer starts out zeroed, the padding needs no copy.
+
+  ByteVector tag(Header::size() + framesSize + paddingSize, char(0));
+  char *p = tag.data();
+
+  const ByteVector header = d->header.render();
+  ::memcpy(p, header.data(), header.size());
+  p += header.size();
+
+  FrameList::ConstIterator frame = frames.begin();
+  for(ByteVectorList::ConstIterator it = fields.begin(); it != fields.end(); ++it, ++frame) {
+
+    // Frame::Header::render(): the id, the synch safe size and blank flags.
+
+    const uint size = (*it).size();
+
+    ::memcpy(p, (*frame)->header()->frameID().data(), 4);
+    for(int i = 0; i < 4; i++)
+      p[4 + i] = char(size >> ((3 - i) * 7) & 0x7f);
+    p += Frame::headerSize();
+
+    ::memcpy(p, (*it).data(), size);
+    p += size;
+  }
 
   // TODO: This should eventually include d->footer->render().
-  return d->header.render() + tagData;
+  return tag;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -399,6 +711,8 @@ void ID3v2::Tag::parse(const ByteVector &origData)
   if(d->header.unsynchronisation() && d->header.majorVersion() <= 3)
     data = SynchData::decode(data);
 
+  d->frameData = data;
+
   uint frameDataPosition = 0;
   uint frameDataLength = data.size();
 
@@ -423,10 +737,21 @@ void ID3v2::Tag::parse(const ByteVector &origData)
 
   // parse frames
 
+  const uint version = d->header.majorVersion();
+  const bool filtered = !(d->readMode & File::ReadAllFrames);
+  const bool readBasicFields = (d->readMode & File::ReadBasicFields) != 0;
+  const bool readPictures = (d->readMode & File::ReadPictures) != 0;
+  const bool readExtendedFields = (d->readMode & File::ReadExtendedFields) != 0;
+
+  // basic fields that have been found, the comment only counts once the one
+  // without a description is there
+
+  int foundFields = 0;
+
   // Make sure that there is at least enough room in the remaining frame data for
   // a frame header.
 
-  while(frameDataPosition < frameDataLength - Frame::headerSize(d->header.majorVersion())) {
+  while(frameDataPosition < frameDataLength - Frame::headerSize(version)) {
 
     // If the next data is position is 0, assume that we've hit the padding
     // portion of the frame data.
@@ -436,25 +761,62 @@ void ID3v2::Tag::parse(const ByteVector &origData)
         debug("Padding *and* a footer found.  This is not allowed by the spec.");
 
       d->paddingSize = frameDataLength - frameDataPosition;
-      return;
+      break;
     }
 
-    Frame *frame = d->factory->createFrame(data.mid(frameDataPosition),
-                                           &d->header);
+    // Only the frame header is read here, the frame is created when it is
+    // accessed.  Checks to make sure that the frame can be parsed.
 
-    if(!frame)
-      return;
+    const ByteVector headerData = data.mid(frameDataPosition, Frame::headerSize(version));
+    const ByteVector frameID = d->factory->frameID(headerData, &d->header);
+    const uint frameSize = Frame::Header(headerData, version).frameSize();
 
-    // Checks to make sure that frame parsed correctly.
+    if(frameID.isEmpty() || frameSize > data.size() - frameDataPosition)
+      break;
 
-    if(frame->size() <= 0) {
-      delete frame;
-      return;
-    }
+    const uint position = frameDataPosition;
+    frameDataPosition += frameSize + Frame::headerSize(version);
+
+    const int field = basicField(frameID);
+
+    if(filtered && !(readBasicFields && field) && !(readPictures && frameID == "APIC") &&
+       !(readExtendedFields && frameID != "APIC"))
+      continue;
 
-    frameDataPosition += frame->size() + Frame::headerSize(d->header.majorVersion());
-    addFrame(frame);
+    TagPrivate::IndexEntry entry;
+    entry.frameID = frameID;
+    entry.offset = position;
+    entry.size = frameSize + Frame::headerSize(version);
+    entry.frame = 0;
+    entry.created = false;
+
+    d->index.append(entry);
+    d->pendingFrames++;
+
+    if(filtered && !readPictures && !readExtendedFields) {
+      if(field != CommentField)
+        foundFields |= field;
+      else {
+
+        // The comment without a description is needed, so this one has to be
+        // created to see if it's the one.
+
+        Frame *frame = d->createFrame(--d->index.end());
+        if(frame) {
+          d->frameList.append(frame);
+          CommentsFrame *comment = dynamic_cast<CommentsFrame *>(frame);
+          if(comment && comment->description().isEmpty())
+            foundFields |= field;
+        }
+      }
+
+      if(foundFields == AllBasicFields)
+        break;
+    }
   }
+
+  if(d->pendingFrames == 0)
+    d->frameData = ByteVector::null;
 }
 
 void ID3v2::Tag::setTextFrame(const ByteVector &id, const String &value)
@@ -464,8 +826,10 @@ void ID3v2::Tag::setTextFrame(const ByteVector &id, const String &value)
     return;
   }
 
-  if(!d->frameListMap[id].isEmpty())
-    d->frameListMap[id].front()->setText(value);
+  const FrameList &frames = frameList(id);
+
+  if(!frames.isEmpty())
+    frames.front()->setText(value);
   else {
     const String::Type encoding = d->factory->defaultTextEncoding();
     TextIdentificationFrame *f = new TextIdentificationFrame(id, encoding);
@@ -127,6 +127,18 @@ namespace TagLib {
       Tag(File *file, long tagOffset,
           const FrameFactory *factory = FrameFactory::instance());
 
+      /*!
+       * Constructs an ID3v2 tag read from \a file starting at \a tagOffset
+       * that only contains the frames selected by \a readMode, a combination
+       * of File::ReadMode values.  The other frames are skipped by their size
+       * without being created, and parsing stops as soon as the basic fields
+       * have been found if nothing else was requested.  ReadExtendedFields
+       * keeps every frame but the pictures.
+       *
+       * \see File::ReadMode
+       */
+      Tag(File *file, long tagOffset, const FrameFactory *factory, int readMode);
+
       /*!
        * Destroys this Tag instance.
        */
@@ -142,6 +154,12 @@ namespace TagLib {
       virtual uint year() const;
       virtual uint track() const;
 
+      /*!
+       * Creates the frames of the requested fields in one walk of the frame
+       * index and takes the fields from one walk of the frame list.
+       */
+      virtual void readFields(TagFields &result, int fields = AllFields) const;
+
       virtual void setTitle(const String &s);
       virtual void setArtist(const String &s);
       virtual void setAlbum(const String &s);
@@ -202,6 +220,10 @@ namespace TagLib {
        *
        * \endcode
        *
+       * \note The frames of a tag that has been read from a file are only
+       * created when they are accessed.  This creates all of them, so use
+       * frameList(const ByteVector &) if only some types are needed.
+       *
        * \warning You should not modify this data structure directly, instead
        * use addFrame() and removeFrame().
        *
@@ -230,6 +252,9 @@ namespace TagLib {
        * frameListMap()[frameID];
        * \endcode
        *
+       * except that only the frames with the id \a frameID are created, the
+       * others stay unparsed until they are accessed.
+       *
        * \see frameListMap()
        */
       const FrameList &frameList(const ByteVector &frameID) const;
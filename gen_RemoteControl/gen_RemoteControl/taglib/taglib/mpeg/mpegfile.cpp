@@ -28,10 +28,20 @@
 #include <id3v2header.h>
 #include <id3v1tag.h>
 #include <apefooter.h>
+#include <apetrailer.h>
 #include <apetag.h>
 #include <tdebug.h>
+#include <tfilestream.h>
 
-#include <bitset>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+# include <emmintrin.h>
+# define MPEG_SYNCH_SSE2
+#endif
+#ifdef _MSC_VER
+# include <intrin.h>
+#endif
 
 #include "mpegfile.h"
 #include "mpegheader.h"
@@ -41,6 +51,122 @@ using namespace TagLib;
 namespace
 {
   enum { ID3v2Index = 0, APEIndex = 1, ID3v1Index = 2 };
+
+  // The valid second bytes of a frame synch, one bit per byte value: the last
+  // three bits of the synch, 111xxxxx, but not 0xff.
+
+  const TagLib::uint secondSynchBits[8] = { 0, 0, 0, 0, 0, 0, 0, 0x7fffffff };
+
+  inline bool isSecondSynchByte(uchar byte)
+  {
+    return (secondSynchBits[byte >> 5] >> (byte & 31)) & 1;
+  }
+
+#ifdef MPEG_SYNCH_SSE2
+
+  inline TagLib::uint lowestBit(TagLib::uint mask)
+  {
+#ifdef _MSC_VER
+    unsigned long bit;
+    _BitScanForward(&bit, mask);
+    return bit;
+#else
+    return __builtin_ctz(mask);
+#endif
+  }
+
+  inline TagLib::uint highestBit(TagLib::uint mask)
+  {
+#ifdef _MSC_VER
+    unsigned long bit;
+    _BitScanReverse(&bit, mask);
+    return bit;
+#else
+    return 31 - __builtin_clz(mask);
+#endif
+  }
+
+  // One bit for every 0xff byte of the 32 bytes at data.
+
+  inline TagLib::uint synchMask(const char *data)
+  {
+    const __m128i ff = _mm_set1_epi8(char(0xff));
+    const __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+    const __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16));
+
+    return TagLib::uint(_mm_movemask_epi8(_mm_cmpeq_epi8(low, ff)))
+      | TagLib::uint(_mm_movemask_epi8(_mm_cmpeq_epi8(high, ff))) << 16;
+  }
+
+#endif
+
+  // Returns the offset of the first frame synch in the size bytes at data, a
+  // 0xff followed by a valid second byte, or -1.  32 bytes are compared at
+  // once, only their 0xff bytes are looked at one by one.
+
+  int findSynch(const char *data, TagLib::uint size)
+  {
+    if(size < 2)
+      return -1;
+
+    // The second byte of a synch at the last candidate is still in the data.
+
+    const TagLib::uint candidates = size - 1;
+    TagLib::uint i = 0;
+
+#ifdef MPEG_SYNCH_SSE2
+    for(; i + 32 <= candidates; i += 32) {
+      for(TagLib::uint mask = synchMask(data + i); mask != 0; mask &= mask - 1) {
+        const TagLib::uint offset = i + lowestBit(mask);
+        if(isSecondSynchByte(uchar(data[offset + 1])))
+          return offset;
+      }
+    }
+#endif
+
+    while(i < candidates) {
+      const char *p = static_cast<const char *>(::memchr(data + i, 0xff, candidates - i));
+      if(!p)
+        return -1;
+
+      i = TagLib::uint(p - data);
+      if(isSecondSynchByte(uchar(data[i + 1])))
+        return i;
+      i++;
+    }
+
+    return -1;
+  }
+
+  // Like findSynch(), but returns the last frame synch.
+
+  int rfindSynch(const char *data, TagLib::uint size)
+  {
+    if(size < 2)
+      return -1;
+
+    TagLib::uint end = size - 1;
+
+#ifdef MPEG_SYNCH_SSE2
+    for(; end >= 32; end -= 32) {
+      const TagLib::uint start = end - 32;
+      TagLib::uint mask = synchMask(data + start);
+      while(mask != 0) {
+        const TagLib::uint bit = highestBit(mask);
+        if(isSecondSynchByte(uchar(data[start + bit + 1])))
+          return start + bit;
+        mask &= ~(1U << bit);
+      }
+    }
+#endif
+
+    for(int i = int(end) - 1; i >= 0; i--) {
+      if(uchar(data[i]) == 0xff && isSecondSynchByte(uchar(data[i + 1])))
+        return i;
+    }
+
+    return -1;
+  }
 }
 
 class MPEG::File::FilePrivate
@@ -57,6 +183,7 @@ public:
     hasID3v2(false),
     hasID3v1(false),
     hasAPE(false),
+    readMode(TagLib::File::ReadAll),
     properties(0)
   {
 
@@ -87,6 +214,8 @@ public:
   bool hasID3v1;
   bool hasAPE;
 
+  int readMode;
+
   Properties *properties;
 };
 
@@ -103,6 +232,15 @@ MPEG::File::File(FileName file, bool readProperties,
     read(readProperties, propertiesStyle);
 }
 
+MPEG::File::File(IOStream *stream, bool readProperties,
+                 Properties::ReadStyle propertiesStyle) : TagLib::File(stream)
+{
+  d = new FilePrivate;
+
+  if(isOpen())
+    read(readProperties, propertiesStyle);
+}
+
 MPEG::File::File(FileName file, ID3v2::FrameFactory *frameFactory,
                  bool readProperties, Properties::ReadStyle propertiesStyle) :
   TagLib::File(file)
@@ -113,6 +251,36 @@ MPEG::File::File(FileName file, ID3v2::FrameFactory *frameFactory,
     read(readProperties, propertiesStyle);
 }
 
+MPEG::File::File(IOStream *stream, ID3v2::FrameFactory *frameFactory,
+                 bool readProperties, Properties::ReadStyle propertiesStyle) :
+  TagLib::File(stream)
+{
+  d = new FilePrivate(frameFactory);
+
+  if(isOpen())
+    read(readProperties, propertiesStyle);
+}
+
+MPEG::File::File(FileName file, int readMode,
+                 Properties::ReadStyle propertiesStyle) : TagLib::File(file)
+{
+  d = new FilePrivate;
+  d->readMode = readMode;
+
+  if(isOpen())
+    read((readMode & ReadAudioProperties) != 0, propertiesStyle);
+}
+
+MPEG::File::File(IOStream *stream, int readMode,
+                 Properties::ReadStyle propertiesStyle) : TagLib::File(stream)
+{
+  d = new FilePrivate;
+  d->readMode = readMode;
+
+  if(isOpen())
+    read((readMode & ReadAudioProperties) != 0, propertiesStyle);
+}
+
 MPEG::File::~File()
 {
   delete d;
@@ -140,6 +308,11 @@ bool MPEG::File::save(int tags)
 
 bool MPEG::File::save(int tags, bool stripOthers)
 {
+  if(!(d->readMode & ReadAllFrames)) {
+    debug("MPEG::File::save() -- The file has not been read completely.");
+    return false;
+  }
+
   if(tags == NoTags && stripOthers)
     return strip(AllTags);
 
@@ -178,15 +351,9 @@ bool MPEG::File::save(int tags, bool stripOthers)
 
       d->hasID3v2 = true;
 
-      // v1 tag location has changed, update if it exists
-
-      if(ID3v1Tag())
-        d->ID3v1Location = findID3v1();
+      // v1 and APE tag locations have changed, update them if they exist
 
-      // APE tag location has changed, update if it exists
-
-      if(APETag())
-	findAPE();
+      findTrailer();
     }
     else if(stripOthers)
       success = strip(ID3v2, false) && success;
@@ -200,7 +367,7 @@ bool MPEG::File::save(int tags, bool stripOthers)
       seek(offset, End);
       writeBlock(ID3v1Tag()->render());
       d->hasID3v1 = true;
-      d->ID3v1Location = findID3v1();
+      findTrailer();
     }
     else if(stripOthers)
       success = strip(ID3v1) && success;
@@ -275,15 +442,9 @@ bool MPEG::File::strip(int tags, bool freeMemory)
     if(freeMemory)
       d->tag.set(ID3v2Index, 0);
 
-    // v1 tag location has changed, update if it exists
-
-    if(ID3v1Tag())
-      d->ID3v1Location = findID3v1();
+    // v1 and APE tag locations have changed, update them if they exist
 
-    // APE tag location has changed, update if it exists
-
-   if(APETag())
-      findAPE();
+    findTrailer();
   }
 
   if((tags & ID3v1) && d->hasID3v1) {
@@ -319,41 +480,52 @@ void MPEG::File::setID3v2FrameFactory(const ID3v2::FrameFactory *factory)
 
 long MPEG::File::nextFrameOffset(long position)
 {
+  // The blocks are read one after another without seeking in between.  Like
+  // File::find() the first one is small, most files have their first frame
+  // right behind the tag, and they double up to the scan buffer size.
+
   bool foundLastSyncPattern = false;
+  uint readSize = bufferSize();
 
-  ByteVector buffer;
+  seek(position);
 
   while(true) {
-    seek(position);
-    buffer = readBlock(bufferSize());
+    const ByteVector buffer = readBlock(readSize);
 
-    if(buffer.size() <= 0)
+    if(buffer.size() <= 0) {
+      clear();
       return -1;
+    }
 
     if(foundLastSyncPattern && secondSynchByte(buffer[0]))
       return position - 1;
 
-    for(uint i = 0; i < buffer.size() - 1; i++) {
-      if(uchar(buffer[i]) == 0xff && secondSynchByte(buffer[i + 1]))
-        return position + i;
-    }
+    const int offset = findSynch(buffer.data(), buffer.size());
+    if(offset >= 0)
+      return position + offset;
 
     foundLastSyncPattern = uchar(buffer[buffer.size() - 1]) == 0xff;
     position += buffer.size();
+
+    if(readSize < FileStream::scanBufferSize())
+      readSize = readSize * 2 < FileStream::scanBufferSize() ? readSize * 2 : FileStream::scanBufferSize();
   }
 }
 
 long MPEG::File::previousFrameOffset(long position)
 {
+  // Going backwards every block needs a seek, the blocks grow as in
+  // nextFrameOffset() to need fewer of them.
+
   bool foundFirstSyncPattern = false;
-  ByteVector buffer;
+  uint readSize = bufferSize();
 
   while (position > 0) {
-    long size = ulong(position) < bufferSize() ? position : bufferSize();
+    long size = ulong(position) < readSize ? position : readSize;
     position -= size;
 
     seek(position);
-    buffer = readBlock(size);
+    const ByteVector buffer = readBlock(size);
 
     if(buffer.size() <= 0)
       break;
@@ -361,12 +533,14 @@ long MPEG::File::previousFrameOffset(long position)
     if(foundFirstSyncPattern && uchar(buffer[buffer.size() - 1]) == 0xff)
       return position + buffer.size() - 1;
 
-    for(int i = buffer.size() - 2; i >= 0; i--) {
-      if(uchar(buffer[i]) == 0xff && secondSynchByte(buffer[i + 1]))
-        return position + i;
-    }
+    const int offset = rfindSynch(buffer.data(), buffer.size());
+    if(offset >= 0)
+      return position + offset;
 
     foundFirstSyncPattern = secondSynchByte(buffer[0]);
+
+    if(readSize < FileStream::scanBufferSize())
+      readSize = readSize * 2 < FileStream::scanBufferSize() ? readSize * 2 : FileStream::scanBufferSize();
   }
   return -1;
 }
@@ -375,7 +549,10 @@ long MPEG::File::firstFrameOffset()
 {
   long position = 0;
 
-  if(ID3v2Tag())
+  // The default tag exists in every file once it is read, only a tag that has
+  // been found in the file counts.
+
+  if(d->hasID3v2 && d->ID3v2Location >= 0)
     position = d->ID3v2Location + ID3v2Tag()->header()->completeTagSize();
 
   return nextFrameOffset(position);
@@ -383,7 +560,7 @@ long MPEG::File::firstFrameOffset()
 
 long MPEG::File::lastFrameOffset()
 {
-  return previousFrameOffset(ID3v1Tag() ? d->ID3v1Location - 1 : length());
+  return previousFrameOffset(streamEndOffset());
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -398,7 +575,7 @@ void MPEG::File::read(bool readProperties, Properties::ReadStyle propertiesStyle
 
   if(d->ID3v2Location >= 0) {
 
-    d->tag.set(ID3v2Index, new ID3v2::Tag(this, d->ID3v2Location, d->ID3v2FrameFactory));
+    d->tag.set(ID3v2Index, new ID3v2::Tag(this, d->ID3v2Location, d->ID3v2FrameFactory, d->readMode));
 
     d->ID3v2OriginalSize = ID3v2Tag()->header()->completeTagSize();
 
@@ -408,24 +585,29 @@ void MPEG::File::read(bool readProperties, Properties::ReadStyle propertiesStyle
       d->hasID3v2 = true;
   }
 
-  // Look for an ID3v1 tag
+  // The other tags only hold basic fields, the APE tag also the extended ones
 
-  d->ID3v1Location = findID3v1();
+  const bool readOtherTags = (d->readMode & (ReadBasicFields | ReadExtendedFields | ReadAllFrames)) != 0;
 
-  if(d->ID3v1Location >= 0) {
-    d->tag.set(ID3v1Index, new ID3v1::Tag(this, d->ID3v1Location));
-    d->hasID3v1 = true;
-  }
+  // Look for an ID3v1 and an APE tag, the end of the file is read once
 
-  // Look for an APE tag
+  if(readOtherTags) {
+    const APE::Trailer trailer(this);
 
-  findAPE();
+    d->ID3v1Location = trailer.ID3v1Location();
+    d->APELocation = trailer.APELocation();
+    d->APEFooterLocation = trailer.APEFooterLocation();
 
-  if(d->APELocation >= 0) {
+    if(d->ID3v1Location >= 0) {
+      d->tag.set(ID3v1Index, new ID3v1::Tag(this, d->ID3v1Location, trailer.ID3v1Data()));
+      d->hasID3v1 = true;
+    }
 
-    d->tag.set(APEIndex, new APE::Tag(this, d->APEFooterLocation));
-    d->APEOriginalSize = APETag()->footer()->completeTagSize();
-    d->hasAPE = true;
+    if(d->APELocation >= 0) {
+      d->tag.set(APEIndex, new APE::Tag(this, d->APEFooterLocation, trailer.APEFooterData()));
+      d->APEOriginalSize = APETag()->footer()->completeTagSize();
+      d->hasAPE = true;
+    }
   }
 
   if(readProperties)
@@ -437,6 +619,22 @@ void MPEG::File::read(bool readProperties, Properties::ReadStyle propertiesStyle
   ID3v1Tag(true);
 }
 
+long MPEG::File::streamEndOffset()
+{
+  // The tags at the end aren't looked for by the partial read modes, their few
+  // bytes are counted as audio then.
+
+  long end = length();
+
+  if(d->hasID3v1 && d->ID3v1Location >= 0)
+    end = d->ID3v1Location;
+
+  if(d->hasAPE && d->APELocation >= 0 && d->APELocation < end)
+    end = d->APELocation;
+
+  return end;
+}
+
 long MPEG::File::findID3v2()
 {
   // This method is based on the contents of TagLib::File::find(), but because
@@ -548,46 +746,16 @@ long MPEG::File::findID3v2()
   return -1;
 }
 
-long MPEG::File::findID3v1()
-{
-  if(isValid()) {
-    seek(-128, End);
-    long p = tell();
-
-    if(readBlock(3) == ID3v1::Tag::fileIdentifier())
-      return p;
-  }
-  return -1;
-}
-
-void MPEG::File::findAPE()
+void MPEG::File::findTrailer()
 {
-  if(isValid()) {
-    seek(d->hasID3v1 ? -160 : -32, End);
-
-    long p = tell();
-
-    if(readBlock(8) == APE::Tag::fileIdentifier()) {
-      d->APEFooterLocation = p;
-      seek(d->APEFooterLocation);
-      APE::Footer footer(readBlock(APE::Footer::size()));
-      d->APELocation = d->APEFooterLocation - footer.completeTagSize()
-	+ APE::Footer::size();
-      return;
-    }
-  }
+  const APE::Trailer trailer(this);
 
-  d->APELocation = -1;
-  d->APEFooterLocation = -1;
+  d->ID3v1Location = trailer.ID3v1Location();
+  d->APELocation = trailer.APELocation();
+  d->APEFooterLocation = trailer.APEFooterLocation();
 }
 
 bool MPEG::File::secondSynchByte(char byte)
 {
-  if(uchar(byte) == 0xff)
-    return false;
-
-  std::bitset<8> b(byte);
-
-  // check to see if the byte matches 111xxxxx
-  return b.test(7) && b.test(6) && b.test(5);
+  return isSecondSynchByte(uchar(byte));
 }
@@ -80,6 +80,17 @@ namespace TagLib {
       File(FileName file, bool readProperties = true,
            Properties::ReadStyle propertiesStyle = Properties::Average);
 
+      /*!
+       * Contructs an MPEG file from \a stream.  If \a readProperties is true the
+       * file's audio properties will also be read using \a propertiesStyle.  If
+       * false, \a propertiesStyle is ignored.
+       *
+       * The stream is not owned by the file, it has to stay valid until the
+       * file is destroyed.
+       */
+      File(IOStream *stream, bool readProperties = true,
+           Properties::ReadStyle propertiesStyle = Properties::Average);
+
       /*!
        * Contructs an MPEG file from \a file.  If \a readProperties is true the
        * file's audio properties will also be read using \a propertiesStyle.  If
@@ -91,6 +102,41 @@ namespace TagLib {
            bool readProperties = true,
            Properties::ReadStyle propertiesStyle = Properties::Average);
 
+      /*!
+       * Contructs an MPEG file from \a stream.  If \a readProperties is true the
+       * file's audio properties will also be read using \a propertiesStyle.  If
+       * false, \a propertiesStyle is ignored.  The frames will be created using
+       * \a frameFactory.
+       *
+       * The stream is not owned by the file, it has to stay valid until the
+       * file is destroyed.
+       */
+      // BIC: merge with the above constructor
+      File(IOStream *stream, ID3v2::FrameFactory *frameFactory,
+           bool readProperties = true,
+           Properties::ReadStyle propertiesStyle = Properties::Average);
+
+      /*!
+       * Contructs an MPEG file from \a file that only reads the parts given by
+       * \a readMode, a combination of TagLib::File::ReadMode values.  The audio
+       * properties are read using \a propertiesStyle if requested.  The ID3v1
+       * and APE tags are only read for the basic or the extended fields.
+       *
+       * \note A file that has been read without ReadAllFrames can't be saved.
+       */
+      File(FileName file, int readMode,
+           Properties::ReadStyle propertiesStyle = Properties::Average);
+
+      /*!
+       * Contructs an MPEG file from \a stream that only reads the parts given
+       * by \a readMode, see the constructor above.
+       *
+       * The stream is not owned by the file, it has to stay valid until the
+       * file is destroyed.
+       */
+      File(IOStream *stream, int readMode,
+           Properties::ReadStyle propertiesStyle = Properties::Average);
+
       /*!
        * Destroys this instance of the File.
        */
@@ -253,13 +299,20 @@ namespace TagLib {
       long lastFrameOffset();
 
     private:
+      friend class Properties;
+
       File(const File &);
       File &operator=(const File &);
 
       void read(bool readProperties, Properties::ReadStyle propertiesStyle);
       long findID3v2();
-      long findID3v1();
-      void findAPE();
+      void findTrailer();
+
+      /*!
+       * Returns the position in the file behind the last MPEG frame, which is
+       * the start of an APE or ID3v1 tag at the end of the file or its length.
+       */
+      long streamEndOffset();
 
       /*!
        * MPEG frames can be recognized by the bit pattern 11111111 111, so the
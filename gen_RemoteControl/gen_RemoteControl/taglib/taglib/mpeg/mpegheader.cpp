@@ -252,12 +252,15 @@ void MPEG::Header::parse(const ByteVector &data)
   d->isCopyrighted = flags[3];
   d->isPadded = flags[9];
 
-  // Calculate the frame length
+  // Calculate the frame length, layer I frames are made of 4 byte slots and
+  // the layer III frames of MPEG 2 and 2.5 only hold half the samples
 
   if(d->layer == 1)
-    d->frameLength = 24000 * 2 * d->bitrate / d->sampleRate + int(d->isPadded);
-  else
+    d->frameLength = (12000 * d->bitrate / d->sampleRate + int(d->isPadded)) * 4;
+  else if(d->layer == 3 && d->version != Version1)
     d->frameLength = 72000 * d->bitrate / d->sampleRate + int(d->isPadded);
+  else
+    d->frameLength = 144000 * d->bitrate / d->sampleRate + int(d->isPadded);
 
   // Samples per frame
 
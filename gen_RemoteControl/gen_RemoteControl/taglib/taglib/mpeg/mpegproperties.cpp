@@ -23,6 +23,8 @@
  *   http://www.mozilla.org/MPL/                                           *
  ***************************************************************************/
 
+#include <map>
+
 #include <tdebug.h>
 #include <tstring.h>
 
@@ -32,6 +34,43 @@
 
 using namespace TagLib;
 
+namespace
+{
+  // Bytes read at the first frame, enough for a Xing header with the seek table
+  // and the LAME extension and for a VBRI header.
+
+  enum { FirstFrameLength = 256 };
+
+  // Frames sampled by the Average style in streams without a VBR header and the
+  // bytes read at each sampling point.
+
+  enum { SamplingPoints = 5, SamplingLength = 4096 };
+
+  // Bytes read at once while the Accurate style walks the frames.
+
+  enum { ScanBufferLength = 65536 };
+
+  // Entries of the seek table of the Accurate style.
+
+  enum { MaxSeekPoints = 256 };
+
+  inline bool isFrameSync(const ByteVector &data, uint offset)
+  {
+    return uchar(data[offset]) == 0xff && (uchar(data[offset + 1]) & 0xe0) == 0xe0;
+  }
+
+  // A frame of the same stream as the first one, other frame syncs are most
+  // likely part of the audio data.
+
+  inline bool isSameStream(const MPEG::Header &header, const MPEG::Header &first)
+  {
+    return header.isValid() && header.frameLength() > 0 &&
+      header.version() == first.version() &&
+      header.layer() == first.layer() &&
+      header.sampleRate() == first.sampleRate();
+  }
+}
+
 class MPEG::Properties::PropertiesPrivate
 {
 public:
@@ -40,6 +79,10 @@ public:
     xingHeader(0),
     style(s),
     length(0),
+    lengthInMicroseconds(0),
+    sampleFrames(0),
+    variableBitrate(false),
+    seekTableSpacing(1),
     bitrate(0),
     sampleRate(0),
     channels(0),
@@ -59,6 +102,11 @@ public:
   XingHeader *xingHeader;
   ReadStyle style;
   int length;
+  long long lengthInMicroseconds;
+  long long sampleFrames;
+  bool variableBitrate;
+  List<long> seekTable;
+  int seekTableSpacing;
   int bitrate;
   int sampleRate;
   int channels;
@@ -92,6 +140,31 @@ int MPEG::Properties::length() const
   return d->length;
 }
 
+long long MPEG::Properties::lengthInMicroseconds() const
+{
+  return d->lengthInMicroseconds;
+}
+
+long long MPEG::Properties::sampleFrames() const
+{
+  return d->sampleFrames;
+}
+
+bool MPEG::Properties::isVariableBitrate() const
+{
+  return d->variableBitrate;
+}
+
+const List<long> &MPEG::Properties::seekTable() const
+{
+  return d->seekTable;
+}
+
+int MPEG::Properties::seekTableSpacing() const
+{
+  return d->seekTableSpacing;
+}
+
 int MPEG::Properties::bitrate() const
 {
   return d->bitrate;
@@ -148,19 +221,6 @@ bool MPEG::Properties::isOriginal() const
 
 void MPEG::Properties::read()
 {
-  // Since we've likely just looked for the ID3v1 tag, start at the end of the
-  // file where we're least likely to have to have to move the disk head.
-
-  long last = d->file->lastFrameOffset();
-
-  if(last < 0) {
-    debug("MPEG::Properties::read() -- Could not find a valid last MPEG frame in the stream.");
-    return;
-  }
-
-  d->file->seek(last);
-  Header lastHeader(d->file->readBlock(4));
-
   long first = d->file->firstFrameOffset();
 
   if(first < 0) {
@@ -168,80 +228,75 @@ void MPEG::Properties::read()
     return;
   }
 
-  if(!lastHeader.isValid()) {
+  // The first frame holds the VBR headers.
 
-    long pos = last;
-
-    while(pos > first) {
+  d->file->seek(first);
+  const ByteVector data = d->file->readBlock(FirstFrameLength);
 
-      pos = d->file->previousFrameOffset(pos);
+  Header firstHeader(data);
 
-      if(pos < 0)
-        break;
+  if(!firstHeader.isValid()) {
+    debug("MPEG::Properties::read() -- Page headers were invalid.");
+    return;
+  }
 
-      d->file->seek(pos);
-      Header header(d->file->readBlock(4));
+  const long end = d->file->streamEndOffset();
+  const long long streamLength = end > first ? end - first : 0;
 
-      if(header.isValid()) {
-        lastHeader = header;
-        last = pos;
-        break;
-      }
-    }
-  }
+  // Check for a Xing or VBRI header that will help us in gathering information
+  // about a VBR stream.
 
-  // Now jump back to the front of the file and read what we need from there.
+  int xingHeaderOffset = MPEG::XingHeader::xingHeaderOffset(firstHeader.version(),
+                                                            firstHeader.channelMode());
 
-  d->file->seek(first);
-  Header firstHeader(d->file->readBlock(4));
+  d->xingHeader = new XingHeader(data.mid(xingHeaderOffset));
 
-  if(!firstHeader.isValid() || !lastHeader.isValid()) {
-    debug("MPEG::Properties::read() -- Page headers were invalid.");
-    return;
+  if(!d->xingHeader->isValid()) {
+    delete d->xingHeader;
+    d->xingHeader = new XingHeader(data.mid(XingHeader::vbriHeaderOffset()));
   }
 
-  // Check for a Xing header that will help us in gathering information about a
-  // VBR stream.
+  // Read the length and the bitrate from the header.
 
-  int xingHeaderOffset = MPEG::XingHeader::xingHeaderOffset(firstHeader.version(),
-                                                            firstHeader.channelMode());
+  if(d->xingHeader->isValid() && d->xingHeader->totalFrames() > 0) {
 
-  d->file->seek(first + xingHeaderOffset);
-  d->xingHeader = new XingHeader(d->file->readBlock(16));
+    long long samples = (long long)firstHeader.samplesPerFrame() * d->xingHeader->totalFrames()
+      - d->xingHeader->encoderDelay() - d->xingHeader->encoderPadding();
 
-  // Read the length and the bitrate from the Xing header.
+    if(samples < 0)
+      samples = 0;
 
-  if(d->xingHeader->isValid() &&
-     firstHeader.sampleRate() > 0 &&
-     d->xingHeader->totalFrames() > 0)
-  {
-      double timePerFrame =
-        double(firstHeader.samplesPerFrame()) / firstHeader.sampleRate();
+    d->sampleFrames = samples;
+    d->lengthInMicroseconds = samples * 1000000 / firstHeader.sampleRate();
 
-      double length = timePerFrame * d->xingHeader->totalFrames();
+    const long long size = d->xingHeader->totalSize() > 0 ? d->xingHeader->totalSize() : streamLength;
 
-      d->length = int(length);
-      d->bitrate = d->length > 0 ? d->xingHeader->totalSize() * 8 / length / 1000 : 0;
+    if(d->lengthInMicroseconds > 0)
+      d->bitrate = int(size * 8000 / d->lengthInMicroseconds);
   }
   else {
-    // Since there was no valid Xing header found, we hope that we're in a constant
-    // bitrate file.
-
     delete d->xingHeader;
     d->xingHeader = 0;
 
-    // TODO: Make this more robust with audio property detection for VBR without a
-    // Xing header.
+    if(d->style == Accurate)
+      scan(first, end, firstHeader);
+    else if(firstHeader.bitrate() > 0) {
+
+      // Hope for a constant bitrate.  The Average style takes the mean of a few
+      // frames spread over the stream, which is close for VBR streams as well.
 
-    if(firstHeader.frameLength() > 0 && firstHeader.bitrate() > 0) {
-      int frames = (last - first) / firstHeader.frameLength() + 1;
+      int bitrate = firstHeader.bitrate();
 
-      d->length = int(float(firstHeader.frameLength() * frames) /
-                      float(firstHeader.bitrate() * 125) + 0.5);
-      d->bitrate = firstHeader.bitrate();
+      if(d->style == Average)
+        bitrate = sampleBitrate(first, end, firstHeader);
+
+      d->lengthInMicroseconds = streamLength * 8000 / bitrate;
+      d->sampleFrames = d->lengthInMicroseconds * firstHeader.sampleRate() / 1000000;
+      d->bitrate = bitrate;
     }
   }
 
+  d->length = int((d->lengthInMicroseconds + 500000) / 1000000);
 
   d->sampleRate = firstHeader.sampleRate();
   d->channels = firstHeader.channelMode() == Header::SingleChannel ? 1 : 2;
@@ -252,3 +307,131 @@ void MPEG::Properties::read()
   d->isCopyrighted = firstHeader.isCopyrighted();
   d->isOriginal = firstHeader.isOriginal();
 }
+
+int MPEG::Properties::sampleBitrate(long first, long end, const Header &firstHeader)
+{
+  long long sum = firstHeader.bitrate();
+  int count = 1;
+
+  for(int point = 1; point < SamplingPoints; point++) {
+
+    d->file->seek(first + long((long long)(end - first) * point / SamplingPoints));
+    const ByteVector data = d->file->readBlock(SamplingLength);
+
+    // Take a frame that is directly followed by another one of the stream.
+
+    for(uint i = 0; i + 4 <= data.size(); i++) {
+      if(!isFrameSync(data, i))
+        continue;
+
+      const Header header(data.mid(i, 4));
+
+      if(!isSameStream(header, firstHeader) || header.bitrate() <= 0)
+        continue;
+
+      const uint next = i + header.frameLength();
+
+      if(next + 4 > data.size())
+        break;
+
+      if(isFrameSync(data, next) && isSameStream(Header(data.mid(next, 4)), firstHeader)) {
+        if(header.bitrate() != firstHeader.bitrate())
+          d->variableBitrate = true;
+
+        sum += header.bitrate();
+        count++;
+        break;
+      }
+    }
+  }
+
+  return int((sum + count / 2) / count);
+}
+
+void MPEG::Properties::scan(long first, long end, const Header &firstHeader)
+{
+  long long frames = 0;
+  long long size = 0;
+
+  // Frame lengths by the four header bytes, 0 if the header doesn't belong to the
+  // stream.  A stream only uses a few different headers.
+
+  std::map<uint, int> frameLengths;
+
+  ByteVector buffer;
+  long bufferOffset = first;
+  long position = first;
+
+  while(position + 4 <= end) {
+
+    if(position + 4 > bufferOffset + long(buffer.size())) {
+      d->file->seek(position);
+      buffer = d->file->readBlock(end - position < long(ScanBufferLength) ? end - position : long(ScanBufferLength));
+      bufferOffset = position;
+
+      if(buffer.size() < 4)
+        break;
+    }
+
+    const uint offset = position - bufferOffset;
+
+    if(isFrameSync(buffer, offset)) {
+      const uint word = buffer.mid(offset, 4).toUInt();
+
+      std::map<uint, int>::iterator it = frameLengths.find(word);
+
+      if(it == frameLengths.end()) {
+        const Header header(buffer.mid(offset, 4));
+        const int length = isSameStream(header, firstHeader) ? header.frameLength() : 0;
+        it = frameLengths.insert(std::make_pair(word, length)).first;
+
+        if(length > 0 && header.bitrate() != firstHeader.bitrate())
+          d->variableBitrate = true;
+      }
+
+      if(it->second > 0) {
+        if(frames % d->seekTableSpacing == 0)
+          addSeekPoint(frames, position);
+
+        frames++;
+        size += it->second;
+        position += it->second;
+        continue;
+      }
+    }
+
+    // Lost the frames, go on with the next sync.
+
+    position = d->file->nextFrameOffset(position + 1);
+
+    if(position < 0)
+      break;
+  }
+
+  d->sampleFrames = frames * firstHeader.samplesPerFrame();
+  d->lengthInMicroseconds = d->sampleFrames * 1000000 / firstHeader.sampleRate();
+
+  if(d->lengthInMicroseconds > 0)
+    d->bitrate = int(size * 8000 / d->lengthInMicroseconds);
+}
+
+void MPEG::Properties::addSeekPoint(long long frame, long offset)
+{
+  // A full table keeps every other entry, the spacing doubles.
+
+  if(d->seekTable.size() == MaxSeekPoints) {
+    List<long> table;
+    bool keep = true;
+
+    for(List<long>::ConstIterator it = d->seekTable.begin(); it != d->seekTable.end(); ++it, keep = !keep) {
+      if(keep)
+        table.append(*it);
+    }
+
+    d->seekTable = table;
+    d->seekTableSpacing *= 2;
+  }
+
+  if(frame % d->seekTableSpacing == 0)
+    d->seekTable.append(offset);
+}
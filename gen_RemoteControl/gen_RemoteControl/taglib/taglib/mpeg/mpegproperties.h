@@ -28,6 +28,7 @@
 
 #include "taglib_export.h"
 #include "audioproperties.h"
+#include "tlist.h"
 
 #include "mpegheader.h"
 
@@ -43,6 +44,11 @@ namespace TagLib {
     /*!
      * This reads the data from an MPEG Layer III stream found in the
      * AudioProperties API.
+     *
+     * The length and bitrate of VBR streams come from a Xing or VBRI header in
+     * the first frame.  Without one the Fast style assumes a constant bitrate,
+     * the Average style samples a few frames spread over the stream and only
+     * the Accurate style walks every frame.
      */
 
     class TAGLIB_EXPORT Properties : public AudioProperties
@@ -66,9 +72,43 @@ namespace TagLib {
       virtual int sampleRate() const;
       virtual int channels() const;
 
+      /*!
+       * Returns the length of the file in microseconds.  The encoder delay and
+       * padding of a LAME header are left out.
+       */
+      long long lengthInMicroseconds() const;
+
+      /*!
+       * Returns the number of samples per channel, without the encoder delay
+       * and padding of a LAME header.  Like the length it is estimated for VBR
+       * streams without a Xing or VBRI header unless the style is Accurate.
+       */
+      long long sampleFrames() const;
+
+      /*!
+       * Returns true if the Average or the Accurate style found frames with
+       * different bitrates in a stream without a Xing or VBRI header.  Only the
+       * Accurate style gets the length of such a stream right.
+       */
+      bool isVariableBitrate() const;
+
+      /*!
+       * Returns the file offsets of every seekTableSpacing()-th frame, starting
+       * with the first one.  The table is filled by the Accurate style when it
+       * walks the frames of a stream without a Xing or VBRI header and is empty
+       * otherwise.  It has at most 256 entries, the spacing grows with the
+       * stream.
+       */
+      const List<long> &seekTable() const;
+
+      /*!
+       * Returns the number of frames from one entry of seekTable() to the next.
+       */
+      int seekTableSpacing() const;
+
       /*!
        * Returns a pointer to the XingHeader if one exists or null if no
-       * XingHeader was found.
+       * Xing or VBRI header was found.
        */
 
       const XingHeader *xingHeader() const;
@@ -108,6 +148,9 @@ namespace TagLib {
       Properties &operator=(const Properties &);
 
       void read();
+      int sampleBitrate(long first, long end, const Header &firstHeader);
+      void scan(long first, long end, const Header &firstHeader);
+      void addSeekPoint(long long frame, long offset);
 
       class PropertiesPrivate;
       PropertiesPrivate *d;
@@ -37,12 +37,16 @@ public:
   XingHeaderPrivate() :
     frames(0),
     size(0),
-    valid(false)
+    type(MPEG::XingHeader::Invalid),
+    encoderDelay(0),
+    encoderPadding(0)
     {}
 
   uint frames;
   uint size;
-  bool valid;
+  MPEG::XingHeader::HeaderType type;
+  int encoderDelay;
+  int encoderPadding;
 };
 
 MPEG::XingHeader::XingHeader(const ByteVector &data)
@@ -58,7 +62,7 @@ MPEG::XingHeader::~XingHeader()
 
 bool MPEG::XingHeader::isValid() const
 {
-  return d->valid;
+  return d->type != Invalid;
 }
 
 TagLib::uint MPEG::XingHeader::totalFrames() const
@@ -71,6 +75,21 @@ TagLib::uint MPEG::XingHeader::totalSize() const
   return d->size;
 }
 
+MPEG::XingHeader::HeaderType MPEG::XingHeader::type() const
+{
+  return d->type;
+}
+
+int MPEG::XingHeader::encoderDelay() const
+{
+  return d->encoderDelay;
+}
+
+int MPEG::XingHeader::encoderPadding() const
+{
+  return d->encoderPadding;
+}
+
 int MPEG::XingHeader::xingHeaderOffset(TagLib::MPEG::Header::Version v,
                                        TagLib::MPEG::Header::ChannelMode c)
 {
@@ -88,28 +107,81 @@ int MPEG::XingHeader::xingHeaderOffset(TagLib::MPEG::Header::Version v,
   }
 }
 
+int MPEG::XingHeader::vbriHeaderOffset()
+{
+  // 32 bytes behind the frame header for every version and channel mode
+
+  return 0x24;
+}
+
 void MPEG::XingHeader::parse(const ByteVector &data)
 {
+  if(data.startsWith("VBRI")) {
+    parseVBRI(data);
+    return;
+  }
+
   // Check to see if a valid Xing header is available.
 
-  if(!data.startsWith("Xing") && !data.startsWith("Info"))
+  if(data.size() < 16 || (!data.startsWith("Xing") && !data.startsWith("Info")))
     return;
 
-  // If the XingHeader doesn't contain the number of frames and the total stream
-  // info it's invalid.
+  // If the XingHeader doesn't contain the number of frames it's invalid.  The
+  // stream size is optional, the file has to be used without it.
 
-  if(!(data[7] & 0x01)) {
+  const uint flags = data.mid(4, 4).toUInt();
+
+  if(!(flags & 0x01)) {
     debug("MPEG::XingHeader::parse() -- Xing header doesn't contain the total number of frames.");
     return;
   }
 
-  if(!(data[7] & 0x02)) {
-    debug("MPEG::XingHeader::parse() -- Xing header doesn't contain the total stream size.");
+  uint offset = 8;
+
+  d->frames = data.mid(offset, 4).toUInt();
+  offset += 4;
+
+  if(flags & 0x02) {
+    d->size = data.mid(offset, 4).toUInt();
+    offset += 4;
+  }
+
+  // Skip the seek table and the quality indicator.
+
+  if(flags & 0x04)
+    offset += 100;
+
+  if(flags & 0x08)
+    offset += 4;
+
+  d->type = Xing;
+
+  // The LAME extension (also written by libavcodec) stores the encoder delay and
+  // padding as two 12 bit values 21 bytes into it.
+
+  if(data.size() >= offset + 24 &&
+     (data.containsAt("LAME", offset) || data.containsAt("Lavf", offset) || data.containsAt("Lavc", offset)))
+  {
+    const uint gapless = data.mid(offset + 21, 3).toUInt();
+
+    d->encoderDelay = gapless >> 12;
+    d->encoderPadding = gapless & 0xfff;
+  }
+}
+
+void MPEG::XingHeader::parseVBRI(const ByteVector &data)
+{
+  // The 26 byte VBRI header is followed by a seek table that isn't needed for the
+  // totals.
+
+  if(data.size() < 26) {
+    debug("MPEG::XingHeader::parseVBRI() -- VBRI header is too short.");
     return;
   }
 
-  d->frames = data.mid(8, 4).toUInt();
-  d->size = data.mid(12, 4).toUInt();
+  d->size = data.mid(10, 4).toUInt();
+  d->frames = data.mid(14, 4).toUInt();
 
-  d->valid = true;
+  if(d->frames > 0)
+    d->type = VBRI;
 }
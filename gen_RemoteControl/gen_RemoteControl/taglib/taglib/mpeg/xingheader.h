@@ -35,7 +35,7 @@ namespace TagLib {
 
   namespace MPEG {
 
-    //! An implementation of the Xing VBR headers
+    //! An implementation of the Xing and VBRI VBR headers
 
     /*!
      * This is a minimalistic implementation of the Xing VBR headers.  Xing
@@ -45,14 +45,33 @@ namespace TagLib {
      * calculate the total playing time and the average bitrate).  It uses
      * <a href="http://home.pcisys.net/~melanson/codecs/mp3extensions.txt">this text</a>
      * and the XMMS sources as references.
+     *
+     * The encoder delay and padding of the LAME extension that follows the Xing
+     * header give the exact number of samples.  The VBRI headers written by the
+     * Fraunhofer encoder carry the same totals at a fixed position of the first
+     * frame.
      */
 
     class TAGLIB_EXPORT XingHeader
     {
     public:
       /*!
-       * Parses a Xing header based on \a data.  The data must be at least 16
-       * bytes long (anything longer than this is discarded).
+       * The type of the header.
+       */
+      enum HeaderType {
+        //! No valid header was found
+        Invalid = 0,
+        //! Xing or Info header, possibly followed by a LAME extension
+        Xing    = 1,
+        //! Fraunhofer VBRI header
+        VBRI    = 2
+      };
+
+      /*!
+       * Parses a Xing or VBRI header based on \a data, which has to start at
+       * the header.  See xingHeaderOffset() and vbriHeaderOffset().  A Xing header
+       * is at least 16 bytes long, the LAME extension is only read if \a data
+       * holds it as well.
        */
       XingHeader(const ByteVector &data);
 
@@ -73,10 +92,28 @@ namespace TagLib {
       uint totalFrames() const;
 
       /*!
-       * Returns the total size of stream in bytes.
+       * Returns the total size of stream in bytes, 0 if the header doesn't
+       * contain it.
        */
       uint totalSize() const;
 
+      /*!
+       * Returns the type of the header.
+       */
+      HeaderType type() const;
+
+      /*!
+       * Returns the number of samples the encoder has added at the start of the
+       * stream, 0 if there's no LAME extension.
+       */
+      int encoderDelay() const;
+
+      /*!
+       * Returns the number of samples the encoder has added at the end of the
+       * stream, 0 if there's no LAME extension.
+       */
+      int encoderPadding() const;
+
       /*!
        * Returns the offset for the start of this Xing header, given the
        * version and channels of the frame
@@ -85,11 +122,18 @@ namespace TagLib {
       static int xingHeaderOffset(TagLib::MPEG::Header::Version v,
                                   TagLib::MPEG::Header::ChannelMode c);
 
+      /*!
+       * Returns the offset for the start of a VBRI header, which doesn't depend
+       * on the frame.
+       */
+      static int vbriHeaderOffset();
+
     private:
       XingHeader(const XingHeader &);
       XingHeader &operator=(const XingHeader &);
 
       void parse(const ByteVector &data);
+      void parseVBRI(const ByteVector &data);
 
       class XingHeaderPrivate;
       XingHeaderPrivate *d;
@@ -28,45 +28,120 @@
 #include <tstring.h>
 #include <tdebug.h>
 
+#include <string.h>
+
 #include "oggfile.h"
 #include "oggpage.h"
 #include "oggpageheader.h"
 
 using namespace TagLib;
 
+namespace
+{
+  // What the packet reader needs to know about a page, taken from its header.
+  // The packet sizes of all pages are kept in one vector of the file.
+
+  struct PageInfo
+  {
+    long offset;
+    int headerSize;
+    int size;
+    TagLib::uint firstPacketIndex;
+    TagLib::uint packetCount;
+    TagLib::uint firstPacketSize;
+    bool lastPacketCompleted;
+    bool lastPageOfStream;
+  };
+}
+
 class Ogg::File::FilePrivate
 {
 public:
   FilePrivate() :
     streamSerialNumber(0),
     firstPageHeader(0),
-    lastPageHeader(0),
-    currentPage(0),
-    currentPacketPage(0)
+    lastPageHeader(0)
   {
-    pages.setAutoDelete(true);
   }
 
   ~FilePrivate()
   {
     delete firstPageHeader;
     delete lastPageHeader;
+    clearPages();
+  }
+
+  /*!
+   * Returns the Page object of the i-th page of the index, which is created
+   * on first use.  Only needed for saving, reading works on the index alone.
+   */
+  Page *page(File *file, uint i)
+  {
+    if(pages.size() < index.size())
+      pages.resize(index.size(), 0);
+
+    if(!pages[i]) {
+      pages[i] = new Page(file, index[i].offset);
+      pages[i]->setFirstPacketIndex(index[i].firstPacketIndex);
+    }
+
+    return pages[i];
+  }
+
+  /*!
+   * Returns the number of bytes of packet \a i on the \a page-th page of the
+   * index, 0 if the packet isn't on the page.
+   */
+  uint partSize(uint i, uint page) const
+  {
+    const PageInfo &info = index[page];
+
+    if(i < info.firstPacketIndex || i >= info.firstPacketIndex + info.packetCount)
+      return 0;
+
+    return packetSizes[info.firstPacketSize + i - info.firstPacketIndex];
+  }
+
+  /*!
+   * Returns the number of bytes of packet \a i on the pages of the index
+   * before the \a page-th one.
+   */
+  uint partOffset(uint i, uint page) const
+  {
+    uint offset = 0;
+    for(uint p = packetToPageMap[i].first; p < page; p++)
+      offset += partSize(i, p);
+    return offset;
+  }
+
+  /*!
+   * Forgets the page index, the pages are read again when they are needed.
+   */
+  void clearPages()
+  {
+    for(std::vector<Page *>::iterator it = pages.begin(); it != pages.end(); ++it)
+      delete *it;
+
+    pages.clear();
+    index.clear();
+    packetSizes.clear();
+    packetToPageMap.clear();
   }
 
   uint streamSerialNumber;
-  List<Page *> pages;
   PageHeader *firstPageHeader;
   PageHeader *lastPageHeader;
-  std::vector< List<int> > packetToPageMap;
+
+  //! The pages read so far and the sizes of their packets
+  std::vector<PageInfo> index;
+  std::vector<int> packetSizes;
+  //! The first and the last page of every packet read so far
+  std::vector< std::pair<uint, uint> > packetToPageMap;
+  //! Page objects for the index, see page()
+  std::vector<Page *> pages;
+
   Map<int, ByteVector> dirtyPackets;
   List<int> dirtyPages;
-
-  //! The current page for the reader -- used by nextPage()
-  Page *currentPage;
-  //! The current page for the packet parser -- used by packet()
-  Page *currentPacketPage;
-  //! The packets for the currentPacketPage -- used by packet()
-  ByteVectorList currentPackets;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -96,43 +171,61 @@ ByteVector Ogg::File::packet(uint i)
     }
   }
 
-  // Start reading at the first page that contains part (or all) of this packet.
-  // If the last read stopped at the packet that we're interested in, don't
-  // reread its packet list.  (This should make sequential packet reads fast.)
+  // Locate the parts of the packet, starting at the first page that contains
+  // part (or all) of it.  If the packet trails off the end of a page it
+  // continues with the first packet of the next one; only the page headers are
+  // read until the page where the packet is completed.
 
-  uint pageIndex = d->packetToPageMap[i].front();
-  if(d->currentPacketPage != d->pages[pageIndex]) {
-    d->currentPacketPage = d->pages[pageIndex];
-    d->currentPackets = d->currentPacketPage->packets();
-  }
+  std::vector< std::pair<long, int> > parts;
 
-  // If the packet is completely contained in the first page that it's in, then
-  // just return it now.
+  uint pageIndex = d->packetToPageMap[i].first;
+  uint packetIndex = i - d->index[pageIndex].firstPacketIndex;
 
-  if(d->currentPacketPage->containsPacket(i) & Page::CompletePacket)
-    return d->currentPackets[i - d->currentPacketPage->firstPacketIndex()];
+  for(;;) {
+    const PageInfo &page = d->index[pageIndex];
 
-  // If the packet is *not* completely contained in the first page that it's a
-  // part of then that packet trails off the end of the page.  Continue appending
-  // the pages' packet data until we hit a page that either does not end with the
-  // packet that we're fetching or where the last packet is complete.
+    long offset = page.offset + page.headerSize;
+    for(uint j = 0; j < packetIndex; j++)
+      offset += d->packetSizes[page.firstPacketSize + j];
+
+    parts.push_back(std::make_pair(offset, d->packetSizes[page.firstPacketSize + packetIndex]));
+
+    if(packetIndex + 1 < page.packetCount || page.lastPacketCompleted)
+      break;
 
-  ByteVector packet = d->currentPackets.back();
-  while(d->currentPacketPage->containsPacket(i) & Page::EndsWithPacket &&
-        !d->currentPacketPage->header()->lastPacketCompleted())
-  {
     pageIndex++;
-    if(pageIndex == d->pages.size()) {
-      if(!nextPage()) {
-        debug("Ogg::File::packet() -- Could not find the requested packet.");
-        return ByteVector::null;
-      }
+    packetIndex = 0;
+
+    if(pageIndex == d->index.size() && !nextPage()) {
+      debug("Ogg::File::packet() -- Could not find the requested packet.");
+      return ByteVector::null;
     }
-    d->currentPacketPage = d->pages[pageIndex];
-    d->currentPackets = d->currentPacketPage->packets();
-    packet.append(d->currentPackets.front());
   }
 
+  if(parts.size() == 1) {
+    seek(parts.front().first);
+    return readBlock(parts.front().second);
+  }
+
+  // Read the parts of a packet spanning several pages into one block.
+
+  uint size = 0;
+  for(std::vector< std::pair<long, int> >::const_iterator it = parts.begin(); it != parts.end(); ++it)
+    size += it->second;
+
+  ByteVector packet(size, 0);
+  uint position = 0;
+
+  for(std::vector< std::pair<long, int> >::const_iterator it = parts.begin(); it != parts.end(); ++it) {
+    seek(it->first);
+    ByteVector data = readBlock(it->second);
+    ::memcpy(packet.data() + position, data.data(), data.size());
+    position += data.size();
+  }
+
+  if(position < size)
+    packet.resize(position);
+
   return packet;
 }
 
@@ -145,13 +238,38 @@ void Ogg::File::setPacket(uint i, const ByteVector &p)
     }
   }
 
-  List<int>::ConstIterator it = d->packetToPageMap[i].begin();
-  for(; it != d->packetToPageMap[i].end(); ++it)
-    d->dirtyPages.sortedInsert(*it, true);
+  for(uint page = d->packetToPageMap[i].first; page <= d->packetToPageMap[i].second; page++)
+    d->dirtyPages.sortedInsert(page, true);
 
   d->dirtyPackets.insert(i, p);
 }
 
+uint Ogg::File::packetSize(uint i)
+{
+  while(d->packetToPageMap.size() <= i) {
+    if(!nextPage()) {
+      debug("Ogg::File::packetSize() -- Could not find the requested packet.");
+      return 0;
+    }
+  }
+
+  // Index the pages until the one where the packet is completed.
+
+  for(;;) {
+    const PageInfo &page = d->index[d->packetToPageMap[i].second];
+
+    if(i + 1 < page.firstPacketIndex + page.packetCount || page.lastPacketCompleted)
+      break;
+
+    if(!nextPage()) {
+      debug("Ogg::File::packetSize() -- Could not find the requested packet.");
+      return 0;
+    }
+  }
+
+  return d->partOffset(i, d->packetToPageMap[i].second + 1);
+}
+
 const Ogg::PageHeader *Ogg::File::firstPageHeader()
 {
   if(d->firstPageHeader)
@@ -201,6 +319,10 @@ bool Ogg::File::save()
   d->dirtyPages.clear();
   d->dirtyPackets.clear();
 
+  // The pages have been moved, they are indexed again when they are read.
+
+  d->clearPages();
+
   return true;
 }
 
@@ -213,6 +335,11 @@ Ogg::File::File(FileName file) : TagLib::File(file)
   d = new FilePrivate;
 }
 
+Ogg::File::File(IOStream *stream) : TagLib::File(stream)
+{
+  d = new FilePrivate;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // private members
 ////////////////////////////////////////////////////////////////////////////////
@@ -220,51 +347,63 @@ Ogg::File::File(FileName file) : TagLib::File(file)
 bool Ogg::File::nextPage()
 {
   long nextPageOffset;
-  int currentPacket;
+  uint currentPacket;
 
-  if(d->pages.isEmpty()) {
+  if(d->index.empty()) {
     currentPacket = 0;
     nextPageOffset = find("OggS");
     if(nextPageOffset < 0)
       return false;
   }
   else {
-    if(d->currentPage->header()->lastPageOfStream())
+    const PageInfo &lastPage = d->index.back();
+
+    if(lastPage.lastPageOfStream)
       return false;
 
-    if(d->currentPage->header()->lastPacketCompleted())
-      currentPacket = d->currentPage->firstPacketIndex() + d->currentPage->packetCount();
+    if(lastPage.lastPacketCompleted)
+      currentPacket = lastPage.firstPacketIndex + lastPage.packetCount;
     else
-      currentPacket = d->currentPage->firstPacketIndex() + d->currentPage->packetCount() - 1;
+      currentPacket = lastPage.firstPacketIndex + lastPage.packetCount - 1;
 
-    nextPageOffset = d->currentPage->fileOffset() + d->currentPage->size();
+    nextPageOffset = lastPage.offset + lastPage.size;
   }
 
-  // Read the next page and add it to the page list.
+  // Read the header of the next page and add the page to the index.
 
-  d->currentPage = new Page(this, nextPageOffset);
+  PageHeader header(this, nextPageOffset);
 
-  if(!d->currentPage->header()->isValid()) {
-    delete d->currentPage;
-    d->currentPage = 0;
+  if(!header.isValid())
     return false;
-  }
 
-  d->currentPage->setFirstPacketIndex(currentPacket);
+  if(d->index.empty())
+    d->streamSerialNumber = header.streamSerialNumber();
+
+  const List<int> packetSizes = header.packetSizes();
+
+  PageInfo page;
+  page.offset = nextPageOffset;
+  page.headerSize = header.size();
+  page.size = header.size() + header.dataSize();
+  page.firstPacketIndex = currentPacket;
+  page.packetCount = packetSizes.size();
+  page.firstPacketSize = d->packetSizes.size();
+  page.lastPacketCompleted = header.lastPacketCompleted();
+  page.lastPageOfStream = header.lastPageOfStream();
 
-  if(d->pages.isEmpty())
-    d->streamSerialNumber = d->currentPage->header()->streamSerialNumber();
+  d->index.push_back(page);
+  d->packetSizes.insert(d->packetSizes.end(), packetSizes.begin(), packetSizes.end());
 
-  d->pages.append(d->currentPage);
+  // Loop through the packets in the page that we just read, adding the page
+  // to the packet to page map for each packet.
 
-  // Loop through the packets in the page that we just read appending the
-  // current page number to the packet to page map for each packet.
+  uint pageIndex = d->index.size() - 1;
 
-  for(uint i = 0; i < d->currentPage->packetCount(); i++) {
-    uint currentPacket = d->currentPage->firstPacketIndex() + i;
-    if(d->packetToPageMap.size() <= currentPacket)
-      d->packetToPageMap.push_back(List<int>());
-    d->packetToPageMap[currentPacket].append(d->pages.size() - 1);
+  for(uint i = 0; i < page.packetCount; i++) {
+    if(d->packetToPageMap.size() <= currentPacket + i)
+      d->packetToPageMap.push_back(std::make_pair(pageIndex, pageIndex));
+    else
+      d->packetToPageMap[currentPacket + i].second = pageIndex;
   }
 
   return true;
@@ -280,48 +419,53 @@ void Ogg::File::writePageGroup(const List<int> &thePageGroup)
   // (originalSize and size of packets would not work together), 
   // therefore we sometimes have to add pages to the group
   List<int> pageGroup(thePageGroup);
-  while (!d->pages[pageGroup.back()]->header()->lastPacketCompleted()) {
-    if (d->currentPage->header()->pageSequenceNumber() == pageGroup.back()) {
+  while (!d->page(this, pageGroup.back())->header()->lastPacketCompleted()) {
+    if (uint(pageGroup.back()) + 1 == d->index.size()) {
       if (nextPage() == false) {
         debug("broken ogg file");
         return;
       }
-      pageGroup.append(d->currentPage->header()->pageSequenceNumber());
-    } else {
-      pageGroup.append(pageGroup.back() + 1);
     }
+    pageGroup.append(pageGroup.back() + 1);
   }
 
+  // Packets that kept their sizes fit into the pages they came from, only
+  // these pages are written then.
+
+  if(writePagesInPlace(pageGroup))
+    return;
+
   ByteVectorList packets;
 
   // If the first page of the group isn't dirty, append its partial content here.
 
-  if(!d->dirtyPages.contains(d->pages[pageGroup.front()]->firstPacketIndex()))
-    packets.append(d->pages[pageGroup.front()]->packets().front());
+  if(!d->dirtyPages.contains(d->page(this, pageGroup.front())->firstPacketIndex()))
+    packets.append(d->page(this, pageGroup.front())->packets().front());
 
   int previousPacket = -1;
   int originalSize = 0;
 
   for(List<int>::ConstIterator it = pageGroup.begin(); it != pageGroup.end(); ++it) {
-    uint firstPacket = d->pages[*it]->firstPacketIndex();
-    uint lastPacket = firstPacket + d->pages[*it]->packetCount() - 1;
+    Page *page = d->page(this, *it);
+    uint firstPacket = page->firstPacketIndex();
+    uint lastPacket = firstPacket + page->packetCount() - 1;
 
     List<int>::ConstIterator last = --pageGroup.end();
 
     for(uint i = firstPacket; i <= lastPacket; i++) {
 
       if(it == last && i == lastPacket && !d->dirtyPages.contains(i))
-        packets.append(d->pages[*it]->packets().back());
+        packets.append(page->packets().back());
       else if(int(i) != previousPacket) {
         previousPacket = i;
         packets.append(packet(i));
       }
     }
-    originalSize += d->pages[*it]->size();
+    originalSize += page->size();
   }
 
-  const bool continued = d->pages[pageGroup.front()]->header()->firstPacketContinued();
-  const bool completed = d->pages[pageGroup.back()]->header()->lastPacketCompleted();
+  const bool continued = d->page(this, pageGroup.front())->header()->firstPacketContinued();
+  const bool completed = d->page(this, pageGroup.back())->header()->lastPacketCompleted();
 
   // TODO: This pagination method isn't accurate for what's being done here.
   // This should account for real possibilities like non-aligned packets and such.
@@ -340,7 +484,7 @@ void Ogg::File::writePageGroup(const List<int> &thePageGroup)
     // complete file in memory (is unavoidable at the moment)
 
     // read the complete stream
-    while(!d->currentPage->header()->lastPageOfStream()) {
+    while(!d->index.back().lastPageOfStream) {
       if(nextPage() == false) {
         debug("broken ogg file");
         break;
@@ -349,22 +493,12 @@ void Ogg::File::writePageGroup(const List<int> &thePageGroup)
 
     // create a gap for the new pages
     int numberOfNewPages = pages.back()->header()->pageSequenceNumber() - pageGroup.back();
-    List<Page *>::Iterator pageIter = d->pages.begin();
-    for(int i = 0; i < pageGroup.back(); i++) {
-      if(pageIter != d->pages.end()) {
-        ++pageIter;
-      }
-      else {
-        debug("Ogg::File::writePageGroup() -- Page sequence is broken in original file.");
-        break;
-      }
-    }
 
-    ++pageIter;
-    for(; pageIter != d->pages.end(); ++pageIter) {
+    for(uint i = pageGroup.back() + 1; i < d->index.size(); i++) {
+      Page *page = d->page(this, i);
       Ogg::Page *newPage =
-        (*pageIter)->getCopyWithNewPageSequenceNumber(
-            (*pageIter)->header()->pageSequenceNumber() + numberOfNewPages);
+        page->getCopyWithNewPageSequenceNumber(
+            page->header()->pageSequenceNumber() + numberOfNewPages);
 
       ByteVector data;
       data.append(newPage->render());
@@ -386,42 +520,79 @@ void Ogg::File::writePageGroup(const List<int> &thePageGroup)
   // generally only be one page group, so it's not worth the time for the
   // optimization at the moment.
 
-  insert(data, d->pages[pageGroup.front()]->fileOffset(), originalSize);
+  insert(data, d->page(this, pageGroup.front())->fileOffset(), originalSize);
 
-  // Update the page index to include the pages we just created and to delete the
-  // old pages.
+  // The written pages are read again from the file when they are needed, see
+  // save().
 
-  // First step: Pages that contain the comment data
+  for(List<Page *>::ConstIterator it = pages.begin(); it != pages.end(); ++it)
+    delete *it;
 
-  for(List<Page *>::ConstIterator it = pages.begin(); it != pages.end(); ++it) {
-    const unsigned int index = (*it)->header()->pageSequenceNumber();
-    if(index < d->pages.size()) {
-      delete d->pages[index];
-      d->pages[index] = *it;
-    }
-    else if(index == d->pages.size()) {
-      d->pages.append(*it);
-    }
-    else {
-      // oops - there's a hole in the sequence
-      debug("Ogg::File::writePageGroup() -- Page sequence is broken.");
-    }
+  for(List<Page *>::ConstIterator it = renumberedPages.begin(); it != renumberedPages.end(); ++it)
+    delete *it;
+}
+
+bool Ogg::File::writePagesInPlace(const List<int> &group)
+{
+  const uint first = group.front();
+  const uint last = group.back();
+
+  // Every changed packet on the pages has to be as large as it was, then the
+  // segment tables stay valid and only the data and the checksums change.
+
+  for(Map<int, ByteVector>::ConstIterator it = d->dirtyPackets.begin(); it != d->dirtyPackets.end(); ++it) {
+    const uint i = (*it).first;
+
+    if(i >= d->packetToPageMap.size() ||
+       d->packetToPageMap[i].first > last || d->packetToPageMap[i].second < first)
+      continue;
+
+    if(d->packetToPageMap[i].first < first || d->packetToPageMap[i].second > last)
+      return false;
+
+    if((*it).second.size() != packetSize(i))
+      return false;
   }
 
-  // Second step: the renumbered pages
+  ByteVector data;
 
-  for(List<Page *>::ConstIterator it = renumberedPages.begin(); it != renumberedPages.end(); ++it) {
-    const unsigned int index = (*it)->header()->pageSequenceNumber();
-    if(index < d->pages.size()) {
-      delete d->pages[index];
-      d->pages[index] = *it;
-    }
-    else if(index == d->pages.size()) {
-      d->pages.append(*it);
-    }
-    else {
-      // oops - there's a hole in the sequence
-      debug("Ogg::File::writePageGroup() -- Page sequence is broken.");
+  for(uint p = first; p <= last; p++) {
+    const PageInfo &page = d->index[p];
+
+    seek(page.offset);
+    ByteVector pageData = readBlock(page.size);
+
+    if(pageData.size() != uint(page.size))
+      return false;
+
+    uint position = page.headerSize;
+
+    for(uint j = 0; j < page.packetCount; j++) {
+      const uint i = page.firstPacketIndex + j;
+      const uint size = d->packetSizes[page.firstPacketSize + j];
+
+      if(d->dirtyPackets.contains(i))
+        ::memcpy(pageData.data() + position, d->dirtyPackets[i].data() + d->partOffset(i, p), size);
+
+      position += size;
     }
+
+    // The checksum is taken with its own 4 bytes zeroed, see Page::render().
+
+    for(int k = 0; k < 4; k++)
+      pageData[k + 22] = 0;
+
+    ByteVector checksum = ByteVector::fromUInt(pageData.checksum(), false);
+    for(int k = 0; k < 4; k++)
+      pageData[k + 22] = checksum[k];
+
+    data.append(pageData);
   }
+
+  // The pages follow each other in the file.
+
+  seek(d->index[first].offset);
+  writeBlock(data);
+
+  return true;
 }
@@ -92,16 +92,44 @@ namespace TagLib {
        */
       File(FileName file);
 
+      /*!
+       * Contructs an Ogg file from \a stream.  If \a readProperties is true the
+       * file's audio properties will also be read using \a propertiesStyle.  If
+       * false, \a propertiesStyle is ignored.
+       *
+       * The stream is not owned by the file, it has to stay valid until the
+       * file is destroyed.
+       *
+       * \note This constructor is protected since Ogg::File shouldn't be
+       * instantiated directly but rather should be used through the codec
+       * specific subclasses.
+       */
+      File(IOStream *stream);
+
+      /*!
+       * Returns the size of the packet with index \a i as it is in the file,
+       * calls to setPacket() since the last save don't change it.  Returns 0 if
+       * the packet could not be found.
+       */
+      uint packetSize(uint i);
+
     private:
       File(const File &);
       File &operator=(const File &);
 
       /*!
-       * Reads the next page and updates the internal "current page" pointer.
+       * Reads the header of the next page and adds the page to the page index.
        */
       bool nextPage();
       void writePageGroup(const List<int> &group);
 
+      /*!
+       * Writes the pages of \a group over themselves if the changed packets
+       * kept their sizes.  Returns false if the pages have to be paginated
+       * again.
+       */
+      bool writePagesInPlace(const List<int> &group);
+
       class FilePrivate;
       FilePrivate *d;
     };
@@ -236,15 +236,16 @@ void Ogg::PageHeader::read()
 {
   d->file->seek(d->fileOffset);
 
-  // An Ogg page header is at least 27 bytes, so we'll go ahead and read that
-  // much and then get the rest when we're ready for it.
+  // An Ogg page header is 27 bytes followed by up to 255 lacing values.  Read
+  // the largest possible header at once, the page data behind a shorter one
+  // is ignored.
 
-  ByteVector data = d->file->readBlock(27);
+  ByteVector data = d->file->readBlock(27 + 255);
 
   // Sanity check -- make sure that we were in fact able to read as much data as
   // we asked for and that the page begins with "OggS".
 
-  if(data.size() != 27 || !data.startsWith("OggS")) {
+  if(data.size() < 27 || !data.startsWith("OggS")) {
     debug("Ogg::PageHeader::read() -- error reading page header");
     return;
   }
@@ -256,8 +257,8 @@ void Ogg::PageHeader::read()
   d->lastPageOfStream = flags.test(2);
 
   d->absoluteGranularPosition = data.mid(6, 8).toLongLong(false);
-  d->streamSerialNumber = data.mid(14, 4).toUInt(false);
-  d->pageSequenceNumber = data.mid(18, 4).toUInt(false);
+  d->streamSerialNumber = data.toUInt(14U, false);
+  d->pageSequenceNumber = data.toUInt(18U, false);
 
   // Byte number 27 is the number of page segments, which is the only variable
   // length portion of the page header.  After reading the number of page
@@ -265,13 +266,13 @@ void Ogg::PageHeader::read()
 
   int pageSegmentCount = uchar(data[26]);
 
-  ByteVector pageSegments = d->file->readBlock(pageSegmentCount);
-
   // Another sanity check.
 
-  if(pageSegmentCount < 1 || int(pageSegments.size()) != pageSegmentCount)
+  if(pageSegmentCount < 1 || int(data.size()) < 27 + pageSegmentCount)
     return;
 
+  const char *pageSegments = data.data() + 27;
+
   // The base size of an Ogg page 27 bytes plus the number of lacing values.
 
   d->size = 27 + pageSegmentCount;
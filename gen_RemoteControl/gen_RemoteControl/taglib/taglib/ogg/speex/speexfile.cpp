@@ -65,6 +65,13 @@ Speex::File::File(FileName file, bool readProperties,
   read(readProperties, propertiesStyle);
 }
 
+Speex::File::File(IOStream *stream, bool readProperties,
+                   Properties::ReadStyle propertiesStyle) : Ogg::File(stream)
+{
+  d = new FilePrivate;
+  read(readProperties, propertiesStyle);
+}
+
 Speex::File::~File()
 {
   delete d;
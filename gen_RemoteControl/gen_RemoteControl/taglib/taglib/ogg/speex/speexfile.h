@@ -63,6 +63,17 @@ namespace TagLib {
         File(FileName file, bool readProperties = true,
              Properties::ReadStyle propertiesStyle = Properties::Average);
 
+        /*!
+         * Contructs a Speex file from \a stream.  If \a readProperties is true the
+         * file's audio properties will also be read using \a propertiesStyle.  If
+         * false, \a propertiesStyle is ignored.
+         *
+         * The stream is not owned by the file, it has to stay valid until the
+         * file is destroyed.
+         */
+        File(IOStream *stream, bool readProperties = true,
+             Properties::ReadStyle propertiesStyle = Properties::Average);
+
         /*!
          * Destroys this instance of the File.
          */
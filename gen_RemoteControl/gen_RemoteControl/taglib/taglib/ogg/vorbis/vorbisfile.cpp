@@ -55,6 +55,12 @@ namespace TagLib {
    * an Ogg stream.  0x03 indicates the comment header.
    */
   static const char vorbisCommentHeaderID[] = { 0x03, 'v', 'o', 'r', 'b', 'i', 's', 0 };
+
+  /*!
+   * The bytes of zeros after the framing bit that a growing comment header
+   * reserves for the next saves.  Decoders skip data after the framing bit.
+   */
+  static const uint commentPadding = 1024;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -68,6 +74,13 @@ Vorbis::File::File(FileName file, bool readProperties,
   read(readProperties, propertiesStyle);
 }
 
+Vorbis::File::File(IOStream *stream, bool readProperties,
+                   Properties::ReadStyle propertiesStyle) : Ogg::File(stream)
+{
+  d = new FilePrivate;
+  read(readProperties, propertiesStyle);
+}
+
 Vorbis::File::~File()
 {
   delete d;
@@ -91,6 +104,16 @@ bool Vorbis::File::save()
     d->comment = new Ogg::XiphComment;
   v.append(d->comment->render());
 
+  // A comment that fits into the header in the file is padded to its size, so
+  // the pages keep their layout and are written over themselves.
+
+  const uint size = packetSize(1);
+
+  if(v.size() <= size)
+    v.resize(size, 0);
+  else
+    v.resize(v.size() + commentPadding, 0);
+
   setPacket(1, v);
 
   return Ogg::File::save();
@@ -23,6 +23,10 @@
  *   http://www.mozilla.org/MPL/                                           *
  ***************************************************************************/
 
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
 #include <tbytevector.h>
 #include <tdebug.h>
 
@@ -30,12 +34,143 @@
 
 using namespace TagLib;
 
+namespace
+{
+  // a field as read, spans over the comment data
+  struct FieldSpan
+  {
+    uint keyOffset;
+    uint keyLength;
+    uint valueOffset;
+    uint valueLength;
+
+    // next field in the same bucket, -1 at the end
+    int next;
+  };
+
+  inline char upperAscii(char c)
+  {
+    return c >= 'a' && c <= 'z' ? char(c - 'a' + 'A') : c;
+  }
+
+  uint hashKey(const char *key, uint length)
+  {
+    uint hash = 2166136261U;
+    for(uint i = 0; i < length; i++)
+      hash = (hash ^ uchar(upperAscii(key[i]))) * 16777619U;
+    return hash;
+  }
+}
+
 class Ogg::XiphComment::XiphCommentPrivate
 {
 public:
+  XiphCommentPrivate() : indexed(false) {}
+
   FieldListMap fieldListMap;
   String vendorID;
   String commentField;
+  ByteVectorList pictureData;
+
+  // Until the first change or the first call of fieldListMap() the fields
+  // stay in the comment data as it was read, found by the hash of their key.
+  // a value is only decoded when it is read.
+
+  ByteVector data;
+  std::vector<FieldSpan> fields;
+  std::vector<int> buckets;
+  bool indexed;
+
+  bool hasKey(int i, const char *key, uint length) const
+  {
+    const FieldSpan &field = fields[i];
+    if(field.keyLength != length)
+      return false;
+
+    const char *fieldKey = data.data() + field.keyOffset;
+    uint j = 0;
+    while(j < length && upperAscii(fieldKey[j]) == upperAscii(key[j]))
+      j++;
+    return j == length;
+  }
+
+  // first field with the key in any case, -1 if there is none
+  int find(const ByteVector &key) const
+  {
+    if(buckets.empty())
+      return -1;
+
+    int i = buckets[hashKey(key.data(), key.size()) & (buckets.size() - 1)];
+    while(i >= 0 && !hasKey(i, key.data(), key.size()))
+      i = fields[i].next;
+    return i;
+  }
+
+  // next field with the same key as field i, -1 if there is none
+  int findNext(int i) const
+  {
+    const char *key = data.data() + fields[i].keyOffset;
+    const uint length = fields[i].keyLength;
+
+    i = fields[i].next;
+    while(i >= 0 && !hasKey(i, key, length))
+      i = fields[i].next;
+    return i;
+  }
+
+  String value(int i) const
+  {
+    return String(data.mid(fields[i].valueOffset, fields[i].valueLength), String::UTF8);
+  }
+
+  // first value of a field, null if there is none
+  String first(const char *key) const
+  {
+    if(indexed) {
+      int i = find(key);
+      return i < 0 ? String::null : value(i);
+    }
+
+    FieldListMap::ConstIterator it = fieldListMap.find(key);
+    if(it == fieldListMap.end() || (*it).second.isEmpty())
+      return String::null;
+    return (*it).second.front();
+  }
+
+  void index()
+  {
+    uint size = 16;
+    while(size < fields.size() * 2)
+      size *= 2;
+
+    buckets.assign(size, -1);
+
+    // backwards, so a bucket lists the fields in the order of the data
+    for(int i = int(fields.size()) - 1; i >= 0; i--) {
+      int &bucket = buckets[hashKey(data.data() + fields[i].keyOffset, fields[i].keyLength) & (size - 1)];
+      fields[i].next = bucket;
+      bucket = i;
+    }
+
+    indexed = true;
+  }
+
+  // decodes the fields into fieldListMap before it is used or changed
+  void decode()
+  {
+    if(!indexed)
+      return;
+
+    for(uint i = 0; i < fields.size(); i++) {
+      String key(data.mid(fields[i].keyOffset, fields[i].keyLength), String::UTF8);
+      fieldListMap[key.upper()].append(value(i));
+    }
+
+    fields.clear();
+    buckets.clear();
+    data.clear();
+    indexed = false;
+  }
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -60,35 +195,31 @@ Ogg::XiphComment::~XiphComment()
 
 String Ogg::XiphComment::title() const
 {
-  if(d->fieldListMap["TITLE"].isEmpty())
-    return String::null;
-  return d->fieldListMap["TITLE"].front();
+  return d->first("TITLE");
 }
 
 String Ogg::XiphComment::artist() const
 {
-  if(d->fieldListMap["ARTIST"].isEmpty())
-    return String::null;
-  return d->fieldListMap["ARTIST"].front();
+  return d->first("ARTIST");
 }
 
 String Ogg::XiphComment::album() const
 {
-  if(d->fieldListMap["ALBUM"].isEmpty())
-    return String::null;
-  return d->fieldListMap["ALBUM"].front();
+  return d->first("ALBUM");
 }
 
 String Ogg::XiphComment::comment() const
 {
-  if(!d->fieldListMap["DESCRIPTION"].isEmpty()) {
+  String description = d->first("DESCRIPTION");
+  if(!description.isNull()) {
     d->commentField = "DESCRIPTION";
-    return d->fieldListMap["DESCRIPTION"].front();
+    return description;
   }
 
-  if(!d->fieldListMap["COMMENT"].isEmpty()) {
+  String comment = d->first("COMMENT");
+  if(!comment.isNull()) {
     d->commentField = "COMMENT";
-    return d->fieldListMap["COMMENT"].front();
+    return comment;
   }
 
   return String::null;
@@ -96,26 +227,28 @@ String Ogg::XiphComment::comment() const
 
 String Ogg::XiphComment::genre() const
 {
-  if(d->fieldListMap["GENRE"].isEmpty())
-    return String::null;
-  return d->fieldListMap["GENRE"].front();
+  return d->first("GENRE");
 }
 
 TagLib::uint Ogg::XiphComment::year() const
 {
-  if(!d->fieldListMap["DATE"].isEmpty())
-    return d->fieldListMap["DATE"].front().toInt();
-  if(!d->fieldListMap["YEAR"].isEmpty())
-    return d->fieldListMap["YEAR"].front().toInt();
+  String date = d->first("DATE");
+  if(!date.isNull())
+    return date.toInt();
+  String year = d->first("YEAR");
+  if(!year.isNull())
+    return year.toInt();
   return 0;
 }
 
 TagLib::uint Ogg::XiphComment::track() const
 {
-  if(!d->fieldListMap["TRACKNUMBER"].isEmpty())
-    return d->fieldListMap["TRACKNUMBER"].front().toInt();
-  if(!d->fieldListMap["TRACKNUM"].isEmpty())
-    return d->fieldListMap["TRACKNUM"].front().toInt();
+  String number = d->first("TRACKNUMBER");
+  if(!number.isNull())
+    return number.toInt();
+  number = d->first("TRACKNUM");
+  if(!number.isNull())
+    return number.toInt();
   return 0;
 }
 
@@ -164,6 +297,9 @@ void Ogg::XiphComment::setTrack(uint i)
 
 bool Ogg::XiphComment::isEmpty() const
 {
+  if(d->indexed)
+    return d->fields.empty();
+
   FieldListMap::ConstIterator it = d->fieldListMap.begin();
   for(; it != d->fieldListMap.end(); ++it)
     if(!(*it).second.isEmpty())
@@ -174,6 +310,9 @@ bool Ogg::XiphComment::isEmpty() const
 
 TagLib::uint Ogg::XiphComment::fieldCount() const
 {
+  if(d->indexed)
+    return d->fields.size();
+
   uint count = 0;
 
   FieldListMap::ConstIterator it = d->fieldListMap.begin();
@@ -185,6 +324,7 @@ TagLib::uint Ogg::XiphComment::fieldCount() const
 
 const Ogg::FieldListMap &Ogg::XiphComment::fieldListMap() const
 {
+  d->decode();
   return d->fieldListMap;
 }
 
@@ -193,8 +333,32 @@ String Ogg::XiphComment::vendorID() const
   return d->vendorID;
 }
 
+const ByteVectorList &Ogg::XiphComment::pictureData() const
+{
+  // While the comment is indexed the values are shared with the comment data.
+  // The base64 text is ASCII, its String form converts back without a loss.
+
+  d->pictureData.clear();
+
+  if(d->indexed) {
+    for(int i = d->find("METADATA_BLOCK_PICTURE"); i >= 0; i = d->findNext(i))
+      d->pictureData.append(d->data.mid(d->fields[i].valueOffset, d->fields[i].valueLength));
+  }
+  else {
+    FieldListMap::ConstIterator it = d->fieldListMap.find("METADATA_BLOCK_PICTURE");
+    if(it != d->fieldListMap.end()) {
+      for(StringList::ConstIterator value = (*it).second.begin(); value != (*it).second.end(); ++value)
+        d->pictureData.append((*value).data(String::UTF8));
+    }
+  }
+
+  return d->pictureData;
+}
+
 void Ogg::XiphComment::addField(const String &key, const String &value, bool replace)
 {
+  d->decode();
+
   if(replace)
     removeField(key.upper());
 
@@ -204,6 +368,8 @@ void Ogg::XiphComment::addField(const String &key, const String &value, bool rep
 
 void Ogg::XiphComment::removeField(const String &key, const String &value)
 {
+  d->decode();
+
   if(!value.isNull()) {
     StringList::Iterator it = d->fieldListMap[key].begin();
     while(it != d->fieldListMap[key].end()) {
@@ -219,6 +385,9 @@ void Ogg::XiphComment::removeField(const String &key, const String &value)
 
 bool Ogg::XiphComment::contains(const String &key) const
 {
+  if(d->indexed)
+    return d->find(key.data(String::UTF8)) >= 0;
+
   return d->fieldListMap.contains(key) && !d->fieldListMap[key].isEmpty();
 }
 
@@ -229,6 +398,8 @@ ByteVector Ogg::XiphComment::render() const
 
 ByteVector Ogg::XiphComment::render(bool addFramingBit) const
 {
+  d->decode();
+
   ByteVector data;
 
   // Add the vendor ID length and the vendor ID.  It's important to use the
@@ -298,22 +469,41 @@ void Ogg::XiphComment::parse(const ByteVector &data)
   int commentFields = data.mid(pos, 4).toUInt(false);
   pos += 4;
 
-  for(int i = 0; i < commentFields; i++) {
+  d->data = data;
+
+  for(int i = 0; i < commentFields && pos + 4 <= int(data.size()); i++) {
 
     // Each comment field is in the format "KEY=value" in a UTF8 string and has
-    // 4 bytes before the text starts that gives the length.
+    // 4 bytes before the text starts that gives the length.  Only the spans of
+    // the key and the value are kept, they are decoded when they are read.
 
-    int commentLength = data.mid(pos, 4).toUInt(false);
+    uint commentLength = data.mid(pos, 4).toUInt(false);
     pos += 4;
 
-    String comment = String(data.mid(pos, commentLength), String::UTF8);
-    pos += commentLength;
+    commentLength = std::min<uint>(commentLength, data.size() - pos);
 
-    int commentSeparatorPosition = comment.find("=");
+    FieldSpan field;
+    field.next = -1;
 
-    String key = comment.substr(0, commentSeparatorPosition);
-    String value = comment.substr(commentSeparatorPosition + 1);
+    const char *separator = static_cast<const char *>(::memchr(data.data() + pos, '=', commentLength));
 
-    addField(key, value, false);
+    // without a separator the whole field is key and value
+
+    field.keyOffset = pos;
+    field.valueOffset = pos;
+    field.keyLength = field.valueLength = commentLength;
+
+    if(separator) {
+      field.keyLength = separator - (data.data() + pos);
+      field.valueOffset = pos + field.keyLength + 1;
+      field.valueLength = commentLength - field.keyLength - 1;
+    }
+
+    pos += commentLength;
+
+    if(field.keyLength > 0 && field.valueLength > 0)
+      d->fields.push_back(field);
   }
+
+  d->index();
 }
@@ -32,6 +32,7 @@
 #include "tstring.h"
 #include "tstringlist.h"
 #include "tbytevector.h"
+#include "tbytevectorlist.h"
 #include "taglib_export.h"
 
 namespace TagLib {
@@ -135,6 +136,11 @@ namespace TagLib {
        * converts all fields to uppercase.  When you are using this data
        * structure, you will need to specify the field name in upper case.
        *
+       * The fields are kept as they were read until the first call of this
+       * method or the first change, the accessors above find them by their key
+       * in any case and only decode the value they return.  This decodes all of
+       * them.
+       *
        * \warning You should not modify this data structure directly, instead
        * use addField() and removeField().
        */
@@ -146,6 +152,16 @@ namespace TagLib {
        */
       String vendorID() const;
 
+      /*!
+       * Returns the values of the METADATA_BLOCK_PICTURE fields: base64 encoded
+       * FLAC picture blocks.  Until fieldListMap() is used or the comment is
+       * changed they are shared with the comment data as it was read, so a
+       * multi-megabyte picture isn't converted to a String to get at it.
+       *
+       * The list is rebuilt on every call.
+       */
+      const ByteVectorList &pictureData() const;
+
       /*!
        * Add the field specified by \a key with the data \a value.  If \a replace
        * is true, then all of the other fields with the same key will be removed
@@ -184,8 +200,8 @@ namespace TagLib {
 
     protected:
       /*!
-       * Reads the tag from the file specified in the constructor and fills the
-       * FieldListMap.
+       * Reads the tag from the file specified in the constructor and indexes
+       * the fields, the FieldListMap is filled when it is asked for.
        */
       void parse(const ByteVector &data);
 
@@ -37,7 +37,9 @@ public:
   FilePrivate() :
     properties(0),
     tag(0),
-    tagChunkID("ID3 ")
+    tagChunkID("ID3 "),
+    tagChunk(-1),
+    tagPending(false)
   {
 
   }
@@ -51,6 +53,8 @@ public:
   Properties *properties;
   ID3v2::Tag *tag;
   ByteVector tagChunkID;
+  int tagChunk;
+  bool tagPending;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -65,6 +69,14 @@ RIFF::AIFF::File::File(FileName file, bool readProperties,
     read(readProperties, propertiesStyle);
 }
 
+RIFF::AIFF::File::File(IOStream *stream, bool readProperties,
+                       Properties::ReadStyle propertiesStyle) : RIFF::File(stream, BigEndian)
+{
+  d = new FilePrivate;
+  if(isOpen())
+    read(readProperties, propertiesStyle);
+}
+
 RIFF::AIFF::File::~File()
 {
   delete d;
@@ -72,6 +84,16 @@ RIFF::AIFF::File::~File()
 
 ID3v2::Tag *RIFF::AIFF::File::tag() const
 {
+  // The ID3 chunk is read when the tag is asked for the first time.
+
+  if(d->tagPending) {
+    d->tagPending = false;
+    if(d->tagChunk >= 0)
+      d->tag = new ID3v2::Tag(const_cast<File *>(this), chunkOffset(d->tagChunk));
+    else
+      d->tag = new ID3v2::Tag;
+  }
+
   return d->tag;
 }
 
@@ -87,7 +109,7 @@ bool RIFF::AIFF::File::save()
     return false;
   }
 
-  setChunkData(d->tagChunkID, d->tag->render());
+  setChunkData(d->tagChunkID, tag()->render());
 
   return true;
 }
@@ -101,12 +123,11 @@ void RIFF::AIFF::File::read(bool readProperties, Properties::ReadStyle propertie
   for(uint i = 0; i < chunkCount(); i++) {
     if(chunkName(i) == "ID3 " || chunkName(i) == "id3 ") {
       d->tagChunkID = chunkName(i);
-      d->tag = new ID3v2::Tag(this, chunkOffset(i));
+      d->tagChunk = i;
     }
     else if(chunkName(i) == "COMM" && readProperties)
       d->properties = new Properties(chunkData(i), propertiesStyle);
   }
 
-  if(!d->tag)
-    d->tag = new ID3v2::Tag;
+  d->tagPending = true;
 }
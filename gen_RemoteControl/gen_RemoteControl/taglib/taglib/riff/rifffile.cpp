@@ -79,6 +79,15 @@ RIFF::File::File(FileName file, Endianness endianness) : TagLib::File(file)
     read();
 }
 
+RIFF::File::File(IOStream *stream, Endianness endianness) : TagLib::File(stream)
+{
+  d = new FilePrivate;
+  d->endianness = endianness;
+
+  if(isOpen())
+    read();
+}
+
 TagLib::uint RIFF::File::riffSize() const
 {
   return d->size;
@@ -117,14 +126,7 @@ ByteVector RIFF::File::chunkData(uint i)
   if(i >= chunkCount())
     return ByteVector::null;
 
-  // Offset for the first subchunk's data
-
-  long begin = 12 + 8;
-
-  for(uint it = 0; it < i; it++)
-    begin += 8 + d->chunks[it].size + d->chunks[it].padding;
-
-  seek(begin);
+  seek(d->chunks[i].offset);
 
   return readBlock(d->chunks[i].size);
 }
@@ -198,42 +200,59 @@ void RIFF::File::read()
 {
   bool bigEndian = (d->endianness == BigEndian);
 
-  d->type = readBlock(4);
-  d->size = readBlock(4).toUInt(bigEndian);
-  d->format = readBlock(4);
+  ByteVector header = readBlock(12);
+  if(header.size() < 12)
+    return;
+
+  d->type = header.mid(0, 4);
+  d->size = header.mid(4, 4).toUInt(bigEndian);
+  d->format = header.mid(8, 4);
+
+  // Only the chunk headers are read, the data is skipped.  The padding byte
+  // behind a chunk of odd size is read together with the next header, so
+  // every chunk costs a single read however large it is.
+
+  const long fileLength = length();
+  long offset = 12;
+  bool padded = false;
 
   // + 8: chunk header at least, fix for additional junk bytes
-  while(tell() + 8 <= length()) {
-    ByteVector chunkName = readBlock(4);
-    uint chunkSize = readBlock(4).toUInt(bigEndian);
+  while(offset + 8 <= fileLength || (padded && offset + 1 <= fileLength)) {
+    header = readBlock(padded ? 9 : 8);
+
+    if(padded) {
+      // not well formed if the byte isn't zero, the header starts there then
+      if(header.size() > 0 && header[0] == 0) {
+        d->chunks.back().padding = 1;
+        header = header.mid(1);
+        offset++;
+      }
+      else
+        header.resize(header.size() < 8 ? header.size() : 8);
+      padded = false;
+    }
+
+    if(header.size() < 8)
+      break;
+
+    uint chunkSize = header.mid(4, 4).toUInt(bigEndian);
 
-    if(tell() + chunkSize > uint(length())) {
+    if(offset + 8 + chunkSize > uint(fileLength)) {
       // something wrong
       break;
     }
 
     Chunk chunk;
-    chunk.name = chunkName;
+    chunk.name = header.mid(0, 4);
     chunk.size = chunkSize;
-    chunk.offset = tell();
-
-    seek(chunk.size, Current);
-
-    // check padding
+    chunk.offset = offset + 8;
     chunk.padding = 0;
-    long uPosNotPadded = tell();
-    if((uPosNotPadded & 0x01) != 0) {
-      ByteVector iByte = readBlock(1);
-      if((iByte.size() != 1) || (iByte[0] != 0)) {
-        // not well formed, re-seek
-        seek(uPosNotPadded, Beginning);
-      }
-      else {
-        chunk.padding = 1;
-      }
-    }
     d->chunks.push_back(chunk);
 
+    offset = chunk.offset + chunk.size;
+    padded = (offset & 0x01) != 0;
+
+    seek(offset);
   }
 }
 
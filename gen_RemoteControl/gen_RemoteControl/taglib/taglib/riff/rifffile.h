@@ -57,6 +57,8 @@ namespace TagLib {
 
       File(FileName file, Endianness endianness);
 
+      File(IOStream *stream, Endianness endianness);
+
       /*!
        * \return The size of the main RIFF chunk.
        */
@@ -37,7 +37,9 @@ public:
   FilePrivate() :
     properties(0),
     tag(0),
-    tagChunkID("ID3 ")
+    tagChunkID("ID3 "),
+    tagChunk(-1),
+    tagPending(false)
   {
 
   }
@@ -51,6 +53,8 @@ public:
   Properties *properties;
   ID3v2::Tag *tag;
   ByteVector tagChunkID;
+  int tagChunk;
+  bool tagPending;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -65,6 +69,14 @@ RIFF::WAV::File::File(FileName file, bool readProperties,
     read(readProperties, propertiesStyle);
 }
 
+RIFF::WAV::File::File(IOStream *stream, bool readProperties,
+                       Properties::ReadStyle propertiesStyle) : RIFF::File(stream, LittleEndian)
+{
+  d = new FilePrivate;
+  if(isOpen())
+    read(readProperties, propertiesStyle);
+}
+
 RIFF::WAV::File::~File()
 {
   delete d;
@@ -72,6 +84,16 @@ RIFF::WAV::File::~File()
 
 ID3v2::Tag *RIFF::WAV::File::tag() const
 {
+  // The ID3 chunk is read when the tag is asked for the first time.
+
+  if(d->tagPending) {
+    d->tagPending = false;
+    if(d->tagChunk >= 0)
+      d->tag = new ID3v2::Tag(const_cast<File *>(this), chunkOffset(d->tagChunk));
+    else
+      d->tag = new ID3v2::Tag;
+  }
+
   return d->tag;
 }
 
@@ -87,7 +109,7 @@ bool RIFF::WAV::File::save()
     return false;
   }
 
-  setChunkData(d->tagChunkID, d->tag->render());
+  setChunkData(d->tagChunkID, tag()->render());
 
   return true;
 }
@@ -103,7 +125,7 @@ void RIFF::WAV::File::read(bool readProperties, Properties::ReadStyle properties
   for(uint i = 0; i < chunkCount(); i++) {
     if(chunkName(i) == "ID3 " || chunkName(i) == "id3 ") {
       d->tagChunkID = chunkName(i);
-      d->tag = new ID3v2::Tag(this, chunkOffset(i));
+      d->tagChunk = i;
     }
     else if(chunkName(i) == "fmt " && readProperties)
       formatData = chunkData(i);
@@ -114,6 +136,5 @@ void RIFF::WAV::File::read(bool readProperties, Properties::ReadStyle properties
   if(!formatData.isEmpty())
     d->properties = new Properties(formatData, streamLength, propertiesStyle);
 
-  if(!d->tag)
-    d->tag = new ID3v2::Tag;
+  d->tagPending = true;
 }
@@ -32,6 +32,12 @@ class Tag::TagPrivate
 
 };
 
+TagFields::TagFields() :
+  year(0),
+  track(0)
+{
+}
+
 Tag::Tag()
 {
 
@@ -53,6 +59,24 @@ bool Tag::isEmpty() const
           track() == 0);
 }
 
+void Tag::readFields(TagFields &result, int fields) const
+{
+  if(fields & Title)
+    result.title = title();
+  if(fields & Artist)
+    result.artist = artist();
+  if(fields & Album)
+    result.album = album();
+  if(fields & Comment)
+    result.comment = comment();
+  if(fields & Genre)
+    result.genre = genre();
+  if(fields & Year)
+    result.year = year();
+  if(fields & Track)
+    result.track = track();
+}
+
 void Tag::duplicate(const Tag *source, Tag *target, bool overwrite) // static
 {
   if(overwrite) {
@@ -41,10 +41,39 @@ namespace TagLib {
    * in TagLib::AudioProperties, TagLib::File and TagLib::FileRef.
    */
 
+  //! The basic fields of a tag, filled by Tag::readFields()
+
+  struct TAGLIB_EXPORT TagFields
+  {
+    TagFields();
+
+    String title;
+    String artist;
+    String album;
+    String comment;
+    String genre;
+    uint year;
+    uint track;
+  };
+
   class TAGLIB_EXPORT Tag
   {
   public:
 
+    /*!
+     * The basic fields, for the fields argument of readFields().
+     */
+    enum Field {
+      Title     = 0x01,
+      Artist    = 0x02,
+      Album     = 0x04,
+      Comment   = 0x08,
+      Genre     = 0x10,
+      Year      = 0x20,
+      Track     = 0x40,
+      AllFields = 0x7f
+    };
+
     /*!
      * Detroys this Tag instance.
      */
@@ -91,6 +120,16 @@ namespace TagLib {
      */
     virtual uint track() const = 0;
 
+    /*!
+     * Sets the fields of \a result that are given in \a fields, an OR of the
+     * Field values, to the values the accessors above return.  The other
+     * fields of \a result are left as they are.
+     *
+     * The default implementation calls the accessors, tags that find their
+     * fields in one pass reimplement it.
+     */
+    virtual void readFields(TagFields &result, int fields = AllFields) const;
+
     /*!
      * Sets the title to \a s.  If \a s is String::null then this value will be
      * cleared.
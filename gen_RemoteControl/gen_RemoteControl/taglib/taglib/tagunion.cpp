@@ -27,36 +27,19 @@
 
 using namespace TagLib;
 
-#define stringUnion(method)                                          \
-  if(tag(0) && !tag(0)->method().isEmpty())                          \
-    return tag(0)->method();                                         \
-  if(tag(1) && !tag(1)->method().isEmpty())                          \
-    return tag(1)->method();                                         \
-  if(tag(2) && !tag(2)->method().isEmpty())                          \
-    return tag(2)->method();                                         \
-  return String::null                                                \
-
-#define numberUnion(method)                                          \
-  if(tag(0) && tag(0)->method() > 0)                                 \
-    return tag(0)->method();                                         \
-  if(tag(1) && tag(1)->method() > 0)                                 \
-    return tag(1)->method();                                         \
-  if(tag(2) && tag(2)->method() > 0)                                 \
-    return tag(2)->method();                                         \
-  return 0
-
 #define setUnion(method, value)                                      \
-  if(tag(0))                                                         \
-    tag(0)->set##method(value);                                      \
-  if(tag(1))                                                         \
-    tag(1)->set##method(value);                                      \
-  if(tag(2))                                                         \
-    tag(2)->set##method(value);                                      \
+  d->resolved = false;                                               \
+  if(d->tags[0])                                                     \
+    d->tags[0]->set##method(value);                                  \
+  if(d->tags[1])                                                     \
+    d->tags[1]->set##method(value);                                  \
+  if(d->tags[2])                                                     \
+    d->tags[2]->set##method(value);                                  \
 
 class TagUnion::TagUnionPrivate
 {
 public:
-  TagUnionPrivate() : tags(3, static_cast<Tag *>(0))
+  TagUnionPrivate() : tags(3, static_cast<Tag *>(0)), resolved(false)
   {
 
   }
@@ -69,6 +52,13 @@ public:
   }
 
   std::vector<Tag *> tags;
+
+  // The basic fields of the union, resolved on the first read.  A write
+  // through the union, and handing out one of the tags, which may be written
+  // directly, resolve them again.
+
+  TagFields fields;
+  bool resolved;
 };
 
 TagUnion::TagUnion(Tag *first, Tag *second, Tag *third)
@@ -92,48 +82,143 @@ Tag *TagUnion::operator[](int index) const
 
 Tag *TagUnion::tag(int index) const
 {
+  d->resolved = false;
   return d->tags[index];
 }
 
 void TagUnion::set(int index, Tag *tag)
 {
+  d->resolved = false;
   delete d->tags[index];
   d->tags[index] = tag;
 }
 
 String TagUnion::title() const
 {
-  stringUnion(title);
+  return resolved().title;
 }
 
 String TagUnion::artist() const
 {
-  stringUnion(artist);
+  return resolved().artist;
 }
 
 String TagUnion::album() const
 {
-  stringUnion(album);
+  return resolved().album;
 }
 
 String TagUnion::comment() const
 {
-  stringUnion(comment);
+  return resolved().comment;
 }
 
 String TagUnion::genre() const
 {
-  stringUnion(genre);
+  return resolved().genre;
 }
 
 TagLib::uint TagUnion::year() const
 {
-  numberUnion(year);
+  return resolved().year;
 }
 
 TagLib::uint TagUnion::track() const
 {
-  numberUnion(track);
+  return resolved().track;
+}
+
+void TagUnion::readFields(TagFields &result, int fields) const
+{
+  const TagFields &values = resolved();
+
+  if(fields & Title)
+    result.title = values.title;
+  if(fields & Artist)
+    result.artist = values.artist;
+  if(fields & Album)
+    result.album = values.album;
+  if(fields & Comment)
+    result.comment = values.comment;
+  if(fields & Genre)
+    result.genre = values.genre;
+  if(fields & Year)
+    result.year = values.year;
+  if(fields & Track)
+    result.track = values.track;
+}
+
+const TagFields &TagUnion::resolved() const
+{
+  if(d->resolved)
+    return d->fields;
+
+  // Every tag is asked once for the fields the tags before it don't have,
+  // the first tag that has a field wins.
+
+  TagFields &result = d->fields;
+  int missing = AllFields;
+
+  for(int i = 0; i < 3 && missing != 0; i++) {
+    if(!d->tags[i])
+      continue;
+
+    TagFields values;
+    d->tags[i]->readFields(values, missing);
+
+    int found = 0;
+
+    if((missing & Title) && !values.title.isEmpty()) {
+      result.title = values.title;
+      found |= Title;
+    }
+    if((missing & Artist) && !values.artist.isEmpty()) {
+      result.artist = values.artist;
+      found |= Artist;
+    }
+    if((missing & Album) && !values.album.isEmpty()) {
+      result.album = values.album;
+      found |= Album;
+    }
+    if((missing & Comment) && !values.comment.isEmpty()) {
+      result.comment = values.comment;
+      found |= Comment;
+    }
+    if((missing & Genre) && !values.genre.isEmpty()) {
+      result.genre = values.genre;
+      found |= Genre;
+    }
+    if((missing & Year) && values.year > 0) {
+      result.year = values.year;
+      found |= Year;
+    }
+    if((missing & Track) && values.track > 0) {
+      result.track = values.track;
+      found |= Track;
+    }
+
+    missing &= ~found;
+  }
+
+  // A field none of the tags has is empty.
+
+  if(missing & Title)
+    result.title = String::null;
+  if(missing & Artist)
+    result.artist = String::null;
+  if(missing & Album)
+    result.album = String::null;
+  if(missing & Comment)
+    result.comment = String::null;
+  if(missing & Genre)
+    result.genre = String::null;
+  if(missing & Year)
+    result.year = 0;
+  if(missing & Track)
+    result.track = 0;
+
+  d->resolved = true;
+  return result;
 }
 
 void TagUnion::setTitle(const String &s)
@@ -64,6 +64,8 @@ namespace TagLib {
     virtual uint year() const;
     virtual uint track() const;
 
+    virtual void readFields(TagFields &result, int fields = AllFields) const;
+
     virtual void setTitle(const String &s);
     virtual void setArtist(const String &s);
     virtual void setAlbum(const String &s);
@@ -83,6 +85,8 @@ namespace TagLib {
     }
 
   private:
+    const TagFields &resolved() const;
+
     TagUnion(const Tag &);
     TagUnion &operator=(const Tag &);
 
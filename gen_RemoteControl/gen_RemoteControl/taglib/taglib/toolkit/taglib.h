@@ -42,8 +42,17 @@
 #define TAGLIB_CONSTRUCT_BITSET(x) static_cast<unsigned long>(x)
 #endif
 
+// Move constructors and assignment of the implicitly shared classes save the
+// reference counting of temporaries.
+
+#if (defined(_MSC_VER) && _MSC_VER >= 1600) || __cplusplus >= 201103L
+#define TAGLIB_HAVE_RVALUE_REFERENCES
+#endif
+
 #include <string>
 
+#include "taglib_export.h"
+
 //! A namespace for all TagLib related classes and functions
 
 /*!
@@ -72,20 +81,22 @@ namespace TagLib {
 #ifndef DO_NOT_DOCUMENT // Tell Doxygen to skip this class.
   /*!
    * \internal
-   * This is just used as a base class for shared classes in TagLib.
+   * This is just used as a base class for shared classes in TagLib.  The
+   * count is changed atomically, so copies of a shared object may be created
+   * and destroyed in different threads.
    *
    * \warning This <b>is not</b> part of the TagLib public API!
    */
 
-  class RefCounter
+  class TAGLIB_EXPORT RefCounter
   {
   public:
     RefCounter() : refCount(1) {}
-    void ref() { refCount++; }
-    bool deref() { return ! --refCount ; }
-    int count() { return refCount; }
+    void ref();
+    bool deref();
+    int count() const;
   private:
-    uint refCount;
+    volatile long refCount;
   };
 
 #endif // DO_NOT_DOCUMENT
@@ -0,0 +1,158 @@
+/***************************************************************************
+ *   This library is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Lesser General Public License version   *
+ *   2.1 as published by the Free Software Foundation.                     *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful, but   *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU     *
+ *   Lesser General Public License for more details.                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU Lesser General Public      *
+ *   License along with this library; if not, write to the Free Software   *
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA         *
+ *   02110-1301  USA                                                       *
+ *                                                                         *
+ *   Alternatively, this file is available under the Mozilla Public        *
+ *   License Version 1.1.  You may obtain a copy of the License at         *
+ *   http://www.mozilla.org/MPL/                                           *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <new>
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <sched.h>
+#endif
+
+#include "tallocator.h"
+
+using namespace TagLib;
+
+#ifdef WITH_POOLED_ALLOCATION
+
+namespace
+{
+  // Blocks are rounded up to multiples of granularity, larger objects are
+  // allocated on the heap.
+
+  const size_t granularity = 16;
+  const size_t largestBlock = 128;
+  const size_t classes = largestBlock / granularity;
+  const size_t chunkSize = 16384;
+
+  struct FreeBlock
+  {
+    FreeBlock *next;
+  };
+
+  // Zero initialized, so it can be used before static constructors ran.
+
+  FreeBlock *freeLists[classes];
+
+  // A spin lock, it is only held for a few instructions.  Statically
+  // initialized unlike a mutex.
+
+#ifdef _WIN32
+  volatile LONG locked;
+
+  inline void lock()
+  {
+    while(InterlockedExchange(&locked, 1) != 0)
+      Sleep(0);
+  }
+
+  inline void unlock()
+  {
+    InterlockedExchange(&locked, 0);
+  }
+#else
+  volatile int locked;
+
+  inline void lock()
+  {
+    while(__sync_lock_test_and_set(&locked, 1) != 0)
+      sched_yield();
+  }
+
+  inline void unlock()
+  {
+    __sync_lock_release(&locked);
+  }
+#endif
+
+  // Fills an empty free list with the blocks of a new chunk.  Called
+  // inside the lock.
+
+  void refill(size_t sizeClass)
+  {
+    const size_t blockSize = (sizeClass + 1) * granularity;
+    char *chunk = static_cast<char *>(::operator new(chunkSize));
+
+    for(size_t offset = 0; offset + blockSize <= chunkSize; offset += blockSize) {
+      FreeBlock *block = reinterpret_cast<FreeBlock *>(chunk + offset);
+      block->next = freeLists[sizeClass];
+      freeLists[sizeClass] = block;
+    }
+  }
+}
+
+void *TagLib::allocateSmall(size_t size)
+{
+  if(size == 0 || size > largestBlock)
+    return ::operator new(size);
+
+  const size_t sizeClass = (size - 1) / granularity;
+
+  lock();
+
+  if(!freeLists[sizeClass])
+    refill(sizeClass);
+
+  FreeBlock *block = freeLists[sizeClass];
+  freeLists[sizeClass] = block->next;
+
+  unlock();
+
+  return block;
+}
+
+void TagLib::releaseSmall(void *block, size_t size)
+{
+  if(!block)
+    return;
+
+  if(size == 0 || size > largestBlock) {
+    ::operator delete(block);
+    return;
+  }
+
+  const size_t sizeClass = (size - 1) / granularity;
+
+  lock();
+
+  FreeBlock *freeBlock = static_cast<FreeBlock *>(block);
+  freeBlock->next = freeLists[sizeClass];
+  freeLists[sizeClass] = freeBlock;
+
+  unlock();
+}
+
+#else
+
+void *TagLib::allocateSmall(size_t size)
+{
+  return ::operator new(size);
+}
+
+void TagLib::releaseSmall(void *block, size_t)
+{
+  ::operator delete(block);
+}
+
+#endif
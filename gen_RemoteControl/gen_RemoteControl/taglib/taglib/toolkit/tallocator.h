@@ -0,0 +1,72 @@
+/***************************************************************************
+ *   This library is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Lesser General Public License version   *
+ *   2.1 as published by the Free Software Foundation.                     *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful, but   *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU     *
+ *   Lesser General Public License for more details.                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU Lesser General Public      *
+ *   License along with this library; if not, write to the Free Software   *
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA         *
+ *   02110-1301  USA                                                       *
+ *                                                                         *
+ *   Alternatively, this file is available under the Mozilla Public        *
+ *   License Version 1.1.  You may obtain a copy of the License at         *
+ *   http://www.mozilla.org/MPL/                                           *
+ ***************************************************************************/
+
+#ifndef TAGLIB_ALLOCATOR_H
+#define TAGLIB_ALLOCATOR_H
+
+#include <stddef.h>
+
+namespace TagLib {
+
+#ifndef DO_NOT_DOCUMENT
+
+  /*!
+   * Allocates \a size bytes for one of the small private objects that every
+   * opened file creates by the hundreds.  If TagLib is built with
+   * WITH_POOLED_ALLOCATION the blocks come from free lists of fixed size
+   * blocks that are carved from larger chunks, a released block is reused by
+   * the next object of its size.  Otherwise this is ::operator new.
+   *
+   * The chunks are kept for the lifetime of the process, so the memory is
+   * recycled between files without going through the heap.  Objects are
+   * implicitly shared and may outlive the file they were read from, which is
+   * why the blocks aren't released together with the file.
+   *
+   * \internal
+   */
+  void *allocateSmall(size_t size);
+
+  /*!
+   * Releases a block from allocateSmall() with the same \a size.
+   *
+   * \internal
+   */
+  void releaseSmall(void *block, size_t size);
+
+  /*!
+   * Base class of the private classes that are allocated with
+   * allocateSmall().  Only for classes that are deleted through their own type
+   * or have a virtual destructor, the size that is passed to delete has to
+   * match.
+   *
+   * \internal
+   */
+  class SmallObject
+  {
+  public:
+    static void *operator new(size_t size) { return allocateSmall(size); }
+    static void operator delete(void *block, size_t size) { releaseSmall(block, size); }
+  };
+
+#endif
+
+}
+
+#endif
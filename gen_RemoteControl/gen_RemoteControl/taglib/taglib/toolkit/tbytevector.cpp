@@ -27,20 +27,12 @@
 
 #include <tstring.h>
 #include <tdebug.h>
+#include <tallocator.h>
 
 #include <string.h>
 
 #include "tbytevector.h"
 
-// This is a bit ugly to keep writing over and over again.
-
-// A rather obscure feature of the C++ spec that I hadn't thought of that makes
-// working with C libs much more effecient.  There's more here:
-//
-// http://www.informit.com/isapi/product_id~{9C84DAB4-FE6E-49C5-BB0A-FB50331233EA}/content/index.asp
-
-#define DATA(x) (&(x->data[0]))
-
 namespace TagLib {
   static const char hexTable[17] = "0123456789abcdef";
 
@@ -90,6 +82,30 @@ namespace TagLib {
     0xbcb4666d, 0xb8757bda, 0xb5365d03, 0xb1f740b4
   };
 
+  /*!
+   * The tables of the slice-by-8 checksum: tables[k][i] is the checksum of
+   * the byte i followed by k zero bytes, tables[0] is crcTable.
+   */
+
+  struct CrcSlices
+  {
+    CrcSlices()
+    {
+      for(int i = 0; i < 256; i++) {
+        tables[0][i] = crcTable[i];
+        for(int k = 1; k < 8; k++)
+          tables[k][i] = (tables[k - 1][i] << 8) ^ crcTable[tables[k - 1][i] >> 24];
+      }
+    }
+
+    uint tables[8][256];
+  };
+
+  // Built during the static initialization like the genre tables, see
+  // id3v1genres.cpp.
+
+  static const CrcSlices crcSlices;
+
   /*!
    * A templatized KMP find that works both with a ByteVector and a ByteVectorMirror.
    */
@@ -136,6 +152,58 @@ namespace TagLib {
     return -1;
   }
 
+  /*!
+   * Finds the first match of the pattern that starts at or after \a offset in
+   * raw data.  memchr() skips to the candidates for the first byte of the pattern
+   * and memcmp() checks the rest, both are vectorized by the C library so this is
+   * a lot faster than vectorFind() on data without many candidates, i.e. audio
+   * frames or garbage in front of a tag.  Only for a byte alignment of one.
+   */
+
+  int dataFind(const char *data, uint size, const char *pattern, uint patternSize, uint offset)
+  {
+    if(patternSize == 0 || patternSize > size || offset > size - patternSize)
+      return -1;
+
+    const char *p = data + offset;
+    const char *end = data + size - patternSize + 1;
+
+    while(p < end) {
+      p = static_cast<const char *>(::memchr(p, pattern[0], end - p));
+
+      if(!p)
+        return -1;
+
+      if(::memcmp(p + 1, pattern + 1, patternSize - 1) == 0)
+        return p - data;
+
+      ++p;
+    }
+
+    return -1;
+  }
+
+  /*!
+   * Finds the last match of the pattern that starts at or before \a last in raw
+   * data.  The reverse of dataFind().
+   */
+
+  int dataReverseFind(const char *data, uint size, const char *pattern, uint patternSize, uint last)
+  {
+    if(patternSize == 0 || patternSize > size)
+      return -1;
+
+    if(last > size - patternSize)
+      last = size - patternSize;
+
+    for(int i = last; i >= 0; --i) {
+      if(data[i] == pattern[0] && ::memcmp(data + i + 1, pattern + 1, patternSize - 1) == 0)
+        return i;
+    }
+
+    return -1;
+  }
+
   /*!
    * Wraps the accessors to a ByteVector to make the search algorithm access the
    * elements in reverse.
@@ -201,17 +269,17 @@ namespace TagLib {
   };
 
   template <class T>
-  T toNumber(const std::vector<char> &data, bool mostSignificantByteFirst)
+  T toNumber(const char *data, uint length, bool mostSignificantByteFirst)
   {
     T sum = 0;
 
-    if(data.size() <= 0) {
+    if(length == 0) {
       debug("ByteVectorMirror::toNumber<T>() -- data is empty, returning 0");
       return sum;
     }
 
     uint size = sizeof(T);
-    uint last = data.size() > size ? size - 1 : data.size() - 1;
+    uint last = length > size ? size - 1 : length - 1;
 
     for(uint i = 0; i <= last; i++)
       sum |= (T) uchar(data[i]) << ((mostSignificantByteFirst ? last - i : i) * 8);
@@ -235,18 +303,50 @@ namespace TagLib {
 
 using namespace TagLib;
 
-class ByteVector::ByteVectorPrivate : public RefCounter
+class ByteVector::ByteVectorPrivate : public RefCounter, public SmallObject
 {
 public:
-  ByteVectorPrivate() : RefCounter(), size(0) {}
-  ByteVectorPrivate(const std::vector<char> &v) : RefCounter(), data(v), size(v.size()) {}
-  ByteVectorPrivate(TagLib::uint len, char value) : RefCounter(), data(len, value), size(len) {}
+  ByteVectorPrivate() : RefCounter(), owner(0), offset(0), size(0) {}
+  ByteVectorPrivate(const char *begin, const char *end) :
+    RefCounter(), data(begin, end), owner(0), offset(0), size(end - begin) {}
+  ByteVectorPrivate(TagLib::uint len, char value) : RefCounter(), data(len, value), owner(0), offset(0), size(len) {}
+
+  // A slice of \a d, it shares the bytes of the vector that owns them.
+
+  ByteVectorPrivate(ByteVectorPrivate *d, TagLib::uint index, TagLib::uint length) :
+    RefCounter(), owner(d->owner ? d->owner : d), offset(d->offset + index), size(length)
+  {
+    owner->ref();
+  }
+
+  ~ByteVectorPrivate()
+  {
+    if(owner && owner->deref())
+      delete owner;
+  }
+
+  // The vector holding the bytes.  Neither one is changed while it is shared,
+  // ByteVector::detach() copies the bytes first.
+
+  std::vector<char> &buffer() { return owner ? owner->data : data; }
+
+  // Only valid if size is not zero.
+
+  char *bytes() { return &buffer()[offset]; }
+
+  // The own bytes, empty for slices.
 
   std::vector<char> data;
 
+  // The private of the vector a slice was taken from with mid(), 0 if the
+  // bytes are owned.
+
+  ByteVectorPrivate *owner;
+  TagLib::uint offset;
+
   // std::vector<T>::size() is very slow, so we'll cache the value
 
-  uint size;
+  TagLib::uint size;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -303,23 +403,20 @@ ByteVector::ByteVector(const ByteVector &v) : d(v.d)
 
 ByteVector::ByteVector(char c)
 {
-  d = new ByteVectorPrivate;
-  d->data.push_back(c);
-  d->size = 1;
+  d = new ByteVectorPrivate(1, c);
 }
 
 ByteVector::ByteVector(const char *data, uint length)
 {
-  d = new ByteVectorPrivate;
-  setData(data, length);
+  d = new ByteVectorPrivate(data, data + length);
 }
 
 ByteVector::ByteVector(const char *data)
 {
-  d = new ByteVectorPrivate;
-  setData(data);
+  d = new ByteVectorPrivate(data, data + ::strlen(data));
 }
 
+
 ByteVector::~ByteVector()
 {
   if(d->deref())
@@ -328,12 +425,15 @@ ByteVector::~ByteVector()
 
 ByteVector &ByteVector::setData(const char *data, uint length)
 {
-  detach();
-
-  resize(length);
-
-  if(length > 0)
-    ::memcpy(DATA(d), data, length);
+  if(d->owner || d->count() > 1) {
+    if(d->deref())
+      delete d;
+    d = new ByteVectorPrivate(data, data + length);
+  }
+  else {
+    d->data.assign(data, data + length);
+    d->size = length;
+  }
 
   return *this;
 }
@@ -346,46 +446,55 @@ ByteVector &ByteVector::setData(const char *data)
 char *ByteVector::data()
 {
   detach();
-  return size() > 0 ? DATA(d) : 0;
+  return size() > 0 ? d->bytes() : 0;
 }
 
 const char *ByteVector::data() const
 {
-  return size() > 0 ? DATA(d) : 0;
+  return size() > 0 ? d->bytes() : 0;
 }
 
 ByteVector ByteVector::mid(uint index, uint length) const
 {
-  ByteVector v;
-
   if(index > size())
-    return v;
+    return ByteVector();
 
-  ConstIterator endIt;
+  if(length > size() - index)
+    length = size() - index;
 
-  if(length < 0xffffffff && length + index < size())
-    endIt = d->data.begin() + index + length;
-  else
-    endIt = d->data.end();
+  if(length == size())
+    return *this;
 
-  v.d->data.insert(v.d->data.begin(), ConstIterator(d->data.begin() + index), endIt);
-  v.d->size = v.d->data.size();
+  if(length == 0)
+    return ByteVector();
 
-  return v;
+  return ByteVector(new ByteVectorPrivate(d, index, length));
 }
 
 char ByteVector::at(uint index) const
 {
-  return index < size() ? d->data[index] : 0;
+  return index < size() ? d->bytes()[index] : 0;
 }
 
 int ByteVector::find(const ByteVector &pattern, uint offset, int byteAlign) const
 {
+  if(byteAlign == 1 && pattern.size() > 0)
+    return dataFind(data(), size(), pattern.data(), pattern.size(), offset);
+
   return vectorFind<ByteVector>(*this, pattern, offset, byteAlign);
 }
 
 int ByteVector::rfind(const ByteVector &pattern, uint offset, int byteAlign) const
 {
+  // A match that starts at or before the offset, or anywhere if the offset is
+  // zero or the pattern doesn't fit in front of it.  The same as the mirrored
+  // search below.
+
+  if(byteAlign == 1 && pattern.size() > 0) {
+    const uint last = offset > 0 && offset + pattern.size() <= size() ? offset : size();
+    return dataReverseFind(data(), size(), pattern.data(), pattern.size(), last);
+  }
+
   // Ok, this is a little goofy, but pretty cool after it sinks in.  Instead of
   // reversing the find method's Boyer-Moore search algorithm I created a "mirror"
   // for a ByteVector to reverse the behavior of the accessors.
@@ -406,6 +515,11 @@ bool ByteVector::containsAt(const ByteVector &pattern, uint offset, uint pattern
   if(patternLength > size() || offset >= size() || patternOffset >= pattern.size() || patternLength == 0)
     return false;
 
+  // compare the raw data if the whole part of the pattern is inside the vector
+
+  if(patternLength > patternOffset && offset + patternLength - patternOffset <= size())
+    return ::memcmp(data() + offset, pattern.data() + patternOffset, patternLength - patternOffset) == 0;
+
   // loop through looking for a mismatch
 
   for(uint i = 0; i < patternLength - patternOffset; i++) {
@@ -443,8 +557,10 @@ ByteVector &ByteVector::replace(const ByteVector &pattern, const ByteVector &wit
     if(withSize > patternSize)
       resize(originalSize + withSize - patternSize);
 
-    if(patternSize != withSize)
-      ::memcpy(data() + offset + withSize, mid(offset + patternSize).data(), originalSize - offset - patternSize);
+    if(patternSize != withSize) {
+      char *bytes = data();
+      ::memmove(bytes + offset + withSize, bytes + offset + patternSize, originalSize - offset - patternSize);
+    }
 
     if(withSize < patternSize)
       resize(originalSize + withSize - patternSize);
@@ -480,20 +596,28 @@ ByteVector &ByteVector::append(const ByteVector &v)
   if(v.d->size == 0)
     return *this; // Simply return if appending nothing.
 
-  detach();
+  // v may be this vector or share its bytes, it stays valid as a copy
 
-  uint originalSize = d->size;
-  resize(d->size + v.d->size);
-  ::memcpy(DATA(d) + originalSize, DATA(v.d), v.size());
+  const ByteVector appended(v);
+  const uint originalSize = d->size;
+
+  resize(originalSize + appended.d->size);
+  ::memcpy(d->bytes() + originalSize, appended.d->bytes(), appended.d->size);
 
   return *this;
 }
 
 ByteVector &ByteVector::clear()
 {
-  detach();
-  d->data.clear();
-  d->size = 0;
+  if(d->owner || d->count() > 1) {
+    if(d->deref())
+      delete d;
+    d = new ByteVectorPrivate;
+  }
+  else {
+    d->data.clear();
+    d->size = 0;
+  }
 
   return *this;
 }
@@ -505,6 +629,18 @@ TagLib::uint ByteVector::size() const
 
 ByteVector &ByteVector::resize(uint size, char padding)
 {
+  if(size == d->size)
+    return *this;
+
+  // a slice that is only used here can be shortened without copying
+
+  if(d->owner && d->count() == 1 && size < d->size) {
+    d->size = size;
+    return *this;
+  }
+
+  detach();
+
   if(d->size < size) {
     d->data.reserve(size);
     d->data.insert(d->data.end(), size - d->size, padding);
@@ -519,22 +655,24 @@ ByteVector &ByteVector::resize(uint size, char padding)
 
 ByteVector::Iterator ByteVector::begin()
 {
-  return d->data.begin();
+  detach();
+  return d->buffer().begin() + d->offset;
 }
 
 ByteVector::ConstIterator ByteVector::begin() const
 {
-  return d->data.begin();
+  return d->buffer().begin() + d->offset;
 }
 
 ByteVector::Iterator ByteVector::end()
 {
-  return d->data.end();
+  detach();
+  return d->buffer().begin() + d->offset + d->size;
 }
 
 ByteVector::ConstIterator ByteVector::end() const
 {
-  return d->data.end();
+  return d->buffer().begin() + d->offset + d->size;
 }
 
 bool ByteVector::isNull() const
@@ -544,40 +682,73 @@ bool ByteVector::isNull() const
 
 bool ByteVector::isEmpty() const
 {
-  return d->data.size() == 0;
+  return d->size == 0;
 }
 
 TagLib::uint ByteVector::checksum() const
 {
+  // Eight bytes take one lookup in each of the slice tables, the rest is done
+  // byte by byte.  The bytes are read one at a time, so the data needs no
+  // alignment and the byte order of the CPU doesn't matter.
+
+  const uchar *p = reinterpret_cast<const uchar *>(data());
+  const uchar *last = p + size();
+  const uint (*t)[256] = crcSlices.tables;
+
   uint sum = 0;
-  for(ByteVector::ConstIterator it = begin(); it != end(); ++it)
-    sum = (sum << 8) ^ crcTable[((sum >> 24) & 0xff) ^ uchar(*it)];
+
+  while(last - p >= 8) {
+    sum ^= (uint(p[0]) << 24) | (uint(p[1]) << 16) | (uint(p[2]) << 8) | uint(p[3]);
+    sum = t[7][sum >> 24] ^ t[6][(sum >> 16) & 0xff] ^ t[5][(sum >> 8) & 0xff] ^ t[4][sum & 0xff] ^
+          t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+    p += 8;
+  }
+
+  while(p < last)
+    sum = (sum << 8) ^ crcTable[(sum >> 24) ^ *p++];
+
   return sum;
 }
 
 TagLib::uint ByteVector::toUInt(bool mostSignificantByteFirst) const
 {
-  return toNumber<uint>(d->data, mostSignificantByteFirst);
+  return toNumber<uint>(data(), size(), mostSignificantByteFirst);
+}
+
+TagLib::uint ByteVector::toUInt(uint offset, bool mostSignificantByteFirst) const
+{
+  return toUInt(offset, 4, mostSignificantByteFirst);
+}
+
+TagLib::uint ByteVector::toUInt(uint offset, uint length, bool mostSignificantByteFirst) const
+{
+  if(offset >= size())
+    return toNumber<uint>(0, 0, mostSignificantByteFirst);
+
+  if(length > size() - offset)
+    length = size() - offset;
+
+  return toNumber<uint>(data() + offset, length, mostSignificantByteFirst);
 }
 
 short ByteVector::toShort(bool mostSignificantByteFirst) const
 {
-  return toNumber<unsigned short>(d->data, mostSignificantByteFirst);
+  return toNumber<unsigned short>(data(), size(), mostSignificantByteFirst);
 }
 
 unsigned short ByteVector::toUShort(bool mostSignificantByteFirst) const
 {
-  return toNumber<unsigned short>(d->data, mostSignificantByteFirst);
+  return toNumber<unsigned short>(data(), size(), mostSignificantByteFirst);
 }
 
 long long ByteVector::toLongLong(bool mostSignificantByteFirst) const
 {
-  return toNumber<unsigned long long>(d->data, mostSignificantByteFirst);
+  return toNumber<unsigned long long>(data(), size(), mostSignificantByteFirst);
 }
 
 const char &ByteVector::operator[](int index) const
 {
-  return d->data[index];
+  return d->buffer()[d->offset + index];
 }
 
 char &ByteVector::operator[](int index)
@@ -592,6 +763,11 @@ bool ByteVector::operator==(const ByteVector &v) const
   if(d->size != v.d->size)
     return false;
 
+  // data() is zero for empty vectors, memcmp() must not see it.
+
+  if(d->size == 0)
+    return true;
+
   return ::memcmp(data(), v.data(), size()) == 0;
 }
 
@@ -605,6 +781,9 @@ bool ByteVector::operator==(const char *s) const
   if(d->size != ::strlen(s))
     return false;
 
+  if(d->size == 0)
+    return true;
+
   return ::memcmp(data(), s, d->size) == 0;
 }
 
@@ -615,7 +794,8 @@ bool ByteVector::operator!=(const char *s) const
 
 bool ByteVector::operator<(const ByteVector &v) const
 {
-  int result = ::memcmp(data(), v.data(), d->size < v.d->size ? d->size : v.d->size);
+  const uint length = d->size < v.d->size ? d->size : v.d->size;
+  const int result = length > 0 ? ::memcmp(data(), v.data(), length) : 0;
 
   if(result != 0)
     return result < 0;
@@ -664,9 +844,11 @@ ByteVector ByteVector::toHex() const
 {
   ByteVector encoded(size() * 2);
 
+  const char *bytes = data();
+
   uint j = 0;
   for(uint i = 0; i < size(); i++) {
-    unsigned char c = d->data[i];
+    unsigned char c = bytes[i];
     encoded[j++] = hexTable[(c >> 4) & 0x0F];
     encoded[j++] = hexTable[(c     ) & 0x0F];
   }
@@ -680,12 +862,30 @@ ByteVector ByteVector::toHex() const
 
 void ByteVector::detach()
 {
-  if(d->count() > 1) {
-    d->deref();
-    d = new ByteVectorPrivate(d->data);
+  if(d->owner || d->count() > 1) {
+    const char *bytes = d->size > 0 ? d->bytes() : 0;
+    ByteVectorPrivate *copy = new ByteVectorPrivate(bytes, bytes + d->size);
+    if(d->deref())
+      delete d;
+    d = copy;
   }
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// private members
+////////////////////////////////////////////////////////////////////////////////
+
+ByteVector::ByteVector(ByteVectorPrivate *p) : d(p)
+{
+
+}
+
+ByteVector::ByteVectorPrivate *ByteVector::nullData()
+{
+  null.d->ref();
+  return null.d;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // related functions
 ////////////////////////////////////////////////////////////////////////////////
@@ -66,6 +66,14 @@ namespace TagLib {
      */
     ByteVector(const ByteVector &v);
 
+#ifdef TAGLIB_HAVE_RVALUE_REFERENCES
+    /*!
+     * Contructs a byte vector that takes over the data of \a v.  \a v is left
+     * null.
+     */
+    ByteVector(ByteVector &&v) : d(v.d) { v.d = nullData(); }
+#endif
+
     /*!
      * Contructs a byte vector that contains \a c.
      */
@@ -118,6 +126,10 @@ namespace TagLib {
      * Returns a byte vector made up of the bytes starting at \a index and
      * for \a length bytes.  If \a length is not specified it will return the bytes
      * from \a index to the end of the vector.
+     *
+     * The returned vector shares the data with this one, nothing is copied
+     * until one of them is modified.  It keeps all of the data alive though,
+     * so a small part that is kept for long should be copied.
      */
     ByteVector mid(uint index, uint length = 0xffffffff) const;
 
@@ -255,6 +267,23 @@ namespace TagLib {
      */
     uint toUInt(bool mostSignificantByteFirst = true) const;
 
+    /*!
+     * Converts the 4 bytes at \a offset of the vector to an unsigned integer,
+     * the same as mid(offset, 4).toUInt() without creating the vector.
+     *
+     * \see toUInt()
+     */
+    uint toUInt(uint offset, bool mostSignificantByteFirst = true) const;
+
+    /*!
+     * Converts the \a length bytes at \a offset of the vector to an unsigned
+     * integer, the same as mid(offset, length).toUInt() without creating the
+     * vector.  \a length should not be larger than 4.
+     *
+     * \see toUInt()
+     */
+    uint toUInt(uint offset, uint length, bool mostSignificantByteFirst = true) const;
+
     /*!
      * Converts the first 2 bytes of the vector to a short.
      *
@@ -380,6 +409,13 @@ namespace TagLib {
      */
     ByteVector &operator=(const ByteVector &v);
 
+#ifdef TAGLIB_HAVE_RVALUE_REFERENCES
+    /*!
+     * Takes over the data of \a v.
+     */
+    ByteVector &operator=(ByteVector &&v) { ByteVectorPrivate *moved = v.d; v.d = d; d = moved; return *this; }
+#endif
+
     /*!
      * Copies ByteVector \a v.
      */
@@ -411,6 +447,13 @@ namespace TagLib {
 
   private:
     class ByteVectorPrivate;
+    ByteVector(ByteVectorPrivate *p);
+
+    // A new reference to the data of null.  The move members are inline, so
+    // they don't depend on the language version the library is built with.
+
+    static ByteVectorPrivate *nullData();
+
     ByteVectorPrivate *d;
   };
 
@@ -0,0 +1,154 @@
+/***************************************************************************
+ *   This library is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Lesser General Public License version   *
+ *   2.1 as published by the Free Software Foundation.                     *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful, but   *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU     *
+ *   Lesser General Public License for more details.                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU Lesser General Public      *
+ *   License along with this library; if not, write to the Free Software   *
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA         *
+ *   02110-1301  USA                                                       *
+ *                                                                         *
+ *   Alternatively, this file is available under the Mozilla Public        *
+ *   License Version 1.1.  You may obtain a copy of the License at         *
+ *   http://www.mozilla.org/MPL/                                           *
+ ***************************************************************************/
+
+#include "tbytevectorstream.h"
+
+#include <string.h>
+
+using namespace TagLib;
+
+class ByteVectorStream::ByteVectorStreamPrivate
+{
+public:
+  ByteVectorStreamPrivate(const ByteVector &data);
+
+  ByteVector data;
+  long position;
+};
+
+ByteVectorStream::ByteVectorStreamPrivate::ByteVectorStreamPrivate(const ByteVector &data) :
+  data(data),
+  position(0)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// public members
+////////////////////////////////////////////////////////////////////////////////
+
+ByteVectorStream::ByteVectorStream(const ByteVector &data)
+{
+  d = new ByteVectorStreamPrivate(data);
+}
+
+ByteVectorStream::~ByteVectorStream()
+{
+  delete d;
+}
+
+FileName ByteVectorStream::name() const
+{
+  return FileName("");
+}
+
+ByteVector ByteVectorStream::readBlock(ulong length)
+{
+  if(length == 0)
+    return ByteVector::null;
+
+  ByteVector v = d->data.mid(d->position, length);
+  d->position += v.size();
+  return v;
+}
+
+void ByteVectorStream::writeBlock(const ByteVector &data)
+{
+  if(data.isEmpty())
+    return;
+
+  const uint end = d->position + data.size();
+
+  if(end > d->data.size())
+    d->data.resize(end);
+
+  ::memcpy(d->data.data() + d->position, data.data(), data.size());
+  d->position = end;
+}
+
+void ByteVectorStream::insert(const ByteVector &data, ulong start, ulong replace)
+{
+  if(start > d->data.size())
+    start = d->data.size();
+
+  ByteVector v = d->data.mid(0, start);
+  v.append(data);
+  v.append(d->data.mid(start + replace));
+
+  d->data = v;
+  d->position = start + data.size();
+}
+
+void ByteVectorStream::removeBlock(ulong start, ulong length)
+{
+  if(start >= d->data.size() || length == 0)
+    return;
+
+  ByteVector v = d->data.mid(0, start);
+  v.append(d->data.mid(start + length));
+
+  d->data = v;
+  d->position = start;
+}
+
+bool ByteVectorStream::readOnly() const
+{
+  return false;
+}
+
+bool ByteVectorStream::isOpen() const
+{
+  return true;
+}
+
+void ByteVectorStream::seek(long offset, Position p)
+{
+  long position = offset;
+
+  if(p == Current)
+    position += d->position;
+  else if(p == End)
+    position += d->data.size();
+
+  // Like fseek(), which fails for a negative position.
+
+  if(position >= 0)
+    d->position = position;
+}
+
+long ByteVectorStream::tell() const
+{
+  return d->position;
+}
+
+long ByteVectorStream::length()
+{
+  return d->data.size();
+}
+
+void ByteVectorStream::truncate(long length)
+{
+  if(length >= 0 && ulong(length) < d->data.size())
+    d->data.resize(length);
+}
+
+ByteVector *ByteVectorStream::data()
+{
+  return &d->data;
+}
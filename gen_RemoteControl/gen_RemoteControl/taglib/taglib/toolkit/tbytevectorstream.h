@@ -0,0 +1,127 @@
+/***************************************************************************
+ *   This library is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Lesser General Public License version   *
+ *   2.1 as published by the Free Software Foundation.                     *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful, but   *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU     *
+ *   Lesser General Public License for more details.                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU Lesser General Public      *
+ *   License along with this library; if not, write to the Free Software   *
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA         *
+ *   02110-1301  USA                                                       *
+ *                                                                         *
+ *   Alternatively, this file is available under the Mozilla Public        *
+ *   License Version 1.1.  You may obtain a copy of the License at         *
+ *   http://www.mozilla.org/MPL/                                           *
+ ***************************************************************************/
+
+#ifndef TAGLIB_BYTEVECTORSTREAM_H
+#define TAGLIB_BYTEVECTORSTREAM_H
+
+#include "taglib_export.h"
+#include "taglib.h"
+#include "tbytevector.h"
+#include "tiostream.h"
+
+namespace TagLib {
+
+  //! A stream that reads and writes a ByteVector in memory
+
+  /*!
+   * This parses data that has already been read, i.e. the start of a file
+   * fetched from the network or a cached copy, without writing it to a file.
+   * Reads beyond the end of the data return less than the requested length,
+   * just like at the end of a file.
+   */
+
+  class TAGLIB_EXPORT ByteVectorStream : public IOStream
+  {
+  public:
+    /*!
+     * Constructs a stream of \a data.  This is a shallow, implicitly shared
+     * copy until the first write.
+     */
+    ByteVectorStream(const ByteVector &data);
+
+    /*!
+     * Destroys this ByteVectorStream instance.
+     */
+    virtual ~ByteVectorStream();
+
+    /*!
+     * Returns an empty name, the stream isn't a file.
+     */
+    FileName name() const;
+
+    /*!
+     * Reads a block of size \a length at the current get pointer.
+     */
+    ByteVector readBlock(ulong length);
+
+    /*!
+     * Writes the block \a data at the current get pointer, the data grows if
+     * it is written beyond its end.
+     */
+    void writeBlock(const ByteVector &data);
+
+    /*!
+     * Insert \a data at position \a start in the data overwriting \a replace
+     * bytes of the original content.
+     */
+    void insert(const ByteVector &data, ulong start = 0, ulong replace = 0);
+
+    /*!
+     * Removes a block of the data starting a \a start and continuing for
+     * \a length bytes.
+     */
+    void removeBlock(ulong start = 0, ulong length = 0);
+
+    /*!
+     * Returns false, the data can always be written.
+     */
+    bool readOnly() const;
+
+    /*!
+     * Returns true, the data is always open.
+     */
+    bool isOpen() const;
+
+    /*!
+     * Move the I/O pointer to \a offset in the data from position \a p.  This
+     * defaults to seeking from the beginning of the data.
+     *
+     * \see Position
+     */
+    void seek(long offset, Position p = Beginning);
+
+    /*!
+     * Returns the current offset within the data.
+     */
+    long tell() const;
+
+    /*!
+     * Returns the length of the data.
+     */
+    long length();
+
+    /*!
+     * Truncates the data to a \a length.
+     */
+    void truncate(long length);
+
+    /*!
+     * Returns the data with every change that has been written.
+     */
+    ByteVector *data();
+
+  private:
+    class ByteVectorStreamPrivate;
+    ByteVectorStreamPrivate *d;
+  };
+
+}
+
+#endif
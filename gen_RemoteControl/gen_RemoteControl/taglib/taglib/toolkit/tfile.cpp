@@ -24,24 +24,18 @@
  ***************************************************************************/
 
 #include "tfile.h"
+#include "tfilestream.h"
 #include "tstring.h"
 #include "tdebug.h"
 
-#include <stdio.h>
-#include <string.h>
-#include <sys/stat.h>
-
 #ifdef _WIN32
-# include <wchar.h>
-# include <windows.h>
 # include <io.h>
-# define ftruncate _chsize
+# include <windows.h>
 #else
 # include <unistd.h>
+# include <sys/time.h>
 #endif
 
-#include <stdlib.h>
-
 #ifndef R_OK
 # define R_OK 4
 #endif
@@ -51,71 +45,56 @@
 
 using namespace TagLib;
 
-#ifdef _WIN32
-
-typedef FileName FileNameHandle;
-
-#else
-
-struct FileNameHandle : public std::string
+namespace
 {
-  FileNameHandle(FileName name) : std::string(name) {}
-  operator FileName () const { return c_str(); }
-};
+  // Milliseconds of a monotonic clock, only differences are used.
 
+  uint milliseconds()
+  {
+#ifdef _WIN32
+    return GetTickCount();
+#else
+    timeval now;
+    gettimeofday(&now, 0);
+    return uint(now.tv_sec * 1000 + now.tv_usec / 1000);
 #endif
+  }
+}
 
 class File::FilePrivate
 {
 public:
-  FilePrivate(FileName fileName);
+  FilePrivate(IOStream *stream, bool owner);
 
-  FILE *file;
-
-  FileNameHandle name;
-
-  bool readOnly;
+  IOStream *stream;
+  bool streamOwner;
   bool valid;
-  ulong size;
-  static const uint bufferSize = 1024;
-};
-
-File::FilePrivate::FilePrivate(FileName fileName) :
-  file(0),
-  name(fileName),
-  readOnly(true),
-  valid(true),
-  size(0)
-{
-  // First try with read / write mode, if that fails, fall back to read only.
-
-#ifdef _WIN32
-
-  if(wcslen((const wchar_t *) fileName) > 0) {
-
-    file = _wfopen(name, L"rb+");
-
-    if(file)
-      readOnly = false;
-    else
-      file = _wfopen(name, L"rb");
 
-    if(file)
-      return;
+  // The parse limits, counted from the construction of the file.
 
-  }
-
-#endif
+  uint started;
+  ulong bytesRead;
+  bool limited;
 
-  file = fopen(name, "rb+");
+  static uint paddingSize;
+  static ulong maxBytes;
+  static ulong maxBlock;
+  static uint deadline;
+};
 
-  if(file)
-    readOnly = false;
-  else
-    file = fopen(name, "rb");
+TagLib::uint File::FilePrivate::paddingSize = 4096;
+TagLib::ulong File::FilePrivate::maxBytes = 0;
+TagLib::ulong File::FilePrivate::maxBlock = 0;
+TagLib::uint File::FilePrivate::deadline = 0;
 
-  if(!file)
-    debug("Could not open file " + String((const char *) name));
+File::FilePrivate::FilePrivate(IOStream *stream, bool owner) :
+  stream(stream),
+  streamOwner(owner),
+  valid(true),
+  started(deadline > 0 ? milliseconds() : 0),
+  bytesRead(0),
+  limited(false)
+{
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -124,59 +103,74 @@ File::FilePrivate::FilePrivate(FileName fileName) :
 
 File::File(FileName file)
 {
-  d = new FilePrivate(file);
+  d = new FilePrivate(new FileStream(file), true);
+}
+
+File::File(IOStream *stream)
+{
+  d = new FilePrivate(stream, false);
 }
 
 File::~File()
 {
-  if(d->file)
-    fclose(d->file);
+  if(d->streamOwner)
+    delete d->stream;
   delete d;
 }
 
 FileName File::name() const
 {
-  return d->name;
+  return d->stream->name();
 }
 
 ByteVector File::readBlock(ulong length)
 {
-  if(!d->file) {
-    debug("File::readBlock() -- Invalid File");
+  if(d->limited)
     return ByteVector::null;
+
+  // A block is only as large as what is left of the file, a bogus size field
+  // near the end doesn't count against the block limit.
+
+  if(FilePrivate::maxBlock > 0 && length > FilePrivate::maxBlock) {
+    const long left = d->stream->length() - d->stream->tell();
+    if(left >= 0 && length > ulong(left))
+      length = ulong(left);
+
+    if(length > FilePrivate::maxBlock) {
+      debug("File::readBlock() -- The block is larger than the parse limit.");
+      d->limited = true;
+      return ByteVector::null;
+    }
   }
 
-  if(length == 0)
+  if(FilePrivate::deadline > 0 && milliseconds() - d->started > FilePrivate::deadline) {
+    debug("File::readBlock() -- The parse deadline has passed.");
+    d->limited = true;
     return ByteVector::null;
+  }
 
-  if(length > FilePrivate::bufferSize &&
-     length > ulong(File::length()))
-  {
-    length = File::length();
+  ByteVector block = d->stream->readBlock(length);
+  d->bytesRead += block.size();
+
+  if(FilePrivate::maxBytes > 0 && d->bytesRead > FilePrivate::maxBytes) {
+    debug("File::readBlock() -- The file has been read up to the parse limit.");
+    d->limited = true;
   }
 
-  ByteVector v(static_cast<uint>(length));
-  const int count = fread(v.data(), sizeof(char), length, d->file);
-  v.resize(count);
-  return v;
+  return block;
 }
 
 void File::writeBlock(const ByteVector &data)
 {
-  if(!d->file)
+  if(d->limited)
     return;
 
-  if(d->readOnly) {
-    debug("File::writeBlock() -- attempted to write to a file that is not writable");
-    return;
-  }
-
-  fwrite(data.data(), sizeof(char), data.size(), d->file);
+  d->stream->writeBlock(data);
 }
 
 long File::find(const ByteVector &pattern, long fromOffset, const ByteVector &before)
 {
-  if(!d->file || pattern.size() > d->bufferSize)
+  if(!isOpen() || pattern.size() > bufferSize())
       return -1;
 
   // The position in the file that the current buffer starts at.
@@ -184,6 +178,15 @@ long File::find(const ByteVector &pattern, long fromOffset, const ByteVector &be
   long bufferOffset = fromOffset;
   ByteVector buffer;
 
+  // Most patterns are found in the first block, so the search starts with the
+  // small buffer and doubles it for every further block up to the scan buffer
+  // size.  The size of the previous block is needed for the partial matches.
+  // A search that stops at "before" keeps the small blocks, a match behind
+  // "before" in the same block would be found otherwise.
+
+  uint readSize = bufferSize();
+  int previousSize = 0;
+
   // These variables are used to keep track of a partial match that happens at
   // the end of a buffer.
 
@@ -217,20 +220,20 @@ long File::find(const ByteVector &pattern, long fromOffset, const ByteVector &be
   // then check for "before".  The order is important because it gives priority
   // to "real" matches.
 
-  for(buffer = readBlock(d->bufferSize); buffer.size() > 0; buffer = readBlock(d->bufferSize)) {
+  for(buffer = readBlock(readSize); buffer.size() > 0; buffer = readBlock(readSize)) {
 
     // (1) previous partial match
 
-    if(previousPartialMatch >= 0 && int(d->bufferSize) > previousPartialMatch) {
-      const int patternOffset = (d->bufferSize - previousPartialMatch);
+    if(previousPartialMatch >= 0 && previousSize > previousPartialMatch) {
+      const int patternOffset = (previousSize - previousPartialMatch);
       if(buffer.containsAt(pattern, 0, patternOffset)) {
         seek(originalPosition);
-        return bufferOffset - d->bufferSize + previousPartialMatch;
+        return bufferOffset - previousSize + previousPartialMatch;
       }
     }
 
-    if(!before.isNull() && beforePreviousPartialMatch >= 0 && int(d->bufferSize) > beforePreviousPartialMatch) {
-      const int beforeOffset = (d->bufferSize - beforePreviousPartialMatch);
+    if(!before.isNull() && beforePreviousPartialMatch >= 0 && previousSize > beforePreviousPartialMatch) {
+      const int beforeOffset = (previousSize - beforePreviousPartialMatch);
       if(buffer.containsAt(before, 0, beforeOffset)) {
         seek(originalPosition);
         return -1;
@@ -257,7 +260,11 @@ long File::find(const ByteVector &pattern, long fromOffset, const ByteVector &be
     if(!before.isNull())
       beforePreviousPartialMatch = buffer.endsWithPartialMatch(before);
 
-    bufferOffset += d->bufferSize;
+    previousSize = buffer.size();
+    bufferOffset += previousSize;
+
+    if(before.isNull() && readSize < FileStream::scanBufferSize())
+      readSize = readSize * 2 < FileStream::scanBufferSize() ? readSize * 2 : FileStream::scanBufferSize();
   }
 
   // Since we hit the end of the file, reset the status before continuing.
@@ -272,7 +279,7 @@ long File::find(const ByteVector &pattern, long fromOffset, const ByteVector &be
 
 long File::rfind(const ByteVector &pattern, long fromOffset, const ByteVector &before)
 {
-  if(!d->file || pattern.size() > d->bufferSize)
+  if(!isOpen() || pattern.size() > bufferSize())
       return -1;
 
   // The position in the file that the current buffer starts at.
@@ -296,17 +303,17 @@ long File::rfind(const ByteVector &pattern, long fromOffset, const ByteVector &b
 
   long bufferOffset;
   if(fromOffset == 0) {
-    seek(-1 * int(d->bufferSize), End);
+    seek(-1 * int(bufferSize()), End);
     bufferOffset = tell();
   }
   else {
-    seek(fromOffset + -1 * int(d->bufferSize), Beginning);
+    seek(fromOffset + -1 * int(bufferSize()), Beginning);
     bufferOffset = tell();
   }
 
   // See the notes in find() for an explanation of this algorithm.
 
-  for(buffer = readBlock(d->bufferSize); buffer.size() > 0; buffer = readBlock(d->bufferSize)) {
+  for(buffer = readBlock(bufferSize()); buffer.size() > 0; buffer = readBlock(bufferSize())) {
 
     // TODO: (1) previous partial match
 
@@ -325,7 +332,7 @@ long File::rfind(const ByteVector &pattern, long fromOffset, const ByteVector &b
 
     // TODO: (3) partial match
 
-    bufferOffset -= d->bufferSize;
+    bufferOffset -= bufferSize();
     seek(bufferOffset);
   }
 
@@ -340,137 +347,23 @@ long File::rfind(const ByteVector &pattern, long fromOffset, const ByteVector &b
 
 void File::insert(const ByteVector &data, ulong start, ulong replace)
 {
-  if(!d->file)
+  if(d->limited)
     return;
 
-  if(data.size() == replace) {
-    seek(start);
-    writeBlock(data);
-    return;
-  }
-  else if(data.size() < replace) {
-      seek(start);
-      writeBlock(data);
-      removeBlock(start + data.size(), replace - data.size());
-      return;
-  }
-
-  // Woohoo!  Faster (about 20%) than id3lib at last.  I had to get hardcore
-  // and avoid TagLib's high level API for rendering just copying parts of
-  // the file that don't contain tag data.
-  //
-  // Now I'll explain the steps in this ugliness:
-
-  // First, make sure that we're working with a buffer that is longer than
-  // the *differnce* in the tag sizes.  We want to avoid overwriting parts
-  // that aren't yet in memory, so this is necessary.
-
-  ulong bufferLength = bufferSize();
-
-  while(data.size() - replace > bufferLength)
-    bufferLength += bufferSize();
-
-  // Set where to start the reading and writing.
-
-  long readPosition = start + replace;
-  long writePosition = start;
-
-  ByteVector buffer;
-  ByteVector aboutToOverwrite(static_cast<uint>(bufferLength));
-
-  // This is basically a special case of the loop below.  Here we're just
-  // doing the same steps as below, but since we aren't using the same buffer
-  // size -- instead we're using the tag size -- this has to be handled as a
-  // special case.  We're also using File::writeBlock() just for the tag.
-  // That's a bit slower than using char *'s so, we're only doing it here.
-
-  seek(readPosition);
-  int bytesRead = fread(aboutToOverwrite.data(), sizeof(char), bufferLength, d->file);
-  readPosition += bufferLength;
-
-  seek(writePosition);
-  writeBlock(data);
-  writePosition += data.size();
-
-  buffer = aboutToOverwrite;
-
-  // In case we've already reached the end of file...
-
-  buffer.resize(bytesRead);
-
-  // Ok, here's the main loop.  We want to loop until the read fails, which
-  // means that we hit the end of the file.
-
-  while(!buffer.isEmpty()) {
-
-    // Seek to the current read position and read the data that we're about
-    // to overwrite.  Appropriately increment the readPosition.
-
-    seek(readPosition);
-    bytesRead = fread(aboutToOverwrite.data(), sizeof(char), bufferLength, d->file);
-    aboutToOverwrite.resize(bytesRead);
-    readPosition += bufferLength;
-
-    // Check to see if we just read the last block.  We need to call clear()
-    // if we did so that the last write succeeds.
-
-    if(ulong(bytesRead) < bufferLength)
-      clear();
-
-    // Seek to the write position and write our buffer.  Increment the
-    // writePosition.
-
-    seek(writePosition);
-    fwrite(buffer.data(), sizeof(char), buffer.size(), d->file);
-    writePosition += buffer.size();
-
-    // Make the current buffer the data that we read in the beginning.
-
-    buffer = aboutToOverwrite;
-
-    // Again, we need this for the last write.  We don't want to write garbage
-    // at the end of our file, so we need to set the buffer size to the amount
-    // that we actually read.
-
-    bufferLength = bytesRead;
-  }
+  d->stream->insert(data, start, replace);
 }
 
 void File::removeBlock(ulong start, ulong length)
 {
-  if(!d->file)
+  if(d->limited)
     return;
 
-  ulong bufferLength = bufferSize();
-
-  long readPosition = start + length;
-  long writePosition = start;
-
-  ByteVector buffer(static_cast<uint>(bufferLength));
-
-  ulong bytesRead = 1;
-
-  while(bytesRead != 0) {
-    seek(readPosition);
-    bytesRead = fread(buffer.data(), sizeof(char), bufferLength, d->file);
-    readPosition += bytesRead;
-
-    // Check to see if we just read the last block.  We need to call clear()
-    // if we did so that the last write succeeds.
-
-    if(bytesRead < bufferLength)
-      clear();
-
-    seek(writePosition);
-    fwrite(buffer.data(), sizeof(char), bytesRead, d->file);
-    writePosition += bytesRead;
-  }
-  truncate(writePosition);
+  d->stream->removeBlock(start, length);
 }
 
 bool File::readOnly() const
 {
-  return d->readOnly;
+  return d->stream->readOnly();
 }
 
 bool File::isReadable(const char *file)
@@ -480,7 +373,7 @@ bool File::isReadable(const char *file)
 
 bool File::isOpen() const
 {
-  return (d->file != NULL);
+  return d->stream->isOpen();
 }
 
 bool File::isValid() const
@@ -490,58 +383,59 @@ bool File::isValid() const
 
 void File::seek(long offset, Position p)
 {
-  if(!d->file) {
-    debug("File::seek() -- trying to seek in a file that isn't opened.");
-    return;
-  }
-
-  switch(p) {
-  case Beginning:
-    fseek(d->file, offset, SEEK_SET);
-    break;
-  case Current:
-    fseek(d->file, offset, SEEK_CUR);
-    break;
-  case End:
-    fseek(d->file, offset, SEEK_END);
-    break;
-  }
+  d->stream->seek(offset, IOStream::Position(p));
 }
 
 void File::clear()
 {
-  clearerr(d->file);
+  d->stream->clear();
 }
 
 long File::tell() const
 {
-  return ftell(d->file);
+  return d->stream->tell();
 }
 
 long File::length()
 {
-  // Do some caching in case we do multiple calls.
+  return d->stream->length();
+}
 
-  if(d->size > 0)
-    return d->size;
+bool File::isWritable(const char *file)
+{
+  return access(file, W_OK) == 0;
+}
 
-  if(!d->file)
-    return 0;
+TagLib::ulong File::ioCalls() const
+{
+  return d->stream->ioCalls();
+}
 
-  long curpos = tell();
+TagLib::ulong File::bytesRead() const
+{
+  return d->bytesRead;
+}
 
-  seek(0, End);
-  long endpos = tell();
+TagLib::uint File::paddingSize()
+{
+  return FilePrivate::paddingSize;
+}
 
-  seek(curpos, Beginning);
+void File::setPaddingSize(uint size)
+{
+  FilePrivate::paddingSize = size;
+}
 
-  d->size = endpos;
-  return endpos;
+bool File::limitExceeded() const
+{
+  return d->limited;
 }
 
-bool File::isWritable(const char *file)
+void File::setParseLimits(ulong maxBytes, ulong maxBlock, uint deadline)
 {
-  return access(file, W_OK) == 0;
+  FilePrivate::maxBytes = maxBytes;
+  FilePrivate::maxBlock = maxBlock;
+  FilePrivate::deadline = deadline;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -555,10 +449,22 @@ void File::setValid(bool valid)
 
 void File::truncate(long length)
 {
-  ftruncate(fileno(d->file), length);
+  if(d->limited)
+    return;
+
+  d->stream->truncate(length);
 }
 
 TagLib::uint File::bufferSize()
 {
-  return FilePrivate::bufferSize;
+  return FileStream::bufferSize();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// private members
+////////////////////////////////////////////////////////////////////////////////
+
+void File::takeStreamOwnership()
+{
+  d->streamOwner = true;
 }
@@ -29,6 +29,7 @@
 #include "taglib_export.h"
 #include "taglib.h"
 #include "tbytevector.h"
+#include "tiostream.h"
 
 namespace TagLib {
 
@@ -36,22 +37,6 @@ namespace TagLib {
   class Tag;
   class AudioProperties;
 
-#ifdef _WIN32
-  class TAGLIB_EXPORT FileName
-  {
-  public:
-    FileName(const wchar_t *name) : m_wname(name) {}
-    FileName(const char *name) : m_name(name) {}
-    operator const wchar_t *() const { return m_wname.c_str(); }
-    operator const char *() const { return m_name.c_str(); }
-  private:
-    std::string m_name;
-    std::wstring m_wname;
-  };
-#else
-  typedef const char *FileName;
-#endif
-
   //! A file class with some useful methods for tag manipulation
 
   /*!
@@ -75,6 +60,31 @@ namespace TagLib {
       End
     };
 
+    /*!
+     * Parts of a file that are read by the constructors taking a read mode.
+     * The values can be combined; everything that is not asked for is skipped
+     * by its size without being parsed.
+     *
+     * \note A file that has been read without ReadAllFrames can't be saved,
+     * the skipped parts would be lost.
+     */
+    enum ReadMode {
+      //! The fields of the Tag interface: title, artist, album, comment,
+      //! genre, year and track.
+      ReadBasicFields = 0x01,
+      //! The embedded pictures.
+      ReadPictures = 0x02,
+      //! The audio properties.
+      ReadAudioProperties = 0x04,
+      //! Every frame and metadata block, including the pictures.
+      ReadAllFrames = 0x08,
+      //! The fields that aren't part of the Tag interface, like lyrics,
+      //! ratings and the ReplayGain values, without the pictures.
+      ReadExtendedFields = 0x10,
+      //! Everything, the same as the constructors without a read mode.
+      ReadAll = 0x0f
+    };
+
     /*!
      * Destroys this File instance.
      */
@@ -135,6 +145,10 @@ namespace TagLib {
      * Searching starts at \a fromOffset, which defaults to the beginning of the
      * file.
      *
+     * The first block that is searched is bufferSize() bytes long, every further
+     * one is twice as long as the previous one up to the scan buffer size of
+     * FileStream unless \a before is set.
+     *
      * \note This has the practial limitation that \a pattern can not be longer
      * than the buffer size used by readBlock().  Currently this is 1024 bytes.
      */
@@ -230,6 +244,61 @@ namespace TagLib {
      */
     static bool isWritable(const char *name);
 
+    /*!
+     * Returns the number of read and write calls on the stream of the file,
+     * see IOStream::ioCalls().
+     */
+    ulong ioCalls() const;
+
+    /*!
+     * Returns the number of bytes readBlock() has returned since the file
+     * was opened.
+     */
+    ulong bytesRead() const;
+
+    /*!
+     * Returns the padding that is reserved behind a tag when it is written
+     * for the first time or no longer fits into its old space.  Later saves
+     * reuse the padding and only rewrite the file once it has run out.
+     *
+     * \see setPaddingSize()
+     */
+    static uint paddingSize();
+
+    /*!
+     * Sets the padding for the ID3v2 tags, FLAC metadata and MP4 item lists
+     * of all files, the default is 4 KB.  Files that get their tags edited
+     * often should reserve more, every save that doesn't fit rewrites
+     * everything behind the tag.
+     * This is not thread safe, it should be set before any file is saved.
+     *
+     * \see paddingSize()
+     */
+    static void setPaddingSize(uint size);
+
+    /*!
+     * Returns true if a read of this file has run into one of the parse
+     * limits.  Every read after that returns an empty block, so the tags and
+     * properties are only what was read before, and the file refuses to be
+     * written.
+     *
+     * \see setParseLimits()
+     */
+    bool limitExceeded() const;
+
+    /*!
+     * Sets the limits of every file that is opened afterwards: \a maxBytes
+     * read in total, \a maxBlock bytes read by one call, which is what gets
+     * allocated for it, and \a deadline milliseconds from the construction
+     * of the file.  0 means no limit, which is the default for all three.
+     * A corrupt size field or a file without a single frame fails fast
+     * instead of being read completely.  This is not thread safe, it should
+     * be set before any file is opened.
+     *
+     * \see limitExceeded()
+     */
+    static void setParseLimits(ulong maxBytes, ulong maxBlock, uint deadline);
+
   protected:
     /*!
      * Construct a File object and opens the \a file.  \a file should be a
@@ -240,6 +309,15 @@ namespace TagLib {
      */
     File(FileName file);
 
+    /*!
+     * Construct a File object that reads from \a stream.  The stream is not
+     * owned by the file, it has to stay valid until the file is destroyed.
+     *
+     * \note Constructor is protected since this class should only be
+     * instantiated through subclasses.
+     */
+    File(IOStream *stream);
+
     /*!
      * Marks the file as valid or invalid.
      *
@@ -258,9 +336,17 @@ namespace TagLib {
     static uint bufferSize();
 
   private:
+    friend class FileRef;
+
     File(const File &);
     File &operator=(const File &);
 
+    /*!
+     * Makes the file delete its stream when it is destroyed, FileRef passes the
+     * streams it has opened itself to File(IOStream *).
+     */
+    void takeStreamOwnership();
+
     class FilePrivate;
     FilePrivate *d;
   };
@@ -0,0 +1,745 @@
+/***************************************************************************
+ *   This library is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Lesser General Public License version   *
+ *   2.1 as published by the Free Software Foundation.                     *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful, but   *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU     *
+ *   Lesser General Public License for more details.                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU Lesser General Public      *
+ *   License along with this library; if not, write to the Free Software   *
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA         *
+ *   02110-1301  USA                                                       *
+ *                                                                         *
+ *   Alternatively, this file is available under the Mozilla Public        *
+ *   License Version 1.1.  You may obtain a copy of the License at         *
+ *   http://www.mozilla.org/MPL/                                           *
+ ***************************************************************************/
+
+#include "tfilestream.h"
+#include "tstring.h"
+#include "tdebug.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+# include <wchar.h>
+# include <windows.h>
+# include <io.h>
+# define ftruncate _chsize
+#else
+# include <unistd.h>
+# include <sys/mman.h>
+#endif
+
+#include <stdlib.h>
+
+using namespace TagLib;
+
+#ifdef _WIN32
+
+typedef FileName FileNameHandle;
+
+#else
+
+struct FileNameHandle : public std::string
+{
+  FileNameHandle(FileName name) : std::string(name) {}
+  operator FileName () const { return c_str(); }
+};
+
+#endif
+
+class FileStream::FileStreamPrivate
+{
+public:
+  FileStreamPrivate(FileName fileName);
+
+  void map();
+  void unmap();
+  bool isRemote() const;
+#ifdef _WIN32
+  bool readOverlapped(ulong headLength, long tailOffset, ulong tailLength);
+#endif
+
+  FILE *file;
+
+  // The contents of a memory mapped file or null, see setMemoryMapping().
+  // Reads, seeks and tell() use the map position instead of the file.  The
+  // file is only mapped once more than the scan buffer size has been read,
+  // the few reads of a tag probe are faster than setting up the map.
+
+  bool mapTried;
+  ulong bytesRead;
+  const char *data;
+  long dataSize;
+  long position;
+#ifdef _WIN32
+  HANDLE mapping;
+#endif
+
+  FileNameHandle name;
+
+  // The first bytes of the file once head() or prefetch() has been called, and
+  // the last bytes after prefetch().  Reads inside them are served from memory
+  // until the first write.
+
+  ByteVector head;
+  ByteVector tail;
+  long tailOffset;
+
+  bool readOnly;
+  ulong size;
+  ulong ioCalls;
+  static const uint bufferSize = 1024;
+  static uint scanBufferSize;
+  static bool memoryMapping;
+  static const long maxMappedSize = 256 * 1024 * 1024;
+};
+
+TagLib::uint FileStream::FileStreamPrivate::scanBufferSize = 65536;
+bool FileStream::FileStreamPrivate::memoryMapping = false;
+
+FileStream::FileStreamPrivate::FileStreamPrivate(FileName fileName) :
+  file(0),
+  mapTried(false),
+  bytesRead(0),
+  data(0),
+  dataSize(0),
+  position(0),
+#ifdef _WIN32
+  mapping(0),
+#endif
+  name(fileName),
+  tailOffset(0),
+  readOnly(true),
+  size(0),
+  ioCalls(0)
+{
+  // First try with read / write mode, if that fails, fall back to read only.
+
+#ifdef _WIN32
+
+  if(wcslen((const wchar_t *) fileName) > 0) {
+
+    file = _wfopen(name, L"rb+");
+
+    if(file)
+      readOnly = false;
+    else
+      file = _wfopen(name, L"rb");
+
+    if(file)
+      return;
+
+  }
+
+#endif
+
+  file = fopen(name, "rb+");
+
+  if(file)
+    readOnly = false;
+  else
+    file = fopen(name, "rb");
+
+  if(!file)
+    debug("Could not open file " + String((const char *) name));
+}
+
+void FileStream::FileStreamPrivate::map()
+{
+  if(!file)
+    return;
+
+#ifdef _WIN32
+
+  // Files on network drives are read through the FILE, every page fault of a
+  // map would be a round trip of its own.
+
+  if(isRemote())
+    return;
+
+  HANDLE handle = (HANDLE) _get_osfhandle(_fileno(file));
+
+  DWORD high = 0;
+  const DWORD low = GetFileSize(handle, &high);
+
+  if(low == INVALID_FILE_SIZE || high != 0 || low == 0 || low > ulong(maxMappedSize))
+    return;
+
+  mapping = CreateFileMappingW(handle, 0, PAGE_READONLY, 0, 0, 0);
+
+  if(!mapping)
+    return;
+
+  data = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+
+  if(!data) {
+    CloseHandle(mapping);
+    mapping = 0;
+    return;
+  }
+
+  dataSize = low;
+
+#else
+
+  struct stat st;
+
+  if(fstat(fileno(file), &st) != 0 || st.st_size == 0 || st.st_size > maxMappedSize)
+    return;
+
+  void *address = mmap(0, st.st_size, PROT_READ, MAP_SHARED, fileno(file), 0);
+
+  if(address == MAP_FAILED)
+    return;
+
+  data = static_cast<const char *>(address);
+  dataSize = st.st_size;
+
+#endif
+
+  position = ftell(file);
+}
+
+bool FileStream::FileStreamPrivate::isRemote() const
+{
+#ifdef _WIN32
+
+  const wchar_t *wideName = name;
+  const char *narrowName = name;
+
+  if(wcslen(wideName) > 0) {
+    if(wcsncmp(wideName, L"\\\\", 2) == 0)
+      return true;
+
+    if(wcslen(wideName) > 2 && wideName[1] == L':') {
+      const wchar_t root[] = { wideName[0], L':', L'\\', 0 };
+      return GetDriveTypeW(root) == DRIVE_REMOTE;
+    }
+  }
+  else {
+    if(strncmp(narrowName, "\\\\", 2) == 0)
+      return true;
+
+    if(strlen(narrowName) > 2 && narrowName[1] == ':') {
+      const char root[] = { narrowName[0], ':', '\\', 0 };
+      return GetDriveTypeA(root) == DRIVE_REMOTE;
+    }
+  }
+
+#endif
+
+  return false;
+}
+
+#ifdef _WIN32
+
+bool FileStream::FileStreamPrivate::readOverlapped(ulong headLength, long tailOffset, ulong tailLength)
+{
+  // A second handle of the file for overlapped reads, the FILE can't issue
+  // them.  Both reads are sent before waiting for the first one, a share
+  // answers them in one round trip.
+
+  const wchar_t *wideName = name;
+  const DWORD share = FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE;
+
+  HANDLE handle = wcslen(wideName) > 0 ?
+    CreateFileW(wideName, GENERIC_READ, share, 0, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, 0) :
+    CreateFileA(name, GENERIC_READ, share, 0, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, 0);
+
+  if(handle == INVALID_HANDLE_VALUE)
+    return false;
+
+  ByteVector buffers[2] = { ByteVector(uint(headLength), 0), ByteVector(uint(tailLength), 0) };
+  const long offsets[2] = { 0, tailOffset };
+  const int count = tailLength > 0 ? 2 : 1;
+
+  OVERLAPPED overlapped[2];
+  bool pending[2] = { false, false };
+  bool success = true;
+
+  memset(overlapped, 0, sizeof(overlapped));
+
+  for(int i = 0; i < count && success; i++) {
+    overlapped[i].Offset = DWORD(offsets[i]);
+    overlapped[i].hEvent = CreateEventW(0, TRUE, FALSE, 0);
+
+    if(!overlapped[i].hEvent)
+      success = false;
+    else if(ReadFile(handle, buffers[i].data(), DWORD(buffers[i].size()), 0, &overlapped[i]) ||
+            GetLastError() == ERROR_IO_PENDING)
+    {
+      pending[i] = true;
+      ioCalls++;
+    }
+    else
+      success = false;
+  }
+
+  for(int i = 0; i < count; i++) {
+    DWORD read = 0;
+
+    if(pending[i] && GetOverlappedResult(handle, &overlapped[i], &read, TRUE))
+      buffers[i].resize(read);
+    else
+      success = false;
+
+    if(overlapped[i].hEvent)
+      CloseHandle(overlapped[i].hEvent);
+  }
+
+  CloseHandle(handle);
+
+  if(!success)
+    return false;
+
+  head = buffers[0];
+  tail = buffers[1];
+  bytesRead += head.size() + tail.size();
+  return true;
+}
+
+#endif
+
+void FileStream::FileStreamPrivate::unmap()
+{
+  head.clear();
+  tail.clear();
+
+  if(!data)
+    return;
+
+  // Hand the position over to the FILE, every further access goes through it.
+  // A file is never mapped again after a write.
+
+  fseek(file, position, SEEK_SET);
+
+#ifdef _WIN32
+  UnmapViewOfFile(data);
+  CloseHandle(mapping);
+  mapping = 0;
+#else
+  munmap(const_cast<char *>(data), dataSize);
+#endif
+
+  data = 0;
+  dataSize = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// public members
+////////////////////////////////////////////////////////////////////////////////
+
+FileStream::FileStream(FileName file)
+{
+  d = new FileStreamPrivate(file);
+}
+
+FileStream::~FileStream()
+{
+  d->unmap();
+
+  if(d->file)
+    fclose(d->file);
+  delete d;
+}
+
+FileName FileStream::name() const
+{
+  return d->name;
+}
+
+ByteVector FileStream::readBlock(ulong length)
+{
+  if(!d->file) {
+    debug("FileStream::readBlock() -- Invalid File");
+    return ByteVector::null;
+  }
+
+  if(length == 0)
+    return ByteVector::null;
+
+  if(length > FileStreamPrivate::bufferSize &&
+     length > ulong(FileStream::length()))
+  {
+    length = FileStream::length();
+  }
+
+  if(!d->head.isEmpty() && !d->data) {
+    const long position = ftell(d->file);
+
+    if(position >= 0 && ulong(position) + length <= d->head.size()) {
+      fseek(d->file, position + length, SEEK_SET);
+      return d->head.mid(position, length);
+    }
+
+    if(!d->tail.isEmpty() && position >= d->tailOffset &&
+       ulong(position - d->tailOffset) + length <= d->tail.size())
+    {
+      fseek(d->file, position + length, SEEK_SET);
+      return d->tail.mid(position - d->tailOffset, length);
+    }
+  }
+
+  if(FileStreamPrivate::memoryMapping && !d->mapTried && d->bytesRead >= d->scanBufferSize) {
+    d->mapTried = true;
+    d->map();
+  }
+
+  if(d->data) {
+    const long count = d->position < d->dataSize ? d->dataSize - d->position : 0;
+    ByteVector v(d->data + d->position, static_cast<uint>(ulong(count) < length ? count : length));
+    d->position += v.size();
+    return v;
+  }
+
+  ByteVector v(static_cast<uint>(length));
+  const int count = fread(v.data(), sizeof(char), length, d->file);
+  d->ioCalls++;
+  d->bytesRead += count;
+  v.resize(count);
+  return v;
+}
+
+ByteVector FileStream::head()
+{
+  if(d->head.isEmpty() && d->file) {
+    const long position = tell();
+
+    seek(0);
+    d->head = readBlock(bufferSize());
+    seek(position);
+  }
+
+  return d->head;
+}
+
+void FileStream::prefetch(ulong headLength, ulong tailLength)
+{
+  if(!d->file || !d->head.isEmpty() || d->data)
+    return;
+
+  if(!d->isRemote()) {
+    head();
+    return;
+  }
+
+  const long fileLength = length();
+
+  if(headLength < bufferSize())
+    headLength = bufferSize();
+
+  // The windows don't overlap, a short file is fetched as a whole.
+
+  if(headLength >= ulong(fileLength)) {
+    headLength = fileLength;
+    tailLength = 0;
+  }
+  else if(headLength + tailLength > ulong(fileLength))
+    tailLength = fileLength - headLength;
+
+  const long offset = fileLength - long(tailLength);
+
+#ifdef _WIN32
+  if(d->readOverlapped(headLength, offset, tailLength)) {
+    d->tailOffset = offset;
+    return;
+  }
+#endif
+
+  const long position = tell();
+
+  seek(0);
+  ByteVector block = readBlock(headLength);
+
+  if(tailLength > 0) {
+    seek(offset);
+    d->tail = readBlock(tailLength);
+    d->tailOffset = offset;
+  }
+
+  d->head = block;
+  seek(position);
+}
+
+void FileStream::writeBlock(const ByteVector &data)
+{
+  if(!d->file)
+    return;
+
+  if(d->readOnly) {
+    debug("FileStream::writeBlock() -- attempted to write to a file that is not writable");
+    return;
+  }
+
+  d->unmap();
+
+  fwrite(data.data(), sizeof(char), data.size(), d->file);
+  d->ioCalls++;
+
+  // The write may have extended the file, see length().
+  d->size = 0;
+}
+
+void FileStream::insert(const ByteVector &data, ulong start, ulong replace)
+{
+  if(!d->file)
+    return;
+
+  d->unmap();
+
+  if(data.size() == replace) {
+    seek(start);
+    writeBlock(data);
+    return;
+  }
+  else if(data.size() < replace) {
+      seek(start);
+      writeBlock(data);
+      removeBlock(start + data.size(), replace - data.size());
+      return;
+  }
+
+  // Woohoo!  Faster (about 20%) than id3lib at last.  I had to get hardcore
+  // and avoid TagLib's high level API for rendering just copying parts of
+  // the file that don't contain tag data.
+  //
+  // Now I'll explain the steps in this ugliness:
+
+  // First, make sure that we're working with a buffer that is longer than
+  // the *differnce* in the tag sizes.  We want to avoid overwriting parts
+  // that aren't yet in memory, so this is necessary.
+
+  ulong bufferLength = scanBufferSize();
+
+  while(data.size() - replace > bufferLength)
+    bufferLength += bufferSize();
+
+  // Set where to start the reading and writing.
+
+  long readPosition = start + replace;
+  long writePosition = start;
+
+  ByteVector buffer;
+  ByteVector aboutToOverwrite(static_cast<uint>(bufferLength));
+
+  // This is basically a special case of the loop below.  Here we're just
+  // doing the same steps as below, but since we aren't using the same buffer
+  // size -- instead we're using the tag size -- this has to be handled as a
+  // special case.  We're also using FileStream::writeBlock() just for the tag.
+  // That's a bit slower than using char *'s so, we're only doing it here.
+
+  seek(readPosition);
+  int bytesRead = fread(aboutToOverwrite.data(), sizeof(char), bufferLength, d->file);
+  d->ioCalls++;
+  readPosition += bufferLength;
+
+  seek(writePosition);
+  writeBlock(data);
+  writePosition += data.size();
+
+  buffer = aboutToOverwrite;
+
+  // In case we've already reached the end of file...
+
+  buffer.resize(bytesRead);
+
+  // Ok, here's the main loop.  We want to loop until the read fails, which
+  // means that we hit the end of the file.
+
+  while(!buffer.isEmpty()) {
+
+    // Seek to the current read position and read the data that we're about
+    // to overwrite.  Appropriately increment the readPosition.
+
+    seek(readPosition);
+    bytesRead = fread(aboutToOverwrite.data(), sizeof(char), bufferLength, d->file);
+    d->ioCalls++;
+    aboutToOverwrite.resize(bytesRead);
+    readPosition += bufferLength;
+
+    // Check to see if we just read the last block.  We need to call clear()
+    // if we did so that the last write succeeds.
+
+    if(ulong(bytesRead) < bufferLength)
+      clear();
+
+    // Seek to the write position and write our buffer.  Increment the
+    // writePosition.
+
+    seek(writePosition);
+    fwrite(buffer.data(), sizeof(char), buffer.size(), d->file);
+    d->ioCalls++;
+    writePosition += buffer.size();
+
+    // Make the current buffer the data that we read in the beginning.
+
+    buffer = aboutToOverwrite;
+
+    // Again, we need this for the last write.  We don't want to write garbage
+    // at the end of our file, so we need to set the buffer size to the amount
+    // that we actually read.
+
+    bufferLength = bytesRead;
+  }
+}
+
+void FileStream::removeBlock(ulong start, ulong length)
+{
+  if(!d->file)
+    return;
+
+  d->unmap();
+
+  ulong bufferLength = scanBufferSize();
+
+  long readPosition = start + length;
+  long writePosition = start;
+
+  ByteVector buffer(static_cast<uint>(bufferLength));
+
+  ulong bytesRead = 1;
+
+  while(bytesRead != 0) {
+    seek(readPosition);
+    bytesRead = fread(buffer.data(), sizeof(char), bufferLength, d->file);
+    d->ioCalls++;
+    readPosition += bytesRead;
+
+    // Check to see if we just read the last block.  We need to call clear()
+    // if we did so that the last write succeeds.
+
+    if(bytesRead < bufferLength)
+      clear();
+
+    seek(writePosition);
+    fwrite(buffer.data(), sizeof(char), bytesRead, d->file);
+    d->ioCalls++;
+    writePosition += bytesRead;
+  }
+  truncate(writePosition);
+}
+
+bool FileStream::readOnly() const
+{
+  return d->readOnly;
+}
+
+bool FileStream::isOpen() const
+{
+  return (d->file != NULL);
+}
+
+void FileStream::seek(long offset, Position p)
+{
+  if(!d->file) {
+    debug("FileStream::seek() -- trying to seek in a file that isn't opened.");
+    return;
+  }
+
+  if(d->data) {
+    long position = offset;
+
+    if(p == Current)
+      position += d->position;
+    else if(p == End)
+      position += d->dataSize;
+
+    // Like fseek(), which fails for a negative position.
+
+    if(position >= 0)
+      d->position = position;
+
+    return;
+  }
+
+  switch(p) {
+  case Beginning:
+    fseek(d->file, offset, SEEK_SET);
+    break;
+  case Current:
+    fseek(d->file, offset, SEEK_CUR);
+    break;
+  case End:
+    fseek(d->file, offset, SEEK_END);
+    break;
+  }
+}
+
+void FileStream::clear()
+{
+  clearerr(d->file);
+}
+
+long FileStream::tell() const
+{
+  if(d->data)
+    return d->position;
+
+  return ftell(d->file);
+}
+
+long FileStream::length()
+{
+  // Do some caching in case we do multiple calls.
+
+  if(d->size > 0)
+    return d->size;
+
+  if(!d->file)
+    return 0;
+
+  long curpos = tell();
+
+  seek(0, End);
+  long endpos = tell();
+
+  seek(curpos, Beginning);
+
+  d->size = endpos;
+  return endpos;
+}
+
+TagLib::ulong FileStream::ioCalls() const
+{
+  return d->ioCalls;
+}
+
+TagLib::uint FileStream::scanBufferSize()
+{
+  return FileStreamPrivate::scanBufferSize;
+}
+
+void FileStream::setScanBufferSize(uint size)
+{
+  FileStreamPrivate::scanBufferSize = size > FileStreamPrivate::bufferSize ? size : FileStreamPrivate::bufferSize;
+}
+
+bool FileStream::isMapped() const
+{
+  return d->data != 0;
+}
+
+void FileStream::setMemoryMapping(bool enable)
+{
+  FileStreamPrivate::memoryMapping = enable;
+}
+
+void FileStream::truncate(long length)
+{
+  d->unmap();
+
+  ftruncate(fileno(d->file), length);
+  d->size = 0;
+}
+
+TagLib::uint FileStream::bufferSize()
+{
+  return FileStreamPrivate::bufferSize;
+}
@@ -0,0 +1,199 @@
+/***************************************************************************
+ *   This library is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Lesser General Public License version   *
+ *   2.1 as published by the Free Software Foundation.                     *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful, but   *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU     *
+ *   Lesser General Public License for more details.                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU Lesser General Public      *
+ *   License along with this library; if not, write to the Free Software   *
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA         *
+ *   02110-1301  USA                                                       *
+ *                                                                         *
+ *   Alternatively, this file is available under the Mozilla Public        *
+ *   License Version 1.1.  You may obtain a copy of the License at         *
+ *   http://www.mozilla.org/MPL/                                           *
+ ***************************************************************************/
+
+#ifndef TAGLIB_FILESTREAM_H
+#define TAGLIB_FILESTREAM_H
+
+#include "taglib_export.h"
+#include "taglib.h"
+#include "tbytevector.h"
+#include "tiostream.h"
+
+namespace TagLib {
+
+  //! A stream that reads and writes a file of the file system
+
+  /*!
+   * This is the stream of every File that is constructed from a file name.
+   * Long scans can read the file from a memory map, see setMemoryMapping().
+   */
+
+  class TAGLIB_EXPORT FileStream : public IOStream
+  {
+  public:
+    /*!
+     * Opens the file \a file, read / write if possible and read only
+     * otherwise.  \a file should be a C-string in the local file system
+     * encoding.
+     */
+    FileStream(FileName file);
+
+    /*!
+     * Closes the file and destroys this FileStream instance.
+     */
+    virtual ~FileStream();
+
+    /*!
+     * Returns the file name in the local file system encoding.
+     */
+    FileName name() const;
+
+    /*!
+     * Reads a block of size \a length at the current get pointer.
+     */
+    ByteVector readBlock(ulong length);
+
+    /*!
+     * Returns the first bufferSize() bytes of the file, fewer if it is shorter.
+     * They are read once and kept, later reads inside them are served from
+     * memory until the file is written.  FileRef detects the file type from them
+     * without reading the start of the file twice.
+     */
+    ByteVector head();
+
+    /*!
+     * Fetches the first \a headLength and the last \a tailLength bytes of a
+     * file on a network drive, reads inside them are then served from memory
+     * until the file is written.  On Windows both reads are issued at once with
+     * overlapped I/O, so the tags at both ends of the file cost one round trip.
+     * head() then returns the whole first window.  Files on local drives only
+     * read head(), their reads are cheap.  This does nothing once head() has
+     * been read.
+     */
+    void prefetch(ulong headLength, ulong tailLength);
+
+    /*!
+     * Attempts to write the block \a data at the current get pointer.  If the
+     * file is only opened read only -- i.e. readOnly() returns true -- this
+     * does nothing.
+     */
+    void writeBlock(const ByteVector &data);
+
+    /*!
+     * Insert \a data at position \a start in the file overwriting \a replace
+     * bytes of the original content.
+     *
+     * \note This method is slow since it requires rewriting all of the file
+     * after the insertion point.  It is copied in blocks of scanBufferSize().
+     */
+    void insert(const ByteVector &data, ulong start = 0, ulong replace = 0);
+
+    /*!
+     * Removes a block of the file starting a \a start and continuing for
+     * \a length bytes.
+     *
+     * \note This method is slow since it involves rewriting all of the file
+     * after the removed portion.  It is copied in blocks of scanBufferSize().
+     */
+    void removeBlock(ulong start = 0, ulong length = 0);
+
+    /*!
+     * Returns true if the file is read only (or if the file can not be opened).
+     */
+    bool readOnly() const;
+
+    /*!
+     * Returns true if the file could be opened.
+     */
+    bool isOpen() const;
+
+    /*!
+     * Move the I/O pointer to \a offset in the file from position \a p.  This
+     * defaults to seeking from the beginning of the file.
+     *
+     * \see Position
+     */
+    void seek(long offset, Position p = Beginning);
+
+    /*!
+     * Reset the end-of-file and error flags on the file.
+     */
+    void clear();
+
+    /*!
+     * Returns the current offset within the file.
+     */
+    long tell() const;
+
+    /*!
+     * Returns the length of the file.
+     */
+    long length();
+
+    /*!
+     * Truncates the file to a \a length.
+     */
+    void truncate(long length);
+
+    /*!
+     * Returns the number of read and write calls on the file since it has been
+     * opened.  Over a network every call is at least one round trip.
+     */
+    ulong ioCalls() const;
+
+    /*!
+     * Returns true if the file is read from a memory map, see
+     * setMemoryMapping().
+     */
+    bool isMapped() const;
+
+    /*!
+     * Returns the buffer size that is used for probing.
+     */
+    static uint bufferSize();
+
+    /*!
+     * Returns the size of the blocks that are used for long sequential I/O:
+     * scanning a file with File::find() and rewriting it with insert() and
+     * removeBlock().
+     *
+     * \see setScanBufferSize()
+     */
+    static uint scanBufferSize();
+
+    /*!
+     * Sets the size of the blocks of long sequential I/O for all files, the
+     * default is 64 KB.  It is never smaller than bufferSize(), which is still
+     * used for probing.  This is not thread safe, it should be set before any
+     * file is opened.
+     *
+     * \see scanBufferSize()
+     */
+    static void setScanBufferSize(uint size);
+
+    /*!
+     * Enables or disables memory mapping for the files that are opened
+     * afterwards, it is disabled by default.  A file is mapped once more than
+     * scanBufferSize() bytes have been read from it, readBlock() then copies
+     * from the map instead of calling fread() and seek() only moves the map
+     * position.  The first write to a file drops its map.  Files on network
+     * drives, empty files and files larger than 256 MB are never mapped.  This
+     * is not thread safe, it should be set before any file is opened.
+     */
+    static void setMemoryMapping(bool enable);
+
+  private:
+    class FileStreamPrivate;
+    FileStreamPrivate *d;
+  };
+
+}
+
+#endif
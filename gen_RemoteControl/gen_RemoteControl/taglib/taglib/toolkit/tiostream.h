@@ -0,0 +1,157 @@
+/***************************************************************************
+ *   This library is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Lesser General Public License version   *
+ *   2.1 as published by the Free Software Foundation.                     *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful, but   *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU     *
+ *   Lesser General Public License for more details.                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU Lesser General Public      *
+ *   License along with this library; if not, write to the Free Software   *
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA         *
+ *   02110-1301  USA                                                       *
+ *                                                                         *
+ *   Alternatively, this file is available under the Mozilla Public        *
+ *   License Version 1.1.  You may obtain a copy of the License at         *
+ *   http://www.mozilla.org/MPL/                                           *
+ ***************************************************************************/
+
+#ifndef TAGLIB_IOSTREAM_H
+#define TAGLIB_IOSTREAM_H
+
+#include "taglib_export.h"
+#include "taglib.h"
+#include "tbytevector.h"
+
+namespace TagLib {
+
+#ifdef _WIN32
+  class TAGLIB_EXPORT FileName
+  {
+  public:
+    FileName(const wchar_t *name) : m_wname(name) {}
+    FileName(const char *name) : m_name(name) {}
+    operator const wchar_t *() const { return m_wname.c_str(); }
+    operator const char *() const { return m_name.c_str(); }
+  private:
+    std::string m_name;
+    std::wstring m_wname;
+  };
+#else
+  typedef const char *FileName;
+#endif
+
+  //! An abstract class that provides operations on a sequence of bytes
+
+  /*!
+   * This is the storage underneath TagLib::File.  FileStream reads a file
+   * from the file system and ByteVectorStream data that is already in memory,
+   * other sources can be parsed by reimplementing this class.
+   */
+
+  class TAGLIB_EXPORT IOStream
+  {
+  public:
+    /*!
+     * Position in the stream used for seeking.
+     */
+    enum Position {
+      //! Seek from the beginning of the stream.
+      Beginning,
+      //! Seek from the current position in the stream.
+      Current,
+      //! Seek from the end of the stream.
+      End
+    };
+
+    IOStream();
+
+    /*!
+     * Destroys this IOStream instance.
+     */
+    virtual ~IOStream();
+
+    /*!
+     * Returns the stream name in the local file system encoding.
+     */
+    virtual FileName name() const = 0;
+
+    /*!
+     * Reads a block of size \a length at the current get pointer.
+     */
+    virtual ByteVector readBlock(ulong length) = 0;
+
+    /*!
+     * Attempts to write the block \a data at the current get pointer.  If the
+     * stream is read only -- i.e. readOnly() returns true -- this does
+     * nothing.
+     */
+    virtual void writeBlock(const ByteVector &data) = 0;
+
+    /*!
+     * Insert \a data at position \a start in the stream overwriting \a replace
+     * bytes of the original content.
+     */
+    virtual void insert(const ByteVector &data, ulong start = 0, ulong replace = 0) = 0;
+
+    /*!
+     * Removes a block of the stream starting a \a start and continuing for
+     * \a length bytes.
+     */
+    virtual void removeBlock(ulong start = 0, ulong length = 0) = 0;
+
+    /*!
+     * Returns true if the stream is read only.
+     */
+    virtual bool readOnly() const = 0;
+
+    /*!
+     * Returns true if the stream has been opened and can be read.
+     */
+    virtual bool isOpen() const = 0;
+
+    /*!
+     * Move the I/O pointer to \a offset in the stream from position \a p.  This
+     * defaults to seeking from the beginning of the stream.
+     *
+     * \see Position
+     */
+    virtual void seek(long offset, Position p = Beginning) = 0;
+
+    /*!
+     * Reset the end-of-stream and error flags of the stream.  The default
+     * implementation does nothing.
+     */
+    virtual void clear();
+
+    /*!
+     * Returns the current offset within the stream.
+     */
+    virtual long tell() const = 0;
+
+    /*!
+     * Returns the length of the stream.
+     */
+    virtual long length() = 0;
+
+    /*!
+     * Truncates the stream to a \a length.
+     */
+    virtual void truncate(long length) = 0;
+
+    /*!
+     * Returns the number of read and write calls on the underlying storage.
+     * The default implementation returns 0, for streams without such calls.
+     */
+    virtual ulong ioCalls() const;
+
+  private:
+    IOStream(const IOStream &);
+    IOStream &operator=(const IOStream &);
+  };
+
+}
+
+#endif
@@ -28,7 +28,7 @@
 
 #include "taglib.h"
 
-#include <list>
+#include <vector>
 
 namespace TagLib {
 
@@ -48,14 +48,19 @@ namespace TagLib {
    * return types of functions.  The above example will just copy a pointer rather
    * than copying the data in the list.  When your \e shared list's data changes,
    * only \e then will the data be copied.
+   *
+   * The items are stored contiguously, so iteration and operator[]() are
+   * cheap.  Like with std::vector, inserting or erasing items invalidates
+   * the iterators and references behind the position, and appending may
+   * invalidate all of them.
    */
 
   template <class T> class List
   {
   public:
 #ifndef DO_NOT_DOCUMENT
-    typedef typename std::list<T>::iterator Iterator;
-    typedef typename std::list<T>::const_iterator ConstIterator;
+    typedef typename std::vector<T>::iterator Iterator;
+    typedef typename std::vector<T>::const_iterator ConstIterator;
 #endif
 
     /*!
@@ -78,25 +83,25 @@ namespace TagLib {
 
     /*!
      * Returns an STL style iterator to the beginning of the list.  See
-     * std::list::const_iterator for the semantics.
+     * std::vector::const_iterator for the semantics.
      */
     Iterator begin();
 
     /*!
      * Returns an STL style constant iterator to the beginning of the list.  See
-     * std::list::iterator for the semantics.
+     * std::vector::iterator for the semantics.
      */
     ConstIterator begin() const;
 
     /*!
      * Returns an STL style iterator to the end of the list.  See
-     * std::list::iterator for the semantics.
+     * std::vector::iterator for the semantics.
      */
     Iterator end();
 
     /*!
      * Returns an STL style constant iterator to the end of the list.  See
-     * std::list::const_iterator for the semantics.
+     * std::vector::const_iterator for the semantics.
      */
     ConstIterator end() const;
 
@@ -52,11 +52,11 @@ template <class TP> class List<T>::ListPrivate  : public ListPrivateBase
 {
 public:
   ListPrivate() : ListPrivateBase() {}
-  ListPrivate(const std::list<TP> &l) : ListPrivateBase(), list(l) {}
+  ListPrivate(const std::vector<TP> &l) : ListPrivateBase(), list(l) {}
   void clear() {
     list.clear();
   }
-  std::list<TP> list;
+  std::vector<TP> list;
 };
 
 // A partial specialization for all pointer types that implements the
@@ -67,19 +67,19 @@ template <class TP> class List<T>::ListPrivate<TP *>  : public ListPrivateBase
 {
 public:
   ListPrivate() : ListPrivateBase() {}
-  ListPrivate(const std::list<TP *> &l) : ListPrivateBase(), list(l) {}
+  ListPrivate(const std::vector<TP *> &l) : ListPrivateBase(), list(l) {}
   ~ListPrivate() {
     clear();
   }
   void clear() {
     if(autoDelete) {
-      typename std::list<TP *>::const_iterator it = list.begin();
+      typename std::vector<TP *>::const_iterator it = list.begin();
       for(; it != list.end(); ++it)
         delete *it;
     }
     list.clear();
   }
-  std::list<TP *> list;
+  std::vector<TP *> list;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -142,12 +142,10 @@ template <class T>
 List<T> &List<T>::sortedInsert(const T &value, bool unique)
 {
   detach();
-  Iterator it = begin();
-  while(it != end() && *it < value)
-    ++it;
-  if(unique && it != end() && *it == value)
+  Iterator it = std::lower_bound(d->list.begin(), d->list.end(), value);
+  if(unique && it != d->list.end() && *it == value)
     return *this;
-  insert(it, value);
+  d->list.insert(it, value);
   return *this;
 }
 
@@ -171,7 +169,7 @@ template <class T>
 List<T> &List<T>::prepend(const T &item)
 {
   detach();
-  d->list.push_front(item);
+  d->list.insert(d->list.begin(), item);
   return *this;
 }
 
@@ -262,23 +260,14 @@ T &List<T>::back()
 template <class T>
 T &List<T>::operator[](uint i)
 {
-  Iterator it = d->list.begin();
-
-  for(uint j = 0; j < i; j++)
-    ++it;
-
-  return *it;
+  detach();
+  return d->list[i];
 }
 
 template <class T>
 const T &List<T>::operator[](uint i) const
 {
-  ConstIterator it = d->list.begin();
-
-  for(uint j = 0; j < i; j++)
-    ++it;
-
-  return *it;
+  return d->list[i];
 }
 
 template <class T>
@@ -308,8 +297,17 @@ template <class T>
 void List<T>::detach()
 {
   if(d->count() > 1) {
-    d->deref();
-    d = new ListPrivate<T>(d->list);
+    // The copy is made before the reference is given up, another thread may
+    // release the last other reference meanwhile.  The list is kept then, an
+    // auto deleting list would delete the items of the copy.
+
+    ListPrivate<T> *copy = new ListPrivate<T>(d->list);
+    if(d->deref()) {
+      d->ref();
+      delete copy;
+    }
+    else
+      d = copy;
   }
 }
 
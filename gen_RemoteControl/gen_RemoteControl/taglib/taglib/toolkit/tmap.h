@@ -27,39 +27,41 @@
 #define TAGLIB_MAP_H
 
 #include <map>
+#include <vector>
+#include <utility>
 using namespace std;
 
 #include "taglib.h"
 
 namespace TagLib {
 
+#ifndef DO_NOT_DOCUMENT
+  // The entries of a Map are kept in a vector and have to be assignable, so a
+  // const key type is stored as the plain type.
+  template <class Key> struct MapKey { typedef Key Type; };
+  template <class Key> struct MapKey<const Key> { typedef Key Type; };
+#endif
+
   //! A generic, implicitly shared map.
 
   /*!
    * This implements a standard map container that associates a key with a value
    * and has fast key-based lookups.  This map is also implicitly shared making
    * it suitable for pass-by-value usage.
+   *
+   * The entries are kept in a vector sorted by key and looked up with a binary
+   * search, the maps of the tags are small and mostly read.  Unlike with
+   * std::map, inserting or erasing entries invalidates the iterators and
+   * references to the entries behind the position.
    */
 
   template <class Key, class T> class Map
   {
   public:
 #ifndef DO_NOT_DOCUMENT
-#ifdef WANT_CLASS_INSTANTIATION_OF_MAP
-    // Some STL implementations get snippy over the use of the
-    // class keyword to distinguish different templates; Sun Studio
-    // in particular finds multiple specializations in certain rare
-    // cases and complains about that. GCC doesn't seem to mind,
-    // and uses the typedefs further below without the class keyword.
-    // Not all the specializations of Map can use the class keyword
-    // (when T is not actually a class type), so don't apply this
-    // generally.
-    typedef typename std::map<class Key, class T>::iterator Iterator;
-    typedef typename std::map<class Key, class T>::const_iterator ConstIterator;
-#else
-    typedef typename std::map<Key, T>::iterator Iterator;
-    typedef typename std::map<Key, T>::const_iterator ConstIterator;
-#endif
+    typedef std::pair<typename MapKey<Key>::Type, T> Entry;
+    typedef typename std::vector<Entry>::iterator Iterator;
+    typedef typename std::vector<Entry>::const_iterator ConstIterator;
 #endif
 
     /*!
@@ -81,25 +83,25 @@ namespace TagLib {
 
     /*!
      * Returns an STL style iterator to the beginning of the map.  See
-     * std::map::iterator for the semantics.
+     * std::vector::iterator for the semantics.
      */
     Iterator begin();
 
     /*!
      * Returns an STL style iterator to the beginning of the map.  See
-     * std::map::const_iterator for the semantics.
+     * std::vector::const_iterator for the semantics.
      */
     ConstIterator begin() const;
 
     /*!
      * Returns an STL style iterator to the end of the map.  See
-     * std::map::iterator for the semantics.
+     * std::vector::iterator for the semantics.
      */
     Iterator end();
 
     /*!
      * Returns an STL style iterator to the end of the map.  See
-     * std::map::const_iterator for the semantics.
+     * std::vector::const_iterator for the semantics.
      */
     ConstIterator end() const;
 
@@ -187,6 +189,12 @@ namespace TagLib {
 #ifndef DO_NOT_DOCUMENT
     template <class KeyP, class TP> class MapPrivate;
     MapPrivate<Key, T> *d;
+
+    /*
+     * Returns the position of the first entry whose key is not less than
+     * \a key, where the entry for \a key is or has to be inserted.
+     */
+    Iterator lowerBound(const Key &key) const;
 #endif
   };
 
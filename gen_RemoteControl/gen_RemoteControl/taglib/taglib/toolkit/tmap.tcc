@@ -35,13 +35,8 @@ class Map<Key, T>::MapPrivate : public RefCounter
 {
 public:
   MapPrivate() : RefCounter() {}
-#ifdef WANT_CLASS_INSTANTIATION_OF_MAP
-  MapPrivate(const std::map<class KeyP, class TP>& m) : RefCounter(), map(m) {}
-  std::map<class KeyP, class TP> map;
-#else
-  MapPrivate(const std::map<KeyP, TP>& m) : RefCounter(), map(m) {}
-  std::map<KeyP, TP> map;
-#endif
+  MapPrivate(const std::vector<Entry> &m) : RefCounter(), map(m) {}
+  std::vector<Entry> map;
 };
 
 template <class Key, class T>
@@ -93,7 +88,11 @@ template <class Key, class T>
 Map<Key, T> &Map<Key, T>::insert(const Key &key, const T &value)
 {
   detach();
-  d->map[key] = value;
+  Iterator it = lowerBound(key);
+  if(it != d->map.end() && !(key < it->first))
+    it->second = value;
+  else
+    d->map.insert(it, Entry(key, value));
   return *this;
 }
 
@@ -115,19 +114,26 @@ template <class Key, class T>
 typename Map<Key, T>::Iterator Map<Key, T>::find(const Key &key)
 {
   detach();
-  return d->map.find(key);
+  Iterator it = lowerBound(key);
+  if(it != d->map.end() && !(key < it->first))
+    return it;
+  return d->map.end();
 }
 
 template <class Key, class T>
 typename Map<Key,T>::ConstIterator Map<Key, T>::find(const Key &key) const
 {
-  return d->map.find(key);
+  ConstIterator it = lowerBound(key);
+  if(it != d->map.end() && !(key < it->first))
+    return it;
+  return d->map.end();
 }
 
 template <class Key, class T>
 bool Map<Key, T>::contains(const Key &key) const
 {
-  return d->map.find(key) != d->map.end();
+  ConstIterator it = lowerBound(key);
+  return it != d->map.end() && !(key < it->first);
 }
 
 template <class Key, class T>
@@ -142,8 +148,8 @@ template <class Key, class T>
 Map<Key, T> &Map<Key,T>::erase(const Key &key)
 {
   detach();
-  Iterator it = d->map.find(key);
-  if(it != d->map.end())
+  Iterator it = lowerBound(key);
+  if(it != d->map.end() && !(key < it->first))
     d->map.erase(it);
   return *this;
 }
@@ -157,14 +163,20 @@ TagLib::uint Map<Key, T>::size() const
 template <class Key, class T>
 const T &Map<Key, T>::operator[](const Key &key) const
 {
-  return d->map[key];
+  Iterator it = lowerBound(key);
+  if(it == d->map.end() || key < it->first)
+    it = d->map.insert(it, Entry(key, T()));
+  return it->second;
 }
 
 template <class Key, class T>
 T &Map<Key, T>::operator[](const Key &key)
 {
   detach();
-  return d->map[key];
+  Iterator it = lowerBound(key);
+  if(it == d->map.end() || key < it->first)
+    it = d->map.insert(it, Entry(key, T()));
+  return it->second;
 }
 
 template <class Key, class T>
@@ -188,9 +200,35 @@ template <class Key, class T>
 void Map<Key, T>::detach()
 {
   if(d->count() > 1) {
-    d->deref();
-    d = new MapPrivate<Key, T>(d->map);
+    MapPrivate<Key, T> *copy = new MapPrivate<Key, T>(d->map);
+    if(d->deref())
+      delete d;
+    d = copy;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// private members
+////////////////////////////////////////////////////////////////////////////////
+
+template <class Key, class T>
+typename Map<Key, T>::Iterator Map<Key, T>::lowerBound(const Key &key) const
+{
+  Iterator first = d->map.begin();
+  typename std::vector<Entry>::size_type count = d->map.size();
+
+  while(count > 0) {
+    typename std::vector<Entry>::size_type half = count / 2;
+    Iterator middle = first + half;
+    if(middle->first < key) {
+      first = middle + 1;
+      count -= half + 1;
+    }
+    else
+      count = half;
   }
+
+  return first;
 }
 
 } // namespace TagLib
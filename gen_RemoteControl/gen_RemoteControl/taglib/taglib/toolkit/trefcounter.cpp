@@ -0,0 +1,62 @@
+/***************************************************************************
+ *   This library is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Lesser General Public License version   *
+ *   2.1 as published by the Free Software Foundation.                     *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful, but   *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU     *
+ *   Lesser General Public License for more details.                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU Lesser General Public      *
+ *   License along with this library; if not, write to the Free Software   *
+ *   Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA         *
+ *   02110-1301  USA                                                       *
+ *                                                                         *
+ *   Alternatively, this file is available under the Mozilla Public        *
+ *   License Version 1.1.  You may obtain a copy of the License at         *
+ *   http://www.mozilla.org/MPL/                                           *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#ifdef _WIN32
+# include <windows.h>
+#endif
+
+#include "taglib.h"
+
+using namespace TagLib;
+
+////////////////////////////////////////////////////////////////////////////////
+// public members
+////////////////////////////////////////////////////////////////////////////////
+
+void RefCounter::ref()
+{
+#ifdef _WIN32
+  InterlockedIncrement(&refCount);
+#else
+  __sync_add_and_fetch(&refCount, 1);
+#endif
+}
+
+bool RefCounter::deref()
+{
+#ifdef _WIN32
+  return InterlockedDecrement(&refCount) == 0;
+#else
+  return __sync_sub_and_fetch(&refCount, 1) == 0;
+#endif
+}
+
+int RefCounter::count() const
+{
+#ifdef _WIN32
+  return InterlockedCompareExchange(const_cast<volatile long *>(&refCount), 0, 0);
+#else
+  return __sync_add_and_fetch(const_cast<volatile long *>(&refCount), 0);
+#endif
+}
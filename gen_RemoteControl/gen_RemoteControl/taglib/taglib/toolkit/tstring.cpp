@@ -26,6 +26,7 @@
 #include "tstring.h"
 #include "unicode.h"
 #include "tdebug.h"
+#include "tallocator.h"
 
 #include <ostream>
 
@@ -44,9 +45,94 @@ namespace TagLib {
   }
 }
 
+namespace
+{
+  // The characters are UTF-16 code units, wider wchar_t values are cut to 16
+  // bits the same way as for Unicode::ConvertUTF16toUTF8().
+
+  inline bool isHighSurrogate(TagLib::uint c)
+  {
+    return c >= 0xD800 && c <= 0xDBFF;
+  }
+
+  inline bool isLowSurrogate(TagLib::uint c)
+  {
+    return c >= 0xDC00 && c <= 0xDFFF;
+  }
+
+  TagLib::uint utf8Size(const TagLib::wchar *data, TagLib::uint length)
+  {
+    TagLib::uint size = 0;
+
+    for(TagLib::uint i = 0; i < length; i++) {
+      const TagLib::uint c = data[i] & 0xFFFF;
+
+      if(c < 0x80)
+        size += 1;
+      else if(c < 0x800)
+        size += 2;
+      else if(isHighSurrogate(c) && i + 1 < length && isLowSurrogate(data[i + 1] & 0xFFFF)) {
+        size += 4;
+        i++;
+      }
+      else
+        size += 3;
+    }
+
+    return size;
+  }
+
+  TagLib::uint writeUTF8(const TagLib::wchar *data, TagLib::uint length, char *buffer)
+  {
+    char *out = buffer;
+    TagLib::uint i = 0;
+
+    while(i < length) {
+
+      // ASCII, by far the most common case in tags
+
+      while(i < length && (data[i] & 0xFF80) == 0)
+        *out++ = char(data[i++]);
+
+      if(i == length)
+        break;
+
+      TagLib::uint c = data[i++] & 0xFFFF;
+
+      if(c < 0x800) {
+        *out++ = char(0xC0 | (c >> 6));
+      }
+      else {
+        if(isHighSurrogate(c) && i < length && isLowSurrogate(data[i] & 0xFFFF)) {
+          c = ((c - 0xD800) << 10) + ((data[i++] & 0xFFFF) - 0xDC00) + 0x10000;
+          *out++ = char(0xF0 | (c >> 18));
+          *out++ = char(0x80 | ((c >> 12) & 0x3F));
+        }
+        else
+          *out++ = char(0xE0 | (c >> 12));
+
+        *out++ = char(0x80 | ((c >> 6) & 0x3F));
+      }
+
+      *out++ = char(0x80 | (c & 0x3F));
+    }
+
+    return out - buffer;
+  }
+
+  // The UTF-8 forms end at the first zero character, like the C-String the
+  // conversion used to go through.  Tags often carry trailing zeros.
+
+  inline TagLib::uint lengthToNull(const TagLib::wstring &data)
+  {
+    const TagLib::wstring::size_type length = data.find(TagLib::wchar(0));
+    return TagLib::uint(length == TagLib::wstring::npos ? data.size() : length);
+  }
+}
+
 using namespace TagLib;
 
-class String::StringPrivate : public RefCounter
+class String::StringPrivate : public RefCounter, public SmallObject
 {
 public:
   StringPrivate(const wstring &s) :
@@ -85,6 +171,7 @@ String::String(const String &s) : d(s.d)
   d->ref();
 }
 
+
 String::String(const std::string &s, Type t)
 {
   d = new StringPrivate;
@@ -172,7 +259,8 @@ String::String(const ByteVector &v, Type t)
     int length = 0;
     d->data.resize(v.size());
     wstring::iterator targetIt = d->data.begin();
-    for(ByteVector::ConstIterator it = v.begin(); it != v.end() && (*it); ++it) {
+    const ByteVector::ConstIterator end = v.end();
+    for(ByteVector::ConstIterator it = v.begin(); it != end && (*it); ++it) {
       *targetIt = uchar(*it);
       ++targetIt;
       ++length;
@@ -182,9 +270,10 @@ String::String(const ByteVector &v, Type t)
   else  {
     d->data.resize(v.size() / 2);
     wstring::iterator targetIt = d->data.begin();
+    const ByteVector::ConstIterator end = v.end();
 
     for(ByteVector::ConstIterator it = v.begin();
-        it != v.end() && it + 1 != v.end() && combine(*it, *(it + 1));
+        it != end && it + 1 != end && combine(*it, *(it + 1));
         it += 2)
     {
       *targetIt = combine(*it, *(it + 1));
@@ -205,9 +294,9 @@ String::~String()
 std::string String::to8Bit(bool unicode) const
 {
   std::string s;
-  s.resize(d->data.size());
 
   if(!unicode) {
+    s.resize(d->data.size());
     std::string::iterator targetIt = s.begin();
     for(wstring::const_iterator it = d->data.begin(); it != d->data.end(); it++) {
       *targetIt = char(*it);
@@ -216,37 +305,21 @@ std::string String::to8Bit(bool unicode) const
     return s;
   }
 
-  const int outputBufferSize = d->data.size() * 3 + 1;
-
-  Unicode::UTF16 *sourceBuffer = new Unicode::UTF16[d->data.size() + 1];
-  Unicode::UTF8  *targetBuffer = new Unicode::UTF8[outputBufferSize];
-
-  for(unsigned int i = 0; i < d->data.size(); i++)
-    sourceBuffer[i] = Unicode::UTF16(d->data[i]);
-
-  const Unicode::UTF16 *source = sourceBuffer;
-  Unicode::UTF8 *target = targetBuffer;
-
-  Unicode::ConversionResult result =
-    Unicode::ConvertUTF16toUTF8(&source, sourceBuffer + d->data.size(),
-                                &target, targetBuffer + outputBufferSize,
-                                Unicode::lenientConversion);
-
-  if(result != Unicode::conversionOK)
-    debug("String::to8Bit() - Unicode conversion error.");
-
-  int newSize = target - targetBuffer;
-  s.resize(newSize);
-  targetBuffer[newSize] = 0;
-
-  s = (char *) targetBuffer;
+  const uint length = lengthToNull(d->data);
+  if(length == 0)
+    return s;
 
-  delete [] sourceBuffer;
-  delete [] targetBuffer;
+  s.resize(length * 3);
+  s.resize(writeUTF8(d->data.data(), length, &s[0]));
 
   return s;
 }
 
+TagLib::uint String::toUTF8(char *buffer, uint size) const
+{
+  return encodeUTF8(d->data.data(), lengthToNull(d->data), buffer, size);
+}
+
 TagLib::wstring String::toWString() const
 {
   return d->data;
@@ -254,11 +327,32 @@ TagLib::wstring String::toWString() const
 
 const char *String::toCString(bool unicode) const
 {
+  // The C-String is kept in the private data, which may be shared with copies
+  // in other threads (String::null is shared by all of them).  Empty strings
+  // don't need it and a shared string gets its own copy first.
+
+  if(isEmpty())
+    return "";
+
+  if(d->count() > 1)
+    const_cast<String *>(this)->detach();
+
   delete [] d->CString;
 
-  std::string buffer = to8Bit(unicode);
-  d->CString = new char[buffer.size() + 1];
-  strcpy(d->CString, buffer.c_str());
+  // The encoded string is written to the C-String directly.
+
+  if(unicode) {
+    const uint size = utf8Size(d->data.data(), d->data.size());
+    d->CString = new char[size + 1];
+    writeUTF8(d->data.data(), d->data.size(), d->CString);
+    d->CString[size] = 0;
+  }
+  else {
+    d->CString = new char[d->data.size() + 1];
+    for(uint i = 0; i < d->data.size(); i++)
+      d->CString[i] = char(d->data[i]);
+    d->CString[d->data.size()] = 0;
+  }
 
   return d->CString;
 }
@@ -500,6 +594,17 @@ bool String::isAscii() const
   return true;
 }
 
+TagLib::uint String::encodeUTF8(const wchar *data, uint length, char *buffer, uint size) // static
+{
+  if(size < length * 3) {
+    const uint needed = utf8Size(data, length);
+    if(needed > size)
+      return needed;
+  }
+
+  return writeUTF8(data, length, buffer);
+}
+
 String String::number(int n) // static
 {
   if(n == 0)
@@ -599,6 +704,7 @@ String &String::operator=(const String &s)
   return *this;
 }
 
+
 String &String::operator=(const std::string &s)
 {
   if(d->deref())
@@ -706,8 +812,10 @@ bool String::operator<(const String &s) const
 void String::detach()
 {
   if(d->count() > 1) {
-    d->deref();
-    d = new StringPrivate(d->data);
+    StringPrivate *copy = new StringPrivate(d->data);
+    if(d->deref())
+      delete d;
+    d = copy;
   }
 }
 
@@ -715,6 +823,12 @@ void String::detach()
 // private members
 ////////////////////////////////////////////////////////////////////////////////
 
+String::StringPrivate *String::nullData()
+{
+  null.d->ref();
+  return null.d;
+}
+
 void String::prepare(Type t)
 {
   switch(t) {
@@ -122,6 +122,13 @@ namespace TagLib {
      */
     String(const String &s);
 
+#ifdef TAGLIB_HAVE_RVALUE_REFERENCES
+    /*!
+     * Takes over the data of \a s.  \a s is left null.
+     */
+    String(String &&s) : d(s.d) { s.d = nullData(); }
+#endif
+
     /*!
      * Makes a deep copy of the data in \a s.
      *
@@ -178,10 +185,23 @@ namespace TagLib {
     /*!
      * If \a unicode if false (the default) this will return a \e Latin1 encoded
      * std::string.  If it is true the returned std::wstring will be UTF-8
-     * encoded.
+     * encoded and ends at the first zero character.
      */
     std::string to8Bit(bool unicode = false) const;
 
+    /*!
+     * Writes the string up to its first zero character UTF-8 encoded to
+     * \a buffer, which has room for \a size bytes, without a terminating
+     * zero.  Returns the size of the encoded string.  If that is larger than
+     * \a size nothing is written, so the size can be asked for with a null
+     * buffer first.
+     *
+     * This is meant for reusing a buffer for many strings.
+     *
+     * \see encodeUTF8()
+     */
+    uint toUTF8(char *buffer, uint size) const;
+
     /*!
      * Returns a wstring version of the TagLib string as a wide string.
      */
@@ -334,6 +354,18 @@ namespace TagLib {
      */
     static String number(int n);
 
+    /*!
+     * Encodes \a length UTF-16 characters of \a data as UTF-8 to \a buffer,
+     * which has room for \a size bytes, without a terminating zero.  Returns
+     * the size of the encoded data.  If that is larger than \a size nothing is
+     * written.  A buffer of 3 * \a length bytes is always large enough, with
+     * such a buffer the size isn't computed first.
+     *
+     * ASCII characters are copied in runs.  Unpaired surrogates are encoded
+     * like other characters, as TagLib always did.
+     */
+    static uint encodeUTF8(const wchar *data, uint length, char *buffer, uint size);
+
     /*!
      * Returns a reference to the character at position \a i.
      */
@@ -381,6 +413,13 @@ namespace TagLib {
      */
     String &operator=(const String &s);
 
+#ifdef TAGLIB_HAVE_RVALUE_REFERENCES
+    /*!
+     * Takes over the data of \a s.
+     */
+    String &operator=(String &&s) { StringPrivate *moved = s.d; s.d = d; d = moved; return *this; }
+#endif
+
     /*!
      * Performs a deep copy of the data in \a s.
      */
@@ -446,6 +485,11 @@ namespace TagLib {
     void prepare(Type t);
 
     class StringPrivate;
+
+    // A new reference to the data of null, for the inline move members.
+
+    static StringPrivate *nullData();
+
     StringPrivate *d;
   };
 
@@ -36,6 +36,7 @@
 #include "id3v1tag.h"
 #include "id3v2tag.h"
 #include "id3v2header.h"
+#include "apetrailer.h"
 
 using namespace TagLib;
 
@@ -54,7 +55,8 @@ public:
     ID3v1Location(-1),
     properties(0),
     hasID3v1(false),
-    hasID3v2(false) {}
+    hasID3v2(false),
+    readMode(TagLib::File::ReadAll) {}
 
   ~FilePrivate()
   {
@@ -76,6 +78,8 @@ public:
 
   bool hasID3v1;
   bool hasID3v2;
+
+  int readMode;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -90,6 +94,14 @@ TrueAudio::File::File(FileName file, bool readProperties,
     read(readProperties, propertiesStyle);
 }
 
+TrueAudio::File::File(IOStream *stream, bool readProperties,
+                 Properties::ReadStyle propertiesStyle) : TagLib::File(stream)
+{
+  d = new FilePrivate;
+  if(isOpen())
+    read(readProperties, propertiesStyle);
+}
+
 TrueAudio::File::File(FileName file, ID3v2::FrameFactory *frameFactory,
                  bool readProperties, Properties::ReadStyle propertiesStyle) :
   TagLib::File(file)
@@ -99,6 +111,33 @@ TrueAudio::File::File(FileName file, ID3v2::FrameFactory *frameFactory,
     read(readProperties, propertiesStyle);
 }
 
+TrueAudio::File::File(IOStream *stream, ID3v2::FrameFactory *frameFactory,
+                 bool readProperties, Properties::ReadStyle propertiesStyle) :
+  TagLib::File(stream)
+{
+  d = new FilePrivate(frameFactory);
+  if(isOpen())
+    read(readProperties, propertiesStyle);
+}
+
+TrueAudio::File::File(FileName file, int readMode,
+                 Properties::ReadStyle propertiesStyle) : TagLib::File(file)
+{
+  d = new FilePrivate;
+  d->readMode = readMode;
+  if(isOpen())
+    read((readMode & ReadAudioProperties) != 0, propertiesStyle);
+}
+
+TrueAudio::File::File(IOStream *stream, int readMode,
+                 Properties::ReadStyle propertiesStyle) : TagLib::File(stream)
+{
+  d = new FilePrivate;
+  d->readMode = readMode;
+  if(isOpen())
+    read((readMode & ReadAudioProperties) != 0, propertiesStyle);
+}
+
 TrueAudio::File::~File()
 {
   delete d;
@@ -121,6 +160,11 @@ void TrueAudio::File::setID3v2FrameFactory(const ID3v2::FrameFactory *factory)
 
 bool TrueAudio::File::save()
 {
+  if(!(d->readMode & ReadAllFrames)) {
+    debug("TrueAudio::File::save() -- The file has not been read completely.");
+    return false;
+  }
+
   if(readOnly()) {
     debug("TrueAudio::File::save() -- File is read only.");
     return false;
@@ -198,75 +242,65 @@ void TrueAudio::File::strip(int tags)
 // private members
 ////////////////////////////////////////////////////////////////////////////////
 
-void TrueAudio::File::read(bool readProperties, Properties::ReadStyle /* propertiesStyle */)
+void TrueAudio::File::read(bool readProperties, Properties::ReadStyle propertiesStyle)
 {
-  // Look for an ID3v2 tag
-
-  d->ID3v2Location = findID3v2();
-
-  if(d->ID3v2Location >= 0) {
+  if(!isValid())
+    return;
 
-    d->tag.set(ID3v2Index, new ID3v2::Tag(this, d->ID3v2Location, d->ID3v2FrameFactory));
+  const bool readTags = (d->readMode & (ReadBasicFields | ReadExtendedFields | ReadAllFrames)) != 0;
 
-    d->ID3v2OriginalSize = ID3v2Tag()->header()->completeTagSize();
+  // The start of the file holds the stream header or the header of an ID3v2
+  // tag, it is read once.
 
-    if(ID3v2Tag()->header()->tagSize() <= 0)
-      d->tag.set(ID3v2Index, 0);
-    else
-      d->hasID3v2 = true;
-  }
+  seek(0);
+  ByteVector header = readBlock(TrueAudio::HeaderSize);
 
-  // Look for an ID3v1 tag
+  if(header.startsWith(ID3v2::Header::fileIdentifier()) && header.size() >= ID3v2::Header::size()) {
+    d->ID3v2Location = 0;
 
-  d->ID3v1Location = findID3v1();
+    if(readTags) {
+      d->tag.set(ID3v2Index, new ID3v2::Tag(this, d->ID3v2Location, d->ID3v2FrameFactory, d->readMode));
 
-  if(d->ID3v1Location >= 0) {
-    d->tag.set(ID3v1Index, new ID3v1::Tag(this, d->ID3v1Location));
-    d->hasID3v1 = true;
-  }
+      d->ID3v2OriginalSize = ID3v2Tag()->header()->completeTagSize();
 
-  if(!d->hasID3v1)
-    ID3v2Tag(true);
-
-  // Look for TrueAudio metadata
-
-  if(readProperties) {
-    if(d->ID3v2Location >= 0) {
-      seek(d->ID3v2Location + d->ID3v2OriginalSize);
-      d->properties = new Properties(readBlock(TrueAudio::HeaderSize),
-                                     length() - d->ID3v2OriginalSize);
+      if(ID3v2Tag()->header()->tagSize() <= 0)
+        d->tag.set(ID3v2Index, 0);
+      else
+        d->hasID3v2 = true;
     }
     else {
-      seek(0);
-      d->properties = new Properties(readBlock(TrueAudio::HeaderSize),
-                                     length());
+      const ID3v2::Header tagHeader(header.mid(0, ID3v2::Header::size()));
+
+      d->ID3v2OriginalSize = tagHeader.completeTagSize();
+      d->hasID3v2 = tagHeader.tagSize() > 0;
+    }
+
+    if(readProperties) {
+      seek(d->ID3v2OriginalSize);
+      header = readBlock(TrueAudio::HeaderSize);
     }
   }
-}
 
-long TrueAudio::File::findID3v1()
-{
-  if(!isValid())
-    return -1;
+  // Look for an ID3v1 tag, the probe reads it along with the end of the file
 
-  seek(-128, End);
-  long p = tell();
+  const APE::Trailer trailer(this);
 
-  if(readBlock(3) == ID3v1::Tag::fileIdentifier())
-    return p;
+  d->ID3v1Location = trailer.ID3v1Location();
 
-  return -1;
-}
+  if(d->ID3v1Location >= 0) {
+    if(readTags)
+      d->tag.set(ID3v1Index, new ID3v1::Tag(this, d->ID3v1Location, trailer.ID3v1Data()));
+    d->hasID3v1 = true;
+  }
 
-long TrueAudio::File::findID3v2()
-{
-  if(!isValid())
-    return -1;
+  if(!d->hasID3v1)
+    ID3v2Tag(true);
 
-  seek(0);
+  // Look for TrueAudio metadata, the stream lies between the tags
 
-  if(readBlock(3) == ID3v2::Header::fileIdentifier())
-    return 0;
+  if(readProperties) {
+    const long streamEnd = d->hasID3v1 ? d->ID3v1Location : length();
 
-  return -1;
+    d->properties = new Properties(header, streamEnd - long(d->ID3v2OriginalSize), propertiesStyle);
+  }
 }
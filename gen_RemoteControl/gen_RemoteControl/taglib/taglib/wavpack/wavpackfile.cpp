@@ -37,6 +37,7 @@
 #include "id3v2header.h"
 #include "apetag.h"
 #include "apefooter.h"
+#include "apetrailer.h"
 
 using namespace TagLib;
 
@@ -54,7 +55,8 @@ public:
     ID3v1Location(-1),
     properties(0),
     hasAPE(false),
-    hasID3v1(false) {}
+    hasID3v1(false),
+    readMode(TagLib::File::ReadAll) {}
 
   ~FilePrivate()
   {
@@ -75,6 +77,8 @@ public:
 
   bool hasAPE;
   bool hasID3v1;
+
+  int readMode;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -88,6 +92,29 @@ WavPack::File::File(FileName file, bool readProperties,
   read(readProperties, propertiesStyle);
 }
 
+WavPack::File::File(IOStream *stream, bool readProperties,
+                Properties::ReadStyle propertiesStyle) : TagLib::File(stream)
+{
+  d = new FilePrivate;
+  read(readProperties, propertiesStyle);
+}
+
+WavPack::File::File(FileName file, int readMode,
+                Properties::ReadStyle propertiesStyle) : TagLib::File(file)
+{
+  d = new FilePrivate;
+  d->readMode = readMode;
+  read((readMode & ReadAudioProperties) != 0, propertiesStyle);
+}
+
+WavPack::File::File(IOStream *stream, int readMode,
+                Properties::ReadStyle propertiesStyle) : TagLib::File(stream)
+{
+  d = new FilePrivate;
+  d->readMode = readMode;
+  read((readMode & ReadAudioProperties) != 0, propertiesStyle);
+}
+
 WavPack::File::~File()
 {
   delete d;
@@ -105,6 +132,11 @@ WavPack::Properties *WavPack::File::audioProperties() const
 
 bool WavPack::File::save()
 {
+  if(!(d->readMode & ReadAllFrames)) {
+    debug("WavPack::File::save() -- The file has not been read completely.");
+    return false;
+  }
+
   if(readOnly()) {
     debug("WavPack::File::save() -- File is read only.");
     return false;
@@ -201,67 +233,46 @@ void WavPack::File::strip(int tags)
 // private members
 ////////////////////////////////////////////////////////////////////////////////
 
-void WavPack::File::read(bool readProperties, Properties::ReadStyle /* propertiesStyle */)
+void WavPack::File::read(bool readProperties, Properties::ReadStyle propertiesStyle)
 {
-  // Look for an ID3v1 tag
+  // Look for an ID3v1 and an APE tag, the end of the file is read once.  The
+  // probe also tells where the stream ends when the tags aren't parsed.
 
-  d->ID3v1Location = findID3v1();
+  const APE::Trailer trailer(this);
+  const bool readTags = (d->readMode & (ReadBasicFields | ReadExtendedFields | ReadAllFrames)) != 0;
+
+  d->ID3v1Location = trailer.ID3v1Location();
 
   if(d->ID3v1Location >= 0) {
-    d->tag.set(ID3v1Index, new ID3v1::Tag(this, d->ID3v1Location));
+    if(readTags)
+      d->tag.set(ID3v1Index, new ID3v1::Tag(this, d->ID3v1Location, trailer.ID3v1Data()));
     d->hasID3v1 = true;
   }
 
-  // Look for an APE tag
-
-  d->APELocation = findAPE();
+  d->APELocation = trailer.APELocation();
 
   if(d->APELocation >= 0) {
-    d->tag.set(APEIndex, new APE::Tag(this, d->APELocation));
-    d->APESize = APETag()->footer()->completeTagSize();
-    d->APELocation = d->APELocation + APETag()->footer()->size() - d->APESize;
+    if(readTags)
+      d->tag.set(APEIndex, new APE::Tag(this, trailer.APEFooterLocation(), trailer.APEFooterData()));
+    d->APESize = trailer.APESize();
     d->hasAPE = true;
   }
 
   if(!d->hasID3v1)
     APETag(true);
 
-  // Look for WavPack audio properties
+  // Look for WavPack audio properties in the first block header, the stream
+  // ends at the first of the tags.
 
   if(readProperties) {
-    seek(0);
-    d->properties = new Properties(this, length() - d->APESize);
-  }
-}
-
-long WavPack::File::findAPE()
-{
-  if(!isValid())
-    return -1;
-
-  if(d->hasID3v1)
-    seek(-160, End);
-  else
-    seek(-32, End);
-
-  long p = tell();
+    long streamEnd = length();
 
-  if(readBlock(8) == APE::Tag::fileIdentifier())
-    return p;
-
-  return -1;
-}
-
-long WavPack::File::findID3v1()
-{
-  if(!isValid())
-    return -1;
-
-  seek(-128, End);
-  long p = tell();
-
-  if(readBlock(3) == ID3v1::Tag::fileIdentifier())
-    return p;
+    if(d->hasAPE)
+      streamEnd = d->APELocation;
+    if(d->hasID3v1 && d->ID3v1Location < streamEnd)
+      streamEnd = d->ID3v1Location;
 
-  return -1;
+    seek(0);
+    d->properties = new Properties(this, streamEnd, propertiesStyle);
+  }
 }
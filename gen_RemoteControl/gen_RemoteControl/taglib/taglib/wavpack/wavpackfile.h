@@ -87,6 +87,40 @@ namespace TagLib {
       File(FileName file, bool readProperties = true,
            Properties::ReadStyle propertiesStyle = Properties::Average);
 
+      /*!
+       * Contructs an WavPack file from \a stream.  If \a readProperties is true the
+       * file's audio properties will also be read using \a propertiesStyle.  If
+       * false, \a propertiesStyle is ignored.
+       *
+       * The stream is not owned by the file, it has to stay valid until the
+       * file is destroyed.
+       */
+      File(IOStream *stream, bool readProperties = true,
+           Properties::ReadStyle propertiesStyle = Properties::Average);
+
+      /*!
+       * Contructs a WavPack file from \a file that only reads the parts given by
+       * \a readMode, a combination of TagLib::File::ReadMode values.  The audio
+       * properties are read using \a propertiesStyle if requested, from the
+       * first block header alone.  The tags are only parsed for ReadBasicFields,
+       * ReadExtendedFields or ReadAllFrames, the end of the file is probed for them in any case to
+       * know where the stream ends.
+       *
+       * \note A file that has been read without ReadAllFrames can't be saved.
+       */
+      File(FileName file, int readMode,
+           Properties::ReadStyle propertiesStyle = Properties::Average);
+
+      /*!
+       * Contructs a WavPack file from \a stream that only reads the parts given
+       * by \a readMode, see the constructor above.
+       *
+       * The stream is not owned by the file, it has to stay valid until the
+       * file is destroyed.
+       */
+      File(IOStream *stream, int readMode,
+           Properties::ReadStyle propertiesStyle = Properties::Average);
+
       /*!
        * Destroys this instance of the File.
        */
@@ -152,8 +186,6 @@ namespace TagLib {
 
       void read(bool readProperties, Properties::ReadStyle propertiesStyle);
       void scan();
-      long findID3v1();
-      long findAPE();
 
       class FilePrivate;
       FilePrivate *d;
@@ -0,0 +1,444 @@
+/* Parse throughput benchmark
+ *
+ * Measures files per second and MB per second of FileRef creation, tag reads, partial reads of the basic
+ * fields (see File::ReadMode), audio properties reads in every read style and picture extraction, per
+ * format. Runs over the files of the test data directory and over a generated corpus: copies of every file
+ * plus large variants with random data appended. Also counts the heap allocations per file, TagLib can be
+ * built WITH_POOLED_ALLOCATION to compare. The checksum of Ogg pages (ByteVector::checksum()) is measured in
+ * MB per second for several block sizes, against the byte at a time loop.
+ *
+ * usage: benchmark [data directory] [copies] [large file size in MB] [map]
+ *
+ * "map" reads the files through memory maps, see FileStream::setMemoryMapping().
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <map>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/time.h>
+#endif
+
+#include <tag.h>
+#include <fileref.h>
+#include <tfile.h>
+#include <tfilestream.h>
+#include <mpegfile.h>
+#include <id3v2tag.h>
+#include <attachedpictureframe.h>
+#include <flacfile.h>
+#include <flacpicture.h>
+#include <taglib_config.h>
+#ifdef TAGLIB_WITH_MP4
+#include <mp4file.h>
+#include <mp4tag.h>
+#endif
+
+using namespace std;
+using namespace TagLib;
+
+// heap allocations of the benchmark and of TagLib, the library uses the global operators
+
+static unsigned long allocations = 0;
+
+void *operator new(size_t size)
+{
+  allocations++;
+  void *block = malloc(size > 0 ? size : 1);
+  if(!block)
+    throw bad_alloc();
+  return block;
+}
+
+void operator delete(void *block) throw()
+{
+  free(block);
+}
+
+// files of one format (extension)
+struct Corpus
+{
+  vector<string> files;
+  long long bytes;
+};
+
+typedef map<string, Corpus> CorpusMap;
+
+static double now()
+{
+#ifdef _WIN32
+  LARGE_INTEGER counter, frequency;
+  QueryPerformanceCounter(&counter);
+  QueryPerformanceFrequency(&frequency);
+  return double(counter.QuadPart) / double(frequency.QuadPart);
+#else
+  timeval time;
+  gettimeofday(&time, 0);
+  return time.tv_sec + time.tv_usec / 1000000.0;
+#endif
+}
+
+static vector<string> listDirectory(const string &directory)
+{
+  vector<string> names;
+#ifdef _WIN32
+  WIN32_FIND_DATAA data;
+  HANDLE find = FindFirstFileA((directory + "\\*").c_str(), &data);
+  if(find == INVALID_HANDLE_VALUE)
+    return names;
+  do {
+    if(!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+      names.push_back(data.cFileName);
+  } while(FindNextFileA(find, &data));
+  FindClose(find);
+#else
+  DIR *dir = opendir(directory.c_str());
+  if(!dir)
+    return names;
+  while(dirent *entry = readdir(dir)) {
+    if(entry->d_name[0] != '.')
+      names.push_back(entry->d_name);
+  }
+  closedir(dir);
+#endif
+  return names;
+}
+
+static string extensionOf(const string &name)
+{
+  string::size_type dot = name.rfind('.');
+  if(dot == string::npos)
+    return string();
+  string ext = name.substr(dot + 1);
+  for(string::iterator it = ext.begin(); it != ext.end(); ++it)
+    *it = char(tolower(*it));
+  return ext;
+}
+
+static long long fileSize(const string &name)
+{
+  FILE *file = fopen(name.c_str(), "rb");
+  if(!file)
+    return 0;
+  fseek(file, 0, SEEK_END);
+  long long size = ftell(file);
+  fclose(file);
+  return size;
+}
+
+// copies a file and appends extra bytes of random data
+static bool copyFile(const string &from, const string &to, long long extra)
+{
+  FILE *in = fopen(from.c_str(), "rb");
+  if(!in)
+    return false;
+  FILE *out = fopen(to.c_str(), "wb");
+  if(!out) {
+    fclose(in);
+    return false;
+  }
+
+  char buffer[65536];
+  size_t bytes;
+  while((bytes = fread(buffer, 1, sizeof(buffer), in)) > 0)
+    fwrite(buffer, 1, bytes, out);
+
+  while(extra > 0) {
+    size_t length = extra < (long long)sizeof(buffer) ? size_t(extra) : sizeof(buffer);
+    for(size_t i = 0; i < length; i++)
+      buffer[i] = char(rand());
+    fwrite(buffer, 1, length, out);
+    extra -= length;
+  }
+
+  fclose(in);
+  fclose(out);
+  return true;
+}
+
+// a new directory of its own in the temp directory for the generated corpus
+static string createTempDirectory()
+{
+#ifdef _WIN32
+  char path[MAX_PATH];
+  if(!GetTempPathA(MAX_PATH, path))
+    return string();
+  for(unsigned int i = 0; i < 100; i++) {
+    char name[MAX_PATH + 64];
+    sprintf(name, "%staglib-benchmark-%lu-%u", path, GetCurrentProcessId(), i);
+    if(CreateDirectoryA(name, 0))
+      return name;
+  }
+  return string();
+#else
+  const char *base = getenv("TMPDIR");
+  string pattern = string(base && *base ? base : "/tmp") + "/taglib-benchmark-XXXXXX";
+  vector<char> name(pattern.begin(), pattern.end());
+  name.push_back(0);
+  return mkdtemp(&name[0]) ? string(&name[0]) : string();
+#endif
+}
+
+static void addFile(CorpusMap &corpus, const string &name)
+{
+  Corpus &c = corpus[extensionOf(name)];
+  c.files.push_back(name);
+  c.bytes += fileSize(name);
+}
+
+// operations, each opens the file once
+
+static void readFileRef(const char *name)
+{
+  FileRef f(name, false);
+}
+
+static void readTag(const char *name)
+{
+  FileRef f(name, false);
+  if(!f.isNull() && f.tag())
+    f.tag()->title().size();
+}
+
+static void readBasic(const char *name)
+{
+  FileRef f(name, File::ReadBasicFields);
+  if(!f.isNull() && f.tag())
+    f.tag()->title().size();
+}
+
+static void readProperties(const char *name, AudioProperties::ReadStyle style)
+{
+  FileRef f(name, true, style);
+  if(!f.isNull() && f.audioProperties())
+    f.audioProperties()->length();
+}
+
+static void readFast(const char *name) { readProperties(name, AudioProperties::Fast); }
+static void readAverage(const char *name) { readProperties(name, AudioProperties::Average); }
+static void readAccurate(const char *name) { readProperties(name, AudioProperties::Accurate); }
+
+static void readPicture(const char *name)
+{
+  string ext = extensionOf(name);
+
+  if(ext == "mp3") {
+    MPEG::File f(name, File::ReadPictures);
+    if(f.isValid() && f.ID3v2Tag()) {
+      ID3v2::FrameList l = f.ID3v2Tag()->frameList("APIC");
+      if(!l.isEmpty())
+        static_cast<ID3v2::AttachedPictureFrame *>(l.front())->picture().size();
+    }
+  }
+  else if(ext == "flac") {
+    FLAC::File f(name, File::ReadPictures);
+    if(f.isValid()) {
+      List<FLAC::Picture *> pictures = f.pictureList();
+      if(!pictures.isEmpty())
+        pictures.front()->data().size();
+    }
+  }
+#ifdef TAGLIB_WITH_MP4
+  else if(ext == "m4a" || ext == "mp4") {
+    MP4::File f(name, false);
+    if(f.isValid() && f.tag() && f.tag()->itemListMap().contains("covr"))
+      f.tag()->itemListMap()["covr"].toCoverArtList().size();
+  }
+#endif
+}
+
+static bool hasPicture(const string &ext)
+{
+#ifdef TAGLIB_WITH_MP4
+  if(ext == "m4a" || ext == "mp4")
+    return true;
+#endif
+  return ext == "mp3" || ext == "flac";
+}
+
+static bool allFormats(const string &)
+{
+  return true;
+}
+
+struct Operation
+{
+  const char *name;
+  void (*run)(const char *);
+  bool (*supports)(const string &);
+};
+
+static const Operation operations[] = {
+  { "fileref", readFileRef, allFormats },
+  { "tag", readTag, allFormats },
+  { "basic", readBasic, allFormats },
+  { "fast", readFast, allFormats },
+  { "average", readAverage, allFormats },
+  { "accurate", readAccurate, allFormats },
+  { "picture", readPicture, hasPicture }
+};
+
+// every operation is repeated over the files for at least this long
+static const double minimumSeconds = 0.2;
+
+static void run(const string &title, CorpusMap &corpus)
+{
+  cout << endl << title << endl;
+  cout << left << setw(8) << "format" << setw(10) << "operation" << right
+       << setw(8) << "files" << setw(14) << "files/s" << setw(12) << "MB/s" << setw(14) << "allocs/file" << endl;
+
+  for(CorpusMap::iterator it = corpus.begin(); it != corpus.end(); ++it) {
+    Corpus &c = it->second;
+    if(c.files.empty())
+      continue;
+
+    for(unsigned int i = 0; i < sizeof(operations) / sizeof(operations[0]); i++) {
+      if(!operations[i].supports(it->first))
+        continue;
+
+      int passes = 0;
+      double seconds = 0;
+      unsigned long startAllocations = allocations;
+      double start = now();
+      do {
+        for(vector<string>::iterator file = c.files.begin(); file != c.files.end(); ++file)
+          operations[i].run(file->c_str());
+        passes++;
+        seconds = now() - start;
+      } while(seconds < minimumSeconds);
+
+      cout << left << setw(8) << it->first << setw(10) << operations[i].name << right
+           << setw(8) << c.files.size()
+           << setw(14) << fixed << setprecision(1) << c.files.size() * passes / seconds
+           << setw(12) << fixed << setprecision(2) << c.bytes * passes / 1048576.0 / seconds
+           << setw(14) << fixed << setprecision(1) << double(allocations - startAllocations) / (c.files.size() * passes) << endl;
+    }
+  }
+}
+
+// the checksum a byte at a time, the way ByteVector::checksum() did it before the slice tables
+static unsigned int byteChecksum(const ByteVector &v)
+{
+  static unsigned int table[256];
+  if(table[1] == 0) {
+    for(unsigned int i = 0; i < 256; i++) {
+      unsigned int sum = i << 24;
+      for(int bit = 0; bit < 8; bit++)
+        sum = (sum & 0x80000000) ? (sum << 1) ^ 0x04c11db7 : sum << 1;
+      table[i] = sum;
+    }
+  }
+
+  unsigned int sum = 0;
+  for(ByteVector::ConstIterator it = v.begin(); it != v.end(); ++it)
+    sum = (sum << 8) ^ table[(sum >> 24) ^ (unsigned char)*it];
+  return sum;
+}
+
+// the results of the measured checksums, keeps the compiler from dropping the loops
+static volatile unsigned int checksumSink;
+
+static void runChecksum()
+{
+  static const unsigned int sizes[] = { 64, 4096, 65536, 1048576 };
+
+  cout << endl << "checksum" << endl;
+  cout << left << setw(10) << "bytes" << right << setw(14) << "byte MB/s" << setw(14) << "slice MB/s" << endl;
+
+  for(unsigned int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    ByteVector data(sizes[i], 0);
+    for(unsigned int j = 0; j < data.size(); j++)
+      data[j] = char(rand());
+
+    double rates[2];
+
+    for(int method = 0; method < 2; method++) {
+      long long bytes = 0;
+      double seconds = 0;
+      double start = now();
+      do {
+        for(int j = 0; j < 16; j++)
+          checksumSink = method == 0 ? byteChecksum(data) : data.checksum();
+        bytes += 16 * (long long)data.size();
+        seconds = now() - start;
+      } while(seconds < minimumSeconds);
+      rates[method] = bytes / 1048576.0 / seconds;
+    }
+
+    cout << left << setw(10) << sizes[i] << right
+         << setw(14) << fixed << setprecision(1) << rates[0]
+         << setw(14) << fixed << setprecision(1) << rates[1]
+         << (byteChecksum(data) == data.checksum() ? "" : "  mismatch") << endl;
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  string directory = argc > 1 ? argv[1] : "data";
+  int copies = argc > 2 ? atoi(argv[2]) : 20;
+  long long large = (argc > 3 ? atoll(argv[3]) : 8) * 1048576;
+
+  if(argc > 4 && string(argv[4]) == "map")
+    FileStream::setMemoryMapping(true);
+
+  vector<string> names = listDirectory(directory);
+  if(names.empty()) {
+    cerr << "no files in " << directory << endl;
+    return 1;
+  }
+
+  CorpusMap data;
+  for(vector<string>::iterator it = names.begin(); it != names.end(); ++it)
+    addFile(data, directory + "/" + *it);
+
+  run("test data", data);
+
+  runChecksum();
+
+  // generated corpus in a new temp directory, removed afterwards
+  const string temp = createTempDirectory();
+  if(temp.empty()) {
+    cerr << "cannot create a temp directory" << endl;
+    return 1;
+  }
+
+  CorpusMap generated;
+  vector<string> created;
+  srand(1);
+
+  for(vector<string>::iterator it = names.begin(); it != names.end(); ++it) {
+    string from = directory + "/" + *it;
+    string ext = extensionOf(*it);
+    for(int i = 0; i <= copies; i++) {
+      char suffix[32];
+      sprintf(suffix, "%s%d.", i == copies ? "-large-" : "-copy-", i);
+      string to = temp + "/" + *it + suffix + ext;
+      if(!copyFile(from, to, i == copies ? large : 0))
+        continue;
+      created.push_back(to);
+      addFile(generated, to);
+    }
+  }
+
+  run("generated corpus", generated);
+
+  for(vector<string>::iterator it = created.begin(); it != created.end(); ++it)
+    remove(it->c_str());
+#ifdef _WIN32
+  RemoveDirectoryA(temp.c_str());
+#else
+  rmdir(temp.c_str());
+#endif
+
+  return 0;
+}
@@ -0,0 +1,194 @@
+/* Thread stress test
+ *
+ * Parses the files of the test data directory in several threads at once and compares the results with a
+ * single threaded pass. Every thread also copies the shared statics (String::null, ByteVector::null, the
+ * ID3v1 genre tables) and strings shared with the other threads, which exercises the atomic reference
+ * counting. Prints "ok" and returns 0 if all threads got the same results.
+ *
+ * usage: stress [data directory] [threads] [rounds]
+ */
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <pthread.h>
+#endif
+
+#include <tag.h>
+#include <fileref.h>
+#include <tstring.h>
+#include <tbytevector.h>
+#include <tstringlist.h>
+#include <id3v1genres.h>
+
+using namespace std;
+using namespace TagLib;
+
+static vector<string> listDirectory(const string &directory)
+{
+  vector<string> names;
+#ifdef _WIN32
+  WIN32_FIND_DATAA data;
+  HANDLE find = FindFirstFileA((directory + "\\*").c_str(), &data);
+  if(find == INVALID_HANDLE_VALUE)
+    return names;
+  do {
+    if(!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+      names.push_back(directory + "\\" + data.cFileName);
+  } while(FindNextFileA(find, &data));
+  FindClose(find);
+#else
+  DIR *dir = opendir(directory.c_str());
+  if(!dir)
+    return names;
+  while(dirent *entry = readdir(dir)) {
+    if(entry->d_name[0] != '.')
+      names.push_back(directory + "/" + entry->d_name);
+  }
+  closedir(dir);
+#endif
+  return names;
+}
+
+// shared by all threads, only copied
+static const String sharedString("shared string");
+static const ByteVector sharedVector("shared vector");
+
+// everything the file gives through FileRef, as text
+static string describe(const string &name)
+{
+  ostringstream s;
+
+  FileRef f(name.c_str());
+  if(f.isNull()) {
+    s << "null";
+    return s.str();
+  }
+
+  if(Tag *tag = f.tag()) {
+    s << tag->title().toCString(true) << '|' << tag->artist().toCString(true) << '|'
+      << tag->album().toCString(true) << '|' << tag->comment().toCString(true) << '|'
+      << tag->genre().toCString(true) << '|' << tag->year() << '|' << tag->track() << '|'
+      << ID3v1::genreIndex(tag->genre()) << '|';
+  }
+
+  if(AudioProperties *properties = f.audioProperties()) {
+    s << properties->length() << '|' << properties->bitrate() << '|'
+      << properties->sampleRate() << '|' << properties->channels();
+  }
+
+  return s.str();
+}
+
+// copies of the shared objects, false if one of them has changed
+static bool touchShared()
+{
+  String s = sharedString;
+  String n = String::null;
+  ByteVector v = sharedVector;
+  ByteVector null = ByteVector::null;
+  StringList genres = ID3v1::genreList();
+
+  if(string(s.toCString()) != "shared string" || string(n.toCString()) != "" || !null.isEmpty())
+    return false;
+
+  s += " changed";
+  v.append('!');
+
+  return v.size() == sharedVector.size() + 1 && genres.size() == 148 &&
+         ID3v1::genre(17) == "Rock" && ID3v1::genreIndex("Rock") == 17;
+}
+
+struct Work
+{
+  const vector<string> *files;
+  const vector<string> *expected;
+  int first;
+  int rounds;
+  int failures;
+};
+
+#ifdef _WIN32
+static DWORD WINAPI run(LPVOID parameter)
+#else
+static void *run(void *parameter)
+#endif
+{
+  Work *work = static_cast<Work *>(parameter);
+  const size_t count = work->files->size();
+
+  for(int round = 0; round < work->rounds; round++) {
+    // the threads start at different files
+    for(size_t i = 0; i < count; i++) {
+      size_t file = (work->first + i) % count;
+      if(describe((*work->files)[file]) != (*work->expected)[file])
+        work->failures++;
+      if(!touchShared())
+        work->failures++;
+    }
+  }
+
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  string directory = argc > 1 ? argv[1] : "data";
+  int threads = argc > 2 ? atoi(argv[2]) : 8;
+  int rounds = argc > 3 ? atoi(argv[3]) : 20;
+
+  vector<string> files = listDirectory(directory);
+  if(files.empty()) {
+    cerr << "no files in " << directory << endl;
+    return 1;
+  }
+
+  vector<string> expected;
+  for(vector<string>::iterator it = files.begin(); it != files.end(); ++it)
+    expected.push_back(describe(*it));
+
+  vector<Work> work(threads);
+  for(int i = 0; i < threads; i++) {
+    work[i].files = &files;
+    work[i].expected = &expected;
+    work[i].first = i;
+    work[i].rounds = rounds;
+    work[i].failures = 0;
+  }
+
+#ifdef _WIN32
+  vector<HANDLE> handles(threads);
+  for(int i = 0; i < threads; i++)
+    handles[i] = CreateThread(NULL, 0, run, &work[i], 0, NULL);
+  for(int i = 0; i < threads; i++) {
+    WaitForSingleObject(handles[i], INFINITE);
+    CloseHandle(handles[i]);
+  }
+#else
+  vector<pthread_t> handles(threads);
+  for(int i = 0; i < threads; i++)
+    pthread_create(&handles[i], NULL, run, &work[i]);
+  for(int i = 0; i < threads; i++)
+    pthread_join(handles[i], NULL);
+#endif
+
+  int failures = 0;
+  for(int i = 0; i < threads; i++)
+    failures += work[i].failures;
+
+  cout << files.size() << " files, " << threads << " threads, " << rounds << " rounds: ";
+  if(failures > 0) {
+    cout << failures << " failed" << endl;
+    return 1;
+  }
+
+  cout << "ok" << endl;
+  return 0;
+}
@@ -39,6 +39,7 @@ class TestByteVector : public CppUnit::TestFixture
   CPPUNIT_TEST(testRfind2);
   CPPUNIT_TEST(testToHex);
   CPPUNIT_TEST(testToUShort);
+  CPPUNIT_TEST(testChecksum);
   CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -182,6 +183,41 @@ public:
     CPPUNIT_ASSERT_EQUAL(ByteVector("f0e1d2c3b4a5968778695a4b3c2d1e0f"), v.toHex());
   }
 
+  // The Ogg checksum computed bit by bit.
+
+  static unsigned int bitwiseChecksum(const ByteVector &v)
+  {
+    unsigned int sum = 0;
+    for(unsigned int i = 0; i < v.size(); i++) {
+      sum ^= (unsigned int)(unsigned char)v[i] << 24;
+      for(int bit = 0; bit < 8; bit++)
+        sum = (sum & 0x80000000) ? (sum << 1) ^ 0x04c11db7 : sum << 1;
+    }
+    return sum;
+  }
+
+  void testChecksum()
+  {
+    CPPUNIT_ASSERT_EQUAL((unsigned int)0, ByteVector().checksum());
+    CPPUNIT_ASSERT_EQUAL((unsigned int)0x89a1897f, ByteVector("123456789").checksum());
+
+    // Every length around the blocks of eight bytes, from every offset of a
+    // larger vector.
+
+    ByteVector data(4096 + 64, 0);
+    for(unsigned int i = 0; i < data.size(); i++)
+      data[i] = char(i * 7 + (i >> 5));
+
+    for(unsigned int offset = 0; offset < 8; offset++) {
+      for(unsigned int length = 0; length <= 40; length++) {
+        ByteVector v = data.mid(offset, length);
+        CPPUNIT_ASSERT_EQUAL(bitwiseChecksum(v), v.checksum());
+      }
+    }
+
+    CPPUNIT_ASSERT_EQUAL(bitwiseChecksum(data), data.checksum());
+  }
+
   void testToUShort()
   {
     CPPUNIT_ASSERT_EQUAL((unsigned short)0xFFFF, ByteVector("\xff\xff", 2).toUShort());
@@ -5,10 +5,17 @@
 #include <fileref.h>
 #include <oggflacfile.h>
 #include <vorbisfile.h>
+#include <flacfile.h>
+#include <mpegfile.h>
+#include <wavpackfile.h>
+#include <trueaudiofile.h>
 #include "utils.h"
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
+#ifdef TAGLIB_WITH_MP4
+#include <mp4file.h>
+#endif
 
 using namespace std;
 using namespace TagLib;
@@ -33,6 +40,7 @@ class TestFileRef : public CppUnit::TestFixture
 #endif
   CPPUNIT_TEST(testTrueAudio);
   CPPUNIT_TEST(testAPE);
+  CPPUNIT_TEST(testWrongExtension);
   CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -153,6 +161,35 @@ public:
   {
     fileRefSave("mac-399.ape", ".ape");
   }
+
+  // opens a copy of the file renamed to the wrong extension, the magic
+  // number has to tell the type
+  template <class T> bool createdAs(const string &filename, const string &ext, const string &wrongExt)
+  {
+    ScopedFileCopy copy(filename, ext);
+    string newname = copy.fileName() + wrongExt;
+    rename(copy.fileName().c_str(), newname.c_str());
+
+    FileRef *f = new FileRef(newname.c_str());
+    bool created = !f->isNull() && dynamic_cast<T *>(f->file()) != NULL && f->file()->isValid();
+    delete f;
+
+    deleteFile(newname);
+    return created;
+  }
+
+  void testWrongExtension()
+  {
+    CPPUNIT_ASSERT(createdAs<FLAC::File>("no-tags", ".flac", ".mp3"));
+    CPPUNIT_ASSERT(createdAs<MPEG::File>("xing", ".mp3", ".ogg"));
+    CPPUNIT_ASSERT(createdAs<Ogg::Vorbis::File>("empty", ".ogg", ".flac"));
+    CPPUNIT_ASSERT(createdAs<Ogg::FLAC::File>("empty_flac", ".oga", ".ogg"));
+    CPPUNIT_ASSERT(createdAs<WavPack::File>("click", ".wv", ".ape"));
+    CPPUNIT_ASSERT(createdAs<TrueAudio::File>("empty", ".tta", ".xyz"));
+#ifdef TAGLIB_WITH_MP4
+    CPPUNIT_ASSERT(createdAs<MP4::File>("has-tags", ".m4a", ".mp3"));
+#endif
+  }
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(TestFileRef);
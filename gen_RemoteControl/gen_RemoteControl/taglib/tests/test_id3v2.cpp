@@ -4,12 +4,15 @@
 #include <id3v2tag.h>
 #include <mpegfile.h>
 #include <id3v2frame.h>
+#include <id3v2header.h>
+#include <id3v2synchdata.h>
 #include <uniquefileidentifierframe.h>
 #include <textidentificationframe.h>
 #include <attachedpictureframe.h>
 #include <generalencapsulatedobjectframe.h>
 #include <relativevolumeframe.h>
 #include <popularimeterframe.h>
+#include <commentsframe.h>
 #include <urllinkframe.h>
 #include <tdebug.h>
 #include "utils.h"
@@ -46,6 +49,7 @@ class TestID3v2 : public CppUnit::TestFixture
   CPPUNIT_TEST(testParsePOPMWithoutCounter);
   CPPUNIT_TEST(testRenderPOPM);
   CPPUNIT_TEST(testPOPMFromFile);
+  CPPUNIT_TEST(testSaveIntoPadding);
   CPPUNIT_TEST(testParseRelativeVolumeFrame);
   CPPUNIT_TEST(testParseUniqueFileIdentifierFrame);
   CPPUNIT_TEST(testParseEmptyUniqueFileIdentifierFrame);
@@ -62,6 +66,8 @@ class TestID3v2 : public CppUnit::TestFixture
   CPPUNIT_TEST(testUpdateDate22);
   // CPPUNIT_TEST(testUpdateFullDate22); TODO TYE+TDA should be upgraded to TDRC together
   CPPUNIT_TEST(testCompressedFrameWithBrokenLength);
+  CPPUNIT_TEST(testReadFields);
+  CPPUNIT_TEST(testRenderRoundTrip);
   CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -173,7 +179,7 @@ public:
 
     ID3v2::Tag tag;
     tag.addFrame(frame);
-    CPPUNIT_ASSERT_EQUAL(TagLib::uint(1034), tag.render().size());
+    CPPUNIT_ASSERT_EQUAL(ID3v2::Header::size(), tag.render().size());
   }
 
   // http://bugs.kde.org/show_bug.cgi?id=151078
@@ -262,6 +268,39 @@ public:
     CPPUNIT_ASSERT_EQUAL(200, dynamic_cast<ID3v2::PopularimeterFrame *>(bar.ID3v2Tag()->frameList("POPM").front())->rating());
   }
 
+  void testSaveIntoPadding()
+  {
+    ScopedFileCopy copy("xing", ".mp3");
+    string newname = copy.fileName();
+
+    {
+      MPEG::File f(newname.c_str());
+      f.ID3v2Tag(true)->setTitle("Title");
+      f.save();
+    }
+
+    long audioOffset;
+    TagLib::uint tagSize;
+    {
+      // the first save reserves File::paddingSize() behind the frames, the
+      // next one has to fit into it without moving the audio
+      MPEG::File f(newname.c_str());
+      audioOffset = f.firstFrameOffset();
+      tagSize = f.ID3v2Tag()->header()->completeTagSize();
+      CPPUNIT_ASSERT(tagSize >= ID3v2::Header::size() + File::paddingSize());
+
+      f.ID3v2Tag()->setTitle(String(std::string(1000, 'x')));
+      f.ID3v2Tag()->setArtist("Artist");
+      f.save();
+    }
+
+    MPEG::File f(newname.c_str());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(1000), f.ID3v2Tag()->title().size());
+    CPPUNIT_ASSERT_EQUAL(String("Artist"), f.ID3v2Tag()->artist());
+    CPPUNIT_ASSERT_EQUAL(tagSize, f.ID3v2Tag()->header()->completeTagSize());
+    CPPUNIT_ASSERT_EQUAL(audioOffset, f.firstFrameOffset());
+  }
+
   // http://bugs.kde.org/show_bug.cgi?id=150481
   void testParseRelativeVolumeFrame()
   {
@@ -469,6 +508,73 @@ public:
     CPPUNIT_ASSERT_EQUAL(TagLib::uint(86414), frame->picture().size());
   }
 
+  void testReadFields()
+  {
+    ID3v2::Tag tag;
+    tag.setTitle("Title");
+    tag.setArtist("Artist");
+    tag.setYear(2010);
+
+    ID3v2::TextIdentificationFrame *genre = new ID3v2::TextIdentificationFrame("TCON");
+    genre->setText("17");
+    tag.addFrame(genre);
+
+    ID3v2::CommentsFrame *described = new ID3v2::CommentsFrame;
+    described->setDescription("iTunNORM");
+    described->setText("0000");
+    tag.addFrame(described);
+
+    ID3v2::CommentsFrame *comment = new ID3v2::CommentsFrame;
+    comment->setText("Comment");
+    tag.addFrame(comment);
+
+    TagFields fields;
+    tag.readFields(fields);
+    CPPUNIT_ASSERT_EQUAL(tag.title(), fields.title);
+    CPPUNIT_ASSERT_EQUAL(tag.artist(), fields.artist);
+    CPPUNIT_ASSERT_EQUAL(String(), fields.album);
+    CPPUNIT_ASSERT_EQUAL(String("Rock"), fields.genre);
+    CPPUNIT_ASSERT_EQUAL(tag.genre(), fields.genre);
+    CPPUNIT_ASSERT_EQUAL(String("Comment"), fields.comment);
+    CPPUNIT_ASSERT_EQUAL(tag.comment(), fields.comment);
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(2010), fields.year);
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(0), fields.track);
+
+    TagFields title;
+    tag.readFields(title, Tag::Title);
+    CPPUNIT_ASSERT_EQUAL(String("Title"), title.title);
+    CPPUNIT_ASSERT(title.artist.isEmpty());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(0), title.year);
+  }
+
+  void testRenderRoundTrip()
+  {
+    ID3v2::Tag tag;
+    tag.setTitle("Title");
+    tag.setArtist("Artist");
+    tag.setComment("Comment");
+    tag.setTrack(7);
+
+    ByteVector data = tag.render();
+    ID3v2::Header header(data.mid(0, ID3v2::Header::size()));
+    CPPUNIT_ASSERT_EQUAL(ID3v2::Header::size() + header.tagSize(), data.size());
+    CPPUNIT_ASSERT_EQUAL(ID3v2::Header::size() + header.tagSize(), header.completeTagSize());
+    CPPUNIT_ASSERT(data.startsWith("ID3"));
+
+    ByteVector frame = data.mid(ID3v2::Header::size(), 10);
+    CPPUNIT_ASSERT_EQUAL(ByteVector("TIT2"), frame.mid(0, 4));
+    CPPUNIT_ASSERT_EQUAL(ID3v2::SynchData::fromUInt(6), frame.mid(4, 4));
+    CPPUNIT_ASSERT_EQUAL(ByteVector(2, char(0)), frame.mid(8, 2));
+    CPPUNIT_ASSERT_EQUAL(tag.frameList("TIT2").front()->render(), data.mid(ID3v2::Header::size(), 16));
+
+    ID3v2::FrameList frames = tag.frameList();
+    uint framesSize = 0;
+    for(ID3v2::FrameList::ConstIterator it = frames.begin(); it != frames.end(); ++it)
+      framesSize += (*it)->render().size();
+    CPPUNIT_ASSERT_EQUAL(framesSize + File::paddingSize(), header.tagSize());
+    CPPUNIT_ASSERT_EQUAL(ByteVector(File::paddingSize(), char(0)), data.mid(data.size() - File::paddingSize()));
+  }
+
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(TestID3v2);
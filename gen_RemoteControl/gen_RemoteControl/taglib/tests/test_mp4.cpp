@@ -20,6 +20,7 @@ class TestMP4 : public CppUnit::TestFixture
   CPPUNIT_TEST(testUpdateStco);
   CPPUNIT_TEST(testSaveExisingWhenIlstIsLast);
   CPPUNIT_TEST(test64BitAtom);
+  CPPUNIT_TEST(testSaveInPadding);
   CPPUNIT_TEST(testGnre);
   CPPUNIT_TEST(testCovrRead);
   CPPUNIT_TEST(testCovrWrite);
@@ -138,7 +139,7 @@ public:
     CPPUNIT_ASSERT_EQUAL(true, f->tag()->itemListMap()["cpil"].toBool());
 
     MP4::Atoms *atoms = new MP4::Atoms(f);
-    MP4::Atom *moov = atoms->atoms[0];
+    MP4::Atom *moov = atoms->find("moov");
     CPPUNIT_ASSERT_EQUAL(long(77), moov->length);
 
     f->tag()->itemListMap()["pgap"] = true;
@@ -149,9 +150,82 @@ public:
     CPPUNIT_ASSERT_EQUAL(true, f->tag()->itemListMap()["pgap"].toBool());
 
     atoms = new MP4::Atoms(f);
-    moov = atoms->atoms[0];
-    // original size + 'pgap' size + padding
-    CPPUNIT_ASSERT_EQUAL(long(77 + 25 + 974), moov->length);
+    moov = atoms->find("moov");
+    // original size + 'pgap' size + padding, which reserves
+    // File::paddingSize() for later saves on top of the rounding to 1 KB
+    CPPUNIT_ASSERT_EQUAL(long(77 + 25 + 974 + File::paddingSize()), moov->length);
+  }
+
+  // the first 20 bytes of every chunk listed in the 'stco' table
+  ByteVectorList chunkData(MP4::File *f, MP4::Atoms &a)
+  {
+    ByteVectorList chunks;
+    MP4::Atom *stco = a.find("moov")->findall("stco", true)[0];
+    f->seek(stco->offset + 12);
+    ByteVector data = f->readBlock(stco->length - 12);
+    unsigned int count = data.mid(0, 4).toUInt();
+    for(unsigned int pos = 4; count--; pos += 4) {
+      f->seek(data.mid(pos, 4).toUInt());
+      chunks.append(f->readBlock(20));
+    }
+    return chunks;
+  }
+
+  void testSaveInPadding()
+  {
+    // moov (with udta ahead of trak), a 16 KB free atom, mdat
+    ScopedFileCopy copy("free-after-moov", ".m4a");
+    string filename = copy.fileName();
+
+    MP4::File *f = new MP4::File(filename.c_str());
+    long mdatOffset, stcoOffset, moovLength;
+    ByteVectorList chunks;
+    {
+      MP4::Atoms a(f);
+      mdatOffset = a.find("mdat")->offset;
+      stcoOffset = a.find("moov")->findall("stco", true)[0]->offset;
+      moovLength = a.find("moov")->length;
+      CPPUNIT_ASSERT_EQUAL(long(16384), a.find("free")->length);
+      chunks = chunkData(f, a);
+    }
+
+    // the new meta goes into udta, moov grows into the free atom behind it
+    f->tag()->setTitle("Title");
+    f->save();
+    delete f;
+
+    f = new MP4::File(filename.c_str());
+    CPPUNIT_ASSERT_EQUAL(String("Title"), f->tag()->title());
+    {
+      MP4::Atoms a(f);
+      MP4::Atom *moov = a.find("moov");
+      CPPUNIT_ASSERT(a.find("moov", "udta", "meta", "ilst"));
+      CPPUNIT_ASSERT_EQUAL(mdatOffset, a.find("mdat")->offset);
+      CPPUNIT_ASSERT_EQUAL(moovLength + 16384, moov->length + a.find("free")->length);
+      // trak and its stco moved with the end of udta, the chunks did not
+      CPPUNIT_ASSERT_EQUAL(stcoOffset + moov->length - moovLength,
+                           moov->findall("stco", true)[0]->offset);
+      CPPUNIT_ASSERT(chunks == chunkData(f, a));
+    }
+
+    // more than the padding inside meta, the rest of the free atom takes it
+    f->tag()->setArtist(String(std::string(6000, 'x')));
+    f->save();
+    delete f;
+
+    f = new MP4::File(filename.c_str());
+    CPPUNIT_ASSERT_EQUAL(String("Title"), f->tag()->title());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(6000), f->tag()->artist().size());
+    {
+      MP4::Atoms a(f);
+      MP4::Atom *moov = a.find("moov");
+      CPPUNIT_ASSERT_EQUAL(mdatOffset, a.find("mdat")->offset);
+      CPPUNIT_ASSERT_EQUAL(moovLength + 16384, moov->length + a.find("free")->length);
+      CPPUNIT_ASSERT_EQUAL(stcoOffset + moov->length - moovLength,
+                           moov->findall("stco", true)[0]->offset);
+      CPPUNIT_ASSERT(chunks == chunkData(f, a));
+    }
+    delete f;
   }
 
   void testGnre()
@@ -0,0 +1,55 @@
+#include <cppunit/extensions/HelperMacros.h>
+#include <string>
+#include <stdio.h>
+#include <tag.h>
+#include <tbytevectorstream.h>
+#include <mpcfile.h>
+
+using namespace std;
+using namespace TagLib;
+
+class TestMPC : public CppUnit::TestFixture
+{
+  CPPUNIT_TEST_SUITE(TestMPC);
+  CPPUNIT_TEST(testPropertiesSV7);
+  CPPUNIT_TEST(testPropertiesSV8);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+
+  void testPropertiesSV7()
+  {
+    MPC::File f("data/click.mpc", File::ReadAudioProperties);
+    CPPUNIT_ASSERT(f.audioProperties());
+    CPPUNIT_ASSERT_EQUAL(7, f.audioProperties()->mpcVersion());
+    CPPUNIT_ASSERT_EQUAL(44100, f.audioProperties()->sampleRate());
+    CPPUNIT_ASSERT(!f.save());
+  }
+
+  void testPropertiesSV8()
+  {
+    // The stream header packet of 3 seconds of stereo at 44100 Hz, 132300
+    // samples with 441 of them silence at the beginning.
+
+    ByteVector data("MPCK" "SH", 6);
+    data.append(char(0x10));
+    data.append(ByteVector(4, 0));
+    data.append(char(8));
+    data.append(ByteVector("\x88\x89\x4c", 3));
+    data.append(ByteVector("\x83\x39", 2));
+    data.append(char(0x00));
+    data.append(char(0x10));
+    data.append(ByteVector(64, 0));
+
+    ByteVectorStream stream(data);
+    MPC::File f(&stream, File::ReadAudioProperties);
+    CPPUNIT_ASSERT(f.audioProperties());
+    CPPUNIT_ASSERT_EQUAL(8, f.audioProperties()->mpcVersion());
+    CPPUNIT_ASSERT_EQUAL(44100, f.audioProperties()->sampleRate());
+    CPPUNIT_ASSERT_EQUAL(2, f.audioProperties()->channels());
+    CPPUNIT_ASSERT_EQUAL(3, f.audioProperties()->length());
+  }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestMPC);
@@ -2,6 +2,14 @@
 #include <string>
 #include <stdio.h>
 #include <mpegfile.h>
+#include <mpegproperties.h>
+#include <xingheader.h>
+#include <tbytevectorstream.h>
+#include <apetag.h>
+#include <id3v1tag.h>
+#include <id3v2tag.h>
+#include <attachedpictureframe.h>
+#include <unsynchronizedlyricsframe.h>
 
 using namespace std;
 using namespace TagLib;
@@ -10,6 +18,14 @@ class TestMPEG : public CppUnit::TestFixture
 {
   CPPUNIT_TEST_SUITE(TestMPEG);
   CPPUNIT_TEST(testVersion2DurationWithXingHeader);
+  CPPUNIT_TEST(testVBRIHeader);
+  CPPUNIT_TEST(testLAMEEncoderGap);
+  CPPUNIT_TEST(testAPETagBeforeLyrics3);
+  CPPUNIT_TEST(testFrameOffsets);
+  CPPUNIT_TEST(testAccurateScan);
+  CPPUNIT_TEST(testReadExtendedFields);
+  CPPUNIT_TEST(testParseLimits);
+  CPPUNIT_TEST(testTagUnion);
   CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -20,6 +36,268 @@ public:
     CPPUNIT_ASSERT_EQUAL(5387, f.audioProperties()->length());
   }
 
+  // MPEG-1 Layer III frames at 44.1 kHz and 128 kbps, the first one with
+  // the given VBR header 36 bytes into it
+  ByteVector framesWithHeader(const ByteVector &header, int count = 100)
+  {
+    ByteVector frame = ByteVector("\xff\xfb\x90\x00", 4) + ByteVector(413, char(0));
+
+    ByteVector data = frame;
+    for(uint i = 0; i < header.size(); i++)
+      data[36 + i] = header[i];
+    for(int i = 1; i < count; i++)
+      data.append(frame);
+    return data;
+  }
+
+  void testVBRIHeader()
+  {
+    // The totals of the header win over the 100 frames in the stream.
+
+    ByteVector vbri = ByteVector("VBRI") + ByteVector(6, char(0))
+      + ByteVector::fromUInt(300000) + ByteVector::fromUInt(1000) + ByteVector(8, char(0));
+
+    ByteVectorStream stream(framesWithHeader(vbri));
+    MPEG::File f(&stream, false);
+    MPEG::Properties properties(&f, AudioProperties::Fast);
+
+    CPPUNIT_ASSERT(properties.xingHeader());
+    CPPUNIT_ASSERT_EQUAL(MPEG::XingHeader::VBRI, properties.xingHeader()->type());
+    CPPUNIT_ASSERT_EQUAL(1000LL * 1152, properties.sampleFrames());
+    CPPUNIT_ASSERT_EQUAL(1000LL * 1152 * 1000000 / 44100, properties.lengthInMicroseconds());
+    CPPUNIT_ASSERT_EQUAL(26, properties.length());
+    CPPUNIT_ASSERT_EQUAL(int(300000LL * 8000 / properties.lengthInMicroseconds()), properties.bitrate());
+  }
+
+  void testLAMEEncoderGap()
+  {
+    // Xing header with the frame count only, then the LAME extension with an
+    // encoder delay of 576 and a padding of 1000 samples.
+
+    ByteVector lame = ByteVector("LAME3.99r") + ByteVector(12, char(0))
+      + ByteVector::fromUInt((576 << 12) | 1000).mid(1) + ByteVector(12, char(0));
+    ByteVector xing = ByteVector("Xing") + ByteVector::fromUInt(1) + ByteVector::fromUInt(100) + lame;
+
+    ByteVectorStream stream(framesWithHeader(xing));
+    MPEG::File f(&stream, false);
+    MPEG::Properties properties(&f, AudioProperties::Fast);
+
+    CPPUNIT_ASSERT(properties.xingHeader());
+    CPPUNIT_ASSERT_EQUAL(MPEG::XingHeader::Xing, properties.xingHeader()->type());
+    CPPUNIT_ASSERT_EQUAL(576, properties.xingHeader()->encoderDelay());
+    CPPUNIT_ASSERT_EQUAL(1000, properties.xingHeader()->encoderPadding());
+    CPPUNIT_ASSERT_EQUAL(100LL * 1152 - 576 - 1000, properties.sampleFrames());
+    CPPUNIT_ASSERT_EQUAL((100LL * 1152 - 576 - 1000) * 1000000 / 44100, properties.lengthInMicroseconds());
+  }
+
+  void testAPETagBeforeLyrics3()
+  {
+    // frames, an APE tag, a Lyrics3 v2 block and an ID3v1 tag
+
+    ByteVector data = framesWithHeader(ByteVector(), 10);
+    const long framesEnd = data.size();
+
+    APE::Tag ape;
+    ape.setTitle("APE title");
+    ape.setArtist("APE artist");
+    data.append(ape.render());
+
+    const ByteVector lyrics = ByteVector("LYRICSBEGININD0000200LYR00005Words");
+    data.append(lyrics);
+    char size[7];
+    sprintf(size, "%06u", lyrics.size());
+    data.append(size);
+    data.append("LYRICS200");
+
+    ID3v1::Tag id3v1;
+    id3v1.setTitle("ID3v1 title");
+    data.append(id3v1.render());
+
+    ByteVectorStream stream(data);
+    MPEG::File f(&stream, false);
+
+    CPPUNIT_ASSERT(f.APETag());
+    CPPUNIT_ASSERT_EQUAL(String("APE title"), f.APETag()->title());
+    CPPUNIT_ASSERT_EQUAL(String("APE artist"), f.APETag()->artist());
+    CPPUNIT_ASSERT(f.ID3v1Tag());
+    CPPUNIT_ASSERT_EQUAL(String("ID3v1 title"), f.ID3v1Tag()->title());
+    CPPUNIT_ASSERT_EQUAL(String("APE title"), f.tag()->title());
+
+    // the stream ends in front of the APE tag
+    MPEG::Properties properties(&f, AudioProperties::Fast);
+    CPPUNIT_ASSERT_EQUAL(framesEnd * 8000LL / 128, properties.lengthInMicroseconds());
+  }
+
+  void testFrameOffsets()
+  {
+    ByteVector data(100000, char(0));
+    data[5000] = char(0xff);
+    data[5001] = char(0x12);
+    data[1023] = char(0xff);
+    data[1024] = char(0xe0);
+    data[40000] = char(0xff);
+    data[40001] = char(0xff);
+    data[40002] = char(0xfb);
+    data[99000] = char(0xff);
+    data[99001] = char(0xe3);
+
+    ByteVectorStream stream(data);
+    MPEG::File f(&stream, false);
+    CPPUNIT_ASSERT_EQUAL(long(1023), f.nextFrameOffset(0));
+    CPPUNIT_ASSERT_EQUAL(long(40001), f.nextFrameOffset(1024));
+    CPPUNIT_ASSERT_EQUAL(long(99000), f.nextFrameOffset(40002));
+    CPPUNIT_ASSERT_EQUAL(long(-1), f.nextFrameOffset(99001));
+    CPPUNIT_ASSERT_EQUAL(long(99000), f.previousFrameOffset(100000));
+    CPPUNIT_ASSERT_EQUAL(long(40001), f.previousFrameOffset(99001));
+    CPPUNIT_ASSERT_EQUAL(long(1023), f.previousFrameOffset(40001));
+    CPPUNIT_ASSERT_EQUAL(long(-1), f.previousFrameOffset(1024));
+    CPPUNIT_ASSERT_EQUAL(long(1023), f.firstFrameOffset());
+    CPPUNIT_ASSERT_EQUAL(long(99000), f.lastFrameOffset());
+  }
+
+  void testAccurateScan()
+  {
+    // MPEG-1 Layer III frames at 44.1 kHz, 128 and 160 kbps, without a Xing
+    // header.
+
+    ByteVector frame128 = framesWithHeader(ByteVector(), 1);
+    ByteVector frame160 = ByteVector("\xff\xfb\xa0\x00", 4) + ByteVector(518, char(0));
+
+    ByteVector data;
+    for(int i = 0; i < 300; i++)
+      data.append(frame128 + frame160);
+
+    ByteVectorStream stream(data);
+    MPEG::File f(&stream, false);
+    MPEG::Properties properties(&f, AudioProperties::Accurate);
+
+    CPPUNIT_ASSERT(!properties.xingHeader());
+    CPPUNIT_ASSERT(properties.isVariableBitrate());
+    CPPUNIT_ASSERT_EQUAL(600LL * 1152, properties.sampleFrames());
+    CPPUNIT_ASSERT_EQUAL(600LL * 1152 * 1000000 / 44100, properties.lengthInMicroseconds());
+
+    // 600 frames fill the table twice, every fourth frame is left.
+
+    CPPUNIT_ASSERT_EQUAL(4, properties.seekTableSpacing());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(150), properties.seekTable().size());
+    CPPUNIT_ASSERT_EQUAL(long(0), properties.seekTable()[0]);
+    CPPUNIT_ASSERT_EQUAL(long(2 * (417 + 522)), properties.seekTable()[1]);
+    CPPUNIT_ASSERT_EQUAL(long(298 * (417 + 522)), properties.seekTable().back());
+  }
+
+  void testReadExtendedFields()
+  {
+    ID3v2::Tag tag;
+    tag.setTitle("Title");
+
+    ID3v2::UnsynchronizedLyricsFrame *lyrics = new ID3v2::UnsynchronizedLyricsFrame;
+    lyrics->setText("Lyrics");
+    tag.addFrame(lyrics);
+
+    ID3v2::AttachedPictureFrame *picture = new ID3v2::AttachedPictureFrame;
+    picture->setPicture(ByteVector(1000, 'x'));
+    tag.addFrame(picture);
+
+    ByteVector data = tag.render();
+    data.append(framesWithHeader(ByteVector(), 10));
+
+    ByteVectorStream extendedStream(data);
+    MPEG::File extended(&extendedStream, File::ReadExtendedFields);
+    CPPUNIT_ASSERT(extended.ID3v2Tag());
+    CPPUNIT_ASSERT_EQUAL(String("Title"), extended.ID3v2Tag()->title());
+    CPPUNIT_ASSERT(!extended.ID3v2Tag()->frameList("USLT").isEmpty());
+    CPPUNIT_ASSERT(extended.ID3v2Tag()->frameList("APIC").isEmpty());
+    CPPUNIT_ASSERT(!extended.save());
+
+    ByteVectorStream basicStream(data);
+    MPEG::File basic(&basicStream, File::ReadBasicFields);
+    CPPUNIT_ASSERT_EQUAL(String("Title"), basic.ID3v2Tag()->title());
+    CPPUNIT_ASSERT(basic.ID3v2Tag()->frameList("USLT").isEmpty());
+  }
+
+  void testParseLimits()
+  {
+    // an ID3v2 tag larger than the block limit in front of the frames
+
+    ID3v2::Tag tag;
+    tag.setTitle("Title");
+    tag.setComment(String(std::string(8000, 'c')));
+
+    ByteVector data = tag.render();
+    data.append(framesWithHeader(ByteVector(), 10));
+
+    {
+      ByteVectorStream stream(data);
+      MPEG::File f(&stream, false);
+      CPPUNIT_ASSERT(!f.limitExceeded());
+      CPPUNIT_ASSERT_EQUAL(String("Title"), f.tag()->title());
+    }
+
+    File::setParseLimits(0, 4096, 0);
+
+    {
+      ByteVectorStream stream(data);
+      MPEG::File f(&stream, false);
+      CPPUNIT_ASSERT(f.limitExceeded());
+      CPPUNIT_ASSERT(f.tag()->title().isEmpty());
+
+      // the partially read file isn't saved over
+      f.tag()->setTitle("Changed");
+      f.save();
+      CPPUNIT_ASSERT(*stream.data() == data);
+    }
+
+    File::setParseLimits(4096, 0, 0);
+
+    {
+      ByteVectorStream stream(data);
+      MPEG::File f(&stream, false);
+      CPPUNIT_ASSERT(f.limitExceeded());
+    }
+
+    File::setParseLimits(0, 0, 0);
+  }
+
+  void testTagUnion()
+  {
+    ID3v2::Tag id3v2;
+    id3v2.setTitle("ID3v2 title");
+
+    ID3v1::Tag id3v1;
+    id3v1.setTitle("ID3v1 title");
+    id3v1.setArtist("ID3v1 artist");
+    id3v1.setYear(1999);
+
+    ByteVector data = id3v2.render();
+    data.append(framesWithHeader(ByteVector(), 10));
+    data.append(id3v1.render());
+
+    ByteVectorStream stream(data);
+    MPEG::File f(&stream, false);
+
+    // the first tag that has a field wins for that field
+
+    CPPUNIT_ASSERT_EQUAL(String("ID3v2 title"), f.tag()->title());
+    CPPUNIT_ASSERT_EQUAL(String("ID3v1 artist"), f.tag()->artist());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(1999), f.tag()->year());
+    CPPUNIT_ASSERT(f.tag()->album().isEmpty());
+
+    // a write to a tag handed out by the file is seen by the union
+
+    f.ID3v1Tag()->setArtist("New artist");
+    CPPUNIT_ASSERT_EQUAL(String("New artist"), f.tag()->artist());
+    f.ID3v2Tag()->setTitle("");
+    CPPUNIT_ASSERT_EQUAL(String("ID3v1 title"), f.tag()->title());
+
+    // and so is a write through the union
+
+    f.tag()->setTitle("Title");
+    f.tag()->setYear(2001);
+    CPPUNIT_ASSERT_EQUAL(String("Title"), f.tag()->title());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(2001), f.tag()->year());
+    CPPUNIT_ASSERT_EQUAL(String("Title"), f.ID3v1Tag()->title());
+  }
+
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(TestMPEG);
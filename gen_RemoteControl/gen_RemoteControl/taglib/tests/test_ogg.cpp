@@ -7,6 +7,7 @@
 #include <oggfile.h>
 #include <vorbisfile.h>
 #include <oggpageheader.h>
+#include <oggpage.h>
 #include "utils.h"
 
 using namespace std;
@@ -17,6 +18,7 @@ class TestOGG : public CppUnit::TestFixture
   CPPUNIT_TEST_SUITE(TestOGG);
   CPPUNIT_TEST(testSimple);
   CPPUNIT_TEST(testSplitPackets);
+  CPPUNIT_TEST(testPaddingReused);
   CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -51,6 +53,44 @@ public:
     delete f;
   }
 
+  void testPaddingReused()
+  {
+    ScopedFileCopy copy("empty", ".ogg");
+    string newname = copy.fileName();
+
+    Vorbis::File *f = new Vorbis::File(newname.c_str());
+    f->tag()->setArtist("The Artist");
+    f->save();
+    long length = f->length();
+    int lastPage = f->lastPageHeader()->pageSequenceNumber();
+    delete f;
+
+    // The shorter and the longer artist fit into the padding of the first save.
+
+    f = new Vorbis::File(newname.c_str());
+    f->tag()->setArtist("An");
+    f->save();
+    delete f;
+
+    f = new Vorbis::File(newname.c_str());
+    f->tag()->setArtist("The Artist with a longer name");
+    f->save();
+    CPPUNIT_ASSERT_EQUAL(length, f->length());
+    delete f;
+
+    f = new Vorbis::File(newname.c_str());
+    CPPUNIT_ASSERT_EQUAL(String("The Artist with a longer name"), f->tag()->artist());
+    CPPUNIT_ASSERT_EQUAL(lastPage, f->lastPageHeader()->pageSequenceNumber());
+
+    // The rewritten page has a valid checksum, rendering it gives the same bytes.
+
+    long offset = f->find("OggS", 1);
+    Ogg::Page page(f, offset);
+    f->seek(offset);
+    CPPUNIT_ASSERT(page.render() == f->readBlock(page.size()));
+    delete f;
+  }
+
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(TestOGG);
@@ -41,6 +41,7 @@ class TestString : public CppUnit::TestFixture
   CPPUNIT_TEST(testAppendCharDetach);
   CPPUNIT_TEST(testAppendStringDetach);
   CPPUNIT_TEST(testToInt);
+  CPPUNIT_TEST(testUTF8EndsAtNull);
   CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -193,6 +194,19 @@ public:
     CPPUNIT_ASSERT_EQUAL(String("-123aa").toInt(), -123);
   }
 
+  void testUTF8EndsAtNull()
+  {
+    String s(wstring(L"Ripped by THSLIVE\0\x00e9", 19));
+    CPPUNIT_ASSERT_EQUAL(std::string("Ripped by THSLIVE"), s.to8Bit(true));
+    CPPUNIT_ASSERT_EQUAL(std::string("Ripped by THSLIVE\0\xe9", 19), s.to8Bit(false));
+
+    char buffer[64];
+    CPPUNIT_ASSERT_EQUAL(17u, s.toUTF8(buffer, sizeof(buffer)));
+    CPPUNIT_ASSERT(memcmp(buffer, "Ripped by THSLIVE", 17) == 0);
+
+    CPPUNIT_ASSERT_EQUAL(std::string(), String(wstring(1, 0)).to8Bit(true));
+  }
+
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(TestString);
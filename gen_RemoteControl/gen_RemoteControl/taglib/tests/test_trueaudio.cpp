@@ -1,6 +1,7 @@
 #include <cppunit/extensions/HelperMacros.h>
 #include <string>
 #include <stdio.h>
+#include <tag.h>
 #include <trueaudiofile.h>
 
 using namespace std;
@@ -10,6 +11,7 @@ class TestTrueAudio : public CppUnit::TestFixture
 {
   CPPUNIT_TEST_SUITE(TestTrueAudio);
   CPPUNIT_TEST(testReadPropertiesWithoutID3v2);
+  CPPUNIT_TEST(testReadAudioPropertiesOnly);
   CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -21,6 +23,15 @@ public:
     CPPUNIT_ASSERT_EQUAL(3, f.audioProperties()->length());
   }
 
+  void testReadAudioPropertiesOnly()
+  {
+    TrueAudio::File f("data/empty.tta", File::ReadAudioProperties);
+    CPPUNIT_ASSERT(f.audioProperties());
+    CPPUNIT_ASSERT_EQUAL(3, f.audioProperties()->length());
+    CPPUNIT_ASSERT(f.tag()->isEmpty());
+    CPPUNIT_ASSERT(!f.save());
+  }
+
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(TestTrueAudio);
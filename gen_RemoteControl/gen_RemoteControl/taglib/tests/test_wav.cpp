@@ -4,6 +4,8 @@
 #include <tag.h>
 #include <tbytevectorlist.h>
 #include <wavfile.h>
+#include <id3v2tag.h>
+#include <attachedpictureframe.h>
 #include "utils.h"
 
 using namespace std;
@@ -13,6 +15,7 @@ class TestWAV : public CppUnit::TestFixture
 {
   CPPUNIT_TEST_SUITE(TestWAV);
   CPPUNIT_TEST(testLength);
+  CPPUNIT_TEST(testLazyID3Chunk);
   CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -23,6 +26,31 @@ public:
     CPPUNIT_ASSERT_EQUAL(3, f.audioProperties()->length());
   }
 
+  void testLazyID3Chunk()
+  {
+    ScopedFileCopy copy("empty", ".wav");
+    string filename = copy.fileName();
+
+    {
+      RIFF::WAV::File f(filename.c_str());
+      f.tag()->setTitle("Title");
+      ID3v2::AttachedPictureFrame *picture = new ID3v2::AttachedPictureFrame;
+      picture->setPicture(ByteVector(100000, 'x'));
+      f.tag()->addFrame(picture);
+      f.save();
+    }
+
+    // Opening reads the chunk headers and the properties, the 100 KB ID3
+    // chunk only once the tag is asked for.
+
+    RIFF::WAV::File f(filename.c_str());
+    CPPUNIT_ASSERT_EQUAL(3, f.audioProperties()->length());
+    const TagLib::ulong calls = f.ioCalls();
+    CPPUNIT_ASSERT_EQUAL(String("Title"), f.tag()->title());
+    CPPUNIT_ASSERT(f.ioCalls() > calls);
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(1), f.tag()->frameList("APIC").size());
+  }
+
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(TestWAV);
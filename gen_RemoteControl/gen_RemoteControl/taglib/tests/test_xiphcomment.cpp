@@ -15,6 +15,8 @@ class TestXiphComment : public CppUnit::TestFixture
   CPPUNIT_TEST(testSetYear);
   CPPUNIT_TEST(testTrack);
   CPPUNIT_TEST(testSetTrack);
+  CPPUNIT_TEST(testPictureData);
+  CPPUNIT_TEST(testFieldIndex);
   CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -59,6 +61,70 @@ public:
     CPPUNIT_ASSERT_EQUAL(String("3"), cmt.fieldListMap()["TRACKNUMBER"].front());
   }
 
+  void testPictureData()
+  {
+    ByteVector data = ByteVector::fromUInt(6, false) + ByteVector("vendor")
+      + ByteVector::fromUInt(2, false)
+      + ByteVector::fromUInt(11, false) + ByteVector("TITLE=Title")
+      + ByteVector::fromUInt(31, false) + ByteVector("METADATA_BLOCK_PICTURE=AAAAAwAA");
+
+    Ogg::XiphComment cmt(data);
+    CPPUNIT_ASSERT_EQUAL(String("Title"), cmt.title());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(1), cmt.pictureData().size());
+    CPPUNIT_ASSERT_EQUAL(ByteVector("AAAAAwAA"), cmt.pictureData().front());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(2), cmt.fieldCount());
+
+    CPPUNIT_ASSERT(cmt.fieldListMap().contains("METADATA_BLOCK_PICTURE"));
+    CPPUNIT_ASSERT_EQUAL(String("AAAAAwAA"), cmt.fieldListMap()["METADATA_BLOCK_PICTURE"].front());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(1), cmt.pictureData().size());
+    CPPUNIT_ASSERT_EQUAL(ByteVector("AAAAAwAA"), cmt.pictureData().front());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(2), cmt.fieldCount());
+
+    Ogg::XiphComment rendered(cmt.render(false));
+    CPPUNIT_ASSERT_EQUAL(String("Title"), rendered.title());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(1), rendered.pictureData().size());
+    CPPUNIT_ASSERT_EQUAL(ByteVector("AAAAAwAA"), rendered.pictureData().front());
+  }
+
+  void testFieldIndex()
+  {
+    ByteVector data = ByteVector::fromUInt(6, false) + ByteVector("vendor")
+      + ByteVector::fromUInt(5, false)
+      + ByteVector::fromUInt(11, false) + ByteVector("Title=First")
+      + ByteVector::fromUInt(12, false) + ByteVector("TITLE=Second")
+      + ByteVector::fromUInt(13, false) + ByteVector("artist=Artist")
+      + ByteVector::fromUInt(6, false) + ByteVector("GENRE=")
+      + ByteVector::fromUInt(15, false) + ByteVector("TRACKNUMBER=12");
+
+    // read through the index, then through the map, with the same results.
+    // the empty value is dropped as addField() would
+
+    Ogg::XiphComment cmt(data);
+    for(int pass = 0; pass < 2; pass++) {
+      CPPUNIT_ASSERT_EQUAL(String("First"), cmt.title());
+      CPPUNIT_ASSERT_EQUAL(String("Artist"), cmt.artist());
+      CPPUNIT_ASSERT_EQUAL(String(""), cmt.genre());
+      CPPUNIT_ASSERT_EQUAL(TagLib::uint(12), cmt.track());
+      CPPUNIT_ASSERT(cmt.contains("TITLE"));
+      CPPUNIT_ASSERT(cmt.contains("ARTIST"));
+      CPPUNIT_ASSERT(!cmt.contains("GENRE"));
+      CPPUNIT_ASSERT(!cmt.contains("ALBUM"));
+      CPPUNIT_ASSERT_EQUAL(TagLib::uint(4), cmt.fieldCount());
+
+      const Ogg::FieldListMap &map = cmt.fieldListMap();
+      CPPUNIT_ASSERT_EQUAL(TagLib::uint(2), map["TITLE"].size());
+      CPPUNIT_ASSERT_EQUAL(String("Second"), map["TITLE"].back());
+      CPPUNIT_ASSERT(map.contains("ARTIST"));
+      CPPUNIT_ASSERT(!map.contains("artist"));
+    }
+
+    cmt.setTitle("Changed");
+    Ogg::XiphComment rendered(cmt.render(false));
+    CPPUNIT_ASSERT_EQUAL(String("Changed"), rendered.title());
+    CPPUNIT_ASSERT_EQUAL(String("Artist"), rendered.artist());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(3), rendered.fieldCount());
+  }
+
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(TestXiphComment);